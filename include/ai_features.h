@@ -0,0 +1,85 @@
+#ifndef AI_FEATURES_H
+#define AI_FEATURES_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+#include "rssi_histogram.h"
+
+/**
+ * @brief Slots of the per-cycle feature vector (all values scaled to about [0, 1])
+ */
+typedef enum {
+    AI_FEATURE_WIFI_COUNT = 0,      // Networks / MAX_WIFI_NETWORKS
+    AI_FEATURE_BLE_COUNT,           // Devices / BLE_RECORD_CAPACITY
+    AI_FEATURE_WIFI_RSSI_P10,       // RSSI quantiles mapped from [-100, 0] dBm
+    AI_FEATURE_WIFI_RSSI_P50,
+    AI_FEATURE_WIFI_RSSI_P90,
+    AI_FEATURE_BLE_RSSI_P50,
+    AI_FEATURE_BLE_RSSI_P90,
+    AI_FEATURE_CHURN,               // (appeared + lost) / devices
+    AI_FEATURE_MOVED,               // Moved / devices
+    AI_FEATURE_NOVELTY,             // Share of new devices never seen before
+    AI_FEATURE_NOVEL_COUNT,         // Novel devices / AI_FEATURE_NOVEL_SCALE
+    AI_FEATURE_BLE_PHONES,          // BLE class mix as shares of all BLE devices
+    AI_FEATURE_BLE_TRACKERS,
+    AI_FEATURE_BLE_WEARABLES,
+    AI_FEATURE_BLE_BEACONS,
+    AI_FEATURE_CAPTURE_FPS,         // Frames per second / AI_FEATURE_FPS_SCALE
+    AI_FEATURE_WIFI_CLIENTS,        // Stations / AI_FEATURE_CLIENT_SCALE
+    AI_FEATURE_MEMORY_HEADROOM,     // Free heap / total heap
+    AI_FEATURE_TIME_SIN,            // Time of day on the unit circle (0 if unknown)
+    AI_FEATURE_TIME_COS,
+    AI_FEATURE_CLOCK_VALID,         // 1 once wall-clock time is set
+    AI_FEATURE_USER_INTERACTION,    // 1 if activity was flagged this cycle
+    AI_FEATURE_WAKE_MOTION,         // 1 while motion woke the device or was felt recently
+    AI_FEATURE_BATTERY_LOW,         // 1 under WAKE_BATTERY_LOW_MV
+    AI_FEATURE_PEOPLE,              // Person communities / AI_FEATURE_PEOPLE_SCALE
+    AI_FEATURE_PLACES,              // Place communities / AI_FEATURE_PLACE_SCALE
+    AI_FEATURE_LOCATION,            // (Fingerprint label + 1) / LOCATION_LABELS, 0 if unplaced
+    AI_FEATURE_LOCATION_MATCH,      // Share of the neighbour vote behind it
+    AI_FEATURE_AIRTIME,             // Rolling share of listening time the air was busy
+    AI_FEATURE_AIRTIME_PEAK,        // ... on the most congested channel
+    AI_FEATURE_TEMPERATURE,         // Over AI_FEATURE_TEMP_SPAN_C10 from AI_FEATURE_TEMP_MIN_C10
+    AI_FEATURE_HUMIDITY,            // Relative humidity, 0-1
+    AI_FEATURE_LIGHT,               // Lux / AI_FEATURE_LUX_SCALE
+    AI_FEATURE_MOTION,              // mg beyond gravity / AI_FEATURE_MOTION_SCALE
+    AI_FEATURE_BATTERY_LEVEL,       // Fuel gauge state of charge, 0-1
+    AI_FEATURE_DARK,                // 1 while the room is dark (the night profile)
+    AI_FEATURE_UNUSUAL,             // Deviation from this hour-of-week's baseline / AI_FEATURE_UNUSUAL_Z10
+    AI_FEATURE_ASSOCIATIONS,        // Association requests per minute / AI_FEATURE_ASSOC_SCALE
+    AI_FEATURE_HANDSHAKES,          // 4-way handshakes per minute / AI_FEATURE_HANDSHAKE_SCALE
+    AI_FEATURE_USED_COUNT           // Slots in use; the rest are zero padding
+} ai_feature_index_t;
+
+#define AI_FEATURE_ONE 32767        // 1.0 in the vector's Q15 fixed point
+
+/**
+ * @brief Fixed-size feature vector in Q15, padded to whole 16-byte lines
+ *
+ * Features are computed in integer arithmetic and stay integers up to the
+ * model's input tensor, which they are requantized into with a multiplier
+ * worked out once per model from its scale and zero point.
+ */
+typedef struct {
+    int16_t  values[AI_FEATURE_COUNT];  // Indexed by ai_feature_index_t, AI_FEATURE_ONE = 1.0
+    uint16_t scan_cycle;                // Scan cycle the vector was built from
+    uint16_t reserved;
+    uint32_t timestamp_ms;              // millis() at extraction
+} __attribute__((aligned(16))) ai_feature_vector_t;
+
+/**
+ * @brief Build the feature vector for one published scan cycle
+ * @param data Sensor data of the cycle
+ * @param histograms RSSI histograms of the cycle
+ * @param features Receives the vector
+ */
+void ai_features_extract(const sensor_data_t* data, const scan_histograms_t* histograms,
+                         ai_feature_vector_t* features);
+
+/**
+ * @brief Short name of a feature slot, for logs and model metadata
+ */
+const char* ai_feature_name(ai_feature_index_t index);
+
+#endif // AI_FEATURES_H
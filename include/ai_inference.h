@@ -0,0 +1,107 @@
+#ifndef AI_INFERENCE_H
+#define AI_INFERENCE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+#include "ai_features.h"
+
+/**
+ * @brief Inference backend statistics
+ */
+typedef struct {
+    bool     model_loaded;          // Model parsed and tensors allocated
+    bool     arena_in_psram;        // Tensor arena placement
+    uint32_t model_bytes;           // Size of the loaded flatbuffer
+    uint32_t arena_bytes;           // Tensor arena size (planned)
+    uint32_t model_hash;            // FNV-1a of the flatbuffer, keys the cached plan
+    bool     plan_cached;           // Arena size came from NVS
+    uint8_t  plan_probes;           // AllocateTensors() trials used to plan
+    uint32_t invocations;           // Successful Invoke() calls
+    uint32_t failures;              // Failed Invoke() calls
+    uint32_t low_confidence;        // Results rejected below AI_MODEL_MIN_CONFIDENCE
+    uint32_t last_invoke_us;        // Duration of the latest Invoke()
+    uint8_t  ops_registered;        // Kernels registered with the op resolver
+    uint32_t model_generation;      // Model store generation in force, 0 for a model file
+    uint32_t model_swaps;           // Models switched in without a reboot
+    uint32_t swap_failures;         // Committed models that failed to build
+    float    last_confidence;       // Top-class probability of the latest result
+    float    last_margin;           // Top-class minus runner-up probability
+    uint32_t avg_invoke_us;         // Mean Invoke() since boot
+    bool     fast_loaded;           // Cascade: a small model runs ahead of this one
+    uint32_t fast_model_hash;
+    uint32_t fast_arena_bytes;
+    uint32_t fast_invocations;
+    uint32_t fast_last_invoke_us;
+    uint32_t fast_avg_invoke_us;
+    uint32_t early_exits;           // Cycles the small model decided alone
+    uint32_t escalated_margin;      // Passed on: margin under AI_CASCADE_MARGIN or confidence too low
+    uint32_t escalated_novelty;     // Passed on: novel devices appeared in the cycle
+} ai_inference_stats_t;
+
+/**
+ * @brief Load the model from flash and allocate its tensor arena once
+ *
+ * The arena is sized by searching for the smallest buffer AllocateTensors()
+ * accepts; the result is cached in NVS against the model hash so later
+ * boots skip the search. With AI_CASCADE_ENABLED, a small model found as
+ * ASSET_FAST_MODEL_NAME or AI_FAST_MODEL_PATH is loaded next to it. Does
+ * nothing unless AI_INFERENCE_BACKEND is AI_BACKEND_TFLITE.
+ * @return true if a model is ready to run
+ */
+bool ai_inference_init(void);
+
+/**
+ * @brief Switch to a model committed since the last call
+ *
+ * Call from the inference task between two inferences. The new model is
+ * built next to the one in force and replaces it only once it is ready.
+ * @return true if a new model is now in force
+ */
+bool ai_inference_poll_update(void);
+
+/**
+ * @brief Classify a feature vector with the model
+ *
+ * The model runs at most once per feature vector; repeated calls with
+ * the same vector return the cached result. With a small model loaded,
+ * it runs first and its answer stands unless its top-2 margin is under
+ * AI_CASCADE_MARGIN or the cycle brought novel devices; only then does
+ * the main model run.
+ * @param features Vector of the latest scan cycle
+ * @param state Receives the predicted state
+ * @return false if no model is loaded, Invoke() failed or confidence was
+ *         too low, in which case the caller falls back to the rule engine
+ */
+bool ai_inference_run(const ai_feature_vector_t* features, ai_state_t* state);
+
+/**
+ * @brief Time AI_BENCHMARK_ROUNDS invocations of the loaded model and log the results
+ *
+ * Flash the default and the -reference environment to compare ESP-NN
+ * against reference kernels on the same model.
+ */
+void ai_inference_benchmark(void);
+
+/**
+ * @brief Check a model's flatbuffer structure and schema version without running it
+ *
+ * Every table offset and vector length is checked to lie inside the
+ * buffer, so a model that passes can be handed to the interpreter. An
+ * upload is checked before it is committed and every model before it is
+ * built.
+ * @return true if well formed (always, with the rule backend)
+ */
+bool ai_inference_verify_model(const uint8_t* model, uint32_t size);
+
+/**
+ * @brief Name of the backend in use ("tflite" or "rules")
+ */
+const char* ai_inference_backend_name(void);
+
+/**
+ * @brief Copy the backend statistics
+ */
+void ai_inference_get_stats(ai_inference_stats_t* stats);
+
+#endif // AI_INFERENCE_H
@@ -0,0 +1,132 @@
+#ifndef AI_RULES_H
+#define AI_RULES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+#include "ai_states.h"
+
+/**
+ * @brief Everything a rule may look at, prepared once per evaluation
+ *
+ * The activity fields are the smoothed history when one exists and the
+ * raw readings of the cycle otherwise.
+ */
+typedef struct {
+    const sensor_data_t* data;      // Latest published cycle
+    float      wifi_networks;       // WiFi networks in view
+    float      ble_devices;         // BLE devices in view
+    float      wifi_high;           // WiFi networks that count as busy here
+    uint32_t   excitement;          // Sustained activity, 0-100
+    ai_state_t current;             // State currently committed
+    uint32_t   state_duration_ms;   // Time spent in it
+} ai_rule_input_t;
+
+// Predicates - pure and constexpr, so rule sets can be checked at compile time on a host
+
+constexpr bool rule_low_memory(const ai_rule_input_t& in) {
+    return in.data->free_memory < LOW_MEMORY_THRESHOLD;
+}
+
+constexpr bool rule_novel_devices(const ai_rule_input_t& in) {
+    return in.data->novel_devices >= NOVELTY_EXCITED_THRESHOLD;
+}
+
+constexpr bool rule_wifi_busy(const ai_rule_input_t& in) {
+    return in.wifi_networks >= in.wifi_high;
+}
+
+constexpr bool rule_wifi_sustained(const ai_rule_input_t& in) {
+    return rule_wifi_busy(in) && in.excitement > AI_RULE_EXCITED_LEVEL;
+}
+
+constexpr bool rule_followed(const ai_rule_input_t& in) {
+    return in.data->ble_followers >= AI_RULE_FOLLOWERS;
+}
+
+constexpr bool rule_phone_crowd(const ai_rule_input_t& in) {
+    return in.data->ble_phones >= AI_RULE_CROWD_PHONES;
+}
+
+constexpr bool rule_digesting(const ai_rule_input_t& in) {
+    return in.current == AI_STATE_SNIFFING && in.state_duration_ms > AI_RULE_LEARNING_AFTER_MS;
+}
+
+constexpr bool rule_quiet(const ai_rule_input_t& in) {
+    return in.data->wifi_networks_count == 0 && in.data->ble_devices_count == 0 &&
+           in.wifi_networks < 0.5f && in.ble_devices < 0.5f &&
+           !in.data->user_interaction && in.state_duration_ms > AI_RULE_SLEEP_AFTER_MS;
+}
+
+/**
+ * @brief One rule: enter State when Predicate holds
+ */
+template <bool (*Predicate)(const ai_rule_input_t&), ai_state_t State>
+struct ai_rule {
+    static constexpr bool matches(const ai_rule_input_t& in) { return Predicate(in); }
+    static constexpr ai_state_t state = State;
+};
+
+/**
+ * @brief Ordered rule list; the first matching rule wins, Fallback if none does
+ *
+ * Expands at compile time into a plain if/else chain over the inlined
+ * predicates - there is no table to walk at run time.
+ */
+template <ai_state_t Fallback, typename... Rules>
+struct ai_rule_set;
+
+template <ai_state_t Fallback>
+struct ai_rule_set<Fallback> {
+    static constexpr size_t size = 0;
+    static constexpr ai_state_t evaluate(const ai_rule_input_t&) { return Fallback; }
+};
+
+template <ai_state_t Fallback, typename First, typename... Rest>
+struct ai_rule_set<Fallback, First, Rest...> {
+    static constexpr size_t size = 1 + sizeof...(Rest);
+    static constexpr ai_state_t evaluate(const ai_rule_input_t& in) {
+        return First::matches(in) ? First::state : ai_rule_set<Fallback, Rest...>::evaluate(in);
+    }
+};
+
+// General purpose: fixed installation, WiFi first
+typedef ai_rule_set<AI_STATE_IDLE,
+    ai_rule<rule_low_memory,     AI_STATE_ERROR>,
+    ai_rule<rule_novel_devices,  AI_STATE_EXCITED>,
+    ai_rule<rule_wifi_sustained, AI_STATE_EXCITED>,
+    ai_rule<rule_wifi_busy,      AI_STATE_SNIFFING>,
+    ai_rule<rule_followed,       AI_STATE_TRACKING>,
+    ai_rule<rule_digesting,      AI_STATE_LEARNING>,
+    ai_rule<rule_quiet,          AI_STATE_SLEEPING>
+> ai_rules_default_t;
+
+// Retail floor: people carry the signal, so BLE outranks WiFi
+typedef ai_rule_set<AI_STATE_IDLE,
+    ai_rule<rule_low_memory,     AI_STATE_ERROR>,
+    ai_rule<rule_followed,       AI_STATE_TRACKING>,
+    ai_rule<rule_phone_crowd,    AI_STATE_SNIFFING>,
+    ai_rule<rule_novel_devices,  AI_STATE_EXCITED>,
+    ai_rule<rule_wifi_busy,      AI_STATE_SNIFFING>,
+    ai_rule<rule_digesting,      AI_STATE_LEARNING>,
+    ai_rule<rule_quiet,          AI_STATE_SLEEPING>
+> ai_rules_retail_t;
+
+// Wardriving: always moving, so no dwell-based learning or sleeping
+typedef ai_rule_set<AI_STATE_IDLE,
+    ai_rule<rule_low_memory,     AI_STATE_ERROR>,
+    ai_rule<rule_novel_devices,  AI_STATE_EXCITED>,
+    ai_rule<rule_wifi_sustained, AI_STATE_EXCITED>,
+    ai_rule<rule_wifi_busy,      AI_STATE_SNIFFING>,
+    ai_rule<rule_followed,       AI_STATE_TRACKING>
+> ai_rules_wardriving_t;
+
+#if AI_RULE_PROFILE == AI_RULE_PROFILE_RETAIL
+typedef ai_rules_retail_t ai_rules_t;
+#elif AI_RULE_PROFILE == AI_RULE_PROFILE_WARDRIVING
+typedef ai_rules_wardriving_t ai_rules_t;
+#else
+typedef ai_rules_default_t ai_rules_t;
+#endif
+
+#endif // AI_RULES_H
@@ -0,0 +1,55 @@
+#ifndef AI_SEQUENCE_H
+#define AI_SEQUENCE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_features.h"
+
+/**
+ * @brief Streaming view of the recent feature history
+ *
+ * Every field is updated in O(1) per pushed vector, whatever the window size.
+ */
+typedef struct {
+    float    mean[AI_FEATURE_COUNT];    // Box filter over the window
+    float    hidden[AI_FEATURE_COUNT];  // Recurrent state, leaks towards each new vector
+    float    surprise;                  // Mean |x - window mean| of the newest vector
+    uint16_t length;                    // Vectors currently in the window
+    uint16_t newest_cycle;              // Scan cycle of the newest vector
+    uint32_t pushed;                    // Vectors pushed since init
+} ai_sequence_state_t;
+
+/**
+ * @brief Empty the window and reset the recurrent state
+ */
+void ai_sequence_init(void);
+
+/**
+ * @brief Start the recurrent state from a saved one instead of the first vector
+ *
+ * Call after ai_sequence_init() and before the first push; the window
+ * itself still fills from empty.
+ */
+void ai_sequence_seed(const float* hidden);
+
+/**
+ * @brief Append the feature vector of a new scan cycle
+ *
+ * Vectors already pushed (same extraction timestamp) and vectors that were
+ * never extracted are ignored, so the caller can push on every loop.
+ * @return true if the vector entered the window
+ */
+bool ai_sequence_push(const ai_feature_vector_t* features);
+
+/**
+ * @brief Current streaming state (owned by the AI task, not thread-safe)
+ */
+const ai_sequence_state_t* ai_sequence_state(void);
+
+/**
+ * @brief Vector pushed age cycles ago (0 = newest)
+ * @return NULL if the window holds fewer than age + 1 vectors
+ */
+const ai_feature_vector_t* ai_sequence_at(uint16_t age);
+
+#endif // AI_SEQUENCE_H
@@ -0,0 +1,53 @@
+#ifndef AI_STATE_STATS_H
+#define AI_STATE_STATS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+
+/**
+ * @brief Where the committed state has spent its time, since the last reset
+ */
+typedef struct {
+    ai_state_t current;                                 // State being timed now
+    uint32_t   seconds[AI_STATE_COUNT];                 // Time in each state
+    uint32_t   entries[AI_STATE_COUNT];                 // Transitions into each state
+    uint16_t   transitions[AI_STATE_COUNT][AI_STATE_COUNT]; // [from][to]
+    uint32_t   total_s;                                 // Sum of seconds
+    uint32_t   halvings;                                // Matrix halved, a count being full
+    uint32_t   saves;                                   // Written to the journal or NVS since boot
+    bool       restored;                                // Carried over from before the boot
+} ai_state_stats_t;
+
+/*
+ * Incremental figures for the committed AI state: time spent in each one
+ * and a count of every from/to transition, both updated in O(1) on each AI
+ * tick rather than recomputed from a log. The matrix holds 16-bit counts;
+ * when one would overflow every count is halved, which keeps the shares
+ * that matter when tuning the dwell times and the governor's profiles.
+ * Both are saved every AI_STATE_STATS_SAVE_INTERVAL_MS, so they cover
+ * weeks of uptime across restarts.
+ */
+
+/**
+ * @brief Restore the saved figures and start timing a state (AI task)
+ */
+void ai_state_stats_init(ai_state_t initial, uint32_t now_ms);
+
+/**
+ * @brief Charge the time since the last tick to the state in force, count a transition (AI task)
+ * @param committed State committed after this tick's decision
+ */
+void ai_state_stats_tick(ai_state_t committed, uint32_t now_ms);
+
+/**
+ * @brief Copy the figures, the current stay included; any task
+ */
+void ai_state_stats_get(ai_state_stats_t* stats);
+
+/**
+ * @brief Zero the figures; any task. The AI task saves the empty set on its next tick.
+ */
+void ai_state_stats_reset(void);
+
+#endif // AI_STATE_STATS_H
@@ -1,13 +1,16 @@
 #ifndef AI_STATES_H
 #define AI_STATES_H
 
+#include <stdint.h>
+#include <stddef.h>
+
 /**
  * @brief AI State enumeration for different Ponagotchi behaviors
  */
 typedef enum {
     AI_STATE_IDLE = 0,      // Default peaceful state
     AI_STATE_SNIFFING,      // High WiFi activity detected
-    AI_STATE_TRACKING,      // Strong BLE devices nearby  
+    AI_STATE_TRACKING,      // A device is following the unit
     AI_STATE_LEARNING,      // Processing captured data
     AI_STATE_EXCITED,       // Found interesting networks
     AI_STATE_SLEEPING,      // Low activity mode
@@ -15,22 +18,88 @@ typedef enum {
     AI_STATE_UPDATING       // OTA or system update
 } ai_state_t;
 
+#define AI_STATE_COUNT (AI_STATE_UPDATING + 1)
+
+// Bump whenever sensor_data_t changes layout
+#define SENSOR_DATA_VERSION 3
+
+// sensor_data_t.wake_flags
+#define SENSOR_WAKE_TOUCH        (1 << 0)   // A touch ended a deep sleep
+#define SENSOR_WAKE_MOTION       (1 << 1)   // Motion ended a sleep or was felt while awake
+#define SENSOR_WAKE_BATTERY_LOW  (1 << 2)   // Cell under WAKE_BATTERY_LOW_MV
+
 /**
  * @brief Structure to hold sensor and network data for AI inference
+ *
+ * Fixed-width fields in natural alignment, so the layout is the same for
+ * every compiler that sees this header and the struct doubles as its own
+ * wire format. The first 32-byte cache line holds everything the rule
+ * engine reads on each cycle.
  */
-typedef struct {
+typedef struct __attribute__((packed, aligned(4))) {
+    // Cache line 0: header and rule engine inputs
+    uint8_t  version;                // SENSOR_DATA_VERSION
+    uint8_t  wake_flags;             // SENSOR_WAKE_* events within WAKE_EVENT_HOLD_MS
+    uint16_t scan_cycle;             // Sequence number of the published scan cycle
+    uint32_t free_memory;            // Available free memory in bytes
+    uint32_t uptime_seconds;         // System uptime
     uint16_t wifi_networks_count;    // Number of WiFi networks detected
     int16_t  wifi_signal_strength;   // Average WiFi signal strength
     uint16_t ble_devices_count;      // Number of BLE devices detected
     int16_t  ble_signal_strength;    // Average BLE signal strength
-    uint32_t free_memory;            // Available free memory in bytes
-    uint32_t uptime_seconds;         // System uptime
-    bool     sd_card_present;        // SD card availability
+    uint16_t novel_devices;          // Devices not seen within NOVELTY_RETENTION_DAYS
+    uint16_t novelty_permille;       // Share of this cycle's new devices that were novel
     bool     user_interaction;       // Recent user input detected
+    bool     sd_card_present;        // SD card availability
+    uint8_t  hop_channel;            // Channel the hopper is parked on
+    uint8_t  busiest_channel;        // Channel with the highest frame-rate score
+    uint16_t devices_appeared;       // Devices first seen this cycle
+    uint16_t devices_lost;           // Devices aged out this cycle
+
+    // Cache line 1: capture, BLE classes and timing
+    uint16_t devices_moved;          // Devices whose RSSI jumped this cycle
+    uint16_t capture_frames_per_second; // Promiscuous frames per second
+    uint16_t probe_requests;         // Probe requests in the last capture window
+    uint16_t wifi_clients_count;     // Estimated unique stations per minute
+    uint16_t randomized_clients;     // Of those, using randomized MACs
+    uint16_t busiest_bssid_fps;      // Highest per-BSSID frame rate
+    uint16_t busiest_channel_fps;    // Frame-rate score of that channel
+    uint16_t ble_phones;             // Recent BLE devices classified as phones
+    uint16_t ble_trackers;           // ... as trackers (Find My, Tile, SmartTag)
+    uint16_t ble_wearables;          // ... as wearables
+    uint16_t ble_beacons;            // ... as beacons (iBeacon, Eddystone)
+    uint16_t ble_followers;          // Devices that stayed while the access points changed
+    uint32_t cycle_time_us;          // Radio clock when the cycle was closed
+    uint8_t  people_clusters;        // Co-occurrence communities that look like a person
+    uint8_t  place_clusters;         // ... like a place
+    uint8_t  location;               // Fingerprint label + 1, 0 if not a learned place
+    uint8_t  location_match;         // Neighbour vote behind it, 0-255
+
+    // Cache line 2: the air
+    uint16_t airtime_permille;       // Rolling share of listening time the air was busy
+    uint16_t busiest_airtime_permille; // ... on the most congested channel
+    uint8_t  busiest_airtime_channel; // That channel, 0 before any was measured
+
+    // ... and the room it is in, from the I2C sensors
+    uint8_t  battery_pct;            // Fuel gauge state of charge
+    int16_t  temperature_c10;        // Tenths of a degree Celsius
+    uint16_t humidity_permille;      // Relative humidity
+    uint16_t light_lux;              // Ambient light
+    uint16_t motion_mg;              // Acceleration beyond gravity, mg
+    uint8_t  i2c_fresh;              // Bit per i2c_sensor_id_t whose reading is current
+    uint8_t  ambient_level;          // ambient_level_t of the filtered light
+    uint8_t  unusual_z10;            // Largest deviation from this hour-of-week's baseline, tenths of a sigma
+    uint8_t  associations_per_min;   // Association and reassociation requests heard, saturating
+    uint8_t  handshakes_per_min;     // Completed 4-way handshakes heard, saturating
+    uint8_t  reserved[13];           // Zero; room for later fields
 } sensor_data_t;
 
+static_assert(sizeof(sensor_data_t) == 96, "sensor_data_t must stay three cache lines");
+static_assert(offsetof(sensor_data_t, devices_moved) == 32, "sensor_data_t line 0 overflowed");
+static_assert(offsetof(sensor_data_t, airtime_permille) == 64, "sensor_data_t line 1 overflowed");
+
 /**
- * @brief AI inference function to determine current state
+ * @brief Evaluate the compiled rule set on a single cycle (no history)
  * @param data Sensor and network data
  * @return Current AI state
  */
@@ -51,77 +120,3 @@ const char* ai_state_to_string(ai_state_t state);
 const char* ai_state_to_emoji(ai_state_t state);
 
 #endif // AI_STATES_H
-#ifndef AI_STATES_H
-#define AI_STATES_H
-
-#include <Arduino.h>
-
-// AI State enumeration
-typedef enum {
-    AI_STATE_IDLE = 0,
-    AI_STATE_SNIFFING,
-    AI_STATE_TRACKING,
-    AI_STATE_LEARNING,
-    AI_STATE_EXCITED,
-    AI_STATE_SLEEPING,
-    AI_STATE_ERROR,
-    AI_STATE_UPDATING
-} ai_state_t;
-
-// Sensor data structure
-typedef struct {
-    uint32_t wifi_networks_count;
-    int32_t wifi_signal_strength;
-    uint32_t ble_devices_count;
-    int32_t ble_signal_strength;
-    uint32_t free_memory;
-    uint32_t uptime_seconds;
-    bool user_interaction;
-    bool sd_card_present;
-} sensor_data_t;
-
-// Function declarations
-ai_state_t infer_ai_state(const sensor_data_t* data);
-const char* ai_state_to_string(ai_state_t state);
-
-#endif // AI_STATES_H
-#ifndef AI_STATES_H
-#define AI_STATES_H
-
-#include <Arduino.h>
-
-// AI State enumeration
-typedef enum {
-    AI_STATE_IDLE = 0,
-    AI_STATE_SNIFFING,
-    AI_STATE_TRACKING,
-    AI_STATE_LEARNING,
-    AI_STATE_EXCITED,
-    AI_STATE_SLEEPING,
-    AI_STATE_ERROR,
-    AI_STATE_UPDATING
-} ai_state_t;
-
-// Sensor data structure with all required fields
-typedef struct {
-    // Memory information
-    uint32_t free_memory;
-    uint32_t uptime_seconds;
-    bool sd_card_present;
-    
-    // Network scanning results
-    int wifi_networks_count;
-    int32_t wifi_signal_strength;
-    int ble_devices_count;
-    int32_t ble_signal_strength;
-    
-    // User interaction flag
-    bool user_interaction;
-} sensor_data_t;
-
-// Function declarations
-ai_state_t infer_ai_state(const sensor_data_t* data);
-const char* ai_state_to_string(ai_state_t state);
-const char* ai_state_to_emoji(ai_state_t state);
-
-#endif // AI_STATES_H
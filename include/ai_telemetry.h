@@ -0,0 +1,56 @@
+#ifndef AI_TELEMETRY_H
+#define AI_TELEMETRY_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Decision latency and certainty since boot or the last model swap
+ */
+typedef struct {
+    uint32_t decisions;             // Decisions timed
+    uint32_t model_decisions;       // Decided by the model
+    uint32_t rule_decisions;        // Decided by the rule engine (no model or low confidence)
+    uint32_t last_us;               // Latency of the latest decision
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t p50_us;                // Upper edge of the histogram bin holding the quantile
+    uint32_t p99_us;
+    uint32_t max_us;
+    uint32_t margins;               // Model outputs behind the margin figures
+    float    last_margin;           // Top-1 minus top-2 class probability, -1 without a model
+    float    mean_margin;
+    float    min_margin;
+    uint32_t narrow_margins;        // Outputs with margin below AI_TELEMETRY_NARROW_MARGIN
+} ai_telemetry_t;
+
+/**
+ * @brief Clear all counters, e.g. when a new model takes over
+ */
+void ai_telemetry_reset(void);
+
+/**
+ * @brief Record one decision
+ * @param latency_us Time from feature vector to proposed state
+ * @param model_decided The model's result was used
+ * @param margin Top-2 margin of the model output, negative if the model did not run
+ */
+void ai_telemetry_record(uint32_t latency_us, bool model_decided, float margin);
+
+/**
+ * @brief Copy the current figures, quantiles estimated from the latency histogram
+ */
+void ai_telemetry_get(ai_telemetry_t* telemetry);
+
+// Octave edges of the latency bins, 4 us, 8 us, ... up to the overflow bin
+#define AI_TELEMETRY_OCTAVES (AI_TELEMETRY_BINS / 4 - 1)
+
+/**
+ * @brief Cumulative decision counts at each octave edge, for histogram export
+ * @param cumulative Receives AI_TELEMETRY_OCTAVES counts: decisions under 4 us, under 8 us, ...
+ * @param sum_us Receives the total latency of every decision
+ * @return Every decision, the overflow bin included
+ */
+uint32_t ai_telemetry_get_octaves(uint32_t* cumulative, uint64_t* sum_us);
+
+#endif // AI_TELEMETRY_H
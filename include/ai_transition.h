@@ -0,0 +1,47 @@
+#ifndef AI_TRANSITION_H
+#define AI_TRANSITION_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+
+/**
+ * @brief Transition filter statistics
+ */
+typedef struct {
+    ai_state_t committed;           // State currently in force
+    float      confidence;          // Evidence for the committed state
+    uint32_t   entered_ms;          // When the committed state was entered
+    uint32_t   proposals;           // States proposed by the inference stage
+    uint32_t   transitions;         // Transitions committed
+    uint32_t   suppressed;          // Proposals of another state held back
+} ai_transition_stats_t;
+
+/**
+ * @brief Start the filter in a committed state
+ */
+void ai_transition_init(ai_state_t initial, uint32_t now_ms);
+
+/**
+ * @brief Feed one proposal from the inference stage
+ *
+ * Each proposal moves the evidence of every state towards the proposal,
+ * weighted by its confidence. A different state is committed once its
+ * evidence exceeds AI_TRANSITION_ENTER, the current state's evidence has
+ * fallen below AI_TRANSITION_EXIT and the current state's minimum dwell
+ * time has passed. ERROR and UPDATING are committed at once.
+ * @param proposed State suggested by the model or the rule engine
+ * @param confidence Weight of the proposal in [0, 1]
+ * @param now_ms Current time
+ * @param committed Receives the committed state when it changes
+ * @return true if a transition was committed
+ */
+bool ai_transition_update(ai_state_t proposed, float confidence, uint32_t now_ms,
+                          ai_state_t* committed);
+
+/**
+ * @brief Copy the filter statistics
+ */
+void ai_transition_get_stats(ai_transition_stats_t* stats);
+
+#endif // AI_TRANSITION_H
@@ -0,0 +1,62 @@
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// capture_frame_t.phy
+#define AIRTIME_PHY_MODE_MASK  0x03     // rx_ctrl.sig_mode: 0 legacy, 1 HT, 3 VHT
+#define AIRTIME_PHY_HT         0x01
+#define AIRTIME_PHY_40MHZ      0x04     // rx_ctrl.cwb
+#define AIRTIME_PHY_SHORT_GI   0x08     // rx_ctrl.sgi
+
+/**
+ * @brief How busy the air is, as rolling averages over capture windows
+ *
+ * Shares are in permille of the time the radio listened on a channel;
+ * a channel not listened on in a window keeps its average.
+ */
+typedef struct {
+    uint16_t permille;                              // All channels, weighted by listening time
+    uint16_t busiest_permille;                      // Highest channel average
+    uint8_t  busiest_channel;                       // Its channel, 0 before any was measured
+    uint8_t  reserved;
+    uint16_t channel_permille[WIFI_CHANNEL_COUNT + 1];  // Index = channel
+    uint32_t windows;                               // Windows rolled since init
+} airtime_stats_t;
+
+/**
+ * @brief Time one frame held the air
+ * @param rate rx_ctrl.rate for a legacy frame, rx_ctrl.mcs otherwise
+ * @param phy AIRTIME_PHY_* bits
+ * @param length Frame length on air, FCS included
+ * @return Microseconds from the start of the preamble to the end of the frame
+ */
+uint32_t airtime_frame_us(uint8_t rate, uint8_t phy, uint16_t length);
+
+/**
+ * @brief Forget every average and start listening on a channel
+ */
+void airtime_init(uint8_t channel, uint32_t now_ms);
+
+/**
+ * @brief The radio was retuned; listening time goes to the new channel from now
+ */
+void airtime_note_channel(uint8_t channel, uint32_t now_ms);
+
+/**
+ * @brief Add a received frame's airtime to its channel's window (capture task)
+ */
+void airtime_observe(uint8_t channel, uint32_t airtime_us);
+
+/**
+ * @brief Close the window: fold each channel's share into its average
+ */
+void airtime_roll(uint32_t now_ms);
+
+/**
+ * @brief Copy the averages
+ */
+void airtime_get_stats(airtime_stats_t* stats);
+
+#endif // AIRTIME_H
@@ -0,0 +1,126 @@
+#ifndef ALLOC_TRACE_H
+#define ALLOC_TRACE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "loop_timing.h"
+
+/**
+ * @brief Bodies whose allocations are attributed; loop_id_t order, then the BLE callback
+ */
+typedef enum {
+    ALLOC_CYCLE_UI = 0,             // One frame
+    ALLOC_CYCLE_AI,                 // One decision
+    ALLOC_CYCLE_SCAN,               // One sweep
+    ALLOC_CYCLE_SYSTEM,
+    ALLOC_CYCLE_CAPTURE,            // One drain
+    ALLOC_CYCLE_BLE_ADVERT,         // One advertisement in Bluedroid's callback
+    ALLOC_CYCLE_COUNT
+} alloc_cycle_t;
+
+static_assert(ALLOC_CYCLE_BLE_ADVERT == (alloc_cycle_t)LOOP_COUNT,
+              "alloc cycles must start with the loops in loop_id_t order");
+
+/**
+ * @brief Allocations made inside one kind of body since boot or the last reset
+ */
+typedef struct {
+    const char* name;
+    uint32_t cycles;
+    uint32_t clean_cycles;          // Bodies that allocated nothing
+    uint32_t allocs;
+    uint64_t bytes;
+    uint32_t last_allocs;           // In the last finished body
+    uint32_t last_bytes;
+    uint32_t max_allocs;            // Most in one body
+    uint32_t regressions;           // Allocated again after ALLOC_TRACE_CLEAN_STREAK clean bodies
+} alloc_cycle_stats_t;
+
+/**
+ * @brief One call site: the innermost ALLOC_TRACE_DEPTH return addresses above the allocator
+ */
+typedef struct {
+    uint32_t pcs[ALLOC_TRACE_DEPTH];    // Decode with addr2line against the firmware ELF
+    uint8_t  cycle;                     // alloc_cycle_t it allocated in
+    uint32_t allocs;
+    uint64_t bytes;
+    uint32_t frees;                     // Of those, freed since (by any task)
+    uint64_t lifetime_us;               // Summed over the frees
+    uint32_t max_lifetime_us;
+} alloc_site_stats_t;
+
+/**
+ * @brief Heap requests that failed, counted whether or not tracing is built in
+ */
+typedef struct {
+    uint32_t    failures;
+    uint32_t    last_size;
+    uint32_t    last_caps;              // MALLOC_CAP_* asked for
+    const char* last_function;          // heap_caps function that failed
+    uint32_t    largest_failed;
+} alloc_failure_stats_t;
+
+#if ALLOC_TRACE_ENABLED
+#define ALLOC_TRACE_BEGIN(cycle) alloc_trace_begin(cycle)
+#define ALLOC_TRACE_END(cycle)   alloc_trace_end(cycle)
+#else
+#define ALLOC_TRACE_BEGIN(cycle) ((void)0)
+#define ALLOC_TRACE_END(cycle)   ((void)0)
+#endif
+
+/**
+ * @brief Register the failed-allocation callback; call once at boot
+ */
+void alloc_trace_init(void);
+
+/**
+ * @brief Attribute the calling task's allocations to a body until alloc_trace_end()
+ */
+void alloc_trace_begin(alloc_cycle_t cycle);
+
+/**
+ * @brief Close a body opened by the same task and fold its counts in
+ */
+void alloc_trace_end(alloc_cycle_t cycle);
+
+/**
+ * @brief Copy one body's figures
+ */
+void alloc_trace_get_cycle(alloc_cycle_t cycle, alloc_cycle_stats_t* stats);
+
+/**
+ * @brief Copy one call site, in the order they were first seen
+ * @return false past the last site
+ */
+bool alloc_trace_get_site(uint16_t index, alloc_site_stats_t* stats);
+
+/**
+ * @brief Allocations that found no free site or live slot, counted in their body only
+ */
+uint32_t alloc_trace_dropped(void);
+
+/**
+ * @brief Copy the failed-allocation counts
+ */
+void alloc_trace_get_failures(alloc_failure_stats_t* stats);
+
+/**
+ * @brief Clear bodies and sites, e.g. once boot has settled
+ */
+void alloc_trace_reset(void);
+
+/**
+ * @brief Write one line of the report: bodies, then sites, then drops and failures
+ *
+ * Lines are written one at a time, so the report of a hundred sites
+ * needs no buffer of its size.
+ * @return Characters written (without NUL), 0 past the last line
+ */
+size_t alloc_trace_write_line(uint16_t line, char* out, size_t capacity);
+
+/**
+ * @brief Write the same text to the serial port as "ALLOC" lines
+ */
+void alloc_trace_dump_serial(void);
+
+#endif // ALLOC_TRACE_H
@@ -0,0 +1,66 @@
+#ifndef AMBIENT_H
+#define AMBIENT_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief How much light the room has, from the filtered lux
+ */
+typedef enum {
+    AMBIENT_UNKNOWN = 0,            // No light sensor, or its reading went stale
+    AMBIENT_DARK,                   // Below AMBIENT_DARK_LUX: the night profile
+    AMBIENT_DIM,
+    AMBIENT_BRIGHT,                 // Above AMBIENT_BRIGHT_LUX
+    AMBIENT_LEVELS
+} ambient_level_t;
+
+/**
+ * @brief Filtered light and what it is doing to the display
+ */
+typedef struct {
+    float           lux;            // EWMA of the readings
+    uint16_t        raw_lux;        // Last reading
+    uint16_t        applied_lux;    // Filtered lux the level and backlight follow
+    ambient_level_t level;
+    uint8_t         backlight_pct;  // Scale on the backlight target
+    uint16_t        frame_interval_ms;  // Shortest UI frame gap, 0 for no cap
+    uint32_t        updates;        // Filtered lux moved far enough to be applied
+    uint32_t        level_changes;
+} ambient_status_t;
+
+/**
+ * @brief Fold the light sensor's latest reading in and adapt to it
+ *
+ * Call once per monitoring cycle from the system task, after
+ * i2c_sensors_tick(). A change smaller than AMBIENT_CHANGE_PCT of the
+ * applied lux leaves the level and the backlight alone.
+ */
+void ambient_sample(uint32_t now_ms);
+
+/**
+ * @brief Light level in force; safe from any task
+ */
+ambient_level_t ambient_level(void);
+
+/**
+ * @brief Scale on the backlight target, 100 without a light sensor
+ */
+uint8_t ambient_backlight_pct(void);
+
+/**
+ * @brief Shortest gap between UI frames; longer at night, 0 otherwise
+ */
+uint32_t ambient_frame_interval_ms(void);
+
+/**
+ * @brief Copy the filtered light and its effects
+ */
+void ambient_get_status(ambient_status_t* status);
+
+/**
+ * @brief Short name for logs ("unknown", "dark", "dim", "bright")
+ */
+const char* ambient_level_name(ambient_level_t level);
+
+#endif // AMBIENT_H
@@ -0,0 +1,65 @@
+#ifndef AP_ANOMALY_H
+#define AP_ANOMALY_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "wifi_scan.h"
+
+/**
+ * @brief Rogue access point patterns
+ */
+typedef enum {
+    AP_ANOMALY_TWIN = 0,            // A known SSID on a new BSSID from another vendor
+    AP_ANOMALY_SECURITY,            // A known SSID advertised with other security
+    AP_ANOMALY_CHANNEL,             // A known BSSID on another channel
+    AP_ANOMALY_BEACON,              // Beacon interval changed, or the TSF ran backwards
+    AP_ANOMALY_DEAUTH,              // Deauthentication burst
+    AP_ANOMALY_COUNT
+} ap_anomaly_t;
+
+/**
+ * @brief Detections since boot
+ */
+typedef struct {
+    uint32_t detected[AP_ANOMALY_COUNT];    // Per pattern
+    uint32_t raised;                        // Queued to the AI task
+    uint32_t dropped;                       // Not queued: repeated within AP_ANOMALY_REPEAT_MS, or queue full
+    uint16_t ssids;                         // SSIDs with a recorded profile
+} ap_anomaly_stats_t;
+
+/**
+ * @brief Forget every SSID and beacon profile
+ */
+void ap_anomaly_init(void);
+
+/**
+ * @brief Check one scan record against its SSID and its device table entry
+ *
+ * Call before the record is folded into the device table, which tells a
+ * new BSSID and the channel a known one had. O(1): the SSID profile is
+ * indexed by the SSID's arena slot.
+ */
+void ap_anomaly_check_record(const wifi_record_t* record, uint32_t now_ms);
+
+/**
+ * @brief Check a beacon's interval and TSF against the last from its BSSID (capture task)
+ */
+void ap_anomaly_observe_beacon(const uint8_t* bssid, uint16_t interval_tu, uint64_t tsf_us,
+                               uint8_t channel, int8_t rssi, uint32_t now_ms);
+
+/**
+ * @brief Count a deauthentication or disassociation frame (capture task)
+ */
+void ap_anomaly_observe_deauth(const uint8_t* bssid, uint8_t channel, int8_t rssi, uint32_t now_ms);
+
+/**
+ * @brief Copy the detection counts
+ */
+void ap_anomaly_get_stats(ap_anomaly_stats_t* stats);
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* ap_anomaly_name(ap_anomaly_t anomaly);
+
+#endif // AP_ANOMALY_H
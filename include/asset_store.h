@@ -0,0 +1,109 @@
+#ifndef ASSET_STORE_H
+#define ASSET_STORE_H
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+
+#define ASSET_MAGIC        0x54534148   // "HAST"
+#define ASSET_FORMAT       1
+#define ASSET_NAME_BYTES   24
+#define ASSET_ALIGN        16           // Data offsets: TFLite wants its flatbuffer 16-byte aligned
+
+/**
+ * @brief How an asset's bytes are laid out
+ */
+typedef enum {
+    ASSET_TYPE_BLOB = 0,
+    ASSET_TYPE_TFLITE,              // A flatbuffer, usable in place by tflite::GetModel()
+    ASSET_TYPE_IMAGE,               // lv_img_header_t, then the pixel data (LVGL's binary image format)
+    ASSET_TYPE_WEB                  // A gzip-compressed HTTP body, served as it is
+} asset_type_t;
+
+/**
+ * @brief Content type of an ASSET_TYPE_WEB asset, from its file extension
+ */
+typedef enum {
+    ASSET_MIME_OTHER = 0,           // application/octet-stream
+    ASSET_MIME_HTML,
+    ASSET_MIME_CSS,
+    ASSET_MIME_JS,
+    ASSET_MIME_JSON,
+    ASSET_MIME_SVG,
+    ASSET_MIME_PNG,
+    ASSET_MIME_ICO,
+    ASSET_MIME_COUNT
+} asset_mime_t;
+
+/**
+ * @brief Start of the asset partition, followed by the table of contents
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t count;                 // Entries in the table
+    uint32_t toc_crc32;             // CRC-32 of the entries
+    uint32_t reserved;
+} asset_header_t;
+
+/**
+ * @brief One table of contents entry (little-endian, fixed layout)
+ */
+typedef struct {
+    char     name[ASSET_NAME_BYTES];    // NUL-padded
+    uint32_t offset;                // From the start of the partition, ASSET_ALIGN aligned
+    uint32_t length;
+    uint32_t crc32;                 // Of the asset's bytes
+    uint16_t type;                  // asset_type_t
+    uint16_t subtype;               // asset_mime_t for ASSET_TYPE_WEB, otherwise 0
+} asset_entry_t;
+
+static_assert(sizeof(asset_header_t) == 16, "asset header layout changed");
+static_assert(sizeof(asset_entry_t) == 40, "asset entry layout changed");
+
+/**
+ * @brief An asset in the address space; data stays valid until reboot
+ */
+typedef struct {
+    const uint8_t* data;            // In the flash cache, read-only
+    uint32_t       length;
+    uint32_t       crc32;           // Of the bytes as stored, e.g. compressed
+    asset_type_t   type;
+    uint16_t       subtype;
+} asset_t;
+
+/**
+ * @brief Assets mapped since boot
+ */
+typedef struct {
+    bool     mapped;
+    uint16_t count;
+    uint32_t mapped_bytes;
+    uint32_t lookups;
+    uint32_t crc_failures;          // Assets refused on first use
+} asset_store_stats_t;
+
+/**
+ * @brief Read the table of contents and map the partition's assets
+ * @return false if there is no asset partition or its table is invalid
+ */
+bool asset_store_init(void);
+
+/**
+ * @brief Find an asset by name; its CRC is checked on the first lookup
+ * @return false if it is missing or corrupt
+ */
+bool asset_store_find(const char* name, asset_t* asset);
+
+/**
+ * @brief Point an LVGL image descriptor at an image asset, no copy
+ * @return false if the asset is missing, corrupt or not an image
+ */
+bool asset_store_image(const char* name, lv_img_dsc_t* image);
+
+/**
+ * @brief Copy the store statistics
+ */
+void asset_store_get_stats(asset_store_stats_t* stats);
+
+#endif // ASSET_STORE_H
@@ -0,0 +1,74 @@
+#ifndef BACKLIGHT_H
+#define BACKLIGHT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+
+#define BACKLIGHT_SCHEDULE_HOURS 24
+
+/**
+ * @brief What the backlight is doing and why
+ */
+typedef struct {
+    uint8_t  level_pct;             // Target brightness, 0-100
+    uint8_t  state_pct;             // From the AI state curve
+    uint8_t  schedule_pct;          // Hourly cap in force (100 without a wall clock)
+    uint8_t  ambient_pct;           // Room light scale (100 without a light sensor)
+    bool     interaction;           // Held at full brightness by a recent interaction
+    uint32_t fades;                 // Hardware fades started
+} backlight_status_t;
+
+/**
+ * @brief Attach BOARD.display.bl to an LEDC channel and light the panel at full brightness
+ *
+ * Also restores this unit's hourly schedule from NVS.
+ * @return false if the LEDC timer or channel cannot be configured
+ */
+bool backlight_init(void);
+
+/**
+ * @brief Follow the brightness curve of a newly committed AI state
+ */
+void backlight_set_state(ai_state_t state);
+
+/**
+ * @brief Full brightness for the room for TUNABLE_BACKLIGHT_INTERACTION_MS, e.g. on a touch
+ */
+void backlight_interaction(uint32_t now_ms);
+
+/**
+ * @brief Fade towards the current target; call from the UI task
+ *
+ * Brightening fades are fast and dimming ones slow. A new fade only starts
+ * once the previous one has finished, so the call never blocks.
+ * @return ms until the target can next change (UINT32_MAX for no deadline)
+ */
+uint32_t backlight_update(uint32_t now_ms);
+
+/**
+ * @brief Switch the PWM output off for panel standby, or back on
+ *
+ * Leaving standby starts from dark and fades up to the current target on
+ * the next backlight_update().
+ * @return false while a fade is still running (entering only)
+ */
+bool backlight_standby(bool standby, uint32_t now_ms);
+
+/**
+ * @brief Copy the hourly brightness caps, in percent, indexed by local hour
+ */
+void backlight_get_schedule(uint8_t schedule[BACKLIGHT_SCHEDULE_HOURS]);
+
+/**
+ * @brief Replace the hourly caps and persist them in NVS
+ * @return false if a value is above 100 or NVS cannot be written
+ */
+bool backlight_set_schedule(const uint8_t schedule[BACKLIGHT_SCHEDULE_HOURS]);
+
+/**
+ * @brief Current target and its inputs
+ */
+void backlight_get_status(backlight_status_t* status);
+
+#endif // BACKLIGHT_H
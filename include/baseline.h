@@ -0,0 +1,86 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "config.h"
+#include "ai_states.h"
+
+#define BASELINE_HOURS 168              // Hour-of-week buckets, Sunday 00:00 first
+
+/**
+ * @brief What each hour-of-week bucket summarises, per cycle
+ */
+typedef enum {
+    BASELINE_WIFI = 0,              // Networks in view
+    BASELINE_BLE,                   // BLE devices in view
+    BASELINE_CHURN,                 // Devices that appeared or were lost
+    BASELINE_PHONES,                // Class mix: recent phones...
+    BASELINE_TRACKERS,              // ... trackers
+    BASELINE_BEACONS,               // ... and beacons
+    BASELINE_METRICS
+} baseline_metric_t;
+
+/**
+ * @brief Baseline engine status
+ */
+typedef struct {
+    bool     clock_valid;           // Wall clock set; without it nothing is learned
+    uint8_t  hour_of_week;          // Bucket of the last cycle, 0 = Sunday 00:00 local
+    bool     ready;                 // That bucket has earlier weeks to compare with
+    uint8_t  coverage_pct;          // Hours of the week with a baseline
+    uint8_t  worst_metric;          // baseline_metric_t furthest from its baseline
+    float    deviation;             // Its z-score, 0 without a baseline
+    float    mean[BASELINE_METRICS];    // The bucket's baseline for the last cycle
+    float    sd[BASELINE_METRICS];
+    uint32_t scored;                // Cycles scored against a baseline
+    uint32_t unusual;               // ... at BASELINE_UNUSUAL_Z or more
+    uint32_t saves;                 // Successful flash writes
+} baseline_status_t;
+
+/*
+ * Day-over-day baselines: for each hour of the week, a decayed mean and
+ * variance of each metric, merged from the visits of earlier weeks. A
+ * cycle is scored against its bucket before joining the visit in
+ * progress, so the hour being measured never dilutes its own baseline.
+ * Scoring and learning are a handful of arithmetic operations per metric,
+ * independent of how much history there is. Scan task, except for the
+ * getters and baseline_save(), which the system task calls.
+ */
+
+/**
+ * @brief Allocate the buckets (PSRAM preferred) and restore them from flash
+ * @return true if the engine is usable
+ */
+bool baseline_init(void);
+
+/**
+ * @brief Score a cycle against its hour-of-week and learn from it
+ * @param now Wall clock; before AI_FEATURE_MIN_EPOCH the cycle is ignored
+ * @return Largest deviation in tenths of a standard deviation, capped at
+ *         255, for sensor_data_t::unusual_z10; 0 without a baseline
+ */
+uint8_t baseline_observe(const sensor_data_t* data, time_t now);
+
+/**
+ * @brief Hours of the week with a baseline, 0-100
+ */
+uint8_t baseline_coverage_pct(void);
+
+/**
+ * @brief Write the buckets to flash
+ * @return true on success
+ */
+bool baseline_save(void);
+
+/**
+ * @brief Copy the engine status
+ */
+void baseline_get_status(baseline_status_t* status);
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* baseline_metric_name(baseline_metric_t metric);
+
+#endif // BASELINE_H
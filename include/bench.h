@@ -0,0 +1,29 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define BENCH_REPORT_VERSION 1      // Bump when a case changes what it measures
+
+/**
+ * @brief Run every microbenchmark and print the report on the console
+ *
+ * Called once from setup() in the env:bench firmware, with every task
+ * created. The scan, capture, AI and system tasks are suspended for the
+ * run, so the cases compete only with the UI task, which is itself only
+ * asked to work during the display suite; they are resumed afterwards.
+ * The report is one line per case, each a JSON object after "BENCH ",
+ * between "BENCH_BEGIN" and "BENCH_END" lines (see tools/bench).
+ */
+void bench_run(void);
+
+/**
+ * @brief Time full redraws of every scene in the ring; UI task only
+ *
+ * Run by the UI task on UI_EVENT_BENCH. Each scene is shown and redrawn
+ * whole BENCH_SCENE_FRAMES times, then the home scene is shown again.
+ */
+void bench_ui_scenes(void);
+
+#endif // BENCH_H
@@ -0,0 +1,58 @@
+#ifndef BLE_ADV_PARSER_H
+#define BLE_ADV_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Maximum 16-bit service UUIDs kept per advertisement
+#define BLE_ADV_MAX_UUID16 4
+
+/**
+ * @brief Coarse device class derived from advertisement fingerprints
+ */
+typedef enum {
+    BLE_CLASS_UNKNOWN = 0,
+    BLE_CLASS_PHONE,
+    BLE_CLASS_TRACKER,
+    BLE_CLASS_WEARABLE,
+    BLE_CLASS_BEACON,
+    BLE_CLASS_COUNT
+} ble_device_class_t;
+
+/**
+ * @brief Fields extracted from one advertisement (no pointers into the payload)
+ */
+typedef struct {
+    uint16_t company_id;                    // Manufacturer data company (0xFFFF if absent)
+    uint8_t  mfg_type;                      // First manufacturer data byte after the company
+    uint8_t  mfg_subtype;                   // Second manufacturer data byte
+    uint16_t appearance;                    // GAP appearance (0 if absent)
+    int8_t   tx_power;                      // TX power level in dBm
+    bool     has_tx_power;
+    uint8_t  flags;                         // AD flags (0 if absent)
+    uint8_t  uuid16_count;                  // Valid entries in uuid16[]
+    uint16_t uuid16[BLE_ADV_MAX_UUID16];    // 16-bit service UUIDs and service data UUIDs
+    uint32_t name_hash;                     // FNV-1a of the local name (0 if none)
+} ble_adv_info_t;
+
+/**
+ * @brief Walk the AD structures of a raw advertisement payload in place
+ * @param data Advertisement data followed by scan response data
+ * @param len Total payload length
+ * @param info Receives the extracted fields
+ */
+void ble_adv_parse(const uint8_t* data, uint8_t len, ble_adv_info_t* info);
+
+/**
+ * @brief Map extracted fields to a device class
+ * @param info Parsed advertisement
+ * @return Device class, BLE_CLASS_UNKNOWN if nothing matched
+ */
+ble_device_class_t ble_adv_classify(const ble_adv_info_t* info);
+
+/**
+ * @brief Short name of a device class
+ */
+const char* ble_class_to_string(ble_device_class_t device_class);
+
+#endif // BLE_ADV_PARSER_H
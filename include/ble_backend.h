@@ -0,0 +1,78 @@
+#ifndef BLE_BACKEND_H
+#define BLE_BACKEND_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Scan parameters are given in 0.625 ms units
+#define BLE_MS_TO_UNITS(ms) ((uint16_t)((ms) * 8 / 5))
+
+// Kind of advertising report, for ble_scan_fold()
+#define BLE_ADV_KIND_LEGACY    0x00
+#define BLE_ADV_KIND_EXTENDED  0x01     // Extended advertising PDU
+#define BLE_ADV_KIND_CODED     0x02     // Received on the coded (long range) PHY
+
+/**
+ * @brief What the observer scan is asked to do
+ */
+typedef struct {
+    uint16_t interval_units;
+    uint16_t window_units;
+    bool     passive;               // No scan requests
+    bool     whitelist_only;        // Report only the addresses of ble_backend_set_whitelist()
+} ble_backend_params_t;
+
+/*
+ * The radio glue under ble_scan.cpp: exactly one of ble_backend_bluedroid.cpp
+ * and ble_backend_nimble.cpp is built, as BLE_SCAN_BACKEND selects. The
+ * backend hands every advertising report to ble_scan_fold() from its host
+ * task and knows nothing of the record table.
+ */
+
+/**
+ * @brief Give classic BT's memory back to the heap and ready the controller
+ *        for BLE alone; before anything else touches the controller
+ */
+bool ble_backend_prepare(void);
+
+/**
+ * @brief Bring up the host stack and take its GAP events
+ */
+bool ble_backend_init(void);
+
+/**
+ * @brief Start the observer scan, or restart it with new parameters
+ * @return true if the stack accepted them
+ */
+bool ble_backend_start(const ble_backend_params_t* params);
+
+/**
+ * @brief Stop the observer scan until the next start
+ */
+bool ble_backend_stop(void);
+
+/**
+ * @brief Replace the controller's whitelist; with the scan stopped
+ * @param addrs Addresses, most significant byte first
+ * @param addr_types 0 public, 1 random, 2-3 resolvable, one per address
+ * @param count Addresses, 0 to empty the list
+ * @return true if the controller took every address
+ */
+bool ble_backend_set_whitelist(const uint8_t (*addrs)[6], const uint8_t* addr_types, uint8_t count);
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* ble_backend_name(void);
+
+/**
+ * @brief Fold one advertising report into its device record (ble_scan.cpp)
+ * @param addr Advertiser address, most significant byte first
+ * @param addr_type 0 public, 1 random, 2-3 resolvable
+ * @param data AD structures; only the first 255 bytes are parsed
+ * @param kind BLE_ADV_KIND_* bits
+ */
+void ble_scan_fold(const uint8_t addr[6], uint8_t addr_type, int8_t rssi,
+                   const uint8_t* data, uint8_t len, uint8_t kind);
+
+#endif // BLE_BACKEND_H
@@ -0,0 +1,56 @@
+#ifndef BLE_DUTY_H
+#define BLE_DUTY_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief What the optimizer is doing
+ */
+typedef enum {
+    BLE_DUTY_SETTLED = 0,           // Holding the chosen settings until the next evaluation
+    BLE_DUTY_REFERENCE,             // Listening at full duty to see what is there
+    BLE_DUTY_TRIAL,                 // Trying a cheaper candidate against the reference
+    BLE_DUTY_PHASE_COUNT
+} ble_duty_phase_t;
+
+/**
+ * @brief Settings in force and the last evaluation's figures
+ */
+typedef struct {
+    uint8_t  phase;                 // ble_duty_phase_t
+    uint8_t  window_pct;            // Scan window over interval in force
+    bool     passive;               // Scan type in force
+    uint8_t  coverage_pct;          // Share of the reference's devices the chosen settings heard
+    uint16_t reference_devices;     // Devices heard at full duty
+    uint16_t devices;               // Devices heard in the last finished trial
+    uint16_t reference_adv_per_s;   // Advertisements per second at full duty
+    uint16_t adv_per_s;             // Advertisements per second in the last finished trial
+    uint32_t evaluations;           // Evaluations finished since boot
+    uint32_t trials;                // Trials finished, reference included
+    uint32_t restarts;              // Trials started over after the scan was paused
+} ble_duty_stats_t;
+
+/**
+ * @brief Start from the configured window, active unless passive only
+ */
+void ble_duty_init(void);
+
+/**
+ * @brief Finish a trial once BLE_DUTY_TRIAL_MS has passed and start the next
+ *
+ * Call about once a second from one task; the system task's loop does.
+ */
+void ble_duty_tick(uint32_t now_ms);
+
+/**
+ * @brief Copy the settings in force and the last evaluation's figures
+ */
+void ble_duty_get_stats(ble_duty_stats_t* stats);
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* ble_duty_phase_name(ble_duty_phase_t phase);
+
+#endif // BLE_DUTY_H
@@ -0,0 +1,162 @@
+#ifndef BLE_SCAN_H
+#define BLE_SCAN_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ble_adv_parser.h"
+
+/**
+ * @brief Compact per-device record folded from advertisements
+ */
+typedef struct {
+    uint8_t  addr[6];               // Advertiser address
+    uint8_t  addr_type;             // 0 public, 1 random, 2-3 resolvable
+    uint8_t  adv_flags;             // AD type 0x01 flags (0 if absent)
+    int16_t  rssi_ewma_x16;         // RSSI EWMA in 1/16 dBm
+    int8_t   rssi_last;             // Most recent RSSI in dBm
+    uint8_t  device_class;          // ble_device_class_t from fingerprints
+    uint32_t name_hash;             // FNV-1a of the local name (0 if none)
+    uint32_t first_seen_ms;         // millis() of first advertisement
+    uint32_t last_seen_ms;          // millis() of latest advertisement
+    uint32_t last_seen_us;          // Radio clock of latest advertisement
+    uint32_t adv_count;             // Advertisements folded into this record
+} ble_record_t;
+
+/**
+ * @brief What a scan cycle needs of one recently heard device
+ *
+ * Written once, straight from the record table into the caller's slots;
+ * half a ble_record_t, with the RSSI already in dBm.
+ */
+typedef struct {
+    uint8_t  addr[6];
+    int8_t   rssi;                  // RSSI EWMA in dBm
+    uint8_t  fresh;                 // Advertised since the cycle's since_ms
+    uint32_t last_seen_ms;
+    uint32_t last_seen_us;          // Radio clock of latest advertisement
+} ble_sighting_t;
+
+/**
+ * @brief Aggregate view of the devices heard recently
+ */
+typedef struct {
+    uint16_t device_count;          // Devices seen within BLE_RECORD_TTL_MS
+    int16_t  avg_rssi;              // Mean of the per-device RSSI EWMAs
+    uint32_t adv_total;             // Advertisements received since boot
+    uint32_t adv_extended;          // Of those, extended advertising PDUs (NimBLE backend)
+    uint32_t adv_coded;             // Of those, received on the coded PHY (NimBLE backend)
+    uint32_t dropped_total;         // Advertisements dropped (table full)
+    uint16_t class_counts[BLE_CLASS_COUNT];  // Recent devices per class
+} ble_scan_summary_t;
+
+/**
+ * @brief Release classic BT's memory and ready the controller for BLE only
+ *
+ * Call once at boot, before ble_scan_init(); classic BT is never used, and
+ * its controller memory cannot be had back once the controller is up.
+ * @return true if the controller can be used
+ */
+bool ble_scan_prepare(void);
+
+/**
+ * @brief Bring up the BLE stack and start a continuous observer scan
+ * @return true on success, false on failure
+ */
+bool ble_scan_init(void);
+
+/**
+ * @brief Listen only, sending no scan requests; call before ble_scan_init()
+ *
+ * For survey mode, where scan responses are not worth the radio time.
+ */
+void ble_scan_set_passive(void);
+
+/**
+ * @brief Whether scan requests were ruled out by ble_scan_set_passive()
+ */
+bool ble_scan_passive_only(void);
+
+/**
+ * @brief Listen for a share of each BLE_SCAN_INTERVAL, actively or not
+ *
+ * Restarts a running scan with the new window and type; a paused one takes
+ * them up when it resumes. Passive is forced after ble_scan_set_passive().
+ * Call from one task only; the BLE duty optimizer's is the system task.
+ * @param window_pct Scan window as a percentage of the interval, 1-100
+ * @return true if the stack accepted the change
+ */
+bool ble_scan_set_duty(uint8_t window_pct, bool passive);
+
+/**
+ * @brief Devices heard since a point in time
+ * @param since_ms millis() to count from
+ * @param adverts_total Receives the advertisements received since boot, if not NULL
+ * @return Records with an advertisement at or after since_ms
+ */
+uint16_t ble_scan_heard_since(uint32_t since_ms, uint32_t* adverts_total);
+
+/**
+ * @brief Times the scan has been paused since boot, so a measurement can
+ *        tell it lost the radio part way through
+ */
+uint32_t ble_scan_pauses(void);
+
+/**
+ * @brief Restart a scan that stopped reporting; supervisor recovery hook
+ * @return true if the restart was accepted by the stack
+ */
+bool ble_scan_restart(void);
+
+/**
+ * @brief Stop the observer scan to give WiFi the radio, or resume it
+ *
+ * Records age out as usual while paused. Safe on any task; does nothing
+ * before ble_scan_init().
+ * @return true if the stack accepted the change
+ */
+bool ble_scan_pause(bool paused);
+
+/**
+ * @brief Hear only the given addresses, or everyone again with count 0
+ *
+ * The controller drops every other advertisement before the host sees it.
+ * Counts as a pause for whoever compares what the scan heard. Scan task
+ * only; a paused scan resumes with the list.
+ * @param addrs Addresses, most significant byte first
+ * @param addr_types Their record's addr_type, one per address
+ * @return true if the controller took the list and the scan restarted
+ */
+bool ble_scan_set_whitelist(const uint8_t (*addrs)[6], const uint8_t* addr_types, uint8_t count);
+
+/**
+ * @brief Latest of one device's record, its last RSSI rather than the average
+ * @param addr_type Receives the record's address type, if not NULL
+ * @return false if no record holds the address
+ */
+bool ble_scan_lookup(const uint8_t addr[6], ble_sighting_t* out, uint8_t* addr_type);
+
+/**
+ * @brief Summarize devices heard within BLE_RECORD_TTL_MS
+ * @param summary Receives the aggregate
+ */
+void ble_scan_get_summary(ble_scan_summary_t* summary);
+
+/**
+ * @brief Write recently heard devices into the caller's slots
+ *
+ * Those heard within BLE_RECORD_TTL_MS, and any heard since since_ms
+ * however long the cycle was.
+ * @param out Destination array
+ * @param capacity Destination capacity
+ * @param since_ms Devices advertising at or after this are marked fresh
+ * @return Number of sightings written
+ */
+uint16_t ble_scan_take_sightings(ble_sighting_t* out, uint16_t capacity, uint32_t since_ms);
+
+/**
+ * @brief Release records not heard within BLE_RECORD_TTL_MS
+ * @return Number of records released
+ */
+uint16_t ble_scan_expire(void);
+
+#endif // BLE_SCAN_H
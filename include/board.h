@@ -0,0 +1,132 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+
+// Board profiles, one chosen per build with -DBOARD_PROFILE=... in platformio.ini
+#define BOARD_PROFILE_CYD         0   // Classic ESP32 CYD: SPI ST7789, XPT2046 touch, SD slot
+#define BOARD_PROFILE_S3_DEVKITC  1   // ESP32-S3-DevKitC-1 with an SPI ST7789 module, touch and SD
+#define BOARD_PROFILE_S3_I80      2   // ESP32-S3 with an 8-bit i80 (8080) ST7789, T-Display-S3 wiring
+
+#ifndef BOARD_PROFILE
+#define BOARD_PROFILE          BOARD_PROFILE_S3_DEVKITC
+#endif
+
+// How the panel is driven: TFT_eSPI on SPI, or esp_lcd on the S3's LCD peripheral
+#define DISPLAY_BUS_SPI        0
+#define DISPLAY_BUS_I80        1
+
+/**
+ * @brief How one board is wired; -1 for a pin that is not connected
+ *
+ * A profile is a constexpr object, so every pin folds into the code that
+ * uses it exactly as a #define would, but with a type and in one place.
+ * On an SPI profile, TFT_eSPI's setup (the env's build flags) must match
+ * display.cs, dc, rst, mosi, clk and bus_hz; panel_spi.cpp checks it.
+ */
+struct board_profile_t {
+    const char* name;
+    struct {
+        uint16_t width, height;     // Native, portrait orientation
+        uint8_t x_gap, y_gap;       // Visible area's offset in panel RAM, portrait (i80)
+        bool invert;                // IPS panel, colours inverted (i80; TFT_eSPI's setup on SPI)
+        uint32_t bus_hz;            // Write clock, the fastest the wiring takes
+        int8_t cs, dc, rst;
+        int8_t bl;                  // Backlight, LEDC PWM
+        int8_t power;               // Panel supply enable
+        int8_t mosi, clk;           // SPI, the display alone
+        int8_t wr, rd;              // i80 strobes
+        uint8_t bus_width;          // i80 data lines, 8 or 16; 0 on SPI
+        int8_t data[16];            // i80 D0-D15, the first bus_width used
+    } display;
+    struct {
+        int8_t cs, irq;             // Pen-down interrupt, falling edge
+        int8_t clk, mosi, miso;     // Shared with the SD card
+    } touch;
+    struct {
+        int8_t cs;
+        int8_t clk, mosi, miso;     // Shared with touch
+        int8_t detect;              // Card-detect switch
+        uint8_t detect_level;       // Pin level with a card in the slot
+    } sd;
+    struct {
+        int8_t sda, scl;
+        int8_t motion_irq;          // Accelerometer INT1, active low; an RTC GPIO to wake deep sleep
+    } i2c;
+    int8_t status_led;
+    int8_t battery_adc;             // Cell voltage through a divider (WAKE_BATTERY_DIVIDER)
+    struct {
+        int8_t rx, tx;              // NMEA receiver's TX into rx; tx optional (WARDRIVE_ENABLED)
+    } gps;
+    struct {
+        int8_t rx, tx;              // Radio modules' UART (RADIO_LINK_ENABLED)
+    } radio_link;
+};
+
+#define BOARD_NO_DATA_PINS { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 }
+
+#if BOARD_PROFILE == BOARD_PROFILE_CYD
+// Display pins are HSPI's IOMUX pins, but TFT_eSPI drives VSPI (the global
+// SPI object) through the GPIO matrix, which caps writes at 40 MHz
+#define BOARD_DISPLAY_BUS      DISPLAY_BUS_SPI
+constexpr board_profile_t BOARD = {
+    "cyd",
+    { 240, 320, 0, 0, false, 40000000, 15, 2, -1, 21, -1, 13, 14, -1, -1, 0, BOARD_NO_DATA_PINS },
+    { 33, 36, 25, 32, 39 },
+    { 5, 18, 23, 19, -1, 0 },
+    { 27, 22, -1 },                 // CN1 header; 21 is the backlight
+    -1,                             // Only the RGB LED on 4/16/17, not driven
+    -1,                             // USB powered
+    { 35, -1 },                     // P3 header; input only, so receive only
+    { -1, -1 }                      // No free pair left
+};
+#elif BOARD_PROFILE == BOARD_PROFILE_S3_DEVKITC
+// The display sits on FSPI's IOMUX pins, so SPI runs at 80 MHz without the
+// GPIO matrix; flushes go out by SPI DMA
+#define BOARD_DISPLAY_BUS      DISPLAY_BUS_SPI
+constexpr board_profile_t BOARD = {
+    "s3-devkitc",
+    { 240, 320, 0, 0, false, 80000000, 10, 9, 14, 21, -1, 11, 12, -1, -1, 0, BOARD_NO_DATA_PINS },
+    { 15, 16, 4, 5, 6 },
+    { 7, 4, 5, 6, -1, 0 },
+    { 1, 2, 18 },
+    17,
+    -1,
+    { 40, 41 },
+    { 38, 39 }
+};
+#elif BOARD_PROFILE == BOARD_PROFILE_S3_I80
+// 16 bits a pixel over 8 data lines at 20 MHz: 10 Mpx/s, twice an 80 MHz
+// SPI panel, and the LCD peripheral streams each band by GDMA. No touch
+// controller on this wiring; the SD card goes on the header pins
+#define BOARD_DISPLAY_BUS      DISPLAY_BUS_I80
+constexpr board_profile_t BOARD = {
+    "s3-i80",
+    { 170, 320, 35, 0, true, 20000000, 6, 7, 5, 38, 15, -1, -1, 8, 9,
+      8, { 39, 40, 41, 42, 45, 46, 47, 48, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { -1, -1, -1, -1, -1 },
+    { 10, 12, 11, 13, -1, 0 },
+    { 1, 2, -1 },
+    -1,
+    4,                              // Half the cell voltage, the board's own divider
+    { 44, 43 },                     // UART0's pins; the console is on USB CDC
+    { 18, 17 }
+};
+#else
+#error "Unknown BOARD_PROFILE"
+#endif
+
+#if BOARD_DISPLAY_BUS == DISPLAY_BUS_SPI
+static_assert(BOARD.display.mosi >= 0 && BOARD.display.clk >= 0, "an SPI display needs its SPI pins");
+#else
+static_assert(BOARD.display.bus_width == 8 || BOARD.display.bus_width == 16,
+              "an i80 display has 8 or 16 data lines");
+static_assert(BOARD.display.wr >= 0 && BOARD.display.dc >= 0 &&
+              BOARD.display.data[BOARD.display.bus_width - 1] >= 0,
+              "an i80 display needs its strobe, DC and data pins");
+#endif
+static_assert(BOARD.display.bl >= 0, "the display needs its backlight pin");
+static_assert(BOARD.sd.cs >= 0 && BOARD.sd.clk >= 0 && BOARD.sd.mosi >= 0 && BOARD.sd.miso >= 0,
+              "the SD card needs its SPI pins");
+
+#endif // BOARD_H
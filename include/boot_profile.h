@@ -0,0 +1,57 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Boot stages, some of which run side by side on other tasks
+ *
+ * The three tiers span the finer stages run within them.
+ */
+typedef enum {
+    BOOT_STAGE_TIER_FACE = 0,       // Tier 0: console through the AI task, face on the panel
+    BOOT_STAGE_TIER_RADIOS,         // Tier 1: I2C, WiFi, Bluetooth and LittleFS, then the scan task
+    BOOT_STAGE_TIER_SERVICES,       // Tier 2: SD, logs, history, web and OTA, then the system task
+    BOOT_STAGE_CONSOLE,             // Serial and the log writer
+    BOOT_STAGE_HARDWARE,            // LED, clocks, SPI hosts
+    BOOT_STAGE_DISPLAY,             // Panel, touch and LVGL, on the UI task
+    BOOT_STAGE_FIRST_FRAME,         // First scene built until its first refresh is flushed
+    BOOT_STAGE_BLUETOOTH,           // Controller start, on a job worker
+    BOOT_STAGE_FLASH_FS,            // LittleFS mount, migrating or formatting the partition
+    BOOT_STAGE_SD,                  // Card mount and trace file, on a job worker
+    BOOT_STAGE_MODELS,              // Journal replay, asset mapping and model slots
+    BOOT_STAGE_TASKS,               // Waiting for the radio and the card, creating the tasks behind them
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+/**
+ * @brief When one stage ran, in microseconds since the timer started at boot
+ */
+typedef struct {
+    const char* name;
+    uint32_t    begin_us;           // 0 if the stage has not started
+    uint32_t    end_us;             // 0 while the stage runs
+} boot_stage_stats_t;
+
+/**
+ * @brief Mark the start of a stage; later calls for the same stage are ignored
+ */
+void boot_profile_begin(boot_stage_t stage);
+
+/**
+ * @brief Mark the end of a stage; later calls for the same stage are ignored
+ */
+void boot_profile_end(boot_stage_t stage);
+
+/**
+ * @brief Copy one stage's timestamps
+ */
+void boot_profile_get(boot_stage_t stage, boot_stage_stats_t* stats);
+
+/**
+ * @brief Log every stage once; later calls do nothing
+ */
+void boot_profile_report(void);
+
+#endif // BOOT_PROFILE_H
@@ -0,0 +1,64 @@
+#ifndef CAPTURE_BURST_H
+#define CAPTURE_BURST_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief What started a burst
+ */
+typedef enum {
+    CAPTURE_BURST_ANOMALY = 0,      // A rogue access point pattern
+    CAPTURE_BURST_EXCITED,          // The AI committed to EXCITED
+    CAPTURE_BURST_REASON_COUNT
+} capture_burst_reason_t;
+
+/**
+ * @brief The burst in force and the bursts since boot
+ */
+typedef struct {
+    bool     active;
+    uint8_t  channel;               // Channel held, 0 with no burst
+    uint8_t  reason;                // capture_burst_reason_t of the burst in force or the last
+    uint8_t  reserved;
+    uint32_t remaining_ms;
+    uint32_t bursts[CAPTURE_BURST_REASON_COUNT];
+    uint32_t extended;              // Triggers that lengthened the burst in force
+    uint32_t suppressed;            // Triggers in a cooldown or for another channel
+    uint32_t burst_ms;              // Time spent in bursts
+} capture_burst_stats_t;
+
+/**
+ * @brief Hold the capture on one channel for CAPTURE_BURST_MS; safe on any task
+ *
+ * A trigger for the channel already held extends the burst, up to
+ * CAPTURE_BURST_MAX_MS from its start. One for another channel, or one
+ * within CAPTURE_BURST_COOLDOWN_MS of the last burst's end, is only
+ * counted, so a storm of detections cannot take the schedule over.
+ * @param channel 1-13, or 0 for the busiest channel the hopper has scored
+ * @return true if a burst was started or extended
+ */
+bool capture_burst_trigger(capture_burst_reason_t reason, uint8_t channel, uint32_t now_ms);
+
+/**
+ * @brief Channel of the burst in force
+ * @return 0 with no burst
+ */
+uint8_t capture_burst_channel(uint32_t now_ms);
+
+/**
+ * @brief Whether a burst is in force
+ */
+bool capture_burst_active(uint32_t now_ms);
+
+/**
+ * @brief Copy the burst figures
+ */
+void capture_burst_get_stats(capture_burst_stats_t* stats);
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* capture_burst_reason_name(capture_burst_reason_t reason);
+
+#endif // CAPTURE_BURST_H
@@ -0,0 +1,57 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Appends CBOR items (RFC 8949) to a caller's buffer
+ *
+ * Only what the compact encodings need: integers, booleans, text and
+ * definite-length maps and arrays. A write that does not fit sets
+ * overflowed and leaves the buffer as it was before that item.
+ */
+typedef struct {
+    uint8_t* out;
+    size_t   capacity;
+    size_t   length;
+    bool     overflowed;
+} cbor_writer_t;
+
+/**
+ * @brief Walks CBOR items in a buffer, one at a time
+ */
+typedef struct {
+    const uint8_t* in;
+    size_t         length;
+    size_t         offset;
+    bool           failed;          // Malformed or unsupported item, or read past the end
+} cbor_reader_t;
+
+void cbor_writer_init(cbor_writer_t* writer, uint8_t* out, size_t capacity);
+void cbor_put_int(cbor_writer_t* writer, int64_t value);
+void cbor_put_bool(cbor_writer_t* writer, bool value);
+void cbor_put_text(cbor_writer_t* writer, const char* text);
+void cbor_put_map(cbor_writer_t* writer, uint32_t pairs);
+void cbor_put_array(cbor_writer_t* writer, uint32_t items);
+
+void cbor_reader_init(cbor_reader_t* reader, const uint8_t* in, size_t length);
+
+/**
+ * @brief Read a definite-length map header
+ * @return false, with failed set, if the next item is not one
+ */
+bool cbor_get_map(cbor_reader_t* reader, uint32_t* pairs);
+
+/**
+ * @brief Read an integer or a boolean (as 0 or 1)
+ * @return false, with failed set, if the next item is neither
+ */
+bool cbor_get_int(cbor_reader_t* reader, int64_t* value);
+
+/**
+ * @brief Step over the next item, whatever it is, nested ones included
+ * @return false, with failed set, if it is malformed or indefinite-length
+ */
+bool cbor_skip(cbor_reader_t* reader);
+
+#endif // CBOR_H
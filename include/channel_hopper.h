@@ -0,0 +1,41 @@
+#ifndef CHANNEL_HOPPER_H
+#define CHANNEL_HOPPER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Channel hopper statistics
+ */
+typedef struct {
+    uint8_t  current_channel;                       // Channel being listened on
+    uint8_t  busiest_channel;                       // Channel with the highest score
+    uint16_t busiest_channel_fps;                   // Score of that channel
+    uint32_t hops_total;                            // Completed hops since init
+    uint32_t hops_deferred;                         // Hops postponed by an active scan
+    uint16_t dwell_ms[WIFI_CHANNEL_COUNT + 1];      // Current dwell per channel
+    uint16_t score_fps[WIFI_CHANNEL_COUNT + 1];     // Frame-rate EWMA per channel
+} hopper_stats_t;
+
+/**
+ * @brief Reset channel scores and tune to channel 1
+ */
+void hopper_init(void);
+
+/**
+ * @brief Hop once the dwell on the current channel has elapsed
+ *
+ * Must run in the capture consumer task, since it reads the consumer-side
+ * per-channel frame counters.
+ * @param now_ms Current time
+ * @return true if the radio was retuned
+ */
+bool hopper_tick(uint32_t now_ms);
+
+/**
+ * @brief Copy the current hopper statistics
+ * @param stats Receives the snapshot
+ */
+void hopper_get_stats(hopper_stats_t* stats);
+
+#endif // CHANNEL_HOPPER_H
@@ -0,0 +1,54 @@
+#ifndef CLIENT_ESTIMATOR_H
+#define CLIENT_ESTIMATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Sequence value for frames the station did not transmit
+ */
+#define CLIENT_SEQ_UNKNOWN 0xFFFF
+
+/**
+ * @brief Client estimate over the last CLIENT_WINDOW_MS
+ */
+typedef struct {
+    uint16_t clients;               // Estimated unique devices
+    uint16_t randomized;            // Of those, using randomized MACs
+    uint16_t macs_merged;           // MAC rotations folded into existing devices
+    uint16_t table_used;            // Occupied table entries
+} client_estimate_t;
+
+/**
+ * @brief Clear the client table
+ */
+void client_estimator_reset(void);
+
+/**
+ * @brief Fingerprint the information elements of a probe request body
+ *
+ * Hashes element IDs and lengths plus the content of capability elements.
+ * SSID and channel elements are skipped since they change between probes.
+ * @param ies First byte after the 24-byte management header
+ * @param len Bytes available (may be truncated mid-element)
+ * @return Non-zero fingerprint
+ */
+uint32_t client_estimator_ie_hash(const uint8_t* ies, uint8_t len);
+
+/**
+ * @brief Record a frame transmitted by a station
+ * @param mac Station address
+ * @param seq 12-bit sequence number, or CLIENT_SEQ_UNKNOWN
+ * @param ie_hash Probe request fingerprint (0 for non-probe frames)
+ * @param now_ms Receive time
+ */
+void client_estimator_observe(const uint8_t* mac, uint16_t seq, uint32_t ie_hash, uint32_t now_ms);
+
+/**
+ * @brief Count devices heard within CLIENT_WINDOW_MS and expire old entries
+ * @param now_ms Current time
+ * @param estimate Receives the counts
+ */
+void client_estimator_estimate(uint32_t now_ms, client_estimate_t* estimate);
+
+#endif // CLIENT_ESTIMATOR_H
@@ -2,75 +2,992 @@
 #define CONFIG_H
 
 #include <Arduino.h>
+#include "board.h"                    // Pins of the board profile being built (BOARD)
 
-// Hardware Configuration - CYD ST7789 Display
-#define TFT_WIDTH  320
-#define TFT_HEIGHT 240
-#define TFT_CS     15
-#define TFT_DC     2
-#define TFT_RST    -1
-#define TFT_BL     21
-#define TFT_MOSI   13
-#define TFT_CLK    14
-
-// Touch pins (if available)
-#define TOUCH_CS   33
-#define TOUCH_IRQ  36
-
-// Status LED
-#define STATUS_LED_PIN 22
-
-// I2C pins for sensors
-#define I2C_SDA 21
-#define I2C_SCL 22
-
-// SD Card pins
-#define SD_CS   5
-#define SD_MOSI 23
-#define SD_MISO 19
-#define SD_CLK  18
+// Hardware Configuration - ST7789 Display (size and bus in the board profile)
+#define DISPLAY_ROTATION 1      // TFT_eSPI rotation at boot (1: landscape, the touch calibration's frame)
+#define DISPLAY_FLUSH_DMA true  // Queue flushes to SPI or i80 DMA while LVGL renders the next band
+#define DISPLAY_BAND_MAX_ROWS 40      // Draw buffer height in internal DMA RAM (x2 buffers)
+#define DISPLAY_BAND_MIN_ROWS 10      // Below this, fall back to PSRAM
+#define DISPLAY_BAND_FALLBACK_ROWS (BOARD.display.width / 10)
+#define DISPLAY_HEAP_RESERVE  (96 * 1024)  // Internal heap left free by the draw buffers
+#define DISPLAY_FULL_FRAME    false   // Boot in full-frame diff mode (2 framebuffers in PSRAM)
+#define DISPLAY_STANDBY_DELAY_MS 10000 // SLEEPING this long puts the panel in standby
+#define RENDERER_TICK_MS      5       // LVGL clock resolution without LV_TICK_CUSTOM
+#define RENDERER_MAX_SCENES   6       // Distinct scenes the renderer can switch between
+#define RENDERER_SCENE_RESERVE (12 * 1024) // LVGL memory a screen build starts with, idle screens evicted for it
+#define RENDERER_LABEL_CHARS  32      // Text held by a cached label
+#define RENDERER_FRAME_BUDGET_MS 25   // Render + flush time one frame may take
+#define RENDERER_MAX_SKIP     3       // Frames dropped after an overrun, at most
+#define RENDERER_ACTIVE_FRAME_MS 16   // LVGL refresh period while animating, touched or scrolling (60 fps)
+#define RENDERER_ACTIVE_MAX_FRAME_MS 33 // ...lengthened up to this while refreshes take longer (30 fps)
+#define RENDERER_STATIC_FRAME_MS 500  // ...and for static content (2 Hz)
+#define RENDERER_FRAME_HEADROOM_PCT 125 // Active period over the averaged refresh time
+#define LVGL_POOL_PSRAM       false   // LVGL's heap (size: LV_MEM_SIZE in platformio.ini) in PSRAM
+#define LVGL_POOL_SAMPLE_MS   1000    // LVGL heap usage refresh for the metrics
+#define IMAGE_CACHE_BYTES     (1024 * 1024) // PSRAM held by images from the card, LRU evicted past it
+#define IMAGE_CACHE_ENTRIES   16      // Images cached at once
+#define IMAGE_CACHE_BINDINGS  16      // lv_img objects showing or waiting for one
+#define IMAGE_CACHE_PATH_BYTES 48     // Longest path + 1, within a job payload
+#define IMAGE_CACHE_RECHECK_MS 30000  // A shown image's mtime is checked again after this
+#define IMAGE_CACHE_CHUNK_BYTES 8192  // Read per SPI bus hold
+#define RENDERER_PROFILE_OVERLAY false // Draw refresh timings over every scene
+#define RENDERER_PROFILE_OVERLAY_MS 1000 // Overlay refresh period
+#ifndef RENDER_SPLIT_ENABLED
+#define RENDER_SPLIT_ENABLED  false   // Large LVGL blends drawn half by a helper on the other core
+#endif
+#define RENDER_SPLIT_CORE     0       // The helper's core, the one the UI task is not on
+#define RENDER_SPLIT_MIN_PX   4096    // Smaller blends are not worth the handoff
+#define RENDER_SPLIT_CORE_MAX_PCT 60  // Helper core busier than this over the last CPU sample: no split
+#define RENDER_SPLIT_PRIORITY 1       // Level with the scan task, which it never preempts
+#define RENDER_SPLIT_STACK_SIZE 1536
+
+// Backlight - LEDC PWM on BOARD.display.bl, brightness follows the AI state
+#define BACKLIGHT_LEDC_CHANNEL 0
+#define BACKLIGHT_LEDC_TIMER  0
+#define BACKLIGHT_PWM_HZ      5000
+#define BACKLIGHT_PWM_BITS    12      // Fine steps at the dim end of the square law
+#define BACKLIGHT_FADE_UP_MS  150     // Brightening, e.g. on a touch
+#define BACKLIGHT_FADE_DOWN_MS 1500   // Dimming
+#define BACKLIGHT_INTERACTION_MS 30000 // Full brightness after an interaction (default, tunable)
+#define BACKLIGHT_PCT_ALERT   100     // EXCITED, ERROR
+#define BACKLIGHT_PCT_ACTIVE  80      // SNIFFING, TRACKING, UPDATING
+#define BACKLIGHT_PCT_CALM    50      // IDLE, LEARNING
+#define BACKLIGHT_PCT_SLEEPING 5
+#define BACKLIGHT_MIN_PCT     2       // Floor after the hourly schedule is applied
+#define BACKLIGHT_NVS_NAMESPACE "backlight"
+#define BACKLIGHT_PATH        "/backlight" // Hourly schedule, on the model update server
+
+// Touch (if the board has it) - XPT2046, shares HSPI with the SD card
+#define TOUCH_SPI_HZ          2000000
+#define TOUCH_SAMPLES         5       // Conversions per axis, median taken
+#define TOUCH_Z_THRESHOLD     400     // Pressure that counts as a touch
+#define TOUCH_RAW_X_MIN       200     // Raw readings at the panel edges
+#define TOUCH_RAW_X_MAX       3700
+#define TOUCH_RAW_Y_MIN       240
+#define TOUCH_RAW_Y_MAX       3800
+#define TOUCH_READ_PERIOD_MS  20      // LVGL input polling, only while the pen is down
+#define GESTURE_TAP_SLOP_PX   10      // Travel still counted as a tap or long press
+#define GESTURE_LONG_PRESS_MS 600
+#define GESTURE_SWIPE_PX      40      // Travel along the dominant axis that makes a swipe
+#define GESTURE_SWIPE_MAX_MS  600     // A slower travel is a drag, left to LVGL's scrolling
+
+// SD Card
+#define SD_SPI_HZ 20000000
+#define SD_PROBE_INTERVAL_MS 5000   // CMD13/CMD0 presence probe without BOARD.sd.detect
+#define SD_PROBE_MISSES      2      // Consecutive disagreeing checks before an event
+#define SD_PROBE_WAIT_MS     20     // Skip a probe rather than wait longer for the bus
+#define SD_BENCH_ENABLED     true   // Sweep clocks and write sizes once per new card
+#define SD_BENCH_CLOCKS      { 10000000, 20000000, 26666666, 40000000 } // Ascending; 80 MHz divided down
+#define SD_BENCH_BLOCKS      { 512, 4096, 16384 } // Write sizes, multiples of the 512-byte sector
+#define SD_BENCH_BYTES       (64UL * 1024) // Written and read back per clock and write size
+#define SD_BENCH_BLOCK_MARGIN_PCT 10 // Smallest write within this much of the fastest is used
+#define SD_BENCH_FILE        "/sdbench.tmp"
+#define SD_BENCH_NVS_NAMESPACE "sd_bench"
+#define SD_BENCH_PATH        "/sdbench"  // Result, and a block size re-run on POST, model update server
+
+// SPI buses - an SPI display has the global SPI object's host to itself
+// (FSPI on the S3, VSPI on the ESP32); the SD card and touch share HSPI,
+// with the host's pins routed to whichever device holds it
+#define SPI_BUS_PERIPH_HOST   HSPI
+#define SPI_BUS_SD_CHUNK_BYTES 1024   // Card data per bus hold, touch reads get in between
+#define SPI_BUS_TOUCH_WAIT_MS 5       // Longest a touch read queues behind the card
+
+// Storage: LittleFS on the data partition, the SD card, and which files go where
+#define STORAGE_PARTITION_LABEL "spiffs"      // Kept so OTA units with the old table still find it
+#define STORAGE_MAX_OPEN_FILES  10
+#define STORAGE_MIGRATE_MAX_FILES 32          // SPIFFS files carried over to LittleFS, once
+#define STORAGE_MIGRATE_MAX_BYTES (4UL * 1024 * 1024) // Held in PSRAM while the partition is reformatted
+#define STORAGE_FLASH_LOG_MAX_BYTES (256UL * 1024) // A log on flash while no card is in rotates here
+#define STORAGE_SD_MODEL_PATH   "/models/ai_model.tflite" // Model fallback when flash has none
+
+// Per-cycle sensor traces on the SD card (replayed by tools/replay)
+#define TRACE_LOG_ENABLED      true
+#define TRACE_LOG_DIR          "/logs"
+#define TRACE_FLUSH_RECORDS    16             // Records batched per card write
+#define TRACE_MAX_FILE_BYTES   (16UL * 1024 * 1024)
+
+// Binary scan log: CRC-framed records appended to one file on the card
+#define SCAN_LOG_ENABLED       true
+#define SCAN_LOG_FILE          TRACE_LOG_DIR "/scan.hsl"
+#define SCAN_LOG_OLD_FILE      TRACE_LOG_DIR "/scan_old.hsl"
+#define SCAN_LOG_STAGING_BYTES 8192           // PSRAM staging ring, a multiple of the 512-byte sector
+#define SCAN_LOG_FLUSH_MS      30000          // Whole staged sectors written at most this often
+#define SCAN_LOG_MAX_BYTES     (4UL * 1024 * 1024)
+#define SIGHTING_LOG_ENABLED   true           // Per-device appeared/changed/present/gone records
+#define SIGHTING_LOG_RSSI_BAND 4              // dB either side of the last raw record counted as unchanged
+#define SIGHTING_LOG_HEARTBEAT_CYCLES 120     // Cycles a steady device is counted before a presence record
+#define SIGHTING_LOG_CYCLE_RECORDS 32         // Records staged per scan cycle at most; the rest wait
+
+// Binary event trace ring (converted by tools/trace)
+#define EVENT_TRACE_ENABLED    true
+#define EVENT_TRACE_RECORDS    512            // 16 bytes each, a power of two
+#define EVENT_TRACE_TASKS_MAX  32             // FreeRTOS tasks the export can name
+#define EVENT_TRACE_SD_FILE    TRACE_LOG_DIR "/events.hev"
+#define EVENT_TRACE_SERIAL_KEY 't'            // Typed on the console: dump the ring as hex lines
+
+// Cycle-count profiling of hot paths (PROFILE_SCOPE, see profile.h)
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED        false          // Scopes compile to nothing; env:profile sets it
+#endif
+#define PROFILE_CALIBRATION_PASSES 64         // Empty scopes timed at boot, the least taken as overhead
+#define PROFILE_TEXT_BYTES     1024           // Registry as a text table
+#define PROFILE_SERIAL_KEY     'p'            // Typed on the console: dump the registry
+
+// Heap allocations inside the task loops (see alloc_trace.h)
+#ifndef ALLOC_TRACE_ENABLED
+#define ALLOC_TRACE_ENABLED    false          // Needs the --wrap link flags of env:alloc
+#endif
+#define ALLOC_TRACE_DEPTH      4              // Return addresses naming a call site
+#define ALLOC_TRACE_SITES      128            // Call sites kept, a power of two
+#define ALLOC_TRACE_LIVE_BITS  9              // 512 traced allocations awaiting their free
+#define ALLOC_TRACE_CLEAN_STREAK 100          // Clean bodies after which an allocation is a regression
+#define ALLOC_TRACE_LINE_BYTES 160            // One report line
+#define ALLOC_TRACE_SERIAL_KEY 'a'            // Typed on the console: dump the report
+
+// Deferred-format logging: callers queue raw args, a writer task formats
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL      4              // 0 none .. 5 verbose: lines above it are not compiled in (env:release sets 2)
+#endif
+#define LOG_DEFAULT_LEVEL      LOG_LEVEL_INFO // Per module, changed at run time over HTTP
+#define LOG_RING_SLOTS         64             // 80 bytes each, a power of two
+#define LOG_ARG_BYTES          64             // Raw arguments per line, strings included
+#define LOG_LINE_BYTES         192            // Longest formatted line
+#define LOG_WRITER_STACK_SIZE  3072
+#define LOG_WRITER_PRIORITY    1
+#define LOG_DRAIN_INTERVAL_MS  20
+#define LOG_TAIL_BYTES         4096           // Newest output kept for HTTP
+#define LOG_SD_ENABLED         true
+#define LOG_SD_FILE            TRACE_LOG_DIR "/console.log"
+#define LOG_SD_OLD_FILE        TRACE_LOG_DIR "/console.old"
+#define LOG_SD_BATCH_BYTES     1024           // Output gathered per card write
+#define LOG_SD_FLUSH_MS        5000
+#define LOG_SD_MAX_BYTES       (1024UL * 1024)
+
+// Metrics history in PSRAM: 1 s for 10 min, 1 min for 24 h, 15 min for 30 days
+#define HISTORY_ENABLED        true
+#define HISTORY_SECONDS_POINTS 600
+#define HISTORY_MINUTES_POINTS 1440
+#define HISTORY_QUARTERS_POINTS 2880
+#define HISTORY_FLUSH_INTERVAL_MS (15UL * 60 * 1000) // Closed minute and quarter points to TRACE_LOG_DIR
+#define HISTORY_MAX_FILE_BYTES (16UL * 1024 * 1024)
+
+// Log manager: numbering, compaction, retention and the time index of TRACE_LOG_DIR
+#define LOG_MANAGER_ENABLED    true
+#define LOG_MANAGER_INTERVAL_MS 60000         // One housekeeping pass on a job worker this often
+#define LOG_MANAGER_MAX_SEGMENTS 64           // Numbered files one pass considers
+#define LOG_SEGMENT_MAX_MS     (6UL * 60 * 60 * 1000) // Traces and history start a new file at this age too
+#define LOG_RAW_SEGMENTS_KEPT  4              // Newest traces left raw, older ones rolled up per minute
+#define LOG_COMPACT_BATCH      8              // Trace records read, and rollups written, per card access
+#define LOG_MIN_FREE_PCT       10             // Oldest segments deleted while the card has less free
+#define LOG_INDEX_FILE         TRACE_LOG_DIR "/index.hix"
+#define LOG_INDEX_TEMP_FILE    TRACE_LOG_DIR "/index.tmp"
+#define LOG_INDEX_STRIDE_MS    60000          // Time one index entry covers at most
+#define LOG_INDEX_PENDING      32             // Entries queued between passes
+#define LOG_NVS_NAMESPACE      "logs"         // Boot counter
+
+// Sighting archive: per-device rows in columnar segments in TRACE_LOG_DIR
+#define ARCHIVE_ENABLED        true
+#define ARCHIVE_SEGMENT_ROWS   4096           // Rows per segment, a power of two; two batches staged in PSRAM
+#define ARCHIVE_SEGMENT_MAX_MS (15UL * 60 * 1000) // A batch is written at this age even if not full
+#define ARCHIVE_WRITE_CHUNK    4096           // Bytes per card write, the bus held for each
+#define ARCHIVE_QUERY_MAX_SEGMENTS 256        // Segments one query considers
 
 // System Configuration
 #define SYSTEM_TASK_STACK_SIZE 4096
 #define UI_TASK_STACK_SIZE     8192
 #define AI_TASK_STACK_SIZE     6144
 #define SCAN_TASK_STACK_SIZE   4096
+#define CAPTURE_TASK_STACK_SIZE 3072
+#define SYSTEM_TASK_STACK_IN_PSRAM false  // Needs CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY; the task must never write flash
+#define TASK_STACK_BUDGET_BYTES (40 * 1024)   // Internal RAM for all static task stacks, checked at compile time
+
+// Boot
+#define BOOT_CONSOLE_WAIT_MS   1000   // Longest wait for a USB CDC host to open the console, after power-on only; a UART never waits
 
 // Task Priorities
 #define SYSTEM_TASK_PRIORITY   1
 #define SCAN_TASK_PRIORITY     1
+#define CAPTURE_TASK_PRIORITY  2
 #define UI_TASK_PRIORITY       2
 #define AI_TASK_PRIORITY       3
 
+// Task Core Affinity; WiFi and BT run on core 0
+#define TASK_CORE_UNPINNED     -1     // Either core, whichever the scheduler finds free
+#define UI_TASK_CORE           1
+#define AI_TASK_CORE           TASK_CORE_UNPINNED   // 0 to measure it beside the radios
+#define SCAN_TASK_CORE         0
+#define SYSTEM_TASK_CORE       0
+#define CAPTURE_TASK_CORE      0
+
+// Background Job Pool
+#define JOB_WORKERS            2      // Unpinned worker tasks
+#define JOB_WORKER_STACK_SIZE  4096
+#define JOB_WORKER_PRIORITY    1      // Never ahead of the periodic tasks
+#define JOB_POOL_SIZE          16     // Preallocated job descriptors, all lanes together
+#define JOB_LANE_DEPTH         8      // Queued jobs per priority lane
+#define JOB_PAYLOAD_BYTES      64     // Copied into each descriptor at submit
+
 // Timing Configuration (in milliseconds)
-#define UI_UPDATE_INTERVAL     30
+#define UI_UPDATE_INTERVAL     16     // Shortest gap between frames (frame rate cap)
+#define UI_REFRESH_STATUS_MS   0      // Per-field status bar refresh (0 = every frame)
+#define UI_REFRESH_UPTIME_MS   1000
+#define UI_REFRESH_MEMORY_MS   5000
+#define UI_REFRESH_AI_MS       1000
+#define UI_REFRESH_NETWORK_MS  0      // Redrawn when a scan cycle notifies the UI
+#define UI_IDLE_INTERVAL_MS    1000   // Longest UI sleep, a safety net for missed wakeups
+#define UI_BLINK_MS            80     // Eyelids closing (and again reopening)
+#define UI_BLINK_MIN_MS        2000   // Random gap between blinks
+#define UI_BLINK_MAX_MS        5000
+#define UI_MORPH_MS            120    // Eyes close, expression swaps, eyes reopen
+#define UI_BREATH_MS           1500   // Face rising (and again settling)
+#define UI_BREATH_GAP_MS       2500   // Rest between breaths in calm states
+#define UI_BREATH_PX           2
+#define FACE_LAYER_ENABLED     true   // Shown expression expanded to native colour in PSRAM (240 KB)
+#define UI_REFRESH_HEALTH_MS   1000   // System health screen
+#define UI_REFRESH_STATES_MS   5000   // AI state statistics screen
+#define UI_LIST_ROW_HEIGHT     18     // Device list rows, px
+#define UI_LIST_POOL_ROWS      18     // Labels recycled by a list: visible rows + 2 on a 320 px tall screen
+#define UI_LIST_ROW_CHARS      48
+#define UI_SPARK_POINTS        60     // Scan cycles in the median RSSI sparkline
+#define UI_SPARK_MIN_DBM       -100
+#define UI_SPARK_MAX_DBM       -20
+#define UI_CHART_PEAK_STEP     4      // Bar chart y axis grows and shrinks in these steps
+#define UI_LAYOUT_PAD          8      // Screen edge to content, px
+#define UI_LAYOUT_GAP          4      // Between stacked layout blocks, px
+#define UI_THEME_DEFAULT       0      // ui_theme_t: 0 classic, 1 night
+#define UI_THEME_NIGHT_IN_DARK 1      // Night colours while the ambient light is dark
+#define LIVE_FEED_ENABLED      true   // Event ticker screen: new devices, rogue APs, state changes
+#define LIVE_FEED_ENTRIES      12     // Lines kept, and rows on the ticker screen
+#define LIVE_FEED_TEXT_BYTES   48     // Per line, uptime prefix included
 #define AI_UPDATE_INTERVAL     200
+#define AI_EVENT_TIMEOUT_MS    1000   // Re-infer at least this often without events
+#define SCAN_EVENT_QUEUE_LENGTH 32
+#define DATA_BUS_SUBSCRIBERS_MAX 4   // Tasks notified per bus topic
 #define SCAN_INTERVAL          5000
 #define SYSTEM_MONITOR_INTERVAL 1000
+#define TIMER_WHEEL_TICK_MS    1000   // Housekeeping timer resolution; the system task advances the wheel
+#define TIMER_WHEEL_MAX_TIMERS 16     // Periodic and one-shot housekeeping jobs registered at once
+#define MEMORY_LOG_INTERVAL_MS 60000  // Heap and PSRAM line
+#define NETWORK_SUMMARY_INTERVAL_MS 60000 // Scan summary log and its scan log record
+#define CPU_LOAD_MAX_TASKS     6      // Tasks in the per-task CPU breakdown
+#define CPU_LOAD_STATUS_SLOTS  32     // FreeRTOS tasks a run-time stats snapshot can hold
+#define CPU_LOAD_WARN_PCT      90     // Warn when a core is this busy over an interval
+#define TASK_MONITOR_MAX_TASKS 6      // Tasks in the stack and heap report
+#define TASK_STACK_WARN_BYTES  512    // Warn when a task's stack headroom falls below this
+#define TASK_STACK_CRITICAL_BYTES 128 // Flag the system critical below this headroom
+#define SUPERVISOR_ENABLED     true
+#define SUPERVISOR_PRIORITY    4      // loop() runs the liveness checks above every task
+#define SUPERVISOR_LOOP_BUDGET_MS 2000 // A loop's own work, past the wait it announced
+#define SUPERVISOR_SCAN_BUDGET_MS 20000 // A whole scan sweep
+#define SUPERVISOR_STALL_MS    5000   // Overdue this long: backtrace to the crash log
+#define SUPERVISOR_RECOVER_MS  15000  // ...this long: restart the task's subsystem
+#define SUPERVISOR_REBOOT_MS   60000  // ...this long, or stalled again after SUPERVISOR_MAX_RECOVERIES: reboot
+#define SUPERVISOR_MAX_RECOVERIES 3
+#define SUPERVISOR_BACKTRACE_DEPTH 12 // Return addresses recorded per stall
+#define SUPERVISOR_CRASH_LOG   "/crash.log" // On flash: the SD bus may be what is stuck
+#define SUPERVISOR_CRASH_LOG_BYTES (16 * 1024) // Then moved to /crash.old and restarted
+#define CRASH_DUMP_ENABLED     true   // Core dump and event ring kept for the boot after a crash
+#define CRASH_PATH             "/crash"     // Crash summary and parts, same server
+#define CRASH_MQTT_CHUNK_BYTES 4096   // Part bytes per MQTT message on <prefix>/<MAC>/crash
+#define CRASH_BACKTRACE_DEPTH  16     // Return addresses kept from the core dump summary
+#define CRASH_NVS_NAMESPACE    "crash"      // Last uploaded core dump, without a journal
+#define LOOP_STRETCH_AFTER     3      // Missed deadlines in a row before a loop's period is stretched
+#define LOOP_STRETCH_MAX_FACTOR 4     // Stretch at most to this multiple of the nominal period
+#define LOOP_RELAX_AFTER       10     // Fitting iterations in a row before a stretch is eased
+#define PRIORITY_TUNER_ENABLED true  // Raise tasks that fall behind their period under load
+#define PRIORITY_TUNE_INTERVAL_MS 2000 // Between looks at the loops' misses, on the timer wheel
+#define PRIORITY_BOOST_MISS_PCT 20    // Share of an interval's iterations missed that counts as falling behind
+#define PRIORITY_CONTENDED_PCT 70     // Core busy share from which a miss is blamed on other tasks
+#define PRIORITY_BOOST_MAX     2      // Levels a task may be raised above its own
+#define PRIORITY_CEILING       (SUPERVISOR_PRIORITY - 1) // Never level with the supervisor
+#define PRIORITY_RELAX_AFTER   3      // Intervals without falling behind before a boost is lowered a level
+#define HEAP_SAMPLE_MS         5000   // Heap walks per capability class, at most this often
+#define HEAP_TREND_INTERVAL_MS 60000  // Between heap trend points
+#define HEAP_TREND_POINTS      60     // Trend points kept: an hour at the interval above
+#define HEAP_LARGEST_CRITICAL  (16 * 1024) // Internal largest free block below this is critical
+#define HEAP_FRAG_WARN_PCT     70     // Warn when internal fragmentation passes this
+#define MEMORY_PRESSURE_LOW_BYTES  (4 * LOW_MEMORY_THRESHOLD) // Internal free heap under this: shed what is cheap to rebuild
+#define MEMORY_PRESSURE_HIGH_BYTES (2 * LOW_MEMORY_THRESHOLD) // ...under this: shed everything that can be
+#define MEMORY_PRESSURE_COOLDOWN_MS 30000 // Before the same pressure level is answered again
+#define MEMORY_SHRINKERS_MAX   8      // Subsystems that can register to give memory back
+#define MEM_BULK_INTERNAL_RESERVE (96 * 1024) // Bulk blocks spill to internal RAM only while this stays free
+#define MEM_MALLOC_INTERNAL_MAX 4096  // Plain malloc() above this tries PSRAM first (CONFIG_SPIRAM_USE_MALLOC)
+#define MEM_ARENAS_MAX         4      // Per-cycle scratch arenas listed in the metrics
+
+// AI feature vector (multiple of 4 floats) and normalization scales
+#define AI_FEATURE_COUNT       40
+#define AI_FEATURE_NOVEL_SCALE 10
+#define AI_FEATURE_FPS_SCALE   1000
+#define AI_FEATURE_CLIENT_SCALE 100
+#define AI_FEATURE_PEOPLE_SCALE 10
+#define AI_FEATURE_PLACE_SCALE 4
+#define AI_FEATURE_TEMP_MIN_C10 -200  // Temperature feature spans -20 to 60 C
+#define AI_FEATURE_TEMP_SPAN_C10 800
+#define AI_FEATURE_LUX_SCALE   1000
+#define AI_FEATURE_MOTION_SCALE 1000  // mg
+#define AI_FEATURE_UNUSUAL_Z10 40     // Deviation from the hour's baseline that reads 1.0 (4 sigma)
+#define AI_FEATURE_ASSOC_SCALE 30     // Associations per minute that read 1.0
+#define AI_FEATURE_HANDSHAKE_SCALE 10 // Completed 4-way handshakes per minute that read 1.0
+#define AI_FEATURE_MIN_EPOCH   1609459200  // Earlier time() values mean the clock is unset
+
+// Temporal model over recent feature vectors
+#define AI_SEQUENCE_WINDOW     16     // Scan cycles of history
+#define AI_SEQUENCE_ALPHA      0.3f   // Recurrent state step towards each new vector
+
+// State transition filter (evidence in [0, 1], entry above exit for hysteresis)
+#define AI_TRANSITION_ALPHA    0.4f   // Evidence step towards each proposal
+#define AI_TRANSITION_ENTER    0.6f   // Evidence a new state needs to be committed
+#define AI_TRANSITION_EXIT     0.45f  // Evidence the current state must fall below
+#define AI_DWELL_IDLE_MS       2000   // Minimum time in a state before leaving it
+#define AI_DWELL_SNIFFING_MS   5000
+#define AI_DWELL_TRACKING_MS   5000
+#define AI_DWELL_LEARNING_MS   5000
+#define AI_DWELL_EXCITED_MS    8000
+#define AI_DWELL_SLEEPING_MS   10000
+
+// Per-site thresholds learned from this unit's own scans (running quantiles)
+#define SITE_LEARN_CYCLES      500    // Cycles before learned values replace the defaults below
+#define SITE_WIFI_HIGH_QUANTILE 0.75f // Share of cycles quieter than "high WiFi activity"
+#define SITE_BLE_STRONG_QUANTILE 0.8f // Share of BLE readings weaker than "close"
+#define SITE_WIFI_HIGH_MIN     3      // Bounds on the learned values
+#define SITE_WIFI_HIGH_MAX     40
+#define SITE_BLE_STRONG_MIN    -80
+#define SITE_BLE_STRONG_MAX    -30
+#define SITE_SAVE_INTERVAL_MS  60000  // Journal commit cadence (NVS without a journal)
+#define SITE_NVS_NAMESPACE     "site"
+
+// Hour-of-week baselines of the scan figures (PSRAM + LittleFS); needs the wall clock
+#define BASELINE_ENABLED       true
+#define BASELINE_DECAY         0.7f   // Weight an hour's history keeps each time a new week is merged
+#define BASELINE_MIN_VISITS    1      // Earlier weeks of an hour before its cycles are scored
+#define BASELINE_MIN_VISIT_CYCLES 10  // Cycles a visit needs to be merged at all
+#define BASELINE_SD_FLOOR      1.0f   // Smallest band a metric is scored against...
+#define BASELINE_SD_RELATIVE   0.1f   // ...plus this share of its mean
+#define BASELINE_UNUSUAL_Z     3.0f   // Deviation counted as unusual in the metrics
+#define BASELINE_SAVE_INTERVAL_MS 900000
+#define BASELINE_FILE          "/baseline.bin"
+
+// Warm start: the AI task's behavioural state, snapshotted to the journal and restored at boot
+#define WARM_START_ENABLED     true
+#define WARM_START_SAVE_INTERVAL_MS 60000 // Commit cadence, skipped while nothing changed
+#define WARM_START_NVS_NAMESPACE "warm"    // Without a journal partition
+
+// Time in each committed AI state and the transition matrix, kept across restarts
+#define AI_STATE_STATS_SAVE_INTERVAL_MS 300000 // Journal commit cadence (NVS without a journal)
+#define AI_STATE_STATS_NVS_NAMESPACE "ststat"
+
+// AI inference backend (model falls back to the rule engine if unusable)
+#define AI_BACKEND_RULES       0
+#define AI_BACKEND_TFLITE      1
+#define AI_INFERENCE_BACKEND   AI_BACKEND_RULES
+#define AI_MODEL_PATH          "/ai_model.tflite"
+#define AI_MODEL_MAX_BYTES     (256 * 1024)
+#define AI_ARENA_PROBE_MAX     (256 * 1024) // Ceiling for the arena size search
+#define AI_ARENA_MIN_BYTES     2048
+#define AI_ARENA_PLAN_STEP     256          // Resolution of the size search
+#define AI_ARENA_MARGIN_BYTES  512          // Added to the smallest arena that fits
+#define AI_ARENA_INTERNAL_MAX  (64 * 1024)  // Larger arenas go to PSRAM
+#define AI_ARENA_NVS_NAMESPACE "ai_arena"
+#define AI_ARENA_HEAP_RESERVE  (96 * 1024)  // Internal heap left free after the arena
+#define AI_MODEL_MIN_CONFIDENCE 0.5f
+#define AI_MODEL_MAX_OPS       16     // Op registrations held by the resolver
+#define AI_CASCADE_ENABLED     true   // A small model runs first; the one above only when it is unsure
+#define AI_FAST_MODEL_PATH     "/ai_model_fast.tflite"
+#define AI_CASCADE_MARGIN      0.3f   // Top-2 margin the small model must clear to decide alone
+#define AI_INFERENCE_BENCHMARK false  // Time the loaded model at boot
+#define AI_BENCHMARK_ROUNDS    200
+#define AI_TELEMETRY_BINS      72     // Log-spaced latency bins, 4 per octave up to ~0.5 s
+#define AI_TELEMETRY_NARROW_MARGIN 0.1f // Top-2 margin counted as a near tie
+#define LATENCY_TRACE_ENABLED  true   // Time a new device's way from the air to the face's flushed frame
+#define LATENCY_TRACE_SLOTS    8      // Traces in flight at once; the oldest is given up for a new one
+
+// Over-the-air model updates into A/B slots (see partitions.csv)
+#define MODEL_UPDATE_ENABLED   true
+#define MODEL_UPDATE_PORT      80
+#define MODEL_UPDATE_PATH      "/model"
+#define MODEL_UPDATE_REQUIRE_KEY true        // Uploads refused until HTTP_API_KEYS is set; the gate then checks it
+#define AI_METRICS_PATH        "/metrics"   // Inference telemetry, same server
+#define HISTORY_PATH           "/history"   // Metrics history, same server
+#define EVENT_TRACE_PATH       "/trace"     // Event trace export, same server
+#define PROFILE_PATH           "/profile"   // Cycle counts per site (GET), cleared by POST, same server
+#define ALLOC_TRACE_PATH       "/allocs"    // Allocations per loop and call site (GET), cleared by POST
+#define LOG_PATH               "/log"       // Log tail and per-module levels, same server
+#define HISTORY_HTTP_MAX_POINTS 120         // Points one history request returns at most
+#define HTTP_API_ENABLED       true
+#define HTTP_API_PREFIX        "/api"       // JSON API for dashboards, same server
+#define HTTP_API_BUFFERS       3            // Responses in flight; PSRAM, taken once
+#define HTTP_API_TEXT_BYTES    1536         // Largest /api/state or /api/metrics body
+#define HTTP_API_HISTORY_PAGE  64           // History points read from the rings at a time
+#define HTTP_API_CHUNK_BYTES   1024         // Streamed body staged ahead by a job, two per buffer
+#define HTTP_API_HEAVY_STREAMS 2            // Streamed responses at once; the other buffers stay for polls
+#define HTTP_API_RATE_BURST    8            // Requests a route takes back to back
+#define HTTP_API_RATE_STATE    10           // Requests per second per route, every client together
+#define HTTP_API_RATE_METRICS  5
+#define HTTP_API_RATE_DEVICES  1
+#define HTTP_API_RATE_HISTORY  2
+#define HTTP_API_RATE_OPENMETRICS 2
+#define HTTP_API_RATE_OTHER    4            // AI_METRICS_PATH, HISTORY_PATH, EVENT_TRACE_PATH
+#define HTTP_API_KEYS          ""           // "name:secret:req/min:KiB/min:streams;..." empty leaves the API open
+#define HTTP_API_KEY_HEADER    "X-Api-Key"  // Where a client presents its secret
+#define HTTP_API_KEY_SLOTS     8            // Keys the table holds
+#define HTTP_API_KEY_NAME_BYTES 12          // Longest name and secret, terminator included
+#define HTTP_API_KEY_SECRET_BYTES 33
+#define HTTP_API_KEY_BURST_S   10           // Seconds of its quota a key may spend back to back
+#define LIVE_STREAM_ENABLED    true
+#define LIVE_STREAM_PATH       HTTP_API_PREFIX "/live"  // WebSocket push, same server
+#define LIVE_STREAM_CLIENTS    4
+#define LIVE_STREAM_STACK_SIZE 3072
+#define LIVE_STREAM_PRIORITY   1
+#define LIVE_STREAM_RETRY_MS   100          // Retry for clients whose send queue was full
+#define LIVE_STREAM_METRICS_MIN_MS 1000     // Metrics frames at most this often
+#define LIVE_STREAM_MEMORY_DELTA 4096       // Free memory change worth a metrics frame
+#define WIFI_LINK_ENABLED      false        // Station association for the uplink
+#define WIFI_LINK_SSID         ""
+#define WIFI_LINK_PASSWORD     ""
+#define WIFI_LINK_SSID_BYTES   33           // Longest SSID and passphrase, terminator included
+#define WIFI_LINK_PASSWORD_BYTES 65
+#define WIFI_LINK_RETRY_MIN_MS 2000         // Rejoin backoff, doubling up to the max
+#define WIFI_LINK_RETRY_MAX_MS 60000
+#define WIFI_LINK_OFF_CHANNEL_MS 60         // Longest channel scan away from the access point
+#define WIFI_LINK_HOME_DWELL_MS 100         // Time back home between two of them
+#define WIFI_LINK_MAX_WAIT_MS  400          // A channel waited on longer is skipped this cycle
+#define WIFI_LINK_TRAFFIC_MS   150          // Radio kept home after an uplink send
+#define MQTT_ENABLED           false        // Needs WIFI_LINK_ENABLED
+#define MQTT_BROKER_URI        "mqtt://192.168.1.10:1883"
+#define MQTT_TOPIC_PREFIX      "hydraesp"   // Published on <prefix>/<station MAC>/telemetry
+#define MQTT_SAMPLE_INTERVAL_MS 5000        // Sensor data sampled this often, if it changed
+#define MQTT_BATCH_RECORDS     6            // Samples per publish
+#define MQTT_QUEUE_BATCHES     32           // Batches held in PSRAM while offline
+#define MQTT_SPOOL_PATH        "/mqtt_spool.bin" // Overflow of the PSRAM queue
+#define MQTT_SPOOL_MAX_BATCHES 4096         // About 1.6 MB; the oldest are dropped beyond it
+#define MQTT_ACK_TIMEOUT_MS    5000         // Publish repeated after this long unacknowledged
+#define MQTT_STACK_SIZE        4096
+#define MQTT_PRIORITY          1
+#define MQTT_RAW_TELEMETRY     false        // Raw sensor batches from boot; fleet "raw <minutes>" turns them on for a while
+#define MQTT_RAW_MAX_MINUTES   1440
+#define SUMMARY_ENABLED        true         // Per-minute and per-hour summaries of the scan cycles, uplinked in place of raw
+#define SUMMARY_UPLINK_MINUTES true         // Minute summaries too, not only the hours
+#define SUMMARY_TOP_K          8            // Strongest devices reported per summary...
+#define SUMMARY_SKETCH_SLOTS   64           // ...out of this many space-saving counters
+#define SUMMARY_ANOMALY_Z10    30           // Cycles this far from the hour-of-week baseline count as unusual
+#define SUMMARY_PENDING        4            // Closed summaries waiting for the uplink
+#define TIME_SYNC_TZ           "UTC0"       // POSIX TZ for local time, e.g. "CET-1CEST,M3.5.0,M10.5.0/3"
+#define TIME_SYNC_NTP_SERVER   "pool.ntp.org" // Polled while WIFI_LINK_ENABLED
+#define TIME_SYNC_NTP_SERVER_2 "time.google.com"
+#define TIME_SYNC_SNTP_INTERVAL_MS 3600000  // SNTP re-sync
+#define TIME_SYNC_MAX_STRATUM  8            // Peers further from an NTP server are ignored
+#define TIME_SYNC_PEER_REFRESH_MS 600000    // Same-stratum peer clock re-taken after this
+#define TIME_SYNC_ANCHOR_STEP_MS 50         // Peer corrections that earn a new log anchor
+#define MODEL_PARTITION_SUBTYPE 0x40
+#define MODEL_SLOT0_LABEL      "model0"
+#define MODEL_SLOT1_LABEL      "model1"
+
+// Delta firmware updates pulled into the inactive app slot (see tools/ota/make_patch.py)
+#define FIRMWARE_UPDATE_ENABLED true
+#define FIRMWARE_UPDATE_PATH   "/firmware"  // POST url= [sha256=] to start, GET for progress; same server
+#define FIRMWARE_UPDATE_URL_BYTES 192
+#define FIRMWARE_UPDATE_CHUNK_BYTES 2048    // Patch bytes read from the socket at a time
+#define FIRMWARE_UPDATE_WRITE_BYTES 4096    // Image bytes per flash write, one sector
+#define FIRMWARE_UPDATE_TIMEOUT_MS 15000    // Silence before a connection counts as dropped
+#define FIRMWARE_UPDATE_RETRIES 8           // Resumes in a row without progress before giving up
+#define FIRMWARE_UPDATE_RETRY_MS 2000       // First resume delay, doubling up to 16x
+#define FIRMWARE_UPDATE_AUTO_REBOOT true    // Run the new image once it is set to boot
+#define FIRMWARE_UPDATE_REBOOT_DELAY_MS 3000 // UPDATING shown this long first
+#define FIRMWARE_UPDATE_STACK_SIZE 6144
+#define FIRMWARE_UPDATE_PRIORITY 1
+
+// Read-only assets mapped into the address space (see tools/assets/pack_assets.py)
+#define ASSET_STORE_ENABLED    true
+#define ASSET_PARTITION_SUBTYPE 0x41
+#define ASSET_PARTITION_LABEL  "assets"
+#define ASSET_MAX_ENTRIES      32             // Table of contents entries read at boot
+#define ASSET_MODEL_NAME       "ai_model.tflite" // Used in place, ahead of the LittleFS copy
+#define ASSET_FAST_MODEL_NAME  "ai_model_fast.tflite" // Cascade's small model, likewise
+#define WEB_ASSETS_ENABLED     true           // Dashboard files from the asset partition, same server as the API
+#define WEB_ASSETS_PREFIX      "/ui"
+#define WEB_ASSETS_INDEX       "index.html"   // Served for the bare prefix
+#define WEB_ASSETS_MAX_AGE_S   604800         // Cache lifetime of everything but pages
+
+// Journaled key-value store on a raw partition, for small settings rewritten often
+#define JOURNAL_ENABLED        true
+#define JOURNAL_PARTITION_SUBTYPE 0x42
+#define JOURNAL_PARTITION_LABEL "journal"
+#define JOURNAL_MAX_SECTORS    16             // 4 KB each; one is always kept erased
+#define JOURNAL_MAX_KEYS       32             // Live keys indexed in RAM
+#define JOURNAL_KEY_BYTES      16             // Terminator included
+#define JOURNAL_VALUE_MAX      224            // A record stays within one 256-byte flash page
+
+// Run-time tunables over the defaults above (see tunables.h)
+#define TUNABLES_NVS_NAMESPACE "tunables"
+#define TUNABLES_PATH          "/tunables"    // Values and bounds (GET), one set or all reset by POST, same server
+
+// Provisioning portal: a temporary SoftAP, opened by a long press, for uplink credentials and tunables
+#define PROVISION_ENABLED      true
+#define PROVISION_PATH         "/provision"   // Form (GET) and changes (POST), only to SoftAP clients
+#define PROVISION_AP_PREFIX    "HydraESP-"    // SoftAP name, followed by the last two MAC bytes
+#define PROVISION_IDLE_MS      180000         // Portal closed this long after the last request
+#define PROVISION_NVS_NAMESPACE "prov"        // Credentials without a journal
+
+// Fleet commands over MQTT (<prefix>/<MAC>/commands) and HTTP, applied between scan cycles
+#define FLEET_ENABLED          true
+#define FLEET_PATH             "/fleet"       // Figures and latest acks (GET), one command (POST), same server
+#define FLEET_QUEUE_COMMANDS   8              // Waiting for the end of a scan cycle
+#define FLEET_ACK_BATCH        8              // Acks per message on <prefix>/<MAC>/acks, sent once this many wait...
+#define FLEET_ACK_INTERVAL_MS  30000          // ...or the oldest has waited this long
+#define FLEET_REBOOT_GRACE_MS  5000           // A reboot waits this long for its ack to go out
+#define FLEET_ID_MAX_STEP      1000           // An id this far past the highest accepted is refused, not adopted
+#define FLEET_NVS_NAMESPACE    "fleet"        // Last applied id without a journal
 
 // AI State Thresholds
 #define HIGH_WIFI_ACTIVITY_THRESHOLD  10
 #define STRONG_BLE_SIGNAL_THRESHOLD   -50
 #define LOW_MEMORY_THRESHOLD          10240
+#define AI_RULE_EXCITED_LEVEL         80     // Sustained excitement that turns SNIFFING into EXCITED
+#define AI_RULE_FOLLOWERS             1      // Devices following the unit that mean TRACKING
+#define AI_RULE_CROWD_PHONES          8      // Retail profile: phones that count as a crowd
+#define AI_RULE_LEARNING_AFTER_MS     5000   // SNIFFING this long turns into LEARNING
+#define AI_RULE_SLEEP_AFTER_MS        60000  // Quiet this long turns into SLEEPING
+
+// Rule set compiled into the firmware (see ai_rules.h)
+#define AI_RULE_PROFILE_DEFAULT       0
+#define AI_RULE_PROFILE_RETAIL        1
+#define AI_RULE_PROFILE_WARDRIVING    2
+#define AI_RULE_PROFILE               AI_RULE_PROFILE_DEFAULT
 
 // WiFi & BLE Configuration
 #define MAX_WIFI_NETWORKS  50
 #define MAX_BLE_DEVICES    30
+#define BLE_RECORD_CAPACITY  64
+#define BLE_RECORD_TTL_MS    30000
+#define BLE_RSSI_EWMA_SHIFT  2
+
+// BLE host stack under the observer scan: Bluedroid's legacy scan, or NimBLE's
+// extended scan for BLE 5 extended advertising and the coded PHY (see the nimble env)
+#define BLE_BACKEND_BLUEDROID  0
+#define BLE_BACKEND_NIMBLE     1
+#ifndef BLE_SCAN_BACKEND
+#define BLE_SCAN_BACKEND       BLE_BACKEND_NIMBLE
+#endif
+#define BLE_SCAN_CODED_PHY     true   // NimBLE: scan the coded PHY as well as 1M
 #define SCAN_TIME_SECONDS  10
+#define WIFI_CHANNEL_COUNT 13
+
+// RSSI histograms (fixed bins, clamped at both ends)
+#define RSSI_HIST_MIN_DBM    -100
+#define RSSI_HIST_BIN_DB     5
+#define RSSI_HIST_BINS       16
+
+// RSSI aggregation kernels (ESP32-S3 PIE path selected at compile time)
+#define RSSI_KERNELS_USE_PIE  true
+#define RSSI_KERNELS_BENCHMARK false  // Compare PIE and scalar paths at boot
+
+// Microbenchmark report at boot, for env:bench (make bench, see tools/bench)
+#ifndef BENCH_ENABLED
+#define BENCH_ENABLED          false
+#endif
+#define BENCH_SAMPLES          64     // Timed batches per case
+#define BENCH_SCENE_FRAMES     20     // Full redraws timed per UI scene
+
+// Synthetic scan source in place of the radios, for env:stress (see scan_synth.cpp)
+#ifndef SCAN_SYNTH_ENABLED
+#define SCAN_SYNTH_ENABLED     false
+#endif
+#define SCAN_SYNTH_MAX_DEVICES 8192         // Per population; 4 bytes each, PSRAM
+#define SCAN_SYNTH_APS         2000         // Emulated access points at boot
+#define SCAN_SYNTH_BLE         4000         // Emulated BLE advertisers at boot
+#define SCAN_SYNTH_CHURN_PERMILLE 20        // Share of each population replaced per cycle
+#define SCAN_SYNTH_RSSI_STEP_DB 3           // Largest signal change per device per cycle
+#define SCAN_SYNTH_ADV_PER_S   4            // Advertisements per BLE device per second
+#define SCAN_SYNTH_SPEEDUP     1            // Cycles this many times faster than the scan plan
+#define SCAN_SYNTH_PATH        "/synth"     // Load and generator figures, model update server
+
+// Soak run: replayed scan cycles, scripted UI and regression gates, for env:soak (make soak, see tools/soak)
+#ifndef SOAK_ENABLED
+#define SOAK_ENABLED           false
+#endif
+#define SOAK_TRACE_FILE        "/soak.htr"  // Replayed in a loop in place of radio results; generated cycles without it
+#define SOAK_CYCLE_MS          2000         // Scan period while injecting
+#define SOAK_UI_STEP_MS        7000         // Next scene in the ring this often
+#define SOAK_WARMUP_MS         (10UL * 60 * 1000)  // Before the baseline is taken
+#define SOAK_CHECK_INTERVAL_MS (5UL * 60 * 1000)
+#define SOAK_MIN_WINDOW_MS     (60UL * 60 * 1000)  // History judged before a gate may fail
+#define SOAK_HEAP_DRIFT_LIMIT  2048         // Bytes per hour the free heap floor may fall
+#define SOAK_FRAG_GROWTH_LIMIT 2            // Fragmentation points per hour it may rise
+#define SOAK_MISS_LIMIT        12           // Deadline misses per hour, every loop together
+#define SOAK_CREEP_LIMIT_PCT   50           // Loop body time above its warm-up average
+#define SOAK_CREEP_MIN_US      200          // Loops faster than this at warm-up are not judged
+#define SOAK_PATH              "/soak"      // Progress and verdict, model update server
+
+// Persistent device table (PSRAM, open addressing)
+#define DEVICE_TABLE_CAPACITY     1024
+#define DEVICE_TABLE_MAX_LOAD_PCT 75
+#define DEVICE_TABLE_SPARE_PCT    100     // Entry versions beyond the live maximum: a whole cycle's updates
+#define DEVICE_TABLE_READERS      4       // Tasks reading the table at once (UI, API workers)
+#define DEVICE_TTL_MS             120000
+#define DEVICE_MOVED_RSSI_DB      8
+#define DEVICE_AGE_SWEEP_BUDGET   128
+#define DEVICE_RSSI_EWMA_SHIFT    2
+#define DEVICE_STAY_GAP_MS        60000   // Unheard this long, a device's next sighting starts a new stay
+#define DEVICE_TREND_ALPHA        0.1f    // Weight of each sighting in the RSSI-over-time fit
+#define DEVICE_TREND_MIN_VAR_S2   4.0f    // Time spread (s^2) before the fit reports a slope
+#define DEVICE_TREND_DB_PER_MIN   1.0f    // Slope beyond which a device approaches or recedes
+#define DEVICE_CLUSTER_WINDOW_SHIFT 1     // Stays starting within 2^n cycles arrived together
+#define DEVICE_CLUSTER_SLOTS      256     // Arrival windows tallied at once, power of two
+#define DEVICE_FOLLOW_STAY_MS     300000  // Stay before a device can count as following
+#define DEVICE_FOLLOW_ARRIVALS    8       // Access points that must come into range meanwhile
+
+// Device history beyond the table: compact warm records in PSRAM, cold
+// sorted runs under TIER_DIR, each with a Bloom filter, merged on a worker
+#define TIER_ENABLED              true
+#define TIER_DIR                  TRACE_LOG_DIR "/tier"
+#define TIER_WARM_SLOTS           16384   // Warm records, 24 bytes each, power of two
+#define TIER_WARM_FLUSH_PCT       70      // Warm slots in use before the oldest go to the card...
+#define TIER_WARM_MAX_PCT         85      // ...and before devices leaving the table are not kept
+#define TIER_FLUSH_RECORDS        4096    // Records per flushed run
+#define TIER_MERGE_FANIN          4       // Runs of one level merged into one of the next
+#define TIER_RUNS_MAX             32      // Runs indexed at once; flushing waits above it
+#define TIER_BLOOM_BITS_PER_KEY   10      // With 7 hashes about 1% of absent devices read a run
+#define TIER_BLOOM_HASHES         7
+#define TIER_READ_RECORDS         128     // Records per card read or write while merging
+#define TIER_WRITE_CHUNK          4096    // Bytes per card write, the bus held for each
+#define TIER_RECALLS_MAX          4       // Card lookups of returning devices in flight
+
+// Long-term "seen before" filter (generational Bloom, PSRAM + LittleFS)
+#define NOVELTY_FILTER_ENABLED    true
+#define NOVELTY_FILTER_BITS       131072  // Bits per generation, power of two
+#define NOVELTY_FILTER_HASHES     4
+#define NOVELTY_GENERATIONS       4
+#define NOVELTY_RETENTION_DAYS    7
+#define NOVELTY_WARMUP_S          600     // History needed before reporting novelty
+#define NOVELTY_SAVE_INTERVAL_MS  900000
+#define NOVELTY_EXCITED_THRESHOLD 3       // Novel devices per cycle that excite the AI
+#define NOVELTY_FILE              "/novelty.bin"
+
+// Co-occurrence graph of devices, grouped into people and places
+#define COOCCURRENCE_ENABLED      true
+#define COOC_NODES                512     // Devices in the graph, power of two
+#define COOC_EDGES_PER_NODE       8       // Strongest links kept per device
+#define COOC_CYCLE_NODES          128     // Sightings of one cycle new partners are drawn from
+#define COOC_LINKS_PER_SIGHTING   2       // New partners drawn per sighting; known ones are always linked
+#define COOC_EDGE_STEP            16      // Weight of one shared cycle
+#define COOC_ARRIVAL_BONUS        4       // Step multiplier for devices that arrived together
+#define COOC_ARRIVAL_CYCLES       1       // Arrivals this many cycles apart count as together
+#define COOC_ABSENT_CYCLES        3       // Unheard for more cycles than this, a device is away
+#define COOC_DRAW_TRIES           4       // Draws per new partner looking for one that arrived together
+#define COOC_PRESENCE_CAP         128     // Most weight an edge gets from sharing cycles alone
+#define COOC_HALF_LIFE_CYCLES     32      // Cycles for an unreinforced edge to halve
+#define COOC_MIN_WEIGHT           32      // Edges lighter than this carry no label
+#define COOC_LP_BUDGET            128     // Nodes label propagation visits per cycle
+#define COOC_ACTIVE_MS            120000  // Heard within this, a device counts in its community
+#define COOC_PERSON_MAX_DEVICES   6       // BLE-only communities up to this size are people
+
+// Rogue access point detection (evil twins, cloned beacons, deauth bursts)
+#define AP_ANOMALY_ENABLED        true
+#define AP_ANOMALY_ESTABLISHED_CYCLES 3   // Cycles an SSID or BSSID is heard in before it is known
+#define AP_ANOMALY_BEACON_SLOTS   128     // BSSIDs whose last beacon is kept, power of two
+#define AP_ANOMALY_DEAUTH_BURST   20      // Deauth/disassoc frames in one capture window
+#define AP_ANOMALY_REPEAT_MS      60000   // At most one AI event per pattern this often
+#define AP_ANOMALY_HOLD_MS        30000   // The AI stays EXCITED this long after one
+
+// Coarse indoor location from anchor access point fingerprints
+#define LOCATION_ENABLED          true
+#define LOCATION_ANCHORS          16      // Access points in a fingerprint: one PIE vector
+#define LOCATION_FINGERPRINTS     256     // Stored fingerprints, PSRAM-resident
+#define LOCATION_LABELS           16      // Named places
+#define LOCATION_LABEL_LENGTH     16      // Bytes per name, terminator included
+#define LOCATION_FLOOR_DBM        -95     // Weaker, or unheard, reads as this
+#define LOCATION_K                3       // Nearest fingerprints that vote
+#define LOCATION_MAX_RMS_DB       12      // Fingerprints further than this on average have no vote
+#define LOCATION_MIN_ANCHORS      3       // Anchors heard before a cycle is placed or learned
+#define LOCATION_LEARN_CYCLES     5       // Fingerprints per learn request unless asked otherwise
+#define LOCATION_FILE             "/location.bin"
+
+// Scan scheduler - per-channel WiFi dwell (ms) interleaved with BLE windows
+#define WIFI_CHANNEL_DWELL_MS     { 120, 80, 80, 80, 80, 120, 80, 80, 80, 80, 120, 80, 80 }
+#define WIFI_CHANNELS_PER_SLOT    4
+#define BLE_SLOT_MS               600
+#define SCAN_SLOT_OVERHEAD_MS     40
+
+// BLE scan duty optimizer - the cheapest window and scan type that still hear most devices
+#define BLE_DUTY_ENABLED          true
+#define BLE_DUTY_TRIAL_MS         20000  // Listening per trial setting
+#define BLE_DUTY_REEVAL_MS        1800000 // Settled time between evaluations (30 min)
+#define BLE_DUTY_COVERAGE_PCT     95     // Share of the full-duty devices a setting must hear
+#define BLE_DUTY_MIN_DEVICES      4      // Fewer at full duty keeps the settings in force
+#define BLE_DUTY_ACTIVE_COST_PCT  115    // Draw of active over passive listening at equal window
+
+// Scan profiles (channel masks use bit N for channel N)
+#define SCAN_CHANNEL_MASK_ALL     0x3FFE
+#define SCAN_CHANNEL_MASK_SOCIAL  ((1 << 1) | (1 << 6) | (1 << 11))
+#define SLEEP_SCAN_INTERVAL_MS    60000
+#define PASSIVE_DWELL_MS          120
+#define TARGETED_DWELL_MS         200
+#define SINGLE_CHANNEL_DWELL_MS   400
+
+// Target registry - pinned devices scanned on their own between full sweeps
+#ifndef SCAN_TARGETS_ENABLED
+#define SCAN_TARGETS_ENABLED      true
+#endif
+#define SCAN_TARGET_MAX           4      // Pinned devices, user and AI together
+#define SCAN_TARGET_PERIOD_MS     250    // Targeted pass to targeted pass
+#define SCAN_TARGET_DWELL_MS      50     // Active, BSSID-filtered, per WiFi target
+#define SCAN_TARGET_MISSES        8      // WiFi passes unheard before the channel is looked up again
+#define SCAN_TARGET_AI_TTL_MS     60000  // An AI pick unheard this long is let go
+#define SCAN_TARGETS_PATH         "/targets" // Model update server
+
+// Adaptive scan interval (scales the active profile's interval)
+#define SCAN_ADAPT_ENABLED        true
+#define SCAN_ADAPT_FLOOR_PCT      40     // Shortest interval during bursts
+#define SCAN_ADAPT_CEILING_PCT    400    // Longest interval when static
+#define SCAN_ADAPT_CHURN_HIGH     150    // Churn (per mille) that shrinks the interval
+#define SCAN_ADAPT_CHURN_LOW      30     // Churn (per mille) below which it may stretch
+#define SCAN_ADAPT_CALM_CYCLES    3      // Quiet cycles required before stretching
+#define SCAN_ADAPT_STEP_PCT       25     // Stretch per quiet cycle
+
+// ESP-NOW mesh of HydraESP nodes sharing device digests
+#define MESH_SYNC_ENABLED         true
+#define MESH_HOME_CHANNEL         1      // Channel digests are exchanged on
+#define MESH_MAX_PEERS            8
+#define MESH_PEER_TTL_MS          30000  // Peer dropped after this long silent
+#define MESH_REFRESH_MS           20000  // Unchanged entries are re-sent this often
+#define MESH_MAX_BATCHES          4      // Digest frames sent per scan cycle
+#define MESH_RX_QUEUE_LENGTH      8
+#define MESH_MIN_COMPARED         8      // BLE devices compared before judging overlap
+#define MESH_MIN_OVERLAP_PCT      30     // Shared BLE devices needed to split channels
+#define MESH_REMOTE_TTL_MS        30000  // Peer-reported APs counted this long
+#define MESH_CLOCK_EWMA_SHIFT     4      // Upward drift tracking of the clock offset
+#define MESH_CLOCK_MIN_SAMPLES    4      // Frames before the offset is trusted
+
+// Extra radio modules streaming observations over a UART (BOARD.radio_link)
+#ifndef RADIO_LINK_ENABLED
+#define RADIO_LINK_ENABLED        false
+#endif
+#define RADIO_LINK_UART_NUM       2
+#define RADIO_LINK_BAUD           921600
+#define RADIO_LINK_RX_BUFFER_BYTES 8192  // UART driver ring; a scan cycle of observations from a few modules
+#define RADIO_LINK_READ_CHUNK     256
+#define RADIO_LINK_MAX_RADIOS     4      // Modules one link addresses
+#define RADIO_LINK_TTL_MS         5000   // Module silent this long gives its channels back
+#define RADIO_LINK_ASSIGN_REFRESH_MS 2000 // Unchanged assignments are re-sent this often
+#define RADIO_LINK_REMOTE_TTL_MS  30000  // Module-reported APs counted this long
+
+// Single-producer streams from radio callbacks (spsc_ring.h)
+#define SPSC_CACHE_LINE           32     // ESP32-S3 data cache line; producer and consumer indices apart
+#define SPSC_LATENCY_EWMA_SHIFT   4      // Push-to-pop latency average, 1/16 per record
+
+// Promiscuous capture pipeline (optional)
+#define PACKET_CAPTURE_ENABLED    true
+#define CAPTURE_RING_SLOTS        1024   // Power of two, PSRAM-resident
+#define CAPTURE_HEADER_BYTES      84     // Frame bytes kept for probe requests
+#define CAPTURE_SHORT_HEADER_BYTES 36    // Frame bytes kept for other frames
+#define CAPTURE_EAPOL_HEADER_BYTES 48    // EAPOL frames, through the key information; never the nonces or MIC
+#define CAPTURE_DRAIN_INTERVAL_MS 10
+#define CAPTURE_WINDOW_MS         1000
+#define CAPTURE_BSSID_SLOTS       64
+#define CAPTURE_CLIENT_SLOTS      128
+#define CAPTURE_ENTRY_TTL_MS      60000
+
+// PCAP export of captured frames (runs with the capture pipeline)
+#define PCAP_EXPORT_ENABLED       true
+#define PCAP_PATH                 "/pcap"  // Live stream and SD start/stop, model update server
+#define PCAP_RING_BYTES           (64 * 1024) // Power of two, PSRAM-resident, shared by both readers
+#define PCAP_SD_CHUNK             4096   // Staged bytes that start a card write; bytes per bus hold
+#define PCAP_SD_FLUSH_MS          2000   // A partial chunk is written at this age
+#define PCAP_BURST_FLUSH_MS       250    // ... and at this age during a capture burst
+#define PCAP_SD_SEGMENT_BYTES     (16UL * 1024 * 1024) // A new capture_NNNN.pcap past this size
+#define PCAP_SD_AUTOSTART         false  // Write to the card from boot
+
+// Client estimation (randomized MAC bucketing)
+#define CLIENT_WINDOW_MS          60000  // Unique-client counting window
+#define CLIENT_ENTRY_TTL_MS       300000
+#define CLIENT_SEQ_MAX_GAP        64     // Sequence advance accepted as the same device
+#define CLIENT_MERGE_MAX_AGE_MS   10000  // Max silence before a MAC rotation is merged
+
+// Association and EAPOL handshake statistics, metadata only (runs with the capture pipeline)
+#define HANDSHAKE_WATCH_ENABLED   true
+#define HANDSHAKE_BSSID_SLOTS     32     // BSSIDs with per-window counts, power of two
+#define HANDSHAKE_BUCKET_MS       10000  // Step of the rolling window
+#define HANDSHAKE_BUCKETS         6      // Window of six steps: the last minute
+#define HANDSHAKE_EXCHANGE_MS     2000   // A 4-way handshake not finished by then counts as partial
+
+// Adaptive channel hopping (runs with the capture pipeline)
+#define CHANNEL_HOPPING_ENABLED   true
+#define HOP_MIN_DWELL_MS          50
+#define HOP_MAX_DWELL_MS          500
+#define HOP_SCORE_EWMA_SHIFT      2
+
+// Airtime utilization per channel (runs with the capture pipeline)
+#define AIRTIME_ENABLED           true
+#define AIRTIME_EWMA_SHIFT        3      // Averages move over about 8 capture windows
+#define AIRTIME_MIN_LISTEN_MS     20     // Less listening on a channel in a window leaves its average alone
+
+// Capture bursts - a rogue AP pattern or EXCITED holds the capture on one channel (runs with the hopper)
+#define CAPTURE_BURST_ENABLED     true
+#define CAPTURE_BURST_MS          5000   // Length of a burst
+#define CAPTURE_BURST_MAX_MS      15000  // Re-triggers on the same channel extend a burst up to this
+#define CAPTURE_BURST_COOLDOWN_MS 30000  // Normal schedule after a burst before another may start
+#define CAPTURE_BURST_DRAIN_MS    2      // Capture ring drain period during a burst
+#define CAPTURE_BURST_WAIT_MS     250    // Scan task's check for the end of a burst
+#define CAPTURE_BURST_SD          true   // Record bursts to the card even with PCAP capture to SD off
 
 // Magic number constants
 #define WIFI_SCAN_TIMEOUT_MS      300
+#define WIFI_SCAN_DONE_MARGIN_MS  1000
 #define BLE_SCAN_INTERVAL         100
 #define BLE_SCAN_WINDOW          99
 #define STATS_UPDATE_INTERVAL_MS  1000
-#define LOG_INTERVAL_MS          30000
+#define LOG_INTERVAL_MS          30000  // Periodic AI and system log lines (default, tunable)
+#define STATUS_REPORT_INTERVAL_MS 300000 // Full system status report (default, tunable)
 #define CLEANUP_MEMORY_MULTIPLIER 2
 
-// Temperature thresholds
-#define CRITICAL_TEMPERATURE_C    85.0
+// Temperature thresholds, each throttling one more thing (see thermal.h); the
+// three steps are defaults, tunable at run time in whole degrees
+#define THERMAL_SCAN_CELSIUS      75.0   // Scan at the adaptive interval ceiling above this
+#define THERMAL_UI_CELSIUS        80.0   // Cap the UI frame rate above this
+#define CRITICAL_TEMPERATURE_C    85.0   // Clock the CPU down above this
+#define THERMAL_HYSTERESIS_C      3.0    // A step is released this far below its threshold
+#define THERMAL_EWMA_ALPHA        0.2f   // Weight of each new sensor reading
+#define THERMAL_UI_INTERVAL_MS    100    // Shortest frame gap while capped (10 fps)
+#define THERMAL_CPU_MHZ           80     // CPU clock while critical
+
+// Dynamic frequency scaling and automatic light sleep (need CONFIG_PM_ENABLE,
+// and CONFIG_FREERTOS_USE_TICKLESS_IDLE for light sleep, in the core's sdkconfig)
+#define POWER_MANAGER_ENABLED     true
+#define POWER_MAX_MHZ             240    // While the renderer, a scan cycle or the AI is active
+#define POWER_MIN_MHZ             80     // Otherwise; the radios need at least 80
+#define POWER_LIGHT_SLEEP         true   // Sleep between ticks when no task is ready
+
+// Resource governor - each AI state's budget for the scan interval, UI frame
+// rate, CPU clock floor and log verbosity, applied on committed transitions
+#define GOVERNOR_ENABLED          true
+#define GOVERNOR_ALERT_MIN_MHZ    160    // Clock floor in SNIFFING, TRACKING and EXCITED
+#define GOVERNOR_ALERT_INTERVAL_PCT 50   // Scan interval, % of the profile's, in SNIFFING and EXCITED
+#define GOVERNOR_CALM_FRAME_MS    50     // Shortest frame gap in IDLE and LEARNING (20 fps)
+#define GOVERNOR_SLEEP_FRAME_MS   250    // Shortest frame gap in SLEEPING (4 fps)
+#define GOVERNOR_SLEEP_INTERVAL_PCT 400  // Scan interval, % of the profile's, in SLEEPING
+#define GOVERNOR_QUIET_LOG_LEVEL  LOG_LEVEL_WARN // Scan and AI modules in SLEEPING
+
+// Energy model: current per subsystem in its full state, integrated over
+// the time spent in each state (see energy.h). Datasheet figures for the
+// S3 and a 2.8" panel; an INA219 on the I2C bus scales them to what is measured
+#define ENERGY_BASE_MA            12.0f  // Regulator, PSRAM, panel logic: always drawn
+#define ENERGY_CPU_IDLE_MA        18.0f  // Both cores idle at the bottom of the DFS range
+#define ENERGY_CPU_MA_PER_MHZ     0.2f   // Added per MHz of the top clock, at 100% load
+#define ENERGY_WIFI_RX_MA         85.0f  // Receiver on: a scan or packet capture
+#define ENERGY_WIFI_LINK_MA       20.0f  // Associated, modem sleep between beacons
+#define ENERGY_BLE_SCAN_MA        70.0f  // Scan window open; scaled by window / interval
+#define ENERGY_BACKLIGHT_MA       60.0f  // At 100%, linear in the PWM level
+#define ENERGY_SD_BUSY_MA         40.0f  // While the card holds the SPI bus
+#define ENERGY_AVG_ALPHA          0.05f  // Weight of each monitoring cycle in the average current
+#define ENERGY_BATTERY_MAH        2000   // Runtime estimate default, tunable
+#define ENERGY_INA219_ENABLED     true   // Probe for an INA219 on the I2C bus at boot
+#define ENERGY_INA219_ADDR        0x40
+#define ENERGY_INA219_SHUNT_MOHM  100    // Shunt resistor, milliohms
+#define ENERGY_CALIBRATION_ALPHA  0.02f  // Weight of each measured/modelled ratio in the scale
+
+// Wake sources besides the timer (see wake_sources.h): the touch IRQ, and a
+// LIS3DH on the I2C bus with INT1 at BOARD.i2c.motion_irq, end a deep or
+// light sleep; the battery is read on every wake and monitoring cycle
+#define WAKE_MOTION_ENABLED       true   // Probe for the accelerometer at boot
+#define WAKE_ACCEL_ADDR           0x18   // LIS3DH with SA0 low
+#define WAKE_MOTION_THRESHOLD_MG  96     // High-passed acceleration that counts as motion
+#define WAKE_EVENT_HOLD_MS        60000  // A wake or motion stays in wake_flags this long
+#define WAKE_BATTERY_DIVIDER      2      // Cell voltage over the ADC pin's
+#define WAKE_BATTERY_LOW_MV       3450   // battery_low feature, longer survey sleeps below it
+
+// I2C environmental sensors (see i2c_sensors.h), each probed at boot and
+// read at its own period in a batch on the job pool; absent ones cost nothing
+#define I2C_SENSORS_ENABLED       true
+#define I2C_SENSOR_CLIMATE_ADDR   0x44   // SHT3x with ADDR low
+#define I2C_SENSOR_CLIMATE_MS     10000
+#define I2C_SENSOR_LIGHT_ADDR     0x23   // BH1750 with ADDR low
+#define I2C_SENSOR_LIGHT_MS       2000
+#define I2C_SENSOR_MOTION_MS      1000   // The LIS3DH at WAKE_ACCEL_ADDR
+#define I2C_SENSOR_BATTERY_ADDR   0x36   // MAX17048 fuel gauge
+#define I2C_SENSOR_BATTERY_MS     30000
+#define I2C_SENSOR_STALE_PERIODS  3      // Periods without a good read before a reading goes stale
+
+// Ambient light (see ambient.h): the filtered lux scales the backlight, and
+// in the dark the night profile caps the frame rate
+#define AMBIENT_ENABLED           true
+#define AMBIENT_EWMA_ALPHA        0.3f   // Weight of each new light reading
+#define AMBIENT_CHANGE_PCT        25     // Filtered lux must move this far from the applied value...
+#define AMBIENT_CHANGE_MIN_LUX    3      // ...and at least this much, for the dark end
+#define AMBIENT_DARK_LUX          10     // Night below this
+#define AMBIENT_BRIGHT_LUX        1000   // Full backlight scale above this
+#define AMBIENT_HYSTERESIS_PCT    50     // A level is left this far past its threshold
+#define AMBIENT_DARK_BACKLIGHT_PCT 25    // Backlight scale in the dark, log-linear up to 100
+#define AMBIENT_NIGHT_FRAME_MS    100    // Shortest UI frame gap at night (10 fps)
+
+// Survey mode (env:survey): wake on the RTC timer, one passive WiFi and BLE
+// sweep into a ring in RTC memory, back to deep sleep; the ring goes to the
+// SD card and the MQTT broker every SURVEY_FLUSH_WAKES wakes or once full
+#ifndef SURVEY_MODE_ENABLED
+#define SURVEY_MODE_ENABLED       false
+#endif
+#define SURVEY_INTERVAL_S         300    // Wake to wake
+#define SURVEY_WIFI_DWELL_MS      60     // Passive listen per channel
+#define SURVEY_BLE_MS             1000   // Least BLE listen, overlapping the WiFi sweep
+#define SURVEY_RING_RECORDS       192    // 16 bytes each, in RTC slow memory
+#define SURVEY_FLUSH_WAKES        24     // Flush every this many wakes
+#define SURVEY_UPLINK_TIMEOUT_MS  8000   // Association, broker and acknowledgement, each
+#define SURVEY_EXIT_PIN           0      // Held low at reset: the full firmware instead
+#define SURVEY_LOW_BATTERY_STRETCH 4    // Sleeps this many intervals with the battery low
+#define SURVEY_LOG_PATH           "/logs/survey.hsv"
+
+// Wardriving (env:wardrive): an NMEA receiver on BOARD.gps, one position
+// record in the scan log ahead of each cycle's sightings while there is a
+// fix, and a scan interval that follows the speed over ground
+#ifndef WARDRIVE_ENABLED
+#define WARDRIVE_ENABLED          false
+#endif
+#define GPS_UART_NUM              1
+#define GPS_BAUD                  9600
+#define GPS_RX_BUFFER_BYTES       1024   // UART driver ring; a second of NMEA at 9600 baud
+#define GPS_READ_CHUNK            128
+#define GPS_READ_TIMEOUT_MS       200    // Longest wait for bytes, also the task's check-in
+#define GPS_FIX_STALE_MS          3000   // A fix older than this is no fix
+#define GPS_TASK_STACK_SIZE       2560
+#define GPS_TASK_PRIORITY         1
+#define GPS_TASK_CORE             TASK_CORE_UNPINNED
+#define WARDRIVE_STILL_KMH_X10    20     // Below this for WARDRIVE_STILL_MS: parked
+#define WARDRIVE_STILL_MS         60000
+#define WARDRIVE_MOVING_KMH_X10   60     // Walking pace and up
+#define WARDRIVE_FAST_KMH_X10     300    // Cycling or driving
+#define WARDRIVE_STILL_PCT        300    // Scan interval scale, parked...
+#define WARDRIVE_MOVING_PCT       50     // ...moving...
+#define WARDRIVE_FAST_PCT         25     // ...and fast
+#define WARDRIVE_MIN_INTERVAL_MS  1500   // However fast; a sweep takes about this long
+
+// Geohash-indexed store of the survey's sightings: one file per cell under
+// GEO_STORE_DIR and a directory of the cells, kept in PSRAM and on the card
+#define GEO_STORE_ENABLED         true
+#define GEO_STORE_DIR             TRACE_LOG_DIR "/geo"
+#define GEO_INDEX_FILE            GEO_STORE_DIR "/index.hgi"
+#define GEO_INDEX_TEMP_FILE       GEO_STORE_DIR "/index.tmp"
+#define GEO_CELL_PRECISION        6      // Geohash characters per file: about 1.2 x 0.6 km
+#define GEO_CELLS_MAX             1024   // Directory entries, 32 bytes each in PSRAM
+#define GEO_CELL_MAX_ROWS         20000  // Rows one cell file takes before it is full
+#define GEO_STAGE_ROWS            2048   // Rows per batch, two batches staged in PSRAM
+#define GEO_STAGE_RUNS            64     // Cell changes one batch holds
+#define GEO_FLUSH_MS              60000  // A batch is written at this age even if not full
+#define GEO_RECORD_MIN_M          20     // Closer than this to the last recorded cycle: only new devices...
+#define GEO_REFRESH_MS            60000  // ...until this long has passed
+#define GEO_WRITE_CHUNK           4096   // Bytes per card write, the bus held for each
+#define GEO_READ_ROWS             256    // Rows per card read in a query
+#define GEO_QUERY_MAX_CELLS       16     // Cell files one query reads
+#define GEO_QUERY_RADIUS_M        200    // Default radius of a POST to GEO_PATH
+#define GEO_RESULT_MAX            32     // Nearest devices a POST's result keeps
+#define GEO_PATH                  "/geo" // Directory, "surveyed" checks and nearby queries, model update server
+
 #define MAX_TASK_COUNT_WARNING    20
 
 // SSID string length
 #define MAX_SSID_LENGTH          32
 
+// SSID arena (interned, fixed 32-byte slots)
+#define SSID_ARENA_SLOTS         128
+#define SSID_ARENA_INDEX_SIZE    256   // Power of two, > SSID_ARENA_SLOTS
+
 #endif // CONFIG_H
\ No newline at end of file
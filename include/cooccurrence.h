@@ -0,0 +1,47 @@
+#ifndef COOCCURRENCE_H
+#define COOCCURRENCE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "device_table.h"
+
+/**
+ * @brief Graph size and the communities of the last completed sweep
+ */
+typedef struct {
+    uint16_t nodes;                 // Devices in the graph
+    uint16_t edges;                 // Directed edges above COOC_MIN_WEIGHT
+    uint16_t people;                // Active BLE-only communities of 2 to COOC_PERSON_MAX_DEVICES
+    uint16_t places;                // Active communities holding an access point, or larger
+    uint16_t largest;               // Members of the largest active community
+    uint32_t sweeps;                // Label propagation passes over the whole graph
+    uint32_t evictions;             // Nodes replaced by a newer device
+    uint32_t skipped;               // Cycles whose pass was still queued or had no worker
+} cooccurrence_stats_t;
+
+/**
+ * @brief Allocate the graph (PSRAM preferred)
+ * @return true if the graph is usable
+ */
+bool cooccurrence_init(void);
+
+/**
+ * @brief Add a sighting of the open cycle, linking it to devices already seen in it
+ *
+ * O(1): the device's own edges to devices already heard in the cycle
+ * grow, and COOC_LINKS_PER_SIGHTING new partners are drawn from them, so
+ * a pair that is always together gains weight every cycle it is.
+ */
+void cooccurrence_observe(const uint8_t* mac, device_kind_t kind, uint32_t now_ms);
+
+/**
+ * @brief Close the cycle and queue a label propagation pass on a job worker
+ */
+void cooccurrence_close_cycle(uint32_t now_ms);
+
+/**
+ * @brief Copy the graph size and the community counts
+ */
+void cooccurrence_get_stats(cooccurrence_stats_t* stats);
+
+#endif // COOCCURRENCE_H
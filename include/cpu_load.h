@@ -0,0 +1,67 @@
+#ifndef CPU_LOAD_H
+#define CPU_LOAD_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+
+#define CPU_LOAD_CORES 2
+
+/**
+ * @brief Share of one watched task over the last sample interval
+ */
+typedef struct {
+    const char* name;               // FreeRTOS task name
+    int8_t      core;               // Pinned core, -1 if it floats
+    float       busy_pct;           // Of one core's time
+    uint8_t     core_share_pct[CPU_LOAD_CORES];  // Where that time was spent
+} cpu_load_task_t;
+
+/**
+ * @brief Utilization over the interval between the last two samples
+ */
+typedef struct {
+    float           core_pct[CPU_LOAD_CORES];   // Time not spent in the core's idle task
+    uint8_t         task_count;
+    cpu_load_task_t tasks[CPU_LOAD_MAX_TASKS];
+    uint32_t        interval_ms;
+    const char*     method;         // "run-time stats" or "tick sampling"
+} cpu_load_t;
+
+/**
+ * @brief Start counting
+ *
+ * Uses the FreeRTOS run-time counters when the kernel keeps them
+ * (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS). The stock Arduino core does
+ * not, so a tick hook on each core instead notes which task every tick
+ * interrupted: a statistical figure that misses work done entirely
+ * between two ticks.
+ * @return false if the tick hooks cannot be registered
+ */
+bool cpu_load_init(void);
+
+/**
+ * @brief Add a task to the per-task breakdown
+ * @return false if CPU_LOAD_MAX_TASKS are watched already
+ */
+bool cpu_load_watch(TaskHandle_t task);
+
+/**
+ * @brief Close the interval since the previous call and publish its figures
+ *
+ * Call from one task only, once per monitoring cycle.
+ */
+void cpu_load_sample(uint32_t now_ms);
+
+/**
+ * @brief Figures of the last closed interval
+ */
+void cpu_load_get(cpu_load_t* load);
+
+/**
+ * @brief One core's busy share of the last closed interval, without copying the task breakdown
+ */
+float cpu_load_core_pct(uint8_t core);
+
+#endif // CPU_LOAD_H
@@ -0,0 +1,116 @@
+#ifndef CRASH_DUMP_H
+#define CRASH_DUMP_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+
+#define CRASH_CHUNK_MAGIC   0x53524348u     // "HCRS"
+#define CRASH_CHUNK_FORMAT  1
+#define CRASH_NOTE_BYTES    64
+
+/**
+ * @brief What a crash left behind
+ */
+typedef enum {
+    CRASH_PART_TRACE = 0,           // The event ring as it stood, in the /trace export format
+    CRASH_PART_CORE,                // The IDF core dump image, as espcoredump.py -t raw reads it
+    CRASH_PARTS
+} crash_part_t;
+
+/**
+ * @brief Start of every MQTT crash message; length bytes of the part follow
+ *
+ * Concatenated messages split again on these headers, so a capture of the
+ * topic's raw payloads is enough to rebuild both parts.
+ */
+typedef struct {
+    uint32_t magic;                 // CRASH_CHUNK_MAGIC
+    uint8_t  part;                  // crash_part_t
+    uint8_t  format;                // CRASH_CHUNK_FORMAT
+    uint16_t length;
+    uint32_t crash_id;              // Same for every chunk of one crash
+    uint32_t offset;                // Of these bytes in the part
+    uint32_t total;                 // Bytes in the part
+} crash_chunk_header_t;
+
+static_assert(sizeof(crash_chunk_header_t) == 20, "crash chunk header layout changed");
+
+/**
+ * @brief The last crash and its upload
+ */
+typedef struct {
+    bool     crashed;               // This boot follows a panic, a watchdog or a supervisor reboot
+    uint8_t  reset_reason;          // esp_reset_reason_t
+    bool     core_present;
+    bool     trace_present;
+    bool     uploaded;              // Every part present acknowledged by the broker
+    uint8_t  backtrace_depth;
+    uint32_t core_bytes;
+    uint32_t trace_bytes;
+    uint32_t crash_id;              // The core dump's checksum, else drawn at boot
+    uint32_t pc;                    // Faulting PC, from the core dump
+    uint32_t backtrace[CRASH_BACKTRACE_DEPTH];
+    char     task[16];              // Task that faulted, from the core dump
+    char     note[CRASH_NOTE_BYTES]; // The supervisor's reason for its reboot
+    uint32_t chunks_sent;           // MQTT messages acknowledged
+    uint32_t downloads;             // Parts fetched over HTTP
+} crash_status_t;
+
+/*
+ * Post-mortems without a laptop attached. A panic or watchdog has ESP-IDF
+ * write a core dump (every task's stack and registers) to the coredump
+ * partition; the event trace ring, in memory a reset leaves alone, holds
+ * the last few seconds of scans, inferences, flushes and lock waits. The
+ * supervisor's own reboots leave a note next to it.
+ *
+ * The next boot keeps both, logs the faulting task, PC and backtrace, and
+ * offers them on CRASH_PATH; with an uplink they are also published in
+ * CRASH_MQTT_CHUNK_BYTES pieces on <prefix>/<MAC>/crash at QoS 1, one
+ * piece in flight at a time. A core dump the broker has taken whole is
+ * remembered by its checksum and not sent again; the ring lasts only as
+ * long as the boot after the crash. tools/crash/crash_fetch.py rebuilds
+ * both from either route.
+ */
+
+/**
+ * @brief Find out whether the last boot crashed and start the event trace
+ *
+ * Call first thing in setup(), before anything traces.
+ */
+void crash_dump_init(void);
+
+/**
+ * @brief Leave a reason for the reboot that follows (supervisor)
+ */
+void crash_dump_note(const char* reason);
+
+/**
+ * @brief Read the core dump, name the kept trace's tasks, remember uploads
+ *
+ * Runs on the system task; the first call does the boot's reading.
+ */
+void crash_dump_tick(uint32_t now_ms);
+
+/**
+ * @brief Add the crash route to the web server
+ */
+void crash_dump_register(AsyncWebServer* server);
+
+/**
+ * @brief Next piece to publish, header included; the same one until acknowledged
+ * @return Bytes written, 0 with nothing left to send
+ */
+size_t crash_dump_chunk(uint8_t* out, size_t size);
+
+/**
+ * @brief The broker has the piece crash_dump_chunk() last returned
+ */
+void crash_dump_chunk_acked(void);
+
+/**
+ * @brief Copy the crash status
+ */
+void crash_dump_get_status(crash_status_t* status);
+
+#endif // CRASH_DUMP_H
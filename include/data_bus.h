@@ -0,0 +1,152 @@
+#ifndef DATA_BUS_H
+#define DATA_BUS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "ai_states.h"
+#include "sensor_snapshot.h"
+
+/**
+ * @brief Published state, each topic written by exactly one task
+ */
+typedef enum {
+    BUS_TOPIC_SCAN = 0,             // sensor_snapshot_t, scan task
+    BUS_TOPIC_SYSTEM,               // system_publication_t, system task
+    BUS_TOPIC_CAPTURE,              // capture_publication_t, capture task
+    BUS_TOPIC_AI_STATE,             // ai_state_publication_t, AI task
+    BUS_TOPIC_I2C,                  // i2c_publication_t, system task
+    BUS_TOPIC_INPUT,                // input_publication_t, UI task
+    BUS_TOPIC_COUNT
+} bus_topic_t;
+
+/**
+ * @brief System task's share of the sensor data
+ */
+typedef struct {
+    uint32_t free_memory;
+    uint32_t uptime_seconds;
+    bool     sd_card_present;
+    uint8_t  ambient_level;         // ambient_level_t
+} system_publication_t;
+
+/**
+ * @brief Capture task's share of the sensor data, one capture window
+ */
+typedef struct {
+    uint16_t capture_frames_per_second;
+    uint16_t probe_requests;
+    uint16_t wifi_clients_count;
+    uint16_t randomized_clients;
+    uint16_t busiest_bssid_fps;
+    uint16_t busiest_channel_fps;
+    uint8_t  hop_channel;
+    uint8_t  busiest_channel;
+    uint16_t airtime_permille;
+    uint16_t busiest_airtime_permille;
+    uint8_t  busiest_airtime_channel;
+    uint8_t  associations_per_min;  // Association and reassociation requests, saturating
+    uint8_t  handshakes_per_min;    // Completed 4-way handshakes, saturating
+} capture_publication_t;
+
+/**
+ * @brief I2C sensor readings; a field is 0 until its sensor has been read
+ */
+typedef struct {
+    uint8_t  present;               // Bit per i2c_sensor_id_t that answered at boot
+    uint8_t  fresh;                 // Bit per sensor read within I2C_SENSOR_STALE_PERIODS of its period
+    int16_t  temperature_c10;       // 0.1 degC
+    uint16_t humidity_permille;     // Relative humidity
+    uint16_t light_lux;
+    uint16_t motion_mg;             // Departure of |a| from 1 g
+    uint16_t battery_mv;            // Cell voltage from the gauge
+    uint8_t  battery_pct;           // State of charge from the gauge
+} i2c_publication_t;
+
+/**
+ * @brief Touch gestures: the latest and counts since boot (see gestures.h)
+ */
+typedef struct {
+    uint8_t  gesture;               // gesture_t
+    int16_t  x;                     // Where the touch started
+    int16_t  y;
+    uint32_t at_ms;
+    uint32_t gestures;
+    uint32_t taps;
+    uint32_t long_presses;
+    uint32_t swipes;
+} input_publication_t;
+
+/**
+ * @brief Committed AI state, a latest-value mailbox
+ *
+ * Transitions published faster than the UI reads them coalesce; the gap
+ * in transitions tells a reader how many it never saw.
+ */
+typedef struct {
+    ai_state_t state;
+    ai_state_t previous;
+    float      confidence;          // Of the decision that committed the state
+    uint32_t   entered_ms;          // millis() of the transition
+    uint32_t   transitions;         // Since boot
+    uint16_t   trace;               // Latency trace the committing decision carried, 0 for none
+} ai_state_publication_t;
+
+/**
+ * @brief Traffic on one topic
+ */
+typedef struct {
+    const char* name;
+    uint32_t    version;            // Publications so far
+    uint32_t    read_retries;       // Reads repeated because a publication landed mid-copy
+    uint32_t    rejected_writes;    // begin_publish() calls from a task other than the writer
+    uint8_t     subscribers;
+} bus_topic_stats_t;
+
+/**
+ * @brief Clear every topic
+ * @return true on success, false on failure
+ */
+bool data_bus_init(void);
+
+/**
+ * @brief Open a topic's inactive slot for writing
+ *
+ * The slot is preloaded with the latest publication, so the writer only
+ * touches the fields that changed. The first task to call this becomes the
+ * topic's only writer; no lock is taken and readers are never blocked.
+ * Every call must be paired with data_bus_publish().
+ * @return Slot to fill, or NULL if another task owns the topic
+ */
+void* data_bus_begin_publish(bus_topic_t topic);
+
+/**
+ * @brief Publish the slot opened by data_bus_begin_publish() and wake subscribers
+ */
+void data_bus_publish(bus_topic_t topic);
+
+/**
+ * @brief Copy part of a topic's latest publication without blocking
+ * @param offset Byte offset into the payload, e.g. offsetof() a member
+ * @return Version of the copy, 0 if nothing was published yet
+ */
+uint32_t data_bus_read(bus_topic_t topic, void* out, size_t offset, size_t length);
+
+/**
+ * @brief Version of a topic, incremented on every publication
+ */
+uint32_t data_bus_version(bus_topic_t topic);
+
+/**
+ * @brief Notify a task with these bits (eSetBits) on every publication
+ * @return false when the topic has DATA_BUS_SUBSCRIBERS_MAX subscribers
+ */
+bool data_bus_subscribe(bus_topic_t topic, TaskHandle_t task, uint32_t bits);
+
+/**
+ * @brief Copy one topic's figures
+ */
+void data_bus_get_stats(bus_topic_t topic, bus_topic_stats_t* stats);
+
+#endif // DATA_BUS_H
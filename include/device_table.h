@@ -0,0 +1,240 @@
+#ifndef DEVICE_TABLE_H
+#define DEVICE_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Kind of radio observation stored in the device table
+ */
+typedef enum {
+    DEVICE_KIND_WIFI_AP = 0,    // WiFi access point, keyed by BSSID
+    DEVICE_KIND_BLE             // BLE advertiser, keyed by address
+} device_kind_t;
+
+/**
+ * @brief Where the sighting log stands with one device (see sighting_log.h)
+ */
+typedef struct {
+    int8_t   rssi_ref;          // RSSI of the device's last raw record
+    int8_t   rssi_min;          // Over the cycles since its last record
+    int8_t   rssi_max;
+    uint8_t  logged;            // Its appearance is in the log
+    uint16_t cycles;            // Cycles seen since its last record
+} device_log_state_t;
+
+/**
+ * @brief How one device has moved and stayed, updated in O(1) per sighting
+ *
+ * The trend is an exponentially weighted least-squares fit of RSSI over
+ * time, kept as running means, a covariance and a variance so no
+ * sightings are stored. A stay ends after DEVICE_STAY_GAP_MS unheard.
+ */
+typedef struct {
+    float    t_mean_s;          // Weighted mean sighting time, s since first seen
+    float    rssi_mean;         // Weighted mean RSSI (dBm)
+    float    t_rssi_cov;        // Weighted covariance of time and RSSI
+    float    t_var;             // Weighted variance of time
+    uint32_t stay_start_ms;     // Start of the current stay
+    uint32_t arrivals_mark;     // Access point arrivals, table-wide, when the stay started
+    uint16_t arrival_window;    // Scan cycle the stay started in >> DEVICE_CLUSTER_WINDOW_SHIFT
+    uint8_t  visits;            // Novelty generations it was seen in before, each a few days (set by the scan task)
+    uint8_t  following;         // Counted as following
+} device_track_t;
+
+/**
+ * @brief Persistent per-device entry (72 bytes, in a pool behind an open-addressed slot)
+ */
+typedef struct {
+    uint8_t  mac[6];            // BSSID or BLE address
+    uint8_t  kind;              // device_kind_t
+    uint8_t  used;              // Slot occupied
+    int8_t   rssi_min;          // Weakest RSSI seen (dBm)
+    int8_t   rssi_max;          // Strongest RSSI seen (dBm)
+    int8_t   rssi_last;         // Latest RSSI (dBm)
+    uint8_t  channel;           // Last WiFi channel (0 for BLE)
+    int16_t  rssi_ewma_x16;     // RSSI EWMA in 1/16 dBm
+    uint16_t moved_cycle;       // Cycle in which the last move was counted
+    uint32_t first_seen_ms;     // First sighting
+    uint32_t last_seen_ms;      // Latest sighting
+    uint32_t sightings;         // Number of sightings
+    uint32_t synced_ms;         // Last time shared with mesh peers (0 = never)
+    uint32_t last_seen_us;      // Radio clock of the latest sighting
+    uint16_t last_cycle;        // Scan cycle of the latest sighting
+    device_log_state_t log;     // Zeroed on insert, kept by the sighting log
+    device_track_t track;       // Trend, stay and co-arrival
+} device_entry_t;
+
+/**
+ * @brief Changes accumulated since the previous delta was taken
+ */
+typedef struct {
+    uint16_t appeared;          // New devices inserted
+    uint16_t lost;              // Devices aged out
+    uint16_t moved;             // Devices whose RSSI jumped past the threshold
+    uint16_t dropped;           // Observations rejected (table full)
+    uint16_t live_wifi;         // Live WiFi entries
+    uint16_t live_ble;          // Live BLE entries
+    uint16_t following;         // Live BLE entries that stayed while the access points changed
+} device_delta_t;
+
+/**
+ * @brief Entry versions and the readers holding them back
+ */
+typedef struct {
+    uint32_t epoch;             // Advanced once per cycle
+    uint32_t records;           // Pool size: the live maximum plus DEVICE_TABLE_SPARE_PCT
+    uint32_t free;
+    uint32_t limbo;             // Retired, waiting for the readers pinned before to unpin
+    uint32_t published;         // Updates published as a new version
+    uint32_t in_place;          // Updates written in place, the spares all in limbo
+    uint32_t reclaimed;         // Retired records back in the pool
+    uint32_t pins;
+    uint32_t unpinned;          // Reads that found every reader slot taken
+    uint8_t  readers;           // Pinned now
+} device_versions_t;
+
+/**
+ * @brief Per-device changes reported through the event handler
+ */
+typedef enum {
+    DEVICE_EVENT_APPEARED = 0,   // First sighting
+    DEVICE_EVENT_LOST,           // Aged out (entry is about to be removed)
+    DEVICE_EVENT_MOVED           // RSSI jumped past DEVICE_MOVED_RSSI_DB
+} device_event_t;
+
+/**
+ * @brief Event handler, called synchronously from observe/age_step
+ *
+ * Of the entry, it may only change track.visits.
+ */
+typedef void (*device_event_handler_t)(device_event_t event, device_entry_t* entry);
+
+/**
+ * @brief Allocate the table (PSRAM preferred)
+ * @param capacity Slot count, rounded up to a power of two
+ * @return true on success, false on allocation failure
+ */
+bool device_table_init(uint32_t capacity);
+
+/**
+ * @brief Install a handler for per-device events (NULL to remove)
+ */
+void device_table_set_event_handler(device_event_handler_t handler);
+
+/**
+ * @brief Record one sighting, inserting the device if it is new
+ * @param mac Six-byte BSSID or BLE address
+ * @param kind Observation kind
+ * @param rssi Signal strength in dBm
+ * @param channel WiFi channel (0 for BLE)
+ * @param now_ms Timestamp of the sighting
+ * @param rx_us Radio clock (esp_timer, microseconds) of the sighting
+ * @return Updated entry, or NULL if the table is full
+ */
+device_entry_t* device_table_observe(const uint8_t* mac, device_kind_t kind,
+                                     int8_t rssi, uint8_t channel, uint32_t now_ms,
+                                     uint32_t rx_us);
+
+/**
+ * @brief Look up a device without modifying it
+ * @return Entry or NULL if unknown
+ */
+const device_entry_t* device_table_find(const uint8_t* mac, device_kind_t kind);
+
+/**
+ * @brief Incrementally sweep for expired entries
+ * @param now_ms Current time
+ * @param budget Maximum slots to examine in this call
+ * @return Number of entries removed
+ */
+uint16_t device_table_age_step(uint32_t now_ms, uint32_t budget);
+
+/**
+ * @brief Return the delta since the previous call and start a new cycle
+ * @param delta Receives the accumulated changes
+ */
+void device_table_take_delta(device_delta_t* delta);
+
+/**
+ * @brief Record that a slot's entry was shared with mesh peers
+ * @param index Slot index
+ * @param now_ms Current time
+ */
+void device_table_mark_synced(uint32_t index, uint32_t now_ms);
+
+/**
+ * @brief RSSI trend of a device, dB per minute: positive approaching, negative receding
+ */
+float device_table_trend(const device_entry_t* entry);
+
+/**
+ * @brief Length of a device's current stay
+ */
+uint32_t device_table_stay_ms(const device_entry_t* entry);
+
+/**
+ * @brief Other live devices whose stay started in the same cycle window
+ *
+ * Devices carried by one person or vehicle arrive, and leave, together;
+ * the count is read from a per-window tally, not by walking the table.
+ */
+uint16_t device_table_companions(const device_entry_t* entry);
+
+/**
+ * @brief Sequence number of the open scan cycle
+ */
+uint16_t device_table_cycle(void);
+
+/**
+ * @brief Number of live entries
+ */
+uint32_t device_table_count(void);
+
+/**
+ * @brief Slot count, for iteration with device_table_entry_at()
+ */
+uint32_t device_table_capacity(void);
+
+/**
+ * @brief Entry stored at a slot index
+ * @return Entry or NULL if the slot is empty
+ */
+const device_entry_t* device_table_entry_at(uint32_t index);
+
+/**
+ * @brief Pin the current epoch before reading entries from another task
+ *
+ * Entries are versions: the scan task publishes a new one for each
+ * sighting rather than writing over the one a reader may be holding, and
+ * an old one only goes back to the pool once every reader pinned before
+ * it was retired has unpinned. Between device_table_pin() and
+ * device_table_unpin() every entry pointer read from the table stays
+ * whole and unchanged, bar the bookkeeping fields; keep the pin for one
+ * walk or one draw, not across waits, as it holds back the pool. Never
+ * blocks; the scan task itself needs no pin.
+ * @return Pin for device_table_unpin(), or 0 with all DEVICE_TABLE_READERS
+ *         slots taken, in which case the read is not protected
+ */
+uint8_t device_table_pin(void);
+
+/**
+ * @brief End a read started by device_table_pin(); 0 is ignored
+ */
+void device_table_unpin(uint8_t pin);
+
+/**
+ * @brief Copy the version pool figures
+ */
+void device_table_get_versions(device_versions_t* versions);
+
+/**
+ * @brief Writable entry at a slot index, for the scan task's bookkeeping fields
+ *
+ * Only the log state may be changed; the key and the figures belong to
+ * the table.
+ * @return Entry or NULL if the slot is empty
+ */
+device_entry_t* device_table_entry_mut(uint32_t index);
+
+#endif // DEVICE_TABLE_H
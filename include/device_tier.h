@@ -0,0 +1,121 @@
+#ifndef DEVICE_TIER_H
+#define DEVICE_TIER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "device_table.h"
+
+/*
+ * Every device ever heard, in three tiers. Hot: the device table, full
+ * entries for what is in range now. Warm: a 24-byte record per device
+ * that has been in range, in PSRAM, folded in each time it leaves the
+ * table. Cold: once TIER_WARM_FLUSH_PCT of the warm slots are used, the
+ * oldest TIER_FLUSH_RECORDS go to the card as a run sorted by address,
+ * with a Bloom filter kept in PSRAM so a device that is in no run costs
+ * no card read. Runs of one level are merged TIER_MERGE_FANIN at a time
+ * into one of the next, so the number of runs grows with the log of the
+ * devices and a lookup reads a handful of them.
+ *
+ * A device coming back into range is looked for in the warm tier at
+ * once, and in the runs whose filters admit it on a worker. A record
+ * flagged whole carries every older one for its device; one that is not,
+ * because its lookup had not finished or was never made, is added to the
+ * older records when runs are merged.
+ */
+
+#define DEVICE_TIER_MAGIC       0x52544848u     // "HHTR", last four bytes of a complete run
+#define DEVICE_TIER_FORMAT      1
+#define DEVICE_TIER_REPLACES    4               // Runs one merged run names as its inputs
+#define DEVICE_TIER_WHOLE       0x80            // In kind: every older record is folded in
+
+/**
+ * @brief What is kept of a device once it leaves the table; runs are arrays of these
+ */
+typedef struct {
+    uint8_t  mac[6];
+    uint8_t  kind;                  // device_kind_t in the low bits, DEVICE_TIER_WHOLE
+    uint8_t  channel;               // Last WiFi channel (0 for BLE)
+    uint32_t last_s;                // Tier clock: UTC seconds, or the card's newest plus uptime
+    uint32_t span_s;                // Back from last_s to the first sighting
+    uint32_t sightings;
+    int8_t   rssi_min;
+    int8_t   rssi_max;
+    int8_t   rssi_mean;             // Of its last stay in the table
+    uint8_t  stays;                 // Times it left the table, saturating
+} device_tier_record_t;
+
+/**
+ * @brief End of every run file: the records come first, then the filter, then this
+ */
+typedef struct {
+    uint32_t records;
+    uint32_t bloom_bits;
+    uint16_t format;                // DEVICE_TIER_FORMAT
+    uint8_t  bloom_hashes;
+    uint8_t  level;                 // 0 for a flush, one above its inputs for a merge
+    uint32_t newest_s;              // Latest last_s of its records
+    uint32_t replaces[DEVICE_TIER_REPLACES];    // Runs merged into it, 0 for none
+    uint32_t crc32;                 // Of the filter
+    uint32_t magic;                 // DEVICE_TIER_MAGIC
+} device_tier_footer_t;
+
+static_assert(sizeof(device_tier_record_t) == 24, "tier record layout changed");
+static_assert(sizeof(device_tier_footer_t) == 24 + DEVICE_TIER_REPLACES * 4, "tier footer has implicit padding");
+static_assert(TIER_MERGE_FANIN <= DEVICE_TIER_REPLACES, "a merged run names every input");
+
+/**
+ * @brief Tier figures since boot
+ */
+typedef struct {
+    bool     loaded;                // The card's runs have been indexed
+    uint32_t warm;                  // Records in PSRAM...
+    uint32_t warm_hot;              // ...of devices in the table now
+    uint16_t runs;
+    uint8_t  levels;                // Deepest level plus one
+    uint32_t cold_records;          // In every run, a device counted once per run holding it
+    uint32_t cold_bytes;
+    uint32_t bloom_bytes;           // Filters held in PSRAM
+    uint32_t demoted;               // Devices folded into the warm tier on leaving the table
+    uint32_t returned_warm;         // Devices back in range, found warm...
+    uint32_t returned_cold;         // ...or in a run
+    uint32_t new_devices;           // In neither, by the filters
+    uint32_t filter_skips;          // Runs a lookup did not read
+    uint32_t filter_false;          // Runs read for nothing
+    uint32_t lookups;               // Card lookups made
+    uint32_t lookups_skipped;       // TIER_RECALLS_MAX already in flight
+    uint32_t flushes;
+    uint32_t merges;
+    uint32_t merged_records;        // Written by merges
+    uint32_t folded;                // Duplicates merged into one record
+    uint32_t discarded;             // Warm records let go with no card to flush them to
+    uint32_t dropped;               // Devices not kept, the warm tier full
+    uint32_t write_failures;
+} device_tier_stats_t;
+
+/**
+ * @brief Allocate the warm tier and the card buffers in PSRAM (scan task)
+ * @return true on success, false on allocation failure
+ */
+bool device_tier_init(void);
+
+/**
+ * @brief A device entered the table: find what is known of it (scan task, APPEARED)
+ */
+void device_tier_appeared(const device_entry_t* entry, uint32_t now_ms);
+
+/**
+ * @brief A device is leaving the table: fold its stay into its warm record (scan task, LOST)
+ */
+void device_tier_lost(const device_entry_t* entry, uint32_t now_ms);
+
+/**
+ * @brief Take in finished lookups and flush the oldest warm records; once per cycle (scan task)
+ */
+void device_tier_step(uint32_t now_ms);
+
+/**
+ * @brief Copy the tier figures
+ */
+void device_tier_get_stats(device_tier_stats_t* stats);
+
+#endif // DEVICE_TIER_H
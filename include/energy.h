@@ -0,0 +1,89 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief What draws current, each with its full-state figure in config.h
+ */
+typedef enum {
+    ENERGY_LOAD_BASE = 0,           // Always on
+    ENERGY_LOAD_CPU,                // Idle floor plus the busy share of the top clock
+    ENERGY_LOAD_WIFI_RX,            // A scan or packet capture under way
+    ENERGY_LOAD_WIFI_LINK,          // Associated to an access point
+    ENERGY_LOAD_BLE_SCAN,           // Observer scan running
+    ENERGY_LOAD_BACKLIGHT,          // At its PWM level
+    ENERGY_LOAD_SD,                 // Card holding the SPI bus
+    ENERGY_LOAD_COUNT
+} energy_load_t;
+
+/**
+ * @brief One load since boot
+ */
+typedef struct {
+    float    ma;                    // Drawn now, by the model
+    float    mah;                   // Charge since boot
+    uint32_t active_ms;             // Time drawing anything
+    uint8_t  share_pct;             // Of all the charge since boot
+} energy_load_stats_t;
+
+/**
+ * @brief The model's figures and the runtime they give
+ */
+typedef struct {
+    energy_load_stats_t loads[ENERGY_LOAD_COUNT];
+    float    model_ma;              // Sum of the loads now
+    float    avg_ma;                // EWMA over monitoring cycles, scaled
+    float    mah;                   // All loads since boot, scaled
+    float    scale;                 // Measured over modelled; 1 without an INA219
+    bool     ina219;                // Sensor found at boot
+    float    measured_ma;           // Its last reading
+    uint32_t calibrations;          // Readings folded into scale
+    uint16_t battery_mah;           // TUNABLE_BATTERY_MAH
+    float    runtime_h;             // A full battery at avg_ma
+} energy_status_t;
+
+/**
+ * @brief Start sampling; probes the INA219 if ENERGY_INA219_ENABLED
+ *
+ * Call after Wire.begin(). Switched loads are counted from boot, even
+ * those switched on before this.
+ */
+void energy_init(void);
+
+/**
+ * @brief A switched load went on or off; safe from any task
+ *
+ * For ENERGY_LOAD_WIFI_RX and ENERGY_LOAD_BLE_SCAN; the others are read
+ * in energy_sample(). Calls nest: a load stays on until each on has had
+ * its off, so a scan ending does not switch off a capture still running.
+ */
+void energy_set_active(energy_load_t load, bool active);
+
+/**
+ * @brief Share of the time a switched load draws its full current while on
+ *
+ * For ENERGY_LOAD_BLE_SCAN, its scan window over its interval. Safe from
+ * any task; the draw changes at once if the load is on.
+ */
+void energy_set_duty(energy_load_t load, uint8_t pct);
+
+/**
+ * @brief Read the polled loads, integrate and calibrate
+ *
+ * Call once per monitoring cycle from the system task, after cpu_load_sample().
+ */
+void energy_sample(uint32_t now_ms);
+
+/**
+ * @brief Copy the figures of the last sample
+ */
+void energy_get_status(energy_status_t* status);
+
+/**
+ * @brief Short name for logs and metrics ("cpu", "wifi_rx", ...)
+ */
+const char* energy_load_name(energy_load_t load);
+
+#endif // ENERGY_H
@@ -0,0 +1,159 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define EVENT_TRACE_MAGIC   0x56454848  // "HHEV"
+#define EVENT_TRACE_FORMAT  1
+
+/**
+ * @brief Traced events; BEGIN/END pairs become slices on the host
+ */
+typedef enum {
+    TRACE_SCAN_BEGIN = 1,
+    TRACE_SCAN_END,                 // arg0: WiFi networks, arg1: BLE devices
+    TRACE_INFER_BEGIN,
+    TRACE_INFER_END,                // arg0: proposed state, arg1: 1 if the model decided
+    TRACE_FLUSH_BEGIN,              // arg0: x1 | y1 << 16, arg1: x2 | y2 << 16
+    TRACE_FLUSH_END,
+    TRACE_MUTEX_WAIT,               // arg0: trace_lock_t, arg1: waited us (UINT32_MAX on timeout)
+    TRACE_QUEUE_SEND,               // arg0: trace_queue_t, arg1: messages waiting, UINT32_MAX if full
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+/**
+ * @brief Locks named in TRACE_MUTEX_WAIT
+ */
+typedef enum {
+    TRACE_LOCK_SPI_DISPLAY = 0,     // spi_device_t order
+    TRACE_LOCK_SPI_TOUCH,
+    TRACE_LOCK_SPI_SD
+} trace_lock_t;
+
+/**
+ * @brief Queues named in TRACE_QUEUE_SEND
+ */
+typedef enum {
+    TRACE_QUEUE_SCAN_EVENTS = 0,
+    TRACE_QUEUE_JOBS_HIGH,          // job_lane_t order
+    TRACE_QUEUE_JOBS_NORMAL,
+    TRACE_QUEUE_JOBS_LOW
+} trace_queue_t;
+
+/**
+ * @brief One event (little-endian, fixed layout)
+ */
+typedef struct {
+    uint32_t timestamp_us;          // esp_timer, wraps after 71 minutes
+    uint8_t  event;                 // trace_event_t
+    uint8_t  core;
+    uint16_t task;                  // FreeRTOS task number, named in the export's task table
+    uint32_t arg0;
+    uint32_t arg1;
+} trace_event_record_t;
+
+/**
+ * @brief Start of an export, followed by task_count task entries and record_count records
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t record_bytes;          // sizeof(trace_event_record_t)
+    uint32_t record_count;          // Oldest first
+    uint32_t overwritten;           // Events lost to the ring wrapping since boot
+    uint16_t task_count;
+    uint16_t task_bytes;            // sizeof(trace_task_entry_t)
+} trace_export_header_t;
+
+/**
+ * @brief Task number to name
+ */
+typedef struct {
+    uint32_t number;
+    char     name[16];
+} trace_task_entry_t;
+
+static_assert(sizeof(trace_event_record_t) == 16, "trace event layout changed");
+static_assert(sizeof(trace_export_header_t) == 20, "trace export header layout changed");
+static_assert(sizeof(trace_task_entry_t) == 20, "trace task entry layout changed");
+
+#if EVENT_TRACE_ENABLED
+#define TRACE_EVENT(event, arg0, arg1) event_trace_record((event), (arg0), (arg1))
+#else
+#define TRACE_EVENT(event, arg0, arg1) ((void)0)
+#endif
+
+/**
+ * @brief Start tracing; call first in setup(), before anything traces
+ * @param keep_previous The last boot crashed: keep what its ring held
+ * @return true if a crashed boot's events were kept
+ *
+ * The ring survives a panic, watchdog or software reset in .noinit. Kept
+ * events move to PSRAM for event_trace_postmortem_read(); the ring then
+ * starts over for this boot.
+ */
+bool event_trace_init(bool keep_previous);
+
+/**
+ * @brief Append one event; task context only
+ *
+ * Claims a slot with a single atomic increment and fills it, so any task
+ * on either core may trace without a lock. The oldest events are
+ * overwritten once the ring is full.
+ */
+void event_trace_record(trace_event_t event, uint32_t arg0, uint32_t arg1);
+
+/**
+ * @brief Pause tracing and take a consistent view of the ring for export
+ * @return Size of the export in bytes, 0 if another export is in progress
+ */
+size_t event_trace_freeze(void);
+
+/**
+ * @brief Copy part of the frozen export: header, task table, then records oldest first
+ * @return Bytes copied
+ */
+size_t event_trace_read(size_t offset, uint8_t* out, size_t length);
+
+/**
+ * @brief End an export and resume tracing
+ */
+void event_trace_thaw(void);
+
+/**
+ * @brief Write the ring to the serial port as "@@EVT" hex lines
+ *
+ * tools/trace/trace_to_perfetto.py reads them out of a captured log.
+ */
+void event_trace_dump_serial(void);
+
+/**
+ * @brief Write the ring to EVENT_TRACE_SD_FILE on the SD card
+ * @return false if there is no card or an export is in progress
+ */
+bool event_trace_save_sd(void);
+
+/**
+ * @brief Name the tasks in the crash export, once this boot's tasks exist
+ * @return true once done; false with no crash export, or while an export holds the task table
+ */
+bool event_trace_postmortem_seal(void);
+
+/**
+ * @brief Size of the crash export, in the format of a live one; 0 with none or unsealed
+ */
+size_t event_trace_postmortem_size(void);
+
+/**
+ * @brief Copy part of the crash export (safe from any task)
+ * @return Bytes copied
+ */
+size_t event_trace_postmortem_read(size_t offset, uint8_t* out, size_t length);
+
+/**
+ * @brief Free the crash export; not while it is being read
+ */
+void event_trace_postmortem_drop(void);
+
+#endif // EVENT_TRACE_H
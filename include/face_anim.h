@@ -0,0 +1,36 @@
+#ifndef FACE_ANIM_H
+#define FACE_ANIM_H
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "ai_states.h"
+
+/**
+ * @brief Drive the face image: blinks, breathing and expression morphs
+ *
+ * Every motion is an eased lv_anim_t scheduled one at a time, so between a
+ * blink and the next breath no animation exists and LVGL has nothing to
+ * redraw. Animations are time based: frames the renderer drops are simply
+ * not seen, the motion still ends on time.
+ */
+void face_anim_init(lv_obj_t* face_img, ai_state_t state);
+
+/**
+ * @brief Morph to another expression: eyes close, the face swaps, eyes reopen
+ */
+void face_anim_set_state(ai_state_t state);
+
+/**
+ * @brief Start blinks and breaths that are due; call once per frame
+ */
+void face_anim_update(uint32_t now_ms);
+
+/**
+ * @brief Time until face_anim_update() has an animation to start
+ *
+ * Running animations are timed by LVGL's own anim timer and not counted.
+ * @return ms until the next blink or breath is due, UINT32_MAX for none
+ */
+uint32_t face_anim_quiet_ms(uint32_t now_ms);
+
+#endif // FACE_ANIM_H
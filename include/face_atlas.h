@@ -0,0 +1,39 @@
+#ifndef FACE_ATLAS_H
+#define FACE_ATLAS_H
+
+#include <lvgl.h>
+
+// Generated into src/generated/face_atlas.c by tools/face_atlas/gen_face_atlas.py
+#define FACE_ATLAS_STATES   8       // One row per ai_state_t, in enum order
+#define FACE_ATLAS_FRAMES   4       // Eyelid steps, open to shut
+#define FACE_FRAME_OPEN     0
+#define FACE_FRAME_BLINK    (FACE_ATLAS_FRAMES - 1)
+#define FACE_ATLAS_WIDTH    200
+#define FACE_ATLAS_HEIGHT   150
+#define FACE_ICON_WIDTH     24
+#define FACE_ICON_HEIGHT    18
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Prerendered face frames in flash, indexed [state][frame]
+ *
+ * 2-bit indexed images: switching expression is one lv_img_set_src() and
+ * redraws a single 200x150 area, with nothing resized or restyled.
+ */
+extern const lv_img_dsc_t* const face_atlas[FACE_ATLAS_STATES][FACE_ATLAS_FRAMES];
+
+/**
+ * @brief Open face of each state at status-bar size, indexed [state]
+ *
+ * Stands in for ai_state_to_emoji() on screen: the UI fonts have no emoji.
+ */
+extern const lv_img_dsc_t* const face_icons[FACE_ATLAS_STATES];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FACE_ATLAS_H
@@ -0,0 +1,95 @@
+#ifndef FIRMWARE_UPDATE_H
+#define FIRMWARE_UPDATE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define FIRMWARE_PATCH_MAGIC   0x31504448   // "HDP1"
+#define FIRMWARE_PATCH_VERSION 1
+
+/**
+ * @brief Start of a patch file, followed by the zlib-compressed records
+ *
+ * Each record is a control triple (add_len, copy_len, seek; little-endian
+ * u32, u32, i32), then add_len bytes added to the running image from the
+ * current base offset, then copy_len bytes taken as they are; the base
+ * offset then moves by seek. Written by tools/ota/make_patch.py.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;                 // FIRMWARE_PATCH_MAGIC
+    uint16_t version;               // FIRMWARE_PATCH_VERSION
+    uint16_t flags;                 // Reserved, 0
+    uint32_t base_size;             // Image the patch applies to
+    uint32_t target_size;           // Image it produces
+    uint8_t  base_sha256[32];
+    uint8_t  target_sha256[32];
+} firmware_patch_header_t;
+
+static_assert(sizeof(firmware_patch_header_t) == 80, "Patch header layout changed");
+
+/**
+ * @brief Where the update is
+ */
+typedef enum {
+    FIRMWARE_UPDATE_IDLE = 0,
+    FIRMWARE_UPDATE_DOWNLOADING,
+    FIRMWARE_UPDATE_RESUMING,       // Connection dropped, waiting to ask for the rest
+    FIRMWARE_UPDATE_READY,          // Verified and set to boot
+    FIRMWARE_UPDATE_FAILED
+} firmware_update_phase_t;
+
+/**
+ * @brief Progress of the current or last update
+ */
+typedef struct {
+    firmware_update_phase_t phase;
+    uint32_t patch_bytes;           // Patch length, 0 until the server reports it
+    uint32_t received;              // Patch bytes taken so far
+    uint32_t written;               // Image bytes written to the inactive slot
+    uint32_t target_size;
+    uint16_t resumes;               // Connections picked up where the last one dropped
+    uint32_t updates;               // Images verified and set to boot since power-on
+    uint32_t failures;
+    const char* error;              // Why the last update failed, "" if it did not
+} firmware_update_status_t;
+
+/**
+ * @brief Create the update task; it waits for firmware_update_start()
+ * @return false if the task could not be created
+ */
+bool firmware_update_init(void);
+
+/**
+ * @brief Pull a patch from url and apply it to the inactive app slot
+ *
+ * The patch is fetched over HTTP and inflated, applied against the
+ * running image and written to the inactive slot as it arrives, with the
+ * image's SHA-256 computed along the way. A dropped connection is resumed
+ * with a Range request from the last byte taken, up to
+ * FIRMWARE_UPDATE_RETRIES times in a row without progress. An image whose
+ * hash matches is set to boot and, with FIRMWARE_UPDATE_AUTO_REBOOT, run.
+ * Without it the image stays staged until a reboot, and a later start
+ * replaces it.
+ * @param url http:// address of the patch
+ * @param target_sha256 Hash the image must have, from a source other than
+ *        the patch itself; NULL trusts the patch header
+ * @return false if an update is already running or the URL is too long
+ */
+bool firmware_update_start(const char* url, const uint8_t* target_sha256);
+
+/**
+ * @brief An update is downloading, resuming or about to restart
+ */
+bool firmware_update_in_progress(void);
+
+/**
+ * @brief Copy the progress of the current or last update
+ */
+void firmware_update_get_status(firmware_update_status_t* status);
+
+/**
+ * @brief Short phase name for logs and the status route
+ */
+const char* firmware_update_phase_name(firmware_update_phase_t phase);
+
+#endif // FIRMWARE_UPDATE_H
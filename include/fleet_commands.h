@@ -0,0 +1,145 @@
+#ifndef FLEET_COMMANDS_H
+#define FLEET_COMMANDS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+
+/**
+ * @brief What a command asks for
+ */
+typedef enum {
+    FLEET_CMD_PROFILE = 0,          // Pin a scan profile by name, or "auto" to follow the governor
+    FLEET_CMD_MODEL,                // "swap": the other model slot back in force
+    FLEET_CMD_DUMP,                 // Event trace to the SD card
+    FLEET_CMD_REBOOT,               // Restart, or "survey" to come back up in survey mode
+    FLEET_CMD_RAW,                  // Raw telemetry beside the summaries for <minutes>, 0 to stop
+    FLEET_CMD_COUNT
+} fleet_cmd_t;
+
+/**
+ * @brief How a command ended, as acknowledged
+ */
+typedef enum {
+    FLEET_ACK_OK = 0,
+    FLEET_ACK_FAILED,               // Understood, but it did not take
+    FLEET_ACK_REJECTED,             // Unknown command or argument
+    FLEET_ACK_UNSUPPORTED,          // Not in this build
+    FLEET_ACK_DUPLICATE,            // Id already applied, e.g. a redelivery
+    FLEET_ACK_OVERFLOW,             // Queue full when it arrived
+    FLEET_ACK_RESULTS
+} fleet_ack_result_t;
+
+/**
+ * @brief Where a command came from
+ */
+typedef enum {
+    FLEET_SOURCE_MQTT = 0,
+    FLEET_SOURCE_HTTP,
+    FLEET_SOURCES
+} fleet_source_t;
+
+/**
+ * @brief One acknowledgement
+ */
+typedef struct {
+    uint32_t id;
+    uint8_t  result;                // fleet_ack_result_t
+    uint8_t  source;                // fleet_source_t
+    uint16_t reserved;
+    uint32_t done_ms;               // Uptime it was applied or refused
+} fleet_ack_t;
+
+/**
+ * @brief Channel figures since boot
+ */
+typedef struct {
+    uint32_t received;
+    uint32_t applied;               // Acknowledged ok
+    uint32_t refused;               // Acknowledged anything else
+    uint32_t duplicates;
+    uint32_t ack_batches;           // Acknowledgement messages sent
+    uint32_t acks_sent;
+    uint32_t last_id;               // Highest id applied, kept across reboots
+    uint8_t  queued;                // Waiting for the end of a cycle
+    uint8_t  acks_pending;          // Not yet sent
+    bool     reboot_pending;
+} fleet_status_t;
+
+/*
+ * A command channel for units deployed in numbers. Commands arrive as
+ * text lines "<id> <command> [argument]", any number to an MQTT message
+ * on <MQTT_TOPIC_PREFIX>/<station MAC>/commands, or one per POST to
+ * FLEET_PATH with id=, cmd= and arg=. They are queued on arrival and
+ * applied by the scan task at the end of its next cycle, where nothing
+ * is half-done: a scan profile change then governs the whole next cycle.
+ *
+ * Ids rise per unit, as the fleet manager hands them out. The highest
+ * applied is kept in the journal (NVS without one), and a command at or
+ * below it is acknowledged as a duplicate without being run again, so a
+ * redelivery or a retained message never reboots a unit twice.
+ *
+ * Acknowledgements collect until FLEET_ACK_BATCH of them are waiting or
+ * the oldest is FLEET_ACK_INTERVAL_MS old, then go out in one QoS 1
+ * message on <prefix>/<MAC>/acks as [[id,"result",uptime_ms],...]. GET
+ * FLEET_PATH returns the channel's figures and the latest of them.
+ */
+
+/**
+ * @brief Restore the highest id applied so far
+ *
+ * Call after journal_init().
+ */
+void fleet_commands_init(void);
+
+/**
+ * @brief Add the command route to the web server
+ */
+void fleet_commands_register(AsyncWebServer* server);
+
+/**
+ * @brief Queue every "<id> <command> [argument]" line of a message (safe from any task)
+ * @return Lines queued; the others are acknowledged at once, ids permitting
+ */
+uint8_t fleet_commands_submit_text(const char* text, size_t length, fleet_source_t source);
+
+/**
+ * @brief Apply the queued commands; the scan task calls this between cycles
+ */
+void fleet_commands_apply(void);
+
+/**
+ * @brief Persist the applied id, then restart if asked, once the acks are out
+ *
+ * Runs on the system task, whose stack a journal write needs.
+ */
+void fleet_commands_tick(uint32_t now_ms);
+
+/**
+ * @brief Whether a batch of acknowledgements is due
+ */
+bool fleet_commands_acks_due(uint32_t now_ms);
+
+/**
+ * @brief Write the waiting acknowledgements as one JSON array
+ * @param count Set to the acks written, for fleet_commands_acks_sent()
+ * @return Bytes written, 0 with none waiting
+ */
+size_t fleet_commands_format_acks(char* out, size_t size, uint8_t* count);
+
+/**
+ * @brief Drop the first count waiting acks once their message is accepted
+ */
+void fleet_commands_acks_sent(uint8_t count);
+
+/**
+ * @brief Copy the channel figures
+ */
+void fleet_commands_get_status(fleet_status_t* status);
+
+/**
+ * @brief Short names for logs, acks and metrics
+ */
+const char* fleet_ack_result_name(fleet_ack_result_t result);
+
+#endif // FLEET_COMMANDS_H
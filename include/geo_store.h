@@ -0,0 +1,151 @@
+#ifndef GEO_STORE_H
+#define GEO_STORE_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+
+#define GEO_INDEX_MAGIC   0x49474848u     // "HHGI"
+#define GEO_INDEX_FORMAT  1
+
+/**
+ * @brief One device heard from one place; cell files are arrays of these
+ */
+typedef struct {
+    int32_t  lat_e7;                // Where the unit was, degrees x 1e7
+    int32_t  lon_e7;
+    uint32_t utc_s;                 // Of the fix
+    uint8_t  mac[6];
+    uint8_t  kind;                  // device_kind_t
+    int8_t   rssi;
+} geo_row_t;
+
+static_assert(sizeof(geo_row_t) == 20, "geo row layout changed");
+
+/**
+ * @brief Directory entry of one cell file
+ */
+typedef struct {
+    uint32_t cell;                  // Geohash of GEO_CELL_PRECISION characters, 5 bits each
+    uint32_t surveyed;              // Bit n: recorded from the child cell whose next character is n
+    uint32_t rows;                  // In the file, or staged for it
+    int32_t  min_lat_e7;            // Bounds of the rows' positions
+    int32_t  max_lat_e7;
+    int32_t  min_lon_e7;
+    int32_t  max_lon_e7;
+    uint32_t last_utc_s;
+} geo_cell_t;
+
+static_assert(sizeof(geo_cell_t) == 32, "geo directory entry layout changed");
+
+/**
+ * @brief Start of GEO_INDEX_FILE; the directory's entries follow, sorted by cell
+ */
+typedef struct {
+    uint32_t magic;                 // GEO_INDEX_MAGIC
+    uint16_t format;                // GEO_INDEX_FORMAT
+    uint16_t cells;
+    uint32_t crc32;                 // Of the entries
+} geo_index_header_t;
+
+/**
+ * @brief Query callback; return false to stop
+ * @param distance_m From the query's centre to where the row was recorded
+ */
+typedef bool (*geo_row_fn)(const geo_row_t* row, uint32_t distance_m, void* context);
+
+/**
+ * @brief What a query read
+ */
+typedef struct {
+    uint32_t rows;                  // Handed to the callback
+    uint16_t cells;                 // Directory entries whose bounds met the query
+    uint16_t cells_read;            // Cell files opened
+    uint32_t bytes_read;
+    bool     truncated;             // More than GEO_QUERY_MAX_CELLS cells met it
+} geo_query_stats_t;
+
+/**
+ * @brief Store figures since boot
+ */
+typedef struct {
+    bool     loaded;                // The card's directory has been read
+    uint16_t cells;
+    uint32_t rows;                  // In every cell, from the directory
+    uint32_t rows_staged;
+    uint32_t rows_dropped;          // Staging full while the previous batch was being written
+    uint32_t rows_capped;           // Cell already at GEO_CELL_MAX_ROWS, or directory full
+    uint32_t cycles_recorded;
+    uint32_t cycles_thinned;        // Parked near the last recorded cycle: new devices only
+    uint32_t batches_written;
+    uint32_t write_failures;
+    uint32_t queries;
+    uint32_t query_bytes_read;
+} geo_store_stats_t;
+
+/*
+ * The survey's sightings indexed by where they were heard. The scan task
+ * stages one row per device seen in a cycle that has a fix, stamped with
+ * the unit's position; a job worker appends each batch to one file per
+ * geohash cell of GEO_CELL_PRECISION characters, GEO_STORE_DIR/<cell>.hgc,
+ * and rewrites the directory in GEO_INDEX_FILE. The directory, sorted by
+ * cell, stays in PSRAM: the bounds of each cell's rows let a radius query
+ * open only the files that can hold a match, a handful for a few hundred
+ * metres, and a bitmap of the 32 child cells answers "surveyed here?"
+ * without touching the card at all. While parked the rows are thinned to
+ * new devices, so a long stop does not fill its cell with repeats.
+ */
+
+/**
+ * @brief Allocate the staging, directory and read buffers in PSRAM
+ * @return true on success, false on allocation failure
+ */
+bool geo_store_init(void);
+
+/**
+ * @brief Stage a row for every device seen in the closing scan cycle, at the current fix
+ *
+ * Called from the scan task, which owns the device table, before the
+ * cycle is closed. Nothing is staged without a fix.
+ * @param cycle device_table_cycle() of the closing cycle
+ */
+void geo_store_record_cycle(uint16_t cycle, uint32_t now_ms);
+
+/**
+ * @brief Whether rows were recorded in the child cell (one more character) of a position
+ *
+ * Reads only the directory; any task.
+ */
+bool geo_store_surveyed(int32_t lat_e7, int32_t lon_e7);
+
+/**
+ * @brief Hand every stored row within a radius of a position to a callback
+ *
+ * Reads the files of the cells whose bounds come within the radius, in
+ * GEO_READ_ROWS pieces. Takes the SD card's bus per read; not for the
+ * async TCP task. Rows still staged are not seen.
+ * @return false if there is no card or the buffers are missing
+ */
+bool geo_store_query(int32_t lat_e7, int32_t lon_e7, uint32_t radius_m, geo_row_fn fn, void* context,
+                     geo_query_stats_t* out);
+
+/**
+ * @brief Geohash of a position, precision characters and a terminator
+ */
+void geo_store_cell_name(int32_t lat_e7, int32_t lon_e7, uint8_t precision, char* out);
+
+/**
+ * @brief Add GEO_PATH to the web server
+ *
+ * GET reports the directory, whether the position of lat=&lon= (else the
+ * fix) was surveyed, and the last query's result; POST lat=&lon=[&radius=]
+ * runs a query on a job worker.
+ */
+void geo_store_register(AsyncWebServer* server);
+
+/**
+ * @brief Copy the store figures
+ */
+void geo_store_get_stats(geo_store_stats_t* stats);
+
+#endif // GEO_STORE_H
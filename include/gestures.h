@@ -0,0 +1,46 @@
+#ifndef GESTURES_H
+#define GESTURES_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief What a touch amounted to
+ */
+typedef enum {
+    GESTURE_NONE = 0,
+    GESTURE_TAP,                    // Short press, barely moved
+    GESTURE_LONG_PRESS,             // Held GESTURE_LONG_PRESS_MS, reported while still down
+    GESTURE_SWIPE_LEFT,             // Quick travel along the dominant axis
+    GESTURE_SWIPE_RIGHT,
+    GESTURE_SWIPE_UP,
+    GESTURE_SWIPE_DOWN,
+    GESTURE_KINDS
+} gesture_t;
+
+/*
+ * Recognises gestures from the samples LVGL's input read already takes,
+ * one per TOUCH_READ_PERIOD_MS while the pen is down: each costs a couple
+ * of compares, and the classification runs once, on release. A slow drag
+ * is no gesture and stays LVGL's, for scrolling. Every gesture is
+ * published on BUS_TOPIC_INPUT (input_publication_t), which is how the
+ * scan task learns of user interaction. UI task only.
+ */
+
+/**
+ * @brief Fold in one touch sample
+ * @param pressed false once the pen has lifted; x and y are then ignored
+ */
+void gestures_feed(bool pressed, int16_t x, int16_t y, uint32_t now_ms);
+
+/**
+ * @brief Latest gesture not yet acted on, then GESTURE_NONE until the next
+ */
+gesture_t gestures_take(void);
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* gesture_name(gesture_t gesture);
+
+#endif // GESTURES_H
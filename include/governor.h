@@ -0,0 +1,64 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+#include "logger.h"
+#include "scan_profile.h"
+
+/**
+ * @brief What one AI state may spend
+ */
+typedef struct {
+    scan_profile_id_t scan_profile;
+    uint16_t    interval_pct;       // Scan interval, % of the profile's
+    uint16_t    frame_interval_ms;  // Shortest UI frame gap; thermal throttling may lengthen it
+    uint16_t    cpu_min_mhz;        // Floor of the DFS range
+    log_level_t log_level;          // Scan and AI modules
+    uint8_t     backlight_pct;      // Before the hourly schedule and interactions
+} governor_profile_t;
+
+/**
+ * @brief Profile in force and how often it changed
+ */
+typedef struct {
+    ai_state_t         state;
+    governor_profile_t profile;
+    uint32_t           applies;     // Committed transitions since boot
+    uint32_t           applied_ms;
+} governor_status_t;
+
+/**
+ * @brief Budget table entry of an AI state
+ * @return Entry, or the IDLE entry for an invalid state
+ */
+const governor_profile_t* governor_profile_for(ai_state_t state);
+
+/**
+ * @brief Put a state's profile in force; call on each committed transition
+ *
+ * The profile is swapped in as a whole, so a reader never sees half of
+ * one state's budget and half of another's. The scan profile, the CPU
+ * floor and the log levels are pushed to their owners here; the scan
+ * interval and the frame cap are read by their loops on the next pass.
+ * A log level changed over HTTP since the last apply is left alone.
+ */
+void governor_apply(ai_state_t state, uint32_t now_ms);
+
+/**
+ * @brief Scale a scan profile's interval by the state's budget (scan task)
+ */
+uint32_t governor_scan_interval_ms(uint32_t profile_ms);
+
+/**
+ * @brief Shortest UI frame gap of the state in force (UI task)
+ */
+uint32_t governor_frame_interval_ms(void);
+
+/**
+ * @brief Copy the profile in force
+ */
+void governor_get_status(governor_status_t* status);
+
+#endif // GOVERNOR_H
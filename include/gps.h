@@ -0,0 +1,73 @@
+#ifndef GPS_H
+#define GPS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief The receiver's latest position
+ */
+typedef struct {
+    bool     valid;                 // RMC status A and a GGA fix quality above 0
+    int32_t  lat_e7;                // Degrees x 1e7, north positive
+    int32_t  lon_e7;                // Degrees x 1e7, east positive
+    int16_t  alt_m;                 // Above mean sea level, from GGA
+    uint16_t speed_kmh_x10;         // Over ground, from RMC
+    uint8_t  hdop_x10;              // Saturates at 255
+    uint8_t  satellites;
+    uint32_t utc_s;                 // Of the fix, seconds since the epoch; 0 before RMC gave a date
+    uint32_t fix_ms;                // millis() when the fix arrived, 0 for never
+} gps_fix_t;
+
+/**
+ * @brief Receiver traffic since boot
+ */
+typedef struct {
+    bool     running;               // UART up and the task reading it
+    uint32_t bytes;
+    uint32_t sentences;             // Checksum-valid RMC and GGA taken
+    uint32_t ignored;               // Valid sentences of other types
+    uint32_t checksum_errors;
+    uint32_t overlong;              // Lines past NMEA's 82 characters, dropped
+    uint32_t fixes;                 // Valid positions published
+} gps_stats_t;
+
+/*
+ * An optional NMEA receiver on a UART, for mobile surveys. Bytes are
+ * parsed as they arrive, one character at a time, so the reading task
+ * never holds a whole burst and never waits on anything but the UART.
+ * RMC gives position, speed and UTC; GGA fix quality, satellites, HDOP and
+ * altitude. Any talker (GP, GN, GL...) is accepted. Only the fix itself
+ * is shared, under a spinlock; the scan task reads it once per cycle.
+ */
+
+/**
+ * @brief Install the UART driver on BOARD.gps
+ * @return false without GPS pins or if the driver would not install
+ */
+bool gps_init(void);
+
+/**
+ * @brief Read what the UART has and parse it; returns after GPS_READ_TIMEOUT_MS at most
+ *
+ * Called in a loop from the GPS task.
+ */
+void gps_poll(void);
+
+/**
+ * @brief Parse NMEA bytes from any source, e.g. a replayed log
+ */
+void gps_feed(const uint8_t* data, size_t length);
+
+/**
+ * @brief Copy the latest fix
+ * @return false without a valid fix newer than GPS_FIX_STALE_MS
+ */
+bool gps_get_fix(gps_fix_t* fix);
+
+/**
+ * @brief Copy the receiver's figures
+ */
+void gps_get_stats(gps_stats_t* stats);
+
+#endif // GPS_H
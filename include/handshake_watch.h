@@ -0,0 +1,83 @@
+#ifndef HANDSHAKE_WATCH_H
+#define HANDSHAKE_WATCH_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/*
+ * When stations join which networks, for site audits: association and
+ * authentication requests, EAPOL frames and the 4-way handshakes they
+ * make up, per BSSID over a rolling minute. Only frame types and the
+ * EAPOL-Key information bits are looked at; the capture callback copies
+ * EAPOL frames no further than those, so no nonce, MIC or key material is
+ * ever held or exported. A first message carrying key data is counted as
+ * a PMKID offer from its length alone.
+ */
+
+/**
+ * @brief What is counted
+ */
+typedef enum {
+    HANDSHAKE_ASSOC = 0,            // Association requests
+    HANDSHAKE_REASSOC,              // Reassociation requests (roaming)
+    HANDSHAKE_AUTH,                 // Authentication requests from stations
+    HANDSHAKE_EAPOL,                // EAPOL-Key frames, any message
+    HANDSHAKE_COMPLETE,             // 4-way handshakes seen through message 4
+    HANDSHAKE_PARTIAL,              // ... that stopped or timed out before it
+    HANDSHAKE_PMKID,                // Message 1 carrying key data, a PMKID
+    HANDSHAKE_EAP,                  // 802.1X EAP and EAPOL-Start frames (enterprise)
+    HANDSHAKE_COUNTER_COUNT
+} handshake_counter_t;
+
+/**
+ * @brief Counts over the rolling window and since boot
+ */
+typedef struct {
+    uint16_t window[HANDSHAKE_COUNTER_COUNT];   // Over the last HANDSHAKE_BUCKETS steps
+    uint32_t total[HANDSHAKE_COUNTER_COUNT];
+    uint16_t bssids;                // With anything counted in the window
+    uint8_t  busiest_bssid[6];      // Most associations and EAPOL frames in the window
+    uint16_t busiest_count;
+    uint32_t evicted;               // BSSIDs whose slot went to another with counts still in the window
+    uint32_t window_ms;             // Span of the window
+} handshake_stats_t;
+
+/**
+ * @brief Clear every BSSID and count (capture task)
+ */
+void handshake_watch_init(void);
+
+/**
+ * @brief Count an association, reassociation or authentication frame (capture task)
+ * @param subtype Management frame subtype; others are ignored
+ * @param station Transmitter address
+ * @param bssid Address 3
+ */
+void handshake_watch_observe_mgmt(uint8_t subtype, const uint8_t* station, const uint8_t* bssid,
+                                  uint32_t now_ms);
+
+/**
+ * @brief Count an EAPOL frame and follow its 4-way handshake (capture task)
+ * @param eapol First byte after the LLC/SNAP header
+ * @param len Bytes available from there
+ * @param from_ap Sent by the access point, FromDS
+ */
+void handshake_watch_observe_eapol(const uint8_t* eapol, uint8_t len, const uint8_t* station,
+                                   const uint8_t* bssid, bool from_ap, uint32_t now_ms);
+
+/**
+ * @brief Step the rolling window and close stale handshakes; with each capture window
+ */
+void handshake_watch_roll(uint32_t now_ms);
+
+/**
+ * @brief Copy the figures of the last roll
+ */
+void handshake_watch_get_stats(handshake_stats_t* stats);
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* handshake_counter_name(handshake_counter_t counter);
+
+#endif // HANDSHAKE_WATCH_H
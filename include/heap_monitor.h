@@ -0,0 +1,59 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Heap capability classes, each possibly spanning several regions
+ */
+typedef enum {
+    HEAP_REGION_INTERNAL = 0,       // MALLOC_CAP_INTERNAL
+    HEAP_REGION_DMA,                // MALLOC_CAP_DMA
+    HEAP_REGION_PSRAM,              // MALLOC_CAP_SPIRAM
+    HEAP_REGION_8BIT,               // MALLOC_CAP_8BIT, internal and PSRAM
+    HEAP_REGION_32BIT,              // MALLOC_CAP_32BIT, includes IRAM
+    HEAP_REGION_COUNT
+} heap_region_t;
+
+/**
+ * @brief One capability class at the last sample, with its trend
+ *
+ * The fragmentation index is the share of free memory outside the largest
+ * free block: 0 when all of it is one block. Trends are the change over
+ * the HEAP_TREND_POINTS samples on record, scaled to an hour; a falling
+ * largest block with steady free space is fragmentation, not a leak.
+ */
+typedef struct {
+    uint32_t total_free;
+    uint32_t largest_free;
+    uint32_t min_largest_free;      // Least largest block at any sample
+    uint32_t min_free;              // Least free memory since boot (heap watermark)
+    uint32_t free_blocks;
+    uint32_t allocated_blocks;
+    uint8_t  frag_pct;
+    uint8_t  max_frag_pct;          // Worst index at any sample
+    uint16_t trend_points;          // Samples the trends span
+    int32_t  free_trend_per_hour;   // Bytes
+    int32_t  largest_trend_per_hour;
+} heap_region_stats_t;
+
+/**
+ * @brief Walk every capability class's heaps; call once per monitoring cycle
+ *
+ * Only samples every HEAP_SAMPLE_MS, as each walk takes the heap locks,
+ * and records a trend point every HEAP_TREND_INTERVAL_MS.
+ */
+void heap_monitor_sample(uint32_t now_ms);
+
+/**
+ * @brief Figures of one capability class, as last sampled
+ */
+void heap_monitor_get(heap_region_t region, heap_region_stats_t* stats);
+
+/**
+ * @brief Short name for logs ("internal", "dma", ...)
+ */
+const char* heap_monitor_region_name(heap_region_t region);
+
+#endif // HEAP_MONITOR_H
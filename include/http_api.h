@@ -0,0 +1,141 @@
+#ifndef HTTP_API_H
+#define HTTP_API_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+
+/**
+ * @brief Routes with a request budget of their own
+ */
+typedef enum {
+    HTTP_API_ROUTE_STATE = 0,
+    HTTP_API_ROUTE_METRICS,
+    HTTP_API_ROUTE_DEVICES,
+    HTTP_API_ROUTE_HISTORY,
+    HTTP_API_ROUTE_OPENMETRICS,
+    HTTP_API_ROUTE_OTHER,           // The older JSON routes on the same server
+    HTTP_API_ROUTE_COUNT
+} http_api_route_t;
+
+/**
+ * @brief API figures since boot
+ */
+typedef struct {
+    uint32_t served;                // Responses started, by route
+    uint32_t state;
+    uint32_t metrics;
+    uint32_t sensor;
+    uint32_t devices;
+    uint32_t history;
+    uint32_t openmetrics;
+    uint32_t location;
+    uint32_t states;
+    uint32_t busy;                  // Turned away with every buffer in use, or every heavy one
+    uint32_t limited;               // Turned away 429 with the route's bucket empty
+    uint32_t unauthorized;          // Turned away 401 without a known key
+    uint32_t key_limited;           // Turned away 429 over their key's quota
+    uint32_t deferred;              // Chunk fills handed to a job worker
+    uint32_t inline_fills;          // Filled on the TCP task, the job pool being full
+    uint32_t waits;                 // Sends put off with no chunk staged yet
+    uint32_t overflowed;            // Documents larger than HTTP_API_TEXT_BYTES
+    uint8_t  buffers_in_use;
+    uint8_t  heavy_streams;         // Chunked responses open now
+} http_api_stats_t;
+
+/**
+ * @brief One key's quota and use since boot
+ */
+typedef struct {
+    char     name[HTTP_API_KEY_NAME_BYTES];
+    uint32_t requests_per_min;      // Quotas, 0 for none
+    uint32_t kib_per_min;
+    uint8_t  stream_max;
+    uint8_t  streams;               // Streamed responses open now
+    uint32_t requests;              // Admitted
+    uint32_t limited;               // 429 over its request or byte quota
+    uint32_t stream_refusals;       // 429 with its streams all open
+    uint32_t bytes;                 // Body bytes sent from the API buffers
+} http_api_key_stats_t;
+
+/**
+ * @brief Put the HTTP_API_KEYS check in front of every route; before any route is added
+ *
+ * With keys set, a request reaching the server through the station link
+ * without one of their secrets, in HTTP_API_KEY_HEADER or as ?key=, is
+ * answered 401 whatever its route. The SoftAP side (the provisioning
+ * portal) is left to its WPA2 key.
+ */
+void http_api_guard(AsyncWebServer* server);
+
+/**
+ * @brief Add the API routes to a server
+ *
+ * GET HTTP_API_PREFIX "/state" reports the committed AI state and the
+ * latest sensor data, "/sensor" the sensor data alone as JSON, CBOR
+ * (?format=cbor) or the packed struct (?format=packed), "/metrics" the bus topics, the capture and system
+ * publications and inference latency, "/devices" the device table
+ * (?kind=wifi|ble) and "/history" one metric's history as
+ * [end_ms,min,avg,max] points, with the parameters of HISTORY_PATH
+ * uncapped. Both take ?since=<ms> to return only devices seen, or points
+ * ended, after that millis(). "/location" reports where the last WiFi
+ * cycle places the unit and the learned places; POST "/location/learn"
+ * with label= (and cycles=) fingerprints the next cycles as that place,
+ * and POST "/location/forget" with label= deletes one. "/states" reports
+ * the time spent in each committed AI state and the transition matrix,
+ * and POST "/states/reset" starts them over. Every body is written into one of
+ * HTTP_API_BUFFERS PSRAM buffers taken at registration, so a request
+ * allocates nothing for its payload; with all of them in use, or
+ * HTTP_API_HEAVY_STREAMS of them streaming devices, history or scrapes,
+ * the request is answered 503. Each route is rate limited first (see
+ * http_api_admit()), and streamed bodies are staged by a low-lane job
+ * rather than on the TCP task.
+ * @return false if the buffers could not be allocated
+ */
+bool http_api_register(AsyncWebServer* server);
+
+/**
+ * @brief Take one request from a route's budget, or answer it 429
+ *
+ * Each route has a token bucket shared by every client, holding
+ * HTTP_API_RATE_BURST requests and refilled at the route's
+ * HTTP_API_RATE_* per second. An empty bucket answers the request 429
+ * with a Retry-After, before any work is done for it.
+ *
+ * With HTTP_API_KEYS set, the request must first carry one of its
+ * secrets (see http_api_guard()) or is answered 401, and is then held to
+ * that key's quotas: requests and KiB of body per minute, each a bucket
+ * holding HTTP_API_KEY_BURST_S seconds of it, and streamed responses
+ * open at once. A key over its quota is answered 429 before it takes
+ * from the route's bucket, so one heavy client runs out of its own
+ * budget and not everyone's.
+ * @return false if the request has been answered
+ */
+bool http_api_admit(AsyncWebServerRequest* request, http_api_route_t route);
+
+/**
+ * @brief Stream the monitors' figures as OpenMetrics text, from one of the API buffers
+ *
+ * System metrics, per-task CPU and stack headroom, heap regions, scan
+ * counts, loop timings, the inference latency histogram and display
+ * refresh times, copied once and written a few families at a time.
+ */
+void http_api_send_openmetrics(AsyncWebServerRequest* request);
+
+/**
+ * @brief Copy the API figures
+ */
+void http_api_get_stats(http_api_stats_t* stats);
+
+/**
+ * @brief Keys parsed from HTTP_API_KEYS at registration
+ */
+uint8_t http_api_key_count(void);
+
+/**
+ * @brief Copy one key's quota and figures
+ * @return false if there is no such key
+ */
+bool http_api_get_key_stats(uint8_t index, http_api_key_stats_t* stats);
+
+#endif // HTTP_API_H
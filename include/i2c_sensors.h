@@ -0,0 +1,53 @@
+#ifndef I2C_SENSORS_H
+#define I2C_SENSORS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Sensors the registry knows, one driver each
+ */
+typedef enum {
+    I2C_SENSOR_CLIMATE = 0,         // SHT3x temperature and humidity
+    I2C_SENSOR_LIGHT,               // BH1750 ambient light
+    I2C_SENSOR_MOTION,              // LIS3DH acceleration, shared with wake_sources
+    I2C_SENSOR_BATTERY,             // MAX17048 fuel gauge
+    I2C_SENSOR_COUNT
+} i2c_sensor_id_t;
+
+/**
+ * @brief One sensor's traffic since boot
+ */
+typedef struct {
+    const char* name;
+    bool     present;
+    uint16_t period_ms;
+    uint32_t reads;
+    uint32_t failures;              // Transactions not acknowledged or failing a check
+    uint32_t last_read_ms;
+    uint32_t max_read_us;           // Longest transaction
+} i2c_sensor_stats_t;
+
+/**
+ * @brief Probe and configure each registered sensor; call after Wire.begin()
+ *
+ * Probing runs on the calling task; after this the bus is only touched
+ * from a job pool worker.
+ */
+void i2c_sensors_init(void);
+
+/**
+ * @brief Publish what the last batch read and start a batch for the sensors due
+ *
+ * Never waits on the bus: the reads run as one job on the low lane, and a
+ * batch still in flight holds the next one back. Call once per monitoring
+ * cycle from the system task, the writer of BUS_TOPIC_I2C.
+ */
+void i2c_sensors_tick(uint32_t now_ms);
+
+/**
+ * @brief Copy one sensor's figures
+ */
+void i2c_sensors_get_stats(i2c_sensor_id_t sensor, i2c_sensor_stats_t* stats);
+
+#endif // I2C_SENSORS_H
@@ -0,0 +1,65 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+
+/**
+ * @brief Traffic through the decoded-image cache since boot
+ */
+typedef struct {
+    uint32_t bytes;                 // Held in PSRAM now
+    uint8_t  entries;               // Images held
+    uint32_t hits;
+    uint32_t misses;                // Placeholder shown, load submitted
+    uint32_t loads;                 // Files read and checked
+    uint32_t reloads;               // ... because the file's mtime changed
+    uint32_t failures;              // Missing, unreadable or not an LVGL image
+    uint32_t evictions;
+    uint32_t rejected;              // No free entry or the job pool was full
+    uint32_t max_load_us;
+} image_cache_stats_t;
+
+/*
+ * Images on the SD card in LVGL's binary format (an lv_img_header_t, then
+ * the pixels, as LVGL's image converter writes them) for themable faces
+ * and icons. A load runs on the job pool into PSRAM; the object shows its
+ * placeholder meanwhile and gets the image on the UI task's next frame.
+ * Entries are keyed by path and hold the file's mtime, which is checked
+ * again every IMAGE_CACHE_RECHECK_MS while the image is in use. The least
+ * recently used image no object shows is evicted once the cache holds more
+ * than IMAGE_CACHE_BYTES. UI task only, except where noted.
+ */
+
+/**
+ * @brief Show an image from the card on an lv_img object
+ *
+ * A cached image is set at once. Otherwise the placeholder is set, a load
+ * is submitted and the object is given the image when it arrives; deleting
+ * the object cancels that.
+ * @param path Absolute path on the card, shorter than IMAGE_CACHE_PATH_BYTES
+ * @param placeholder Any lv_img source, NULL for none
+ * @return true if the image itself is on screen
+ */
+bool image_cache_set_src(lv_obj_t* img, const char* path, const void* placeholder);
+
+/**
+ * @brief Hand finished loads to their objects and evict down to the budget
+ *
+ * Call once per frame; cheap when nothing has finished.
+ */
+void image_cache_poll(uint32_t now_ms);
+
+/**
+ * @brief Drop every image no object shows
+ * @return Bytes freed
+ */
+size_t image_cache_release(void);
+
+/**
+ * @brief Copy the cache's figures; safe from any task
+ */
+void image_cache_get_stats(image_cache_stats_t* stats);
+
+#endif // IMAGE_CACHE_H
@@ -0,0 +1,59 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Job priority lanes; workers always drain higher lanes first
+ */
+typedef enum {
+    JOB_LANE_HIGH = 0,              // Short and latency-sensitive, e.g. a model load
+    JOB_LANE_NORMAL,
+    JOB_LANE_LOW,                   // Logging, summaries, housekeeping
+    JOB_LANE_COUNT
+} job_lane_t;
+
+/**
+ * @brief Job body; runs on a worker task with the payload copied at submit time
+ */
+typedef void (*job_fn_t)(void* payload);
+
+/**
+ * @brief Traffic through one lane since boot
+ */
+typedef struct {
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t rejected;              // No free descriptor or lane full
+    uint32_t max_wait_us;           // Submit to start
+    uint32_t max_run_us;
+} job_lane_stats_t;
+
+/**
+ * @brief Create the descriptor pool, the lanes and the worker tasks
+ * @return true on success, false on failure
+ */
+bool job_pool_init(void);
+
+/**
+ * @brief Hand a job to the workers without blocking
+ *
+ * Takes a preallocated descriptor, copies the payload into it and queues
+ * it; O(1) and safe from any task.
+ * @param payload Copied, at most JOB_PAYLOAD_BYTES; may be NULL
+ * @return false if no descriptor is free, the lane is full or the payload is too big
+ */
+bool job_pool_submit(job_lane_t lane, job_fn_t fn, const void* payload, size_t length);
+
+/**
+ * @brief Copy one lane's figures
+ */
+void job_pool_get_stats(job_lane_t lane, job_lane_stats_t* stats);
+
+/**
+ * @brief Short name for logs ("high", "normal", "low")
+ */
+const char* job_pool_lane_name(job_lane_t lane);
+
+#endif // JOB_POOL_H
@@ -0,0 +1,104 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define JOURNAL_SECTOR_MAGIC  0x4C4A4848    // "HHJL"
+#define JOURNAL_UNIT          32            // Records are padded to a multiple of this
+
+/**
+ * @brief Start of every sector in use
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;              // Order the sectors were taken in, from 1
+    uint32_t crc32;                 // Of magic and sequence
+    uint32_t reserved;
+} journal_sector_header_t;
+
+/**
+ * @brief Start of every record, followed by its key and value (little-endian, fixed layout)
+ *
+ * The record is written with state JOURNAL_STATE_WRITTEN, then the state
+ * byte alone is programmed to JOURNAL_STATE_COMMITTED. Both only clear
+ * bits, so neither needs an erase, and a record cut off in either phase
+ * is skipped by the replay.
+ */
+typedef struct {
+    uint8_t  state;                 // journal_record_state_t
+    uint8_t  flags;                 // JOURNAL_FLAG_*
+    uint8_t  key_length;            // Without a terminator
+    uint8_t  reserved;
+    uint16_t value_length;
+    uint16_t reserved2;
+    uint32_t generation;            // Store-wide, one up per commit
+    uint32_t crc32;                 // Of the record with state 0xFF and this field 0, key and value included
+} journal_record_header_t;
+
+static_assert(sizeof(journal_sector_header_t) == 16, "journal sector header layout changed");
+static_assert(sizeof(journal_record_header_t) == 16, "journal record header layout changed");
+
+#define JOURNAL_STATE_ERASED     0xFF
+#define JOURNAL_STATE_WRITTEN    0xFE   // Phase one: key and value on flash, not yet in force
+#define JOURNAL_STATE_COMMITTED  0xFC   // Phase two: in force
+#define JOURNAL_FLAG_ERASE       0x01   // A tombstone: the key no longer exists
+
+/**
+ * @brief Store figures since boot
+ */
+typedef struct {
+    bool     mounted;
+    uint8_t  sectors;
+    uint8_t  sectors_free;          // Erased and ready
+    uint16_t keys;
+    uint32_t generation;
+    uint32_t replayed;              // Committed records applied at boot
+    uint32_t torn;                  // Records cut off by a power loss, skipped at boot
+    uint32_t replay_us;
+    uint32_t commits;
+    uint32_t failures;
+    uint32_t reclaimed;             // Sectors compacted and erased
+    uint32_t last_commit_us;
+    uint32_t max_commit_us;
+} journal_stats_t;
+
+/**
+ * @brief Find the journal partition and replay it into the RAM index
+ *
+ * Reads every sector once, so it takes time proportional to the journal,
+ * not to the number of keys ever written.
+ * @return false if there is no journal partition
+ */
+bool journal_init(void);
+
+/**
+ * @brief Write a value under a key and commit it before returning
+ *
+ * A power cut at any point leaves either the old value or the new one.
+ * Writes flash with the cache off, so the caller's stack must be in
+ * internal RAM.
+ * @param key At most JOURNAL_KEY_BYTES - 1 characters
+ * @param length At most JOURNAL_VALUE_MAX bytes
+ * @return false if the store is not mounted, full, or the write failed
+ */
+bool journal_put(const char* key, const void* value, size_t length);
+
+/**
+ * @brief Read the committed value of a key
+ * @return Its length, or 0 if the key is missing or size is too small
+ */
+size_t journal_get(const char* key, void* value, size_t size);
+
+/**
+ * @brief Remove a key by committing a tombstone
+ * @return true if the key is gone
+ */
+bool journal_erase(const char* key);
+
+/**
+ * @brief Copy the store figures
+ */
+void journal_get_stats(journal_stats_t* stats);
+
+#endif // JOURNAL_H
@@ -0,0 +1,93 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/*
+ * Scan-to-display latency. A scan cycle in which a device appears opens
+ * a trace, and its id travels with the work it caused: in the cycle's
+ * scan event to the AI task, in the AI state publication to the UI task,
+ * and to the renderer until the frame that shows the new face is
+ * flushed. Each hand-off marks a stage, and the time since the previous
+ * mark goes into that stage's histogram. A decision that commits no new
+ * state ends its trace there, as held: the face had nothing to show.
+ */
+
+/**
+ * @brief Steps of a trace, in the order they are marked
+ */
+typedef enum {
+    LATENCY_STAGE_OBSERVE = 0,      // Heard on air to folded into the device table (scan task)
+    LATENCY_STAGE_FEATURES,         // Folded to the cycle's features published
+    LATENCY_STAGE_INFERENCE,        // Published to the AI task's decision
+    LATENCY_STAGE_COMMIT,           // Decision to the state committed and published
+    LATENCY_STAGE_UI,               // Published to the UI task showing the state
+    LATENCY_STAGE_FLUSH,            // Shown to the last band of its frame flushed
+    LATENCY_STAGE_TOTAL,            // Heard on air to flushed, completed traces only
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+/**
+ * @brief How a trace ended short of the display
+ */
+typedef enum {
+    LATENCY_END_HELD = 0,           // The decision committed no new state
+    LATENCY_END_COALESCED           // A newer trace was taken up in its place
+} latency_end_t;
+
+// Octave edges of the stage histograms: 1 ms, 2 ms, ... 32.768 s
+#define LATENCY_TRACE_OCTAVES 16
+
+/**
+ * @brief One stage's latency since boot
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t avg_us;
+    uint32_t max_us;
+    uint32_t p50_ms;                // Upper edge of the octave holding the quantile
+    uint32_t p99_ms;
+    uint64_t sum_us;
+    uint32_t cumulative[LATENCY_TRACE_OCTAVES];     // Marks under 1 ms, under 2 ms, ...
+} latency_stage_stats_t;
+
+/**
+ * @brief Every stage and how the traces ended
+ */
+typedef struct {
+    latency_stage_stats_t stages[LATENCY_STAGE_COUNT];
+    uint32_t started;
+    uint32_t completed;             // Reached the display
+    uint32_t held;
+    uint32_t coalesced;
+    uint32_t lost;                  // Slot taken by a newer trace before the trace ended
+} latency_trace_stats_t;
+
+/**
+ * @brief Open a trace for a device heard at seen_ms and mark its observe stage (scan task)
+ * @return Trace id, never 0; 0 with LATENCY_TRACE_ENABLED off
+ */
+uint16_t latency_trace_begin(uint32_t seen_ms);
+
+/**
+ * @brief Mark the end of a stage; any task. Does nothing for trace 0 or one already ended.
+ */
+void latency_trace_mark(uint16_t trace, latency_stage_t stage);
+
+/**
+ * @brief End a trace short of the display; any task
+ */
+void latency_trace_end(uint16_t trace, latency_end_t reason);
+
+/**
+ * @brief Copy the figures
+ */
+void latency_trace_get(latency_trace_stats_t* stats);
+
+/**
+ * @brief Short name for logs and metrics ("observe", "features", ...)
+ */
+const char* latency_stage_name(latency_stage_t stage);
+
+#endif // LATENCY_TRACE_H
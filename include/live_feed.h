@@ -0,0 +1,54 @@
+#ifndef LIVE_FEED_H
+#define LIVE_FEED_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief What a feed line reports
+ */
+typedef enum {
+    LIVE_FEED_DEVICE = 0,           // A device appeared
+    LIVE_FEED_ROGUE_AP,             // A rogue access point pattern (ap_anomaly.h)
+    LIVE_FEED_STATE,                // The AI state changed
+    LIVE_FEED_NOTICE,               // The unit itself: the provisioning portal opened or closed
+    LIVE_FEED_KINDS
+} live_feed_kind_t;
+
+/**
+ * @brief One preformatted line
+ */
+typedef struct {
+    uint32_t sequence;              // 1 for the first line since boot
+    uint32_t timestamp_ms;
+    uint8_t  kind;                  // live_feed_kind_t
+    char     text[LIVE_FEED_TEXT_BYTES];
+} live_feed_entry_t;
+
+/*
+ * The latest LIVE_FEED_ENTRIES interesting events as ready-made text, for
+ * the ticker screen. The AI task, which drains the scan event queue and
+ * commits state changes, writes nearly all of them; the system task adds
+ * the odd notice about the unit itself. Lines are formatted once, by the
+ * writer, and the UI only copies them. A reader that falls more than the
+ * ring behind skips what was overwritten.
+ */
+
+/**
+ * @brief Format a line into the ring, overwriting the oldest (safe from any task)
+ */
+void live_feed_post(live_feed_kind_t kind, uint32_t now_ms, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief Sequence of the newest line, 0 while the feed is empty; safe from any task
+ */
+uint32_t live_feed_sequence(void);
+
+/**
+ * @brief Copy a line by sequence
+ * @return false if it was never posted or has been overwritten
+ */
+bool live_feed_read(uint32_t sequence, live_feed_entry_t* entry);
+
+#endif // LIVE_FEED_H
@@ -0,0 +1,97 @@
+#ifndef LIVE_STREAM_H
+#define LIVE_STREAM_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+
+/**
+ * @brief Kinds of update pushed to live clients, first byte of a binary frame
+ */
+typedef enum {
+    LIVE_FRAME_STATE = 1,           // AI state transition
+    LIVE_FRAME_CYCLE,               // Scan cycle summary
+    LIVE_FRAME_METRICS,             // System and capture figures that moved
+    LIVE_FRAME_KINDS = 3
+} live_frame_type_t;
+
+/**
+ * @brief Binary AI state frame (little-endian, fixed layout)
+ */
+typedef struct {
+    uint8_t  type;                  // LIVE_FRAME_STATE
+    uint8_t  state;                 // ai_state_t
+    uint8_t  previous;
+    uint8_t  confidence_pct;
+    uint32_t transitions;           // Since boot; a gap counts coalesced transitions
+    uint32_t age_ms;                // Since the transition, when the frame was built
+} live_state_frame_t;
+
+/**
+ * @brief Binary scan cycle frame
+ */
+typedef struct {
+    uint8_t  type;                  // LIVE_FRAME_CYCLE
+    uint8_t  hop_channel;
+    uint16_t cycle;
+    uint16_t wifi_networks;
+    uint16_t ble_devices;
+    int16_t  wifi_rssi;
+    int16_t  ble_rssi;
+    uint16_t appeared;
+    uint16_t lost;
+    uint16_t moved;
+    uint16_t novel;
+} live_cycle_frame_t;
+
+/**
+ * @brief Binary metrics frame
+ */
+typedef struct {
+    uint8_t  type;                  // LIVE_FRAME_METRICS
+    uint8_t  sd_card_present;
+    uint8_t  hop_channel;
+    uint8_t  busiest_channel;
+    uint32_t free_memory;
+    uint32_t uptime_seconds;
+    uint16_t frames_per_second;
+    uint16_t probe_requests;
+    uint16_t clients;
+    uint16_t randomized_clients;
+} live_metrics_frame_t;
+
+static_assert(sizeof(live_state_frame_t) == 12, "live state frame layout changed");
+static_assert(sizeof(live_cycle_frame_t) == 20, "live cycle frame layout changed");
+static_assert(sizeof(live_metrics_frame_t) == 20, "live metrics frame layout changed");
+
+/**
+ * @brief Live stream figures since boot
+ */
+typedef struct {
+    uint8_t  clients;               // Connected now
+    uint32_t connects;
+    uint32_t refused;               // Turned away with LIVE_STREAM_CLIENTS connected
+    uint32_t frames_sent;
+    uint32_t coalesced;             // Updates replaced by a newer one before a slow client took them
+    uint32_t deferred;              // Sends put off because a client's queue was full
+} live_stream_stats_t;
+
+/**
+ * @brief Add the WebSocket on LIVE_STREAM_PATH and start the push task
+ *
+ * Each client is sent the current state, cycle and metrics on connect,
+ * then every update as it is published: JSON text frames by default, the
+ * frames above once it sends the text "binary" ("json" switches back).
+ * A client whose send queue is full keeps only the newest update of each
+ * kind, sent as soon as it drains. Nothing is built while no client is
+ * connected.
+ * @return false if the push task could not be created
+ */
+bool live_stream_register(AsyncWebServer* server);
+
+/**
+ * @brief Copy the live stream figures
+ */
+void live_stream_get_stats(live_stream_stats_t* stats);
+
+#endif // LIVE_STREAM_H
@@ -0,0 +1,91 @@
+#ifndef LOCATION_H
+#define LOCATION_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "wifi_scan.h"
+
+#define LOCATION_UNKNOWN 0xFF       // Label of a cycle no fingerprint is near
+
+/**
+ * @brief Where the last WiFi cycle places the unit
+ */
+typedef struct {
+    uint8_t  label;                 // Label index, LOCATION_UNKNOWN if none is near
+    uint8_t  match;                 // Share of the neighbours' vote behind it, 0-255
+    uint8_t  anchors_heard;         // Anchor access points in the cycle
+    uint8_t  reserved;
+    float    nearest_db;            // RMS difference to the nearest fingerprint
+    uint32_t updated_ms;            // Cycle the estimate was made in
+} location_estimate_t;
+
+/**
+ * @brief One named place
+ */
+typedef struct {
+    char     name[LOCATION_LABEL_LENGTH];   // Empty for a free label
+    uint16_t fingerprints;
+} location_label_t;
+
+/**
+ * @brief Store size and activity
+ */
+typedef struct {
+    uint16_t fingerprints;          // Stored
+    uint8_t  anchors;               // Anchor access points chosen so far
+    uint8_t  learning;              // Label being learned, LOCATION_UNKNOWN if none
+    uint8_t  learn_cycles;          // Cycles left to learn it
+    uint32_t queries;               // Cycles placed
+    uint32_t learned;               // Fingerprints taken since boot
+    uint32_t saves;
+} location_stats_t;
+
+/**
+ * @brief Allocate the fingerprint store (PSRAM preferred) and restore it from flash
+ * @return true if the store is usable
+ */
+bool location_init(void);
+
+/**
+ * @brief Place one WiFi cycle, or take it as a fingerprint while learning
+ *
+ * The cycle becomes a 16-lane vector of anchor RSSIs, and its k nearest
+ * fingerprints vote on the label. Called by the scan task.
+ */
+void location_observe(const wifi_record_t* records, uint16_t count, uint32_t now_ms);
+
+/**
+ * @brief Take the next cycles as fingerprints of a label, adding the label if new
+ * @param name Letters, digits, space, '-', '_' or '.', at most LOCATION_LABEL_LENGTH - 1
+ * @param cycles Cycles to learn from (each with enough anchors heard)
+ * @return false for an invalid name or with every label taken
+ */
+bool location_learn(const char* name, uint8_t cycles);
+
+/**
+ * @brief Delete a label and its fingerprints
+ * @return Fingerprints deleted, -1 if there is no such label
+ */
+int32_t location_forget(const char* name);
+
+/**
+ * @brief Write the store to flash
+ */
+bool location_save(void);
+
+/**
+ * @brief Copy the latest estimate
+ */
+void location_get_estimate(location_estimate_t* estimate);
+
+/**
+ * @brief Copy every label slot, LOCATION_LABELS of them
+ */
+void location_get_labels(location_label_t* labels);
+
+/**
+ * @brief Copy the store figures
+ */
+void location_get_stats(location_stats_t* stats);
+
+#endif // LOCATION_H
@@ -0,0 +1,165 @@
+#ifndef LOG_MANAGER_H
+#define LOG_MANAGER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "metrics_history.h"
+
+#define LOG_ROLLUP_MAGIC   0x52484848   // "HHHR"
+#define LOG_ROLLUP_FORMAT  1
+
+/**
+ * @brief Numbered files in TRACE_LOG_DIR the manager rotates, compacts and expires
+ */
+typedef enum {
+    LOG_SEGMENT_TRACE = 0,          // trace_NNNN.htr, one record per scan cycle
+    LOG_SEGMENT_ROLLUP,             // trace_NNNN.hmr, a compacted trace: one record per minute
+    LOG_SEGMENT_METRICS,            // metrics_NNNN.hmh, minute and quarter history points
+    LOG_SEGMENT_ARCHIVE,            // archive_NNNN.hca, columnar per-device sightings
+    LOG_SEGMENT_PCAP,               // capture_NNNN.pcap, captured frames with radiotap headers
+    LOG_SEGMENT_KIND_COUNT
+} log_segment_kind_t;
+
+/**
+ * @brief Trace fields kept by a minute rollup
+ */
+typedef enum {
+    LOG_ROLLUP_WIFI_NETWORKS = 0,
+    LOG_ROLLUP_WIFI_RSSI,
+    LOG_ROLLUP_BLE_DEVICES,
+    LOG_ROLLUP_BLE_RSSI,
+    LOG_ROLLUP_WIFI_CLIENTS,
+    LOG_ROLLUP_PROBE_REQUESTS,
+    LOG_ROLLUP_CAPTURE_FPS,
+    LOG_ROLLUP_NOVEL_DEVICES,
+    LOG_ROLLUP_FIELD_COUNT
+} log_rollup_field_t;
+
+/**
+ * @brief Start of every rollup file, followed by log_rollup_t records
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t record_bytes;          // sizeof(log_rollup_t) of the writer
+    uint32_t boot;                  // Of the trace it was made from
+    uint32_t source_records;        // Trace records rolled up
+} log_rollup_header_t;
+
+/**
+ * @brief One minute of a trace (little-endian, fixed layout)
+ */
+typedef struct {
+    uint32_t        first_ms;       // timestamp_ms of the first and last records
+    uint32_t        last_ms;
+    uint16_t        cycles;         // Trace records rolled up
+    uint16_t        reserved;
+    metric_rollup_t values[LOG_ROLLUP_FIELD_COUNT];
+} log_rollup_t;
+
+/**
+ * @brief One stretch of a segment in the index file (little-endian, fixed layout)
+ *
+ * Covers at most LOG_INDEX_STRIDE_MS of its segment's time; offset is the
+ * byte where the stretch's first record, or first batch, starts.
+ */
+typedef struct {
+    uint32_t boot;                  // log_manager_boot() of the writer
+    uint32_t first_ms;              // millis() of that boot
+    uint32_t last_ms;
+    uint32_t offset;
+    uint16_t segment;               // The NNNN of the file name
+    uint8_t  kind;                  // log_segment_kind_t
+    uint8_t  reserved;
+} log_index_entry_t;
+
+static_assert(sizeof(log_rollup_header_t) == 16, "rollup header layout changed");
+static_assert(sizeof(log_rollup_t) == 12 + LOG_ROLLUP_FIELD_COUNT * 12, "rollup record has implicit padding");
+static_assert(sizeof(log_index_entry_t) == 20, "index entry layout changed");
+
+/**
+ * @brief Where log_manager_find() points a query
+ */
+typedef struct {
+    log_segment_kind_t kind;
+    uint16_t segment;
+    uint32_t offset;                // Seek here in path
+    uint32_t first_ms;              // Time the entry found covers
+    uint32_t last_ms;
+    char     path[40];
+} log_location_t;
+
+/**
+ * @brief Housekeeping since boot
+ */
+typedef struct {
+    uint32_t boot;
+    uint32_t passes;
+    uint32_t compacted;             // Trace segments turned into rollups
+    uint32_t deleted;               // Segments expired for free space
+    uint32_t index_entries;         // Appended to the index file
+    uint32_t index_dropped;         // Lost while the pending queue was full
+    uint8_t  free_pct;              // Card space free after the last pass
+} log_manager_stats_t;
+
+/**
+ * @brief Count this boot in NVS; segments written from here on carry its number
+ * @return true on success, false on failure
+ */
+bool log_manager_init(void);
+
+/**
+ * @brief This boot's number, 0 before log_manager_init()
+ */
+uint32_t log_manager_boot(void);
+
+/**
+ * @brief Number the next file of a kind should take: one past the newest on the card
+ *
+ * Numbers only go up, so expired low numbers are never reused and the
+ * oldest segment is always the lowest. The caller holds the SD card's bus.
+ */
+uint16_t log_manager_next_segment(log_segment_kind_t kind);
+
+/**
+ * @brief A writer opened a segment; the manager leaves it alone until the next one
+ */
+void log_manager_opened(log_segment_kind_t kind, uint16_t segment);
+
+/**
+ * @brief A writer appended records from first_ms to last_ms at offset; never blocks
+ *
+ * Consecutive notes on one segment are merged into one index entry per
+ * LOG_INDEX_STRIDE_MS; the entries reach the index file on the next pass.
+ */
+void log_manager_note(log_segment_kind_t kind, uint16_t segment, uint32_t offset,
+                      uint32_t first_ms, uint32_t last_ms);
+
+/**
+ * @brief Start a housekeeping pass on a job worker every LOG_MANAGER_INTERVAL_MS
+ *
+ * A pass appends the pending index entries, compacts the oldest raw trace
+ * beyond LOG_RAW_SEGMENTS_KEPT, and deletes the oldest segments while the
+ * card has less than LOG_MIN_FREE_PCT free.
+ */
+void log_manager_tick(uint32_t now_ms);
+
+/**
+ * @brief Look up where a boot's data at time_ms lives, reading only the index
+ *
+ * Takes the SD card's bus; not for the async TCP task.
+ * @return false if no indexed segment of that kind covers or follows time_ms
+ */
+bool log_manager_find(log_segment_kind_t kind, uint32_t boot, uint32_t time_ms, log_location_t* out);
+
+/**
+ * @brief Path of a segment, e.g. "/logs/trace_0012.htr"
+ */
+void log_manager_segment_path(log_segment_kind_t kind, uint16_t segment, char* out, size_t size);
+
+/**
+ * @brief Copy the manager's figures
+ */
+void log_manager_get_stats(log_manager_stats_t* stats);
+
+#endif // LOG_MANAGER_H
@@ -0,0 +1,132 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include "config.h"
+
+/**
+ * @brief Severity, highest first; a module logs at and above its level
+ */
+typedef enum {
+    LOG_LEVEL_NONE = 0,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_VERBOSE,
+    LOG_LEVEL_COUNT
+} log_level_t;
+
+/**
+ * @brief Modules with a level of their own
+ */
+typedef enum {
+    LOG_MODULE_SYSTEM = 0,
+    LOG_MODULE_SCAN,                // Scan task, WiFi and BLE engines, device table
+    LOG_MODULE_CAPTURE,
+    LOG_MODULE_AI,
+    LOG_MODULE_UI,
+    LOG_MODULE_MESH,
+    LOG_MODULE_IDF,                 // ESP-IDF components through esp_log
+    LOG_MODULE_COUNT
+} log_module_t;
+
+/**
+ * @brief Ring and sink figures since boot
+ */
+typedef struct {
+    uint32_t written;               // Records queued
+    uint32_t dropped;               // Ring full
+    uint32_t truncated;             // Arguments that did not fit a record
+    uint32_t drained;               // Records formatted and sunk
+    uint32_t sd_bytes;
+    uint32_t max_latency_ms;        // Longest a record waited for the writer
+} logger_stats_t;
+
+/*
+ * Lines above LOG_COMPILE_LEVEL are compiled out: the dead branch keeps
+ * the format checked but the optimizer drops the call, its arguments and
+ * the format string, so none of it reaches flash. Arguments of such a
+ * line are never evaluated.
+ */
+#define LOG_AT(module, level, ...) logger_write((module), (level), __VA_ARGS__)
+#define LOG_DISCARD(module, level, ...) \
+    do { if (0) { logger_write((module), (level), __VA_ARGS__); } } while (0)
+
+#if LOG_COMPILE_LEVEL >= 1
+#define LOGE(module, ...) LOG_AT(LOG_MODULE_##module, LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOGE(module, ...) LOG_DISCARD(LOG_MODULE_##module, LOG_LEVEL_ERROR, __VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL >= 2
+#define LOGW(module, ...) LOG_AT(LOG_MODULE_##module, LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOGW(module, ...) LOG_DISCARD(LOG_MODULE_##module, LOG_LEVEL_WARN, __VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL >= 3
+#define LOGI(module, ...) LOG_AT(LOG_MODULE_##module, LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOGI(module, ...) LOG_DISCARD(LOG_MODULE_##module, LOG_LEVEL_INFO, __VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL >= 4
+#define LOGD(module, ...) LOG_AT(LOG_MODULE_##module, LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOGD(module, ...) LOG_DISCARD(LOG_MODULE_##module, LOG_LEVEL_DEBUG, __VA_ARGS__)
+#endif
+
+/**
+ * @brief Create the writer task and route esp_log output through the ring
+ * @return true on success, false on failure
+ */
+bool logger_init(void);
+
+/**
+ * @brief Queue one line without formatting it
+ *
+ * Copies the format pointer and the raw arguments into a ring slot; the
+ * writer task formats it later. The format must therefore be a string
+ * literal. Strings passed for %s are copied, bounded by any precision.
+ * Never blocks: a full ring drops the line and counts it. Until
+ * logger_init() has run, lines go straight to the serial port.
+ */
+void logger_write(log_module_t module, log_level_t level, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief Same as logger_write() with a va_list
+ */
+void logger_vwrite(log_module_t module, log_level_t level, const char* format, va_list args);
+
+/**
+ * @brief Change a module's level at run time; LOG_MODULE_COUNT sets all
+ */
+void logger_set_level(log_module_t module, log_level_t level);
+
+/**
+ * @brief Current level of a module
+ */
+log_level_t logger_get_level(log_module_t module);
+
+/**
+ * @brief Look a module or level up by its name, e.g. "scan" or "debug"
+ * @return LOG_MODULE_COUNT / LOG_LEVEL_COUNT if unknown
+ */
+log_module_t logger_find_module(const char* name);
+log_level_t logger_find_level(const char* name);
+
+const char* logger_module_name(log_module_t module);
+const char* logger_level_name(log_level_t level);
+
+/**
+ * @brief Copy the newest formatted output, oldest first
+ * @return Bytes copied, not NUL-terminated
+ */
+size_t logger_tail(char* out, size_t capacity);
+
+/**
+ * @brief Copy the ring and sink figures
+ */
+void logger_get_stats(logger_stats_t* stats);
+
+#endif // LOGGER_H
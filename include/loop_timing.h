@@ -0,0 +1,59 @@
+#ifndef LOOP_TIMING_H
+#define LOOP_TIMING_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief The firmware's task loops, each timed against its own period
+ */
+typedef enum {
+    LOOP_UI = 0,                    // One frame against the frame rate cap
+    LOOP_AI,                        // One decision against AI_UPDATE_INTERVAL
+    LOOP_SCAN,                      // One sweep against the scan interval
+    LOOP_SYSTEM,                    // Against SYSTEM_MONITOR_INTERVAL
+    LOOP_CAPTURE,                   // One drain against CAPTURE_DRAIN_INTERVAL_MS
+    LOOP_COUNT
+} loop_id_t;
+
+/**
+ * @brief Timing of one loop since boot
+ */
+typedef struct {
+    const char* name;
+    uint32_t    loops;
+    uint32_t    period_ms;          // Nominal period of the last iteration
+    uint32_t    stretched_ms;       // Period in force after stretching, 0 if none
+    uint32_t    last_exec_us;
+    uint32_t    avg_exec_us;        // EWMA
+    uint32_t    max_exec_us;
+    uint32_t    max_jitter_us;      // Latest start past the one the period promised
+    uint32_t    misses;             // Iterations that ran longer than their period
+    uint32_t    consecutive_misses;
+    uint32_t    stretches;          // Times the period was lengthened
+} loop_timing_stats_t;
+
+/**
+ * @brief Mark the start of a loop body, after the wait
+ */
+void loop_timing_start(loop_id_t loop);
+
+/**
+ * @brief Mark the end of a loop body and get the period to wait for
+ *
+ * An iteration that ran longer than period_ms is a missed deadline. After
+ * LOOP_STRETCH_AFTER misses in a row the loop's period is lengthened to
+ * fit its average body, at most LOOP_STRETCH_MAX_FACTOR times period_ms,
+ * so vTaskDelayUntil() stops running it back to back; LOOP_RELAX_AFTER
+ * iterations in a row that fit bring it back by steps.
+ * @param period_ms Nominal period of this iteration
+ * @return Period to wait for, never shorter than period_ms
+ */
+uint32_t loop_timing_finish(loop_id_t loop, uint32_t period_ms);
+
+/**
+ * @brief Copy one loop's figures
+ */
+void loop_timing_get(loop_id_t loop, loop_timing_stats_t* stats);
+
+#endif // LOOP_TIMING_H
@@ -0,0 +1,53 @@
+#ifndef LVGL_POOL_H
+#define LVGL_POOL_H
+
+// Included by LVGL's lv_mem.c through LV_MEM_POOL_INCLUDE, so plain C
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief LVGL heap usage as last sampled
+ */
+typedef struct {
+    uint32_t    size;               // LV_MEM_SIZE, the whole pool
+    const char* placement;          // "internal RAM", "PSRAM", NULL before lv_init()
+    uint32_t    used;               // Bytes allocated
+    uint32_t    peak;               // Most bytes ever allocated at once
+    uint32_t    largest_free;       // Biggest allocation that could succeed
+    uint8_t     used_pct;
+    uint8_t     frag_pct;           // 100 - largest_free * 100 / free bytes
+    uint32_t    sampled_ms;
+} lvgl_pool_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Allocate the block LVGL runs its TLSF allocator in
+ *
+ * LV_MEM_POOL_ALLOC (see platformio.ini): lv_init() calls it once for
+ * LV_MEM_SIZE bytes. The block comes from PSRAM with LVGL_POOL_PSRAM and
+ * from internal RAM otherwise, falling back to the other if that fails.
+ */
+void* lvgl_pool_alloc(size_t size);
+
+/**
+ * @brief Walk the pool and publish its usage
+ *
+ * LVGL is not thread safe: call only from the task running LVGL. The
+ * renderer does so every LVGL_POOL_SAMPLE_MS.
+ */
+void lvgl_pool_sample(uint32_t now_ms);
+
+/**
+ * @brief Copy the last sample, from any task
+ */
+void lvgl_pool_get_stats(lvgl_pool_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LVGL_POOL_H
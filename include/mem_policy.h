@@ -0,0 +1,122 @@
+#ifndef MEM_POLICY_H
+#define MEM_POLICY_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief What a block is for, which decides where it may live
+ */
+typedef enum {
+    MEM_HOT_DMA = 0,                // DMA-capable internal RAM only: draw bands, SPI transfers
+    MEM_HOT_CPU,                    // Internal RAM, PSRAM if that is full: arenas touched every cycle
+    MEM_BULK,                       // PSRAM, internal only above MEM_BULK_INTERNAL_RESERVE: tables, rings, staging
+    MEM_CACHE,                      // PSRAM only; a failure just means a miss
+    MEM_CLASSES
+} mem_class_t;
+
+/**
+ * @brief Blocks of one class, counted exactly at allocation and free
+ */
+typedef struct {
+    const char* name;
+    uint32_t live_bytes;
+    uint32_t peak_bytes;            // Most live at once since boot
+    uint32_t internal_bytes;        // Of the live bytes, in internal RAM
+    uint32_t psram_bytes;           // ...in PSRAM
+    uint32_t live_blocks;
+    uint32_t allocs;
+    uint32_t fallbacks;             // Served from the class's second choice
+    uint32_t failures;
+} mem_class_stats_t;
+
+/**
+ * @brief Bump allocator over one block, emptied all at once
+ *
+ * For scratch that lives exactly one cycle: mem_arena_reset() at the top
+ * of the cycle, mem_arena_alloc() through it, nothing freed one by one.
+ * An arena belongs to the task that resets it.
+ */
+typedef struct {
+    const char* name;
+    uint8_t*    base;
+    uint32_t    size;
+    uint32_t    used;
+    uint32_t    peak;               // Most used in one cycle
+    uint32_t    last;               // Used by the cycle the last reset ended
+    uint32_t    resets;
+    uint32_t    overflows;          // Requests that did not fit
+    uint8_t     mem_class;          // mem_class_t of the block
+} mem_arena_t;
+
+/*
+ * One placement policy for every long-lived or per-cycle block instead of
+ * capability flags chosen call by call. Each class maps to heap_caps
+ * flags and a second choice, and its bytes are counted exactly: callers
+ * give the size back on free, so the figures are what is held now, not
+ * an estimate from heap walks. Plain malloc() (String, std::vector, the
+ * BLE stack) is left to the SDK, with its PSRAM threshold set here
+ * explicitly rather than inherited from the core's sdkconfig.
+ */
+
+/**
+ * @brief Set plain malloc()'s PSRAM threshold; call once at boot
+ */
+void mem_policy_init(void);
+
+/**
+ * @brief Allocate for a class, falling back as the class allows
+ * @return NULL when neither choice has room
+ */
+void* mem_alloc(mem_class_t mem_class, size_t size);
+
+/**
+ * @brief Zeroed mem_alloc()
+ */
+void* mem_calloc(mem_class_t mem_class, size_t count, size_t size);
+
+/**
+ * @brief mem_alloc() at an alignment (a power of two), e.g. 16 for the SIMD kernels
+ */
+void* mem_aligned_alloc(mem_class_t mem_class, size_t alignment, size_t size);
+
+/**
+ * @brief Free a block from any of the above; size as it was asked for
+ */
+void mem_free(mem_class_t mem_class, void* ptr, size_t size);
+
+/**
+ * @brief Copy one class's figures
+ */
+void mem_policy_get(mem_class_t mem_class, mem_class_stats_t* stats);
+
+/**
+ * @brief Short name for logs and metrics ("hot_dma", ...)
+ */
+const char* mem_class_name(mem_class_t mem_class);
+
+/**
+ * @brief Take an arena's block and list it in the figures
+ * @return false without memory, or with MEM_ARENAS_MAX arenas listed
+ */
+bool mem_arena_init(mem_arena_t* arena, const char* name, mem_class_t mem_class, size_t size);
+
+/**
+ * @brief Bump-allocate from an arena
+ * @param alignment Power of two
+ * @return NULL when the rest of the block is too small (counted as an overflow)
+ */
+void* mem_arena_alloc(mem_arena_t* arena, size_t size, size_t alignment);
+
+/**
+ * @brief Empty an arena; everything it handed out is invalid from here
+ */
+void mem_arena_reset(mem_arena_t* arena);
+
+/**
+ * @brief Copy a listed arena, in the order they were taken
+ * @return false past the last one
+ */
+bool mem_arena_get(uint8_t index, mem_arena_t* arena);
+
+#endif // MEM_POLICY_H
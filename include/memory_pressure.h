@@ -0,0 +1,83 @@
+#ifndef MEMORY_PRESSURE_H
+#define MEMORY_PRESSURE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief How short the internal heap is, mildest first
+ */
+typedef enum {
+    MEMORY_PRESSURE_NONE = 0,
+    MEMORY_PRESSURE_LOW,            // Under MEMORY_PRESSURE_LOW_BYTES free
+    MEMORY_PRESSURE_HIGH,           // Under MEMORY_PRESSURE_HIGH_BYTES free
+    MEMORY_PRESSURE_CRITICAL,       // Under LOW_MEMORY_THRESHOLD free, or largest block under HEAP_LARGEST_CRITICAL
+    MEMORY_PRESSURE_LEVELS
+} memory_pressure_t;
+
+/**
+ * @brief Give memory back at some pressure level
+ *
+ * Runs on the system task. A subsystem whose memory belongs to another
+ * task should only ask that task to shrink, return 0, and credit the bytes
+ * with memory_pressure_credit() once it has.
+ * @return Bytes freed
+ */
+typedef size_t (*memory_shrink_t)(memory_pressure_t level);
+
+/**
+ * @brief One registered shrinker and what it has given back
+ */
+typedef struct {
+    const char*       name;
+    uint8_t           priority;         // Lower runs first
+    memory_pressure_t min_level;        // Not asked below this
+    uint32_t          calls;
+    uint32_t          reclaimed_bytes;  // Returned and credited, since boot
+} memory_shrinker_stats_t;
+
+/**
+ * @brief Register a shrinker
+ * @param priority Lower is asked first: put what is cheapest to rebuild first
+ * @param min_level Least pressure it is asked at
+ * @return Id for memory_pressure_credit(), -1 if MEMORY_SHRINKERS_MAX are registered
+ */
+int8_t memory_pressure_register(const char* name, uint8_t priority,
+                                memory_pressure_t min_level, memory_shrink_t shrink);
+
+/**
+ * @brief Credit bytes a shrinker freed after it returned; safe from any task
+ */
+void memory_pressure_credit(int8_t shrinker, size_t bytes);
+
+/**
+ * @brief Pressure level of the internal heap right now
+ *
+ * Only walks the heap for its largest block once free memory is under
+ * MEMORY_PRESSURE_LOW_BYTES.
+ */
+memory_pressure_t memory_pressure_level(void);
+
+/**
+ * @brief Ask shrinkers for memory if the heap is under pressure
+ *
+ * Shrinkers registered for the level run in priority order until the
+ * level drops. A level is answered once per MEMORY_PRESSURE_COOLDOWN_MS
+ * while it holds; a worse one is answered at once. Call from the system
+ * task only.
+ * @return Level the heap was at
+ */
+memory_pressure_t memory_pressure_respond(uint32_t now_ms);
+
+/**
+ * @brief Copy out the shrinkers in priority order
+ * @return Number written, at most max
+ */
+uint8_t memory_pressure_get(memory_shrinker_stats_t* stats, uint8_t max);
+
+/**
+ * @brief Short name for logs ("none", "low", ...)
+ */
+const char* memory_pressure_name(memory_pressure_t level);
+
+#endif // MEMORY_PRESSURE_H
@@ -0,0 +1,130 @@
+#ifndef MESH_SYNC_H
+#define MESH_SYNC_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define MESH_MAGIC          0xA7
+#define MESH_VERSION        3
+#define MESH_MSG_DIGEST     1
+
+/**
+ * @brief Digest frame header (24 bytes on the wire)
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  magic;                 // MESH_MAGIC
+    uint8_t  version;               // MESH_VERSION
+    uint8_t  type;                  // MESH_MSG_*
+    uint8_t  entry_count;           // Entries following the header
+    uint16_t seq;                   // Per-sender frame counter
+    uint16_t channel_mask;          // Channels the sender currently sweeps
+    uint16_t cycle_seq;             // Sender's scan cycle when the frame was built
+    uint8_t  time_stratum;          // Sender's wall clock stratum, 0 if it has none
+    uint8_t  reserved;
+    uint32_t tx_time_us;            // Sender's radio clock at transmission
+    uint64_t tx_wall_ms;            // Sender's wall clock then, 0 if it has none
+} mesh_header_t;
+
+/**
+ * @brief One device table entry on the wire (12 bytes)
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  mac[6];                // BSSID or BLE address
+    uint8_t  kind;                  // device_kind_t
+    int8_t   rssi;                  // RSSI EWMA at the sender (dBm)
+    uint8_t  channel;               // WiFi channel (0 for BLE)
+    uint8_t  cycle_age;             // Sender cycles since the sighting (saturating)
+    uint16_t age_ms;                // tx_time_us minus sighting time, in ms (saturating)
+} mesh_entry_t;
+
+#define MESH_MAX_FRAME_BYTES    250
+#define MESH_ENTRIES_PER_FRAME  ((MESH_MAX_FRAME_BYTES - sizeof(mesh_header_t)) / sizeof(mesh_entry_t))
+
+/**
+ * @brief Peer node state
+ */
+typedef struct {
+    uint8_t  mac[6];                // Peer station address
+    bool     used;
+    uint16_t channel_mask;          // Channels the peer sweeps
+    uint16_t last_seq;              // Last frame counter received
+    uint16_t frames_lost;           // Gaps in the frame counter
+    uint16_t compared;              // Peer BLE devices checked against our table
+    uint16_t shared;                // ...of which we also hear
+    int16_t  rssi_offset_x16;       // EWMA of (our RSSI - peer RSSI) on shared devices
+    int32_t  clock_offset_us;       // Our radio clock minus the peer's
+    uint16_t clock_samples;         // Frames folded into the offset estimate
+    uint16_t cycle_seq;             // Peer's latest scan cycle
+    uint32_t entries_rx;            // Entries received
+    uint32_t last_seen_ms;          // Last frame received
+} mesh_peer_t;
+
+/**
+ * @brief Mesh statistics
+ */
+typedef struct {
+    uint8_t  peer_count;            // Live peers
+    uint8_t  nearby_peers;          // Peers sharing our airspace
+    uint16_t local_mask;            // Channels this node sweeps after the split
+    uint32_t frames_tx;
+    uint32_t frames_rx;
+    uint32_t frames_rejected;       // Bad magic/version/length or full peer list
+    uint32_t rx_dropped;            // Receive queue full
+    uint32_t entries_tx;
+    uint32_t entries_merged;        // Peer WiFi entries added to the device table
+    uint32_t entries_deferred;      // Dirty entries left for a later cycle
+    uint32_t entries_duplicate;     // Peer sightings we already had
+} mesh_stats_t;
+
+/**
+ * @brief Bring up ESP-NOW and register the broadcast peer
+ * @return true on success
+ */
+bool mesh_sync_init(void);
+
+/**
+ * @brief Drain received digests, expire peers and send dirty entries
+ *
+ * Call once per scan cycle from the scan task, after the device table has
+ * been updated.
+ * @param now_ms Current time
+ */
+void mesh_sync_tick(uint32_t now_ms);
+
+/**
+ * @brief Restrict a channel mask to this node's share of the airspace
+ *
+ * Nearby nodes split the mask by rank of their station address, so each
+ * channel is swept by exactly one of them. Single-channel masks pass through.
+ * @param mask Channels the active profile wants swept
+ * @return Channels this node should sweep
+ */
+uint16_t mesh_sync_filter_mask(uint16_t mask);
+
+/**
+ * @brief WiFi APs reported by peers on channels this node skips
+ * @param now_ms Current time
+ */
+uint16_t mesh_sync_remote_networks(uint32_t now_ms);
+
+/**
+ * @brief Map a peer's radio timestamp onto our own clock
+ * @param peer_mac Station address of the peer
+ * @param remote_us Timestamp on the peer's clock
+ * @param local_us Receives the timestamp on our clock
+ * @return false if the peer is unknown or its offset is not yet estimated
+ */
+bool mesh_sync_to_local_time(const uint8_t* peer_mac, uint32_t remote_us, uint32_t* local_us);
+
+/**
+ * @brief Copy the mesh statistics
+ */
+void mesh_sync_get_stats(mesh_stats_t* stats);
+
+/**
+ * @brief Copy the peer list
+ * @return Number of peers copied
+ */
+uint8_t mesh_sync_get_peers(mesh_peer_t* peers, uint8_t capacity);
+
+#endif // MESH_SYNC_H
@@ -0,0 +1,146 @@
+#ifndef METRICS_HISTORY_H
+#define METRICS_HISTORY_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+#include "system_monitor.h"
+
+#define HISTORY_FILE_MAGIC   0x4D484848   // "HHHM"
+#define HISTORY_FILE_FORMAT  1
+
+/**
+ * @brief Metrics kept in the history, all as integers
+ */
+typedef enum {
+    METRIC_FREE_HEAP = 0,           // Bytes
+    METRIC_FREE_PSRAM,
+    METRIC_MIN_FREE_HEAP,
+    METRIC_HEAP_LARGEST_FREE,
+    METRIC_HEAP_FRAG_PCT,
+    METRIC_TEMPERATURE_DECI_C,      // 0.1 °C, filtered
+    METRIC_THERMAL_LEVEL,           // thermal_level_t
+    METRIC_TASK_COUNT,
+    METRIC_CPU_PCT,
+    METRIC_CPU0_PCT,
+    METRIC_CPU1_PCT,
+    METRIC_WIFI_CONNECTED,          // 0 or 1; the average is the share of time up
+    METRIC_SD_MOUNTED,
+    METRIC_LVGL_USED_PCT,
+    METRIC_LVGL_FRAG_PCT,
+    METRIC_LVGL_USED_BYTES,
+    METRIC_LVGL_PEAK_BYTES,
+    METRIC_LVGL_LARGEST_FREE,
+    METRIC_WIFI_NETWORKS,           // Scan counts, from the published sensor data
+    METRIC_WIFI_CLIENTS,
+    METRIC_BLE_DEVICES,
+    METRIC_COUNT
+} metric_id_t;
+
+/**
+ * @brief Resolutions, finest first
+ */
+typedef enum {
+    HISTORY_TIER_SECONDS = 0,       // One point per metrics_history_record()
+    HISTORY_TIER_MINUTES,
+    HISTORY_TIER_QUARTERS,          // 15 minutes
+    HISTORY_TIER_COUNT
+} history_tier_t;
+
+/**
+ * @brief Least, mean and most of a metric over one point's interval
+ */
+typedef struct {
+    int32_t min;
+    int32_t avg;
+    int32_t max;
+} metric_rollup_t;
+
+/**
+ * @brief Every metric over one interval (little-endian, fixed layout)
+ */
+typedef struct {
+    uint32_t        end_ms;         // millis() of the last sample in the interval
+    uint16_t        samples;        // Seconds-tier samples rolled up
+    uint8_t         tier;           // history_tier_t
+    uint8_t         reserved;
+    metric_rollup_t values[METRIC_COUNT];
+} history_point_t;
+
+/**
+ * @brief Start of every history file in TRACE_LOG_DIR, followed by history_point_t records
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t point_bytes;           // sizeof(history_point_t) of the writer
+    uint8_t  metric_count;
+    uint8_t  reserved[3];
+    uint32_t boot_ms;               // millis() when the file was opened
+} history_file_header_t;
+
+static_assert(sizeof(history_point_t) == 8 + METRIC_COUNT * 12, "history point has implicit padding");
+static_assert(sizeof(history_file_header_t) == 16, "history file header layout changed");
+
+/**
+ * @brief Allocate the rings in PSRAM
+ * @return false without PSRAM room; the history then stays empty
+ */
+bool metrics_history_init(void);
+
+/**
+ * @brief Add one sample of every metric and roll up closed intervals
+ *
+ * Call once per SYSTEM_MONITOR_INTERVAL from the system task; closed
+ * minute and quarter points reach the SD card every HISTORY_FLUSH_INTERVAL_MS
+ * while a card is mounted.
+ */
+void metrics_history_record(uint32_t now_ms, const system_metrics_t* metrics,
+                            const sensor_data_t* scan);
+
+/**
+ * @brief Copy the newest points of one metric, oldest first; safe from any task
+ * @param newest_ms Set to the newest point's end_ms, if any
+ * @return Points written, at most max
+ */
+uint16_t metrics_history_query(history_tier_t tier, metric_id_t metric,
+                               metric_rollup_t* out, uint16_t max, uint32_t* newest_ms);
+
+/**
+ * @brief Copy points of one metric that ended after a time, oldest first; safe from any task
+ *
+ * Pass the last end_ms received as after_ms to page through a tier; points
+ * overwritten between calls are skipped, never repeated.
+ * @param after_ms Only points whose end_ms is later than this
+ * @param end_ms Receives each point's end_ms
+ * @return Points written, at most max
+ */
+uint16_t metrics_history_read_after(history_tier_t tier, metric_id_t metric, uint32_t after_ms,
+                                    metric_rollup_t* out, uint32_t* end_ms, uint16_t max);
+
+/**
+ * @brief after_ms that makes metrics_history_read_after() start at the newest count points
+ */
+uint32_t metrics_history_newest_after(history_tier_t tier, uint16_t count);
+
+/**
+ * @brief Points a tier holds right now
+ */
+uint16_t metrics_history_count(history_tier_t tier);
+
+/**
+ * @brief Length of a tier's intervals
+ */
+uint32_t metrics_history_interval_ms(history_tier_t tier);
+
+/**
+ * @brief Short name for logs and the web UI ("free_heap", ...)
+ */
+const char* metrics_history_name(metric_id_t metric);
+
+/**
+ * @brief Metric with that name, METRIC_COUNT if none
+ */
+metric_id_t metrics_history_find(const char* name);
+
+#endif // METRICS_HISTORY_H
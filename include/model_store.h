@@ -0,0 +1,93 @@
+#ifndef MODEL_STORE_H
+#define MODEL_STORE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Committed contents of a model slot
+ */
+typedef struct {
+    bool     valid;                 // Slot holds a verified model
+    uint8_t  slot;                  // 0 or 1
+    uint32_t generation;            // Higher is newer
+    uint32_t length;                // Model bytes
+    uint32_t crc32;                 // CRC-32 of the model bytes
+} model_slot_info_t;
+
+/**
+ * @brief Model store statistics
+ */
+typedef struct {
+    uint32_t slot_capacity;         // Largest model a slot holds
+    uint32_t updates_committed;     // Uploads verified and committed since boot
+    uint32_t updates_rejected;      // Uploads that failed size, write or CRC checks
+    bool     writing;               // An upload is in progress
+} model_store_stats_t;
+
+/**
+ * @brief Find the two model partitions and the newest committed slot
+ * @return false if the partition table has no model slots
+ */
+bool model_store_init(void);
+
+/**
+ * @brief Newest committed slot
+ * @return false if neither slot holds a model
+ */
+bool model_store_active(model_slot_info_t* info);
+
+/**
+ * @brief Read model bytes out of a committed slot
+ */
+bool model_store_read(const model_slot_info_t* info, uint32_t offset, void* dst, uint32_t length);
+
+/**
+ * @brief Start writing a model of the given size into the slot not in use
+ *
+ * Sectors are erased as the write reaches them, so no single call blocks
+ * for long. Only one upload can be open at a time.
+ */
+bool model_store_begin(uint32_t length);
+
+/**
+ * @brief Append the next chunk of the model
+ */
+bool model_store_write(const uint8_t* data, uint32_t length);
+
+/**
+ * @brief Verify the written model against its CRC-32 and commit it
+ *
+ * The bytes must also pass ai_inference_verify_model() where they lie in
+ * flash, since the CRC is the uploader's. The slot header is written last, so a power cut at any point leaves
+ * the previous model in force. A committed model is handed to the
+ * inference stage through model_store_take_pending().
+ */
+bool model_store_finish(uint32_t expected_crc32);
+
+/**
+ * @brief Drop an open upload
+ */
+void model_store_abort(void);
+
+/**
+ * @brief Put the other slot's model back in force, e.g. to roll an update back
+ *
+ * Its header is rewritten one generation above the model in force, so the
+ * swap also holds across a reboot. It is handed to the inference stage
+ * like an upload. Fails with no model in the other slot or an upload open,
+ * which would be writing into it.
+ */
+bool model_store_swap(void);
+
+/**
+ * @brief Take the slot committed since the last call, if any
+ */
+bool model_store_take_pending(model_slot_info_t* info);
+
+/**
+ * @brief Copy the store statistics
+ */
+void model_store_get_stats(model_store_stats_t* stats);
+
+#endif // MODEL_STORE_H
@@ -0,0 +1,25 @@
+#ifndef MODEL_UPDATE_H
+#define MODEL_UPDATE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Start the HTTP endpoint that accepts new models
+ *
+ * POST MODEL_UPDATE_PATH with the raw .tflite as an application/octet-stream
+ * body and its CRC-32 in hex in the X-Model-CRC32 header. The model is
+ * streamed into the inactive slot and, once verified, picked up by the AI
+ * task at the next cycle boundary. GET on the same path reports the slot
+ * in force, and GET AI_METRICS_PATH the inference latency histogram and
+ * model margins. Serves on whichever interface has an IP address.
+ * @return true if the server is listening
+ */
+bool model_update_init(void);
+
+/**
+ * @brief A model body is being streamed into the inactive slot
+ */
+bool model_update_in_progress(void);
+
+#endif // MODEL_UPDATE_H
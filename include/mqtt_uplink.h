@@ -0,0 +1,89 @@
+#ifndef MQTT_UPLINK_H
+#define MQTT_UPLINK_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+#include "sensor_data_codec.h"
+#include "telemetry_summary.h"
+
+#define MQTT_BATCH_MAGIC   0x48     // 'H'
+#define MQTT_BATCH_FORMAT  1      // Records are sensor data, on .../telemetry
+#define MQTT_SUMMARY_FORMAT 2     // One telemetry_summary_t, on .../summary
+
+/**
+ * @brief Start of every published payload, followed by the records
+ *
+ * Records are sensor_data_serialize() output, oldest first, or a single
+ * telemetry summary in a MQTT_SUMMARY_FORMAT batch. A batch can
+ * arrive twice after a broker drops the connection mid-acknowledgement;
+ * session and sequence tell a duplicate apart.
+ */
+typedef struct {
+    uint8_t  magic;                 // MQTT_BATCH_MAGIC
+    uint8_t  format;                // MQTT_BATCH_FORMAT
+    uint8_t  records;
+    uint8_t  record_bytes;          // SENSOR_DATA_WIRE_BYTES or sizeof(telemetry_summary_t)
+    uint32_t session;               // Random per boot
+    uint32_t sequence;              // Batches of this session so far
+} mqtt_batch_header_t;
+
+/**
+ * @brief One queued batch, as published and as spooled
+ */
+typedef struct {
+    mqtt_batch_header_t header;
+    uint8_t             records[MQTT_BATCH_RECORDS * SENSOR_DATA_WIRE_BYTES];
+} mqtt_batch_t;
+
+static_assert(sizeof(mqtt_batch_header_t) == 12, "MQTT batch header layout changed");
+static_assert(sizeof(telemetry_summary_t) <= sizeof(((mqtt_batch_t*)0)->records),
+              "a summary fits in a batch");
+
+/**
+ * @brief Uplink figures since boot
+ */
+typedef struct {
+    bool     wifi_connected;
+    bool     broker_connected;
+    uint16_t queued;                // Batches in the PSRAM queue
+    uint32_t spooled;               // Batches waiting in the SD spool
+    uint32_t published;             // Acknowledged by the broker
+    uint32_t retries;               // Publishes repeated after no acknowledgement
+    uint32_t spilled;               // Moved from the full PSRAM queue to the SD spool
+    uint32_t dropped;               // Lost with the queue full and no card
+    uint32_t connects;
+    uint32_t summaries;             // Summary batches queued
+    uint32_t raw;                   // Sensor data batches queued
+    uint32_t raw_left_s;            // Of raw telemetry asked for, 0 when off or always on
+} mqtt_uplink_stats_t;
+
+/**
+ * @brief Start the uplink task, publishing over the wifi_link association
+ *
+ * The task queues each closed telemetry summary as a batch of its own,
+ * published at QoS 1 on MQTT_TOPIC_PREFIX/<station MAC>/summary. Raw
+ * sensor data goes out only with MQTT_RAW_TELEMETRY or for the minutes
+ * asked by mqtt_uplink_raw_for(): the latest is sampled every
+ * MQTT_SAMPLE_INTERVAL_MS and MQTT_BATCH_RECORDS new cycles are packed
+ * into a batch on .../telemetry. Batches are published one at a time,
+ * each removed from the queue only once the broker acknowledges it. While the
+ * broker is out of reach batches wait in a PSRAM queue of
+ * MQTT_QUEUE_BATCHES; when that fills, the oldest move to a spool file on
+ * the SD card, which is replayed first on reconnect and survives reboots.
+ * @return false without PSRAM for the queue or a task
+ */
+bool mqtt_uplink_init(void);
+
+/**
+ * @brief Send raw sensor data as well as summaries for a while (any task)
+ * @param minutes From now, replacing any earlier request; 0 stops it
+ */
+void mqtt_uplink_raw_for(uint32_t minutes);
+
+/**
+ * @brief Copy the uplink figures
+ */
+void mqtt_uplink_get_stats(mqtt_uplink_stats_t* stats);
+
+#endif // MQTT_UPLINK_H
@@ -0,0 +1,57 @@
+#ifndef NOVELTY_FILTER_H
+#define NOVELTY_FILTER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "device_table.h"
+
+/**
+ * @brief Novelty filter statistics
+ */
+typedef struct {
+    uint8_t  current_generation;    // Generation receiving inserts
+    bool     warm;                  // Enough history to report novelty
+    uint16_t fill_permille;         // Bits set in the current generation
+    uint32_t generation_age_s;      // Uptime spent in the current generation
+    uint32_t history_s;             // Uptime covered by all generations
+    uint32_t inserted;              // Addresses added since boot
+    uint32_t novel;                 // Of those, reported as novel
+    uint32_t saves;                 // Successful flash writes
+} novelty_stats_t;
+
+/**
+ * @brief Allocate the filter (PSRAM preferred) and restore it from flash
+ * @return true if the filter is usable
+ */
+bool novelty_filter_init(void);
+
+/**
+ * @brief Check an address against the history and add it
+ * @param mac Six-byte BSSID or BLE address
+ * @param kind Observation kind
+ * @param generations Receives how many generations held the address before
+ *        this call, i.e. in how many spans of the retention window it was
+ *        seen (NULL if not needed)
+ * @return true if the address was not seen within the retention window
+ *         (always false until the filter is warm)
+ */
+bool novelty_filter_check_and_add(const uint8_t* mac, device_kind_t kind, uint8_t* generations);
+
+/**
+ * @brief Advance generation ages and retire the oldest when due
+ * @param now_ms Current time
+ */
+void novelty_filter_tick(uint32_t now_ms);
+
+/**
+ * @brief Write the filter to flash
+ * @return true on success
+ */
+bool novelty_filter_save(void);
+
+/**
+ * @brief Copy the filter statistics
+ */
+void novelty_filter_get_stats(novelty_stats_t* stats);
+
+#endif // NOVELTY_FILTER_H
@@ -0,0 +1,68 @@
+#ifndef OPENMETRICS_H
+#define OPENMETRICS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+#include "system_monitor.h"
+#include "cpu_load.h"
+#include "task_monitor.h"
+#include "heap_monitor.h"
+#include "loop_timing.h"
+#include "renderer.h"
+#include "ai_telemetry.h"
+#include "energy.h"
+#include "profile.h"
+#include "latency_trace.h"
+#include "handshake_watch.h"
+
+#define OPENMETRICS_CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/**
+ * @brief Every figure one scrape reports, copied at its start
+ */
+typedef struct {
+    system_metrics_t    system;
+    cpu_load_t          cpu;
+    uint8_t             task_count;
+    task_stats_t        tasks[TASK_MONITOR_MAX_TASKS];
+    heap_region_stats_t heap[HEAP_REGION_COUNT];
+    loop_timing_stats_t loops[LOOP_COUNT];
+    sensor_data_t       scan;
+    uint32_t            scan_version;
+    renderer_profile_t  display;
+    energy_status_t     energy;
+    ai_telemetry_t      inference;
+    uint32_t            latency_octaves[AI_TELEMETRY_OCTAVES];
+    uint32_t            latency_count;
+    uint64_t            latency_sum_us;
+    latency_trace_stats_t pipeline;
+    handshake_stats_t   handshakes;
+#if PROFILE_ENABLED
+    profile_stats_t     profile[PROFILE_SITE_COUNT];
+#endif
+} openmetrics_snapshot_t;
+
+/**
+ * @brief Copy every figure a scrape reports
+ */
+void openmetrics_snapshot(openmetrics_snapshot_t* snapshot);
+
+/**
+ * @brief Write one group of metric families in OpenMetrics text
+ *
+ * Groups are small enough to be written one at a time into a buffer of
+ * HTTP_API_TEXT_BYTES; after the last group comes "# EOF".
+ * @param group 0 up to the last group
+ * @return Characters written (without NUL); 0 with nothing to report
+ *         or past the last group
+ */
+size_t openmetrics_write_group(const openmetrics_snapshot_t* snapshot, uint8_t group,
+                               char* out, size_t capacity);
+
+/**
+ * @brief Number of groups openmetrics_write_group() takes
+ */
+uint8_t openmetrics_group_count(void);
+
+#endif // OPENMETRICS_H
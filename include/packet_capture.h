@@ -0,0 +1,94 @@
+#ifndef PACKET_CAPTURE_H
+#define PACKET_CAPTURE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "spsc_ring.h"
+
+/**
+ * @brief Frame header copied out of the promiscuous callback (96 bytes)
+ */
+typedef struct {
+    uint32_t timestamp_us;                  // Radio RX timestamp
+    uint16_t length;                        // Full frame length on air
+    int8_t   rssi;                          // Signal strength in dBm
+    uint8_t  channel;                       // Primary channel
+    uint8_t  pkt_type;                      // wifi_promiscuous_pkt_type_t value
+    uint8_t  header_len;                    // Valid bytes in header[]
+    uint8_t  rate;                          // rx_ctrl.rate, or rx_ctrl.mcs for HT
+    uint8_t  phy;                           // AIRTIME_PHY_* bits
+    uint8_t  header[CAPTURE_HEADER_BYTES];  // Leading bytes of the 802.11 frame
+} capture_frame_t;
+
+/**
+ * @brief Aggregate traffic statistics from the consumer stage
+ */
+typedef struct {
+    uint32_t frames_total;                  // Frames parsed since start
+    uint32_t frames_dropped;                // Frames lost to a full ring
+    uint16_t frames_per_second;             // Rate over the last window
+    uint16_t probe_requests;                // Probe requests in the last window
+    uint16_t bssid_count;                   // Access points heard within the TTL
+    uint16_t client_count;                  // Estimated unique stations per CLIENT_WINDOW_MS
+    uint16_t randomized_clients;            // Of those, using randomized MACs
+    uint16_t macs_merged;                   // MAC rotations folded into known stations
+    uint16_t busiest_bssid_fps;             // Highest per-BSSID frame rate
+    uint8_t  busiest_bssid[6];              // Address of that BSSID
+    uint16_t channel_fps[WIFI_CHANNEL_COUNT + 1];  // Per-channel rate (index = channel)
+} capture_stats_t;
+
+/**
+ * @brief Allocate the frame ring (PSRAM preferred) and clear statistics
+ * @return true on success, false on allocation failure
+ */
+bool capture_init(void);
+
+/**
+ * @brief Enable promiscuous reception into the ring
+ * @return true on success, false on failure
+ */
+bool capture_start(void);
+
+/**
+ * @brief Disable promiscuous reception
+ */
+void capture_stop(void);
+
+/**
+ * @brief Whether promiscuous reception is active
+ */
+bool capture_is_running(void);
+
+/**
+ * @brief Drain and parse queued frames (consumer side)
+ * @param max_frames Upper bound on frames handled in this call
+ * @return Number of frames parsed
+ */
+uint16_t capture_process(uint16_t max_frames);
+
+/**
+ * @brief Close the current statistics window if it has elapsed
+ * @param now_ms Current time
+ * @return true if a new window was published
+ */
+bool capture_roll_window(uint32_t now_ms);
+
+/**
+ * @brief Frames parsed on a channel since capture_init() (consumer side)
+ * @param channel WiFi channel (1-13)
+ * @return Cumulative frame count, 0 for an invalid channel
+ */
+uint32_t capture_channel_frames(uint8_t channel);
+
+/**
+ * @brief Copy the most recently published statistics
+ * @param stats Receives the snapshot
+ */
+void capture_get_stats(capture_stats_t* stats);
+
+/**
+ * @brief Copy the figures of the ring between the RX callback and the capture task
+ */
+void capture_get_stream_stats(spsc_stats_t* stats);
+
+#endif // PACKET_CAPTURE_H
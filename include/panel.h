@@ -0,0 +1,55 @@
+#ifndef PANEL_H
+#define PANEL_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief The ST7789 behind the board profile's display bus
+ *
+ * panel_spi.cpp drives it through TFT_eSPI on SPI, panel_i80.cpp through
+ * esp_lcd on the S3's LCD peripheral; BOARD_DISPLAY_BUS builds one of them.
+ * Only the renderer calls these, from the UI task.
+ */
+typedef struct {
+    const char* bus;                // "SPI" or "i80"
+    uint32_t    bus_hz;
+    bool        dma;                // panel_push() queues and returns
+} panel_info_t;
+
+/**
+ * @brief Bring the panel up in a rotation (0-3, TFT_eSPI's), cleared to black
+ * @return false if the bus or the panel cannot be set up
+ */
+bool panel_init(uint8_t rotation, panel_info_t* info);
+
+/**
+ * @brief Turn the panel's address mapping; waits for a transfer in flight
+ */
+void panel_set_rotation(uint8_t rotation);
+
+/**
+ * @brief Width and height in the current rotation
+ */
+uint16_t panel_width(void);
+uint16_t panel_height(void);
+
+/**
+ * @brief Send a rectangle of RGB565 pixels, LVGL's little-endian order
+ *
+ * With DMA this waits for the previous transfer, queues this one and
+ * returns, so pixels must stay untouched until the next push or panel_wait().
+ */
+void panel_push(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint16_t* pixels);
+
+/**
+ * @brief Wait for a transfer in flight
+ */
+void panel_wait(void);
+
+/**
+ * @brief Send a parameterless command (SLPIN, SLPOUT) once the bus is idle
+ */
+void panel_command(uint8_t command);
+
+#endif // PANEL_H
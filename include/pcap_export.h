@@ -0,0 +1,134 @@
+#ifndef PCAP_EXPORT_H
+#define PCAP_EXPORT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "packet_capture.h"
+
+#define PCAP_MAGIC              0xA1B2C3D4   // Microsecond timestamps, writer's byte order
+#define PCAP_LINKTYPE_RADIOTAP  127          // LINKTYPE_IEEE802_11_RADIOTAP
+
+/**
+ * @brief Start of every capture file and stream (classic libpcap format)
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version_major;         // 2
+    uint16_t version_minor;         // 4
+    int32_t  thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;               // Radiotap header plus CAPTURE_HEADER_BYTES
+    uint32_t linktype;
+} pcap_file_header_t;
+
+/**
+ * @brief Start of every packet record
+ */
+typedef struct {
+    uint32_t ts_sec;                // Radio clock, seconds since boot
+    uint32_t ts_usec;
+    uint32_t incl_len;              // Bytes that follow: radiotap header and kept frame bytes
+    uint32_t orig_len;              // As if the whole frame had been kept
+} pcap_record_header_t;
+
+/**
+ * @brief Radiotap header ahead of every frame: flags, channel and signal
+ */
+typedef struct {
+    uint8_t  version;               // 0
+    uint8_t  pad;
+    uint16_t length;                // sizeof(pcap_radiotap_t)
+    uint32_t present;               // Bits of the fields below
+    uint8_t  flags;                 // 0x10 when the frame's FCS is among the kept bytes
+    uint8_t  pad1;                  // Channel is 2-byte aligned
+    uint16_t channel_mhz;
+    uint16_t channel_flags;         // 2 GHz spectrum
+    int8_t   antenna_signal;        // dBm
+    uint8_t  pad2;
+} pcap_radiotap_t;
+
+static_assert(sizeof(pcap_file_header_t) == 24, "pcap file header layout changed");
+static_assert(sizeof(pcap_record_header_t) == 16, "pcap record header layout changed");
+static_assert(sizeof(pcap_radiotap_t) == 16, "radiotap header layout changed");
+
+/**
+ * @brief Export figures since boot
+ */
+typedef struct {
+    bool     sd_active;
+    bool     stream_active;
+    uint16_t sd_segment;            // capture_NNNN.pcap being written
+    uint32_t frames_exported;
+    uint32_t frames_dropped;        // The slowest reader had not made room
+    uint32_t sd_bytes;              // Written to the card
+    uint32_t sd_failures;
+    uint32_t stream_bytes;          // Handed to the HTTP stream
+    uint32_t stream_sessions;
+} pcap_export_stats_t;
+
+/**
+ * @brief Allocate the export ring in PSRAM; start the SD file if PCAP_SD_AUTOSTART
+ * @return true on success, false on allocation failure
+ */
+bool pcap_export_init(void);
+
+/**
+ * @brief Append one frame as a pcap record, straight from its capture ring slot
+ *
+ * Called by the capture task for each slot it drains, before the slot is
+ * handed back. Does nothing while no reader is open.
+ */
+void pcap_export_frame(const capture_frame_t* frame);
+
+/**
+ * @brief Start a card write on a job worker once a chunk is staged or has aged
+ *
+ * Called by the capture task after each drain.
+ */
+void pcap_export_tick(uint32_t now_ms);
+
+/**
+ * @brief Start writing frames to a new capture_NNNN.pcap in TRACE_LOG_DIR
+ *
+ * The file is opened by the first card write, so this is safe on any task.
+ * @return false without a card or the ring
+ */
+bool pcap_export_sd_start(void);
+
+/**
+ * @brief Write what is staged, then stop writing to the card
+ */
+void pcap_export_sd_stop(void);
+
+/**
+ * @brief Enter or leave burst mode (capture task)
+ *
+ * Entering opens the SD file if CAPTURE_BURST_SD and nobody has; leaving
+ * closes it only if the burst opened it. In between, card writes start
+ * sooner, on the normal job lane, and keep the bus for their whole length.
+ */
+void pcap_export_set_burst(bool on);
+
+/**
+ * @brief Open the live stream; frames from now on are kept for it
+ * @return false if a stream is already open or there is no ring
+ */
+bool pcap_export_stream_open(void);
+
+/**
+ * @brief Copy the next stream bytes, starting with the file header
+ * @return Bytes copied, 0 if nothing is staged yet
+ */
+size_t pcap_export_stream_read(uint8_t* out, size_t max_len);
+
+/**
+ * @brief Close the live stream; its staged bytes are released
+ */
+void pcap_export_stream_close(void);
+
+/**
+ * @brief Copy the export figures
+ */
+void pcap_export_get_stats(pcap_export_stats_t* stats);
+
+#endif // PCAP_EXPORT_H
@@ -0,0 +1,75 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Work that needs the full clock while it runs
+ */
+typedef enum {
+    POWER_CLIENT_RENDER = 0,        // One renderer_frame()
+    POWER_CLIENT_SCAN,              // One scan cycle, sweep to publish
+    POWER_CLIENT_AI,                // One decision
+    POWER_CLIENT_BENCH,             // The benchmark run, env:bench only
+    POWER_CLIENT_COUNT
+} power_client_t;
+
+/**
+ * @brief What the power manager could configure, and how long each client held the clock
+ */
+typedef struct {
+    bool     dfs;                   // esp_pm configured: the clock drops to min_mhz when idle
+    bool     light_sleep;           // ...and the chip sleeps when no task is ready
+    uint16_t max_mhz;
+    uint16_t min_mhz;
+    uint32_t held_ms[POWER_CLIENT_COUNT];       // Since boot
+    uint32_t acquisitions[POWER_CLIENT_COUNT];
+} power_status_t;
+
+/**
+ * @brief Configure DFS between POWER_MIN_MHZ and POWER_MAX_MHZ, with light sleep if the core allows
+ *
+ * Without CONFIG_PM_ENABLE in the core the clock stays fixed; the clients'
+ * active time is still measured.
+ * @return true if esp_pm took the configuration
+ */
+bool power_manager_init(void);
+
+/**
+ * @brief Hold the full clock for a client's work; pair with power_manager_release()
+ *
+ * Each client is only used from one task.
+ */
+void power_manager_acquire(power_client_t client);
+
+/**
+ * @brief The client's work is done
+ */
+void power_manager_release(power_client_t client);
+
+/**
+ * @brief Lower or restore the top of the DFS range (thermal throttling)
+ * @return false if esp_pm is not in use; the caller sets the clock itself
+ */
+bool power_manager_set_max_mhz(uint16_t mhz);
+
+/**
+ * @brief Raise or restore the bottom of the DFS range (resource governor)
+ *
+ * Never below POWER_MIN_MHZ, and never above the top of the range.
+ * @return false if esp_pm is not in use
+ */
+bool power_manager_set_min_mhz(uint16_t mhz);
+
+/**
+ * @brief Copy the configuration and per-client figures
+ */
+void power_manager_get_status(power_status_t* status);
+
+/**
+ * @brief Short name for logs ("render", "scan", "ai")
+ */
+const char* power_manager_client_name(power_client_t client);
+
+#endif // POWER_MANAGER_H
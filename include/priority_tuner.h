@@ -0,0 +1,67 @@
+#ifndef PRIORITY_TUNER_H
+#define PRIORITY_TUNER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "loop_timing.h"
+
+/*
+ * Task priorities that follow the load. The priorities in config.h are
+ * each task's own, and the floor it returns to. Every
+ * PRIORITY_TUNE_INTERVAL_MS the tuner compares each loop's missed
+ * deadlines over the interval with how busy its core was: a loop that
+ * missed PRIORITY_BOOST_MISS_PCT of its iterations on a core busier than
+ * PRIORITY_CONTENDED_PCT was kept from running, and is raised a level,
+ * up to PRIORITY_BOOST_MAX above its own and never past PRIORITY_CEILING.
+ * A miss on an idle core is the loop's own work, which a priority does
+ * not shorten. PRIORITY_RELAX_AFTER quiet intervals lower a boost by a
+ * level. When the UI falls behind under load the other tasks' boosts are
+ * lowered first, so the face slows last.
+ *
+ * A task found running above the priority the tuner gave it has
+ * inherited it through a mutex a higher task is waiting on; that is
+ * logged when it starts and counted per look.
+ */
+
+/**
+ * @brief One tuned task
+ */
+typedef struct {
+    const char* name;               // Its loop's
+    uint8_t     base;               // From config.h
+    uint8_t     priority;           // Set by the tuner
+    uint8_t     running;            // At the last look, inheritance included
+    uint32_t    boosts;             // Times raised a level
+    uint32_t    relaxes;            // Times lowered a level
+    uint32_t    inherited;          // Looks that found it above its own
+} priority_task_stats_t;
+
+/**
+ * @brief Every tuned task and how often the UI came first
+ */
+typedef struct {
+    priority_task_stats_t tasks[LOOP_COUNT];
+    uint8_t  count;
+    uint32_t looks;
+    uint32_t ui_guards;             // Looks that lowered other boosts for the UI
+} priority_tuner_stats_t;
+
+/**
+ * @brief Hand a task's loop to the tuner; after the task is created
+ * @param base Priority it was created with
+ */
+void priority_tuner_register(loop_id_t loop, TaskHandle_t task, UBaseType_t base);
+
+/**
+ * @brief Look at the interval since the last call and move priorities (system task)
+ */
+void priority_tuner_adjust(void);
+
+/**
+ * @brief Copy the figures
+ */
+void priority_tuner_get(priority_tuner_stats_t* stats);
+
+#endif // PRIORITY_TUNER_H
@@ -0,0 +1,97 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Instrumented hot paths, each a fixed slot in the registry
+ */
+typedef enum {
+    PROFILE_RSSI_SUM = 0,           // rssi_sum_s8()
+    PROFILE_RSSI_MINMAX,            // rssi_minmax_s8()
+    PROFILE_HIST_ADD,               // rssi_hist_add_s8()
+    PROFILE_FEATURES,               // ai_features_extract()
+    PROFILE_RULES,                  // infer_ai_state()
+    PROFILE_DEVICE_OBSERVE,         // device_table_observe()
+    PROFILE_NOVELTY,                // novelty_filter_check_and_add()
+    PROFILE_ADV_PARSE,              // ble_adv_parse(), the BLE host task
+    PROFILE_FRAME_PARSE,            // One captured frame, capture task
+    PROFILE_RSSI_DISTANCE,          // rssi_sqdist_s8x16()
+    PROFILE_SITE_COUNT
+} profile_site_t;
+
+/**
+ * @brief One site's figures, summed over both cores
+ */
+typedef struct {
+    const char* name;
+    uint32_t    calls;
+    uint64_t    cycles;             // Inside the scope, scope overhead taken off
+    uint32_t    max_cycles;         // Longest single pass; preemption lands here
+    uint32_t    migrated;           // Passes dropped for ending on the other core
+} profile_stats_t;
+
+#if PROFILE_ENABLED
+
+/**
+ * @brief CPU cycles since reset on this core; wraps every 17.9 s at 240 MHz
+ */
+static inline uint32_t profile_ccount(void) {
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+}
+
+/**
+ * @brief Account one pass through a site; use PROFILE_SCOPE() instead
+ */
+void profile_record(profile_site_t site, uint32_t start_ccount, uint8_t start_core);
+
+/**
+ * @brief Times the rest of the enclosing block against one site
+ */
+struct profile_scope_t {
+    profile_site_t site;
+    uint8_t        core;
+    uint32_t       start;
+
+    explicit profile_scope_t(profile_site_t s)
+        : site(s), core((uint8_t)xPortGetCoreID()), start(profile_ccount()) {}
+    ~profile_scope_t() { profile_record(site, start, core); }
+};
+
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b)  PROFILE_JOIN_(a, b)
+#define PROFILE_SCOPE(site) profile_scope_t PROFILE_JOIN(profile_scope_, __LINE__)(site)
+#else
+#define PROFILE_SCOPE(site) ((void)0)
+#endif
+
+/**
+ * @brief Measure the scope's own cost, taken off every pass; call once at boot
+ */
+void profile_init(void);
+
+/**
+ * @brief Copy one site's figures
+ */
+void profile_get(profile_site_t site, profile_stats_t* stats);
+
+/**
+ * @brief Clear every site, e.g. before a run to be compared
+ */
+void profile_reset(void);
+
+/**
+ * @brief Write the registry as a text table, one line per site
+ * @return Characters written (without NUL)
+ */
+size_t profile_format(char* out, size_t capacity);
+
+/**
+ * @brief Write the registry to the serial port as "PROFILE" lines
+ */
+void profile_dump_serial(void);
+
+#endif // PROFILE_H
@@ -0,0 +1,162 @@
+#ifndef PROTOTHREAD_H
+#define PROTOTHREAD_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/*
+ * Stackless threads for one FreeRTOS task, so a flow that waits on the
+ * radio reads top to bottom instead of as a chain of callbacks:
+ *
+ *     PT_BEGIN(pt);
+ *     while (scan_scheduler_next_slot(&ctx.slot)) {
+ *         PT_SPAWN(pt, &ctx.dwell.pt, dwell_thread(&ctx.dwell.pt, &ctx.dwell));
+ *         PT_SLEEP_MS(pt, ctx.slot.duration_ms);
+ *     }
+ *     PT_END(pt);
+ *
+ * A thread is a function re-entered by the scheduler at the wait it last
+ * stopped at; the task itself blocks in one place, on its notification
+ * value, until the earliest deadline of its threads. The compiler in the
+ * Arduino core has no C++20 coroutines, so the resume point is a switch
+ * case (Duff's device, as Dunkels' protothreads). That has two rules:
+ * locals do not survive a wait, so keep state in a context struct, and a
+ * body may not have its own switch around a wait. One wait per line.
+ */
+
+#define PT_SCHED_MAX_THREADS 4
+
+/**
+ * @brief What a thread function returns to the one that ran it
+ */
+typedef enum {
+    PT_WAITING = 0,                 // Stopped at a wait; run again later
+    PT_EXITED                       // Ran off its end or PT_EXIT()ed
+} pt_status_t;
+
+struct pt_thread;
+
+/**
+ * @brief Resume point of one thread function; a spawned child has its own
+ */
+typedef struct {
+    uint16_t          line;         // Wait to resume at, 0 to start over
+    struct pt_thread* thread;       // Scheduler record the waits report to
+} pt_t;
+
+typedef pt_status_t (*pt_entry_t)(pt_t* pt);
+
+/**
+ * @brief A thread known to a scheduler
+ */
+typedef struct pt_thread {
+    const char* name;
+    pt_entry_t  entry;
+    pt_t        pt;
+    uint32_t    wake_ms;            // Deadline of the current wait, if timed
+    bool        timed;
+    bool        exited;
+    uint32_t    bits;               // Notification bits delivered since its wait began
+    uint32_t    runs;
+} pt_thread_t;
+
+/**
+ * @brief The threads one task runs, and why it woke
+ */
+typedef struct {
+    pt_thread_t* threads[PT_SCHED_MAX_THREADS];
+    uint8_t      count;
+    uint32_t     posted;            // Bits from the threads themselves, for the next pass
+    uint32_t     passes;            // Every thread run once
+    uint32_t     notified;          // Passes started by a task notification
+    uint32_t     timed_out;         // By a thread's deadline
+} pt_sched_t;
+
+#define PT_INIT(pt, owner) do { (pt)->line = 0; (pt)->thread = (owner); } while (0)
+
+#define PT_BEGIN(pt) switch ((pt)->line) { case 0:
+
+#define PT_END(pt) } (pt)->line = 0; return PT_EXITED
+
+#define PT_EXIT(pt) do { (pt)->line = 0; return PT_EXITED; } while (0)
+
+// Re-checked each pass: on a notification, a post, or another thread's deadline
+#define PT_WAIT_UNTIL(pt, condition) do { \
+        (pt)->line = __LINE__; case __LINE__: \
+        if (!(condition)) { return PT_WAITING; } \
+    } while (0)
+
+// Let the other threads run, then carry on
+#define PT_YIELD(pt) do { \
+        (pt)->thread->timed = true; (pt)->thread->wake_ms = millis(); \
+        (pt)->line = __LINE__; return PT_WAITING; case __LINE__:; \
+        (pt)->thread->timed = false; \
+    } while (0)
+
+#define PT_SLEEP_UNTIL(pt, deadline_ms) do { \
+        (pt)->thread->timed = true; (pt)->thread->wake_ms = (deadline_ms); \
+        PT_WAIT_UNTIL(pt, pt_expired((pt)->thread)); \
+        (pt)->thread->timed = false; \
+    } while (0)
+
+#define PT_SLEEP_MS(pt, ms) PT_SLEEP_UNTIL(pt, millis() + (uint32_t)(ms))
+
+// Until one of mask's bits is notified or timeout_ms passes; bits that came
+// before the wait began do not count
+#define PT_AWAIT_BITS(pt, mask, timeout_ms) do { \
+        (pt)->thread->bits &= ~(uint32_t)(mask); \
+        (pt)->thread->timed = true; (pt)->thread->wake_ms = millis() + (uint32_t)(timeout_ms); \
+        PT_WAIT_UNTIL(pt, ((pt)->thread->bits & (mask)) != 0 || pt_expired((pt)->thread)); \
+        (pt)->thread->bits &= ~(uint32_t)(mask); \
+        (pt)->thread->timed = false; \
+    } while (0)
+
+// Until one of mask's bits is notified, however long that takes
+#define PT_WAIT_BITS(pt, mask) do { \
+        (pt)->thread->bits &= ~(uint32_t)(mask); \
+        PT_WAIT_UNTIL(pt, ((pt)->thread->bits & (mask)) != 0); \
+        (pt)->thread->bits &= ~(uint32_t)(mask); \
+    } while (0)
+
+// Run a child thread function to its end; its waits are this thread's
+#define PT_SPAWN(pt, child, call) do { \
+        PT_INIT(child, (pt)->thread); \
+        PT_WAIT_UNTIL(pt, (call) == PT_EXITED); \
+    } while (0)
+
+/**
+ * @brief Whether a thread's timed wait has run out
+ */
+static inline bool pt_expired(const pt_thread_t* thread) {
+    return (int32_t)(millis() - thread->wake_ms) >= 0;
+}
+
+/**
+ * @brief Start with no threads
+ */
+void pt_sched_init(pt_sched_t* sched);
+
+/**
+ * @brief Add a thread, to be first run by pt_sched_run()
+ * @return false with PT_SCHED_MAX_THREADS already added
+ */
+bool pt_sched_add(pt_sched_t* sched, pt_thread_t* thread, const char* name, pt_entry_t entry);
+
+/**
+ * @brief Hand bits to every thread of the scheduler at the next pass (its own task)
+ *
+ * Threads of one task signal each other this way; other tasks and the
+ * radio callbacks notify the task.
+ */
+void pt_sched_post(pt_sched_t* sched, uint32_t bits);
+
+/**
+ * @brief Run the threads on the calling task; returns once every one has exited
+ *
+ * Each pass runs every live thread once, in the order added. The task then
+ * blocks on its notification value until the earliest deadline, and the
+ * bits it receives are handed to every thread.
+ */
+void pt_sched_run(pt_sched_t* sched);
+
+#endif // PROTOTHREAD_H
@@ -0,0 +1,66 @@
+#ifndef PROVISIONING_H
+#define PROVISIONING_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+
+/**
+ * @brief Provisioning figures since boot
+ */
+typedef struct {
+    bool     open;                  // SoftAP up now
+    bool     stored;                // Credentials provisioned, replacing WIFI_LINK_SSID
+    uint8_t  clients;               // Stations on the SoftAP
+    uint32_t opened;                // Times the portal was opened
+    uint32_t credential_saves;      // New uplink credentials committed
+    uint32_t tunable_sets;          // Tunable values taken through the portal
+    uint32_t rejected;              // Values refused: bad length, unknown name, out of bounds
+} provision_status_t;
+
+/*
+ * Configuration without a rebuild. A long press on the screen opens a
+ * WPA2 SoftAP whose passphrase is drawn afresh each time and shown only on
+ * the unit's own ticker and console, so changing a unit takes having it
+ * in hand. Phones joining it are sent to PROVISION_PATH by a catch-all DNS
+ * and captive portal handler, where a form sets the uplink credentials
+ * and any tunable. Neither route answers on the station side.
+ *
+ * Tunables apply the moment they are set. Credentials are committed to the
+ * journal (NVS without one) and the link moves to the new network at once.
+ * The portal closes PROVISION_IDLE_MS after the last request.
+ */
+
+/**
+ * @brief Restore provisioned uplink credentials
+ *
+ * Call after journal_init() and before wifi_link_init().
+ */
+void provisioning_init(void);
+
+/**
+ * @brief Add the portal routes and the captive handler to the web server
+ *
+ * Call last, just before server->begin(): the captive handler takes every
+ * SoftAP request no route before it matched.
+ */
+void provisioning_register(AsyncWebServer* server);
+
+/**
+ * @brief Ask for the portal to open (safe from any task)
+ */
+void provisioning_request_open(void);
+
+/**
+ * @brief Open and close the SoftAP, answer DNS, commit credentials
+ *
+ * Runs on the system task.
+ */
+void provisioning_tick(uint32_t now_ms);
+
+/**
+ * @brief Copy the provisioning figures
+ */
+void provisioning_get_status(provision_status_t* status);
+
+#endif // PROVISIONING_H
@@ -0,0 +1,164 @@
+#ifndef RADIO_LINK_H
+#define RADIO_LINK_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "scan_profile.h"
+
+#define RADIO_LINK_SYNC0        0xA5
+#define RADIO_LINK_SYNC1        0x5A
+#define RADIO_LINK_VERSION      1
+#define RADIO_LINK_PAYLOAD_MAX  240
+
+/**
+ * @brief Frame types; HELLO and OBSERVATIONS come from a module, ASSIGN goes to one
+ */
+typedef enum {
+    RADIO_MSG_HELLO = 1,
+    RADIO_MSG_OBSERVATIONS = 2,
+    RADIO_MSG_ASSIGN = 3
+} radio_msg_t;
+
+/**
+ * @brief Start of every frame (6 bytes); the payload follows, then a CRC-32
+ *
+ * The CRC is esp_rom_crc32_le(0, ...), zlib's crc32, from type to the
+ * payload's end, the sync bytes excluded, sent little-endian.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  sync0;                 // RADIO_LINK_SYNC0
+    uint8_t  sync1;                 // RADIO_LINK_SYNC1
+    uint8_t  type;                  // radio_msg_t
+    uint8_t  radio;                 // Module number on the link, below RADIO_LINK_MAX_RADIOS
+    uint8_t  seq;                   // Per-module frame counter
+    uint8_t  length;                // Payload bytes
+} radio_frame_header_t;
+
+/**
+ * @brief HELLO payload, sent by a module at start and every second or so
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  version;               // RADIO_LINK_VERSION
+    uint8_t  bands;                 // RADIO_BAND_* bits
+    uint16_t channel_mask;          // Channels the module can sweep, bit n for channel n
+    uint16_t dropped;               // Observations the module could not send, since its boot
+    uint16_t reserved;
+} radio_hello_t;
+
+#define RADIO_BAND_WIFI  0x01
+#define RADIO_BAND_BLE   0x02
+
+/**
+ * @brief One sighting in an OBSERVATIONS payload (12 bytes)
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  mac[6];                // BSSID or BLE address
+    uint8_t  kind;                  // device_kind_t
+    int8_t   rssi;
+    uint8_t  channel;               // WiFi channel, 0 for BLE
+    uint8_t  flags;                 // Reserved, 0
+    uint16_t age_ms;                // Before the frame was sent (saturating)
+} radio_observation_t;
+
+#define RADIO_OBSERVATIONS_PER_FRAME (RADIO_LINK_PAYLOAD_MAX / sizeof(radio_observation_t))
+
+/**
+ * @brief ASSIGN payload: what a module sweeps until the next one
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t channel_mask;          // 0: WiFi idle, BLE only if it has it
+    uint16_t dwell_ms;              // Per channel, 0 for the module's own
+    uint8_t  passive;
+    uint8_t  reserved;
+} radio_assign_t;
+
+/**
+ * @brief One module as the aggregator sees it
+ */
+typedef struct {
+    bool     live;                  // Heard from within RADIO_LINK_TTL_MS
+    uint8_t  bands;
+    uint16_t supported_mask;
+    uint16_t assigned_mask;         // Its share of the last plan
+    uint16_t module_dropped;        // As it last reported
+    uint32_t frames;
+    uint32_t frames_lost;           // Gaps in its frame counter
+    uint32_t observations;
+    uint32_t merged;                // Taken into the device table
+    uint32_t rejected;              // WiFi on channels it was not given, or bad kinds
+    uint32_t last_seen_ms;
+} radio_module_t;
+
+/**
+ * @brief Link traffic since boot
+ */
+typedef struct {
+    bool     running;
+    uint8_t  live;                  // Modules heard within RADIO_LINK_TTL_MS
+    uint16_t local_mask;            // Channels this node kept for its own radio
+    uint32_t bytes;
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t rejected;              // Unknown types, bad lengths, module numbers past the last
+    uint32_t resyncs;               // Bytes skipped looking for a frame start, bad frames included
+    uint32_t assigns_sent;
+} radio_link_stats_t;
+
+/*
+ * Extra radios on a wire. One S3 radio sweeps one channel at a time, so
+ * secondary boards (an ESP32 per radio, or a hub multiplexing several)
+ * stream compact binary observations over a UART and take channel
+ * assignments back. Each plan's channels are dealt round-robin between
+ * this node and every live module that sweeps WiFi, the same way nearby
+ * mesh nodes split theirs, so coverage grows with the modules attached
+ * and each channel is still swept by one radio only. The scan task drains
+ * the link once per cycle, before it folds its own results, and merges a
+ * module's WiFi sightings on the channels it was given, and its BLE
+ * sightings, into the device table: everything behind the table counts
+ * them as this cycle's. A module that goes quiet gives its channels back
+ * at the next plan.
+ */
+
+/**
+ * @brief Install the UART driver on BOARD.radio_link
+ * @return false without pins or if the driver would not install
+ */
+bool radio_link_init(void);
+
+/**
+ * @brief Take the link's frames into the device table and send changed assignments
+ *
+ * Called from the scan task once per cycle, after the sweep.
+ */
+void radio_link_collect(uint32_t now_ms);
+
+/**
+ * @brief Parse link bytes from any source, e.g. a replayed capture; from the scan task
+ */
+void radio_link_feed(const uint8_t* data, size_t length, uint32_t now_ms);
+
+/**
+ * @brief Deal a plan's channels between this node and the live modules
+ *
+ * Single-channel plans stay local.
+ * @return Channels this node's own radio sweeps
+ */
+uint16_t radio_link_filter_mask(uint16_t mask, const scan_profile_t* profile);
+
+/**
+ * @brief WiFi access points the modules reported on channels they were given
+ */
+uint16_t radio_link_remote_networks(uint32_t now_ms);
+
+/**
+ * @brief Copy the link figures
+ */
+void radio_link_get_stats(radio_link_stats_t* stats);
+
+/**
+ * @brief Copy one module's figures
+ * @return false past RADIO_LINK_MAX_RADIOS
+ */
+bool radio_link_get_module(uint8_t radio, radio_module_t* module);
+
+#endif // RADIO_LINK_H
@@ -0,0 +1,60 @@
+#ifndef RENDER_SPLIT_H
+#define RENDER_SPLIT_H
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+
+/**
+ * @brief What the split did, since boot
+ */
+typedef struct {
+    bool     running;               // Helper task up and the blend hook installed
+    bool     allowed;               // In the refresh under way, or the last one
+    float    core_pct;              // Helper core's load the decision was taken on
+    uint32_t refreshes;             // Refreshes with splitting allowed
+    uint32_t refreshes_busy;        // Refreshes drawn alone, the helper core being busy
+    uint32_t blends;                // Blends large enough to split
+    uint32_t stripes_helper;        // Top stripes the helper drew
+    uint32_t stripes_stolen;        // Top stripes taken back, the helper not having started
+    uint64_t px_helper;             // Pixels the helper drew
+} render_split_stats_t;
+
+/*
+ * LVGL 8 draws on one task: the objects of a dirty area are walked in
+ * order, and each draw call ends in a blend of a colour or a pixel map
+ * into the draw buffer. A large blend - backgrounds, panels, images,
+ * chart areas - is cut into two horizontal stripes: the top one is handed
+ * to a helper task on the other core and the UI task blends the bottom
+ * one, then both are done before LVGL's next draw call, so the buffer is
+ * whole when it is flushed. Only the blend is shared; masks, glyphs and
+ * LVGL's temporary buffers stay on the UI task, so nothing LVGL keeps in
+ * globals is touched from two cores.
+ *
+ * The helper runs at the scan task's priority and never preempts it. If it
+ * has not started its stripe by the time the UI task is done with its own,
+ * the UI task takes the stripe back, so a busy core 0 costs one task
+ * notification per blend, not a wait. Splitting is off for a refresh when
+ * the helper's core was busier than RENDER_SPLIT_CORE_MAX_PCT over the last
+ * CPU load sample.
+ */
+
+/**
+ * @brief Start the helper task and put the split blend into the display's draw context
+ * @return false if the task could not be created
+ */
+bool render_split_init(lv_disp_t* disp);
+
+/**
+ * @brief Decide, from the CPU load, whether the refresh starting now splits its blends
+ *
+ * Called from the renderer's render_start_cb.
+ */
+void render_split_begin_refresh(lv_disp_t* disp);
+
+/**
+ * @brief Copy the split figures
+ */
+void render_split_get_stats(render_split_stats_t* stats);
+
+#endif // RENDER_SPLIT_H
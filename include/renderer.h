@@ -0,0 +1,247 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+
+/**
+ * @brief One full-screen UI; the renderer gives it its own LVGL screen
+ *
+ * Screens are built on first entry. Under LVGL memory pressure the screens
+ * of scenes not shown recently are deleted and rebuilt on their next entry;
+ * a scene without a destroy callback is never torn down.
+ */
+typedef struct {
+    const char* name;
+    void (*create)(lv_obj_t* screen);   // Build the scene's objects
+    void (*update)(uint32_t now_ms);    // Refresh them, once per frame while shown
+    uint32_t (*wait_ms)(uint32_t now_ms); // Time until update() has work, NULL for none
+    void (*destroy)(void);              // Forget the objects, their screen is deleted next
+} renderer_scene_t;
+
+/**
+ * @brief How frames get from LVGL to the panel
+ */
+typedef enum {
+    RENDERER_MODE_BANDS = 0,        // Dirty areas rendered band by band into two internal buffers
+    RENDERER_MODE_FULL_FRAME        // Two full framebuffers in PSRAM, only changed spans sent
+} renderer_mode_t;
+
+/**
+ * @brief Where the renderer ended up after init
+ */
+typedef struct {
+    lv_coord_t  width;                  // Screen in the current rotation
+    lv_coord_t  height;
+    uint8_t     rotation;               // TFT_eSPI rotation, 0-3
+    uint32_t    rotations;              // renderer_set_rotation() changes since boot
+    uint16_t    band_rows;              // Height of each draw buffer at the boot rotation
+    const char* buffer_placement;       // "internal DMA RAM", "PSRAM" or "internal RAM"
+    bool        flush_dma;              // Bands are queued to DMA, the CPU free meanwhile
+    const char* bus;                    // Display bus of the board profile: "SPI" or "i80"
+    uint32_t    bus_hz;
+    renderer_mode_t mode;
+    uint32_t    mode_switches;
+    uint32_t    frames;                 // Frames rendered
+    uint32_t    frame_us;               // Render + flush time of the last one
+    uint32_t    frames_over_budget;     // Frames that took more than RENDERER_FRAME_BUDGET_MS
+    uint32_t    frames_skipped;         // Budgets waited out to let the flush catch up
+    uint16_t    refresh_period_ms;      // LVGL refresh timer period in force
+    uint16_t    active_period_ms;       // Period while animating, from the refresh times
+    uint32_t    period_changes;         // Switches between static and active periods
+    uint32_t    label_updates;          // Label texts changed (each one redraws its area)
+    uint32_t    label_unchanged;        // Refreshes that produced the same text
+    bool        standby;                // Panel asleep, backlight off
+    uint32_t    standby_entries;
+    uint32_t    scene_builds;           // Screens built, including rebuilds after eviction
+    uint32_t    scene_evictions;        // Screens deleted to free LVGL memory
+} renderer_info_t;
+
+/**
+ * @brief Where the time of LVGL refreshes goes, since boot
+ *
+ * A refresh runs from LVGL's render_start_cb to its monitor_cb. Flush time
+ * is spent inside disp_flush(): with DMA that is the wait for the previous
+ * band to leave, so it grows when the bus, not rendering, is the bottleneck.
+ * Render time is the rest of the refresh.
+ */
+typedef struct {
+    uint32_t refreshes;             // LVGL refreshes that drew something
+    uint32_t bands;                 // disp_flush() calls
+    uint32_t refresh_us;            // Last refresh, render + flush
+    uint32_t refresh_max_us;
+    uint32_t render_us;             // Last refresh, drawing into the bands
+    uint32_t render_max_us;
+    uint64_t render_total_us;
+    uint32_t flush_us;              // Last refresh, blocked in disp_flush()
+    uint32_t flush_max_us;
+    uint64_t flush_total_us;
+    uint32_t area_px;               // Last refresh, invalidated pixels drawn
+    uint64_t area_total_px;
+    uint64_t bytes_flushed;
+    uint64_t bytes_unchanged;       // Full-frame mode: dirty pixels found equal to the panel's
+    uint32_t frames_dropped;        // Same as renderer_info_t.frames_skipped
+} renderer_profile_t;
+
+/**
+ * @brief Label that is only invalidated when its text changes
+ *
+ * The text is re-formatted at most every period_ms and compared with what
+ * is on screen; an unchanged label costs no rendering and no SPI traffic.
+ */
+typedef struct {
+    lv_obj_t* obj;
+    uint32_t  period_ms;            // 0 re-formats on every frame drawn for other reasons
+    uint32_t  refreshed_ms;
+    bool      shown;                // text is on screen
+    char      text[RENDERER_LABEL_CHARS];
+} renderer_label_t;
+
+/**
+ * @brief Bring up the panel, LVGL, its draw buffers and its tick source
+ *
+ * The only place that touches TFT_eSPI or calls lv_init(). Must be called
+ * from the task that will call renderer_frame(), as LVGL is not thread safe.
+ * @return false if the draw buffers cannot be allocated
+ */
+bool renderer_init(void);
+
+/**
+ * @brief Turn the picture to another TFT_eSPI rotation (0-3)
+ *
+ * LVGL gets the new resolution and every screen is resized, which makes
+ * LVGL re-run their flex layouts once (see ui_layout.h). Touch points are
+ * turned along with the picture. The draw buffers need no change: they hold
+ * a fixed pixel count and LVGL cuts bands from them to the new width.
+ */
+void renderer_set_rotation(uint8_t rotation);
+
+/**
+ * @brief Switch between band rendering and full-frame diff rendering
+ *
+ * Full-frame mode renders into one of two PSRAM framebuffers (LVGL direct
+ * mode) and compares each dirty area against the other, which holds what
+ * the panel shows; only rectangles of changed rows are staged through the
+ * band buffers and sent. The framebuffers are allocated on entry and freed
+ * on leaving. The whole screen is redrawn after a switch.
+ * @return false if the framebuffers cannot be allocated
+ */
+bool renderer_set_mode(renderer_mode_t mode);
+
+/**
+ * @brief Give back memory the renderer can rebuild on demand
+ *
+ * Deletes every idle screen with a destroy hook, whatever LVGL has free;
+ * each is rebuilt when next shown. With deep, also drops LVGL's image
+ * cache and leaves full-frame mode, freeing both framebuffers. UI task only.
+ * @return Screens deleted
+ */
+uint8_t renderer_release_memory(bool deep);
+
+/**
+ * @brief Make a scene current, building its screen if it has none
+ *
+ * Before a build, idle screens are evicted, least recently shown first,
+ * until LVGL has RENDERER_SCENE_RESERVE bytes free.
+ * @return false if more than RENDERER_MAX_SCENES distinct scenes are shown
+ */
+bool renderer_show(const renderer_scene_t* scene);
+
+/**
+ * @brief The scene on screen, NULL before the first renderer_show()
+ */
+const renderer_scene_t* renderer_current_scene(void);
+
+/**
+ * @brief Time until the current scene's update() has work
+ * @return UINT32_MAX if the scene only changes on events
+ */
+uint32_t renderer_scene_wait_ms(uint32_t now_ms);
+
+/**
+ * @brief Update the current scene and let LVGL render and flush
+ *
+ * Backs off for a few budgets after a frame overruns RENDERER_FRAME_BUDGET_MS.
+ * @return ms until LVGL next needs a frame, UINT32_MAX if no timer is pending
+ */
+uint32_t renderer_frame(void);
+
+/**
+ * @brief Shortest gap between frames the renderer wants now
+ *
+ * RENDERER_STATIC_FRAME_MS for a still screen; while an animation runs,
+ * the pen is down or a scroll is under way, the active period. Events
+ * still wake the UI task sooner.
+ */
+uint32_t renderer_frame_interval_ms(void);
+
+/**
+ * @brief Park the panel with its last frame, or wake it
+ *
+ * Entering waits for a complete frame: it fails while areas are dirty or
+ * animations run, so the caller retries later. The panel then gets SLPIN
+ * and the backlight PWM is stopped; the caller stops calling
+ * renderer_frame() until it wakes the panel. Waking sends SLPOUT and the
+ * frame reappears from the panel's GRAM without a redraw.
+ * @return false if the frame is not complete yet (entering only)
+ */
+bool renderer_standby(bool standby);
+
+/**
+ * @brief Start polling the touch controller after a pen-down interrupt
+ *
+ * LVGL reads it every TOUCH_READ_PERIOD_MS until the pen lifts.
+ */
+void renderer_touch_active(void);
+
+/**
+ * @brief The panel is parked by renderer_standby()
+ */
+bool renderer_in_standby(void);
+
+/**
+ * @brief Create a cached label on a scene's screen
+ * @return The LVGL label, for styling and placement
+ */
+lv_obj_t* renderer_label_create(renderer_label_t* label, lv_obj_t* parent, uint32_t period_ms);
+
+/**
+ * @brief The label's refresh period has elapsed (always true before its first text)
+ */
+bool renderer_label_due(const renderer_label_t* label, uint32_t now_ms);
+
+/**
+ * @brief Time until the label is due, for sleeping between frames
+ * @return 0 when due, UINT32_MAX for a period of 0 (never wakes the UI itself)
+ */
+uint32_t renderer_label_wait_ms(const renderer_label_t* label, uint32_t now_ms);
+
+/**
+ * @brief Format the label's text and hand it to LVGL only if it changed
+ * @return true if the label was invalidated
+ */
+bool renderer_label_printf(renderer_label_t* label, uint32_t now_ms, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief Mark a latency trace's flush stage when the next frame's last band is out (UI task)
+ *
+ * A trace still waiting for its frame is given up for the newer one.
+ */
+void renderer_trace_flush(uint16_t trace);
+
+/**
+ * @brief Copy the renderer configuration and frame counter
+ */
+void renderer_get_info(renderer_info_t* info);
+
+/**
+ * @brief Copy the refresh timings
+ *
+ * With RENDERER_PROFILE_OVERLAY they are also drawn in a corner of the
+ * screen, refreshed every RENDERER_PROFILE_OVERLAY_MS while frames are drawn.
+ */
+void renderer_get_profile(renderer_profile_t* profile);
+
+#endif // RENDERER_H
@@ -0,0 +1,49 @@
+#ifndef RSSI_HISTOGRAM_H
+#define RSSI_HISTOGRAM_H
+
+#include <stdint.h>
+#include "config.h"
+
+/**
+ * @brief Fixed-bin RSSI histogram (RSSI_HIST_BIN_DB wide bins)
+ */
+typedef struct {
+    uint16_t bins[RSSI_HIST_BINS];      // Bin 0 starts at RSSI_HIST_MIN_DBM
+    uint16_t count;                     // Total observations
+} rssi_hist_t;
+
+/**
+ * @brief RSSI distributions of the last scan cycle, published next to sensor_data_t
+ */
+typedef struct {
+    rssi_hist_t wifi_channel[WIFI_CHANNEL_COUNT + 1];  // Per channel (index = channel)
+    rssi_hist_t wifi_all;                             // All WiFi networks
+    rssi_hist_t ble;                                  // Recently heard BLE devices
+} scan_histograms_t;
+
+/**
+ * @brief Clear all bins
+ */
+void rssi_hist_reset(rssi_hist_t* hist);
+
+/**
+ * @brief Add one observation (values outside the range land in the end bins)
+ * @param hist Histogram to update
+ * @param rssi Signal strength in dBm
+ */
+void rssi_hist_add(rssi_hist_t* hist, int8_t rssi);
+
+/**
+ * @brief Estimate a quantile in O(RSSI_HIST_BINS) by interpolating within a bin
+ * @param hist Histogram to query
+ * @param percent Quantile in percent (e.g. 10, 50, 90)
+ * @return Estimated RSSI in dBm, or -100 if the histogram is empty
+ */
+int8_t rssi_hist_quantile(const rssi_hist_t* hist, uint8_t percent);
+
+/**
+ * @brief Clear every histogram in a scan_histograms_t
+ */
+void scan_histograms_reset(scan_histograms_t* hists);
+
+#endif // RSSI_HISTOGRAM_H
@@ -0,0 +1,59 @@
+#ifndef RSSI_KERNELS_H
+#define RSSI_KERNELS_H
+
+#include <stdint.h>
+#include "config.h"
+#include "rssi_histogram.h"
+
+/**
+ * @brief Sum of an int8 RSSI array
+ * @param values RSSI samples in dBm
+ * @param count Number of samples
+ * @return Sum of the samples
+ */
+int32_t rssi_sum_s8(const int8_t* values, uint32_t count);
+
+/**
+ * @brief Minimum and maximum of an int8 RSSI array
+ * @param values RSSI samples in dBm
+ * @param count Number of samples (min/max are left untouched if 0)
+ * @param min Receives the weakest sample
+ * @param max Receives the strongest sample
+ */
+void rssi_minmax_s8(const int8_t* values, uint32_t count, int8_t* min, int8_t* max);
+
+/**
+ * @brief Bin an int8 RSSI array into a histogram
+ * @param hist Histogram to update
+ * @param values RSSI samples in dBm
+ * @param count Number of samples
+ */
+void rssi_hist_add_s8(rssi_hist_t* hist, const int8_t* values, uint32_t count);
+
+/**
+ * @brief Fold one sample per element into an array of 1/16 dBm EWMAs
+ * @param ewma_x16 EWMAs to update in place
+ * @param samples New samples in dBm, one per EWMA
+ * @param count Number of elements
+ * @param shift EWMA weight as a right shift
+ */
+void rssi_ewma_update_s16(int16_t* ewma_x16, const int8_t* samples, uint32_t count, uint8_t shift);
+
+/**
+ * @brief Squared Euclidean distance from one 16-lane int8 vector to each of many
+ *
+ * Lanes must differ by less than 128 and every vector, the query
+ * included, must be 16-byte aligned.
+ * @param query Vector to compare against
+ * @param vectors count vectors of 16 lanes, back to back
+ * @param count Number of vectors
+ * @param distances Receives one distance per vector
+ */
+void rssi_sqdist_s8x16(const int8_t* query, const int8_t* vectors, uint32_t count, uint32_t* distances);
+
+/**
+ * @brief Time the vector and scalar paths against each other and log the results
+ */
+void rssi_kernels_benchmark(void);
+
+#endif // RSSI_KERNELS_H
@@ -0,0 +1,31 @@
+#ifndef SCAN_EVENTS_H
+#define SCAN_EVENTS_H
+
+#include <stdint.h>
+
+/**
+ * @brief Delta events emitted by the scan task
+ */
+typedef enum {
+    SCAN_EVENT_DEVICE_APPEARED = 0,
+    SCAN_EVENT_DEVICE_LOST,
+    SCAN_EVENT_DEVICE_MOVED,
+    SCAN_EVENT_CYCLE_COMPLETE,      // Snapshot for the cycle has been published
+    SCAN_EVENT_AP_ANOMALY           // A rogue access point pattern (see ap_anomaly.h)
+} scan_event_type_t;
+
+/**
+ * @brief One queued scan event (20 bytes)
+ */
+typedef struct {
+    uint8_t  type;                  // scan_event_type_t
+    uint8_t  kind;                  // device_kind_t (device events)
+    int8_t   rssi;                  // Latest RSSI (device events)
+    uint8_t  detail;                // ap_anomaly_t (anomaly events)
+    uint8_t  mac[6];                // Device address (device and anomaly events)
+    uint16_t dropped;               // Device events dropped since the last cycle event
+    uint16_t trace;                 // Latency trace of the cycle (latency_trace.h), 0 for none
+    uint32_t timestamp_ms;
+} scan_event_t;
+
+#endif // SCAN_EVENTS_H
@@ -0,0 +1,41 @@
+#ifndef SCAN_INTERVAL_H
+#define SCAN_INTERVAL_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "device_table.h"
+
+/**
+ * @brief Adaptive scan interval controller state
+ */
+typedef struct {
+    uint16_t churn_permille;        // Churn measured in the last cycle
+    uint16_t scale_pct;             // Current scale applied to the profile interval
+    uint8_t  calm_cycles;           // Consecutive cycles below SCAN_ADAPT_CHURN_LOW
+    bool     thermal_hold;          // Held at the ceiling by thermal throttling
+    uint32_t interval_ms;           // Interval chosen for the next sleep
+} scan_interval_stats_t;
+
+/**
+ * @brief Start at the profile's nominal interval
+ */
+void scan_interval_init(void);
+
+/**
+ * @brief Feed one cycle's delta and pick the next interval
+ *
+ * Bursts shrink the interval straight to the floor; it only stretches
+ * back after several quiet cycles, one step at a time.
+ * @param delta Device changes of the cycle just closed
+ * @param base_ms Nominal interval of the active scan profile
+ * @param thermal_hold Thermal throttling asks for the ceiling
+ * @return Time to sleep before the next cycle, in milliseconds
+ */
+uint32_t scan_interval_update(const device_delta_t* delta, uint32_t base_ms, bool thermal_hold);
+
+/**
+ * @brief Copy the controller state
+ */
+void scan_interval_get_stats(scan_interval_stats_t* stats);
+
+#endif // SCAN_INTERVAL_H
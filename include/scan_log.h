@@ -0,0 +1,180 @@
+#ifndef SCAN_LOG_H
+#define SCAN_LOG_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define SCAN_LOG_SYNC          0x4C53   // "SL"
+#define SCAN_LOG_FORMAT        1
+#define SCAN_LOG_SECTOR_BYTES  512
+#define SCAN_LOG_PAYLOAD_BYTES 16
+
+/**
+ * @brief What a record's payload holds
+ */
+typedef enum {
+    SCAN_LOG_BOOT = 1,              // scan_log_boot_t, first record of every boot
+    SCAN_LOG_STATE_CHANGE,          // scan_log_state_t, a committed AI transition
+    SCAN_LOG_NETWORKS,              // scan_log_networks_t, the periodic network summary
+    SCAN_LOG_SYSTEM,                // scan_log_system_t, the periodic status report
+    SCAN_LOG_DEVICE_APPEARED,       // scan_log_sighting_t, a device's first sighting
+    SCAN_LOG_DEVICE_CHANGED,        // scan_log_sighting_t, RSSI left the band around the last raw record
+    SCAN_LOG_DEVICE_PRESENT,        // scan_log_presence_t, a heartbeat: still there, RSSI within the band
+    SCAN_LOG_DEVICE_GONE,           // scan_log_presence_t, aged out of the device table
+    SCAN_LOG_CLOCK,                 // scan_log_clock_t, the wall clock at the record's uptime
+    SCAN_LOG_POSITION               // scan_log_position_t, where the cycle whose sightings follow was heard
+} scan_log_type_t;
+
+/**
+ * @brief One framed record (little-endian, fixed layout)
+ *
+ * Records never straddle a sector. Slots whose sync word does not match
+ * are padding, written to keep every flush sector-aligned; slots whose
+ * CRC does not match were torn by a power loss.
+ */
+typedef struct {
+    uint16_t sync;                  // SCAN_LOG_SYNC
+    uint8_t  type;                  // scan_log_type_t
+    uint8_t  length;                // Payload bytes in use
+    uint32_t sequence;              // Since boot; a gap is records dropped while staging
+    uint32_t timestamp_ms;          // millis() when the record was made
+    uint8_t  payload[SCAN_LOG_PAYLOAD_BYTES];
+    uint32_t crc32;                 // esp_rom_crc32_le() of the bytes above
+} scan_log_record_t;
+
+typedef struct {
+    uint16_t format;                // SCAN_LOG_FORMAT
+    uint8_t  record_bytes;          // sizeof(scan_log_record_t) of the writer
+    uint8_t  reset_reason;          // esp_reset_reason()
+    uint32_t heap_size;             // ESP.getHeapSize() of the recording unit
+} scan_log_boot_t;
+
+typedef struct {
+    uint8_t  from;                  // ai_state_t
+    uint8_t  to;
+    uint16_t reserved;
+    float    confidence;            // Of the decision that committed the state
+    uint32_t duration_ms;           // Time spent in the state left
+} scan_log_state_t;
+
+typedef struct {
+    uint16_t wifi_networks;
+    uint16_t ble_devices;
+    int8_t   wifi_rssi;             // Averages, dBm
+    int8_t   ble_rssi;
+    uint16_t ble_phones;
+    uint16_t ble_trackers;
+    uint16_t wifi_clients;          // Estimated stations per minute
+    uint16_t probe_requests;
+    uint16_t capture_fps;
+} scan_log_networks_t;
+
+typedef struct {
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint16_t free_psram_kb;
+    int16_t  temperature_dc;        // Tenths of a degree Celsius
+    uint8_t  cpu_pct;
+    uint8_t  thermal_level;         // thermal_level_t
+    uint8_t  task_count;
+    uint8_t  critical;
+} scan_log_system_t;
+
+/**
+ * @brief A raw sighting: the device and the RSSI later records are measured against
+ */
+typedef struct {
+    uint8_t  mac[6];
+    uint8_t  kind;                  // device_kind_t
+    uint8_t  channel;               // 0 for BLE
+    int8_t   rssi;
+} scan_log_sighting_t;
+
+/**
+ * @brief The cycles a device was seen in since its previous record
+ */
+typedef struct {
+    uint8_t  mac[6];
+    uint8_t  kind;                  // device_kind_t
+    int8_t   rssi_min;              // Over those cycles
+    int8_t   rssi_max;
+    int8_t   rssi_last;
+    uint16_t cycles;
+} scan_log_presence_t;
+
+/**
+ * @brief The wall clock was set or stepped; places the boot's other records
+ */
+typedef struct {
+    uint32_t epoch_s;               // Wall clock at the record's timestamp_ms
+    uint16_t epoch_ms;
+    uint8_t  source;                // time_source_t
+    uint8_t  stratum;
+    int32_t  step_ms;               // Correction over the previous clock, 0 for the first
+} scan_log_clock_t;
+
+/**
+ * @brief A GPS fix, staged ahead of its cycle's sightings (wardriving)
+ */
+typedef struct {
+    int32_t  lat_e7;                // Degrees x 1e7
+    int32_t  lon_e7;
+    uint32_t utc_s;                 // GPS time of the fix, 0 without a date
+    int16_t  alt_m;
+    uint8_t  speed_kmh;             // Saturates at 255
+    uint8_t  hdop_x10;
+} scan_log_position_t;
+
+static_assert(sizeof(scan_log_record_t) == 32, "scan log record layout changed");
+static_assert(SCAN_LOG_SECTOR_BYTES % sizeof(scan_log_record_t) == 0, "records must tile a sector");
+static_assert(SCAN_LOG_STAGING_BYTES % SCAN_LOG_SECTOR_BYTES == 0, "staging must hold whole sectors");
+static_assert(sizeof(scan_log_boot_t) <= SCAN_LOG_PAYLOAD_BYTES &&
+              sizeof(scan_log_state_t) <= SCAN_LOG_PAYLOAD_BYTES &&
+              sizeof(scan_log_networks_t) <= SCAN_LOG_PAYLOAD_BYTES &&
+              sizeof(scan_log_system_t) <= SCAN_LOG_PAYLOAD_BYTES &&
+              sizeof(scan_log_sighting_t) <= SCAN_LOG_PAYLOAD_BYTES &&
+              sizeof(scan_log_presence_t) <= SCAN_LOG_PAYLOAD_BYTES &&
+              sizeof(scan_log_clock_t) <= SCAN_LOG_PAYLOAD_BYTES &&
+              sizeof(scan_log_position_t) <= SCAN_LOG_PAYLOAD_BYTES, "payload too big for a record");
+
+/**
+ * @brief Traffic through the log since boot
+ */
+typedef struct {
+    uint32_t records;               // Staged
+    uint32_t dropped;               // Staging full, e.g. while neither card nor flash is mounted
+    uint32_t flushes;
+    uint32_t bytes_written;         // Padding included
+    uint32_t padding_bytes;
+    uint32_t staged_bytes;          // Waiting for the next flush
+} scan_log_stats_t;
+
+/**
+ * @brief Allocate the PSRAM staging ring and stage the boot record
+ * @return false without PSRAM; appends are then ignored
+ */
+bool scan_log_init(void);
+
+/**
+ * @brief Frame and stage one record without blocking; safe from any task
+ *
+ * Staged records reach the card, or flash while there is none, in whole
+ * sectors at most every SCAN_LOG_FLUSH_MS. A forced record is written on the next job worker
+ * pass instead, its sector padded out, so the file has it before
+ * anything that might follow it, such as a reset.
+ * @param length Payload bytes, at most SCAN_LOG_PAYLOAD_BYTES
+ * @return false if the staging ring is full or the log is not initialized
+ */
+bool scan_log_append(scan_log_type_t type, const void* payload, size_t length, bool force);
+
+/**
+ * @brief Start a flush on a job worker when one is due; from the system task
+ */
+void scan_log_tick(uint32_t now_ms);
+
+/**
+ * @brief Copy the log's figures
+ */
+void scan_log_get_stats(scan_log_stats_t* stats);
+
+#endif // SCAN_LOG_H
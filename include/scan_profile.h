@@ -0,0 +1,80 @@
+#ifndef SCAN_PROFILE_H
+#define SCAN_PROFILE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Named scan profiles
+ */
+typedef enum {
+    SCAN_PROFILE_FAST_PASSIVE = 0,  // Cheap passive sweep of the social channels
+    SCAN_PROFILE_FULL_ACTIVE,       // Active sweep of every channel
+    SCAN_PROFILE_TARGETED,          // Active scan for one BSSID on its channel
+    SCAN_PROFILE_SINGLE_CHANNEL,    // Long active dwell on one channel
+    SCAN_PROFILE_COUNT
+} scan_profile_id_t;
+
+/**
+ * @brief Radio parameters of a scan profile
+ */
+typedef struct {
+    const char* name;
+    uint16_t channel_mask;          // Bit N = channel N (0 = target channel only)
+    uint16_t dwell_ms;              // Per-channel dwell (0 = WIFI_CHANNEL_DWELL_MS table)
+    bool     passive;               // Listen for beacons instead of probing
+    bool     use_target_bssid;      // Filter the scan on the target BSSID
+    uint32_t interval_ms;           // Time between scan cycles
+} scan_profile_t;
+
+/**
+ * @brief Profile parameters by id
+ * @return Profile, or the full-active profile for an invalid id
+ */
+const scan_profile_t* scan_profile_get(scan_profile_id_t id);
+
+/**
+ * @brief Request a profile for the next scan cycle (safe from any task)
+ */
+void scan_profile_select(scan_profile_id_t id);
+
+/**
+ * @brief Profile for the next scan cycle: the pinned one, else the one requested
+ */
+scan_profile_id_t scan_profile_active(void);
+
+/**
+ * @brief Hold a profile over the governor's choices (safe from any task)
+ * @param id Profile to hold, or SCAN_PROFILE_COUNT to follow the governor again
+ */
+void scan_profile_pin(scan_profile_id_t id);
+
+/**
+ * @brief Pinned profile, SCAN_PROFILE_COUNT for none
+ */
+scan_profile_id_t scan_profile_pinned(void);
+
+/**
+ * @brief Profile by name, SCAN_PROFILE_COUNT for an unknown one
+ */
+scan_profile_id_t scan_profile_find(const char* name);
+
+/**
+ * @brief Set the BSSID and channel used by the targeted and single-channel profiles
+ * @param bssid Six-byte BSSID (NULL keeps the current one)
+ * @param channel Channel the target was last seen on
+ */
+void scan_profile_set_target(const uint8_t* bssid, uint8_t channel);
+
+/**
+ * @brief Effective channel mask of a profile, resolving the target channel
+ */
+uint16_t scan_profile_channel_mask(const scan_profile_t* profile);
+
+/**
+ * @brief Target BSSID for profiles that filter on it
+ * @return BSSID, or NULL if the profile does not filter or no target is set
+ */
+const uint8_t* scan_profile_target_bssid(const scan_profile_t* profile);
+
+#endif // SCAN_PROFILE_H
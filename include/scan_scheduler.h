@@ -0,0 +1,63 @@
+#ifndef SCAN_SCHEDULER_H
+#define SCAN_SCHEDULER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "scan_profile.h"
+
+/**
+ * @brief Radio slot types handed out by the scan scheduler
+ */
+typedef enum {
+    SCAN_SLOT_WIFI = 0,     // Dwell on a run of WiFi channels
+    SCAN_SLOT_BLE           // WiFi-quiet window for the BLE observer
+} scan_slot_type_t;
+
+/**
+ * @brief One time slice of a scan cycle
+ */
+typedef struct {
+    scan_slot_type_t type;
+    uint16_t channel_mask;         // WiFi slots: bit N = channel N
+    uint16_t duration_ms;          // Planned length of the slot
+} scan_slot_t;
+
+/**
+ * @brief Build the interleaved slot plan and apply the coexistence policy
+ * @return true if the plan fits inside SCAN_INTERVAL
+ */
+bool scan_scheduler_init(void);
+
+/**
+ * @brief Rewind to the first slot of a new scan cycle
+ *
+ * Rebuilds the plan if the active scan profile or its target changed.
+ * @return Profile the cycle runs with
+ */
+const scan_profile_t* scan_scheduler_begin_cycle(void);
+
+/**
+ * @brief Fetch the next slot of the current cycle
+ * @param slot Receives the slot description
+ * @return false once the cycle is complete
+ */
+bool scan_scheduler_next_slot(scan_slot_t* slot);
+
+/**
+ * @brief Dwell time for a WiFi channel under the current profile
+ * @param channel WiFi channel (1-13)
+ * @return Dwell time in milliseconds
+ */
+uint16_t scan_scheduler_channel_dwell(uint8_t channel);
+
+/**
+ * @brief Worst-case time between two refreshes of the same WiFi channel
+ */
+uint32_t scan_scheduler_wifi_refresh_ms(void);
+
+/**
+ * @brief Worst-case gap between two BLE scan windows
+ */
+uint32_t scan_scheduler_ble_refresh_ms(void);
+
+#endif // SCAN_SCHEDULER_H
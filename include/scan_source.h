@@ -0,0 +1,32 @@
+#ifndef SCAN_SOURCE_H
+#define SCAN_SOURCE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "scan_profile.h"
+#include "wifi_scan.h"
+#include "ble_scan.h"
+
+/**
+ * @brief Where a scan cycle's sightings come from
+ *
+ * The scan task asks its source for each cycle's WiFi records and recently
+ * heard BLE advertisers and folds them the same way whatever the source,
+ * so the device table, aggregators, logs and UI lists behind it cannot
+ * tell the radios from a replayed trace (soak.cpp) or the load generator
+ * (scan_synth.cpp). Every function is called from the scan task only.
+ */
+typedef struct {
+    const char* name;
+    bool     (*init)(void);                                     // Once, before the first cycle
+    void     (*sweep)(const scan_profile_t* profile);           // Gather one cycle's sightings; NULL: the radios,
+                                                                // swept by the scan task's own threads
+    bool     (*wifi_results)(const wifi_record_t** records, uint16_t* count);  // false if none this cycle
+    void     (*wifi_release)(void);
+    uint16_t (*ble_sightings)(ble_sighting_t* out, uint16_t capacity, uint32_t since_ms);  // Heard recently
+    uint16_t (*ble_expire)(void);
+    void     (*ble_summary)(ble_scan_summary_t* summary);
+    uint32_t (*interval_ms)(uint32_t planned_ms);               // Until the next cycle, given the plan's
+} scan_source_t;
+
+#endif // SCAN_SOURCE_H
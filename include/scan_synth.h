@@ -0,0 +1,74 @@
+#ifndef SCAN_SYNTH_H
+#define SCAN_SYNTH_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "scan_source.h"
+
+/**
+ * @brief Population and behaviour the generator emulates
+ */
+typedef struct {
+    uint16_t aps;                   // Access points, at most SCAN_SYNTH_MAX_DEVICES
+    uint16_t ble_devices;           // BLE advertisers, at most SCAN_SYNTH_MAX_DEVICES
+    uint16_t churn_permille;        // Share of each population replaced by new devices per cycle
+    uint8_t  rssi_step_db;          // Largest RSSI change of a device per cycle
+    uint8_t  adv_per_s;             // Advertisements per BLE device per second
+    int8_t   wifi_rssi_dbm;         // Centre of the access points' signal levels
+    int8_t   ble_rssi_dbm;          // ... of the advertisers'
+    uint8_t  speedup;               // Cycles this many times faster than the scan plan
+} scan_synth_load_t;
+
+/**
+ * @brief Generator figures since boot
+ */
+typedef struct {
+    uint32_t cycles;
+    uint32_t wifi_records;          // Handed to the scan task
+    uint32_t ble_records;
+    uint32_t adverts;               // Emulated advertisements
+    uint32_t adverts_dropped;       // From advertisers beyond the BLE record table
+    uint32_t replaced;              // Devices churned out for new ones
+    uint32_t last_sweep_us;         // Generator time of the latest cycle
+} scan_synth_stats_t;
+
+/**
+ * @brief Synthetic scan source emulating thousands of devices
+ *
+ * Each cycle replaces churn_permille of every population with new
+ * addresses, moves each device's RSSI by up to rssi_step_db around its
+ * centre and hands the scan task a window of the population as wide as
+ * the real record tables (MAX_WIFI_NETWORKS, BLE_RECORD_CAPACITY), the
+ * window moving on every cycle, so the device table sees every device
+ * in turn. Advertisers that do not fit count as dropped adverts, as on
+ * the radio. The radios are never started. Deterministic for one load.
+ */
+extern const scan_source_t scan_synth_source;
+
+bool     scan_synth_init(void);
+void     scan_synth_sweep(const scan_profile_t* profile);
+bool     scan_synth_wifi_results(const wifi_record_t** records, uint16_t* count);
+void     scan_synth_wifi_release(void);
+uint16_t scan_synth_ble_sightings(ble_sighting_t* out, uint16_t capacity, uint32_t since_ms);
+uint16_t scan_synth_ble_expire(void);
+void     scan_synth_ble_summary(ble_scan_summary_t* summary);
+uint32_t scan_synth_interval_ms(uint32_t planned_ms);
+
+/**
+ * @brief Change the emulated load; safe from any task, applied at the next cycle
+ *
+ * Populations above SCAN_SYNTH_MAX_DEVICES are clamped to it.
+ */
+void scan_synth_set_load(const scan_synth_load_t* load);
+
+/**
+ * @brief Copy the load in force
+ */
+void scan_synth_get_load(scan_synth_load_t* load);
+
+/**
+ * @brief Copy the generator figures
+ */
+void scan_synth_get_stats(scan_synth_stats_t* stats);
+
+#endif // SCAN_SYNTH_H
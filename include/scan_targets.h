@@ -0,0 +1,139 @@
+#ifndef SCAN_TARGETS_H
+#define SCAN_TARGETS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "device_table.h"
+
+/**
+ * @brief Who pinned a target
+ */
+typedef enum {
+    SCAN_TARGET_USER = 0,           // Over HTTP; stays until unpinned
+    SCAN_TARGET_AI                  // A follower picked while TRACKING
+} scan_target_source_t;
+
+/**
+ * @brief One pinned device
+ */
+typedef struct {
+    uint8_t  mac[6];                // BSSID or BLE address
+    uint8_t  kind;                  // device_kind_t
+    uint8_t  source;                // scan_target_source_t
+    uint8_t  addr_type;             // BLE record's, for the whitelist
+    uint8_t  channel;               // WiFi channel, 0 while unknown
+    int8_t   rssi;                  // Latest, dBm
+    uint8_t  misses;                // WiFi passes in a row without it
+    uint32_t pinned_ms;
+    uint32_t last_seen_ms;          // 0 before the first targeted update
+    uint32_t updates;               // RSSI updates from targeted passes
+    uint32_t interval_ms;           // Between updates, EWMA
+} scan_target_t;
+
+/**
+ * @brief Registry figures since boot
+ */
+typedef struct {
+    uint8_t  count;                 // Pinned now
+    uint8_t  ai;                    // Of those, picked by the AI
+    bool     whitelist;             // BLE scan narrowed to the targets
+    uint32_t passes;                // Targeted passes between full sweeps
+    uint32_t sweeps;                // Full sweeps the passes were interleaved with
+    uint32_t wifi_scans;            // Single-channel, BSSID-filtered scans
+    uint32_t wifi_hits;             // Of those, that heard their target
+    uint32_t ble_updates;           // BLE targets heard again since the previous pass
+    uint32_t whitelist_sets;        // Controller whitelist changes
+    uint32_t ai_picks;
+    uint32_t ai_released;           // Left TRACKING, or unheard for SCAN_TARGET_AI_TTL_MS
+    uint32_t rejected;              // Pins refused, the registry being full
+} scan_targets_stats_t;
+
+/*
+ * Devices worth more than one look per cycle. A full sweep every 15 s or
+ * so hears everyone once; a pinned device is also scanned on its own
+ * every SCAN_TARGET_PERIOD_MS in between: an access point with an active
+ * scan of its last channel filtered on its BSSID, a BLE device by reading
+ * its record, the BLE scan being narrowed to the targets' addresses by
+ * the controller's whitelist until the next full sweep lifts it. Targets
+ * come from the user over HTTP, or from the AI: while the committed state
+ * is TRACKING, the strongest of the BLE devices counted as following fill
+ * the free slots, and they are let go when it ends.
+ *
+ * The targeted passes run on the scan task, in what would otherwise be
+ * its sleep, so the full sweep keeps its interval. A BLE target heard
+ * under a resolvable address is lost when the address rotates, as it is
+ * by the device table.
+ */
+
+/**
+ * @brief Pin a device; any task
+ * @return false if the registry is full; a user's pin of an AI pick keeps it for good
+ */
+bool scan_targets_pin(const uint8_t* mac, device_kind_t kind, scan_target_source_t source);
+
+/**
+ * @brief Unpin a device; any task
+ * @return false if it was not pinned
+ */
+bool scan_targets_unpin(const uint8_t* mac, device_kind_t kind);
+
+/**
+ * @brief Unpin every target of one source; any task
+ * @return Targets unpinned
+ */
+uint8_t scan_targets_unpin_all(scan_target_source_t source);
+
+/**
+ * @brief Pick or release the AI's targets after a folded cycle (scan task)
+ *
+ * Reads the committed AI state from the governor and the followers from
+ * the device table.
+ */
+void scan_targets_cycle(uint32_t now_ms);
+
+/**
+ * @brief Ready a targeted pass: look channels up, narrow the BLE scan (scan task)
+ * @param out Receives the targets, SCAN_TARGET_MAX slots
+ * @return Targets to scan, 0 when none are pinned
+ */
+uint8_t scan_targets_begin_pass(scan_target_t* out);
+
+/**
+ * @brief Record what a WiFi target's scan heard (scan task)
+ * @param heard false if the scan did not report it
+ */
+void scan_targets_note_wifi(const uint8_t* bssid, bool heard, int8_t rssi, uint8_t channel, uint32_t now_ms);
+
+/**
+ * @brief Take the BLE targets' latest advertisements from their records (scan task)
+ */
+void scan_targets_note_ble(void);
+
+/**
+ * @brief Hear everyone again before a full sweep (scan task)
+ */
+void scan_targets_end_phase(void);
+
+/**
+ * @brief Copy the pinned targets; any task
+ * @param out SCAN_TARGET_MAX slots
+ * @return Targets copied
+ */
+uint8_t scan_targets_list(scan_target_t* out);
+
+/**
+ * @brief Copy the registry figures
+ */
+void scan_targets_get_stats(scan_targets_stats_t* stats);
+
+/**
+ * @brief Add SCAN_TARGETS_PATH to the web server
+ *
+ * GET lists the targets. POST mac=aa:bb:cc:dd:ee:ff&kind=wifi|ble pins
+ * one for the user, with remove=1 unpins it; POST clear=user|ai|all
+ * unpins a source's.
+ */
+void scan_targets_register(AsyncWebServer* server);
+
+#endif // SCAN_TARGETS_H
@@ -0,0 +1,71 @@
+#ifndef SD_BENCH_H
+#define SD_BENCH_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief What the last sweep found for the mounted card (kept in NVS)
+ */
+typedef struct {
+    uint64_t card_bytes;            // With card_type, tells a different card apart
+    uint8_t  card_type;             // sdcard_type_t
+    uint8_t  reserved[3];
+    uint32_t spi_hz;                // Fastest clock that mounted, wrote and read back intact
+    uint32_t write_kbps;            // Sequential write at that clock and block_bytes
+    uint32_t max_block_us;          // Slowest single block write in that run
+    uint16_t block_bytes;           // Write size the log writers use
+    uint16_t reserved2;
+} sd_bench_result_t;
+
+/**
+ * @brief Benchmark figures since boot
+ */
+typedef struct {
+    bool     valid;                 // A result applies to the mounted card
+    uint8_t  clocks_tried;          // In the last sweep
+    uint16_t sweeps;                // Full clock sweeps, new cards only
+    uint16_t block_runs;            // Block size sweeps, on demand
+    uint32_t last_sweep_ms;         // Duration of the last sweep
+    sd_bench_result_t result;
+} sd_bench_stats_t;
+
+/**
+ * @brief Clock to mount the card at: the stored result's, or SD_SPI_HZ
+ */
+uint32_t sd_bench_clock_hz(void);
+
+/**
+ * @brief Check a freshly mounted card against the stored result
+ *
+ * A card that does not match is swept: remounted at each of
+ * SD_BENCH_CLOCKS in turn, timing sequential writes of each of
+ * SD_BENCH_BLOCKS and reading them back, until a clock fails. It is left
+ * mounted at the fastest clock that held. Remounting under open files
+ * corrupts them, so this runs inside the mount, before any writer opens
+ * one. The caller does not hold the SD bus.
+ * @param hz Clock the card was mounted at
+ * @return false if the card could not be mounted again afterwards
+ */
+bool sd_bench_on_mount(uint32_t hz);
+
+/**
+ * @brief Time each of SD_BENCH_BLOCKS again at the current clock, on a job worker
+ *
+ * Does not remount, so it is safe while files are open.
+ * @return false without a card or a free job slot
+ */
+bool sd_bench_request(void);
+
+/**
+ * @brief Bytes a log writer should hand the card per write
+ * @param max_bytes The writer's own ceiling
+ */
+size_t sd_bench_block_bytes(size_t max_bytes);
+
+/**
+ * @brief Copy the benchmark figures
+ */
+void sd_bench_get_stats(sd_bench_stats_t* stats);
+
+#endif // SD_BENCH_H
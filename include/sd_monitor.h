@@ -0,0 +1,70 @@
+#ifndef SD_MONITOR_H
+#define SD_MONITOR_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Card insertions and removals reported by sd_monitor_poll()
+ */
+typedef enum {
+    SD_EVENT_NONE = 0,
+    SD_EVENT_INSERTED,              // Card found and mounted
+    SD_EVENT_REMOVED                // Card gone, unmounted
+} sd_event_t;
+
+/**
+ * @brief Called on a hot-plug event, without the SD bus held
+ *
+ * On removal it runs before the card is unmounted, so open files can be
+ * closed; on insertion after the mount.
+ */
+typedef void (*sd_monitor_listener_t)(bool mounted);
+
+/**
+ * @brief Presence tracking since boot
+ */
+typedef struct {
+    bool     mounted;
+    bool     card_detect;           // BOARD.sd.detect is wired
+    uint32_t probes;                // Status or presence commands sent
+    uint32_t insertions;
+    uint32_t removals;
+    uint32_t mount_failures;        // Card answered but SD.begin() failed
+    uint32_t changed_ms;            // millis() of the last event
+} sd_monitor_status_t;
+
+/**
+ * @brief Mount the card if one is in the slot
+ *
+ * Must run after spi_bus_init().
+ * @return true if a card is mounted
+ */
+bool sd_monitor_init(void);
+
+/**
+ * @brief Receive hot-plug events (one listener)
+ */
+void sd_monitor_listen(sd_monitor_listener_t listener);
+
+/**
+ * @brief Check for insertion or removal; cheap to call every monitoring cycle
+ *
+ * With a card-detect switch the pin is read on every call. Without one, a
+ * mounted card is sent CMD13 (SEND_STATUS) every SD_PROBE_INTERVAL_MS,
+ * and an empty slot CMD0, a full mount following only if it answers; a
+ * card is only declared gone after SD_PROBE_MISSES failed probes.
+ */
+sd_event_t sd_monitor_poll(uint32_t now_ms);
+
+/**
+ * @brief A card is mounted; no bus traffic
+ */
+bool sd_monitor_mounted(void);
+
+/**
+ * @brief Presence tracking since boot
+ */
+void sd_monitor_get_status(sd_monitor_status_t* status);
+
+#endif // SD_MONITOR_H
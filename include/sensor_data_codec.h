@@ -0,0 +1,117 @@
+#ifndef SENSOR_DATA_CODEC_H
+#define SENSOR_DATA_CODEC_H
+
+#include <Arduino.h>
+#include "ai_states.h"
+
+// sensor_data_t is its own wire format (little-endian, fixed layout)
+#define SENSOR_DATA_WIRE_BYTES sizeof(sensor_data_t)
+
+// Largest CBOR encoding: a two-byte map head, then one-byte keys and
+// values of at most five bytes
+#define SENSOR_DATA_CBOR_MAX_BYTES (2 + SENSOR_DATA_FIELD_COUNT * 6)
+
+/**
+ * @brief Every field of sensor_data_t but the reserved ones, X(id, name)
+ *
+ * The one definition the JSON and CBOR encodings, and the CBOR decoder,
+ * are generated from. An id is the field's CBOR key and its place in the
+ * list: never reuse or renumber one, append new fields with the next id,
+ * so a decoder from any version reads the fields it knows and skips the
+ * rest. The packed form is the struct itself.
+ */
+#define SENSOR_DATA_FIELDS(X)            \
+    X(0,  version)                       \
+    X(1,  scan_cycle)                    \
+    X(2,  free_memory)                   \
+    X(3,  uptime_seconds)                \
+    X(4,  wifi_networks_count)           \
+    X(5,  wifi_signal_strength)          \
+    X(6,  ble_devices_count)             \
+    X(7,  ble_signal_strength)           \
+    X(8,  novel_devices)                 \
+    X(9,  novelty_permille)              \
+    X(10, user_interaction)              \
+    X(11, sd_card_present)               \
+    X(12, hop_channel)                   \
+    X(13, busiest_channel)               \
+    X(14, devices_appeared)              \
+    X(15, devices_lost)                  \
+    X(16, devices_moved)                 \
+    X(17, capture_frames_per_second)     \
+    X(18, probe_requests)                \
+    X(19, wifi_clients_count)            \
+    X(20, randomized_clients)            \
+    X(21, busiest_bssid_fps)             \
+    X(22, busiest_channel_fps)           \
+    X(23, ble_phones)                    \
+    X(24, ble_trackers)                  \
+    X(25, ble_wearables)                 \
+    X(26, ble_beacons)                   \
+    X(27, cycle_time_us)                 \
+    X(28, wake_flags)                    \
+    X(29, ble_followers)                 \
+    X(30, people_clusters)               \
+    X(31, place_clusters)                \
+    X(32, location)                      \
+    X(33, location_match)                \
+    X(34, airtime_permille)              \
+    X(35, busiest_airtime_permille)      \
+    X(36, busiest_airtime_channel)       \
+    X(37, battery_pct)                   \
+    X(38, temperature_c10)               \
+    X(39, humidity_permille)             \
+    X(40, light_lux)                     \
+    X(41, motion_mg)                     \
+    X(42, i2c_fresh)                     \
+    X(43, ambient_level)                 \
+    X(44, unusual_z10)                   \
+    X(45, associations_per_min)          \
+    X(46, handshakes_per_min)
+
+#define SENSOR_DATA_FIELD_COUNT_ONE(id, name) + 1
+#define SENSOR_DATA_FIELD_COUNT (0 SENSOR_DATA_FIELDS(SENSOR_DATA_FIELD_COUNT_ONE))
+
+/**
+ * @brief Binary encoding for logs, the web API and peers
+ * @param data Record to encode
+ * @param out Destination buffer
+ * @param capacity Size of out
+ * @return Bytes written, 0 if out is too small
+ */
+size_t sensor_data_serialize(const sensor_data_t* data, uint8_t* out, size_t capacity);
+
+/**
+ * @brief Decode a record written by sensor_data_serialize()
+ * @return false if the length or the version tag does not match
+ */
+bool sensor_data_deserialize(const uint8_t* in, size_t length, sensor_data_t* data);
+
+/**
+ * @brief CBOR encoding: a map from field id to value, each in its shortest form
+ * @param data Record to encode
+ * @param out Destination buffer, SENSOR_DATA_CBOR_MAX_BYTES always suffices
+ * @param capacity Size of out
+ * @return Bytes written, 0 if out is too small
+ */
+size_t sensor_data_to_cbor(const sensor_data_t* data, uint8_t* out, size_t capacity);
+
+/**
+ * @brief Decode a record written by sensor_data_to_cbor() of any version
+ *
+ * Fields the record lacks are zero, ids this build does not know are
+ * skipped, and the version is set to the current one.
+ * @return false if the record is not a CBOR map of integers
+ */
+bool sensor_data_from_cbor(const uint8_t* in, size_t length, sensor_data_t* data);
+
+/**
+ * @brief JSON encoding with one key per field
+ * @param data Record to encode
+ * @param out Destination buffer, NUL-terminated on success
+ * @param capacity Size of out
+ * @return Characters written (without NUL), 0 if out is too small
+ */
+size_t sensor_data_to_json(const sensor_data_t* data, char* out, size_t capacity);
+
+#endif // SENSOR_DATA_CODEC_H
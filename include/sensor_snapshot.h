@@ -0,0 +1,56 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+#include <Arduino.h>
+#include "ai_states.h"
+#include "rssi_histogram.h"
+#include "ai_features.h"
+
+/**
+ * @brief One scan cycle as published on BUS_TOPIC_SCAN
+ *
+ * The scan task fills the scan fields of data and overlays the latest
+ * system and capture fields before extracting the features, so the three
+ * parts always agree with each other.
+ */
+typedef struct {
+    sensor_data_t       data;
+    scan_histograms_t   histograms;
+    ai_feature_vector_t features;       // Extracted once per scan cycle
+} sensor_snapshot_t;
+
+/**
+ * @brief Copy the latest sensor data without blocking
+ *
+ * Scan fields come from the latest scan cycle, system and capture fields
+ * from those tasks' latest publications.
+ * @param data Receives a consistent copy
+ * @return Scan cycle publication version of the copy
+ */
+uint32_t sensor_snapshot_read(sensor_data_t* data);
+
+/**
+ * @brief Replace the system and capture fields with their latest publications
+ */
+void sensor_snapshot_overlay(sensor_data_t* data);
+
+/**
+ * @brief Copy the latest RSSI histograms without blocking
+ * @param histograms Receives a consistent copy
+ * @return Scan cycle publication version of the copy
+ */
+uint32_t sensor_snapshot_read_histograms(scan_histograms_t* histograms);
+
+/**
+ * @brief Copy the latest feature vector without blocking
+ * @param features Receives a consistent copy
+ * @return Scan cycle publication version of the copy
+ */
+uint32_t sensor_snapshot_read_features(ai_feature_vector_t* features);
+
+/**
+ * @brief Scan cycle publication version (increments once per cycle)
+ */
+uint32_t sensor_snapshot_sequence(void);
+
+#endif // SENSOR_SNAPSHOT_H
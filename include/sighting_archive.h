@@ -0,0 +1,160 @@
+#ifndef SIGHTING_ARCHIVE_H
+#define SIGHTING_ARCHIVE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "device_table.h"
+
+#define ARCHIVE_MAGIC          0x41484848   // "HHHA"
+#define ARCHIVE_FOOTER_MAGIC   0x46414848   // "HHAF", last four bytes of a complete segment
+#define ARCHIVE_FORMAT         1
+
+/**
+ * @brief Columns of a segment, each stored as one contiguous block
+ */
+typedef enum {
+    ARCHIVE_COLUMN_TIME = 0,        // Zigzag varints: first time, first delta, then delta-of-delta
+    ARCHIVE_COLUMN_DEVICE,          // Varint index into the dictionary, one per row
+    ARCHIVE_COLUMN_RSSI,            // Zigzag deltas from the same device's previous row, zero runs folded
+    ARCHIVE_COLUMN_CHANNEL,         // (channel, run) byte pairs; rows of a cycle are ordered by channel
+    ARCHIVE_COLUMN_DICTIONARY,      // archive_device_t per distinct device, in order of first row
+    ARCHIVE_COLUMN_COUNT
+} archive_column_t;
+
+/**
+ * @brief Start of every segment file
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t column_count;          // ARCHIVE_COLUMN_COUNT of the writer
+    uint32_t boot;                  // log_manager_boot() of the writer
+    uint32_t reserved;
+} archive_header_t;
+
+/**
+ * @brief One dictionary entry
+ */
+typedef struct {
+    uint8_t mac[6];
+    uint8_t kind;                   // device_kind_t
+} archive_device_t;
+
+/**
+ * @brief Where a column's block is and what it holds
+ */
+typedef struct {
+    uint32_t offset;                // From the start of the file
+    uint32_t length;
+    uint32_t crc32;                 // Of the block
+} archive_column_ref_t;
+
+/**
+ * @brief End of every segment file: its bounds and column directory (little-endian, fixed layout)
+ *
+ * A reader seeks to the end, reads this alone, and skips the segment when
+ * the bounds rule out its query.
+ */
+typedef struct {
+    uint32_t boot;
+    uint32_t first_ms;              // millis() of that boot, of the first and last rows
+    uint32_t last_ms;
+    uint32_t rows;
+    uint16_t devices;               // Dictionary entries
+    uint16_t channel_mask;          // Bit n set if any row is on channel n; bit 0 for BLE
+    int8_t   rssi_min;
+    int8_t   rssi_max;
+    uint8_t  kind_mask;             // Bit n set if any device is of device_kind_t n
+    uint8_t  reserved;
+    archive_column_ref_t columns[ARCHIVE_COLUMN_COUNT];
+    uint32_t magic;                 // ARCHIVE_FOOTER_MAGIC
+} archive_footer_t;
+
+static_assert(sizeof(archive_header_t) == 16, "archive header layout changed");
+static_assert(sizeof(archive_device_t) == 7, "archive dictionary entry layout changed");
+static_assert(sizeof(archive_footer_t) == 24 + ARCHIVE_COLUMN_COUNT * 12 + 4, "archive footer has implicit padding");
+
+/**
+ * @brief Sightings a query selects; a zero field does not restrict
+ */
+typedef struct {
+    uint32_t boot;                  // 0 for this boot
+    uint32_t from_ms;
+    uint32_t to_ms;                 // 0 for no upper bound
+    uint16_t channel_mask;          // Bit n for channel n, bit 0 for BLE
+    uint8_t  kind_mask;             // Bit n for device_kind_t n
+} archive_query_t;
+
+/**
+ * @brief One sighting handed to a query's callback
+ */
+typedef struct {
+    uint32_t time_ms;
+    uint8_t  mac[6];
+    uint8_t  kind;                  // device_kind_t
+    uint8_t  channel;
+    int8_t   rssi;
+} archive_row_t;
+
+/**
+ * @brief Query callback; return false to stop
+ */
+typedef bool (*archive_row_fn)(const archive_row_t* row, void* context);
+
+/**
+ * @brief What a query read
+ */
+typedef struct {
+    uint32_t rows;                  // Handed to the callback
+    uint16_t segments;              // Footers read
+    uint16_t segments_read;         // Segments whose columns were read
+    uint32_t bytes_read;
+} archive_query_stats_t;
+
+/**
+ * @brief Archive figures since boot
+ */
+typedef struct {
+    uint32_t rows_staged;
+    uint32_t rows_dropped;          // Staging full while the previous batch was being written
+    uint32_t segments_written;
+    uint32_t write_failures;
+    uint32_t raw_bytes;             // Rows written, at sizeof(archive_row_t) each
+    uint32_t encoded_bytes;         // What they took on the card, header and footer included
+} archive_stats_t;
+
+/**
+ * @brief Allocate the staging and encoding buffers in PSRAM
+ * @return true on success, false on allocation failure
+ */
+bool sighting_archive_init(void);
+
+/**
+ * @brief Stage a row for every device seen in the closing scan cycle
+ *
+ * Called from the scan task, which owns the device table, before the
+ * cycle is closed. A batch of ARCHIVE_SEGMENT_ROWS rows, or one older
+ * than ARCHIVE_SEGMENT_MAX_MS, is written as a segment on a job worker.
+ * @param cycle device_table_cycle() of the closing cycle
+ * @param now_ms Time the rows are stamped with
+ */
+void sighting_archive_record_cycle(uint16_t cycle, uint32_t now_ms);
+
+/**
+ * @brief Hand every archived sighting matching a query to a callback, oldest segment first
+ *
+ * Reads each segment's footer, then only the time and channel columns of
+ * the segments it cannot rule out, and the device, RSSI and dictionary
+ * columns only of those with a matching row. Takes the SD card's bus per
+ * read; not for the async TCP task.
+ * @return false if there is no card or the buffers are missing
+ */
+bool sighting_archive_query(const archive_query_t* query, archive_row_fn fn, void* context,
+                            archive_query_stats_t* out);
+
+/**
+ * @brief Copy the archive figures
+ */
+void sighting_archive_get_stats(archive_stats_t* stats);
+
+#endif // SIGHTING_ARCHIVE_H
@@ -0,0 +1,44 @@
+#ifndef SIGHTING_LOG_H
+#define SIGHTING_LOG_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "device_table.h"
+
+/**
+ * @brief Sighting log figures since boot
+ */
+typedef struct {
+    uint32_t cycles_seen;           // Device sightings folded into the log, one per device per cycle
+    uint32_t appeared;              // Records staged, by type
+    uint32_t changed;
+    uint32_t present;
+    uint32_t gone;
+    uint32_t deferred;              // Records held to a later cycle by the budget or a full ring
+} sighting_log_stats_t;
+
+/**
+ * @brief Fold the closing cycle's sightings into the scan log
+ *
+ * Called from the scan task, which owns the device table, before the
+ * cycle is closed. A device not yet in the log gets an appearance
+ * record; one whose RSSI left SIGHTING_LOG_RSSI_BAND around its last raw
+ * record gets a presence record for the run so far and a new raw record;
+ * one seen for SIGHTING_LOG_HEARTBEAT_CYCLES gets a presence record.
+ * Every other sighting only bumps the device's counters. At most
+ * SIGHTING_LOG_CYCLE_RECORDS are staged per call; the rest wait.
+ * @param cycle device_table_cycle() of the closing cycle
+ */
+void sighting_log_record_cycle(uint16_t cycle);
+
+/**
+ * @brief Stage a device's last run as it ages out; from the device event handler
+ */
+void sighting_log_device_lost(const device_entry_t* entry);
+
+/**
+ * @brief Copy the sighting log figures
+ */
+void sighting_log_get_stats(sighting_log_stats_t* stats);
+
+#endif // SIGHTING_LOG_H
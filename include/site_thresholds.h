@@ -0,0 +1,55 @@
+#ifndef SITE_THRESHOLDS_H
+#define SITE_THRESHOLDS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+
+/**
+ * @brief Streaming P² estimate of one quantile (five markers, no sample storage)
+ */
+typedef struct {
+    float    height[5];             // Marker heights
+    float    desired[5];            // Desired marker positions
+    int32_t  position[5];           // Actual marker positions
+    float    quantile;              // Target quantile in (0, 1)
+    uint32_t count;                 // Observations so far
+} p2_quantile_t;
+
+/**
+ * @brief Activity thresholds in force at this site
+ */
+typedef struct {
+    float    wifi_high;             // WiFi networks that count as high activity
+    float    ble_strong;            // BLE signal (dBm) that counts as close
+    uint32_t samples;               // Scan cycles learned from
+    uint8_t  progress_pct;          // Share of SITE_LEARN_CYCLES seen, 0-100
+    bool     learned;               // Thresholds come from this site, not config.h
+} site_thresholds_t;
+
+/**
+ * @brief Restore the learned estimators from the journal, else NVS
+ */
+void site_thresholds_init(void);
+
+/**
+ * @brief Learn from one published scan cycle
+ */
+void site_thresholds_observe(const sensor_data_t* data);
+
+/**
+ * @brief Thresholds to use now (config.h defaults until SITE_LEARN_CYCLES are seen)
+ */
+void site_thresholds_get(site_thresholds_t* thresholds);
+
+/**
+ * @brief Persist the estimators every SITE_SAVE_INTERVAL_MS
+ */
+void site_thresholds_tick(uint32_t now_ms);
+
+/**
+ * @brief Forget this site, e.g. after the unit has been moved
+ */
+void site_thresholds_reset(void);
+
+#endif // SITE_THRESHOLDS_H
@@ -0,0 +1,76 @@
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "scan_source.h"
+
+/**
+ * @brief Regression gates judged over a soak run
+ */
+typedef enum {
+    SOAK_GATE_HEAP_DRIFT = 0,       // Free heap floor falling steadily
+    SOAK_GATE_FRAG_GROWTH,          // Heap fragmentation rising steadily
+    SOAK_GATE_DEADLINES,            // Loop deadline misses per hour
+    SOAK_GATE_LOOP_CREEP,           // Loop bodies slower than after warm-up
+    SOAK_GATE_COUNT
+} soak_gate_t;
+
+/**
+ * @brief Progress and the latest verdict of a soak run
+ */
+typedef struct {
+    uint32_t elapsed_ms;            // Since boot
+    uint32_t window_ms;             // Judged so far, from the end of warm-up
+    uint32_t cycles;                // Scan cycles injected
+    uint32_t trace_loops;           // Times SOAK_TRACE_FILE was replayed to its end
+    bool     from_trace;            // Cycles come from SOAK_TRACE_FILE, not the generator
+    uint32_t ui_steps;              // Scripted scene changes
+    uint32_t checks;                // Gate evaluations
+    int32_t  heap_drift_bph;        // Slope of the free heap floor, bytes per hour
+    int32_t  frag_growth_milli_pph; // Slope of fragmentation, 0.001 points per hour
+    uint32_t misses_per_hour;       // Deadline misses of every loop since warm-up
+    int32_t  loop_creep_pct;        // Worst loop's average body against its warm-up figure
+    uint8_t  failing;               // soak_gate_t bits failing at the latest check
+    uint8_t  failed;                // ... at any check of this run
+} soak_status_t;
+
+/**
+ * @brief Scan source of a soak run, selected by the scan task under SOAK_ENABLED
+ *
+ * Each cycle's counts, signal levels and arrivals come from SOAK_TRACE_FILE
+ * on the SD card, replayed in a loop, or from a fixed pattern when there
+ * is no card or no file, so a run never stalls; they set the load of the
+ * synthetic source (scan_synth.h), which turns them into sightings. Cycles
+ * are SOAK_CYCLE_MS apart.
+ */
+extern const scan_source_t soak_scan_source;
+
+/**
+ * @brief Show the next scene in the ring; UI task only, on UI_EVENT_SOAK
+ */
+void soak_ui_step(void);
+
+/**
+ * @brief Script the UI and judge the gates; call from the system task
+ *
+ * Every SOAK_UI_STEP_MS the UI task is asked to move along the ring. Once
+ * SOAK_WARMUP_MS have passed the loop figures are taken as the baseline,
+ * and every SOAK_CHECK_INTERVAL_MS the gates are judged over the minutes
+ * tier of the metrics history since then. Slopes are least-squares fits,
+ * so a steady drift fails a gate and a single dip does not; nothing fails
+ * before SOAK_MIN_WINDOW_MS of history is in.
+ */
+void soak_tick(uint32_t now_ms);
+
+/**
+ * @brief Copy the progress and the latest verdict
+ */
+void soak_get_status(soak_status_t* status);
+
+/**
+ * @brief Short name of a gate for logs and the report
+ */
+const char* soak_gate_name(soak_gate_t gate);
+
+#endif // SOAK_H
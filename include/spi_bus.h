@@ -0,0 +1,74 @@
+#ifndef SPI_BUS_H
+#define SPI_BUS_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "config.h"
+
+#define SPI_BUS_WAIT_FOREVER UINT32_MAX
+
+/**
+ * @brief Devices on the SPI buses, in falling priority
+ *
+ * The display has a host to itself, so SD and touch traffic never delays
+ * a flush. On the shared host a waiting higher-priority device goes ahead
+ * of lower-priority ones still queued; the holder is never preempted.
+ */
+typedef enum {
+    SPI_DEVICE_DISPLAY = 0,
+    SPI_DEVICE_TOUCH,
+    SPI_DEVICE_SD,
+    SPI_DEVICE_COUNT
+} spi_device_t;
+
+/**
+ * @brief Bus occupancy of one device since boot
+ */
+typedef struct {
+    uint32_t transactions;          // Times the bus was acquired
+    uint64_t busy_us;               // Time holding the bus
+    uint64_t wait_us;               // Time queued behind other devices
+    uint32_t max_wait_us;
+    uint32_t timeouts;              // Acquisitions given up
+} spi_bus_stats_t;
+
+/**
+ * @brief Bring up both SPI hosts with their pins assigned explicitly
+ *
+ * Must run before TFT_eSPI and SD.begin(): TFT_eSPI keeps the pins the
+ * display host was begun with.
+ * @return false if the arbiter locks cannot be created
+ */
+bool spi_bus_init(void);
+
+/**
+ * @brief The SPIClass a device talks through
+ */
+SPIClass* spi_bus_host(spi_device_t device);
+
+/**
+ * @brief Take a device's bus, routing the host's pins to it
+ *
+ * Every transaction of the device, including ones made inside libraries
+ * such as SD, must run between this and spi_bus_release().
+ * @param timeout_ms SPI_BUS_WAIT_FOREVER to wait as long as it takes
+ * @return false if the bus was not free within timeout_ms
+ */
+bool spi_bus_acquire(spi_device_t device, uint32_t timeout_ms);
+
+/**
+ * @brief Hand the bus back and account the time it was held
+ */
+void spi_bus_release(spi_device_t device);
+
+/**
+ * @brief Bus occupancy of one device since boot
+ */
+void spi_bus_get_stats(spi_device_t device, spi_bus_stats_t* stats);
+
+/**
+ * @brief Device name for logs
+ */
+const char* spi_bus_device_name(spi_device_t device);
+
+#endif // SPI_BUS_H
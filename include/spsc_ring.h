@@ -0,0 +1,166 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Figures of one stream since attach()
+ */
+typedef struct {
+    uint32_t capacity;              // Slots
+    uint32_t depth;                 // Queued when the figures were taken
+    uint32_t high_water;            // Deepest the ring has been
+    uint32_t pushed;
+    uint32_t dropped;               // Producer found it full
+    uint32_t popped;
+    uint32_t batches;               // Drains that took at least one record
+    uint32_t latency_avg_us;        // Push to pop, EWMA, as the consumer noted it
+    uint32_t latency_max_us;
+} spsc_stats_t;
+
+/*
+ * A stream of records from one producer, typically a radio callback, to
+ * one consumer task. The producer only writes head and its counters, the
+ * consumer only tail and its own, each on a cache line of its own, so
+ * neither side ever waits on the other: a push into a full ring is a
+ * counted drop, a drain of an empty one returns 0. Slots are claimed in
+ * place, so a callback fills a record without a copy, and drained in
+ * batches: one acquire of head, then a single release of tail hands the
+ * whole batch back. Storage is the caller's (PSRAM for big rings); the
+ * indices live in the ring object, which belongs in DRAM when the
+ * producer runs from IRAM. The push side is forced inline for that reason:
+ * an out-of-line template instance would land in flash.
+ */
+template <typename T, uint32_t Slots>
+class spsc_ring {
+    static_assert(Slots >= 2 && (Slots & (Slots - 1)) == 0, "spsc_ring slots must be a power of two");
+    static constexpr uint32_t MASK = Slots - 1;
+
+public:
+    static constexpr uint32_t capacity = Slots;
+
+    /**
+     * @brief Take Slots records of storage and empty the ring; neither side may be running
+     */
+    void attach(T* storage) {
+        slots = storage;
+        producer.head = producer.pushed = producer.dropped = producer.high_water = 0;
+        consumer.tail = consumer.popped = consumer.batches = 0;
+        consumer.latency_avg_us = consumer.latency_max_us = 0;
+    }
+
+    bool attached() const { return slots != NULL; }
+
+    /**
+     * @brief Producer: the next free slot to fill, or NULL (counted as a drop) if full
+     */
+    __attribute__((always_inline)) inline T* claim() {
+        uint32_t head = producer.head;
+        if (head - __atomic_load_n(&consumer.tail, __ATOMIC_ACQUIRE) >= Slots) {
+            producer.dropped++;
+            return NULL;
+        }
+        return &slots[head & MASK];
+    }
+
+    /**
+     * @brief Producer: hand the slot from claim() to the consumer
+     */
+    __attribute__((always_inline)) inline void publish() {
+        uint32_t head = producer.head + 1;
+        uint32_t depth = head - __atomic_load_n(&consumer.tail, __ATOMIC_RELAXED);
+        if (depth > producer.high_water) {
+            producer.high_water = depth;
+        }
+        producer.pushed++;
+        __atomic_store_n(&producer.head, head, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief Producer: copy one record in
+     * @return false if the ring was full and the record dropped
+     */
+    __attribute__((always_inline)) inline bool push(const T& record) {
+        T* slot = claim();
+        if (slot == NULL) {
+            return false;
+        }
+        *slot = record;
+        publish();
+        return true;
+    }
+
+    /**
+     * @brief Consumer: hand up to max queued records, oldest first, to fn(T&)
+     * @return Records taken
+     */
+    template <typename Fn>
+    uint32_t drain(Fn&& fn, uint32_t max) {
+        uint32_t tail = consumer.tail;
+        uint32_t head = __atomic_load_n(&producer.head, __ATOMIC_ACQUIRE);
+        uint32_t taken = 0;
+        while (tail != head && taken < max) {
+            fn(slots[tail & MASK]);
+            tail++;
+            taken++;
+        }
+        if (taken > 0) {
+            consumer.popped += taken;
+            consumer.batches++;
+            __atomic_store_n(&consumer.tail, tail, __ATOMIC_RELEASE);
+        }
+        return taken;
+    }
+
+    /**
+     * @brief Consumer: record how long a drained record waited
+     */
+    void note_latency(uint32_t us) {
+        if (us > consumer.latency_max_us) {
+            consumer.latency_max_us = us;
+        }
+        consumer.latency_avg_us = consumer.latency_avg_us == 0 ? us :
+            consumer.latency_avg_us + (((int32_t)(us - consumer.latency_avg_us)) >> SPSC_LATENCY_EWMA_SHIFT);
+    }
+
+    /**
+     * @brief Records queued; exact from either side, a snapshot from any other
+     */
+    uint32_t size() const {
+        return __atomic_load_n(&producer.head, __ATOMIC_ACQUIRE) - __atomic_load_n(&consumer.tail, __ATOMIC_ACQUIRE);
+    }
+
+    /**
+     * @brief Copy the figures; any task, word by word, so they may be a record apart
+     */
+    void get_stats(spsc_stats_t* out) const {
+        out->capacity = Slots;
+        out->depth = size();
+        out->high_water = producer.high_water;
+        out->pushed = producer.pushed;
+        out->dropped = producer.dropped;
+        out->popped = consumer.popped;
+        out->batches = consumer.batches;
+        out->latency_avg_us = consumer.latency_avg_us;
+        out->latency_max_us = consumer.latency_max_us;
+    }
+
+private:
+    struct alignas(SPSC_CACHE_LINE) {
+        volatile uint32_t head;
+        volatile uint32_t pushed;
+        volatile uint32_t dropped;
+        volatile uint32_t high_water;
+    } producer = {};
+    struct alignas(SPSC_CACHE_LINE) {
+        volatile uint32_t tail;
+        volatile uint32_t popped;
+        volatile uint32_t batches;
+        volatile uint32_t latency_avg_us;
+        volatile uint32_t latency_max_us;
+    } consumer = {};
+    T* slots = NULL;
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,55 @@
+#ifndef SSID_ARENA_H
+#define SSID_ARENA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+/**
+ * @brief Handle returned for hidden SSIDs or when the arena is full
+ */
+#define SSID_ARENA_NONE 0xFFFF
+
+/**
+ * @brief Reset the arena and its interning index
+ */
+void ssid_arena_init(void);
+
+/**
+ * @brief Start a new scan cycle
+ *
+ * Slots not interned since the previous call become eligible for reuse.
+ * Handles returned during the current cycle stay valid until the next call.
+ */
+void ssid_arena_begin_cycle(void);
+
+/**
+ * @brief Intern raw SSID bytes, reusing the slot of an identical SSID
+ * @param bytes SSID bytes (not necessarily NUL-terminated)
+ * @param len Length in bytes (truncated to MAX_SSID_LENGTH)
+ * @return Slot handle, or SSID_ARENA_NONE for empty SSIDs or a full arena
+ */
+uint16_t ssid_arena_intern(const uint8_t* bytes, uint8_t len);
+
+/**
+ * @brief Raw bytes of an interned SSID
+ * @param id Slot handle
+ * @param len Receives the length (0 for SSID_ARENA_NONE)
+ * @return Pointer into the arena (not NUL-terminated), or NULL
+ */
+const uint8_t* ssid_arena_bytes(uint16_t id, uint8_t* len);
+
+/**
+ * @brief Check whether an interned SSID contains a byte pattern
+ * @param id Slot handle
+ * @param needle NUL-terminated pattern
+ * @return true if the pattern occurs anywhere in the SSID
+ */
+bool ssid_arena_contains(uint16_t id, const char* needle);
+
+/**
+ * @brief Number of occupied slots
+ */
+uint16_t ssid_arena_count(void);
+
+#endif // SSID_ARENA_H
@@ -0,0 +1,39 @@
+#ifndef STATUS_LED_H
+#define STATUS_LED_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief What the status LED plays, in falling precedence for the system task
+ */
+typedef enum {
+    STATUS_LED_OFF = 0,
+    STATUS_LED_ON,                  // Solid, e.g. during boot
+    STATUS_LED_CRITICAL,            // 250 ms on, 250 ms off
+    STATUS_LED_OTA,                 // Double blink: a model upload is open
+    STATUS_LED_SCANNING,            // Short blink every 500 ms while a sweep runs
+    STATUS_LED_HEARTBEAT,           // 50 ms flash every 2 s
+    STATUS_LED_PATTERN_COUNT
+} status_led_pattern_t;
+
+/**
+ * @brief Drive BOARD.status_led from a one-shot esp_timer, LED off
+ * @return false if the board has no LED or the timer cannot be created
+ */
+bool status_led_init(void);
+
+/**
+ * @brief Switch patterns; the new one starts at once, from its first step
+ *
+ * Asking for the pattern already playing leaves it undisturbed, so this
+ * can be called on every monitoring cycle. Never blocks.
+ */
+void status_led_set(status_led_pattern_t pattern);
+
+/**
+ * @brief Pattern playing or about to start
+ */
+status_led_pattern_t status_led_get(void);
+
+#endif // STATUS_LED_H
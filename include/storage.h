@@ -0,0 +1,93 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "config.h"
+
+/**
+ * @brief Where a file lives
+ */
+typedef enum {
+    STORAGE_MEDIUM_NONE = 0,
+    STORAGE_MEDIUM_FLASH,           // LittleFS on the STORAGE_PARTITION_LABEL partition
+    STORAGE_MEDIUM_SD               // The card, on the shared SPI bus
+} storage_medium_t;
+
+/**
+ * @brief What a file is used for, which decides its medium
+ */
+typedef enum {
+    STORAGE_CLASS_CONFIG = 0,       // Small, rewritten whole, needed before the card: flash only
+    STORAGE_CLASS_MODEL,            // Large, read once at boot: flash, else the card
+    STORAGE_CLASS_LOG,              // Appended all day: the card, else flash
+    STORAGE_CLASS_COUNT
+} storage_class_t;
+
+/**
+ * @brief Flash file system state since boot
+ */
+typedef struct {
+    bool     flash_mounted;
+    bool     migrated;              // SPIFFS content was carried over this boot
+    uint16_t migrated_files;
+    uint16_t migration_lost;        // Files over the migration budget
+    uint32_t flash_total_bytes;
+    uint32_t flash_used_bytes;
+} storage_status_t;
+
+/**
+ * @brief Mount LittleFS, moving a SPIFFS partition's files over once
+ *
+ * A partition that does not mount as LittleFS but does as SPIFFS has its
+ * files read into PSRAM, is formatted as LittleFS, and gets them back.
+ * @return false if the flash file system cannot be mounted
+ */
+bool storage_init(void);
+
+/**
+ * @brief The medium a class of file goes to right now; no bus traffic
+ */
+storage_medium_t storage_select(storage_class_t cls);
+
+/**
+ * @brief Take a medium for file operations: the SD card's bus, nothing for flash
+ * @return false if the medium is not mounted
+ */
+bool storage_lock(storage_medium_t medium);
+
+/**
+ * @brief Give back what storage_lock() took
+ */
+void storage_unlock(storage_medium_t medium);
+
+/**
+ * @brief File system of a medium, NULL for STORAGE_MEDIUM_NONE
+ */
+fs::FS* storage_fs(storage_medium_t medium);
+
+/**
+ * @brief Select and lock the medium of a class in one step
+ *
+ * Release with storage_unlock(*medium); re-lock the same medium, not the
+ * class, for later operations on a file opened meanwhile.
+ * @return NULL if neither of the class's media is mounted
+ */
+fs::FS* storage_acquire(storage_class_t cls, storage_medium_t* medium);
+
+/**
+ * @brief Create a directory on a locked medium unless it exists
+ */
+bool storage_mkdir(storage_medium_t medium, const char* path);
+
+/**
+ * @brief Name of a medium for logs
+ */
+const char* storage_medium_name(storage_medium_t medium);
+
+/**
+ * @brief Copy the flash file system's state
+ */
+void storage_get_status(storage_status_t* status);
+
+#endif // STORAGE_H
@@ -0,0 +1,82 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+
+#define SUPERVISOR_PARKED  UINT32_MAX   // check-in wait: blocked on purpose, no deadline
+
+/**
+ * @brief The firmware's tasks, each checking in once per loop
+ */
+typedef enum {
+    SUPERVISED_UI = 0,
+    SUPERVISED_AI,
+    SUPERVISED_SCAN,
+    SUPERVISED_SYSTEM,
+    SUPERVISED_CAPTURE,
+    SUPERVISED_GPS,
+    SUPERVISED_COUNT
+} supervised_task_t;
+
+/**
+ * @brief Unstick a task's subsystem after a stall, e.g. restart a radio
+ * @return true if something was restarted
+ */
+typedef bool (*supervisor_recover_t)(void);
+
+/**
+ * @brief Liveness of one supervised task
+ */
+typedef struct {
+    const char* name;
+    uint32_t    checkins;
+    uint32_t    max_gap_ms;         // Longest time between two check-ins
+    uint32_t    max_late_ms;        // Longest a check-in came after the wait it announced
+    uint32_t    stalls;             // Times it went SUPERVISOR_STALL_MS overdue
+    uint32_t    recoveries;
+    bool        registered;
+    bool        retired;            // Ended on purpose
+} supervisor_task_stats_t;
+
+/**
+ * @brief Open the crash log and note a reset caused by a panic or watchdog
+ *
+ * Call once storage_init() has mounted LittleFS.
+ */
+void supervisor_init(void);
+
+/**
+ * @brief Start watching a task
+ * @param budget_ms Own work a loop may take past the wait it announces
+ * @param recover Called when the stall passes SUPERVISOR_RECOVER_MS, may be NULL
+ */
+void supervisor_register(supervised_task_t id, TaskHandle_t task, uint32_t stack_bytes,
+                         uint32_t budget_ms, supervisor_recover_t recover);
+
+/**
+ * @brief Heartbeat, from the task itself before it waits
+ * @param wait_ms Longest it is about to block, SUPERVISOR_PARKED for no limit
+ */
+void supervisor_checkin(supervised_task_t id, uint32_t wait_ms);
+
+/**
+ * @brief The task is ending on purpose; call before vTaskDelete(NULL)
+ */
+void supervisor_retire(supervised_task_t id);
+
+/**
+ * @brief Find overdue tasks and escalate: backtrace, subsystem restart, reboot
+ *
+ * Call about once a second from a task above all the supervised ones.
+ */
+void supervisor_check(uint32_t now_ms);
+
+/**
+ * @brief Copy one task's figures
+ */
+void supervisor_get(supervised_task_t id, supervisor_task_stats_t* stats);
+
+#endif // SUPERVISOR_H
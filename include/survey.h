@@ -0,0 +1,58 @@
+#ifndef SURVEY_H
+#define SURVEY_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define SURVEY_FILE_MAGIC   0x56525348u     // "HSRV"
+#define SURVEY_FORMAT       1
+
+/**
+ * @brief One sweep, as kept in RTC memory, written to SD and published
+ */
+typedef struct {
+    uint32_t time_s;                // time(): since power-on unless the clock was ever set
+    uint8_t  wifi_count;            // Access points heard
+    uint8_t  ble_count;             // Advertisers heard
+    int8_t   wifi_best_rssi;        // -128 with none
+    int8_t   ble_avg_rssi;          // Mean of the advertisers' RSSI, -128 with none
+    uint16_t channel_mask;          // Bit n: an access point on channel n (1-13)
+    uint8_t  open_count;            // Access points without encryption
+    uint8_t  wake_ms_x16;           // Time awake for the sweep, 16 ms units
+    uint32_t best_bssid;            // Last four bytes of the strongest BSSID
+} survey_record_t;
+
+static_assert(sizeof(survey_record_t) == 16, "survey record layout changed");
+
+/**
+ * @brief Start of the SD file and of each published payload; records follow
+ */
+typedef struct {
+    uint32_t magic;                 // SURVEY_FILE_MAGIC
+    uint8_t  format;                // SURVEY_FORMAT
+    uint8_t  record_bytes;          // sizeof(survey_record_t)
+    uint16_t records;               // In this payload; 0 in the file header
+    uint32_t wakes;                 // Survey wakes since the ring was created
+    uint32_t dropped;               // Records overwritten before a flush took them
+} survey_header_t;
+
+static_assert(sizeof(survey_header_t) == 16, "survey header layout changed");
+
+/**
+ * @brief Whether this boot is a survey wake
+ *
+ * Only built with SURVEY_MODE_ENABLED. False when SURVEY_EXIT_PIN is held
+ * low at reset, which boots the full firmware with the ring kept for later.
+ */
+bool survey_should_run(void);
+
+/**
+ * @brief Sweep, store, flush if due, and deep sleep until the next wake
+ *
+ * Called first thing in setup(), before the logger, the display and the
+ * tasks: nothing but the radios, and the SD card and the uplink on a
+ * flush, is brought up. Never returns.
+ */
+void survey_run(void) __attribute__((noreturn));
+
+#endif // SURVEY_H
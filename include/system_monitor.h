@@ -10,14 +10,26 @@ typedef struct {
     uint32_t free_heap_size;         // Free heap memory in bytes
     uint32_t free_psram_size;        // Free PSRAM in bytes  
     uint32_t min_free_heap;          // Minimum free heap since boot
-    uint8_t  cpu_usage_percent;      // CPU usage percentage
-    float    temperature_celsius;     // CPU temperature
     uint32_t uptime_ms;              // System uptime in milliseconds
+    float    temperature_celsius;    // CPU temperature
     uint16_t task_count;             // Number of active tasks
+    uint8_t  cpu_usage_percent;      // Mean of both cores over the last interval
     bool     wifi_connected;         // WiFi connection status
     bool     sd_card_mounted;        // SD card mount status
+    uint8_t  lvgl_used_pct;          // LVGL pool in use
+    uint8_t  lvgl_frag_pct;          // LVGL pool fragmentation
+    uint8_t  cpu_core_percent[2];    // Per core, 0 = PRO CPU
+    uint8_t  heap_frag_pct;          // Internal heap free space outside its largest block
+    uint8_t  thermal_level;          // thermal_level_t: throttling steps in force
+    uint8_t  reserved;
+    uint32_t lvgl_used_bytes;        // LVGL pool, as last sampled on the UI task
+    uint32_t lvgl_peak_bytes;        // Most of the LVGL pool ever in use
+    uint32_t lvgl_largest_free;      // Biggest LVGL allocation that could succeed
+    uint32_t heap_largest_free;      // Biggest internal allocation that could succeed
 } system_metrics_t;
 
+static_assert(sizeof(system_metrics_t) == 48, "system_metrics_t has implicit padding");
+
 /**
  * @brief Initialize system monitoring
  * @return true on success, false on failure
@@ -47,53 +59,3 @@ bool system_monitor_is_critical(void);
 void system_monitor_update_status_led(void);
 
 #endif // SYSTEM_MONITOR_H
-#ifndef SYSTEM_MONITOR_H
-#define SYSTEM_MONITOR_H
-
-#include <Arduino.h>
-
-// System metrics structure
-typedef struct {
-    uint32_t free_heap_size;
-    uint32_t free_psram_size;
-    uint32_t min_free_heap;
-    uint32_t uptime_ms;
-    uint32_t task_count;
-    float temperature_celsius;
-    uint8_t cpu_usage_percent;
-    bool wifi_connected;
-    bool sd_card_mounted;
-} system_metrics_t;
-
-// Function declarations
-bool system_monitor_init(void);
-bool system_monitor_is_critical(void);
-void system_monitor_get_metrics(system_metrics_t* metrics);
-
-#endif // SYSTEM_MONITOR_H
-#ifndef SYSTEM_MONITOR_H
-#define SYSTEM_MONITOR_H
-
-#include <Arduino.h>
-
-// System metrics structure
-typedef struct {
-    uint32_t free_heap_size;
-    uint32_t free_psram_size;
-    uint32_t min_free_heap;
-    uint32_t uptime_ms;
-    uint8_t task_count;
-    float temperature_celsius;
-    uint8_t cpu_usage_percent;
-    bool wifi_connected;
-    bool sd_card_mounted;
-} system_metrics_t;
-
-// Function declarations
-bool system_monitor_init(void);
-void system_monitor_get_metrics(system_metrics_t* metrics);
-void system_monitor_log_metrics(void);
-bool system_monitor_is_critical(void);
-void system_monitor_update_status_led(void);
-
-#endif // SYSTEM_MONITOR_H
@@ -0,0 +1,52 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+
+/**
+ * @brief Stack and heap use of one watched task
+ *
+ * Stack figures are in bytes (StackType_t is a byte on ESP-IDF). The heap
+ * figures need CONFIG_HEAP_TASK_TRACKING, which the stock Arduino core is
+ * built without; heap_tracked is false then and they stay 0.
+ */
+typedef struct {
+    const char* name;
+    uint32_t    stack_bytes;        // As created
+    uint32_t    stack_min_free;     // Least headroom ever, uxTaskGetStackHighWaterMark()
+    uint32_t    heap_bytes;         // Live heap blocks allocated by the task, last sample
+    uint32_t    heap_peak_bytes;    // Most seen at any sample
+    uint32_t    heap_blocks;
+    bool        heap_tracked;
+} task_stats_t;
+
+/**
+ * @brief Add a task to the stack and heap report
+ * @param stack_bytes Stack size it was created with
+ * @return false if TASK_MONITOR_MAX_TASKS are watched already
+ */
+bool task_monitor_watch(TaskHandle_t task, uint32_t stack_bytes);
+
+/**
+ * @brief Read every watched task's stack high-water mark and heap totals
+ *
+ * Logs a warning whenever a task's headroom reaches a new low under
+ * TASK_STACK_WARN_BYTES. Call from one task only.
+ */
+void task_monitor_sample(void);
+
+/**
+ * @brief Copy out the figures of the last sample
+ * @return Number of tasks written, at most max
+ */
+uint8_t task_monitor_get(task_stats_t* stats, uint8_t max);
+
+/**
+ * @brief Least stack headroom of any watched task, UINT32_MAX before the first sample
+ */
+uint32_t task_monitor_min_stack_free(void);
+
+#endif // TASK_MONITOR_H
@@ -0,0 +1,136 @@
+#ifndef TELEMETRY_SUMMARY_H
+#define TELEMETRY_SUMMARY_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+#include "rssi_histogram.h"
+
+/*
+ * What a node uplinks instead of every cycle: a summary per minute and
+ * per hour, each of fixed size whatever the cycle rate or the crowd.
+ * The scan task folds each cycle into the minute as it is published, and
+ * each closed minute into the hour. Counts are kept as log-spaced
+ * histograms, four buckets an octave, so their quantiles are within an
+ * eighth of the value; signal strengths as the cycles' RSSI histograms
+ * added up. The strongest devices are counted with a space-saving sketch
+ * of SUMMARY_SKETCH_SLOTS counters per window, each sighting weighing the
+ * square of its RSSI above -100 dBm: a device near the node for the whole
+ * window ranks above one that passed by, and far above the crowd at the
+ * edge. A reported weight is an upper bound, at most error above the true
+ * one.
+ */
+
+#define TELEMETRY_SUMMARY_VERSION 1
+
+/**
+ * @brief Window of a summary
+ */
+typedef enum {
+    SUMMARY_PERIOD_MINUTE = 0,
+    SUMMARY_PERIOD_HOUR,
+    SUMMARY_PERIOD_COUNT
+} summary_period_t;
+
+/**
+ * @brief Per-cycle figures summarized as quantiles
+ */
+typedef enum {
+    SUMMARY_METRIC_WIFI_NETWORKS = 0,
+    SUMMARY_METRIC_BLE_DEVICES,
+    SUMMARY_METRIC_WIFI_CLIENTS,
+    SUMMARY_METRIC_FRAMES_PER_SECOND,
+    SUMMARY_METRIC_AIRTIME_PERMILLE,
+    SUMMARY_METRIC_COUNT
+} summary_metric_t;
+
+/**
+ * @brief Distribution of one figure over the window's cycles
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t min;
+    uint16_t p50;
+    uint16_t p90;
+    uint16_t max;
+    uint16_t mean;
+} summary_quantiles_t;
+
+/**
+ * @brief One of the strongest devices of a window
+ */
+typedef struct {
+    uint8_t  mac[6];
+    uint8_t  kind;                  // device_kind_t
+    int8_t   rssi_max;
+    uint32_t weight;                // Sum of (RSSI + 100)^2 over its sightings, an upper bound...
+    uint32_t error;                 // ...by at most this much, inherited from the device it displaced
+} summary_top_t;
+
+/**
+ * @brief One window, as uplinked (little-endian, fixed layout like sensor_data_t)
+ */
+typedef struct __attribute__((packed, aligned(4))) {
+    uint8_t  version;               // TELEMETRY_SUMMARY_VERSION
+    uint8_t  period;                // summary_period_t
+    uint16_t cycles;                // Scan cycles folded in
+    uint32_t start_s;               // Uptime at the window's start
+    uint32_t utc_s;                 // UTC at its start, 0 without a clock
+    uint16_t span_s;                // Covered, up to its last cycle
+    uint8_t  top_count;             // Of top[] in use
+    uint8_t  unusual_peak_z10;      // Largest deviation from the hour-of-week baseline
+    uint32_t novel_devices;         // Not seen within NOVELTY_RETENTION_DAYS
+    uint32_t appeared;
+    uint32_t lost;
+    uint32_t moved;
+    summary_quantiles_t metrics[SUMMARY_METRIC_COUNT];
+    uint16_t novelty_peak_permille;
+    uint16_t unusual_cycles;        // At least SUMMARY_ANOMALY_Z10 from the baseline
+    uint16_t ap_anomalies;          // Rogue access point patterns detected
+    int8_t   wifi_rssi[3];          // 10th, 50th and 90th percentile, dBm
+    int8_t   ble_rssi[3];
+    uint8_t  reserved[2];
+    summary_top_t top[SUMMARY_TOP_K];
+} telemetry_summary_t;
+
+static_assert(sizeof(telemetry_summary_t) == 96 + SUMMARY_TOP_K * sizeof(summary_top_t),
+              "telemetry summary layout changed");
+static_assert(sizeof(telemetry_summary_t) <= UINT8_MAX, "a summary is one record of an MQTT batch");
+
+/**
+ * @brief Summaries since boot
+ */
+typedef struct {
+    uint32_t closed[SUMMARY_PERIOD_COUNT];
+    uint32_t taken;                 // By the uplink
+    uint32_t dropped;               // Overwritten before it took them
+    uint16_t sketch_replaced;       // Devices displaced from a full sketch, last minute
+    telemetry_summary_t last_minute;
+} telemetry_summary_stats_t;
+
+/**
+ * @brief Open the first windows
+ */
+void telemetry_summary_init(void);
+
+/**
+ * @brief Fold one published cycle into the minute, closing windows it ends (scan task)
+ *
+ * The devices heard in the cycle are those the table marked with its
+ * number, which is read before the delta is taken and the number moves on.
+ * @param cycle Device table cycle of the data
+ */
+void telemetry_summary_cycle(const sensor_data_t* data, const scan_histograms_t* histograms,
+                             uint16_t cycle, uint32_t now_ms);
+
+/**
+ * @brief Take the oldest closed summary the uplink has not had (any task)
+ * @return false if none is waiting
+ */
+bool telemetry_summary_take(telemetry_summary_t* summary);
+
+/**
+ * @brief Copy the figures and the last closed minute
+ */
+void telemetry_summary_get_stats(telemetry_summary_stats_t* stats);
+
+#endif // TELEMETRY_SUMMARY_H
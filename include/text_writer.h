@@ -0,0 +1,27 @@
+#ifndef TEXT_WRITER_H
+#define TEXT_WRITER_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Appends formatted text, such as a JSON document, to a caller's buffer
+ *
+ * The first append that does not fit sets truncated and leaves the text
+ * ending at the last append that did; every append after it is dropped,
+ * so a handler formats on and checks once at the end.
+ */
+typedef struct {
+    char*  out;
+    size_t capacity;
+    size_t length;
+    bool   truncated;
+} text_writer_t;
+
+void text_writer_init(text_writer_t* writer, char* out, size_t capacity);
+
+/**
+ * @brief Append printf-style text, or nothing once the buffer is full
+ */
+void text_printf(text_writer_t* writer, const char* format, ...);
+
+#endif // TEXT_WRITER_H
@@ -0,0 +1,73 @@
+#ifndef THERMAL_H
+#define THERMAL_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Throttling steps, each adding to the ones before
+ */
+typedef enum {
+    THERMAL_NORMAL = 0,
+    THERMAL_SCAN_THROTTLED,         // TUNABLE_THERMAL_SCAN_C: scan interval held at its ceiling
+    THERMAL_UI_THROTTLED,           // TUNABLE_THERMAL_UI_C: frames at most every THERMAL_UI_INTERVAL_MS
+    THERMAL_CPU_THROTTLED,          // TUNABLE_THERMAL_CPU_C: CPU at THERMAL_CPU_MHZ
+    THERMAL_LEVELS
+} thermal_level_t;
+
+/**
+ * @brief Filtered die temperature and the throttling in force
+ */
+typedef struct {
+    float           celsius;        // EWMA of the sensor readings
+    float           raw_celsius;    // Last reading
+    thermal_level_t level;
+    uint16_t        cpu_mhz;
+    uint16_t        frame_interval_ms;  // Shortest UI frame gap
+    uint32_t        level_changes;
+    uint32_t        throttled_ms;   // Time spent above THERMAL_NORMAL since boot
+    bool            sensor_driver;  // false: falling back to temperatureRead()
+} thermal_status_t;
+
+/**
+ * @brief Start the die temperature sensor in its 20-100 °C range
+ *
+ * Call before the tasks start; temperatureRead() reconfigures the same
+ * sensor, so nothing else should call it afterwards.
+ */
+bool thermal_init(void);
+
+/**
+ * @brief Read the sensor, filter it and step the throttling up or down
+ *
+ * Call once per monitoring cycle from the system task; lowering the CPU
+ * clock happens here.
+ */
+void thermal_sample(uint32_t now_ms);
+
+/**
+ * @brief Filtered die temperature; safe from any task
+ */
+float thermal_celsius(void);
+
+/**
+ * @brief Throttling step in force; safe from any task
+ */
+thermal_level_t thermal_level(void);
+
+/**
+ * @brief Shortest gap between UI frames at the current step
+ */
+uint32_t thermal_frame_interval_ms(void);
+
+/**
+ * @brief Copy the filtered temperature and throttling state
+ */
+void thermal_get_status(thermal_status_t* status);
+
+/**
+ * @brief Short name for logs ("normal", "scan", "ui", "cpu")
+ */
+const char* thermal_level_name(thermal_level_t level);
+
+#endif // THERMAL_H
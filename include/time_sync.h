@@ -0,0 +1,100 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Where the wall clock came from
+ */
+typedef enum {
+    TIME_SOURCE_NONE = 0,           // Unset: wall-clock reads fail
+    TIME_SOURCE_RTC,                // Kept by the RTC across a deep sleep or soft reset
+    TIME_SOURCE_PEER,               // Taken from a mesh node with a better clock
+    TIME_SOURCE_SNTP,               // Set by an NTP server over the uplink
+    TIME_SOURCES
+} time_source_t;
+
+/**
+ * @brief Time service status
+ */
+typedef struct {
+    uint8_t  source;                // time_source_t
+    uint8_t  stratum;               // 1 from NTP, one more per hop or boot; 0 unset
+    bool     sntp_running;
+    uint32_t synced_ms;             // Uptime of the last sync, 0 for none
+    int32_t  last_step_ms;          // How far the last sync moved the clock
+    uint32_t sntp_syncs;
+    uint32_t peer_syncs;
+} time_sync_status_t;
+
+/*
+ * One clock for the whole unit. The monotonic clock is esp_timer, counting
+ * microseconds from boot; the wall clock is that plus an offset cached
+ * here, so either read is a timer read and an add, with no lock on the
+ * reader's side. The offset is set by SNTP while the station link is up,
+ * otherwise by a mesh peer with a lower stratum, and the system clock the
+ * RTC keeps through deep sleep covers the time until either answers.
+ *
+ * Every timestamp stored by the unit stays on the monotonic clock. Each
+ * sync writes one SCAN_LOG_CLOCK record and one log line pairing an uptime
+ * with the wall clock, and that anchor places every record of the boot
+ * around it: nothing is added to the records themselves.
+ */
+
+/**
+ * @brief Set the time zone and take over a clock the RTC kept
+ *
+ * Call early in setup(), before anything reads the wall clock.
+ */
+void time_sync_init(void);
+
+/**
+ * @brief Start SNTP once the uplink is up and apply its updates
+ *
+ * Runs on the system task.
+ */
+void time_sync_tick(uint32_t now_ms);
+
+/**
+ * @brief Consider a mesh peer's wall clock
+ * @param stratum The peer's stratum; 0 means it has no clock
+ * @param wall_ms Its wall clock, in milliseconds since the epoch...
+ * @param local_us ...at this moment of our monotonic clock
+ * @return true if the clock was taken from the peer
+ */
+bool time_sync_offer_peer(uint8_t stratum, uint64_t wall_ms, int64_t local_us);
+
+/**
+ * @brief Microseconds since boot, never going back (safe from any task)
+ */
+int64_t time_sync_mono_us(void);
+
+/**
+ * @brief Microseconds since the epoch (safe from any task)
+ * @return false while the clock is unset
+ */
+bool time_sync_wall_us(int64_t* wall_us);
+
+/**
+ * @brief Wall clock of an uptime stamp, e.g. a record's millis()
+ * @return Milliseconds since the epoch, 0 while the clock is unset
+ */
+uint64_t time_sync_wall_ms_at(uint32_t uptime_ms);
+
+/**
+ * @brief Stratum to advertise to peers, 0 while unset
+ */
+uint8_t time_sync_stratum(void);
+
+/**
+ * @brief Copy the service status
+ */
+void time_sync_get_status(time_sync_status_t* status);
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* time_source_name(time_source_t source);
+
+#endif // TIME_SYNC_H
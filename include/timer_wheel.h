@@ -0,0 +1,80 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/*
+ * Housekeeping timers: log lines, periodic saves and the other jobs that
+ * would otherwise each keep a last-run time and compare it with millis()
+ * on every pass of some task's loop. A timer is filed in a hierarchical
+ * wheel of three levels of 64 slots, TIMER_WHEEL_TICK_MS per slot at the
+ * bottom: 64 ticks, 68 minutes and 72 hours at one and a second tick.
+ * Starting and cancelling a timer is O(1); each tick looks at one bottom
+ * slot, and every 64th tick files one slot of the level above into the
+ * one below. The system task advances the wheel once per monitoring cycle
+ * and runs the callbacks that came due; a callback with slow work hands it
+ * to the job pool.
+ */
+
+#define TIMER_WHEEL_NONE 0xFF
+
+typedef uint8_t timer_id_t;
+
+/**
+ * @brief Timer body; runs on the system task, outside the wheel's lock
+ */
+typedef void (*timer_fn_t)(void* arg);
+
+/**
+ * @brief Traffic through the wheel since boot
+ */
+typedef struct {
+    uint8_t  active;                // Timers filed now
+    uint8_t  peak;
+    uint32_t started;
+    uint32_t rejected;              // Every timer record in use
+    uint32_t fired;
+    uint32_t cascaded;              // Timers refiled from a higher level
+    uint32_t ticks;
+    uint32_t late_max_ms;           // Latest a callback ran after its deadline
+    uint32_t run_max_us;            // Longest callback
+} timer_wheel_stats_t;
+
+/**
+ * @brief Start with an empty wheel at the current time; before the tasks start
+ */
+void timer_wheel_init(void);
+
+/**
+ * @brief File a timer; any task
+ * @param name Static string, for logs
+ * @param delay_ms Until the first run
+ * @param period_ms Between later runs, 0 for a one-shot timer
+ * @param arg Handed to fn as it is, not copied
+ * @return Timer id, or TIMER_WHEEL_NONE with every record in use
+ */
+timer_id_t timer_wheel_start(const char* name, uint32_t delay_ms, uint32_t period_ms,
+                             timer_fn_t fn, void* arg);
+
+/**
+ * @brief Change a periodic timer's period from its next run on; any task, callbacks included
+ */
+void timer_wheel_set_period(timer_id_t id, uint32_t period_ms);
+
+/**
+ * @brief Stop a timer and free its record; any task. A run in progress finishes.
+ */
+void timer_wheel_cancel(timer_id_t id);
+
+/**
+ * @brief Process every tick up to now_ms and run the callbacks that came due (system task)
+ */
+void timer_wheel_advance(uint32_t now_ms);
+
+/**
+ * @brief Copy the figures
+ */
+void timer_wheel_get_stats(timer_wheel_stats_t* stats);
+
+#endif // TIMER_WHEEL_H
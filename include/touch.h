@@ -0,0 +1,33 @@
+#ifndef TOUCH_H
+#define TOUCH_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Arm the XPT2046 on the shared SPI host and its pen interrupt
+ *
+ * A pen-down edge on BOARD.touch.irq notifies the UI task with UI_EVENT_TOUCH
+ * and UI_EVENT_WAKE; nothing touches the bus until then.
+ * @return true on success, false on failure
+ */
+bool touch_init(void);
+
+/**
+ * @brief Sample the controller (median of TOUCH_SAMPLES per axis)
+ *
+ * Call only while a touch is active. A release re-arms the pen interrupt.
+ * Waits at most SPI_BUS_TOUCH_WAIT_MS for the SD card to free the bus,
+ * and reports the previous sample if it does not.
+ * @param x Receives the screen column while pressed
+ * @param y Receives the screen row while pressed
+ * @return true while the panel is pressed
+ */
+bool touch_read(int16_t* x, int16_t* y);
+
+/**
+ * @brief Touches started since boot, for "was there input since..." checks
+ */
+uint32_t touch_presses(void);
+
+#endif // TOUCH_H
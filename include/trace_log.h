@@ -0,0 +1,68 @@
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+#include "rssi_histogram.h"
+
+#define TRACE_FILE_MAGIC   0x52544848   // "HHTR"
+#define TRACE_FILE_FORMAT  1
+
+/**
+ * @brief Start of every trace file
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t record_bytes;          // sizeof(trace_record_t) of the writer
+    uint32_t heap_size;             // ESP.getHeapSize() of the recording unit
+    uint32_t boot;                  // log_manager_boot() of the recording unit; 0 in older files
+} trace_file_header_t;
+
+/**
+ * @brief One scan cycle: what the inference stage saw (little-endian, fixed layout)
+ *
+ * Holds the inputs of ai_features_extract() apart from the wall clock, so
+ * the host replay tool rebuilds the same feature vectors.
+ */
+typedef struct {
+    sensor_data_t data;             // As published, SENSOR_DATA_VERSION layout
+    rssi_hist_t   wifi_all;         // The histograms the extractor reads
+    rssi_hist_t   ble;
+    uint32_t      timestamp_ms;     // millis() when the features were extracted
+} trace_record_t;
+
+static_assert(sizeof(trace_file_header_t) == 16, "trace file header layout changed");
+static_assert(sizeof(trace_record_t) == 168, "trace record layout changed");
+
+/**
+ * @brief Open a new trace file in TRACE_LOG_DIR on the SD card
+ *
+ * Files are numbered by log_manager_next_segment() and rotated at
+ * TRACE_MAX_FILE_BYTES or LOG_SEGMENT_MAX_MS; the log manager indexes,
+ * compacts and expires them.
+ * @return false if there is no card or the file cannot be created
+ */
+bool trace_log_init(void);
+
+/**
+ * @brief Queue one scan cycle; records reach the card TRACE_FLUSH_RECORDS at a time
+ */
+void trace_log_append(const sensor_data_t* data, const scan_histograms_t* histograms,
+                      uint32_t timestamp_ms);
+
+/**
+ * @brief Write out queued records
+ */
+void trace_log_flush(void);
+
+/**
+ * @brief SD hot-plug listener (see sd_monitor_listen())
+ *
+ * A removal closes the trace file before the card is unmounted; queued
+ * records wait for the next card, which gets a new file.
+ */
+void trace_log_card_changed(bool mounted);
+
+#endif // TRACE_LOG_H
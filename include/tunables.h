@@ -0,0 +1,67 @@
+#ifndef TUNABLES_H
+#define TUNABLES_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Values that may be changed at run time, each bounded and kept in NVS
+ *
+ * Only what no hot path reads belongs here; everything else stays a
+ * compile-time constant in config.h.
+ */
+typedef enum {
+    TUNABLE_LOG_INTERVAL_MS = 0,        // Periodic AI and system log lines
+    TUNABLE_STATUS_REPORT_MS,           // Full system status report
+    TUNABLE_THERMAL_SCAN_C,             // Thermal steps, each above the one before
+    TUNABLE_THERMAL_UI_C,
+    TUNABLE_THERMAL_CPU_C,
+    TUNABLE_BACKLIGHT_INTERACTION_MS,   // Full brightness after a touch
+    TUNABLE_BATTERY_MAH,                // Capacity the runtime estimate divides
+    TUNABLE_COUNT
+} tunable_id_t;
+
+/**
+ * @brief One value with its bounds
+ */
+typedef struct {
+    const char* name;                   // Also its NVS key
+    int32_t     value;
+    int32_t     default_value;          // From config.h
+    int32_t     min;
+    int32_t     max;
+} tunable_info_t;
+
+/**
+ * @brief Load stored values over the config.h defaults; call before their readers start
+ */
+void tunables_init(void);
+
+/**
+ * @brief Current value; a single aligned load, safe from any task
+ */
+int32_t tunable_get(tunable_id_t id);
+
+/**
+ * @brief Take a new value and store it
+ * @return false outside its bounds (or out of order), or when NVS refused it
+ */
+bool tunable_set(tunable_id_t id, int32_t value);
+
+/**
+ * @brief Look a value up by name
+ * @return TUNABLE_COUNT if there is none
+ */
+tunable_id_t tunable_find(const char* name);
+
+/**
+ * @brief Copy one value with its bounds
+ */
+void tunable_get_info(tunable_id_t id, tunable_info_t* info);
+
+/**
+ * @brief Back to the config.h defaults, stored values erased
+ */
+void tunables_reset(void);
+
+#endif // TUNABLES_H
@@ -0,0 +1,31 @@
+#ifndef UI_EVENTS_H
+#define UI_EVENTS_H
+
+#include <Arduino.h>
+
+// Task notification bits that wake the UI task
+#define UI_EVENT_STATE     (1UL << 0)   // AI state published on BUS_TOPIC_AI_STATE
+#define UI_EVENT_SENSORS   (1UL << 1)   // Scan cycle published on BUS_TOPIC_SCAN
+#define UI_EVENT_WAKE      (1UL << 2)   // User interaction: full brightness, leave standby
+#define UI_EVENT_TOUCH     (1UL << 3)   // Pen down: start reading the touch controller
+#define UI_EVENT_MEMORY    (1UL << 4)   // Heap under pressure: release what the renderer can rebuild
+#define UI_EVENT_BENCH     (1UL << 5)   // Time every scene's frames for the benchmark report
+#define UI_EVENT_SOAK      (1UL << 6)   // Scripted step of a soak run: next scene in the ring
+#define UI_EVENT_IMAGE     (1UL << 7)   // An image from the card finished loading (image_cache.h)
+#define UI_EVENT_FEED      (1UL << 8)   // New lines in the event ticker (live_feed.h)
+
+/**
+ * @brief Wake the UI task to redraw for an external change
+ *
+ * The UI task otherwise sleeps until its next LVGL timer, animation or
+ * label refresh. Safe from any task; does nothing before the UI task runs.
+ * @param events UI_EVENT_* bits
+ */
+void ui_notify(uint32_t events);
+
+/**
+ * @brief ui_notify() for interrupt handlers
+ */
+void ui_notify_from_isr(uint32_t events);
+
+#endif // UI_EVENTS_H
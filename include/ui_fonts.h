@@ -0,0 +1,26 @@
+#ifndef UI_FONTS_H
+#define UI_FONTS_H
+
+#include <lvgl.h>
+
+// Generated into src/generated/ui_fonts.c by tools/fonts/subset_fonts.py
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Montserrat Medium at 12 and 14 px, printable ASCII only
+ *
+ * Stand-ins for lv_font_montserrat_12/14 without the symbol glyphs. Text
+ * outside 0x20-0x7E draws as blank space. ui_font_14 is also LVGL's
+ * LV_FONT_DEFAULT (see platformio.ini).
+ */
+LV_FONT_DECLARE(ui_font_12);
+LV_FONT_DECLARE(ui_font_14);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UI_FONTS_H
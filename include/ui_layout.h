@@ -0,0 +1,51 @@
+#ifndef UI_LAYOUT_H
+#define UI_LAYOUT_H
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+
+/**
+ * @brief How often LVGL has re-run the flex layouts built here
+ */
+typedef struct {
+    uint32_t passes;                // LV_EVENT_LAYOUT_CHANGED on any layout container
+} ui_layout_stats_t;
+
+/**
+ * @brief Make a scene's screen a padded, non-scrolling flex column
+ *
+ * Nothing on a screen is placed by pixel: positions follow from the
+ * screen size, whatever the panel and rotation, and LVGL keeps them in
+ * the objects until the size changes again.
+ */
+void ui_layout_screen(lv_obj_t* screen);
+
+/**
+ * @brief Transparent flex container, sized to its content
+ * @return The container; give it a width or ui_layout_fill() as needed
+ */
+lv_obj_t* ui_layout_box(lv_obj_t* parent, lv_flex_flow_t flow);
+
+/**
+ * @brief Stretch an object across its flex column and let it take grow
+ *        shares of the height left over (0 for none)
+ */
+void ui_layout_fill(lv_obj_t* obj, uint8_t grow);
+
+/**
+ * @brief Pin a one-line label to its column's width and its font's height
+ *
+ * A label sized to its content resizes with every new text, and LVGL then
+ * re-runs the whole flex chain above it. A fixed box is redrawn but never
+ * relaid, so the layout is only computed again when the screen changes size.
+ * Set the font first.
+ */
+void ui_layout_line(lv_obj_t* label);
+
+/**
+ * @brief Copy the layout counters
+ */
+void ui_layout_get_stats(ui_layout_stats_t* stats);
+
+#endif // UI_LAYOUT_H
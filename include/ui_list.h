@@ -0,0 +1,52 @@
+#ifndef UI_LIST_H
+#define UI_LIST_H
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+
+/**
+ * @brief Writes the text of one list row
+ * @param user_data As given to ui_list_create()
+ * @param row Index of the row in the list
+ */
+typedef void (*ui_list_fill_t)(void* user_data, uint32_t row, char* text, size_t size);
+
+/**
+ * @brief Scrolling list over a fixed pool of row labels
+ *
+ * Only UI_LIST_POOL_ROWS labels exist however long the list is. Row i is
+ * shown by pooled label i % UI_LIST_POOL_ROWS, so a label that scrolls out
+ * at one end is moved and refilled as the row coming in at the other end,
+ * and rows that stay on screen are left alone.
+ */
+typedef struct {
+    lv_obj_t*      container;               // Scrollable viewport
+    lv_obj_t*      spacer;                  // Sets the content height to count rows
+    lv_obj_t*      rows[UI_LIST_POOL_ROWS];
+    uint32_t       row_of[UI_LIST_POOL_ROWS]; // Row each label shows, UINT32_MAX for none
+    uint32_t       count;
+    lv_coord_t     row_height;
+    ui_list_fill_t fill;
+    void*          user_data;
+    uint32_t       refills;                 // Labels given another row or new text
+} ui_list_t;
+
+/**
+ * @brief Build the viewport and its label pool
+ *
+ * The size may be relative (lv_pct()) or left to a flex layout: rows span
+ * the viewport and are re-placed whenever it is resized.
+ * @return The viewport, for placement
+ */
+lv_obj_t* ui_list_create(ui_list_t* list, lv_obj_t* parent, lv_coord_t width, lv_coord_t height,
+                         ui_list_fill_t fill, void* user_data);
+
+/**
+ * @brief Change the number of rows and redraw the visible ones
+ *
+ * Labels whose text is unchanged are not invalidated.
+ */
+void ui_list_set_count(ui_list_t* list, uint32_t count);
+
+#endif // UI_LIST_H
@@ -0,0 +1,45 @@
+#ifndef UI_SCREENS_H
+#define UI_SCREENS_H
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "renderer.h"
+
+/**
+ * @brief Register the detail screens behind the home scene
+ *
+ * The screens form a ring: home, the live event feed, WiFi networks,
+ * BLE devices, system health, RSSI charts. Each is built only on first entry (see
+ * renderer_show()) and may be evicted again once it is out of view.
+ */
+void ui_screens_init(const renderer_scene_t* home);
+
+/**
+ * @brief Move along the ring, wrapping at either end
+ *
+ * The UI task steps on a swipe (see gestures.h): left for the next
+ * screen, right for the previous one.
+ * @param step Screens to move, negative for backwards
+ */
+void ui_screens_step(int8_t step);
+
+/**
+ * @brief Record the WiFi and BLE median RSSI of a newly published scan cycle
+ *
+ * Call on every UI_EVENT_SENSORS, whichever screen is up: the sparkline
+ * history survives the RSSI screen being torn down. The medians come from
+ * the aggregator's feature vector and are not recomputed here.
+ */
+void ui_screens_sample(void);
+
+/**
+ * @brief Number of scenes in the ring, home included
+ */
+uint8_t ui_screens_count(void);
+
+/**
+ * @brief Scene at a place in the ring, 0 being home
+ */
+const renderer_scene_t* ui_screens_scene(uint8_t index);
+
+#endif // UI_SCREENS_H
@@ -0,0 +1,86 @@
+#ifndef UI_THEME_H
+#define UI_THEME_H
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+#include "ai_states.h"
+
+/**
+ * @brief What an object is for; each has one shared style
+ */
+typedef enum {
+    UI_STYLE_SCREEN = 0,            // Scene screen background
+    UI_STYLE_LAYOUT,                // Scene screen padding and row gap
+    UI_STYLE_STATUS_ROW,            // Face screen status row: gap between icon and text
+    UI_STYLE_TEXT,                  // Plain text: status line, list rows, legends
+    UI_STYLE_TITLE,                 // Screen titles and list headers
+    UI_STYLE_ALERT,                 // Warnings: rogue access points on the ticker
+    UI_STYLE_STATS,                 // Face screen system figures
+    UI_STYLE_NETWORK,               // Face screen scan counters
+    UI_STYLE_HEALTH,                // System health lines
+    UI_STYLE_CHART,                 // Chart strips
+    UI_STYLE_CHART_POINTS,          // Chart indicator part: no point markers
+    UI_STYLE_OVERLAY,               // Renderer profile overlay
+    UI_STYLE_ROLES
+} ui_style_role_t;
+
+/**
+ * @brief Colour sets; every role and AI state has a colour in each
+ */
+typedef enum {
+    UI_THEME_CLASSIC = 0,           // Green and cyan on black
+    UI_THEME_NIGHT,                 // Dim reds, kind to dark-adapted eyes
+    UI_THEMES
+} ui_theme_t;
+
+/*
+ * Shared styles for every scene. They are built once, after lv_init(), and
+ * objects only point at them, so building a screen adds no local styles to
+ * the LVGL heap and LVGL resolves each property from a handful of styles
+ * every object shares. A state change on the status line swaps one style
+ * pointer. A theme change rewrites the properties the styles already hold,
+ * which allocates nothing, and restyles the screens once. UI task only.
+ */
+
+/**
+ * @brief Build the shared styles in UI_THEME_DEFAULT
+ *
+ * Call once, after lv_init() and before any scene is built.
+ */
+void ui_theme_init(void);
+
+/**
+ * @brief Give an object a role's shared style
+ */
+void ui_theme_apply(lv_obj_t* obj, ui_style_role_t role);
+
+/**
+ * @brief Replace one role's shared style on an object with another's
+ */
+void ui_theme_swap(lv_obj_t* obj, ui_style_role_t from, ui_style_role_t to);
+
+/**
+ * @brief Colour an object's text by AI state, swapping out the previous state's style
+ * @param previous The state the object shows now, or AI_STATE_COUNT for none yet
+ */
+void ui_theme_set_state(lv_obj_t* obj, ai_state_t previous, ai_state_t state);
+
+/**
+ * @brief Switch every shared style to another colour set
+ *
+ * Does nothing if the theme is already in force.
+ */
+void ui_theme_set(ui_theme_t theme);
+
+/**
+ * @brief Theme in force
+ */
+ui_theme_t ui_theme_current(void);
+
+/**
+ * @brief Short name for logs ("classic", "night")
+ */
+const char* ui_theme_name(ui_theme_t theme);
+
+#endif // UI_THEME_H
@@ -0,0 +1,75 @@
+#ifndef WAKE_SOURCES_H
+#define WAKE_SOURCES_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+
+/**
+ * @brief What ended the sleep this boot came from
+ */
+typedef enum {
+    WAKE_CAUSE_RESET = 0,           // Power-on, reset or crash: no sleep before
+    WAKE_CAUSE_TIMER,               // The RTC timer (survey mode)
+    WAKE_CAUSE_TOUCH,               // Touch IRQ
+    WAKE_CAUSE_MOTION,              // Accelerometer INT1
+    WAKE_CAUSE_COUNT
+} wake_cause_t;
+
+/**
+ * @brief Sources found at boot and what they reported since
+ */
+typedef struct {
+    wake_cause_t boot_cause;
+    bool     accelerometer;         // Answered at WAKE_ACCEL_ADDR and configured
+    bool     battery;               // BOARD.battery_adc is wired
+    uint16_t battery_mv;            // Last reading, 0 without a battery
+    uint32_t motion_events;         // Felt while awake, since boot
+    uint32_t motion_ms;             // millis() of the last one, or of a motion wake
+} wake_status_t;
+
+/**
+ * @brief What ended the last sleep, from the RTC's wake status; no setup needed
+ */
+wake_cause_t wake_sources_boot_cause(void);
+
+/**
+ * @brief Read the boot cause, set up the accelerometer and the battery pin
+ *
+ * Call after Wire.begin(). The accelerometer's INT1 is also armed as a
+ * light-sleep wakeup, next to the touch IRQ the power manager arms.
+ */
+void wake_sources_init(void);
+
+/**
+ * @brief Clear a latched motion interrupt and read the battery
+ *
+ * Once per monitoring cycle from the system task; the interrupt stays
+ * latched (and INT1 low) until this reads it.
+ */
+void wake_sources_sample(uint32_t now_ms);
+
+/**
+ * @brief SENSOR_WAKE_* bits for the cycle's sensor data; safe from any task
+ */
+uint8_t wake_sources_flags(uint32_t now_ms);
+
+/**
+ * @brief Arm the touch IRQ, and the accelerometer if motion, to end a deep sleep
+ *
+ * Both lines are active low. A classic ESP32 can only wake when all its
+ * EXT1 pins are low, so there only the touch IRQ is armed.
+ */
+void wake_sources_arm_deep_sleep(bool motion);
+
+/**
+ * @brief Copy the sources and their figures
+ */
+void wake_sources_get_status(wake_status_t* status);
+
+/**
+ * @brief Short name for logs and metrics ("reset", "timer", "touch", "motion")
+ */
+const char* wake_cause_name(wake_cause_t cause);
+
+#endif // WAKE_SOURCES_H
@@ -0,0 +1,68 @@
+#ifndef WARDRIVE_H
+#define WARDRIVE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief How the unit is moving, from the GPS speed over ground
+ */
+typedef enum {
+    WARDRIVE_NO_FIX = 0,            // Interval left as planned
+    WARDRIVE_PARKED,                // Slow for WARDRIVE_STILL_MS: WARDRIVE_STILL_PCT
+    WARDRIVE_SLOW,                  // Neither parked nor moving: as planned
+    WARDRIVE_MOVING,                // WARDRIVE_MOVING_PCT
+    WARDRIVE_FAST,                  // WARDRIVE_FAST_PCT
+    WARDRIVE_MOTIONS
+} wardrive_motion_t;
+
+/**
+ * @brief Tagging and pacing since boot
+ */
+typedef struct {
+    uint8_t  motion;                // wardrive_motion_t
+    uint16_t scale_pct;             // Applied to the last interval
+    uint32_t tagged_cycles;         // Cycles with a position record ahead of their sightings
+    uint32_t untagged_cycles;       // Cycles without a fix
+    uint32_t dropped;               // Position records the scan log had no room for
+    uint32_t distance_m;            // Travelled between tagged cycles
+} wardrive_stats_t;
+
+/*
+ * Mobile surveys on top of the normal scan cycle. With a fix, each cycle
+ * stages one SCAN_LOG_POSITION record just before its sightings go to the
+ * scan log, so every sighting is placed by the position record before it
+ * and nothing is added per device; the log's batched sector writes carry
+ * both. tools/scan_log/dump_scan_log.py --wigle joins them into a WiGLE
+ * CSV. The scan interval follows the speed over ground: sweeps come
+ * closer together on the move, so the distance between them stays
+ * useful, and spread out while parked.
+ */
+
+/**
+ * @brief Stage the cycle's position ahead of its sightings; from the scan task
+ */
+void wardrive_tag_cycle(uint32_t now_ms);
+
+/**
+ * @brief Scale the next scan interval by the motion
+ * @return planned_ms scaled, never below WARDRIVE_MIN_INTERVAL_MS unless planned so
+ */
+uint32_t wardrive_interval_ms(uint32_t planned_ms, uint32_t now_ms);
+
+/**
+ * @brief Copy the figures
+ */
+void wardrive_get_stats(wardrive_stats_t* stats);
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* wardrive_motion_name(wardrive_motion_t motion);
+
+/**
+ * @brief Equirectangular distance between two positions; good to a few kilometres
+ */
+uint32_t wardrive_distance_m(int32_t lat1_e7, int32_t lon1_e7, int32_t lat2_e7, int32_t lon2_e7);
+
+#endif // WARDRIVE_H
@@ -0,0 +1,72 @@
+#ifndef WARM_START_H
+#define WARM_START_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_states.h"
+#include "ai_features.h"
+
+#define WARM_START_MAGIC   0x4D524157   // "WARM"
+#define WARM_START_VERSION 1
+
+/**
+ * @brief The AI task's behavioural state, as persisted (little-endian, fixed layout)
+ *
+ * The learned site thresholds and the novelty filter persist on their own;
+ * this is what used to be lost on every reboot.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t feature_count;         // AI_FEATURE_COUNT of the writer
+    uint8_t  state;                 // ai_state_t in force
+    uint8_t  previous_state;
+    uint8_t  excitement;            // 0-100
+    uint8_t  learning_progress;     // 0-100
+    uint32_t state_age_ms;          // Time in state when saved
+    uint32_t uptime_s;              // Of the boot that saved it
+    float    hidden[AI_FEATURE_COUNT];  // ai_sequence recurrent state
+    uint32_t crc32;                 // Of the fields above
+} warm_start_snapshot_t;
+
+/**
+ * @brief Restore and save counts since boot
+ */
+typedef struct {
+    bool     restored;              // A valid snapshot was found at boot
+    uint32_t saves;
+    uint32_t skipped;               // Due saves with nothing changed
+    uint32_t failures;
+} warm_start_stats_t;
+
+/**
+ * @brief Read the snapshot from the journal, else NVS, and register the shutdown save
+ *
+ * Call before the tasks start; ERROR and UPDATING are not restored, the
+ * unit comes back IDLE from them.
+ * @return true if a valid snapshot of this version was found
+ */
+bool warm_start_init(void);
+
+/**
+ * @brief The snapshot read at boot
+ * @return false if there was none
+ */
+bool warm_start_restored(warm_start_snapshot_t* snapshot);
+
+/**
+ * @brief Hand over the latest state; cheap, from the AI task after each decision
+ */
+void warm_start_update(const warm_start_snapshot_t* snapshot);
+
+/**
+ * @brief Save on a job worker every WARM_START_SAVE_INTERVAL_MS if the state changed
+ */
+void warm_start_tick(uint32_t now_ms);
+
+/**
+ * @brief Copy the counts
+ */
+void warm_start_get_stats(warm_start_stats_t* stats);
+
+#endif // WARM_START_H
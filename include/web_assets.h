@@ -0,0 +1,38 @@
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+
+/**
+ * @brief Dashboard asset figures since boot
+ */
+typedef struct {
+    uint32_t served;                // 200s, body sent from the mapped partition
+    uint32_t not_modified;          // 304s, the client's ETag still current
+    uint32_t missing;               // 404s, no such asset
+    uint32_t unasked;               // Served gzip to a client that did not offer it
+} web_assets_stats_t;
+
+/**
+ * @brief Serve the dashboard's ASSET_TYPE_WEB assets under WEB_ASSETS_PREFIX
+ *
+ * GET WEB_ASSETS_PREFIX "/<name>" answers with the asset of that name,
+ * and the bare prefix with WEB_ASSETS_INDEX; "/" redirects there. Bodies
+ * are stored gzip-compressed by tools/assets/pack_assets.py and sent as
+ * they are, straight from the flash cache, with Content-Encoding: gzip.
+ * The stored CRC-32 is the ETag, so a matching If-None-Match is answered
+ * 304 with no body. Pages are revalidated on every load; everything else
+ * is cached for WEB_ASSETS_MAX_AGE_S, which is safe because a changed
+ * file is a new image and the pages revalidate into its new ETags.
+ * @return false if the asset partition is not mapped
+ */
+bool web_assets_register(AsyncWebServer* server);
+
+/**
+ * @brief Copy the dashboard asset figures
+ */
+void web_assets_get_stats(web_assets_stats_t* stats);
+
+#endif // WEB_ASSETS_H
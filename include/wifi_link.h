@@ -0,0 +1,90 @@
+#ifndef WIFI_LINK_H
+#define WIFI_LINK_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Station link figures since boot
+ */
+typedef struct {
+    bool     associated;
+    uint8_t  home_channel;          // Access point's channel, 0 while not associated
+    int8_t   rssi;
+    uint8_t  power_save;            // wifi_ps_type_t in force
+    uint32_t associations;
+    uint32_t disconnects;
+    uint32_t off_channel_scans;     // Channel scans that left the home channel
+    uint32_t off_channel_ms;        // Time spent away from it
+    uint32_t scans_delayed;         // Waited for home time or uplink traffic first
+    uint32_t scans_skipped;         // Gave up waiting; the channel is missed this cycle
+} wifi_link_stats_t;
+
+/**
+ * @brief Join WIFI_LINK_SSID and keep the association up
+ *
+ * Call once the radio is in station mode. Reconnects are retried from
+ * wifi_link_tick() with a backoff from WIFI_LINK_RETRY_MIN_MS to
+ * WIFI_LINK_RETRY_MAX_MS, so a missing access point does not keep the
+ * radio busy while it scans.
+ * @return false if the connection events could not be registered
+ */
+bool wifi_link_init(void);
+
+/**
+ * @brief Use another network from now on
+ *
+ * Before wifi_link_init() this only replaces WIFI_LINK_SSID; afterwards
+ * the link leaves its network and joins the new one straight away.
+ * System task only.
+ */
+void wifi_link_set_credentials(const char* ssid, const char* password);
+
+/**
+ * @brief Retry a lost association and set the power save mode of the AI state
+ *
+ * Runs on the system task.
+ */
+void wifi_link_tick(uint32_t now_ms);
+
+/**
+ * @brief Whether the station is associated and has an address (safe from any task)
+ */
+bool wifi_link_associated(void);
+
+/**
+ * @brief Channel the association holds the radio on, 0 while not associated
+ */
+uint8_t wifi_link_home_channel(void);
+
+/**
+ * @brief Ask to scan a channel; pair a true return with wifi_link_release_radio()
+ *
+ * Without an association, or on the home channel, this returns at once.
+ * Otherwise it waits until the radio has been back on the home channel for
+ * WIFI_LINK_HOME_DWELL_MS and no uplink traffic is expected, and caps the
+ * dwell at WIFI_LINK_OFF_CHANNEL_MS, so the access point buffers at most
+ * that long for us. Runs on the scan task.
+ * @param dwell_ms In: the planned dwell; out: the dwell to use
+ * @return false if the wait would exceed WIFI_LINK_MAX_WAIT_MS; skip the channel
+ */
+bool wifi_link_claim_radio(uint8_t channel, uint16_t* dwell_ms);
+
+/**
+ * @brief The channel scan is over and the radio is back home
+ */
+void wifi_link_release_radio(void);
+
+/**
+ * @brief Keep scans on the home channel for the next window_ms
+ *
+ * The uplink calls this as it sends, so the reply finds the radio home.
+ */
+void wifi_link_expect_traffic(uint32_t window_ms);
+
+/**
+ * @brief Copy the link figures
+ */
+void wifi_link_get_stats(wifi_link_stats_t* stats);
+
+#endif // WIFI_LINK_H
@@ -0,0 +1,100 @@
+#ifndef WIFI_SCAN_H
+#define WIFI_SCAN_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ssid_arena.h"
+
+/**
+ * @brief Compact access point record, copied once from the driver per scan
+ */
+typedef struct {
+    uint8_t bssid[6];                    // Access point MAC address
+    uint16_t ssid_id;                    // SSID arena handle (SSID_ARENA_NONE if hidden)
+    int8_t  rssi;                        // Signal strength in dBm
+    uint8_t channel;                     // Primary channel
+    uint8_t auth_mode;                   // wifi_auth_mode_t value
+    uint32_t rx_time_us;                 // Radio clock when the channel scan completed
+} wifi_record_t;
+
+/**
+ * @brief Asynchronous WiFi scan engine status
+ */
+typedef enum {
+    WIFI_SCAN_STATE_IDLE = 0,   // No scan in flight, no unread results
+    WIFI_SCAN_STATE_RUNNING,    // Radio is sweeping channels
+    WIFI_SCAN_STATE_DONE,       // Results copied into the record table
+    WIFI_SCAN_STATE_FAILED      // Driver error or completion timeout
+} wifi_scan_status_t;
+
+/**
+ * @brief Task notification bit set on the scan task when a scan completes
+ */
+#define WIFI_SCAN_NOTIFY_BIT (1UL << 0)
+
+/**
+ * @brief Register the scan-done event handler
+ * @param notify_task Task to notify with WIFI_SCAN_NOTIFY_BIT (NULL = caller)
+ * @return true on success, false on failure
+ */
+bool wifi_scan_init(TaskHandle_t notify_task);
+
+/**
+ * @brief Start a non-blocking scan of all channels
+ * @return true if the radio accepted the scan request
+ */
+bool wifi_scan_start(void);
+
+/**
+ * @brief Clear the record table before a multi-slot channel sweep
+ */
+void wifi_scan_begin_sweep(void);
+
+/**
+ * @brief Clear the record table for a scan between sweeps
+ *
+ * The SSID arena's cycle carries on, so handles from the last sweep stay
+ * valid until the next wifi_scan_begin_sweep().
+ */
+void wifi_scan_clear_records(void);
+
+/**
+ * @brief Start a non-blocking scan of a single channel
+ *
+ * Results are appended to the record table until the next
+ * wifi_scan_begin_sweep(), so a sweep may be split into time slices.
+ * @param channel WiFi channel (1-13)
+ * @param dwell_ms Per-channel listen time
+ * @param passive Listen for beacons instead of sending probe requests
+ * @param bssid Only report this BSSID (NULL = all)
+ * @return true if the radio accepted the scan request
+ */
+bool wifi_scan_start_channel(uint8_t channel, uint16_t dwell_ms, bool passive, const uint8_t* bssid);
+
+/**
+ * @brief Advance the scan state machine without blocking
+ *
+ * Copies the driver results into the record table exactly once when the
+ * scan-done event has fired, and releases the driver's result list.
+ * @return Current scan status
+ */
+wifi_scan_status_t wifi_scan_poll(void);
+
+/**
+ * @brief Whether a scan currently owns the radio (safe from any task)
+ */
+bool wifi_scan_in_progress(void);
+
+/**
+ * @brief Access the record table filled since the sweep began
+ * @param records Receives a pointer to the internal table
+ * @return Number of valid records (0 while a scan is running)
+ */
+uint16_t wifi_scan_get_results(const wifi_record_t** records);
+
+/**
+ * @brief Acknowledge the current results and return to idle
+ */
+void wifi_scan_release(void);
+
+#endif // WIFI_SCAN_H
@@ -24,7 +24,7 @@
 /*====================
    HAL SETTINGS
  *====================*/
-#define LV_DISP_DEF_REFR_PERIOD    30
+#define LV_DISP_DEF_REFR_PERIOD    16    /*The renderer sets it per frame, see RENDERER_*_FRAME_MS*/
 #define LV_INDEV_DEF_READ_PERIOD   30
 
 /*========================
@@ -0,0 +1,152 @@
+/**
+ * @file ai_features.cpp
+ * @brief Per-cycle feature extraction for the state inference stage
+ *
+ * Decision code only ever sees this vector, so rules and models can be
+ * swapped without touching the scan path, and the cost of extraction is
+ * paid once per scan cycle instead of on every inference.
+ *
+ * Every feature is a ratio of two counts, so it is computed as one integer
+ * multiply and divide straight into Q15; only the time of day needs the
+ * FPU, once per cycle.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <time.h>
+#include "config.h"
+#include "ai_features.h"
+#include "i2c_sensors.h"
+#include "ambient.h"
+#include "profile.h"
+
+// Features never exceed the vector, and padding keeps whole 16-byte lines
+static_assert(AI_FEATURE_USED_COUNT <= AI_FEATURE_COUNT, "AI_FEATURE_COUNT too small");
+static_assert(sizeof(ai_feature_vector_t) % 16 == 0, "feature vector not line-aligned");
+
+static const char* const feature_names[AI_FEATURE_USED_COUNT] = {
+    "wifi_count", "ble_count",
+    "wifi_rssi_p10", "wifi_rssi_p50", "wifi_rssi_p90",
+    "ble_rssi_p50", "ble_rssi_p90",
+    "churn", "moved", "novelty", "novel_count",
+    "ble_phones", "ble_trackers", "ble_wearables", "ble_beacons",
+    "capture_fps", "wifi_clients", "memory_headroom",
+    "time_sin", "time_cos", "clock_valid", "user_interaction",
+    "wake_motion", "battery_low", "people", "places",
+    "location", "location_match", "airtime", "airtime_peak",
+    "temperature", "humidity", "light", "motion", "battery_level", "dark",
+    "unusual", "associations", "handshakes"
+};
+
+// Forward declarations
+static int16_t ratio(uint32_t value, uint32_t scale);
+static int16_t rssi_feature(const rssi_hist_t* hist, uint8_t percent);
+
+/**
+ * @brief Build the feature vector for one published scan cycle
+ */
+void ai_features_extract(const sensor_data_t* data, const scan_histograms_t* histograms,
+                         ai_feature_vector_t* features) {
+    PROFILE_SCOPE(PROFILE_FEATURES);
+    memset(features, 0, sizeof(*features));
+    int16_t* v = features->values;
+
+    uint32_t devices = data->wifi_networks_count + data->ble_devices_count;
+    v[AI_FEATURE_WIFI_COUNT] = ratio(data->wifi_networks_count, MAX_WIFI_NETWORKS);
+    v[AI_FEATURE_BLE_COUNT] = ratio(data->ble_devices_count, BLE_RECORD_CAPACITY);
+
+    v[AI_FEATURE_WIFI_RSSI_P10] = rssi_feature(&histograms->wifi_all, 10);
+    v[AI_FEATURE_WIFI_RSSI_P50] = rssi_feature(&histograms->wifi_all, 50);
+    v[AI_FEATURE_WIFI_RSSI_P90] = rssi_feature(&histograms->wifi_all, 90);
+    v[AI_FEATURE_BLE_RSSI_P50] = rssi_feature(&histograms->ble, 50);
+    v[AI_FEATURE_BLE_RSSI_P90] = rssi_feature(&histograms->ble, 90);
+
+    v[AI_FEATURE_CHURN] = ratio(data->devices_appeared + data->devices_lost, devices);
+    v[AI_FEATURE_MOVED] = ratio(data->devices_moved, devices);
+    v[AI_FEATURE_NOVELTY] = ratio(data->novelty_permille, 1000);
+    v[AI_FEATURE_NOVEL_COUNT] = ratio(data->novel_devices, AI_FEATURE_NOVEL_SCALE);
+
+    v[AI_FEATURE_BLE_PHONES] = ratio(data->ble_phones, data->ble_devices_count);
+    v[AI_FEATURE_BLE_TRACKERS] = ratio(data->ble_trackers, data->ble_devices_count);
+    v[AI_FEATURE_BLE_WEARABLES] = ratio(data->ble_wearables, data->ble_devices_count);
+    v[AI_FEATURE_BLE_BEACONS] = ratio(data->ble_beacons, data->ble_devices_count);
+
+    v[AI_FEATURE_CAPTURE_FPS] = ratio(data->capture_frames_per_second, AI_FEATURE_FPS_SCALE);
+    v[AI_FEATURE_WIFI_CLIENTS] = ratio(data->wifi_clients_count, AI_FEATURE_CLIENT_SCALE);
+    v[AI_FEATURE_MEMORY_HEADROOM] = ratio(data->free_memory, ESP.getHeapSize());
+
+    // Wall-clock time only exists once something has set it (NTP, RTC)
+    time_t now = time(NULL);
+    if (now > AI_FEATURE_MIN_EPOCH) {
+        struct tm local;
+        localtime_r(&now, &local);
+        float day_fraction = (local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec) / 86400.0f;
+        v[AI_FEATURE_TIME_SIN] = (int16_t)lroundf(sinf(2.0f * (float)M_PI * day_fraction) * AI_FEATURE_ONE);
+        v[AI_FEATURE_TIME_COS] = (int16_t)lroundf(cosf(2.0f * (float)M_PI * day_fraction) * AI_FEATURE_ONE);
+        v[AI_FEATURE_CLOCK_VALID] = AI_FEATURE_ONE;
+    }
+
+    v[AI_FEATURE_USER_INTERACTION] = data->user_interaction ? AI_FEATURE_ONE : 0;
+    v[AI_FEATURE_WAKE_MOTION] = data->wake_flags & SENSOR_WAKE_MOTION ? AI_FEATURE_ONE : 0;
+    v[AI_FEATURE_BATTERY_LOW] = data->wake_flags & SENSOR_WAKE_BATTERY_LOW ? AI_FEATURE_ONE : 0;
+    v[AI_FEATURE_PEOPLE] = ratio(data->people_clusters, AI_FEATURE_PEOPLE_SCALE);
+    v[AI_FEATURE_PLACES] = ratio(data->place_clusters, AI_FEATURE_PLACE_SCALE);
+    v[AI_FEATURE_LOCATION] = ratio(data->location, LOCATION_LABELS);
+    v[AI_FEATURE_LOCATION_MATCH] = ratio(data->location_match, 255);
+    v[AI_FEATURE_AIRTIME] = ratio(data->airtime_permille, 1000);
+    v[AI_FEATURE_AIRTIME_PEAK] = ratio(data->busiest_airtime_permille, 1000);
+
+    // I2C sensors: 0 while absent or stale
+    if (data->i2c_fresh & (1 << I2C_SENSOR_CLIMATE)) {
+        int32_t above = data->temperature_c10 - AI_FEATURE_TEMP_MIN_C10;
+        v[AI_FEATURE_TEMPERATURE] = ratio(above > 0 ? above : 0, AI_FEATURE_TEMP_SPAN_C10);
+        v[AI_FEATURE_HUMIDITY] = ratio(data->humidity_permille, 1000);
+    }
+    if (data->i2c_fresh & (1 << I2C_SENSOR_LIGHT)) {
+        v[AI_FEATURE_LIGHT] = ratio(data->light_lux, AI_FEATURE_LUX_SCALE);
+    }
+    if (data->i2c_fresh & (1 << I2C_SENSOR_MOTION)) {
+        v[AI_FEATURE_MOTION] = ratio(data->motion_mg, AI_FEATURE_MOTION_SCALE);
+    }
+    if (data->i2c_fresh & (1 << I2C_SENSOR_BATTERY)) {
+        v[AI_FEATURE_BATTERY_LEVEL] = ratio(data->battery_pct, 100);
+    }
+    v[AI_FEATURE_DARK] = data->ambient_level == AMBIENT_DARK ? AI_FEATURE_ONE : 0;
+    v[AI_FEATURE_UNUSUAL] = ratio(data->unusual_z10, AI_FEATURE_UNUSUAL_Z10);
+    v[AI_FEATURE_ASSOCIATIONS] = ratio(data->associations_per_min, AI_FEATURE_ASSOC_SCALE);
+    v[AI_FEATURE_HANDSHAKES] = ratio(data->handshakes_per_min, AI_FEATURE_HANDSHAKE_SCALE);
+
+    features->scan_cycle = data->scan_cycle;
+    features->timestamp_ms = millis();
+}
+
+/**
+ * @brief Short name of a feature slot, for logs and model metadata
+ */
+const char* ai_feature_name(ai_feature_index_t index) {
+    return index < AI_FEATURE_USED_COUNT ? feature_names[index] : "padding";
+}
+
+/**
+ * @brief value / scale clamped to [0, 1] in Q15 (0 when scale is 0)
+ */
+static int16_t ratio(uint32_t value, uint32_t scale) {
+    if (scale == 0) {
+        return 0;
+    }
+    if (value >= scale) {
+        return AI_FEATURE_ONE;
+    }
+    // 64-bit product: the heap size times AI_FEATURE_ONE overflows 32 bits
+    return (int16_t)(((uint64_t)value * AI_FEATURE_ONE + scale / 2) / scale);
+}
+
+/**
+ * @brief RSSI quantile mapped from [-100, 0] dBm to [0, 1] in Q15
+ */
+static int16_t rssi_feature(const rssi_hist_t* hist, uint8_t percent) {
+    int16_t rssi = rssi_hist_quantile(hist, percent);
+    if (rssi < -100) rssi = -100;
+    if (rssi > 0) rssi = 0;
+    return ratio(rssi + 100, 100);
+}
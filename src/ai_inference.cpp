@@ -0,0 +1,859 @@
+/**
+ * @file ai_inference.cpp
+ * @brief TensorFlow Lite Micro backend for state inference
+ *
+ * A quantized model is read from flash once, its tensor arena is allocated
+ * once (internal RAM when small enough, PSRAM otherwise) and each scan
+ * cycle's feature vector is classified with a single Invoke(). Anything
+ * that goes wrong leaves the rule engine in charge.
+ *
+ * The interpreter plans all tensors into one contiguous arena, so the
+ * placement decision is made for the arena as a whole: its exact size is
+ * found by bisecting over AllocateTensors(), which lets small models run
+ * entirely from internal SRAM instead of a guessed, oversized PSRAM block.
+ *
+ * Only the ops a small classifier needs are registered. Built with ESP_NN,
+ * the same registrations resolve to the ESP32-S3 SIMD kernels, which fall
+ * back to the reference code per op when a shape does not qualify.
+ *
+ * A model committed to the model store while running is built next to the
+ * one in force (second interpreter storage, own buffer and arena) and
+ * swapped in by the AI task between two inferences; if it fails to build,
+ * the old model simply stays.
+ *
+ * A second, much smaller model may sit in front of it (third interpreter
+ * storage, loaded once at boot). Most cycles look like the one before,
+ * and the small model is sure of those; it decides them alone, and the
+ * main model only runs on the cycles it is unsure of or that bring
+ * devices never seen before. The average cost stays near the small
+ * model's while the hard cycles get the main model's accuracy.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_inference.h"
+#include "model_store.h"
+#include "storage.h"
+#include "asset_store.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+#if AI_INFERENCE_BACKEND == AI_BACKEND_TFLITE
+#include <new>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+#include <soc/soc_memory_layout.h>
+#include <TensorFlowLite_ESP32.h>
+#if __has_include("tensorflow/lite/micro/micro_mutable_op_resolver.h")
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#define AI_OPS_SELECTIVE 1
+typedef tflite::MicroMutableOpResolver<AI_MODEL_MAX_OPS> ops_resolver_t;
+#else
+#include "tensorflow/lite/experimental/micro/kernels/all_ops_resolver.h"
+#include "tensorflow/lite/experimental/micro/micro_interpreter.h"
+#define AI_OPS_SELECTIVE 0
+typedef tflite::ops::micro::AllOpsResolver ops_resolver_t;
+#endif
+// Newer TFLite Micro logs through MicroPrintf and dropped ErrorReporter
+#if __has_include("tensorflow/lite/micro/micro_error_reporter.h")
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#define AI_TFLM_ERROR_REPORTER 1
+#elif __has_include("tensorflow/lite/experimental/micro/micro_error_reporter.h")
+#include "tensorflow/lite/experimental/micro/micro_error_reporter.h"
+#define AI_TFLM_ERROR_REPORTER 1
+#else
+#define AI_TFLM_ERROR_REPORTER 0
+#endif
+#if defined(ESP_NN)
+#define AI_KERNELS_NAME "ESP-NN"
+#else
+#define AI_KERNELS_NAME "reference"
+#endif
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+/**
+ * @brief A model with everything it needs to run
+ */
+typedef struct {
+    uint8_t* model_buffer;          // Flatbuffer, owned unless mapped
+    bool     model_mapped;          // model_buffer is in the asset partition, used in place
+    uint8_t* tensor_arena;          // Owned
+    tflite::MicroInterpreter* interpreter;
+    uint8_t  storage;               // Index into interpreter_storage
+    bool     arena_in_psram;
+    uint8_t  arena_class;           // mem_class_t it was allocated as
+    bool     plan_cached;
+    uint8_t  plan_probes;
+    uint32_t model_bytes;
+    uint32_t model_hash;
+    uint32_t arena_bytes;
+    uint32_t generation;            // Model store generation, 0 for a model file
+    int32_t  input_multiplier;      // Q15 feature to input tensor step, Q16 (integer inputs)
+    int32_t  input_zero_point;
+} engine_t;
+
+#define FAST_STORAGE 2              // Interpreter storage of the cascade's small model
+
+static engine_t engine;             // In force
+static engine_t fast_engine;        // Cascade's small model, if any
+static uint8_t interpreter_storage[3][sizeof(tflite::MicroInterpreter)] __attribute__((aligned(16)));
+static uint64_t invoke_us_total = 0;
+static uint64_t fast_invoke_us_total = 0;
+static ops_resolver_t resolver;
+
+#if AI_TFLM_ERROR_REPORTER
+/**
+ * @brief Swallows the expected failures of the arena size search
+ */
+class QuietErrorReporter : public tflite::ErrorReporter {
+public:
+    int Report(const char* format, va_list args) override { return 0; }
+};
+
+static tflite::MicroErrorReporter error_reporter;
+static QuietErrorReporter quiet_reporter;
+#endif
+
+// Forward declarations
+static bool register_ops(void);
+static tflite::MicroInterpreter* create_interpreter(const tflite::Model* model, uint8_t storage,
+                                                    uint8_t* arena, uint32_t bytes, bool quiet);
+static uint8_t* alloc_model_buffer(uint32_t size);
+static uint8_t* read_model_file(uint32_t* size);
+static uint8_t* read_model_from(storage_medium_t medium, const char* path, uint32_t* size);
+static uint8_t* read_model_slot(const model_slot_info_t* slot);
+static bool build_engine(engine_t* e, uint8_t* buffer, uint32_t size, uint8_t storage, bool mapped);
+static void release_engine(engine_t* e);
+static void activate_engine(const engine_t* e);
+static void load_fast_engine(void);
+static bool invoke_engine(engine_t* e, const ai_feature_vector_t* features, int8_t* best,
+                          float* confidence, float* margin);
+static bool finish_result(const ai_feature_vector_t* features, int8_t best, float confidence,
+                          float margin, ai_state_t* state);
+static void benchmark_engine(const engine_t* e, const char* role);
+static uint32_t hash_model(const uint8_t* data, uint32_t size);
+static bool arena_fits(engine_t* e, const tflite::Model* model, uint8_t* arena, uint32_t bytes);
+static uint32_t plan_arena(engine_t* e, const tflite::Model* model);
+static uint8_t* allocate_arena(uint32_t bytes, uint8_t* mem_class, bool* in_psram);
+static bool plan_input(engine_t* e);
+static void write_input(const engine_t* e, const ai_feature_vector_t* features);
+static int8_t read_output(const TfLiteTensor* output, float* confidence, float* margin);
+#endif
+
+static ai_inference_stats_t stats;
+static uint32_t cached_timestamp_ms = 0;
+static ai_state_t cached_state = AI_STATE_IDLE;
+static bool cached_valid = false;
+
+/**
+ * @brief Load the model from flash and allocate its tensor arena once
+ */
+bool ai_inference_init(void) {
+    memset(&stats, 0, sizeof(stats));
+
+#if AI_INFERENCE_BACKEND == AI_BACKEND_TFLITE
+    memset(&engine, 0, sizeof(engine));
+    memset(&fast_engine, 0, sizeof(fast_engine));
+    invoke_us_total = 0;
+    fast_invoke_us_total = 0;
+    if (!register_ops()) {
+        return false;
+    }
+
+    // The newest uploaded model wins over the one shipped in the asset
+    // partition, which is used where it lies, and that over a file
+    model_slot_info_t slot;
+    uint32_t size = 0;
+    uint8_t* buffer = NULL;
+    bool mapped = false;
+    if (model_store_active(&slot)) {
+        buffer = read_model_slot(&slot);
+        size = slot.length;
+    }
+    asset_t asset;
+    if (buffer == NULL && asset_store_find(ASSET_MODEL_NAME, &asset) && asset.type == ASSET_TYPE_TFLITE) {
+        slot.generation = 0;
+        buffer = (uint8_t*)asset.data;      // Read-only: TFLM never writes the flatbuffer
+        size = asset.length;
+        mapped = true;
+    }
+    if (buffer == NULL) {
+        slot.generation = 0;
+        buffer = read_model_file(&size);
+    }
+    if (buffer == NULL) {
+        return false;
+    }
+
+    engine_t loaded;
+    if (!build_engine(&loaded, buffer, size, 0, mapped)) {
+        return false;
+    }
+    loaded.generation = slot.generation;
+    activate_engine(&loaded);
+#if AI_CASCADE_ENABLED
+    load_fast_engine();
+#endif
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Switch to a model committed since the last call, between two inferences
+ */
+bool ai_inference_poll_update(void) {
+    model_slot_info_t slot;
+    if (!model_store_take_pending(&slot)) {
+        return false;
+    }
+
+#if AI_INFERENCE_BACKEND == AI_BACKEND_TFLITE
+    uint8_t* buffer = read_model_slot(&slot);
+    engine_t next;
+    if (buffer == NULL || !build_engine(&next, buffer, slot.length, engine.storage ^ 1, false)) {
+        stats.swap_failures++;
+        LOGE(AI, "❌ Model generation %lu rejected - keeping the current model", slot.generation);
+        return false;
+    }
+    next.generation = slot.generation;
+
+    release_engine(&engine);
+    activate_engine(&next);
+    stats.model_swaps++;
+    return true;
+#else
+    LOGW(AI, "⚠️  Model update received, but the TFLite backend is not built in");
+    return false;
+#endif
+}
+
+/**
+ * @brief Classify a feature vector with the model
+ */
+bool ai_inference_run(const ai_feature_vector_t* features, ai_state_t* state) {
+    if (!stats.model_loaded || features == NULL || state == NULL) {
+        return false;
+    }
+
+    // One Invoke() per scan cycle, however often the caller re-infers
+    if (cached_valid && features->timestamp_ms == cached_timestamp_ms) {
+        *state = cached_state;
+        return stats.last_confidence >= AI_MODEL_MIN_CONFIDENCE;
+    }
+
+#if AI_INFERENCE_BACKEND == AI_BACKEND_TFLITE
+    int8_t best = 0;
+    float confidence = 0.0f;
+    float margin = 0.0f;
+
+    // Cascade: the small model's answer stands when it is sure and nothing new appeared
+    if (fast_engine.interpreter != NULL &&
+        invoke_engine(&fast_engine, features, &best, &confidence, &margin)) {
+        if (features->values[AI_FEATURE_NOVEL_COUNT] > 0) {
+            stats.escalated_novelty++;
+        } else if (margin < AI_CASCADE_MARGIN || confidence < AI_MODEL_MIN_CONFIDENCE) {
+            stats.escalated_margin++;
+        } else {
+            stats.early_exits++;
+            return finish_result(features, best, confidence, margin, state);
+        }
+    }
+
+    if (!invoke_engine(&engine, features, &best, &confidence, &margin)) {
+        return false;
+    }
+    return finish_result(features, best, confidence, margin, state);
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Time AI_BENCHMARK_ROUNDS invocations of the loaded model and log the results
+ */
+void ai_inference_benchmark(void) {
+#if AI_INFERENCE_BACKEND == AI_BACKEND_TFLITE
+    if (!stats.model_loaded) {
+        LOGW(AI, "⚠️  No model loaded - inference benchmark skipped");
+        return;
+    }
+
+    benchmark_engine(&engine, "Model");
+    if (fast_engine.interpreter != NULL) {
+        benchmark_engine(&fast_engine, "Fast model");
+    }
+#endif
+}
+
+/**
+ * @brief Whether a buffer is a well-formed TFLite flatbuffer of this schema
+ */
+bool ai_inference_verify_model(const uint8_t* model, uint32_t size) {
+#if AI_INFERENCE_BACKEND == AI_BACKEND_TFLITE
+    // Every offset and vector length is checked against the buffer before
+    // anything reads through it
+    flatbuffers::Verifier verifier(model, size);
+    if (!tflite::VerifyModelBuffer(verifier)) {
+        return false;
+    }
+    return tflite::GetModel(model)->version() == TFLITE_SCHEMA_VERSION;
+#else
+    return true;                    // Never parsed by the rule engine
+#endif
+}
+
+/**
+ * @brief Name of the backend in use ("tflite" or "rules")
+ */
+const char* ai_inference_backend_name(void) {
+    return stats.model_loaded ? "tflite" : "rules";
+}
+
+/**
+ * @brief Copy the backend statistics
+ */
+void ai_inference_get_stats(ai_inference_stats_t* out) {
+    if (out != NULL) {
+        *out = stats;
+    }
+}
+
+#if AI_INFERENCE_BACKEND == AI_BACKEND_TFLITE
+/**
+ * @brief Register the kernels a small classifier uses
+ */
+static bool register_ops(void) {
+#if AI_OPS_SELECTIVE
+    // Each Add*() fails once AI_MODEL_MAX_OPS registrations are used up
+    const uint8_t wanted = 13;
+    uint8_t added = 0;
+    added += resolver.AddFullyConnected() == kTfLiteOk;
+    added += resolver.AddConv2D() == kTfLiteOk;
+    added += resolver.AddDepthwiseConv2D() == kTfLiteOk;
+    added += resolver.AddAveragePool2D() == kTfLiteOk;
+    added += resolver.AddMaxPool2D() == kTfLiteOk;
+    added += resolver.AddAdd() == kTfLiteOk;
+    added += resolver.AddMul() == kTfLiteOk;
+    added += resolver.AddRelu() == kTfLiteOk;
+    added += resolver.AddLogistic() == kTfLiteOk;
+    added += resolver.AddSoftmax() == kTfLiteOk;
+    added += resolver.AddReshape() == kTfLiteOk;
+    added += resolver.AddQuantize() == kTfLiteOk;
+    added += resolver.AddDequantize() == kTfLiteOk;
+    stats.ops_registered = added;
+    if (added != wanted) {
+        LOGE(AI, "❌ Registered %d of %d ops - raise AI_MODEL_MAX_OPS", added, wanted);
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * @brief Construct an interpreter in one of the static storages
+ * @param quiet Suppress error reports (arena size search)
+ */
+static tflite::MicroInterpreter* create_interpreter(const tflite::Model* model, uint8_t storage,
+                                                    uint8_t* arena, uint32_t bytes, bool quiet) {
+#if AI_TFLM_ERROR_REPORTER
+    tflite::ErrorReporter* reporter = quiet ? (tflite::ErrorReporter*)&quiet_reporter
+                                            : (tflite::ErrorReporter*)&error_reporter;
+    return new (interpreter_storage[storage]) tflite::MicroInterpreter(model, resolver, arena, bytes, reporter);
+#else
+    return new (interpreter_storage[storage]) tflite::MicroInterpreter(model, resolver, arena, bytes);
+#endif
+}
+
+/**
+ * @brief Buffer for a flatbuffer: 16-byte aligned, PSRAM to keep internal RAM free
+ */
+static uint8_t* alloc_model_buffer(uint32_t size) {
+    uint8_t* buffer = (uint8_t*)mem_aligned_alloc(MEM_BULK, 16, size);
+    if (buffer == NULL) {
+        LOGE(AI, "❌ Model buffer allocation failed");
+    }
+    return buffer;
+}
+
+/**
+ * @brief Read the model shipped on flash, else one copied to the SD card
+ */
+static uint8_t* read_model_file(uint32_t* size) {
+    uint8_t* buffer = read_model_from(STORAGE_MEDIUM_FLASH, AI_MODEL_PATH, size);
+    if (buffer == NULL) {
+        buffer = read_model_from(STORAGE_MEDIUM_SD, STORAGE_SD_MODEL_PATH, size);
+    }
+    if (buffer == NULL) {
+        LOGW(AI, "⚠️  No model at " AI_MODEL_PATH " or SD " STORAGE_SD_MODEL_PATH " - using rule engine");
+    }
+    return buffer;
+}
+
+/**
+ * @brief Read a model file, a bus hold per SPI_BUS_SD_CHUNK_BYTES on the card
+ * @return NULL if the medium or the file is missing or unreadable
+ */
+static uint8_t* read_model_from(storage_medium_t medium, const char* path, uint32_t* size) {
+    if (!storage_lock(medium)) {
+        return NULL;
+    }
+    File file = storage_fs(medium)->open(path, "r");
+    *size = file ? file.size() : 0;
+    storage_unlock(medium);
+    if (!file) {
+        return NULL;
+    }
+
+    uint8_t* buffer = NULL;
+    if (*size == 0 || *size > AI_MODEL_MAX_BYTES) {
+        LOGE(AI, "❌ Model size %u out of range", (unsigned)*size);
+    } else {
+        buffer = alloc_model_buffer(*size);
+    }
+    bool ok = buffer != NULL;
+    for (uint32_t offset = 0; ok && offset < *size; offset += SPI_BUS_SD_CHUNK_BYTES) {
+        size_t chunk = min((uint32_t)SPI_BUS_SD_CHUNK_BYTES, *size - offset);
+        ok = storage_lock(medium);
+        if (ok) {
+            ok = file.read(buffer + offset, chunk) == chunk;
+            storage_unlock(medium);
+        }
+    }
+    bool locked = storage_lock(medium);     // A card pulled meanwhile is closed without its bus
+    file.close();
+    if (locked) {
+        storage_unlock(medium);
+    }
+
+    if (!ok && buffer != NULL) {
+        LOGE(AI, "❌ Model read from %s failed", storage_medium_name(medium));
+        mem_free(MEM_BULK, buffer, *size);
+        buffer = NULL;
+    } else if (ok && medium == STORAGE_MEDIUM_SD) {
+        LOGI(AI, "📥 Model loaded from SD " STORAGE_SD_MODEL_PATH);
+    }
+    return buffer;
+}
+
+/**
+ * @brief Read a committed model out of the model store
+ */
+static uint8_t* read_model_slot(const model_slot_info_t* slot) {
+    if (slot->length == 0 || slot->length > AI_MODEL_MAX_BYTES) {
+        return NULL;
+    }
+
+    uint8_t* buffer = alloc_model_buffer(slot->length);
+    if (buffer != NULL && !model_store_read(slot, 0, buffer, slot->length)) {
+        LOGE(AI, "❌ Model slot %d read failed", slot->slot);
+        mem_free(MEM_BULK, buffer, slot->length);
+        buffer = NULL;
+    }
+    return buffer;
+}
+
+/**
+ * @brief Plan, allocate and validate a model; takes ownership of buffer unless mapped
+ */
+static bool build_engine(engine_t* e, uint8_t* buffer, uint32_t size, uint8_t storage, bool mapped) {
+    memset(e, 0, sizeof(*e));
+    e->model_buffer = buffer;
+    e->model_mapped = mapped;
+    e->model_bytes = size;
+    e->model_hash = hash_model(buffer, size);
+    e->storage = storage;
+
+    flatbuffers::Verifier verifier(buffer, size);
+    if (!tflite::VerifyModelBuffer(verifier)) {
+        LOGE(AI, "❌ Model is not a well-formed TFLite flatbuffer (%lu bytes)", size);
+        release_engine(e);
+        return false;
+    }
+    const tflite::Model* model = tflite::GetModel(buffer);
+    if (model->version() != TFLITE_SCHEMA_VERSION) {
+        LOGE(AI, "❌ Model schema %lu, expected %d", model->version(), TFLITE_SCHEMA_VERSION);
+        release_engine(e);
+        return false;
+    }
+
+    e->arena_bytes = plan_arena(e, model);
+    if (e->arena_bytes == 0) {
+        LOGE(AI, "❌ Model does not fit a %d KB arena", AI_ARENA_PROBE_MAX / 1024);
+        release_engine(e);
+        return false;
+    }
+
+    e->tensor_arena = allocate_arena(e->arena_bytes, &e->arena_class, &e->arena_in_psram);
+    if (e->tensor_arena == NULL) {
+        LOGE(AI, "❌ Tensor arena allocation failed");
+        release_engine(e);
+        return false;
+    }
+
+    e->interpreter = create_interpreter(model, storage, e->tensor_arena, e->arena_bytes, false);
+    if (e->interpreter->AllocateTensors() != kTfLiteOk) {
+        LOGE(AI, "❌ Tensor allocation failed - arena too small?");
+        release_engine(e);
+        return false;
+    }
+
+    // Input must hold the feature vector, output one score per ai_state_t
+    const TfLiteTensor* output = e->interpreter->output(0);
+    size_t output_size = output->type == kTfLiteInt8 ? 1 : sizeof(float);
+    if (e->interpreter->input(0)->bytes == 0 || output->bytes / output_size != AI_STATE_COUNT) {
+        LOGE(AI, "❌ Model output has %d classes, expected %d",
+             (int)(output->bytes / output_size), AI_STATE_COUNT);
+        release_engine(e);
+        return false;
+    }
+    if (!plan_input(e)) {
+        LOGE(AI, "❌ Model input type %d or scale %.6f unsupported",
+             e->interpreter->input(0)->type, e->interpreter->input(0)->params.scale);
+        release_engine(e);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Destroy the interpreter and free the buffers of an engine
+ */
+static void release_engine(engine_t* e) {
+    if (e->interpreter != NULL) {
+        e->interpreter->~MicroInterpreter();
+    }
+    if (e->tensor_arena != NULL) {
+        mem_free((mem_class_t)e->arena_class, e->tensor_arena, e->arena_bytes);
+    }
+    if (e->model_buffer != NULL && !e->model_mapped) {
+        mem_free(MEM_BULK, e->model_buffer, e->model_bytes);
+    }
+    uint8_t storage = e->storage;
+    memset(e, 0, sizeof(*e));
+    e->storage = storage;
+}
+
+/**
+ * @brief Put a built engine in force
+ */
+static void activate_engine(const engine_t* e) {
+    engine = *e;
+    cached_valid = false;
+
+    stats.model_loaded = true;
+    stats.arena_in_psram = engine.arena_in_psram;
+    stats.model_bytes = engine.model_bytes;
+    stats.arena_bytes = engine.arena_bytes;
+    stats.model_hash = engine.model_hash;
+    stats.plan_cached = engine.plan_cached;
+    stats.plan_probes = engine.plan_probes;
+    stats.model_generation = engine.generation;
+
+    LOGI(AI, "✅ TFLite model %08lx (generation %lu) loaded: %lu bytes%s, %lu byte arena in %s (%s), %s kernels",
+         engine.model_hash, engine.generation, engine.model_bytes,
+         engine.model_mapped ? " mapped in place" : "", engine.arena_bytes,
+         engine.arena_in_psram ? "PSRAM" : "internal RAM",
+         engine.plan_cached ? "cached plan" : "planned", AI_KERNELS_NAME);
+}
+
+/**
+ * @brief Load the cascade's small model, from the asset partition in place or from flash
+ *
+ * Without one, or if it does not build, the main model runs every cycle.
+ */
+static void load_fast_engine(void) {
+    uint8_t* buffer = NULL;
+    uint32_t size = 0;
+    bool mapped = false;
+    asset_t asset;
+    if (asset_store_find(ASSET_FAST_MODEL_NAME, &asset) && asset.type == ASSET_TYPE_TFLITE) {
+        buffer = (uint8_t*)asset.data;
+        size = asset.length;
+        mapped = true;
+    } else {
+        buffer = read_model_from(STORAGE_MEDIUM_FLASH, AI_FAST_MODEL_PATH, &size);
+    }
+    if (buffer == NULL) {
+        return;
+    }
+    if (!build_engine(&fast_engine, buffer, size, FAST_STORAGE, mapped)) {
+        LOGW(AI, "⚠️  Fast model rejected - the main model runs every cycle");
+        return;
+    }
+
+    stats.fast_loaded = true;
+    stats.fast_model_hash = fast_engine.model_hash;
+    stats.fast_arena_bytes = fast_engine.arena_bytes;
+    LOGI(AI, "✅ Fast model %08lx loaded: %lu bytes, %lu byte arena in %s; escalates under a %.2f margin",
+         fast_engine.model_hash, fast_engine.model_bytes, fast_engine.arena_bytes,
+         fast_engine.arena_in_psram ? "PSRAM" : "internal RAM", AI_CASCADE_MARGIN);
+}
+
+/**
+ * @brief Run one engine on a feature vector and count it against its model
+ * @return false if Invoke() failed
+ */
+static bool invoke_engine(engine_t* e, const ai_feature_vector_t* features, int8_t* best,
+                          float* confidence, float* margin) {
+    tflite::MicroInterpreter* runner = e->interpreter;
+    write_input(e, features);
+
+    uint32_t start = micros();
+    TfLiteStatus status = runner->Invoke();
+    uint32_t elapsed = micros() - start;
+    if (status != kTfLiteOk) {
+        stats.failures++;
+        return false;
+    }
+
+    if (e == &fast_engine) {
+        stats.fast_invocations++;
+        stats.fast_last_invoke_us = elapsed;
+        fast_invoke_us_total += elapsed;
+        stats.fast_avg_invoke_us = (uint32_t)(fast_invoke_us_total / stats.fast_invocations);
+    } else {
+        stats.invocations++;
+        stats.last_invoke_us = elapsed;
+        invoke_us_total += elapsed;
+        stats.avg_invoke_us = (uint32_t)(invoke_us_total / stats.invocations);
+    }
+    *best = read_output(runner->output(0), confidence, margin);
+    return true;
+}
+
+/**
+ * @brief Cache a cycle's result and accept it if confident enough
+ */
+static bool finish_result(const ai_feature_vector_t* features, int8_t best, float confidence,
+                          float margin, ai_state_t* state) {
+    stats.last_confidence = confidence;
+    stats.last_margin = margin;
+    cached_timestamp_ms = features->timestamp_ms;
+    cached_state = (ai_state_t)best;
+    cached_valid = true;
+
+    if (confidence < AI_MODEL_MIN_CONFIDENCE) {
+        stats.low_confidence++;
+        return false;
+    }
+    *state = cached_state;
+    return true;
+}
+
+/**
+ * @brief Time AI_BENCHMARK_ROUNDS invocations of one engine
+ */
+static void benchmark_engine(const engine_t* e, const char* role) {
+    // Mid-range input so no kernel takes a saturated shortcut
+    ai_feature_vector_t features;
+    memset(&features, 0, sizeof(features));
+    for (uint8_t i = 0; i < AI_FEATURE_USED_COUNT; i++) {
+        features.values[i] = AI_FEATURE_ONE / 2;
+    }
+    write_input(e, &features);
+    tflite::MicroInterpreter* runner = e->interpreter;
+
+    uint32_t min_us = UINT32_MAX;
+    uint32_t max_us = 0;
+    uint32_t total_us = 0;
+    uint32_t failed = 0;
+    for (uint32_t r = 0; r < AI_BENCHMARK_ROUNDS; r++) {
+        uint32_t start = micros();
+        TfLiteStatus status = runner->Invoke();
+        uint32_t elapsed = micros() - start;
+        if (status != kTfLiteOk) {
+            failed++;
+            continue;
+        }
+        total_us += elapsed;
+        if (elapsed < min_us) min_us = elapsed;
+        if (elapsed > max_us) max_us = elapsed;
+    }
+
+    uint32_t ok = AI_BENCHMARK_ROUNDS - failed;
+    LOGI(AI, "⏱️  %s %08lx (%s kernels, %d ops): mean %luus, min %luus, max %luus over %lu runs%s",
+         role, e->model_hash, AI_KERNELS_NAME, stats.ops_registered,
+         ok > 0 ? total_us / ok : 0, ok > 0 ? min_us : 0, max_us,
+         ok, failed > 0 ? " - INVOKE FAILURES" : "");
+}
+
+/**
+ * @brief FNV-1a over the flatbuffer
+ */
+static uint32_t hash_model(const uint8_t* data, uint32_t size) {
+    uint32_t hash = 2166136261UL;
+    for (uint32_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Whether AllocateTensors() succeeds within the first bytes of arena
+ */
+static bool arena_fits(engine_t* e, const tflite::Model* model, uint8_t* arena, uint32_t bytes) {
+    tflite::MicroInterpreter* trial = create_interpreter(model, e->storage, arena, bytes, true);
+    bool fits = trial->AllocateTensors() == kTfLiteOk;
+    trial->~MicroInterpreter();
+    e->plan_probes++;
+    return fits;
+}
+
+/**
+ * @brief Smallest workable arena size, from NVS or by bisection
+ * @return Arena size in bytes, or 0 if the model needs more than AI_ARENA_PROBE_MAX
+ */
+static uint32_t plan_arena(engine_t* e, const tflite::Model* model) {
+    // Each model of the cascade keeps a plan of its own
+    bool fast = e->storage == FAST_STORAGE;
+    const char* hash_key = fast ? "fast_hash" : "hash";
+    const char* bytes_key = fast ? "fast_bytes" : "bytes";
+    Preferences prefs;
+    if (prefs.begin(AI_ARENA_NVS_NAMESPACE, true)) {
+        uint32_t cached_hash = prefs.getUInt(hash_key, 0);
+        uint32_t cached_bytes = prefs.getUInt(bytes_key, 0);
+        prefs.end();
+        if (cached_hash == e->model_hash && cached_bytes != 0) {
+            e->plan_cached = true;
+            return cached_bytes;
+        }
+    }
+
+    // The search only needs one scratch buffer at the ceiling size
+    uint8_t* probe = (uint8_t*)mem_aligned_alloc(MEM_BULK, 16, AI_ARENA_PROBE_MAX);
+    if (probe == NULL) {
+        LOGE(AI, "❌ Arena planning buffer allocation failed");
+        return 0;
+    }
+
+    uint32_t low = AI_ARENA_MIN_BYTES;
+    uint32_t high = AI_ARENA_PROBE_MAX;
+    if (!arena_fits(e, model, probe, high)) {
+        mem_free(MEM_BULK, probe, AI_ARENA_PROBE_MAX);
+        return 0;
+    }
+
+    // Invariant: high fits, low - AI_ARENA_PLAN_STEP does not (or is below the minimum)
+    while (high - low > AI_ARENA_PLAN_STEP) {
+        uint32_t mid = (low + (high - low) / 2) & ~(uint32_t)(AI_ARENA_PLAN_STEP - 1);
+        if (mid <= low) {
+            break;
+        }
+        if (arena_fits(e, model, probe, mid)) {
+            high = mid;
+        } else {
+            low = mid;
+        }
+    }
+    mem_free(MEM_BULK, probe, AI_ARENA_PROBE_MAX);
+
+    uint32_t planned = high + AI_ARENA_MARGIN_BYTES;
+    LOGI(AI, "📐 Arena plan: %lu bytes needed (+%d margin) after %d probes",
+         high, AI_ARENA_MARGIN_BYTES, e->plan_probes);
+
+    if (prefs.begin(AI_ARENA_NVS_NAMESPACE, false)) {
+        prefs.putUInt(hash_key, e->model_hash);
+        prefs.putUInt(bytes_key, planned);
+        prefs.end();
+    }
+    return planned;
+}
+
+/**
+ * @brief Place the arena in internal RAM when it is small and there is room
+ */
+static uint8_t* allocate_arena(uint32_t bytes, uint8_t* mem_class, bool* in_psram) {
+    // Touched all through every inference: hot when it fits, bulk otherwise
+    *mem_class = bytes <= AI_ARENA_INTERNAL_MAX &&
+                 heap_caps_get_free_size(MALLOC_CAP_INTERNAL) > bytes + AI_ARENA_HEAP_RESERVE
+                 ? MEM_HOT_CPU : MEM_BULK;
+    uint8_t* arena = (uint8_t*)mem_aligned_alloc((mem_class_t)*mem_class, 16, bytes);
+    *in_psram = arena != NULL && esp_ptr_external_ram(arena);
+    return arena;
+}
+
+/**
+ * @brief Work out the step from a Q15 feature to the input tensor's quantization, once per model
+ *
+ * An integer input holds value / scale + zero_point, so a Q15 feature x
+ * becomes x * multiplier / 2^16 + zero_point with
+ * multiplier = 2^16 / (AI_FEATURE_ONE * scale).
+ * @return false for an input type or scale the features cannot be written into
+ */
+static bool plan_input(engine_t* e) {
+    const TfLiteTensor* input = e->interpreter->input(0);
+    if (input->type == kTfLiteFloat32) {
+        return true;
+    }
+    if (input->type != kTfLiteInt8 && input->type != kTfLiteInt16) {
+        return false;
+    }
+    float multiplier = 65536.0f / (AI_FEATURE_ONE * input->params.scale);
+    if (!(multiplier >= 1.0f && multiplier < (float)INT32_MAX)) {
+        return false;
+    }
+    e->input_multiplier = (int32_t)lroundf(multiplier);
+    e->input_zero_point = input->params.zero_point;
+    return true;
+}
+
+/**
+ * @brief Requantize the Q15 feature vector into the input tensor, integer only for integer inputs
+ */
+static void write_input(const engine_t* e, const ai_feature_vector_t* features) {
+    TfLiteTensor* input = e->interpreter->input(0);
+    if (input->type == kTfLiteFloat32) {
+        size_t count = input->bytes / sizeof(float);
+        for (size_t i = 0; i < count; i++) {
+            input->data.f[i] = i < AI_FEATURE_COUNT ? features->values[i] * (1.0f / AI_FEATURE_ONE) : 0.0f;
+        }
+        return;
+    }
+
+    bool wide = input->type == kTfLiteInt16;
+    int32_t low = wide ? INT16_MIN : INT8_MIN;
+    int32_t high = wide ? INT16_MAX : INT8_MAX;
+    size_t count = wide ? input->bytes / sizeof(int16_t) : input->bytes;
+    for (size_t i = 0; i < count; i++) {
+        int32_t x = i < AI_FEATURE_COUNT ? features->values[i] : 0;
+        int32_t q = (int32_t)(((int64_t)x * e->input_multiplier + 0x8000) >> 16) + e->input_zero_point;
+        q = q < low ? low : (q > high ? high : q);
+        if (wide) {
+            input->data.i16[i] = (int16_t)q;
+        } else {
+            input->data.int8[i] = (int8_t)q;
+        }
+    }
+}
+
+/**
+ * @brief Arg-max over the class scores, dequantized to probabilities
+ */
+static int8_t read_output(const TfLiteTensor* output, float* confidence, float* margin) {
+    int8_t best = 0;
+    float best_score = -1.0f;
+    float runner_up = -1.0f;
+
+    for (uint8_t i = 0; i < AI_STATE_COUNT; i++) {
+        float score = output->type == kTfLiteInt8
+            ? (output->data.int8[i] - output->params.zero_point) * output->params.scale
+            : output->data.f[i];
+        if (score > best_score) {
+            runner_up = best_score;
+            best_score = score;
+            best = (int8_t)i;
+        } else if (score > runner_up) {
+            runner_up = score;
+        }
+    }
+
+    *confidence = best_score;
+    *margin = best_score - max(runner_up, 0.0f);
+    return best;
+}
+#endif
@@ -0,0 +1,104 @@
+/**
+ * @file ai_sequence.cpp
+ * @brief Sliding window of feature vectors with a streaming temporal model
+ *
+ * The window is a ring buffer of the last AI_SEQUENCE_WINDOW vectors. Two
+ * causal filters run over it incrementally: a box filter (running sums, an
+ * evicted vector is subtracted as the new one is added) and a recurrent
+ * leaky integrator whose state moves AI_SEQUENCE_ALPHA of the way towards
+ * each new vector. Neither reprocesses the window, so a cycle costs the
+ * same with 4 vectors of history or 64. The vectors are Q15 integers, so
+ * the running sums are exact and never need rebuilding.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include "config.h"
+#include "ai_sequence.h"
+
+static ai_feature_vector_t window[AI_SEQUENCE_WINDOW];
+static int32_t sums[AI_FEATURE_COUNT];     // Q15
+static uint16_t head = 0;               // Next slot to write
+static uint32_t last_timestamp_ms = 0;
+static bool seeded = false;             // hidden came from ai_sequence_seed()
+static ai_sequence_state_t state;
+
+/**
+ * @brief Empty the window and reset the recurrent state
+ */
+void ai_sequence_init(void) {
+    memset(window, 0, sizeof(window));
+    memset(sums, 0, sizeof(sums));
+    memset(&state, 0, sizeof(state));
+    head = 0;
+    last_timestamp_ms = 0;
+    seeded = false;
+}
+
+/**
+ * @brief Start the recurrent state from a saved one instead of the first vector
+ */
+void ai_sequence_seed(const float* hidden) {
+    memcpy(state.hidden, hidden, sizeof(state.hidden));
+    seeded = true;
+}
+
+/**
+ * @brief Append the feature vector of a new scan cycle
+ */
+bool ai_sequence_push(const ai_feature_vector_t* features) {
+    if (features == NULL || features->timestamp_ms == 0 ||
+        features->timestamp_ms == last_timestamp_ms) {
+        return false;
+    }
+    last_timestamp_ms = features->timestamp_ms;
+
+    const int16_t* q = features->values;
+    const ai_feature_vector_t* evicted = state.length == AI_SEQUENCE_WINDOW ? &window[head] : NULL;
+
+    // The first vector seeds the recurrent state instead of leaking in from
+    // zero, unless a saved state already did
+    bool first = state.pushed == 0 && !seeded;
+    float distance = 0.0f;
+    for (uint8_t i = 0; i < AI_FEATURE_USED_COUNT; i++) {
+        if (evicted != NULL) {
+            sums[i] -= evicted->values[i];
+        }
+        sums[i] += q[i];
+        float x = q[i] * (1.0f / AI_FEATURE_ONE);
+        state.hidden[i] = first ? x : state.hidden[i] + AI_SEQUENCE_ALPHA * (x - state.hidden[i]);
+    }
+
+    window[head] = *features;
+    head = (head + 1) % AI_SEQUENCE_WINDOW;
+    if (state.length < AI_SEQUENCE_WINDOW) {
+        state.length++;
+    }
+
+    float to_mean = 1.0f / ((float)state.length * AI_FEATURE_ONE);
+    for (uint8_t i = 0; i < AI_FEATURE_USED_COUNT; i++) {
+        state.mean[i] = sums[i] * to_mean;
+        distance += fabsf(q[i] * (1.0f / AI_FEATURE_ONE) - state.mean[i]);
+    }
+    state.surprise = distance / AI_FEATURE_USED_COUNT;
+    state.newest_cycle = features->scan_cycle;
+    state.pushed++;
+    return true;
+}
+
+/**
+ * @brief Current streaming state (owned by the AI task, not thread-safe)
+ */
+const ai_sequence_state_t* ai_sequence_state(void) {
+    return &state;
+}
+
+/**
+ * @brief Vector pushed age cycles ago (0 = newest)
+ */
+const ai_feature_vector_t* ai_sequence_at(uint16_t age) {
+    if (age >= state.length) {
+        return NULL;
+    }
+    return &window[(head + AI_SEQUENCE_WINDOW - 1 - age) % AI_SEQUENCE_WINDOW];
+}
@@ -0,0 +1,206 @@
+/**
+ * @file ai_state_stats.cpp
+ * @brief Time in each committed AI state and the transitions between them
+ *
+ * The AI task charges the time since its previous tick to the state that
+ * was in force and, when the tick committed another one, counts the pair
+ * in the matrix: two additions per tick, whatever the uptime. Seconds are
+ * kept whole in the saved record and the remainders in RAM, so a stay
+ * split over many short ticks is not rounded away. The record is small
+ * enough for one journal entry and is saved like the site thresholds, to
+ * the journal or to NVS on a unit without a journal partition.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "config.h"
+#include "journal.h"
+#include "ai_state_stats.h"
+#include "logger.h"
+
+#define STATE_STATS_MAGIC    0x53545354  // "STST"
+#define STATE_STATS_VERSION  1
+#define STATE_STATS_JOURNAL_KEY "ststat"
+
+/**
+ * @brief Persisted figures
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t seconds[AI_STATE_COUNT];
+    uint32_t entries[AI_STATE_COUNT];
+    uint16_t transitions[AI_STATE_COUNT][AI_STATE_COUNT];
+    uint32_t halvings;
+} state_stats_record_t;
+
+static_assert(sizeof(state_stats_record_t) <= JOURNAL_VALUE_MAX, "state stats must fit one journal entry");
+
+static state_stats_record_t record;
+static uint16_t remainder_ms[AI_STATE_COUNT];
+static ai_state_t current = AI_STATE_IDLE;
+static uint32_t last_tick_ms = 0;
+static uint32_t last_save_ms = 0;
+static uint32_t saves = 0;
+static bool restored = false;
+static bool save_now = false;           // A reset waiting to be written
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void clear_record(void);
+static bool load_record(state_stats_record_t* stored);
+static void save_record(void);
+
+/**
+ * @brief Restore the saved figures and start timing a state (AI task)
+ */
+void ai_state_stats_init(ai_state_t initial, uint32_t now_ms) {
+    clear_record();
+
+    state_stats_record_t stored;
+    bool ok = load_record(&stored) && stored.magic == STATE_STATS_MAGIC &&
+              stored.version == STATE_STATS_VERSION;
+    portENTER_CRITICAL(&stats_mux);
+    if (ok) {
+        record = stored;
+        restored = true;
+    }
+    current = initial < AI_STATE_COUNT ? initial : AI_STATE_IDLE;
+    last_tick_ms = now_ms;
+    last_save_ms = now_ms;
+    portEXIT_CRITICAL(&stats_mux);
+
+    if (ok) {
+        uint32_t total_s = 0;
+        for (uint8_t i = 0; i < AI_STATE_COUNT; i++) {
+            total_s += stored.seconds[i];
+        }
+        LOGI(AI, "✅ State statistics restored: %luh tracked", total_s / 3600);
+    }
+}
+
+/**
+ * @brief Charge the time since the last tick to the state in force, count a transition (AI task)
+ */
+void ai_state_stats_tick(ai_state_t committed, uint32_t now_ms) {
+    if (committed >= AI_STATE_COUNT) {
+        return;
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    uint32_t elapsed_ms = remainder_ms[current] + (now_ms - last_tick_ms);
+    record.seconds[current] += elapsed_ms / 1000;
+    remainder_ms[current] = (uint16_t)(elapsed_ms % 1000);
+    last_tick_ms = now_ms;
+
+    if (committed != current) {
+        // Halve the whole matrix rather than saturate one cell, so the shares still hold
+        if (record.transitions[current][committed] == UINT16_MAX) {
+            for (uint8_t from = 0; from < AI_STATE_COUNT; from++) {
+                for (uint8_t to = 0; to < AI_STATE_COUNT; to++) {
+                    record.transitions[from][to] >>= 1;
+                }
+            }
+            record.halvings++;
+        }
+        record.transitions[current][committed]++;
+        record.entries[committed]++;
+        current = committed;
+    }
+    bool due = save_now || now_ms - last_save_ms >= AI_STATE_STATS_SAVE_INTERVAL_MS;
+    portEXIT_CRITICAL(&stats_mux);
+
+    if (due) {
+        save_record();
+        last_save_ms = now_ms;
+    }
+}
+
+/**
+ * @brief Copy the figures, the current stay included; any task
+ */
+void ai_state_stats_get(ai_state_stats_t* out) {
+    memset(out, 0, sizeof(*out));
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&stats_mux);
+    out->current = current;
+    memcpy(out->seconds, record.seconds, sizeof(out->seconds));
+    memcpy(out->entries, record.entries, sizeof(out->entries));
+    memcpy(out->transitions, record.transitions, sizeof(out->transitions));
+    out->seconds[current] += (remainder_ms[current] + (now - last_tick_ms)) / 1000;
+    out->halvings = record.halvings;
+    out->saves = saves;
+    out->restored = restored;
+    portEXIT_CRITICAL(&stats_mux);
+
+    for (uint8_t i = 0; i < AI_STATE_COUNT; i++) {
+        out->total_s += out->seconds[i];
+    }
+}
+
+/**
+ * @brief Zero the figures; any task. The AI task saves the empty set on its next tick.
+ */
+void ai_state_stats_reset(void) {
+    portENTER_CRITICAL(&stats_mux);
+    clear_record();
+    last_tick_ms = millis();
+    restored = false;
+    save_now = true;
+    portEXIT_CRITICAL(&stats_mux);
+    LOGI(AI, "🔄 State statistics reset");
+}
+
+/**
+ * @brief Write the record to the journal, else NVS
+ */
+static void save_record(void) {
+    static state_stats_record_t copy;       // Only the AI task saves
+
+    portENTER_CRITICAL(&stats_mux);
+    copy = record;
+    save_now = false;
+    portEXIT_CRITICAL(&stats_mux);
+
+    bool ok = journal_put(STATE_STATS_JOURNAL_KEY, &copy, sizeof(copy));
+    if (!ok) {
+        Preferences prefs;
+        if (prefs.begin(AI_STATE_STATS_NVS_NAMESPACE, false)) {
+            ok = prefs.putBytes("record", &copy, sizeof(copy)) == sizeof(copy);
+            prefs.end();
+        }
+    }
+    if (ok) {
+        portENTER_CRITICAL(&stats_mux);
+        saves++;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+}
+
+/**
+ * @brief Read the saved figures: the journal's, else NVS
+ */
+static bool load_record(state_stats_record_t* stored) {
+    if (journal_get(STATE_STATS_JOURNAL_KEY, stored, sizeof(*stored)) == sizeof(*stored)) {
+        return true;
+    }
+    Preferences prefs;
+    if (!prefs.begin(AI_STATE_STATS_NVS_NAMESPACE, true)) {
+        return false;
+    }
+    bool ok = prefs.getBytes("record", stored, sizeof(*stored)) == sizeof(*stored);
+    prefs.end();
+    return ok;
+}
+
+/**
+ * @brief Start the figures from zero; callers hold stats_mux or run before the AI task ticks
+ */
+static void clear_record(void) {
+    memset(&record, 0, sizeof(record));
+    memset(remainder_ms, 0, sizeof(remainder_ms));
+    record.magic = STATE_STATS_MAGIC;
+    record.version = STATE_STATS_VERSION;
+}
@@ -4,54 +4,31 @@
  */
 #include "ai_states.h"
 #include "config.h"
+#include "ai_rules.h"
+#include "profile.h"
 
 /**
  * @brief AI inference function to determine current state
+ *
+ * Evaluates the compiled rule set on one cycle's raw readings, with no
+ * history, no dwell time and the config.h thresholds - for host-side
+ * replay and tools.
  */
 ai_state_t infer_ai_state(const sensor_data_t* data) {
+    PROFILE_SCOPE(PROFILE_RULES);
     if (data == NULL) {
         return AI_STATE_ERROR;
     }
 
-    // Check for system error conditions first
-    if (data->free_memory < LOW_MEMORY_THRESHOLD) {
-        return AI_STATE_ERROR;
-    }
-
-    // High activity detection - WiFi networks
-    if (data->wifi_networks_count >= HIGH_WIFI_ACTIVITY_THRESHOLD) {
-        // Strong signals indicate close proximity activity
-        if (data->wifi_signal_strength > -40) {
-            return AI_STATE_EXCITED;
-        } else {
-            return AI_STATE_SNIFFING;
-        }
-    }
-
-    // BLE tracking mode - strong nearby devices
-    if (data->ble_devices_count > 5 && data->ble_signal_strength > STRONG_BLE_SIGNAL_THRESHOLD) {
-        return AI_STATE_TRACKING;
-    }
-
-    // Learning mode - moderate activity with recent interaction
-    if ((data->wifi_networks_count > 3 || data->ble_devices_count > 2) && 
-        data->user_interaction) {
-        return AI_STATE_LEARNING;
-    }
-
-    // Sleep mode - very low activity for extended time
-    if (data->wifi_networks_count == 0 && data->ble_devices_count == 0 && 
-        !data->user_interaction && data->uptime_seconds > 300) {
-        return AI_STATE_SLEEPING;
-    }
-
-    // System update mode
-    if (data->uptime_seconds < 60) {
-        return AI_STATE_UPDATING;
-    }
-
-    // Default idle state
-    return AI_STATE_IDLE;
+    ai_rule_input_t in;
+    in.data = data;
+    in.wifi_networks = data->wifi_networks_count;
+    in.ble_devices = data->ble_devices_count;
+    in.wifi_high = HIGH_WIFI_ACTIVITY_THRESHOLD;
+    in.excitement = 0;
+    in.current = AI_STATE_IDLE;
+    in.state_duration_ms = 0;
+    return ai_rules_t::evaluate(in);
 }
 
 /**
@@ -0,0 +1,162 @@
+/**
+ * @file ai_telemetry.cpp
+ * @brief Decision latency histogram and model margin statistics
+ *
+ * Latencies go into log-spaced bins, AI_TELEMETRY_SUBBINS per octave, so a
+ * few hundred bytes cover everything from a microsecond rule evaluation to
+ * a quarter-second model with bounded relative error. Written by the AI
+ * task, read by the UI and the HTTP server.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "ai_telemetry.h"
+
+#define AI_TELEMETRY_SUBBIN_BITS 2
+#define AI_TELEMETRY_SUBBINS     (1 << AI_TELEMETRY_SUBBIN_BITS)
+static_assert(AI_TELEMETRY_SUBBINS == 4, "AI_TELEMETRY_OCTAVES assumes 4 bins per octave");
+
+static uint32_t bins[AI_TELEMETRY_BINS];
+static uint64_t total_us = 0;
+static double margin_sum = 0.0;
+static ai_telemetry_t telemetry;
+static portMUX_TYPE telemetry_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static uint8_t bin_of(uint32_t us);
+static uint32_t bin_upper_us(uint8_t bin);
+static uint32_t quantile_us(uint32_t count, uint8_t percent);
+
+/**
+ * @brief Clear all counters, e.g. when a new model takes over
+ */
+void ai_telemetry_reset(void) {
+    portENTER_CRITICAL(&telemetry_lock);
+    memset(bins, 0, sizeof(bins));
+    memset(&telemetry, 0, sizeof(telemetry));
+    total_us = 0;
+    margin_sum = 0.0;
+    telemetry.min_us = UINT32_MAX;
+    telemetry.last_margin = -1.0f;
+    telemetry.min_margin = 1.0f;
+    portEXIT_CRITICAL(&telemetry_lock);
+}
+
+/**
+ * @brief Record one decision
+ */
+void ai_telemetry_record(uint32_t latency_us, bool model_decided, float margin) {
+    portENTER_CRITICAL(&telemetry_lock);
+    bins[bin_of(latency_us)]++;
+    total_us += latency_us;
+    telemetry.decisions++;
+    if (model_decided) {
+        telemetry.model_decisions++;
+    } else {
+        telemetry.rule_decisions++;
+    }
+    telemetry.last_us = latency_us;
+    telemetry.min_us = min(telemetry.min_us, latency_us);
+    telemetry.max_us = max(telemetry.max_us, latency_us);
+
+    telemetry.last_margin = margin;
+    if (margin >= 0.0f) {
+        telemetry.margins++;
+        margin_sum += margin;
+        telemetry.min_margin = min(telemetry.min_margin, margin);
+        if (margin < AI_TELEMETRY_NARROW_MARGIN) {
+            telemetry.narrow_margins++;
+        }
+    }
+    portEXIT_CRITICAL(&telemetry_lock);
+}
+
+/**
+ * @brief Copy the current figures, quantiles estimated from the latency histogram
+ */
+void ai_telemetry_get(ai_telemetry_t* out) {
+    portENTER_CRITICAL(&telemetry_lock);
+    *out = telemetry;
+    uint32_t count = telemetry.decisions;
+    out->avg_us = count > 0 ? (uint32_t)(total_us / count) : 0;
+    out->mean_margin = telemetry.margins > 0 ? (float)(margin_sum / telemetry.margins) : 0.0f;
+    out->p50_us = quantile_us(count, 50);
+    out->p99_us = quantile_us(count, 99);
+    portEXIT_CRITICAL(&telemetry_lock);
+
+    if (count == 0) {
+        out->min_us = 0;
+    }
+    if (out->margins == 0) {
+        out->min_margin = 0.0f;
+    }
+    // A bin edge can overshoot the largest value actually seen
+    out->p50_us = min(out->p50_us, out->max_us);
+    out->p99_us = min(out->p99_us, out->max_us);
+}
+
+/**
+ * @brief Cumulative decision counts at each octave edge, for histogram export
+ */
+uint32_t ai_telemetry_get_octaves(uint32_t* cumulative, uint64_t* sum_us) {
+    portENTER_CRITICAL(&telemetry_lock);
+    uint32_t seen = 0;
+    uint8_t octave = 0;
+    for (uint8_t i = 0; i < AI_TELEMETRY_BINS && octave < AI_TELEMETRY_OCTAVES; i++) {
+        seen += bins[i];
+        if (i % AI_TELEMETRY_SUBBINS == AI_TELEMETRY_SUBBINS - 1) {
+            cumulative[octave++] = seen;    // Bin i ends at 4 << octave us
+        }
+    }
+    *sum_us = total_us;
+    uint32_t count = telemetry.decisions;
+    portEXIT_CRITICAL(&telemetry_lock);
+    return count;
+}
+
+/**
+ * @brief Bin index: exact below AI_TELEMETRY_SUBBINS us, then SUBBINS per octave
+ */
+static uint8_t bin_of(uint32_t us) {
+    if (us < AI_TELEMETRY_SUBBINS) {
+        return (uint8_t)us;
+    }
+    uint8_t octave = 31 - __builtin_clz(us);
+    uint8_t sub = (us >> (octave - AI_TELEMETRY_SUBBIN_BITS)) & (AI_TELEMETRY_SUBBINS - 1);
+    uint32_t bin = (octave - AI_TELEMETRY_SUBBIN_BITS + 1) * AI_TELEMETRY_SUBBINS + sub;
+    return (uint8_t)min(bin, (uint32_t)(AI_TELEMETRY_BINS - 1));
+}
+
+/**
+ * @brief Smallest latency above every value in a bin
+ */
+static uint32_t bin_upper_us(uint8_t bin) {
+    if (bin < AI_TELEMETRY_SUBBINS) {
+        return bin + 1;
+    }
+    if (bin == AI_TELEMETRY_BINS - 1) {
+        return UINT32_MAX;          // Overflow bin; callers clamp to max_us
+    }
+    uint8_t shift = bin / AI_TELEMETRY_SUBBINS - 1;
+    uint32_t lower = (uint32_t)(AI_TELEMETRY_SUBBINS + bin % AI_TELEMETRY_SUBBINS) << shift;
+    return lower + (1UL << shift);
+}
+
+/**
+ * @brief Walk the histogram to the bin holding the given quantile (lock held)
+ */
+static uint32_t quantile_us(uint32_t count, uint8_t percent) {
+    if (count == 0) {
+        return 0;
+    }
+    uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < AI_TELEMETRY_BINS; i++) {
+        seen += bins[i];
+        if (seen >= rank) {
+            return bin_upper_us(i);
+        }
+    }
+    return UINT32_MAX;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file ai_transition.cpp
+ * @brief Hysteresis and dwell filter between state inference and its consumers
+ *
+ * Inference runs on every scan event and re-evaluates near its thresholds,
+ * so raw proposals flip back and forth. Only committed transitions reach
+ * the UI queue, the scan profile and the log.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_transition.h"
+
+// Minimum dwell per state, indexed by ai_state_t; 0 leaves at once
+static const uint32_t dwell_ms[AI_STATE_COUNT] = {
+    AI_DWELL_IDLE_MS,
+    AI_DWELL_SNIFFING_MS,
+    AI_DWELL_TRACKING_MS,
+    AI_DWELL_LEARNING_MS,
+    AI_DWELL_EXCITED_MS,
+    AI_DWELL_SLEEPING_MS,
+    0,                      // ERROR
+    0                       // UPDATING
+};
+
+static float evidence[AI_STATE_COUNT];
+static ai_transition_stats_t stats;
+
+// Forward declarations
+static bool is_urgent(ai_state_t state);
+static void commit(ai_state_t state, uint32_t now_ms);
+
+/**
+ * @brief Start the filter in a committed state
+ */
+void ai_transition_init(ai_state_t initial, uint32_t now_ms) {
+    memset(evidence, 0, sizeof(evidence));
+    memset(&stats, 0, sizeof(stats));
+    evidence[initial] = 1.0f;
+    stats.committed = initial;
+    stats.confidence = 1.0f;
+    stats.entered_ms = now_ms;
+}
+
+/**
+ * @brief Feed one proposal from the inference stage
+ */
+bool ai_transition_update(ai_state_t proposed, float confidence, uint32_t now_ms,
+                          ai_state_t* committed) {
+    if (proposed >= AI_STATE_COUNT) {
+        return false;
+    }
+    confidence = constrain(confidence, 0.0f, 1.0f);
+    stats.proposals++;
+
+    for (uint8_t s = 0; s < AI_STATE_COUNT; s++) {
+        float target = s == proposed ? confidence : 0.0f;
+        evidence[s] += AI_TRANSITION_ALPHA * (target - evidence[s]);
+    }
+
+    ai_state_t current = stats.committed;
+    if (proposed == current) {
+        stats.confidence = evidence[current];
+        return false;
+    }
+
+    bool dwelled = now_ms - stats.entered_ms >= dwell_ms[current];
+    bool entered = evidence[proposed] >= AI_TRANSITION_ENTER;
+    bool exited = evidence[current] <= AI_TRANSITION_EXIT;
+
+    // Faults and updates must show up now, and are left as soon as they clear
+    if (is_urgent(proposed) || (dwelled && entered && exited) ||
+        (is_urgent(current) && entered)) {
+        commit(proposed, now_ms);
+        *committed = proposed;
+        return true;
+    }
+
+    stats.confidence = evidence[current];
+    stats.suppressed++;
+    return false;
+}
+
+/**
+ * @brief Copy the filter statistics
+ */
+void ai_transition_get_stats(ai_transition_stats_t* out) {
+    if (out != NULL) {
+        *out = stats;
+    }
+}
+
+/**
+ * @brief States that bypass dwell and hysteresis on entry
+ */
+static bool is_urgent(ai_state_t state) {
+    return state == AI_STATE_ERROR || state == AI_STATE_UPDATING;
+}
+
+/**
+ * @brief Make a state current
+ */
+static void commit(ai_state_t state, uint32_t now_ms) {
+    // Urgent entries skip accumulation; lift them to the entry level so
+    // the next different proposal does not commit straight away
+    if (evidence[state] < AI_TRANSITION_ENTER) {
+        evidence[state] = AI_TRANSITION_ENTER;
+    }
+    stats.committed = state;
+    stats.confidence = evidence[state];
+    stats.entered_ms = now_ms;
+    stats.transitions++;
+}
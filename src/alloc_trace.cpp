@@ -0,0 +1,446 @@
+/**
+ * @file alloc_trace.cpp
+ * @brief Heap allocations made inside the hot loops, by body and call site
+ *
+ * A tracing build links with --wrap for malloc, calloc, realloc and free
+ * (see env:alloc), so every request the Arduino core, libstdc++ and the
+ * BLE and Wi-Fi glue send through the C heap passes here first. A task
+ * opens a body with alloc_trace_begin(); while it is open, its own
+ * allocations are counted against that body and against their call site,
+ * the innermost return addresses above the allocator. Each one is also
+ * kept in a live table by address, so its free - on whichever task - adds
+ * to the site's lifetime. Tables are fixed and internal, since the hooks
+ * may not allocate. The failed-allocation callback is registered in every
+ * build and covers heap_caps_* requests too.
+ */
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <esp_debug_helpers.h>
+#include "config.h"
+#include "alloc_trace.h"
+
+static const char* const cycle_names[ALLOC_CYCLE_COUNT] = {
+    "ui", "ai", "scan", "system", "capture", "ble.advert"
+};
+
+static alloc_failure_stats_t failures;
+static portMUX_TYPE failure_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void on_failed_alloc(size_t size, uint32_t caps, const char* function_name);
+static uint16_t sites_seen(void);
+
+#if ALLOC_TRACE_ENABLED
+static_assert((ALLOC_TRACE_SITES & (ALLOC_TRACE_SITES - 1)) == 0,
+              "ALLOC_TRACE_SITES must be a power of two");
+
+#define ALLOC_TRACE_LIVE        (1u << ALLOC_TRACE_LIVE_BITS)
+#define ALLOC_TRACE_SKIP_FRAMES 1       // The __wrap_ entry above note_alloc()
+
+typedef struct {
+    alloc_cycle_stats_t stats;
+    TaskHandle_t        task;           // Task with the body open, NULL between bodies
+    uint32_t            allocs;         // In the open body
+    uint32_t            bytes;
+    uint32_t            clean_streak;
+} cycle_state_t;
+
+typedef struct {
+    void*    ptr;                       // NULL for a free slot
+    uint16_t site;                      // ALLOC_TRACE_SITES if the site was dropped
+    uint32_t at_us;
+} live_entry_t;
+
+static cycle_state_t cycles[ALLOC_CYCLE_COUNT];
+static volatile uint8_t open_bodies = 0;
+static alloc_site_stats_t sites[ALLOC_TRACE_SITES];
+static uint16_t site_order[ALLOC_TRACE_SITES];      // Slots in the order first seen
+static uint16_t site_count = 0;
+static live_entry_t live[ALLOC_TRACE_LIVE];
+static uint32_t dropped = 0;
+static portMUX_TYPE trace_mux = portMUX_INITIALIZER_UNLOCKED;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void  __real_free(void* ptr);
+}
+
+// Forward declarations
+static void __attribute__((noinline)) note_alloc(void* ptr, size_t size);
+static void note_free(void* ptr);
+static uint16_t find_site(const uint32_t* pcs, uint8_t cycle);
+static void live_remove(uint32_t index);
+static inline uint32_t hash_ptr(const void* ptr);
+
+extern "C" void* __wrap_malloc(size_t size) {
+    void* ptr = __real_malloc(size);
+    note_alloc(ptr, size);
+    return ptr;
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t size) {
+    void* ptr = __real_calloc(count, size);
+    note_alloc(ptr, count * size);
+    return ptr;
+}
+
+// A String or vector growing in place still asked the heap, so it counts
+extern "C" void* __wrap_realloc(void* old, size_t size) {
+    void* ptr = __real_realloc(old, size);
+    if (ptr != NULL || size == 0) {
+        note_free(old);
+    }
+    note_alloc(ptr, size);
+    return ptr;
+}
+
+extern "C" void __wrap_free(void* ptr) {
+    note_free(ptr);
+    __real_free(ptr);
+}
+#endif
+
+/**
+ * @brief Register the failed-allocation callback
+ */
+void alloc_trace_init(void) {
+    heap_caps_register_failed_alloc_callback(on_failed_alloc);
+}
+
+/**
+ * @brief Attribute the calling task's allocations to a body until alloc_trace_end()
+ */
+void alloc_trace_begin(alloc_cycle_t cycle) {
+#if ALLOC_TRACE_ENABLED
+    cycle_state_t* state = &cycles[cycle];
+    portENTER_CRITICAL(&trace_mux);
+    if (state->task == NULL) {
+        open_bodies++;
+    }
+    state->task = xTaskGetCurrentTaskHandle();
+    state->allocs = 0;
+    state->bytes = 0;
+    portEXIT_CRITICAL(&trace_mux);
+#endif
+}
+
+/**
+ * @brief Close a body opened by the same task and fold its counts in
+ */
+void alloc_trace_end(alloc_cycle_t cycle) {
+#if ALLOC_TRACE_ENABLED
+    cycle_state_t* state = &cycles[cycle];
+    portENTER_CRITICAL(&trace_mux);
+    if (state->task != xTaskGetCurrentTaskHandle()) {
+        portEXIT_CRITICAL(&trace_mux);
+        return;
+    }
+    state->task = NULL;
+    open_bodies--;
+
+    alloc_cycle_stats_t* stats = &state->stats;
+    stats->cycles++;
+    stats->last_allocs = state->allocs;
+    stats->last_bytes = state->bytes;
+    stats->max_allocs = max(stats->max_allocs, state->allocs);
+    if (state->allocs == 0) {
+        stats->clean_cycles++;
+        state->clean_streak++;
+    } else {
+        if (state->clean_streak >= ALLOC_TRACE_CLEAN_STREAK) {
+            stats->regressions++;
+        }
+        state->clean_streak = 0;
+    }
+    portEXIT_CRITICAL(&trace_mux);
+#endif
+}
+
+/**
+ * @brief Copy one body's figures
+ */
+void alloc_trace_get_cycle(alloc_cycle_t cycle, alloc_cycle_stats_t* stats) {
+#if ALLOC_TRACE_ENABLED
+    portENTER_CRITICAL(&trace_mux);
+    *stats = cycles[cycle].stats;
+    portEXIT_CRITICAL(&trace_mux);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+    stats->name = cycle_names[cycle];
+}
+
+/**
+ * @brief Copy one call site, in the order they were first seen
+ */
+bool alloc_trace_get_site(uint16_t index, alloc_site_stats_t* stats) {
+#if ALLOC_TRACE_ENABLED
+    bool found = false;
+    portENTER_CRITICAL(&trace_mux);
+    if (index < site_count) {
+        *stats = sites[site_order[index]];
+        found = true;
+    }
+    portEXIT_CRITICAL(&trace_mux);
+    return found;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Allocations that found no free site or live slot
+ */
+uint32_t alloc_trace_dropped(void) {
+#if ALLOC_TRACE_ENABLED
+    return dropped;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Copy the failed-allocation counts
+ */
+void alloc_trace_get_failures(alloc_failure_stats_t* stats) {
+    portENTER_CRITICAL(&failure_mux);
+    *stats = failures;
+    portEXIT_CRITICAL(&failure_mux);
+}
+
+/**
+ * @brief Clear bodies and sites
+ */
+void alloc_trace_reset(void) {
+#if ALLOC_TRACE_ENABLED
+    portENTER_CRITICAL(&trace_mux);
+    for (uint8_t c = 0; c < ALLOC_CYCLE_COUNT; c++) {
+        memset(&cycles[c].stats, 0, sizeof(cycles[c].stats));
+        cycles[c].clean_streak = 0;
+    }
+    memset(sites, 0, sizeof(sites));
+    memset(live, 0, sizeof(live));
+    site_count = 0;
+    dropped = 0;
+    portEXIT_CRITICAL(&trace_mux);
+#endif
+}
+
+/**
+ * @brief Write one line of the report: bodies, then sites, then drops and failures
+ */
+size_t alloc_trace_write_line(uint16_t line, char* out, size_t capacity) {
+    int n = 0;
+    if (line == 0) {
+        n = snprintf(out, capacity, "%-12s %10s %10s %10s %12s %6s %8s %6s %6s",
+                     "body", "cycles", "clean", "allocs", "bytes", "last", "last_b", "max", "regr");
+    } else if (line <= ALLOC_CYCLE_COUNT) {
+        alloc_cycle_stats_t c;
+        alloc_trace_get_cycle((alloc_cycle_t)(line - 1), &c);
+        n = snprintf(out, capacity, "%-12s %10lu %10lu %10lu %12llu %6lu %8lu %6lu %6lu",
+                     c.name, c.cycles, c.clean_cycles, c.allocs, c.bytes,
+                     c.last_allocs, c.last_bytes, c.max_allocs, c.regressions);
+    } else if (line == ALLOC_CYCLE_COUNT + 1) {
+        n = snprintf(out, capacity, "%-12s %10s %12s %10s %10s %10s  %s",
+                     "site.body", "allocs", "bytes", "freed", "avg_us", "max_us", "pcs");
+    } else {
+        alloc_site_stats_t site;
+        uint16_t index = line - ALLOC_CYCLE_COUNT - 2;
+        if (alloc_trace_get_site(index, &site)) {
+            n = snprintf(out, capacity, "%-12s %10lu %12llu %10lu %10lu %10lu ",
+                         cycle_names[site.cycle], site.allocs, site.bytes, site.frees,
+                         site.frees > 0 ? (uint32_t)(site.lifetime_us / site.frees) : 0UL,
+                         site.max_lifetime_us);
+            for (uint8_t d = 0; d < ALLOC_TRACE_DEPTH && site.pcs[d] != 0 && n > 0 && (size_t)n < capacity; d++) {
+                n += snprintf(out + n, capacity - n, " 0x%08lx", site.pcs[d]);
+            }
+        } else if (index == sites_seen()) {
+            alloc_failure_stats_t f;
+            alloc_trace_get_failures(&f);
+            n = snprintf(out, capacity, "dropped %lu, failed %lu (largest %lu bytes; last %lu bytes, caps 0x%lx, %s)",
+                         alloc_trace_dropped(), f.failures, f.largest_failed, f.last_size,
+                         f.last_caps, f.last_function != NULL ? f.last_function : "-");
+        }
+    }
+    return n > 0 ? min((size_t)n, capacity - 1) : 0;
+}
+
+/**
+ * @brief Write the same text to the serial port as "ALLOC" lines
+ */
+void alloc_trace_dump_serial(void) {
+    char text[ALLOC_TRACE_LINE_BYTES];
+    for (uint16_t line = 0; alloc_trace_write_line(line, text, sizeof(text)) > 0; line++) {
+        Serial.printf("ALLOC %s\n", text);
+    }
+}
+
+/**
+ * @brief Count a request the heap could not meet; runs inside the allocator, so no logging
+ */
+static void on_failed_alloc(size_t size, uint32_t caps, const char* function_name) {
+    portENTER_CRITICAL_SAFE(&failure_mux);
+    failures.failures++;
+    failures.last_size = size;
+    failures.last_caps = caps;
+    failures.last_function = function_name;
+    failures.largest_failed = max(failures.largest_failed, (uint32_t)size);
+    portEXIT_CRITICAL_SAFE(&failure_mux);
+}
+
+/**
+ * @brief Call sites in the table, 0 without tracing
+ */
+static uint16_t sites_seen(void) {
+#if ALLOC_TRACE_ENABLED
+    return site_count;
+#else
+    return 0;
+#endif
+}
+
+#if ALLOC_TRACE_ENABLED
+/**
+ * @brief Count an allocation if the calling task has a body open
+ *
+ * The walk up the stack happens before the lock. It starts in this
+ * function and skips the __wrap_ entry, so the first address recorded is
+ * in whatever called malloc: operator new, String, a C library.
+ */
+static void __attribute__((noinline)) note_alloc(void* ptr, size_t size) {
+    if (ptr == NULL || open_bodies == 0) {
+        return;
+    }
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    uint8_t cycle = 0;
+    while (cycle < ALLOC_CYCLE_COUNT && cycles[cycle].task != task) {
+        cycle++;
+    }
+    if (cycle == ALLOC_CYCLE_COUNT) {
+        return;
+    }
+
+    uint32_t pcs[ALLOC_TRACE_DEPTH] = {0};
+    esp_backtrace_frame_t frame;
+    esp_backtrace_get_start(&frame.pc, &frame.sp, &frame.next_pc);
+    for (uint8_t depth = 0; depth < ALLOC_TRACE_SKIP_FRAMES + ALLOC_TRACE_DEPTH && frame.next_pc != 0; depth++) {
+        if (!esp_backtrace_get_next_frame(&frame)) {
+            break;
+        }
+        if (depth >= ALLOC_TRACE_SKIP_FRAMES) {
+            // Windowed calls keep the window increment in the top two bits
+            pcs[depth - ALLOC_TRACE_SKIP_FRAMES] = (frame.pc & 0x3FFFFFFF) | 0x40000000;
+        }
+    }
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+
+    portENTER_CRITICAL(&trace_mux);
+    cycle_state_t* state = &cycles[cycle];
+    if (state->task == task) {
+        state->allocs++;
+        state->bytes += size;
+        state->stats.allocs++;
+        state->stats.bytes += size;
+
+        uint16_t site = find_site(pcs, cycle);
+        if (site < ALLOC_TRACE_SITES) {
+            sites[site].allocs++;
+            sites[site].bytes += size;
+        }
+        uint32_t index = hash_ptr(ptr);
+        uint32_t probes = 0;
+        while (live[index].ptr != NULL && probes < ALLOC_TRACE_LIVE / 2) {
+            index = (index + 1) & (ALLOC_TRACE_LIVE - 1);
+            probes++;
+        }
+        if (live[index].ptr == NULL && site < ALLOC_TRACE_SITES) {
+            live[index].ptr = ptr;
+            live[index].site = site;
+            live[index].at_us = now_us;
+        } else {
+            dropped++;
+        }
+    }
+    portEXIT_CRITICAL(&trace_mux);
+}
+
+/**
+ * @brief Close the lifetime of a traced allocation; others are not in the table
+ */
+static void note_free(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+    portENTER_CRITICAL(&trace_mux);
+    uint32_t index = hash_ptr(ptr);
+    for (uint32_t probes = 0; live[index].ptr != NULL && probes < ALLOC_TRACE_LIVE / 2; probes++) {
+        if (live[index].ptr == ptr) {
+            alloc_site_stats_t* site = &sites[live[index].site];
+            uint32_t lifetime = now_us - live[index].at_us;
+            site->frees++;
+            site->lifetime_us += lifetime;
+            site->max_lifetime_us = max(site->max_lifetime_us, lifetime);
+            live_remove(index);
+            break;
+        }
+        index = (index + 1) & (ALLOC_TRACE_LIVE - 1);
+    }
+    portEXIT_CRITICAL(&trace_mux);
+}
+
+/**
+ * @brief Slot of a call site in one body, claimed if new; ALLOC_TRACE_SITES when full
+ */
+static uint16_t find_site(const uint32_t* pcs, uint8_t cycle) {
+    uint32_t hash = cycle * 0x9E3779B1u;
+    for (uint8_t d = 0; d < ALLOC_TRACE_DEPTH; d++) {
+        hash = (hash ^ pcs[d]) * 0x01000193u;
+    }
+    uint16_t index = (uint16_t)(hash & (ALLOC_TRACE_SITES - 1));
+    for (uint16_t probes = 0; probes < ALLOC_TRACE_SITES; probes++) {
+        alloc_site_stats_t* site = &sites[index];
+        if (site->allocs == 0) {
+            if (site_count >= ALLOC_TRACE_SITES) {
+                break;
+            }
+            memcpy(site->pcs, pcs, sizeof(site->pcs));
+            site->cycle = cycle;
+            site_order[site_count++] = index;
+            return index;
+        }
+        if (site->cycle == cycle && memcmp(site->pcs, pcs, sizeof(site->pcs)) == 0) {
+            return index;
+        }
+        index = (index + 1) & (ALLOC_TRACE_SITES - 1);
+    }
+    return ALLOC_TRACE_SITES;
+}
+
+/**
+ * @brief Empty a live slot and pull later entries of its run back (no tombstones)
+ */
+static void live_remove(uint32_t index) {
+    uint32_t hole = index;
+    uint32_t next = (hole + 1) & (ALLOC_TRACE_LIVE - 1);
+    while (live[next].ptr != NULL) {
+        uint32_t home = hash_ptr(live[next].ptr);
+        // Move next into the hole unless its home lies cyclically in (hole, next]
+        bool stays = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (!stays) {
+            live[hole] = live[next];
+            hole = next;
+        }
+        next = (next + 1) & (ALLOC_TRACE_LIVE - 1);
+    }
+    live[hole].ptr = NULL;
+}
+
+static inline uint32_t hash_ptr(const void* ptr) {
+    return (((uint32_t)(uintptr_t)ptr >> 3) * 0x9E3779B1u) >> (32 - ALLOC_TRACE_LIVE_BITS);
+}
+#endif
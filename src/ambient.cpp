@@ -0,0 +1,174 @@
+/**
+ * @file ambient.cpp
+ * @brief Ambient light from the I2C light sensor, for the backlight and the night profile
+ *
+ * A BH1750 reading jumps when a hand or a shadow passes, so everything
+ * here follows an EWMA of the readings, and even that is only applied once
+ * it has moved AMBIENT_CHANGE_PCT from the value last applied: a steady
+ * room costs no fades and no level changes. The applied lux scales the
+ * backlight on a log scale, from AMBIENT_DARK_BACKLIGHT_PCT in the dark to
+ * full at AMBIENT_BRIGHT_LUX, since the eye judges a screen against the
+ * room around it. In the dark the night profile also caps the frame rate.
+ * Levels are left AMBIENT_HYSTERESIS_PCT past their threshold, so a lamp
+ * at the edge does not flap between them.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include "config.h"
+#include "ambient.h"
+#include "data_bus.h"
+#include "i2c_sensors.h"
+#include "logger.h"
+
+static const char* const level_names[AMBIENT_LEVELS] = { "unknown", "dark", "dim", "bright" };
+
+static ambient_status_t status = { 0, 0, 0, AMBIENT_UNKNOWN, 100, 0, 0, 0 };
+static volatile ambient_level_t level = AMBIENT_UNKNOWN;
+static volatile uint8_t backlight_pct = 100;
+static uint32_t last_read_ms = 0;
+static bool sampled = false;
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static ambient_level_t next_level(ambient_level_t current, uint16_t lux);
+static uint8_t scale_for(uint16_t lux);
+static void apply(ambient_level_t new_level, uint16_t lux);
+
+/**
+ * @brief Fold the light sensor's latest reading in and adapt to it
+ */
+void ambient_sample(uint32_t now_ms) {
+#if AMBIENT_ENABLED
+    i2c_publication_t i2c;
+    data_bus_read(BUS_TOPIC_I2C, &i2c, 0, sizeof(i2c));
+    if ((i2c.fresh & (1 << I2C_SENSOR_LIGHT)) == 0) {
+        if (level != AMBIENT_UNKNOWN) {
+            LOGW(SYSTEM, "⚠️  Ambient light reading stale - backlight back to full scale");
+            sampled = false;
+            apply(AMBIENT_UNKNOWN, 0);
+        }
+        return;
+    }
+
+    // The topic is republished for every sensor; fold each light reading once
+    i2c_sensor_stats_t light;
+    i2c_sensors_get_stats(I2C_SENSOR_LIGHT, &light);
+    if (sampled && light.last_read_ms == last_read_ms) {
+        return;
+    }
+    last_read_ms = light.last_read_ms;
+
+    float lux = sampled ? status.lux + AMBIENT_EWMA_ALPHA * (i2c.light_lux - status.lux) : i2c.light_lux;
+    uint16_t applied = status.applied_lux;
+    uint32_t threshold = max((uint32_t)applied * AMBIENT_CHANGE_PCT / 100, (uint32_t)AMBIENT_CHANGE_MIN_LUX);
+    bool significant = !sampled || fabsf(lux - applied) >= threshold;
+    sampled = true;
+
+    portENTER_CRITICAL(&status_mux);
+    status.lux = lux;
+    status.raw_lux = i2c.light_lux;
+    portEXIT_CRITICAL(&status_mux);
+
+    if (significant) {
+        uint16_t rounded = (uint16_t)lroundf(lux);
+        apply(next_level(level, rounded), rounded);
+    }
+#endif
+}
+
+/**
+ * @brief Light level in force
+ */
+ambient_level_t ambient_level(void) {
+    return level;
+}
+
+/**
+ * @brief Scale on the backlight target
+ */
+uint8_t ambient_backlight_pct(void) {
+    return backlight_pct;
+}
+
+/**
+ * @brief Shortest gap between UI frames
+ */
+uint32_t ambient_frame_interval_ms(void) {
+    return level == AMBIENT_DARK ? AMBIENT_NIGHT_FRAME_MS : 0;
+}
+
+/**
+ * @brief Copy the filtered light and its effects
+ */
+void ambient_get_status(ambient_status_t* out) {
+    portENTER_CRITICAL(&status_mux);
+    *out = status;
+    portEXIT_CRITICAL(&status_mux);
+}
+
+/**
+ * @brief Short name for logs
+ */
+const char* ambient_level_name(ambient_level_t l) {
+    return l < AMBIENT_LEVELS ? level_names[l] : "?";
+}
+
+/**
+ * @brief Level for a lux value, keeping the current one inside its hysteresis band
+ */
+static ambient_level_t next_level(ambient_level_t current, uint16_t lux) {
+    uint32_t dark_exit = (uint32_t)AMBIENT_DARK_LUX * (100 + AMBIENT_HYSTERESIS_PCT) / 100;
+    uint32_t bright_exit = (uint32_t)AMBIENT_BRIGHT_LUX * 100 / (100 + AMBIENT_HYSTERESIS_PCT);
+
+    if (current == AMBIENT_DARK && lux <= dark_exit) {
+        return AMBIENT_DARK;
+    }
+    if (current == AMBIENT_BRIGHT && lux >= bright_exit) {
+        return AMBIENT_BRIGHT;
+    }
+    if (lux < AMBIENT_DARK_LUX) {
+        return AMBIENT_DARK;
+    }
+    return lux > AMBIENT_BRIGHT_LUX ? AMBIENT_BRIGHT : AMBIENT_DIM;
+}
+
+/**
+ * @brief Backlight scale, log-linear between the dark and bright thresholds
+ */
+static uint8_t scale_for(uint16_t lux) {
+    if (lux <= AMBIENT_DARK_LUX) {
+        return AMBIENT_DARK_BACKLIGHT_PCT;
+    }
+    if (lux >= AMBIENT_BRIGHT_LUX) {
+        return 100;
+    }
+    float position = logf((float)lux / AMBIENT_DARK_LUX) / logf((float)AMBIENT_BRIGHT_LUX / AMBIENT_DARK_LUX);
+    return (uint8_t)(AMBIENT_DARK_BACKLIGHT_PCT + position * (100 - AMBIENT_DARK_BACKLIGHT_PCT) + 0.5f);
+}
+
+/**
+ * @brief Put a level and lux in force
+ */
+static void apply(ambient_level_t new_level, uint16_t lux) {
+    uint8_t pct = new_level == AMBIENT_UNKNOWN ? 100 : scale_for(lux);
+    ambient_level_t old_level = level;
+
+    portENTER_CRITICAL(&status_mux);
+    status.applied_lux = lux;
+    status.backlight_pct = pct;
+    status.level = new_level;
+    status.frame_interval_ms = new_level == AMBIENT_DARK ? AMBIENT_NIGHT_FRAME_MS : 0;
+    status.updates++;
+    if (new_level != old_level) {
+        status.level_changes++;
+    }
+    portEXIT_CRITICAL(&status_mux);
+
+    backlight_pct = pct;
+    level = new_level;
+    if (new_level != old_level) {
+        LOGI(SYSTEM, "💡 Ambient light %s (%u lx): backlight at %u%% of target%s",
+             level_names[new_level], lux, pct, new_level == AMBIENT_DARK ? ", night frame cap" : "");
+    }
+}
@@ -0,0 +1,172 @@
+/**
+ * @file asset_store.cpp
+ * @brief Read-only assets mapped from a raw data partition
+ *
+ * The partition starts with a header and a table of contents written by
+ * tools/assets/pack_assets.py. The table is read once; the assets behind
+ * it are mapped into the data address space with one esp_partition_mmap()
+ * and handed out as pointers, so a model or an image is used where it
+ * sits in flash, through the cache, rather than copied into the heap.
+ * The mapping is never undone.
+ */
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include "config.h"
+#include "asset_store.h"
+#include "logger.h"
+
+#define CHECK_UNKNOWN 0
+#define CHECK_PASSED  1
+#define CHECK_FAILED  2
+
+static asset_entry_t toc[ASSET_MAX_ENTRIES];
+static uint8_t checked[ASSET_MAX_ENTRIES];
+static const uint8_t* base = NULL;              // Partition offset 0 in the address space
+static spi_flash_mmap_handle_t mapping;
+static asset_store_stats_t stats = {0};
+static portMUX_TYPE store_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static bool read_toc(const esp_partition_t* partition, uint32_t* end);
+
+/**
+ * @brief Read the table of contents and map the partition's assets
+ */
+bool asset_store_init(void) {
+    if (base != NULL) {
+        return true;
+    }
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                (esp_partition_subtype_t)ASSET_PARTITION_SUBTYPE,
+                                                                ASSET_PARTITION_LABEL);
+    if (partition == NULL) {
+        LOGW(SYSTEM, "⚠️  No asset partition - assets load from the file system");
+        return false;
+    }
+
+    uint32_t end = 0;
+    if (!read_toc(partition, &end)) {
+        return false;
+    }
+
+    // Only as far as the last asset: the MMU pages are shared with the program
+    const void* mapped = NULL;
+    if (esp_partition_mmap(partition, 0, end, SPI_FLASH_MMAP_DATA, &mapped, &mapping) != ESP_OK) {
+        LOGE(SYSTEM, "❌ Asset partition mmap of %lu KB failed", end / 1024);
+        return false;
+    }
+    base = (const uint8_t*)mapped;
+    memset(checked, CHECK_UNKNOWN, sizeof(checked));
+    stats.mapped = true;
+    stats.mapped_bytes = end;
+    LOGI(SYSTEM, "✅ %u assets mapped, %lu KB", stats.count, end / 1024);
+    return true;
+}
+
+/**
+ * @brief Find an asset by name; its CRC is checked on the first lookup
+ */
+bool asset_store_find(const char* name, asset_t* asset) {
+    if (base == NULL) {
+        return false;
+    }
+    for (uint16_t i = 0; i < stats.count; i++) {
+        const asset_entry_t* entry = &toc[i];
+        if (strncmp(entry->name, name, ASSET_NAME_BYTES) != 0) {
+            continue;
+        }
+
+        portENTER_CRITICAL(&store_mux);
+        stats.lookups++;
+        uint8_t check = checked[i];
+        portEXIT_CRITICAL(&store_mux);
+        if (check == CHECK_UNKNOWN) {
+            // Read through the cache once; two tasks racing here both get the same answer
+            bool ok = esp_rom_crc32_le(0, base + entry->offset, entry->length) == entry->crc32;
+            check = ok ? CHECK_PASSED : CHECK_FAILED;
+            portENTER_CRITICAL(&store_mux);
+            if (checked[i] == CHECK_UNKNOWN && !ok) {
+                stats.crc_failures++;
+            }
+            checked[i] = check;
+            portEXIT_CRITICAL(&store_mux);
+            if (!ok) {
+                LOGE(SYSTEM, "❌ Asset %.24s fails its CRC - not used", entry->name);
+            }
+        }
+        if (check != CHECK_PASSED) {
+            return false;
+        }
+
+        asset->data = base + entry->offset;
+        asset->length = entry->length;
+        asset->crc32 = entry->crc32;
+        asset->type = (asset_type_t)entry->type;
+        asset->subtype = entry->subtype;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Point an LVGL image descriptor at an image asset, no copy
+ */
+bool asset_store_image(const char* name, lv_img_dsc_t* image) {
+    asset_t asset;
+    if (!asset_store_find(name, &asset) || asset.type != ASSET_TYPE_IMAGE ||
+        asset.length < sizeof(lv_img_header_t)) {
+        return false;
+    }
+    memset(image, 0, sizeof(*image));
+    memcpy(&image->header, asset.data, sizeof(lv_img_header_t));
+    image->data = asset.data + sizeof(lv_img_header_t);
+    image->data_size = asset.length - sizeof(lv_img_header_t);
+    return true;
+}
+
+/**
+ * @brief Copy the store statistics
+ */
+void asset_store_get_stats(asset_store_stats_t* out) {
+    portENTER_CRITICAL(&store_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&store_mux);
+}
+
+/**
+ * @brief Read and check the header and table, and find where the last asset ends
+ */
+static bool read_toc(const esp_partition_t* partition, uint32_t* end) {
+    asset_header_t header;
+    if (esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK ||
+        header.magic != ASSET_MAGIC || header.format != ASSET_FORMAT) {
+        LOGW(SYSTEM, "⚠️  Asset partition is empty - flash one with make assets-upload");
+        return false;
+    }
+    if (header.count == 0 || header.count > ASSET_MAX_ENTRIES) {
+        LOGE(SYSTEM, "❌ Asset table has %u entries, at most %d fit", header.count, ASSET_MAX_ENTRIES);
+        return false;
+    }
+
+    size_t bytes = header.count * sizeof(asset_entry_t);
+    if (esp_partition_read(partition, sizeof(header), toc, bytes) != ESP_OK ||
+        esp_rom_crc32_le(0, (const uint8_t*)toc, bytes) != header.toc_crc32) {
+        LOGE(SYSTEM, "❌ Asset table fails its CRC");
+        return false;
+    }
+
+    *end = sizeof(header) + bytes;
+    for (uint16_t i = 0; i < header.count; i++) {
+        const asset_entry_t* entry = &toc[i];
+        if (entry->offset % ASSET_ALIGN != 0 || entry->offset > partition->size ||
+            entry->length > partition->size - entry->offset) {
+            LOGE(SYSTEM, "❌ Asset %.24s lies outside the partition", entry->name);
+            return false;
+        }
+        *end = max(*end, entry->offset + entry->length);
+    }
+    stats.count = header.count;
+    return true;
+}
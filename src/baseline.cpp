@@ -0,0 +1,330 @@
+/**
+ * @file baseline.cpp
+ * @brief Hour-of-week baselines of the scan figures, and deviation from them
+ *
+ * Each bucket keeps, per metric, a weight, a mean and a sum of squared
+ * deviations (M2). Cycles of the hour in progress build up a separate
+ * visit summary one Welford step at a time; when the hour ends the visit
+ * is merged into its bucket with the parallel-variance formula, after the
+ * bucket's own weight has been decayed by BASELINE_DECAY. Recent weeks so
+ * count for more, and a site whose Tuesday afternoons change is followed
+ * within a few weeks. Variance is kept across cycles, not visits, so a
+ * normally lively hour gets a wide band and a normally dead one a narrow
+ * band; the floor keeps a dead hour from making a single device
+ * remarkable.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "storage.h"
+#include "baseline.h"
+#include "logger.h"
+
+#ifdef ESP_PLATFORM
+#include "mem_policy.h"
+#endif
+
+#define BASELINE_MAGIC          0x42534C4E  // "BSLN"
+#define BASELINE_VERSION        1
+#define NO_HOUR                 0xFF
+
+/**
+ * @brief One hour of the week, or the visit in progress
+ */
+typedef struct {
+    float    weight;                        // Cycles, decayed per week
+    uint16_t visits;                        // Weeks merged in, saturating
+    uint16_t reserved;
+    float    mean[BASELINE_METRICS];
+    float    m2[BASELINE_METRICS];          // Sum of squared deviations from the mean
+} bucket_t;
+
+/**
+ * @brief On-flash header, followed by the hour buckets and the open visit
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t  hours;
+    uint8_t  metrics;
+    uint8_t  open_hour;
+    uint8_t  reserved[3];
+    uint32_t open_start;
+} baseline_file_header_t;
+
+static const char* const metric_names[BASELINE_METRICS] = {
+    "wifi", "ble", "churn", "phones", "trackers", "beacons"
+};
+
+// BASELINE_HOURS buckets, then the open visit
+static bucket_t* buckets = NULL;
+static bucket_t* open_visit = NULL;
+static uint8_t open_hour = NO_HOUR;
+static time_t open_start = 0;
+static uint8_t covered = 0;
+static volatile uint8_t coverage_pct = 0;
+static baseline_status_t status;
+static SemaphoreHandle_t baseline_lock = NULL;
+static StaticSemaphore_t baseline_lock_state;
+
+// Forward declarations
+static void close_visit(void);
+static void count_covered(void);
+
+/**
+ * @brief Allocate the buckets (PSRAM preferred) and restore them from flash
+ */
+bool baseline_init(void) {
+    size_t bytes = sizeof(bucket_t) * (BASELINE_HOURS + 1);
+#ifdef ESP_PLATFORM
+    buckets = (bucket_t*)mem_calloc(MEM_BULK, 1, bytes);
+#else
+    buckets = (bucket_t*)calloc(1, bytes);
+#endif
+    if (baseline_lock == NULL) {
+        baseline_lock = xSemaphoreCreateMutexStatic(&baseline_lock_state);
+    }
+    if (buckets == NULL) {
+        LOGE(SCAN, "❌ Baseline allocation failed");
+        return false;
+    }
+    open_visit = &buckets[BASELINE_HOURS];
+    memset(&status, 0, sizeof(status));
+
+    // Restore the weeks learned so far if the stored layout matches this build
+    storage_medium_t medium;
+    fs::FS* fs = storage_acquire(STORAGE_CLASS_CONFIG, &medium);
+    File file;
+    if (fs != NULL) {
+        file = fs->open(BASELINE_FILE, "r");
+    }
+    if (file) {
+        baseline_file_header_t header;
+        bool valid = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                     header.magic == BASELINE_MAGIC && header.version == BASELINE_VERSION &&
+                     header.hours == BASELINE_HOURS && header.metrics == BASELINE_METRICS &&
+                     (header.open_hour < BASELINE_HOURS || header.open_hour == NO_HOUR) &&
+                     file.read((uint8_t*)buckets, bytes) == bytes;
+        file.close();
+
+        if (valid) {
+            // The visit in progress at shutdown resumes if the power comes
+            // back within its hour, and is merged at the next cycle if not
+            open_hour = header.open_hour;
+            open_start = (time_t)header.open_start;
+        } else {
+            memset(buckets, 0, bytes);
+            LOGW(SCAN, "⚠️  Baselines unreadable - starting fresh");
+        }
+    }
+    storage_unlock(medium);
+
+    count_covered();
+    LOGI(SCAN, "✅ Baselines: %u of %u hours of the week learned",
+         covered, BASELINE_HOURS);
+    return true;
+}
+
+/**
+ * @brief Score a cycle against its hour-of-week and learn from it
+ */
+uint8_t baseline_observe(const sensor_data_t* data, time_t now) {
+    if (buckets == NULL || data == NULL) {
+        return 0;
+    }
+    if (now < AI_FEATURE_MIN_EPOCH) {
+        status.clock_valid = false;
+        return 0;
+    }
+
+    struct tm local;
+    localtime_r(&now, &local);
+    uint8_t hour = (uint8_t)(local.tm_wday * 24 + local.tm_hour);
+
+    float x[BASELINE_METRICS];
+    x[BASELINE_WIFI] = data->wifi_networks_count;
+    x[BASELINE_BLE] = data->ble_devices_count;
+    x[BASELINE_CHURN] = (float)data->devices_appeared + data->devices_lost;
+    x[BASELINE_PHONES] = data->ble_phones;
+    x[BASELINE_TRACKERS] = data->ble_trackers;
+    x[BASELINE_BEACONS] = data->ble_beacons;
+
+    xSemaphoreTake(baseline_lock, portMAX_DELAY);
+
+    // A new hour, the same hour a week or more later, or a clock set back
+    if (hour != open_hour || now < open_start || now - open_start >= 3600) {
+        close_visit();
+        open_hour = hour;
+        open_start = now;
+    }
+
+    // Score against the earlier weeks of this hour
+    const bucket_t* bucket = &buckets[hour];
+    bool ready = bucket->visits >= BASELINE_MIN_VISITS && bucket->weight > 0.0f;
+    float worst = 0.0f;
+    uint8_t worst_metric = 0;
+    for (uint8_t m = 0; m < BASELINE_METRICS; m++) {
+        float mean = bucket->mean[m];
+        float sd = ready ? sqrtf(bucket->m2[m] / bucket->weight) : 0.0f;
+        status.mean[m] = mean;
+        status.sd[m] = sd;
+        if (ready) {
+            float band = max(sd, BASELINE_SD_FLOOR + BASELINE_SD_RELATIVE * mean);
+            float z = fabsf(x[m] - mean) / band;
+            if (z > worst) {
+                worst = z;
+                worst_metric = m;
+            }
+        }
+    }
+
+    // Then the cycle joins the visit in progress
+    open_visit->weight += 1.0f;
+    for (uint8_t m = 0; m < BASELINE_METRICS; m++) {
+        float delta = x[m] - open_visit->mean[m];
+        open_visit->mean[m] += delta / open_visit->weight;
+        open_visit->m2[m] += delta * (x[m] - open_visit->mean[m]);
+    }
+
+    status.clock_valid = true;
+    status.hour_of_week = hour;
+    status.ready = ready;
+    status.deviation = worst;
+    status.worst_metric = worst_metric;
+    if (ready) {
+        status.scored++;
+        if (worst >= BASELINE_UNUSUAL_Z) {
+            status.unusual++;
+        }
+    }
+    xSemaphoreGive(baseline_lock);
+
+    if (ready && worst >= BASELINE_UNUSUAL_Z) {
+        LOGD(SCAN, "📅 Unusual for hour %u: %s %.0f vs %.1f (z %.1f)", hour,
+             metric_names[worst_metric], x[worst_metric], bucket->mean[worst_metric], worst);
+    }
+    return (uint8_t)min(worst * 10.0f, 255.0f);
+}
+
+/**
+ * @brief Hours of the week with a baseline, 0-100
+ */
+uint8_t baseline_coverage_pct(void) {
+    return coverage_pct;
+}
+
+/**
+ * @brief Write the buckets to flash
+ */
+bool baseline_save(void) {
+    if (buckets == NULL) {
+        return false;
+    }
+
+    storage_medium_t medium;
+    fs::FS* fs = storage_acquire(STORAGE_CLASS_CONFIG, &medium);
+    File file;
+    if (fs != NULL) {
+        file = fs->open(BASELINE_FILE, "w");
+    }
+    if (!file) {
+        storage_unlock(medium);
+        LOGE(SCAN, "❌ Baseline save failed");
+        return false;
+    }
+
+    baseline_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BASELINE_MAGIC;
+    header.version = BASELINE_VERSION;
+    header.hours = BASELINE_HOURS;
+    header.metrics = BASELINE_METRICS;
+
+    // The open visit changes every cycle, so the write holds the lock; at
+    // under 10 KB it delays at most one cycle's scoring
+    xSemaphoreTake(baseline_lock, portMAX_DELAY);
+    header.open_hour = open_hour;
+    header.open_start = (uint32_t)open_start;
+    size_t bytes = sizeof(bucket_t) * (BASELINE_HOURS + 1);
+    bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              file.write((const uint8_t*)buckets, bytes) == bytes;
+    if (ok) {
+        status.saves++;
+    }
+    xSemaphoreGive(baseline_lock);
+    file.close();
+    storage_unlock(medium);
+    return ok;
+}
+
+/**
+ * @brief Copy the engine status
+ */
+void baseline_get_status(baseline_status_t* out) {
+    if (out == NULL) {
+        return;
+    }
+    if (baseline_lock == NULL) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(baseline_lock, portMAX_DELAY);
+    *out = status;
+    xSemaphoreGive(baseline_lock);
+    out->coverage_pct = coverage_pct;
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* baseline_metric_name(baseline_metric_t metric) {
+    return metric < BASELINE_METRICS ? metric_names[metric] : "?";
+}
+
+/**
+ * @brief Merge the visit in progress into its hour's bucket and clear it
+ *
+ * Visits too short to say much about the hour (a boot at five to three)
+ * are dropped rather than merged. Called with the lock held.
+ */
+static void close_visit(void) {
+    if (open_hour < BASELINE_HOURS && open_visit->weight >= BASELINE_MIN_VISIT_CYCLES) {
+        bucket_t* bucket = &buckets[open_hour];
+        float wa = bucket->weight * BASELINE_DECAY;
+        float wb = open_visit->weight;
+        float n = wa + wb;
+        for (uint8_t m = 0; m < BASELINE_METRICS; m++) {
+            float delta = open_visit->mean[m] - bucket->mean[m];
+            bucket->mean[m] += delta * wb / n;
+            bucket->m2[m] = bucket->m2[m] * BASELINE_DECAY + open_visit->m2[m] + delta * delta * wa * wb / n;
+        }
+        bucket->weight = n;
+        if (bucket->visits == 0) {
+            covered++;
+            coverage_pct = (uint8_t)(covered * 100U / BASELINE_HOURS);
+        }
+        if (bucket->visits < UINT16_MAX) {
+            bucket->visits++;
+        }
+        LOGD(SCAN, "📅 Hour %u of the week: visit of %.0f cycles merged, %u weeks",
+             open_hour, wb, bucket->visits);
+    }
+    memset(open_visit, 0, sizeof(*open_visit));
+    open_hour = NO_HOUR;
+}
+
+/**
+ * @brief Recount the hours with a baseline
+ */
+static void count_covered(void) {
+    covered = 0;
+    for (uint16_t h = 0; h < BASELINE_HOURS; h++) {
+        if (buckets[h].visits > 0) {
+            covered++;
+        }
+    }
+    coverage_pct = (uint8_t)(covered * 100U / BASELINE_HOURS);
+}
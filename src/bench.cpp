@@ -0,0 +1,487 @@
+/**
+ * @file bench.cpp
+ * @brief Microbenchmark suite of the env:bench firmware
+ *
+ * Every case times BENCH_SAMPLES batches of calls with the CPU cycle
+ * counter, after one warm-up batch, and reports the per-call minimum,
+ * median, 99th percentile, maximum and mean in nanoseconds. Inputs are
+ * fixed rather than taken from the radios, so two builds see the same
+ * work and their reports compare case by case (tools/bench/bench_report.py).
+ *
+ * The device table cases insert locally administered addresses into the
+ * live table; they age out like any other device, and the report is all
+ * this firmware is for.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <lvgl.h>
+#include "config.h"
+#include "ai_states.h"
+#include "ai_features.h"
+#include "ai_inference.h"
+#include "rssi_histogram.h"
+#include "device_table.h"
+#include "sensor_data_codec.h"
+#include "renderer.h"
+#include "ui_screens.h"
+#include "ui_events.h"
+#include "sd_monitor.h"
+#include "sd_bench.h"
+#include "power_manager.h"
+#include "bench.h"
+
+#if BENCH_ENABLED
+
+#define BENCH_SCENES_MAX     8
+#define BENCH_ECHO_STACK     2048
+#define BENCH_WAIT_MS        30000  // For the UI task or the card, before a suite is skipped
+#define BENCH_ECHO_NOTIFY    UINT32_MAX // Sent on ping: the echo task answers notifications from then on
+
+extern TaskHandle_t ui_task_handle;
+extern TaskHandle_t ai_task_handle;
+extern TaskHandle_t scan_task_handle;
+extern TaskHandle_t system_task_handle;
+extern TaskHandle_t capture_task_handle;
+
+typedef void (*bench_fn_t)(uint32_t i);
+
+/**
+ * @brief Distribution of one case
+ */
+typedef struct {
+    uint32_t min;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+    uint32_t mean;
+} bench_summary_t;
+
+/**
+ * @brief Frame timings of one scene, filled on the UI task
+ */
+typedef struct {
+    const char* name;
+    uint16_t    frames;
+    uint32_t    render_us[BENCH_SCENE_FRAMES];
+    uint32_t    flush_us[BENCH_SCENE_FRAMES];
+} bench_scene_t;
+
+// Case inputs
+static sensor_data_t data;
+static scan_histograms_t histograms;
+static ai_feature_vector_t features;
+static uint8_t wire[SENSOR_DATA_CBOR_MAX_BYTES];
+static size_t wire_length = 0;
+static char json[1024];
+static volatile uint32_t sink = 0;          // Keeps results alive past the optimizer
+
+// Round trips
+static SemaphoreHandle_t mutex = NULL;
+static QueueHandle_t ping = NULL;
+static QueueHandle_t pong = NULL;
+static TaskHandle_t echo_task = NULL;
+static TaskHandle_t bench_task = NULL;
+static StaticTask_t echo_tcb;
+static StackType_t echo_stack[BENCH_ECHO_STACK];
+
+// Display suite
+static bench_scene_t scenes[BENCH_SCENES_MAX];
+static uint8_t scene_count = 0;
+static SemaphoreHandle_t scenes_done = NULL;
+
+static uint32_t samples[BENCH_SAMPLES];
+static uint16_t cases = 0;
+
+// Forward declarations
+static void fill_inputs(void);
+static void run_case(const char* suite, const char* name, bench_fn_t fn, uint32_t batch);
+static void summarize(uint32_t* values, uint32_t count, bench_summary_t* summary);
+static void report(const char* suite, const char* name, const char* unit, uint32_t count,
+                   uint32_t batch, const bench_summary_t* summary);
+static void report_skip(const char* suite, const char* name, const char* reason);
+static void run_display_suite(void);
+static void run_sd_suite(void);
+static void echo_loop(void* parameter);
+
+// Cases
+static void case_rules(uint32_t i) {
+    sink += infer_ai_state(&data);
+}
+
+static void case_tflite(uint32_t i) {
+    ai_state_t state;
+    features.timestamp_ms = i + 1;          // A new vector each call, never the cached result
+    sink += ai_inference_run(&features, &state) ? state : 0;
+}
+
+static void case_features(uint32_t i) {
+    ai_features_extract(&data, &histograms, &features);
+    sink += features.scan_cycle;
+}
+
+static void make_mac(uint32_t i, uint8_t* mac) {
+    mac[0] = 0x02;                          // Locally administered, never a real device
+    mac[1] = 0xBE;
+    mac[2] = 0x4C;
+    mac[3] = (uint8_t)(i >> 16);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+static void case_device_insert(uint32_t i) {
+    uint8_t mac[6];
+    make_mac(i, mac);
+    sink += device_table_observe(mac, DEVICE_KIND_BLE, -60, 0, millis(), 0) != NULL;
+}
+
+static void case_device_lookup(uint32_t i) {
+    uint8_t mac[6];
+    make_mac(i % (BENCH_SAMPLES * 4), mac); // Among those inserted
+    sink += device_table_find(mac, DEVICE_KIND_BLE) != NULL;
+}
+
+static void case_device_miss(uint32_t i) {
+    uint8_t mac[6];
+    make_mac(0x800000 | i, mac);
+    sink += device_table_find(mac, DEVICE_KIND_BLE) != NULL;
+}
+
+static void case_json(uint32_t i) {
+    sink += sensor_data_to_json(&data, json, sizeof(json));
+}
+
+static void case_cbor_encode(uint32_t i) {
+    sink += sensor_data_to_cbor(&data, wire, sizeof(wire));
+}
+
+static void case_cbor_decode(uint32_t i) {
+    sensor_data_t decoded;
+    sink += sensor_data_from_cbor(wire, wire_length, &decoded);
+}
+
+static void case_packed(uint32_t i) {
+    sink += sensor_data_serialize(&data, wire, sizeof(wire));
+}
+
+static void case_mutex(uint32_t i) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    xSemaphoreGive(mutex);
+}
+
+static void case_queue(uint32_t i) {
+    uint32_t value = i;
+    xQueueSend(ping, &value, portMAX_DELAY);
+    xQueueReceive(pong, &value, portMAX_DELAY);
+    sink += value;
+}
+
+static void case_notify(uint32_t i) {
+    xTaskNotifyGive(echo_task);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+/**
+ * @brief Run every microbenchmark and print the report on the console
+ */
+void bench_run(void) {
+    bench_task = xTaskGetCurrentTaskHandle();
+    TaskHandle_t quiet[] = { scan_task_handle, capture_task_handle, ai_task_handle, system_task_handle };
+    for (TaskHandle_t task : quiet) {
+        if (task != NULL) {
+            vTaskSuspend(task);
+        }
+    }
+    power_manager_acquire(POWER_CLIENT_BENCH);  // Cycles convert at one clock throughout
+    vTaskDelay(pdMS_TO_TICKS(500));         // Let the console and the radios settle
+
+    mutex = xSemaphoreCreateMutex();
+    ping = xQueueCreate(1, sizeof(uint32_t));
+    pong = xQueueCreate(1, sizeof(uint32_t));
+    scenes_done = xSemaphoreCreateBinary();
+    echo_task = xTaskCreateStaticPinnedToCore(echo_loop, "Bench_Echo", BENCH_ECHO_STACK, NULL,
+                                              uxTaskPriorityGet(NULL), echo_stack, &echo_tcb,
+                                              xPortGetCoreID());
+    fill_inputs();
+
+    ai_inference_stats_t inference;
+    ai_inference_get_stats(&inference);
+    uint32_t started_ms = millis();
+    Serial.printf("BENCH_BEGIN {\"report\":%d,\"idf\":\"%s\",\"cpu_mhz\":%lu,\"backend\":\"%s\","
+                  "\"model\":\"%08lx\",\"samples\":%d}\n",
+                  BENCH_REPORT_VERSION, esp_get_idf_version(), (uint32_t)ESP.getCpuFreqMHz(),
+                  ai_inference_backend_name(), inference.model_hash, BENCH_SAMPLES);
+
+    run_case("ai", "rules", case_rules, 100);
+    if (inference.model_loaded) {
+        run_case("ai", "tflite", case_tflite, 1);
+    } else {
+        report_skip("ai", "tflite", "no model");
+    }
+    run_case("ai", "features", case_features, 10);
+
+    run_case("devices", "insert", case_device_insert, 4);
+    run_case("devices", "lookup", case_device_lookup, 100);
+    run_case("devices", "miss", case_device_miss, 100);
+
+    run_case("codec", "json", case_json, 4);
+    run_case("codec", "cbor_encode", case_cbor_encode, 20);
+    run_case("codec", "cbor_decode", case_cbor_decode, 20);
+    run_case("codec", "packed", case_packed, 100);
+
+    run_case("rtos", "mutex", case_mutex, 100);
+    run_case("rtos", "queue_round_trip", case_queue, 10);
+    uint32_t mode = BENCH_ECHO_NOTIFY;
+    xQueueSend(ping, &mode, portMAX_DELAY);
+    run_case("rtos", "notify_round_trip", case_notify, 10);
+
+    run_display_suite();
+    run_sd_suite();
+
+    Serial.printf("BENCH_END {\"cases\":%u,\"ms\":%lu}\n", cases, millis() - started_ms);
+
+    vTaskDelete(echo_task);
+    power_manager_release(POWER_CLIENT_BENCH);
+    for (TaskHandle_t task : quiet) {
+        if (task != NULL) {
+            vTaskResume(task);
+        }
+    }
+}
+
+/**
+ * @brief Time full redraws of every scene in the ring; UI task only
+ */
+void bench_ui_scenes(void) {
+    if (renderer_in_standby()) {
+        renderer_standby(false);
+    }
+    scene_count = min((uint8_t)BENCH_SCENES_MAX, ui_screens_count());
+    for (uint8_t s = 0; s < scene_count; s++) {
+        bench_scene_t* scene = &scenes[s];
+        const renderer_scene_t* shown = ui_screens_scene(s);
+        scene->name = shown->name;
+        scene->frames = 0;
+        if (!renderer_show(shown)) {
+            continue;
+        }
+        renderer_frame();                   // Build and first draw, not timed
+
+        // A frame held back after an overrun draws nothing; try again
+        for (uint16_t attempt = 0; scene->frames < BENCH_SCENE_FRAMES &&
+                                   attempt < BENCH_SCENE_FRAMES * 4; attempt++) {
+            renderer_profile_t before;
+            renderer_profile_t after;
+            renderer_get_profile(&before);
+            lv_obj_invalidate(lv_scr_act());
+            renderer_frame();
+            renderer_get_profile(&after);
+            if (after.refreshes != before.refreshes) {
+                scene->render_us[scene->frames] = after.render_us;
+                scene->flush_us[scene->frames] = after.flush_us;
+                scene->frames++;
+            }
+            vTaskDelay(1);
+        }
+    }
+    renderer_show(ui_screens_scene(0));
+    xSemaphoreGive(scenes_done);
+}
+
+/**
+ * @brief Fixed inputs: a busy cycle with a spread of signal strengths
+ */
+static void fill_inputs(void) {
+    memset(&data, 0, sizeof(data));
+    data.version = SENSOR_DATA_VERSION;
+    data.scan_cycle = 1000;
+    data.free_memory = 6 * 1024 * 1024;
+    data.uptime_seconds = 86400;
+    data.wifi_networks_count = 24;
+    data.wifi_signal_strength = -68;
+    data.ble_devices_count = 41;
+    data.ble_signal_strength = -77;
+    data.novel_devices = 3;
+    data.novelty_permille = 150;
+    data.sd_card_present = true;
+    data.hop_channel = 6;
+    data.busiest_channel = 11;
+    data.devices_appeared = 5;
+    data.devices_lost = 2;
+    data.devices_moved = 4;
+    data.capture_frames_per_second = 420;
+    data.probe_requests = 96;
+    data.wifi_clients_count = 37;
+    data.randomized_clients = 22;
+    data.busiest_bssid_fps = 120;
+    data.busiest_channel_fps = 260;
+    data.ble_phones = 12;
+    data.ble_trackers = 2;
+    data.ble_wearables = 4;
+    data.ble_beacons = 6;
+    data.cycle_time_us = 123456789;
+
+    scan_histograms_reset(&histograms);
+    for (uint8_t i = 0; i < 64; i++) {
+        int8_t rssi = (int8_t)(-40 - (i * 37) % 55);
+        rssi_hist_add(&histograms.wifi_channel[1 + i % WIFI_CHANNEL_COUNT], rssi);
+        rssi_hist_add(&histograms.wifi_all, rssi);
+        rssi_hist_add(&histograms.ble, rssi - 10);
+    }
+    ai_features_extract(&data, &histograms, &features);
+    wire_length = sensor_data_to_cbor(&data, wire, sizeof(wire));
+}
+
+/**
+ * @brief Time BENCH_SAMPLES batches of batch calls, after one warm-up batch
+ */
+static void run_case(const char* suite, const char* name, bench_fn_t fn, uint32_t batch) {
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    uint32_t call = 0;
+    for (uint32_t i = 0; i < batch; i++) {
+        fn(call++);
+    }
+    for (uint32_t s = 0; s < BENCH_SAMPLES; s++) {
+        uint32_t start = ESP.getCycleCount();
+        for (uint32_t i = 0; i < batch; i++) {
+            fn(call++);
+        }
+        uint32_t cycles = ESP.getCycleCount() - start;
+        samples[s] = (uint32_t)((uint64_t)cycles * 1000 / mhz / batch);
+    }
+
+    bench_summary_t summary;
+    summarize(samples, BENCH_SAMPLES, &summary);
+    report(suite, name, "ns", BENCH_SAMPLES, batch, &summary);
+}
+
+/**
+ * @brief Sort the values and take their order statistics
+ */
+static void summarize(uint32_t* values, uint32_t count, bench_summary_t* summary) {
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t v = values[i];
+        uint32_t j = i;
+        for (; j > 0 && values[j - 1] > v; j--) {
+            values[j] = values[j - 1];
+        }
+        values[j] = v;
+    }
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += values[i];
+    }
+    summary->min = values[0];
+    summary->p50 = values[count / 2];
+    summary->p99 = values[(count * 99) / 100 < count ? (count * 99) / 100 : count - 1];
+    summary->max = values[count - 1];
+    summary->mean = (uint32_t)(total / count);
+}
+
+/**
+ * @brief Print one case as a BENCH line
+ */
+static void report(const char* suite, const char* name, const char* unit, uint32_t count,
+                   uint32_t batch, const bench_summary_t* summary) {
+    cases++;
+    Serial.printf("BENCH {\"suite\":\"%s\",\"case\":\"%s\",\"unit\":\"%s\",\"samples\":%lu,"
+                  "\"batch\":%lu,\"min\":%lu,\"p50\":%lu,\"p99\":%lu,\"max\":%lu,\"mean\":%lu}\n",
+                  suite, name, unit, count, batch, summary->min, summary->p50, summary->p99,
+                  summary->max, summary->mean);
+}
+
+/**
+ * @brief Print a case that could not run, so the report keeps its shape
+ */
+static void report_skip(const char* suite, const char* name, const char* reason) {
+    cases++;
+    Serial.printf("BENCH {\"suite\":\"%s\",\"case\":\"%s\",\"skipped\":\"%s\"}\n",
+                  suite, name, reason);
+}
+
+/**
+ * @brief Have the UI task redraw each scene, then report render and flush times
+ */
+static void run_display_suite(void) {
+    if (ui_task_handle == NULL) {
+        report_skip("display", "scenes", "no UI task");
+        return;
+    }
+    ui_notify(UI_EVENT_BENCH);
+    if (xSemaphoreTake(scenes_done, pdMS_TO_TICKS(BENCH_WAIT_MS)) != pdTRUE) {
+        report_skip("display", "scenes", "UI task did not answer");
+        return;
+    }
+
+    for (uint8_t s = 0; s < scene_count; s++) {
+        bench_scene_t* scene = &scenes[s];
+        char name[32];
+        if (scene->frames == 0) {
+            report_skip("display", scene->name, "no frame drawn");
+            continue;
+        }
+        bench_summary_t summary;
+        snprintf(name, sizeof(name), "%s_render", scene->name);
+        summarize(scene->render_us, scene->frames, &summary);
+        report("display", name, "us", scene->frames, 1, &summary);
+        snprintf(name, sizeof(name), "%s_flush", scene->name);
+        summarize(scene->flush_us, scene->frames, &summary);
+        report("display", name, "us", scene->frames, 1, &summary);
+    }
+}
+
+/**
+ * @brief Time the card's write sizes again and report the one the writers use
+ */
+static void run_sd_suite(void) {
+    sd_bench_stats_t before;
+    sd_bench_get_stats(&before);
+    if (!sd_monitor_mounted() || !sd_bench_request()) {
+        report_skip("sd", "write", "no card");
+        return;
+    }
+
+    sd_bench_stats_t after;
+    uint32_t started_ms = millis();
+    do {
+        vTaskDelay(pdMS_TO_TICKS(100));
+        sd_bench_get_stats(&after);
+    } while (after.block_runs == before.block_runs && millis() - started_ms < BENCH_WAIT_MS);
+    if (after.block_runs == before.block_runs || !after.valid) {
+        report_skip("sd", "write", "benchmark did not finish");
+        return;
+    }
+
+    // One sequential run: the figures are the run's, not a distribution
+    bench_summary_t throughput = { after.result.write_kbps, after.result.write_kbps,
+                                   after.result.write_kbps, after.result.write_kbps,
+                                   after.result.write_kbps };
+    report("sd", "write_throughput", "kbps", 1, after.result.block_bytes, &throughput);
+    bench_summary_t block = { after.result.max_block_us, after.result.max_block_us,
+                              after.result.max_block_us, after.result.max_block_us,
+                              after.result.max_block_us };
+    report("sd", "write_worst_block", "us", 1, after.result.block_bytes, &block);
+}
+
+/**
+ * @brief Answer pings, then notifications, for the round-trip cases
+ */
+static void echo_loop(void* parameter) {
+    uint32_t value;
+    do {
+        xQueueReceive(ping, &value, portMAX_DELAY);
+        if (value != BENCH_ECHO_NOTIFY) {
+            xQueueSend(pong, &value, portMAX_DELAY);
+        }
+    } while (value != BENCH_ECHO_NOTIFY);
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        xTaskNotifyGive(bench_task);
+    }
+}
+
+#endif // BENCH_ENABLED
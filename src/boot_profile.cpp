@@ -0,0 +1,108 @@
+/**
+ * @file boot_profile.cpp
+ * @brief Timestamps of the boot stages, reported once the system runs
+ *
+ * Stages that run on the UI task or on job workers overlap the ones on
+ * the setup path, so each one keeps its own start and end rather than a
+ * duration; the report shows both, from which the overlap is plain.
+ * Times count from the esp_timer start, before setup() is entered.
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "boot_profile.h"
+#include "logger.h"
+
+// In boot_stage_t order
+static boot_stage_stats_t stages[BOOT_STAGE_COUNT] = {
+    { "tier_face" },
+    { "tier_radios" },
+    { "tier_services" },
+    { "console" },
+    { "hardware" },
+    { "display" },
+    { "first_frame" },
+    { "bluetooth" },
+    { "flash_fs" },
+    { "sd" },
+    { "models" },
+    { "tasks" }
+};
+static bool reported = false;
+static portMUX_TYPE profile_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static uint32_t now_us(void);
+
+/**
+ * @brief Mark the start of a stage; later calls for the same stage are ignored
+ */
+void boot_profile_begin(boot_stage_t stage) {
+    uint32_t now = now_us();
+    portENTER_CRITICAL(&profile_mux);
+    if (stages[stage].begin_us == 0) {
+        stages[stage].begin_us = now;
+    }
+    portEXIT_CRITICAL(&profile_mux);
+}
+
+/**
+ * @brief Mark the end of a stage; later calls for the same stage are ignored
+ */
+void boot_profile_end(boot_stage_t stage) {
+    uint32_t now = now_us();
+    portENTER_CRITICAL(&profile_mux);
+    if (stages[stage].begin_us != 0 && stages[stage].end_us == 0) {
+        stages[stage].end_us = now;
+    }
+    portEXIT_CRITICAL(&profile_mux);
+}
+
+/**
+ * @brief Copy one stage's timestamps
+ */
+void boot_profile_get(boot_stage_t stage, boot_stage_stats_t* out) {
+    portENTER_CRITICAL(&profile_mux);
+    *out = stages[stage];
+    portEXIT_CRITICAL(&profile_mux);
+}
+
+/**
+ * @brief Log every stage once; later calls do nothing
+ */
+void boot_profile_report(void) {
+    if (reported) {
+        return;
+    }
+    reported = true;
+
+    boot_stage_stats_t frame;
+    boot_stage_stats_t radios;
+    boot_stage_stats_t services;
+    boot_profile_get(BOOT_STAGE_FIRST_FRAME, &frame);
+    boot_profile_get(BOOT_STAGE_TIER_RADIOS, &radios);
+    boot_profile_get(BOOT_STAGE_TIER_SERVICES, &services);
+    LOGI(SYSTEM, "⏱️  Boot profile: first frame at %lu ms, scanning at %lu ms, setup done at %lu ms",
+         frame.end_us / 1000, radios.end_us / 1000, services.end_us / 1000);
+    for (uint8_t i = 0; i < BOOT_STAGE_COUNT; i++) {
+        boot_stage_stats_t stage;
+        boot_profile_get((boot_stage_t)i, &stage);
+        if (stage.begin_us == 0) {
+            LOGI(SYSTEM, "   %-14s not run", stage.name);
+        } else if (stage.end_us == 0) {
+            LOGI(SYSTEM, "   %-14s %6lu ms -> still running", stage.name, stage.begin_us / 1000);
+        } else {
+            LOGI(SYSTEM, "   %-14s %6lu ms -> %6lu ms (%lu ms)", stage.name, stage.begin_us / 1000,
+                 stage.end_us / 1000, (stage.end_us - stage.begin_us) / 1000);
+        }
+    }
+}
+
+/**
+ * @brief Microseconds since boot, never 0 so 0 can mean "not yet"
+ */
+static uint32_t now_us(void) {
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    return now != 0 ? now : 1;
+}
@@ -0,0 +1,222 @@
+/**
+ * @file cbor.cpp
+ * @brief Minimal CBOR writer and reader for the compact wire encodings
+ *
+ * Every integer is written in its shortest form, which is what makes the
+ * encoding compact: a count below 24 is one byte with its key. The reader
+ * takes definite-length items only, which is all the writer produces, and
+ * nests at most CBOR_MAX_DEPTH deep when skipping.
+ */
+
+#include <Arduino.h>
+#include "cbor.h"
+
+#define CBOR_UINT   0
+#define CBOR_NINT   1
+#define CBOR_BYTES  2
+#define CBOR_TEXT   3
+#define CBOR_ARRAY  4
+#define CBOR_MAP    5
+#define CBOR_TAG    6
+#define CBOR_SIMPLE 7
+
+#define CBOR_FALSE  20
+#define CBOR_TRUE   21
+
+#define CBOR_MAX_DEPTH 8
+
+// Forward declarations
+static void put_head(cbor_writer_t* writer, uint8_t major, uint64_t argument);
+static bool get_head(cbor_reader_t* reader, uint8_t* major, uint64_t* argument);
+static bool skip_items(cbor_reader_t* reader, uint64_t items, uint8_t depth);
+
+void cbor_writer_init(cbor_writer_t* writer, uint8_t* out, size_t capacity) {
+    writer->out = out;
+    writer->capacity = capacity;
+    writer->length = 0;
+    writer->overflowed = false;
+}
+
+void cbor_put_int(cbor_writer_t* writer, int64_t value) {
+    if (value >= 0) {
+        put_head(writer, CBOR_UINT, (uint64_t)value);
+    } else {
+        put_head(writer, CBOR_NINT, (uint64_t)(-1 - value));
+    }
+}
+
+void cbor_put_bool(cbor_writer_t* writer, bool value) {
+    put_head(writer, CBOR_SIMPLE, value ? CBOR_TRUE : CBOR_FALSE);
+}
+
+void cbor_put_text(cbor_writer_t* writer, const char* text) {
+    size_t n = strlen(text);
+    size_t start = writer->length;
+    put_head(writer, CBOR_TEXT, n);
+    if (writer->overflowed || writer->capacity - writer->length < n) {
+        writer->length = start;
+        writer->overflowed = true;
+        return;
+    }
+    memcpy(writer->out + writer->length, text, n);
+    writer->length += n;
+}
+
+void cbor_put_map(cbor_writer_t* writer, uint32_t pairs) {
+    put_head(writer, CBOR_MAP, pairs);
+}
+
+void cbor_put_array(cbor_writer_t* writer, uint32_t items) {
+    put_head(writer, CBOR_ARRAY, items);
+}
+
+void cbor_reader_init(cbor_reader_t* reader, const uint8_t* in, size_t length) {
+    reader->in = in;
+    reader->length = length;
+    reader->offset = 0;
+    reader->failed = false;
+}
+
+/**
+ * @brief Read a definite-length map header
+ */
+bool cbor_get_map(cbor_reader_t* reader, uint32_t* pairs) {
+    uint8_t major;
+    uint64_t argument;
+    if (!get_head(reader, &major, &argument) || major != CBOR_MAP || argument > UINT32_MAX) {
+        reader->failed = true;
+        return false;
+    }
+    *pairs = (uint32_t)argument;
+    return true;
+}
+
+/**
+ * @brief Read an integer or a boolean (as 0 or 1)
+ */
+bool cbor_get_int(cbor_reader_t* reader, int64_t* value) {
+    uint8_t major;
+    uint64_t argument;
+    if (!get_head(reader, &major, &argument)) {
+        return false;
+    }
+    if (major == CBOR_UINT && argument <= INT64_MAX) {
+        *value = (int64_t)argument;
+    } else if (major == CBOR_NINT && argument <= INT64_MAX) {
+        *value = -1 - (int64_t)argument;
+    } else if (major == CBOR_SIMPLE && (argument == CBOR_FALSE || argument == CBOR_TRUE)) {
+        *value = argument == CBOR_TRUE ? 1 : 0;
+    } else {
+        reader->failed = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Step over the next item, whatever it is, nested ones included
+ */
+bool cbor_skip(cbor_reader_t* reader) {
+    return skip_items(reader, 1, 0);
+}
+
+/**
+ * @brief Append a major type and its argument in the shortest form
+ */
+static void put_head(cbor_writer_t* writer, uint8_t major, uint64_t argument) {
+    uint8_t head[9];
+    size_t n;
+    if (argument < 24) {
+        head[0] = (major << 5) | (uint8_t)argument;
+        n = 1;
+    } else {
+        uint8_t bytes = argument <= UINT8_MAX ? 1 : argument <= UINT16_MAX ? 2 :
+                        argument <= UINT32_MAX ? 4 : 8;
+        head[0] = (major << 5) | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27);
+        for (uint8_t i = 0; i < bytes; i++) {
+            head[bytes - i] = (uint8_t)(argument >> (8 * i));      // Big-endian
+        }
+        n = 1 + bytes;
+    }
+    if (writer->overflowed || writer->capacity - writer->length < n) {
+        writer->overflowed = true;
+        return;
+    }
+    memcpy(writer->out + writer->length, head, n);
+    writer->length += n;
+}
+
+/**
+ * @brief Read a major type and its argument
+ * @return false, with failed set, past the end or on an indefinite length
+ */
+static bool get_head(cbor_reader_t* reader, uint8_t* major, uint64_t* argument) {
+    if (reader->failed || reader->offset >= reader->length) {
+        reader->failed = true;
+        return false;
+    }
+    uint8_t initial = reader->in[reader->offset++];
+    *major = initial >> 5;
+    uint8_t info = initial & 0x1F;
+    if (info < 24) {
+        *argument = info;
+        return true;
+    }
+    if (info > 27) {
+        reader->failed = true;      // Indefinite length, or reserved
+        return false;
+    }
+    uint8_t bytes = 1 << (info - 24);
+    if (reader->length - reader->offset < bytes) {
+        reader->failed = true;
+        return false;
+    }
+    *argument = 0;
+    for (uint8_t i = 0; i < bytes; i++) {
+        *argument = (*argument << 8) | reader->in[reader->offset++];
+    }
+    return true;
+}
+
+/**
+ * @brief Step over items, descending into arrays, maps and tags
+ */
+static bool skip_items(cbor_reader_t* reader, uint64_t items, uint8_t depth) {
+    if (depth > CBOR_MAX_DEPTH) {
+        reader->failed = true;
+        return false;
+    }
+    for (; items > 0; items--) {
+        uint8_t major;
+        uint64_t argument;
+        if (!get_head(reader, &major, &argument)) {
+            return false;
+        }
+        switch (major) {
+            case CBOR_BYTES:
+            case CBOR_TEXT:
+                if (reader->length - reader->offset < argument) {
+                    reader->failed = true;
+                    return false;
+                }
+                reader->offset += argument;
+                break;
+            case CBOR_ARRAY:
+            case CBOR_MAP:
+                if (argument > reader->length ||
+                    !skip_items(reader, major == CBOR_MAP ? argument * 2 : argument, depth + 1)) {
+                    reader->failed = true;
+                    return false;
+                }
+                break;
+            case CBOR_TAG:
+                if (!skip_items(reader, 1, depth + 1)) {
+                    return false;
+                }
+                break;
+            default:                // Integers and simple values are all head
+                break;
+        }
+    }
+    return true;
+}
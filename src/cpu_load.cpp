@@ -0,0 +1,241 @@
+/**
+ * @file cpu_load.cpp
+ * @brief Per-core and per-task CPU utilization from cumulative counters
+ *
+ * Whatever the source, each core has a running total of time (or ticks)
+ * and the part of it spent in its idle task, and each watched task a
+ * running total of its own. A sample differences them against the
+ * previous one; the counters are 32-bit and wrap, which the unsigned
+ * subtraction absorbs as long as samples are minutes rather than hours
+ * apart.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_freertos_hooks.h>
+#include "config.h"
+#include "cpu_load.h"
+#include "logger.h"
+
+#define RUN_TIME_STATS (configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY)
+
+typedef struct {
+    uint32_t core_total[CPU_LOAD_CORES];
+    uint32_t core_idle[CPU_LOAD_CORES];
+    uint32_t task[CPU_LOAD_MAX_TASKS];
+    uint32_t task_core1[CPU_LOAD_MAX_TASKS];     // Of task[], the part on core 1
+} counters_t;
+
+static TaskHandle_t idle_task[CPU_LOAD_CORES];
+static TaskHandle_t watched[CPU_LOAD_MAX_TASKS];
+static cpu_load_task_t watched_info[CPU_LOAD_MAX_TASKS];
+static volatile uint8_t watched_count = 0;
+
+static counters_t previous;
+static uint32_t previous_ms = 0;
+static bool sampled = false;
+static cpu_load_t last = {0};
+static portMUX_TYPE load_mux = portMUX_INITIALIZER_UNLOCKED;
+
+#if RUN_TIME_STATS
+static const char* const METHOD = "run-time stats";
+static TaskStatus_t status[CPU_LOAD_STATUS_SLOTS];   // Too big for the caller's stack
+#else
+static const char* const METHOD = "tick sampling";
+static volatile counters_t ticks;
+#endif
+
+// Forward declarations
+static bool read_counters(counters_t* now);
+#if !RUN_TIME_STATS
+static void tick_hook(void);
+#endif
+
+/**
+ * @brief Start counting
+ */
+bool cpu_load_init(void) {
+    for (uint8_t core = 0; core < CPU_LOAD_CORES; core++) {
+        idle_task[core] = xTaskGetIdleTaskHandleForCPU(core);
+#if !RUN_TIME_STATS
+        if (esp_register_freertos_tick_hook_for_cpu(tick_hook, core) != ESP_OK) {
+            LOGE(SYSTEM, "❌ CPU load: no tick hook on core %d", core);
+            return false;
+        }
+#endif
+    }
+    LOGI(SYSTEM, "✅ CPU load from %s", METHOD);
+    return true;
+}
+
+/**
+ * @brief Add a task to the per-task breakdown
+ */
+bool cpu_load_watch(TaskHandle_t task) {
+    uint8_t index = watched_count;
+    if (task == NULL || index == CPU_LOAD_MAX_TASKS) {
+        return false;
+    }
+    BaseType_t affinity = xTaskGetAffinity(task);
+    watched_info[index].name = pcTaskGetName(task);
+    watched_info[index].core = affinity == tskNO_AFFINITY ? -1 : (int8_t)affinity;
+    watched[index] = task;
+    watched_count = index + 1;      // Published last: the tick hooks read it
+    return true;
+}
+
+/**
+ * @brief Close the interval since the previous call and publish its figures
+ */
+void cpu_load_sample(uint32_t now_ms) {
+    counters_t now;
+    if (!read_counters(&now)) {
+        return;
+    }
+
+    if (sampled) {
+        cpu_load_t load = {0};
+        load.interval_ms = now_ms - previous_ms;
+        load.method = METHOD;
+
+        uint32_t core_time[CPU_LOAD_CORES];
+        for (uint8_t core = 0; core < CPU_LOAD_CORES; core++) {
+            core_time[core] = now.core_total[core] - previous.core_total[core];
+            uint32_t idle = min(now.core_idle[core] - previous.core_idle[core], core_time[core]);
+            load.core_pct[core] = core_time[core] > 0 ?
+                100.0f * (core_time[core] - idle) / core_time[core] : 0.0f;
+        }
+
+        // A floating task is measured against core 0's time, which runs at the same rate
+        load.task_count = watched_count;
+        for (uint8_t i = 0; i < load.task_count; i++) {
+            load.tasks[i] = watched_info[i];
+            uint32_t base = core_time[max(watched_info[i].core, (int8_t)0)];
+            uint32_t busy = now.task[i] - previous.task[i];
+            uint32_t on_core1 = min(now.task_core1[i] - previous.task_core1[i], busy);
+            load.tasks[i].busy_pct = base > 0 ? 100.0f * busy / base : 0.0f;
+            if (busy > 0) {
+                load.tasks[i].core_share_pct[1] = (uint8_t)((uint64_t)on_core1 * 100 / busy);
+                load.tasks[i].core_share_pct[0] = 100 - load.tasks[i].core_share_pct[1];
+            }
+        }
+
+        portENTER_CRITICAL(&load_mux);
+        last = load;
+        portEXIT_CRITICAL(&load_mux);
+    }
+
+    previous = now;
+    previous_ms = now_ms;
+    sampled = true;
+}
+
+/**
+ * @brief Figures of the last closed interval
+ */
+void cpu_load_get(cpu_load_t* load) {
+    portENTER_CRITICAL(&load_mux);
+    *load = last;
+    portEXIT_CRITICAL(&load_mux);
+}
+
+/**
+ * @brief One core's busy share of the last closed interval
+ */
+float cpu_load_core_pct(uint8_t core) {
+    if (core >= CPU_LOAD_CORES) {
+        return 0.0f;
+    }
+    portENTER_CRITICAL(&load_mux);
+    float pct = last.core_pct[core];
+    portEXIT_CRITICAL(&load_mux);
+    return pct;
+}
+
+#if RUN_TIME_STATS
+
+/**
+ * @brief Cumulative run time of the idle and watched tasks, in run-time counter units
+ *
+ * Every core runs for the whole of the counter's elapsed time.
+ */
+static bool read_counters(counters_t* now) {
+    uint32_t elapsed = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, CPU_LOAD_STATUS_SLOTS, &elapsed);
+    if (count == 0) {
+        static bool warned = false;
+        if (!warned) {
+            LOGW(SYSTEM, "⚠️  CPU load: more than %d tasks, raise CPU_LOAD_STATUS_SLOTS",
+                 CPU_LOAD_STATUS_SLOTS);
+            warned = true;
+        }
+        return false;
+    }
+
+    memset(now, 0, sizeof(*now));
+    for (uint8_t core = 0; core < CPU_LOAD_CORES; core++) {
+        now->core_total[core] = elapsed;
+    }
+    uint8_t tasks = watched_count;
+    for (UBaseType_t s = 0; s < count; s++) {
+        for (uint8_t core = 0; core < CPU_LOAD_CORES; core++) {
+            if (status[s].xHandle == idle_task[core]) {
+                now->core_idle[core] = status[s].ulRunTimeCounter;
+            }
+        }
+        for (uint8_t i = 0; i < tasks; i++) {
+            if (status[s].xHandle == watched[i]) {
+                now->task[i] = status[s].ulRunTimeCounter;
+                // The counters do not say where a floating task ran
+                now->task_core1[i] = watched_info[i].core == 1 ? now->task[i] : 0;
+            }
+        }
+    }
+    return true;
+}
+
+#else
+
+/**
+ * @brief Tick counts so far
+ *
+ * Each core's hook writes its own core's counters and those of the tasks
+ * pinned to it; a floating task may lose the odd tick to both at once.
+ */
+static bool read_counters(counters_t* now) {
+    for (uint8_t core = 0; core < CPU_LOAD_CORES; core++) {
+        now->core_total[core] = ticks.core_total[core];
+        now->core_idle[core] = ticks.core_idle[core];
+    }
+    for (uint8_t i = 0; i < CPU_LOAD_MAX_TASKS; i++) {
+        now->task[i] = ticks.task[i];
+        now->task_core1[i] = ticks.task_core1[i];
+    }
+    return true;
+}
+
+/**
+ * @brief Tick interrupt on either core: charge the tick to the task it interrupted
+ */
+static void IRAM_ATTR tick_hook(void) {
+    BaseType_t core = xPortGetCoreID();
+    TaskHandle_t current = xTaskGetCurrentTaskHandleForCPU(core);
+    ticks.core_total[core]++;
+    if (current == idle_task[core]) {
+        ticks.core_idle[core]++;
+        return;
+    }
+    uint8_t tasks = watched_count;
+    for (uint8_t i = 0; i < tasks; i++) {
+        if (current == watched[i]) {
+            ticks.task[i]++;
+            if (core == 1) {
+                ticks.task_core1[i]++;
+            }
+            return;
+        }
+    }
+}
+
+#endif // RUN_TIME_STATS
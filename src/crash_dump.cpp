@@ -0,0 +1,396 @@
+/**
+ * @file crash_dump.cpp
+ * @brief Core dump and crash-time event trace, kept for the next boot to upload
+ *
+ * The core dump is written by ESP-IDF's panic handler into the coredump
+ * partition (CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH, set in the Arduino
+ * core's build) and stays there until the next crash, so it is read
+ * straight from flash whenever it is asked for; invalidating it takes an
+ * erase of its first sector. Its last four bytes are the tail of its
+ * checksum, which names the crash: an image whose name the journal holds
+ * has been uploaded before.
+ *
+ * Reads of either part and clearing them go through one lock, so a
+ * download on the web server's task or a publish on the uplink's never
+ * reads a part being dropped.
+ */
+
+#include <Arduino.h>
+#include <esp_system.h>
+#include <esp_attr.h>
+#include <esp_partition.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "crash_dump.h"
+#include "event_trace.h"
+#include "journal.h"
+#include "logger.h"
+
+#if CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH
+#include <esp_core_dump.h>
+#endif
+
+#define CRASH_NOTE_MAGIC        0x45544F4Eu     // "NOTE"
+#define CRASH_JOURNAL_KEY       "crash"
+#define CRASH_CORE_SECTOR       4096
+
+/**
+ * @brief The supervisor's reason, kept through its reboot
+ */
+typedef struct {
+    uint32_t magic;
+    char     text[CRASH_NOTE_BYTES];
+} crash_note_t;
+
+__NOINIT_ATTR static crash_note_t note;
+
+static crash_status_t status;
+static SemaphoreHandle_t crash_lock = NULL;
+static StaticSemaphore_t crash_lock_state;
+static const esp_partition_t* core_partition = NULL;
+static uint32_t core_offset = 0;                // Of the image in the partition
+static bool read_done = false;
+static uint32_t uploaded_id = 0;                // Core dump the broker has, from the journal
+static bool uploaded_dirty = false;
+
+// Upload cursor: the piece crash_dump_chunk() hands out until acknowledged
+static uint8_t upload_part = CRASH_PART_TRACE;
+static uint32_t upload_offset = 0;
+static uint16_t upload_length = 0;
+
+// Forward declarations
+static void read_core(void);
+static uint32_t part_size(crash_part_t part);
+static size_t read_part(crash_part_t part, uint32_t offset, uint8_t* out, size_t length);
+static void clear(void);
+static void on_get(AsyncWebServerRequest* request);
+static void on_post(AsyncWebServerRequest* request);
+
+/**
+ * @brief Find out whether the last boot crashed and start the event trace
+ */
+void crash_dump_init(void) {
+    memset(&status, 0, sizeof(status));
+    if (crash_lock == NULL) {
+        crash_lock = xSemaphoreCreateMutexStatic(&crash_lock_state);
+    }
+
+    esp_reset_reason_t reason = esp_reset_reason();
+    status.reset_reason = (uint8_t)reason;
+    bool noted = reason == ESP_RST_SW && note.magic == CRASH_NOTE_MAGIC;
+    if (noted) {
+        memcpy(status.note, note.text, sizeof(status.note));
+        status.note[sizeof(status.note) - 1] = '\0';
+    }
+    note.magic = 0;
+    status.crashed = noted || reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT ||
+                     reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT;
+
+#if EVENT_TRACE_ENABLED
+    status.trace_present = event_trace_init(status.crashed);
+#endif
+    status.crash_id = esp_random();     // Replaced by the core dump's, if there is one
+}
+
+/**
+ * @brief Leave a reason for the reboot that follows
+ */
+void crash_dump_note(const char* reason) {
+    strlcpy(note.text, reason, sizeof(note.text));
+    note.magic = CRASH_NOTE_MAGIC;
+}
+
+/**
+ * @brief Read the core dump, name the kept trace's tasks, remember uploads
+ */
+void crash_dump_tick(uint32_t now_ms) {
+    if (!read_done) {
+        read_done = true;
+        if (journal_get(CRASH_JOURNAL_KEY, &uploaded_id, sizeof(uploaded_id)) != sizeof(uploaded_id)) {
+            Preferences prefs;
+            if (prefs.begin(CRASH_NVS_NAMESPACE, true)) {
+                uploaded_id = prefs.getUInt("uploaded", 0);
+                prefs.end();
+            }
+        }
+        read_core();
+    }
+
+#if EVENT_TRACE_ENABLED
+    // Every task exists by the system task's first pass
+    if (status.trace_present && status.trace_bytes == 0 && event_trace_postmortem_seal()) {
+        xSemaphoreTake(crash_lock, portMAX_DELAY);
+        status.trace_bytes = event_trace_postmortem_size();
+        xSemaphoreGive(crash_lock);
+    }
+#endif
+
+    if (uploaded_dirty) {
+        uploaded_dirty = false;
+        uint32_t id = uploaded_id;
+        if (!journal_put(CRASH_JOURNAL_KEY, &id, sizeof(id))) {
+            Preferences prefs;
+            if (prefs.begin(CRASH_NVS_NAMESPACE, false)) {
+                prefs.putUInt("uploaded", id);
+                prefs.end();
+            }
+        }
+    }
+}
+
+/**
+ * @brief Add the crash route to the web server
+ */
+void crash_dump_register(AsyncWebServer* server) {
+    server->on(CRASH_PATH, HTTP_GET, on_get);
+    server->on(CRASH_PATH, HTTP_POST, on_post);
+}
+
+/**
+ * @brief Next piece to publish, header included
+ */
+size_t crash_dump_chunk(uint8_t* out, size_t size) {
+    if (!read_done || size <= sizeof(crash_chunk_header_t)) {
+        return 0;
+    }
+
+    xSemaphoreTake(crash_lock, portMAX_DELAY);
+    size_t length = 0;
+    while (upload_part < CRASH_PARTS) {
+        crash_part_t part = (crash_part_t)upload_part;
+        bool wanted = part == CRASH_PART_TRACE ? status.trace_bytes > 0
+                                               : status.core_present && status.crash_id != uploaded_id;
+        uint32_t total = part_size(part);
+        if (!wanted || upload_offset >= total) {
+            upload_part++;
+            upload_offset = 0;
+            continue;
+        }
+
+        crash_chunk_header_t header;
+        header.magic = CRASH_CHUNK_MAGIC;
+        header.part = part;
+        header.format = CRASH_CHUNK_FORMAT;
+        header.crash_id = status.crash_id;
+        header.offset = upload_offset;
+        header.total = total;
+        size_t want = min((size_t)min(total - upload_offset, (uint32_t)CRASH_MQTT_CHUNK_BYTES),
+                          size - sizeof(header));
+        header.length = (uint16_t)read_part(part, upload_offset, out + sizeof(header), want);
+        if (header.length == 0) {
+            break;                  // Flash read failed; tried again next time
+        }
+        memcpy(out, &header, sizeof(header));
+        upload_length = header.length;
+        length = sizeof(header) + header.length;
+        break;
+    }
+    if (upload_part >= CRASH_PARTS && !status.uploaded &&
+        (status.trace_bytes > 0 || status.core_present)) {
+        status.uploaded = true;
+        LOGI(SYSTEM, "✅ Crash %08lx uploaded", (unsigned long)status.crash_id);
+    }
+    xSemaphoreGive(crash_lock);
+    return length;
+}
+
+/**
+ * @brief The broker has the piece crash_dump_chunk() last returned
+ */
+void crash_dump_chunk_acked(void) {
+    xSemaphoreTake(crash_lock, portMAX_DELAY);
+    upload_offset += upload_length;
+    upload_length = 0;
+    status.chunks_sent++;
+    if (upload_part == CRASH_PART_CORE && upload_offset >= status.core_bytes) {
+        uploaded_id = status.crash_id;
+        uploaded_dirty = true;      // To the journal on the system task
+    }
+    xSemaphoreGive(crash_lock);
+}
+
+/**
+ * @brief Copy the crash status
+ */
+void crash_dump_get_status(crash_status_t* out) {
+    if (crash_lock == NULL) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(crash_lock, portMAX_DELAY);
+    *out = status;
+    xSemaphoreGive(crash_lock);
+}
+
+/**
+ * @brief Locate a valid core dump and log what it says
+ */
+static void read_core(void) {
+#if CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH
+    core_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                              ESP_PARTITION_SUBTYPE_DATA_COREDUMP, NULL);
+    size_t address = 0;
+    size_t size = 0;
+    if (core_partition == NULL) {
+        LOGW(SYSTEM, "⚠️  No coredump partition - crashes keep only the event trace");
+    } else if (esp_core_dump_image_get(&address, &size) == ESP_OK && size > sizeof(uint32_t) &&
+               address >= core_partition->address &&
+               address + size <= core_partition->address + core_partition->size) {
+        uint32_t tail = 0;
+        core_offset = address - core_partition->address;
+        if (esp_partition_read(core_partition, core_offset + size - sizeof(tail), &tail, sizeof(tail)) == ESP_OK) {
+            xSemaphoreTake(crash_lock, portMAX_DELAY);
+            status.core_present = true;
+            status.core_bytes = size;
+            status.crash_id = tail;
+            status.uploaded = tail == uploaded_id;
+            xSemaphoreGive(crash_lock);
+        }
+    }
+
+#if CONFIG_ESP_COREDUMP_DATA_FORMAT_ELF
+    esp_core_dump_summary_t* summary = (esp_core_dump_summary_t*)malloc(sizeof(esp_core_dump_summary_t));
+    if (status.core_present && summary != NULL && esp_core_dump_get_summary(summary) == ESP_OK) {
+        xSemaphoreTake(crash_lock, portMAX_DELAY);
+        strlcpy(status.task, summary->exc_task, sizeof(status.task));
+        status.pc = summary->exc_pc;
+        status.backtrace_depth = (uint8_t)min(summary->exc_bt_info.depth, (uint32_t)CRASH_BACKTRACE_DEPTH);
+        for (uint8_t i = 0; i < status.backtrace_depth; i++) {
+            status.backtrace[i] = summary->exc_bt_info.bt[i];
+        }
+        xSemaphoreGive(crash_lock);
+    }
+    free(summary);
+#endif
+#endif
+
+    if (status.core_present) {
+        // The same line the console decoder would have printed, for addr2line
+        char trace[CRASH_BACKTRACE_DEPTH * 11 + 1];
+        size_t len = 0;
+        trace[0] = '\0';
+        for (uint8_t i = 0; i < status.backtrace_depth; i++) {
+            len += snprintf(trace + len, sizeof(trace) - len, " 0x%08lx", (unsigned long)status.backtrace[i]);
+        }
+        LOGE(SYSTEM, "💥 Core dump %08lx (%lu bytes%s): task %s, PC 0x%08lx, backtrace:%s",
+             (unsigned long)status.crash_id, (unsigned long)status.core_bytes,
+             status.uploaded ? ", uploaded" : "", status.task[0] ? status.task : "?",
+             (unsigned long)status.pc, len > 0 ? trace : " none");
+    }
+    if (status.crashed) {
+        LOGE(SYSTEM, "💥 Boot after a crash (reset reason %u)%s%s; event trace %s",
+             status.reset_reason, status.note[0] ? ": " : "", status.note,
+             status.trace_present ? "kept" : "lost");
+    }
+}
+
+/**
+ * @brief Bytes in a part, 0 with none
+ */
+static uint32_t part_size(crash_part_t part) {
+    return part == CRASH_PART_TRACE ? status.trace_bytes
+                                    : status.core_present ? status.core_bytes : 0;
+}
+
+/**
+ * @brief Copy part of a part; called with the lock held
+ */
+static size_t read_part(crash_part_t part, uint32_t offset, uint8_t* out, size_t length) {
+    uint32_t total = part_size(part);
+    if (offset >= total) {
+        return 0;
+    }
+    length = min(length, (size_t)(total - offset));
+    if (part == CRASH_PART_TRACE) {
+#if EVENT_TRACE_ENABLED
+        return event_trace_postmortem_read(offset, out, length);
+#else
+        return 0;
+#endif
+    }
+    return esp_partition_read(core_partition, core_offset + offset, out, length) == ESP_OK ? length : 0;
+}
+
+/**
+ * @brief Drop both parts: the kept trace and the core dump's first sector
+ */
+static void clear(void) {
+    xSemaphoreTake(crash_lock, portMAX_DELAY);
+#if EVENT_TRACE_ENABLED
+    event_trace_postmortem_drop();
+#endif
+    if (status.core_present) {
+        esp_partition_erase_range(core_partition, core_offset & ~(CRASH_CORE_SECTOR - 1), CRASH_CORE_SECTOR);
+    }
+    status.trace_present = false;
+    status.trace_bytes = 0;
+    status.core_present = false;
+    status.core_bytes = 0;
+    upload_part = CRASH_PARTS;
+    xSemaphoreGive(crash_lock);
+    LOGI(SYSTEM, "🧹 Crash dump cleared");
+}
+
+/**
+ * @brief The summary as JSON, or ?part=core|trace as the raw bytes
+ */
+static void on_get(AsyncWebServerRequest* request) {
+    if (request->hasParam("part")) {
+        const String& name = request->getParam("part")->value();
+        crash_part_t part = name == "core" ? CRASH_PART_CORE : name == "trace" ? CRASH_PART_TRACE : CRASH_PARTS;
+        if (part == CRASH_PARTS) {
+            request->send(400, "text/plain", "part=core or part=trace\n");
+            return;
+        }
+        xSemaphoreTake(crash_lock, portMAX_DELAY);
+        uint32_t total = part_size(part);
+        if (total > 0) {
+            status.downloads++;
+        }
+        xSemaphoreGive(crash_lock);
+        if (total == 0) {
+            request->send(404, "text/plain", "none kept\n");
+            return;
+        }
+        AsyncWebServerResponse* response = request->beginResponse("application/octet-stream", total,
+            [part](uint8_t* out, size_t max_len, size_t index) -> size_t {
+                xSemaphoreTake(crash_lock, portMAX_DELAY);
+                size_t n = read_part(part, index, out, max_len);
+                xSemaphoreGive(crash_lock);
+                return n;
+            });
+        response->addHeader("Content-Disposition", part == CRASH_PART_CORE
+                            ? "attachment; filename=\"core.bin\"" : "attachment; filename=\"crash.hev\"");
+        request->send(response);
+        return;
+    }
+
+    crash_status_t crash;
+    crash_dump_get_status(&crash);
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"crashed\":%s,\"reset_reason\":%u,\"note\":\"%s\",\"crash_id\":\"%08lx\","
+                     "\"core_bytes\":%lu,\"trace_bytes\":%lu,\"uploaded\":%s,\"task\":\"%s\","
+                     "\"pc\":\"0x%08lx\",\"backtrace\":[",
+                     crash.crashed ? "true" : "false", crash.reset_reason, crash.note, crash.crash_id,
+                     crash.core_present ? crash.core_bytes : 0, crash.trace_bytes,
+                     crash.uploaded ? "true" : "false", crash.task, crash.pc);
+    for (uint8_t i = 0; i < crash.backtrace_depth; i++) {
+        response->printf("%s\"0x%08lx\"", i > 0 ? "," : "", crash.backtrace[i]);
+    }
+    response->printf("],\"chunks_sent\":%lu,\"downloads\":%lu}", crash.chunks_sent, crash.downloads);
+    request->send(response);
+}
+
+/**
+ * @brief clear=1: forget the crash once it is safely elsewhere
+ */
+static void on_post(AsyncWebServerRequest* request) {
+    if (!request->hasParam("clear", true)) {
+        request->send(400, "text/plain", "clear=1 required\n");
+        return;
+    }
+    clear();
+    request->send(200, "text/plain", "cleared\n");
+}
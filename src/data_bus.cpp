@@ -0,0 +1,175 @@
+/**
+ * @file data_bus.cpp
+ * @brief Single-writer publication slots with seqlock readers and notifications
+ *
+ * Every topic has two slots and a version counter whose low bit selects
+ * the published one. Its one writer fills the other slot and publishes it
+ * by incrementing the version; readers copy the published slot and retry
+ * if the version moved during the copy. A release fence between the bump
+ * and the next fill, paired with the readers' acquire fence before their
+ * recheck, keeps a torn copy from passing it. With one writer per topic no
+ * lock is needed on either side, so a high-priority reader can never wait
+ * on a low-priority writer. Subscribers get their notification bits set
+ * after every publication.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "data_bus.h"
+#include "logger.h"
+
+typedef struct {
+    TaskHandle_t task;
+    uint32_t     bits;
+} bus_subscriber_t;
+
+typedef struct {
+    const char*       name;
+    uint8_t*          slots;            // Two payloads back to back
+    size_t            size;
+    volatile uint32_t version;
+    TaskHandle_t      writer;
+    uint32_t          read_retries;
+    uint32_t          rejected_writes;
+    bus_subscriber_t  subscribers[DATA_BUS_SUBSCRIBERS_MAX];
+    volatile uint8_t  subscriber_count;
+} bus_topic_state_t;
+
+static sensor_snapshot_t      scan_slots[2];
+static system_publication_t   system_slots[2];
+static capture_publication_t  capture_slots[2];
+static ai_state_publication_t ai_state_slots[2];
+static i2c_publication_t      i2c_slots[2];
+static input_publication_t    input_slots[2];
+
+// In bus_topic_t order
+static bus_topic_state_t topics[BUS_TOPIC_COUNT] = {
+    { "scan",     (uint8_t*)scan_slots,     sizeof(scan_slots[0]) },
+    { "system",   (uint8_t*)system_slots,   sizeof(system_slots[0]) },
+    { "capture",  (uint8_t*)capture_slots,  sizeof(capture_slots[0]) },
+    { "ai_state", (uint8_t*)ai_state_slots, sizeof(ai_state_slots[0]) },
+    { "i2c",      (uint8_t*)i2c_slots,      sizeof(i2c_slots[0]) },
+    { "input",    (uint8_t*)input_slots,    sizeof(input_slots[0]) }
+};
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Clear every topic
+ */
+bool data_bus_init(void) {
+    for (uint8_t i = 0; i < BUS_TOPIC_COUNT; i++) {
+        bus_topic_state_t* topic = &topics[i];
+        memset(topic->slots, 0, topic->size * 2);
+        topic->version = 0;
+        topic->writer = NULL;
+        topic->subscriber_count = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Open a topic's inactive slot for writing
+ */
+void* data_bus_begin_publish(bus_topic_t topic_id) {
+    bus_topic_state_t* topic = &topics[topic_id];
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (topic->writer == NULL) {
+        topic->writer = self;
+    } else if (topic->writer != self) {
+        portENTER_CRITICAL(&stats_mux);
+        topic->rejected_writes++;
+        portEXIT_CRITICAL(&stats_mux);
+        LOGE(SYSTEM, "❌ Bus topic %s written by %s, owned by %s", topic->name,
+             pcTaskGetName(self), pcTaskGetName(topic->writer));
+        return NULL;
+    }
+
+    // The inactive slot is the one published before the last version bump,
+    // which a reader may still be copying: its recheck only catches the
+    // writes below if they cannot become visible before that bump
+    uint32_t version = topic->version;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    uint8_t* next = topic->slots + ((version + 1) & 1) * topic->size;
+    memcpy(next, topic->slots + (version & 1) * topic->size, topic->size);
+    return next;
+}
+
+/**
+ * @brief Publish the slot opened by data_bus_begin_publish() and wake subscribers
+ */
+void data_bus_publish(bus_topic_t topic_id) {
+    bus_topic_state_t* topic = &topics[topic_id];
+    __atomic_store_n(&topic->version, topic->version + 1, __ATOMIC_RELEASE);
+
+    uint8_t count = __atomic_load_n(&topic->subscriber_count, __ATOMIC_ACQUIRE);
+    for (uint8_t i = 0; i < count; i++) {
+        xTaskNotify(topic->subscribers[i].task, topic->subscribers[i].bits, eSetBits);
+    }
+}
+
+/**
+ * @brief Copy part of a topic's latest publication without blocking
+ */
+uint32_t data_bus_read(bus_topic_t topic_id, void* out, size_t offset, size_t length) {
+    bus_topic_state_t* topic = &topics[topic_id];
+    uint32_t before, after;
+    uint32_t retries = 0;
+    while (true) {
+        before = __atomic_load_n(&topic->version, __ATOMIC_ACQUIRE);
+        memcpy(out, topic->slots + (before & 1) * topic->size + offset, length);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&topic->version, __ATOMIC_RELAXED);
+        if (before == after) {
+            break;
+        }
+        retries++;
+    }
+    if (retries > 0) {
+        portENTER_CRITICAL(&stats_mux);
+        topic->read_retries += retries;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+    return before;
+}
+
+/**
+ * @brief Version of a topic, incremented on every publication
+ */
+uint32_t data_bus_version(bus_topic_t topic_id) {
+    return __atomic_load_n(&topics[topic_id].version, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Notify a task with these bits on every publication
+ */
+bool data_bus_subscribe(bus_topic_t topic_id, TaskHandle_t task, uint32_t bits) {
+    bus_topic_state_t* topic = &topics[topic_id];
+    bool added = false;
+    portENTER_CRITICAL(&stats_mux);
+    uint8_t count = topic->subscriber_count;
+    if (count < DATA_BUS_SUBSCRIBERS_MAX) {
+        topic->subscribers[count].task = task;
+        topic->subscribers[count].bits = bits;
+        // The entry is complete before publishers can see it
+        __atomic_store_n(&topic->subscriber_count, count + 1, __ATOMIC_RELEASE);
+        added = true;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+    return added;
+}
+
+/**
+ * @brief Copy one topic's figures
+ */
+void data_bus_get_stats(bus_topic_t topic_id, bus_topic_stats_t* out) {
+    const bus_topic_state_t* topic = &topics[topic_id];
+    portENTER_CRITICAL(&stats_mux);
+    out->name = topic->name;
+    out->version = topic->version;
+    out->read_retries = topic->read_retries;
+    out->rejected_writes = topic->rejected_writes;
+    out->subscribers = topic->subscriber_count;
+    portEXIT_CRITICAL(&stats_mux);
+}
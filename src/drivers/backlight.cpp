@@ -0,0 +1,257 @@
+/**
+ * @file backlight.cpp
+ * @brief LEDC backlight with hardware fades, an AI state curve and an hourly schedule
+ *
+ * The backlight is the largest load on a battery unit. Its target is the
+ * AI state's level from the resource governor's table, capped by this
+ * unit's hourly schedule once the wall clock is set and scaled to the
+ * room's light when a light sensor is fitted; an interaction overrides
+ * the first two with the room's full brightness for a while. Levels are perceived
+ * brightness and map to duty through a square law, so 5% still reads but
+ * draws a fraction of it.
+ *
+ * Fades run in the LEDC peripheral. The IDF fade call blocks while the
+ * previous fade is still running, so a new one is only started after the
+ * last one has ended.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <driver/ledc.h>
+#include <time.h>
+#include "config.h"
+#include "backlight.h"
+#include "governor.h"
+#include "ambient.h"
+#include "tunables.h"
+#include "logger.h"
+
+#define BACKLIGHT_MAX_DUTY ((1UL << BACKLIGHT_PWM_BITS) - 1)
+
+static uint8_t schedule[BACKLIGHT_SCHEDULE_HOURS];
+static ai_state_t state = AI_STATE_IDLE;
+static bool interaction = false;
+static uint32_t interaction_ms = 0;
+static uint8_t level_pct = 0;               // Target of the last fade started
+static uint32_t fade_end_ms = 0;
+static uint32_t fades = 0;
+static bool ready = false;
+static bool standby = false;                // PWM output stopped
+
+// Forward declarations
+static uint8_t schedule_cap(uint32_t* next_change_ms);
+static uint8_t target_pct(uint32_t now_ms, uint32_t* wait_ms);
+static uint32_t pct_to_duty(uint8_t pct);
+static void load_schedule(void);
+
+/**
+ * @brief Attach BOARD.display.bl to an LEDC channel and light the panel at full brightness
+ */
+bool backlight_init(void) {
+    ledc_timer_config_t timer;
+    memset(&timer, 0, sizeof(timer));
+    timer.speed_mode = LEDC_LOW_SPEED_MODE;
+    timer.duty_resolution = (ledc_timer_bit_t)BACKLIGHT_PWM_BITS;
+    timer.timer_num = (ledc_timer_t)BACKLIGHT_LEDC_TIMER;
+    timer.freq_hz = BACKLIGHT_PWM_HZ;
+    timer.clk_cfg = LEDC_AUTO_CLK;
+
+    ledc_channel_config_t channel;
+    memset(&channel, 0, sizeof(channel));
+    channel.gpio_num = BOARD.display.bl;
+    channel.speed_mode = LEDC_LOW_SPEED_MODE;
+    channel.channel = (ledc_channel_t)BACKLIGHT_LEDC_CHANNEL;
+    channel.intr_type = LEDC_INTR_DISABLE;
+    channel.timer_sel = (ledc_timer_t)BACKLIGHT_LEDC_TIMER;
+    channel.duty = pct_to_duty(100);
+
+    if (ledc_timer_config(&timer) != ESP_OK || ledc_channel_config(&channel) != ESP_OK ||
+        ledc_fade_func_install(0) != ESP_OK) {
+        LOGE(UI, "❌ Backlight PWM unavailable");
+        return false;
+    }
+
+    load_schedule();
+    level_pct = 100;
+    ready = true;
+    LOGI(UI, "✅ Backlight PWM: %d Hz, %d-bit", BACKLIGHT_PWM_HZ, BACKLIGHT_PWM_BITS);
+    return true;
+}
+
+/**
+ * @brief Follow the brightness curve of a newly committed AI state
+ */
+void backlight_set_state(ai_state_t new_state) {
+    if (new_state < AI_STATE_COUNT) {
+        state = new_state;
+    }
+}
+
+/**
+ * @brief Full brightness for the room for TUNABLE_BACKLIGHT_INTERACTION_MS, e.g. on a touch
+ */
+void backlight_interaction(uint32_t now_ms) {
+    interaction = true;
+    interaction_ms = now_ms;
+}
+
+/**
+ * @brief Fade towards the current target; call from the UI task
+ */
+uint32_t backlight_update(uint32_t now_ms) {
+    if (!ready || standby) {
+        return UINT32_MAX;
+    }
+
+    uint32_t wait_ms;
+    uint8_t target = target_pct(now_ms, &wait_ms);
+    if (target == level_pct) {
+        return wait_ms;
+    }
+
+    int32_t fading_ms = (int32_t)(fade_end_ms - now_ms);
+    if (fading_ms > 0) {
+        return min(wait_ms, (uint32_t)fading_ms);
+    }
+
+    uint32_t fade_ms = target > level_pct ? BACKLIGHT_FADE_UP_MS : BACKLIGHT_FADE_DOWN_MS;
+    if (ledc_set_fade_time_and_start(LEDC_LOW_SPEED_MODE, (ledc_channel_t)BACKLIGHT_LEDC_CHANNEL,
+                                     pct_to_duty(target), fade_ms, LEDC_FADE_NO_WAIT) == ESP_OK) {
+        level_pct = target;
+        fade_end_ms = now_ms + fade_ms;
+        fades++;
+    }
+    return wait_ms;
+}
+
+/**
+ * @brief Switch the PWM output off for panel standby, or back on
+ */
+bool backlight_standby(bool enter, uint32_t now_ms) {
+    if (!ready || enter == standby) {
+        return true;
+    }
+
+    const ledc_channel_t channel = (ledc_channel_t)BACKLIGHT_LEDC_CHANNEL;
+    if (enter) {
+        // A fade in flight would keep rewriting the duty from its ISR
+        if ((int32_t)(fade_end_ms - now_ms) > 0) {
+            return false;
+        }
+        ledc_stop(LEDC_LOW_SPEED_MODE, channel, 0);
+    } else {
+        ledc_set_duty(LEDC_LOW_SPEED_MODE, channel, 0);
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, channel);
+        level_pct = 0;
+        fade_end_ms = now_ms;
+    }
+    standby = enter;
+    return true;
+}
+
+/**
+ * @brief Copy the hourly brightness caps, in percent, indexed by local hour
+ */
+void backlight_get_schedule(uint8_t out[BACKLIGHT_SCHEDULE_HOURS]) {
+    memcpy(out, schedule, sizeof(schedule));
+}
+
+/**
+ * @brief Replace the hourly caps and persist them in NVS
+ */
+bool backlight_set_schedule(const uint8_t in[BACKLIGHT_SCHEDULE_HOURS]) {
+    for (uint8_t hour = 0; hour < BACKLIGHT_SCHEDULE_HOURS; hour++) {
+        if (in[hour] > 100) {
+            return false;
+        }
+    }
+    // Byte stores: a reader sees each hour either old or new
+    memcpy(schedule, in, sizeof(schedule));
+
+    Preferences prefs;
+    if (!prefs.begin(BACKLIGHT_NVS_NAMESPACE, false)) {
+        return false;
+    }
+    bool ok = prefs.putBytes("schedule", schedule, sizeof(schedule)) == sizeof(schedule);
+    prefs.end();
+    return ok;
+}
+
+/**
+ * @brief Current target and its inputs
+ */
+void backlight_get_status(backlight_status_t* status) {
+    uint32_t next_change_ms;
+    status->level_pct = standby ? 0 : level_pct;
+    status->state_pct = governor_profile_for(state)->backlight_pct;
+    status->schedule_pct = schedule_cap(&next_change_ms);
+    status->ambient_pct = ambient_backlight_pct();
+    status->interaction = interaction;
+    status->fades = fades;
+}
+
+/**
+ * @brief Cap for the current local hour, 100 until the wall clock is set
+ * @param next_change_ms Receives the time until the hour changes
+ */
+static uint8_t schedule_cap(uint32_t* next_change_ms) {
+    *next_change_ms = UINT32_MAX;
+    time_t now = time(NULL);
+    if (now <= AI_FEATURE_MIN_EPOCH) {
+        return 100;
+    }
+
+    struct tm local;
+    localtime_r(&now, &local);
+    *next_change_ms = (3600UL - local.tm_min * 60UL - local.tm_sec) * 1000UL;
+    return schedule[local.tm_hour];
+}
+
+/**
+ * @brief Brightness wanted now and how long it holds
+ */
+static uint8_t target_pct(uint32_t now_ms, uint32_t* wait_ms) {
+    if (interaction) {
+        uint32_t elapsed = now_ms - interaction_ms;
+        uint32_t hold_ms = (uint32_t)tunable_get(TUNABLE_BACKLIGHT_INTERACTION_MS);
+        if (elapsed < hold_ms) {
+            *wait_ms = hold_ms - elapsed;
+            return max(ambient_backlight_pct(), (uint8_t)BACKLIGHT_MIN_PCT);
+        }
+        interaction = false;
+    }
+
+    uint8_t pct = governor_profile_for(state)->backlight_pct * schedule_cap(wait_ms) / 100 *
+                  ambient_backlight_pct() / 100;
+    return max(pct, (uint8_t)BACKLIGHT_MIN_PCT);
+}
+
+/**
+ * @brief Perceived brightness to PWM duty (square law)
+ */
+static uint32_t pct_to_duty(uint8_t pct) {
+    return BACKLIGHT_MAX_DUTY * pct * pct / 10000UL;
+}
+
+/**
+ * @brief Restore the hourly caps, all 100% if none are stored
+ */
+static void load_schedule(void) {
+    memset(schedule, 100, sizeof(schedule));
+
+    uint8_t stored[BACKLIGHT_SCHEDULE_HOURS];
+    Preferences prefs;
+    if (!prefs.begin(BACKLIGHT_NVS_NAMESPACE, true)) {
+        return;
+    }
+    bool ok = prefs.getBytes("schedule", stored, sizeof(stored)) == sizeof(stored);
+    prefs.end();
+
+    for (uint8_t hour = 0; ok && hour < BACKLIGHT_SCHEDULE_HOURS; hour++) {
+        ok = stored[hour] <= 100;
+    }
+    if (ok) {
+        memcpy(schedule, stored, sizeof(schedule));
+        LOGI(UI, "✅ Backlight schedule restored");
+    }
+}
@@ -0,0 +1,334 @@
+/**
+ * @file gps.cpp
+ * @brief Incremental NMEA parsing from a UART receiver
+ *
+ * Characters go into a line buffer as they arrive; a complete line has its
+ * checksum checked and its fields split in place, and RMC and GGA update
+ * the fix. Nothing is allocated and no float is parsed: coordinates are
+ * read as integer degrees, minutes and decimal digits straight into
+ * degrees x 1e7, which keeps a receiver's full resolution.
+ */
+
+#include <Arduino.h>
+#include <driver/uart.h>
+#include "config.h"
+#include "board.h"
+#include "gps.h"
+#include "logger.h"
+
+#define NMEA_LINE_MAX    82         // '$' to checksum, without CR LF
+#define NMEA_FIELDS_MAX  20
+
+static char line[NMEA_LINE_MAX + 1];
+static uint8_t line_length = 0;
+static bool in_line = false;
+static bool overlong = false;
+static uint8_t gga_quality = 0;
+static bool gga_seen = false;
+
+static gps_fix_t fix;
+static gps_stats_t stats;
+static portMUX_TYPE gps_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void take_line(void);
+static bool checksum_ok(void);
+static void take_rmc(char** fields, uint8_t count);
+static void take_gga(char** fields, uint8_t count);
+static bool parse_coordinate(const char* text, const char* hemisphere, uint8_t degree_digits, int32_t* e7);
+static int32_t parse_fixed(const char* text, uint8_t decimals);
+static uint32_t parse_utc(const char* time, const char* date);
+
+/**
+ * @brief Install the UART driver on BOARD.gps
+ */
+bool gps_init(void) {
+    if (BOARD.gps.rx < 0) {
+        LOGW(SCAN, "⚠️  No GPS pins on this board");
+        return false;
+    }
+
+    uart_config_t config = {};
+    config.baud_rate = GPS_BAUD;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    config.source_clk = UART_SCLK_APB;
+    if (uart_driver_install((uart_port_t)GPS_UART_NUM, GPS_RX_BUFFER_BYTES, 0, 0, NULL, 0) != ESP_OK ||
+        uart_param_config((uart_port_t)GPS_UART_NUM, &config) != ESP_OK ||
+        uart_set_pin((uart_port_t)GPS_UART_NUM, BOARD.gps.tx, BOARD.gps.rx,
+                     UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+        LOGE(SCAN, "❌ GPS UART%d setup failed", GPS_UART_NUM);
+        return false;
+    }
+
+    portENTER_CRITICAL(&gps_mux);
+    stats.running = true;
+    portEXIT_CRITICAL(&gps_mux);
+    LOGI(SCAN, "✅ GPS on UART%d, RX %d, %d baud", GPS_UART_NUM, BOARD.gps.rx, GPS_BAUD);
+    return true;
+}
+
+/**
+ * @brief Read what the UART has and parse it
+ */
+void gps_poll(void) {
+    static uint8_t chunk[GPS_READ_CHUNK];
+    int read = uart_read_bytes((uart_port_t)GPS_UART_NUM, chunk, sizeof(chunk),
+                               pdMS_TO_TICKS(GPS_READ_TIMEOUT_MS));
+    if (read > 0) {
+        gps_feed(chunk, read);
+    }
+}
+
+/**
+ * @brief Parse NMEA bytes, one character at a time
+ */
+void gps_feed(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char c = (char)data[i];
+        if (c == '$') {
+            // A new sentence, whatever the last one left behind
+            in_line = true;
+            overlong = false;
+            line_length = 0;
+        } else if (!in_line || c == '\r') {
+            continue;
+        } else if (c == '\n') {
+            in_line = false;
+            line[line_length] = '\0';
+            if (overlong) {
+                portENTER_CRITICAL(&gps_mux);
+                stats.overlong++;
+                portEXIT_CRITICAL(&gps_mux);
+            } else {
+                take_line();
+            }
+            continue;
+        }
+        if (line_length < NMEA_LINE_MAX) {
+            line[line_length++] = c;
+        } else {
+            overlong = true;
+        }
+    }
+
+    portENTER_CRITICAL(&gps_mux);
+    stats.bytes += length;
+    portEXIT_CRITICAL(&gps_mux);
+}
+
+/**
+ * @brief Copy the latest fix, if it is one and still fresh
+ */
+bool gps_get_fix(gps_fix_t* out) {
+    portENTER_CRITICAL(&gps_mux);
+    *out = fix;
+    portEXIT_CRITICAL(&gps_mux);
+    return out->valid && out->fix_ms != 0 && millis() - out->fix_ms <= GPS_FIX_STALE_MS;
+}
+
+/**
+ * @brief Copy the receiver's figures
+ */
+void gps_get_stats(gps_stats_t* out) {
+    portENTER_CRITICAL(&gps_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&gps_mux);
+}
+
+/**
+ * @brief Check a complete line and hand RMC and GGA to their parsers
+ */
+static void take_line(void) {
+    if (!checksum_ok()) {
+        portENTER_CRITICAL(&gps_mux);
+        stats.checksum_errors++;
+        portEXIT_CRITICAL(&gps_mux);
+        return;
+    }
+
+    // Split "$GNRMC,f1,f2,...*HH" in place; empty fields stay empty strings
+    char* fields[NMEA_FIELDS_MAX];
+    uint8_t count = 0;
+    char* p = line + 1;
+    fields[count++] = p;
+    for (; *p != '*' && *p != '\0'; p++) {
+        if (*p == ',' && count < NMEA_FIELDS_MAX) {
+            *p = '\0';
+            fields[count++] = p + 1;
+        }
+    }
+    *p = '\0';
+
+    // Any talker: the type is the three characters after it
+    const char* type = strlen(fields[0]) == 5 ? fields[0] + 2 : "";
+    if (strcmp(type, "RMC") == 0) {
+        take_rmc(fields, count);
+    } else if (strcmp(type, "GGA") == 0) {
+        take_gga(fields, count);
+    } else {
+        portENTER_CRITICAL(&gps_mux);
+        stats.ignored++;
+        portEXIT_CRITICAL(&gps_mux);
+    }
+}
+
+/**
+ * @brief XOR of the characters between '$' and '*' against the two hex digits after it
+ */
+static bool checksum_ok(void) {
+    uint8_t sum = 0;
+    uint8_t i = 1;
+    for (; i < line_length && line[i] != '*'; i++) {
+        sum ^= (uint8_t)line[i];
+    }
+    if (i + 2 >= line_length || line[i] != '*') {
+        return false;
+    }
+    char hex[3] = { line[i + 1], line[i + 2], '\0' };
+    char* end = NULL;
+    long expected = strtol(hex, &end, 16);
+    return end == hex + 2 && expected == sum;
+}
+
+/**
+ * @brief Position, speed and UTC: time,status,lat,N/S,lon,E/W,knots,course,date
+ */
+static void take_rmc(char** fields, uint8_t count) {
+    if (count < 10) {
+        return;
+    }
+    int32_t lat = 0, lon = 0;
+    bool active = fields[2][0] == 'A';
+    bool placed = parse_coordinate(fields[3], fields[4], 2, &lat) &&
+                  parse_coordinate(fields[5], fields[6], 3, &lon);
+    // Knots to km/h x 10: x 1.852
+    int32_t knots_x100 = parse_fixed(fields[7], 2);
+    uint32_t utc = parse_utc(fields[1], fields[9]);
+
+    portENTER_CRITICAL(&gps_mux);
+    stats.sentences++;
+    fix.valid = active && placed && (!gga_seen || gga_quality > 0);
+    if (fix.valid) {
+        fix.lat_e7 = lat;
+        fix.lon_e7 = lon;
+        fix.speed_kmh_x10 = (uint16_t)min((int32_t)UINT16_MAX, max((int32_t)0, knots_x100) * 1852 / 10000);
+        fix.utc_s = utc;
+        fix.fix_ms = millis();
+        stats.fixes++;
+    }
+    portEXIT_CRITICAL(&gps_mux);
+}
+
+/**
+ * @brief Fix quality, satellites, HDOP and altitude: time,lat,N/S,lon,E/W,quality,sats,hdop,alt,M
+ */
+static void take_gga(char** fields, uint8_t count) {
+    if (count < 10) {
+        return;
+    }
+    uint8_t quality = (uint8_t)atoi(fields[6]);
+    uint8_t satellites = (uint8_t)min(atoi(fields[7]), 255);
+    int32_t hdop_x10 = parse_fixed(fields[8], 1);
+    int32_t alt_m = parse_fixed(fields[9], 0);
+
+    portENTER_CRITICAL(&gps_mux);
+    stats.sentences++;
+    gga_seen = true;
+    gga_quality = quality;
+    fix.satellites = satellites;
+    fix.hdop_x10 = (uint8_t)constrain(hdop_x10, 0, 255);
+    fix.alt_m = (int16_t)constrain(alt_m, INT16_MIN, INT16_MAX);
+    if (quality == 0) {
+        fix.valid = false;
+    }
+    portEXIT_CRITICAL(&gps_mux);
+}
+
+/**
+ * @brief "ddmm.mmmm" or "dddmm.mmmm" and a hemisphere letter to degrees x 1e7
+ */
+static bool parse_coordinate(const char* text, const char* hemisphere, uint8_t degree_digits, int32_t* e7) {
+    const char* dot = strchr(text, '.');
+    size_t whole = dot != NULL ? (size_t)(dot - text) : strlen(text);
+    if (whole != (size_t)degree_digits + 2 || hemisphere[0] == '\0') {
+        return false;
+    }
+
+    int32_t degrees = 0, minutes = 0;
+    for (uint8_t i = 0; i < whole; i++) {
+        if (!isdigit((unsigned char)text[i])) {
+            return false;
+        }
+        if (i < degree_digits) {
+            degrees = degrees * 10 + (text[i] - '0');
+        } else {
+            minutes = minutes * 10 + (text[i] - '0');
+        }
+    }
+    // Minutes' decimals to 1e7ths of a minute, extra digits cut
+    int64_t minutes_e7 = (int64_t)minutes * 10000000LL;
+    if (dot != NULL) {
+        int64_t scale = 1000000LL;
+        for (const char* d = dot + 1; isdigit((unsigned char)*d) && scale > 0; d++, scale /= 10) {
+            minutes_e7 += (*d - '0') * scale;
+        }
+    }
+    int64_t value = (int64_t)degrees * 10000000LL + minutes_e7 / 60;
+    if (hemisphere[0] == 'S' || hemisphere[0] == 'W') {
+        value = -value;
+    }
+    *e7 = (int32_t)value;
+    return true;
+}
+
+/**
+ * @brief A decimal field as an integer with this many decimals kept; 0 if empty
+ */
+static int32_t parse_fixed(const char* text, uint8_t decimals) {
+    bool negative = *text == '-';
+    if (negative) {
+        text++;
+    }
+    int32_t value = 0;
+    for (; isdigit((unsigned char)*text); text++) {
+        value = value * 10 + (*text - '0');
+    }
+    if (*text == '.') {
+        text++;
+    }
+    for (uint8_t i = 0; i < decimals; i++) {
+        value = value * 10 + (isdigit((unsigned char)*text) ? *text++ - '0' : 0);
+    }
+    return negative ? -value : value;
+}
+
+/**
+ * @brief "hhmmss.ss" and "ddmmyy" to seconds since the epoch; 0 if either is missing
+ */
+static uint32_t parse_utc(const char* time, const char* date) {
+    if (strlen(time) < 6 || strlen(date) != 6) {
+        return 0;
+    }
+    int32_t hh = (time[0] - '0') * 10 + (time[1] - '0');
+    int32_t mm = (time[2] - '0') * 10 + (time[3] - '0');
+    int32_t ss = (time[4] - '0') * 10 + (time[5] - '0');
+    int32_t day = (date[0] - '0') * 10 + (date[1] - '0');
+    int32_t month = (date[2] - '0') * 10 + (date[3] - '0');
+    int32_t year = (date[4] - '0') * 10 + (date[5] - '0');
+    year += year < 80 ? 2000 : 1900;
+    if (month < 1 || month > 12 || day < 1 || day > 31) {
+        return 0;
+    }
+
+    // Days from the civil date (proleptic Gregorian), March-based year
+    year -= month <= 2;
+    int32_t era = year / 400;
+    int32_t yoe = year - era * 400;
+    int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int32_t days = era * 146097 + doe - 719468;
+    return (uint32_t)days * 86400UL + hh * 3600 + mm * 60 + ss;
+}
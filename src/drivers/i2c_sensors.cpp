@@ -0,0 +1,367 @@
+/**
+ * @file i2c_sensors.cpp
+ * @brief Registry of I2C sensor drivers, read in batches off the system task
+ *
+ * Each driver probes its chip at boot, leaving it converting on its own
+ * where the chip can, and reads everything it reports in one transaction:
+ * a register pointer, a repeated start and one burst read. The system
+ * task's tick collects the sensors whose period has run out and hands
+ * them to a low-lane job as one batch, so a slow or stuck device costs a
+ * worker its Wire timeout and never the system loop. The tick after the
+ * batch finishes publishes the readings on BUS_TOPIC_I2C, from where they
+ * reach the sensor data and the feature vector.
+ *
+ * Wire holds its own lock for a whole transaction, so the batch and the
+ * INA219 and LIS3DH interrupt reads on the system task interleave
+ * transaction by transaction. A driver is added by writing its probe and
+ * read and giving it a line in drivers[].
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <math.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "board.h"
+#include "i2c_sensors.h"
+#include "data_bus.h"
+#include "job_pool.h"
+#include "logger.h"
+
+#define SHT3X_PERIODIC_1MPS_HIGH  0x2130  // One measurement a second, high repeatability
+#define SHT3X_FETCH               0xE000
+#define BH1750_POWER_ON           0x01
+#define BH1750_CONTINUOUS_HIGH    0x10    // 1 lx resolution, 120 ms a conversion
+#define LIS3DH_WHO_AM_I           0x0F
+#define LIS3DH_ID                 0x33
+#define LIS3DH_CTRL_REG1          0x20
+#define LIS3DH_CTRL_REG1_10HZ_LP  0x2F    // As wake_sources sets it: 10 Hz, low power, X, Y, Z
+#define LIS3DH_OUT_X_L            0x28
+#define LIS3DH_AUTO_INCREMENT     0x80
+#define LIS3DH_MG_PER_LSB         16      // High byte in low-power mode at +-2 g
+#define MAX17048_VCELL            0x02    // VCELL then SOC, 78.125 uV and 1/256 % a count
+#define MAX17048_VERSION          0x08
+
+/**
+ * @brief One sensor: where it is, how often to read it and how
+ */
+typedef struct {
+    const char* name;
+    uint8_t     addr;
+    uint16_t    period_ms;
+    bool (*probe)(uint8_t addr);
+    bool (*read)(uint8_t addr, i2c_publication_t* out);
+} i2c_driver_t;
+
+// Forward declarations
+static bool sht3x_probe(uint8_t addr);
+static bool sht3x_read(uint8_t addr, i2c_publication_t* out);
+static bool bh1750_probe(uint8_t addr);
+static bool bh1750_read(uint8_t addr, i2c_publication_t* out);
+static bool lis3dh_probe(uint8_t addr);
+static bool lis3dh_read(uint8_t addr, i2c_publication_t* out);
+static bool max17048_probe(uint8_t addr);
+static bool max17048_read(uint8_t addr, i2c_publication_t* out);
+static void read_batch_job(void* payload);
+static bool command(uint8_t addr, const uint8_t* bytes, uint8_t count);
+static bool read_block(uint8_t addr, const uint8_t* pointer, uint8_t pointer_len, uint8_t* out, uint8_t count);
+static uint8_t sht3x_crc(const uint8_t* data);
+
+// In i2c_sensor_id_t order
+static const i2c_driver_t drivers[I2C_SENSOR_COUNT] = {
+    { "climate", I2C_SENSOR_CLIMATE_ADDR, I2C_SENSOR_CLIMATE_MS, sht3x_probe,    sht3x_read },
+    { "light",   I2C_SENSOR_LIGHT_ADDR,   I2C_SENSOR_LIGHT_MS,   bh1750_probe,   bh1750_read },
+    { "motion",  WAKE_ACCEL_ADDR,         I2C_SENSOR_MOTION_MS,  lis3dh_probe,   lis3dh_read },
+    { "battery", I2C_SENSOR_BATTERY_ADDR, I2C_SENSOR_BATTERY_MS, max17048_probe, max17048_read }
+};
+
+// System task
+static uint32_t due_ms[I2C_SENSOR_COUNT];
+static uint8_t present = 0;
+
+// Shared with the batch job
+static i2c_publication_t readings;
+static i2c_sensor_stats_t stats[I2C_SENSOR_COUNT];
+static volatile bool in_flight = false;
+static volatile bool batch_done = false;
+static portMUX_TYPE sensors_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Probe and configure each registered sensor
+ */
+void i2c_sensors_init(void) {
+    memset(&readings, 0, sizeof(readings));
+    for (uint8_t i = 0; i < I2C_SENSOR_COUNT; i++) {
+        stats[i].name = drivers[i].name;
+        stats[i].period_ms = drivers[i].period_ms;
+#if I2C_SENSORS_ENABLED
+        if (BOARD.i2c.sda >= 0 && drivers[i].probe(drivers[i].addr)) {
+            present |= 1 << i;
+            stats[i].present = true;
+        }
+#endif
+        due_ms[i] = millis();
+    }
+    readings.present = present;
+    LOGI(SYSTEM, "✅ I2C sensors: climate %s, light %s, motion %s, battery gauge %s",
+         stats[I2C_SENSOR_CLIMATE].present ? "found" : "absent",
+         stats[I2C_SENSOR_LIGHT].present ? "found" : "absent",
+         stats[I2C_SENSOR_MOTION].present ? "found" : "absent",
+         stats[I2C_SENSOR_BATTERY].present ? "found" : "absent");
+}
+
+/**
+ * @brief Publish what the last batch read and start a batch for the sensors due
+ */
+void i2c_sensors_tick(uint32_t now_ms) {
+    if (present == 0) {
+        return;
+    }
+
+    if (batch_done) {
+        i2c_publication_t latest;
+        portENTER_CRITICAL(&sensors_mux);
+        latest = readings;
+        latest.fresh = 0;
+        for (uint8_t i = 0; i < I2C_SENSOR_COUNT; i++) {
+            if (stats[i].reads > 0 &&
+                now_ms - stats[i].last_read_ms <= (uint32_t)drivers[i].period_ms * I2C_SENSOR_STALE_PERIODS) {
+                latest.fresh |= 1 << i;
+            }
+        }
+        batch_done = false;
+        portEXIT_CRITICAL(&sensors_mux);
+
+        i2c_publication_t* slot = (i2c_publication_t*)data_bus_begin_publish(BUS_TOPIC_I2C);
+        if (slot != NULL) {
+            *slot = latest;
+            data_bus_publish(BUS_TOPIC_I2C);
+        }
+    }
+
+    if (in_flight) {
+        return;
+    }
+    uint8_t due = 0;
+    for (uint8_t i = 0; i < I2C_SENSOR_COUNT; i++) {
+        if ((present & (1 << i)) && (int32_t)(now_ms - due_ms[i]) >= 0) {
+            due |= 1 << i;
+        }
+    }
+    if (due == 0) {
+        return;
+    }
+    in_flight = true;
+    if (!job_pool_submit(JOB_LANE_LOW, read_batch_job, &due, sizeof(due))) {
+        in_flight = false;          // Tried again next cycle
+        return;
+    }
+    for (uint8_t i = 0; i < I2C_SENSOR_COUNT; i++) {
+        if (due & (1 << i)) {
+            due_ms[i] = now_ms + drivers[i].period_ms;
+        }
+    }
+}
+
+/**
+ * @brief Copy one sensor's figures
+ */
+void i2c_sensors_get_stats(i2c_sensor_id_t sensor, i2c_sensor_stats_t* out) {
+    if (sensor >= I2C_SENSOR_COUNT) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    portENTER_CRITICAL(&sensors_mux);
+    *out = stats[sensor];
+    portEXIT_CRITICAL(&sensors_mux);
+}
+
+/**
+ * @brief Read each sensor in the batch, one transaction each (job pool worker)
+ */
+static void read_batch_job(void* payload) {
+    uint8_t due = *(const uint8_t*)payload;
+
+    for (uint8_t i = 0; i < I2C_SENSOR_COUNT; i++) {
+        if ((due & (1 << i)) == 0) {
+            continue;
+        }
+        portENTER_CRITICAL(&sensors_mux);
+        i2c_publication_t next = readings;
+        portEXIT_CRITICAL(&sensors_mux);
+
+        int64_t started_us = esp_timer_get_time();
+        bool ok = drivers[i].read(drivers[i].addr, &next);
+        uint32_t took_us = (uint32_t)(esp_timer_get_time() - started_us);
+
+        portENTER_CRITICAL(&sensors_mux);
+        if (ok) {
+            readings = next;
+            stats[i].reads++;
+            stats[i].last_read_ms = millis();
+        } else {
+            stats[i].failures++;
+        }
+        if (took_us > stats[i].max_read_us) {
+            stats[i].max_read_us = took_us;
+        }
+        portEXIT_CRITICAL(&sensors_mux);
+    }
+
+    portENTER_CRITICAL(&sensors_mux);
+    batch_done = true;
+    in_flight = false;
+    portEXIT_CRITICAL(&sensors_mux);
+}
+
+/**
+ * @brief Start periodic measurement; the chip converts on its own from here
+ */
+static bool sht3x_probe(uint8_t addr) {
+    static const uint8_t start[] = { SHT3X_PERIODIC_1MPS_HIGH >> 8, SHT3X_PERIODIC_1MPS_HIGH & 0xFF };
+    return command(addr, start, sizeof(start));
+}
+
+/**
+ * @brief Fetch the latest temperature and humidity, each word CRC-checked
+ */
+static bool sht3x_read(uint8_t addr, i2c_publication_t* out) {
+    static const uint8_t fetch[] = { SHT3X_FETCH >> 8, SHT3X_FETCH & 0xFF };
+    uint8_t data[6];
+    if (!read_block(addr, fetch, sizeof(fetch), data, sizeof(data)) ||
+        sht3x_crc(&data[0]) != data[2] || sht3x_crc(&data[3]) != data[5]) {
+        return false;
+    }
+    uint32_t t_raw = (data[0] << 8) | data[1];
+    uint32_t rh_raw = (data[3] << 8) | data[4];
+    out->temperature_c10 = (int16_t)((int32_t)(t_raw * 1750 / 65535) - 450);
+    out->humidity_permille = (uint16_t)min(rh_raw * 1000 / 65535, (uint32_t)1000);
+    return true;
+}
+
+/**
+ * @brief Power on and convert continuously at 1 lx resolution
+ */
+static bool bh1750_probe(uint8_t addr) {
+    static const uint8_t power_on = BH1750_POWER_ON;
+    static const uint8_t continuous = BH1750_CONTINUOUS_HIGH;
+    return command(addr, &power_on, 1) && command(addr, &continuous, 1);
+}
+
+/**
+ * @brief The last conversion; the chip has no register pointer
+ */
+static bool bh1750_read(uint8_t addr, i2c_publication_t* out) {
+    uint8_t data[2];
+    if (!read_block(addr, NULL, 0, data, sizeof(data))) {
+        return false;
+    }
+    out->light_lux = (uint16_t)(((data[0] << 8) | data[1]) * 10 / 12);
+    return true;
+}
+
+/**
+ * @brief The LIS3DH, converting at 10 Hz whether or not wake_sources armed it
+ */
+static bool lis3dh_probe(uint8_t addr) {
+    static const uint8_t who = LIS3DH_WHO_AM_I;
+    uint8_t id;
+    if (!read_block(addr, &who, 1, &id, 1) || id != LIS3DH_ID) {
+        return false;
+    }
+    static const uint8_t ctrl = LIS3DH_CTRL_REG1;
+    uint8_t reg1;
+    if (!read_block(addr, &ctrl, 1, &reg1, 1)) {
+        return false;
+    }
+    if ((reg1 & 0xF0) != 0) {
+        return true;                // Already converting; INT1's set-up is left alone
+    }
+    static const uint8_t start[] = { LIS3DH_CTRL_REG1, LIS3DH_CTRL_REG1_10HZ_LP };
+    return command(addr, start, sizeof(start));
+}
+
+/**
+ * @brief X, Y and Z in one auto-incrementing read; reading them leaves INT1 latched
+ */
+static bool lis3dh_read(uint8_t addr, i2c_publication_t* out) {
+    static const uint8_t pointer = LIS3DH_OUT_X_L | LIS3DH_AUTO_INCREMENT;
+    uint8_t data[6];
+    if (!read_block(addr, &pointer, 1, data, sizeof(data))) {
+        return false;
+    }
+    int32_t x = (int8_t)data[1] * LIS3DH_MG_PER_LSB;
+    int32_t y = (int8_t)data[3] * LIS3DH_MG_PER_LSB;
+    int32_t z = (int8_t)data[5] * LIS3DH_MG_PER_LSB;
+    int32_t magnitude = (int32_t)sqrtf((float)(x * x + y * y + z * z));
+    out->motion_mg = (uint16_t)abs(magnitude - 1000);
+    return true;
+}
+
+/**
+ * @brief A MAX17048 answers its version register with 0x001x
+ */
+static bool max17048_probe(uint8_t addr) {
+    static const uint8_t version = MAX17048_VERSION;
+    uint8_t data[2];
+    return read_block(addr, &version, 1, data, sizeof(data)) && data[0] == 0x00 && (data[1] & 0xF0) == 0x10;
+}
+
+/**
+ * @brief Cell voltage and state of charge, adjacent registers read together
+ */
+static bool max17048_read(uint8_t addr, i2c_publication_t* out) {
+    static const uint8_t pointer = MAX17048_VCELL;
+    uint8_t data[4];
+    if (!read_block(addr, &pointer, 1, data, sizeof(data))) {
+        return false;
+    }
+    uint32_t vcell = (data[0] << 8) | data[1];
+    out->battery_mv = (uint16_t)(vcell * 5 / 64);           // 78.125 uV a count
+    out->battery_pct = (uint8_t)min((uint32_t)data[2], (uint32_t)100);
+    return true;
+}
+
+/**
+ * @brief Write bytes and stop
+ */
+static bool command(uint8_t addr, const uint8_t* bytes, uint8_t count) {
+    Wire.beginTransmission(addr);
+    Wire.write(bytes, count);
+    return Wire.endTransmission() == 0;
+}
+
+/**
+ * @brief Set the register pointer, if any, then read with a repeated start
+ */
+static bool read_block(uint8_t addr, const uint8_t* pointer, uint8_t pointer_len, uint8_t* out, uint8_t count) {
+    if (pointer_len > 0) {
+        Wire.beginTransmission(addr);
+        Wire.write(pointer, pointer_len);
+        if (Wire.endTransmission(false) != 0) {
+            return false;
+        }
+    }
+    if (Wire.requestFrom(addr, count) != count) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        out[i] = Wire.read();
+    }
+    return true;
+}
+
+/**
+ * @brief SHT3x CRC-8 over one word: polynomial 0x31, initial 0xFF
+ */
+static uint8_t sht3x_crc(const uint8_t* data) {
+    uint8_t crc = 0xFF;
+    for (uint8_t i = 0; i < 2; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
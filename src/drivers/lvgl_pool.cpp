@@ -0,0 +1,75 @@
+/**
+ * @file lvgl_pool.cpp
+ * @brief Placement and accounting of LVGL's memory pool
+ *
+ * There is no lv_conf.h: LVGL keeps its built-in TLSF allocator
+ * (LV_MEM_CUSTOM 0) and platformio.ini sets its size and points
+ * LV_MEM_POOL_ALLOC here, so the pool is one heap block placed where
+ * LVGL_POOL_PSRAM says instead of a static array in internal RAM.
+ *
+ * Usage is read with lv_mem_monitor(), which walks the TLSF blocks and so
+ * must run on the LVGL task; the figures are copied out under a spinlock
+ * for the system task and the metrics endpoint.
+ */
+
+#include <Arduino.h>
+#include <soc/soc_memory_layout.h>
+#include <lvgl.h>
+#include "config.h"
+#include "lvgl_pool.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+static lvgl_pool_stats_t stats;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Allocate the block LVGL runs its TLSF allocator in
+ */
+void* lvgl_pool_alloc(size_t size) {
+    // Hot falls back to PSRAM by itself; bulk only while internal RAM is
+    // plentiful, and lv_init() cannot be refused
+    void* pool = mem_alloc(LVGL_POOL_PSRAM ? MEM_BULK : MEM_HOT_CPU, size);
+    if (pool == NULL && LVGL_POOL_PSRAM) {
+        pool = mem_alloc(MEM_HOT_CPU, size);
+    }
+    const char* placement = pool != NULL && esp_ptr_external_ram(pool) ? "PSRAM" : "internal RAM";
+    if (pool == NULL) {
+        // lv_init() has no way to fail; stop here rather than inside TLSF
+        LOGE(UI, "❌ No %u bytes anywhere for the LVGL pool", (unsigned)size);
+        abort();
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.size = size;
+    stats.placement = placement;
+    portEXIT_CRITICAL(&stats_mux);
+    LOGI(UI, "✅ LVGL pool: %u KB in %s", (unsigned)(size / 1024), placement);
+    return pool;
+}
+
+/**
+ * @brief Walk the pool and publish its usage
+ */
+void lvgl_pool_sample(uint32_t now_ms) {
+    lv_mem_monitor_t mem;
+    lv_mem_monitor(&mem);
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.used = mem.total_size - mem.free_size;
+    stats.peak = mem.max_used;
+    stats.largest_free = mem.free_biggest_size;
+    stats.used_pct = mem.used_pct;
+    stats.frag_pct = mem.frag_pct;
+    stats.sampled_ms = now_ms;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Copy the last sample, from any task
+ */
+void lvgl_pool_get_stats(lvgl_pool_stats_t* out) {
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
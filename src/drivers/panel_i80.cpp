@@ -0,0 +1,229 @@
+/**
+ * @file panel_i80.cpp
+ * @brief The ST7789 on the S3's i80 (8080) LCD peripheral, through esp_lcd
+ *
+ * Each push is one draw_bitmap(): the column and row windows go out as
+ * commands, then the pixels stream from the band buffer by GDMA. On an
+ * 8-bit bus the peripheral swaps each pixel's bytes on the way
+ * (swap_color_bytes); a 16-bit bus takes LVGL's little-endian RGB565 as
+ * it lies, one pixel a write strobe. Either way nothing is copied.
+ *
+ * The CPU is free while a band is on the bus: the transfer-done callback
+ * runs from the LCD interrupt and only gives a semaphore; the next push,
+ * or panel_wait(), takes it before the buffer can be touched again.
+ */
+
+#include "config.h"
+
+#if BOARD_DISPLAY_BUS == DISPLAY_BUS_I80
+
+#include <Arduino.h>
+#include <esp_attr.h>
+#include <esp_idf_version.h>
+#include <esp_lcd_panel_io.h>
+#include <esp_lcd_panel_ops.h>
+#include <esp_lcd_panel_vendor.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "panel.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+#define PANEL_TRANSFER_ROWS  DISPLAY_BAND_MAX_ROWS   // Largest push: a draw buffer band
+#define PANEL_QUEUE_DEPTH    2                       // Window commands plus the pixels
+
+static esp_lcd_i80_bus_handle_t bus = NULL;
+static esp_lcd_panel_io_handle_t io = NULL;
+static esp_lcd_panel_handle_t panel = NULL;
+static SemaphoreHandle_t done = NULL;
+static StaticSemaphore_t done_state;
+static bool in_flight = false;
+static uint8_t rotation_now = 0;
+
+// Forward declarations
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+static bool IRAM_ATTR on_transfer_done(esp_lcd_panel_io_handle_t io, esp_lcd_panel_io_event_data_t* event,
+                                       void* ctx);
+#else
+static bool IRAM_ATTR on_transfer_done(esp_lcd_panel_io_handle_t io, void* ctx, void* event);
+#endif
+static void apply_rotation(uint8_t rotation);
+
+/**
+ * @brief Bring the panel up in a rotation, cleared to black
+ */
+bool panel_init(uint8_t rotation, panel_info_t* info) {
+    if (BOARD.display.power >= 0) {
+        pinMode(BOARD.display.power, OUTPUT);
+        digitalWrite(BOARD.display.power, HIGH);
+    }
+    if (BOARD.display.rd >= 0) {
+        pinMode(BOARD.display.rd, OUTPUT);      // Never read back: RD idles high
+        digitalWrite(BOARD.display.rd, HIGH);
+    }
+    done = xSemaphoreCreateBinaryStatic(&done_state);
+
+    esp_lcd_i80_bus_config_t bus_config = {};
+    bus_config.dc_gpio_num = BOARD.display.dc;
+    bus_config.wr_gpio_num = BOARD.display.wr;
+    for (uint8_t i = 0; i < BOARD.display.bus_width; i++) {
+        bus_config.data_gpio_nums[i] = BOARD.display.data[i];
+    }
+    bus_config.bus_width = BOARD.display.bus_width;
+    bus_config.max_transfer_bytes = (size_t)BOARD.display.height * PANEL_TRANSFER_ROWS * sizeof(uint16_t);
+    bus_config.psram_trans_align = 64;      // Full-frame mode and the PSRAM fallback buffers
+    bus_config.sram_trans_align = 4;
+    if (esp_lcd_new_i80_bus(&bus_config, &bus) != ESP_OK) {
+        LOGE(UI, "❌ i80 LCD bus unavailable");
+        return false;
+    }
+
+    esp_lcd_panel_io_i80_config_t io_config = {};
+    io_config.cs_gpio_num = BOARD.display.cs;
+    io_config.pclk_hz = BOARD.display.bus_hz;
+    io_config.trans_queue_depth = PANEL_QUEUE_DEPTH;
+    io_config.on_color_trans_done = on_transfer_done;
+    io_config.user_ctx = NULL;
+    io_config.lcd_cmd_bits = 8;
+    io_config.lcd_param_bits = 8;
+    io_config.dc_levels.dc_idle_level = 0;
+    io_config.dc_levels.dc_cmd_level = 0;
+    io_config.dc_levels.dc_dummy_level = 0;
+    io_config.dc_levels.dc_data_level = 1;
+    io_config.flags.swap_color_bytes = BOARD.display.bus_width == 8;  // LVGL renders RGB565 little-endian
+    if (esp_lcd_new_panel_io_i80(bus, &io_config, &io) != ESP_OK) {
+        LOGE(UI, "❌ i80 LCD panel IO unavailable");
+        return false;
+    }
+
+    esp_lcd_panel_dev_config_t panel_config = {};
+    panel_config.reset_gpio_num = BOARD.display.rst;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    panel_config.rgb_endian = LCD_RGB_ENDIAN_RGB;
+#else
+    panel_config.color_space = ESP_LCD_COLOR_SPACE_RGB;
+#endif
+    panel_config.bits_per_pixel = 16;
+    if (esp_lcd_new_panel_st7789(io, &panel_config, &panel) != ESP_OK ||
+        esp_lcd_panel_reset(panel) != ESP_OK || esp_lcd_panel_init(panel) != ESP_OK) {
+        LOGE(UI, "❌ ST7789 on i80 did not initialize");
+        return false;
+    }
+    esp_lcd_panel_invert_color(panel, BOARD.display.invert);
+    apply_rotation(rotation);
+
+    // Clear a band at a time from a zeroed buffer, then switch the panel on
+    size_t band_bytes = (size_t)BOARD.display.height * PANEL_TRANSFER_ROWS * sizeof(uint16_t);
+    uint16_t* black = (uint16_t*)mem_calloc(MEM_HOT_DMA, 1, band_bytes);
+    if (black != NULL) {
+        uint16_t rows = panel_height();
+        for (uint16_t y = 0; y < rows; y += PANEL_TRANSFER_ROWS) {
+            uint16_t h = min((uint16_t)PANEL_TRANSFER_ROWS, (uint16_t)(rows - y));
+            panel_push(0, y, panel_width(), h, black);
+        }
+        panel_wait();
+        mem_free(MEM_HOT_DMA, black, band_bytes);
+    }
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    esp_lcd_panel_disp_on_off(panel, true);
+#else
+    esp_lcd_panel_disp_off(panel, false);
+#endif
+
+    info->bus = "i80";
+    info->bus_hz = BOARD.display.bus_hz;
+    info->dma = DISPLAY_FLUSH_DMA;
+    return true;
+}
+
+/**
+ * @brief Turn the panel's address mapping
+ */
+void panel_set_rotation(uint8_t rotation) {
+    panel_wait();
+    apply_rotation(rotation);
+}
+
+/**
+ * @brief Width in the current rotation
+ */
+uint16_t panel_width(void) {
+    return rotation_now & 1 ? BOARD.display.height : BOARD.display.width;
+}
+
+/**
+ * @brief Height in the current rotation
+ */
+uint16_t panel_height(void) {
+    return rotation_now & 1 ? BOARD.display.width : BOARD.display.height;
+}
+
+/**
+ * @brief Send a rectangle of RGB565 pixels
+ *
+ * Without DISPLAY_FLUSH_DMA the transfer is still DMA, but waited for here.
+ */
+void panel_push(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint16_t* pixels) {
+    panel_wait();
+    in_flight = esp_lcd_panel_draw_bitmap(panel, x, y, x + w, y + h, pixels) == ESP_OK;
+#if !DISPLAY_FLUSH_DMA
+    panel_wait();
+#endif
+}
+
+/**
+ * @brief Wait for a transfer in flight
+ */
+void panel_wait(void) {
+    if (in_flight) {
+        xSemaphoreTake(done, portMAX_DELAY);
+        in_flight = false;
+    }
+}
+
+/**
+ * @brief Send a parameterless command once the bus is idle
+ */
+void panel_command(uint8_t command) {
+    panel_wait();
+    esp_lcd_panel_io_tx_param(io, command, NULL, 0);
+}
+
+/**
+ * @brief A pixel transfer is out: the buffer may be reused
+ */
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+static bool IRAM_ATTR on_transfer_done(esp_lcd_panel_io_handle_t io, esp_lcd_panel_io_event_data_t* event,
+                                       void* ctx) {
+#else
+static bool IRAM_ATTR on_transfer_done(esp_lcd_panel_io_handle_t io, void* ctx, void* event) {
+#endif
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(done, &woken);
+    return woken == pdTRUE;
+}
+
+/**
+ * @brief MADCTL and the RAM offset for a TFT_eSPI rotation
+ *
+ * Odd rotations swap the axes, and with them which gap applies to x.
+ */
+static void apply_rotation(uint8_t rotation) {
+    static const struct { bool swap_xy, mirror_x, mirror_y; } madctl[4] = {
+        { false, false, false },
+        { true,  true,  false },
+        { false, true,  true },
+        { true,  false, true },
+    };
+    rotation &= 3;
+    esp_lcd_panel_swap_xy(panel, madctl[rotation].swap_xy);
+    esp_lcd_panel_mirror(panel, madctl[rotation].mirror_x, madctl[rotation].mirror_y);
+    if (rotation & 1) {
+        esp_lcd_panel_set_gap(panel, BOARD.display.y_gap, BOARD.display.x_gap);
+    } else {
+        esp_lcd_panel_set_gap(panel, BOARD.display.x_gap, BOARD.display.y_gap);
+    }
+    rotation_now = rotation;
+}
+
+#endif // BOARD_DISPLAY_BUS == DISPLAY_BUS_I80
@@ -0,0 +1,113 @@
+/**
+ * @file panel_spi.cpp
+ * @brief The ST7789 on SPI, through TFT_eSPI
+ *
+ * TFT_eSPI is set up by the env's build flags (USER_SETUP_LOADED), so its
+ * pins and clock are checked against the board profile at compile time.
+ * With DISPLAY_FLUSH_DMA each push is queued to SPI DMA; pushImageDMA()
+ * waits for the previous transfer before queueing, so a buffer is never
+ * reused while the DMA still reads it.
+ */
+
+#include "config.h"
+
+#if BOARD_DISPLAY_BUS == DISPLAY_BUS_SPI
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <TFT_eSPI.h>
+#include "panel.h"
+#include "logger.h"
+
+#if !defined(USER_SETUP_LOADED)
+#error "TFT_eSPI needs the board's setup in the env's build_flags (USER_SETUP_LOADED)"
+#endif
+static_assert(TFT_CS == BOARD.display.cs && TFT_DC == BOARD.display.dc && TFT_RST == BOARD.display.rst &&
+              TFT_MOSI == BOARD.display.mosi && TFT_SCLK == BOARD.display.clk,
+              "TFT_eSPI's pins in platformio.ini differ from the board profile");
+static_assert(SPI_FREQUENCY == BOARD.display.bus_hz,
+              "TFT_eSPI's SPI_FREQUENCY in platformio.ini differs from the board profile");
+
+static TFT_eSPI tft = TFT_eSPI();
+static bool dma = false;
+
+/**
+ * @brief Bring the panel up in a rotation, cleared to black
+ */
+bool panel_init(uint8_t rotation, panel_info_t* info) {
+    tft.init();
+    tft.setRotation(rotation);
+    tft.fillScreen(TFT_BLACK);
+
+#if DISPLAY_FLUSH_DMA
+    // CS is driven by TFT_eSPI, not the DMA engine, so the bus stays held
+    // for good: releasing it would raise CS under a transfer in flight.
+    // The host is the display's alone (spi_bus.h), so that blocks nobody
+    dma = tft.initDMA();
+    if (dma) {
+        tft.setSwapBytes(true);     // LVGL renders RGB565 little-endian
+        tft.startWrite();
+    } else {
+        LOGW(UI, "⚠️  SPI DMA unavailable - blocking display flushes");
+    }
+#endif
+    info->bus = "SPI";
+    info->bus_hz = SPI_FREQUENCY;
+    info->dma = dma;
+    return true;
+}
+
+/**
+ * @brief Turn the panel's address mapping
+ */
+void panel_set_rotation(uint8_t rotation) {
+    panel_wait();
+    tft.setRotation(rotation);
+}
+
+/**
+ * @brief Width in the current rotation
+ */
+uint16_t panel_width(void) {
+    return tft.width();
+}
+
+/**
+ * @brief Height in the current rotation
+ */
+uint16_t panel_height(void) {
+    return tft.height();
+}
+
+/**
+ * @brief Send a rectangle of RGB565 pixels
+ */
+void panel_push(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint16_t* pixels) {
+    if (dma) {
+        tft.pushImageDMA(x, y, w, h, (uint16_t*)pixels);
+    } else {
+        tft.startWrite();
+        tft.setAddrWindow(x, y, w, h);
+        tft.pushColors((uint16_t*)pixels, w * h, true);
+        tft.endWrite();
+    }
+}
+
+/**
+ * @brief Wait for a transfer in flight
+ */
+void panel_wait(void) {
+    if (dma) {
+        tft.dmaWait();
+    }
+}
+
+/**
+ * @brief Send a parameterless command once the bus is idle
+ */
+void panel_command(uint8_t command) {
+    panel_wait();
+    tft.writecommand(command);
+}
+
+#endif // BOARD_DISPLAY_BUS == DISPLAY_BUS_SPI
@@ -0,0 +1,192 @@
+/**
+ * @file render_split.cpp
+ * @brief Large LVGL blends shared with a helper task on the other core
+ *
+ * One stripe is in flight at a time: the UI task publishes a copy of the
+ * draw context, clipped to the top stripe, and notifies the helper; the
+ * stripe's state word then decides who draws it. The helper moves it from
+ * pending to running, the UI task from pending back to idle when it takes
+ * the stripe itself, so exactly one of them wins. Once the helper is
+ * running it is only waited for, spinning: its stripe is no larger than
+ * the one the UI task has just drawn.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <lvgl.h>
+#include <src/draw/sw/lv_draw_sw.h>
+#include "config.h"
+#include "render_split.h"
+#include "cpu_load.h"
+#include "logger.h"
+
+enum {
+    STRIPE_IDLE = 0,
+    STRIPE_PENDING,                 // Published, nobody drawing it yet
+    STRIPE_RUNNING,                 // The helper is drawing it
+    STRIPE_DONE
+};
+
+static TaskHandle_t helper = NULL;
+#if RENDER_SPLIT_ENABLED
+static StackType_t helper_stack[RENDER_SPLIT_STACK_SIZE];
+static StaticTask_t helper_tcb;
+#endif
+
+// The stripe in flight; written by the UI task before it is published
+static lv_draw_ctx_t stripe_ctx;
+static lv_area_t stripe_clip;
+static const lv_draw_sw_blend_dsc_t* stripe_dsc = NULL;
+static volatile uint32_t stripe_state = STRIPE_IDLE;
+
+static bool allowed = false;
+static render_split_stats_t stats;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+#if RENDER_SPLIT_ENABLED
+static void helper_task(void* parameter);
+#endif
+static void split_blend(lv_draw_ctx_t* draw_ctx, const lv_draw_sw_blend_dsc_t* dsc);
+static void install(lv_disp_t* disp);
+
+/**
+ * @brief Start the helper task and put the split blend into the display's draw context
+ */
+bool render_split_init(lv_disp_t* disp) {
+#if RENDER_SPLIT_ENABLED
+    if (helper == NULL) {
+        helper = xTaskCreateStaticPinnedToCore(helper_task, "Render_Split", RENDER_SPLIT_STACK_SIZE, NULL,
+                                               RENDER_SPLIT_PRIORITY, helper_stack, &helper_tcb,
+                                               RENDER_SPLIT_CORE);
+        if (helper == NULL) {
+            LOGE(UI, "❌ Render split helper could not be created");
+            return false;
+        }
+    }
+    install(disp);
+    portENTER_CRITICAL(&stats_mux);
+    stats.running = true;
+    portEXIT_CRITICAL(&stats_mux);
+    LOGI(UI, "✅ Blends over %d px split with core %d while it is under %d%% busy",
+         RENDER_SPLIT_MIN_PX, RENDER_SPLIT_CORE, RENDER_SPLIT_CORE_MAX_PCT);
+    return true;
+#else
+    return false;                   // Its stack is only reserved with RENDER_SPLIT_ENABLED
+#endif
+}
+
+/**
+ * @brief Decide, from the CPU load, whether the refresh starting now splits its blends
+ */
+void render_split_begin_refresh(lv_disp_t* disp) {
+    if (helper == NULL) {
+        return;
+    }
+    install(disp);                  // A driver update may have rebuilt the draw context
+
+    float pct = cpu_load_core_pct(RENDER_SPLIT_CORE);
+    allowed = xPortGetCoreID() != RENDER_SPLIT_CORE && pct <= RENDER_SPLIT_CORE_MAX_PCT;
+    portENTER_CRITICAL(&stats_mux);
+    stats.allowed = allowed;
+    stats.core_pct = pct;
+    if (allowed) {
+        stats.refreshes++;
+    } else {
+        stats.refreshes_busy++;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Copy the split figures
+ */
+void render_split_get_stats(render_split_stats_t* out) {
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Point the software renderer's blend at split_blend()
+ */
+static void install(lv_disp_t* disp) {
+    if (disp == NULL || disp->driver->draw_ctx == NULL) {
+        return;
+    }
+    lv_draw_sw_ctx_t* sw = (lv_draw_sw_ctx_t*)disp->driver->draw_ctx;
+    if (sw->blend != split_blend) {
+        sw->blend = split_blend;
+    }
+}
+
+/**
+ * @brief Blend the bottom stripe here and hand the top one to the helper
+ */
+static void split_blend(lv_draw_ctx_t* draw_ctx, const lv_draw_sw_blend_dsc_t* dsc) {
+    lv_area_t area;
+    if (!allowed || !_lv_area_intersect(&area, dsc->blend_area, draw_ctx->clip_area) ||
+        lv_area_get_size(&area) < RENDER_SPLIT_MIN_PX || lv_area_get_height(&area) < 2) {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        return;
+    }
+
+    // blend_basic() cuts the source and the mask to the clip area by itself,
+    // so each half only needs its own clip
+    lv_coord_t middle = area.y1 + lv_area_get_height(&area) / 2;
+    stripe_ctx = *draw_ctx;
+    stripe_clip = area;
+    stripe_clip.y2 = middle - 1;
+    stripe_ctx.clip_area = &stripe_clip;
+    stripe_dsc = dsc;
+    __atomic_store_n(&stripe_state, STRIPE_PENDING, __ATOMIC_RELEASE);
+    xTaskNotifyGive(helper);
+
+    lv_draw_ctx_t bottom_ctx = *draw_ctx;
+    lv_area_t bottom = area;
+    bottom.y1 = middle;
+    bottom_ctx.clip_area = &bottom;
+    lv_draw_sw_blend_basic(&bottom_ctx, dsc);
+
+    uint32_t expected = STRIPE_PENDING;
+    bool stolen = __atomic_compare_exchange_n(&stripe_state, &expected, STRIPE_IDLE, false,
+                                              __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE);
+    if (stolen) {
+        lv_draw_sw_blend_basic(&stripe_ctx, dsc);
+    } else {
+        while (__atomic_load_n(&stripe_state, __ATOMIC_ACQUIRE) != STRIPE_DONE) {
+        }
+        __atomic_store_n(&stripe_state, STRIPE_IDLE, __ATOMIC_RELAXED);
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.blends++;
+    stats.stripes_stolen += stolen ? 1 : 0;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+#if RENDER_SPLIT_ENABLED
+/**
+ * @brief Draw each published stripe that the UI task has not taken back
+ */
+static void helper_task(void* parameter) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // A notification left over from a stolen stripe finds it idle
+        uint32_t expected = STRIPE_PENDING;
+        if (!__atomic_compare_exchange_n(&stripe_state, &expected, STRIPE_RUNNING, false,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        lv_draw_sw_blend_basic(&stripe_ctx, stripe_dsc);
+        uint32_t px = lv_area_get_size(&stripe_clip);
+        __atomic_store_n(&stripe_state, STRIPE_DONE, __ATOMIC_RELEASE);
+
+        portENTER_CRITICAL(&stats_mux);
+        stats.stripes_helper++;
+        stats.px_helper += px;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+}
+#endif
@@ -0,0 +1,932 @@
+/**
+ * @file renderer.cpp
+ * @brief The one owner of the ST7789 panel, LVGL, its draw buffers and its tick
+ *
+ * Scenes only build and refresh LVGL objects; everything about getting
+ * pixels onto the glass lives here, so rendering is tuned in one place.
+ * The bus itself, SPI or i80 as the board profile has it, is panel.h's.
+ *
+ * With DISPLAY_FLUSH_DMA each flushed band is queued to DMA and the
+ * flush returns at once, so LVGL renders the next band into the other
+ * draw buffer while this one is on the wire. panel_push() waits for the
+ * previous transfer before queueing, so a buffer is never reused while
+ * the DMA still reads it.
+ *
+ * In RENDERER_MODE_FULL_FRAME LVGL instead renders into two full-size
+ * PSRAM framebuffers in direct mode, and the flush compares each dirty area
+ * row by row against the other framebuffer, which matches the panel. Runs
+ * of changed rows go out as rectangles, staged through the band buffers
+ * (internal, DMA capable) two at a time, so a blink that repaints the face
+ * area sends little more than the eyelids.
+ *
+ * Every refresh is timed through the driver's render_start_cb and
+ * monitor_cb, with the time spent inside disp_flush() split out, so buffer
+ * sizes and the DMA mode can be tuned against renderer_get_profile().
+ *
+ * The refresh timer's period follows what is on screen: 60 fps while an
+ * animation runs, the pen is down or a scroll is under way, 2 Hz for a
+ * static screen, whose label changes are then drawn together. The active
+ * period stretches towards 30 fps while the averaged refresh time, with
+ * headroom, no longer fits in it.
+ */
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <lvgl.h>
+#include "config.h"
+#include "renderer.h"
+#include "backlight.h"
+#include "panel.h"
+#include "spi_bus.h"
+#include "touch.h"
+#include "gestures.h"
+#include "ui_theme.h"
+#include "lvgl_pool.h"
+#include "render_split.h"
+#include "mem_policy.h"
+#include "power_manager.h"
+#include "event_trace.h"
+#include "latency_trace.h"
+#include "boot_profile.h"
+#include "logger.h"
+
+// ST7789 sleep commands; the panel keeps its GRAM while asleep
+#define PANEL_SLPIN     0x10
+#define PANEL_SLPOUT    0x11
+#define PANEL_SLPOUT_MS 5          // Before the panel takes further commands
+#define TOUCH_FRAME_ROTATION 1     // Rotation touch_read() reports coordinates in
+
+// LVGL draw buffers - internal DMA-capable RAM, PSRAM only as a fallback
+static lv_disp_draw_buf_t draw_buf;
+static lv_color_t *buf1;
+static lv_color_t *buf2;
+static size_t band_px = 0;                  // Pixels in each of buf1 and buf2
+static lv_color_t* frames[2] = { NULL, NULL }; // Full-frame mode framebuffers
+static bool frame_resend = false;           // Panel may differ from both framebuffers
+static uint8_t staging_next = 0;            // Band buffer the next rectangle is staged in
+static lv_disp_drv_t disp_drv;
+static bool flush_dma = false;
+#if !LV_TICK_CUSTOM
+static esp_timer_handle_t tick_timer = NULL;
+#endif
+static renderer_info_t info;
+static bool initialized = false;
+static bool standby = false;
+static bool bus_held = false;               // Display host held for the frame being flushed
+static lv_timer_t* touch_timer = NULL;     // LVGL's input read timer, paused while untouched
+static renderer_profile_t profile;
+static int64_t refresh_start_us = 0;
+static uint32_t refresh_flush_us = 0;      // Spent in disp_flush() by the refresh under way
+static uint32_t refresh_avg_us = 0;        // EWMA of active refreshes, sets the active period
+static bool animating = false;              // Refresh period is the active one
+static uint16_t flush_trace = 0;            // Latency trace waiting for the next frame to go out
+#if RENDERER_PROFILE_OVERLAY
+static renderer_label_t overlay_label;
+static uint32_t overlay_refreshes = 0;     // profile.refreshes when the overlay was last set
+static bool overlay_changed = false;       // ...and whether that cost a refresh of its own
+#endif
+
+// Scenes shown so far and their screens (NULL once evicted)
+static const renderer_scene_t* scenes[RENDERER_MAX_SCENES];
+static lv_obj_t* screens[RENDERER_MAX_SCENES];
+static uint32_t shown_ms[RENDERER_MAX_SCENES];
+static uint8_t scene_count = 0;
+static const renderer_scene_t* current_scene = NULL;
+
+// Forward declarations
+static void disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p);
+static void touchpad_read(lv_indev_drv_t *indev_driver, lv_indev_data_t *data);
+static uint16_t plan_band_rows(uint16_t row_px);
+static bool allocate_draw_buffers(uint16_t rows, uint16_t row_px, mem_class_t mem_class);
+static void rotate_touch(int16_t* x, int16_t* y);
+static void flush_frame_diff(const lv_color_t *back);
+static void flush_area_diff(const lv_area_t *area, const lv_color_t *back);
+static bool row_span(const lv_color_t* back, const lv_color_t* front, lv_coord_t x1, lv_coord_t x2,
+                     lv_coord_t* first, lv_coord_t* last);
+static void push_rect(const lv_color_t* back, lv_coord_t stride, lv_coord_t x1, lv_coord_t y1,
+                      lv_coord_t x2, lv_coord_t y2);
+static uint8_t evict_idle_scenes(uint8_t keep, uint32_t reserve);
+static void render_start(lv_disp_drv_t *disp);
+static void refresh_done(lv_disp_drv_t *disp, uint32_t time_ms, uint32_t px);
+static void govern_refresh_period(lv_disp_t* disp);
+#if RENDERER_PROFILE_OVERLAY
+static void update_overlay(uint32_t now_ms);
+#endif
+#if !LV_TICK_CUSTOM
+static void lvgl_tick(void* arg);
+#endif
+
+/**
+ * @brief Bring up the panel, LVGL, its draw buffers and its tick source
+ */
+bool renderer_init(void) {
+    if (initialized) {
+        return true;
+    }
+    LOGI(UI, "🖥️  Initializing ST7789 renderer...");
+    
+    panel_info_t panel;
+    if (!panel_init(DISPLAY_ROTATION, &panel)) {
+        return false;
+    }
+    info.width = panel_width();
+    info.height = panel_height();
+    info.rotation = DISPLAY_ROTATION;
+    
+    // Turn on backlight, plain on/off if PWM is unavailable
+    if (!backlight_init()) {
+        pinMode(BOARD.display.bl, OUTPUT);
+        digitalWrite(BOARD.display.bl, HIGH);
+    }
+    
+    LOGI(UI, "✅ Display initialized: %dx%d pixels, rotation %d, %s at %lu MHz",
+         info.width, info.height, DISPLAY_ROTATION, panel.bus, panel.bus_hz / 1000000);
+    
+    flush_dma = panel.dma;
+    if (flush_dma) {
+        LOGI(UI, "✅ Display flushes via %s DMA", panel.bus);
+    }
+    
+    // Initialize LVGL; its heap comes from lvgl_pool_alloc()
+    lv_init();
+    ui_theme_init();
+    lvgl_pool_sample(millis());
+    
+    // Draw buffers: LVGL renders into them pixel by pixel and SPI DMA reads
+    // them directly, so internal RAM beats PSRAM on both counts. Rows are
+    // as wide as the current rotation's; a later rotation reflows them
+    uint16_t row_px = info.width;
+    uint16_t rows = plan_band_rows(row_px);
+    const char* placement = "internal DMA RAM";
+    if (rows == 0 || !allocate_draw_buffers(rows, row_px, MEM_HOT_DMA)) {
+        rows = DISPLAY_BAND_FALLBACK_ROWS;
+        placement = "PSRAM";
+        LOGW(UI, "⚠️  No internal DMA RAM for draw buffers - using PSRAM (slower rendering, bounce-buffered DMA)");
+        if (!psramFound() || !allocate_draw_buffers(rows, row_px, MEM_BULK)) {
+            placement = "internal RAM";
+            if (!allocate_draw_buffers(rows, row_px, MEM_HOT_CPU)) {
+                LOGE(UI, "❌ Failed to allocate display buffers");
+                return false;
+            }
+        }
+    }
+    size_t buffer_size = (size_t)row_px * rows;
+    band_px = buffer_size;
+    LOGI(UI, "✅ Display buffers: 2 x %d rows (%d KB each) in %s",
+         rows, (int)(buffer_size * sizeof(lv_color_t) / 1024), placement);
+    info.band_rows = rows;
+    info.buffer_placement = placement;
+    info.flush_dma = flush_dma;
+    info.refresh_period_ms = LV_DISP_DEF_REFR_PERIOD;
+    info.active_period_ms = RENDERER_ACTIVE_FRAME_MS;
+    info.bus = panel.bus;
+    info.bus_hz = panel.bus_hz;
+    
+    // Initialize display buffer
+    lv_disp_draw_buf_init(&draw_buf, buf1, buf2, buffer_size);
+    
+    // Initialize display driver
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = info.width;
+    disp_drv.ver_res = info.height;
+    disp_drv.flush_cb = disp_flush;
+    disp_drv.render_start_cb = render_start;
+    disp_drv.monitor_cb = refresh_done;
+    disp_drv.draw_buf = &draw_buf;
+    lv_disp_drv_register(&disp_drv);
+#if RENDER_SPLIT_ENABLED
+    render_split_init(lv_disp_get_default());
+#endif
+    
+#if RENDERER_PROFILE_OVERLAY
+    // On the top layer, so it stays put across scene changes
+    lv_obj_t* overlay = renderer_label_create(&overlay_label, lv_layer_top(), RENDERER_PROFILE_OVERLAY_MS);
+    ui_theme_apply(overlay, UI_STYLE_OVERLAY);
+    lv_obj_align(overlay, LV_ALIGN_BOTTOM_RIGHT, 0, 0);
+#endif
+    
+    // Initialize input device (touchpad) if available. It is only polled
+    // between a pen-down interrupt and the release
+    if (BOARD.touch.cs >= 0 && touch_init()) {
+        static lv_indev_drv_t indev_drv;
+        lv_indev_drv_init(&indev_drv);
+        indev_drv.type = LV_INDEV_TYPE_POINTER;
+        indev_drv.read_cb = touchpad_read;
+        lv_indev_drv_register(&indev_drv);
+        touch_timer = indev_drv.read_timer;
+        lv_timer_set_period(touch_timer, TOUCH_READ_PERIOD_MS);
+        lv_timer_pause(touch_timer);
+        LOGI(UI, "✅ Touchpad initialized");
+    }
+    
+    // LVGL's clock: animations, refresh period and input polling run off it.
+    // platformio.ini binds it to esp_timer_get_time() (LV_TICK_CUSTOM), which
+    // is exact and costs no wakeups; a periodic esp_timer is the fallback
+#if !LV_TICK_CUSTOM
+    const esp_timer_create_args_t tick_args = {
+        .callback = lvgl_tick,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "lv_tick",
+        .skip_unhandled_events = true
+    };
+    if (esp_timer_create(&tick_args, &tick_timer) != ESP_OK ||
+        esp_timer_start_periodic(tick_timer, RENDERER_TICK_MS * 1000) != ESP_OK) {
+        LOGE(UI, "❌ Failed to start the LVGL tick");
+        return false;
+    }
+#endif
+    
+    initialized = true;
+    LOGI(UI, "🎨 LVGL initialized successfully");
+#if DISPLAY_FULL_FRAME
+    renderer_set_mode(RENDERER_MODE_FULL_FRAME);
+#endif
+    return true;
+}
+
+/**
+ * @brief Turn the picture to another TFT_eSPI rotation (0-3)
+ */
+void renderer_set_rotation(uint8_t rotation) {
+    rotation &= 3;
+    if (!initialized || rotation == info.rotation) {
+        return;
+    }
+    panel_set_rotation(rotation);
+    info.rotation = rotation;
+    info.width = panel_width();
+    info.height = panel_height();
+    info.rotations++;
+    frame_resend = true;
+
+    // Resizes every screen and marks all layouts dirty; the next frame
+    // recomputes them and redraws the active screen in full
+    disp_drv.hor_res = info.width;
+    disp_drv.ver_res = info.height;
+    lv_disp_drv_update(lv_disp_get_default(), &disp_drv);
+    LOGI(UI, "🔄 Display rotation %d: %dx%d", rotation, info.width, info.height);
+}
+
+/**
+ * @brief Switch between band rendering and full-frame diff rendering
+ */
+bool renderer_set_mode(renderer_mode_t mode) {
+    if (!initialized || mode == info.mode) {
+        return initialized;
+    }
+
+    size_t frame_px = (size_t)info.width * info.height;
+    if (mode == RENDERER_MODE_FULL_FRAME) {
+        for (uint8_t i = 0; i < 2; i++) {
+            frames[i] = (lv_color_t*)mem_alloc(MEM_BULK, frame_px * sizeof(lv_color_t));
+        }
+        if (frames[0] == NULL || frames[1] == NULL) {
+            mem_free(MEM_BULK, frames[0], frame_px * sizeof(lv_color_t));
+            mem_free(MEM_BULK, frames[1], frame_px * sizeof(lv_color_t));
+            frames[0] = frames[1] = NULL;
+            LOGW(UI, "⚠️  No PSRAM for 2 x %d KB framebuffers - staying in band mode",
+                 (int)(frame_px * sizeof(lv_color_t) / 1024));
+            return false;
+        }
+    }
+    panel_wait();
+
+    // LVGL is between refreshes here, so neither buffer set is in use
+    if (mode == RENDERER_MODE_FULL_FRAME) {
+        lv_disp_draw_buf_init(&draw_buf, frames[0], frames[1], frame_px);
+        disp_drv.direct_mode = 1;
+        frame_resend = true;
+    } else {
+        lv_disp_draw_buf_init(&draw_buf, buf1, buf2, band_px);
+        disp_drv.direct_mode = 0;
+        mem_free(MEM_BULK, frames[0], frame_px * sizeof(lv_color_t));
+        mem_free(MEM_BULK, frames[1], frame_px * sizeof(lv_color_t));
+        frames[0] = frames[1] = NULL;
+    }
+    lv_disp_drv_update(lv_disp_get_default(), &disp_drv);   // Invalidates the whole screen
+    info.mode = mode;
+    info.mode_switches++;
+    LOGI(UI, "🖥️  Render mode: %s", mode == RENDERER_MODE_FULL_FRAME ? "full frame, diff flush" : "bands");
+    return true;
+}
+
+/**
+ * @brief Give back what the renderer can rebuild: idle screens, and with
+ *        deep the image cache and the full-frame framebuffers
+ */
+uint8_t renderer_release_memory(bool deep) {
+    if (!initialized) {
+        return 0;
+    }
+    // No scene is being built, so every idle screen is a candidate
+    uint8_t evicted = evict_idle_scenes(RENDERER_MAX_SCENES, UINT32_MAX);
+    if (deep) {
+        lv_img_cache_invalidate_src(NULL);
+        renderer_set_mode(RENDERER_MODE_BANDS);
+    }
+    return evicted;
+}
+
+/**
+ * @brief Make a scene current, building its screen if it has none
+ */
+bool renderer_show(const renderer_scene_t* scene) {
+    uint8_t index = 0;
+    while (index < scene_count && scenes[index] != scene) {
+        index++;
+    }
+
+    if (index == scene_count) {
+        if (scene_count == RENDERER_MAX_SCENES) {
+            LOGE(UI, "❌ No room for scene %s", scene->name);
+            return false;
+        }
+        scenes[index] = scene;
+        screens[index] = NULL;
+        scene_count++;
+    }
+
+    if (screens[index] == NULL) {
+        evict_idle_scenes(index, RENDERER_SCENE_RESERVE);
+        screens[index] = lv_obj_create(NULL);
+        ui_theme_apply(screens[index], UI_STYLE_SCREEN);
+        scene->create(screens[index]);
+        info.scene_builds++;
+    }
+
+    current_scene = scene;
+    shown_ms[index] = millis();
+    lv_scr_load(screens[index]);
+    return true;
+}
+
+/**
+ * @brief The scene on screen, NULL before the first renderer_show()
+ */
+const renderer_scene_t* renderer_current_scene(void) {
+    return current_scene;
+}
+
+/**
+ * @brief Time until the current scene's update() has work
+ */
+uint32_t renderer_scene_wait_ms(uint32_t now_ms) {
+    if (current_scene == NULL || current_scene->wait_ms == NULL) {
+        return UINT32_MAX;
+    }
+    return current_scene->wait_ms(now_ms);
+}
+
+/**
+ * @brief Update the current scene and let LVGL render and flush
+ *
+ * LVGL's refresh timer is paused while nothing is invalidated (any
+ * invalidation resumes it), so a still screen leaves no LVGL timer due and
+ * the caller can sleep until its own next event.
+ *
+ * A frame that overruns RENDERER_FRAME_BUDGET_MS means the flush pipeline
+ * is behind, so the next frame waits one budget per overrun, up to
+ * RENDERER_MAX_SKIP. Animations are time based and jump to where they
+ * should be, so dropping frames decimates motion rather than slowing it.
+ */
+uint32_t renderer_frame(void) {
+    power_manager_acquire(POWER_CLIENT_RENDER);
+    int64_t start_us = esp_timer_get_time();
+    if (current_scene != NULL && current_scene->update != NULL) {
+        current_scene->update(millis());
+    }
+#if RENDERER_PROFILE_OVERLAY
+    update_overlay(millis());
+#endif
+    static uint32_t pool_sampled_ms = 0;
+    if (millis() - pool_sampled_ms >= LVGL_POOL_SAMPLE_MS) {
+        pool_sampled_ms = millis();
+        lvgl_pool_sample(pool_sampled_ms);
+    }
+
+    lv_disp_t* disp = lv_disp_get_default();
+    if (disp != NULL) {
+        govern_refresh_period(disp);
+        if (disp->inv_p == 0) {
+            lv_timer_pause(disp->refr_timer);
+        }
+    }
+    uint32_t wait_ms = lv_timer_handler();
+    info.frame_us = (uint32_t)(esp_timer_get_time() - start_us);
+    info.frames++;
+
+    const uint32_t budget_us = RENDERER_FRAME_BUDGET_MS * 1000;
+    if (info.frame_us > budget_us) {
+        uint32_t skip = min(info.frame_us / budget_us, (uint32_t)RENDERER_MAX_SKIP);
+        wait_ms = max(wait_ms, skip * RENDERER_FRAME_BUDGET_MS);
+        info.frames_over_budget++;
+        info.frames_skipped += skip;
+        profile.frames_dropped = info.frames_skipped;
+    }
+    power_manager_release(POWER_CLIENT_RENDER);
+    return wait_ms == LV_NO_TIMER_READY ? UINT32_MAX : wait_ms;
+}
+
+/**
+ * @brief Shortest gap between frames the renderer wants now
+ */
+uint32_t renderer_frame_interval_ms(void) {
+    return info.refresh_period_ms;
+}
+
+/**
+ * @brief Park the panel with its last frame, or wake it
+ */
+bool renderer_standby(bool enter) {
+    if (!initialized || enter == standby) {
+        return true;
+    }
+    uint32_t now = millis();
+
+    if (enter) {
+        // The parked frame must be complete: nothing dirty, nothing in flight
+        lv_disp_t* disp = lv_disp_get_default();
+        if (disp->inv_p != 0 || lv_anim_count_running() > 0 || !backlight_standby(true, now)) {
+            return false;
+        }
+        panel_command(PANEL_SLPIN);
+        info.standby_entries++;
+        LOGI(UI, "💤 Display in standby");
+    } else {
+        // GRAM still holds the frame, so no redraw is needed
+        panel_command(PANEL_SLPOUT);
+        delay(PANEL_SLPOUT_MS);
+        backlight_standby(false, now);
+        LOGI(UI, "🖥️  Display awake");
+    }
+    standby = enter;
+    info.standby = enter;
+    return true;
+}
+
+/**
+ * @brief Start polling the touch controller after a pen-down interrupt
+ */
+void renderer_touch_active(void) {
+    if (touch_timer != NULL) {
+        lv_timer_resume(touch_timer);
+        lv_timer_ready(touch_timer);
+    }
+}
+
+/**
+ * @brief The panel is parked by renderer_standby()
+ */
+bool renderer_in_standby(void) {
+    return standby;
+}
+
+/**
+ * @brief Create a cached label on a scene's screen
+ */
+lv_obj_t* renderer_label_create(renderer_label_t* label, lv_obj_t* parent, uint32_t period_ms) {
+    memset(label, 0, sizeof(*label));
+    label->obj = lv_label_create(parent);
+    label->period_ms = period_ms;
+    lv_label_set_text_static(label->obj, "");
+    return label->obj;
+}
+
+/**
+ * @brief The label's refresh period has elapsed (always true before its first text)
+ */
+bool renderer_label_due(const renderer_label_t* label, uint32_t now_ms) {
+    return !label->shown || now_ms - label->refreshed_ms >= label->period_ms;
+}
+
+/**
+ * @brief Time until the label is due, UINT32_MAX if it only follows frames
+ */
+uint32_t renderer_label_wait_ms(const renderer_label_t* label, uint32_t now_ms) {
+    if (!label->shown) return 0;
+    if (label->period_ms == 0) return UINT32_MAX;
+    uint32_t elapsed = now_ms - label->refreshed_ms;
+    return elapsed >= label->period_ms ? 0 : label->period_ms - elapsed;
+}
+
+/**
+ * @brief Format the label's text and hand it to LVGL only if it changed
+ */
+bool renderer_label_printf(renderer_label_t* label, uint32_t now_ms, const char* format, ...) {
+    char scratch[RENDERER_LABEL_CHARS];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(scratch, sizeof(scratch), format, args);
+    va_end(args);
+    label->refreshed_ms = now_ms;
+
+    if (label->shown && strcmp(scratch, label->text) == 0) {
+        info.label_unchanged++;
+        return false;
+    }
+
+    // LVGL keeps pointing at our copy, so nothing is allocated per update
+    memcpy(label->text, scratch, sizeof(label->text));
+    lv_label_set_text_static(label->obj, label->text);
+    label->shown = true;
+    info.label_updates++;
+    return true;
+}
+
+/**
+ * @brief Mark a latency trace's flush stage when the next frame's last band is out (UI task)
+ */
+void renderer_trace_flush(uint16_t trace) {
+    if (flush_trace != 0) {
+        latency_trace_end(flush_trace, LATENCY_END_COALESCED);
+    }
+    flush_trace = trace;
+}
+
+/**
+ * @brief Copy the renderer configuration and frame counter
+ */
+void renderer_get_info(renderer_info_t* out) {
+    *out = info;
+}
+
+/**
+ * @brief Copy the refresh timings
+ */
+void renderer_get_profile(renderer_profile_t* out) {
+    *out = profile;
+}
+
+#if !LV_TICK_CUSTOM
+/**
+ * @brief esp_timer callback advancing the LVGL clock
+ */
+static void lvgl_tick(void* arg) {
+    lv_tick_inc(RENDERER_TICK_MS);
+}
+#endif
+
+/**
+ * @brief Delete idle screens, least recently shown first, until LVGL has
+ *        reserve bytes free
+ * @param keep Scene about to be built, never a candidate
+ * @return Screens deleted
+ */
+static uint8_t evict_idle_scenes(uint8_t keep, uint32_t reserve) {
+    uint8_t evicted = 0;
+    while (true) {
+        lv_mem_monitor_t mem;
+        lv_mem_monitor(&mem);
+        if (mem.free_size >= reserve) {
+            return evicted;
+        }
+
+        int8_t oldest = -1;
+        for (uint8_t i = 0; i < scene_count; i++) {
+            if (i == keep || screens[i] == NULL || scenes[i] == current_scene ||
+                scenes[i]->destroy == NULL) {
+                continue;
+            }
+            if (oldest < 0 || (int32_t)(shown_ms[i] - shown_ms[oldest]) < 0) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            return evicted;
+        }
+
+        scenes[oldest]->destroy();
+        lv_obj_del(screens[oldest]);
+        screens[oldest] = NULL;
+        info.scene_evictions++;
+        evicted++;
+        LOGI(UI, "🧹 Scene %s evicted (%lu bytes of LVGL memory were free)",
+             scenes[oldest]->name, mem.free_size);
+    }
+}
+
+/**
+ * @brief Band height two internal DMA buffers can have without eating the heap reserve
+ * @return Rows per buffer, 0 if not even DISPLAY_BAND_MIN_ROWS fit
+ */
+static uint16_t plan_band_rows(uint16_t row_px) {
+    const uint32_t caps = MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL;
+    size_t row_bytes = row_px * sizeof(lv_color_t);
+    size_t free_bytes = heap_caps_get_free_size(caps);
+    size_t largest = heap_caps_get_largest_free_block(caps);
+    size_t spare = free_bytes > DISPLAY_HEAP_RESERVE ? free_bytes - DISPLAY_HEAP_RESERVE : 0;
+
+    size_t rows = min(spare / (2 * row_bytes), largest / row_bytes);
+    if (rows < DISPLAY_BAND_MIN_ROWS) {
+        return 0;
+    }
+    return (uint16_t)min(rows, (size_t)DISPLAY_BAND_MAX_ROWS);
+}
+
+/**
+ * @brief Allocate both draw buffers in one allocation class, or neither
+ */
+static bool allocate_draw_buffers(uint16_t rows, uint16_t row_px, mem_class_t mem_class) {
+    size_t bytes = (size_t)row_px * rows * sizeof(lv_color_t);
+    buf1 = (lv_color_t*)mem_alloc(mem_class, bytes);
+    buf2 = (lv_color_t*)mem_alloc(mem_class, bytes);
+    if (buf1 == NULL || buf2 == NULL) {
+        mem_free(mem_class, buf1, bytes);
+        mem_free(mem_class, buf2, bytes);
+        buf1 = buf2 = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief LVGL is about to render the invalidated areas: start the refresh clock
+ */
+static void render_start(lv_disp_drv_t *disp) {
+    refresh_start_us = esp_timer_get_time();
+    refresh_flush_us = 0;
+#if RENDER_SPLIT_ENABLED
+    render_split_begin_refresh(lv_disp_get_default());
+#endif
+}
+
+/**
+ * @brief LVGL finished a refresh that drew px pixels
+ *
+ * LVGL's own time_ms has tick resolution; the esp_timer pair is used instead.
+ */
+static void refresh_done(lv_disp_drv_t *disp, uint32_t time_ms, uint32_t px) {
+    uint32_t refresh_us = (uint32_t)(esp_timer_get_time() - refresh_start_us);
+    uint32_t flush_us = min(refresh_flush_us, refresh_us);
+    uint32_t render_us = refresh_us - flush_us;
+
+    profile.refreshes++;
+    profile.refresh_us = refresh_us;
+    profile.refresh_max_us = max(profile.refresh_max_us, refresh_us);
+    profile.render_us = render_us;
+    profile.render_max_us = max(profile.render_max_us, render_us);
+    profile.render_total_us += render_us;
+    profile.flush_us = flush_us;
+    profile.flush_max_us = max(profile.flush_max_us, flush_us);
+    profile.flush_total_us += flush_us;
+    profile.area_px = px;
+    profile.area_total_px += px;
+    if (animating) {
+        // EWMA over about 8 refreshes
+        int32_t delta = (int32_t)(refresh_us - refresh_avg_us);
+        refresh_avg_us = refresh_avg_us == 0 ? refresh_us : refresh_avg_us + delta / 8;
+    }
+    if (profile.refreshes == 1) {
+        boot_profile_end(BOOT_STAGE_FIRST_FRAME);
+    }
+}
+
+/**
+ * @brief Pick the refresh timer's period for what is on screen
+ *
+ * Called after the scene's update, so an animation it just started counts.
+ */
+static void govern_refresh_period(lv_disp_t* disp) {
+    bool touched = touch_timer != NULL && !touch_timer->paused;
+    bool scrolling = false;
+    for (lv_indev_t* indev = lv_indev_get_next(NULL); indev != NULL; indev = lv_indev_get_next(indev)) {
+        scrolling = scrolling || lv_indev_get_scroll_obj(indev) != NULL;
+    }
+    bool active = lv_anim_count_running() > 0 || touched || scrolling;
+
+    uint32_t fitted_ms = (refresh_avg_us * RENDERER_FRAME_HEADROOM_PCT / 100 + 999) / 1000;
+    info.active_period_ms = (uint16_t)constrain(fitted_ms, (uint32_t)RENDERER_ACTIVE_FRAME_MS,
+                                                (uint32_t)RENDERER_ACTIVE_MAX_FRAME_MS);
+    uint16_t period_ms = active ? info.active_period_ms : RENDERER_STATIC_FRAME_MS;
+    if (active != animating) {
+        animating = active;
+        info.period_changes++;
+    }
+    if (period_ms != info.refresh_period_ms) {
+        info.refresh_period_ms = period_ms;
+        lv_timer_set_period(disp->refr_timer, period_ms);
+    }
+}
+
+#if RENDERER_PROFILE_OVERLAY
+/**
+ * @brief Show the refresh rate and the latest timings
+ *
+ * Only when something besides the overlay itself was drawn since its last
+ * change, so the overlay alone never keeps the screen refreshing.
+ */
+static void update_overlay(uint32_t now_ms) {
+    uint32_t drawn = profile.refreshes - overlay_refreshes;
+    if (!renderer_label_due(&overlay_label, now_ms) || drawn <= (overlay_changed ? 1u : 0u)) {
+        return;
+    }
+    uint32_t elapsed_ms = overlay_label.shown ? now_ms - overlay_label.refreshed_ms : 0;
+    uint32_t fps = elapsed_ms > 0 ? drawn * 1000 / elapsed_ms : 0;
+    overlay_changed = renderer_label_printf(&overlay_label, now_ms, "%lufps R%lu.%lu F%lu.%lums %lukpx",
+                                            fps, profile.render_us / 1000, profile.render_us / 100 % 10,
+                                            profile.flush_us / 1000, profile.flush_us / 100 % 10,
+                                            profile.area_px / 1000);
+    overlay_refreshes = profile.refreshes;
+}
+#endif
+
+/**
+ * @brief LVGL display flush callback
+ */
+static void disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p) {
+    TRACE_EVENT(TRACE_FLUSH_BEGIN, (uint16_t)area->x1 | (uint32_t)(uint16_t)area->y1 << 16,
+                (uint16_t)area->x2 | (uint32_t)(uint16_t)area->y2 << 16);
+    int64_t start_us = esp_timer_get_time();
+    uint32_t w = (area->x2 - area->x1 + 1);
+    uint32_t h = (area->y2 - area->y1 + 1);
+    
+    // The display has its host to itself; holding it from the first band
+    // to the last queued one accounts the frame's bus occupancy. An i80
+    // panel is on the LCD peripheral, no SPI host at all
+    if (BOARD_DISPLAY_BUS == DISPLAY_BUS_SPI && !bus_held) {
+        bus_held = spi_bus_acquire(SPI_DEVICE_DISPLAY, SPI_BUS_WAIT_FOREVER);
+    }
+    
+    if (info.mode == RENDERER_MODE_FULL_FRAME) {
+        // Direct mode hands over the whole back framebuffer once per dirty
+        // area; all of them are rendered by the last call
+        if (lv_disp_flush_is_last(disp)) {
+            flush_frame_diff(color_p);
+            frame_resend = false;
+        }
+    } else {
+        // With DMA, returns once the previous band is out and this one is queued
+        panel_push(area->x1, area->y1, w, h, (uint16_t*)&color_p->full);
+    }
+    
+    if (bus_held && lv_disp_flush_is_last(disp)) {
+        spi_bus_release(SPI_DEVICE_DISPLAY);
+        bus_held = false;
+    }
+    refresh_flush_us += (uint32_t)(esp_timer_get_time() - start_us);
+    profile.bands++;
+    if (info.mode == RENDERER_MODE_BANDS) {
+        profile.bytes_flushed += w * h * sizeof(lv_color_t);
+    }
+    TRACE_EVENT(TRACE_FLUSH_END, 0, 0);
+    if (flush_trace != 0 && lv_disp_flush_is_last(disp)) {
+        latency_trace_mark(flush_trace, LATENCY_STAGE_FLUSH);
+        flush_trace = 0;
+    }
+    lv_disp_flush_ready(disp);
+}
+
+/**
+ * @brief Send what changed in this refresh's dirty areas
+ *
+ * LVGL still holds the areas it just rendered; after a mode switch or a
+ * rotation the panel matches neither framebuffer, so all of it is sent.
+ */
+static void flush_frame_diff(const lv_color_t *back) {
+    if (frame_resend) {
+        lv_area_t all = { 0, 0, (lv_coord_t)(info.width - 1), (lv_coord_t)(info.height - 1) };
+        flush_area_diff(&all, back);
+        return;
+    }
+    lv_disp_t* disp = _lv_refr_get_disp_refreshing();
+    for (uint16_t i = 0; i < disp->inv_p; i++) {
+        if (!disp->inv_area_joined[i]) {
+            flush_area_diff(&disp->inv_areas[i], back);
+        }
+    }
+}
+
+/**
+ * @brief Send the rows of a redrawn area that differ from the panel
+ *
+ * Consecutive changed rows are merged into one rectangle spanning all of
+ * their changed columns, as long as it fits a band buffer; an unchanged
+ * row ends it.
+ */
+static void flush_area_diff(const lv_area_t *area, const lv_color_t *back) {
+    const lv_color_t* front = back == frames[0] ? frames[1] : frames[0];
+    lv_coord_t stride = info.width;
+    uint32_t sent_px = 0;
+
+    lv_coord_t y = area->y1;
+    while (y <= area->y2) {
+        size_t row = (size_t)y * stride;
+        lv_coord_t left, right;
+        if (frame_resend) {
+            left = area->x1;
+            right = area->x2;
+        } else if (!row_span(back + row, front + row, area->x1, area->x2, &left, &right)) {
+            y++;
+            continue;
+        }
+
+        lv_coord_t top = y++;
+        while (y <= area->y2) {
+            row = (size_t)y * stride;
+            lv_coord_t first = area->x1, last = area->x2;
+            if (!frame_resend && !row_span(back + row, front + row, area->x1, area->x2, &first, &last)) {
+                break;
+            }
+            lv_coord_t l = min(left, first), r = max(right, last);
+            if ((size_t)(r - l + 1) * (y - top + 1) > band_px) {
+                break;
+            }
+            left = l;
+            right = r;
+            y++;
+        }
+        push_rect(back, stride, left, top, right, y - 1);
+        sent_px += (uint32_t)(right - left + 1) * (y - top);
+    }
+
+    uint32_t area_px = (uint32_t)(area->x2 - area->x1 + 1) * (area->y2 - area->y1 + 1);
+    profile.bytes_flushed += sent_px * sizeof(lv_color_t);
+    profile.bytes_unchanged += (area_px - min(sent_px, area_px)) * sizeof(lv_color_t);
+}
+
+/**
+ * @brief First and last column of [x1, x2] where a row differs between the framebuffers
+ * @return false if the row is unchanged
+ */
+static bool row_span(const lv_color_t* back, const lv_color_t* front, lv_coord_t x1, lv_coord_t x2,
+                     lv_coord_t* first, lv_coord_t* last) {
+    lv_coord_t l = x1;
+    while (l <= x2 && back[l].full == front[l].full) {
+        l++;
+    }
+    if (l > x2) {
+        return false;
+    }
+    lv_coord_t r = x2;
+    while (back[r].full == front[r].full) {
+        r--;
+    }
+    *first = l;
+    *last = r;
+    return true;
+}
+
+/**
+ * @brief Copy a rectangle of the back framebuffer into a band buffer and send it
+ *
+ * The band buffers alternate: panel_push() returns once the previous
+ * rectangle is out, so the buffer being overwritten is never still on the wire.
+ */
+static void push_rect(const lv_color_t* back, lv_coord_t stride, lv_coord_t x1, lv_coord_t y1,
+                      lv_coord_t x2, lv_coord_t y2) {
+    uint32_t w = x2 - x1 + 1;
+    uint32_t h = y2 - y1 + 1;
+    lv_color_t* staging = staging_next ? buf2 : buf1;
+    staging_next ^= 1;
+    for (lv_coord_t y = y1; y <= y2; y++) {
+        memcpy(staging + (size_t)(y - y1) * w, back + (size_t)y * stride + x1, w * sizeof(lv_color_t));
+    }
+
+    panel_push(x1, y1, w, h, (uint16_t*)&staging->full);
+}
+
+/**
+ * @brief LVGL touchpad read callback (if touch is available)
+ */
+static void touchpad_read(lv_indev_drv_t *indev_driver, lv_indev_data_t *data) {
+    int16_t x, y;
+    if (touch_read(&x, &y)) {
+        rotate_touch(&x, &y);
+        data->point.x = x;
+        data->point.y = y;
+        data->state = LV_INDEV_STATE_PR;
+        backlight_interaction(millis());
+        gestures_feed(true, x, y, millis());
+    } else {
+        // Released: stop polling until the next pen-down interrupt
+        data->state = LV_INDEV_STATE_REL;
+        lv_timer_pause(indev_driver->read_timer);
+        gestures_feed(false, 0, 0, millis());
+    }
+}
+
+/**
+ * @brief Turn a touch point from touch_read()'s frame into the current rotation
+ *
+ * touch_read() scales to the landscape panel in TOUCH_FRAME_ROTATION;
+ * each TFT_eSPI rotation step turns the picture a further quarter turn.
+ */
+static void rotate_touch(int16_t* x, int16_t* y) {
+    const int32_t frame_w = BOARD.display.height;
+    const int32_t frame_h = BOARD.display.width;
+    int32_t u = *x;
+    int32_t v = *y;
+    int32_t nx, ny, nw, nh;             // In the current rotation, before scaling
+
+    switch ((info.rotation - TOUCH_FRAME_ROTATION) & 3) {
+        case 1:  nx = frame_h - 1 - v; ny = u;               nw = frame_h; nh = frame_w; break;
+        case 2:  nx = frame_w - 1 - u; ny = frame_h - 1 - v; nw = frame_w; nh = frame_h; break;
+        case 3:  nx = v;               ny = frame_w - 1 - u; nw = frame_h; nh = frame_w; break;
+        default: nx = u;               ny = v;               nw = frame_w; nh = frame_h; break;
+    }
+    *x = (int16_t)(nx * info.width / nw);
+    *y = (int16_t)(ny * info.height / nh);
+}
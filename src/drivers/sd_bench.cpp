@@ -0,0 +1,370 @@
+/**
+ * @file sd_bench.cpp
+ * @brief Measured SPI clock and write size for the card in the slot
+ *
+ * Cards differ widely in what they sustain over SPI, and a clock one
+ * card takes without complaint gives another CRC errors. A card the
+ * stored result does not describe is swept once, inside its mount: for
+ * each of SD_BENCH_CLOCKS it is remounted, SD_BENCH_BYTES are written in
+ * each of SD_BENCH_BLOCKS sized writes and read back, and the sweep stops
+ * at the first clock that fails to mount, write or read back intact. The
+ * card stays at the clock with the best write throughput, and the log
+ * writers use the smallest block within SD_BENCH_BLOCK_MARGIN_PCT of that
+ * clock's best, which holds the shared bus no longer than it has to. The
+ * result lives in NVS, so the next mount of the same card goes straight
+ * to its clock.
+ *
+ * Time is counted only while the bus is held, so touch reads in between
+ * do not count against the card.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <Preferences.h>
+#include <esp_system.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "job_pool.h"
+#include "sd_bench.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+#define VERIFY_BYTES  512
+
+/**
+ * @brief Timing of one block size at one clock
+ */
+typedef struct {
+    uint16_t block_bytes;
+    uint32_t write_kbps;
+    uint32_t max_block_us;
+} bench_run_t;
+
+static const uint32_t clocks[] = SD_BENCH_CLOCKS;
+static const uint16_t blocks[] = SD_BENCH_BLOCKS;
+#define CLOCK_COUNT  (sizeof(clocks) / sizeof(clocks[0]))
+#define BLOCK_COUNT  (sizeof(blocks) / sizeof(blocks[0]))
+
+static sd_bench_result_t stored = {0};
+static bool stored_loaded = false;
+static uint32_t mounted_hz = 0;
+static volatile bool busy = false;
+static sd_bench_stats_t stats = {0};
+static portMUX_TYPE bench_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void load_stored(void);
+static void save_stored(const sd_bench_result_t* result);
+static bool sweep(uint8_t card_type, uint64_t card_bytes);
+static bool time_blocks(uint8_t* buffer, uint16_t max_block, bench_run_t* chosen);
+static bool time_writes(uint8_t* buffer, uint16_t block, bench_run_t* run);
+static bool verify(const uint8_t* buffer, uint16_t block);
+static bool remount(uint32_t hz);
+static void block_job(void* payload);
+static uint16_t largest_block(void);
+
+/**
+ * @brief Clock to mount the card at: the stored result's, or SD_SPI_HZ
+ */
+uint32_t sd_bench_clock_hz(void) {
+    load_stored();
+    return stored.spi_hz != 0 ? stored.spi_hz : SD_SPI_HZ;
+}
+
+/**
+ * @brief Check a freshly mounted card against the stored result
+ */
+bool sd_bench_on_mount(uint32_t hz) {
+    load_stored();
+    mounted_hz = hz;
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    uint8_t card_type = (uint8_t)SD.cardType();
+    uint64_t card_bytes = SD.cardSize();
+    spi_bus_release(SPI_DEVICE_SD);
+
+    if (stored.spi_hz != 0 && stored.card_type == card_type && stored.card_bytes == card_bytes &&
+        mounted_hz == stored.spi_hz) {
+        portENTER_CRITICAL(&bench_mux);
+        stats.valid = true;
+        stats.result = stored;
+        portEXIT_CRITICAL(&bench_mux);
+        LOGI(SYSTEM, "💾 SD card at %lu MHz, %u B writes (%lu kB/s measured)",
+             stored.spi_hz / 1000000, stored.block_bytes, stored.write_kbps);
+        return true;
+    }
+
+    busy = true;
+    bool mounted = sweep(card_type, card_bytes);
+    busy = false;
+    return mounted;
+}
+
+/**
+ * @brief Time each of SD_BENCH_BLOCKS again at the current clock, on a job worker
+ */
+bool sd_bench_request(void) {
+    if (!sd_monitor_mounted() || busy) {
+        return false;
+    }
+    busy = true;
+    if (!job_pool_submit(JOB_LANE_LOW, block_job, NULL, 0)) {
+        busy = false;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Bytes a log writer should hand the card per write
+ */
+size_t sd_bench_block_bytes(size_t max_bytes) {
+    portENTER_CRITICAL(&bench_mux);
+    size_t block = stats.valid ? stats.result.block_bytes : max_bytes;
+    portEXIT_CRITICAL(&bench_mux);
+    return min(block, max_bytes);
+}
+
+/**
+ * @brief Copy the benchmark figures
+ */
+void sd_bench_get_stats(sd_bench_stats_t* out) {
+    portENTER_CRITICAL(&bench_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&bench_mux);
+}
+
+static void load_stored(void) {
+    if (stored_loaded) {
+        return;
+    }
+    stored_loaded = true;
+    Preferences prefs;
+    if (prefs.begin(SD_BENCH_NVS_NAMESPACE, true)) {
+        if (prefs.getBytes("result", &stored, sizeof(stored)) != sizeof(stored)) {
+            memset(&stored, 0, sizeof(stored));
+        }
+        prefs.end();
+    }
+}
+
+static void save_stored(const sd_bench_result_t* result) {
+    stored = *result;
+    Preferences prefs;
+    if (prefs.begin(SD_BENCH_NVS_NAMESPACE, false)) {
+        prefs.putBytes("result", result, sizeof(*result));
+        prefs.end();
+    }
+}
+
+/**
+ * @brief Step up through SD_BENCH_CLOCKS until one fails, then settle on the best
+ * @return false if the card could not be remounted at all
+ */
+static bool sweep(uint8_t card_type, uint64_t card_bytes) {
+    uint16_t max_block = largest_block();
+    uint8_t* buffer = (uint8_t*)mem_alloc(MEM_HOT_CPU, max_block + VERIFY_BYTES);
+    if (buffer == NULL) {
+        LOGW(SYSTEM, "⚠️  No memory for the SD benchmark - card left at %lu MHz", mounted_hz / 1000000);
+        return true;
+    }
+    // Fresh data every sweep, so stale sectors cannot pass the read-back
+    esp_fill_random(buffer, max_block);
+
+    uint32_t started = millis();
+    sd_bench_result_t best = {0};
+    uint8_t tried = 0;
+    for (uint8_t c = 0; c < CLOCK_COUNT; c++) {
+        tried++;
+        bench_run_t run;
+        if (!remount(clocks[c]) || !time_blocks(buffer, max_block, &run)) {
+            LOGW(SYSTEM, "⚠️  SD card unstable at %lu MHz", clocks[c] / 1000000);
+            break;
+        }
+        if (run.write_kbps > best.write_kbps) {
+            best.spi_hz = clocks[c];
+            best.write_kbps = run.write_kbps;
+            best.max_block_us = run.max_block_us;
+            best.block_bytes = run.block_bytes;
+        }
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    SD.remove(SD_BENCH_FILE);
+    spi_bus_release(SPI_DEVICE_SD);
+    mem_free(MEM_HOT_CPU, buffer, max_block + VERIFY_BYTES);
+
+    bool mounted;
+    if (best.spi_hz == 0) {
+        // Nothing held; keep the configured clock and measure again next mount
+        mounted = remount(SD_SPI_HZ);
+    } else {
+        mounted = (mounted_hz == best.spi_hz || remount(best.spi_hz)) || remount(SD_SPI_HZ);
+        best.card_type = card_type;
+        best.card_bytes = card_bytes;
+        if (mounted_hz == best.spi_hz) {
+            save_stored(&best);
+        }
+    }
+
+    portENTER_CRITICAL(&bench_mux);
+    stats.valid = best.spi_hz != 0 && mounted_hz == best.spi_hz;
+    stats.result = best;
+    stats.clocks_tried = tried;
+    stats.sweeps++;
+    stats.last_sweep_ms = millis() - started;
+    portEXIT_CRITICAL(&bench_mux);
+
+    LOGI(SYSTEM, "💾 SD benchmark: %lu MHz, %u B writes, %lu kB/s, %lu us worst block (%u clocks, %lu ms)",
+         mounted_hz / 1000000, best.block_bytes, best.write_kbps, best.max_block_us,
+         tried, millis() - started);
+    return mounted;
+}
+
+/**
+ * @brief Time every block size at the current clock and pick the one the writers use
+ *
+ * The smallest block within SD_BENCH_BLOCK_MARGIN_PCT of the fastest.
+ * @return false if any write or read-back failed
+ */
+static bool time_blocks(uint8_t* buffer, uint16_t max_block, bench_run_t* chosen) {
+    bench_run_t runs[BLOCK_COUNT];
+    uint32_t fastest = 0;
+    for (uint8_t b = 0; b < BLOCK_COUNT; b++) {
+        if (!time_writes(buffer, blocks[b], &runs[b]) || !verify(buffer, blocks[b])) {
+            return false;
+        }
+        fastest = max(fastest, runs[b].write_kbps);
+        LOGD(SYSTEM, "SD %lu MHz, %5u B writes: %lu kB/s, %lu us worst",
+             mounted_hz / 1000000, blocks[b], runs[b].write_kbps, runs[b].max_block_us);
+    }
+    for (uint8_t b = 0; b < BLOCK_COUNT; b++) {
+        if (runs[b].write_kbps * 100 >= fastest * (100 - SD_BENCH_BLOCK_MARGIN_PCT)) {
+            *chosen = runs[b];
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Write SD_BENCH_BYTES to the scratch file in block-sized writes, synced
+ */
+static bool time_writes(uint8_t* buffer, uint16_t block, bench_run_t* run) {
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(SD_BENCH_FILE, "w");
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!file) {
+        return false;
+    }
+
+    bool ok = true;
+    uint32_t busy_us = 0;
+    run->block_bytes = block;
+    run->max_block_us = 0;
+    for (uint32_t done = 0; done < SD_BENCH_BYTES && ok; done += block) {
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        uint32_t start = micros();
+        ok = file.write(buffer, block) == block;
+        uint32_t took = micros() - start;
+        spi_bus_release(SPI_DEVICE_SD);
+        busy_us += took;
+        run->max_block_us = max(run->max_block_us, took);
+    }
+
+    // The sync belongs to the cost: a writer pays it on every close
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    uint32_t start = micros();
+    file.close();
+    busy_us += micros() - start;
+    spi_bus_release(SPI_DEVICE_SD);
+
+    run->write_kbps = busy_us > 0 ? (uint32_t)((uint64_t)SD_BENCH_BYTES * 1000 / busy_us) : 0;
+    return ok;
+}
+
+/**
+ * @brief Read the scratch file back and compare it with the repeated block
+ */
+static bool verify(const uint8_t* buffer, uint16_t block) {
+    uint8_t* scratch = (uint8_t*)buffer + largest_block();
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(SD_BENCH_FILE, "r");
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!file) {
+        return false;
+    }
+
+    bool ok = true;
+    for (uint32_t done = 0; done < SD_BENCH_BYTES && ok; done += VERIFY_BYTES) {
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        ok = file.read(scratch, VERIFY_BYTES) == VERIFY_BYTES;
+        spi_bus_release(SPI_DEVICE_SD);
+        ok = ok && memcmp(scratch, buffer + done % block, VERIFY_BYTES) == 0;
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    file.close();
+    spi_bus_release(SPI_DEVICE_SD);
+    return ok;
+}
+
+/**
+ * @brief Unmount and mount again at another clock; no file may be open
+ */
+static bool remount(uint32_t hz) {
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    SD.end();
+    bool ok = SD.begin(BOARD.sd.cs, *spi_bus_host(SPI_DEVICE_SD), hz);
+    spi_bus_release(SPI_DEVICE_SD);
+    mounted_hz = ok ? hz : 0;
+    return ok;
+}
+
+/**
+ * @brief Job: time the block sizes at the current clock and keep the new choice
+ */
+static void block_job(void* payload) {
+    uint16_t max_block = largest_block();
+    uint8_t* buffer = (uint8_t*)mem_alloc(MEM_HOT_CPU, max_block + VERIFY_BYTES);
+    if (buffer == NULL) {
+        busy = false;
+        return;
+    }
+    esp_fill_random(buffer, max_block);
+
+    bench_run_t run;
+    bool ok = time_blocks(buffer, max_block, &run);
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    SD.remove(SD_BENCH_FILE);
+    spi_bus_release(SPI_DEVICE_SD);
+    mem_free(MEM_HOT_CPU, buffer, max_block + VERIFY_BYTES);
+
+    if (ok) {
+        sd_bench_result_t result = stored;
+        result.block_bytes = run.block_bytes;
+        result.write_kbps = run.write_kbps;
+        result.max_block_us = run.max_block_us;
+        if (result.spi_hz == mounted_hz) {
+            save_stored(&result);
+        }
+        portENTER_CRITICAL(&bench_mux);
+        stats.valid = result.spi_hz == mounted_hz;
+        stats.result = result;
+        stats.block_runs++;
+        portEXIT_CRITICAL(&bench_mux);
+        LOGI(SYSTEM, "💾 SD writes at %lu MHz: %u B chosen, %lu kB/s, %lu us worst block",
+             mounted_hz / 1000000, run.block_bytes, run.write_kbps, run.max_block_us);
+    } else {
+        LOGW(SYSTEM, "⚠️  SD benchmark failed at %lu MHz", mounted_hz / 1000000);
+    }
+    busy = false;
+}
+
+static uint16_t largest_block(void) {
+    uint16_t largest = 0;
+    for (uint8_t b = 0; b < BLOCK_COUNT; b++) {
+        largest = max(largest, blocks[b]);
+    }
+    return largest;
+}
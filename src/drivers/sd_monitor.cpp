@@ -0,0 +1,274 @@
+/**
+ * @file sd_monitor.cpp
+ * @brief SD card presence, mounting and hot-plug events
+ *
+ * SD.begin() is a full initialisation handshake, tens of milliseconds of
+ * bus time, and re-running it under open files can corrupt them, so it is
+ * only ever called on a card that has just answered. Presence comes from
+ * the card-detect switch when BOARD.sd.detect is wired, and otherwise from
+ * single commands sent directly on the shared host between the library's
+ * own transactions: CMD13 to a mounted card, which leaves its state
+ * alone, and CMD0 to an empty slot, which a newly inserted card answers.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <SD.h>
+#include <driver/gpio.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "sd_bench.h"
+#include "logger.h"
+
+#define CMD_GO_IDLE      0
+#define CMD_SEND_STATUS  13
+#define PROBE_HZ         400000     // Identification-mode clock, safe for any card
+#define NO_RESPONSE      0xFF
+
+static bool mounted = false;
+static uint8_t misses = 0;          // Consecutive probes that disagreed with mounted
+static uint32_t last_probe_ms = 0;
+static uint32_t failed_ms = 0;      // Last SD.begin() failure
+static sd_monitor_listener_t listener = NULL;
+static sd_monitor_status_t status = {0};
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static bool card_present(uint32_t now_ms, bool* probed);
+static uint8_t send_command(uint8_t command);
+static uint8_t crc7(const uint8_t* data, uint8_t length);
+static bool mount(void);
+static void unmount(void);
+static void set_mounted(bool state, uint32_t now_ms);
+
+/**
+ * @brief Mount the card if one is in the slot
+ */
+bool sd_monitor_init(void) {
+    status.card_detect = BOARD.sd.detect >= 0;
+    if (BOARD.sd.detect >= 0) {
+        pinMode(BOARD.sd.detect, INPUT_PULLUP);
+    }
+    // An empty slot then reads 0xFF instead of noise
+    gpio_pullup_en((gpio_num_t)BOARD.sd.miso);
+
+    // Without a switch the boot mount doubles as the first probe
+    bool probed = false;
+    mounted = (!status.card_detect || card_present(0, &probed)) && mount();
+    status.mounted = mounted;
+    last_probe_ms = millis();
+    return mounted;
+}
+
+/**
+ * @brief Receive hot-plug events (one listener)
+ */
+void sd_monitor_listen(sd_monitor_listener_t callback) {
+    listener = callback;
+}
+
+/**
+ * @brief Check for insertion or removal
+ */
+sd_event_t sd_monitor_poll(uint32_t now_ms) {
+    bool probed = true;
+    bool present = card_present(now_ms, &probed);
+    if (!probed || present == mounted) {
+        if (probed) {
+            misses = 0;
+        }
+        return SD_EVENT_NONE;
+    }
+    if (++misses < SD_PROBE_MISSES) {
+        return SD_EVENT_NONE;
+    }
+    misses = 0;
+
+    if (mounted) {
+        LOGI(SYSTEM, "💾 SD card removed");
+        if (listener != NULL) {
+            listener(false);
+        }
+        unmount();
+        set_mounted(false, now_ms);
+        return SD_EVENT_REMOVED;
+    }
+
+    // A card that answers but will not mount is retried at the probe interval
+    if (failed_ms != 0 && now_ms - failed_ms < SD_PROBE_INTERVAL_MS) {
+        return SD_EVENT_NONE;
+    }
+    if (!mount()) {
+        failed_ms = now_ms | 1;
+        portENTER_CRITICAL(&status_mux);
+        status.mount_failures++;
+        portEXIT_CRITICAL(&status_mux);
+        return SD_EVENT_NONE;
+    }
+    failed_ms = 0;
+    set_mounted(true, now_ms);
+    if (listener != NULL) {
+        listener(true);
+    }
+    return SD_EVENT_INSERTED;
+}
+
+/**
+ * @brief A card is mounted; no bus traffic
+ */
+bool sd_monitor_mounted(void) {
+    return mounted;
+}
+
+/**
+ * @brief Presence tracking since boot
+ */
+void sd_monitor_get_status(sd_monitor_status_t* out) {
+    portENTER_CRITICAL(&status_mux);
+    *out = status;
+    portEXIT_CRITICAL(&status_mux);
+}
+
+/**
+ * @brief Whether a card is in the slot, as far as this call can tell
+ * @param probed Cleared when nothing was checked (probe not due, bus busy)
+ */
+static bool card_present(uint32_t now_ms, bool* probed) {
+    if (BOARD.sd.detect >= 0) {
+        *probed = true;
+        return digitalRead(BOARD.sd.detect) == BOARD.sd.detect_level;
+    }
+
+    if (now_ms - last_probe_ms < SD_PROBE_INTERVAL_MS ||
+        !spi_bus_acquire(SPI_DEVICE_SD, SD_PROBE_WAIT_MS)) {
+        *probed = false;
+        return mounted;
+    }
+    last_probe_ms = now_ms;
+    uint8_t r1 = send_command(mounted ? CMD_SEND_STATUS : CMD_GO_IDLE);
+    spi_bus_release(SPI_DEVICE_SD);
+
+    portENTER_CRITICAL(&status_mux);
+    status.probes++;
+    portEXIT_CRITICAL(&status_mux);
+
+    *probed = true;
+    // Any R1 shows a card; an empty slot leaves MISO high. CMD0 puts a
+    // card in idle, which SD.begin() takes from there
+    return mounted ? r1 != NO_RESPONSE : r1 == 0x01;
+}
+
+/**
+ * @brief Send one argument-less command and return its R1, NO_RESPONSE if none
+ *
+ * The caller holds the SD bus. CMD13's R2 status byte is clocked out and
+ * dropped: the card answering at all is what counts.
+ */
+static uint8_t send_command(uint8_t command) {
+    SPIClass* spi = spi_bus_host(SPI_DEVICE_SD);
+    spi->beginTransaction(SPISettings(PROBE_HZ, MSBFIRST, SPI_MODE0));
+    if (command == CMD_GO_IDLE) {
+        // A card fresh in the slot needs 74 clocks with CS high first
+        for (uint8_t i = 0; i < 10; i++) {
+            spi->transfer(0xFF);
+        }
+    }
+
+    uint8_t frame[6] = { (uint8_t)(0x40 | command), 0, 0, 0, 0, 0 };
+    frame[5] = crc7(frame, 5);      // The SD library runs cards with CRC checks on
+    digitalWrite(BOARD.sd.cs, LOW);
+    spi->transfer(0xFF);
+    for (uint8_t i = 0; i < sizeof(frame); i++) {
+        spi->transfer(frame[i]);
+    }
+    uint8_t r1 = NO_RESPONSE;
+    for (uint8_t i = 0; i < 8 && (r1 & 0x80); i++) {
+        r1 = spi->transfer(0xFF);
+    }
+    if (command == CMD_SEND_STATUS && !(r1 & 0x80)) {
+        spi->transfer(0xFF);
+    }
+    digitalWrite(BOARD.sd.cs, HIGH);
+    spi->transfer(0xFF);
+    spi->endTransaction();
+    return r1 & 0x80 ? NO_RESPONSE : r1;
+}
+
+/**
+ * @brief SD command CRC7, shifted up with the end bit set
+ */
+static uint8_t crc7(const uint8_t* data, uint8_t length) {
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t byte = data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc <<= 1;
+            if ((byte ^ crc) & 0x80) {
+                crc ^= 0x09;
+            }
+            byte <<= 1;
+        }
+    }
+    return (uint8_t)((crc << 1) | 1);
+}
+
+/**
+ * @brief Run the library's handshake and make sure /logs exists
+ *
+ * The card is mounted at its measured clock, falling back to SD_SPI_HZ,
+ * and benchmarked before anyone hears of it if it is new.
+ */
+static bool mount(void) {
+#if SD_BENCH_ENABLED
+    uint32_t hz = sd_bench_clock_hz();
+#else
+    uint32_t hz = SD_SPI_HZ;
+#endif
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    bool ok = SD.begin(BOARD.sd.cs, *spi_bus_host(SPI_DEVICE_SD), hz);
+    if (!ok && hz != SD_SPI_HZ) {
+        SD.end();
+        hz = SD_SPI_HZ;
+        ok = SD.begin(BOARD.sd.cs, *spi_bus_host(SPI_DEVICE_SD), hz);
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+#if SD_BENCH_ENABLED
+    ok = ok && sd_bench_on_mount(hz);
+#endif
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (ok) {
+        LOGI(SYSTEM, "✅ SD Card initialized: %lluMB", SD.cardSize() / (1024 * 1024));
+        if (!SD.exists("/logs")) {
+            SD.mkdir("/logs");
+            LOGI(SYSTEM, "📁 Created /logs directory");
+        }
+    } else {
+        SD.end();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    return ok;
+}
+
+/**
+ * @brief Drop the filesystem of a card that is no longer there
+ */
+static void unmount(void) {
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    SD.end();
+    spi_bus_release(SPI_DEVICE_SD);
+}
+
+static void set_mounted(bool state, uint32_t now_ms) {
+    mounted = state;
+    portENTER_CRITICAL(&status_mux);
+    status.mounted = state;
+    if (state) {
+        status.insertions++;
+    } else {
+        status.removals++;
+    }
+    status.changed_ms = now_ms;
+    portEXIT_CRITICAL(&status_mux);
+}
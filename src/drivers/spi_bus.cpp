@@ -0,0 +1,232 @@
+/**
+ * @file spi_bus.cpp
+ * @brief SPI host assignment and arbitration between the display, SD card and touch
+ *
+ * The ESP32-S3 has two SPI hosts for general use. An SPI display takes FSPI
+ * (VSPI on the classic ESP32) alone: its flushes are DMA transfers that hold the bus for most of every
+ * frame, and a card write queued behind them, or in front of them, would
+ * stall one side for milliseconds. The SD card and the touch controller
+ * share HSPI. They sit on different pins, so the host's signals are routed
+ * through the GPIO matrix to whichever device holds it, which costs a few
+ * register writes per hand-over. On an i80 board the display host is
+ * left unused, and on one without touch the SD card has HSPI to itself.
+ *
+ * A host is held through a FreeRTOS mutex. A device that takes it while a
+ * higher-priority one is queued hands it straight back, so a touch read
+ * waits for at most one card chunk, never for a whole queue of them.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "event_trace.h"
+#include "logger.h"
+
+#define HOST_DISPLAY 0
+#define HOST_PERIPH  1
+#define HOST_COUNT   2
+#define NOT_ROUTED   -1
+
+typedef struct {
+    SPIClass*         spi;
+    SemaphoreHandle_t lock;
+    StaticSemaphore_t lock_state;
+    int8_t            routed;                   // Device the pins are attached to
+    uint8_t           waiting[SPI_DEVICE_COUNT];
+} spi_host_t;
+
+typedef struct {
+    const char*     name;
+    uint8_t         host;
+    int8_t          sck;
+    int8_t          miso;
+    int8_t          mosi;
+    int64_t         acquired_us;
+    spi_bus_stats_t stats;
+} spi_slot_t;
+
+static SPIClass periph_spi(SPI_BUS_PERIPH_HOST);
+static spi_host_t hosts[HOST_COUNT];
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// In spi_device_t order
+static spi_slot_t slots[SPI_DEVICE_COUNT] = {
+    { "display", HOST_DISPLAY, BOARD.display.clk, -1,               BOARD.display.mosi, 0, {0} },
+    { "touch",   HOST_PERIPH,  BOARD.touch.clk,   BOARD.touch.miso, BOARD.touch.mosi,   0, {0} },
+    { "sd",      HOST_PERIPH,  BOARD.sd.clk,      BOARD.sd.miso,    BOARD.sd.mosi,      0, {0} }
+};
+
+// Forward declarations
+static bool higher_priority_waiting(const spi_host_t* host, spi_device_t device);
+static void route(spi_host_t* host, spi_device_t device);
+
+/**
+ * @brief Bring up both SPI hosts with their pins assigned explicitly
+ */
+bool spi_bus_init(void) {
+    if (hosts[HOST_DISPLAY].lock != NULL) {
+        return true;
+    }
+
+    // TFT_eSPI drives the global SPI object (FSPI on the S3); its own
+    // begin() is a no-op once the host is up, so these pins stick
+    if (BOARD_DISPLAY_BUS == DISPLAY_BUS_SPI) {
+        SPI.begin(BOARD.display.clk, -1, BOARD.display.mosi, -1);
+    }
+    hosts[HOST_DISPLAY].spi = &SPI;
+    hosts[HOST_DISPLAY].routed = SPI_DEVICE_DISPLAY;
+
+    pinMode(BOARD.sd.cs, OUTPUT);
+    digitalWrite(BOARD.sd.cs, HIGH);
+    if (BOARD.touch.cs >= 0) {
+        pinMode(BOARD.touch.cs, OUTPUT);
+        digitalWrite(BOARD.touch.cs, HIGH);
+    }
+    periph_spi.begin(BOARD.sd.clk, BOARD.sd.miso, BOARD.sd.mosi, -1);
+    hosts[HOST_PERIPH].spi = &periph_spi;
+    hosts[HOST_PERIPH].routed = SPI_DEVICE_SD;
+
+    for (uint8_t i = 0; i < HOST_COUNT; i++) {
+        hosts[i].lock = xSemaphoreCreateMutexStatic(&hosts[i].lock_state);
+    }
+
+    LOGI(SYSTEM, "✅ SPI buses: display on %s, SD%s on HSPI",
+         BOARD_DISPLAY_BUS == DISPLAY_BUS_SPI ? "the global SPI host" : "i80",
+         BOARD.touch.cs >= 0 ? " and touch share" : "");
+    return true;
+}
+
+/**
+ * @brief The SPIClass a device talks through
+ */
+SPIClass* spi_bus_host(spi_device_t device) {
+    return hosts[slots[device].host].spi;
+}
+
+/**
+ * @brief Take a device's bus, routing the host's pins to it
+ */
+bool spi_bus_acquire(spi_device_t device, uint32_t timeout_ms) {
+    spi_slot_t* slot = &slots[device];
+    spi_host_t* host = &hosts[slot->host];
+    if (host->lock == NULL) {
+        return false;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    TickType_t timeout = timeout_ms == SPI_BUS_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    TickType_t start = xTaskGetTickCount();
+
+    portENTER_CRITICAL(&stats_mux);
+    host->waiting[device]++;
+    portEXIT_CRITICAL(&stats_mux);
+
+    bool taken = false;
+    while (true) {
+        TickType_t remaining = portMAX_DELAY;
+        if (timeout != portMAX_DELAY) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            remaining = elapsed < timeout ? timeout - elapsed : 0;
+        }
+        if (xSemaphoreTake(host->lock, remaining) != pdTRUE) {
+            break;
+        }
+        if (!higher_priority_waiting(host, device)) {
+            taken = true;
+            break;
+        }
+        // A more urgent device is queued: let it go first
+        xSemaphoreGive(host->lock);
+        vTaskDelay(1);
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    uint32_t waited_us = (uint32_t)(now_us - start_us);
+    TRACE_EVENT(TRACE_MUTEX_WAIT, TRACE_LOCK_SPI_DISPLAY + device, taken ? waited_us : UINT32_MAX);
+    portENTER_CRITICAL(&stats_mux);
+    host->waiting[device]--;
+    if (taken) {
+        slot->stats.transactions++;
+        slot->stats.wait_us += waited_us;
+        if (waited_us > slot->stats.max_wait_us) {
+            slot->stats.max_wait_us = waited_us;
+        }
+    } else {
+        slot->stats.timeouts++;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+
+    if (taken) {
+        route(host, device);
+        slot->acquired_us = now_us;
+    }
+    return taken;
+}
+
+/**
+ * @brief Hand the bus back and account the time it was held
+ */
+void spi_bus_release(spi_device_t device) {
+    spi_slot_t* slot = &slots[device];
+    uint32_t held_us = (uint32_t)(esp_timer_get_time() - slot->acquired_us);
+
+    portENTER_CRITICAL(&stats_mux);
+    slot->stats.busy_us += held_us;
+    portEXIT_CRITICAL(&stats_mux);
+
+    xSemaphoreGive(hosts[slot->host].lock);
+}
+
+/**
+ * @brief Bus occupancy of one device since boot
+ */
+void spi_bus_get_stats(spi_device_t device, spi_bus_stats_t* stats) {
+    portENTER_CRITICAL(&stats_mux);
+    *stats = slots[device].stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Device name for logs
+ */
+const char* spi_bus_device_name(spi_device_t device) {
+    return device < SPI_DEVICE_COUNT ? slots[device].name : "?";
+}
+
+/**
+ * @brief A device ahead of this one in spi_device_t order is queued on the host
+ */
+static bool higher_priority_waiting(const spi_host_t* host, spi_device_t device) {
+    for (uint8_t other = 0; other < device; other++) {
+        if (host->waiting[other] > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Move the host's SCK/MISO/MOSI signals to a device's pins
+ */
+static void route(spi_host_t* host, spi_device_t device) {
+    if (host->routed == device) {
+        return;
+    }
+
+    spi_t* hw = host->spi->bus();
+    if (host->routed != NOT_ROUTED) {
+        const spi_slot_t* old = &slots[host->routed];
+        spiDetachSCK(hw, old->sck);
+        spiDetachMISO(hw, old->miso);
+        spiDetachMOSI(hw, old->mosi);
+    }
+    const spi_slot_t* slot = &slots[device];
+    spiAttachSCK(hw, slot->sck);
+    spiAttachMISO(hw, slot->miso);
+    spiAttachMOSI(hw, slot->mosi);
+    host->routed = device;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file status_led.cpp
+ * @brief Status LED patterns played from an esp_timer callback
+ *
+ * A pattern is a list of step durations that alternate on and off,
+ * starting on, and repeat. Each step re-arms a one-shot timer for the
+ * next, so the LED keeps its cadence whatever the calling task is doing
+ * and nobody sleeps to time a flash. A pattern change is handed to the
+ * callback, which is the only place the pin and the step are touched:
+ * the timer is re-armed to fire at once and restarts from the new
+ * pattern's first step.
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "status_led.h"
+#include "logger.h"
+
+typedef struct {
+    const uint16_t* steps_ms;       // On, off, on, ...; 0 holds the step for good
+    uint8_t         steps;          // 0 for dark
+} led_pattern_t;
+
+static const uint16_t SOLID[]     = { 0 };
+static const uint16_t CRITICAL[]  = { 250, 250 };
+static const uint16_t OTA[]       = { 100, 100, 100, 700 };
+static const uint16_t SCANNING[]  = { 30, 470 };
+static const uint16_t HEARTBEAT[] = { 50, 1950 };
+
+// In status_led_pattern_t order
+static const led_pattern_t patterns[STATUS_LED_PATTERN_COUNT] = {
+    { NULL,      0 },
+    { SOLID,     1 },
+    { CRITICAL,  2 },
+    { OTA,       4 },
+    { SCANNING,  2 },
+    { HEARTBEAT, 2 }
+};
+
+static esp_timer_handle_t step_timer = NULL;
+static volatile status_led_pattern_t requested = STATUS_LED_OFF;
+static status_led_pattern_t playing = STATUS_LED_OFF;   // Timer callback only
+static uint8_t step = 0;                                // Timer callback only
+
+// Forward declarations
+static void step_cb(void* arg);
+
+/**
+ * @brief Drive BOARD.status_led from a one-shot esp_timer, LED off
+ */
+bool status_led_init(void) {
+    if (step_timer != NULL) {
+        return true;
+    }
+    if (BOARD.status_led < 0) {
+        return false;               // Not on this board; status_led_set() does nothing
+    }
+    pinMode(BOARD.status_led, OUTPUT);
+    digitalWrite(BOARD.status_led, LOW);
+
+    const esp_timer_create_args_t args = {
+        .callback = step_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "status_led",
+        .skip_unhandled_events = true
+    };
+    if (esp_timer_create(&args, &step_timer) != ESP_OK) {
+        LOGE(SYSTEM, "❌ Status LED timer unavailable");
+        step_timer = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Switch patterns; the new one starts at once, from its first step
+ */
+void status_led_set(status_led_pattern_t pattern) {
+    if (step_timer == NULL || pattern >= STATUS_LED_PATTERN_COUNT || pattern == requested) {
+        return;
+    }
+    requested = pattern;
+    // If the callback is running and re-arms first, this stop cancels
+    // that; if it re-arms after, its own start fails and this one stands
+    esp_timer_stop(step_timer);
+    esp_timer_start_once(step_timer, 1);
+}
+
+/**
+ * @brief Pattern playing or about to start
+ */
+status_led_pattern_t status_led_get(void) {
+    return requested;
+}
+
+/**
+ * @brief Show the next step, or the first step of a newly requested pattern
+ */
+static void step_cb(void* arg) {
+    status_led_pattern_t want = requested;
+    if (want != playing) {
+        playing = want;
+        step = 0;
+    } else if (patterns[playing].steps > 0) {
+        step = (step + 1) % patterns[playing].steps;
+    }
+
+    const led_pattern_t* pattern = &patterns[playing];
+    if (pattern->steps == 0) {
+        digitalWrite(BOARD.status_led, LOW);
+        return;
+    }
+    digitalWrite(BOARD.status_led, step % 2 == 0 ? HIGH : LOW);
+    if (pattern->steps_ms[step] > 0) {
+        esp_timer_start_once(step_timer, (uint64_t)pattern->steps_ms[step] * 1000);
+    }
+}
@@ -0,0 +1,172 @@
+/**
+ * @file touch.cpp
+ * @brief Interrupt-driven XPT2046 resistive touch controller
+ *
+ * The controller raises PENIRQ low when the panel is pressed. Until then
+ * nothing polls it: the interrupt is the only cost. On the edge the ISR
+ * masks itself (conversions glitch PENIRQ) and wakes the UI task, whose
+ * LVGL input timer then reads the controller until the pen lifts and the
+ * interrupt is armed again.
+ *
+ * Each read takes TOUCH_SAMPLES conversions per axis and keeps the median,
+ * which rejects the single-sample spikes typical of resistive panels. The
+ * pressure estimate decides whether the pen is still down.
+ *
+ * The controller shares its SPI host with the SD card. A read that cannot
+ * get the bus within SPI_BUS_TOUCH_WAIT_MS reports the last sample again.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <driver/gpio.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "touch.h"
+#include "ui_events.h"
+#include "logger.h"
+
+// XPT2046 control bytes: 12-bit differential conversions, power-down
+// between them with PENIRQ enabled
+#define XPT2046_READ_X   0xD0
+#define XPT2046_READ_Y   0x90
+#define XPT2046_READ_Z1  0xB0
+#define XPT2046_READ_Z2  0xC0
+
+static SPIClass* touch_spi = NULL;
+static volatile uint32_t presses = 0;
+static bool pressed = false;
+static int16_t last_x = 0;
+static int16_t last_y = 0;
+static bool initialized = false;
+
+// Forward declarations
+static void IRAM_ATTR pen_isr(void);
+static uint16_t convert(uint8_t command);
+static uint16_t median_conversion(uint8_t command);
+static int16_t raw_to_screen(uint16_t raw, uint16_t raw_min, uint16_t raw_max, int16_t size);
+
+/**
+ * @brief Arm the XPT2046 on the shared SPI host and its pen interrupt
+ */
+bool touch_init(void) {
+    if (initialized) {
+        return true;
+    }
+
+    pinMode(BOARD.touch.irq, INPUT);
+    touch_spi = spi_bus_host(SPI_DEVICE_TOUCH);
+    if (!spi_bus_acquire(SPI_DEVICE_TOUCH, SPI_BUS_WAIT_FOREVER)) {
+        LOGE(UI, "❌ Touch: SPI bus unavailable");
+        return false;
+    }
+
+    // One conversion leaves the controller powered down with PENIRQ enabled
+    touch_spi->beginTransaction(SPISettings(TOUCH_SPI_HZ, MSBFIRST, SPI_MODE0));
+    digitalWrite(BOARD.touch.cs, LOW);
+    convert(XPT2046_READ_X);
+    digitalWrite(BOARD.touch.cs, HIGH);
+    touch_spi->endTransaction();
+    spi_bus_release(SPI_DEVICE_TOUCH);
+    attachInterrupt(digitalPinToInterrupt(BOARD.touch.irq), pen_isr, FALLING);
+
+    initialized = true;
+    LOGI(UI, "✅ XPT2046 touch armed on IRQ");
+    return true;
+}
+
+/**
+ * @brief Sample the controller (median of TOUCH_SAMPLES per axis)
+ */
+bool touch_read(int16_t* x, int16_t* y) {
+    if (!initialized) {
+        return false;
+    }
+
+    if (!spi_bus_acquire(SPI_DEVICE_TOUCH, SPI_BUS_TOUCH_WAIT_MS)) {
+        // The card holds the bus: repeat the last sample rather than a release
+        *x = last_x;
+        *y = last_y;
+        return pressed;
+    }
+    touch_spi->beginTransaction(SPISettings(TOUCH_SPI_HZ, MSBFIRST, SPI_MODE0));
+    digitalWrite(BOARD.touch.cs, LOW);
+    uint16_t z1 = convert(XPT2046_READ_Z1);
+    uint16_t z2 = convert(XPT2046_READ_Z2);
+    int32_t z = (int32_t)z1 + 4095 - z2;
+    bool down = z >= TOUCH_Z_THRESHOLD;
+    uint16_t raw_x = 0;
+    uint16_t raw_y = 0;
+    if (down) {
+        raw_x = median_conversion(XPT2046_READ_X);
+        raw_y = median_conversion(XPT2046_READ_Y);
+    }
+    convert(XPT2046_READ_X);            // Ends powered down, PENIRQ enabled
+    digitalWrite(BOARD.touch.cs, HIGH);
+    touch_spi->endTransaction();
+    spi_bus_release(SPI_DEVICE_TOUCH);
+
+    if (down) {
+        if (!pressed) {
+            presses = presses + 1;
+        }
+        // Landscape (rotation 1): the panel's Y axis runs along the screen width
+        *x = raw_to_screen(raw_y, TOUCH_RAW_Y_MIN, TOUCH_RAW_Y_MAX, BOARD.display.height);
+        *y = raw_to_screen(raw_x, TOUCH_RAW_X_MIN, TOUCH_RAW_X_MAX, BOARD.display.width);
+        last_x = *x;
+        last_y = *y;
+    } else {
+        // Pen lifted: back to waiting on the interrupt
+        gpio_intr_enable((gpio_num_t)BOARD.touch.irq);
+    }
+    pressed = down;
+    return down;
+}
+
+/**
+ * @brief Touches started since boot, for "was there input since..." checks
+ */
+uint32_t touch_presses(void) {
+    return presses;
+}
+
+/**
+ * @brief Pen-down edge: mask until released and wake the UI task
+ */
+static void IRAM_ATTR pen_isr(void) {
+    gpio_intr_disable((gpio_num_t)BOARD.touch.irq);
+    ui_notify_from_isr(UI_EVENT_TOUCH | UI_EVENT_WAKE);
+}
+
+/**
+ * @brief One 12-bit conversion (CS must be low)
+ */
+static uint16_t convert(uint8_t command) {
+    touch_spi->transfer(command);
+    return touch_spi->transfer16(0) >> 3;
+}
+
+/**
+ * @brief Median of TOUCH_SAMPLES conversions
+ */
+static uint16_t median_conversion(uint8_t command) {
+    uint16_t samples[TOUCH_SAMPLES];
+    for (uint8_t i = 0; i < TOUCH_SAMPLES; i++) {
+        // Insertion sort as the samples arrive
+        uint16_t value = convert(command);
+        uint8_t j = i;
+        while (j > 0 && samples[j - 1] > value) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = value;
+    }
+    return samples[TOUCH_SAMPLES / 2];
+}
+
+/**
+ * @brief Calibrated raw reading to a screen coordinate
+ */
+static int16_t raw_to_screen(uint16_t raw, uint16_t raw_min, uint16_t raw_max, int16_t size) {
+    int32_t pos = ((int32_t)raw - raw_min) * (size - 1) / (raw_max - raw_min);
+    return (int16_t)constrain(pos, 0, size - 1);
+}
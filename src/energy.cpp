@@ -0,0 +1,260 @@
+/**
+ * @file energy.cpp
+ * @brief Current per subsystem from time in each state, and the battery runtime it gives
+ *
+ * Every load has a full-state current in config.h and a present draw: on
+ * or off for the switched ones, a fraction for the rest (the backlight at
+ * its PWM level, BLE at its scan duty, the CPU at its busy share of the
+ * top clock). A load's charge is its draw integrated over the time it was
+ * drawn, closed each time it changes and at every sample, so a WiFi scan
+ * shorter than a monitoring cycle is still counted in full.
+ *
+ * With an INA219 on the I2C bus, each sample's measured current is set
+ * against the model's, and an EWMA of the ratio scales the totals and the
+ * runtime; the per-load split stays the model's.
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "energy.h"
+#include "backlight.h"
+#include "cpu_load.h"
+#include "spi_bus.h"
+#include "thermal.h"
+#include "tunables.h"
+#include "logger.h"
+
+#define INA219_REG_CONFIG   0x00
+#define INA219_REG_SHUNT    0x01        // Signed, 10 uV per LSB
+#define INA219_CONFIG       0x399F      // 32 V, +-320 mV, 12-bit, continuous
+#define SCALE_MIN           0.25f       // Ratios outside these are a wiring fault, not a calibration
+#define SCALE_MAX           4.0f
+
+typedef struct {
+    float    ma;                    // Drawn now
+    int64_t  since_us;              // When ma last changed or was integrated
+    uint64_t charge_uams;           // uA x ms since boot
+    uint64_t active_us;
+    uint8_t  users;                 // energy_set_active() calls on, not yet off
+} load_state_t;
+
+static const char* const load_names[ENERGY_LOAD_COUNT] = {
+    "base", "cpu", "wifi_rx", "wifi_link", "ble_scan", "backlight", "sd"
+};
+
+// Switched loads at full duty; the others are set in energy_sample()
+static const float switched_ma[ENERGY_LOAD_COUNT] = {
+    0, 0, ENERGY_WIFI_RX_MA, 0, ENERGY_BLE_SCAN_MA, 0, 0
+};
+
+static load_state_t loads[ENERGY_LOAD_COUNT];
+static uint8_t duty_pct[ENERGY_LOAD_COUNT] = {
+    100, 100, 100, 100, BLE_SCAN_WINDOW * 100 / BLE_SCAN_INTERVAL, 100, 100
+};
+static energy_status_t status;
+static uint64_t sd_busy_us = 0;         // spi_bus figure at the previous sample
+static uint32_t last_sample_ms = 0;
+static bool initialized = false;
+static portMUX_TYPE energy_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void integrate(load_state_t* load, int64_t now_us);
+static void set_draw(energy_load_t load, float ma, int64_t now_us);
+static bool ina219_probe(void);
+static bool ina219_read_ma(float* ma);
+
+/**
+ * @brief Start the integrators
+ */
+void energy_init(void) {
+    // Every integrator starts at boot (since_us 0), so the base load is
+    // charged from there at its first sample
+    portENTER_CRITICAL(&energy_mux);
+    loads[ENERGY_LOAD_BASE].ma = ENERGY_BASE_MA;
+    portEXIT_CRITICAL(&energy_mux);
+    status.scale = 1.0f;
+#if ENERGY_INA219_ENABLED
+    status.ina219 = ina219_probe();
+#endif
+    initialized = true;
+    LOGI(SYSTEM, "✅ Energy model started%s", status.ina219 ? ", INA219 calibrating" : "");
+}
+
+/**
+ * @brief A switched load went on or off; may come before energy_init()
+ */
+void energy_set_active(energy_load_t load, bool active) {
+    if (load >= ENERGY_LOAD_COUNT) {
+        return;
+    }
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&energy_mux);
+    load_state_t* state = &loads[load];
+    if (active) {
+        state->users++;
+    } else if (state->users > 0) {
+        state->users--;
+    }
+    integrate(state, now_us);
+    state->ma = state->users > 0 ? switched_ma[load] * duty_pct[load] / 100 : 0;
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+/**
+ * @brief Share of the time a switched load draws its full current while on
+ */
+void energy_set_duty(energy_load_t load, uint8_t pct) {
+    if (load >= ENERGY_LOAD_COUNT) {
+        return;
+    }
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&energy_mux);
+    load_state_t* state = &loads[load];
+    integrate(state, now_us);
+    duty_pct[load] = pct < 100 ? pct : 100;
+    state->ma = state->users > 0 ? switched_ma[load] * duty_pct[load] / 100 : 0;
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+/**
+ * @brief Read the polled loads, integrate and calibrate
+ */
+void energy_sample(uint32_t now_ms) {
+    if (!initialized) {
+        return;
+    }
+    int64_t now_us = esp_timer_get_time();
+
+    // CPU: the idle floor, plus the busy share of the top clock
+    cpu_load_t cpu;
+    cpu_load_get(&cpu);
+    thermal_status_t thermal;
+    thermal_get_status(&thermal);
+    float busy = (cpu.core_pct[0] + cpu.core_pct[1]) / (100.0f * CPU_LOAD_CORES);
+    set_draw(ENERGY_LOAD_CPU, ENERGY_CPU_IDLE_MA + ENERGY_CPU_MA_PER_MHZ * thermal.cpu_mhz * busy, now_us);
+
+    backlight_status_t light;
+    backlight_get_status(&light);
+    set_draw(ENERGY_LOAD_BACKLIGHT, ENERGY_BACKLIGHT_MA * light.level_pct / 100.0f, now_us);
+
+    set_draw(ENERGY_LOAD_WIFI_LINK, WiFi.status() == WL_CONNECTED ? ENERGY_WIFI_LINK_MA : 0, now_us);
+
+    // The card is charged for its bus time since the last sample; its share
+    // of the cycle stands for its draw now
+    spi_bus_stats_t sd;
+    spi_bus_get_stats(SPI_DEVICE_SD, &sd);
+    uint64_t sd_delta_us = sd.busy_us - sd_busy_us;
+    sd_busy_us = sd.busy_us;
+    uint32_t cycle_ms = max(now_ms - last_sample_ms, (uint32_t)1);
+    last_sample_ms = now_ms;
+
+    energy_status_t next = status;
+    uint64_t total_uams = 0;
+    next.model_ma = 0;
+    portENTER_CRITICAL(&energy_mux);
+    loads[ENERGY_LOAD_SD].charge_uams += (uint64_t)(ENERGY_SD_BUSY_MA * 1000) * sd_delta_us / 1000;
+    loads[ENERGY_LOAD_SD].active_us += sd_delta_us;
+    loads[ENERGY_LOAD_SD].ma = min(ENERGY_SD_BUSY_MA * sd_delta_us / (cycle_ms * 1000.0f), ENERGY_SD_BUSY_MA);
+    for (uint8_t i = 0; i < ENERGY_LOAD_COUNT; i++) {
+        if (i != ENERGY_LOAD_SD) {
+            integrate(&loads[i], now_us);
+        }
+        next.model_ma += loads[i].ma;
+        total_uams += loads[i].charge_uams;
+    }
+    for (uint8_t i = 0; i < ENERGY_LOAD_COUNT; i++) {
+        energy_load_stats_t* out = &next.loads[i];
+        out->ma = loads[i].ma;
+        out->mah = loads[i].charge_uams / 3.6e9f;
+        out->active_ms = (uint32_t)(loads[i].active_us / 1000);
+        out->share_pct = total_uams > 0 ? (uint8_t)(loads[i].charge_uams * 100 / total_uams) : 0;
+    }
+    portEXIT_CRITICAL(&energy_mux);
+
+    float measured;
+    if (next.ina219 && next.model_ma > 0 && ina219_read_ma(&measured)) {
+        float ratio = constrain(measured / next.model_ma, SCALE_MIN, SCALE_MAX);
+        next.scale += (ratio - next.scale) * ENERGY_CALIBRATION_ALPHA;
+        next.measured_ma = measured;
+        next.calibrations++;
+    }
+
+    float drawn_ma = next.model_ma * next.scale;
+    next.avg_ma = next.avg_ma == 0 ? drawn_ma : next.avg_ma + (drawn_ma - next.avg_ma) * ENERGY_AVG_ALPHA;
+    next.mah = total_uams / 3.6e9f * next.scale;
+    next.battery_mah = (uint16_t)tunable_get(TUNABLE_BATTERY_MAH);
+    next.runtime_h = next.avg_ma > 0 ? next.battery_mah / next.avg_ma : 0;
+
+    portENTER_CRITICAL(&energy_mux);
+    status = next;
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+/**
+ * @brief Copy the figures of the last sample
+ */
+void energy_get_status(energy_status_t* out) {
+    portENTER_CRITICAL(&energy_mux);
+    *out = status;
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* energy_load_name(energy_load_t load) {
+    return load < ENERGY_LOAD_COUNT ? load_names[load] : "?";
+}
+
+/**
+ * @brief Charge the present draw up to now; caller holds energy_mux
+ */
+static void integrate(load_state_t* load, int64_t now_us) {
+    int64_t elapsed_us = now_us - load->since_us;
+    if (elapsed_us > 0 && load->ma > 0) {
+        load->charge_uams += (uint64_t)(load->ma * 1000) * (uint64_t)elapsed_us / 1000;
+        load->active_us += elapsed_us;
+    }
+    load->since_us = now_us;
+}
+
+/**
+ * @brief A polled load's draw from now on
+ */
+static void set_draw(energy_load_t load, float ma, int64_t now_us) {
+    portENTER_CRITICAL(&energy_mux);
+    integrate(&loads[load], now_us);
+    loads[load].ma = ma;
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+/**
+ * @brief Configure the INA219 if one answers at ENERGY_INA219_ADDR
+ */
+static bool ina219_probe(void) {
+    if (BOARD.i2c.sda < 0) {
+        return false;
+    }
+    Wire.beginTransmission(ENERGY_INA219_ADDR);
+    Wire.write(INA219_REG_CONFIG);
+    Wire.write(INA219_CONFIG >> 8);
+    Wire.write(INA219_CONFIG & 0xFF);
+    return Wire.endTransmission() == 0;
+}
+
+/**
+ * @brief Current through the shunt, from its voltage; no calibration register needed
+ */
+static bool ina219_read_ma(float* ma) {
+    Wire.beginTransmission(ENERGY_INA219_ADDR);
+    Wire.write(INA219_REG_SHUNT);
+    if (Wire.endTransmission(false) != 0 || Wire.requestFrom(ENERGY_INA219_ADDR, 2) != 2) {
+        return false;
+    }
+    int16_t raw = (int16_t)((Wire.read() << 8) | Wire.read());
+    *ma = raw * 10.0f / ENERGY_INA219_SHUNT_MOHM;     // 10 uV a count over milliohms: mA
+    return true;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file event_trace.cpp
+ * @brief Fixed-size binary ring of timestamped events
+ *
+ * Writers claim a slot with one atomic increment of the head and fill it
+ * in place, so tracing costs a few hundred nanoseconds and never blocks,
+ * unlike a Serial line at 115200 baud. An export first stops new writes,
+ * then reads the ring oldest first behind a header and a table naming the
+ * task numbers; the host script turns that into a Chrome/Perfetto trace.
+ *
+ * The ring sits in .noinit, which a panic, a watchdog or a software reset
+ * leaves alone. After a crash the boot copies it to PSRAM before anything
+ * traces again, and that copy is exported the same way; its task table is
+ * taken once this boot's tasks exist, as the same firmware numbers them in
+ * the same order.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "event_trace.h"
+#include "mem_policy.h"
+
+static_assert((EVENT_TRACE_RECORDS & (EVENT_TRACE_RECORDS - 1)) == 0,
+              "EVENT_TRACE_RECORDS must be a power of two");
+
+#define EVENT_TRACE_KEPT_MAGIC  0x54505645u     // "EVPT"
+
+/**
+ * @brief The ring and its claim count, kept through a panic or software reset
+ */
+typedef struct {
+    uint32_t magic;
+    volatile uint32_t head;                     // Slots claimed since boot
+    trace_event_record_t ring[EVENT_TRACE_RECORDS];
+} trace_ring_t;
+
+__NOINIT_ATTR static trace_ring_t kept;
+static volatile bool recording = false;         // From event_trace_init() on
+static volatile bool exporting = false;
+
+// Frozen view, valid between freeze and thaw
+static trace_export_header_t frozen_header;
+static trace_task_entry_t frozen_tasks[EVENT_TRACE_TASKS_MAX];
+static uint32_t frozen_first = 0;               // Claim index of the oldest record
+static TaskStatus_t task_status[EVENT_TRACE_TASKS_MAX];
+static portMUX_TYPE export_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// The previous boot's ring, when it ended in a crash
+static trace_event_record_t* postmortem = NULL;     // PSRAM
+static trace_export_header_t postmortem_header;
+static trace_task_entry_t postmortem_tasks[EVENT_TRACE_TASKS_MAX];
+static uint32_t postmortem_first = 0;
+static volatile bool postmortem_sealed = false;
+
+// Forward declarations
+static bool begin_export(void);
+static void end_export(void);
+static uint16_t snapshot_tasks(trace_task_entry_t* tasks);
+static size_t read_export(const trace_export_header_t* header, const trace_task_entry_t* tasks,
+                          const trace_event_record_t* records, uint32_t first,
+                          size_t offset, uint8_t* out, size_t length);
+
+/**
+ * @brief Keep a crashed boot's ring for export, then start tracing afresh
+ */
+bool event_trace_init(bool keep_previous) {
+    bool kept_one = false;
+    uint32_t claimed = kept.head;
+    if (keep_previous && kept.magic == EVENT_TRACE_KEPT_MAGIC && claimed > 0) {
+        postmortem = (trace_event_record_t*)mem_alloc(MEM_BULK, sizeof(kept.ring));
+        if (postmortem != NULL) {
+            memcpy(postmortem, kept.ring, sizeof(kept.ring));
+            uint32_t count = min(claimed, (uint32_t)EVENT_TRACE_RECORDS);
+            postmortem_first = claimed - count;
+            memset(&postmortem_header, 0, sizeof(postmortem_header));
+            postmortem_header.magic = EVENT_TRACE_MAGIC;
+            postmortem_header.format = EVENT_TRACE_FORMAT;
+            postmortem_header.record_bytes = sizeof(trace_event_record_t);
+            postmortem_header.record_count = count;
+            postmortem_header.overwritten = claimed - count;
+            postmortem_header.task_bytes = sizeof(trace_task_entry_t);
+            kept_one = true;
+        }
+    }
+
+    kept.magic = EVENT_TRACE_KEPT_MAGIC;
+    kept.head = 0;
+    recording = true;
+    return kept_one;
+}
+
+/**
+ * @brief Append one event; task context only
+ */
+void event_trace_record(trace_event_t event, uint32_t arg0, uint32_t arg1) {
+    if (!recording) {
+        return;
+    }
+    uint32_t index = __atomic_fetch_add(&kept.head, 1, __ATOMIC_RELAXED);
+    trace_event_record_t* record = &kept.ring[index & (EVENT_TRACE_RECORDS - 1)];
+    record->timestamp_us = (uint32_t)esp_timer_get_time();
+    record->event = event;
+    record->core = (uint8_t)xPortGetCoreID();
+    record->task = (uint16_t)uxTaskGetTaskNumber(xTaskGetCurrentTaskHandle());
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+}
+
+/**
+ * @brief Pause tracing and take a consistent view of the ring for export
+ */
+size_t event_trace_freeze(void) {
+    if (!begin_export()) {
+        return 0;
+    }
+
+    recording = false;
+    // A writer past the check may still be filling its slot
+    vTaskDelay(1);
+
+    uint32_t claimed = __atomic_load_n(&kept.head, __ATOMIC_ACQUIRE);
+    uint32_t count = min(claimed, (uint32_t)EVENT_TRACE_RECORDS);
+    frozen_first = claimed - count;
+    frozen_header.task_count = snapshot_tasks(frozen_tasks);
+
+    frozen_header.magic = EVENT_TRACE_MAGIC;
+    frozen_header.format = EVENT_TRACE_FORMAT;
+    frozen_header.record_bytes = sizeof(trace_event_record_t);
+    frozen_header.record_count = count;
+    frozen_header.overwritten = claimed - count;
+    frozen_header.task_bytes = sizeof(trace_task_entry_t);
+    return sizeof(frozen_header) + frozen_header.task_count * sizeof(trace_task_entry_t)
+         + count * sizeof(trace_event_record_t);
+}
+
+/**
+ * @brief Copy part of the frozen export
+ */
+size_t event_trace_read(size_t offset, uint8_t* out, size_t length) {
+    return read_export(&frozen_header, frozen_tasks, kept.ring, frozen_first, offset, out, length);
+}
+
+/**
+ * @brief End an export and resume tracing
+ */
+void event_trace_thaw(void) {
+    recording = true;
+    end_export();
+}
+
+/**
+ * @brief Write the ring to the serial port as "@@EVT" hex lines
+ */
+void event_trace_dump_serial(void) {
+    size_t total = event_trace_freeze();
+    if (total == 0) {
+        Serial.println("❌ Event trace export already in progress");
+        return;
+    }
+    Serial.printf("@@EVT begin %u\n", total);
+    uint8_t line[32];
+    for (size_t offset = 0; offset < total; offset += sizeof(line)) {
+        size_t n = event_trace_read(offset, line, sizeof(line));
+        Serial.print("@@EVT ");
+        for (size_t i = 0; i < n; i++) {
+            Serial.printf("%02x", line[i]);
+        }
+        Serial.println();
+    }
+    Serial.println("@@EVT end");
+    event_trace_thaw();
+}
+
+/**
+ * @brief Write the ring to EVENT_TRACE_SD_FILE on the SD card
+ */
+bool event_trace_save_sd(void) {
+    if (!sd_monitor_mounted()) {
+        return false;
+    }
+    size_t total = event_trace_freeze();
+    if (total == 0) {
+        return false;
+    }
+
+    bool saved = false;
+    if (spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER)) {
+        if (SD.exists(TRACE_LOG_DIR) || SD.mkdir(TRACE_LOG_DIR)) {
+            File file = SD.open(EVENT_TRACE_SD_FILE, "w");
+            if (file) {
+                uint8_t chunk[256];
+                size_t written = 0;
+                while (written < total) {
+                    size_t n = event_trace_read(written, chunk, sizeof(chunk));
+                    if (file.write(chunk, n) != n) {
+                        break;
+                    }
+                    written += n;
+                }
+                file.close();
+                saved = written == total;
+            }
+        }
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+    event_trace_thaw();
+
+    Serial.printf(saved ? "✅ Event trace saved to %s (%u bytes)\n"
+                        : "❌ Event trace could not be saved to %s (%u bytes)\n",
+                  EVENT_TRACE_SD_FILE, total);
+    return saved;
+}
+
+/**
+ * @brief Name the tasks in the ring a crash left
+ */
+bool event_trace_postmortem_seal(void) {
+    if (postmortem == NULL || postmortem_sealed) {
+        return postmortem_sealed;
+    }
+    if (!begin_export()) {
+        return false;               // The task table is in use; the next call
+    }
+    postmortem_header.task_count = snapshot_tasks(postmortem_tasks);
+    end_export();
+    postmortem_sealed = true;
+    return true;
+}
+
+/**
+ * @brief Size of the crash export, 0 with none
+ */
+size_t event_trace_postmortem_size(void) {
+    if (!postmortem_sealed) {
+        return 0;
+    }
+    return sizeof(postmortem_header) + postmortem_header.task_count * sizeof(trace_task_entry_t)
+         + postmortem_header.record_count * sizeof(trace_event_record_t);
+}
+
+/**
+ * @brief Copy part of the crash export (safe from any task once sealed)
+ */
+size_t event_trace_postmortem_read(size_t offset, uint8_t* out, size_t length) {
+    if (!postmortem_sealed) {
+        return 0;
+    }
+    return read_export(&postmortem_header, postmortem_tasks, postmortem, postmortem_first,
+                       offset, out, length);
+}
+
+/**
+ * @brief Free the crash export
+ */
+void event_trace_postmortem_drop(void) {
+    if (!postmortem_sealed) {
+        return;
+    }
+    postmortem_sealed = false;
+    trace_event_record_t* copy = postmortem;
+    postmortem = NULL;
+    mem_free(MEM_BULK, copy, sizeof(kept.ring));
+}
+
+/**
+ * @brief Claim the export state (frozen view and task status buffer)
+ */
+static bool begin_export(void) {
+    portENTER_CRITICAL(&export_mux);
+    bool busy = exporting;
+    exporting = true;
+    portEXIT_CRITICAL(&export_mux);
+    return !busy;
+}
+
+/**
+ * @brief Release it
+ */
+static void end_export(void) {
+    portENTER_CRITICAL(&export_mux);
+    exporting = false;
+    portEXIT_CRITICAL(&export_mux);
+}
+
+/**
+ * @brief Name the task numbers the records refer to
+ * @return Entries written
+ */
+static uint16_t snapshot_tasks(trace_task_entry_t* tasks) {
+    UBaseType_t count = uxTaskGetSystemState(task_status, EVENT_TRACE_TASKS_MAX, NULL);
+    for (UBaseType_t i = 0; i < count; i++) {
+        tasks[i].number = task_status[i].xTaskNumber;
+        strlcpy(tasks[i].name, task_status[i].pcTaskName, sizeof(tasks[i].name));
+    }
+    return (uint16_t)count;
+}
+
+/**
+ * @brief Copy part of an export: header, task table, then records oldest first
+ */
+static size_t read_export(const trace_export_header_t* header, const trace_task_entry_t* tasks,
+                          const trace_event_record_t* records, uint32_t first,
+                          size_t offset, uint8_t* out, size_t length) {
+    size_t copied = 0;
+    size_t tasks_bytes = header->task_count * sizeof(trace_task_entry_t);
+    size_t records_bytes = header->record_count * sizeof(trace_event_record_t);
+    size_t sections[3] = { sizeof(*header), tasks_bytes, records_bytes };
+
+    size_t base = 0;
+    for (uint8_t section = 0; section < 3 && copied < length; section++) {
+        size_t end = base + sections[section];
+        while (offset + copied < end && copied < length) {
+            size_t at = offset + copied - base;
+            size_t chunk = min(end - (offset + copied), length - copied);
+            const uint8_t* from;
+            if (section == 0) {
+                from = (const uint8_t*)header + at;
+            } else if (section == 1) {
+                from = (const uint8_t*)tasks + at;
+            } else {
+                // Records lie in the ring from first on, wrapping once
+                uint32_t slot = (first + at / sizeof(trace_event_record_t)) & (EVENT_TRACE_RECORDS - 1);
+                size_t within = at % sizeof(trace_event_record_t);
+                size_t to_wrap = (EVENT_TRACE_RECORDS - slot) * sizeof(trace_event_record_t) - within;
+                chunk = min(chunk, to_wrap);
+                from = (const uint8_t*)&records[slot] + within;
+            }
+            memcpy(out + copied, from, chunk);
+            copied += chunk;
+        }
+        base = end;
+    }
+    return copied;
+}
@@ -0,0 +1,279 @@
+/**
+ * @file face_anim.cpp
+ * @brief Eased blink, breathing and morph animations over the face atlas
+ *
+ * Two animation channels run on the face image: the eyelid, stepping
+ * through the atlas frames of the shown state, and breathing, a slow
+ * vertical lift. A morph is an eyelid cycle that swaps the expression at
+ * the moment the eyes are shut, so no in-between frames are needed.
+ *
+ * The atlas is 2-bit indexed, which LVGL decodes line by line through the
+ * palette every time the face area is drawn: each blink step, each breath
+ * and anything else invalidating the area. With FACE_LAYER_ENABLED the
+ * shown expression's frames are expanded once, on an expression change,
+ * into native-colour images in PSRAM, which LVGL blits directly. The
+ * outgoing expression is drawn from the atlas until the morph swaps it.
+ */
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+#include "face_anim.h"
+#include "face_atlas.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+static_assert(FACE_ATLAS_STATES == AI_STATE_COUNT, "face atlas needs one row per AI state");
+
+// Eyelid animation values are atlas frame indices
+#define LID_SHUT FACE_FRAME_BLINK
+
+static lv_obj_t* img = NULL;
+static ai_state_t shown_state = AI_STATE_IDLE;     // Expression on screen
+static ai_state_t target_state = AI_STATE_IDLE;    // Expression to morph to
+static int32_t shown_frame = FACE_FRAME_OPEN;
+static int32_t shown_lift = 0;
+static uint32_t next_blink_ms = 0;
+static uint32_t next_breath_ms = 0;
+
+// Native-colour copy of one state's frames, FACE_ATLAS_STATES if none
+static lv_img_dsc_t layer[FACE_ATLAS_FRAMES];
+static lv_color_t* layer_pixels = NULL;
+static ai_state_t layer_state = (ai_state_t)FACE_ATLAS_STATES;
+
+// Forward declarations
+static void lid_exec(void* var, int32_t frame);
+static void lid_ready(lv_anim_t* anim);
+static void breath_exec(void* var, int32_t lift);
+static void start_lid(uint32_t time_ms);
+static void start_breath(void);
+static bool state_blinks(ai_state_t state);
+static bool state_breathes(ai_state_t state);
+static uint32_t ms_until(uint32_t deadline_ms, uint32_t now_ms);
+static const void* frame_src(ai_state_t state, int32_t frame);
+static void render_layer(ai_state_t state);
+static void expand_frame(const lv_img_dsc_t* src, lv_color_t* dst);
+
+/**
+ * @brief Take over the face image and show a state's open-eyed frame
+ */
+void face_anim_init(lv_obj_t* face_img, ai_state_t state) {
+    img = face_img;
+    shown_state = target_state = state;
+    shown_frame = FACE_FRAME_OPEN;
+    shown_lift = 0;
+    render_layer(state);
+    lv_img_set_src(img, frame_src(state, FACE_FRAME_OPEN));
+
+    uint32_t now = millis();
+    next_blink_ms = now + random(UI_BLINK_MIN_MS, UI_BLINK_MAX_MS);
+    next_breath_ms = now + UI_BREATH_GAP_MS;
+}
+
+/**
+ * @brief Morph to another expression: eyes close, the face swaps, eyes reopen
+ */
+void face_anim_set_state(ai_state_t state) {
+    if (img == NULL || state >= AI_STATE_COUNT) return;
+
+    target_state = state;
+    render_layer(state);
+    // A running eyelid cycle swaps when it shuts, or restarts when it ends
+    if (state != shown_state && lv_anim_get(img, lid_exec) == NULL) {
+        start_lid(UI_MORPH_MS);
+    }
+}
+
+/**
+ * @brief Start blinks and breaths that are due; call once per frame
+ */
+void face_anim_update(uint32_t now_ms) {
+    if (img == NULL) return;
+
+    if (state_blinks(shown_state) && ms_until(next_blink_ms, now_ms) == 0 &&
+        lv_anim_get(img, lid_exec) == NULL) {
+        start_lid(UI_BLINK_MS);
+        next_blink_ms = now_ms + random(UI_BLINK_MIN_MS, UI_BLINK_MAX_MS);
+    }
+
+    if (state_breathes(shown_state) && ms_until(next_breath_ms, now_ms) == 0 &&
+        lv_anim_get(img, breath_exec) == NULL) {
+        start_breath();
+        next_breath_ms = now_ms + 2 * UI_BREATH_MS + UI_BREATH_GAP_MS;
+    }
+}
+
+/**
+ * @brief Time until face_anim_update() has an animation to start
+ */
+uint32_t face_anim_quiet_ms(uint32_t now_ms) {
+    if (img == NULL) return UINT32_MAX;
+
+    // A channel that is animating starts nothing until it finishes
+    uint32_t quiet = UINT32_MAX;
+    if (state_blinks(shown_state) && lv_anim_get(img, lid_exec) == NULL) {
+        quiet = min(quiet, ms_until(next_blink_ms, now_ms));
+    }
+    if (state_breathes(shown_state) && lv_anim_get(img, breath_exec) == NULL) {
+        quiet = min(quiet, ms_until(next_breath_ms, now_ms));
+    }
+    return quiet;
+}
+
+/**
+ * @brief Eyelid channel: show one atlas frame, swapping expression while shut
+ */
+static void lid_exec(void* var, int32_t frame) {
+    bool swap = frame == LID_SHUT && target_state != shown_state;
+    if (swap) {
+        shown_state = target_state;
+    }
+    // Only a changed frame invalidates the image
+    if (swap || frame != shown_frame) {
+        shown_frame = frame;
+        lv_img_set_src((lv_obj_t*)var, frame_src(shown_state, frame));
+    }
+}
+
+/**
+ * @brief The eyes reopened; morph again if the state changed meanwhile
+ */
+static void lid_ready(lv_anim_t* anim) {
+    if (target_state != shown_state) {
+        start_lid(UI_MORPH_MS);
+    }
+}
+
+/**
+ * @brief Breathing channel: lift the face a few pixels
+ */
+static void breath_exec(void* var, int32_t lift) {
+    if (lift != shown_lift) {
+        shown_lift = lift;
+        lv_obj_set_y((lv_obj_t*)var, -lift);
+    }
+}
+
+/**
+ * @brief Close and reopen the eyes, time_ms each way
+ */
+static void start_lid(uint32_t time_ms) {
+    lv_anim_t anim;
+    lv_anim_init(&anim);
+    lv_anim_set_var(&anim, img);
+    lv_anim_set_exec_cb(&anim, lid_exec);
+    lv_anim_set_values(&anim, FACE_FRAME_OPEN, LID_SHUT);
+    lv_anim_set_time(&anim, time_ms);
+    lv_anim_set_playback_time(&anim, time_ms);
+    lv_anim_set_path_cb(&anim, lv_anim_path_ease_in_out);
+    lv_anim_set_ready_cb(&anim, lid_ready);
+    lv_anim_start(&anim);
+}
+
+/**
+ * @brief One breath: rise over UI_BREATH_MS and settle back
+ */
+static void start_breath(void) {
+    lv_anim_t anim;
+    lv_anim_init(&anim);
+    lv_anim_set_var(&anim, img);
+    lv_anim_set_exec_cb(&anim, breath_exec);
+    lv_anim_set_values(&anim, 0, UI_BREATH_PX);
+    lv_anim_set_time(&anim, UI_BREATH_MS);
+    lv_anim_set_playback_time(&anim, UI_BREATH_MS);
+    lv_anim_set_path_cb(&anim, lv_anim_path_ease_in_out);
+    lv_anim_start(&anim);
+}
+
+/**
+ * @brief A frame's image: the expanded copy if it holds the state, else the atlas
+ */
+static const void* frame_src(ai_state_t state, int32_t frame) {
+    return state == layer_state ? (const void*)&layer[frame] : (const void*)face_atlas[state][frame];
+}
+
+/**
+ * @brief Expand a state's frames into the layer, once per expression change
+ *
+ * The image may be showing the layer's old frames: it is pointed back at
+ * the atlas first, which has the same pixels, so the rewrite is never seen.
+ */
+static void render_layer(ai_state_t state) {
+#if FACE_LAYER_ENABLED
+    if (state == layer_state || state >= FACE_ATLAS_STATES) {
+        return;
+    }
+    const size_t frame_px = (size_t)FACE_ATLAS_WIDTH * FACE_ATLAS_HEIGHT;
+    if (layer_pixels == NULL) {
+        // Only ever a faster copy of the atlas, so a cache
+        layer_pixels = (lv_color_t*)mem_alloc(MEM_CACHE, FACE_ATLAS_FRAMES * frame_px * sizeof(lv_color_t));
+        if (layer_pixels == NULL) {
+            LOGW(UI, "⚠️  No PSRAM for the face layer - drawing from the indexed atlas");
+            return;
+        }
+    }
+
+    if (layer_state < FACE_ATLAS_STATES && shown_state == layer_state) {
+        lv_img_set_src(img, face_atlas[shown_state][shown_frame]);
+    }
+    layer_state = (ai_state_t)FACE_ATLAS_STATES;
+    for (uint8_t frame = 0; frame < FACE_ATLAS_FRAMES; frame++) {
+        lv_img_cache_invalidate_src(&layer[frame]);
+        lv_color_t* pixels = layer_pixels + frame * frame_px;
+        expand_frame(face_atlas[state][frame], pixels);
+        layer[frame].header.always_zero = 0;
+        layer[frame].header.cf = LV_IMG_CF_TRUE_COLOR;
+        layer[frame].header.w = FACE_ATLAS_WIDTH;
+        layer[frame].header.h = FACE_ATLAS_HEIGHT;
+        layer[frame].data_size = frame_px * sizeof(lv_color_t);
+        layer[frame].data = (const uint8_t*)pixels;
+    }
+    layer_state = state;
+#endif
+}
+
+/**
+ * @brief 2-bit indexed atlas frame to native colour, alpha blended onto black
+ *
+ * The palette's four lv_color32_t come first, then rows packed four pixels
+ * to a byte, first pixel in the top bits, each row starting on a byte.
+ */
+static void expand_frame(const lv_img_dsc_t* src, lv_color_t* dst) {
+    const lv_color32_t* palette = (const lv_color32_t*)src->data;
+    lv_color_t colors[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        lv_color_t color = lv_color_make(palette[i].ch.red, palette[i].ch.green, palette[i].ch.blue);
+        colors[i] = lv_color_mix(color, lv_color_black(), palette[i].ch.alpha);
+    }
+
+    const uint8_t* rows = src->data + 4 * sizeof(lv_color32_t);
+    const uint32_t stride = (src->header.w + 3) / 4;
+    for (uint32_t y = 0; y < src->header.h; y++) {
+        const uint8_t* row = rows + y * stride;
+        for (uint32_t x = 0; x < src->header.w; x++) {
+            *dst++ = colors[(row[x >> 2] >> (6 - 2 * (x & 3))) & 0x3];
+        }
+    }
+}
+
+/**
+ * @brief Sleeping eyes are already shut
+ */
+static bool state_blinks(ai_state_t state) {
+    return state != AI_STATE_SLEEPING;
+}
+
+/**
+ * @brief Only the calm states breathe
+ */
+static bool state_breathes(ai_state_t state) {
+    return state == AI_STATE_IDLE || state == AI_STATE_SLEEPING;
+}
+
+/**
+ * @brief Wrap-safe time left until a deadline, 0 once it has passed
+ */
+static uint32_t ms_until(uint32_t deadline_ms, uint32_t now_ms) {
+    int32_t left = (int32_t)(deadline_ms - now_ms);
+    return left > 0 ? (uint32_t)left : 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file gestures.cpp
+ * @brief Tap, long press and swipe recognition over the touch samples
+ *
+ * A touch is tracked from its first sample: where it started, where it is
+ * and when it began. A press held within GESTURE_TAP_SLOP_PX for
+ * GESTURE_LONG_PRESS_MS is a long press at once, so the user feels it
+ * register without lifting. On release, travel of GESTURE_SWIPE_PX along
+ * the dominant axis within GESTURE_SWIPE_MAX_MS is a swipe, and a release
+ * inside the slop a tap. Anything else was a drag.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "gestures.h"
+#include "data_bus.h"
+#include "logger.h"
+
+static const char* const gesture_names[GESTURE_KINDS] = {
+    "none", "tap", "long_press", "swipe_left", "swipe_right", "swipe_up", "swipe_down"
+};
+
+static bool down = false;
+static bool long_reported = false;
+static int16_t start_x = 0;
+static int16_t start_y = 0;
+static int16_t last_x = 0;
+static int16_t last_y = 0;
+static uint32_t start_ms = 0;
+static gesture_t pending = GESTURE_NONE;
+
+// Forward declarations
+static void emit(gesture_t gesture, uint32_t now_ms);
+
+/**
+ * @brief Fold in one touch sample
+ */
+void gestures_feed(bool pressed, int16_t x, int16_t y, uint32_t now_ms) {
+    if (pressed) {
+        if (!down) {
+            down = true;
+            long_reported = false;
+            start_x = x;
+            start_y = y;
+            start_ms = now_ms;
+        }
+        last_x = x;
+        last_y = y;
+        bool still = abs(x - start_x) + abs(y - start_y) <= GESTURE_TAP_SLOP_PX;
+        if (!long_reported && still && now_ms - start_ms >= GESTURE_LONG_PRESS_MS) {
+            long_reported = true;
+            emit(GESTURE_LONG_PRESS, now_ms);
+        }
+        return;
+    }
+
+    if (!down) {
+        return;
+    }
+    down = false;
+    if (long_reported) {
+        return;
+    }
+
+    int16_t dx = last_x - start_x;
+    int16_t dy = last_y - start_y;
+    uint32_t held_ms = now_ms - start_ms;
+    if (max(abs(dx), abs(dy)) >= GESTURE_SWIPE_PX && held_ms <= GESTURE_SWIPE_MAX_MS) {
+        if (abs(dx) >= abs(dy)) {
+            emit(dx < 0 ? GESTURE_SWIPE_LEFT : GESTURE_SWIPE_RIGHT, now_ms);
+        } else {
+            emit(dy < 0 ? GESTURE_SWIPE_UP : GESTURE_SWIPE_DOWN, now_ms);
+        }
+    } else if (abs(dx) + abs(dy) <= GESTURE_TAP_SLOP_PX) {
+        emit(GESTURE_TAP, now_ms);
+    }
+}
+
+/**
+ * @brief Latest gesture not yet acted on
+ */
+gesture_t gestures_take(void) {
+    gesture_t gesture = pending;
+    pending = GESTURE_NONE;
+    return gesture;
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* gesture_name(gesture_t gesture) {
+    return gesture < GESTURE_KINDS ? gesture_names[gesture] : "?";
+}
+
+/**
+ * @brief Hand a gesture to the UI and publish it
+ */
+static void emit(gesture_t gesture, uint32_t now_ms) {
+    pending = gesture;
+
+    input_publication_t* input = (input_publication_t*)data_bus_begin_publish(BUS_TOPIC_INPUT);
+    if (input != NULL) {
+        input->gesture = gesture;
+        input->x = start_x;
+        input->y = start_y;
+        input->at_ms = now_ms;
+        input->gestures++;
+        if (gesture == GESTURE_TAP) {
+            input->taps++;
+        } else if (gesture == GESTURE_LONG_PRESS) {
+            input->long_presses++;
+        } else {
+            input->swipes++;
+        }
+        data_bus_publish(BUS_TOPIC_INPUT);
+    }
+    LOGD(UI, "👆 %s at %d,%d", gesture_names[gesture], start_x, start_y);
+}
@@ -0,0 +1,124 @@
+/**
+ * @file governor.cpp
+ * @brief Per-state budgets for the radios, the screen, the clock and the log
+ *
+ * Every AI state has one row below saying what the unit may spend in it.
+ * SLEEPING sweeps passively and rarely, draws few frames and logs only
+ * warnings; SNIFFING, TRACKING and EXCITED keep the clock off its lowest
+ * step so the radios and the decision loop answer at once, and the first
+ * and last of them scan twice as often. The row of a committed state is
+ * copied in whole under a lock, then pushed to the subsystems that hold
+ * their own settings.
+ *
+ * With GOVERNOR_ENABLED false only the scan profile and backlight columns
+ * apply; the budget columns fall back to the fixed configuration.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "governor.h"
+#include "power_manager.h"
+#include "logger.h"
+
+#if GOVERNOR_ENABLED
+#define ALERT_MIN_MHZ       GOVERNOR_ALERT_MIN_MHZ
+#define ALERT_INTERVAL_PCT  GOVERNOR_ALERT_INTERVAL_PCT
+#define CALM_FRAME_MS       GOVERNOR_CALM_FRAME_MS
+#define SLEEP_FRAME_MS      GOVERNOR_SLEEP_FRAME_MS
+#define SLEEP_INTERVAL_PCT  GOVERNOR_SLEEP_INTERVAL_PCT
+#define QUIET_LOG_LEVEL     GOVERNOR_QUIET_LOG_LEVEL
+#else
+#define ALERT_MIN_MHZ       POWER_MIN_MHZ
+#define ALERT_INTERVAL_PCT  100
+#define CALM_FRAME_MS       UI_UPDATE_INTERVAL
+#define SLEEP_FRAME_MS      UI_UPDATE_INTERVAL
+#define SLEEP_INTERVAL_PCT  100
+#define QUIET_LOG_LEVEL     LOG_DEFAULT_LEVEL
+#endif
+
+// Budgets, in ai_state_t order
+static const governor_profile_t profiles[AI_STATE_COUNT] = {
+    // Scan profile                 Interval            Frame gap           CPU floor      Log level          Backlight
+    { SCAN_PROFILE_FULL_ACTIVE,    100,                CALM_FRAME_MS,      POWER_MIN_MHZ, LOG_DEFAULT_LEVEL, BACKLIGHT_PCT_CALM },     // IDLE
+    { SCAN_PROFILE_TARGETED,       ALERT_INTERVAL_PCT, UI_UPDATE_INTERVAL, ALERT_MIN_MHZ, LOG_DEFAULT_LEVEL, BACKLIGHT_PCT_ACTIVE },   // SNIFFING
+    { SCAN_PROFILE_FULL_ACTIVE,    100,                UI_UPDATE_INTERVAL, ALERT_MIN_MHZ, LOG_DEFAULT_LEVEL, BACKLIGHT_PCT_ACTIVE },   // TRACKING
+    { SCAN_PROFILE_SINGLE_CHANNEL, 100,                CALM_FRAME_MS,      POWER_MIN_MHZ, LOG_DEFAULT_LEVEL, BACKLIGHT_PCT_CALM },     // LEARNING
+    { SCAN_PROFILE_FULL_ACTIVE,    ALERT_INTERVAL_PCT, UI_UPDATE_INTERVAL, ALERT_MIN_MHZ, LOG_DEFAULT_LEVEL, BACKLIGHT_PCT_ALERT },    // EXCITED
+    { SCAN_PROFILE_FAST_PASSIVE,   SLEEP_INTERVAL_PCT, SLEEP_FRAME_MS,     POWER_MIN_MHZ, QUIET_LOG_LEVEL,   BACKLIGHT_PCT_SLEEPING }, // SLEEPING
+    { SCAN_PROFILE_FAST_PASSIVE,   100,                CALM_FRAME_MS,      POWER_MIN_MHZ, LOG_DEFAULT_LEVEL, BACKLIGHT_PCT_ALERT },    // ERROR
+    { SCAN_PROFILE_FAST_PASSIVE,   100,                CALM_FRAME_MS,      POWER_MIN_MHZ, LOG_DEFAULT_LEVEL, BACKLIGHT_PCT_ACTIVE }    // UPDATING
+};
+
+// Modules whose level follows the state
+static const log_module_t governed_modules[] = { LOG_MODULE_SCAN, LOG_MODULE_AI };
+
+static governor_status_t status = { AI_STATE_IDLE, profiles[AI_STATE_IDLE], 0, 0 };
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Budget table entry of an AI state
+ */
+const governor_profile_t* governor_profile_for(ai_state_t state) {
+    return &profiles[state < AI_STATE_COUNT ? state : AI_STATE_IDLE];
+}
+
+/**
+ * @brief Put a state's profile in force
+ */
+void governor_apply(ai_state_t state, uint32_t now_ms) {
+    const governor_profile_t* next = governor_profile_for(state);
+
+    portENTER_CRITICAL(&status_mux);
+    governor_profile_t previous = status.profile;
+    bool first = status.applies == 0;
+    status.state = state < AI_STATE_COUNT ? state : AI_STATE_IDLE;
+    status.profile = *next;
+    status.applies++;
+    status.applied_ms = now_ms;
+    portEXIT_CRITICAL(&status_mux);
+
+    // Trade radio time for freshness according to the new state
+    scan_profile_select(next->scan_profile);
+#if GOVERNOR_ENABLED
+    if (first || next->cpu_min_mhz != previous.cpu_min_mhz) {
+        power_manager_set_min_mhz(next->cpu_min_mhz);
+    }
+    for (uint8_t i = 0; i < sizeof(governed_modules) / sizeof(governed_modules[0]); i++) {
+        if (logger_get_level(governed_modules[i]) == previous.log_level) {
+            logger_set_level(governed_modules[i], next->log_level);
+        }
+    }
+#else
+    (void)first;
+    (void)previous;
+#endif
+}
+
+/**
+ * @brief Scale a scan profile's interval by the state's budget
+ */
+uint32_t governor_scan_interval_ms(uint32_t profile_ms) {
+    portENTER_CRITICAL(&status_mux);
+    uint16_t pct = status.profile.interval_pct;
+    portEXIT_CRITICAL(&status_mux);
+    return (uint32_t)((uint64_t)profile_ms * pct / 100);
+}
+
+/**
+ * @brief Shortest UI frame gap of the state in force
+ */
+uint32_t governor_frame_interval_ms(void) {
+    portENTER_CRITICAL(&status_mux);
+    uint16_t frame_ms = status.profile.frame_interval_ms;
+    portEXIT_CRITICAL(&status_mux);
+    return frame_ms;
+}
+
+/**
+ * @brief Copy the profile in force
+ */
+void governor_get_status(governor_status_t* out) {
+    portENTER_CRITICAL(&status_mux);
+    *out = status;
+    portEXIT_CRITICAL(&status_mux);
+}
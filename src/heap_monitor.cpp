@@ -0,0 +1,131 @@
+/**
+ * @file heap_monitor.cpp
+ * @brief Largest free block, block counts and fragmentation per heap capability
+ *
+ * Allocations start failing when no single free block is big enough,
+ * which on a unit up for weeks happens long before free memory runs out.
+ * heap_caps_get_info() gives both figures for a capability class; they
+ * are sampled on a slow cadence, since each call walks the heaps under
+ * their locks, and a ring of trend points shows which way they drift.
+ */
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "config.h"
+#include "heap_monitor.h"
+
+typedef struct {
+    uint32_t total_free;
+    uint32_t largest_free;
+} trend_point_t;
+
+typedef struct {
+    trend_point_t points[HEAP_TREND_POINTS];
+    uint16_t      next;
+    uint16_t      count;
+} trend_ring_t;
+
+// In heap_region_t order
+static const uint32_t region_caps[HEAP_REGION_COUNT] = {
+    MALLOC_CAP_INTERNAL, MALLOC_CAP_DMA, MALLOC_CAP_SPIRAM, MALLOC_CAP_8BIT, MALLOC_CAP_32BIT
+};
+static const char* const region_names[HEAP_REGION_COUNT] = {
+    "internal", "dma", "psram", "8bit", "32bit"
+};
+
+static heap_region_stats_t stats[HEAP_REGION_COUNT];
+static trend_ring_t trends[HEAP_REGION_COUNT];
+static uint32_t last_sample_ms = 0;
+static uint32_t last_trend_ms = 0;
+static bool sampled = false;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void add_trend_point(heap_region_t region, heap_region_stats_t* now);
+static int32_t per_hour(int64_t delta, uint16_t intervals);
+
+/**
+ * @brief Walk every capability class's heaps
+ */
+void heap_monitor_sample(uint32_t now_ms) {
+    if (sampled && now_ms - last_sample_ms < HEAP_SAMPLE_MS) {
+        return;
+    }
+    bool trend_due = !sampled || now_ms - last_trend_ms >= HEAP_TREND_INTERVAL_MS;
+    last_sample_ms = now_ms;
+    if (trend_due) {
+        last_trend_ms = now_ms;
+    }
+
+    for (uint8_t region = 0; region < HEAP_REGION_COUNT; region++) {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, region_caps[region]);
+
+        heap_region_stats_t now = stats[region];
+        now.total_free = info.total_free_bytes;
+        now.largest_free = info.largest_free_block;
+        now.min_free = info.minimum_free_bytes;
+        now.free_blocks = info.free_blocks;
+        now.allocated_blocks = info.allocated_blocks;
+        now.frag_pct = info.total_free_bytes > 0 ?
+            (uint8_t)(100 - (uint64_t)info.largest_free_block * 100 / info.total_free_bytes) : 0;
+        if (!sampled || now.largest_free < now.min_largest_free) {
+            now.min_largest_free = now.largest_free;
+        }
+        now.max_frag_pct = max(now.max_frag_pct, now.frag_pct);
+        if (trend_due) {
+            add_trend_point((heap_region_t)region, &now);
+        }
+
+        portENTER_CRITICAL(&stats_mux);
+        stats[region] = now;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+    sampled = true;
+}
+
+/**
+ * @brief Figures of one capability class, as last sampled
+ */
+void heap_monitor_get(heap_region_t region, heap_region_stats_t* out) {
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats[region];
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Short name for logs
+ */
+const char* heap_monitor_region_name(heap_region_t region) {
+    return region < HEAP_REGION_COUNT ? region_names[region] : "?";
+}
+
+/**
+ * @brief Record a trend point and set the trends from the oldest one kept
+ */
+static void add_trend_point(heap_region_t region, heap_region_stats_t* now) {
+    trend_ring_t* ring = &trends[region];
+    ring->points[ring->next].total_free = now->total_free;
+    ring->points[ring->next].largest_free = now->largest_free;
+    ring->next = (ring->next + 1) % HEAP_TREND_POINTS;
+    if (ring->count < HEAP_TREND_POINTS) {
+        ring->count++;
+    }
+
+    // The oldest point is the one the next write replaces, once the ring is full
+    const trend_point_t* oldest = &ring->points[ring->count < HEAP_TREND_POINTS ? 0 : ring->next];
+    uint16_t intervals = ring->count - 1;
+    now->trend_points = ring->count;
+    now->free_trend_per_hour = per_hour((int64_t)now->total_free - oldest->total_free, intervals);
+    now->largest_trend_per_hour = per_hour((int64_t)now->largest_free - oldest->largest_free, intervals);
+}
+
+/**
+ * @brief Scale a change over some trend intervals to one hour
+ */
+static int32_t per_hour(int64_t delta, uint16_t intervals) {
+    if (intervals == 0) {
+        return 0;
+    }
+    return (int32_t)(delta * 3600000 / ((int64_t)intervals * HEAP_TREND_INTERVAL_MS));
+}
@@ -0,0 +1,459 @@
+/**
+ * @file image_cache.cpp
+ * @brief Images from the SD card, loaded on the job pool into a PSRAM cache
+ *
+ * Reading a full-screen image off the card takes longer than a frame, so
+ * the UI task never does it: a miss puts the placeholder on screen and
+ * submits a load, and the frame after the load finishes swaps the image
+ * in. The load holds the SPI bus one chunk at a time, so panel flushes on
+ * a shared bus go on between chunks.
+ *
+ * An entry's lv_img_dsc_t lives in its slot, so an lv_img object points
+ * straight at it; LVGL's built-in decoder only reads the header and the
+ * pixels are never copied again. Before the pixels are freed, whether by
+ * eviction or because the file changed, LVGL's own image cache is told
+ * to forget the source. Slots are only ever changed by the UI task; a
+ * load job fills the result fields of its slot and leaves them for
+ * image_cache_poll().
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <lvgl.h>
+#include "config.h"
+#include "image_cache.h"
+#include "mem_policy.h"
+#include "storage.h"
+#include "job_pool.h"
+#include "ui_events.h"
+#include "logger.h"
+
+typedef enum {
+    SLOT_EMPTY = 0,
+    SLOT_LOADING,                   // First load in flight, placeholder on screen
+    SLOT_READY,
+    SLOT_FAILED                     // Retried after IMAGE_CACHE_RECHECK_MS
+} slot_state_t;
+
+/**
+ * @brief One cached image
+ */
+typedef struct {
+    char         path[IMAGE_CACHE_PATH_BYTES];
+    slot_state_t state;
+    bool         checking;          // A load is in flight for a READY image
+    uint32_t     mtime;
+    uint32_t     checked_ms;
+    uint32_t     used;              // LRU stamp
+    uint8_t      refs;              // Objects showing it or waiting for it
+    uint8_t*     data;              // PSRAM
+    lv_img_dsc_t dsc;
+
+    // Written by the load job, taken by image_cache_poll()
+    volatile bool   done;
+    bool            ok;
+    uint8_t*        loaded;         // NULL: unchanged since mtime, or failed
+    lv_img_header_t loaded_header;
+    uint32_t        loaded_size;
+    uint32_t        loaded_mtime;
+} slot_t;
+
+/**
+ * @brief An lv_img object showing, or waiting for, a slot's image
+ */
+typedef struct {
+    lv_obj_t* obj;                  // NULL: free
+    uint8_t   slot;
+} binding_t;
+
+/**
+ * @brief Job payload, copied at submit
+ */
+typedef struct {
+    uint8_t  slot;
+    uint32_t known_mtime;           // 0 for a first load
+    char     path[IMAGE_CACHE_PATH_BYTES];
+} load_request_t;
+
+static_assert(sizeof(load_request_t) <= JOB_PAYLOAD_BYTES, "image path too long for a job payload");
+
+static slot_t slots[IMAGE_CACHE_ENTRIES];
+static binding_t bindings[IMAGE_CACHE_BINDINGS];
+static uint32_t use_clock = 0;
+static image_cache_stats_t stats;
+static portMUX_TYPE cache_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static int8_t find_slot(const char* path);
+static int8_t claim_slot(void);
+static bool submit_load(uint8_t index, uint32_t known_mtime, uint32_t now_ms);
+static void take_result(uint8_t index, uint32_t now_ms);
+static void evict(uint8_t index);
+static void bind(lv_obj_t* img, uint8_t index);
+static void unbind(lv_obj_t* img);
+static void on_delete(lv_event_t* event);
+static void load_job(void* payload);
+static bool read_image(const load_request_t* request, lv_img_header_t* header, uint8_t** pixels,
+                       uint32_t* size, uint32_t* mtime);
+
+/**
+ * @brief Show an image from the card on an lv_img object
+ */
+bool image_cache_set_src(lv_obj_t* img, const char* path, const void* placeholder) {
+    unbind(img);
+    if (strlen(path) >= IMAGE_CACHE_PATH_BYTES) {
+        if (placeholder != NULL) {
+            lv_img_set_src(img, placeholder);
+        }
+        return false;
+    }
+
+    uint32_t now = millis();
+    int8_t index = find_slot(path);
+    if (index >= 0 && slots[index].state == SLOT_READY) {
+        slot_t* slot = &slots[index];
+        slot->used = ++use_clock;
+        bind(img, index);
+        lv_img_set_src(img, &slot->dsc);
+        portENTER_CRITICAL(&cache_mux);
+        stats.hits++;
+        portEXIT_CRITICAL(&cache_mux);
+        return true;
+    }
+
+    if (placeholder != NULL) {
+        lv_img_set_src(img, placeholder);
+    }
+    if (index < 0) {
+        index = claim_slot();
+        if (index < 0) {
+            portENTER_CRITICAL(&cache_mux);
+            stats.rejected++;
+            portEXIT_CRITICAL(&cache_mux);
+            return false;
+        }
+        strlcpy(slots[index].path, path, IMAGE_CACHE_PATH_BYTES);
+        slots[index].state = SLOT_LOADING;
+        if (!submit_load(index, 0, now)) {
+            slots[index].state = SLOT_EMPTY;
+            return false;
+        }
+    } else if (slots[index].state == SLOT_FAILED &&
+               now - slots[index].checked_ms >= IMAGE_CACHE_RECHECK_MS) {
+        slots[index].state = SLOT_LOADING;
+        if (!submit_load(index, 0, now)) {
+            slots[index].state = SLOT_FAILED;
+        }
+    }
+    slots[index].used = ++use_clock;
+    bind(img, index);
+    portENTER_CRITICAL(&cache_mux);
+    stats.misses++;
+    portEXIT_CRITICAL(&cache_mux);
+    return false;
+}
+
+/**
+ * @brief Hand finished loads to their objects and evict down to the budget
+ */
+void image_cache_poll(uint32_t now_ms) {
+    for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+        slot_t* slot = &slots[i];
+        if (slot->done) {
+            take_result(i, now_ms);
+        }
+        // Images on screen have their file checked for a newer version
+        if (slot->state == SLOT_READY && slot->refs > 0 && !slot->checking &&
+            now_ms - slot->checked_ms >= IMAGE_CACHE_RECHECK_MS) {
+            slot->checking = submit_load(i, slot->mtime, now_ms);
+        }
+    }
+
+    while (stats.bytes > IMAGE_CACHE_BYTES) {
+        int8_t oldest = -1;
+        for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+            const slot_t* slot = &slots[i];
+            if (slot->state == SLOT_READY && slot->refs == 0 && !slot->checking &&
+                (oldest < 0 || (int32_t)(slot->used - slots[oldest].used) < 0)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            break;                  // Everything left is on screen
+        }
+        evict(oldest);
+    }
+}
+
+/**
+ * @brief Drop every image no object shows
+ */
+size_t image_cache_release(void) {
+    size_t before = stats.bytes;
+    for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+        const slot_t* slot = &slots[i];
+        if ((slot->state == SLOT_READY || slot->state == SLOT_FAILED) && slot->refs == 0 && !slot->checking) {
+            evict(i);
+        }
+    }
+    return before - stats.bytes;
+}
+
+/**
+ * @brief Copy the cache's figures
+ */
+void image_cache_get_stats(image_cache_stats_t* out) {
+    portENTER_CRITICAL(&cache_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&cache_mux);
+}
+
+/**
+ * @brief Slot holding a path, in any state
+ */
+static int8_t find_slot(const char* path) {
+    for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+        if (slots[i].state != SLOT_EMPTY && strcmp(slots[i].path, path) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief An empty slot, or the least recently used one no object needs
+ */
+static int8_t claim_slot(void) {
+    int8_t oldest = -1;
+    for (uint8_t i = 0; i < IMAGE_CACHE_ENTRIES; i++) {
+        const slot_t* slot = &slots[i];
+        if (slot->state == SLOT_EMPTY && !slot->done) {
+            return i;
+        }
+        bool idle = (slot->state == SLOT_READY || slot->state == SLOT_FAILED) &&
+                    slot->refs == 0 && !slot->checking && !slot->done;
+        if (idle && (oldest < 0 || (int32_t)(slot->used - slots[oldest].used) < 0)) {
+            oldest = i;
+        }
+    }
+    if (oldest >= 0) {
+        evict(oldest);
+    }
+    return oldest;
+}
+
+/**
+ * @brief Queue a slot's file on the low lane
+ */
+static bool submit_load(uint8_t index, uint32_t known_mtime, uint32_t now_ms) {
+    load_request_t request;
+    request.slot = index;
+    request.known_mtime = known_mtime;
+    strlcpy(request.path, slots[index].path, sizeof(request.path));
+    slots[index].checked_ms = now_ms;
+    if (job_pool_submit(JOB_LANE_LOW, load_job, &request, sizeof(request))) {
+        return true;
+    }
+    portENTER_CRITICAL(&cache_mux);
+    stats.rejected++;
+    portEXIT_CRITICAL(&cache_mux);
+    return false;
+}
+
+/**
+ * @brief Install what a load job left in its slot
+ */
+static void take_result(uint8_t index, uint32_t now_ms) {
+    slot_t* slot = &slots[index];
+    bool was_ready = slot->state == SLOT_READY;
+    slot->done = false;
+    slot->checking = false;
+    slot->checked_ms = now_ms;
+
+    if (!slot->ok) {
+        if (!was_ready) {
+            slot->state = SLOT_FAILED;
+            LOGW(UI, "⚠️  Image %s not loaded", slot->path);
+        }
+        return;                     // A vanished file leaves the image on screen as it was
+    }
+    if (slot->loaded == NULL) {
+        return;                     // Unchanged since the last load
+    }
+
+    portENTER_CRITICAL(&cache_mux);
+    if (was_ready) {
+        stats.bytes -= slot->dsc.data_size;
+        stats.reloads++;
+    } else {
+        stats.entries++;
+    }
+    stats.bytes += slot->loaded_size;
+    portEXIT_CRITICAL(&cache_mux);
+
+    if (was_ready) {
+        lv_img_cache_invalidate_src(&slot->dsc);
+        mem_free(MEM_CACHE, slot->data, slot->dsc.data_size);
+    }
+    slot->data = slot->loaded;
+    slot->loaded = NULL;
+    slot->mtime = slot->loaded_mtime;
+    slot->dsc.header = slot->loaded_header;
+    slot->dsc.data_size = slot->loaded_size;
+    slot->dsc.data = slot->data;
+    slot->state = SLOT_READY;
+
+    for (uint8_t b = 0; b < IMAGE_CACHE_BINDINGS; b++) {
+        if (bindings[b].obj != NULL && bindings[b].slot == index) {
+            lv_img_set_src(bindings[b].obj, &slot->dsc);
+        }
+    }
+}
+
+/**
+ * @brief Free a slot's pixels and forget its path
+ */
+static void evict(uint8_t index) {
+    slot_t* slot = &slots[index];
+    if (slot->state == SLOT_READY) {
+        lv_img_cache_invalidate_src(&slot->dsc);
+        mem_free(MEM_CACHE, slot->data, slot->dsc.data_size);
+        portENTER_CRITICAL(&cache_mux);
+        stats.bytes -= slot->dsc.data_size;
+        stats.entries--;
+        stats.evictions++;
+        portEXIT_CRITICAL(&cache_mux);
+    }
+    slot->data = NULL;
+    slot->state = SLOT_EMPTY;
+    slot->path[0] = '\0';
+    slot->mtime = 0;
+}
+
+/**
+ * @brief Note that an object shows or waits for a slot
+ */
+static void bind(lv_obj_t* img, uint8_t index) {
+    for (uint8_t b = 0; b < IMAGE_CACHE_BINDINGS; b++) {
+        if (bindings[b].obj == NULL) {
+            bindings[b].obj = img;
+            bindings[b].slot = index;
+            slots[index].refs++;
+            lv_obj_add_event_cb(img, on_delete, LV_EVENT_DELETE, NULL);
+            return;
+        }
+    }
+    // Out of bindings: the object keeps what it has, the slot is not pinned
+    portENTER_CRITICAL(&cache_mux);
+    stats.rejected++;
+    portEXIT_CRITICAL(&cache_mux);
+}
+
+/**
+ * @brief Forget an object's binding, if it has one
+ */
+static void unbind(lv_obj_t* img) {
+    for (uint8_t b = 0; b < IMAGE_CACHE_BINDINGS; b++) {
+        if (bindings[b].obj == img) {
+            slots[bindings[b].slot].refs--;
+            bindings[b].obj = NULL;
+            lv_obj_remove_event_cb(img, on_delete);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief A bound object is being deleted
+ */
+static void on_delete(lv_event_t* event) {
+    unbind(lv_event_get_target(event));
+}
+
+/**
+ * @brief Read one image file into PSRAM (job pool worker)
+ */
+static void load_job(void* payload) {
+    const load_request_t* request = (const load_request_t*)payload;
+    slot_t* slot = &slots[request->slot];
+
+    int64_t started_us = esp_timer_get_time();
+    lv_img_header_t header;
+    uint8_t* pixels = NULL;
+    uint32_t size = 0;
+    uint32_t mtime = 0;
+    bool ok = read_image(request, &header, &pixels, &size, &mtime);
+    uint32_t took_us = (uint32_t)(esp_timer_get_time() - started_us);
+
+    slot->ok = ok;
+    slot->loaded = pixels;
+    slot->loaded_header = header;
+    slot->loaded_size = size;
+    slot->loaded_mtime = mtime;
+    portENTER_CRITICAL(&cache_mux);
+    if (ok) {
+        stats.loads++;
+    } else {
+        stats.failures++;
+    }
+    stats.max_load_us = max(stats.max_load_us, took_us);
+    slot->done = true;
+    portEXIT_CRITICAL(&cache_mux);
+    ui_notify(UI_EVENT_IMAGE);
+}
+
+/**
+ * @brief Check the header against the file size and read the pixels
+ *
+ * The bus is given back between chunks of IMAGE_CACHE_CHUNK_BYTES.
+ * @return true with pixels NULL if the file still has known_mtime
+ */
+static bool read_image(const load_request_t* request, lv_img_header_t* header, uint8_t** pixels,
+                       uint32_t* size, uint32_t* mtime) {
+    memset(header, 0, sizeof(*header));
+    if (!storage_lock(STORAGE_MEDIUM_SD)) {
+        return false;
+    }
+    File file = storage_fs(STORAGE_MEDIUM_SD)->open(request->path, FILE_READ);
+    if (!file) {
+        storage_unlock(STORAGE_MEDIUM_SD);
+        return false;
+    }
+    *mtime = (uint32_t)file.getLastWrite();
+    if (request->known_mtime != 0 && *mtime == request->known_mtime) {
+        file.close();
+        storage_unlock(STORAGE_MEDIUM_SD);
+        return true;
+    }
+
+    uint32_t file_size = file.size();
+    bool ok = file_size > sizeof(*header) &&
+              file.read((uint8_t*)header, sizeof(*header)) == sizeof(*header);
+    *size = file_size - sizeof(*header);
+    ok = ok && header->w > 0 && header->h > 0 && *size <= IMAGE_CACHE_BYTES &&
+         lv_img_buf_get_img_size(header->w, header->h, header->cf) == *size;
+    uint8_t* data = ok ? (uint8_t*)mem_alloc(MEM_CACHE, *size) : NULL;
+    storage_unlock(STORAGE_MEDIUM_SD);
+
+    for (uint32_t offset = 0; data != NULL && offset < *size; offset += IMAGE_CACHE_CHUNK_BYTES) {
+        uint32_t chunk = min((uint32_t)IMAGE_CACHE_CHUNK_BYTES, *size - offset);
+        if (!storage_lock(STORAGE_MEDIUM_SD)) {
+            mem_free(MEM_CACHE, data, *size);
+            data = NULL;
+            break;
+        }
+        if (file.read(data + offset, chunk) != chunk) {
+            mem_free(MEM_CACHE, data, *size);
+            data = NULL;
+        }
+        storage_unlock(STORAGE_MEDIUM_SD);
+    }
+
+    bool locked = storage_lock(STORAGE_MEDIUM_SD);
+    file.close();
+    if (locked) {
+        storage_unlock(STORAGE_MEDIUM_SD);
+    }
+    *pixels = data;
+    return data != NULL;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file job_pool.cpp
+ * @brief Fixed worker pool fed from bounded priority lanes
+ *
+ * Descriptors come from a preallocated array through a free list, so a
+ * submit never touches the heap. Each lane is a FreeRTOS queue of
+ * descriptor pointers, which is safe with any number of producers and
+ * workers; a counting semaphore holds one count per queued job, so an idle
+ * worker waits on a single object and then takes from the highest lane
+ * that has work.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "job_pool.h"
+#include "event_trace.h"
+#include "logger.h"
+
+typedef struct job {
+    job_fn_t     fn;
+    uint32_t     submitted_us;
+    uint8_t      lane;
+    struct job*  next_free;
+    uint8_t      payload[JOB_PAYLOAD_BYTES] __attribute__((aligned(4)));
+} job_t;
+
+static const char* const lane_names[JOB_LANE_COUNT] = { "high", "normal", "low" };
+
+static job_t jobs[JOB_POOL_SIZE];
+static job_t* free_list = NULL;
+static QueueHandle_t lanes[JOB_LANE_COUNT];
+static StaticQueue_t lane_states[JOB_LANE_COUNT];
+static uint8_t lane_storage[JOB_LANE_COUNT][JOB_LANE_DEPTH * sizeof(job_t*)];
+static SemaphoreHandle_t pending = NULL;
+static StaticSemaphore_t pending_state;
+static StackType_t worker_stacks[JOB_WORKERS][JOB_WORKER_STACK_SIZE];
+static StaticTask_t worker_tcbs[JOB_WORKERS];
+static job_lane_stats_t stats[JOB_LANE_COUNT];
+static portMUX_TYPE pool_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void worker_task(void* parameter);
+static job_t* take_next(void);
+static void release(job_t* job);
+
+/**
+ * @brief Create the descriptor pool, the lanes and the worker tasks
+ */
+bool job_pool_init(void) {
+    if (pending != NULL) {
+        return true;
+    }
+    for (uint8_t i = 0; i < JOB_POOL_SIZE; i++) {
+        jobs[i].next_free = i + 1 < JOB_POOL_SIZE ? &jobs[i + 1] : NULL;
+    }
+    free_list = &jobs[0];
+
+    for (uint8_t lane = 0; lane < JOB_LANE_COUNT; lane++) {
+        lanes[lane] = xQueueCreateStatic(JOB_LANE_DEPTH, sizeof(job_t*),
+                                         lane_storage[lane], &lane_states[lane]);
+    }
+    pending = xSemaphoreCreateCountingStatic(JOB_LANE_COUNT * JOB_LANE_DEPTH, 0, &pending_state);
+
+    for (uint8_t i = 0; i < JOB_WORKERS; i++) {
+        char name[configMAX_TASK_NAME_LEN];
+        snprintf(name, sizeof(name), "Job_Worker%u", i);
+        if (xTaskCreateStaticPinnedToCore(worker_task, name, JOB_WORKER_STACK_SIZE, NULL,
+                                          JOB_WORKER_PRIORITY, worker_stacks[i], &worker_tcbs[i],
+                                          tskNO_AFFINITY) == NULL) {
+            LOGE(SYSTEM, "❌ Job worker %u could not be created", i);
+            return false;
+        }
+    }
+    LOGI(SYSTEM, "✅ Job pool: %d workers, %d descriptors", JOB_WORKERS, JOB_POOL_SIZE);
+    return true;
+}
+
+/**
+ * @brief Hand a job to the workers without blocking
+ */
+bool job_pool_submit(job_lane_t lane, job_fn_t fn, const void* payload, size_t length) {
+    if (lane >= JOB_LANE_COUNT || fn == NULL || length > JOB_PAYLOAD_BYTES || pending == NULL) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&pool_mux);
+    job_t* job = free_list;
+    if (job != NULL) {
+        free_list = job->next_free;
+        stats[lane].submitted++;
+    } else {
+        stats[lane].rejected++;
+    }
+    portEXIT_CRITICAL(&pool_mux);
+    if (job == NULL) {
+        return false;
+    }
+
+    job->fn = fn;
+    job->lane = lane;
+    if (length > 0) {
+        memcpy(job->payload, payload, length);
+    }
+    job->submitted_us = (uint32_t)esp_timer_get_time();
+
+    bool sent = xQueueSend(lanes[lane], &job, 0) == pdTRUE;
+    TRACE_EVENT(TRACE_QUEUE_SEND, TRACE_QUEUE_JOBS_HIGH + lane,
+                sent ? uxQueueMessagesWaiting(lanes[lane]) : UINT32_MAX);
+    if (!sent) {
+        portENTER_CRITICAL(&pool_mux);
+        stats[lane].submitted--;
+        stats[lane].rejected++;
+        portEXIT_CRITICAL(&pool_mux);
+        release(job);
+        return false;
+    }
+    xSemaphoreGive(pending);
+    return true;
+}
+
+/**
+ * @brief Copy one lane's figures
+ */
+void job_pool_get_stats(job_lane_t lane, job_lane_stats_t* out) {
+    portENTER_CRITICAL(&pool_mux);
+    *out = stats[lane];
+    portEXIT_CRITICAL(&pool_mux);
+}
+
+/**
+ * @brief Short name for logs
+ */
+const char* job_pool_lane_name(job_lane_t lane) {
+    return lane < JOB_LANE_COUNT ? lane_names[lane] : "?";
+}
+
+/**
+ * @brief Worker - runs one job per count taken from the pending semaphore
+ */
+static void worker_task(void* parameter) {
+    while (true) {
+        xSemaphoreTake(pending, portMAX_DELAY);
+        job_t* job = take_next();
+        if (job == NULL) {
+            continue;
+        }
+
+        uint32_t start_us = (uint32_t)esp_timer_get_time();
+        job->fn(job->payload);
+        uint32_t end_us = (uint32_t)esp_timer_get_time();
+
+        job_lane_stats_t* lane = &stats[job->lane];
+        portENTER_CRITICAL(&pool_mux);
+        lane->completed++;
+        lane->max_wait_us = max(lane->max_wait_us, start_us - job->submitted_us);
+        lane->max_run_us = max(lane->max_run_us, end_us - start_us);
+        portEXIT_CRITICAL(&pool_mux);
+        release(job);
+    }
+}
+
+/**
+ * @brief Oldest job of the highest lane with work
+ */
+static job_t* take_next(void) {
+    job_t* job = NULL;
+    for (uint8_t lane = 0; lane < JOB_LANE_COUNT; lane++) {
+        if (xQueueReceive(lanes[lane], &job, 0) == pdTRUE) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Return a descriptor to the free list
+ */
+static void release(job_t* job) {
+    portENTER_CRITICAL(&pool_mux);
+    job->next_free = free_list;
+    free_list = job;
+    portEXIT_CRITICAL(&pool_mux);
+}
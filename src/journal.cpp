@@ -0,0 +1,468 @@
+/**
+ * @file journal.cpp
+ * @brief Power-cut-safe key-value store, as a log of records on a raw partition
+ *
+ * Every put appends a record to the head sector and commits it in two
+ * phases: the record goes to flash in its written state, then its state
+ * byte is programmed to committed. A record torn in either phase fails its
+ * state or its CRC and the key keeps its previous value. Nothing is ever
+ * rewritten in place, so a commit is one write of a few dozen bytes and
+ * one of a byte, well under a millisecond, instead of a file rewrite.
+ *
+ * RAM holds where each key's newest record is. At boot the sectors are
+ * replayed in the order they were taken, each record once. When the head
+ * is full the next erased sector is taken; one is always kept spare, and
+ * taking it triggers the reclaim of the oldest sector: its still-current
+ * records are copied to the head and the sector is erased. A power cut
+ * during a reclaim leaves two copies of the same generation, which replay
+ * to the same value.
+ */
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "journal.h"
+#include "logger.h"
+
+#define SECTOR_BYTES     4096
+#define RECORD_MAX       256        // One flash page
+#define SEQUENCE_ERASED  0          // sequences[] of a sector ready to take
+
+static_assert(sizeof(journal_record_header_t) + JOURNAL_KEY_BYTES - 1 + JOURNAL_VALUE_MAX <= RECORD_MAX,
+              "a journal record must fit one flash page");
+
+typedef struct {
+    char     key[JOURNAL_KEY_BYTES];
+    uint32_t address;               // Of the record in the partition
+    uint32_t generation;
+    uint16_t value_length;
+    bool     used;
+} index_entry_t;
+
+static const esp_partition_t* partition = NULL;
+static uint8_t sector_count = 0;
+static uint32_t sequences[JOURNAL_MAX_SECTORS];
+static uint8_t head = 0;
+static uint32_t head_offset = SECTOR_BYTES;     // Within the head sector
+static uint32_t next_sequence = 1;
+static uint32_t next_generation = 1;
+static index_entry_t entries[JOURNAL_MAX_KEYS];
+static uint8_t record[RECORD_MAX];
+static SemaphoreHandle_t journal_lock = NULL;
+static StaticSemaphore_t journal_lock_state;
+static journal_stats_t stats = {0};
+
+// Forward declarations
+static bool prepare_sector(uint8_t sector);
+static void replay_sector(uint8_t sector);
+static bool write_record(const char* key, uint8_t flags, const void* value, uint16_t length, uint32_t generation);
+static bool take_sector(void);
+static bool reclaim_oldest(void);
+static bool activate(uint8_t sector);
+static index_entry_t* find_entry(const char* key);
+static void apply(const char* key, uint8_t flags, uint32_t address, uint32_t generation, uint16_t length);
+static uint32_t record_bytes(uint8_t key_length, uint16_t value_length);
+static uint32_t record_crc(const uint8_t* bytes, uint32_t length);
+static uint8_t free_sectors(void);
+
+/**
+ * @brief Find the journal partition and replay it into the RAM index
+ */
+bool journal_init(void) {
+    if (partition != NULL) {
+        return true;
+    }
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                         (esp_partition_subtype_t)JOURNAL_PARTITION_SUBTYPE,
+                                         JOURNAL_PARTITION_LABEL);
+    if (partition == NULL) {
+        LOGW(SYSTEM, "⚠️  No journal partition - settings fall back to NVS");
+        return false;
+    }
+    sector_count = (uint8_t)min(partition->size / SECTOR_BYTES, (uint32_t)JOURNAL_MAX_SECTORS);
+    if (sector_count < 3) {
+        LOGE(SYSTEM, "❌ Journal partition has %u sectors, at least 3 are needed", sector_count);
+        partition = NULL;
+        return false;
+    }
+    journal_lock = xSemaphoreCreateMutexStatic(&journal_lock_state);
+
+    uint32_t start_us = (uint32_t)esp_timer_get_time();
+    for (uint8_t s = 0; s < sector_count; s++) {
+        prepare_sector(s);
+    }
+
+    // Replay oldest first, so a newer record of a key always lands last
+    uint32_t replayed_up_to = 0;
+    for (uint8_t pass = 0; pass < sector_count; pass++) {
+        int16_t oldest = -1;
+        for (uint8_t s = 0; s < sector_count; s++) {
+            if (sequences[s] > replayed_up_to && (oldest < 0 || sequences[s] < sequences[oldest])) {
+                oldest = s;
+            }
+        }
+        if (oldest < 0) {
+            break;
+        }
+        replay_sector((uint8_t)oldest);
+        replayed_up_to = sequences[oldest];
+        head = (uint8_t)oldest;
+        next_sequence = replayed_up_to + 1;
+    }
+    if (next_sequence == 1 && !activate(0)) {
+        LOGE(SYSTEM, "❌ Journal partition could not be written");
+        partition = NULL;
+        return false;
+    }
+    // Cut off mid-reclaim: the head holds part of the copies, finish them
+    if (free_sectors() == 0 && !reclaim_oldest()) {
+        LOGW(SYSTEM, "⚠️  Journal has no spare sector - it is read-only until erased");
+    }
+    stats.replay_us = (uint32_t)esp_timer_get_time() - start_us;
+    stats.mounted = true;
+    stats.sectors = sector_count;
+    LOGI(SYSTEM, "✅ Journal: %u keys at generation %lu, %lu records replayed (%lu torn) in %lu us",
+         stats.keys, next_generation - 1, stats.replayed, stats.torn, stats.replay_us);
+    return true;
+}
+
+/**
+ * @brief Write a value under a key and commit it before returning
+ */
+bool journal_put(const char* key, const void* value, size_t length) {
+    size_t key_length = strlen(key);
+    if (partition == NULL || key_length == 0 || key_length >= JOURNAL_KEY_BYTES || length > JOURNAL_VALUE_MAX) {
+        return false;
+    }
+    xSemaphoreTake(journal_lock, portMAX_DELAY);
+    uint32_t start_us = (uint32_t)esp_timer_get_time();
+    bool ok = (find_entry(key) != NULL || stats.keys < JOURNAL_MAX_KEYS) &&
+              write_record(key, 0, value, (uint16_t)length, next_generation);
+    uint32_t elapsed_us = (uint32_t)esp_timer_get_time() - start_us;
+    if (ok) {
+        stats.commits++;
+        stats.last_commit_us = elapsed_us;
+        stats.max_commit_us = max(stats.max_commit_us, elapsed_us);
+    } else {
+        stats.failures++;
+    }
+    xSemaphoreGive(journal_lock);
+    if (!ok) {
+        LOGW(SYSTEM, "⚠️  Journal put of %s failed", key);
+    }
+    return ok;
+}
+
+/**
+ * @brief Read the committed value of a key
+ */
+size_t journal_get(const char* key, void* value, size_t size) {
+    if (partition == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(journal_lock, portMAX_DELAY);
+    const index_entry_t* entry = find_entry(key);
+    size_t length = 0;
+    if (entry != NULL && entry->value_length <= size) {
+        uint32_t offset = entry->address + sizeof(journal_record_header_t) + strlen(entry->key);
+        if (esp_partition_read(partition, offset, value, entry->value_length) == ESP_OK) {
+            length = entry->value_length;
+        }
+    }
+    xSemaphoreGive(journal_lock);
+    return length;
+}
+
+/**
+ * @brief Remove a key by committing a tombstone
+ */
+bool journal_erase(const char* key) {
+    if (partition == NULL) {
+        return false;
+    }
+    xSemaphoreTake(journal_lock, portMAX_DELAY);
+    bool ok = find_entry(key) == NULL ||
+              write_record(key, JOURNAL_FLAG_ERASE, NULL, 0, next_generation);
+    xSemaphoreGive(journal_lock);
+    return ok;
+}
+
+/**
+ * @brief Copy the store figures
+ */
+void journal_get_stats(journal_stats_t* out) {
+    if (journal_lock == NULL) {
+        *out = stats;
+        return;
+    }
+    xSemaphoreTake(journal_lock, portMAX_DELAY);
+    stats.generation = next_generation - 1;
+    stats.sectors_free = free_sectors();
+    *out = stats;
+    xSemaphoreGive(journal_lock);
+}
+
+/**
+ * @brief Read a sector's header; erase it unless it is in use or blank
+ */
+static bool prepare_sector(uint8_t sector) {
+    uint32_t base = sector * SECTOR_BYTES;
+    journal_sector_header_t header;
+    sequences[sector] = SEQUENCE_ERASED;
+    if (esp_partition_read(partition, base, &header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    if (header.magic == JOURNAL_SECTOR_MAGIC && header.sequence != SEQUENCE_ERASED &&
+        esp_rom_crc32_le(0, (const uint8_t*)&header, 8) == header.crc32) {
+        sequences[sector] = header.sequence;
+        return true;
+    }
+
+    // Blank through and through, or left half-erased or half-taken by a power cut
+    bool blank = true;
+    for (uint32_t offset = 0; offset < SECTOR_BYTES && blank; offset += RECORD_MAX) {
+        if (esp_partition_read(partition, base + offset, record, RECORD_MAX) != ESP_OK) {
+            return false;
+        }
+        for (uint16_t i = 0; i < RECORD_MAX && blank; i++) {
+            blank = record[i] == 0xFF;
+        }
+    }
+    return blank || esp_partition_erase_range(partition, base, SECTOR_BYTES) == ESP_OK;
+}
+
+/**
+ * @brief Apply a sector's committed records to the index, and leave its end as the head offset
+ */
+static void replay_sector(uint8_t sector) {
+    uint32_t base = sector * SECTOR_BYTES;
+    uint32_t offset = sizeof(journal_sector_header_t);
+    while (offset + sizeof(journal_record_header_t) <= SECTOR_BYTES) {
+        journal_record_header_t* header = (journal_record_header_t*)record;
+        if (esp_partition_read(partition, base + offset, header, sizeof(*header)) != ESP_OK) {
+            offset = SECTOR_BYTES;
+            break;
+        }
+        if (header->state == JOURNAL_STATE_ERASED && header->key_length == 0xFF) {
+            break;                  // Never written: the end of the log in this sector
+        }
+        uint32_t bytes = record_bytes(header->key_length, header->value_length);
+        if (header->key_length == 0 || header->key_length >= JOURNAL_KEY_BYTES ||
+            header->value_length > JOURNAL_VALUE_MAX || offset + bytes > SECTOR_BYTES) {
+            stats.torn++;
+            offset = SECTOR_BYTES;  // Its length cannot be trusted, nor anything after it
+            break;
+        }
+        uint32_t length = sizeof(*header) + header->key_length + header->value_length;
+        bool ok = esp_partition_read(partition, base + offset + sizeof(*header), record + sizeof(*header),
+                                     length - sizeof(*header)) == ESP_OK &&
+                  header->state == JOURNAL_STATE_COMMITTED && record_crc(record, length) == header->crc32;
+        if (ok) {
+            char key[JOURNAL_KEY_BYTES];
+            memcpy(key, record + sizeof(*header), header->key_length);
+            key[header->key_length] = '\0';
+            apply(key, header->flags, base + offset, header->generation, header->value_length);
+            next_generation = max(next_generation, header->generation + 1);
+            stats.replayed++;
+        } else {
+            stats.torn++;
+        }
+        offset += bytes;
+    }
+    head_offset = offset;
+}
+
+/**
+ * @brief Append and commit one record, taking a new sector first if the head is full
+ *
+ * The caller holds journal_lock.
+ */
+static bool write_record(const char* key, uint8_t flags, const void* value, uint16_t length, uint32_t generation) {
+    uint8_t key_length = (uint8_t)strlen(key);
+    uint32_t bytes = record_bytes(key_length, length);
+    for (uint8_t tries = 0; head_offset + bytes > SECTOR_BYTES; tries++) {
+        if (tries == sector_count || !take_sector()) {
+            return false;
+        }
+    }
+
+    memset(record, 0xFF, bytes);    // Padding stays erased
+    journal_record_header_t* header = (journal_record_header_t*)record;
+    header->state = JOURNAL_STATE_ERASED;
+    header->flags = flags;
+    header->key_length = key_length;
+    header->reserved = 0xFF;
+    header->value_length = length;
+    header->reserved2 = 0xFFFF;
+    header->generation = generation;
+    header->crc32 = 0;
+    memcpy(record + sizeof(*header), key, key_length);
+    if (length > 0) {
+        memcpy(record + sizeof(*header) + key_length, value, length);
+    }
+    header->crc32 = record_crc(record, sizeof(*header) + key_length + length);
+    header->state = JOURNAL_STATE_WRITTEN;
+
+    // The offset moves on even if a write fails: that space is no longer erased
+    uint32_t address = head * SECTOR_BYTES + head_offset;
+    head_offset += bytes;
+    uint8_t committed = JOURNAL_STATE_COMMITTED;
+    if (esp_partition_write(partition, address, record, bytes) != ESP_OK ||
+        esp_partition_write(partition, address, &committed, 1) != ESP_OK) {
+        return false;
+    }
+    apply(key, flags, address, generation, length);
+    next_generation = max(next_generation, generation + 1);
+    return true;
+}
+
+/**
+ * @brief Make an erased sector the head, reclaiming the oldest if no spare is left
+ */
+static bool take_sector(void) {
+    for (uint8_t i = 1; i <= sector_count; i++) {
+        uint8_t sector = (head + i) % sector_count;
+        if (sequences[sector] != SEQUENCE_ERASED) {
+            continue;
+        }
+        if (!activate(sector)) {
+            return false;
+        }
+        return free_sectors() > 0 || reclaim_oldest();
+    }
+    return false;
+}
+
+/**
+ * @brief Copy the oldest sector's current records to the head, then erase it
+ */
+static bool reclaim_oldest(void) {
+    int16_t oldest = -1;
+    for (uint8_t s = 0; s < sector_count; s++) {
+        if (s != head && sequences[s] != SEQUENCE_ERASED &&
+            (oldest < 0 || sequences[s] < sequences[oldest])) {
+            oldest = s;
+        }
+    }
+    if (oldest < 0) {
+        return false;
+    }
+
+    uint32_t base = oldest * SECTOR_BYTES;
+    for (uint8_t i = 0; i < JOURNAL_MAX_KEYS; i++) {
+        index_entry_t* entry = &entries[i];
+        if (!entry->used || entry->address < base || entry->address >= base + SECTOR_BYTES) {
+            continue;
+        }
+        // Its live records fitted one sector, so they fit the head taken just before
+        uint8_t value[JOURNAL_VALUE_MAX];
+        uint32_t offset = entry->address + sizeof(journal_record_header_t) + strlen(entry->key);
+        char key[JOURNAL_KEY_BYTES];
+        strlcpy(key, entry->key, sizeof(key));
+        if (esp_partition_read(partition, offset, value, entry->value_length) != ESP_OK ||
+            head_offset + record_bytes(strlen(key), entry->value_length) > SECTOR_BYTES ||
+            !write_record(key, 0, value, entry->value_length, entry->generation)) {
+            return false;
+        }
+    }
+    // Tombstones are not copied: no older sector is left to hold what they cover
+
+    if (esp_partition_erase_range(partition, base, SECTOR_BYTES) != ESP_OK) {
+        return false;
+    }
+    sequences[oldest] = SEQUENCE_ERASED;
+    stats.reclaimed++;
+    return true;
+}
+
+/**
+ * @brief Write an erased sector's header with the next sequence
+ */
+static bool activate(uint8_t sector) {
+    journal_sector_header_t header;
+    header.magic = JOURNAL_SECTOR_MAGIC;
+    header.sequence = next_sequence;
+    header.crc32 = esp_rom_crc32_le(0, (const uint8_t*)&header, 8);
+    header.reserved = 0xFFFFFFFF;
+    if (esp_partition_write(partition, sector * SECTOR_BYTES, &header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    sequences[sector] = next_sequence++;
+    head = sector;
+    head_offset = sizeof(header);
+    return true;
+}
+
+static index_entry_t* find_entry(const char* key) {
+    for (uint8_t i = 0; i < JOURNAL_MAX_KEYS; i++) {
+        if (entries[i].used && strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Point a key at its newest record, or drop it for a tombstone
+ */
+static void apply(const char* key, uint8_t flags, uint32_t address, uint32_t generation, uint16_t length) {
+    index_entry_t* entry = find_entry(key);
+    if (entry != NULL && generation < entry->generation) {
+        return;
+    }
+    if (flags & JOURNAL_FLAG_ERASE) {
+        if (entry != NULL) {
+            entry->used = false;
+            stats.keys--;
+        }
+        return;
+    }
+    if (entry == NULL) {
+        for (uint8_t i = 0; i < JOURNAL_MAX_KEYS && entry == NULL; i++) {
+            if (!entries[i].used) {
+                entry = &entries[i];
+            }
+        }
+        if (entry == NULL) {
+            LOGW(SYSTEM, "⚠️  Journal key %s over the %d indexed - ignored", key, JOURNAL_MAX_KEYS);
+            return;
+        }
+        strlcpy(entry->key, key, sizeof(entry->key));
+        entry->used = true;
+        stats.keys++;
+    }
+    entry->address = address;
+    entry->generation = generation;
+    entry->value_length = length;
+}
+
+static uint32_t record_bytes(uint8_t key_length, uint16_t value_length) {
+    uint32_t bytes = sizeof(journal_record_header_t) + key_length + value_length;
+    return (bytes + JOURNAL_UNIT - 1) / JOURNAL_UNIT * JOURNAL_UNIT;
+}
+
+/**
+ * @brief CRC of a record as written, with the state erased and the CRC field zero
+ */
+static uint32_t record_crc(const uint8_t* bytes, uint32_t length) {
+    journal_record_header_t header;
+    memcpy(&header, bytes, sizeof(header));
+    header.state = JOURNAL_STATE_ERASED;
+    header.crc32 = 0;
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)&header, sizeof(header));
+    return esp_rom_crc32_le(crc, bytes + sizeof(header), length - sizeof(header));
+}
+
+static uint8_t free_sectors(void) {
+    uint8_t count = 0;
+    for (uint8_t s = 0; s < sector_count; s++) {
+        if (sequences[s] == SEQUENCE_ERASED) {
+            count++;
+        }
+    }
+    return count;
+}
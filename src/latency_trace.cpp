@@ -0,0 +1,194 @@
+/**
+ * @file latency_trace.cpp
+ * @brief Per-stage latency of traces from the air to the display
+ *
+ * Traces in flight live in LATENCY_TRACE_SLOTS slots picked by the low
+ * bits of the id, so a mark is an index and a compare rather than a
+ * search; a mark carrying an id its slot no longer holds is dropped. Ids
+ * come from a 16-bit counter that skips 0, the "no trace" every carrier
+ * starts with. Each stage keeps one count per octave of milliseconds, a
+ * sum and a maximum, which is all a histogram export needs.
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "latency_trace.h"
+
+/**
+ * @brief A trace in flight
+ */
+typedef struct {
+    uint16_t id;                    // 0 when free or ended
+    int64_t  start_us;              // Heard on air
+    int64_t  last_us;               // Previous mark
+} trace_slot_t;
+
+/**
+ * @brief A stage's counts; cumulated on the way out
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t octaves[LATENCY_TRACE_OCTAVES + 1];    // The last one is above every edge
+} stage_bins_t;
+
+static const char* const stage_names[LATENCY_STAGE_COUNT] = {
+    "observe", "features", "inference", "commit", "ui", "flush", "total"
+};
+
+static trace_slot_t slots[LATENCY_TRACE_SLOTS];
+static stage_bins_t bins[LATENCY_STAGE_COUNT];
+static uint16_t next_id = 0;
+static uint32_t started = 0;
+static uint32_t completed = 0;
+static uint32_t held = 0;
+static uint32_t coalesced = 0;
+static uint32_t lost = 0;
+static portMUX_TYPE trace_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void add_sample(latency_stage_t stage, uint32_t us);
+static uint32_t quantile_ms(const stage_bins_t* stage, uint32_t percent);
+
+/**
+ * @brief Open a trace for a device heard at seen_ms and mark its observe stage (scan task)
+ */
+uint16_t latency_trace_begin(uint32_t seen_ms) {
+    if (!LATENCY_TRACE_ENABLED) {
+        return 0;
+    }
+    int64_t now_us = esp_timer_get_time();
+    uint32_t observe_us = (millis() - seen_ms) * 1000;
+
+    portENTER_CRITICAL(&trace_mux);
+    if (++next_id == 0) {
+        next_id = 1;
+    }
+    trace_slot_t* slot = &slots[next_id % LATENCY_TRACE_SLOTS];
+    if (slot->id != 0) {
+        lost++;
+    }
+    slot->id = next_id;
+    slot->start_us = now_us - observe_us;
+    slot->last_us = now_us;
+    started++;
+    add_sample(LATENCY_STAGE_OBSERVE, observe_us);
+    uint16_t id = next_id;
+    portEXIT_CRITICAL(&trace_mux);
+    return id;
+}
+
+/**
+ * @brief Mark the end of a stage; any task. Does nothing for trace 0 or one already ended.
+ */
+void latency_trace_mark(uint16_t trace, latency_stage_t stage) {
+    if (trace == 0 || stage >= LATENCY_STAGE_TOTAL) {
+        return;
+    }
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&trace_mux);
+    trace_slot_t* slot = &slots[trace % LATENCY_TRACE_SLOTS];
+    if (slot->id == trace) {
+        add_sample(stage, (uint32_t)(now_us - slot->last_us));
+        slot->last_us = now_us;
+        if (stage == LATENCY_STAGE_FLUSH) {
+            add_sample(LATENCY_STAGE_TOTAL, (uint32_t)(now_us - slot->start_us));
+            slot->id = 0;
+            completed++;
+        }
+    }
+    portEXIT_CRITICAL(&trace_mux);
+}
+
+/**
+ * @brief End a trace short of the display; any task
+ */
+void latency_trace_end(uint16_t trace, latency_end_t reason) {
+    if (trace == 0) {
+        return;
+    }
+    portENTER_CRITICAL(&trace_mux);
+    trace_slot_t* slot = &slots[trace % LATENCY_TRACE_SLOTS];
+    if (slot->id == trace) {
+        slot->id = 0;
+        if (reason == LATENCY_END_HELD) {
+            held++;
+        } else {
+            coalesced++;
+        }
+    }
+    portEXIT_CRITICAL(&trace_mux);
+}
+
+/**
+ * @brief Copy the figures
+ */
+void latency_trace_get(latency_trace_stats_t* out) {
+    memset(out, 0, sizeof(*out));
+
+    // A hundred additions; not worth a copy of the bins to do them outside
+    portENTER_CRITICAL(&trace_mux);
+    for (uint8_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        const stage_bins_t* stage = &bins[i];
+        latency_stage_stats_t* stats = &out->stages[i];
+        stats->count = stage->count;
+        stats->max_us = stage->max_us;
+        stats->sum_us = stage->sum_us;
+        stats->avg_us = stage->count > 0 ? (uint32_t)(stage->sum_us / stage->count) : 0;
+        stats->p50_ms = quantile_ms(stage, 50);
+        stats->p99_ms = quantile_ms(stage, 99);
+        uint32_t seen = 0;
+        for (uint8_t octave = 0; octave < LATENCY_TRACE_OCTAVES; octave++) {
+            seen += stage->octaves[octave];
+            stats->cumulative[octave] = seen;
+        }
+    }
+    out->started = started;
+    out->completed = completed;
+    out->held = held;
+    out->coalesced = coalesced;
+    out->lost = lost;
+    portEXIT_CRITICAL(&trace_mux);
+}
+
+/**
+ * @brief Short name for logs and metrics ("observe", "features", ...)
+ */
+const char* latency_stage_name(latency_stage_t stage) {
+    return stage < LATENCY_STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+/**
+ * @brief Count one latency in its stage; caller holds trace_mux
+ */
+static void add_sample(latency_stage_t stage, uint32_t us) {
+    stage_bins_t* bin = &bins[stage];
+    uint32_t ms = us / 1000;
+    // Octave n holds [2^(n-1), 2^n) ms; octave 0 everything under a millisecond
+    uint8_t octave = ms == 0 ? 0 : (uint8_t)min(32 - __builtin_clz(ms), LATENCY_TRACE_OCTAVES);
+    bin->octaves[octave]++;
+    bin->count++;
+    bin->sum_us += us;
+    bin->max_us = max(bin->max_us, us);
+}
+
+/**
+ * @brief Upper edge of the octave holding a quantile; the maximum above the last edge
+ */
+static uint32_t quantile_ms(const stage_bins_t* stage, uint32_t percent) {
+    if (stage->count == 0) {
+        return 0;
+    }
+    uint32_t rank = (uint32_t)(((uint64_t)stage->count * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (uint8_t octave = 0; octave < LATENCY_TRACE_OCTAVES; octave++) {
+        seen += stage->octaves[octave];
+        if (seen >= rank) {
+            return 1UL << octave;
+        }
+    }
+    return stage->max_us / 1000;
+}
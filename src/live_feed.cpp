@@ -0,0 +1,64 @@
+/**
+ * @file live_feed.cpp
+ * @brief Ring of preformatted event lines for the on-screen ticker
+ *
+ * Fixed size, allocated with the image: LIVE_FEED_ENTRIES lines of
+ * LIVE_FEED_TEXT_BYTES, each led by the uptime. A line is formatted on
+ * the stack and copied into its slot under the lock, so a reader never
+ * sees half a line and never holds the lock for more than one copy.
+ */
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include "config.h"
+#include "live_feed.h"
+
+static live_feed_entry_t ring[LIVE_FEED_ENTRIES];
+static volatile uint32_t newest = 0;
+static portMUX_TYPE ring_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Format a line into the ring, overwriting the oldest
+ */
+void live_feed_post(live_feed_kind_t kind, uint32_t now_ms, const char* format, ...) {
+    live_feed_entry_t entry;
+    entry.timestamp_ms = now_ms;
+    entry.kind = kind;
+    // Uptime as minutes:seconds, then the event
+    uint32_t seconds = now_ms / 1000;
+    int prefix = snprintf(entry.text, sizeof(entry.text), "%3lu:%02lu ", seconds / 60, seconds % 60);
+    prefix = constrain(prefix, 0, (int)sizeof(entry.text) - 1);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(entry.text + prefix, sizeof(entry.text) - prefix, format, args);
+    va_end(args);
+
+    // Numbered under the lock, so two writers never take the same slot
+    portENTER_CRITICAL(&ring_mux);
+    entry.sequence = newest + 1;
+    ring[entry.sequence % LIVE_FEED_ENTRIES] = entry;
+    newest = entry.sequence;
+    portEXIT_CRITICAL(&ring_mux);
+}
+
+/**
+ * @brief Sequence of the newest line
+ */
+uint32_t live_feed_sequence(void) {
+    return newest;
+}
+
+/**
+ * @brief Copy a line by sequence
+ */
+bool live_feed_read(uint32_t sequence, live_feed_entry_t* entry) {
+    bool found = false;
+    portENTER_CRITICAL(&ring_mux);
+    const live_feed_entry_t* slot = &ring[sequence % LIVE_FEED_ENTRIES];
+    if (sequence != 0 && slot->sequence == sequence) {
+        *entry = *slot;
+        found = true;
+    }
+    portEXIT_CRITICAL(&ring_mux);
+    return found;
+}
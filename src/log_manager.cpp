@@ -0,0 +1,734 @@
+/**
+ * @file log_manager.cpp
+ * @brief Segment numbering, compaction, retention and the time index of /logs
+ *
+ * The trace, history, archive and capture writers still write their own
+ * files; the manager numbers them, is told what they wrote, and does
+ * everything else on a job worker once every LOG_MANAGER_INTERVAL_MS. A
+ * pass appends the index entries noted since the last one, turns the
+ * oldest raw trace beyond the newest LOG_RAW_SEGMENTS_KEPT into
+ * per-minute rollups, and deletes the oldest segments, by the index's
+ * timestamps, while the card is short of free space. Whenever a segment
+ * went away the index is rewritten without its entries, so it stays a
+ * few kilobytes and a lookup reads it alone.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <Preferences.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "job_pool.h"
+#include "trace_log.h"
+#include "log_manager.h"
+#include "logger.h"
+
+#define NO_SEGMENT   -1
+#define AGE_UNKNOWN  0              // Segments without index entries are expired first
+
+typedef struct {
+    const char* prefix;
+    const char* suffix;
+} kind_name_t;
+
+typedef struct {
+    uint8_t  kind;
+    uint16_t segment;
+    bool     deleted;
+    uint64_t age;                   // boot << 32 | first_ms of its oldest entry
+} candidate_t;
+
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+} accumulator_t;
+
+// In log_segment_kind_t order; kinds with one prefix share their numbers
+static const kind_name_t kind_names[LOG_SEGMENT_KIND_COUNT] = {
+    { "trace_",   ".htr" },
+    { "trace_",   ".hmr" },
+    { "metrics_", ".hmh" },
+    { "archive_", ".hca" },
+    { "capture_", ".pcap" }
+};
+
+static uint32_t boot = 0;
+static int32_t active[LOG_SEGMENT_KIND_COUNT] = { NO_SEGMENT, NO_SEGMENT, NO_SEGMENT, NO_SEGMENT, NO_SEGMENT };
+static log_index_entry_t open_entries[LOG_SEGMENT_KIND_COUNT];
+static bool open_valid[LOG_SEGMENT_KIND_COUNT] = { false };
+static log_index_entry_t pending[LOG_INDEX_PENDING];
+static uint8_t pending_count = 0;
+static volatile bool pass_queued = false;
+static uint32_t last_pass_ms = 0;
+static log_manager_stats_t stats = {0};
+static portMUX_TYPE manager_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Working storage of the one pass that runs at a time
+static candidate_t candidates[LOG_MANAGER_MAX_SEGMENTS];
+static uint8_t candidate_count = 0;
+static trace_record_t trace_batch[LOG_COMPACT_BATCH];
+static log_rollup_t rollup_batch[LOG_COMPACT_BATCH];
+static log_index_entry_t index_batch[LOG_INDEX_PENDING];
+
+// Forward declarations
+static void pass_job(void* payload);
+static void stage(log_segment_kind_t kind, const log_index_entry_t* entry);
+static void close_open_entry(log_segment_kind_t kind);
+static bool append_pending(void);
+static void list_segments(void);
+static bool parse_name(const char* name, uint8_t* kind, uint16_t* segment);
+static bool compact_oldest_trace(void);
+static bool compact(uint16_t segment);
+static bool flush_rollups(File& out, uint8_t count, uint32_t* offset, uint32_t source_boot, uint16_t segment);
+static void rollup_add(accumulator_t* fields, const sensor_data_t* data, bool first);
+static bool enforce_retention(void);
+static uint8_t free_pct(void);
+static void date_candidates(void);
+static bool rewrite_index(void);
+static bool segment_alive(uint8_t kind, uint16_t segment);
+
+/**
+ * @brief Count this boot in NVS; segments written from here on carry its number
+ */
+bool log_manager_init(void) {
+    Preferences prefs;
+    if (!prefs.begin(LOG_NVS_NAMESPACE, false)) {
+        return false;
+    }
+    boot = prefs.getUInt("boot", 0) + 1;
+    prefs.putUInt("boot", boot);
+    prefs.end();
+    stats.boot = boot;
+    LOGI(SYSTEM, "✅ Log manager: boot %lu", boot);
+    return true;
+}
+
+/**
+ * @brief This boot's number, 0 before log_manager_init()
+ */
+uint32_t log_manager_boot(void) {
+    return boot;
+}
+
+/**
+ * @brief Number the next file of a kind should take: one past the newest on the card
+ */
+uint16_t log_manager_next_segment(log_segment_kind_t kind) {
+    int32_t newest = NO_SEGMENT;
+    File dir = SD.open(TRACE_LOG_DIR);
+    if (dir && dir.isDirectory()) {
+        for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+            uint8_t found;
+            uint16_t segment;
+            if (parse_name(file.name(), &found, &segment) &&
+                strcmp(kind_names[found].prefix, kind_names[kind].prefix) == 0) {
+                newest = max(newest, (int32_t)segment);
+            }
+            file.close();
+        }
+    }
+    if (dir) {
+        dir.close();
+    }
+    return (uint16_t)(newest + 1);
+}
+
+/**
+ * @brief A writer opened a segment; the manager leaves it alone until the next one
+ */
+void log_manager_opened(log_segment_kind_t kind, uint16_t segment) {
+    portENTER_CRITICAL(&manager_mux);
+    active[kind] = segment;
+    portEXIT_CRITICAL(&manager_mux);
+}
+
+/**
+ * @brief A writer appended records from first_ms to last_ms at offset; never blocks
+ */
+void log_manager_note(log_segment_kind_t kind, uint16_t segment, uint32_t offset,
+                      uint32_t first_ms, uint32_t last_ms) {
+    log_index_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.boot = boot;
+    entry.first_ms = first_ms;
+    entry.last_ms = last_ms;
+    entry.offset = offset;
+    entry.segment = segment;
+    entry.kind = kind;
+    stage(kind, &entry);
+}
+
+/**
+ * @brief Start a housekeeping pass on a job worker every LOG_MANAGER_INTERVAL_MS
+ */
+void log_manager_tick(uint32_t now_ms) {
+    if (pass_queued || now_ms - last_pass_ms < LOG_MANAGER_INTERVAL_MS) {
+        return;
+    }
+    last_pass_ms = now_ms;
+    pass_queued = true;
+    if (!job_pool_submit(JOB_LANE_LOW, pass_job, NULL, 0)) {
+        pass_queued = false;        // Retried on the next interval
+    }
+}
+
+/**
+ * @brief Look up where a boot's data at time_ms lives, reading only the index
+ */
+bool log_manager_find(log_segment_kind_t kind, uint32_t query_boot, uint32_t time_ms, log_location_t* out) {
+    if (!sd_monitor_mounted() || !spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER)) {
+        return false;
+    }
+    File index = SD.open(LOG_INDEX_FILE, "r");
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!index) {
+        return false;
+    }
+
+    // The entry covering time_ms, else the earliest one after it
+    log_index_entry_t best;
+    bool found = false;
+    bool covered = false;
+    log_index_entry_t entries[16];
+    while (!covered) {
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        size_t count = index.read((uint8_t*)entries, sizeof(entries)) / sizeof(entries[0]);
+        spi_bus_release(SPI_DEVICE_SD);
+        if (count == 0) {
+            break;
+        }
+        for (size_t i = 0; i < count && !covered; i++) {
+            const log_index_entry_t* entry = &entries[i];
+            if (entry->kind != kind || entry->boot != query_boot || entry->last_ms < time_ms) {
+                continue;
+            }
+            covered = entry->first_ms <= time_ms;
+            if (covered || !found || entry->first_ms < best.first_ms) {
+                best = *entry;
+                found = true;
+            }
+        }
+    }
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    index.close();
+    spi_bus_release(SPI_DEVICE_SD);
+
+    if (found) {
+        out->kind = kind;
+        out->segment = best.segment;
+        out->offset = best.offset;
+        out->first_ms = best.first_ms;
+        out->last_ms = best.last_ms;
+        log_manager_segment_path(kind, best.segment, out->path, sizeof(out->path));
+    }
+    return found;
+}
+
+/**
+ * @brief Path of a segment, e.g. "/logs/trace_0012.htr"
+ */
+void log_manager_segment_path(log_segment_kind_t kind, uint16_t segment, char* out, size_t size) {
+    snprintf(out, size, "%s/%s%04u%s", TRACE_LOG_DIR, kind_names[kind].prefix, segment,
+             kind_names[kind].suffix);
+}
+
+/**
+ * @brief Copy the manager's figures
+ */
+void log_manager_get_stats(log_manager_stats_t* out) {
+    portENTER_CRITICAL(&manager_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&manager_mux);
+}
+
+/**
+ * @brief One housekeeping pass, on a job worker
+ */
+static void pass_job(void* payload) {
+    if (sd_monitor_mounted()) {
+        append_pending();
+
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        list_segments();
+        spi_bus_release(SPI_DEVICE_SD);
+
+        bool compacted = compact_oldest_trace();
+        bool expired = enforce_retention();
+        if (compacted || expired) {
+            append_pending();       // The rollup's entries, before the old ones are filtered
+            rewrite_index();
+        }
+
+        uint8_t free_now = free_pct();
+        portENTER_CRITICAL(&manager_mux);
+        stats.passes++;
+        stats.free_pct = free_now;
+        portEXIT_CRITICAL(&manager_mux);
+    }
+    pass_queued = false;
+}
+
+/**
+ * @brief Merge an entry into its kind's open entry, or queue the open one
+ */
+static void stage(log_segment_kind_t kind, const log_index_entry_t* entry) {
+    portENTER_CRITICAL(&manager_mux);
+    log_index_entry_t* open = &open_entries[kind];
+    if (open_valid[kind] && open->segment == entry->segment && open->boot == entry->boot &&
+        entry->last_ms - open->first_ms < LOG_INDEX_STRIDE_MS) {
+        open->first_ms = min(open->first_ms, entry->first_ms);
+        open->last_ms = max(open->last_ms, entry->last_ms);
+    } else {
+        if (open_valid[kind]) {
+            if (pending_count < LOG_INDEX_PENDING) {
+                pending[pending_count++] = *open;
+            } else {
+                stats.index_dropped++;
+            }
+        }
+        *open = *entry;
+        open_valid[kind] = true;
+    }
+    portEXIT_CRITICAL(&manager_mux);
+}
+
+/**
+ * @brief Queue a kind's open entry without waiting for the next one
+ */
+static void close_open_entry(log_segment_kind_t kind) {
+    portENTER_CRITICAL(&manager_mux);
+    if (open_valid[kind]) {
+        if (pending_count < LOG_INDEX_PENDING) {
+            pending[pending_count++] = open_entries[kind];
+        } else {
+            stats.index_dropped++;
+        }
+        open_valid[kind] = false;
+    }
+    portEXIT_CRITICAL(&manager_mux);
+}
+
+/**
+ * @brief Append the queued entries to the index file
+ */
+static bool append_pending(void) {
+    portENTER_CRITICAL(&manager_mux);
+    uint8_t count = pending_count;
+    memcpy(index_batch, pending, count * sizeof(pending[0]));
+    pending_count = 0;
+    portEXIT_CRITICAL(&manager_mux);
+    if (count == 0) {
+        return true;
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File index = SD.open(LOG_INDEX_FILE, "a");
+    size_t bytes = count * sizeof(index_batch[0]);
+    bool ok = index && index.write((const uint8_t*)index_batch, bytes) == bytes;
+    if (index) {
+        index.close();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+
+    portENTER_CRITICAL(&manager_mux);
+    if (ok) {
+        stats.index_entries += count;
+    } else {
+        stats.index_dropped += count;
+    }
+    portEXIT_CRITICAL(&manager_mux);
+    return ok;
+}
+
+/**
+ * @brief Collect every numbered segment in TRACE_LOG_DIR
+ *
+ * The caller holds the SD card's bus.
+ */
+static void list_segments(void) {
+    candidate_count = 0;
+    File dir = SD.open(TRACE_LOG_DIR);
+    if (!dir || !dir.isDirectory()) {
+        return;
+    }
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+        candidate_t* candidate = &candidates[candidate_count];
+        if (candidate_count < LOG_MANAGER_MAX_SEGMENTS &&
+            parse_name(file.name(), &candidate->kind, &candidate->segment)) {
+            candidate->deleted = false;
+            candidate->age = AGE_UNKNOWN;
+            candidate_count++;
+        }
+        file.close();
+    }
+    dir.close();
+}
+
+/**
+ * @brief Kind and number of a segment file name, with or without its directory
+ */
+static bool parse_name(const char* name, uint8_t* kind, uint16_t* segment) {
+    const char* slash = strrchr(name, '/');
+    const char* base = slash != NULL ? slash + 1 : name;
+    for (uint8_t k = 0; k < LOG_SEGMENT_KIND_COUNT; k++) {
+        size_t prefix = strlen(kind_names[k].prefix);
+        unsigned number;
+        char suffix[8];
+        if (strncmp(base, kind_names[k].prefix, prefix) == 0 &&
+            sscanf(base + prefix, "%4u%7s", &number, suffix) == 2 &&
+            strcmp(suffix, kind_names[k].suffix) == 0) {
+            *kind = k;
+            *segment = (uint16_t)number;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Compact the lowest-numbered raw trace beyond the newest LOG_RAW_SEGMENTS_KEPT
+ *
+ * One per pass, so a pass never holds a worker for long.
+ */
+static bool compact_oldest_trace(void) {
+    uint8_t raw = 0;
+    int32_t oldest = NO_SEGMENT;
+    uint8_t oldest_index = 0;
+    for (uint8_t i = 0; i < candidate_count; i++) {
+        if (candidates[i].kind == LOG_SEGMENT_TRACE && candidates[i].segment != active[LOG_SEGMENT_TRACE]) {
+            raw++;
+            if (oldest == NO_SEGMENT || candidates[i].segment < oldest) {
+                oldest = candidates[i].segment;
+                oldest_index = i;
+            }
+        }
+    }
+    if (raw < LOG_RAW_SEGMENTS_KEPT || oldest == NO_SEGMENT) {  // The active one makes the kept count
+        return false;
+    }
+    bool ok = compact((uint16_t)oldest);
+    candidates[oldest_index].deleted = true;
+    if (ok && candidate_count < LOG_MANAGER_MAX_SEGMENTS) {
+        candidate_t* rollup = &candidates[candidate_count++];
+        rollup->kind = LOG_SEGMENT_ROLLUP;
+        rollup->segment = (uint16_t)oldest;
+        rollup->deleted = false;
+        rollup->age = AGE_UNKNOWN;
+    }
+    return true;
+}
+
+/**
+ * @brief Roll one trace up into minutes and delete it
+ *
+ * A trace that cannot be read as one is deleted as well; it could not be
+ * replayed either.
+ */
+static bool compact(uint16_t segment) {
+    char source[40];
+    char target[40];
+    log_manager_segment_path(LOG_SEGMENT_TRACE, segment, source, sizeof(source));
+    log_manager_segment_path(LOG_SEGMENT_ROLLUP, segment, target, sizeof(target));
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File in = SD.open(source, "r");
+    trace_file_header_t header;
+    bool valid = in && in.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                 header.magic == TRACE_FILE_MAGIC && header.format == TRACE_FILE_FORMAT &&
+                 header.record_bytes == sizeof(trace_record_t);
+    File out;
+    if (valid) {
+        out = SD.open(target, "w");
+    }
+    bool ok = valid && out;
+    if (ok) {
+        log_rollup_header_t rollup_header;
+        memset(&rollup_header, 0, sizeof(rollup_header));
+        rollup_header.magic = LOG_ROLLUP_MAGIC;
+        rollup_header.format = LOG_ROLLUP_FORMAT;
+        rollup_header.record_bytes = sizeof(log_rollup_t);
+        rollup_header.boot = header.boot;
+        rollup_header.source_records = (in.size() - sizeof(header)) / sizeof(trace_record_t);
+        ok = out.write((const uint8_t*)&rollup_header, sizeof(rollup_header)) == sizeof(rollup_header);
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+
+    uint32_t offset = sizeof(log_rollup_header_t);
+    uint8_t rollups = 0;
+    accumulator_t fields[LOG_ROLLUP_FIELD_COUNT];
+    log_rollup_t* current = NULL;
+    while (ok) {
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        size_t count = in.read((uint8_t*)trace_batch, sizeof(trace_batch)) / sizeof(trace_record_t);
+        spi_bus_release(SPI_DEVICE_SD);
+        if (count == 0) {
+            break;
+        }
+        for (size_t i = 0; i < count && ok; i++) {
+            const trace_record_t* record = &trace_batch[i];
+            if (current != NULL && record->timestamp_ms - current->first_ms >= 60000) {
+                current = NULL;
+                if (++rollups == LOG_COMPACT_BATCH) {
+                    ok = flush_rollups(out, rollups, &offset, header.boot, segment);
+                    rollups = 0;
+                }
+            }
+            bool first = current == NULL;
+            if (first) {
+                current = &rollup_batch[rollups];
+                memset(current, 0, sizeof(*current));
+                current->first_ms = record->timestamp_ms;
+            }
+            current->last_ms = record->timestamp_ms;
+            current->cycles++;
+            rollup_add(fields, &record->data, first);
+            for (uint8_t f = 0; f < LOG_ROLLUP_FIELD_COUNT; f++) {
+                current->values[f].min = fields[f].min;
+                current->values[f].max = fields[f].max;
+                current->values[f].avg = (int32_t)(fields[f].sum / current->cycles);
+            }
+        }
+    }
+    if (ok && current != NULL) {
+        rollups++;
+    }
+    if (ok && rollups > 0) {
+        ok = flush_rollups(out, rollups, &offset, header.boot, segment);
+    }
+    close_open_entry(LOG_SEGMENT_ROLLUP);
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (out) {
+        out.close();
+    }
+    if (in) {
+        in.close();
+    }
+    if (ok || !valid) {
+        SD.remove(source);
+    } else {
+        SD.remove(target);           // Write failed: the trace stays for the next pass
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+
+    if (ok) {
+        portENTER_CRITICAL(&manager_mux);
+        stats.compacted++;
+        portEXIT_CRITICAL(&manager_mux);
+        LOGI(SYSTEM, "🗜️  %s rolled up into %s", source, target);
+    } else if (!valid) {
+        LOGW(SYSTEM, "⚠️  %s unreadable - deleted", source);
+    } else {
+        LOGW(SYSTEM, "⚠️  Rollup of %s failed", source);
+    }
+    return ok;
+}
+
+/**
+ * @brief Write the finished minutes and index them
+ */
+static bool flush_rollups(File& out, uint8_t count, uint32_t* offset, uint32_t source_boot, uint16_t segment) {
+    size_t bytes = count * sizeof(log_rollup_t);
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    bool ok = out.write((const uint8_t*)rollup_batch, bytes) == bytes;
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!ok) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        log_index_entry_t entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.boot = source_boot;
+        entry.first_ms = rollup_batch[i].first_ms;
+        entry.last_ms = rollup_batch[i].last_ms;
+        entry.offset = *offset + i * sizeof(log_rollup_t);
+        entry.segment = segment;
+        entry.kind = LOG_SEGMENT_ROLLUP;
+        stage(LOG_SEGMENT_ROLLUP, &entry);
+    }
+    *offset += bytes;
+
+    // A trace holds hours of minutes; empty the queue before the next batch could overflow it
+    portENTER_CRITICAL(&manager_mux);
+    bool nearly_full = pending_count > LOG_INDEX_PENDING - LOG_COMPACT_BATCH - 1;
+    portEXIT_CRITICAL(&manager_mux);
+    return nearly_full ? append_pending() : true;
+}
+
+/**
+ * @brief Fold one trace record into the minute's accumulators
+ */
+static void rollup_add(accumulator_t* fields, const sensor_data_t* data, bool first) {
+    const int32_t values[LOG_ROLLUP_FIELD_COUNT] = {
+        data->wifi_networks_count, data->wifi_signal_strength,
+        data->ble_devices_count, data->ble_signal_strength,
+        data->wifi_clients_count, data->probe_requests,
+        data->capture_frames_per_second, data->novel_devices
+    };
+    for (uint8_t f = 0; f < LOG_ROLLUP_FIELD_COUNT; f++) {
+        if (first) {
+            fields[f].min = fields[f].max = values[f];
+            fields[f].sum = 0;
+        }
+        fields[f].min = min(fields[f].min, values[f]);
+        fields[f].max = max(fields[f].max, values[f]);
+        fields[f].sum += values[f];
+    }
+}
+
+/**
+ * @brief Delete the oldest segments, never an open one, until LOG_MIN_FREE_PCT is free
+ */
+static bool enforce_retention(void) {
+    if (free_pct() >= LOG_MIN_FREE_PCT) {
+        return false;
+    }
+    date_candidates();
+
+    bool deleted = false;
+    while (free_pct() < LOG_MIN_FREE_PCT) {
+        candidate_t* oldest = NULL;
+        for (uint8_t i = 0; i < candidate_count; i++) {
+            candidate_t* candidate = &candidates[i];
+            if (candidate->deleted || candidate->segment == active[candidate->kind]) {
+                continue;
+            }
+            if (oldest == NULL || candidate->age < oldest->age ||
+                (candidate->age == oldest->age && candidate->segment < oldest->segment)) {
+                oldest = candidate;
+            }
+        }
+        if (oldest == NULL) {
+            LOGW(SYSTEM, "⚠️  Card below %d%% free with nothing left to expire", LOG_MIN_FREE_PCT);
+            break;
+        }
+
+        char path[40];
+        log_manager_segment_path((log_segment_kind_t)oldest->kind, oldest->segment, path, sizeof(path));
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        SD.remove(path);
+        spi_bus_release(SPI_DEVICE_SD);
+        oldest->deleted = true;
+        deleted = true;
+        portENTER_CRITICAL(&manager_mux);
+        stats.deleted++;
+        portEXIT_CRITICAL(&manager_mux);
+        LOGI(SYSTEM, "🧹 %s expired for free space", path);
+    }
+    return deleted;
+}
+
+/**
+ * @brief Card space free, in percent
+ */
+static uint8_t free_pct(void) {
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    uint64_t total = SD.totalBytes();
+    uint64_t used = SD.usedBytes();
+    spi_bus_release(SPI_DEVICE_SD);
+    return total > 0 && used < total ? (uint8_t)((total - used) * 100 / total) : 0;
+}
+
+/**
+ * @brief Give every candidate the age of its oldest index entry
+ */
+static void date_candidates(void) {
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File index = SD.open(LOG_INDEX_FILE, "r");
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!index) {
+        return;
+    }
+    while (true) {
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        size_t count = index.read((uint8_t*)index_batch, sizeof(index_batch)) / sizeof(index_batch[0]);
+        spi_bus_release(SPI_DEVICE_SD);
+        if (count == 0) {
+            break;
+        }
+        for (size_t e = 0; e < count; e++) {
+            uint64_t age = ((uint64_t)index_batch[e].boot << 32) | index_batch[e].first_ms;
+            for (uint8_t i = 0; i < candidate_count; i++) {
+                candidate_t* candidate = &candidates[i];
+                if (candidate->kind == index_batch[e].kind && candidate->segment == index_batch[e].segment &&
+                    (candidate->age == AGE_UNKNOWN || age < candidate->age)) {
+                    candidate->age = age;
+                }
+            }
+        }
+    }
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    index.close();
+    spi_bus_release(SPI_DEVICE_SD);
+}
+
+/**
+ * @brief Copy the index without the entries of segments that are gone
+ */
+static bool rewrite_index(void) {
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File index = SD.open(LOG_INDEX_FILE, "r");
+    File copy = SD.open(LOG_INDEX_TEMP_FILE, "w");
+    spi_bus_release(SPI_DEVICE_SD);
+
+    bool ok = index && copy;
+    uint32_t kept = 0;
+    uint32_t dropped = 0;
+    while (ok) {
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        size_t count = index.read((uint8_t*)index_batch, sizeof(index_batch)) / sizeof(index_batch[0]);
+        spi_bus_release(SPI_DEVICE_SD);
+        if (count == 0) {
+            break;
+        }
+        size_t alive = 0;
+        for (size_t e = 0; e < count; e++) {
+            if (segment_alive(index_batch[e].kind, index_batch[e].segment)) {
+                index_batch[alive++] = index_batch[e];
+            }
+        }
+        dropped += count - alive;
+        kept += alive;
+        size_t bytes = alive * sizeof(index_batch[0]);
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        ok = copy.write((const uint8_t*)index_batch, bytes) == bytes;
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (index) {
+        index.close();
+    }
+    if (copy) {
+        copy.close();
+    }
+    if (ok) {
+        SD.remove(LOG_INDEX_FILE);
+        ok = SD.rename(LOG_INDEX_TEMP_FILE, LOG_INDEX_FILE);
+    } else {
+        SD.remove(LOG_INDEX_TEMP_FILE);
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    if (ok) {
+        LOGI(SYSTEM, "📇 Log index rewritten: %lu entries kept, %lu dropped", kept, dropped);
+    }
+    return ok;
+}
+
+/**
+ * @brief Whether a segment is still on the card, as far as this pass knows
+ */
+static bool segment_alive(uint8_t kind, uint16_t segment) {
+    if (kind < LOG_SEGMENT_KIND_COUNT && active[kind] == segment) {
+        return true;
+    }
+    for (uint8_t i = 0; i < candidate_count; i++) {
+        if (candidates[i].kind == kind && candidates[i].segment == segment) {
+            return !candidates[i].deleted;
+        }
+    }
+    // Beyond LOG_MANAGER_MAX_SEGMENTS the listing is incomplete; keep what it missed
+    return candidate_count == LOG_MANAGER_MAX_SEGMENTS;
+}
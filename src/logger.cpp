@@ -0,0 +1,634 @@
+/**
+ * @file logger.cpp
+ * @brief Deferred-format log lines through a lock-free ring to a writer task
+ *
+ * A caller only copies the format pointer and the raw arguments into a
+ * ring slot, walked with the format string so each one is taken with its
+ * own type; strings are copied because the caller's buffer will not
+ * outlive the call. Slots are claimed and published with per-slot
+ * sequence numbers, so any number of tasks on both cores log without a
+ * lock and a full ring drops a line instead of blocking. The writer task,
+ * at the lowest application priority, formats each line conversion by
+ * conversion and sinks it to the UART, the SD card and an in-memory tail
+ * served over HTTP.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <ctype.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "logger.h"
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS must be a power of two");
+
+typedef struct {
+    volatile uint32_t sequence;     // Claim index + 1 once published
+    uint32_t    timestamp_ms;
+    const char* format;
+    uint8_t     module;
+    uint8_t     level;
+    uint8_t     used;               // Bytes of args filled
+    uint8_t     truncated;
+    uint8_t     args[LOG_ARG_BYTES];
+} log_slot_t;
+
+static const char* const module_names[LOG_MODULE_COUNT] = {
+    "system", "scan", "capture", "ai", "ui", "mesh", "idf"
+};
+static const char* const level_names[LOG_LEVEL_COUNT] = {
+    "none", "error", "warn", "info", "debug", "verbose"
+};
+static const char level_letters[LOG_LEVEL_COUNT + 1] = "-EWIDV";
+
+static log_slot_t ring[LOG_RING_SLOTS];
+static volatile uint32_t enqueue_pos = 0;
+static uint32_t dequeue_pos = 0;                // Writer task only
+static volatile uint8_t levels[LOG_MODULE_COUNT] = {
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL
+};
+static_assert(LOG_MODULE_COUNT == 7, "give the new module a default level");
+static volatile bool started = false;
+
+static char tail[LOG_TAIL_BYTES];
+static uint32_t tail_written = 0;               // Bytes since boot
+static char sd_batch[LOG_SD_BATCH_BYTES];
+static size_t sd_batch_len = 0;
+static uint32_t sd_last_flush_ms = 0;
+
+static logger_stats_t stats;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE tail_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static StackType_t writer_stack[LOG_WRITER_STACK_SIZE];
+static StaticTask_t writer_tcb;
+
+// Forward declarations
+static void writer_task(void* parameter);
+static bool drain_one(char* line, size_t capacity);
+static void pack_args(log_slot_t* slot, const char* format, va_list args);
+static size_t render(const log_slot_t* slot, char* out, size_t capacity);
+static void sink(const char* line, size_t length);
+static void flush_sd(void);
+static int idf_vprintf(const char* format, va_list args);
+
+/**
+ * @brief Create the writer task and route esp_log output through the ring
+ */
+bool logger_init(void) {
+    if (started) {
+        return true;
+    }
+    for (uint32_t i = 0; i < LOG_RING_SLOTS; i++) {
+        ring[i].sequence = i;
+    }
+    if (xTaskCreateStaticPinnedToCore(writer_task, "Log_Writer", LOG_WRITER_STACK_SIZE, NULL,
+                                      LOG_WRITER_PRIORITY, writer_stack, &writer_tcb,
+                                      tskNO_AFFINITY) == NULL) {
+        Serial.println("❌ Log writer could not be created");
+        return false;
+    }
+    started = true;
+    esp_log_level_set("*", (esp_log_level_t)levels[LOG_MODULE_IDF]);
+    esp_log_set_vprintf(idf_vprintf);
+    Serial.printf("✅ Logger: %d slots, default level %s\n", LOG_RING_SLOTS,
+                  level_names[LOG_DEFAULT_LEVEL]);
+    return true;
+}
+
+/**
+ * @brief Queue one line without formatting it
+ */
+void logger_write(log_module_t module, log_level_t level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    logger_vwrite(module, level, format, args);
+    va_end(args);
+}
+
+/**
+ * @brief Same as logger_write() with a va_list
+ */
+void logger_vwrite(log_module_t module, log_level_t level, const char* format, va_list args) {
+    if (module >= LOG_MODULE_COUNT || level == LOG_LEVEL_NONE || level > levels[module]) {
+        return;
+    }
+    if (!started) {
+        // Boot messages before the writer exists
+        char line[LOG_LINE_BYTES];
+        int length = vsnprintf(line, sizeof(line), format, args);
+        Serial.print(line);
+        if (length <= 0 || line[min((size_t)length, sizeof(line) - 1) - 1] != '\n') {
+            Serial.println();
+        }
+        return;
+    }
+
+    // Claim the slot at the enqueue position once the writer has freed it
+    uint32_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    log_slot_t* slot;
+    while (true) {
+        slot = &ring[pos & (LOG_RING_SLOTS - 1)];
+        uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(sequence - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            portENTER_CRITICAL(&stats_mux);
+            stats.dropped++;
+            portEXIT_CRITICAL(&stats_mux);
+            return;
+        } else {
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->timestamp_ms = millis();
+    slot->format = format;
+    slot->module = module;
+    slot->level = level;
+    pack_args(slot, format, args);
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.written++;
+    if (slot->truncated) {
+        stats.truncated++;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Change a module's level at run time
+ */
+void logger_set_level(log_module_t module, log_level_t level) {
+    if (level >= LOG_LEVEL_COUNT) {
+        return;
+    }
+    for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
+        if (module == LOG_MODULE_COUNT || module == i) {
+            levels[i] = level;
+        }
+    }
+    if (module == LOG_MODULE_COUNT || module == LOG_MODULE_IDF) {
+        // esp_log_level_t uses the same numbering
+        esp_log_level_set("*", (esp_log_level_t)level);
+    }
+}
+
+/**
+ * @brief Current level of a module
+ */
+log_level_t logger_get_level(log_module_t module) {
+    return module < LOG_MODULE_COUNT ? (log_level_t)levels[module] : LOG_LEVEL_NONE;
+}
+
+/**
+ * @brief Look a module up by its name
+ */
+log_module_t logger_find_module(const char* name) {
+    uint8_t i = 0;
+    while (i < LOG_MODULE_COUNT && strcmp(name, module_names[i]) != 0) {
+        i++;
+    }
+    return (log_module_t)i;
+}
+
+/**
+ * @brief Look a level up by its name
+ */
+log_level_t logger_find_level(const char* name) {
+    uint8_t i = 0;
+    while (i < LOG_LEVEL_COUNT && strcmp(name, level_names[i]) != 0) {
+        i++;
+    }
+    return (log_level_t)i;
+}
+
+const char* logger_module_name(log_module_t module) {
+    return module < LOG_MODULE_COUNT ? module_names[module] : "?";
+}
+
+const char* logger_level_name(log_level_t level) {
+    return level < LOG_LEVEL_COUNT ? level_names[level] : "?";
+}
+
+/**
+ * @brief Copy the newest formatted output, oldest first
+ */
+size_t logger_tail(char* out, size_t capacity) {
+    portENTER_CRITICAL(&tail_mux);
+    size_t length = min((size_t)min(tail_written, (uint32_t)LOG_TAIL_BYTES), capacity);
+    uint32_t start = tail_written - length;
+    for (size_t i = 0; i < length; i++) {
+        out[i] = tail[(start + i) % LOG_TAIL_BYTES];
+    }
+    portEXIT_CRITICAL(&tail_mux);
+    return length;
+}
+
+/**
+ * @brief Copy the ring and sink figures
+ */
+void logger_get_stats(logger_stats_t* out) {
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Writer - formats and sinks everything queued, then sleeps
+ */
+static void writer_task(void* parameter) {
+    static char line[LOG_LINE_BYTES];
+    uint32_t reported_drops = 0;
+
+    while (true) {
+        while (drain_one(line, sizeof(line))) {
+        }
+
+        uint32_t dropped;
+        portENTER_CRITICAL(&stats_mux);
+        dropped = stats.dropped;
+        portEXIT_CRITICAL(&stats_mux);
+        if (dropped != reported_drops) {
+            int length = snprintf(line, sizeof(line), "⚠️  %lu log lines dropped, ring full\n",
+                                  dropped - reported_drops);
+            sink(line, min((size_t)length, sizeof(line) - 1));
+            reported_drops = dropped;
+        }
+
+        if (sd_batch_len > 0 && millis() - sd_last_flush_ms >= LOG_SD_FLUSH_MS) {
+            flush_sd();
+        }
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    }
+}
+
+/**
+ * @brief Format and sink the oldest published slot
+ * @return false if the next slot is not published yet
+ */
+static bool drain_one(char* line, size_t capacity) {
+    log_slot_t* slot = &ring[dequeue_pos & (LOG_RING_SLOTS - 1)];
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != dequeue_pos + 1) {
+        return false;
+    }
+
+    uint32_t timestamp = slot->timestamp_ms;
+    int prefix = snprintf(line, capacity, "%lu.%03lu %c %s: ", timestamp / 1000, timestamp % 1000,
+                          level_letters[slot->level], module_names[slot->module]);
+    size_t length = (size_t)prefix + render(slot, line + prefix, capacity - prefix);
+
+    // Hand the slot back before the slow part
+    __atomic_store_n(&slot->sequence, dequeue_pos + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+    dequeue_pos++;
+
+    // Callers' own line ends are replaced by exactly one
+    while (length > (size_t)prefix && line[length - 1] == '\n') {
+        length--;
+    }
+    if (length + 1 < capacity) {
+        line[length++] = '\n';
+    } else {
+        line[capacity - 2] = '\n';
+        length = capacity - 1;
+    }
+    line[length] = '\0';
+    sink(line, length);
+
+    uint32_t latency = millis() - timestamp;
+    portENTER_CRITICAL(&stats_mux);
+    stats.drained++;
+    stats.max_latency_ms = max(stats.max_latency_ms, latency);
+    portEXIT_CRITICAL(&stats_mux);
+    return true;
+}
+
+/**
+ * @brief Append bytes to a slot's args
+ */
+static bool put(log_slot_t* slot, const void* data, size_t length) {
+    if (slot->used + length > LOG_ARG_BYTES) {
+        slot->truncated = 1;
+        return false;
+    }
+    memcpy(slot->args + slot->used, data, length);
+    slot->used += length;
+    return true;
+}
+
+/**
+ * @brief Take every argument the format names, each with its own type
+ *
+ * Integers are 4 bytes, 8 with ll or j, floating point always 8 (promoted
+ * to double); a string is a length byte and its characters, bounded by
+ * the conversion's precision.
+ */
+static void pack_args(log_slot_t* slot, const char* format, va_list args) {
+    slot->used = 0;
+    slot->truncated = 0;
+    for (const char* p = format; *p != '\0'; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            continue;
+        }
+        while (*p != '\0' && strchr("-+ #0", *p) != NULL) {
+            p++;
+        }
+        if (*p == '*') {
+            int width = va_arg(args, int);
+            if (!put(slot, &width, sizeof(width))) {
+                return;
+            }
+            p++;
+        }
+        while (isdigit((unsigned char)*p)) {
+            p++;
+        }
+        int precision = -1;
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                precision = va_arg(args, int);
+                if (!put(slot, &precision, sizeof(precision))) {
+                    return;
+                }
+                p++;
+            } else {
+                precision = 0;
+                while (isdigit((unsigned char)*p)) {
+                    precision = precision * 10 + (*p++ - '0');
+                }
+            }
+        }
+        uint8_t longs = 0;
+        while (*p != '\0' && strchr("hlLjzt", *p) != NULL) {
+            longs += *p == 'l' ? 1 : *p == 'j' ? 2 : 0;
+            p++;
+        }
+
+        bool fits = true;
+        switch (*p) {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c': case 'p':
+                if (longs >= 2) {
+                    uint64_t value = va_arg(args, unsigned long long);
+                    fits = put(slot, &value, sizeof(value));
+                } else {
+                    uint32_t value = va_arg(args, unsigned int);
+                    fits = put(slot, &value, sizeof(value));
+                }
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                double value = va_arg(args, double);
+                fits = put(slot, &value, sizeof(value));
+                break;
+            }
+            case 's': {
+                const char* text = va_arg(args, const char*);
+                if (text == NULL) {
+                    text = "(null)";
+                }
+                size_t length = precision >= 0 ? strnlen(text, precision) : strlen(text);
+                size_t room = LOG_ARG_BYTES - slot->used;
+                if (room < 1) {
+                    slot->truncated = 1;
+                    return;
+                }
+                if (length > room - 1 || length > UINT8_MAX) {
+                    length = min(room - 1, (size_t)UINT8_MAX);
+                    slot->truncated = 1;
+                }
+                uint8_t stored = (uint8_t)length;
+                put(slot, &stored, 1);
+                put(slot, text, length);
+                break;
+            }
+            case 'n':
+                va_arg(args, void*);
+                break;
+            case '\0':
+                return;
+            default:
+                break;
+        }
+        if (!fits) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Read bytes back out of a slot's args, zeros past the end
+ */
+static void take(const log_slot_t* slot, size_t* offset, void* out, size_t length) {
+    if (*offset + length <= slot->used) {
+        memcpy(out, slot->args + *offset, length);
+        *offset += length;
+    } else {
+        memset(out, 0, length);
+        *offset = slot->used;
+    }
+}
+
+/**
+ * @brief Format a slot one conversion at a time
+ * @return Characters written, excluding the NUL
+ */
+static size_t render(const log_slot_t* slot, char* out, size_t capacity) {
+    size_t length = 0;
+    size_t offset = 0;
+    char spec[24];
+
+    for (const char* p = slot->format; *p != '\0' && length + 1 < capacity; p++) {
+        if (*p != '%') {
+            out[length++] = *p;
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            out[length++] = '%';
+            continue;
+        }
+
+        // Rebuild the conversion with any * replaced by its recorded value
+        size_t s = 0;
+        spec[s++] = '%';
+        while (*p != '\0' && strchr("-+ #0", *p) != NULL && s < 4) {
+            spec[s++] = *p++;
+        }
+        if (*p == '*') {
+            int width;
+            take(slot, &offset, &width, sizeof(width));
+            s += snprintf(spec + s, sizeof(spec) - s, "%d", width);
+            p++;
+        }
+        while (isdigit((unsigned char)*p) && s < 10) {
+            spec[s++] = *p++;
+        }
+        size_t precision_at = s;
+        if (*p == '.') {
+            spec[s++] = *p++;
+            if (*p == '*') {
+                int precision;
+                take(slot, &offset, &precision, sizeof(precision));
+                s += snprintf(spec + s, sizeof(spec) - s, "%d", max(precision, 0));
+                p++;
+            }
+            while (isdigit((unsigned char)*p) && s < 16) {
+                spec[s++] = *p++;
+            }
+        }
+        uint8_t longs = 0;
+        while (*p != '\0' && strchr("hlLjzt", *p) != NULL) {
+            longs += *p == 'l' ? 1 : *p == 'j' ? 2 : 0;
+            if (s < sizeof(spec) - 2) {
+                spec[s++] = *p;
+            }
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        spec[s++] = *p;
+        spec[s] = '\0';
+
+        size_t room = capacity - length;
+        int written = 0;
+        switch (*p) {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c': case 'p':
+                if (longs >= 2) {
+                    uint64_t value;
+                    take(slot, &offset, &value, sizeof(value));
+                    written = snprintf(out + length, room, spec, value);
+                } else {
+                    uint32_t value;
+                    take(slot, &offset, &value, sizeof(value));
+                    written = *p == 'p' ? snprintf(out + length, room, spec, (void*)(uintptr_t)value)
+                                        : snprintf(out + length, room, spec, value);
+                }
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                double value;
+                take(slot, &offset, &value, sizeof(value));
+                written = snprintf(out + length, room, spec, value);
+                break;
+            }
+            case 's': {
+                // Precision was applied when the string was copied
+                uint8_t stored = 0;
+                take(slot, &offset, &stored, 1);
+                const char* text = (const char*)slot->args + offset;
+                if (offset + stored > slot->used) {
+                    text = "?";
+                    stored = 1;
+                } else {
+                    offset += stored;
+                }
+                memcpy(spec + precision_at, ".*s", 4);
+                written = snprintf(out + length, room, spec, (int)stored, text);
+                break;
+            }
+            default:
+                written = snprintf(out + length, room, "%s", spec);
+                break;
+        }
+        if (written > 0) {
+            length += min((size_t)written, room - 1);
+        }
+    }
+    if (slot->truncated) {
+        while (length > 0 && out[length - 1] == '\n') {
+            length--;
+        }
+    }
+    if (slot->truncated && length + 4 < capacity) {
+        memcpy(out + length, " ...", 4);
+        length += 4;
+    }
+    out[length] = '\0';
+    return length;
+}
+
+/**
+ * @brief Send one formatted line to the UART, the tail and the SD batch
+ */
+static void sink(const char* line, size_t length) {
+    Serial.write((const uint8_t*)line, length);
+
+    portENTER_CRITICAL(&tail_mux);
+    for (size_t i = 0; i < length; i++) {
+        tail[(tail_written + i) % LOG_TAIL_BYTES] = line[i];
+    }
+    tail_written += length;
+    portEXIT_CRITICAL(&tail_mux);
+
+#if LOG_SD_ENABLED
+    if (sd_batch_len + length > sizeof(sd_batch)) {
+        flush_sd();
+    }
+    if (length <= sizeof(sd_batch)) {
+        memcpy(sd_batch + sd_batch_len, line, length);
+        sd_batch_len += length;
+    }
+#endif
+}
+
+/**
+ * @brief Append the batch to LOG_SD_FILE, rotating it at LOG_SD_MAX_BYTES
+ */
+static void flush_sd(void) {
+    size_t length = sd_batch_len;
+    sd_batch_len = 0;
+    sd_last_flush_ms = millis();
+    if (length == 0 || !sd_monitor_mounted() || !spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER)) {
+        return;
+    }
+    if (SD.exists(TRACE_LOG_DIR) || SD.mkdir(TRACE_LOG_DIR)) {
+        File file = SD.open(LOG_SD_FILE, "a");
+        if (file && file.size() + length > LOG_SD_MAX_BYTES) {
+            file.close();
+            SD.remove(LOG_SD_OLD_FILE);
+            SD.rename(LOG_SD_FILE, LOG_SD_OLD_FILE);
+            file = SD.open(LOG_SD_FILE, "a");
+        }
+        if (file) {
+            size_t written = file.write((const uint8_t*)sd_batch, length);
+            file.close();
+            portENTER_CRITICAL(&stats_mux);
+            stats.sd_bytes += written;
+            portEXIT_CRITICAL(&stats_mux);
+        }
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+}
+
+/**
+ * @brief esp_log output: the level letter follows any colour code
+ */
+static int idf_vprintf(const char* format, va_list args) {
+    const char* p = format;
+    if (*p == '\033') {
+        while (*p != '\0' && *p != 'm') {
+            p++;
+        }
+        if (*p == 'm') {
+            p++;
+        }
+    }
+    const char* letter = strchr(level_letters + 1, *p);
+    log_level_t level = letter != NULL && *p != '\0' ? (log_level_t)(letter - level_letters) : LOG_LEVEL_INFO;
+    logger_vwrite(LOG_MODULE_IDF, level, format, args);
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file loop_timing.cpp
+ * @brief Execution time, start jitter and missed deadlines of each task loop
+ *
+ * Each loop marks the start and the end of its body. The body's length is
+ * compared against the loop's period; a periodic loop's start is also
+ * compared against the one its previous period promised, which shows how
+ * late the scheduler let it run. Loops that keep missing get a longer
+ * period so they settle into a steady rhythm instead of running back to
+ * back, and give it back once their bodies fit again.
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "loop_timing.h"
+#include "alloc_trace.h"
+#include "logger.h"
+
+typedef struct {
+    loop_timing_stats_t stats;
+    bool     periodic;              // Wakes on a period rather than on events
+    uint32_t start_us;
+    uint32_t expected_us;           // Start the last period promised, 0 if none
+    uint32_t consecutive_fits;
+} loop_state_t;
+
+// In loop_id_t order
+static loop_state_t loops[LOOP_COUNT] = {
+    { { "ui" },      false },
+    { { "ai" },      false },
+    { { "scan" },    true },
+    { { "system" },  true },
+    { { "capture" }, true }
+};
+static portMUX_TYPE timing_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static uint32_t adapt_period(loop_state_t* loop, uint32_t period_ms, bool missed);
+
+/**
+ * @brief Mark the start of a loop body, after the wait
+ */
+void loop_timing_start(loop_id_t id) {
+    loop_state_t* loop = &loops[id];
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    loop->start_us = now;
+    ALLOC_TRACE_BEGIN((alloc_cycle_t)id);
+    if (loop->periodic && loop->expected_us != 0 && (int32_t)(now - loop->expected_us) > 0) {
+        uint32_t jitter = now - loop->expected_us;
+        portENTER_CRITICAL(&timing_mux);
+        loop->stats.max_jitter_us = max(loop->stats.max_jitter_us, jitter);
+        portEXIT_CRITICAL(&timing_mux);
+    }
+}
+
+/**
+ * @brief Mark the end of a loop body and get the period to wait for
+ */
+uint32_t loop_timing_finish(loop_id_t id, uint32_t period_ms) {
+    loop_state_t* loop = &loops[id];
+    uint32_t exec_us = (uint32_t)esp_timer_get_time() - loop->start_us;
+    ALLOC_TRACE_END((alloc_cycle_t)id);
+    bool missed = exec_us > period_ms * 1000;
+
+    portENTER_CRITICAL(&timing_mux);
+    loop_timing_stats_t* stats = &loop->stats;
+    stats->loops++;
+    stats->period_ms = period_ms;
+    stats->last_exec_us = exec_us;
+    stats->avg_exec_us = stats->loops == 1 ? exec_us
+                       : stats->avg_exec_us - stats->avg_exec_us / 8 + exec_us / 8;
+    stats->max_exec_us = max(stats->max_exec_us, exec_us);
+    if (missed) {
+        stats->misses++;
+        stats->consecutive_misses++;
+    } else {
+        stats->consecutive_misses = 0;
+    }
+    uint32_t wait_ms = adapt_period(loop, period_ms, missed);
+    portEXIT_CRITICAL(&timing_mux);
+
+    // A missed period has no promised start; vTaskDelayUntil() returns at once
+    loop->expected_us = missed ? 0 : loop->start_us + wait_ms * 1000;
+
+    if (missed && stats->consecutive_misses == LOOP_STRETCH_AFTER) {
+        LOGI(SYSTEM, "⏱️ Loop %s missed %d deadlines in a row (%lu us against %lu ms), period now %lu ms",
+            stats->name, LOOP_STRETCH_AFTER, exec_us, period_ms, wait_ms);
+    }
+    return wait_ms;
+}
+
+/**
+ * @brief Copy one loop's figures
+ */
+void loop_timing_get(loop_id_t id, loop_timing_stats_t* out) {
+    portENTER_CRITICAL(&timing_mux);
+    *out = loops[id].stats;
+    portEXIT_CRITICAL(&timing_mux);
+}
+
+/**
+ * @brief Stretch the period after repeated misses, relax it after repeated fits
+ *
+ * Called with timing_mux held.
+ */
+static uint32_t adapt_period(loop_state_t* loop, uint32_t period_ms, bool missed) {
+    loop_timing_stats_t* stats = &loop->stats;
+    uint32_t ceiling_ms = period_ms * LOOP_STRETCH_MAX_FACTOR;
+
+    if (missed) {
+        loop->consecutive_fits = 0;
+        if (stats->consecutive_misses >= LOOP_STRETCH_AFTER) {
+            // Room for the average body plus a quarter
+            uint32_t fit_ms = (stats->avg_exec_us + stats->avg_exec_us / 4) / 1000 + 1;
+            uint32_t stretched = min(max(fit_ms, period_ms), ceiling_ms);
+            if (stretched > max(stats->stretched_ms, period_ms)) {
+                stats->stretched_ms = stretched;
+                stats->stretches++;
+            }
+        }
+    } else if (stats->stretched_ms != 0 && ++loop->consecutive_fits >= LOOP_RELAX_AFTER) {
+        // Give back a quarter of the extra time at a time
+        loop->consecutive_fits = 0;
+        uint32_t extra = stats->stretched_ms > period_ms ? stats->stretched_ms - period_ms : 0;
+        stats->stretched_ms = extra < 4 ? 0 : stats->stretched_ms - extra / 4;
+    }
+
+    if (stats->stretched_ms > ceiling_ms) {
+        stats->stretched_ms = ceiling_ms;
+    }
+    return max(period_ms, stats->stretched_ms);
+}
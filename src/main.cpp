@@ -16,233 +16,595 @@
 #include <WiFi.h>
 #include <Wire.h>
 #include <SPI.h>
-#include <SD.h>
-#include <SPIFFS.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
 #include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include <esp_heap_caps.h>
+#include <esp_system.h>
 
 #include "config.h"
 #include "ai_states.h"
 #include "system_monitor.h"
+#include "data_bus.h"
+#include "job_pool.h"
+#include "scan_events.h"
+#include "rssi_kernels.h"
+#include "model_store.h"
+#include "model_update.h"
+#include "trace_log.h"
+#include "scan_log.h"
+#include "log_manager.h"
+#include "event_trace.h"
+#include "profile.h"
+#include "alloc_trace.h"
+#include "mem_policy.h"
+#include "tunables.h"
+#include "timer_wheel.h"
+#include "boot_profile.h"
+#include "storage.h"
+#include "journal.h"
+#include "asset_store.h"
+#include "warm_start.h"
+#include "logger.h"
+#include "spi_bus.h"
+#include "cpu_load.h"
+#include "task_monitor.h"
+#include "sd_monitor.h"
+#include "metrics_history.h"
+#include "status_led.h"
+#include "power_manager.h"
+#include "thermal.h"
+#include "energy.h"
+#include "wake_sources.h"
+#include "time_sync.h"
+#include "provisioning.h"
+#include "fleet_commands.h"
+#include "crash_dump.h"
+#include "i2c_sensors.h"
+#include "supervisor.h"
+#include "priority_tuner.h"
+#include "ble_scan.h"
+#include "mqtt_uplink.h"
+#include "wifi_link.h"
+#include "firmware_update.h"
+#include "bench.h"
+#include "survey.h"
 
 // Task handles for FreeRTOS
 TaskHandle_t ui_task_handle = NULL;
 TaskHandle_t ai_task_handle = NULL;
 TaskHandle_t scan_task_handle = NULL;
 TaskHandle_t system_task_handle = NULL;
+TaskHandle_t capture_task_handle = NULL;
+TaskHandle_t gps_task_handle = NULL;
 
 // Global state and synchronization
 ai_state_t current_ai_state = AI_STATE_IDLE;
-sensor_data_t global_sensor_data = {0};
-SemaphoreHandle_t sensor_data_mutex = NULL;
-QueueHandle_t ai_state_queue = NULL;
+QueueHandle_t scan_event_queue = NULL;
+static StaticQueue_t scan_event_queue_state;
+static uint8_t scan_event_queue_storage[SCAN_EVENT_QUEUE_LENGTH * sizeof(scan_event_t)];
+
+// Task stacks and control blocks live in .bss: boot takes nothing from
+// the heap for them and an oversized budget fails at link time
+#if SYSTEM_TASK_STACK_IN_PSRAM && CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY
+#define SYSTEM_STACK_EXTERNAL 1
+#else
+#define SYSTEM_STACK_EXTERNAL 0
+#if SYSTEM_TASK_STACK_IN_PSRAM
+#warning "SYSTEM_TASK_STACK_IN_PSRAM needs CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY; stack kept internal"
+#endif
+#endif
+static_assert(UI_TASK_STACK_SIZE + AI_TASK_STACK_SIZE + SCAN_TASK_STACK_SIZE + CAPTURE_TASK_STACK_SIZE +
+              (SYSTEM_STACK_EXTERNAL ? 0 : SYSTEM_TASK_STACK_SIZE) +
+              (WARDRIVE_ENABLED ? GPS_TASK_STACK_SIZE : 0) +
+              (RENDER_SPLIT_ENABLED ? RENDER_SPLIT_STACK_SIZE : 0) +
+              JOB_WORKERS * JOB_WORKER_STACK_SIZE + LOG_WRITER_STACK_SIZE <= TASK_STACK_BUDGET_BYTES,
+              "task stacks exceed TASK_STACK_BUDGET_BYTES");
+
+static StackType_t ui_stack[UI_TASK_STACK_SIZE];
+static StackType_t ai_stack[AI_TASK_STACK_SIZE];
+static StackType_t scan_stack[SCAN_TASK_STACK_SIZE];
+#if !SYSTEM_STACK_EXTERNAL
+static StackType_t system_stack[SYSTEM_TASK_STACK_SIZE];
+#endif
+#if PACKET_CAPTURE_ENABLED
+static StackType_t capture_stack[CAPTURE_TASK_STACK_SIZE];
+#else
+static StackType_t* const capture_stack = NULL;
+#endif
+#if WARDRIVE_ENABLED
+static StackType_t gps_stack[GPS_TASK_STACK_SIZE];
+#else
+static StackType_t* const gps_stack = NULL;
+#endif
+static StaticTask_t ui_tcb, ai_tcb, scan_tcb, system_tcb, capture_tcb, gps_tcb;
+
+// When each task is created: the panel first, the AI from its persisted
+// state, then the scans once the radios are up, and the system task once
+// storage, web and OTA are, while the others already run
+typedef enum {
+    BOOT_TIER_PANEL = 0,
+    BOOT_TIER_FACE,
+    BOOT_TIER_RADIOS,
+    BOOT_TIER_SERVICES
+} boot_tier_t;
+
+// Boot steps that run on the job workers while setup() carries on; the
+// tier that needs one waits for its bit
+#define BOOT_DONE_BLUETOOTH    (1 << 0)
+#define BOOT_DONE_SD           (1 << 1)
+static EventGroupHandle_t boot_done = NULL;
+static StaticEventGroup_t boot_done_state;
+static volatile bool bluetooth_ready = false;
+static bool model_slots_ready = false;
 
 // Forward declarations
 void ui_task(void* parameter);
 void ai_task(void* parameter);
 void scan_task(void* parameter);
 void system_task(void* parameter);
-bool initialize_hardware(void);
-bool initialize_storage(void);
-void create_tasks(void);
+void capture_task(void* parameter);
+void gps_task(void* parameter);
+bool initialize_face(void);
+bool initialize_radios(void);
+bool initialize_services(void);
+void create_tasks(boot_tier_t tier);
+static void run_boot_job(job_fn_t job);
+static void start_bluetooth_job(void* payload);
+static void mount_sd_job(void* payload);
 
 void setup() {
     Serial.begin(115200);
-    delay(1000);
+#if SURVEY_MODE_ENABLED
+    // Straight to the sweep: no console wait, display or tasks on a survey wake
+    if (survey_should_run()) {
+        survey_run();
+    }
+#endif
+    boot_profile_begin(BOOT_STAGE_TIER_FACE);
+    boot_profile_begin(BOOT_STAGE_CONSOLE);
+    // A USB CDC console only shows the banner once a host has opened it;
+    // after a restart (scheduled, watchdog, update) nobody is waiting
+    if (esp_reset_reason() == ESP_RST_POWERON) {
+        while (!Serial && millis() < BOOT_CONSOLE_WAIT_MS) {
+            delay(10);
+        }
+    }
     
-    Serial.println("\n" + String('=', 50));
-    Serial.println("🧠 HydraESP AI Edition v2.0");
-    Serial.println("ESP32-S3 Ponagotchi-Style AI Companion");
-    Serial.println(String('=', 50) + "\n");
+    Serial.println("\n==================================================\n"
+                   "🧠 HydraESP AI Edition v2.0\n"
+                   "ESP32-S3 Ponagotchi-Style AI Companion\n"
+                   "==================================================\n");
     
-    // Initialize hardware components
-    if (!initialize_hardware()) {
-        Serial.println("❌ Hardware initialization failed!");
-        ESP.restart();
+    // Before anything traces: the ring may still hold a crash's last events
+#if CRASH_DUMP_ENABLED
+    crash_dump_init();
+#elif EVENT_TRACE_ENABLED
+    event_trace_init(false);
+#endif
+    
+    // From here on task logging only queues lines; the writer prints them
+    if (!logger_init()) {
+        Serial.println("⚠️  Log writer unavailable - logging straight to the UART");
     }
     
-    // Initialize storage systems  
-    if (!initialize_storage()) {
-        Serial.println("❌ Storage initialization failed!");
+    // The data bus must exist before anything publishes on it
+    if (!data_bus_init()) {
+        Serial.println("❌ Data bus initialization failed!");
         ESP.restart();
     }
     
-    // Initialize system monitoring
-    if (!system_monitor_init()) {
-        Serial.println("❌ System monitor initialization failed!");
+    // Time zone, and the wall clock if the RTC kept it through a sleep
+    time_sync_init();
+    
+    // Workers first: the slow boot steps run on them, or inline without them
+    if (!job_pool_init()) {
+        LOGW(SYSTEM, "⚠️  Job pool unavailable - background jobs run inline");
+    }
+    profile_init();                 // Before the first scope runs
+    alloc_trace_init();
+    mem_policy_init();              // Before the radios and LVGL allocate
+    tunables_init();                // Before thermal and the tasks read them
+    timer_wheel_init();             // Before the tasks start their housekeeping timers
+    boot_done = xEventGroupCreateStatic(&boot_done_state);
+    boot_profile_end(BOOT_STAGE_CONSOLE);
+    
+    // Tier 0: the panel, and the AI task from the persisted state
+    if (!initialize_face()) {
+        Serial.println("❌ Hardware initialization failed!");
         ESP.restart();
     }
+    boot_profile_end(BOOT_STAGE_TIER_FACE);
     
-    // Create FreeRTOS synchronization objects
-    sensor_data_mutex = xSemaphoreCreateMutex();
-    ai_state_queue = xQueueCreate(10, sizeof(ai_state_t));
+    // Tier 1: the radios, and the scan task once the flash file system it
+    // keeps its state in is mounted
+    boot_profile_begin(BOOT_STAGE_TIER_RADIOS);
+    if (!initialize_radios()) {
+        Serial.println("❌ Radio or flash file system initialization failed!");
+        ESP.restart();
+    }
+    boot_profile_end(BOOT_STAGE_TIER_RADIOS);
     
-    if (sensor_data_mutex == NULL || ai_state_queue == NULL) {
-        Serial.println("❌ Failed to create synchronization objects!");
+    // Tier 2: the card, history, web and OTA, with the face and the scans
+    // already running; the system task starts last
+    boot_profile_begin(BOOT_STAGE_TIER_SERVICES);
+    if (!initialize_services()) {
+        Serial.println("❌ System monitor initialization failed!");
         ESP.restart();
     }
+    boot_profile_end(BOOT_STAGE_TIER_SERVICES);
+    
+#if BENCH_ENABLED
+    bench_run();                    // Before the supervisor: tasks are suspended meanwhile
+#endif
     
-    // Create and start FreeRTOS tasks
-    create_tasks();
+#if SUPERVISOR_ENABLED
+    vTaskPrioritySet(NULL, SUPERVISOR_PRIORITY);
+    enableLoopWDT();
+#endif
     
-    Serial.println("✅ HydraESP AI Edition initialized successfully!");
-    Serial.println("🚀 All systems operational\n");
+    LOGI(SYSTEM, "✅ HydraESP AI Edition initialized successfully!");
+    LOGI(SYSTEM, "🚀 All systems operational");
 }
 
 void loop() {
-    // Main loop is handled by FreeRTOS tasks
-    // Keep this minimal to avoid blocking
+    // Main loop is handled by FreeRTOS tasks; this one only supervises them,
+    // above their priorities and itself under the loop task watchdog
     vTaskDelay(pdMS_TO_TICKS(1000));
-    
-    // Optional: Watchdog reset or system health check
-    if (system_monitor_is_critical()) {
-        Serial.println("⚠️  System in critical state - considering restart");
-        // Could implement graceful shutdown or restart logic here
+#if SUPERVISOR_ENABLED
+    supervisor_check(millis());
+#endif
+#if EVENT_TRACE_ENABLED || PROFILE_ENABLED || ALLOC_TRACE_ENABLED
+    // A key on the console dumps the event ring, profile or allocations without a network
+    while (Serial.available() > 0) {
+        int key = Serial.read();
+#if EVENT_TRACE_ENABLED
+        if (key == EVENT_TRACE_SERIAL_KEY) {
+            event_trace_dump_serial();
+        }
+#endif
+#if PROFILE_ENABLED
+        if (key == PROFILE_SERIAL_KEY) {
+            profile_dump_serial();
+        }
+#endif
+#if ALLOC_TRACE_ENABLED
+        if (key == ALLOC_TRACE_SERIAL_KEY) {
+            alloc_trace_dump_serial();
+        }
+#endif
     }
+#endif
 }
 
 /**
- * @brief Initialize all hardware components
+ * @brief Tier 0: clocks, the SPI hosts, the UI task, and the AI task behind it
+ *
+ * The AI task only needs raw partitions: its state from the journal, its
+ * model from a slot or the asset partition. A model only found as a
+ * file is picked up once the last tier has mounted the file systems.
  * @return true on success, false on failure
  */
-bool initialize_hardware(void) {
-    Serial.println("🔧 Initializing hardware components...");
+bool initialize_face(void) {
+    LOGI(SYSTEM, "🔧 Initializing hardware components (board %s)...", BOARD.name);
+    boot_profile_begin(BOOT_STAGE_HARDWARE);
+    
+    // Status LED, solid during init
+    status_led_init();
+    status_led_set(STATUS_LED_ON);
     
-    // Initialize status LED
-    pinMode(STATUS_LED_PIN, OUTPUT);
-    digitalWrite(STATUS_LED_PIN, HIGH); // Turn on during init
+    // Full clock only while there is work, then the die temperature,
+    // which may lower the top of that range
+    power_manager_init();
+    thermal_init();
+    
+    // SPI hosts: an SPI display alone on its own, SD card and touch sharing HSPI
+    if (!spi_bus_init()) {
+        return false;
+    }
+    boot_profile_end(BOOT_STAGE_HARDWARE);
     
-    // Initialize SPI for display and SD card
-    SPI.begin(TFT_CLK, -1, TFT_MOSI, -1);
-    Serial.println("✅ SPI initialized");
+    // The panel, touch and LVGL come up on the UI task meanwhile
+    create_tasks(BOOT_TIER_PANEL);
+    
+    // Journal replay, mapped assets and model slots: raw flash, no file system
+    boot_profile_begin(BOOT_STAGE_MODELS);
+#if JOURNAL_ENABLED
+    journal_init();                 // Replayed before warm start and the AI task read it
+#endif
+#if ASSET_STORE_ENABLED
+    asset_store_init();             // Mapped before the AI task looks for its model
+#endif
+    model_slots_ready = model_store_init();
+    boot_profile_end(BOOT_STAGE_MODELS);
+    
+#if WARM_START_ENABLED
+    // The AI state the last boot ended in, before the AI task reads it
+    warm_start_snapshot_t warm;
+    if (warm_start_init() && warm_start_restored(&warm)) {
+        current_ai_state = (ai_state_t)warm.state;
+    }
+#endif
+    
+    // Create FreeRTOS synchronization objects, in static storage
+    scan_event_queue = xQueueCreateStatic(SCAN_EVENT_QUEUE_LENGTH, sizeof(scan_event_t),
+                                          scan_event_queue_storage, &scan_event_queue_state);
+    create_tasks(BOOT_TIER_FACE);
+    return true;
+}
+
+/**
+ * @brief Tier 1: I2C, the radios, LittleFS, then the scan and capture tasks
+ * @return true on success, false on failure
+ */
+bool initialize_radios(void) {
+    // Bluetooth controller on a worker while the rest of this tier runs
+    run_boot_job(start_bluetooth_job);
     
     // Initialize I2C for sensors (if needed)
-    Wire.begin(I2C_SDA, I2C_SCL);
-    Serial.println("✅ I2C initialized");
+    Wire.begin(BOARD.i2c.sda, BOARD.i2c.scl);
+    LOGI(SYSTEM, "✅ I2C initialized");
+    
+    // Current per subsystem, calibrated by an INA219 if one is on the bus
+    energy_init();
+    
+    // Why this boot happened, and the accelerometer and battery for the features
+    wake_sources_init();
+    
+    // Climate, light, motion and fuel gauge, whichever answer on the bus
+    i2c_sensors_init();
     
     // Initialize WiFi in station mode
     WiFi.mode(WIFI_STA);
     WiFi.disconnect();
-    Serial.println("✅ WiFi initialized in station mode");
+    LOGI(SYSTEM, "✅ WiFi initialized in station mode");
+#if PROVISION_ENABLED
+    provisioning_init();            // Provisioned uplink credentials over WIFI_LINK_SSID
+#endif
+#if FLEET_ENABLED
+    fleet_commands_init();          // Ids already applied, before any command can arrive
+#endif
+#if WIFI_LINK_ENABLED
+    wifi_link_init();               // Joins in the background, kept up by the system task
+#endif
     
-    // Initialize Bluetooth
-    if (!btStart()) {
-        Serial.println("❌ Bluetooth initialization failed");
+    // LittleFS holds the scan task's novelty filter and the crash log
+    boot_profile_begin(BOOT_STAGE_FLASH_FS);
+    if (!storage_init()) {
         return false;
     }
-    Serial.println("✅ Bluetooth initialized");
+    boot_profile_end(BOOT_STAGE_FLASH_FS);
+#if SUPERVISOR_ENABLED
+    supervisor_init();
+#endif
     
     // Check PSRAM availability
     if (psramFound()) {
-        Serial.printf("✅ PSRAM initialized: %d KB available\n", 
-                     ESP.getPsramSize() / 1024);
+        LOGI(SYSTEM, "✅ PSRAM initialized: %d KB available", 
+            ESP.getPsramSize() / 1024);
     } else {
-        Serial.println("⚠️  PSRAM not found - using internal RAM only");
+        LOGW(SYSTEM, "⚠️  PSRAM not found - using internal RAM only");
     }
     
-    digitalWrite(STATUS_LED_PIN, LOW); // Turn off after init
+#if RSSI_KERNELS_BENCHMARK
+    rssi_kernels_benchmark();
+#endif
+    
+    // The scan task needs the radio
+    boot_profile_begin(BOOT_STAGE_TASKS);
+    xEventGroupWaitBits(boot_done, BOOT_DONE_BLUETOOTH, pdFALSE, pdTRUE, portMAX_DELAY);
+    if (!bluetooth_ready) {
+        LOGE(SYSTEM, "❌ Bluetooth initialization failed!");
+        return false;
+    }
+    create_tasks(BOOT_TIER_RADIOS);
+    status_led_set(STATUS_LED_OFF); // The system task takes over
     return true;
 }
 
 /**
- * @brief Initialize storage systems (SD card and SPIFFS)  
- * @return true on success, false on failure
+ * @brief Tier 2: the SD card, logs, history, web and OTA, then the system task
+ *
+ * Every writer here stages or drops its records until it is initialized,
+ * so the tasks already running lose nothing but the odd early record.
+ * @return false if the system monitor cannot start
  */
-bool initialize_storage(void) {
-    Serial.println("💾 Initializing storage systems...");
+bool initialize_services(void) {
+    LOGI(SYSTEM, "💾 Initializing storage and services...");
     
-    // Initialize SPIFFS for internal storage
-    if (!SPIFFS.begin(true)) {
-        Serial.println("❌ SPIFFS initialization failed");
-        return false;
+    // SD card on a worker (optional - don't fail if not present); the
+    // system task watches for it coming and going once it runs
+#if LOG_MANAGER_ENABLED
+    log_manager_init();             // Boot number for the files the SD job opens
+#endif
+#if TRACE_LOG_ENABLED
+    sd_monitor_listen(trace_log_card_changed);
+#endif
+    run_boot_job(mount_sd_job);
+    
+#if HISTORY_ENABLED
+    metrics_history_init();         // Flushes to whichever card is mounted later
+#endif
+#if SCAN_LOG_ENABLED
+    scan_log_init();                // Staged in PSRAM until a card takes it
+#endif
+#if MODEL_UPDATE_ENABLED
+    if (model_slots_ready) {
+        model_update_init();
     }
-    Serial.printf("✅ SPIFFS initialized: %d KB total, %d KB used\n",
-                  SPIFFS.totalBytes() / 1024, SPIFFS.usedBytes() / 1024);
-    
-    // Initialize SD card (optional - don't fail if not present)
-    if (SD.begin(SD_CS)) {
-        uint64_t cardSize = SD.cardSize() / (1024 * 1024);
-        Serial.printf("✅ SD Card initialized: %lluMB\n", cardSize);
-        
-        // Create log directory if it doesn't exist
-        if (!SD.exists("/logs")) {
-            SD.mkdir("/logs");
-            Serial.println("📁 Created /logs directory");
-        }
-        
-        global_sensor_data.sd_card_present = true;
-    } else {
-        Serial.println("⚠️  SD Card not found - logging to SPIFFS only");
-        global_sensor_data.sd_card_present = false;
+#endif
+#if FIRMWARE_UPDATE_ENABLED
+    firmware_update_init();         // Idle until a patch URL is posted
+#endif
+    if (!system_monitor_init()) {
+        return false;
     }
     
+    // The system task polls the card and the uplink replays its spool
+    xEventGroupWaitBits(boot_done, BOOT_DONE_SD, pdFALSE, pdTRUE, portMAX_DELAY);
+#if MQTT_ENABLED && WIFI_LINK_ENABLED
+    mqtt_uplink_init();
+#endif
+    create_tasks(BOOT_TIER_SERVICES);
+    boot_profile_end(BOOT_STAGE_TASKS);
     return true;
 }
 
 /**
- * @brief Create and start all FreeRTOS tasks
+ * @brief Hand a boot step to a worker, or run it here without the pool
+ */
+static void run_boot_job(job_fn_t job) {
+    if (!job_pool_submit(JOB_LANE_HIGH, job, NULL, 0)) {
+        job(NULL);
+    }
+}
+
+/**
+ * @brief Release classic BT's memory and ready the controller for BLE
+ */
+static void start_bluetooth_job(void* payload) {
+    boot_profile_begin(BOOT_STAGE_BLUETOOTH);
+    bluetooth_ready = ble_scan_prepare();
+    boot_profile_end(BOOT_STAGE_BLUETOOTH);
+    if (bluetooth_ready) {
+        LOGI(SYSTEM, "✅ Bluetooth initialized");
+    }
+    xEventGroupSetBits(boot_done, BOOT_DONE_BLUETOOTH);
+}
+
+/**
+ * @brief Mount the SD card, if any, and open the trace file on it
+ */
+static void mount_sd_job(void* payload) {
+    boot_profile_begin(BOOT_STAGE_SD);
+    if (sd_monitor_init()) {
+#if TRACE_LOG_ENABLED
+        trace_log_init();
+#endif
+    } else {
+        LOGW(SYSTEM, "⚠️  SD Card not found - logging to flash only");
+    }
+    boot_profile_end(BOOT_STAGE_SD);
+    xEventGroupSetBits(boot_done, BOOT_DONE_SD);
+}
+
+/**
+ * @brief Create and start the FreeRTOS tasks of one boot tier
+ * @param tier The tier that has just finished its init
  */
-void create_tasks(void) {
-    Serial.println("🚀 Creating FreeRTOS tasks...");
-    
-    // Create UI task (highest priority for smooth animations)
-    xTaskCreatePinnedToCore(
-        ui_task,                    // Task function
-        "UI_Task",                  // Task name
-        UI_TASK_STACK_SIZE,         // Stack size
-        NULL,                       // Parameters
-        UI_TASK_PRIORITY,           // Priority
-        &ui_task_handle,            // Task handle
-        1                           // Core 1 (APP CPU)
-    );
-    Serial.println("✅ UI Task created on Core 1");
-    
-    // Create AI inference task  
-    xTaskCreatePinnedToCore(
-        ai_task,
-        "AI_Task", 
-        AI_TASK_STACK_SIZE,
-        NULL,
-        AI_TASK_PRIORITY,
-        &ai_task_handle,
-        0                           // Core 0 (PRO CPU)
-    );
-    Serial.println("✅ AI Task created on Core 0");
-    
-    // Create network scanning task
-    xTaskCreatePinnedToCore(
-        scan_task,
-        "Scan_Task",
-        SCAN_TASK_STACK_SIZE, 
-        NULL,
-        SCAN_TASK_PRIORITY,
-        &scan_task_handle,
-        0                           // Core 0 (PRO CPU)
-    );
-    Serial.println("✅ Scan Task created on Core 0");
-    
-    // Create system monitoring task
-    xTaskCreatePinnedToCore(
-        system_task,
-        "System_Task",
-        SYSTEM_TASK_STACK_SIZE,
-        NULL, 
-        SYSTEM_TASK_PRIORITY,
-        &system_task_handle,
-        0                           // Core 0 (PRO CPU)  
-    );
-    Serial.println("✅ System Task created on Core 0");
-    
-    Serial.println("🎯 All tasks created successfully!");
-    Serial.println("📊 Task distribution:");
-    Serial.println("   Core 0 (PRO): AI, Scan, System tasks");
-    Serial.println("   Core 1 (APP): UI task");
+void create_tasks(boot_tier_t tier) {
+    LOGI(SYSTEM, "🚀 Creating tier %d FreeRTOS tasks...", tier);
+    
+#if SYSTEM_STACK_EXTERNAL
+    // Allocated once at boot and never freed; a flash write from this
+    // task would fault, as the cache and with it PSRAM go away meanwhile
+    StackType_t* system_stack = tier != BOOT_TIER_SERVICES ? NULL
+                              : (StackType_t*)heap_caps_malloc(SYSTEM_TASK_STACK_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    
+    // Every task, its placement, and what the monitors and the supervisor
+    // need to know about it; UI first so its handle exists for notifiers
+    // and its display init overlaps the rest of boot
+    const struct {
+        TaskFunction_t       entry;
+        const char*          name;
+        StackType_t*         stack;
+        StaticTask_t*        tcb;
+        uint32_t             stack_bytes;
+        UBaseType_t          priority;
+        int8_t               core;          // TASK_CORE_UNPINNED floats
+        bool                 enabled;
+        boot_tier_t          tier;          // Created at the end of this one
+        TaskHandle_t*        handle;
+        supervised_task_t    id;
+        uint32_t             budget_ms;
+        supervisor_recover_t recover;
+        loop_id_t            loop;          // Timed loop the priority tuner watches, LOOP_COUNT if none
+    } tasks[] = {
+        { ui_task,      "UI_Task",      ui_stack,      &ui_tcb,      UI_TASK_STACK_SIZE,      UI_TASK_PRIORITY,      UI_TASK_CORE,
+          true,                   BOOT_TIER_PANEL,    &ui_task_handle,      SUPERVISED_UI,      SUPERVISOR_LOOP_BUDGET_MS, NULL,             LOOP_UI },
+        { ai_task,      "AI_Task",      ai_stack,      &ai_tcb,      AI_TASK_STACK_SIZE,      AI_TASK_PRIORITY,      AI_TASK_CORE,
+          true,                   BOOT_TIER_FACE,     &ai_task_handle,      SUPERVISED_AI,      SUPERVISOR_LOOP_BUDGET_MS, NULL,             LOOP_AI },
+        { scan_task,    "Scan_Task",    scan_stack,    &scan_tcb,    SCAN_TASK_STACK_SIZE,    SCAN_TASK_PRIORITY,    SCAN_TASK_CORE,
+          true,                   BOOT_TIER_RADIOS,   &scan_task_handle,    SUPERVISED_SCAN,    SUPERVISOR_SCAN_BUDGET_MS, ble_scan_restart, LOOP_SCAN },
+        { system_task,  "System_Task",  system_stack,  &system_tcb,  SYSTEM_TASK_STACK_SIZE,  SYSTEM_TASK_PRIORITY,  SYSTEM_TASK_CORE,
+          true,                   BOOT_TIER_SERVICES, &system_task_handle,  SUPERVISED_SYSTEM,  SUPERVISOR_LOOP_BUDGET_MS, NULL,             LOOP_SYSTEM },
+        { capture_task, "Capture_Task", capture_stack, &capture_tcb, CAPTURE_TASK_STACK_SIZE, CAPTURE_TASK_PRIORITY, CAPTURE_TASK_CORE,
+          PACKET_CAPTURE_ENABLED, BOOT_TIER_RADIOS,   &capture_task_handle, SUPERVISED_CAPTURE, SUPERVISOR_LOOP_BUDGET_MS, NULL,             LOOP_CAPTURE },
+        { gps_task,     "GPS_Task",     gps_stack,     &gps_tcb,     GPS_TASK_STACK_SIZE,     GPS_TASK_PRIORITY,     GPS_TASK_CORE,
+          WARDRIVE_ENABLED,       BOOT_TIER_RADIOS,   &gps_task_handle,     SUPERVISED_GPS,     SUPERVISOR_LOOP_BUDGET_MS, NULL,             LOOP_COUNT }
+    };
+    const uint8_t task_count = sizeof(tasks) / sizeof(tasks[0]);
+    
+    for (uint8_t i = 0; i < task_count; i++) {
+        if (!tasks[i].enabled || tasks[i].tier != tier) {
+            continue;
+        }
+        if (tasks[i].stack == NULL) {
+            LOGE(SYSTEM, "❌ %s has no stack", tasks[i].name);
+            continue;
+        }
+        BaseType_t core = tasks[i].core == TASK_CORE_UNPINNED ? tskNO_AFFINITY : tasks[i].core;
+        *tasks[i].handle = xTaskCreateStaticPinnedToCore(tasks[i].entry, tasks[i].name, tasks[i].stack_bytes,
+                                                         NULL, tasks[i].priority, tasks[i].stack,
+                                                         tasks[i].tcb, core);
+        if (tasks[i].core == TASK_CORE_UNPINNED) {
+            LOGI(SYSTEM, "✅ %s created, unpinned", tasks[i].name);
+        } else {
+            LOGI(SYSTEM, "✅ %s created on Core %d", tasks[i].name, tasks[i].core);
+        }
+    }
+    
+    // Per-task CPU, stack and heap figures for the system report, liveness and priorities
+    static bool cpu_load = false;
+    if (tier == BOOT_TIER_PANEL) {
+        cpu_load = cpu_load_init();
+    }
+    for (uint8_t i = 0; i < task_count; i++) {
+        TaskHandle_t task = *tasks[i].handle;
+        if (task == NULL || tasks[i].tier != tier) {
+            continue;
+        }
+        if (cpu_load) {
+            cpu_load_watch(task);
+        }
+        task_monitor_watch(task, tasks[i].stack_bytes);
+#if SUPERVISOR_ENABLED
+        supervisor_register(tasks[i].id, task, tasks[i].stack_bytes,
+                            tasks[i].budget_ms, tasks[i].recover);
+#endif
+        if (tasks[i].loop != LOOP_COUNT) {
+            priority_tuner_register(tasks[i].loop, task, tasks[i].priority);
+        }
+    }
+    
+    if (tier != BOOT_TIER_SERVICES) {
+        return;
+    }
+    LOGI(SYSTEM, "🎯 All tasks created successfully!");
+    LOGI(SYSTEM, "📊 Task distribution:");
+    for (int8_t core = TASK_CORE_UNPINNED; core < 2; core++) {
+        char names[96] = "";
+        size_t length = 0;
+        for (uint8_t i = 0; i < task_count && length < sizeof(names); i++) {
+            if (tasks[i].enabled && tasks[i].core == core) {
+                length += snprintf(names + length, sizeof(names) - length, " %s", tasks[i].name);
+            }
+        }
+        if (core == TASK_CORE_UNPINNED) {
+            LOGI(SYSTEM, "   Either core:%s", names);
+        } else {
+            LOGI(SYSTEM, "   Core %d (%s):%s", core, core == 0 ? "PRO" : "APP", names);
+        }
+    }
 }
 
 // Task implementations are in separate files
 extern void ui_task(void* parameter);
 extern void ai_task(void* parameter);  
 extern void scan_task(void* parameter);
-extern void system_task(void* parameter);
\ No newline at end of file
+extern void system_task(void* parameter);
+extern void capture_task(void* parameter);
+extern void gps_task(void* parameter);
\ No newline at end of file
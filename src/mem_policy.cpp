@@ -0,0 +1,224 @@
+/**
+ * @file mem_policy.cpp
+ * @brief Allocation classes over heap_caps, with exact per-class accounting
+ *
+ * A class is a first choice of capabilities and an optional second. Hot
+ * data must stay in internal RAM, where a cache miss on PSRAM cannot
+ * stall it; bulk data should not crowd internal RAM, but may borrow some
+ * while plenty is left. Counting happens on the caller's side of
+ * heap_caps, under one spinlock, with the size the caller already knows:
+ * heap_caps_get_allocated_size() would report the heap's rounded block,
+ * and cannot be given an aligned allocation's pointer at all.
+ */
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <soc/soc_memory_layout.h>
+#include "config.h"
+#include "mem_policy.h"
+
+/**
+ * @brief Where a class looks, in order
+ */
+typedef struct {
+    const char* name;
+    uint32_t    first;
+    uint32_t    second;             // 0: no second choice
+    uint32_t    second_reserve;     // Internal bytes the second choice must leave free
+} mem_class_policy_t;
+
+// In mem_class_t order
+static const mem_class_policy_t policies[MEM_CLASSES] = {
+    { "hot_dma", MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL, 0, 0 },
+    { "hot_cpu", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, 0 },
+    { "bulk", MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+      MEM_BULK_INTERNAL_RESERVE },
+    { "cache", MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, 0, 0 },
+};
+
+static mem_class_stats_t stats[MEM_CLASSES];
+static mem_arena_t* arenas[MEM_ARENAS_MAX];
+static uint8_t arena_count = 0;
+static portMUX_TYPE policy_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void* place(mem_class_t mem_class, size_t alignment, size_t size);
+static void count_alloc(mem_class_t mem_class, void* ptr, size_t size, bool fallback);
+
+/**
+ * @brief Set plain malloc()'s PSRAM threshold
+ */
+void mem_policy_init(void) {
+#if CONFIG_SPIRAM_USE_MALLOC
+    // Below this malloc() stays internal; above it PSRAM is tried first
+    heap_caps_malloc_extmem_enable(MEM_MALLOC_INTERNAL_MAX);
+#endif
+}
+
+/**
+ * @brief Allocate for a class
+ */
+void* mem_alloc(mem_class_t mem_class, size_t size) {
+    return place(mem_class, 0, size);
+}
+
+/**
+ * @brief Zeroed mem_alloc()
+ */
+void* mem_calloc(mem_class_t mem_class, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void* ptr = place(mem_class, 0, count * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+/**
+ * @brief mem_alloc() at an alignment
+ */
+void* mem_aligned_alloc(mem_class_t mem_class, size_t alignment, size_t size) {
+    return place(mem_class, alignment, size);
+}
+
+/**
+ * @brief Free a block and take it off its class
+ */
+void mem_free(mem_class_t mem_class, void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    bool external = esp_ptr_external_ram(ptr);
+    portENTER_CRITICAL(&policy_mux);
+    mem_class_stats_t* s = &stats[mem_class];
+    s->live_bytes -= size;
+    s->live_blocks--;
+    if (external) {
+        s->psram_bytes -= size;
+    } else {
+        s->internal_bytes -= size;
+    }
+    portEXIT_CRITICAL(&policy_mux);
+    heap_caps_free(ptr);
+}
+
+/**
+ * @brief Copy one class's figures
+ */
+void mem_policy_get(mem_class_t mem_class, mem_class_stats_t* out) {
+    portENTER_CRITICAL(&policy_mux);
+    *out = stats[mem_class];
+    portEXIT_CRITICAL(&policy_mux);
+    out->name = policies[mem_class].name;
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* mem_class_name(mem_class_t mem_class) {
+    return mem_class < MEM_CLASSES ? policies[mem_class].name : "?";
+}
+
+/**
+ * @brief Take an arena's block and list it
+ */
+bool mem_arena_init(mem_arena_t* arena, const char* name, mem_class_t mem_class, size_t size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->name = name;
+    arena->mem_class = mem_class;
+    if (arena_count >= MEM_ARENAS_MAX) {
+        return false;
+    }
+    arena->base = (uint8_t*)mem_aligned_alloc(mem_class, 16, size);
+    if (arena->base == NULL) {
+        return false;
+    }
+    arena->size = size;
+    portENTER_CRITICAL(&policy_mux);
+    arenas[arena_count++] = arena;
+    portEXIT_CRITICAL(&policy_mux);
+    return true;
+}
+
+/**
+ * @brief Bump-allocate from an arena
+ */
+void* mem_arena_alloc(mem_arena_t* arena, size_t size, size_t alignment) {
+    uint32_t start = (arena->used + alignment - 1) & ~(uint32_t)(alignment - 1);
+    if (arena->base == NULL || start + size > arena->size) {
+        arena->overflows++;
+        return NULL;
+    }
+    arena->used = start + size;
+    arena->peak = max(arena->peak, arena->used);
+    return arena->base + start;
+}
+
+/**
+ * @brief Empty an arena
+ */
+void mem_arena_reset(mem_arena_t* arena) {
+    arena->last = arena->used;
+    arena->used = 0;
+    arena->resets++;
+}
+
+/**
+ * @brief Copy a listed arena
+ */
+bool mem_arena_get(uint8_t index, mem_arena_t* out) {
+    portENTER_CRITICAL(&policy_mux);
+    bool found = index < arena_count;
+    if (found) {
+        *out = *arenas[index];
+    }
+    portEXIT_CRITICAL(&policy_mux);
+    return found;
+}
+
+/**
+ * @brief Try the class's first choice, then its second if the reserve allows
+ */
+static void* place(mem_class_t mem_class, size_t alignment, size_t size) {
+    const mem_class_policy_t* policy = &policies[mem_class];
+    void* ptr = alignment > 0 ? heap_caps_aligned_alloc(alignment, size, policy->first)
+                              : heap_caps_malloc(size, policy->first);
+    bool fallback = false;
+    if (ptr == NULL && policy->second != 0 &&
+        (policy->second_reserve == 0 ||
+         heap_caps_get_free_size(MALLOC_CAP_INTERNAL) >= size + policy->second_reserve)) {
+        ptr = alignment > 0 ? heap_caps_aligned_alloc(alignment, size, policy->second)
+                            : heap_caps_malloc(size, policy->second);
+        fallback = ptr != NULL;
+    }
+    count_alloc(mem_class, ptr, size, fallback);
+    return ptr;
+}
+
+/**
+ * @brief Add a block, or a failure, to its class
+ */
+static void count_alloc(mem_class_t mem_class, void* ptr, size_t size, bool fallback) {
+    bool external = ptr != NULL && esp_ptr_external_ram(ptr);
+    portENTER_CRITICAL(&policy_mux);
+    mem_class_stats_t* s = &stats[mem_class];
+    if (ptr == NULL) {
+        s->failures++;
+    } else {
+        s->allocs++;
+        s->live_blocks++;
+        s->live_bytes += size;
+        s->peak_bytes = max(s->peak_bytes, s->live_bytes);
+        if (external) {
+            s->psram_bytes += size;
+        } else {
+            s->internal_bytes += size;
+        }
+        if (fallback) {
+            s->fallbacks++;
+        }
+    }
+    portEXIT_CRITICAL(&policy_mux);
+}
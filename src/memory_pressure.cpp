@@ -0,0 +1,171 @@
+/**
+ * @file memory_pressure.cpp
+ * @brief Tiered heap pressure levels and the shrinkers that answer them
+ *
+ * Most of the firmware's tables are allocated once at boot and give
+ * nothing back; what can be freed belongs to a few subsystems that can
+ * rebuild it later. They register a shrink callback, and when the
+ * internal heap crosses a threshold the system task asks them, cheapest
+ * to rebuild first, until the heap is back above it. What each returned
+ * is kept, so a shrinker that never frees anything shows in the report.
+ */
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "config.h"
+#include "memory_pressure.h"
+#include "logger.h"
+
+typedef struct {
+    memory_shrinker_stats_t stats;
+    memory_shrink_t         shrink;
+} shrinker_t;
+
+static const char* const level_names[MEMORY_PRESSURE_LEVELS] = {
+    "none", "low", "high", "critical"
+};
+
+// In registration order, which is also each shrinker's id
+static shrinker_t shrinkers[MEMORY_SHRINKERS_MAX];
+static volatile uint8_t shrinker_count = 0;
+static memory_pressure_t answered = MEMORY_PRESSURE_NONE;
+static uint32_t answered_ms = 0;
+static portMUX_TYPE shrinkers_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static uint8_t priority_order(uint8_t* order);
+
+/**
+ * @brief Register a shrinker
+ */
+int8_t memory_pressure_register(const char* name, uint8_t priority,
+                                memory_pressure_t min_level, memory_shrink_t shrink) {
+    if (shrink == NULL) {
+        return -1;
+    }
+    portENTER_CRITICAL(&shrinkers_mux);
+    if (shrinker_count == MEMORY_SHRINKERS_MAX) {
+        portEXIT_CRITICAL(&shrinkers_mux);
+        return -1;
+    }
+    int8_t id = shrinker_count;
+    shrinker_t* entry = &shrinkers[id];
+    memset(entry, 0, sizeof(*entry));
+    entry->stats.name = name;
+    entry->stats.priority = priority;
+    entry->stats.min_level = min_level;
+    entry->shrink = shrink;
+    shrinker_count++;               // Published last: the entry is complete once counted
+    portEXIT_CRITICAL(&shrinkers_mux);
+    return id;
+}
+
+/**
+ * @brief Credit bytes a shrinker freed after it returned
+ */
+void memory_pressure_credit(int8_t shrinker, size_t bytes) {
+    if (shrinker < 0 || shrinker >= shrinker_count) {
+        return;
+    }
+    portENTER_CRITICAL(&shrinkers_mux);
+    shrinkers[shrinker].stats.reclaimed_bytes += bytes;
+    portEXIT_CRITICAL(&shrinkers_mux);
+}
+
+/**
+ * @brief Pressure level of the internal heap right now
+ */
+memory_pressure_t memory_pressure_level(void) {
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    if (free_bytes >= MEMORY_PRESSURE_LOW_BYTES) {
+        return MEMORY_PRESSURE_NONE;
+    }
+    if (free_bytes < LOW_MEMORY_THRESHOLD ||
+        heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL) < HEAP_LARGEST_CRITICAL) {
+        return MEMORY_PRESSURE_CRITICAL;
+    }
+    return free_bytes < MEMORY_PRESSURE_HIGH_BYTES ? MEMORY_PRESSURE_HIGH : MEMORY_PRESSURE_LOW;
+}
+
+/**
+ * @brief Ask shrinkers for memory if the heap is under pressure
+ */
+memory_pressure_t memory_pressure_respond(uint32_t now_ms) {
+    memory_pressure_t level = memory_pressure_level();
+    if (level == MEMORY_PRESSURE_NONE ||
+        (level <= answered && now_ms - answered_ms < MEMORY_PRESSURE_COOLDOWN_MS)) {
+        if (level == MEMORY_PRESSURE_NONE) {
+            answered = MEMORY_PRESSURE_NONE;
+        }
+        return level;
+    }
+    answered = level;
+    answered_ms = now_ms;
+
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    LOGI(SYSTEM, "🧹 Memory pressure %s: %u bytes free, asking shrinkers",
+         memory_pressure_name(level), (unsigned)free_before);
+
+    uint8_t order[MEMORY_SHRINKERS_MAX];
+    uint8_t count = priority_order(order);
+    memory_pressure_t now = level;
+    for (uint8_t i = 0; i < count && now >= level; i++) {
+        shrinker_t* entry = &shrinkers[order[i]];
+        if (level < entry->stats.min_level) {
+            continue;
+        }
+        size_t freed = entry->shrink(level);
+        portENTER_CRITICAL(&shrinkers_mux);
+        entry->stats.calls++;
+        entry->stats.reclaimed_bytes += freed;
+        portEXIT_CRITICAL(&shrinkers_mux);
+        if (freed > 0) {
+            LOGI(SYSTEM, "🧹   %s: %u bytes", entry->stats.name, (unsigned)freed);
+        }
+        now = memory_pressure_level();
+    }
+
+    LOGI(SYSTEM, "🧹 Memory after cleanup: %u bytes free (%s)",
+         (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+         memory_pressure_name(now));
+    return level;
+}
+
+/**
+ * @brief Copy out the shrinkers in priority order
+ */
+uint8_t memory_pressure_get(memory_shrinker_stats_t* out, uint8_t max) {
+    uint8_t order[MEMORY_SHRINKERS_MAX];
+    uint8_t count = min(priority_order(order), max);
+    portENTER_CRITICAL(&shrinkers_mux);
+    for (uint8_t i = 0; i < count; i++) {
+        out[i] = shrinkers[order[i]].stats;
+    }
+    portEXIT_CRITICAL(&shrinkers_mux);
+    return count;
+}
+
+/**
+ * @brief Short name for logs
+ */
+const char* memory_pressure_name(memory_pressure_t level) {
+    return level < MEMORY_PRESSURE_LEVELS ? level_names[level] : "?";
+}
+
+/**
+ * @brief Ids of the registered shrinkers, lowest priority value first,
+ *        registration order among equals
+ * @return Number of ids written
+ */
+static uint8_t priority_order(uint8_t* order) {
+    uint8_t count = shrinker_count;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t slot = i;
+        while (slot > 0 && shrinkers[order[slot - 1]].stats.priority > shrinkers[i].stats.priority) {
+            order[slot] = order[slot - 1];
+            slot--;
+        }
+        order[slot] = i;
+    }
+    return count;
+}
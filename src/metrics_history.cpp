@@ -0,0 +1,424 @@
+/**
+ * @file metrics_history.cpp
+ * @brief Multi-resolution history of the system metrics and scan counts
+ *
+ * Every sample goes into the seconds ring and into a running minute rollup;
+ * a closed minute goes into the minutes ring and into a running quarter
+ * rollup. Rollups keep min, max and a sample-weighted sum, so a quarter
+ * is exact without rereading the minutes it spans. The rings are in PSRAM
+ * and queried from memory; only closed minute and quarter points are
+ * appended to the card, a batch every HISTORY_FLUSH_INTERVAL_MS.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "metrics_history.h"
+#include "mem_policy.h"
+#include "log_manager.h"
+#include "logger.h"
+
+typedef struct {
+    history_point_t* points;
+    uint16_t         capacity;
+    uint16_t         next;
+    uint16_t         count;
+    uint32_t         written;       // Points ever added
+    uint32_t         flushed;       // ...and of those, on the card or overwritten unsaved
+} tier_ring_t;
+
+typedef struct {
+    int32_t  min;
+    int32_t  max;
+    int64_t  sum;
+} accumulator_t;
+
+typedef struct {
+    accumulator_t metrics[METRIC_COUNT];
+    uint32_t      samples;
+    uint32_t      start_ms;         // First sample's millis()
+} rollup_t;
+
+static const uint16_t tier_points[HISTORY_TIER_COUNT] = {
+    HISTORY_SECONDS_POINTS, HISTORY_MINUTES_POINTS, HISTORY_QUARTERS_POINTS
+};
+static const uint32_t tier_interval_ms[HISTORY_TIER_COUNT] = {
+    SYSTEM_MONITOR_INTERVAL, 60UL * 1000, 15UL * 60 * 1000
+};
+
+// In metric_id_t order
+static const char* const metric_names[METRIC_COUNT] = {
+    "free_heap", "free_psram", "min_free_heap", "heap_largest_free", "heap_frag_pct",
+    "temperature_dc", "thermal_level", "task_count", "cpu_pct", "cpu0_pct", "cpu1_pct",
+    "wifi_connected", "sd_mounted", "lvgl_used_pct", "lvgl_frag_pct", "lvgl_used_bytes",
+    "lvgl_peak_bytes", "lvgl_largest_free", "wifi_networks", "wifi_clients", "ble_devices"
+};
+
+static tier_ring_t rings[HISTORY_TIER_COUNT];
+static rollup_t rollups[HISTORY_TIER_COUNT];   // Seconds unused; [t] builds tier t's next point
+static SemaphoreHandle_t rings_lock = NULL;
+static StaticSemaphore_t rings_lock_state;
+static uint32_t last_flush_ms = 0;
+static char file_path[48] = "";                 // This boot's file, once the first flush opened it
+static uint32_t file_bytes = 0;
+static uint16_t segment = 0;
+static uint32_t opened_ms = 0;
+
+// Forward declarations
+static void add_point(history_tier_t tier, const history_point_t* point);
+static void merge(rollup_t* into, const history_point_t* point);
+static void close_rollup(history_tier_t tier, uint32_t end_ms);
+static void flush_to_card(void);
+static bool open_next_file(File* file);
+
+/**
+ * @brief Allocate the rings in PSRAM
+ */
+bool metrics_history_init(void) {
+    if (rings_lock != NULL) {
+        return true;
+    }
+    for (uint8_t tier = 0; tier < HISTORY_TIER_COUNT; tier++) {
+        rings[tier].points = (history_point_t*)mem_alloc(MEM_BULK, tier_points[tier] * sizeof(history_point_t));
+        if (rings[tier].points == NULL) {
+            for (uint8_t i = 0; i <= tier; i++) {
+                mem_free(MEM_BULK, rings[i].points, tier_points[i] * sizeof(history_point_t));
+                rings[i].points = NULL;
+            }
+            LOGW(SYSTEM, "⚠️  No PSRAM for the metrics history - history disabled");
+            return false;
+        }
+        rings[tier].capacity = tier_points[tier];
+    }
+    rings_lock = xSemaphoreCreateMutexStatic(&rings_lock_state);
+    LOGI(SYSTEM, "✅ Metrics history: %u/%u/%u points, %u KB of PSRAM",
+         HISTORY_SECONDS_POINTS, HISTORY_MINUTES_POINTS, HISTORY_QUARTERS_POINTS,
+         (unsigned)((HISTORY_SECONDS_POINTS + HISTORY_MINUTES_POINTS + HISTORY_QUARTERS_POINTS) *
+                    sizeof(history_point_t) / 1024));
+    return true;
+}
+
+/**
+ * @brief Add one sample of every metric and roll up closed intervals
+ */
+void metrics_history_record(uint32_t now_ms, const system_metrics_t* metrics,
+                            const sensor_data_t* scan) {
+    if (rings_lock == NULL) {
+        return;
+    }
+
+    int32_t values[METRIC_COUNT];
+    values[METRIC_FREE_HEAP] = metrics->free_heap_size;
+    values[METRIC_FREE_PSRAM] = metrics->free_psram_size;
+    values[METRIC_MIN_FREE_HEAP] = metrics->min_free_heap;
+    values[METRIC_HEAP_LARGEST_FREE] = metrics->heap_largest_free;
+    values[METRIC_HEAP_FRAG_PCT] = metrics->heap_frag_pct;
+    values[METRIC_TEMPERATURE_DECI_C] = (int32_t)lroundf(metrics->temperature_celsius * 10);
+    values[METRIC_THERMAL_LEVEL] = metrics->thermal_level;
+    values[METRIC_TASK_COUNT] = metrics->task_count;
+    values[METRIC_CPU_PCT] = metrics->cpu_usage_percent;
+    values[METRIC_CPU0_PCT] = metrics->cpu_core_percent[0];
+    values[METRIC_CPU1_PCT] = metrics->cpu_core_percent[1];
+    values[METRIC_WIFI_CONNECTED] = metrics->wifi_connected;
+    values[METRIC_SD_MOUNTED] = metrics->sd_card_mounted;
+    values[METRIC_LVGL_USED_PCT] = metrics->lvgl_used_pct;
+    values[METRIC_LVGL_FRAG_PCT] = metrics->lvgl_frag_pct;
+    values[METRIC_LVGL_USED_BYTES] = metrics->lvgl_used_bytes;
+    values[METRIC_LVGL_PEAK_BYTES] = metrics->lvgl_peak_bytes;
+    values[METRIC_LVGL_LARGEST_FREE] = metrics->lvgl_largest_free;
+    values[METRIC_WIFI_NETWORKS] = scan->wifi_networks_count;
+    values[METRIC_WIFI_CLIENTS] = scan->wifi_clients_count;
+    values[METRIC_BLE_DEVICES] = scan->ble_devices_count;
+
+    history_point_t point;
+    point.end_ms = now_ms;
+    point.samples = 1;
+    point.tier = HISTORY_TIER_SECONDS;
+    point.reserved = 0;
+    for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+        point.values[m].min = point.values[m].avg = point.values[m].max = values[m];
+    }
+    add_point(HISTORY_TIER_SECONDS, &point);
+
+    // A minute closes on the first sample at or past its length, then feeds the quarter
+    merge(&rollups[HISTORY_TIER_MINUTES], &point);
+    if (now_ms - rollups[HISTORY_TIER_MINUTES].start_ms + tier_interval_ms[HISTORY_TIER_SECONDS] >=
+        tier_interval_ms[HISTORY_TIER_MINUTES]) {
+        close_rollup(HISTORY_TIER_MINUTES, now_ms);
+    }
+
+    if (now_ms - last_flush_ms >= HISTORY_FLUSH_INTERVAL_MS) {
+        last_flush_ms = now_ms;
+        flush_to_card();
+    }
+}
+
+/**
+ * @brief Copy the newest points of one metric, oldest first
+ */
+uint16_t metrics_history_query(history_tier_t tier, metric_id_t metric,
+                               metric_rollup_t* out, uint16_t max, uint32_t* newest_ms) {
+    if (rings_lock == NULL || tier >= HISTORY_TIER_COUNT || metric >= METRIC_COUNT) {
+        return 0;
+    }
+    const tier_ring_t* ring = &rings[tier];
+    xSemaphoreTake(rings_lock, portMAX_DELAY);
+    uint16_t count = min(ring->count, max);
+    uint16_t first = (ring->next + ring->capacity - count) % ring->capacity;
+    for (uint16_t i = 0; i < count; i++) {
+        out[i] = ring->points[(first + i) % ring->capacity].values[metric];
+    }
+    if (count > 0 && newest_ms != NULL) {
+        *newest_ms = ring->points[(ring->next + ring->capacity - 1) % ring->capacity].end_ms;
+    }
+    xSemaphoreGive(rings_lock);
+    return count;
+}
+
+/**
+ * @brief Copy points of one metric that ended after a time, oldest first
+ */
+uint16_t metrics_history_read_after(history_tier_t tier, metric_id_t metric, uint32_t after_ms,
+                                    metric_rollup_t* out, uint32_t* end_ms, uint16_t max) {
+    if (rings_lock == NULL || tier >= HISTORY_TIER_COUNT || metric >= METRIC_COUNT) {
+        return 0;
+    }
+    const tier_ring_t* ring = &rings[tier];
+    xSemaphoreTake(rings_lock, portMAX_DELAY);
+    uint16_t oldest = (ring->next + ring->capacity - ring->count) % ring->capacity;
+
+    // end_ms rises from oldest to newest: find the first point past after_ms
+    uint16_t low = 0, high = ring->count;
+    while (low < high) {
+        uint16_t mid = (low + high) / 2;
+        if ((int32_t)(ring->points[(oldest + mid) % ring->capacity].end_ms - after_ms) > 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    uint16_t count = min((uint16_t)(ring->count - low), max);
+    for (uint16_t i = 0; i < count; i++) {
+        const history_point_t* point = &ring->points[(oldest + low + i) % ring->capacity];
+        out[i] = point->values[metric];
+        end_ms[i] = point->end_ms;
+    }
+    xSemaphoreGive(rings_lock);
+    return count;
+}
+
+/**
+ * @brief after_ms that makes metrics_history_read_after() start at the newest count points
+ */
+uint32_t metrics_history_newest_after(history_tier_t tier, uint16_t count) {
+    if (rings_lock == NULL || tier >= HISTORY_TIER_COUNT) {
+        return 0;
+    }
+    const tier_ring_t* ring = &rings[tier];
+    xSemaphoreTake(rings_lock, portMAX_DELAY);
+    uint32_t after_ms = 0;
+    if (ring->count > 0) {
+        uint16_t back = min(count, ring->count);
+        // Just short of the first wanted point's end
+        uint16_t first = (ring->next + ring->capacity - back) % ring->capacity;
+        after_ms = ring->points[first].end_ms - 1;
+    }
+    xSemaphoreGive(rings_lock);
+    return after_ms;
+}
+
+/**
+ * @brief Points a tier holds right now
+ */
+uint16_t metrics_history_count(history_tier_t tier) {
+    return tier < HISTORY_TIER_COUNT ? rings[tier].count : 0;
+}
+
+/**
+ * @brief Length of a tier's intervals
+ */
+uint32_t metrics_history_interval_ms(history_tier_t tier) {
+    return tier < HISTORY_TIER_COUNT ? tier_interval_ms[tier] : 0;
+}
+
+/**
+ * @brief Short name for logs and the web UI
+ */
+const char* metrics_history_name(metric_id_t metric) {
+    return metric < METRIC_COUNT ? metric_names[metric] : "?";
+}
+
+/**
+ * @brief Metric with that name, METRIC_COUNT if none
+ */
+metric_id_t metrics_history_find(const char* name) {
+    for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+        if (strcmp(name, metric_names[m]) == 0) {
+            return (metric_id_t)m;
+        }
+    }
+    return METRIC_COUNT;
+}
+
+/**
+ * @brief Append a point to a tier's ring, replacing the oldest once full
+ */
+static void add_point(history_tier_t tier, const history_point_t* point) {
+    tier_ring_t* ring = &rings[tier];
+    xSemaphoreTake(rings_lock, portMAX_DELAY);
+    ring->points[ring->next] = *point;
+    ring->next = (ring->next + 1) % ring->capacity;
+    if (ring->count < ring->capacity) {
+        ring->count++;
+    }
+    ring->written++;
+    xSemaphoreGive(rings_lock);
+}
+
+/**
+ * @brief Fold a point, of any tier, into a running rollup
+ */
+static void merge(rollup_t* into, const history_point_t* point) {
+    bool first = into->samples == 0;
+    if (first) {
+        into->start_ms = point->end_ms;
+    }
+    for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+        accumulator_t* acc = &into->metrics[m];
+        const metric_rollup_t* value = &point->values[m];
+        acc->min = first ? value->min : min(acc->min, value->min);
+        acc->max = first ? value->max : max(acc->max, value->max);
+        acc->sum = (first ? 0 : acc->sum) + (int64_t)value->avg * point->samples;
+    }
+    into->samples += point->samples;
+}
+
+/**
+ * @brief Turn a tier's running rollup into its next point, and feed the tier above
+ */
+static void close_rollup(history_tier_t tier, uint32_t end_ms) {
+    rollup_t* rollup = &rollups[tier];
+    if (rollup->samples == 0) {
+        return;
+    }
+    history_point_t point;
+    point.end_ms = end_ms;
+    point.samples = (uint16_t)min(rollup->samples, (uint32_t)UINT16_MAX);
+    point.tier = tier;
+    point.reserved = 0;
+    for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+        point.values[m].min = rollup->metrics[m].min;
+        point.values[m].max = rollup->metrics[m].max;
+        point.values[m].avg = (int32_t)(rollup->metrics[m].sum / (int64_t)rollup->samples);
+    }
+    rollup->samples = 0;
+    add_point(tier, &point);
+
+    history_tier_t above = (history_tier_t)(tier + 1);
+    if (above == HISTORY_TIER_COUNT) {
+        return;
+    }
+    merge(&rollups[above], &point);
+    if (end_ms - rollups[above].start_ms + tier_interval_ms[tier] >= tier_interval_ms[above]) {
+        close_rollup(above, end_ms);
+    }
+}
+
+/**
+ * @brief Append the minute and quarter points added since the last flush
+ *
+ * Runs on the system task, the only writer, so the rings are read without
+ * the lock. Points overwritten before a card came back are skipped.
+ */
+static void flush_to_card(void) {
+    if (!sd_monitor_mounted()) {
+        return;
+    }
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file;
+    if (file_path[0] != '\0' && file_bytes < HISTORY_MAX_FILE_BYTES &&
+        millis() - opened_ms < LOG_SEGMENT_MAX_MS) {
+        file = SD.open(file_path, "a");
+    }
+    if (!file) {
+        open_next_file(&file);      // First flush, file full or old, or the card was replaced
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!file) {
+        return;
+    }
+
+    uint32_t points = 0;
+    uint32_t start = file_bytes;
+    uint32_t first_ms = UINT32_MAX;
+    uint32_t last_ms = 0;
+    bool failed = false;
+    for (uint8_t tier = HISTORY_TIER_MINUTES; tier < HISTORY_TIER_COUNT && !failed; tier++) {
+        tier_ring_t* ring = &rings[tier];
+        ring->flushed = max(ring->flushed, ring->written - ring->count);
+        while (ring->flushed < ring->written) {
+            uint32_t age = ring->written - ring->flushed;   // 1 for the newest point
+            const history_point_t* point =
+                &ring->points[(ring->next + ring->capacity - age) % ring->capacity];
+            spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+            size_t written = file.write((const uint8_t*)point, sizeof(*point));
+            spi_bus_release(SPI_DEVICE_SD);
+            if (written != sizeof(*point)) {
+                LOGW(SYSTEM, "⚠️  History write failed");
+                failed = true;
+                break;
+            }
+            ring->flushed++;
+            file_bytes += sizeof(*point);
+            first_ms = min(first_ms, point->end_ms);
+            last_ms = max(last_ms, point->end_ms);
+            points++;
+        }
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    file.close();
+    spi_bus_release(SPI_DEVICE_SD);
+    if (points > 0) {
+        log_manager_note(LOG_SEGMENT_METRICS, segment, start, first_ms, last_ms);
+        LOGI(SYSTEM, "📈 %lu history points flushed to %s", points, file_path);
+    }
+}
+
+/**
+ * @brief Create the next TRACE_LOG_DIR/metrics_NNNN.hmh and write its header
+ *
+ * The caller holds the SD card's bus.
+ */
+static bool open_next_file(File* file) {
+    if (!SD.exists(TRACE_LOG_DIR) && !SD.mkdir(TRACE_LOG_DIR)) {
+        return false;
+    }
+    char path[sizeof(file_path)];
+    segment = log_manager_next_segment(LOG_SEGMENT_METRICS);
+    log_manager_segment_path(LOG_SEGMENT_METRICS, segment, path, sizeof(path));
+    *file = SD.open(path, "w");
+    if (!*file) {
+        return false;
+    }
+
+    history_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = HISTORY_FILE_MAGIC;
+    header.format = HISTORY_FILE_FORMAT;
+    header.point_bytes = sizeof(history_point_t);
+    header.metric_count = METRIC_COUNT;
+    header.boot_ms = millis();
+    file->write((const uint8_t*)&header, sizeof(header));
+    file_bytes = sizeof(header);
+    opened_ms = millis();
+    log_manager_opened(LOG_SEGMENT_METRICS, segment);
+
+    strlcpy(file_path, path, sizeof(file_path));
+    LOGI(SYSTEM, "📈 Metrics history to %s", path);
+    return true;
+}
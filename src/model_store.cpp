@@ -0,0 +1,396 @@
+/**
+ * @file model_store.cpp
+ * @brief Two A/B model slots in dedicated data partitions
+ *
+ * Each slot is a header sector followed by the model bytes. Uploads always
+ * go to the slot that is not the newest committed one, and the header is
+ * written only after the bytes read back with the expected CRC-32 and
+ * pass the flatbuffer verifier, so the model in force is never partially
+ * overwritten or replaced by one that cannot be parsed. The newest valid
+ * header wins at boot.
+ */
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "model_store.h"
+#include "ai_inference.h"
+#include "logger.h"
+
+#define MODEL_SLOT_MAGIC        0x4C444D48  // "HMDL"
+#define MODEL_SLOT_FORMAT       1
+#define MODEL_SLOT_SECTOR       4096
+#define MODEL_SLOT_DATA_OFFSET  MODEL_SLOT_SECTOR   // Header sector, then model bytes
+
+/**
+ * @brief On-flash slot header
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t reserved;
+    uint32_t generation;
+    uint32_t length;
+    uint32_t crc32;                 // Of the model bytes
+    uint32_t header_crc32;          // Of the fields above
+} model_slot_header_t;
+
+static const esp_partition_t* partitions[2] = { NULL, NULL };
+static SemaphoreHandle_t store_lock = NULL;
+static StaticSemaphore_t store_lock_state;
+static model_slot_info_t active;
+static model_slot_info_t pending;
+static bool pending_valid = false;
+static model_store_stats_t stats;
+
+// Open upload (only touched by the uploading task)
+static uint8_t write_slot = 0;
+static uint32_t write_length = 0;
+static uint32_t write_offset = 0;
+static uint32_t write_crc = 0;
+
+// Forward declarations
+static bool read_header(uint8_t slot, model_slot_info_t* info);
+static bool crc_of_slot(uint8_t slot, uint32_t length, uint32_t* crc);
+static bool verify_slot(uint8_t slot, uint32_t length);
+
+/**
+ * @brief Find the two model partitions and the newest committed slot
+ */
+bool model_store_init(void) {
+    partitions[0] = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                             (esp_partition_subtype_t)MODEL_PARTITION_SUBTYPE,
+                                             MODEL_SLOT0_LABEL);
+    partitions[1] = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                             (esp_partition_subtype_t)MODEL_PARTITION_SUBTYPE,
+                                             MODEL_SLOT1_LABEL);
+    if (store_lock == NULL) {
+        store_lock = xSemaphoreCreateMutexStatic(&store_lock_state);
+    }
+    memset(&active, 0, sizeof(active));
+    memset(&stats, 0, sizeof(stats));
+
+    if (partitions[0] == NULL || partitions[1] == NULL) {
+        LOGW(AI, "⚠️  No model slots in the partition table - OTA model updates disabled");
+        partitions[0] = partitions[1] = NULL;
+        return false;
+    }
+
+    uint32_t size = min(partitions[0]->size, partitions[1]->size);
+    stats.slot_capacity = size - MODEL_SLOT_DATA_OFFSET;
+
+    model_slot_info_t slot_info[2];
+    bool valid0 = read_header(0, &slot_info[0]);
+    bool valid1 = read_header(1, &slot_info[1]);
+    if (valid0 && (!valid1 || slot_info[0].generation >= slot_info[1].generation)) {
+        active = slot_info[0];
+    } else if (valid1) {
+        active = slot_info[1];
+    }
+
+    if (active.valid) {
+        LOGI(AI, "✅ Model slot %d: generation %lu, %lu bytes",
+             active.slot, active.generation, active.length);
+    }
+    return true;
+}
+
+/**
+ * @brief Newest committed slot
+ */
+bool model_store_active(model_slot_info_t* info) {
+    if (store_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    *info = active;
+    xSemaphoreGive(store_lock);
+    return info->valid;
+}
+
+/**
+ * @brief Read model bytes out of a committed slot
+ */
+bool model_store_read(const model_slot_info_t* info, uint32_t offset, void* dst, uint32_t length) {
+    if (info == NULL || !info->valid || partitions[info->slot] == NULL ||
+        offset + length > info->length) {
+        return false;
+    }
+    return esp_partition_read(partitions[info->slot], MODEL_SLOT_DATA_OFFSET + offset,
+                              dst, length) == ESP_OK;
+}
+
+/**
+ * @brief Start writing a model of the given size into the slot not in use
+ */
+bool model_store_begin(uint32_t length) {
+    if (store_lock == NULL || length == 0 || length > stats.slot_capacity) {
+        stats.updates_rejected++;
+        return false;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    bool busy = stats.writing;
+    if (!busy) {
+        stats.writing = true;
+        write_slot = active.valid ? (uint8_t)(active.slot ^ 1) : 0;
+    }
+    xSemaphoreGive(store_lock);
+    if (busy) {
+        return false;
+    }
+
+    // Invalidate the target first so a half-written slot never looks committed
+    if (esp_partition_erase_range(partitions[write_slot], 0, MODEL_SLOT_SECTOR) != ESP_OK) {
+        model_store_abort();
+        stats.updates_rejected++;
+        return false;
+    }
+
+    write_length = length;
+    write_offset = 0;
+    write_crc = 0;
+    return true;
+}
+
+/**
+ * @brief Append the next chunk of the model
+ */
+bool model_store_write(const uint8_t* data, uint32_t length) {
+    if (!stats.writing || write_offset + length > write_length) {
+        return false;
+    }
+
+    const esp_partition_t* part = partitions[write_slot];
+    uint32_t start = MODEL_SLOT_DATA_OFFSET + write_offset;
+    uint32_t end = start + length;
+
+    // Erase each sector the first time the write reaches it; the sector
+    // holding start was erased by the previous chunk unless start opens it
+    uint32_t erased_end = (start + MODEL_SLOT_SECTOR - 1) & ~(uint32_t)(MODEL_SLOT_SECTOR - 1);
+    while (erased_end < end) {
+        if (esp_partition_erase_range(part, erased_end, MODEL_SLOT_SECTOR) != ESP_OK) {
+            return false;
+        }
+        erased_end += MODEL_SLOT_SECTOR;
+    }
+
+    if (esp_partition_write(part, start, data, length) != ESP_OK) {
+        return false;
+    }
+    write_crc = esp_rom_crc32_le(write_crc, data, length);
+    write_offset += length;
+    return true;
+}
+
+/**
+ * @brief Verify the written model against its CRC-32 and commit it
+ */
+bool model_store_finish(uint32_t expected_crc32) {
+    if (!stats.writing) {
+        return false;
+    }
+
+    // The streamed CRC checks the transfer, the read-back checks the flash
+    uint32_t flash_crc = 0;
+    bool ok = write_offset == write_length && write_crc == expected_crc32 &&
+              crc_of_slot(write_slot, write_length, &flash_crc) && flash_crc == expected_crc32;
+    // The CRC comes from the uploader, so it only proves the bytes arrived
+    // as sent; the model itself must also be well formed
+    if (ok && !verify_slot(write_slot, write_length)) {
+        LOGE(AI, "❌ Model update to slot %d is not a valid model", write_slot);
+        ok = false;
+    }
+
+    model_slot_header_t header;
+    if (ok) {
+        memset(&header, 0, sizeof(header));
+        header.magic = MODEL_SLOT_MAGIC;
+        header.format = MODEL_SLOT_FORMAT;
+        header.generation = active.valid ? active.generation + 1 : 1;
+        header.length = write_length;
+        header.crc32 = expected_crc32;
+        header.header_crc32 = esp_rom_crc32_le(0, (const uint8_t*)&header,
+                                               offsetof(model_slot_header_t, header_crc32));
+        ok = esp_partition_write(partitions[write_slot], 0, &header, sizeof(header)) == ESP_OK;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    if (ok) {
+        active.valid = true;
+        active.slot = write_slot;
+        active.generation = header.generation;
+        active.length = header.length;
+        active.crc32 = header.crc32;
+        pending = active;
+        pending_valid = true;
+        stats.updates_committed++;
+    } else {
+        stats.updates_rejected++;
+    }
+    stats.writing = false;
+    xSemaphoreGive(store_lock);
+
+    if (ok) {
+        LOGI(AI, "✅ Model update committed to slot %d (%lu bytes)", write_slot, write_length);
+    } else {
+        LOGE(AI, "❌ Model update to slot %d failed verification (%lu bytes)", write_slot, write_length);
+    }
+    return ok;
+}
+
+/**
+ * @brief Drop an open upload
+ */
+void model_store_abort(void) {
+    if (store_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    stats.writing = false;
+    xSemaphoreGive(store_lock);
+}
+
+/**
+ * @brief Put the other slot's model back in force
+ */
+bool model_store_swap(void) {
+    if (store_lock == NULL || partitions[0] == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    bool busy = stats.writing;
+    if (!busy) {
+        stats.writing = true;       // Keeps an upload out while the header is rewritten
+        write_slot = active.valid ? (uint8_t)(active.slot ^ 1) : 0;
+    }
+    uint32_t generation = active.valid ? active.generation + 1 : 1;
+    xSemaphoreGive(store_lock);
+    if (busy) {
+        return false;
+    }
+
+    // Checked in full: the slot may hold the remains of an upload that failed
+    model_slot_info_t other;
+    uint32_t flash_crc = 0;
+    bool ok = read_header(write_slot, &other) &&
+              crc_of_slot(write_slot, other.length, &flash_crc) && flash_crc == other.crc32;
+
+    model_slot_header_t header;
+    if (ok) {
+        memset(&header, 0, sizeof(header));
+        header.magic = MODEL_SLOT_MAGIC;
+        header.format = MODEL_SLOT_FORMAT;
+        header.generation = generation;
+        header.length = other.length;
+        header.crc32 = other.crc32;
+        header.header_crc32 = esp_rom_crc32_le(0, (const uint8_t*)&header,
+                                               offsetof(model_slot_header_t, header_crc32));
+        // Cut off between the two, the slot in force is the newer valid one still
+        ok = esp_partition_erase_range(partitions[write_slot], 0, MODEL_SLOT_SECTOR) == ESP_OK &&
+             esp_partition_write(partitions[write_slot], 0, &header, sizeof(header)) == ESP_OK;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    if (ok) {
+        active = other;
+        active.generation = generation;
+        pending = active;
+        pending_valid = true;
+    }
+    stats.writing = false;
+    xSemaphoreGive(store_lock);
+
+    if (ok) {
+        LOGI(AI, "🔁 Model slot %d back in force (generation %lu, %lu bytes)",
+             active.slot, active.generation, active.length);
+    } else {
+        LOGW(AI, "⚠️  Model swap to slot %d refused: no verified model there", write_slot);
+    }
+    return ok;
+}
+
+/**
+ * @brief Take the slot committed since the last call, if any
+ */
+bool model_store_take_pending(model_slot_info_t* info) {
+    if (store_lock == NULL || !pending_valid) {
+        return false;
+    }
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    bool taken = pending_valid;
+    *info = pending;
+    pending_valid = false;
+    xSemaphoreGive(store_lock);
+    return taken;
+}
+
+/**
+ * @brief Copy the store statistics
+ */
+void model_store_get_stats(model_store_stats_t* out) {
+    if (out != NULL) {
+        *out = stats;
+    }
+}
+
+/**
+ * @brief Read and validate a slot header
+ */
+static bool read_header(uint8_t slot, model_slot_info_t* info) {
+    model_slot_header_t header;
+    memset(info, 0, sizeof(*info));
+    if (esp_partition_read(partitions[slot], 0, &header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+
+    uint32_t header_crc = esp_rom_crc32_le(0, (const uint8_t*)&header,
+                                           offsetof(model_slot_header_t, header_crc32));
+    if (header.magic != MODEL_SLOT_MAGIC || header.format != MODEL_SLOT_FORMAT ||
+        header.header_crc32 != header_crc || header.length == 0 ||
+        header.length > stats.slot_capacity) {
+        return false;
+    }
+
+    info->valid = true;
+    info->slot = slot;
+    info->generation = header.generation;
+    info->length = header.length;
+    info->crc32 = header.crc32;
+    return true;
+}
+
+/**
+ * @brief CRC-32 of the first length model bytes of a slot, read back from flash
+ */
+static bool crc_of_slot(uint8_t slot, uint32_t length, uint32_t* crc) {
+    uint8_t chunk[256];
+    *crc = 0;
+    for (uint32_t offset = 0; offset < length; offset += sizeof(chunk)) {
+        uint32_t n = min((uint32_t)sizeof(chunk), length - offset);
+        if (esp_partition_read(partitions[slot], MODEL_SLOT_DATA_OFFSET + offset, chunk, n) != ESP_OK) {
+            return false;
+        }
+        *crc = esp_rom_crc32_le(*crc, chunk, n);
+    }
+    return true;
+}
+
+/**
+ * @brief Verify the model bytes of a slot in place, mapped from flash
+ */
+static bool verify_slot(uint8_t slot, uint32_t length) {
+    const void* mapped = NULL;
+    spi_flash_mmap_handle_t mapping;
+    if (esp_partition_mmap(partitions[slot], MODEL_SLOT_DATA_OFFSET, length, SPI_FLASH_MMAP_DATA,
+                           &mapped, &mapping) != ESP_OK) {
+        return false;
+    }
+    bool ok = ai_inference_verify_model((const uint8_t*)mapped, length);
+    spi_flash_munmap(mapping);
+    return ok;
+}
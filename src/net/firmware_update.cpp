@@ -0,0 +1,586 @@
+/**
+ * @file firmware_update.cpp
+ * @brief Delta firmware updates pulled over HTTP into the inactive app slot
+ *
+ * A patch is a bsdiff-style record stream against the running image,
+ * deflated, so a release that changes a few modules costs a fraction of
+ * the 3 MB image over the air. It is applied as it streams in: the ROM's
+ * inflater fills a 32 KB window, records are interpreted straight out of
+ * it, base bytes are read from the running partition and the result goes
+ * to the inactive slot in FIRMWARE_UPDATE_WRITE_BYTES writes, hashed on
+ * the way. Nothing holds more than one window of the image.
+ *
+ * All of that state lives until the update ends, so a dropped connection
+ * costs only the bytes in flight: the next request asks for the rest with
+ * a Range header and the inflater carries on. A server that ignores the
+ * range sends everything again and the part already taken is skipped.
+ *
+ * The inactive slot is only set to boot once the image's length and
+ * SHA-256 match the patch header (and the hash given with the request,
+ * if any) and esp_ota_end() has validated it.
+ */
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+#include <esp32s3/rom/miniz.h>
+#include "config.h"
+#include "firmware_update.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+/**
+ * @brief Outcome of one HTTP request for the patch
+ */
+typedef enum {
+    FETCH_DONE = 0,                 // Image complete, verified or not
+    FETCH_MORE,                     // Patch bytes taken, more to come
+    FETCH_DROPPED,                  // Connection lost, worth resuming
+    FETCH_FATAL                     // Patch or server unusable
+} fetch_result_t;
+
+/**
+ * @brief Where the record interpreter is within the current record
+ */
+typedef enum {
+    RECORD_CONTROL = 0,
+    RECORD_ADD,
+    RECORD_COPY
+} record_phase_t;
+
+/**
+ * @brief Buffers of one update, PSRAM, taken at its start and freed at its end
+ */
+typedef struct {
+    tinfl_decompressor inflator;
+    uint8_t window[TINFL_LZ_DICT_SIZE];
+    uint8_t input[FIRMWARE_UPDATE_CHUNK_BYTES];
+    uint8_t output[FIRMWARE_UPDATE_WRITE_BYTES];
+    uint8_t base[FIRMWARE_UPDATE_WRITE_BYTES];
+} update_work_t;
+
+static TaskHandle_t update_handle = NULL;
+static StaticTask_t update_tcb;
+static StackType_t update_stack[FIRMWARE_UPDATE_STACK_SIZE];
+
+static char url[FIRMWARE_UPDATE_URL_BYTES];
+static uint8_t expected_sha256[32];
+static bool expected_given = false;
+
+// Update task side
+static update_work_t* work = NULL;
+static firmware_patch_header_t header;
+static uint8_t header_fill = 0;
+static uint32_t window_offset = 0;
+static const esp_partition_t* running = NULL;
+static const esp_partition_t* target = NULL;
+static esp_ota_handle_t ota_handle = 0;
+static bool ota_open = false;
+static mbedtls_sha256_context sha;
+static uint16_t output_fill = 0;
+
+static record_phase_t record_phase = RECORD_CONTROL;
+static uint8_t control[12];
+static uint8_t control_fill = 0;
+static uint32_t add_left = 0;
+static uint32_t copy_left = 0;
+static int32_t seek = 0;
+static uint32_t base_offset = 0;
+
+static firmware_update_status_t status = { FIRMWARE_UPDATE_IDLE, 0, 0, 0, 0, 0, 0, 0, "" };
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void update_task(void* parameter);
+static void run_update(void);
+static fetch_result_t fetch(void);
+static fetch_result_t take_patch(const uint8_t* data, size_t length);
+static bool begin_image(void);
+static bool apply_records(const uint8_t* data, size_t length);
+static bool emit(const uint8_t* data, size_t length);
+static bool flush_output(void);
+static bool finish_image(void);
+static void set_phase(firmware_update_phase_t phase, const char* error);
+static bool is_busy(firmware_update_phase_t phase);
+
+/**
+ * @brief Create the update task
+ */
+bool firmware_update_init(void) {
+    if (update_handle != NULL) {
+        return true;
+    }
+    update_handle = xTaskCreateStaticPinnedToCore(update_task, "FW_Update",
+                                                  FIRMWARE_UPDATE_STACK_SIZE, NULL,
+                                                  FIRMWARE_UPDATE_PRIORITY, update_stack,
+                                                  &update_tcb, tskNO_AFFINITY);
+    return update_handle != NULL;
+}
+
+/**
+ * @brief Hand a patch URL to the update task
+ */
+bool firmware_update_start(const char* patch_url, const uint8_t* target_sha256) {
+    if (update_handle == NULL || strlen(patch_url) >= sizeof(url)) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&status_mux);
+    bool busy = is_busy(status.phase);
+    if (!busy) {
+        status.phase = FIRMWARE_UPDATE_DOWNLOADING;
+        status.error = "";
+    }
+    portEXIT_CRITICAL(&status_mux);
+    if (busy) {
+        return false;
+    }
+
+    strcpy(url, patch_url);
+    expected_given = target_sha256 != NULL;
+    if (expected_given) {
+        memcpy(expected_sha256, target_sha256, sizeof(expected_sha256));
+    }
+    xTaskNotifyGive(update_handle);
+    return true;
+}
+
+/**
+ * @brief An update is downloading, resuming or about to restart
+ */
+bool firmware_update_in_progress(void) {
+    return is_busy(status.phase);
+}
+
+/**
+ * @brief Copy the progress of the current or last update
+ */
+void firmware_update_get_status(firmware_update_status_t* out) {
+    portENTER_CRITICAL(&status_mux);
+    *out = status;
+    portEXIT_CRITICAL(&status_mux);
+}
+
+/**
+ * @brief Short phase name
+ */
+const char* firmware_update_phase_name(firmware_update_phase_t phase) {
+    switch (phase) {
+        case FIRMWARE_UPDATE_IDLE:        return "idle";
+        case FIRMWARE_UPDATE_DOWNLOADING: return "downloading";
+        case FIRMWARE_UPDATE_RESUMING:    return "resuming";
+        case FIRMWARE_UPDATE_READY:       return "ready";
+        case FIRMWARE_UPDATE_FAILED:      return "failed";
+        default:                          return "?";
+    }
+}
+
+/**
+ * @brief Wait for a URL, then run one update to its end
+ */
+static void update_task(void* parameter) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        run_update();
+    }
+}
+
+/**
+ * @brief Fetch and apply the patch, resuming dropped connections
+ */
+static void run_update(void) {
+    work = (update_work_t*)mem_alloc(MEM_BULK, sizeof(update_work_t));
+    if (work == NULL) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "no PSRAM for the update buffers");
+        return;
+    }
+
+    header_fill = 0;
+    window_offset = 0;
+    output_fill = 0;
+    record_phase = RECORD_CONTROL;
+    control_fill = 0;
+    base_offset = 0;
+    ota_open = false;
+    running = esp_ota_get_running_partition();
+    target = esp_ota_get_next_update_partition(NULL);
+    portENTER_CRITICAL(&status_mux);
+    status.patch_bytes = status.received = status.written = status.target_size = 0;
+    status.resumes = 0;
+    portEXIT_CRITICAL(&status_mux);
+    LOGI(SYSTEM, "📥 Firmware patch from %s", url);
+
+    uint8_t drops = 0;
+    fetch_result_t result = fetch();
+    while (result == FETCH_DROPPED && drops < FIRMWARE_UPDATE_RETRIES) {
+        uint32_t received = status.received;
+        set_phase(FIRMWARE_UPDATE_RESUMING, "");
+        vTaskDelay(pdMS_TO_TICKS(FIRMWARE_UPDATE_RETRY_MS << min(drops, (uint8_t)4)));
+        set_phase(FIRMWARE_UPDATE_DOWNLOADING, "");
+        portENTER_CRITICAL(&status_mux);
+        status.resumes++;
+        portEXIT_CRITICAL(&status_mux);
+
+        result = fetch();
+        drops = status.received > received ? 0 : drops + 1;   // Only stalls count
+    }
+
+    if (result == FETCH_DROPPED) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "connection kept dropping");
+    }
+    if (result != FETCH_DONE || status.phase != FIRMWARE_UPDATE_READY) {
+        if (ota_open) {
+            esp_ota_abort(ota_handle);
+            ota_open = false;
+        }
+        mbedtls_sha256_free(&sha);
+        mem_free(MEM_BULK, work, sizeof(update_work_t));
+        work = NULL;
+        LOGW(SYSTEM, "⚠️  Firmware update failed: %s", status.error);
+        return;
+    }
+
+    mem_free(MEM_BULK, work, sizeof(update_work_t));
+    work = NULL;
+    LOGI(SYSTEM, "✅ Firmware %lu bytes from a %lu byte patch, set to boot from %s",
+         status.written, status.received, target->label);
+#if FIRMWARE_UPDATE_AUTO_REBOOT
+    vTaskDelay(pdMS_TO_TICKS(FIRMWARE_UPDATE_REBOOT_DELAY_MS));
+    ESP.restart();
+#endif
+}
+
+/**
+ * @brief One GET of the patch from the first byte not yet taken
+ */
+static fetch_result_t fetch(void) {
+    HTTPClient http;
+    http.setTimeout(FIRMWARE_UPDATE_TIMEOUT_MS);
+    if (!http.begin(url)) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "bad URL");
+        return FETCH_FATAL;
+    }
+
+    uint32_t received = status.received;
+    if (received > 0) {
+        char range[24];
+        snprintf(range, sizeof(range), "bytes=%lu-", received);
+        http.addHeader("Range", range);
+    }
+    int code = http.GET();
+    if (code < 0) {
+        http.end();
+        return FETCH_DROPPED;
+    }
+    if (code != 200 && code != 206) {
+        http.end();
+        set_phase(FIRMWARE_UPDATE_FAILED, "server refused the patch");
+        return FETCH_FATAL;
+    }
+
+    // A 200 carries the whole patch again; skip what was already taken
+    uint32_t skip = code == 200 ? received : 0;
+    int length = http.getSize();
+    if (length > 0) {
+        portENTER_CRITICAL(&status_mux);
+        status.patch_bytes = (code == 200 ? 0 : received) + length;
+        portEXIT_CRITICAL(&status_mux);
+    }
+
+    WiFiClient* stream = http.getStreamPtr();
+    uint32_t idle_since = millis();
+    fetch_result_t result = FETCH_DROPPED;
+    while (http.connected() || stream->available() > 0) {
+        int available = stream->available();
+        if (available <= 0) {
+            if (millis() - idle_since > FIRMWARE_UPDATE_TIMEOUT_MS) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        idle_since = millis();
+
+        size_t want = min((size_t)available, sizeof(work->input));
+        if (skip > 0) {
+            want = min(want, (size_t)skip);
+        }
+        int got = stream->readBytes(work->input, want);
+        if (got <= 0) {
+            break;
+        }
+        if (skip > 0) {
+            skip -= got;
+            continue;
+        }
+
+        fetch_result_t taken = take_patch(work->input, got);
+        if (taken != FETCH_MORE) {
+            result = taken;         // Image complete, or the patch is unusable
+            break;
+        }
+    }
+    http.end();
+    return result;
+}
+
+/**
+ * @brief Feed patch bytes: the header first, then the inflater
+ * @return FETCH_MORE until the end of the image, then FETCH_DONE
+ */
+static fetch_result_t take_patch(const uint8_t* data, size_t length) {
+    size_t taken = 0;
+    if (header_fill < sizeof(header)) {
+        taken = min(length, sizeof(header) - header_fill);
+        memcpy((uint8_t*)&header + header_fill, data, taken);
+        header_fill += taken;
+        if (header_fill == sizeof(header) && !begin_image()) {
+            return FETCH_FATAL;
+        }
+    }
+
+    const uint8_t* next = data + taken;
+    size_t left = length - taken;
+    tinfl_status inflated = TINFL_STATUS_NEEDS_MORE_INPUT;
+    while (left > 0 || inflated == TINFL_STATUS_HAS_MORE_OUTPUT) {
+        size_t in_bytes = left;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - window_offset;
+        inflated = tinfl_decompress(&work->inflator, next, &in_bytes, work->window,
+                                    work->window + window_offset, &out_bytes,
+                                    TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        next += in_bytes;
+        left -= in_bytes;
+        if (!apply_records(work->window + window_offset, out_bytes)) {
+            return FETCH_FATAL;
+        }
+        window_offset = (window_offset + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (inflated == TINFL_STATUS_DONE) {
+            break;
+        }
+        if (inflated < TINFL_STATUS_DONE) {
+            set_phase(FIRMWARE_UPDATE_FAILED, "patch stream corrupt");
+            return FETCH_FATAL;
+        }
+    }
+
+    portENTER_CRITICAL(&status_mux);
+    status.received += length - left;
+    portEXIT_CRITICAL(&status_mux);
+
+    if (inflated == TINFL_STATUS_DONE) {
+        return finish_image() ? FETCH_DONE : FETCH_FATAL;
+    }
+    return FETCH_MORE;
+}
+
+/**
+ * @brief Check the header against the running image and open the inactive slot
+ */
+static bool begin_image(void) {
+    if (header.magic != FIRMWARE_PATCH_MAGIC || header.version != FIRMWARE_PATCH_VERSION) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "not a patch");
+        return false;
+    }
+    if (expected_given && memcmp(header.target_sha256, expected_sha256, 32) != 0) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "patch is for another image");
+        return false;
+    }
+    if (target == NULL || header.target_size > target->size || header.base_size > running->size) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "image does not fit the slot");
+        return false;
+    }
+
+    uint8_t running_sha256[32];
+    if (esp_partition_get_sha256(running, running_sha256) != ESP_OK ||
+        memcmp(running_sha256, header.base_sha256, sizeof(running_sha256)) != 0) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "patch is against another base image");
+        return false;
+    }
+
+    // A staged image is about to be overwritten: boot the running one until
+    // its replacement is verified
+    if (esp_ota_get_boot_partition() != running &&
+        esp_ota_set_boot_partition(running) != ESP_OK) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "staged image could not be unset");
+        return false;
+    }
+    if (esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle) != ESP_OK) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "inactive slot unavailable");
+        return false;
+    }
+    ota_open = true;
+    tinfl_init(&work->inflator);
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+
+    portENTER_CRITICAL(&status_mux);
+    status.target_size = header.target_size;
+    portEXIT_CRITICAL(&status_mux);
+    return true;
+}
+
+/**
+ * @brief Run inflated record bytes through the interpreter
+ */
+static bool apply_records(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t n;
+        switch (record_phase) {
+            case RECORD_CONTROL:
+                n = min(length, sizeof(control) - control_fill);
+                memcpy(control + control_fill, data, n);
+                control_fill += n;
+                if (control_fill == sizeof(control)) {
+                    memcpy(&add_left, control, 4);
+                    memcpy(&copy_left, control + 4, 4);
+                    memcpy(&seek, control + 8, 4);
+                    control_fill = 0;
+                    record_phase = RECORD_ADD;
+                }
+                break;
+
+            case RECORD_ADD:
+                n = min(length, (size_t)add_left);
+                n = min(n, sizeof(work->base));
+                if (base_offset + n > header.base_size ||
+                    esp_partition_read(running, base_offset, work->base, n) != ESP_OK) {
+                    set_phase(FIRMWARE_UPDATE_FAILED, "patch reads past the base image");
+                    return false;
+                }
+                for (size_t i = 0; i < n; i++) {
+                    work->base[i] += data[i];
+                }
+                if (!emit(work->base, n)) {
+                    return false;
+                }
+                base_offset += n;
+                add_left -= n;
+                break;
+
+            case RECORD_COPY:
+                n = min(length, (size_t)copy_left);
+                if (!emit(data, n)) {
+                    return false;
+                }
+                copy_left -= n;
+                break;
+
+            default:
+                return false;
+        }
+        data += n;
+        length -= n;
+
+        // Zero-length parts end at once, so a record may finish without more data
+        if (record_phase == RECORD_ADD && add_left == 0) {
+            record_phase = RECORD_COPY;
+        }
+        if (record_phase == RECORD_COPY && copy_left == 0) {
+            base_offset += seek;
+            record_phase = RECORD_CONTROL;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Stage image bytes, writing whole buffers to the slot
+ */
+static bool emit(const uint8_t* data, size_t length) {
+    if (status.written + output_fill + length > header.target_size) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "patch produces too long an image");
+        return false;
+    }
+    while (length > 0) {
+        size_t n = min(length, sizeof(work->output) - output_fill);
+        memcpy(work->output + output_fill, data, n);
+        output_fill += n;
+        data += n;
+        length -= n;
+        if (output_fill == sizeof(work->output) && !flush_output()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Write and hash the staged image bytes
+ */
+static bool flush_output(void) {
+    if (output_fill == 0) {
+        return true;
+    }
+    if (esp_ota_write(ota_handle, work->output, output_fill) != ESP_OK) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "flash write failed");
+        return false;
+    }
+    mbedtls_sha256_update_ret(&sha, work->output, output_fill);
+    portENTER_CRITICAL(&status_mux);
+    status.written += output_fill;
+    portEXIT_CRITICAL(&status_mux);
+    output_fill = 0;
+    return true;
+}
+
+/**
+ * @brief Verify the image and set it to boot
+ */
+static bool finish_image(void) {
+    if (!flush_output()) {
+        return false;
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    if (status.written != header.target_size ||
+        memcmp(digest, header.target_sha256, sizeof(digest)) != 0) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "image SHA-256 mismatch");
+        return false;
+    }
+
+    ota_open = false;
+    if (esp_ota_end(ota_handle) != ESP_OK) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "image failed validation");
+        return false;
+    }
+    if (esp_ota_set_boot_partition(target) != ESP_OK) {
+        set_phase(FIRMWARE_UPDATE_FAILED, "boot slot not switched");
+        return false;
+    }
+
+    portENTER_CRITICAL(&status_mux);
+    status.updates++;
+    portEXIT_CRITICAL(&status_mux);
+    set_phase(FIRMWARE_UPDATE_READY, "");
+    return true;
+}
+
+/**
+ * @brief Move to a phase, with the reason if it is a failure
+ */
+static void set_phase(firmware_update_phase_t phase, const char* error) {
+    portENTER_CRITICAL(&status_mux);
+    if (phase == FIRMWARE_UPDATE_FAILED) {
+        status.failures++;
+        status.error = error;
+    }
+    status.phase = phase;
+    portEXIT_CRITICAL(&status_mux);
+}
+
+/**
+ * @brief Phases a new start must not interrupt
+ *
+ * READY is one of them only while a restart into the image is pending;
+ * without FIRMWARE_UPDATE_AUTO_REBOOT a staged image waits for a reboot
+ * that may never come, and a later start replaces it.
+ */
+static bool is_busy(firmware_update_phase_t phase) {
+    return phase == FIRMWARE_UPDATE_DOWNLOADING || phase == FIRMWARE_UPDATE_RESUMING ||
+           (phase == FIRMWARE_UPDATE_READY && FIRMWARE_UPDATE_AUTO_REBOOT);
+}
@@ -0,0 +1,510 @@
+/**
+ * @file fleet_commands.cpp
+ * @brief Remote commands queued to cycle boundaries, acknowledged in batches
+ *
+ * Lines are parsed and checked on the task they arrive on (the MQTT or the
+ * async TCP task), so anything malformed or unknown is refused at once and
+ * only runnable commands take a queue slot. The queue, the waiting
+ * acknowledgements and the figures share one spinlock; nothing slow runs
+ * under it. The scan task applies the queue between cycles: a profile pin
+ * and a model swap happen there, a trace dump goes to a job worker, and a
+ * reboot is left to the system task, which first records the id and then
+ * gives the acknowledgement FLEET_REBOOT_GRACE_MS to go out.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "config.h"
+#include "fleet_commands.h"
+#include "scan_profile.h"
+#include "model_store.h"
+#include "event_trace.h"
+#include "sd_monitor.h"
+#include "job_pool.h"
+#include "journal.h"
+#include "mqtt_uplink.h"
+#include "logger.h"
+
+#define FLEET_JOURNAL_KEY       "fleet"
+#define FLEET_ARG_BYTES         24          // Argument, terminator included
+#define FLEET_LINE_BYTES        64          // Longest line considered
+#define FLEET_ACK_SLOTS         (FLEET_ACK_BATCH * 4)
+
+/**
+ * @brief One queued command
+ */
+typedef struct {
+    uint32_t id;
+    uint8_t  cmd;                   // fleet_cmd_t
+    uint8_t  source;                // fleet_source_t
+    char     arg[FLEET_ARG_BYTES];
+} fleet_entry_t;
+
+static const char* const cmd_names[FLEET_CMD_COUNT] = { "profile", "model", "dump", "reboot", "raw" };
+static const char* const result_names[FLEET_ACK_RESULTS] = {
+    "ok", "failed", "rejected", "unsupported", "duplicate", "overflow"
+};
+
+static portMUX_TYPE fleet_mux = portMUX_INITIALIZER_UNLOCKED;
+static fleet_entry_t queue[FLEET_QUEUE_COMMANDS];
+static uint8_t queue_head = 0;
+static uint8_t queue_count = 0;
+static fleet_ack_t acks[FLEET_ACK_SLOTS];   // Waiting to be sent, oldest first
+static uint8_t ack_head = 0;
+static uint8_t ack_count = 0;
+static fleet_ack_t recent[FLEET_ACK_BATCH]; // Latest, sent or not, for GET
+static uint8_t recent_next = 0;
+static fleet_status_t status;
+static uint32_t accepted_id = 0;            // Highest id queued or acknowledged
+static uint32_t saved_id = 0;               // Highest id in the journal
+
+// Set by the scan task, acted on by the system task
+static volatile bool reboot_pending = false;
+static uint32_t reboot_at_ms = 0;
+
+// Forward declarations
+static fleet_ack_result_t check(fleet_cmd_t cmd, const char* arg);
+static fleet_ack_result_t run(const fleet_entry_t* entry);
+static void acknowledge(uint32_t id, fleet_ack_result_t result, fleet_source_t source);
+static fleet_ack_result_t submit(uint32_t id, const char* verb, const char* arg, fleet_source_t source);
+static void dump_trace_job(void* payload);
+static void on_get(AsyncWebServerRequest* request);
+static void on_post(AsyncWebServerRequest* request);
+
+/**
+ * @brief Restore the highest id applied so far
+ */
+void fleet_commands_init(void) {
+    memset(&status, 0, sizeof(status));
+    uint32_t id = 0;
+    if (journal_get(FLEET_JOURNAL_KEY, &id, sizeof(id)) != sizeof(id)) {
+        Preferences prefs;
+        if (prefs.begin(FLEET_NVS_NAMESPACE, true)) {
+            id = prefs.getUInt("last_id", 0);
+            prefs.end();
+        }
+    }
+    accepted_id = saved_id = status.last_id = id;
+    LOGI(SYSTEM, "✅ Fleet commands from id %lu", (unsigned long)(id + 1));
+}
+
+/**
+ * @brief Add the command route to the web server
+ */
+void fleet_commands_register(AsyncWebServer* server) {
+    server->on(FLEET_PATH, HTTP_GET, on_get);
+    server->on(FLEET_PATH, HTTP_POST, on_post);
+}
+
+/**
+ * @brief Queue every "<id> <command> [argument]" line of a message
+ */
+uint8_t fleet_commands_submit_text(const char* text, size_t length, fleet_source_t source) {
+    uint8_t queued = 0;
+    size_t start = 0;
+    while (start < length) {
+        size_t end = start;
+        while (end < length && text[end] != '\n') {
+            end++;
+        }
+        char line[FLEET_LINE_BYTES];
+        bool too_long = end - start >= sizeof(line);
+        size_t n = min(end - start, sizeof(line) - 1);
+        memcpy(line, text + start, n);
+        line[n] = '\0';
+        start = end + 1;
+
+        // Split into id, verb and argument; blank lines are skipped
+        char* save = NULL;
+        char* id_text = strtok_r(line, " \t\r", &save);
+        if (id_text == NULL) {
+            continue;
+        }
+        char* verb = strtok_r(NULL, " \t\r", &save);
+        char* arg = strtok_r(NULL, " \t\r", &save);
+        char* end_id;
+        uint32_t id = strtoul(id_text, &end_id, 10);
+        if (*end_id != '\0' || id == 0 || verb == NULL) {
+            portENTER_CRITICAL(&fleet_mux);
+            status.received++;
+            status.refused++;
+            portEXIT_CRITICAL(&fleet_mux);
+            LOGW(SYSTEM, "⚠️  Fleet command line without an id or a command ignored");
+            continue;
+        }
+        if (too_long) {
+            // Cut short it could still parse, as some other command
+            portENTER_CRITICAL(&fleet_mux);
+            status.received++;
+            portEXIT_CRITICAL(&fleet_mux);
+            LOGW(SYSTEM, "⚠️  Fleet command %lu over %d characters rejected", (unsigned long)id,
+                 FLEET_LINE_BYTES - 1);
+            acknowledge(id, FLEET_ACK_REJECTED, source);
+            continue;
+        }
+        if (submit(id, verb, arg != NULL ? arg : "", source) == FLEET_ACK_OK) {
+            queued++;
+        }
+    }
+    return queued;
+}
+
+/**
+ * @brief Apply the queued commands
+ */
+void fleet_commands_apply(void) {
+    for (;;) {
+        fleet_entry_t entry;
+        portENTER_CRITICAL(&fleet_mux);
+        bool any = queue_count > 0;
+        if (any) {
+            entry = queue[queue_head];
+            queue_head = (queue_head + 1) % FLEET_QUEUE_COMMANDS;
+            queue_count--;
+            status.queued = queue_count;
+        }
+        portEXIT_CRITICAL(&fleet_mux);
+        if (!any) {
+            return;
+        }
+
+        fleet_ack_result_t result = run(&entry);
+        LOGI(SYSTEM, "🛰️  Fleet command %lu: %s %s -> %s", (unsigned long)entry.id,
+             cmd_names[entry.cmd], entry.arg, result_names[result]);
+        acknowledge(entry.id, result, (fleet_source_t)entry.source);
+    }
+}
+
+/**
+ * @brief Persist the applied id, then restart if asked, once the acks are out
+ */
+void fleet_commands_tick(uint32_t now_ms) {
+    portENTER_CRITICAL(&fleet_mux);
+    uint32_t id = status.last_id;
+    portEXIT_CRITICAL(&fleet_mux);
+
+    if (id != saved_id) {
+        bool saved = journal_put(FLEET_JOURNAL_KEY, &id, sizeof(id));
+        if (!saved) {
+            Preferences prefs;
+            saved = prefs.begin(FLEET_NVS_NAMESPACE, false) && prefs.putUInt("last_id", id) == sizeof(id);
+            prefs.end();
+        }
+        if (saved) {
+            saved_id = id;
+        } else {
+            LOGE(SYSTEM, "❌ Fleet command id %lu not saved", (unsigned long)id);
+        }
+    }
+
+    // Not before the id is stored: the same command would reboot it again
+    if (reboot_pending && saved_id == id && now_ms - reboot_at_ms >= FLEET_REBOOT_GRACE_MS) {
+        LOGW(SYSTEM, "🔄 Restarting on a fleet command");
+        delay(100);                 // The log writer drains
+        ESP.restart();
+    }
+}
+
+/**
+ * @brief Whether a batch of acknowledgements is due
+ */
+bool fleet_commands_acks_due(uint32_t now_ms) {
+    portENTER_CRITICAL(&fleet_mux);
+    bool due = ack_count > 0 &&
+               (ack_count >= FLEET_ACK_BATCH || reboot_pending ||
+                now_ms - acks[ack_head].done_ms >= FLEET_ACK_INTERVAL_MS);
+    portEXIT_CRITICAL(&fleet_mux);
+    return due;
+}
+
+/**
+ * @brief Write the waiting acknowledgements as one JSON array
+ */
+size_t fleet_commands_format_acks(char* out, size_t size, uint8_t* count) {
+    fleet_ack_t batch[FLEET_ACK_BATCH];
+    portENTER_CRITICAL(&fleet_mux);
+    uint8_t n = min(ack_count, (uint8_t)FLEET_ACK_BATCH);
+    for (uint8_t i = 0; i < n; i++) {
+        batch[i] = acks[(ack_head + i) % FLEET_ACK_SLOTS];
+    }
+    portEXIT_CRITICAL(&fleet_mux);
+
+    *count = 0;
+    if (n == 0 || size < 3) {
+        return 0;
+    }
+    size_t len = snprintf(out, size, "[");
+    for (uint8_t i = 0; i < n; i++) {
+        int written = snprintf(out + len, size - len, "%s[%lu,\"%s\",%lu]", i > 0 ? "," : "",
+                               (unsigned long)batch[i].id, result_names[batch[i].result],
+                               (unsigned long)batch[i].done_ms);
+        if (written < 0 || len + written + 2 > size) {
+            break;                  // The rest go in the next message
+        }
+        len += written;
+        (*count)++;
+    }
+    len += snprintf(out + len, size - len, "]");
+    return *count > 0 ? len : 0;
+}
+
+/**
+ * @brief Drop the first count waiting acks once their message is accepted
+ */
+void fleet_commands_acks_sent(uint8_t count) {
+    portENTER_CRITICAL(&fleet_mux);
+    count = min(count, ack_count);
+    ack_head = (ack_head + count) % FLEET_ACK_SLOTS;
+    ack_count -= count;
+    status.acks_pending = ack_count;
+    status.acks_sent += count;
+    status.ack_batches++;
+    portEXIT_CRITICAL(&fleet_mux);
+}
+
+/**
+ * @brief Copy the channel figures
+ */
+void fleet_commands_get_status(fleet_status_t* out) {
+    portENTER_CRITICAL(&fleet_mux);
+    *out = status;
+    portEXIT_CRITICAL(&fleet_mux);
+    out->reboot_pending = reboot_pending;
+}
+
+/**
+ * @brief Short names for logs, acks and metrics
+ */
+const char* fleet_ack_result_name(fleet_ack_result_t result) {
+    return result < FLEET_ACK_RESULTS ? result_names[result] : "?";
+}
+
+/**
+ * @brief Check one command and queue it, or acknowledge it at once
+ * @return FLEET_ACK_OK if queued, else what it was acknowledged with
+ */
+static fleet_ack_result_t submit(uint32_t id, const char* verb, const char* arg, fleet_source_t source) {
+    fleet_cmd_t cmd = FLEET_CMD_COUNT;
+    for (uint8_t c = 0; c < FLEET_CMD_COUNT; c++) {
+        if (strcmp(verb, cmd_names[c]) == 0) {
+            cmd = (fleet_cmd_t)c;
+        }
+    }
+    fleet_ack_result_t result = cmd < FLEET_CMD_COUNT ? check(cmd, arg) : FLEET_ACK_REJECTED;
+    if (strlen(arg) >= FLEET_ARG_BYTES) {
+        result = FLEET_ACK_REJECTED;
+    }
+
+    portENTER_CRITICAL(&fleet_mux);
+    status.received++;
+    bool duplicate = id <= accepted_id;
+    // Adopting a far-off id would make every command after it a duplicate
+    bool too_far = id - accepted_id > FLEET_ID_MAX_STEP;
+    if (duplicate) {
+        result = FLEET_ACK_DUPLICATE;
+        status.duplicates++;
+    } else if (too_far) {
+        result = FLEET_ACK_REJECTED;
+    } else if (result == FLEET_ACK_OK && queue_count == FLEET_QUEUE_COMMANDS) {
+        result = FLEET_ACK_OVERFLOW;
+    } else if (result == FLEET_ACK_OK) {
+        fleet_entry_t* entry = &queue[(queue_head + queue_count) % FLEET_QUEUE_COMMANDS];
+        entry->id = id;
+        entry->cmd = cmd;
+        entry->source = source;
+        strlcpy(entry->arg, arg, sizeof(entry->arg));
+        queue_count++;
+        status.queued = queue_count;
+    }
+    // An overflow may be sent again under the same id
+    if (result != FLEET_ACK_OVERFLOW && !duplicate && !too_far) {
+        accepted_id = id;
+    }
+    portEXIT_CRITICAL(&fleet_mux);
+
+    if (result != FLEET_ACK_OK) {
+        LOGW(SYSTEM, "⚠️  Fleet command %lu (%s %s) %s", (unsigned long)id, verb, arg,
+             result_names[result]);
+        acknowledge(id, result, source);
+    }
+    return result;
+}
+
+/**
+ * @brief Whether this build can run a command with this argument
+ */
+static fleet_ack_result_t check(fleet_cmd_t cmd, const char* arg) {
+    switch (cmd) {
+        case FLEET_CMD_PROFILE:
+            return strcmp(arg, "auto") == 0 || scan_profile_find(arg) < SCAN_PROFILE_COUNT ?
+                   FLEET_ACK_OK : FLEET_ACK_REJECTED;
+        case FLEET_CMD_MODEL:
+            return strcmp(arg, "swap") == 0 ? FLEET_ACK_OK : FLEET_ACK_REJECTED;
+        case FLEET_CMD_DUMP:
+#if EVENT_TRACE_ENABLED
+            return arg[0] == '\0' ? FLEET_ACK_OK : FLEET_ACK_REJECTED;
+#else
+            return FLEET_ACK_UNSUPPORTED;
+#endif
+        case FLEET_CMD_REBOOT:
+            if (arg[0] == '\0') {
+                return FLEET_ACK_OK;
+            }
+            if (strcmp(arg, "survey") != 0) {
+                return FLEET_ACK_REJECTED;
+            }
+            // Only a survey build sweeps from a plain restart; any other
+            // build would come back exactly as it is
+            return SURVEY_MODE_ENABLED ? FLEET_ACK_OK : FLEET_ACK_UNSUPPORTED;
+        case FLEET_CMD_RAW: {
+#if MQTT_ENABLED
+            char* end;
+            unsigned long minutes = strtoul(arg, &end, 10);
+            return arg[0] != '\0' && *end == '\0' && minutes <= MQTT_RAW_MAX_MINUTES ?
+                   FLEET_ACK_OK : FLEET_ACK_REJECTED;
+#else
+            return FLEET_ACK_UNSUPPORTED;
+#endif
+        }
+        default:
+            return FLEET_ACK_REJECTED;
+    }
+}
+
+/**
+ * @brief Run one checked command (scan task, between cycles)
+ */
+static fleet_ack_result_t run(const fleet_entry_t* entry) {
+    switch (entry->cmd) {
+        case FLEET_CMD_PROFILE:
+            scan_profile_pin(strcmp(entry->arg, "auto") == 0 ? SCAN_PROFILE_COUNT
+                                                             : scan_profile_find(entry->arg));
+            return FLEET_ACK_OK;
+        case FLEET_CMD_MODEL:
+            return model_store_swap() ? FLEET_ACK_OK : FLEET_ACK_FAILED;
+        case FLEET_CMD_DUMP:
+            if (!sd_monitor_mounted() || !job_pool_submit(JOB_LANE_LOW, dump_trace_job, NULL, 0)) {
+                return FLEET_ACK_FAILED;
+            }
+            return FLEET_ACK_OK;
+        case FLEET_CMD_REBOOT:
+            // A survey build sweeps on any restart not woken by a touch
+            reboot_at_ms = millis();
+            reboot_pending = true;
+            return FLEET_ACK_OK;
+        case FLEET_CMD_RAW:
+#if MQTT_ENABLED
+            mqtt_uplink_raw_for(strtoul(entry->arg, NULL, 10));
+#endif
+            return FLEET_ACK_OK;
+        default:
+            return FLEET_ACK_REJECTED;
+    }
+}
+
+/**
+ * @brief Record an outcome for the next batch and for GET
+ */
+static void acknowledge(uint32_t id, fleet_ack_result_t result, fleet_source_t source) {
+    fleet_ack_t ack;
+    memset(&ack, 0, sizeof(ack));
+    ack.id = id;
+    ack.result = result;
+    ack.source = source;
+    ack.done_ms = millis();
+
+    portENTER_CRITICAL(&fleet_mux);
+    if (ack_count == FLEET_ACK_SLOTS) {
+        // With the broker away this long, the oldest are the least useful
+        ack_head = (ack_head + 1) % FLEET_ACK_SLOTS;
+        ack_count--;
+    }
+    acks[(ack_head + ack_count) % FLEET_ACK_SLOTS] = ack;
+    ack_count++;
+    recent[recent_next] = ack;
+    recent_next = (recent_next + 1) % FLEET_ACK_BATCH;
+    if (result == FLEET_ACK_OK) {
+        status.applied++;
+    } else if (result != FLEET_ACK_DUPLICATE) {
+        status.refused++;
+    }
+    // Only ids submit() accepted are kept: a refused far-off or overlong one is not
+    if (result != FLEET_ACK_DUPLICATE && result != FLEET_ACK_OVERFLOW && id > status.last_id &&
+        id <= accepted_id) {
+        status.last_id = id;
+    }
+    status.acks_pending = ack_count;
+    portEXIT_CRITICAL(&fleet_mux);
+}
+
+/**
+ * @brief Job: event_trace_save_sd() on a worker
+ */
+static void dump_trace_job(void* payload) {
+#if EVENT_TRACE_ENABLED
+    event_trace_save_sd();
+#endif
+}
+
+/**
+ * @brief The channel's figures and latest acknowledgements
+ */
+static void on_get(AsyncWebServerRequest* request) {
+    fleet_status_t fleet;
+    fleet_ack_t latest[FLEET_ACK_BATCH];
+    portENTER_CRITICAL(&fleet_mux);
+    fleet = status;
+    uint8_t next = recent_next;
+    memcpy(latest, recent, sizeof(latest));
+    portEXIT_CRITICAL(&fleet_mux);
+    scan_profile_id_t pinned = scan_profile_pinned();
+
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"last_id\":%lu,\"received\":%lu,\"applied\":%lu,\"refused\":%lu,"
+                     "\"duplicates\":%lu,\"queued\":%u,\"acks_pending\":%u,\"pinned\":\"%s\","
+                     "\"reboot_pending\":%s,\"acks\":[",
+                     fleet.last_id, fleet.received, fleet.applied, fleet.refused, fleet.duplicates,
+                     fleet.queued, fleet.acks_pending,
+                     pinned < SCAN_PROFILE_COUNT ? scan_profile_get(pinned)->name : "auto",
+                     reboot_pending ? "true" : "false");
+    const char* separator = "";
+    for (uint8_t i = 0; i < FLEET_ACK_BATCH; i++) {
+        const fleet_ack_t* ack = &latest[(next + i) % FLEET_ACK_BATCH];
+        if (ack->id == 0) {
+            continue;
+        }
+        response->printf("%s[%lu,\"%s\",%lu]", separator, ack->id, result_names[ack->result],
+                         ack->done_ms);
+        separator = ",";
+    }
+    response->print("]}");
+    request->send(response);
+}
+
+/**
+ * @brief Queue one command: id=17&cmd=profile&arg=fast-passive
+ */
+static void on_post(AsyncWebServerRequest* request) {
+    if (!request->hasParam("id", true) || !request->hasParam("cmd", true)) {
+        request->send(400, "text/plain", "id and cmd required\n");
+        return;
+    }
+    const char* id_text = request->getParam("id", true)->value().c_str();
+    char* end;
+    uint32_t id = strtoul(id_text, &end, 10);
+    if (end == id_text || *end != '\0' || id == 0) {
+        request->send(400, "text/plain", "id must be a positive number\n");
+        return;
+    }
+    String arg = request->hasParam("arg", true) ? request->getParam("arg", true)->value() : String();
+    fleet_ack_result_t result = submit(id, request->getParam("cmd", true)->value().c_str(),
+                                       arg.c_str(), FLEET_SOURCE_HTTP);
+    if (result != FLEET_ACK_OK) {
+        char reply[16];
+        snprintf(reply, sizeof(reply), "%s\n", result_names[result]);
+        request->send(result == FLEET_ACK_DUPLICATE ? 409 : result == FLEET_ACK_OVERFLOW ? 503 : 400,
+                      "text/plain", reply);
+        return;
+    }
+    request->send(202, "text/plain", "queued\n");
+}
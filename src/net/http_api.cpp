@@ -0,0 +1,1252 @@
+/**
+ * @file http_api.cpp
+ * @brief JSON API over the bus snapshots, for dashboards that poll
+ *
+ * Each request takes one of HTTP_API_BUFFERS buffers allocated in PSRAM
+ * once, at registration, and keeps it until its last byte has been handed
+ * to the TCP stack or the client goes away. State and metrics are built in
+ * a StaticJsonDocument on the server task's stack and serialized into the
+ * buffer, then sent with a Content-Length. Devices and history are
+ * unbounded in length, so they go out chunked: the filler stages one
+ * device or point at a time in the buffer and copies it into the TCP
+ * buffer it was given, so no body is ever held whole or in a String.
+ * History is read from the rings a page at a time, with the last point's
+ * end time as the cursor, so a whole tier streams through one buffer.
+ * Both take ?since=<ms> for incremental queries; each response carries
+ * the now_ms or newest_ms to pass as the next since.
+ *
+ * The async TCP task runs above the scan and UI tasks, so nothing costly
+ * happens on it. Each route draws from a token bucket of its own, shared
+ * by every client, and a request with the bucket empty is answered 429.
+ * With keys configured, a request is first matched to one in a fixed
+ * table by the hash of its secret: every route of the server is behind a
+ * gate handler added ahead of them, and the API routes are then held to
+ * that key's per-minute
+ * request and byte budgets and its count of open streams, so a bulk
+ * exporter is throttled on its own budget before it can drain a route's.
+ * Bytes are charged as the send callbacks hand them to the TCP stack, and
+ * may run a key into debt that turns its next requests away.
+ * At most HTTP_API_HEAVY_STREAMS chunked responses are open at once, so
+ * the other buffers stay free for state and metrics polls. A chunked body
+ * is staged by a JOB_LANE_LOW job into two HTTP_API_CHUNK_BYTES halves of
+ * its buffer, one filled while the other drains; the TCP callback only
+ * copies a filled half out, and asks the server to try again when neither
+ * is ready. Only the first half is staged in the request handler, so the
+ * body starts with the headers.
+ *
+ * The device table is walked without a lock, as the detail screens do,
+ * each device read under an epoch pin so the scan task publishing a new
+ * version of it cannot tear it; a device moved by a deletion between
+ * chunks may be listed twice or not at all. The halves and the claim are handed between the TCP task and the
+ * worker under api_mux; everything else runs on the TCP task alone.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "data_bus.h"
+#include "sensor_snapshot.h"
+#include "sensor_data_codec.h"
+#include "device_table.h"
+#include "metrics_history.h"
+#include "ai_inference.h"
+#include "ai_telemetry.h"
+#include "openmetrics.h"
+#include "job_pool.h"
+#include "location.h"
+#include "ai_state_stats.h"
+#include "mem_policy.h"
+#include "logger.h"
+#include "http_api.h"
+
+// Room for /api/state and /api/metrics in the stack documents
+#define STATE_JSON_CAPACITY   (JSON_OBJECT_SIZE(4) + JSON_OBJECT_SIZE(6))
+#define METRICS_JSON_CAPACITY (JSON_OBJECT_SIZE(4) + JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(11) + \
+                               JSON_ARRAY_SIZE(BUS_TOPIC_COUNT) +                              \
+                               BUS_TOPIC_COUNT * JSON_OBJECT_SIZE(4) + JSON_OBJECT_SIZE(9))
+#define SENSOR_JSON_BYTES     1024
+
+#define TICKET_SLOT_BITS 4              // Ticket = claim count << bits | buffer index
+static_assert(HTTP_API_BUFFERS <= (1 << TICKET_SLOT_BITS), "too many API buffers for a ticket");
+static_assert(HTTP_API_HEAVY_STREAMS < HTTP_API_BUFFERS, "no API buffer left for polls");
+
+typedef struct api_buffer api_buffer_t;
+
+/**
+ * @brief Ahead of every route: keeps the key header, and answers 401 for
+ *        a station-side request without a known key
+ */
+class KeyGate : public AsyncWebHandler {
+public:
+    bool canHandle(AsyncWebServerRequest* request) override;
+    void handleRequest(AsyncWebServerRequest* request) override;
+};
+
+/**
+ * @brief Requests a route may take back to back, refilled at its rate
+ */
+typedef struct {
+    uint16_t per_second;
+    uint32_t milli_tokens;
+    uint32_t refilled_ms;
+} api_bucket_t;
+
+/**
+ * @brief A key's per-minute budget, in thousandths of a request or in bytes
+ */
+typedef struct {
+    uint32_t per_minute;            // 0 for no limit
+    int32_t  balance;               // Below zero, a debt of bytes sent
+    uint32_t refilled_ms;
+} key_quota_t;
+
+/**
+ * @brief One entry of the key table
+ */
+typedef struct {
+    char                 secret[HTTP_API_KEY_SECRET_BYTES];
+    uint32_t             hash;      // FNV-1a of the secret, compared first
+    key_quota_t          requests;
+    key_quota_t          bytes;
+    http_api_key_stats_t stats;
+} api_key_t;
+
+/**
+ * @brief Payload of a fill job
+ */
+typedef struct {
+    uint32_t ticket;
+} fill_job_t;
+
+/**
+ * @brief Stage the next piece of a chunked body in text
+ * @return false once the closing text has been staged
+ */
+typedef bool (*api_next_t)(api_buffer_t* buffer);
+
+/**
+ * @brief One response in flight
+ */
+struct api_buffer {
+    bool       busy;
+    bool       heavy;               // Chunked, counted against HTTP_API_HEAVY_STREAMS
+    bool       filling;             // A fill job queued or running
+    bool       abandoned;           // Released while filling; the job frees it
+    bool       finished;            // The closing text is in a half
+    bool       done;                // Closing text staged
+    int8_t     key;                 // Charged for the body, -1 for none
+    uint16_t   sent;                // Of the staged text
+    uint16_t   length;
+    uint32_t   ticket;              // Of the current claim, so a stale release frees nothing
+    uint32_t   cursor;              // Next device slot, or point in the page
+    uint32_t   items;               // Written so far
+    uint32_t   limit;               // Most to write
+    uint32_t   count;               // History points in the page
+    uint32_t   after_ms;            // Devices seen, or the page's points ended, after this
+    int8_t     kind;                // Device filter, -1 for every kind
+    uint8_t    tier;                // history_tier_t and metric_id_t of a history query
+    uint8_t    metric;
+    api_next_t next;
+    union {
+        struct {
+            metric_rollup_t points[HTTP_API_HISTORY_PAGE];
+            uint32_t        end_ms[HTTP_API_HISTORY_PAGE];
+        } page;
+        char sensor[SENSOR_JSON_BYTES];
+        openmetrics_snapshot_t metrics;
+    } scratch;
+    char       text[HTTP_API_TEXT_BYTES];
+    bool       ready[2];            // Half filled and not yet drained
+    uint8_t    fill_half;           // Worker side
+    uint8_t    drain_half;          // TCP side
+    uint16_t   drained;             // Of the drain half
+    uint16_t   half_length[2];
+    char       half[2][HTTP_API_CHUNK_BYTES];
+};
+
+static api_buffer_t* buffers = NULL;
+static uint32_t claims = 0;
+static uint8_t heavy_streams = 0;
+static http_api_stats_t stats = {0};
+static portMUX_TYPE api_mux = portMUX_INITIALIZER_UNLOCKED;
+static api_key_t keys[HTTP_API_KEY_SLOTS];
+static uint8_t key_count = 0;
+static int8_t admitted_key = -1;    // Of the request in hand, for its claim(); TCP task
+
+static api_bucket_t buckets[HTTP_API_ROUTE_COUNT] = {
+    { HTTP_API_RATE_STATE },
+    { HTTP_API_RATE_METRICS },
+    { HTTP_API_RATE_DEVICES },
+    { HTTP_API_RATE_HISTORY },
+    { HTTP_API_RATE_OPENMETRICS },
+    { HTTP_API_RATE_OTHER }
+};
+
+// Forward declarations
+static void on_state(AsyncWebServerRequest* request);
+static void on_metrics(AsyncWebServerRequest* request);
+static void on_sensor(AsyncWebServerRequest* request);
+static void on_devices(AsyncWebServerRequest* request);
+static void on_history(AsyncWebServerRequest* request);
+static void on_location(AsyncWebServerRequest* request);
+static void on_location_learn(AsyncWebServerRequest* request);
+static void on_location_forget(AsyncWebServerRequest* request);
+static void on_states(AsyncWebServerRequest* request);
+static void on_states_reset(AsyncWebServerRequest* request);
+static api_buffer_t* claim(AsyncWebServerRequest* request, uint32_t* ticket, bool heavy);
+static void release(uint32_t ticket);
+static void parse_keys(void);
+static int8_t find_key(AsyncWebServerRequest* request);
+static bool admit_key(AsyncWebServerRequest* request, int8_t key);
+static void refill(key_quota_t* quota, uint32_t now, uint32_t least);
+static void charge(int8_t key, size_t bytes);
+static void refuse(AsyncWebServerRequest* request, uint32_t wait_s, const char* reason);
+static void send_document(AsyncWebServerRequest* request, api_buffer_t* buffer,
+                          uint32_t ticket, JsonDocument& doc);
+static void send_text(AsyncWebServerRequest* request, api_buffer_t* buffer, uint32_t ticket,
+                      const char* content_type);
+static void send_chunked(AsyncWebServerRequest* request, api_buffer_t* buffer, uint32_t ticket,
+                         const char* content_type);
+static void schedule_fill(api_buffer_t* buffer);
+static void fill_job(void* payload);
+static void fill_halves(api_buffer_t* buffer, uint8_t halves);
+static bool next_device(api_buffer_t* buffer);
+static bool next_point(api_buffer_t* buffer);
+static bool next_metrics_group(api_buffer_t* buffer);
+
+/**
+ * @brief Put the key check in front of every route of a server
+ */
+void http_api_guard(AsyncWebServer* server) {
+    static bool parsed = false;
+    if (!parsed) {
+        parse_keys();
+        parsed = true;
+    }
+    server->addHandler(new KeyGate());
+}
+
+/**
+ * @brief Add the API routes to a server
+ */
+bool http_api_register(AsyncWebServer* server) {
+    if (buffers == NULL) {
+        buffers = (api_buffer_t*)mem_calloc(MEM_BULK, HTTP_API_BUFFERS, sizeof(api_buffer_t));
+        if (buffers == NULL) {
+            return false;
+        }
+    }
+
+    server->on(HTTP_API_PREFIX "/state", HTTP_GET, on_state);
+    server->on(HTTP_API_PREFIX "/metrics", HTTP_GET, on_metrics);
+    server->on(HTTP_API_PREFIX "/sensor", HTTP_GET, on_sensor);
+    server->on(HTTP_API_PREFIX "/devices", HTTP_GET, on_devices);
+    server->on(HTTP_API_PREFIX "/history", HTTP_GET, on_history);
+    server->on(HTTP_API_PREFIX "/location/learn", HTTP_POST, on_location_learn);
+    server->on(HTTP_API_PREFIX "/location/forget", HTTP_POST, on_location_forget);
+    server->on(HTTP_API_PREFIX "/location", HTTP_GET, on_location);
+    server->on(HTTP_API_PREFIX "/states/reset", HTTP_POST, on_states_reset);
+    server->on(HTTP_API_PREFIX "/states", HTTP_GET, on_states);
+    return true;
+}
+
+/**
+ * @brief Match the request's key and take from its quotas, then a token
+ *        from the route's bucket, or answer the request 401 or 429
+ */
+bool http_api_admit(AsyncWebServerRequest* request, http_api_route_t route) {
+    admitted_key = -1;
+    if (key_count > 0) {
+        int8_t key = find_key(request);
+        if (key < 0) {
+            stats.unauthorized++;
+            request->send(401, "text/plain", "API key required");
+            return false;
+        }
+        if (!admit_key(request, key)) {
+            return false;
+        }
+        admitted_key = key;
+    }
+
+    api_bucket_t* bucket = &buckets[route];
+    uint32_t now = millis();
+    uint32_t full = HTTP_API_RATE_BURST * 1000UL;
+    uint32_t elapsed_ms = now - bucket->refilled_ms;
+    bucket->refilled_ms = now;
+    if (elapsed_ms >= full / bucket->per_second) {
+        bucket->milli_tokens = full;
+    } else {
+        bucket->milli_tokens = min(full, bucket->milli_tokens + elapsed_ms * bucket->per_second);
+    }
+    if (bucket->milli_tokens >= 1000) {
+        bucket->milli_tokens -= 1000;
+        return true;
+    }
+
+    stats.limited++;
+    uint32_t wait_ms = (1000 - bucket->milli_tokens) / bucket->per_second;
+    refuse(request, wait_ms / 1000 + 1, "rate limited");
+    return false;
+}
+
+/**
+ * @brief Copy the API figures
+ */
+void http_api_get_stats(http_api_stats_t* out) {
+    *out = stats;
+    out->heavy_streams = heavy_streams;
+    out->buffers_in_use = 0;
+    for (uint8_t i = 0; buffers != NULL && i < HTTP_API_BUFFERS; i++) {
+        out->buffers_in_use += buffers[i].busy ? 1 : 0;
+    }
+}
+
+/**
+ * @brief Keys parsed from HTTP_API_KEYS at registration
+ */
+uint8_t http_api_key_count(void) {
+    return key_count;
+}
+
+/**
+ * @brief Copy one key's quota and figures
+ */
+bool http_api_get_key_stats(uint8_t index, http_api_key_stats_t* out) {
+    if (index >= key_count) {
+        return false;
+    }
+    *out = keys[index].stats;
+    return true;
+}
+
+/**
+ * @brief Committed AI state and the latest sensor data
+ */
+static void on_state(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_STATE)) {
+        return;
+    }
+    uint32_t ticket;
+    api_buffer_t* buffer = claim(request, &ticket, false);
+    if (buffer == NULL) {
+        return;
+    }
+    stats.state++;
+
+    ai_state_publication_t ai;
+    sensor_data_t data;
+    uint32_t ai_version = data_bus_read(BUS_TOPIC_AI_STATE, &ai, 0, sizeof(ai));
+    uint32_t scan_version = sensor_snapshot_read(&data);
+    size_t sensor_len = sensor_data_to_json(&data, buffer->scratch.sensor,
+                                            sizeof(buffer->scratch.sensor));
+
+    StaticJsonDocument<STATE_JSON_CAPACITY> doc;
+    doc["ai_version"] = ai_version;
+    doc["scan_version"] = scan_version;
+    if (ai_version > 0) {
+        JsonObject state = doc.createNestedObject("ai");
+        state["state"] = ai_state_to_string(ai.state);
+        state["previous"] = ai_state_to_string(ai.previous);
+        state["confidence"] = ai.confidence;
+        state["entered_ms"] = ai.entered_ms;
+        state["age_ms"] = millis() - ai.entered_ms;
+        state["transitions"] = ai.transitions;
+    }
+    if (sensor_len > 0) {
+        doc["sensor"] = serialized((const char*)buffer->scratch.sensor, sensor_len);
+    }
+    send_document(request, buffer, ticket, doc);
+}
+
+/**
+ * @brief Bus traffic, the system and capture publications and decision latency
+ */
+static void on_metrics(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_METRICS)) {
+        return;
+    }
+    uint32_t ticket;
+    api_buffer_t* buffer = claim(request, &ticket, false);
+    if (buffer == NULL) {
+        return;
+    }
+    stats.metrics++;
+
+    system_publication_t system = {0};
+    capture_publication_t capture = {0};
+    data_bus_read(BUS_TOPIC_SYSTEM, &system, 0, sizeof(system));
+    data_bus_read(BUS_TOPIC_CAPTURE, &capture, 0, sizeof(capture));
+    ai_inference_stats_t inference;
+    ai_telemetry_t telemetry;
+    ai_inference_get_stats(&inference);
+    ai_telemetry_get(&telemetry);
+
+    StaticJsonDocument<METRICS_JSON_CAPACITY> doc;
+    JsonObject sys = doc.createNestedObject("system");
+    sys["free_memory"] = system.free_memory;
+    sys["uptime_seconds"] = system.uptime_seconds;
+    sys["sd_card_present"] = system.sd_card_present;
+
+    JsonObject cap = doc.createNestedObject("capture");
+    cap["frames_per_second"] = capture.capture_frames_per_second;
+    cap["probe_requests"] = capture.probe_requests;
+    cap["clients"] = capture.wifi_clients_count;
+    cap["randomized_clients"] = capture.randomized_clients;
+    cap["busiest_bssid_fps"] = capture.busiest_bssid_fps;
+    cap["busiest_channel_fps"] = capture.busiest_channel_fps;
+    cap["hop_channel"] = capture.hop_channel;
+    cap["busiest_channel"] = capture.busiest_channel;
+    cap["airtime_permille"] = capture.airtime_permille;
+    cap["busiest_airtime_permille"] = capture.busiest_airtime_permille;
+    cap["busiest_airtime_channel"] = capture.busiest_airtime_channel;
+    cap["associations_per_min"] = capture.associations_per_min;
+    cap["handshakes_per_min"] = capture.handshakes_per_min;
+
+    JsonArray bus = doc.createNestedArray("bus");
+    for (uint8_t topic = 0; topic < BUS_TOPIC_COUNT; topic++) {
+        bus_topic_stats_t topic_stats;
+        data_bus_get_stats((bus_topic_t)topic, &topic_stats);
+        JsonObject entry = bus.createNestedObject();
+        entry["topic"] = topic_stats.name;
+        entry["version"] = topic_stats.version;
+        entry["read_retries"] = topic_stats.read_retries;
+        entry["subscribers"] = topic_stats.subscribers;
+    }
+
+    JsonObject ai = doc.createNestedObject("inference");
+    ai["backend"] = ai_inference_backend_name();
+    ai["model_generation"] = inference.model_generation;
+    ai["decisions"] = telemetry.decisions;
+    ai["model_decisions"] = telemetry.model_decisions;
+    ai["last_us"] = telemetry.last_us;
+    ai["p50_us"] = telemetry.p50_us;
+    ai["p99_us"] = telemetry.p99_us;
+    ai["max_us"] = telemetry.max_us;
+    ai["mean_margin"] = telemetry.mean_margin;
+    send_document(request, buffer, ticket, doc);
+}
+
+/**
+ * @brief The latest sensor data alone: ?format=json|cbor|packed
+ */
+static void on_sensor(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_STATE)) {
+        return;
+    }
+    const char* format = request->hasParam("format") ?
+        request->getParam("format")->value().c_str() : "json";
+    if (strcmp(format, "json") != 0 && strcmp(format, "cbor") != 0 &&
+        strcmp(format, "packed") != 0) {
+        request->send(400, "text/plain", "format is json, cbor or packed");
+        return;
+    }
+
+    uint32_t ticket;
+    api_buffer_t* buffer = claim(request, &ticket, false);
+    if (buffer == NULL) {
+        return;
+    }
+    stats.sensor++;
+
+    sensor_data_t data;
+    if (sensor_snapshot_read(&data) == 0) {
+        release(ticket);
+        request->send(503, "text/plain", "no scan cycle yet");
+        return;
+    }
+    if (format[0] == 'c') {
+        buffer->length = sensor_data_to_cbor(&data, (uint8_t*)buffer->text, sizeof(buffer->text));
+        send_text(request, buffer, ticket, "application/cbor");
+    } else if (format[0] == 'p') {
+        buffer->length = sensor_data_serialize(&data, (uint8_t*)buffer->text, sizeof(buffer->text));
+        send_text(request, buffer, ticket, "application/octet-stream");
+    } else {
+        buffer->length = sensor_data_to_json(&data, buffer->text, sizeof(buffer->text));
+        send_text(request, buffer, ticket, "application/json");
+    }
+}
+
+/**
+ * @brief Every live device: ?kind=wifi|ble&since=<ms>
+ */
+static void on_devices(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_DEVICES)) {
+        return;
+    }
+    int8_t kind = -1;
+    if (request->hasParam("kind")) {
+        const char* name = request->getParam("kind")->value().c_str();
+        if (strcmp(name, "wifi") == 0) {
+            kind = DEVICE_KIND_WIFI_AP;
+        } else if (strcmp(name, "ble") == 0) {
+            kind = DEVICE_KIND_BLE;
+        } else {
+            request->send(400, "text/plain", "kind is wifi or ble");
+            return;
+        }
+    }
+
+    uint32_t ticket;
+    api_buffer_t* buffer = claim(request, &ticket, true);
+    if (buffer == NULL) {
+        return;
+    }
+    stats.devices++;
+
+    buffer->kind = kind;
+    buffer->limit = UINT32_MAX;
+    buffer->after_ms = request->hasParam("since") ?
+        strtoul(request->getParam("since")->value().c_str(), NULL, 10) : 0;
+    buffer->next = next_device;
+    buffer->length = snprintf(buffer->text, sizeof(buffer->text),
+                              "{\"now_ms\":%lu,\"cycle\":%u,\"count\":%lu,\"devices\":[",
+                              millis(), device_table_cycle(), device_table_count());
+    send_chunked(request, buffer, ticket, "application/json");
+}
+
+/**
+ * @brief Points of one metric: ?metric=free_heap&tier=1s|1m|15m, then since=<ms>
+ *        for those after a time, count=N for the newest N, or neither for
+ *        the newest HISTORY_HTTP_MAX_POINTS
+ */
+static void on_history(AsyncWebServerRequest* request) {
+    static const char* const tier_names[HISTORY_TIER_COUNT] = { "1s", "1m", "15m" };
+
+    if (!http_api_admit(request, HTTP_API_ROUTE_HISTORY)) {
+        return;
+    }
+    metric_id_t metric = request->hasParam("metric") ?
+        metrics_history_find(request->getParam("metric")->value().c_str()) : METRIC_COUNT;
+    if (metric == METRIC_COUNT) {
+        request->send(400, "text/plain", "unknown metric");
+        return;
+    }
+    history_tier_t tier = HISTORY_TIER_MINUTES;
+    if (request->hasParam("tier")) {
+        const char* name = request->getParam("tier")->value().c_str();
+        uint8_t t = 0;
+        while (t < HISTORY_TIER_COUNT && strcmp(name, tier_names[t]) != 0) {
+            t++;
+        }
+        if (t == HISTORY_TIER_COUNT) {
+            request->send(400, "text/plain", "tier is 1s, 1m or 15m");
+            return;
+        }
+        tier = (history_tier_t)t;
+    }
+    uint32_t count = UINT32_MAX;
+    if (request->hasParam("count")) {
+        long requested = request->getParam("count")->value().toInt();
+        count = (uint32_t)constrain(requested, 1L, (long)UINT16_MAX);
+    }
+    bool since = request->hasParam("since");
+
+    uint32_t ticket;
+    api_buffer_t* buffer = claim(request, &ticket, true);
+    if (buffer == NULL) {
+        return;
+    }
+    stats.history++;
+
+    uint32_t newest_ms = 0;
+    metric_rollup_t newest;
+    metrics_history_query(tier, metric, &newest, 1, &newest_ms);
+    buffer->tier = tier;
+    buffer->metric = metric;
+    if (since) {
+        buffer->after_ms = strtoul(request->getParam("since")->value().c_str(), NULL, 10);
+        buffer->limit = count;
+    } else {
+        buffer->limit = count != UINT32_MAX ? count : HISTORY_HTTP_MAX_POINTS;
+        buffer->after_ms = metrics_history_newest_after(tier, buffer->limit);
+    }
+    buffer->next = next_point;
+    buffer->length = snprintf(buffer->text, sizeof(buffer->text),
+                              "{\"metric\":\"%s\",\"tier\":\"%s\",\"interval_ms\":%lu,"
+                              "\"newest_ms\":%lu,\"points\":[", metrics_history_name(metric),
+                              tier_names[tier], metrics_history_interval_ms(tier), newest_ms);
+    send_chunked(request, buffer, ticket, "application/json");
+}
+
+/**
+ * @brief Stream the monitors' figures as OpenMetrics text
+ */
+void http_api_send_openmetrics(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_OPENMETRICS)) {
+        return;
+    }
+    uint32_t ticket;
+    api_buffer_t* buffer = claim(request, &ticket, true);
+    if (buffer == NULL) {
+        return;
+    }
+    stats.openmetrics++;
+
+    openmetrics_snapshot(&buffer->scratch.metrics);
+    buffer->next = next_metrics_group;
+    send_chunked(request, buffer, ticket, OPENMETRICS_CONTENT_TYPE);
+}
+
+/**
+ * @brief The last cycle's place and every learned one
+ */
+static void on_location(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_STATE)) {
+        return;
+    }
+    uint32_t ticket;
+    api_buffer_t* buffer = claim(request, &ticket, false);
+    if (buffer == NULL) {
+        return;
+    }
+    stats.location++;
+
+    location_estimate_t estimate;
+    location_stats_t store;
+    static location_label_t labels[LOCATION_LABELS];   // One handler at a time on the TCP task
+    location_get_estimate(&estimate);
+    location_get_stats(&store);
+    location_get_labels(labels);
+
+    int len = snprintf(buffer->text, sizeof(buffer->text),
+                       "{\"label\":%s%s%s,\"match\":%.2f,\"nearest_db\":%.1f,\"anchors_heard\":%u,"
+                       "\"updated_ms\":%lu,\"anchors\":%u,\"fingerprints\":%u,\"learning\":%s%s%s,"
+                       "\"learn_cycles\":%u,\"labels\":[",
+                       estimate.label != LOCATION_UNKNOWN ? "\"" : "",
+                       estimate.label != LOCATION_UNKNOWN ? labels[estimate.label].name : "null",
+                       estimate.label != LOCATION_UNKNOWN ? "\"" : "",
+                       estimate.match / 255.0f, estimate.nearest_db, estimate.anchors_heard,
+                       estimate.updated_ms, store.anchors, store.fingerprints,
+                       store.learning != LOCATION_UNKNOWN ? "\"" : "",
+                       store.learning != LOCATION_UNKNOWN ? labels[store.learning].name : "null",
+                       store.learning != LOCATION_UNKNOWN ? "\"" : "",
+                       store.learn_cycles);
+    bool first = true;
+    for (uint8_t i = 0; i < LOCATION_LABELS; i++) {
+        if (labels[i].name[0] != '\0') {
+            len += snprintf(buffer->text + len, sizeof(buffer->text) - len,
+                            "%s{\"name\":\"%s\",\"fingerprints\":%u}",
+                            first ? "" : ",", labels[i].name, labels[i].fingerprints);
+            first = false;
+        }
+    }
+    len += snprintf(buffer->text + len, sizeof(buffer->text) - len, "]}");
+    buffer->length = (uint16_t)len;
+    send_text(request, buffer, ticket, "application/json");
+}
+
+/**
+ * @brief Fingerprint the next cycles as a place: label=kitchen&cycles=5
+ */
+static void on_location_learn(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_OTHER)) {
+        return;
+    }
+    if (!request->hasParam("label", true)) {
+        request->send(400, "text/plain", "label is required");
+        return;
+    }
+    uint8_t cycles = request->hasParam("cycles", true) ?
+        (uint8_t)constrain(request->getParam("cycles", true)->value().toInt(), 1, UINT8_MAX) : 0;
+    if (!location_learn(request->getParam("label", true)->value().c_str(), cycles)) {
+        request->send(400, "text/plain", "label is 1-15 letters, digits, ' ', '-', '_' or '.', "
+                                         "and every label may be taken");
+        return;
+    }
+    request->send(202, "text/plain", "learning");
+}
+
+/**
+ * @brief Delete a place and its fingerprints: label=kitchen
+ */
+static void on_location_forget(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_OTHER)) {
+        return;
+    }
+    if (!request->hasParam("label", true)) {
+        request->send(400, "text/plain", "label is required");
+        return;
+    }
+    int32_t deleted = location_forget(request->getParam("label", true)->value().c_str());
+    if (deleted < 0) {
+        request->send(404, "text/plain", "no such label");
+        return;
+    }
+    char body[32];
+    snprintf(body, sizeof(body), "%ld fingerprints deleted", deleted);
+    request->send(200, "text/plain", body);
+}
+
+/**
+ * @brief Time in each committed state and the from/to transition counts
+ */
+static void on_states(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_STATE)) {
+        return;
+    }
+    uint32_t ticket;
+    api_buffer_t* buffer = claim(request, &ticket, false);
+    if (buffer == NULL) {
+        return;
+    }
+    stats.states++;
+
+    static ai_state_stats_t figures;    // One handler at a time on the TCP task
+    ai_state_stats_get(&figures);
+
+    int len = snprintf(buffer->text, sizeof(buffer->text),
+                       "{\"current\":\"%s\",\"total_s\":%lu,\"halvings\":%lu,\"restored\":%s,\"states\":[",
+                       ai_state_to_string(figures.current), figures.total_s, figures.halvings,
+                       figures.restored ? "true" : "false");
+    for (uint8_t i = 0; i < AI_STATE_COUNT; i++) {
+        len += snprintf(buffer->text + len, sizeof(buffer->text) - len,
+                        "%s{\"name\":\"%s\",\"seconds\":%lu,\"share\":%.3f,\"entries\":%lu}",
+                        i == 0 ? "" : ",", ai_state_to_string((ai_state_t)i), figures.seconds[i],
+                        figures.total_s > 0 ? (float)figures.seconds[i] / figures.total_s : 0.0f,
+                        figures.entries[i]);
+    }
+    // Rows are the state left, columns the state entered, in the order above
+    len += snprintf(buffer->text + len, sizeof(buffer->text) - len, "],\"transitions\":[");
+    for (uint8_t from = 0; from < AI_STATE_COUNT; from++) {
+        len += snprintf(buffer->text + len, sizeof(buffer->text) - len, "%s[", from == 0 ? "" : ",");
+        for (uint8_t to = 0; to < AI_STATE_COUNT; to++) {
+            len += snprintf(buffer->text + len, sizeof(buffer->text) - len, "%s%u",
+                            to == 0 ? "" : ",", figures.transitions[from][to]);
+        }
+        len += snprintf(buffer->text + len, sizeof(buffer->text) - len, "]");
+    }
+    len += snprintf(buffer->text + len, sizeof(buffer->text) - len, "]}");
+    buffer->length = (uint16_t)len;
+    send_text(request, buffer, ticket, "application/json");
+}
+
+/**
+ * @brief Start the state figures over, e.g. after retuning the dwell times
+ */
+static void on_states_reset(AsyncWebServerRequest* request) {
+    if (!http_api_admit(request, HTTP_API_ROUTE_OTHER)) {
+        return;
+    }
+    ai_state_stats_reset();
+    request->send(200, "text/plain", "state statistics reset");
+}
+
+/**
+ * @brief Take a free buffer for a request, or answer it 503
+ * @param ticket Receives the claim, for release()
+ */
+static api_buffer_t* claim(AsyncWebServerRequest* request, uint32_t* ticket, bool heavy) {
+    int8_t key = admitted_key;
+    http_api_key_stats_t* owner = key >= 0 ? &keys[key].stats : NULL;
+    admitted_key = -1;
+    if (heavy && owner != NULL && owner->stream_max > 0) {
+        portENTER_CRITICAL(&api_mux);
+        bool full = owner->streams >= owner->stream_max;
+        portEXIT_CRITICAL(&api_mux);
+        if (full) {
+            owner->stream_refusals++;
+            stats.key_limited++;
+            refuse(request, 1, "stream quota");
+            return NULL;
+        }
+    }
+
+    for (uint8_t i = 0; i < HTTP_API_BUFFERS; i++) {
+        api_buffer_t* buffer = &buffers[i];
+        portENTER_CRITICAL(&api_mux);
+        bool taken = buffer->busy || (heavy && heavy_streams >= HTTP_API_HEAVY_STREAMS);
+        if (!taken) {
+            buffer->busy = true;
+            buffer->heavy = heavy;
+            buffer->key = key;
+            heavy_streams += heavy ? 1 : 0;
+            if (heavy && owner != NULL) {
+                owner->streams++;
+            }
+        }
+        portEXIT_CRITICAL(&api_mux);
+        if (taken) {
+            continue;
+        }
+        buffer->filling = buffer->abandoned = buffer->finished = false;
+        buffer->ready[0] = buffer->ready[1] = false;
+        buffer->fill_half = buffer->drain_half = 0;
+        buffer->drained = 0;
+        buffer->done = false;
+        buffer->sent = buffer->length = 0;
+        buffer->cursor = buffer->items = buffer->count = 0;
+        buffer->limit = UINT32_MAX;
+        buffer->after_ms = 0;
+        buffer->next = NULL;
+        buffer->ticket = ++claims << TICKET_SLOT_BITS | i;
+        *ticket = buffer->ticket;
+        uint32_t claimed = buffer->ticket;
+        request->onDisconnect([claimed]() { release(claimed); });
+        stats.served++;
+        return buffer;
+    }
+    stats.busy++;
+    AsyncWebServerResponse* response = request->beginResponse(503, "text/plain", "busy");
+    response->addHeader("Retry-After", "1");
+    request->send(response);
+    return NULL;
+}
+
+/**
+ * @brief Free a buffer, unless it has been claimed again since the ticket;
+ *        a buffer a fill job still holds is freed by the job
+ */
+static void release(uint32_t ticket) {
+    api_buffer_t* buffer = &buffers[ticket & ((1 << TICKET_SLOT_BITS) - 1)];
+    portENTER_CRITICAL(&api_mux);
+    if (buffer->busy && buffer->ticket == ticket) {
+        if (buffer->filling) {
+            buffer->abandoned = true;
+        } else {
+            buffer->busy = false;
+            heavy_streams -= buffer->heavy ? 1 : 0;
+            if (buffer->heavy && buffer->key >= 0) {
+                keys[buffer->key].stats.streams--;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&api_mux);
+}
+
+/**
+ * @brief Fill the key table from HTTP_API_KEYS
+ *
+ * Entries are name:secret:requests-per-minute:KiB-per-minute:streams,
+ * separated by ';'; a quota of 0 is no limit. A malformed entry, or one
+ * past HTTP_API_KEY_SLOTS, is skipped with a warning.
+ */
+static void parse_keys(void) {
+    static const char spec[] = HTTP_API_KEYS;
+    const char* entry = spec;
+    uint32_t now = millis();
+    while (*entry != '\0') {
+        const char* end = strchr(entry, ';');
+        size_t len = end != NULL ? (size_t)(end - entry) : strlen(entry);
+        char text[HTTP_API_KEY_NAME_BYTES + HTTP_API_KEY_SECRET_BYTES + 40];
+        api_key_t* key = &keys[key_count];
+        unsigned long per_min = 0, kib = 0;
+        unsigned int streams = 0;
+        bool fits = len < sizeof(text) && key_count < HTTP_API_KEY_SLOTS;
+        if (fits) {
+            memcpy(text, entry, len);
+            text[len] = '\0';
+            memset(key, 0, sizeof(*key));
+        }
+        if (fits && sscanf(text, "%11[^:]:%32[^:]:%lu:%lu:%u", key->stats.name, key->secret,
+                           &per_min, &kib, &streams) == 5) {
+            static_assert(HTTP_API_KEY_NAME_BYTES == 12 && HTTP_API_KEY_SECRET_BYTES == 33,
+                          "key field widths in the scan format");
+            key->hash = 2166136261UL;
+            for (const char* c = key->secret; *c != '\0'; c++) {
+                key->hash = (key->hash ^ (uint8_t)*c) * 16777619UL;
+            }
+            key->stats.requests_per_min = per_min;
+            key->stats.kib_per_min = kib;
+            key->stats.stream_max = min(streams, 255u);
+            key->requests.per_minute = per_min * 1000;
+            key->bytes.per_minute = kib * 1024;
+            key->requests.refilled_ms = key->bytes.refilled_ms = now;
+            key->requests.balance = key->bytes.balance = INT32_MAX;
+            refill(&key->requests, now, 1000);      // Clamps each to a full burst
+            refill(&key->bytes, now, 1);
+            key_count++;
+        } else {
+            LOGW(SYSTEM, "⚠️  API key entry %u not used", (unsigned)key_count + 1);
+        }
+        entry += len + (end != NULL ? 1 : 0);
+    }
+    if (key_count > 0) {
+        LOGI(SYSTEM, "✅ API keys: %u, requests need " HTTP_API_KEY_HEADER, key_count);
+    }
+}
+
+/**
+ * @brief Every request, before its route is picked
+ *
+ * The server drops the headers no handler asked for once one is picked,
+ * so they are all kept here, where every request passes: the key, the
+ * model's CRC, Accept and the cache headers. The SoftAP side is the
+ * provisioning portal, which its own WPA2 key guards.
+ */
+bool KeyGate::canHandle(AsyncWebServerRequest* request) {
+    request->addInterestingHeader("ANY");
+    if (key_count == 0 || !ON_STA_FILTER(request)) {
+        return false;
+    }
+    return find_key(request) < 0;
+}
+
+/**
+ * @brief Turn away a request without a known key
+ */
+void KeyGate::handleRequest(AsyncWebServerRequest* request) {
+    stats.unauthorized++;
+    request->send(401, "text/plain", "API key required");
+}
+
+/**
+ * @brief The table index of the secret the request carries, or -1
+ *
+ * The secret is taken from the key header, or from ?key= where a browser
+ * cannot set one (dashboard pages, the live stream's WebSocket). The
+ * hashes are compared first; a match is confirmed over the whole secret
+ * field, without stopping at the first difference.
+ */
+static int8_t find_key(AsyncWebServerRequest* request) {
+    const String* value = NULL;
+    AsyncWebHeader* header = request->getHeader(HTTP_API_KEY_HEADER);
+    if (header != NULL) {
+        value = &header->value();
+    } else if (request->hasParam("key")) {
+        value = &request->getParam("key")->value();
+    } else {
+        return -1;
+    }
+    const char* presented = value->c_str();
+    size_t len = strlen(presented);
+    if (len == 0 || len >= HTTP_API_KEY_SECRET_BYTES) {
+        return -1;
+    }
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)presented[i]) * 16777619UL;
+    }
+    for (uint8_t k = 0; k < key_count; k++) {
+        if (keys[k].hash != hash) {
+            continue;
+        }
+        uint8_t diff = 0;
+        for (size_t i = 0; i < HTTP_API_KEY_SECRET_BYTES; i++) {
+            diff |= keys[k].secret[i] ^ (i <= len ? presented[i] : 0);
+        }
+        if (diff == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Take a request from a key's quota, or answer it 429
+ *
+ * The byte quota only has to be out of debt: what a response will send is
+ * not known until it has been sent.
+ */
+static bool admit_key(AsyncWebServerRequest* request, int8_t index) {
+    api_key_t* key = &keys[index];
+    uint32_t now = millis();
+    uint32_t wait_s = 0;
+    if (key->requests.per_minute > 0) {
+        refill(&key->requests, now, 1000);
+        if (key->requests.balance < 1000) {
+            wait_s = (uint64_t)(1000 - key->requests.balance) * 60 / key->requests.per_minute + 1;
+        }
+    }
+    if (key->bytes.per_minute > 0) {
+        refill(&key->bytes, now, 1);
+        if (key->bytes.balance <= 0) {
+            wait_s = max(wait_s, (uint32_t)((uint64_t)(1 - (int64_t)key->bytes.balance) * 60 /
+                                            key->bytes.per_minute + 1));
+        }
+    }
+    if (wait_s > 0) {
+        key->stats.limited++;
+        stats.key_limited++;
+        refuse(request, wait_s, "key quota exceeded");
+        return false;
+    }
+    if (key->requests.per_minute > 0) {
+        key->requests.balance -= 1000;
+    }
+    key->stats.requests++;
+    return true;
+}
+
+/**
+ * @brief Add what a quota has earned since it was last refilled, up to
+ *        HTTP_API_KEY_BURST_S seconds of it and never below least
+ */
+static void refill(key_quota_t* quota, uint32_t now, uint32_t least) {
+    int64_t capacity = max((int64_t)quota->per_minute * HTTP_API_KEY_BURST_S / 60, (int64_t)least);
+    capacity = min(capacity, (int64_t)INT32_MAX);
+    int64_t earned = (int64_t)(now - quota->refilled_ms) * quota->per_minute / 60000;
+    if (earned > 0 || quota->balance > capacity) {
+        // The clock moves only once a whole unit is earned, so frequent calls do not round it away
+        quota->refilled_ms = earned > 0 ? now : quota->refilled_ms;
+        quota->balance = (int32_t)min(capacity, (int64_t)quota->balance + earned);
+    }
+}
+
+/**
+ * @brief Charge body bytes handed to the TCP stack to the key that asked for them
+ */
+static void charge(int8_t key, size_t bytes) {
+    if (key < 0) {
+        return;
+    }
+    keys[key].stats.bytes += bytes;
+    if (keys[key].bytes.per_minute > 0) {
+        keys[key].bytes.balance = max((int32_t)INT32_MIN / 2, keys[key].bytes.balance - (int32_t)bytes);
+    }
+}
+
+/**
+ * @brief Answer 429 with a Retry-After
+ */
+static void refuse(AsyncWebServerRequest* request, uint32_t wait_s, const char* reason) {
+    char retry[12];
+    snprintf(retry, sizeof(retry), "%lu", wait_s);
+    AsyncWebServerResponse* response = request->beginResponse(429, "text/plain", reason);
+    response->addHeader("Retry-After", retry);
+    request->send(response);
+}
+
+/**
+ * @brief Serialize a document into the buffer and send it with its length
+ */
+static void send_document(AsyncWebServerRequest* request, api_buffer_t* buffer,
+                          uint32_t ticket, JsonDocument& doc) {
+    if (doc.overflowed() || measureJson(doc) >= sizeof(buffer->text)) {
+        stats.overflowed++;
+        release(ticket);
+        request->send(500, "text/plain", "response too large");
+        return;
+    }
+    buffer->length = serializeJson(doc, buffer->text, sizeof(buffer->text));
+    send_text(request, buffer, ticket, "application/json");
+}
+
+/**
+ * @brief Send buffer->length bytes of buffer->text with their length
+ */
+static void send_text(AsyncWebServerRequest* request, api_buffer_t* buffer, uint32_t ticket,
+                      const char* content_type) {
+    request->send(request->beginResponse(content_type, buffer->length,
+        [buffer, ticket](uint8_t* out, size_t max_len, size_t index) -> size_t {
+            size_t n = min(max_len, (size_t)buffer->length - index);
+            memcpy(out, buffer->text + index, n);
+            charge(buffer->key, n);
+            if (index + n >= buffer->length) {
+                release(ticket);
+            }
+            return n;
+        }));
+}
+
+/**
+ * @brief Send the staged head, then whatever buffer->next stages, chunked
+ */
+static void send_chunked(AsyncWebServerRequest* request, api_buffer_t* buffer, uint32_t ticket,
+                         const char* content_type) {
+    buffer->filling = true;
+    fill_halves(buffer, 1);         // The first half here, so the body starts at once
+    schedule_fill(buffer);
+
+    request->send(request->beginChunkedResponse(content_type,
+        [buffer, ticket](uint8_t* out, size_t max_len, size_t index) -> size_t {
+            size_t len = 0;
+            while (len < max_len) {
+                uint8_t h = buffer->drain_half;
+                portENTER_CRITICAL(&api_mux);
+                bool ready = buffer->ready[h];
+                portEXIT_CRITICAL(&api_mux);
+                if (!ready) {
+                    break;
+                }
+                size_t n = min(max_len - len, (size_t)(buffer->half_length[h] - buffer->drained));
+                memcpy(out + len, buffer->half[h] + buffer->drained, n);
+                buffer->drained += n;
+                len += n;
+                if (buffer->drained >= buffer->half_length[h]) {
+                    portENTER_CRITICAL(&api_mux);
+                    buffer->ready[h] = false;
+                    portEXIT_CRITICAL(&api_mux);
+                    buffer->drain_half = h ^ 1;
+                    buffer->drained = 0;
+                }
+            }
+            if (len > 0) {
+                charge(buffer->key, len);
+                schedule_fill(buffer);
+                return len;
+            }
+            portENTER_CRITICAL(&api_mux);
+            bool ended = buffer->finished && !buffer->filling;
+            portEXIT_CRITICAL(&api_mux);
+            if (ended) {
+                release(ticket);        // Ends the response
+                return 0;
+            }
+            stats.waits++;
+            schedule_fill(buffer);
+            return RESPONSE_TRY_AGAIN;
+        }));
+}
+
+/**
+ * @brief Queue a fill job if a half is free and the body is not complete
+ *
+ * Fills on the TCP task itself only when the job pool is full, so a
+ * response never stalls for want of a descriptor.
+ */
+static void schedule_fill(api_buffer_t* buffer) {
+    portENTER_CRITICAL(&api_mux);
+    bool wanted = !buffer->filling && !buffer->finished && !buffer->ready[buffer->fill_half];
+    buffer->filling = buffer->filling || wanted;
+    portEXIT_CRITICAL(&api_mux);
+    if (!wanted) {
+        return;
+    }
+
+    fill_job_t job = { buffer->ticket };
+    if (job_pool_submit(JOB_LANE_LOW, fill_job, &job, sizeof(job))) {
+        stats.deferred++;
+        return;
+    }
+    stats.inline_fills++;
+    fill_halves(buffer, 1);
+}
+
+/**
+ * @brief Fill the free halves of a chunked response; runs on a job worker
+ */
+static void fill_job(void* payload) {
+    fill_job_t job;
+    memcpy(&job, payload, sizeof(job));
+    fill_halves(&buffers[job.ticket & ((1 << TICKET_SLOT_BITS) - 1)], 2);
+}
+
+/**
+ * @brief Stage text into up to halves free halves in turn, then give up
+ *        the fill; frees the buffer if its request went away meanwhile
+ *
+ * The caller has set filling, which keeps the buffer claimed throughout.
+ */
+static void fill_halves(api_buffer_t* buffer, uint8_t halves) {
+    for (; halves > 0; halves--) {
+        uint8_t h = buffer->fill_half;
+        portENTER_CRITICAL(&api_mux);
+        bool stop = buffer->abandoned || buffer->finished || buffer->ready[h];
+        portEXIT_CRITICAL(&api_mux);
+        if (stop) {
+            break;
+        }
+
+        size_t len = 0;
+        while (len < sizeof(buffer->half[h])) {
+            if (buffer->sent < buffer->length) {
+                size_t n = min(sizeof(buffer->half[h]) - len, (size_t)(buffer->length - buffer->sent));
+                memcpy(buffer->half[h] + len, buffer->text + buffer->sent, n);
+                buffer->sent += n;
+                len += n;
+                continue;
+            }
+            if (buffer->done) {
+                break;
+            }
+            buffer->sent = buffer->length = 0;
+            buffer->done = !buffer->next(buffer);
+        }
+        bool last = buffer->done && buffer->sent >= buffer->length;
+
+        buffer->half_length[h] = len;
+        buffer->fill_half = h ^ 1;
+        portENTER_CRITICAL(&api_mux);
+        buffer->ready[h] = len > 0;
+        buffer->finished = last;
+        portEXIT_CRITICAL(&api_mux);
+    }
+
+    portENTER_CRITICAL(&api_mux);
+    buffer->filling = false;
+    if (buffer->abandoned) {
+        buffer->abandoned = false;
+        buffer->busy = false;
+        heavy_streams -= buffer->heavy ? 1 : 0;
+        if (buffer->heavy && buffer->key >= 0) {
+            keys[buffer->key].stats.streams--;
+        }
+    }
+    portEXIT_CRITICAL(&api_mux);
+}
+
+/**
+ * @brief Stage the next device at or after the cursor, or the closing text
+ */
+static bool next_device(api_buffer_t* buffer) {
+    uint32_t capacity = device_table_capacity();
+    uint8_t pin = device_table_pin();
+    while (buffer->cursor < capacity) {
+        const device_entry_t* entry = device_table_entry_at(buffer->cursor++);
+        if (entry == NULL || (buffer->kind >= 0 && entry->kind != buffer->kind) ||
+            (buffer->after_ms != 0 && (int32_t)(entry->last_seen_ms - buffer->after_ms) <= 0)) {
+            continue;
+        }
+        buffer->length = snprintf(buffer->text, sizeof(buffer->text),
+            "%s{\"mac\":\"%02x:%02x:%02x:%02x:%02x:%02x\",\"kind\":\"%s\",\"channel\":%u,"
+            "\"rssi\":%d,\"rssi_min\":%d,\"rssi_max\":%d,\"sightings\":%lu,"
+            "\"first_seen_ms\":%lu,\"last_seen_ms\":%lu,\"trend_db_per_min\":%.1f,\"stay_ms\":%lu,"
+            "\"visits\":%u,\"companions\":%u,\"following\":%s}",
+            buffer->items > 0 ? "," : "", entry->mac[0], entry->mac[1], entry->mac[2],
+            entry->mac[3], entry->mac[4], entry->mac[5],
+            entry->kind == DEVICE_KIND_BLE ? "ble" : "wifi", entry->channel, entry->rssi_last,
+            entry->rssi_min, entry->rssi_max, entry->sightings, entry->first_seen_ms,
+            entry->last_seen_ms, device_table_trend(entry), device_table_stay_ms(entry),
+            entry->track.visits, device_table_companions(entry), entry->track.following ? "true" : "false");
+        device_table_unpin(pin);
+        buffer->items++;
+        return true;
+    }
+    device_table_unpin(pin);
+    buffer->length = snprintf(buffer->text, sizeof(buffer->text), "]}");
+    return false;
+}
+
+/**
+ * @brief Stage the next history point, reading the next page when one runs
+ *        out, or the closing text
+ */
+static bool next_point(api_buffer_t* buffer) {
+    if (buffer->cursor >= buffer->count && buffer->items < buffer->limit) {
+        buffer->cursor = 0;
+        buffer->count = metrics_history_read_after((history_tier_t)buffer->tier,
+                                                   (metric_id_t)buffer->metric, buffer->after_ms,
+                                                   buffer->scratch.page.points,
+                                                   buffer->scratch.page.end_ms,
+                                                   HTTP_API_HISTORY_PAGE);
+        if (buffer->count > 0) {
+            buffer->after_ms = buffer->scratch.page.end_ms[buffer->count - 1];
+        }
+    }
+    if (buffer->cursor >= buffer->count || buffer->items >= buffer->limit) {
+        buffer->length = snprintf(buffer->text, sizeof(buffer->text), "]}");
+        return false;
+    }
+    uint32_t i = buffer->cursor++;
+    const metric_rollup_t* point = &buffer->scratch.page.points[i];
+    buffer->length = snprintf(buffer->text, sizeof(buffer->text),
+                              buffer->items > 0 ? ",[%lu,%ld,%ld,%ld]" : "[%lu,%ld,%ld,%ld]",
+                              buffer->scratch.page.end_ms[i], point->min, point->avg, point->max);
+    buffer->items++;
+    return true;
+}
+
+/**
+ * @brief Stage the next group of metric families, or the closing "# EOF"
+ */
+static bool next_metrics_group(api_buffer_t* buffer) {
+    if (buffer->cursor >= openmetrics_group_count()) {
+        buffer->length = snprintf(buffer->text, sizeof(buffer->text), "# EOF\n");
+        return false;
+    }
+    buffer->length = openmetrics_write_group(&buffer->scratch.metrics, buffer->cursor++,
+                                             buffer->text, sizeof(buffer->text));
+    return true;
+}
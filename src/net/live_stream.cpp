@@ -0,0 +1,364 @@
+/**
+ * @file live_stream.cpp
+ * @brief WebSocket push of AI transitions, scan cycles and metric changes
+ *
+ * A small task subscribes to the bus topics and sleeps until one is
+ * published. It then rebuilds the latest frame of that kind, in both
+ * encodings, and marks it pending for every client. Clients are sent
+ * their pending kinds in turn. If a client's send queue is full, its
+ * kinds stay pending, and a newer publication of the same kind replaces
+ * the one it never took. So a slow client falls behind by at most one
+ * update of each kind, never by a queue of them.
+ *
+ * Metrics are only pushed when a figure moves; the free memory must move by
+ * LIVE_STREAM_MEMORY_DELTA and at most one push per LIVE_STREAM_METRICS_MIN_MS
+ * goes out, so the system task's once-a-second publication does not become
+ * a once-a-second frame.
+ *
+ * The client table is written on the async TCP task (connect, disconnect,
+ * format switches) and read by the push task, under live_mux. Every call
+ * into the WebSocket itself is made from the push task.
+ */
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "data_bus.h"
+#include "sensor_snapshot.h"
+#include "live_stream.h"
+
+// Notification bits, one per reason to wake
+#define LIVE_EVENT_STATE   (1 << 0)
+#define LIVE_EVENT_CYCLE   (1 << 1)
+#define LIVE_EVENT_METRICS (1 << 2)
+#define LIVE_EVENT_CLIENT  (1 << 3)     // Connect or format switch, send what is pending
+
+#define KIND_BIT(type) (1 << ((type) - 1))
+#define ALL_KINDS      ((1 << LIVE_FRAME_KINDS) - 1)
+
+#define TEXT_FRAME_BYTES 256
+
+/**
+ * @brief One connected client
+ */
+typedef struct {
+    uint32_t id;                    // AsyncWebSocketClient::id(), 0 for a free slot
+    uint8_t  pending;               // KIND_BIT()s built but not yet sent
+    bool     binary;
+} live_client_t;
+
+/**
+ * @brief Latest frame of one kind, in both encodings
+ */
+typedef struct {
+    bool     built;
+    uint16_t text_len;
+    uint16_t binary_len;
+    char     text[TEXT_FRAME_BYTES];
+    uint8_t  binary[24];
+} live_frame_t;
+
+static AsyncWebSocket* live_socket = NULL;
+static TaskHandle_t push_handle = NULL;
+static StaticTask_t push_tcb;
+static StackType_t push_stack[LIVE_STREAM_STACK_SIZE];
+
+static live_client_t clients[LIVE_STREAM_CLIENTS];
+static live_frame_t frames[LIVE_FRAME_KINDS];
+static live_metrics_frame_t metrics_sent;   // Figures of the last metrics frame pushed
+static uint32_t metrics_sent_ms = 0;
+static live_stream_stats_t stats = {0};
+static portMUX_TYPE live_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void on_event(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type,
+                     void* arg, uint8_t* data, size_t len);
+static void push_task(void* parameter);
+static uint8_t build_frames(uint32_t events, uint32_t now_ms);
+static bool flush_clients(uint8_t fresh);
+static bool send_frame(AsyncWebSocketClient* client, const live_frame_t* frame, bool binary);
+
+/**
+ * @brief Add the WebSocket on LIVE_STREAM_PATH and start the push task
+ */
+bool live_stream_register(AsyncWebServer* server) {
+    if (live_socket != NULL) {
+        return true;
+    }
+
+    push_handle = xTaskCreateStaticPinnedToCore(push_task, "Live_Push", LIVE_STREAM_STACK_SIZE,
+                                                NULL, LIVE_STREAM_PRIORITY, push_stack,
+                                                &push_tcb, tskNO_AFFINITY);
+    if (push_handle == NULL) {
+        return false;
+    }
+    data_bus_subscribe(BUS_TOPIC_AI_STATE, push_handle, LIVE_EVENT_STATE);
+    data_bus_subscribe(BUS_TOPIC_SCAN, push_handle, LIVE_EVENT_CYCLE);
+    data_bus_subscribe(BUS_TOPIC_SYSTEM, push_handle, LIVE_EVENT_METRICS);
+    data_bus_subscribe(BUS_TOPIC_CAPTURE, push_handle, LIVE_EVENT_METRICS);
+
+    live_socket = new AsyncWebSocket(LIVE_STREAM_PATH);
+    live_socket->onEvent(on_event);
+    server->addHandler(live_socket);
+    return true;
+}
+
+/**
+ * @brief Copy the live stream figures
+ */
+void live_stream_get_stats(live_stream_stats_t* out) {
+    portENTER_CRITICAL(&live_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&live_mux);
+}
+
+/**
+ * @brief Track clients and their chosen encoding; runs on the async TCP task
+ */
+static void on_event(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type,
+                     void* arg, uint8_t* data, size_t len) {
+    if (type == WS_EVT_CONNECT) {
+        bool added = false;
+        portENTER_CRITICAL(&live_mux);
+        for (uint8_t i = 0; i < LIVE_STREAM_CLIENTS && !added; i++) {
+            if (clients[i].id == 0) {
+                clients[i].id = client->id();
+                clients[i].pending = ALL_KINDS;
+                clients[i].binary = false;
+                stats.clients++;
+                stats.connects++;
+                added = true;
+            }
+        }
+        stats.refused += added ? 0 : 1;
+        portEXIT_CRITICAL(&live_mux);
+        if (!added) {
+            client->close(1013, "busy");    // Try again later
+            return;
+        }
+    } else if (type == WS_EVT_DISCONNECT) {
+        portENTER_CRITICAL(&live_mux);
+        for (uint8_t i = 0; i < LIVE_STREAM_CLIENTS; i++) {
+            if (clients[i].id == client->id()) {
+                clients[i].id = 0;
+                stats.clients--;
+            }
+        }
+        portEXIT_CRITICAL(&live_mux);
+        return;
+    } else if (type == WS_EVT_DATA) {
+        AwsFrameInfo* info = (AwsFrameInfo*)arg;
+        if (info->opcode != WS_TEXT || info->index != 0 || info->len != len) {
+            return;
+        }
+        bool binary = len == 6 && memcmp(data, "binary", 6) == 0;
+        if (!binary && !(len == 4 && memcmp(data, "json", 4) == 0)) {
+            return;
+        }
+        portENTER_CRITICAL(&live_mux);
+        for (uint8_t i = 0; i < LIVE_STREAM_CLIENTS; i++) {
+            if (clients[i].id == client->id() && clients[i].binary != binary) {
+                clients[i].binary = binary;
+                clients[i].pending = ALL_KINDS;     // Everything again, in the new encoding
+            }
+        }
+        portEXIT_CRITICAL(&live_mux);
+    } else {
+        return;
+    }
+    xTaskNotify(push_handle, LIVE_EVENT_CLIENT, eSetBits);
+}
+
+/**
+ * @brief Sleep until a publication or a client needs a send, then push
+ */
+static void push_task(void* parameter) {
+    bool backlog = false;
+    while (true) {
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events,
+                        backlog ? pdMS_TO_TICKS(LIVE_STREAM_RETRY_MS) : portMAX_DELAY);
+
+        portENTER_CRITICAL(&live_mux);
+        uint8_t connected = stats.clients;
+        portEXIT_CRITICAL(&live_mux);
+        if (connected == 0) {
+            backlog = false;
+            continue;                   // Nothing is built for nobody
+        }
+
+        if (events & LIVE_EVENT_CLIENT) {
+            events |= LIVE_EVENT_STATE | LIVE_EVENT_CYCLE | LIVE_EVENT_METRICS;
+        }
+        uint8_t fresh = build_frames(events, millis());
+        live_socket->cleanupClients(LIVE_STREAM_CLIENTS);
+        backlog = flush_clients(fresh);
+    }
+}
+
+/**
+ * @brief Rebuild the frames whose topics were published
+ *
+ * A client that has just connected needs every frame even when nothing
+ * changed, so frames are rebuilt on LIVE_EVENT_CLIENT as well. Only real
+ * changes are returned as fresh for the other clients.
+ * @return KIND_BIT()s of frames that changed
+ */
+static uint8_t build_frames(uint32_t events, uint32_t now_ms) {
+    uint8_t fresh = 0;
+
+    if (events & LIVE_EVENT_STATE) {
+        ai_state_publication_t ai;
+        if (data_bus_read(BUS_TOPIC_AI_STATE, &ai, 0, sizeof(ai)) > 0) {
+            live_frame_t* frame = &frames[LIVE_FRAME_STATE - 1];
+            live_state_frame_t* bin = (live_state_frame_t*)frame->binary;
+            fresh |= (!frame->built || bin->transitions != ai.transitions) ?
+                     KIND_BIT(LIVE_FRAME_STATE) : 0;
+            bin->type = LIVE_FRAME_STATE;
+            bin->state = ai.state;
+            bin->previous = ai.previous;
+            bin->confidence_pct = (uint8_t)(ai.confidence * 100.0f + 0.5f);
+            bin->transitions = ai.transitions;
+            bin->age_ms = now_ms - ai.entered_ms;
+            frame->binary_len = sizeof(*bin);
+            frame->text_len = snprintf(frame->text, sizeof(frame->text),
+                "{\"type\":\"state\",\"state\":\"%s\",\"previous\":\"%s\",\"confidence\":%.2f,"
+                "\"transitions\":%lu,\"age_ms\":%lu}",
+                ai_state_to_string(ai.state), ai_state_to_string(ai.previous), ai.confidence,
+                ai.transitions, bin->age_ms);
+            frame->built = true;
+        }
+    }
+
+    if (events & LIVE_EVENT_CYCLE) {
+        sensor_data_t data;
+        if (sensor_snapshot_read(&data) > 0) {
+            live_frame_t* frame = &frames[LIVE_FRAME_CYCLE - 1];
+            live_cycle_frame_t* bin = (live_cycle_frame_t*)frame->binary;
+            fresh |= (!frame->built || bin->cycle != data.scan_cycle) ? KIND_BIT(LIVE_FRAME_CYCLE) : 0;
+            bin->type = LIVE_FRAME_CYCLE;
+            bin->hop_channel = data.hop_channel;
+            bin->cycle = data.scan_cycle;
+            bin->wifi_networks = data.wifi_networks_count;
+            bin->ble_devices = data.ble_devices_count;
+            bin->wifi_rssi = data.wifi_signal_strength;
+            bin->ble_rssi = data.ble_signal_strength;
+            bin->appeared = data.devices_appeared;
+            bin->lost = data.devices_lost;
+            bin->moved = data.devices_moved;
+            bin->novel = data.novel_devices;
+            frame->binary_len = sizeof(*bin);
+            frame->text_len = snprintf(frame->text, sizeof(frame->text),
+                "{\"type\":\"cycle\",\"cycle\":%u,\"wifi\":%u,\"ble\":%u,\"wifi_rssi\":%d,"
+                "\"ble_rssi\":%d,\"appeared\":%u,\"lost\":%u,\"moved\":%u,\"novel\":%u,\"channel\":%u}",
+                bin->cycle, bin->wifi_networks, bin->ble_devices, bin->wifi_rssi, bin->ble_rssi,
+                bin->appeared, bin->lost, bin->moved, bin->novel, bin->hop_channel);
+            frame->built = true;
+        }
+    }
+
+    if (events & LIVE_EVENT_METRICS) {
+        system_publication_t system = {0};
+        capture_publication_t capture = {0};
+        data_bus_read(BUS_TOPIC_SYSTEM, &system, 0, sizeof(system));
+        data_bus_read(BUS_TOPIC_CAPTURE, &capture, 0, sizeof(capture));
+
+        live_metrics_frame_t now = {0};
+        now.type = LIVE_FRAME_METRICS;
+        now.sd_card_present = system.sd_card_present;
+        now.hop_channel = capture.hop_channel;
+        now.busiest_channel = capture.busiest_channel;
+        now.free_memory = system.free_memory;
+        now.uptime_seconds = system.uptime_seconds;
+        now.frames_per_second = capture.capture_frames_per_second;
+        now.probe_requests = capture.probe_requests;
+        now.clients = capture.wifi_clients_count;
+        now.randomized_clients = capture.randomized_clients;
+
+        // Moved: any figure but memory and uptime, or memory by the delta
+        int32_t memory_delta = (int32_t)(now.free_memory - metrics_sent.free_memory);
+        live_metrics_frame_t a = now, b = metrics_sent;
+        a.free_memory = b.free_memory = 0;
+        a.uptime_seconds = b.uptime_seconds = 0;
+        bool moved = memcmp(&a, &b, sizeof(a)) != 0 || abs(memory_delta) >= LIVE_STREAM_MEMORY_DELTA;
+        bool due = now_ms - metrics_sent_ms >= LIVE_STREAM_METRICS_MIN_MS;
+        live_frame_t* frame = &frames[LIVE_FRAME_METRICS - 1];
+        if ((moved && due) || !frame->built) {
+            fresh |= KIND_BIT(LIVE_FRAME_METRICS);
+            metrics_sent = now;
+            metrics_sent_ms = now_ms;
+            memcpy(frame->binary, &now, sizeof(now));
+            frame->binary_len = sizeof(now);
+            frame->text_len = snprintf(frame->text, sizeof(frame->text),
+                "{\"type\":\"metrics\",\"free_memory\":%lu,\"uptime_seconds\":%lu,\"sd\":%s,"
+                "\"fps\":%u,\"probes\":%u,\"clients\":%u,\"randomized\":%u,"
+                "\"hop_channel\":%u,\"busiest_channel\":%u}",
+                now.free_memory, now.uptime_seconds, now.sd_card_present ? "true" : "false",
+                now.frames_per_second, now.probe_requests, now.clients, now.randomized_clients,
+                now.hop_channel, now.busiest_channel);
+            frame->built = true;
+        }
+    }
+    return fresh;
+}
+
+/**
+ * @brief Mark fresh frames pending for every client and send what each can take
+ * @return true if a client was left with frames pending
+ */
+static bool flush_clients(uint8_t fresh) {
+    bool backlog = false;
+    for (uint8_t i = 0; i < LIVE_STREAM_CLIENTS; i++) {
+        portENTER_CRITICAL(&live_mux);
+        uint32_t id = clients[i].id;
+        uint8_t pending = clients[i].pending;
+        stats.coalesced += __builtin_popcount(pending & fresh);
+        clients[i].pending = 0;
+        bool binary = clients[i].binary;
+        portEXIT_CRITICAL(&live_mux);
+        if (id == 0) {
+            continue;
+        }
+        pending |= fresh;
+
+        AsyncWebSocketClient* client = live_socket->client(id);
+        uint32_t sent = 0, deferred = 0;
+        for (uint8_t type = LIVE_FRAME_STATE; client != NULL && type <= LIVE_FRAME_KINDS; type++) {
+            const live_frame_t* frame = &frames[type - 1];
+            if (!(pending & KIND_BIT(type)) || !frame->built) {
+                continue;
+            }
+            if (!send_frame(client, frame, binary)) {
+                deferred++;
+                continue;
+            }
+            pending &= ~KIND_BIT(type);
+            sent++;
+        }
+
+        portENTER_CRITICAL(&live_mux);
+        if (clients[i].id == id) {
+            clients[i].pending |= pending;  // Beside anything a format switch set meanwhile
+            backlog |= clients[i].pending != 0;
+        }
+        stats.frames_sent += sent;
+        stats.deferred += deferred;
+        portEXIT_CRITICAL(&live_mux);
+    }
+    return backlog;
+}
+
+/**
+ * @brief Queue one frame to a client unless its queue is full
+ */
+static bool send_frame(AsyncWebSocketClient* client, const live_frame_t* frame, bool binary) {
+    if (!client->canSend()) {
+        return false;
+    }
+    if (binary) {
+        client->binary((const char*)frame->binary, frame->binary_len);
+    } else {
+        client->text(frame->text, frame->text_len);
+    }
+    return true;
+}
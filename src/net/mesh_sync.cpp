@@ -0,0 +1,511 @@
+/**
+ * @file mesh_sync.cpp
+ * @brief ESP-NOW digest exchange between HydraESP nodes
+ *
+ * Each node broadcasts compact digests of the device table entries that
+ * changed since they were last shared. Peer BLE entries are compared with
+ * our own table to decide whether a peer hears the same airspace; nearby
+ * nodes then split the WiFi channel sweep between them and merge each
+ * other's access points into their device tables.
+ *
+ * Frames carry the sender's radio clock. Transit latency only ever adds to
+ * the observed offset, so the estimator follows new minima immediately and
+ * drifts upward slowly; sightings mapped through it can be deduplicated
+ * and ordered across nodes without a shared time source. Once the offset
+ * has settled it also carries the sender's wall clock over to us, for the
+ * time service to take if the sender's clock is the better one.
+ *
+ * ESP-NOW only delivers frames to nodes tuned to the same channel, so
+ * digests go out on MESH_HOME_CHANNEL. Every digest is self-contained,
+ * so a frame missed while a receiver is hopping is simply superseded by
+ * the next refresh.
+ */
+
+#include <Arduino.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "config.h"
+#include "mesh_sync.h"
+#include "device_table.h"
+#include "wifi_scan.h"
+#include "time_sync.h"
+#include "logger.h"
+
+/**
+ * @brief Raw frame handed from the WiFi task to the scan task
+ */
+typedef struct {
+    uint32_t rx_us;                 // Our radio clock at reception
+    uint8_t  mac[6];
+    uint8_t  len;
+    uint8_t  data[MESH_MAX_FRAME_BYTES];
+} mesh_rx_item_t;
+
+static const uint8_t broadcast_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static QueueHandle_t rx_queue = NULL;
+static StaticQueue_t rx_queue_state;
+static uint8_t rx_queue_storage[MESH_RX_QUEUE_LENGTH * sizeof(mesh_rx_item_t)];
+static mesh_peer_t peers[MESH_MAX_PEERS];
+static mesh_stats_t stats;
+static uint8_t own_mac[6];
+static uint16_t tx_seq = 0;
+static uint32_t tx_cursor = 0;
+static bool mesh_ready = false;
+
+// Written from the WiFi task
+static volatile uint32_t rx_dropped = 0;
+static volatile uint32_t rx_rejected = 0;
+
+// Forward declarations
+static void on_receive(const uint8_t* mac, const uint8_t* data, int len);
+static void handle_frame(const mesh_rx_item_t* item, uint32_t now_ms);
+static void update_clock_offset(mesh_peer_t* peer, uint32_t rx_us, uint32_t tx_us);
+static mesh_peer_t* find_peer(const uint8_t* mac, uint32_t now_ms);
+static bool peer_is_nearby(const mesh_peer_t* peer);
+static void send_dirty_entries(uint32_t now_ms);
+static bool send_frame(uint8_t* frame, uint8_t entry_count, uint32_t tx_time_us);
+
+/**
+ * @brief Bring up ESP-NOW and register the broadcast peer
+ */
+bool mesh_sync_init(void) {
+    memset(peers, 0, sizeof(peers));
+    memset(&stats, 0, sizeof(stats));
+    stats.local_mask = SCAN_CHANNEL_MASK_ALL;
+
+    if (rx_queue == NULL) {
+        rx_queue = xQueueCreateStatic(MESH_RX_QUEUE_LENGTH, sizeof(mesh_rx_item_t),
+                                      rx_queue_storage, &rx_queue_state);
+    }
+
+    if (esp_now_init() != ESP_OK) {
+        LOGE(MESH, "❌ ESP-NOW initialization failed");
+        return false;
+    }
+
+    esp_now_peer_info_t broadcast_peer;
+    memset(&broadcast_peer, 0, sizeof(broadcast_peer));
+    memcpy(broadcast_peer.peer_addr, broadcast_mac, sizeof(broadcast_mac));
+    broadcast_peer.channel = 0;     // Follow the current radio channel
+    broadcast_peer.ifidx = WIFI_IF_STA;
+    broadcast_peer.encrypt = false;
+    if (esp_now_add_peer(&broadcast_peer) != ESP_OK) {
+        LOGE(MESH, "❌ ESP-NOW broadcast peer registration failed");
+        return false;
+    }
+
+    esp_wifi_get_mac(WIFI_IF_STA, own_mac);
+    esp_now_register_recv_cb(on_receive);
+    mesh_ready = true;
+
+    LOGI(MESH, "✅ Mesh sync on channel %d (%d entries per frame)",
+         MESH_HOME_CHANNEL, (int)MESH_ENTRIES_PER_FRAME);
+    return true;
+}
+
+/**
+ * @brief Drain received digests, expire peers and send dirty entries
+ */
+void mesh_sync_tick(uint32_t now_ms) {
+    if (!mesh_ready) {
+        return;
+    }
+
+    mesh_rx_item_t item;
+    while (xQueueReceive(rx_queue, &item, 0) == pdTRUE) {
+        handle_frame(&item, now_ms);
+    }
+
+    // Expire silent peers so their channels are swept locally again
+    stats.peer_count = 0;
+    stats.nearby_peers = 0;
+    for (uint8_t i = 0; i < MESH_MAX_PEERS; i++) {
+        if (!peers[i].used) {
+            continue;
+        }
+        if (now_ms - peers[i].last_seen_ms > MESH_PEER_TTL_MS) {
+            LOGI(MESH, "📴 Mesh peer %02X:%02X:%02X lost",
+                 peers[i].mac[3], peers[i].mac[4], peers[i].mac[5]);
+            peers[i].used = false;
+            continue;
+        }
+        stats.peer_count++;
+        if (peer_is_nearby(&peers[i])) {
+            stats.nearby_peers++;
+        }
+    }
+
+    send_dirty_entries(now_ms);
+
+    stats.rx_dropped = rx_dropped;
+    stats.frames_rejected = rx_rejected;
+}
+
+/**
+ * @brief Restrict a channel mask to this node's share of the airspace
+ */
+uint16_t mesh_sync_filter_mask(uint16_t mask) {
+    if (!mesh_ready || __builtin_popcount(mask) <= 1) {
+        stats.local_mask = mask;
+        return mask;
+    }
+
+    // Rank among nearby nodes by station address; every node computes
+    // the same order, so the shares do not overlap
+    uint8_t node_count = 1;
+    uint8_t rank = 0;
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < MESH_MAX_PEERS; i++) {
+        if (peers[i].used && now - peers[i].last_seen_ms <= MESH_PEER_TTL_MS &&
+            peer_is_nearby(&peers[i])) {
+            node_count++;
+            if (memcmp(peers[i].mac, own_mac, sizeof(own_mac)) < 0) {
+                rank++;
+            }
+        }
+    }
+
+    uint16_t share = 0;
+    uint8_t index = 0;
+    for (uint8_t channel = 1; channel <= WIFI_CHANNEL_COUNT; channel++) {
+        if (mask & (1 << channel)) {
+            if (index % node_count == rank) {
+                share |= 1 << channel;
+            }
+            index++;
+        }
+    }
+
+    stats.local_mask = share;
+    return share;
+}
+
+/**
+ * @brief WiFi APs reported by peers on channels this node skips
+ */
+uint16_t mesh_sync_remote_networks(uint32_t now_ms) {
+    if (stats.nearby_peers == 0) {
+        return 0;
+    }
+
+    uint16_t count = 0;
+    uint32_t capacity = device_table_capacity();
+    for (uint32_t i = 0; i < capacity; i++) {
+        const device_entry_t* entry = device_table_entry_at(i);
+        if (entry != NULL && entry->kind == DEVICE_KIND_WIFI_AP && entry->channel != 0 &&
+            !(stats.local_mask & (1 << entry->channel)) &&
+            now_ms - entry->last_seen_ms <= MESH_REMOTE_TTL_MS) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Map a peer's radio timestamp onto our own clock
+ */
+bool mesh_sync_to_local_time(const uint8_t* peer_mac, uint32_t remote_us, uint32_t* local_us) {
+    if (peer_mac == NULL || local_us == NULL) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < MESH_MAX_PEERS; i++) {
+        if (peers[i].used && memcmp(peers[i].mac, peer_mac, sizeof(peers[i].mac)) == 0) {
+            if (peers[i].clock_samples < MESH_CLOCK_MIN_SAMPLES) {
+                return false;
+            }
+            *local_us = remote_us + (uint32_t)peers[i].clock_offset_us;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Copy the mesh statistics
+ */
+void mesh_sync_get_stats(mesh_stats_t* out) {
+    if (out != NULL) {
+        *out = stats;
+    }
+}
+
+/**
+ * @brief Copy the peer list
+ */
+uint8_t mesh_sync_get_peers(mesh_peer_t* out, uint8_t capacity) {
+    if (out == NULL) {
+        return 0;
+    }
+
+    uint8_t copied = 0;
+    for (uint8_t i = 0; i < MESH_MAX_PEERS && copied < capacity; i++) {
+        if (peers[i].used) {
+            out[copied++] = peers[i];
+        }
+    }
+    return copied;
+}
+
+/**
+ * @brief ESP-NOW receive callback - runs in the WiFi task
+ */
+static void on_receive(const uint8_t* mac, const uint8_t* data, int len) {
+    if (mac == NULL || data == NULL || len < (int)sizeof(mesh_header_t) ||
+        len > MESH_MAX_FRAME_BYTES) {
+        rx_rejected++;
+        return;
+    }
+
+    mesh_rx_item_t item;
+    item.rx_us = (uint32_t)esp_timer_get_time();
+    memcpy(item.mac, mac, sizeof(item.mac));
+    item.len = (uint8_t)len;
+    memcpy(item.data, data, len);
+    if (xQueueSend(rx_queue, &item, 0) != pdTRUE) {
+        rx_dropped++;
+    }
+}
+
+/**
+ * @brief Validate a digest and fold its entries into the peer and table
+ */
+static void handle_frame(const mesh_rx_item_t* item, uint32_t now_ms) {
+    mesh_header_t header;
+    memcpy(&header, item->data, sizeof(header));
+    if (header.magic != MESH_MAGIC || header.version != MESH_VERSION ||
+        header.type != MESH_MSG_DIGEST ||
+        item->len != sizeof(header) + header.entry_count * sizeof(mesh_entry_t)) {
+        rx_rejected++;
+        return;
+    }
+
+    mesh_peer_t* peer = find_peer(item->mac, now_ms);
+    if (peer == NULL) {
+        rx_rejected++;
+        return;
+    }
+
+    uint16_t gap = header.seq - peer->last_seq;
+    if (peer->entries_rx > 0 && gap > 1 && gap < 0x8000) {
+        peer->frames_lost += gap - 1;
+    }
+    peer->last_seq = header.seq;
+    peer->channel_mask = header.channel_mask;
+    peer->cycle_seq = header.cycle_seq;
+    peer->last_seen_ms = now_ms;
+    update_clock_offset(peer, item->rx_us, header.tx_time_us);
+    bool clock_valid = peer->clock_samples >= MESH_CLOCK_MIN_SAMPLES;
+    if (clock_valid && header.time_stratum != 0) {
+        // The sender's transmission on our clock, widened to 64 bits
+        uint32_t local_tx_us = header.tx_time_us + (uint32_t)peer->clock_offset_us;
+        int64_t now_us = esp_timer_get_time();
+        time_sync_offer_peer(header.time_stratum, header.tx_wall_ms,
+                             now_us - (uint32_t)((uint32_t)now_us - local_tx_us));
+    }
+    peer->entries_rx += header.entry_count;
+    stats.frames_rx++;
+
+    const mesh_entry_t* entries = (const mesh_entry_t*)(item->data + sizeof(header));
+    for (uint8_t i = 0; i < header.entry_count; i++) {
+        mesh_entry_t entry;
+        memcpy(&entry, &entries[i], sizeof(entry));
+
+        // Sighting time on our clock; until the offset settles, assume
+        // the frame arrived the moment it was sent
+        uint32_t seen_us = header.tx_time_us - entry.age_ms * 1000UL;
+        seen_us = clock_valid ? seen_us + (uint32_t)peer->clock_offset_us
+                              : item->rx_us - entry.age_ms * 1000UL;
+
+        if (entry.kind == DEVICE_KIND_BLE) {
+            // Every node hears BLE, so shared advertisers measure overlap
+            peer->compared++;
+            const device_entry_t* local = device_table_find(entry.mac, DEVICE_KIND_BLE);
+            if (local != NULL && now_ms - local->last_seen_ms <= MESH_REMOTE_TTL_MS) {
+                peer->shared++;
+                int16_t offset_x16 = local->rssi_ewma_x16 - (int16_t)(entry.rssi * 16);
+                peer->rssi_offset_x16 += (offset_x16 - peer->rssi_offset_x16) >> 3;
+            }
+
+            // Halve the counts so overlap tracks recent movement
+            if (peer->compared >= 1024) {
+                peer->compared >>= 1;
+                peer->shared >>= 1;
+            }
+        } else if (entry.kind == DEVICE_KIND_WIFI_AP && entry.channel >= 1 &&
+                   entry.channel <= WIFI_CHANNEL_COUNT &&
+                   !(stats.local_mask & (1 << entry.channel))) {
+            // Only channels handed to peers; our own sweep is authoritative.
+            // A sighting no newer than the one we hold was relayed already
+            const device_entry_t* known = device_table_find(entry.mac, DEVICE_KIND_WIFI_AP);
+            if (known != NULL && (int32_t)(seen_us - known->last_seen_us) <= 0) {
+                stats.entries_duplicate++;
+                continue;
+            }
+            device_table_observe(entry.mac, DEVICE_KIND_WIFI_AP, entry.rssi, entry.channel,
+                                 now_ms - entry.age_ms, seen_us);
+            stats.entries_merged++;
+        }
+    }
+}
+
+/**
+ * @brief Fold one frame's clock sample into the peer's offset estimate
+ */
+static void update_clock_offset(mesh_peer_t* peer, uint32_t rx_us, uint32_t tx_us) {
+    int32_t sample = (int32_t)(rx_us - tx_us);
+
+    if (peer->clock_samples == 0 || sample < peer->clock_offset_us) {
+        // Lower samples saw less queuing delay: take them as they come
+        peer->clock_offset_us = sample;
+    } else {
+        // Follow crystal drift upward without chasing slow deliveries
+        peer->clock_offset_us += (sample - peer->clock_offset_us) >> MESH_CLOCK_EWMA_SHIFT;
+    }
+
+    if (peer->clock_samples < 0xFFFF) {
+        peer->clock_samples++;
+    }
+}
+
+/**
+ * @brief Find a peer by address, adding it if there is room
+ */
+static mesh_peer_t* find_peer(const uint8_t* mac, uint32_t now_ms) {
+    mesh_peer_t* free_peer = NULL;
+    for (uint8_t i = 0; i < MESH_MAX_PEERS; i++) {
+        if (peers[i].used) {
+            if (memcmp(peers[i].mac, mac, sizeof(peers[i].mac)) == 0) {
+                return &peers[i];
+            }
+        } else if (free_peer == NULL) {
+            free_peer = &peers[i];
+        }
+    }
+
+    if (free_peer == NULL) {
+        return NULL;
+    }
+
+    memset(free_peer, 0, sizeof(*free_peer));
+    memcpy(free_peer->mac, mac, sizeof(free_peer->mac));
+    free_peer->used = true;
+    free_peer->last_seen_ms = now_ms;
+    LOGI(MESH, "🛰️  Mesh peer %02X:%02X:%02X:%02X:%02X:%02X joined",
+         mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return free_peer;
+}
+
+/**
+ * @brief Whether a peer hears enough of the same BLE devices as we do
+ */
+static bool peer_is_nearby(const mesh_peer_t* peer) {
+    return peer->compared >= MESH_MIN_COMPARED &&
+           (uint32_t)peer->shared * 100 >= (uint32_t)peer->compared * MESH_MIN_OVERLAP_PCT;
+}
+
+/**
+ * @brief Broadcast entries that are new, moved or due for a refresh
+ */
+static void send_dirty_entries(uint32_t now_ms) {
+    uint8_t frame[MESH_MAX_FRAME_BYTES];
+    mesh_entry_t* out = (mesh_entry_t*)(frame + sizeof(mesh_header_t));
+    uint8_t entry_count = 0;
+    uint8_t frames_sent = 0;
+    uint32_t capacity = device_table_capacity();
+
+    // Entry ages are taken against this instant, which is close enough to
+    // the actual transmission for the min-filtered offset estimate
+    uint32_t tx_time_us = (uint32_t)esp_timer_get_time();
+    uint16_t cycle_seq = device_table_cycle();
+
+    // Frames only reach peers parked on the home channel
+    if (!wifi_scan_in_progress()) {
+        esp_wifi_set_channel(MESH_HOME_CHANNEL, WIFI_SECOND_CHAN_NONE);
+    }
+
+    // Resume where the previous cycle ran out of frames
+    for (uint32_t step = 0; step < capacity; step++) {
+        uint32_t index = (tx_cursor + step) % capacity;
+        const device_entry_t* entry = device_table_entry_at(index);
+        if (entry == NULL || now_ms - entry->last_seen_ms > MESH_REMOTE_TTL_MS) {
+            continue;
+        }
+
+        // Re-broadcasting peer APs would loop them around the mesh
+        if (entry->kind == DEVICE_KIND_WIFI_AP &&
+            (entry->channel == 0 || !(stats.local_mask & (1 << entry->channel)))) {
+            continue;
+        }
+
+        if (entry->synced_ms != 0 && now_ms - entry->synced_ms < MESH_REFRESH_MS) {
+            continue;
+        }
+
+        if (frames_sent >= MESH_MAX_BATCHES) {
+            stats.entries_deferred++;
+            continue;
+        }
+
+        mesh_entry_t wire;
+        memcpy(wire.mac, entry->mac, sizeof(wire.mac));
+        wire.kind = entry->kind;
+        wire.rssi = (int8_t)(entry->rssi_ewma_x16 >> 4);
+        wire.channel = entry->channel;
+        uint32_t age_ms = (tx_time_us - entry->last_seen_us) / 1000;
+        wire.age_ms = age_ms > 0xFFFF ? 0xFFFF : (uint16_t)age_ms;
+        uint16_t cycle_age = cycle_seq - entry->last_cycle;
+        wire.cycle_age = cycle_age > 255 ? 255 : (uint8_t)cycle_age;
+        memcpy(&out[entry_count++], &wire, sizeof(wire));
+        device_table_mark_synced(index, now_ms);
+
+        if (entry_count == MESH_ENTRIES_PER_FRAME) {
+            if (send_frame(frame, entry_count, tx_time_us)) {
+                frames_sent++;
+            }
+            entry_count = 0;
+            if (frames_sent >= MESH_MAX_BATCHES) {
+                tx_cursor = (index + 1) % capacity;
+            }
+        }
+    }
+
+    // A header-only frame doubles as a presence beacon
+    if (entry_count > 0 || frames_sent == 0) {
+        send_frame(frame, entry_count, tx_time_us);
+    }
+}
+
+/**
+ * @brief Fill in the header and broadcast one digest frame
+ */
+static bool send_frame(uint8_t* frame, uint8_t entry_count, uint32_t tx_time_us) {
+    mesh_header_t header;
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.type = MESH_MSG_DIGEST;
+    header.entry_count = entry_count;
+    header.seq = ++tx_seq;
+    header.channel_mask = stats.local_mask;
+    header.cycle_seq = device_table_cycle();
+    header.time_stratum = time_sync_stratum();
+    header.reserved = 0;
+    header.tx_time_us = tx_time_us;
+    int64_t wall_us;
+    header.tx_wall_ms = time_sync_wall_us(&wall_us) ?
+        (uint64_t)(wall_us - (uint32_t)((uint32_t)esp_timer_get_time() - tx_time_us)) / 1000 : 0;
+    memcpy(frame, &header, sizeof(header));
+
+    size_t len = sizeof(header) + entry_count * sizeof(mesh_entry_t);
+    if (esp_now_send(broadcast_mac, frame, len) != ESP_OK) {
+        return false;
+    }
+
+    stats.frames_tx++;
+    stats.entries_tx += entry_count;
+    return true;
+}
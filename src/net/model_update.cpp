@@ -0,0 +1,1304 @@
+/**
+ * @file model_update.cpp
+ * @brief HTTP endpoint streaming new models into the model store
+ *
+ * The same server reports inference telemetry on AI_METRICS_PATH, so a
+ * model swap and its effect on latency can be checked from one place,
+ * along with the display's refresh timings and the energy per subsystem, and
+ * takes this unit's hourly backlight schedule on BACKLIGHT_PATH and
+ * serves the metrics history on HISTORY_PATH. PCAP_PATH streams captured
+ * frames live as a pcap file for as long as the client stays connected,
+ * and SD_BENCH_PATH reports and re-runs the card benchmark. The JSON API
+ * under HTTP_API_PREFIX and the WebSocket on LIVE_STREAM_PATH are
+ * registered on it too (see http_api.cpp and live_stream.cpp), and
+ * FIRMWARE_UPDATE_PATH starts and follows a delta firmware update. A
+ * soak build reports its progress and verdict on SOAK_PATH, and a stress
+ * build takes its synthetic load on SCAN_SYNTH_PATH; a profiling build
+ * reports its cycle counts on PROFILE_PATH and an allocation-tracing build
+ * its allocations per loop and call site on ALLOC_TRACE_PATH. The values
+ * tunable at run time are read and set on TUNABLES_PATH, and fleet
+ * commands are taken and acknowledged on FLEET_PATH. The
+ * dashboard itself is served under WEB_ASSETS_PREFIX (see web_assets.cpp).
+ *
+ * AsyncWebServer delivers the body in chunks on its own task; each chunk
+ * goes straight to flash, so an upload never needs a model-sized buffer.
+ * The response is decided once the last chunk has been verified.
+ */
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "model_store.h"
+#include "ai_inference.h"
+#include "ai_telemetry.h"
+#include "backlight.h"
+#include "renderer.h"
+#include "metrics_history.h"
+#include "thermal.h"
+#include "ambient.h"
+#include "image_cache.h"
+#include "gestures.h"
+#include "baseline.h"
+#include "time_sync.h"
+#include "provisioning.h"
+#include "fleet_commands.h"
+#include "crash_dump.h"
+#include "mem_policy.h"
+#include "gps.h"
+#include "wardrive.h"
+#include "geo_store.h"
+#include "radio_link.h"
+#include "packet_capture.h"
+#include "render_split.h"
+#include "scan_targets.h"
+#include "data_bus.h"
+#include "power_manager.h"
+#include "energy.h"
+#include "wake_sources.h"
+#include "loop_timing.h"
+#include "boot_profile.h"
+#include "event_trace.h"
+#include "logger.h"
+#include "job_pool.h"
+#include "sd_monitor.h"
+#include "pcap_export.h"
+#include "sd_bench.h"
+#include "http_api.h"
+#include "live_stream.h"
+#include "firmware_update.h"
+#include "web_assets.h"
+#include "soak.h"
+#include "scan_synth.h"
+#include "device_table.h"
+#include "cooccurrence.h"
+#include "ap_anomaly.h"
+#include "handshake_watch.h"
+#include "device_tier.h"
+#include "telemetry_summary.h"
+#include "capture_burst.h"
+#include "ble_duty.h"
+#include "governor.h"
+#include "profile.h"
+#include "alloc_trace.h"
+#include "tunables.h"
+#include "timer_wheel.h"
+#include "latency_trace.h"
+#include "priority_tuner.h"
+#include "text_writer.h"
+#include "model_update.h"
+
+/**
+ * @brief Outcome of the upload owned by a request
+ */
+typedef enum {
+    UPLOAD_NONE = 0,                // No body seen yet
+    UPLOAD_WRITING,
+    UPLOAD_COMMITTED,
+    UPLOAD_NO_CRC,
+    UPLOAD_NO_KEYS,                 // MODEL_UPDATE_REQUIRE_KEY without any key set
+    UPLOAD_REJECTED,                // Too large or another upload is open
+    UPLOAD_WRITE_FAILED,
+    UPLOAD_VERIFY_FAILED
+} upload_result_t;
+
+// Widest /metrics document: every 32-bit number at 11 characters, every
+// 64-bit one at 20, every float at 48 (FLT_MAX under %.1f), every name
+// at 32, and every list at the bounds below - 18834 bytes, with 7 latency
+// stages of 16 octaves, 4 radios, 7 energy loads, 4 memory classes and
+// arenas, 5 loops and tuned tasks, 12 boot stages, 8 handshake counters,
+// 5 anomaly kinds and 2 burst reasons. A new field or list entry has to
+// be added here; until then a document that does not fit is a 500.
+#define METRICS_BODY_BYTES 19456
+static_assert(LATENCY_STAGE_COUNT <= 7 && LATENCY_TRACE_OCTAVES <= 16 && RADIO_LINK_MAX_RADIOS <= 4 &&
+              ENERGY_LOAD_COUNT <= 7 && MEM_CLASSES <= 4 && MEM_ARENAS_MAX <= 4 && LOOP_COUNT <= 5 &&
+              BOOT_STAGE_COUNT <= 12 && HANDSHAKE_COUNTER_COUNT <= 8 && AP_ANOMALY_COUNT <= 5 &&
+              CAPTURE_BURST_REASON_COUNT <= 2,
+              "a /metrics list grew: recount METRICS_BODY_BYTES");
+
+static AsyncWebServer* server = NULL;
+static AsyncWebServerRequest* owner = NULL;     // Request holding the open upload
+static upload_result_t result = UPLOAD_NONE;
+static uint32_t expected_crc = 0;
+
+// Forward declarations
+static void on_body(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                    size_t index, size_t total);
+static void on_upload_done(AsyncWebServerRequest* request);
+static void on_status(AsyncWebServerRequest* request);
+static void on_metrics(AsyncWebServerRequest* request);
+static void on_backlight_get(AsyncWebServerRequest* request);
+static void on_backlight_set(AsyncWebServerRequest* request);
+static void on_history(AsyncWebServerRequest* request);
+static void on_trace_get(AsyncWebServerRequest* request);
+static void on_trace_save(AsyncWebServerRequest* request);
+static void save_trace_job(void* payload);
+static void on_pcap_stream(AsyncWebServerRequest* request);
+static void on_pcap_sd(AsyncWebServerRequest* request);
+static void on_sd_bench_get(AsyncWebServerRequest* request);
+static void on_sd_bench_run(AsyncWebServerRequest* request);
+static void on_log_get(AsyncWebServerRequest* request);
+static void on_log_level(AsyncWebServerRequest* request);
+static void on_firmware_get(AsyncWebServerRequest* request);
+static void on_firmware_start(AsyncWebServerRequest* request);
+static void on_tunables_get(AsyncWebServerRequest* request);
+static void on_tunables_set(AsyncWebServerRequest* request);
+#if SOAK_ENABLED
+static void on_soak_get(AsyncWebServerRequest* request);
+#endif
+#if SCAN_SYNTH_ENABLED && !SOAK_ENABLED
+static void on_synth_get(AsyncWebServerRequest* request);
+static void on_synth_set(AsyncWebServerRequest* request);
+#endif
+#if PROFILE_ENABLED
+static void on_profile_get(AsyncWebServerRequest* request);
+static void on_profile_reset(AsyncWebServerRequest* request);
+#endif
+#if ALLOC_TRACE_ENABLED
+static void on_allocs_get(AsyncWebServerRequest* request);
+static void on_allocs_reset(AsyncWebServerRequest* request);
+#endif
+
+/**
+ * @brief Start the HTTP endpoint that accepts new models
+ */
+bool model_update_init(void) {
+    if (server != NULL) {
+        return true;
+    }
+
+    server = new AsyncWebServer(MODEL_UPDATE_PORT);
+    if (server == NULL) {
+        return false;
+    }
+#if HTTP_API_ENABLED
+    http_api_guard(server);         // First: every route after it needs a key once keys are set
+#endif
+    server->on(MODEL_UPDATE_PATH, HTTP_POST, on_upload_done, NULL, on_body);
+    server->on(MODEL_UPDATE_PATH, HTTP_GET, on_status);
+    server->on(AI_METRICS_PATH, HTTP_GET, on_metrics);
+    server->on(BACKLIGHT_PATH, HTTP_GET, on_backlight_get);
+    server->on(BACKLIGHT_PATH, HTTP_POST, on_backlight_set);
+    server->on(HISTORY_PATH, HTTP_GET, on_history);
+#if EVENT_TRACE_ENABLED
+    server->on(EVENT_TRACE_PATH, HTTP_GET, on_trace_get);
+    server->on(EVENT_TRACE_PATH, HTTP_POST, on_trace_save);
+#endif
+#if PACKET_CAPTURE_ENABLED && PCAP_EXPORT_ENABLED
+    server->on(PCAP_PATH, HTTP_GET, on_pcap_stream);
+    server->on(PCAP_PATH, HTTP_POST, on_pcap_sd);
+#endif
+#if SD_BENCH_ENABLED
+    server->on(SD_BENCH_PATH, HTTP_GET, on_sd_bench_get);
+    server->on(SD_BENCH_PATH, HTTP_POST, on_sd_bench_run);
+#endif
+    server->on(LOG_PATH, HTTP_GET, on_log_get);
+    server->on(LOG_PATH, HTTP_POST, on_log_level);
+#if FIRMWARE_UPDATE_ENABLED
+    server->on(FIRMWARE_UPDATE_PATH, HTTP_GET, on_firmware_get);
+    server->on(FIRMWARE_UPDATE_PATH, HTTP_POST, on_firmware_start);
+#endif
+    server->on(TUNABLES_PATH, HTTP_GET, on_tunables_get);
+    server->on(TUNABLES_PATH, HTTP_POST, on_tunables_set);
+#if SOAK_ENABLED
+    server->on(SOAK_PATH, HTTP_GET, on_soak_get);
+#endif
+#if SCAN_SYNTH_ENABLED && !SOAK_ENABLED
+    server->on(SCAN_SYNTH_PATH, HTTP_GET, on_synth_get);
+    server->on(SCAN_SYNTH_PATH, HTTP_POST, on_synth_set);
+#endif
+#if PROFILE_ENABLED
+    server->on(PROFILE_PATH, HTTP_GET, on_profile_get);
+    server->on(PROFILE_PATH, HTTP_POST, on_profile_reset);
+#endif
+#if ALLOC_TRACE_ENABLED
+    server->on(ALLOC_TRACE_PATH, HTTP_GET, on_allocs_get);
+    server->on(ALLOC_TRACE_PATH, HTTP_POST, on_allocs_reset);
+#endif
+#if HTTP_API_ENABLED
+    if (!http_api_register(server)) {
+        LOGW(SYSTEM, "⚠️  No PSRAM for the %s routes", HTTP_API_PREFIX);
+    }
+#endif
+#if LIVE_STREAM_ENABLED
+    if (!live_stream_register(server)) {
+        LOGW(SYSTEM, "⚠️  Live stream on %s could not start", LIVE_STREAM_PATH);
+    }
+#endif
+#if WEB_ASSETS_ENABLED && ASSET_STORE_ENABLED
+    if (!web_assets_register(server)) {
+        LOGW(SYSTEM, "⚠️  No asset partition, dashboard on %s not served", WEB_ASSETS_PREFIX);
+    }
+#endif
+#if FLEET_ENABLED
+    fleet_commands_register(server);
+#endif
+#if CRASH_DUMP_ENABLED
+    crash_dump_register(server);
+#endif
+#if WARDRIVE_ENABLED && GEO_STORE_ENABLED
+    geo_store_register(server);
+#endif
+#if SCAN_TARGETS_ENABLED
+    scan_targets_register(server);
+#endif
+#if PROVISION_ENABLED
+    provisioning_register(server);  // Last: its captive handler takes what is left
+#endif
+    server->begin();
+
+    LOGI(SYSTEM, "✅ Model update endpoint on port %d%s", MODEL_UPDATE_PORT, MODEL_UPDATE_PATH);
+    return true;
+}
+
+/**
+ * @brief A model body is being streamed into the inactive slot
+ */
+bool model_update_in_progress(void) {
+    return owner != NULL && result == UPLOAD_WRITING;
+}
+
+/**
+ * @brief Stream one body chunk into the inactive slot
+ */
+static void on_body(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                    size_t index, size_t total) {
+    if (index == 0) {
+        if (owner != NULL) {
+            return;                 // Another upload holds the store
+        }
+        owner = request;
+
+        // A dropped connection must not leave the store locked
+        request->onDisconnect([request]() {
+            if (owner == request) {
+                if (result == UPLOAD_WRITING) {
+                    model_store_abort();
+                }
+                owner = NULL;
+                result = UPLOAD_NONE;
+            }
+        });
+
+        // With keys set the gate has matched one before the body started
+        if (MODEL_UPDATE_REQUIRE_KEY && !(HTTP_API_ENABLED && http_api_key_count() > 0)) {
+            result = UPLOAD_NO_KEYS;
+            return;
+        }
+        if (!request->hasHeader("X-Model-CRC32")) {
+            result = UPLOAD_NO_CRC;
+            return;
+        }
+        expected_crc = strtoul(request->getHeader("X-Model-CRC32")->value().c_str(), NULL, 16);
+        result = model_store_begin(total) ? UPLOAD_WRITING : UPLOAD_REJECTED;
+    }
+
+    if (owner != request || result != UPLOAD_WRITING) {
+        return;
+    }
+    if (!model_store_write(data, len)) {
+        model_store_abort();
+        result = UPLOAD_WRITE_FAILED;
+        return;
+    }
+    if (index + len == total) {
+        result = model_store_finish(expected_crc) ? UPLOAD_COMMITTED : UPLOAD_VERIFY_FAILED;
+    }
+}
+
+/**
+ * @brief Answer the upload once its body has been handled
+ */
+static void on_upload_done(AsyncWebServerRequest* request) {
+    if (owner != request) {
+        if (owner != NULL) {
+            request->send(409, "text/plain", "another model upload is in progress\n");
+        } else {
+            request->send(400, "text/plain", "empty body\n");
+        }
+        return;
+    }
+
+    switch (result) {
+        case UPLOAD_COMMITTED:
+            request->send(200, "text/plain", "model committed, switching at next cycle\n");
+            break;
+        case UPLOAD_NO_CRC:
+            request->send(400, "text/plain", "X-Model-CRC32 header required\n");
+            break;
+        case UPLOAD_NO_KEYS:
+            request->send(403, "text/plain", "set HTTP_API_KEYS to accept model uploads\n");
+            break;
+        case UPLOAD_REJECTED:
+            request->send(413, "text/plain", "model too large or store busy\n");
+            break;
+        case UPLOAD_VERIFY_FAILED:
+            request->send(422, "text/plain", "CRC-32 mismatch or not a valid model\n");
+            break;
+        case UPLOAD_WRITING:
+            // Body ended early; nothing was committed
+            model_store_abort();
+            request->send(400, "text/plain", "incomplete body\n");
+            break;
+        default:
+            request->send(500, "text/plain", "flash write failed\n");
+            break;
+    }
+    owner = NULL;
+    result = UPLOAD_NONE;
+}
+
+/**
+ * @brief Report the committed model and the store counters
+ */
+static void on_status(AsyncWebServerRequest* request) {
+    model_slot_info_t info;
+    model_store_stats_t stats;
+    bool valid = model_store_active(&info);
+    model_store_get_stats(&stats);
+
+    char body[192];
+    snprintf(body, sizeof(body),
+             "{\"valid\":%s,\"slot\":%d,\"generation\":%lu,\"length\":%lu,\"crc32\":\"%08lx\","
+             "\"capacity\":%lu,\"committed\":%lu,\"rejected\":%lu}",
+             valid ? "true" : "false", info.slot, info.generation, info.length, info.crc32,
+             stats.slot_capacity, stats.updates_committed, stats.updates_rejected);
+    request->send(200, "application/json", body);
+}
+
+/**
+ * @brief Report decision latency and model margins for the model in force,
+ *        then the display refresh profile, loop timings and boot stages
+ *
+ * A Prometheus scrape, which asks for OpenMetrics or the 0.0.4 text
+ * format in its Accept header, or ?format=openmetrics, is answered with
+ * the OpenMetrics exposition instead.
+ */
+static void on_metrics(AsyncWebServerRequest* request) {
+#if HTTP_API_ENABLED
+    bool scrape = request->hasParam("format") &&
+                  request->getParam("format")->value() == "openmetrics";
+    if (!scrape && request->hasHeader("Accept")) {
+        const char* accept = request->getHeader("Accept")->value().c_str();
+        scrape = strstr(accept, "application/openmetrics-text") != NULL ||
+                 strstr(accept, "text/plain;version=0.0.4") != NULL;
+    }
+    if (scrape) {
+        http_api_send_openmetrics(request);
+        return;
+    }
+    if (!http_api_admit(request, HTTP_API_ROUTE_OTHER)) {
+        return;
+    }
+#endif
+    ai_inference_stats_t inference;
+    ai_telemetry_t telemetry;
+    renderer_profile_t display;
+    ai_inference_get_stats(&inference);
+    ai_telemetry_get(&telemetry);
+    renderer_get_profile(&display);
+    renderer_info_t mode;
+    renderer_get_info(&mode);
+    render_split_stats_t split;
+    render_split_get_stats(&split);
+    uint32_t refreshes = max(display.refreshes, (uint32_t)1);
+
+    thermal_status_t thermal;
+    thermal_get_status(&thermal);
+    ambient_status_t ambient;
+    ambient_get_status(&ambient);
+    image_cache_stats_t images;
+    image_cache_get_stats(&images);
+    input_publication_t input;
+    data_bus_read(BUS_TOPIC_INPUT, &input, 0, sizeof(input));
+    baseline_status_t baseline;
+    baseline_get_status(&baseline);
+    time_sync_status_t clock;
+    time_sync_get_status(&clock);
+    int64_t wall_us = 0;
+    time_sync_wall_us(&wall_us);
+    provision_status_t provision;
+    provisioning_get_status(&provision);
+    fleet_status_t fleet;
+    fleet_commands_get_status(&fleet);
+    crash_status_t crash;
+    crash_dump_get_status(&crash);
+    gps_fix_t gps_fix;
+    bool gps_valid = gps_get_fix(&gps_fix);
+    gps_stats_t gps;
+    gps_get_stats(&gps);
+    wardrive_stats_t wardrive;
+    wardrive_get_stats(&wardrive);
+    geo_store_stats_t geo;
+    geo_store_get_stats(&geo);
+    radio_link_stats_t radio_link;
+    radio_link_get_stats(&radio_link);
+    scan_targets_stats_t targets;
+    scan_targets_get_stats(&targets);
+    device_versions_t versions;
+    device_table_get_versions(&versions);
+    device_tier_stats_t tier;
+    device_tier_get_stats(&tier);
+    static telemetry_summary_stats_t summary;   // Handlers run one at a time on the async TCP task
+    telemetry_summary_get_stats(&summary);
+    timer_wheel_stats_t timers;
+    timer_wheel_get_stats(&timers);
+    static latency_trace_stats_t latency;   // Handlers run one at a time on the async TCP task
+    latency_trace_get(&latency);
+    spsc_stats_t capture_stream;
+    capture_get_stream_stats(&capture_stream);
+    power_status_t power;
+    power_manager_get_status(&power);
+    energy_status_t energy;
+    energy_get_status(&energy);
+    wake_status_t wake;
+    wake_sources_get_status(&wake);
+    cooccurrence_stats_t communities;
+    cooccurrence_get_stats(&communities);
+    ap_anomaly_stats_t anomalies;
+    ap_anomaly_get_stats(&anomalies);
+    handshake_stats_t handshakes;
+    handshake_watch_get_stats(&handshakes);
+    governor_status_t governor;
+    governor_get_status(&governor);
+    capture_burst_stats_t burst;
+    capture_burst_get_stats(&burst);
+    ble_duty_stats_t duty;
+    ble_duty_get_stats(&duty);
+
+    static char* body = NULL;   // Handlers run one at a time on the async TCP task
+    if (body == NULL) {
+        body = (char*)mem_alloc(MEM_BULK, METRICS_BODY_BYTES);
+    }
+    if (body == NULL) {
+        request->send(503, "text/plain", "no memory for the metrics\n");
+        return;
+    }
+    text_writer_t w;
+    text_writer_init(&w, body, METRICS_BODY_BYTES);
+    text_printf(&w,
+             "{\"backend\":\"%s\",\"model_generation\":%lu,\"model_hash\":\"%08lx\","
+             "\"decisions\":%lu,\"model_decisions\":%lu,\"rule_decisions\":%lu,"
+             "\"latency_us\":{\"last\":%lu,\"min\":%lu,\"avg\":%lu,\"p50\":%lu,\"p99\":%lu,\"max\":%lu},"
+             "\"invoke_us\":%lu,\"margin\":{\"samples\":%lu,\"last\":%.3f,\"mean\":%.3f,"
+             "\"min\":%.3f,\"narrow\":%lu},\"model_swaps\":%lu,\"swap_failures\":%lu,",
+             ai_inference_backend_name(), inference.model_generation, inference.model_hash,
+             telemetry.decisions, telemetry.model_decisions, telemetry.rule_decisions,
+             telemetry.last_us, telemetry.min_us, telemetry.avg_us, telemetry.p50_us,
+             telemetry.p99_us, telemetry.max_us, inference.last_invoke_us,
+             telemetry.margins, telemetry.last_margin, telemetry.mean_margin,
+             telemetry.min_margin, telemetry.narrow_margins,
+             inference.model_swaps, inference.swap_failures);
+    text_printf(&w,
+             "\"invokes\":{\"main\":%lu,\"main_avg_us\":%lu,\"fast\":%lu,\"fast_avg_us\":%lu,"
+             "\"fast_last_us\":%lu},\"cascade\":{\"loaded\":%s,\"fast_hash\":\"%08lx\","
+             "\"early_exits\":%lu,\"escalated_margin\":%lu,\"escalated_novelty\":%lu},",
+             inference.invocations, inference.avg_invoke_us, inference.fast_invocations,
+             inference.fast_avg_invoke_us, inference.fast_last_invoke_us,
+             inference.fast_loaded ? "true" : "false", inference.fast_model_hash,
+             inference.early_exits, inference.escalated_margin, inference.escalated_novelty);
+    text_printf(&w,
+             "\"display\":{\"refreshes\":%lu,\"bands\":%lu,"
+             "\"render_us\":{\"last\":%lu,\"avg\":%llu,\"max\":%lu},"
+             "\"flush_us\":{\"last\":%lu,\"avg\":%llu,\"max\":%lu},"
+             "\"refresh_max_us\":%lu,\"area_px\":{\"last\":%lu,\"avg\":%llu},"
+             "\"mode\":\"%s\",\"bus\":\"%s\",\"bus_mhz\":%lu,\"dma\":%s,"
+             "\"bytes_flushed\":%llu,\"bytes_unchanged\":%llu,\"frames_dropped\":%lu,"
+             "\"refresh_period_ms\":%u,\"active_period_ms\":%u,\"period_changes\":%lu,",
+             display.refreshes, display.bands,
+             display.render_us, display.render_total_us / refreshes, display.render_max_us,
+             display.flush_us, display.flush_total_us / refreshes, display.flush_max_us,
+             display.refresh_max_us, display.area_px, display.area_total_px / refreshes,
+             mode.mode == RENDERER_MODE_FULL_FRAME ? "full" : "bands",
+             mode.bus != NULL ? mode.bus : "none", mode.bus_hz / 1000000, mode.flush_dma ? "true" : "false",
+             display.bytes_flushed, display.bytes_unchanged, display.frames_dropped,
+             mode.refresh_period_ms, mode.active_period_ms, mode.period_changes);
+    text_printf(&w,
+             "\"split\":{\"running\":%s,\"allowed\":%s,\"core_pct\":%.1f,\"refreshes\":%lu,"
+             "\"refreshes_busy\":%lu,\"blends\":%lu,\"stripes_helper\":%lu,\"stripes_stolen\":%lu,"
+             "\"px_helper\":%llu}},",
+             split.running ? "true" : "false", split.allowed ? "true" : "false", split.core_pct,
+             split.refreshes, split.refreshes_busy, split.blends, split.stripes_helper,
+             split.stripes_stolen, split.px_helper);
+    text_printf(&w,
+             "\"image_cache\":{\"bytes\":%lu,\"entries\":%u,\"hits\":%lu,\"misses\":%lu,"
+             "\"loads\":%lu,\"reloads\":%lu,\"failures\":%lu,\"evictions\":%lu,\"rejected\":%lu,"
+             "\"max_load_us\":%lu},",
+             images.bytes, images.entries, images.hits, images.misses, images.loads, images.reloads,
+             images.failures, images.evictions, images.rejected, images.max_load_us);
+    text_printf(&w,
+             "\"gestures\":{\"last\":\"%s\",\"taps\":%lu,\"long_presses\":%lu,\"swipes\":%lu},",
+             gesture_name((gesture_t)input.gesture), input.taps, input.long_presses, input.swipes);
+    text_printf(&w,
+             "\"baseline\":{\"clock_valid\":%s,\"hour_of_week\":%u,\"ready\":%s,\"coverage_pct\":%u,"
+             "\"deviation\":%.2f,\"worst\":\"%s\",\"scored\":%lu,\"unusual\":%lu,\"saves\":%lu},",
+             baseline.clock_valid ? "true" : "false", baseline.hour_of_week,
+             baseline.ready ? "true" : "false", baseline.coverage_pct, baseline.deviation,
+             baseline_metric_name((baseline_metric_t)baseline.worst_metric),
+             baseline.scored, baseline.unusual, baseline.saves);
+    text_printf(&w,
+             "\"clock\":{\"source\":\"%s\",\"stratum\":%u,\"epoch_ms\":%llu,\"synced_ms\":%lu,"
+             "\"last_step_ms\":%ld,\"sntp\":%s,\"sntp_syncs\":%lu,\"peer_syncs\":%lu},",
+             time_source_name((time_source_t)clock.source), clock.stratum, (uint64_t)(wall_us / 1000),
+             clock.synced_ms, clock.last_step_ms, clock.sntp_running ? "true" : "false",
+             clock.sntp_syncs, clock.peer_syncs);
+    text_printf(&w,
+             "\"provisioning\":{\"open\":%s,\"clients\":%u,\"stored\":%s,\"opened\":%lu,"
+             "\"credential_saves\":%lu,\"tunable_sets\":%lu,\"rejected\":%lu},",
+             provision.open ? "true" : "false", provision.clients, provision.stored ? "true" : "false",
+             provision.opened, provision.credential_saves, provision.tunable_sets, provision.rejected);
+    text_printf(&w,
+             "\"fleet\":{\"last_id\":%lu,\"received\":%lu,\"applied\":%lu,\"refused\":%lu,"
+             "\"duplicates\":%lu,\"queued\":%u,\"acks_pending\":%u,\"acks_sent\":%lu,\"ack_batches\":%lu},",
+             fleet.last_id, fleet.received, fleet.applied, fleet.refused, fleet.duplicates,
+             fleet.queued, fleet.acks_pending, fleet.acks_sent, fleet.ack_batches);
+    text_printf(&w,
+             "\"crash\":{\"crashed\":%s,\"reset_reason\":%u,\"core_bytes\":%lu,\"trace_bytes\":%lu,"
+             "\"uploaded\":%s,\"chunks_sent\":%lu,\"downloads\":%lu},",
+             crash.crashed ? "true" : "false", crash.reset_reason, crash.core_present ? crash.core_bytes : 0,
+             crash.trace_bytes, crash.uploaded ? "true" : "false", crash.chunks_sent, crash.downloads);
+    text_printf(&w,
+             "\"gps\":{\"running\":%s,\"fix\":%s,\"lat\":%.7f,\"lon\":%.7f,\"alt_m\":%d,"
+             "\"speed_kmh\":%.1f,\"hdop\":%.1f,\"satellites\":%u,\"sentences\":%lu,"
+             "\"checksum_errors\":%lu,\"motion\":\"%s\",\"interval_pct\":%u,\"tagged_cycles\":%lu,"
+             "\"untagged_cycles\":%lu,\"dropped\":%lu,\"distance_m\":%lu},",
+             gps.running ? "true" : "false", gps_valid ? "true" : "false",
+             gps_fix.lat_e7 / 1e7, gps_fix.lon_e7 / 1e7, gps_fix.alt_m, gps_fix.speed_kmh_x10 / 10.0f,
+             gps_fix.hdop_x10 / 10.0f, gps_fix.satellites, gps.sentences, gps.checksum_errors,
+             wardrive_motion_name((wardrive_motion_t)wardrive.motion), wardrive.scale_pct,
+             wardrive.tagged_cycles, wardrive.untagged_cycles, wardrive.dropped, wardrive.distance_m);
+    text_printf(&w,
+             "\"geo\":{\"loaded\":%s,\"cells\":%u,\"rows\":%lu,\"rows_staged\":%lu,\"rows_dropped\":%lu,"
+             "\"rows_capped\":%lu,\"cycles_thinned\":%lu,\"batches_written\":%lu,\"write_failures\":%lu,"
+             "\"queries\":%lu,\"query_bytes_read\":%lu},",
+             geo.loaded ? "true" : "false", geo.cells, geo.rows, geo.rows_staged, geo.rows_dropped,
+             geo.rows_capped, geo.cycles_thinned, geo.batches_written, geo.write_failures,
+             geo.queries, geo.query_bytes_read);
+    text_printf(&w,
+             "\"radios\":{\"running\":%s,\"live\":%u,\"local_mask\":%u,\"bytes\":%lu,\"frames\":%lu,"
+             "\"crc_errors\":%lu,\"rejected\":%lu,\"resyncs\":%lu,\"assigns_sent\":%lu,\"modules\":[",
+             radio_link.running ? "true" : "false", radio_link.live, radio_link.local_mask, radio_link.bytes,
+             radio_link.frames, radio_link.crc_errors, radio_link.rejected, radio_link.resyncs,
+             radio_link.assigns_sent);
+    bool first_module = true;
+    for (uint8_t radio = 0; radio < RADIO_LINK_MAX_RADIOS; radio++) {
+        radio_module_t module;
+        if (!radio_link_get_module(radio, &module) || module.frames == 0) {
+            continue;
+        }
+        text_printf(&w,
+                 "%s{\"radio\":%u,\"live\":%s,\"bands\":%u,\"supported_mask\":%u,\"assigned_mask\":%u,"
+                 "\"frames\":%lu,\"frames_lost\":%lu,\"observations\":%lu,\"merged\":%lu,"
+                 "\"rejected\":%lu,\"module_dropped\":%u}",
+                 first_module ? "" : ",", radio, module.live ? "true" : "false", module.bands,
+                 module.supported_mask, module.assigned_mask, module.frames, module.frames_lost,
+                 module.observations, module.merged, module.rejected, module.module_dropped);
+        first_module = false;
+    }
+    text_printf(&w, "]},");
+    text_printf(&w,
+             "\"targets\":{\"count\":%u,\"ai\":%u,\"whitelist\":%s,\"passes\":%lu,\"sweeps\":%lu,"
+             "\"wifi_scans\":%lu,\"wifi_hits\":%lu,\"ble_updates\":%lu,\"whitelist_sets\":%lu,"
+             "\"ai_picks\":%lu,\"ai_released\":%lu,\"rejected\":%lu},",
+             targets.count, targets.ai, targets.whitelist ? "true" : "false", targets.passes, targets.sweeps,
+             targets.wifi_scans, targets.wifi_hits, targets.ble_updates, targets.whitelist_sets,
+             targets.ai_picks, targets.ai_released, targets.rejected);
+    text_printf(&w,
+             "\"device_table\":{\"live\":%lu,\"capacity\":%lu,\"epoch\":%lu,\"records\":%lu,\"free\":%lu,"
+             "\"limbo\":%lu,\"published\":%lu,\"in_place\":%lu,\"reclaimed\":%lu,\"pins\":%lu,"
+             "\"unpinned\":%lu,\"readers\":%u},",
+             device_table_count(), device_table_capacity(), versions.epoch, versions.records, versions.free,
+             versions.limbo, versions.published, versions.in_place, versions.reclaimed, versions.pins,
+             versions.unpinned, versions.readers);
+    text_printf(&w,
+             "\"device_tier\":{\"loaded\":%s,\"warm\":%lu,\"warm_hot\":%lu,\"runs\":%u,\"levels\":%u,"
+             "\"cold_records\":%lu,\"cold_bytes\":%lu,\"bloom_bytes\":%lu,\"demoted\":%lu,"
+             "\"returned_warm\":%lu,\"returned_cold\":%lu,\"new\":%lu,\"filter_skips\":%lu,"
+             "\"filter_false\":%lu,\"lookups\":%lu,\"lookups_skipped\":%lu,\"flushes\":%lu,"
+             "\"merges\":%lu,\"merged_records\":%lu,\"folded\":%lu,\"discarded\":%lu,"
+             "\"dropped\":%lu,\"write_failures\":%lu},",
+             tier.loaded ? "true" : "false", tier.warm, tier.warm_hot, tier.runs, tier.levels,
+             tier.cold_records, tier.cold_bytes, tier.bloom_bytes, tier.demoted,
+             tier.returned_warm, tier.returned_cold, tier.new_devices, tier.filter_skips,
+             tier.filter_false, tier.lookups, tier.lookups_skipped, tier.flushes,
+             tier.merges, tier.merged_records, tier.folded, tier.discarded,
+             tier.dropped, tier.write_failures);
+    text_printf(&w,
+             "\"summary\":{\"minutes\":%lu,\"hours\":%lu,\"taken\":%lu,\"dropped\":%lu,"
+             "\"sketch_replaced\":%u,\"last_minute\":{\"cycles\":%u,\"wifi_p50\":%u,\"ble_p50\":%u,"
+             "\"novel\":%lu,\"unusual_cycles\":%u,\"top\":%u}},",
+             summary.closed[SUMMARY_PERIOD_MINUTE], summary.closed[SUMMARY_PERIOD_HOUR], summary.taken,
+             summary.dropped, summary.sketch_replaced, summary.last_minute.cycles,
+             summary.last_minute.metrics[SUMMARY_METRIC_WIFI_NETWORKS].p50,
+             summary.last_minute.metrics[SUMMARY_METRIC_BLE_DEVICES].p50,
+             summary.last_minute.novel_devices, summary.last_minute.unusual_cycles,
+             summary.last_minute.top_count);
+    text_printf(&w,
+             "\"timers\":{\"active\":%u,\"peak\":%u,\"started\":%lu,\"rejected\":%lu,\"fired\":%lu,"
+             "\"cascaded\":%lu,\"ticks\":%lu,\"late_max_ms\":%lu,\"run_max_us\":%lu},",
+             timers.active, timers.peak, timers.started, timers.rejected, timers.fired,
+             timers.cascaded, timers.ticks, timers.late_max_ms, timers.run_max_us);
+    text_printf(&w,
+             "\"latency\":{\"started\":%lu,\"completed\":%lu,\"held\":%lu,\"coalesced\":%lu,\"lost\":%lu,\"stages\":{",
+             latency.started, latency.completed, latency.held, latency.coalesced, latency.lost);
+    for (uint8_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        const latency_stage_stats_t* figures = &latency.stages[stage];
+        text_printf(&w,
+                 "%s\"%s\":{\"count\":%lu,\"avg_us\":%lu,\"max_us\":%lu,\"p50_ms\":%lu,\"p99_ms\":%lu,\"le_ms\":[",
+                 stage > 0 ? "," : "", latency_stage_name((latency_stage_t)stage), figures->count,
+                 figures->avg_us, figures->max_us, figures->p50_ms, figures->p99_ms);
+        for (uint8_t octave = 0; octave < LATENCY_TRACE_OCTAVES; octave++) {
+            text_printf(&w, "%s%lu", octave > 0 ? "," : "",
+                        figures->cumulative[octave]);
+        }
+        text_printf(&w, "]}");
+    }
+    text_printf(&w, "}},");
+    text_printf(&w,
+             "\"streams\":{\"capture\":{\"capacity\":%lu,\"depth\":%lu,\"high_water\":%lu,\"pushed\":%lu,"
+             "\"dropped\":%lu,\"popped\":%lu,\"batches\":%lu,\"latency_avg_us\":%lu,\"latency_max_us\":%lu}},",
+             capture_stream.capacity, capture_stream.depth, capture_stream.high_water, capture_stream.pushed,
+             capture_stream.dropped, capture_stream.popped, capture_stream.batches,
+             capture_stream.latency_avg_us, capture_stream.latency_max_us);
+    text_printf(&w,
+             "\"thermal\":{\"celsius\":%.1f,\"raw_celsius\":%.1f,\"throttle\":\"%s\","
+             "\"cpu_mhz\":%u,\"frame_interval_ms\":%u,\"throttled_s\":%lu,\"changes\":%lu},",
+             thermal.celsius, thermal.raw_celsius, thermal_level_name(thermal.level),
+             thermal.cpu_mhz, thermal.frame_interval_ms, thermal.throttled_ms / 1000,
+             thermal.level_changes);
+    text_printf(&w,
+             "\"ambient\":{\"level\":\"%s\",\"lux\":%.1f,\"raw_lux\":%u,\"applied_lux\":%u,"
+             "\"backlight_pct\":%u,\"frame_interval_ms\":%u,\"updates\":%lu,\"changes\":%lu},",
+             ambient_level_name(ambient.level), ambient.lux, ambient.raw_lux, ambient.applied_lux,
+             ambient.backlight_pct, ambient.frame_interval_ms, ambient.updates, ambient.level_changes);
+    text_printf(&w,
+             "\"power\":{\"dfs\":%s,\"light_sleep\":%s,\"min_mhz\":%u,\"max_mhz\":%u,"
+             "\"held_ms\":{\"render\":%lu,\"scan\":%lu,\"ai\":%lu}},",
+             power.dfs ? "true" : "false", power.light_sleep ? "true" : "false",
+             power.min_mhz, power.max_mhz, power.held_ms[POWER_CLIENT_RENDER],
+             power.held_ms[POWER_CLIENT_SCAN], power.held_ms[POWER_CLIENT_AI]);
+    text_printf(&w,
+             "\"energy\":{\"avg_ma\":%.1f,\"model_ma\":%.1f,\"scale\":%.3f,\"ina219\":%s,"
+             "\"measured_ma\":%.1f,\"mah\":%.2f,\"battery_mah\":%u,\"runtime_h\":%.1f,\"loads\":{",
+             energy.avg_ma, energy.model_ma, energy.scale, energy.ina219 ? "true" : "false",
+             energy.measured_ma, energy.mah, energy.battery_mah, energy.runtime_h);
+    for (uint8_t load = 0; load < ENERGY_LOAD_COUNT; load++) {
+        text_printf(&w,
+                 "%s\"%s\":{\"ma\":%.1f,\"mah\":%.2f,\"share_pct\":%u,\"active_s\":%lu}",
+                 load > 0 ? "," : "", energy_load_name((energy_load_t)load), energy.loads[load].ma,
+                 energy.loads[load].mah, energy.loads[load].share_pct, energy.loads[load].active_ms / 1000);
+    }
+    text_printf(&w,
+             "}},\"wake\":{\"boot_cause\":\"%s\",\"accelerometer\":%s,\"motion_events\":%lu,"
+             "\"battery_mv\":%u,\"flags\":%u},",
+             wake_cause_name(wake.boot_cause), wake.accelerometer ? "true" : "false",
+             wake.motion_events, wake.battery_mv, wake_sources_flags(millis()));
+    text_printf(&w,
+             "\"cooccurrence\":{\"nodes\":%u,\"edges\":%u,\"people\":%u,\"places\":%u,"
+             "\"largest\":%u,\"sweeps\":%lu,\"evictions\":%lu,\"skipped\":%lu},",
+             communities.nodes, communities.edges, communities.people, communities.places,
+             communities.largest, communities.sweeps, communities.evictions, communities.skipped);
+    text_printf(&w, "\"ap_anomaly\":{\"ssids\":%u,\"raised\":%lu,\"dropped\":%lu",
+                anomalies.ssids, anomalies.raised, anomalies.dropped);
+    for (uint8_t anomaly = 0; anomaly < AP_ANOMALY_COUNT; anomaly++) {
+        text_printf(&w, ",\"%s\":%lu",
+                    ap_anomaly_name((ap_anomaly_t)anomaly), anomalies.detected[anomaly]);
+    }
+    text_printf(&w,
+             "},\"handshakes\":{\"window_ms\":%lu,\"bssids\":%u,"
+             "\"busiest\":{\"bssid\":\"%02x:%02x:%02x:%02x:%02x:%02x\",\"count\":%u},\"evicted\":%lu",
+             handshakes.window_ms, handshakes.bssids,
+             handshakes.busiest_bssid[0], handshakes.busiest_bssid[1], handshakes.busiest_bssid[2],
+             handshakes.busiest_bssid[3], handshakes.busiest_bssid[4], handshakes.busiest_bssid[5],
+             handshakes.busiest_count, handshakes.evicted);
+    for (uint8_t counter = 0; counter < HANDSHAKE_COUNTER_COUNT; counter++) {
+        text_printf(&w, ",\"%s\":[%u,%lu]",
+                    handshake_counter_name((handshake_counter_t)counter),
+                    handshakes.window[counter], handshakes.total[counter]);
+    }
+    text_printf(&w,
+             "},\"governor\":{\"state\":\"%s\",\"scan_profile\":\"%s\",\"interval_pct\":%u,"
+             "\"frame_ms\":%u,\"cpu_min_mhz\":%u,\"log_level\":\"%s\",\"backlight_pct\":%u,\"applies\":%lu",
+             ai_state_to_string(governor.state), scan_profile_get(governor.profile.scan_profile)->name,
+             governor.profile.interval_pct, governor.profile.frame_interval_ms,
+             governor.profile.cpu_min_mhz, logger_level_name(governor.profile.log_level),
+             governor.profile.backlight_pct, governor.applies);
+    text_printf(&w,
+             "},\"capture_burst\":{\"active\":%s,\"channel\":%u,\"reason\":\"%s\",\"remaining_ms\":%lu,"
+             "\"extended\":%lu,\"suppressed\":%lu,\"burst_ms\":%lu",
+             burst.active ? "true" : "false", burst.channel,
+             capture_burst_reason_name((capture_burst_reason_t)burst.reason), burst.remaining_ms,
+             burst.extended, burst.suppressed, burst.burst_ms);
+    for (uint8_t reason = 0; reason < CAPTURE_BURST_REASON_COUNT; reason++) {
+        text_printf(&w, ",\"%s\":%lu",
+                    capture_burst_reason_name((capture_burst_reason_t)reason), burst.bursts[reason]);
+    }
+    text_printf(&w,
+             "},\"ble_duty\":{\"phase\":\"%s\",\"window_pct\":%u,\"passive\":%s,\"coverage_pct\":%u,"
+             "\"reference_devices\":%u,\"devices\":%u,\"reference_adv_per_s\":%u,\"adv_per_s\":%u,"
+             "\"evaluations\":%lu,\"restarts\":%lu",
+             ble_duty_phase_name((ble_duty_phase_t)duty.phase), duty.window_pct,
+             duty.passive ? "true" : "false", duty.coverage_pct, duty.reference_devices,
+             duty.devices, duty.reference_adv_per_s, duty.adv_per_s, duty.evaluations, duty.restarts);
+    text_printf(&w, "},\"mem\":{");
+    for (uint8_t c = 0; c < MEM_CLASSES; c++) {
+        mem_class_stats_t mem;
+        mem_policy_get((mem_class_t)c, &mem);
+        text_printf(&w,
+                 "\"%s\":{\"live\":%lu,\"peak\":%lu,\"internal\":%lu,\"psram\":%lu,\"blocks\":%lu,"
+                 "\"allocs\":%lu,\"fallbacks\":%lu,\"failures\":%lu},",
+                 mem.name, mem.live_bytes, mem.peak_bytes, mem.internal_bytes, mem.psram_bytes,
+                 mem.live_blocks, mem.allocs, mem.fallbacks, mem.failures);
+    }
+    text_printf(&w, "\"arenas\":[");
+    mem_arena_t arena;
+    for (uint8_t i = 0; mem_arena_get(i, &arena); i++) {
+        text_printf(&w,
+                 "%s{\"name\":\"%s\",\"class\":\"%s\",\"size\":%lu,\"last\":%lu,\"peak\":%lu,\"resets\":%lu,"
+                 "\"overflows\":%lu}",
+                 i > 0 ? "," : "", arena.name, mem_class_name((mem_class_t)arena.mem_class),
+                 arena.size, arena.last, arena.peak, arena.resets, arena.overflows);
+    }
+    text_printf(&w, "]},\"loops\":{");
+    for (uint8_t id = 0; id < LOOP_COUNT; id++) {
+        loop_timing_stats_t timing;
+        loop_timing_get((loop_id_t)id, &timing);
+        text_printf(&w,
+                 "%s\"%s\":{\"runs\":%lu,\"period_ms\":%lu,\"stretched_ms\":%lu,"
+                 "\"exec_us\":{\"last\":%lu,\"avg\":%lu,\"max\":%lu},\"jitter_max_us\":%lu,"
+                 "\"missed\":%lu,\"missed_in_row\":%lu,\"stretches\":%lu}",
+                 id > 0 ? "," : "", timing.name, timing.loops, timing.period_ms,
+                 timing.stretched_ms, timing.last_exec_us, timing.avg_exec_us,
+                 timing.max_exec_us, timing.max_jitter_us, timing.misses,
+                 timing.consecutive_misses, timing.stretches);
+    }
+    priority_tuner_stats_t priorities;
+    priority_tuner_get(&priorities);
+    text_printf(&w, "},\"priorities\":{\"looks\":%lu,\"ui_guards\":%lu",
+                priorities.looks, priorities.ui_guards);
+    for (uint8_t i = 0; i < priorities.count; i++) {
+        const priority_task_stats_t* task = &priorities.tasks[i];
+        text_printf(&w,
+                 ",\"%s\":{\"own\":%u,\"set\":%u,\"running\":%u,\"raised\":%lu,\"lowered\":%lu,"
+                 "\"inherited\":%lu}",
+                 task->name, task->base, task->priority, task->running, task->boosts,
+                 task->relaxes, task->inherited);
+    }
+    text_printf(&w, "},\"boot_ms\":{");
+    for (uint8_t id = 0; id < BOOT_STAGE_COUNT; id++) {
+        boot_stage_stats_t stage;
+        boot_profile_get((boot_stage_t)id, &stage);
+        text_printf(&w, "%s\"%s\":[%lu,%lu]",
+                    id > 0 ? "," : "", stage.name, stage.begin_us / 1000, stage.end_us / 1000);
+    }
+    text_printf(&w, "}}");
+    if (w.truncated) {
+        LOGW(SYSTEM, "⚠️  /metrics cut off at %u of %u bytes", (unsigned)w.length, METRICS_BODY_BYTES);
+        request->send(500, "text/plain", "metrics document too large\n");
+        return;
+    }
+    request->send(200, "application/json", body);
+}
+
+/**
+ * @brief Report the backlight level, its inputs and the hourly schedule
+ */
+static void on_backlight_get(AsyncWebServerRequest* request) {
+    backlight_status_t status;
+    uint8_t schedule[BACKLIGHT_SCHEDULE_HOURS];
+    backlight_get_status(&status);
+    backlight_get_schedule(schedule);
+
+    char body[256];
+    int len = snprintf(body, sizeof(body),
+                       "{\"level\":%u,\"state\":%u,\"schedule_cap\":%u,\"ambient\":%u,\"interaction\":%s,"
+                       "\"fades\":%lu,\"schedule\":[",
+                       status.level_pct, status.state_pct, status.schedule_pct, status.ambient_pct,
+                       status.interaction ? "true" : "false", status.fades);
+    for (uint8_t hour = 0; hour < BACKLIGHT_SCHEDULE_HOURS; hour++) {
+        len += snprintf(body + len, sizeof(body) - len, hour > 0 ? ",%u" : "%u", schedule[hour]);
+    }
+    snprintf(body + len, sizeof(body) - len, "]}");
+    request->send(200, "application/json", body);
+}
+
+/**
+ * @brief Take a new schedule: form field "schedule", 24 comma-separated percentages
+ */
+static void on_backlight_set(AsyncWebServerRequest* request) {
+    if (!request->hasParam("schedule", true)) {
+        request->send(400, "text/plain", "schedule missing");
+        return;
+    }
+
+    uint8_t schedule[BACKLIGHT_SCHEDULE_HOURS];
+    const char* text = request->getParam("schedule", true)->value().c_str();
+    uint8_t hours = 0;
+    while (hours < BACKLIGHT_SCHEDULE_HOURS) {
+        char* end;
+        long pct = strtol(text, &end, 10);
+        if (end == text || pct < 0 || pct > 100) {
+            break;
+        }
+        schedule[hours++] = (uint8_t)pct;
+        text = *end == ',' ? end + 1 : end;
+    }
+
+    if (hours != BACKLIGHT_SCHEDULE_HOURS || *text != '\0') {
+        request->send(400, "text/plain", "expected 24 values 0-100");
+        return;
+    }
+    if (!backlight_set_schedule(schedule)) {
+        request->send(500, "text/plain", "schedule not saved");
+        return;
+    }
+    request->send(200, "text/plain", "schedule saved");
+}
+
+/**
+ * @brief Newest points of one metric: ?metric=free_heap&tier=1s|1m|15m&count=N
+ */
+static void on_history(AsyncWebServerRequest* request) {
+    static const char* const tier_names[HISTORY_TIER_COUNT] = { "1s", "1m", "15m" };
+    static metric_rollup_t points[HISTORY_HTTP_MAX_POINTS];    // Handlers all run on the server's task
+
+#if HTTP_API_ENABLED
+    if (!http_api_admit(request, HTTP_API_ROUTE_OTHER)) {
+        return;
+    }
+#endif
+    metric_id_t metric = request->hasParam("metric") ?
+        metrics_history_find(request->getParam("metric")->value().c_str()) : METRIC_COUNT;
+    if (metric == METRIC_COUNT) {
+        request->send(400, "text/plain", "unknown metric");
+        return;
+    }
+    history_tier_t tier = HISTORY_TIER_MINUTES;
+    if (request->hasParam("tier")) {
+        const char* name = request->getParam("tier")->value().c_str();
+        uint8_t t = 0;
+        while (t < HISTORY_TIER_COUNT && strcmp(name, tier_names[t]) != 0) {
+            t++;
+        }
+        if (t == HISTORY_TIER_COUNT) {
+            request->send(400, "text/plain", "tier is 1s, 1m or 15m");
+            return;
+        }
+        tier = (history_tier_t)t;
+    }
+    uint16_t count = HISTORY_HTTP_MAX_POINTS;
+    if (request->hasParam("count")) {
+        long requested = request->getParam("count")->value().toInt();
+        count = (uint16_t)constrain(requested, 1L, (long)HISTORY_HTTP_MAX_POINTS);
+    }
+
+    uint32_t newest_ms = 0;
+    count = metrics_history_query(tier, metric, points, count, &newest_ms);
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"metric\":\"%s\",\"tier\":\"%s\",\"interval_ms\":%lu,\"newest_ms\":%lu,"
+                     "\"points\":[", metrics_history_name(metric), tier_names[tier],
+                     metrics_history_interval_ms(tier), newest_ms);
+    for (uint16_t i = 0; i < count; i++) {
+        response->printf(i > 0 ? ",[%ld,%ld,%ld]" : "[%ld,%ld,%ld]",
+                         points[i].min, points[i].avg, points[i].max);
+    }
+    response->print("]}");
+    request->send(response);
+}
+
+/**
+ * @brief Send the event ring as a binary export
+ *
+ * Tracing stays paused until the last byte is out or the client goes away.
+ */
+static void on_trace_get(AsyncWebServerRequest* request) {
+#if HTTP_API_ENABLED
+    if (!http_api_admit(request, HTTP_API_ROUTE_OTHER)) {
+        return;
+    }
+#endif
+    size_t total = event_trace_freeze();
+    if (total == 0) {
+        request->send(409, "text/plain", "export in progress");
+        return;
+    }
+    request->onDisconnect([]() {
+        event_trace_thaw();
+    });
+    AsyncWebServerResponse* response = request->beginResponse("application/octet-stream", total,
+        [total](uint8_t* out, size_t max_len, size_t index) -> size_t {
+            return index < total ? event_trace_read(index, out, max_len) : 0;
+        });
+    response->addHeader("Content-Disposition", "attachment; filename=\"events.hev\"");
+    request->send(response);
+}
+
+/**
+ * @brief Write the event ring to the SD card off the server's task
+ */
+static void on_trace_save(AsyncWebServerRequest* request) {
+    if (!sd_monitor_mounted()) {
+        request->send(503, "text/plain", "no SD card");
+        return;
+    }
+    if (!job_pool_submit(JOB_LANE_LOW, save_trace_job, NULL, 0)) {
+        request->send(503, "text/plain", "job queue full");
+        return;
+    }
+    request->send(202, "text/plain", EVENT_TRACE_SD_FILE "\n");
+}
+
+/**
+ * @brief Job: event_trace_save_sd() on a worker
+ */
+static void save_trace_job(void* payload) {
+    event_trace_save_sd();
+}
+
+/**
+ * @brief Stream captured frames as pcap until the client goes away
+ *
+ * The body is chunked and open-ended; while nothing new is staged the
+ * filler asks the server to try again instead of ending the response.
+ */
+static void on_pcap_stream(AsyncWebServerRequest* request) {
+    if (!pcap_export_stream_open()) {
+        request->send(409, "text/plain", "stream busy or capture off");
+        return;
+    }
+    request->onDisconnect([]() {
+        pcap_export_stream_close();
+    });
+    AsyncWebServerResponse* response = request->beginChunkedResponse("application/vnd.tcpdump.pcap",
+        [](uint8_t* out, size_t max_len, size_t index) -> size_t {
+            size_t length = pcap_export_stream_read(out, max_len);
+            return length > 0 ? length : RESPONSE_TRY_AGAIN;
+        });
+    response->addHeader("Content-Disposition", "attachment; filename=\"capture.pcap\"");
+    request->send(response);
+}
+
+/**
+ * @brief Start or stop writing captured frames to the SD card, e.g. sd=start
+ */
+static void on_pcap_sd(AsyncWebServerRequest* request) {
+    if (!request->hasParam("sd", true)) {
+        request->send(400, "text/plain", "sd=start or sd=stop required");
+        return;
+    }
+    const String& action = request->getParam("sd", true)->value();
+    if (action == "start") {
+        if (!pcap_export_sd_start()) {
+            request->send(503, "text/plain", "no SD card");
+            return;
+        }
+    } else if (action == "stop") {
+        pcap_export_sd_stop();
+    } else {
+        request->send(400, "text/plain", "sd=start or sd=stop required");
+        return;
+    }
+    request->send(200, "text/plain", "ok\n");
+}
+
+/**
+ * @brief The mounted card's measured clock and write size
+ */
+static void on_sd_bench_get(AsyncWebServerRequest* request) {
+    sd_bench_stats_t bench;
+    sd_bench_get_stats(&bench);
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"valid\":%s,\"spi_hz\":%lu,\"block_bytes\":%u,\"write_kbps\":%lu,"
+                     "\"max_block_us\":%lu,\"clocks_tried\":%u,\"sweeps\":%u,\"block_runs\":%u,"
+                     "\"last_sweep_ms\":%lu}",
+                     bench.valid ? "true" : "false", bench.result.spi_hz, bench.result.block_bytes,
+                     bench.result.write_kbps, bench.result.max_block_us, bench.clocks_tried,
+                     bench.sweeps, bench.block_runs, bench.last_sweep_ms);
+    request->send(response);
+}
+
+/**
+ * @brief Time the write sizes again at the current clock, off the server's task
+ */
+static void on_sd_bench_run(AsyncWebServerRequest* request) {
+    if (!sd_bench_request()) {
+        request->send(503, "text/plain", "no SD card or benchmark running");
+        return;
+    }
+    request->send(202, "text/plain", "started\n");
+}
+
+/**
+ * @brief Every tunable value with its default and bounds
+ */
+static void on_tunables_get(AsyncWebServerRequest* request) {
+    char body[768];
+    int len = snprintf(body, sizeof(body), "{");
+    for (uint8_t id = 0; id < TUNABLE_COUNT; id++) {
+        tunable_info_t info;
+        tunable_get_info((tunable_id_t)id, &info);
+        len += snprintf(body + len, sizeof(body) - len,
+                        "%s\"%s\":{\"value\":%ld,\"default\":%ld,\"min\":%ld,\"max\":%ld}",
+                        id > 0 ? "," : "", info.name, info.value, info.default_value,
+                        info.min, info.max);
+    }
+    snprintf(body + len, sizeof(body) - len, "}");
+    request->send(200, "application/json", body);
+}
+
+/**
+ * @brief Set one value: name=log_ms&value=60000; or reset=1 for all the defaults
+ */
+static void on_tunables_set(AsyncWebServerRequest* request) {
+    if (request->hasParam("reset", true)) {
+        tunables_reset();
+        request->send(200, "text/plain", "defaults restored\n");
+        return;
+    }
+    if (!request->hasParam("name", true) || !request->hasParam("value", true)) {
+        request->send(400, "text/plain", "name and value required\n");
+        return;
+    }
+
+    tunable_id_t id = tunable_find(request->getParam("name", true)->value().c_str());
+    if (id == TUNABLE_COUNT) {
+        request->send(400, "text/plain", "unknown name\n");
+        return;
+    }
+    const char* text = request->getParam("value", true)->value().c_str();
+    char* end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || !tunable_set(id, (int32_t)value)) {
+        request->send(400, "text/plain", "value out of bounds or order, or not saved\n");
+        return;
+    }
+    request->send(200, "text/plain", "saved\n");
+}
+
+#if SOAK_ENABLED
+/**
+ * @brief Progress of a soak run and the gates' latest figures, for tools/soak
+ */
+static void on_soak_get(AsyncWebServerRequest* request) {
+    soak_status_t soak;
+    soak_get_status(&soak);
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"elapsed_ms\":%lu,\"window_ms\":%lu,\"cycles\":%lu,\"from_trace\":%s,"
+                     "\"trace_loops\":%lu,\"ui_steps\":%lu,\"checks\":%lu,"
+                     "\"heap_drift_bph\":%ld,\"frag_growth_pph\":%.3f,\"misses_per_hour\":%lu,"
+                     "\"loop_creep_pct\":%ld,\"failing\":[",
+                     soak.elapsed_ms, soak.window_ms, soak.cycles, soak.from_trace ? "true" : "false",
+                     soak.trace_loops, soak.ui_steps, soak.checks, soak.heap_drift_bph,
+                     soak.frag_growth_milli_pph / 1000.0f, soak.misses_per_hour, soak.loop_creep_pct);
+    const char* separator = "";
+    for (uint8_t gate = 0; gate < SOAK_GATE_COUNT; gate++) {
+        if (soak.failing & (1 << gate)) {
+            response->printf("%s\"%s\"", separator, soak_gate_name((soak_gate_t)gate));
+            separator = ",";
+        }
+    }
+    response->print("],\"failed\":[");
+    separator = "";
+    for (uint8_t gate = 0; gate < SOAK_GATE_COUNT; gate++) {
+        if (soak.failed & (1 << gate)) {
+            response->printf("%s\"%s\"", separator, soak_gate_name((soak_gate_t)gate));
+            separator = ",";
+        }
+    }
+    response->print("]}");
+    request->send(response);
+}
+#endif
+
+#if SCAN_SYNTH_ENABLED && !SOAK_ENABLED
+/**
+ * @brief The synthetic load in force and what the generator has handed out
+ */
+static void on_synth_get(AsyncWebServerRequest* request) {
+    scan_synth_load_t load;
+    scan_synth_stats_t synth;
+    scan_synth_get_load(&load);
+    scan_synth_get_stats(&synth);
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"aps\":%u,\"ble\":%u,\"churn_permille\":%u,\"rssi_step_db\":%u,"
+                     "\"adv_per_s\":%u,\"wifi_rssi\":%d,\"ble_rssi\":%d,\"speedup\":%u,"
+                     "\"cycles\":%lu,\"wifi_records\":%lu,\"ble_records\":%lu,\"adverts\":%lu,"
+                     "\"adverts_dropped\":%lu,\"replaced\":%lu,\"last_sweep_us\":%lu,"
+                     "\"tracked\":%lu,\"table_slots\":%lu}",
+                     load.aps, load.ble_devices, load.churn_permille, load.rssi_step_db,
+                     load.adv_per_s, load.wifi_rssi_dbm, load.ble_rssi_dbm, load.speedup,
+                     synth.cycles, synth.wifi_records, synth.ble_records, synth.adverts,
+                     synth.adverts_dropped, synth.replaced, synth.last_sweep_us,
+                     device_table_count(), device_table_capacity());
+    request->send(response);
+}
+
+/**
+ * @brief Change the load, e.g. aps=3000&ble=6000&churn=50&speedup=4; unnamed fields stay
+ */
+static void on_synth_set(AsyncWebServerRequest* request) {
+    scan_synth_load_t load;
+    scan_synth_get_load(&load);
+    if (request->hasParam("aps", true)) {
+        load.aps = (uint16_t)constrain(request->getParam("aps", true)->value().toInt(), 0, SCAN_SYNTH_MAX_DEVICES);
+    }
+    if (request->hasParam("ble", true)) {
+        load.ble_devices = (uint16_t)constrain(request->getParam("ble", true)->value().toInt(), 0, SCAN_SYNTH_MAX_DEVICES);
+    }
+    if (request->hasParam("churn", true)) {
+        load.churn_permille = (uint16_t)constrain(request->getParam("churn", true)->value().toInt(), 0, 1000);
+    }
+    if (request->hasParam("step", true)) {
+        load.rssi_step_db = (uint8_t)constrain(request->getParam("step", true)->value().toInt(), 0, 20);
+    }
+    if (request->hasParam("adv", true)) {
+        load.adv_per_s = (uint8_t)constrain(request->getParam("adv", true)->value().toInt(), 0, 100);
+    }
+    if (request->hasParam("wifi_rssi", true)) {
+        load.wifi_rssi_dbm = (int8_t)constrain(request->getParam("wifi_rssi", true)->value().toInt(), -100, -20);
+    }
+    if (request->hasParam("ble_rssi", true)) {
+        load.ble_rssi_dbm = (int8_t)constrain(request->getParam("ble_rssi", true)->value().toInt(), -100, -20);
+    }
+    if (request->hasParam("speedup", true)) {
+        load.speedup = (uint8_t)constrain(request->getParam("speedup", true)->value().toInt(), 1, 50);
+    }
+    scan_synth_set_load(&load);
+    on_synth_get(request);
+}
+#endif
+
+#if PROFILE_ENABLED
+/**
+ * @brief Cycle counts of every instrumented site, as a text table
+ */
+static void on_profile_get(AsyncWebServerRequest* request) {
+    static char table[PROFILE_TEXT_BYTES];     // Handlers all run on the server's task
+    size_t length = profile_format(table, sizeof(table));
+    AsyncResponseStream* response = request->beginResponseStream("text/plain");
+    response->write((const uint8_t*)table, length);
+    request->send(response);
+}
+
+/**
+ * @brief Clear every site, so the next GET covers only what runs from now on
+ */
+static void on_profile_reset(AsyncWebServerRequest* request) {
+    profile_reset();
+    request->send(200, "text/plain", "profile cleared\n");
+}
+#endif
+
+#if ALLOC_TRACE_ENABLED
+/**
+ * @brief Allocations per loop body and call site, as text
+ */
+static void on_allocs_get(AsyncWebServerRequest* request) {
+    char line[ALLOC_TRACE_LINE_BYTES];
+    AsyncResponseStream* response = request->beginResponseStream("text/plain");
+    for (uint16_t i = 0; alloc_trace_write_line(i, line, sizeof(line)) > 0; i++) {
+        response->printf("%s\n", line);
+    }
+    request->send(response);
+}
+
+/**
+ * @brief Clear bodies and sites, e.g. once boot and the first scans have settled
+ */
+static void on_allocs_reset(AsyncWebServerRequest* request) {
+    alloc_trace_reset();
+    request->send(200, "text/plain", "allocations cleared\n");
+}
+#endif
+
+/**
+ * @brief Newest log output, preceded by the level of every module
+ */
+static void on_log_get(AsyncWebServerRequest* request) {
+    static char tail[LOG_TAIL_BYTES];
+    size_t length = logger_tail(tail, sizeof(tail));
+
+    AsyncResponseStream* response = request->beginResponseStream("text/plain");
+    response->print("# levels:");
+    for (uint8_t module = 0; module < LOG_MODULE_COUNT; module++) {
+        response->printf(" %s=%s", logger_module_name((log_module_t)module),
+                         logger_level_name(logger_get_level((log_module_t)module)));
+    }
+    response->print("\n");
+    response->write((const uint8_t*)tail, length);
+    request->send(response);
+}
+
+/**
+ * @brief Set a module's level, e.g. module=scan&level=debug; module=all sets every one
+ */
+static void on_log_level(AsyncWebServerRequest* request) {
+    if (!request->hasParam("module", true) || !request->hasParam("level", true)) {
+        request->send(400, "text/plain", "module and level required");
+        return;
+    }
+    const char* module_name = request->getParam("module", true)->value().c_str();
+    log_module_t module = strcmp(module_name, "all") == 0 ? LOG_MODULE_COUNT
+                        : logger_find_module(module_name);
+    log_level_t level = logger_find_level(request->getParam("level", true)->value().c_str());
+    if ((module == LOG_MODULE_COUNT && strcmp(module_name, "all") != 0) || level == LOG_LEVEL_COUNT) {
+        request->send(400, "text/plain", "unknown module or level");
+        return;
+    }
+    logger_set_level(module, level);
+    request->send(200, "text/plain", "ok\n");
+}
+
+/**
+ * @brief Progress of the current or last firmware update
+ */
+static void on_firmware_get(AsyncWebServerRequest* request) {
+    firmware_update_status_t firmware;
+    firmware_update_get_status(&firmware);
+
+    char body[320];
+    snprintf(body, sizeof(body),
+             "{\"phase\":\"%s\",\"patch_bytes\":%lu,\"received\":%lu,\"written\":%lu,"
+             "\"target_size\":%lu,\"resumes\":%u,\"updates\":%lu,\"failures\":%lu,"
+             "\"error\":\"%s\"}",
+             firmware_update_phase_name(firmware.phase), firmware.patch_bytes, firmware.received,
+             firmware.written, firmware.target_size, firmware.resumes, firmware.updates,
+             firmware.failures, firmware.error);
+    request->send(200, "application/json", body);
+}
+
+/**
+ * @brief Pull a patch: url=http://..., optionally sha256=<64 hex digits> of the new image
+ */
+static void on_firmware_start(AsyncWebServerRequest* request) {
+    if (!request->hasParam("url", true)) {
+        request->send(400, "text/plain", "url required\n");
+        return;
+    }
+
+    uint8_t sha256[32];
+    bool have_sha = request->hasParam("sha256", true);
+    if (have_sha) {
+        const String& hex = request->getParam("sha256", true)->value();
+        if (hex.length() != 64) {
+            request->send(400, "text/plain", "sha256 is 64 hex digits\n");
+            return;
+        }
+        for (uint8_t i = 0; i < sizeof(sha256); i++) {
+            char pair[3] = { hex[i * 2], hex[i * 2 + 1], '\0' };
+            char* end;
+            sha256[i] = (uint8_t)strtoul(pair, &end, 16);
+            if (*end != '\0') {
+                request->send(400, "text/plain", "sha256 is 64 hex digits\n");
+                return;
+            }
+        }
+    }
+
+    if (!firmware_update_start(request->getParam("url", true)->value().c_str(),
+                               have_sha ? sha256 : NULL)) {
+        request->send(409, "text/plain", "update running or URL too long\n");
+        return;
+    }
+    request->send(202, "text/plain", "started\n");
+}
+
@@ -0,0 +1,648 @@
+/**
+ * @file mqtt_uplink.cpp
+ * @brief Batched sensor telemetry to an MQTT broker, queued while offline
+ *
+ * The task queues each closed telemetry summary as a batch of one and,
+ * while raw telemetry is on, samples the sensor snapshot and packs new
+ * cycles into batches; it publishes one batch at a time at QoS 1. A batch leaves the queue only
+ * once the broker acknowledges it, so delivery is at least once: a broker
+ * that drops the connection between storing a batch and acknowledging it
+ * sees the batch again, with the same session and sequence.
+ *
+ * Batches wait in a PSRAM ring of MQTT_QUEUE_BATCHES. When it is full the
+ * oldest moves to a spool file of fixed-size slots on the SD card; the
+ * file's header records the next slot to replay, so the spool survives a
+ * reboot and is replayed before anything newer. Everything in the spool is
+ * older than everything in the ring, so draining the spool first and then
+ * the ring keeps the broker's view in order.
+ *
+ * The association itself belongs to wifi_link; each send keeps scans on
+ * the home channel for WIFI_LINK_TRAFFIC_MS so the acknowledgement is not
+ * left waiting at the access point.
+ *
+ * The same connection carries the fleet command channel: the commands
+ * topic is subscribed on every connect, and the batched acknowledgements
+ * go out from this task between telemetry publishes (see fleet_commands.h).
+ *
+ * After a crash it also carries the core dump and the kept event trace,
+ * one chunk in flight at a time beside the telemetry (see crash_dump.h).
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <mqtt_client.h>
+#include <esp_wifi.h>
+#include "config.h"
+#include "mqtt_uplink.h"
+#include "sensor_snapshot.h"
+#include "telemetry_summary.h"
+#include "wifi_link.h"
+#include "sd_monitor.h"
+#include "spi_bus.h"
+#include "fleet_commands.h"
+#include "crash_dump.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+#define SPOOL_MAGIC (0x4C4F4F00u | SENSOR_DATA_VERSION) // "POO" + record layout; another starts over
+
+// Notification bits, one per reason to wake
+#define UPLINK_EVENT_CONNECTED (1 << 0)
+#define UPLINK_EVENT_ACKED     (1 << 1)
+
+// Without summaries the raw batches are all there is
+#define RAW_ALWAYS (MQTT_RAW_TELEMETRY || !SUMMARY_ENABLED)
+
+/**
+ * @brief First bytes of the spool file; slots of sizeof(mqtt_batch_t) follow
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t read_slot;             // Next slot to publish
+} spool_header_t;
+
+/**
+ * @brief Where the batch being published came from
+ */
+typedef enum {
+    SOURCE_NONE = 0,
+    SOURCE_SPOOL,
+    SOURCE_RING
+} batch_source_t;
+
+static TaskHandle_t uplink_handle = NULL;
+static StaticTask_t uplink_tcb;
+static StackType_t uplink_stack[MQTT_STACK_SIZE];
+static esp_mqtt_client_handle_t client = NULL;
+
+static mqtt_batch_t* ring = NULL;   // MQTT_QUEUE_BATCHES, PSRAM
+static uint16_t ring_head = 0;      // Oldest batch
+static uint16_t ring_count = 0;
+static mqtt_batch_t filling;        // Batch taking samples
+static mqtt_batch_t sending;        // Copy of the batch awaiting acknowledgement
+
+static uint32_t spool_read = 0;     // Mirrors the file header
+static uint32_t spool_slots = 0;    // Slots written, replayed or not
+
+static uint32_t session = 0;
+static uint32_t sequence = 0;
+static uint32_t sampled_version = 0;
+static uint32_t sampled_ms = 0;
+static batch_source_t in_flight = SOURCE_NONE;
+static int in_flight_id = -1;
+static uint32_t in_flight_ms = 0;
+static char topic[64];
+static char summary_topic[64];
+static uint32_t raw_until_ms = 0;   // Raw telemetry asked for until then, under uplink_mux
+static bool raw_requested = false;
+#if FLEET_ENABLED
+static char command_topic[64];
+static char ack_topic[64];
+static char ack_body[FLEET_ACK_BATCH * 48];
+static volatile int ack_msg_id = -1;  // Acknowledgement message in flight, not a batch
+#endif
+#if CRASH_DUMP_ENABLED
+static char crash_topic[64];
+static uint8_t* crash_chunk = NULL; // Header and CRASH_MQTT_CHUNK_BYTES, PSRAM
+static volatile int crash_msg_id = -1;
+static volatile bool crash_acked = false;
+static bool crash_in_flight = false;
+static uint32_t crash_sent_ms = 0;
+#endif
+
+// Written from the MQTT task
+static volatile bool broker_up = false;
+static volatile int acked_id = -1;
+
+static mqtt_uplink_stats_t stats = {0};
+static portMUX_TYPE uplink_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void uplink_task(void* parameter);
+static void on_mqtt_event(void* handler_args, esp_event_base_t base, int32_t event_id,
+                          void* event_data);
+static void sample(uint32_t now_ms);
+static void seal(mqtt_batch_t* batch, uint8_t format, uint8_t record_bytes);
+static bool raw_on(uint32_t now_ms);
+static void enqueue(const mqtt_batch_t* batch);
+static void publish_next(uint32_t now_ms);
+static void on_acknowledged(void);
+#if FLEET_ENABLED
+static void publish_acks(uint32_t now_ms);
+#endif
+#if CRASH_DUMP_ENABLED
+static void publish_crash(uint32_t now_ms);
+#endif
+static void spool_open(void);
+static bool spool_append(const mqtt_batch_t* batch);
+static bool spool_peek(mqtt_batch_t* batch);
+static void spool_pop(void);
+
+/**
+ * @brief Take the PSRAM queue and start the uplink task
+ */
+bool mqtt_uplink_init(void) {
+    if (uplink_handle != NULL) {
+        return true;
+    }
+
+    ring = (mqtt_batch_t*)mem_calloc(MEM_BULK, MQTT_QUEUE_BATCHES, sizeof(mqtt_batch_t));
+    if (ring == NULL) {
+        LOGE(SYSTEM, "❌ No PSRAM for the MQTT queue");
+        return false;
+    }
+
+    uint8_t mac[6];
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+    snprintf(topic, sizeof(topic), "%s/%02x%02x%02x%02x%02x%02x/telemetry", MQTT_TOPIC_PREFIX,
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(summary_topic, sizeof(summary_topic), "%s/%02x%02x%02x%02x%02x%02x/summary",
+             MQTT_TOPIC_PREFIX, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+#if FLEET_ENABLED
+    snprintf(command_topic, sizeof(command_topic), "%s/%02x%02x%02x%02x%02x%02x/commands",
+             MQTT_TOPIC_PREFIX, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(ack_topic, sizeof(ack_topic), "%s/%02x%02x%02x%02x%02x%02x/acks",
+             MQTT_TOPIC_PREFIX, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+#endif
+#if CRASH_DUMP_ENABLED
+    snprintf(crash_topic, sizeof(crash_topic), "%s/%02x%02x%02x%02x%02x%02x/crash",
+             MQTT_TOPIC_PREFIX, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    // Without it crashes are still served over HTTP
+    crash_chunk = (uint8_t*)mem_alloc(MEM_BULK, sizeof(crash_chunk_header_t) + CRASH_MQTT_CHUNK_BYTES);
+#endif
+    session = esp_random();
+    memset(&filling, 0, sizeof(filling));
+    spool_open();
+    stats.spooled = spool_slots - spool_read;
+
+    uplink_handle = xTaskCreateStaticPinnedToCore(uplink_task, "MQTT_Uplink", MQTT_STACK_SIZE,
+                                                  NULL, MQTT_PRIORITY, uplink_stack,
+                                                  &uplink_tcb, tskNO_AFFINITY);
+    if (uplink_handle == NULL) {
+        mem_free(MEM_BULK, ring, MQTT_QUEUE_BATCHES * sizeof(mqtt_batch_t));
+        ring = NULL;
+        return false;
+    }
+
+    LOGI(SYSTEM, "✅ MQTT uplink to %s on %s (%lu spooled)", MQTT_BROKER_URI, topic,
+         (unsigned long)(spool_slots - spool_read));
+    return true;
+}
+
+/**
+ * @brief Send raw sensor data as well as summaries for a while (any task)
+ */
+void mqtt_uplink_raw_for(uint32_t minutes) {
+    portENTER_CRITICAL(&uplink_mux);
+    raw_until_ms = millis() + minutes * 60000UL;
+    raw_requested = minutes > 0;
+    portEXIT_CRITICAL(&uplink_mux);
+}
+
+/**
+ * @brief Copy the uplink figures
+ */
+void mqtt_uplink_get_stats(mqtt_uplink_stats_t* out) {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&uplink_mux);
+    *out = stats;
+    out->raw_left_s = raw_requested && (int32_t)(raw_until_ms - now) > 0 ?
+                      (raw_until_ms - now) / 1000 : 0;
+    portEXIT_CRITICAL(&uplink_mux);
+    out->wifi_connected = wifi_link_associated();
+    out->broker_connected = broker_up;
+}
+
+/**
+ * @brief Sample, queue and publish; the broker client starts with the first association
+ */
+static void uplink_task(void* parameter) {
+    for (;;) {
+        uint32_t now = millis();
+
+        if (client == NULL && wifi_link_associated()) {
+            // esp-mqtt reconnects by itself from here on
+            esp_mqtt_client_config_t config;
+            memset(&config, 0, sizeof(config));
+            config.uri = MQTT_BROKER_URI;
+            client = esp_mqtt_client_init(&config);
+            if (client != NULL) {
+                esp_mqtt_client_register_event(client, MQTT_EVENT_ANY, on_mqtt_event, NULL);
+                esp_mqtt_client_start(client);
+            }
+        }
+
+        sample(now);
+
+        if (in_flight != SOURCE_NONE) {
+            if (acked_id == in_flight_id) {
+                on_acknowledged();
+            } else if (!broker_up || now - in_flight_ms >= MQTT_ACK_TIMEOUT_MS) {
+                // Sent again from the queue once the broker is back
+                in_flight = SOURCE_NONE;
+                portENTER_CRITICAL(&uplink_mux);
+                stats.retries++;
+                portEXIT_CRITICAL(&uplink_mux);
+            }
+        }
+        if (in_flight == SOURCE_NONE && broker_up) {
+            publish_next(now);
+        }
+#if FLEET_ENABLED
+        if (broker_up) {
+            publish_acks(now);
+        }
+#endif
+#if CRASH_DUMP_ENABLED
+        publish_crash(now);
+#endif
+
+        uint32_t events;
+        xTaskNotifyWait(0, ULONG_MAX, &events, pdMS_TO_TICKS(250));
+    }
+}
+
+/**
+ * @brief Track the broker connection and acknowledgements; runs on the MQTT task
+ */
+static void on_mqtt_event(void* handler_args, esp_event_base_t base, int32_t event_id,
+                          void* event_data) {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+    switch (event_id) {
+        case MQTT_EVENT_CONNECTED:
+            broker_up = true;
+            portENTER_CRITICAL(&uplink_mux);
+            stats.connects++;
+            portEXIT_CRITICAL(&uplink_mux);
+#if FLEET_ENABLED
+            // Clean sessions forget subscriptions, so every connect renews it
+            esp_mqtt_client_subscribe(client, command_topic, 1);
+#endif
+            xTaskNotify(uplink_handle, UPLINK_EVENT_CONNECTED, eSetBits);
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            broker_up = false;
+            break;
+        case MQTT_EVENT_PUBLISHED:
+#if FLEET_ENABLED
+            if (event->msg_id == ack_msg_id) {
+                break;
+            }
+#endif
+#if CRASH_DUMP_ENABLED
+            if (event->msg_id == crash_msg_id) {
+                crash_acked = true;
+                xTaskNotify(uplink_handle, UPLINK_EVENT_ACKED, eSetBits);
+                break;
+            }
+#endif
+            acked_id = event->msg_id;
+            xTaskNotify(uplink_handle, UPLINK_EVENT_ACKED, eSetBits);
+            break;
+#if FLEET_ENABLED
+        case MQTT_EVENT_DATA:
+            // Commands are a few lines; a message split over reads is not one
+            if (event->current_data_offset == 0 && event->data_len == event->total_data_len) {
+                fleet_commands_submit_text(event->data, event->data_len, FLEET_SOURCE_MQTT);
+            } else if (event->current_data_offset == 0) {
+                LOGW(SYSTEM, "⚠️  %d-byte fleet command message ignored", event->total_data_len);
+            }
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Queue the closed summaries, then add the latest sensor data to the filling batch
+ *
+ * Sensor data is only sampled while raw telemetry is on; a batch left
+ * part full when it goes off is queued as it is.
+ */
+static void sample(uint32_t now_ms) {
+#if SUMMARY_ENABLED
+    mqtt_batch_t batch;
+    telemetry_summary_t summary;
+    while (telemetry_summary_take(&summary)) {
+        memset(&batch, 0, sizeof(batch));
+        memcpy(batch.records, &summary, sizeof(summary));
+        batch.header.records = 1;
+        seal(&batch, MQTT_SUMMARY_FORMAT, sizeof(summary));
+        enqueue(&batch);
+        portENTER_CRITICAL(&uplink_mux);
+        stats.summaries++;
+        portEXIT_CRITICAL(&uplink_mux);
+    }
+#endif
+
+    if (!raw_on(now_ms)) {
+        if (filling.header.records > 0) {
+            seal(&filling, MQTT_BATCH_FORMAT, SENSOR_DATA_WIRE_BYTES);
+            enqueue(&filling);
+            memset(&filling, 0, sizeof(filling));
+            portENTER_CRITICAL(&uplink_mux);
+            stats.raw++;
+            portEXIT_CRITICAL(&uplink_mux);
+        }
+        return;
+    }
+    if (now_ms - sampled_ms < MQTT_SAMPLE_INTERVAL_MS) {
+        return;
+    }
+
+    sensor_data_t data;
+    uint32_t version = sensor_snapshot_read(&data);
+    if (version == 0 || version == sampled_version) {
+        return;
+    }
+    sampled_version = version;
+    sampled_ms = now_ms;
+
+    uint8_t* slot = filling.records + filling.header.records * SENSOR_DATA_WIRE_BYTES;
+    if (sensor_data_serialize(&data, slot, SENSOR_DATA_WIRE_BYTES) == 0) {
+        return;
+    }
+    if (++filling.header.records < MQTT_BATCH_RECORDS) {
+        return;
+    }
+
+    seal(&filling, MQTT_BATCH_FORMAT, SENSOR_DATA_WIRE_BYTES);
+    enqueue(&filling);
+    memset(&filling, 0, sizeof(filling));
+    portENTER_CRITICAL(&uplink_mux);
+    stats.raw++;
+    portEXIT_CRITICAL(&uplink_mux);
+}
+
+/**
+ * @brief Fill in a batch's header, giving it the next sequence
+ */
+static void seal(mqtt_batch_t* batch, uint8_t format, uint8_t record_bytes) {
+    batch->header.magic = MQTT_BATCH_MAGIC;
+    batch->header.format = format;
+    batch->header.record_bytes = record_bytes;
+    batch->header.session = session;
+    batch->header.sequence = sequence++;
+}
+
+/**
+ * @brief Whether sensor data is uplinked now, always or as asked
+ */
+static bool raw_on(uint32_t now_ms) {
+    if (RAW_ALWAYS) {
+        return true;
+    }
+    portENTER_CRITICAL(&uplink_mux);
+    bool on = raw_requested && (int32_t)(raw_until_ms - now_ms) > 0;
+    if (raw_requested && !on) {
+        raw_requested = false;
+    }
+    portEXIT_CRITICAL(&uplink_mux);
+    return on;
+}
+
+/**
+ * @brief Queue a full batch, moving the oldest to the spool if the ring is full
+ */
+static void enqueue(const mqtt_batch_t* batch) {
+    if (ring_count == MQTT_QUEUE_BATCHES) {
+        bool spilled = spool_append(&ring[ring_head]);
+        ring_head = (ring_head + 1) % MQTT_QUEUE_BATCHES;
+        ring_count--;
+        portENTER_CRITICAL(&uplink_mux);
+        if (spilled) {
+            stats.spilled++;
+        } else {
+            stats.dropped++;
+        }
+        portEXIT_CRITICAL(&uplink_mux);
+    }
+
+    ring[(ring_head + ring_count) % MQTT_QUEUE_BATCHES] = *batch;
+    ring_count++;
+    portENTER_CRITICAL(&uplink_mux);
+    stats.queued = ring_count;
+    stats.spooled = spool_slots - spool_read;
+    portEXIT_CRITICAL(&uplink_mux);
+}
+
+/**
+ * @brief Publish the oldest queued batch, spool first
+ */
+static void publish_next(uint32_t now_ms) {
+    batch_source_t source = SOURCE_NONE;
+    if (spool_read < spool_slots && spool_peek(&sending)) {
+        source = SOURCE_SPOOL;
+    } else if (ring_count > 0) {
+        sending = ring[ring_head];
+        source = SOURCE_RING;
+    } else {
+        return;
+    }
+
+    size_t length = sizeof(sending.header) +
+                    sending.header.records * sending.header.record_bytes;
+    wifi_link_expect_traffic(WIFI_LINK_TRAFFIC_MS);
+    const char* to = sending.header.format == MQTT_SUMMARY_FORMAT ? summary_topic : topic;
+    int id = esp_mqtt_client_publish(client, to, (const char*)&sending, length, 1, 0);
+    if (id < 0) {
+        return;                     // Outbox full or not connected, tried again next wake
+    }
+    in_flight = source;
+    in_flight_id = id;
+    in_flight_ms = now_ms;
+}
+
+/**
+ * @brief Remove the acknowledged batch from wherever it now is
+ *
+ * The ring is only published from with the spool empty, so a ring batch
+ * spilled while in flight is then the spool's only slot, its head.
+ */
+static void on_acknowledged(void) {
+    mqtt_batch_t head;
+    if (spool_read < spool_slots && spool_peek(&head) &&
+        head.header.session == sending.header.session &&
+        head.header.sequence == sending.header.sequence) {
+        spool_pop();
+    } else if (ring_count > 0 && ring[ring_head].header.session == sending.header.session &&
+               ring[ring_head].header.sequence == sending.header.sequence) {
+        ring_head = (ring_head + 1) % MQTT_QUEUE_BATCHES;
+        ring_count--;
+    }
+    in_flight = SOURCE_NONE;
+
+    portENTER_CRITICAL(&uplink_mux);
+    stats.published++;
+    stats.queued = ring_count;
+    stats.spooled = spool_slots - spool_read;
+    portEXIT_CRITICAL(&uplink_mux);
+}
+
+#if FLEET_ENABLED
+/**
+ * @brief Send the waiting fleet acknowledgements in one message, if due
+ */
+static void publish_acks(uint32_t now_ms) {
+    if (!fleet_commands_acks_due(now_ms)) {
+        return;
+    }
+    uint8_t count;
+    size_t length = fleet_commands_format_acks(ack_body, sizeof(ack_body), &count);
+    if (length == 0) {
+        return;
+    }
+    wifi_link_expect_traffic(WIFI_LINK_TRAFFIC_MS);
+    int id = esp_mqtt_client_publish(client, ack_topic, ack_body, length, 1, 0);
+    if (id < 0) {
+        return;                     // Kept for the next wake
+    }
+    // Queued in the client's outbox, which repeats it until the broker has it
+    ack_msg_id = id;
+    fleet_commands_acks_sent(count);
+}
+#endif
+
+#if CRASH_DUMP_ENABLED
+/**
+ * @brief Move the crash upload on by a chunk once the last one is acknowledged
+ */
+static void publish_crash(uint32_t now_ms) {
+    if (crash_chunk == NULL) {
+        return;
+    }
+    if (crash_in_flight) {
+        if (crash_acked) {
+            crash_in_flight = false;
+            crash_dump_chunk_acked();
+        } else if (!broker_up || now_ms - crash_sent_ms >= MQTT_ACK_TIMEOUT_MS) {
+            crash_in_flight = false;    // The same chunk again below
+            crash_msg_id = -1;
+        } else {
+            return;
+        }
+    }
+    if (!broker_up) {
+        return;
+    }
+
+    size_t length = crash_dump_chunk(crash_chunk, sizeof(crash_chunk_header_t) + CRASH_MQTT_CHUNK_BYTES);
+    if (length == 0) {
+        return;
+    }
+    wifi_link_expect_traffic(WIFI_LINK_TRAFFIC_MS);
+    crash_acked = false;
+    int id = esp_mqtt_client_publish(client, crash_topic, (const char*)crash_chunk, length, 1, 0);
+    if (id < 0) {
+        return;
+    }
+    crash_msg_id = id;
+    crash_in_flight = true;
+    crash_sent_ms = now_ms;
+}
+#endif
+
+/**
+ * @brief Pick up a spool left by an earlier boot
+ */
+static void spool_open(void) {
+    spool_read = spool_slots = 0;
+    if (!sd_monitor_mounted()) {
+        return;
+    }
+
+    spool_header_t header;
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(MQTT_SPOOL_PATH, "r");
+    bool ok = file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == SPOOL_MAGIC;
+    uint32_t size = file ? file.size() : 0;
+    if (file) {
+        file.close();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+
+    if (ok) {
+        spool_slots = (size - sizeof(header)) / sizeof(mqtt_batch_t);
+        spool_read = header.read_slot < spool_slots ? header.read_slot : spool_slots;
+    }
+}
+
+/**
+ * @brief Add a batch after the last spool slot
+ * @return false without a card, with the spool full or on a write error
+ */
+static bool spool_append(const mqtt_batch_t* batch) {
+    if (!sd_monitor_mounted() || spool_slots >= MQTT_SPOOL_MAX_BATCHES) {
+        return false;
+    }
+
+    bool ok;
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (spool_slots == 0) {
+        spool_header_t header = { SPOOL_MAGIC, 0 };
+        File file = SD.open(MQTT_SPOOL_PATH, "w");
+        ok = file && file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+             file.write((const uint8_t*)batch, sizeof(*batch)) == sizeof(*batch);
+        if (file) {
+            file.close();
+        }
+    } else {
+        File file = SD.open(MQTT_SPOOL_PATH, "a");
+        ok = file && file.write((const uint8_t*)batch, sizeof(*batch)) == sizeof(*batch);
+        if (file) {
+            file.close();
+        }
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+
+    if (ok) {
+        spool_slots++;
+    }
+    return ok;
+}
+
+/**
+ * @brief Read the oldest unreplayed spool slot
+ */
+static bool spool_peek(mqtt_batch_t* batch) {
+    if (!sd_monitor_mounted()) {
+        return false;
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(MQTT_SPOOL_PATH, "r");
+    bool ok = file && file.seek(sizeof(spool_header_t) + spool_read * sizeof(mqtt_batch_t)) &&
+              file.read((uint8_t*)batch, sizeof(*batch)) == sizeof(*batch);
+    if (file) {
+        file.close();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    return ok;
+}
+
+/**
+ * @brief Mark the oldest spool slot replayed; remove the file once all are
+ */
+static void spool_pop(void) {
+    spool_read++;
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (spool_read >= spool_slots) {
+        SD.remove(MQTT_SPOOL_PATH);
+    } else {
+        // "r+" keeps the slots; only the header is rewritten
+        File file = SD.open(MQTT_SPOOL_PATH, "r+");
+        if (file) {
+            spool_header_t header = { SPOOL_MAGIC, spool_read };
+            file.write((const uint8_t*)&header, sizeof(header));
+            file.close();
+        }
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+
+    if (spool_read >= spool_slots) {
+        spool_read = spool_slots = 0;
+    }
+}
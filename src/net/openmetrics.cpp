@@ -0,0 +1,457 @@
+/**
+ * @file openmetrics.cpp
+ * @brief OpenMetrics text exposition of the monitors' figures, for Prometheus
+ *
+ * A scrape copies every figure once, then writes them a group of families
+ * at a time into whatever buffer the caller streams from; nothing is
+ * allocated and no group is held longer than it takes to send. Groups
+ * are one to a few families, each well under HTTP_API_TEXT_BYTES; a line
+ * that would not fit is left out whole rather than cut. Names,
+ * help text and the latency bucket edges are all string constants, so a
+ * group costs a few snprintf() calls and nothing else.
+ *
+ * The inference latency histogram reuses the telemetry's own bins: their
+ * octave edges are the bucket bounds, written out below in seconds. The
+ * scan-to-display stages do the same with the latency traces' millisecond
+ * octaves, one family and one group per stage.
+ */
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include "config.h"
+#include "sensor_snapshot.h"
+#include "i2c_sensors.h"
+#include "openmetrics.h"
+
+/**
+ * @brief Appends to one group's buffer, dropping what does not fit
+ */
+typedef struct {
+    char*  out;
+    size_t capacity;
+    size_t len;
+} om_writer_t;
+
+typedef enum {
+    FIELD_U32 = 0,
+    FIELD_U16,
+    FIELD_U8,
+    FIELD_BOOL,
+    FIELD_FLOAT
+} field_type_t;
+
+/**
+ * @brief One system_metrics_t field exposed as a gauge
+ */
+typedef struct {
+    const char* name;
+    const char* help;
+    uint8_t     offset;
+    uint8_t     type;               // field_type_t
+    float       scale;
+} system_gauge_t;
+
+#define SYSTEM_GAUGE(name, field, type, scale, help) \
+    { name, help, offsetof(system_metrics_t, field), type, scale }
+
+static const system_gauge_t system_gauges[] = {
+    SYSTEM_GAUGE("hydra_heap_free_bytes", free_heap_size, FIELD_U32, 1.0f, "Free internal heap"),
+    SYSTEM_GAUGE("hydra_heap_min_free_bytes", min_free_heap, FIELD_U32, 1.0f, "Least free internal heap since boot"),
+    SYSTEM_GAUGE("hydra_heap_largest_free_bytes", heap_largest_free, FIELD_U32, 1.0f, "Largest internal allocation that could succeed"),
+    SYSTEM_GAUGE("hydra_heap_fragmentation_percent", heap_frag_pct, FIELD_U8, 1.0f, "Free internal heap outside its largest block"),
+    SYSTEM_GAUGE("hydra_psram_free_bytes", free_psram_size, FIELD_U32, 1.0f, "Free PSRAM"),
+    SYSTEM_GAUGE("hydra_uptime_seconds", uptime_ms, FIELD_U32, 0.001f, "Time since boot"),
+    SYSTEM_GAUGE("hydra_temperature_celsius", temperature_celsius, FIELD_FLOAT, 1.0f, "Chip temperature"),
+    SYSTEM_GAUGE("hydra_thermal_level", thermal_level, FIELD_U8, 1.0f, "Throttling steps in force"),
+    SYSTEM_GAUGE("hydra_tasks", task_count, FIELD_U16, 1.0f, "FreeRTOS tasks"),
+    SYSTEM_GAUGE("hydra_cpu_usage_percent", cpu_usage_percent, FIELD_U8, 1.0f, "Mean load of both cores"),
+    SYSTEM_GAUGE("hydra_wifi_connected", wifi_connected, FIELD_BOOL, 1.0f, "Station connected"),
+    SYSTEM_GAUGE("hydra_sd_mounted", sd_card_mounted, FIELD_BOOL, 1.0f, "SD card mounted"),
+    SYSTEM_GAUGE("hydra_lvgl_used_bytes", lvgl_used_bytes, FIELD_U32, 1.0f, "LVGL pool in use"),
+    SYSTEM_GAUGE("hydra_lvgl_peak_bytes", lvgl_peak_bytes, FIELD_U32, 1.0f, "Most of the LVGL pool ever in use"),
+    SYSTEM_GAUGE("hydra_lvgl_largest_free_bytes", lvgl_largest_free, FIELD_U32, 1.0f, "Largest LVGL allocation that could succeed"),
+    SYSTEM_GAUGE("hydra_lvgl_fragmentation_percent", lvgl_frag_pct, FIELD_U8, 1.0f, "LVGL pool fragmentation"),
+};
+
+// Upper edges of the latency octaves, 4 us << n, in seconds
+static const char* const latency_le[] = {
+    "4e-06", "8e-06", "1.6e-05", "3.2e-05", "6.4e-05", "0.000128", "0.000256", "0.000512",
+    "0.001024", "0.002048", "0.004096", "0.008192", "0.016384", "0.032768", "0.065536",
+    "0.131072", "0.262144"
+};
+static_assert(sizeof(latency_le) / sizeof(latency_le[0]) == AI_TELEMETRY_OCTAVES,
+              "latency bucket edges do not match the telemetry bins");
+
+// Upper edges of the latency trace octaves, 1 ms << n, in seconds
+static const char* const pipeline_le[] = {
+    "0.001", "0.002", "0.004", "0.008", "0.016", "0.032", "0.064", "0.128",
+    "0.256", "0.512", "1.024", "2.048", "4.096", "8.192", "16.384", "32.768"
+};
+static_assert(sizeof(pipeline_le) / sizeof(pipeline_le[0]) == LATENCY_TRACE_OCTAVES,
+              "pipeline bucket edges do not match the latency trace octaves");
+
+static const char* const loop_names[LOOP_COUNT] = { "ui", "ai", "scan", "system", "capture" };
+
+#define SYSTEM_GAUGES (sizeof(system_gauges) / sizeof(system_gauges[0]))
+#define HEAP_FAMILIES 4
+#define PIPELINE_FAMILIES LATENCY_STAGE_COUNT
+
+// Forward declarations
+static void write_system(const openmetrics_snapshot_t* s, om_writer_t* w, uint8_t index);
+static void write_heap(const openmetrics_snapshot_t* s, om_writer_t* w, uint8_t f);
+static void write_pipeline(const openmetrics_snapshot_t* s, om_writer_t* w, uint8_t stage);
+static void write_cpu(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_stacks(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_scan(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_loop_times(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_loop_counts(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_latency(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_decisions(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_display(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_energy(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_environment(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_handshakes(const openmetrics_snapshot_t* s, om_writer_t* w);
+#if PROFILE_ENABLED
+static void write_profile_counts(const openmetrics_snapshot_t* s, om_writer_t* w);
+static void write_profile_max(const openmetrics_snapshot_t* s, om_writer_t* w);
+#endif
+static void put(om_writer_t* w, const char* format, ...);
+static void family(om_writer_t* w, const char* name, const char* type, const char* help);
+
+typedef void (*group_writer_t)(const openmetrics_snapshot_t* s, om_writer_t* w);
+
+// After one group per system gauge, heap family and pipeline stage
+static const group_writer_t groups[] = {
+    write_cpu, write_stacks, write_scan, write_loop_times, write_loop_counts,
+    write_latency, write_decisions, write_display, write_energy, write_environment,
+    write_handshakes,
+#if PROFILE_ENABLED
+    write_profile_counts, write_profile_max,
+#endif
+};
+
+/**
+ * @brief Copy every figure a scrape reports
+ */
+void openmetrics_snapshot(openmetrics_snapshot_t* s) {
+    system_monitor_get_metrics(&s->system);
+    cpu_load_get(&s->cpu);
+    s->task_count = task_monitor_get(s->tasks, TASK_MONITOR_MAX_TASKS);
+    for (uint8_t r = 0; r < HEAP_REGION_COUNT; r++) {
+        heap_monitor_get((heap_region_t)r, &s->heap[r]);
+    }
+    for (uint8_t id = 0; id < LOOP_COUNT; id++) {
+        loop_timing_get((loop_id_t)id, &s->loops[id]);
+    }
+    s->scan_version = sensor_snapshot_read(&s->scan);
+    renderer_get_profile(&s->display);
+    energy_get_status(&s->energy);
+    ai_telemetry_get(&s->inference);
+    s->latency_count = ai_telemetry_get_octaves(s->latency_octaves, &s->latency_sum_us);
+    latency_trace_get(&s->pipeline);
+    handshake_watch_get_stats(&s->handshakes);
+#if PROFILE_ENABLED
+    for (uint8_t site = 0; site < PROFILE_SITE_COUNT; site++) {
+        profile_get((profile_site_t)site, &s->profile[site]);
+    }
+#endif
+}
+
+/**
+ * @brief Write one group of metric families in OpenMetrics text
+ */
+size_t openmetrics_write_group(const openmetrics_snapshot_t* snapshot, uint8_t group,
+                               char* out, size_t capacity) {
+    if (group >= openmetrics_group_count() || capacity == 0) {
+        return 0;
+    }
+    om_writer_t writer = { out, capacity, 0 };
+    out[0] = '\0';
+    if (group < SYSTEM_GAUGES) {
+        write_system(snapshot, &writer, group);
+    } else if (group < SYSTEM_GAUGES + HEAP_FAMILIES) {
+        write_heap(snapshot, &writer, group - SYSTEM_GAUGES);
+    } else if (group < SYSTEM_GAUGES + HEAP_FAMILIES + PIPELINE_FAMILIES) {
+        write_pipeline(snapshot, &writer, group - SYSTEM_GAUGES - HEAP_FAMILIES);
+    } else {
+        groups[group - SYSTEM_GAUGES - HEAP_FAMILIES - PIPELINE_FAMILIES](snapshot, &writer);
+    }
+    return writer.len;
+}
+
+/**
+ * @brief Number of groups openmetrics_write_group() takes
+ */
+uint8_t openmetrics_group_count(void) {
+    return SYSTEM_GAUGES + HEAP_FAMILIES + PIPELINE_FAMILIES + sizeof(groups) / sizeof(groups[0]);
+}
+
+static void write_system(const openmetrics_snapshot_t* s, om_writer_t* w, uint8_t index) {
+    const system_gauge_t* gauge = &system_gauges[index];
+    const uint8_t* field = (const uint8_t*)&s->system + gauge->offset;
+    double value;
+    switch (gauge->type) {
+        case FIELD_U32:   value = *(const uint32_t*)field; break;
+        case FIELD_U16:   value = *(const uint16_t*)field; break;
+        case FIELD_FLOAT: value = *(const float*)field; break;
+        default:          value = *field; break;
+    }
+    family(w, gauge->name, "gauge", gauge->help);
+    put(w, "%s %.10g\n", gauge->name, value * gauge->scale);
+}
+
+static void write_heap(const openmetrics_snapshot_t* s, om_writer_t* w, uint8_t f) {
+    static const char* const names[HEAP_FAMILIES] = {
+        "hydra_heap_region_free_bytes", "hydra_heap_region_largest_free_bytes",
+        "hydra_heap_region_min_free_bytes", "hydra_heap_region_fragmentation_percent"
+    };
+    static const char* const helps[HEAP_FAMILIES] = {
+        "Free memory in a capability class", "Largest block that could be allocated",
+        "Least free memory since boot", "Free memory outside the largest block"
+    };
+    family(w, names[f], "gauge", helps[f]);
+    for (uint8_t r = 0; r < HEAP_REGION_COUNT; r++) {
+        const heap_region_stats_t* region = &s->heap[r];
+        uint32_t value = f == 0 ? region->total_free : f == 1 ? region->largest_free :
+                         f == 2 ? region->min_free : region->frag_pct;
+        put(w, "%s{region=\"%s\"} %lu\n", names[f],
+            heap_monitor_region_name((heap_region_t)r), value);
+    }
+}
+
+static void write_pipeline(const openmetrics_snapshot_t* s, om_writer_t* w, uint8_t stage) {
+    static const char* const helps[PIPELINE_FAMILIES] = {
+        "Device heard on air to folded into the device table",
+        "Folded to the scan cycle's features published",
+        "Features published to the AI decision",
+        "Decision to the new state published",
+        "State published to the UI showing it",
+        "State shown to its frame flushed",
+        "Device heard on air to the face's frame flushed"
+    };
+    const latency_stage_stats_t* figures = &s->pipeline.stages[stage];
+    const char* name = latency_stage_name((latency_stage_t)stage);
+    char family_name[48];
+    snprintf(family_name, sizeof(family_name), "hydra_pipeline_%s_seconds", name);
+    family(w, family_name, "histogram", helps[stage]);
+    for (uint8_t i = 0; i < LATENCY_TRACE_OCTAVES; i++) {
+        put(w, "%s_bucket{le=\"%s\"} %lu\n", family_name, pipeline_le[i], figures->cumulative[i]);
+    }
+    put(w, "%s_bucket{le=\"+Inf\"} %lu\n%s_count %lu\n%s_sum %.6f\n",
+        family_name, figures->count, family_name, figures->count, family_name, figures->sum_us / 1e6);
+}
+
+static void write_cpu(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    family(w, "hydra_cpu_core_busy_percent", "gauge", "Time not spent in the core's idle task");
+    for (uint8_t core = 0; core < CPU_LOAD_CORES; core++) {
+        put(w, "hydra_cpu_core_busy_percent{core=\"%u\"} %.1f\n", core, s->cpu.core_pct[core]);
+    }
+    family(w, "hydra_task_cpu_percent", "gauge", "Share of one core a task used over the last interval");
+    for (uint8_t i = 0; i < s->cpu.task_count; i++) {
+        put(w, "hydra_task_cpu_percent{task=\"%s\"} %.1f\n", s->cpu.tasks[i].name,
+            s->cpu.tasks[i].busy_pct);
+    }
+}
+
+static void write_stacks(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    family(w, "hydra_task_stack_bytes", "gauge", "Stack a task was created with");
+    for (uint8_t i = 0; i < s->task_count; i++) {
+        put(w, "hydra_task_stack_bytes{task=\"%s\"} %lu\n", s->tasks[i].name, s->tasks[i].stack_bytes);
+    }
+    family(w, "hydra_task_stack_min_free_bytes", "gauge", "Least stack headroom a task ever had");
+    for (uint8_t i = 0; i < s->task_count; i++) {
+        put(w, "hydra_task_stack_min_free_bytes{task=\"%s\"} %lu\n", s->tasks[i].name,
+            s->tasks[i].stack_min_free);
+    }
+}
+
+static void write_scan(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    if (s->scan_version == 0) {
+        return;
+    }
+    const sensor_data_t* d = &s->scan;
+    family(w, "hydra_scan_cycles", "counter", "Scan cycles published");
+    put(w, "hydra_scan_cycles_total %lu\n", s->scan_version);
+    family(w, "hydra_scan_devices", "gauge", "Devices seen in the last scan cycle");
+    put(w, "hydra_scan_devices{kind=\"wifi\"} %u\nhydra_scan_devices{kind=\"ble\"} %u\n",
+        d->wifi_networks_count, d->ble_devices_count);
+    family(w, "hydra_scan_signal_dbm", "gauge", "Mean RSSI in the last scan cycle");
+    put(w, "hydra_scan_signal_dbm{kind=\"wifi\"} %d\nhydra_scan_signal_dbm{kind=\"ble\"} %d\n",
+        d->wifi_signal_strength, d->ble_signal_strength);
+    family(w, "hydra_scan_device_changes", "gauge", "Device table changes in the last scan cycle");
+    put(w, "hydra_scan_device_changes{change=\"appeared\"} %u\n"
+           "hydra_scan_device_changes{change=\"lost\"} %u\n"
+           "hydra_scan_device_changes{change=\"moved\"} %u\n",
+        d->devices_appeared, d->devices_lost, d->devices_moved);
+    family(w, "hydra_wifi_clients", "gauge", "Estimated unique stations per minute");
+    put(w, "hydra_wifi_clients %u\n", d->wifi_clients_count);
+    family(w, "hydra_capture_frames_per_second", "gauge", "Promiscuous frames per second");
+    put(w, "hydra_capture_frames_per_second %u\n", d->capture_frames_per_second);
+    family(w, "hydra_airtime_ratio", "gauge", "Rolling share of listening time the air was busy");
+    put(w, "hydra_airtime_ratio{channel=\"all\"} %.3f\n", d->airtime_permille / 1000.0);
+    if (d->busiest_airtime_channel != 0) {
+        put(w, "hydra_airtime_ratio{channel=\"%u\"} %.3f\n", d->busiest_airtime_channel,
+            d->busiest_airtime_permille / 1000.0);
+    }
+}
+
+static void write_loop_times(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    family(w, "hydra_loop_exec_seconds", "gauge", "Time a task loop's body takes, EWMA");
+    for (uint8_t id = 0; id < LOOP_COUNT; id++) {
+        put(w, "hydra_loop_exec_seconds{loop=\"%s\"} %.6f\n", loop_names[id],
+            s->loops[id].avg_exec_us / 1e6);
+    }
+    family(w, "hydra_loop_exec_max_seconds", "gauge", "Longest a task loop's body has taken");
+    for (uint8_t id = 0; id < LOOP_COUNT; id++) {
+        put(w, "hydra_loop_exec_max_seconds{loop=\"%s\"} %.6f\n", loop_names[id],
+            s->loops[id].max_exec_us / 1e6);
+    }
+}
+
+static void write_loop_counts(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    family(w, "hydra_loop_runs", "counter", "Task loop iterations");
+    for (uint8_t id = 0; id < LOOP_COUNT; id++) {
+        put(w, "hydra_loop_runs_total{loop=\"%s\"} %lu\n", loop_names[id], s->loops[id].loops);
+    }
+    family(w, "hydra_loop_misses", "counter", "Iterations that overran their period");
+    for (uint8_t id = 0; id < LOOP_COUNT; id++) {
+        put(w, "hydra_loop_misses_total{loop=\"%s\"} %lu\n", loop_names[id], s->loops[id].misses);
+    }
+}
+
+static void write_latency(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    family(w, "hydra_inference_latency_seconds", "histogram", "Time from feature vector to proposed state");
+    for (uint8_t i = 0; i < AI_TELEMETRY_OCTAVES; i++) {
+        put(w, "hydra_inference_latency_seconds_bucket{le=\"%s\"} %lu\n", latency_le[i],
+            s->latency_octaves[i]);
+    }
+    put(w, "hydra_inference_latency_seconds_bucket{le=\"+Inf\"} %lu\n"
+           "hydra_inference_latency_seconds_count %lu\n"
+           "hydra_inference_latency_seconds_sum %.6f\n",
+        s->latency_count, s->latency_count, s->latency_sum_us / 1e6);
+}
+
+static void write_decisions(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    family(w, "hydra_inference_decisions", "counter", "Decisions, by who made them");
+    put(w, "hydra_inference_decisions_total{by=\"model\"} %lu\n"
+           "hydra_inference_decisions_total{by=\"rules\"} %lu\n",
+        s->inference.model_decisions, s->inference.rule_decisions);
+    family(w, "hydra_inference_narrow_margins", "counter", "Model outputs whose top two classes nearly tied");
+    put(w, "hydra_inference_narrow_margins_total %lu\n", s->inference.narrow_margins);
+}
+
+static void write_display(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    const renderer_profile_t* d = &s->display;
+    family(w, "hydra_display_refreshes", "counter", "LVGL refreshes that drew something");
+    put(w, "hydra_display_refreshes_total %lu\n", d->refreshes);
+    family(w, "hydra_display_frames_dropped", "counter", "Frames skipped by the renderer");
+    put(w, "hydra_display_frames_dropped_total %lu\n", d->frames_dropped);
+    family(w, "hydra_display_phase_seconds", "counter", "Time spent per refresh phase");
+    put(w, "hydra_display_phase_seconds_total{phase=\"render\"} %.6f\n"
+           "hydra_display_phase_seconds_total{phase=\"flush\"} %.6f\n",
+        d->render_total_us / 1e6, d->flush_total_us / 1e6);
+    family(w, "hydra_display_frame_seconds", "gauge", "Last refresh, render and flush");
+    put(w, "hydra_display_frame_seconds %.6f\n", d->refresh_us / 1e6);
+    family(w, "hydra_display_frame_max_seconds", "gauge", "Longest refresh");
+    put(w, "hydra_display_frame_max_seconds %.6f\n", d->refresh_max_us / 1e6);
+    family(w, "hydra_display_flushed_bytes", "counter", "Bytes sent to the panel");
+    put(w, "hydra_display_flushed_bytes_total %llu\n", d->bytes_flushed);
+}
+
+static void write_energy(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    const energy_status_t* e = &s->energy;
+    family(w, "hydra_energy_charge_milliampere_hours", "counter", "Charge drawn by a subsystem, modelled");
+    for (uint8_t load = 0; load < ENERGY_LOAD_COUNT; load++) {
+        put(w, "hydra_energy_charge_milliampere_hours_total{load=\"%s\"} %.4f\n",
+            energy_load_name((energy_load_t)load), e->loads[load].mah);
+    }
+    family(w, "hydra_energy_current_milliamperes", "gauge", "Current a subsystem draws now, modelled");
+    for (uint8_t load = 0; load < ENERGY_LOAD_COUNT; load++) {
+        put(w, "hydra_energy_current_milliamperes{load=\"%s\"} %.1f\n",
+            energy_load_name((energy_load_t)load), e->loads[load].ma);
+    }
+    family(w, "hydra_energy_average_milliamperes", "gauge", "Average current, calibrated if an INA219 is fitted");
+    put(w, "hydra_energy_average_milliamperes %.1f\n", e->avg_ma);
+    family(w, "hydra_battery_runtime_hours", "gauge", "Runtime of a full battery at the average current");
+    put(w, "hydra_battery_runtime_hours %.2f\n", e->runtime_h);
+}
+
+static void write_environment(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    const sensor_data_t* d = &s->scan;
+    if (d->i2c_fresh & (1 << I2C_SENSOR_CLIMATE)) {
+        family(w, "hydra_ambient_temperature_celsius", "gauge", "Air temperature, SHT3x");
+        put(w, "hydra_ambient_temperature_celsius %.1f\n", d->temperature_c10 / 10.0);
+        family(w, "hydra_ambient_humidity_ratio", "gauge", "Relative humidity, SHT3x");
+        put(w, "hydra_ambient_humidity_ratio %.3f\n", d->humidity_permille / 1000.0);
+    }
+    if (d->i2c_fresh & (1 << I2C_SENSOR_LIGHT)) {
+        family(w, "hydra_ambient_light_lux", "gauge", "Ambient light, BH1750");
+        put(w, "hydra_ambient_light_lux %u\n", d->light_lux);
+    }
+    if (d->i2c_fresh & (1 << I2C_SENSOR_MOTION)) {
+        family(w, "hydra_motion_milli_g", "gauge", "Acceleration beyond gravity, LIS3DH");
+        put(w, "hydra_motion_milli_g %u\n", d->motion_mg);
+    }
+    if (d->i2c_fresh & (1 << I2C_SENSOR_BATTERY)) {
+        family(w, "hydra_battery_charge_ratio", "gauge", "State of charge, MAX17048 fuel gauge");
+        put(w, "hydra_battery_charge_ratio %.2f\n", d->battery_pct / 100.0);
+    }
+}
+
+static void write_handshakes(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    if (!HANDSHAKE_WATCH_ENABLED) {
+        return;
+    }
+    family(w, "hydra_wifi_join_events", "counter", "Association requests, EAPOL frames and the handshakes they make up");
+    for (uint8_t counter = 0; counter < HANDSHAKE_COUNTER_COUNT; counter++) {
+        put(w, "hydra_wifi_join_events_total{kind=\"%s\"} %lu\n",
+            handshake_counter_name((handshake_counter_t)counter), s->handshakes.total[counter]);
+    }
+    family(w, "hydra_wifi_join_bssids", "gauge", "Access points with joins or EAPOL frames in the last minute");
+    put(w, "hydra_wifi_join_bssids %u\n", s->handshakes.bssids);
+}
+
+#if PROFILE_ENABLED
+static void write_profile_counts(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    family(w, "hydra_profile_calls", "counter", "Passes through an instrumented site");
+    for (uint8_t site = 0; site < PROFILE_SITE_COUNT; site++) {
+        put(w, "hydra_profile_calls_total{site=\"%s\"} %lu\n", s->profile[site].name,
+            s->profile[site].calls);
+    }
+    family(w, "hydra_profile_cycles", "counter", "CPU cycles spent inside an instrumented site");
+    for (uint8_t site = 0; site < PROFILE_SITE_COUNT; site++) {
+        put(w, "hydra_profile_cycles_total{site=\"%s\"} %llu\n", s->profile[site].name,
+            s->profile[site].cycles);
+    }
+}
+
+static void write_profile_max(const openmetrics_snapshot_t* s, om_writer_t* w) {
+    family(w, "hydra_profile_max_cycles", "gauge", "Longest single pass through an instrumented site");
+    for (uint8_t site = 0; site < PROFILE_SITE_COUNT; site++) {
+        put(w, "hydra_profile_max_cycles{site=\"%s\"} %lu\n", s->profile[site].name,
+            s->profile[site].max_cycles);
+    }
+}
+#endif
+
+/**
+ * @brief Append formatted text, or nothing if it does not all fit
+ */
+static void put(om_writer_t* w, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(w->out + w->len, w->capacity - w->len, format, args);
+    va_end(args);
+    if (n > 0 && (size_t)n < w->capacity - w->len) {
+        w->len += n;
+    } else {
+        w->out[w->len] = '\0';        // Drop the line rather than send half of it
+    }
+}
+
+/**
+ * @brief Start a metric family
+ */
+static void family(om_writer_t* w, const char* name, const char* type, const char* help) {
+    put(w, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
@@ -0,0 +1,372 @@
+/**
+ * @file provisioning.cpp
+ * @brief SoftAP captive portal for uplink credentials and tunables
+ *
+ * The web server already runs on every interface, so the portal is only
+ * its routes plus the SoftAP and a DNS server that answers every name
+ * with the SoftAP's address. Requests are handled on the async TCP task:
+ * tunables are set there, as on TUNABLES_PATH, while credentials are
+ * handed to the system task, which writes the journal (its stack is in
+ * internal RAM, as a journal write needs) and moves the link.
+ *
+ * The passphrase is eight random digits, drawn from the hardware RNG each
+ * time the portal opens and forgotten when it closes.
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <DNSServer.h>
+#include <Preferences.h>
+#include <esp_system.h>
+#include "config.h"
+#include "provisioning.h"
+#include "journal.h"
+#include "tunables.h"
+#include "wifi_link.h"
+#include "live_feed.h"
+#include "ui_events.h"
+#include "logger.h"
+
+#define PROVISION_MAGIC         0x50525631  // "PRV1"
+#define PROVISION_VERSION       1
+#define PROVISION_JOURNAL_KEY   "prov"
+#define PROVISION_DNS_PORT      53
+#define PROVISION_DNS_BURST     8           // Queries answered per tick
+
+/**
+ * @brief Stored credentials (journal value, NVS blob without a journal)
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    char     ssid[WIFI_LINK_SSID_BYTES];
+    char     password[WIFI_LINK_PASSWORD_BYTES];
+} provision_record_t;
+
+static_assert(sizeof(provision_record_t) <= JOURNAL_VALUE_MAX, "credentials too big for a journal value");
+static_assert(!PROVISION_ENABLED || LIVE_FEED_ENABLED, "the SoftAP key is only shown on the event ticker");
+
+/**
+ * @brief Sends every SoftAP request no route matched to the form
+ */
+class CaptiveHandler : public AsyncWebHandler {
+public:
+    bool canHandle(AsyncWebServerRequest* request) override;
+    void handleRequest(AsyncWebServerRequest* request) override;
+};
+
+static DNSServer dns;
+static provision_status_t status;
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+static char ap_ssid[WIFI_LINK_SSID_BYTES];
+static char ap_password[9];
+
+// Set from any task, taken by the system task
+static volatile bool open_requested = false;
+static volatile bool portal_open = false;
+static volatile uint32_t last_request_ms = 0;
+static volatile bool credentials_pending = false;
+static provision_record_t pending;
+
+// Forward declarations
+static void open_portal(uint32_t now_ms);
+static void close_portal(void);
+static void commit_credentials(void);
+static bool load_record(provision_record_t* record);
+static void on_form(AsyncWebServerRequest* request);
+static void on_submit(AsyncWebServerRequest* request);
+
+/**
+ * @brief Restore provisioned uplink credentials
+ */
+void provisioning_init(void) {
+    memset(&status, 0, sizeof(status));
+    provision_record_t record;
+    if (!load_record(&record)) {
+        return;
+    }
+    wifi_link_set_credentials(record.ssid, record.password);
+    status.stored = true;
+    LOGI(SYSTEM, "✅ Provisioned uplink '%s' restored", record.ssid);
+}
+
+/**
+ * @brief Add the portal routes and the captive handler to the web server
+ */
+void provisioning_register(AsyncWebServer* server) {
+    server->on(PROVISION_PATH, HTTP_GET, on_form).setFilter(ON_AP_FILTER);
+    server->on(PROVISION_PATH, HTTP_POST, on_submit).setFilter(ON_AP_FILTER);
+    server->addHandler(new CaptiveHandler()).setFilter(ON_AP_FILTER);
+}
+
+/**
+ * @brief Ask for the portal to open
+ */
+void provisioning_request_open(void) {
+    open_requested = true;
+}
+
+/**
+ * @brief Open and close the SoftAP, answer DNS, commit credentials
+ */
+void provisioning_tick(uint32_t now_ms) {
+    if (open_requested) {
+        open_requested = false;
+        if (!portal_open) {
+            open_portal(now_ms);
+        }
+        last_request_ms = now_ms;   // Another long press keeps it open
+    }
+    if (credentials_pending) {
+        commit_credentials();
+    }
+    if (!portal_open) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < PROVISION_DNS_BURST; i++) {
+        dns.processNextRequest();
+    }
+    if (now_ms - last_request_ms >= PROVISION_IDLE_MS) {
+        close_portal();
+    }
+}
+
+/**
+ * @brief Copy the provisioning figures
+ */
+void provisioning_get_status(provision_status_t* out) {
+    portENTER_CRITICAL(&status_mux);
+    *out = status;
+    portEXIT_CRITICAL(&status_mux);
+    out->open = portal_open;
+    out->clients = portal_open ? WiFi.softAPgetStationNum() : 0;
+}
+
+/**
+ * @brief Bring up the SoftAP on the channel the radio is held on
+ */
+static void open_portal(uint32_t now_ms) {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(ap_ssid, sizeof(ap_ssid), "%s%02X%02X", PROVISION_AP_PREFIX, mac[4], mac[5]);
+    snprintf(ap_password, sizeof(ap_password), "%08lu", (unsigned long)(esp_random() % 100000000UL));
+
+    // An associated station pins the channel; otherwise the mesh's
+    uint8_t channel = wifi_link_home_channel();
+    if (channel == 0) {
+        channel = MESH_HOME_CHANNEL;
+    }
+    WiFi.mode(WIFI_AP_STA);
+    if (!WiFi.softAP(ap_ssid, ap_password, channel)) {
+        WiFi.mode(WIFI_STA);
+        LOGE(SYSTEM, "❌ Provisioning SoftAP failed to start");
+        return;
+    }
+    dns.setErrorReplyCode(DNSReplyCode::NoError);
+    dns.start(PROVISION_DNS_PORT, "*", WiFi.softAPIP());
+    portal_open = true;
+    portENTER_CRITICAL(&status_mux);
+    status.opened++;
+    portEXIT_CRITICAL(&status_mux);
+
+    // The key stays off the log: its tail is served over HTTP
+    LOGI(SYSTEM, "📶 Provisioning portal '%s' on channel %u, http://%s%s (key on the screen)",
+         ap_ssid, channel, WiFi.softAPIP().toString().c_str(), PROVISION_PATH);
+#if LIVE_FEED_ENABLED
+    live_feed_post(LIVE_FEED_NOTICE, now_ms, "Setup %s key %s", ap_ssid, ap_password);
+    ui_notify(UI_EVENT_FEED);
+#endif
+}
+
+/**
+ * @brief Take the SoftAP down and forget its passphrase
+ */
+static void close_portal(void) {
+    dns.stop();
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+    portal_open = false;
+    memset(ap_password, 0, sizeof(ap_password));
+    LOGI(SYSTEM, "📶 Provisioning portal closed");
+#if LIVE_FEED_ENABLED
+    live_feed_post(LIVE_FEED_NOTICE, millis(), "Setup closed");
+    ui_notify(UI_EVENT_FEED);
+#endif
+}
+
+/**
+ * @brief Store the submitted credentials and move the link to them
+ */
+static void commit_credentials(void) {
+    provision_record_t record;
+    portENTER_CRITICAL(&status_mux);
+    record = pending;
+    credentials_pending = false;
+    portEXIT_CRITICAL(&status_mux);
+
+    bool saved = journal_put(PROVISION_JOURNAL_KEY, &record, sizeof(record));
+    if (!saved) {
+        Preferences prefs;
+        saved = prefs.begin(PROVISION_NVS_NAMESPACE, false) &&
+                prefs.putBytes("record", &record, sizeof(record)) == sizeof(record);
+        prefs.end();
+    }
+    if (!saved) {
+        LOGE(SYSTEM, "❌ Provisioned credentials not saved");
+        return;
+    }
+
+    portENTER_CRITICAL(&status_mux);
+    status.stored = true;
+    status.credential_saves++;
+    portEXIT_CRITICAL(&status_mux);
+#if WIFI_LINK_ENABLED
+    wifi_link_set_credentials(record.ssid, record.password);
+#else
+    LOGW(SYSTEM, "⚠️  Uplink '%s' saved; used once WIFI_LINK_ENABLED is set", record.ssid);
+#endif
+    memset(&record, 0, sizeof(record));
+}
+
+/**
+ * @brief Read the stored credentials: the journal's, else those in NVS
+ */
+static bool load_record(provision_record_t* record) {
+    bool found = journal_get(PROVISION_JOURNAL_KEY, record, sizeof(*record)) == sizeof(*record);
+    if (!found) {
+        Preferences prefs;
+        if (prefs.begin(PROVISION_NVS_NAMESPACE, true)) {
+            found = prefs.getBytes("record", record, sizeof(*record)) == sizeof(*record);
+            prefs.end();
+        }
+    }
+    return found && record->magic == PROVISION_MAGIC && record->version == PROVISION_VERSION &&
+           record->ssid[0] != '\0' &&
+           memchr(record->ssid, '\0', sizeof(record->ssid)) != NULL &&
+           memchr(record->password, '\0', sizeof(record->password)) != NULL;
+}
+
+/**
+ * @brief The form: uplink network, then every tunable with its bounds
+ */
+static void on_form(AsyncWebServerRequest* request) {
+    if (!portal_open) {
+        request->send(404);
+        return;
+    }
+    last_request_ms = millis();
+
+    static char page[2560];  // Handlers run one at a time on the async TCP task
+    int len = snprintf(page, sizeof(page),
+        "<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width'>"
+        "<title>HydraESP setup</title></head><body><h3>HydraESP setup</h3>"
+        "<form method='post'><fieldset><legend>Uplink</legend>"
+        "SSID <input name='ssid' maxlength='32'><br>"
+        "Passphrase <input name='password' type='password' maxlength='63'></fieldset>"
+        "<fieldset><legend>Tunables</legend>");
+    for (uint8_t id = 0; id < TUNABLE_COUNT && len < (int)sizeof(page); id++) {
+        tunable_info_t info;
+        tunable_get_info((tunable_id_t)id, &info);
+        len += snprintf(page + len, sizeof(page) - len,
+                        "%s <input name='%s' type='number' value='%ld' min='%ld' max='%ld'><br>",
+                        info.name, info.name, info.value, info.min, info.max);
+    }
+    if (len < (int)sizeof(page)) {
+        snprintf(page + len, sizeof(page) - len,
+                 "</fieldset><input type='submit' value='Apply'></form>"
+                 "<p>Leave the SSID empty to keep the current network.</p></body></html>");
+    }
+    request->send(200, "text/html", page);
+}
+
+/**
+ * @brief Apply a submitted form: ssid= and password=, and name=value per tunable
+ */
+static void on_submit(AsyncWebServerRequest* request) {
+    if (!portal_open) {
+        request->send(404);
+        return;
+    }
+    last_request_ms = millis();
+
+    char reply[512];
+    int len = 0;
+    uint32_t sets = 0;
+    uint32_t rejected = 0;
+
+    if (request->hasParam("ssid", true) && request->getParam("ssid", true)->value().length() > 0) {
+        const String& ssid = request->getParam("ssid", true)->value();
+        String password = request->hasParam("password", true) ?
+                          request->getParam("password", true)->value() : String();
+        // WPA2 passphrases are 8-63 characters; empty is an open network
+        bool valid = ssid.length() < WIFI_LINK_SSID_BYTES &&
+                     (password.length() == 0 ||
+                      (password.length() >= 8 && password.length() < WIFI_LINK_PASSWORD_BYTES));
+        if (valid) {
+            portENTER_CRITICAL(&status_mux);
+            memset(&pending, 0, sizeof(pending));
+            pending.magic = PROVISION_MAGIC;
+            pending.version = PROVISION_VERSION;
+            strlcpy(pending.ssid, ssid.c_str(), sizeof(pending.ssid));
+            strlcpy(pending.password, password.c_str(), sizeof(pending.password));
+            credentials_pending = true;
+            portEXIT_CRITICAL(&status_mux);
+            len += snprintf(reply + len, sizeof(reply) - len, "uplink: joining %s\n", ssid.c_str());
+        } else {
+            rejected++;
+            len += snprintf(reply + len, sizeof(reply) - len, "uplink: bad SSID or passphrase length\n");
+        }
+    }
+
+    // Only values that differ from the current ones, so the untouched
+    // fields of the form cost no NVS writes
+    for (uint8_t id = 0; id < TUNABLE_COUNT; id++) {
+        tunable_info_t info;
+        tunable_get_info((tunable_id_t)id, &info);
+        if (!request->hasParam(info.name, true)) {
+            continue;
+        }
+        const char* text = request->getParam(info.name, true)->value().c_str();
+        char* end;
+        long value = strtol(text, &end, 10);
+        if (end != text && *end == '\0' && value == info.value) {
+            continue;
+        }
+        if (end == text || *end != '\0' || !tunable_set((tunable_id_t)id, (int32_t)value)) {
+            rejected++;
+            len += snprintf(reply + len, sizeof(reply) - len, "%s: out of bounds or order\n", info.name);
+        } else {
+            sets++;
+            len += snprintf(reply + len, sizeof(reply) - len, "%s: %ld\n", info.name, value);
+        }
+        if (len >= (int)sizeof(reply)) {
+            len = sizeof(reply) - 1;
+        }
+    }
+
+    portENTER_CRITICAL(&status_mux);
+    status.tunable_sets += sets;
+    status.rejected += rejected;
+    portEXIT_CRITICAL(&status_mux);
+    if (len == 0) {
+        snprintf(reply, sizeof(reply), "nothing changed\n");
+    }
+    request->send(rejected > 0 ? 400 : 200, "text/plain", reply);
+}
+
+/**
+ * @brief Every SoftAP request while the portal is open
+ */
+bool CaptiveHandler::canHandle(AsyncWebServerRequest* request) {
+    return portal_open;
+}
+
+/**
+ * @brief Send phones' connectivity checks and stray pages to the form
+ */
+void CaptiveHandler::handleRequest(AsyncWebServerRequest* request) {
+    last_request_ms = millis();
+    request->redirect(String("http://") + WiFi.softAPIP().toString() + PROVISION_PATH);
+}
@@ -0,0 +1,277 @@
+/**
+ * @file time_sync.cpp
+ * @brief Cached wall-clock offset over esp_timer, set by SNTP, peers or the RTC
+ *
+ * The offset is 64 bits, which the S3 cannot load in one access, so it sits
+ * behind a sequence counter: the writer makes the count odd, stores, and
+ * makes it even again, and a reader retries if the count was odd or moved
+ * while it read. Writes happen a few times an hour, so a reader all but
+ * never retries, and never blocks.
+ *
+ * Strata are NTP's: the server's clock is stratum 0, so ours is 1 after
+ * SNTP. A peer's clock is taken only at a lower stratum than our own (or
+ * the same, from a peer, after TIME_SYNC_PEER_REFRESH_MS), so time flows
+ * outward from the nodes with an uplink and never in a loop. A clock the
+ * RTC kept through a sleep goes up one stratum per boot, and one from a
+ * peer with an uplink soon replaces it.
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+#include <time.h>
+#include "config.h"
+#include "time_sync.h"
+#include "wifi_link.h"
+#include "scan_log.h"
+#include "logger.h"
+
+#define TIME_SYNC_MAGIC         0x54494D45u     // "TIME"
+
+/**
+ * @brief Kept in RTC memory across deep sleep and soft resets
+ */
+typedef struct {
+    uint32_t magic;
+    uint8_t  stratum;
+    uint8_t  source;
+    uint16_t reserved;
+} time_sync_rtc_t;
+
+RTC_NOINIT_ATTR static time_sync_rtc_t rtc_state;
+
+static const char* const source_names[TIME_SOURCES] = { "none", "rtc", "peer", "sntp" };
+
+// Wall clock minus esp_timer, behind the sequence counter
+static volatile uint32_t offset_seq = 0;
+static volatile int64_t offset_us = 0;
+static volatile uint8_t stratum = 0;
+static portMUX_TYPE offset_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static time_sync_status_t status;
+static bool anchor_pending = false;
+
+// Written from the lwIP task by the SNTP callback
+static volatile bool sntp_pending = false;
+static volatile int64_t sntp_offset_us = 0;
+
+// Forward declarations
+static void apply(int64_t offset, time_source_t source, uint8_t new_stratum, bool set_system);
+static void on_sntp_sync(struct timeval* tv);
+static void write_anchor(void);
+
+/**
+ * @brief Set the time zone and take over a clock the RTC kept
+ */
+void time_sync_init(void) {
+    memset(&status, 0, sizeof(status));
+    setenv("TZ", TIME_SYNC_TZ, 1);
+    tzset();
+
+    // The system clock runs on through deep sleep and survives a soft
+    // reset, but not a power cycle; a plausible date is one that was kept
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec > AI_FEATURE_MIN_EPOCH) {
+        bool known = rtc_state.magic == TIME_SYNC_MAGIC && rtc_state.stratum > 0;
+        uint8_t kept = known ? min(rtc_state.stratum + 1, TIME_SYNC_MAX_STRATUM) : TIME_SYNC_MAX_STRATUM;
+        int64_t wall = (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+        apply(wall - esp_timer_get_time(), TIME_SOURCE_RTC, kept, false);
+    } else {
+        LOGI(SYSTEM, "🕒 Wall clock unset until SNTP or a peer answers");
+    }
+}
+
+/**
+ * @brief Start SNTP once the uplink is up and apply its updates
+ */
+void time_sync_tick(uint32_t now_ms) {
+#if WIFI_LINK_ENABLED
+    if (!status.sntp_running && wifi_link_associated()) {
+        // lwIP keeps polling from here on, through link losses
+        sntp_set_time_sync_notification_cb(on_sntp_sync);
+        sntp_set_sync_interval(TIME_SYNC_SNTP_INTERVAL_MS);
+        configTzTime(TIME_SYNC_TZ, TIME_SYNC_NTP_SERVER, TIME_SYNC_NTP_SERVER_2);
+        status.sntp_running = true;
+        LOGI(SYSTEM, "🕒 SNTP started with %s", TIME_SYNC_NTP_SERVER);
+    }
+    if (sntp_pending) {
+        portENTER_CRITICAL(&offset_mux);
+        int64_t offset = sntp_offset_us;
+        sntp_pending = false;
+        portEXIT_CRITICAL(&offset_mux);
+        // lwIP has set the system clock already
+        apply(offset, TIME_SOURCE_SNTP, 1, false);
+    }
+#endif
+    if (anchor_pending) {
+        anchor_pending = false;
+        write_anchor();
+    }
+}
+
+/**
+ * @brief Consider a mesh peer's wall clock
+ */
+bool time_sync_offer_peer(uint8_t peer_stratum, uint64_t wall_ms, int64_t local_us) {
+    if (peer_stratum == 0 || peer_stratum >= TIME_SYNC_MAX_STRATUM) {
+        return false;
+    }
+    uint8_t offered = peer_stratum + 1;
+    uint8_t own = stratum;
+    bool better = own == 0 || offered < own;
+    bool refresh = offered == own && status.source == TIME_SOURCE_PEER &&
+                   millis() - status.synced_ms >= TIME_SYNC_PEER_REFRESH_MS;
+    if (!better && !refresh) {
+        return false;
+    }
+    apply((int64_t)wall_ms * 1000LL - local_us, TIME_SOURCE_PEER, offered, true);
+    return true;
+}
+
+/**
+ * @brief Microseconds since boot, never going back
+ */
+int64_t time_sync_mono_us(void) {
+    return esp_timer_get_time();
+}
+
+/**
+ * @brief Microseconds since the epoch
+ */
+bool time_sync_wall_us(int64_t* wall_us) {
+    uint32_t seq;
+    int64_t offset;
+    do {
+        seq = offset_seq;
+        offset = offset_us;
+    } while ((seq & 1) || seq != offset_seq);
+
+    if (seq == 0) {
+        return false;
+    }
+    if (wall_us != NULL) {
+        *wall_us = esp_timer_get_time() + offset;
+    }
+    return true;
+}
+
+/**
+ * @brief Wall clock of an uptime stamp
+ */
+uint64_t time_sync_wall_ms_at(uint32_t uptime_ms) {
+    int64_t wall_us;
+    if (!time_sync_wall_us(&wall_us)) {
+        return 0;
+    }
+    // The stamp wrapped with millis(), so measure back from now
+    uint32_t ago_ms = (uint32_t)(esp_timer_get_time() / 1000) - uptime_ms;
+    return (uint64_t)(wall_us / 1000) - ago_ms;
+}
+
+/**
+ * @brief Stratum to advertise to peers, 0 while unset
+ */
+uint8_t time_sync_stratum(void) {
+    return stratum;
+}
+
+/**
+ * @brief Copy the service status
+ */
+void time_sync_get_status(time_sync_status_t* out) {
+    if (out == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&offset_mux);
+    *out = status;
+    portEXIT_CRITICAL(&offset_mux);
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* time_source_name(time_source_t source) {
+    return source < TIME_SOURCES ? source_names[source] : "?";
+}
+
+/**
+ * @brief Install a new offset and record where it came from
+ * @param set_system Also step the system clock, for time() and localtime()
+ */
+static void apply(int64_t offset, time_source_t source, uint8_t new_stratum, bool set_system) {
+    portENTER_CRITICAL(&offset_mux);
+    bool had = offset_seq != 0;
+    int64_t step_us = had ? offset - offset_us : 0;
+    offset_seq++;
+    offset_us = offset;
+    offset_seq++;
+    stratum = new_stratum;
+    status.source = source;
+    status.stratum = new_stratum;
+    status.synced_ms = millis();
+    status.last_step_ms = (int32_t)constrain(step_us / 1000, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+    if (source == TIME_SOURCE_SNTP) {
+        status.sntp_syncs++;
+    } else if (source == TIME_SOURCE_PEER) {
+        status.peer_syncs++;
+    }
+    portEXIT_CRITICAL(&offset_mux);
+
+    if (set_system) {
+        int64_t wall = esp_timer_get_time() + offset;
+        struct timeval tv = { (time_t)(wall / 1000000), (suseconds_t)(wall % 1000000) };
+        settimeofday(&tv, NULL);
+    }
+    rtc_state.magic = TIME_SYNC_MAGIC;
+    rtc_state.stratum = new_stratum;
+    rtc_state.source = source;
+
+    // Small corrections are routine; steps and first syncs get a new anchor
+    if (!had || source != TIME_SOURCE_PEER || llabs(step_us) >= TIME_SYNC_ANCHOR_STEP_MS * 1000LL) {
+        anchor_pending = true;
+    }
+}
+
+/**
+ * @brief SNTP has set the system clock (lwIP task)
+ */
+static void on_sntp_sync(struct timeval* tv) {
+    int64_t wall = (int64_t)tv->tv_sec * 1000000LL + tv->tv_usec;
+    portENTER_CRITICAL(&offset_mux);
+    sntp_offset_us = wall - esp_timer_get_time();
+    sntp_pending = true;
+    portEXIT_CRITICAL(&offset_mux);
+}
+
+/**
+ * @brief Pair this uptime with the wall clock in the logs
+ */
+static void write_anchor(void) {
+    int64_t wall_us;
+    if (!time_sync_wall_us(&wall_us)) {
+        return;
+    }
+    time_t seconds = (time_t)(wall_us / 1000000);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    char stamp[24];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+    uint32_t now_ms = millis();
+    LOGI(SYSTEM, "🕒 Clock from %s (stratum %u, step %ld ms): uptime %lu.%03lu = %s.%03luZ",
+         source_names[status.source], status.stratum, status.last_step_ms,
+         now_ms / 1000, now_ms % 1000, stamp, (uint32_t)(wall_us / 1000 % 1000));
+
+#if SCAN_LOG_ENABLED
+    scan_log_clock_t record;
+    memset(&record, 0, sizeof(record));
+    record.epoch_s = (uint32_t)seconds;
+    record.epoch_ms = (uint16_t)(wall_us / 1000 % 1000);
+    record.source = status.source;
+    record.stratum = status.stratum;
+    record.step_ms = status.last_step_ms;
+    scan_log_append(SCAN_LOG_CLOCK, &record, sizeof(record), true);
+#endif
+}
@@ -0,0 +1,119 @@
+/**
+ * @file web_assets.cpp
+ * @brief Dashboard files served from the mapped asset partition
+ *
+ * The files are packed into the asset partition gzip-compressed (see
+ * tools/assets/pack_assets.py --web), so a request never touches a file
+ * system or a compressor: the name is looked up in the table read at
+ * boot and the body goes to the TCP stack straight from the flash cache,
+ * with the stored CRC-32 as its ETag. A browser that already holds the
+ * asset revalidates with If-None-Match and gets a 304 with no body.
+ *
+ * Every callback runs on the async TCP task, so the figures need no lock.
+ */
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "asset_store.h"
+#include "web_assets.h"
+
+// Content-Type per asset_mime_t
+static const char* const mime_types[ASSET_MIME_COUNT] = {
+    "application/octet-stream",
+    "text/html",
+    "text/css",
+    "application/javascript",
+    "application/json",
+    "image/svg+xml",
+    "image/png",
+    "image/x-icon"
+};
+
+static web_assets_stats_t stats = {0};
+
+// Forward declarations
+static void on_asset(AsyncWebServerRequest* request);
+static void on_root(AsyncWebServerRequest* request);
+
+/**
+ * @brief Add the asset route and the redirect from "/"
+ */
+bool web_assets_register(AsyncWebServer* server) {
+    asset_store_stats_t store;
+    asset_store_get_stats(&store);
+    if (!store.mapped) {
+        return false;
+    }
+
+    // Matches the prefix itself and everything below it
+    server->on(WEB_ASSETS_PREFIX, HTTP_GET, on_asset);
+    server->on("/", HTTP_GET, on_root);
+    return true;
+}
+
+/**
+ * @brief Copy the dashboard asset figures
+ */
+void web_assets_get_stats(web_assets_stats_t* out) {
+    *out = stats;
+}
+
+/**
+ * @brief Answer with the named asset, or 304 if the client's copy is current
+ */
+static void on_asset(AsyncWebServerRequest* request) {
+    const String& url = request->url();
+    const char* path = url.c_str() + strlen(WEB_ASSETS_PREFIX);
+    if (*path == '/') {
+        path++;
+    }
+
+    char name[ASSET_NAME_BYTES];
+    int length = snprintf(name, sizeof(name), "%s%s", path,
+                          (*path == '\0' || path[strlen(path) - 1] == '/') ? WEB_ASSETS_INDEX : "");
+
+    asset_t asset;
+    if (length >= (int)sizeof(name) || !asset_store_find(name, &asset) ||
+        asset.type != ASSET_TYPE_WEB) {
+        stats.missing++;
+        request->send(404, "text/plain", "no such asset");
+        return;
+    }
+
+    char etag[12];
+    snprintf(etag, sizeof(etag), "\"%08lx\"", asset.crc32);
+    char cache[32] = "no-cache";                        // Pages pick up a new image at once
+    if (asset.subtype != ASSET_MIME_HTML) {
+        snprintf(cache, sizeof(cache), "public, max-age=%lu", (unsigned long)WEB_ASSETS_MAX_AGE_S);
+    }
+
+    AsyncWebServerResponse* response;
+    if (request->hasHeader("If-None-Match") &&
+        strstr(request->header("If-None-Match").c_str(), etag) != NULL) {
+        stats.not_modified++;
+        response = request->beginResponse(304);
+    } else {
+        // Every browser offers gzip; a client that does not gets it anyway
+        if (!request->hasHeader("Accept-Encoding") ||
+            strstr(request->header("Accept-Encoding").c_str(), "gzip") == NULL) {
+            stats.unasked++;
+        }
+        stats.served++;
+        const char* type = asset.subtype < ASSET_MIME_COUNT ? mime_types[asset.subtype]
+                                                            : mime_types[ASSET_MIME_OTHER];
+        response = request->beginResponse_P(200, type, asset.data, asset.length);
+        response->addHeader("Content-Encoding", "gzip");
+    }
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", cache);
+    response->addHeader("Vary", "Accept-Encoding");
+    request->send(response);
+}
+
+/**
+ * @brief Send the bare address to the dashboard
+ */
+static void on_root(AsyncWebServerRequest* request) {
+    request->redirect(WEB_ASSETS_PREFIX "/");
+}
@@ -0,0 +1,277 @@
+/**
+ * @file wifi_link.cpp
+ * @brief Station association for the uplink, time-shared with scanning
+ *
+ * The scan task sweeps every channel, the capture hopper retunes the radio
+ * and the uplink needs it parked on its access point's channel. While the
+ * station is associated the hopper stays on the home channel, and each
+ * channel scan elsewhere asks here first: it waits until the radio has
+ * spent WIFI_LINK_HOME_DWELL_MS at home and no uplink reply is expected,
+ * and its dwell is cut to WIFI_LINK_OFF_CHANNEL_MS. The driver announces
+ * power save to the access point before it leaves, so frames for us are
+ * buffered there rather than lost, and the cap bounds how long they wait.
+ *
+ * Power save follows the AI state: states that expect activity wake for
+ * every DTIM beacon (WIFI_PS_MIN_MODEM), calm states sleep for the listen
+ * interval (WIFI_PS_MAX_MODEM). WIFI_PS_NONE is never used, since the
+ * BLE scan shares the radio and coexistence needs modem sleep.
+ *
+ * The network is WIFI_LINK_SSID unless credentials were provisioned, in
+ * which case those replace it at boot and, when they change, at once.
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include "config.h"
+#include "ai_states.h"
+#include "data_bus.h"
+#include "wifi_link.h"
+#include "logger.h"
+
+// Power save per AI state
+static const wifi_ps_type_t state_power_save[AI_STATE_COUNT] = {
+    WIFI_PS_MAX_MODEM,              // IDLE
+    WIFI_PS_MIN_MODEM,              // SNIFFING
+    WIFI_PS_MIN_MODEM,              // TRACKING
+    WIFI_PS_MAX_MODEM,              // LEARNING
+    WIFI_PS_MIN_MODEM,              // EXCITED
+    WIFI_PS_MAX_MODEM,              // SLEEPING
+    WIFI_PS_MIN_MODEM,              // ERROR
+    WIFI_PS_MIN_MODEM               // UPDATING
+};
+
+// Written from the WiFi event task
+static volatile bool associated = false;
+static volatile uint8_t home_channel = 0;
+static volatile bool lost = false;
+
+// Written from the uplink
+static volatile uint32_t traffic_until_ms = 0;
+
+// Scan task side
+static bool off_channel = false;
+static uint32_t off_started_ms = 0;
+static uint32_t returned_ms = 0;
+
+// System task side
+static char link_ssid[WIFI_LINK_SSID_BYTES] = WIFI_LINK_SSID;
+static char link_password[WIFI_LINK_PASSWORD_BYTES] = WIFI_LINK_PASSWORD;
+static bool joining = false;
+static uint32_t retry_at_ms = 0;
+static uint32_t retry_delay_ms = WIFI_LINK_RETRY_MIN_MS;
+static uint32_t applied_state_version = 0;
+static int8_t applied_power_save = -1;
+
+static wifi_link_stats_t stats = {0};
+static portMUX_TYPE link_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void on_got_ip(arduino_event_id_t event, arduino_event_info_t info);
+static void on_disconnected(arduino_event_id_t event, arduino_event_info_t info);
+static void apply_power_save(void);
+
+/**
+ * @brief Register the connection events and start joining
+ */
+bool wifi_link_init(void) {
+    if (WiFi.onEvent(on_got_ip, ARDUINO_EVENT_WIFI_STA_GOT_IP) == 0 ||
+        WiFi.onEvent(on_disconnected, ARDUINO_EVENT_WIFI_STA_DISCONNECTED) == 0) {
+        LOGE(SYSTEM, "❌ Failed to register WiFi link handlers");
+        return false;
+    }
+
+    // Retries are paced from wifi_link_tick(), not by the core
+    WiFi.setAutoReconnect(false);
+    WiFi.begin(link_ssid, link_password);
+    joining = true;
+    retry_at_ms = millis() + WIFI_LINK_RETRY_MIN_MS;
+    LOGI(SYSTEM, "✅ WiFi link joining '%s'", link_ssid);
+    return true;
+}
+
+/**
+ * @brief Use another network from now on
+ */
+void wifi_link_set_credentials(const char* ssid, const char* password) {
+    strlcpy(link_ssid, ssid, sizeof(link_ssid));
+    strlcpy(link_password, password, sizeof(link_password));
+    if (!joining) {
+        return;                     // wifi_link_init() picks them up
+    }
+
+    // Leave the old network and join the new one without the backoff
+    WiFi.disconnect(false);
+    WiFi.begin(link_ssid, link_password);
+    retry_delay_ms = WIFI_LINK_RETRY_MIN_MS;
+    retry_at_ms = millis() + retry_delay_ms;
+    LOGI(SYSTEM, "🔁 WiFi link switching to '%s'", link_ssid);
+}
+
+/**
+ * @brief Retry a lost association and set the power save mode of the AI state
+ */
+void wifi_link_tick(uint32_t now_ms) {
+    if (associated) {
+        retry_delay_ms = WIFI_LINK_RETRY_MIN_MS;
+        int8_t rssi = (int8_t)WiFi.RSSI();
+        portENTER_CRITICAL(&link_mux);
+        stats.rssi = rssi;
+        portEXIT_CRITICAL(&link_mux);
+        apply_power_save();
+        return;
+    }
+
+    if (lost) {
+        lost = false;
+        applied_power_save = -1;    // Set again on the next association
+        retry_at_ms = now_ms + retry_delay_ms;
+        LOGW(SYSTEM, "⚠️  WiFi link lost, rejoining in %lums", retry_delay_ms);
+    }
+    if ((int32_t)(now_ms - retry_at_ms) >= 0) {
+        WiFi.begin(link_ssid, link_password);
+        retry_delay_ms = min(retry_delay_ms * 2, (uint32_t)WIFI_LINK_RETRY_MAX_MS);
+        retry_at_ms = now_ms + retry_delay_ms;
+    }
+}
+
+/**
+ * @brief Whether the station is associated and has an address
+ */
+bool wifi_link_associated(void) {
+    return associated;
+}
+
+/**
+ * @brief Channel the association holds the radio on
+ */
+uint8_t wifi_link_home_channel(void) {
+    return associated ? home_channel : 0;
+}
+
+/**
+ * @brief Wait for a turn off the home channel, or give the channel up
+ */
+bool wifi_link_claim_radio(uint8_t channel, uint16_t* dwell_ms) {
+    if (!associated || channel == home_channel) {
+        return true;
+    }
+
+    uint32_t waited_ms = 0;
+    for (;;) {
+        uint32_t now = millis();
+        int32_t home_left = (int32_t)(returned_ms + WIFI_LINK_HOME_DWELL_MS - now);
+        int32_t traffic_left = (int32_t)(traffic_until_ms - now);
+        int32_t wait_ms = max(home_left, traffic_left);
+        if (wait_ms <= 0) {
+            break;
+        }
+        if (waited_ms + wait_ms > WIFI_LINK_MAX_WAIT_MS) {
+            portENTER_CRITICAL(&link_mux);
+            stats.scans_skipped++;
+            portEXIT_CRITICAL(&link_mux);
+            return false;
+        }
+        if (waited_ms == 0) {
+            portENTER_CRITICAL(&link_mux);
+            stats.scans_delayed++;
+            portEXIT_CRITICAL(&link_mux);
+        }
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+        waited_ms += wait_ms;
+    }
+
+    if (*dwell_ms > WIFI_LINK_OFF_CHANNEL_MS) {
+        *dwell_ms = WIFI_LINK_OFF_CHANNEL_MS;
+    }
+    off_channel = true;
+    off_started_ms = millis();
+    return true;
+}
+
+/**
+ * @brief The channel scan is over and the radio is back home
+ */
+void wifi_link_release_radio(void) {
+    if (!off_channel) {
+        return;
+    }
+    off_channel = false;
+    returned_ms = millis();
+    portENTER_CRITICAL(&link_mux);
+    stats.off_channel_scans++;
+    stats.off_channel_ms += returned_ms - off_started_ms;
+    portEXIT_CRITICAL(&link_mux);
+}
+
+/**
+ * @brief Keep scans on the home channel for the next window_ms
+ */
+void wifi_link_expect_traffic(uint32_t window_ms) {
+    traffic_until_ms = millis() + window_ms;
+}
+
+/**
+ * @brief Copy the link figures
+ */
+void wifi_link_get_stats(wifi_link_stats_t* out) {
+    portENTER_CRITICAL(&link_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&link_mux);
+    out->associated = associated;
+    out->home_channel = wifi_link_home_channel();
+}
+
+/**
+ * @brief Associated with an address; runs in the WiFi event task
+ */
+static void on_got_ip(arduino_event_id_t event, arduino_event_info_t info) {
+    uint8_t primary = 0;
+    wifi_second_chan_t second;
+    esp_wifi_get_channel(&primary, &second);
+    home_channel = primary;
+    associated = true;
+    portENTER_CRITICAL(&link_mux);
+    stats.associations++;
+    portEXIT_CRITICAL(&link_mux);
+}
+
+/**
+ * @brief Association lost, or a join attempt failed; runs in the WiFi event task
+ */
+static void on_disconnected(arduino_event_id_t event, arduino_event_info_t info) {
+    if (associated) {
+        portENTER_CRITICAL(&link_mux);
+        stats.disconnects++;
+        portEXIT_CRITICAL(&link_mux);
+        lost = true;
+    }
+    associated = false;
+}
+
+/**
+ * @brief Set the power save mode of the committed AI state, once per change
+ */
+static void apply_power_save(void) {
+    uint32_t version = data_bus_version(BUS_TOPIC_AI_STATE);
+    if (version == applied_state_version && applied_power_save >= 0) {
+        return;
+    }
+
+    ai_state_publication_t published;
+    ai_state_t state = AI_STATE_IDLE;
+    if (data_bus_read(BUS_TOPIC_AI_STATE, &published, 0, sizeof(published)) != 0 &&
+        published.state < AI_STATE_COUNT) {
+        state = published.state;
+    }
+    applied_state_version = version;
+
+    wifi_ps_type_t mode = state_power_save[state];
+    if (mode == applied_power_save || esp_wifi_set_ps(mode) != ESP_OK) {
+        return;
+    }
+    applied_power_save = (int8_t)mode;
+    portENTER_CRITICAL(&link_mux);
+    stats.power_save = (uint8_t)mode;
+    portEXIT_CRITICAL(&link_mux);
+}
@@ -0,0 +1,175 @@
+/**
+ * @file power_manager.cpp
+ * @brief Dynamic frequency scaling and automatic light sleep around the active work
+ *
+ * The renderer, the scan cycle and the AI decision each hold a
+ * CPU_FREQ_MAX lock while they run, so they see the full clock and the
+ * same latency as before; between them the clock drops to POWER_MIN_MHZ
+ * and, with tickless idle, the chip light-sleeps until the next timer or
+ * interrupt. The touch IRQ line is armed as a wakeup source so a tap is
+ * not lost to sleep. The radio drivers hold locks of their own.
+ */
+
+#include <Arduino.h>
+#include <esp_idf_version.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "power_manager.h"
+#include "logger.h"
+
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#endif
+
+static const char* const client_names[POWER_CLIENT_COUNT] = { "render", "scan", "ai", "bench" };
+
+static power_status_t status;
+static int64_t held_since_us[POWER_CLIENT_COUNT];
+static uint64_t held_us[POWER_CLIENT_COUNT];
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t floor_mhz = POWER_MIN_MHZ;       // Bottom of the range, raised by the governor
+static uint16_t ceiling_mhz = POWER_MAX_MHZ;     // Top of the range, lowered by thermal throttling
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t locks[POWER_CLIENT_COUNT];
+
+// Forward declarations
+static bool configure(uint16_t max_mhz);
+#endif
+
+/**
+ * @brief Configure DFS, with light sleep if the core allows
+ */
+bool power_manager_init(void) {
+    status.max_mhz = status.min_mhz = getCpuFrequencyMhz();
+#if CONFIG_PM_ENABLE && POWER_MANAGER_ENABLED
+    for (uint8_t client = 0; client < POWER_CLIENT_COUNT; client++) {
+        if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, client_names[client], &locks[client]) != ESP_OK) {
+            LOGE(SYSTEM, "❌ Power management locks unavailable - fixed clock");
+            return false;
+        }
+    }
+    if (!configure(POWER_MAX_MHZ)) {
+        LOGW(SYSTEM, "⚠️  esp_pm rejected the DFS range - fixed clock");
+        return false;
+    }
+    if (status.light_sleep && BOARD.touch.irq >= 0) {
+        // A pen-down must wake the chip; the touch driver's own interrupt follows
+        gpio_wakeup_enable((gpio_num_t)BOARD.touch.irq, GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+    }
+    LOGI(SYSTEM, "✅ DFS %u-%u MHz, light sleep %s", POWER_MIN_MHZ, POWER_MAX_MHZ,
+         status.light_sleep ? "on" : "off (no tickless idle in this core)");
+    return true;
+#else
+    LOGW(SYSTEM, "⚠️  No power management in this core - fixed %u MHz clock", status.max_mhz);
+    return false;
+#endif
+}
+
+/**
+ * @brief Hold the full clock for a client's work
+ */
+void power_manager_acquire(power_client_t client) {
+#if CONFIG_PM_ENABLE
+    if (status.dfs) {
+        esp_pm_lock_acquire(locks[client]);
+    }
+#endif
+    held_since_us[client] = esp_timer_get_time();
+}
+
+/**
+ * @brief The client's work is done
+ */
+void power_manager_release(power_client_t client) {
+    int64_t now_us = esp_timer_get_time();
+    held_us[client] += now_us - held_since_us[client];
+    portENTER_CRITICAL(&status_mux);
+    status.held_ms[client] = (uint32_t)(held_us[client] / 1000);
+    status.acquisitions[client]++;
+    portEXIT_CRITICAL(&status_mux);
+#if CONFIG_PM_ENABLE
+    if (status.dfs) {
+        esp_pm_lock_release(locks[client]);
+    }
+#endif
+}
+
+/**
+ * @brief Lower or restore the top of the DFS range
+ */
+bool power_manager_set_max_mhz(uint16_t mhz) {
+    ceiling_mhz = mhz;
+#if CONFIG_PM_ENABLE
+    if (status.dfs) {
+        return configure(mhz);
+    }
+#endif
+    return false;
+}
+
+/**
+ * @brief Raise or restore the bottom of the DFS range
+ */
+bool power_manager_set_min_mhz(uint16_t mhz) {
+    floor_mhz = max(mhz, (uint16_t)POWER_MIN_MHZ);
+#if CONFIG_PM_ENABLE
+    if (status.dfs) {
+        return configure(ceiling_mhz);
+    }
+#endif
+    return false;
+}
+
+/**
+ * @brief Copy the configuration and per-client figures
+ */
+void power_manager_get_status(power_status_t* out) {
+    portENTER_CRITICAL(&status_mux);
+    *out = status;
+    portEXIT_CRITICAL(&status_mux);
+}
+
+/**
+ * @brief Short name for logs
+ */
+const char* power_manager_client_name(power_client_t client) {
+    return client < POWER_CLIENT_COUNT ? client_names[client] : "?";
+}
+
+#if CONFIG_PM_ENABLE
+
+/**
+ * @brief Apply a DFS range topping out at max_mhz, light sleep if the core has tickless idle
+ *
+ * The floor never rises above the top, so thermal throttling wins over the governor.
+ */
+static bool configure(uint16_t max_mhz) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    esp_pm_config_t config;
+#else
+    esp_pm_config_esp32s3_t config;
+#endif
+    config.max_freq_mhz = max_mhz;
+    config.min_freq_mhz = min(max_mhz, floor_mhz);
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    config.light_sleep_enable = POWER_LIGHT_SLEEP;
+#else
+    config.light_sleep_enable = false;
+#endif
+    if (esp_pm_configure(&config) != ESP_OK) {
+        return false;
+    }
+    portENTER_CRITICAL(&status_mux);
+    status.dfs = true;
+    status.light_sleep = config.light_sleep_enable;
+    status.max_mhz = config.max_freq_mhz;
+    status.min_mhz = config.min_freq_mhz;
+    portEXIT_CRITICAL(&status_mux);
+    return true;
+}
+
+#endif // CONFIG_PM_ENABLE
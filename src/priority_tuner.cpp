@@ -0,0 +1,168 @@
+/**
+ * @file priority_tuner.cpp
+ * @brief Bounded priority boosts for the loops that fall behind
+ *
+ * Each look works on the change in the loop counters since the previous
+ * one, so a loop's history before its last quiet spell does not count
+ * against it. Decisions are made for every task first and applied after,
+ * so the UI guard sees the whole picture before any priority moves.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "priority_tuner.h"
+#include "cpu_load.h"
+#include "logger.h"
+
+typedef struct {
+    loop_id_t    loop;
+    TaskHandle_t task;
+    int8_t       core;              // -1 if it floats
+    uint8_t      boost;             // Levels above base
+    uint8_t      calm;              // Quiet intervals in a row
+    bool         inheriting;        // At the last look
+    uint32_t     last_loops;
+    uint32_t     last_misses;
+} tuned_task_t;
+
+static tuned_task_t tuned[LOOP_COUNT];
+static priority_tuner_stats_t stats;
+static portMUX_TYPE tuner_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static bool contended(int8_t core);
+
+/**
+ * @brief Hand a task's loop to the tuner; after the task is created
+ */
+void priority_tuner_register(loop_id_t loop, TaskHandle_t task, UBaseType_t base) {
+    if (task == NULL || stats.count == LOOP_COUNT) {
+        return;
+    }
+    uint8_t index = stats.count;
+    BaseType_t affinity = xTaskGetAffinity(task);
+    loop_timing_stats_t timing;
+    loop_timing_get(loop, &timing);
+
+    tuned_task_t* entry = &tuned[index];
+    memset(entry, 0, sizeof(*entry));
+    entry->loop = loop;
+    entry->task = task;
+    entry->core = affinity == tskNO_AFFINITY ? -1 : (int8_t)affinity;
+    entry->last_loops = timing.loops;
+    entry->last_misses = timing.misses;
+
+    portENTER_CRITICAL(&tuner_mux);
+    priority_task_stats_t* task_stats = &stats.tasks[index];
+    memset(task_stats, 0, sizeof(*task_stats));
+    task_stats->name = timing.name;
+    task_stats->base = (uint8_t)base;
+    task_stats->priority = (uint8_t)base;
+    task_stats->running = (uint8_t)base;
+    stats.count = index + 1;
+    portEXIT_CRITICAL(&tuner_mux);
+}
+
+/**
+ * @brief Look at the interval since the last call and move priorities (system task)
+ */
+void priority_tuner_adjust(void) {
+    if (!PRIORITY_TUNER_ENABLED) {
+        return;
+    }
+    uint8_t count = stats.count;
+    bool behind[LOOP_COUNT] = {};
+    bool ui_starved = false;
+
+    for (uint8_t i = 0; i < count; i++) {
+        tuned_task_t* entry = &tuned[i];
+        loop_timing_stats_t timing;
+        loop_timing_get(entry->loop, &timing);
+        uint32_t runs = timing.loops - entry->last_loops;
+        uint32_t missed = timing.misses - entry->last_misses;
+        entry->last_loops = timing.loops;
+        entry->last_misses = timing.misses;
+        // A loop that waited on events the whole interval is idle, not behind
+        behind[i] = runs > 0 && missed * 100 >= runs * PRIORITY_BOOST_MISS_PCT && contended(entry->core);
+        if (behind[i] && entry->loop == LOOP_UI) {
+            ui_starved = true;
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        tuned_task_t* entry = &tuned[i];
+        priority_task_stats_t* task_stats = &stats.tasks[i];
+        uint8_t limit = min((uint8_t)(task_stats->base + PRIORITY_BOOST_MAX), (uint8_t)PRIORITY_CEILING);
+        uint8_t boost = entry->boost;
+
+        if (ui_starved && entry->loop != LOOP_UI) {
+            // The face first: give back what the others were lent
+            if (boost > 0) {
+                boost--;
+            }
+            entry->calm = 0;
+        } else if (behind[i]) {
+            if (task_stats->base + boost < limit) {
+                boost++;
+            }
+            entry->calm = 0;
+        } else if (boost > 0 && ++entry->calm >= PRIORITY_RELAX_AFTER) {
+            boost--;
+            entry->calm = 0;
+        }
+
+        uint8_t priority = task_stats->base + boost;
+        if (boost != entry->boost) {
+            vTaskPrioritySet(entry->task, priority);
+            LOGI(SYSTEM, "📈 %s priority %u -> %u (own %u)%s", task_stats->name,
+                task_stats->priority, priority, task_stats->base,
+                ui_starved && entry->loop != LOOP_UI ? ", UI behind" : "");
+        }
+        bool raised = boost > entry->boost;
+        bool lowered = boost < entry->boost;
+        entry->boost = boost;
+
+        // Above what it was given: holding a mutex a higher task waits on
+        uint8_t running = (uint8_t)uxTaskPriorityGet(entry->task);
+        bool inheriting = running > priority;
+        if (inheriting && !entry->inheriting) {
+            LOGI(SYSTEM, "🔗 %s runs at %u over its %u, inherited through a mutex",
+                task_stats->name, running, priority);
+        }
+        entry->inheriting = inheriting;
+
+        portENTER_CRITICAL(&tuner_mux);
+        task_stats->priority = priority;
+        task_stats->running = running;
+        task_stats->boosts += raised ? 1 : 0;
+        task_stats->relaxes += lowered ? 1 : 0;
+        task_stats->inherited += inheriting ? 1 : 0;
+        portEXIT_CRITICAL(&tuner_mux);
+    }
+
+    portENTER_CRITICAL(&tuner_mux);
+    stats.looks++;
+    stats.ui_guards += ui_starved ? 1 : 0;
+    portEXIT_CRITICAL(&tuner_mux);
+}
+
+/**
+ * @brief Copy the figures
+ */
+void priority_tuner_get(priority_tuner_stats_t* out) {
+    portENTER_CRITICAL(&tuner_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&tuner_mux);
+}
+
+/**
+ * @brief Whether a task's core was busy enough that others kept it waiting
+ *
+ * A task that floats is held up only when both cores are.
+ */
+static bool contended(int8_t core) {
+    if (core >= 0) {
+        return cpu_load_core_pct((uint8_t)core) >= PRIORITY_CONTENDED_PCT;
+    }
+    return cpu_load_core_pct(0) >= PRIORITY_CONTENDED_PCT && cpu_load_core_pct(1) >= PRIORITY_CONTENDED_PCT;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file profile.cpp
+ * @brief Cycle counts of instrumented hot paths
+ *
+ * A scope reads CCOUNT on entry and again in profile_record(), so a pass
+ * costs two register reads and a call instead of the microsecond ticks
+ * of esp_timer, which round a 20 us kernel to nothing useful. Each site
+ * has a slot per core: a pass adds to its own core's slot with interrupts
+ * masked, which keeps a task switch out of the update without a spinlock.
+ * The cycles of the scope itself are measured once at boot and taken off
+ * every pass. A pass that ends on the other core (an unpinned task that
+ * migrated) compares two unrelated counters and is only counted as such.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "profile.h"
+#include "logger.h"
+
+typedef struct {
+    uint32_t calls;
+    uint32_t max_cycles;
+    uint64_t cycles;
+    uint32_t migrated;
+} profile_slot_t;
+
+static const char* const site_names[PROFILE_SITE_COUNT] = {
+    "rssi.sum", "rssi.minmax", "hist.add", "ai.features", "ai.rules",
+    "devices.observe", "novelty.check", "ble.adv_parse", "capture.frame",
+    "rssi.distance"
+};
+
+#if PROFILE_ENABLED
+static profile_slot_t slots[PROFILE_SITE_COUNT][portNUM_PROCESSORS];
+static uint32_t overhead_cycles = 0;            // Cost of an empty scope
+
+// Forward declarations
+static uint32_t __attribute__((noinline)) elapsed_cycles(uint32_t start_ccount);
+
+/**
+ * @brief Account one pass through a site
+ */
+void profile_record(profile_site_t site, uint32_t start_ccount, uint8_t start_core) {
+    uint32_t elapsed = elapsed_cycles(start_ccount);
+    elapsed = elapsed > overhead_cycles ? elapsed - overhead_cycles : 0;
+
+    UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    uint8_t core = (uint8_t)xPortGetCoreID();
+    profile_slot_t* slot = &slots[site][core];
+    if (core != start_core) {
+        slot->migrated++;
+    } else {
+        slot->calls++;
+        slot->cycles += elapsed;
+        if (elapsed > slot->max_cycles) {
+            slot->max_cycles = elapsed;
+        }
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+/**
+ * @brief Cycles since start_ccount; shared with the calibration so both pay the same call
+ */
+static uint32_t __attribute__((noinline)) elapsed_cycles(uint32_t start_ccount) {
+    return profile_ccount() - start_ccount;
+}
+#endif
+
+/**
+ * @brief Measure the scope's own cost, taken off every pass
+ */
+void profile_init(void) {
+#if PROFILE_ENABLED
+    uint32_t least = UINT32_MAX;
+    for (uint8_t i = 0; i < PROFILE_CALIBRATION_PASSES; i++) {
+        uint32_t start = profile_ccount();
+        uint32_t elapsed = elapsed_cycles(start);
+        if (elapsed < least) {
+            least = elapsed;
+        }
+    }
+    overhead_cycles = least;
+    profile_reset();
+    LOGI(SYSTEM, "✅ Profiling %u sites, %lu cycles of scope overhead taken off each pass",
+         (unsigned)PROFILE_SITE_COUNT, overhead_cycles);
+#endif
+}
+
+/**
+ * @brief Copy one site's figures
+ */
+void profile_get(profile_site_t site, profile_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->name = site_names[site];
+#if PROFILE_ENABLED
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+        const profile_slot_t* slot = &slots[site][core];
+        stats->calls += slot->calls;
+        stats->cycles += slot->cycles;
+        stats->migrated += slot->migrated;
+        if (slot->max_cycles > stats->max_cycles) {
+            stats->max_cycles = slot->max_cycles;
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Clear every site
+ */
+void profile_reset(void) {
+#if PROFILE_ENABLED
+    memset(slots, 0, sizeof(slots));
+#endif
+}
+
+/**
+ * @brief Write the registry as a text table, one line per site
+ */
+size_t profile_format(char* out, size_t capacity) {
+    if (capacity == 0) {
+        return 0;
+    }
+    uint32_t mhz = getCpuFrequencyMhz();
+    int n = snprintf(out, capacity, "%-16s %10s %14s %10s %10s %12s %8s\n",
+                     "site", "calls", "cycles", "avg", "max", "total_us", "migrated");
+    size_t length = n > 0 ? min((size_t)n, capacity - 1) : 0;
+    for (uint8_t site = 0; site < PROFILE_SITE_COUNT && length < capacity - 1; site++) {
+        profile_stats_t stats;
+        profile_get((profile_site_t)site, &stats);
+        n = snprintf(out + length, capacity - length, "%-16s %10lu %14llu %10lu %10lu %12llu %8lu\n",
+                     stats.name, stats.calls, stats.cycles,
+                     stats.calls > 0 ? (uint32_t)(stats.cycles / stats.calls) : 0UL,
+                     stats.max_cycles, stats.cycles / mhz, stats.migrated);
+        if (n <= 0 || (size_t)n >= capacity - length) {
+            out[length] = '\0';                 // Drop the line rather than cut it
+            break;
+        }
+        length += n;
+    }
+    return length;
+}
+
+/**
+ * @brief Write the registry to the serial port as "PROFILE" lines
+ */
+void profile_dump_serial(void) {
+    static char table[PROFILE_TEXT_BYTES];
+    size_t length = profile_format(table, sizeof(table));
+    const char* line = table;
+    while (line < table + length) {
+        const char* end = strchr(line, '\n');
+        Serial.printf("PROFILE %.*s\n", (int)(end - line), line);
+        line = end + 1;
+    }
+}
@@ -0,0 +1,102 @@
+/**
+ * @file protothread.cpp
+ * @brief Pass-based scheduler for the stackless threads of one task
+ *
+ * There is no ready list: with a handful of threads, running every one on
+ * each pass costs less than tracking which wait each is in, and a thread
+ * that is not ready returns at its first check. Only timed waits
+ * bound the block; the task notification value wakes it for everything
+ * else, so a thread waiting on the radio sleeps exactly as long as the
+ * blocking call it replaces.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "protothread.h"
+#include "logger.h"
+
+/**
+ * @brief Start with no threads
+ */
+void pt_sched_init(pt_sched_t* sched) {
+    memset(sched, 0, sizeof(*sched));
+}
+
+/**
+ * @brief Add a thread, to be first run by pt_sched_run()
+ */
+bool pt_sched_add(pt_sched_t* sched, pt_thread_t* thread, const char* name, pt_entry_t entry) {
+    if (sched->count >= PT_SCHED_MAX_THREADS) {
+        return false;
+    }
+    memset(thread, 0, sizeof(*thread));
+    thread->name = name;
+    thread->entry = entry;
+    PT_INIT(&thread->pt, thread);
+    sched->threads[sched->count++] = thread;
+    return true;
+}
+
+/**
+ * @brief Hand bits to every thread of the scheduler at the next pass (its own task)
+ */
+void pt_sched_post(pt_sched_t* sched, uint32_t bits) {
+    sched->posted |= bits;
+}
+
+/**
+ * @brief Run the threads on the calling task; returns once every one has exited
+ */
+void pt_sched_run(pt_sched_t* sched) {
+    while (true) {
+        // One pass: every live thread runs to its next wait
+        uint8_t live = 0;
+        for (uint8_t i = 0; i < sched->count; i++) {
+            pt_thread_t* thread = sched->threads[i];
+            if (thread->exited) {
+                continue;
+            }
+            thread->runs++;
+            if (thread->entry(&thread->pt) == PT_EXITED) {
+                thread->exited = true;
+                LOGD(SYSTEM, "Thread '%s' exited after %lu runs", thread->name, thread->runs);
+                continue;
+            }
+            live++;
+        }
+        sched->passes++;
+        if (live == 0) {
+            return;
+        }
+
+        // Block until the nearest deadline, unless a thread has posted bits
+        uint32_t now = millis();
+        TickType_t ticks = portMAX_DELAY;
+        for (uint8_t i = 0; i < sched->count && sched->posted == 0; i++) {
+            const pt_thread_t* thread = sched->threads[i];
+            if (thread->exited || !thread->timed) {
+                continue;
+            }
+            int32_t left_ms = (int32_t)(thread->wake_ms - now);
+            TickType_t left = left_ms <= 0 ? 0 : pdMS_TO_TICKS(left_ms) + 1;
+            ticks = min(ticks, left);
+        }
+        if (sched->posted != 0) {
+            ticks = 0;
+        }
+
+        uint32_t bits = 0;
+        if (xTaskNotifyWait(0, UINT32_MAX, &bits, ticks) == pdTRUE) {
+            sched->notified++;
+        } else if (ticks != 0) {
+            sched->timed_out++;
+        }
+        bits |= sched->posted;
+        sched->posted = 0;
+        for (uint8_t i = 0; i < sched->count && bits != 0; i++) {
+            sched->threads[i]->bits |= bits;
+        }
+    }
+}
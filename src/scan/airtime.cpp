@@ -0,0 +1,210 @@
+/**
+ * @file airtime.cpp
+ * @brief Per-channel airtime utilization from the captured frames
+ *
+ * Every captured frame held the air for a time its PHY, rate and length
+ * fix: preamble, then the payload at the rate it was sent. The capture
+ * task sums those times per channel over each capture window and divides
+ * by how long the radio listened there, which the hopper reports on each
+ * retune. Microseconds over milliseconds is already permille. Each
+ * channel's share is folded into an EWMA, as is the share over all
+ * channels, so the averages move over several windows and a channel the
+ * hopper only visits now and then keeps its last value in between.
+ *
+ * The promiscuous filter passes management and data frames only, so ACKs,
+ * RTS/CTS and the inter-frame spaces are not counted, and the time an
+ * active scan spends on other channels is counted to the hopper's; the
+ * figures are a floor on congestion rather than a full accounting.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "airtime.h"
+
+#define DSSS_LONG_PREAMBLE_US   192
+#define DSSS_SHORT_PREAMBLE_US  96
+#define OFDM_PREAMBLE_US        20      // L-STF, L-LTF, L-SIG
+#define HT_PREAMBLE_US          12      // HT-SIG, HT-STF on top of the legacy preamble
+#define HT_LTF_US               4       // One per spatial stream
+#define OFDM_SIGNAL_EXT_US      6       // After every OFDM frame at 2.4 GHz
+#define OFDM_SERVICE_TAIL_BITS  22      // SERVICE field and tail around the PSDU
+#define AVERAGE_FRACTION_BITS   4       // Averages are kept in 1/16 permille
+
+/**
+ * @brief A legacy rate: DSSS in 100 kbit/s, or OFDM data bits per symbol
+ */
+typedef struct {
+    uint8_t kind;
+    uint8_t value;
+} legacy_rate_t;
+
+enum { RATE_DSSS_LONG, RATE_DSSS_SHORT, RATE_OFDM };
+
+// By rx_ctrl.rate (wifi_phy_rate_t); 4 is unused and read as 1 Mbit/s
+static const legacy_rate_t legacy_rates[16] = {
+    { RATE_DSSS_LONG, 10 },  { RATE_DSSS_LONG, 20 },  { RATE_DSSS_LONG, 55 },  { RATE_DSSS_LONG, 110 },
+    { RATE_DSSS_LONG, 10 },  { RATE_DSSS_SHORT, 20 }, { RATE_DSSS_SHORT, 55 }, { RATE_DSSS_SHORT, 110 },
+    { RATE_OFDM, 192 },      { RATE_OFDM, 96 },       { RATE_OFDM, 48 },       { RATE_OFDM, 24 },
+    { RATE_OFDM, 216 },      { RATE_OFDM, 144 },      { RATE_OFDM, 72 },       { RATE_OFDM, 36 }
+};
+
+// HT data bits per symbol for one stream, MCS 0-7, at 20 and 40 MHz
+static const uint16_t ht_bits_20[8] = { 26, 52, 78, 104, 156, 208, 234, 260 };
+static const uint16_t ht_bits_40[8] = { 54, 108, 162, 216, 324, 432, 486, 540 };
+
+// Capture task
+static uint32_t window_airtime_us[WIFI_CHANNEL_COUNT + 1];
+static uint32_t window_listen_ms[WIFI_CHANNEL_COUNT + 1];
+static uint32_t average[WIFI_CHANNEL_COUNT + 1];   // Index 0: all channels
+static uint16_t measured = 0;                       // Bit per average that has a sample
+static uint8_t tuned_channel = 0;
+static uint32_t tuned_since_ms = 0;
+
+// Shared
+static airtime_stats_t published;
+static portMUX_TYPE airtime_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void close_span(uint32_t now_ms);
+static void fold(uint8_t index, uint32_t sample);
+static uint16_t permille_of(uint8_t index);
+
+/**
+ * @brief Time one frame held the air
+ */
+uint32_t airtime_frame_us(uint8_t rate, uint8_t phy, uint16_t length) {
+    uint32_t bits = OFDM_SERVICE_TAIL_BITS + (uint32_t)length * 8;
+
+    if ((phy & AIRTIME_PHY_MODE_MASK) != 0) {
+        // HT mixed format; VHT is not received at 2.4 GHz and is read the same way
+        uint8_t streams = min(rate / 8 + 1, 4);
+        const uint16_t* per_stream = (phy & AIRTIME_PHY_40MHZ) ? ht_bits_40 : ht_bits_20;
+        uint32_t per_symbol = per_stream[rate % 8] * streams;
+        uint32_t symbols = (bits + per_symbol - 1) / per_symbol;
+        uint32_t data_us = (phy & AIRTIME_PHY_SHORT_GI) ? (symbols * 36 + 9) / 10 : symbols * 4;
+        return OFDM_PREAMBLE_US + HT_PREAMBLE_US + HT_LTF_US * streams + data_us + OFDM_SIGNAL_EXT_US;
+    }
+
+    const legacy_rate_t* legacy = &legacy_rates[rate & 0x0F];
+    if (legacy->kind == RATE_OFDM) {
+        uint32_t symbols = (bits + legacy->value - 1) / legacy->value;
+        return OFDM_PREAMBLE_US + symbols * 4 + OFDM_SIGNAL_EXT_US;
+    }
+    uint32_t preamble = legacy->kind == RATE_DSSS_SHORT ? DSSS_SHORT_PREAMBLE_US : DSSS_LONG_PREAMBLE_US;
+    return preamble + ((uint32_t)length * 80 + legacy->value - 1) / legacy->value;
+}
+
+/**
+ * @brief Forget every average and start listening on a channel
+ */
+void airtime_init(uint8_t channel, uint32_t now_ms) {
+    memset(window_airtime_us, 0, sizeof(window_airtime_us));
+    memset(window_listen_ms, 0, sizeof(window_listen_ms));
+    memset(average, 0, sizeof(average));
+    measured = 0;
+    tuned_channel = channel <= WIFI_CHANNEL_COUNT ? channel : 0;
+    tuned_since_ms = now_ms;
+    portENTER_CRITICAL(&airtime_mux);
+    memset(&published, 0, sizeof(published));
+    portEXIT_CRITICAL(&airtime_mux);
+}
+
+/**
+ * @brief The radio was retuned; listening time goes to the new channel from now
+ */
+void airtime_note_channel(uint8_t channel, uint32_t now_ms) {
+    if (channel == tuned_channel) {
+        return;
+    }
+    close_span(now_ms);
+    tuned_channel = channel <= WIFI_CHANNEL_COUNT ? channel : 0;
+}
+
+/**
+ * @brief Add a received frame's airtime to its channel's window
+ */
+void airtime_observe(uint8_t channel, uint32_t airtime_us) {
+    if (channel <= WIFI_CHANNEL_COUNT) {
+        window_airtime_us[channel] += airtime_us;
+    }
+}
+
+/**
+ * @brief Close the window: fold each channel's share into its average
+ */
+void airtime_roll(uint32_t now_ms) {
+    close_span(now_ms);
+
+    airtime_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    uint32_t total_airtime_us = 0;
+    uint32_t total_listen_ms = 0;
+
+    for (uint8_t ch = 1; ch <= WIFI_CHANNEL_COUNT; ch++) {
+        // Frames heard during a short visit, such as a scan's, are dropped
+        if (window_listen_ms[ch] >= AIRTIME_MIN_LISTEN_MS) {
+            fold(ch, min(window_airtime_us[ch] / window_listen_ms[ch], (uint32_t)1000));
+            total_airtime_us += window_airtime_us[ch];
+            total_listen_ms += window_listen_ms[ch];
+        }
+        stats.channel_permille[ch] = permille_of(ch);
+        if ((measured & (1 << ch)) &&
+            (stats.busiest_channel == 0 || stats.channel_permille[ch] > stats.busiest_permille)) {
+            stats.busiest_permille = stats.channel_permille[ch];
+            stats.busiest_channel = ch;
+        }
+    }
+    if (total_listen_ms >= AIRTIME_MIN_LISTEN_MS) {
+        fold(0, min(total_airtime_us / total_listen_ms, (uint32_t)1000));
+    }
+    stats.permille = permille_of(0);
+
+    memset(window_airtime_us, 0, sizeof(window_airtime_us));
+    memset(window_listen_ms, 0, sizeof(window_listen_ms));
+
+    portENTER_CRITICAL(&airtime_mux);
+    stats.windows = published.windows + 1;
+    published = stats;
+    portEXIT_CRITICAL(&airtime_mux);
+}
+
+/**
+ * @brief Copy the averages
+ */
+void airtime_get_stats(airtime_stats_t* out) {
+    portENTER_CRITICAL(&airtime_mux);
+    *out = published;
+    portEXIT_CRITICAL(&airtime_mux);
+}
+
+/**
+ * @brief Credit the time since the last retune to the channel tuned
+ */
+static void close_span(uint32_t now_ms) {
+    if (tuned_channel != 0) {
+        window_listen_ms[tuned_channel] += now_ms - tuned_since_ms;
+    }
+    tuned_since_ms = now_ms;
+}
+
+/**
+ * @brief EWMA of a permille sample; the first sample seeds it
+ */
+static void fold(uint8_t index, uint32_t sample) {
+    int32_t target = (int32_t)(sample << AVERAGE_FRACTION_BITS);
+    if ((measured & (1 << index)) == 0) {
+        measured |= 1 << index;
+        average[index] = (uint32_t)target;
+        return;
+    }
+    int32_t current = (int32_t)average[index];
+    average[index] = (uint32_t)(current + ((target - current) >> AIRTIME_EWMA_SHIFT));
+}
+
+/**
+ * @brief Permille of an average, rounded
+ */
+static uint16_t permille_of(uint8_t index) {
+    return (uint16_t)((average[index] + (1 << (AVERAGE_FRACTION_BITS - 1))) >> AVERAGE_FRACTION_BITS);
+}
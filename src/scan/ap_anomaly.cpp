@@ -0,0 +1,261 @@
+/**
+ * @file ap_anomaly.cpp
+ * @brief Streaming rogue access point detection
+ *
+ * Each SSID keeps a small profile in an array indexed by its SSID arena
+ * slot: the vendor prefix of the first BSSID it was heard on, its security
+ * and how many cycles it has been heard in. Once established, a new BSSID
+ * carrying it from another vendor is a twin, since the access points of
+ * one network almost always share a vendor, and a change of security is
+ * reported whichever BSSID brought it. The device table tells a new BSSID
+ * from a known one and the channel a known one was on.
+ *
+ * The capture pipeline adds what a scan cannot see: beacons whose interval
+ * changes or whose TSF runs backwards, as when a second transmitter
+ * clones a BSSID, and bursts of deauthentication frames. Every check is a
+ * direct-indexed lookup, so the cost per observation is constant.
+ *
+ * Detections are queued to the AI task as scan events, at most one per
+ * pattern every AP_ANOMALY_REPEAT_MS, and each one queued that way starts
+ * a capture burst on the channel it was heard on; all of them are counted.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "config.h"
+#include "ap_anomaly.h"
+#include "capture_burst.h"
+#include "device_table.h"
+#include "scan_events.h"
+#include "ssid_arena.h"
+#include "logger.h"
+
+static_assert((AP_ANOMALY_BEACON_SLOTS & (AP_ANOMALY_BEACON_SLOTS - 1)) == 0,
+              "AP_ANOMALY_BEACON_SLOTS must be a power of two");
+
+#define MAC_LOCAL_BIT 0x02          // Locally administered: set on a vendor's secondary BSSIDs
+
+/**
+ * @brief What is expected of one SSID (scan task)
+ */
+typedef struct {
+    uint32_t hash;                  // Of the SSID bytes, 0 for a free profile
+    uint8_t  vendor[3];             // Prefix of the first BSSID, local bit cleared
+    uint8_t  auth_mode;             // wifi_auth_mode_t last advertised
+    uint16_t last_cycle;            // Scan cycle it was last counted in
+    uint8_t  cycles;                // Cycles heard in, saturating
+    uint8_t  reserved;
+} ssid_profile_t;
+
+/**
+ * @brief The last beacon from one BSSID (capture task)
+ */
+typedef struct {
+    uint8_t  bssid[6];
+    uint16_t interval_tu;
+    uint64_t tsf_us;
+    uint32_t last_ms;               // 0 for a free slot
+} beacon_slot_t;
+
+// Scan task
+static ssid_profile_t profiles[SSID_ARENA_SLOTS];
+
+// Capture task
+static beacon_slot_t beacons[AP_ANOMALY_BEACON_SLOTS];
+static uint32_t deauth_window_ms = 0;
+static uint16_t deauth_frames = 0;
+
+// Shared
+static ap_anomaly_stats_t stats;
+static uint32_t raised_ms[AP_ANOMALY_COUNT];
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+extern QueueHandle_t scan_event_queue;
+
+static const char* const anomaly_names[AP_ANOMALY_COUNT] = {
+    "twin", "security", "channel", "beacon", "deauth"
+};
+
+// Forward declarations
+static void raise_anomaly(ap_anomaly_t anomaly, const uint8_t* bssid, uint8_t channel, int8_t rssi,
+                          uint32_t now_ms);
+static uint32_t hash_ssid(const uint8_t* bytes, uint8_t len);
+
+/**
+ * @brief Forget every SSID and beacon profile
+ */
+void ap_anomaly_init(void) {
+    memset(profiles, 0, sizeof(profiles));
+    memset(beacons, 0, sizeof(beacons));
+    deauth_window_ms = 0;
+    deauth_frames = 0;
+    portENTER_CRITICAL(&stats_mux);
+    memset(&stats, 0, sizeof(stats));
+    memset(raised_ms, 0, sizeof(raised_ms));
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Check one scan record against its SSID and its device table entry
+ */
+void ap_anomaly_check_record(const wifi_record_t* record, uint32_t now_ms) {
+    const device_entry_t* known = device_table_find(record->bssid, DEVICE_KIND_WIFI_AP);
+    if (known != NULL && known->sightings >= AP_ANOMALY_ESTABLISHED_CYCLES &&
+        known->channel != 0 && known->channel != record->channel) {
+        raise_anomaly(AP_ANOMALY_CHANNEL, record->bssid, record->channel, record->rssi, now_ms);
+    }
+
+    // Hidden networks carry nothing to compare
+    if (record->ssid_id >= SSID_ARENA_SLOTS) {
+        return;
+    }
+    uint8_t len = 0;
+    const uint8_t* ssid = ssid_arena_bytes(record->ssid_id, &len);
+    uint32_t hash = hash_ssid(ssid, len);
+    uint8_t vendor[3] = { (uint8_t)(record->bssid[0] & ~MAC_LOCAL_BIT), record->bssid[1], record->bssid[2] };
+    uint16_t cycle = device_table_cycle();
+
+    // The arena slot may have been handed to another SSID since
+    ssid_profile_t* profile = &profiles[record->ssid_id];
+    if (profile->hash != hash) {
+        bool added = profile->hash == 0;
+        profile->hash = hash;
+        memcpy(profile->vendor, vendor, sizeof(vendor));
+        profile->auth_mode = record->auth_mode;
+        profile->last_cycle = cycle;
+        profile->cycles = 1;
+        if (added) {
+            portENTER_CRITICAL(&stats_mux);
+            stats.ssids++;
+            portEXIT_CRITICAL(&stats_mux);
+        }
+        return;
+    }
+
+    if (profile->cycles >= AP_ANOMALY_ESTABLISHED_CYCLES) {
+        if (known == NULL && memcmp(profile->vendor, vendor, sizeof(vendor)) != 0) {
+            raise_anomaly(AP_ANOMALY_TWIN, record->bssid, record->channel, record->rssi, now_ms);
+        }
+        if (record->auth_mode != profile->auth_mode) {
+            raise_anomaly(AP_ANOMALY_SECURITY, record->bssid, record->channel, record->rssi, now_ms);
+        }
+    }
+    // A lasting change of security is reported once; flipping back and forth keeps reporting
+    profile->auth_mode = record->auth_mode;
+    if (profile->last_cycle != cycle) {
+        profile->last_cycle = cycle;
+        if (profile->cycles < UINT8_MAX) {
+            profile->cycles++;
+        }
+    }
+}
+
+/**
+ * @brief Check a beacon's interval and TSF against the last from its BSSID
+ */
+void ap_anomaly_observe_beacon(const uint8_t* bssid, uint16_t interval_tu, uint64_t tsf_us,
+                               uint8_t channel, int8_t rssi, uint32_t now_ms) {
+    uint32_t index = ((uint32_t)bssid[3] << 16 | (uint32_t)bssid[4] << 8 | bssid[5]) * 2654435761u;
+    beacon_slot_t* slot = &beacons[index >> 16 & (AP_ANOMALY_BEACON_SLOTS - 1)];
+
+    // A slot that went quiet starts over, as does one taken by another BSSID
+    bool same = slot->last_ms != 0 && now_ms - slot->last_ms < CAPTURE_ENTRY_TTL_MS &&
+                memcmp(slot->bssid, bssid, sizeof(slot->bssid)) == 0;
+    if (same && (interval_tu != slot->interval_tu || tsf_us < slot->tsf_us)) {
+        raise_anomaly(AP_ANOMALY_BEACON, bssid, channel, rssi, now_ms);
+    }
+    memcpy(slot->bssid, bssid, sizeof(slot->bssid));
+    slot->interval_tu = interval_tu;
+    slot->tsf_us = tsf_us;
+    slot->last_ms = now_ms != 0 ? now_ms : 1;
+}
+
+/**
+ * @brief Count a deauthentication or disassociation frame
+ */
+void ap_anomaly_observe_deauth(const uint8_t* bssid, uint8_t channel, int8_t rssi, uint32_t now_ms) {
+    if (now_ms - deauth_window_ms >= CAPTURE_WINDOW_MS) {
+        deauth_window_ms = now_ms;
+        deauth_frames = 0;
+    }
+    if (++deauth_frames == AP_ANOMALY_DEAUTH_BURST) {
+        raise_anomaly(AP_ANOMALY_DEAUTH, bssid, channel, rssi, now_ms);
+    }
+}
+
+/**
+ * @brief Copy the detection counts
+ */
+void ap_anomaly_get_stats(ap_anomaly_stats_t* out) {
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* ap_anomaly_name(ap_anomaly_t anomaly) {
+    return anomaly < AP_ANOMALY_COUNT ? anomaly_names[anomaly] : "?";
+}
+
+/**
+ * @brief Count a detection and queue it to the AI task unless it just had one like it
+ *
+ * A fresh detection also asks for a capture burst on its channel.
+ */
+static void raise_anomaly(ap_anomaly_t anomaly, const uint8_t* bssid, uint8_t channel, int8_t rssi,
+                          uint32_t now_ms) {
+    portENTER_CRITICAL(&stats_mux);
+    stats.detected[anomaly]++;
+    bool repeat = raised_ms[anomaly] != 0 && now_ms - raised_ms[anomaly] < AP_ANOMALY_REPEAT_MS;
+    if (!repeat) {
+        raised_ms[anomaly] = now_ms != 0 ? now_ms : 1;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+
+    // Keep the last slot free so the cycle-complete event always fits
+    bool sent = false;
+    if (!repeat && scan_event_queue != NULL && uxQueueSpacesAvailable(scan_event_queue) > 1) {
+        scan_event_t event;
+        event.type = SCAN_EVENT_AP_ANOMALY;
+        event.kind = DEVICE_KIND_WIFI_AP;
+        event.rssi = rssi;
+        event.detail = (uint8_t)anomaly;
+        memcpy(event.mac, bssid, sizeof(event.mac));
+        event.dropped = 0;
+        event.trace = 0;
+        event.timestamp_ms = now_ms;
+        sent = xQueueSend(scan_event_queue, &event, 0) == pdTRUE;
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    if (sent) {
+        stats.raised++;
+    } else {
+        stats.dropped++;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+
+    if (!repeat) {
+        LOGW(SCAN, "🚨 Rogue AP pattern '%s' from %02X:%02X:%02X:%02X:%02X:%02X (%d dBm)",
+             anomaly_names[anomaly], bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], rssi);
+#if CAPTURE_BURST_ENABLED && PACKET_CAPTURE_ENABLED
+        capture_burst_trigger(CAPTURE_BURST_ANOMALY, channel, now_ms);
+#else
+        (void)channel;
+#endif
+    }
+}
+
+/**
+ * @brief FNV-1a of the SSID bytes, never 0
+ */
+static uint32_t hash_ssid(const uint8_t* bytes, uint8_t len) {
+    uint32_t hash = 2166136261u;
+    for (uint8_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash != 0 ? hash : 1;
+}
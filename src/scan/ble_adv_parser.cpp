@@ -0,0 +1,239 @@
+/**
+ * @file ble_adv_parser.cpp
+ * @brief Zero-copy AD structure parser and fingerprint classifier
+ *
+ * The parser runs directly over the payload handed to the GAP callback and
+ * copies out only fixed-size fields. Classification checks the strongest
+ * fingerprints first (beacon frames, tracker services), then appearance,
+ * service UUIDs and finally the manufacturer, using constexpr tables.
+ *
+ * Both run for every advertisement in Bluedroid's callback, so they and
+ * the fingerprint tables are placed in IRAM and DRAM: a pass never waits
+ * on a flash cache line evicted by the UI or an SD write.
+ */
+
+#include <esp_attr.h>
+#include "ble_adv_parser.h"
+#include "profile.h"
+
+// AD structure types
+#define AD_TYPE_FLAGS           0x01
+#define AD_TYPE_UUID16_PARTIAL  0x02
+#define AD_TYPE_UUID16_COMPLETE 0x03
+#define AD_TYPE_SHORT_NAME      0x08
+#define AD_TYPE_FULL_NAME       0x09
+#define AD_TYPE_TX_POWER        0x0A
+#define AD_TYPE_SERVICE_DATA16  0x16
+#define AD_TYPE_APPEARANCE      0x19
+#define AD_TYPE_MANUFACTURER    0xFF
+
+#define COMPANY_NONE            0xFFFF
+#define COMPANY_APPLE           0x004C
+
+// Apple continuity message types
+#define APPLE_TYPE_IBEACON      0x02
+#define APPLE_TYPE_PROXIMITY    0x07
+#define APPLE_TYPE_NEARBY       0x10
+#define APPLE_TYPE_FIND_MY      0x12
+
+/**
+ * @brief Fingerprint table entry
+ */
+struct class_entry_t {
+    uint16_t key;
+    ble_device_class_t device_class;
+};
+
+// 16-bit service UUIDs
+static constexpr DRAM_ATTR class_entry_t service_classes[] = {
+    { 0xFEAA, BLE_CLASS_BEACON   },     // Eddystone
+    { 0xFEED, BLE_CLASS_TRACKER  },     // Tile
+    { 0xFEEC, BLE_CLASS_TRACKER  },     // Tile
+    { 0xFD5A, BLE_CLASS_TRACKER  },     // Samsung SmartTag
+    { 0xFD6F, BLE_CLASS_PHONE    },     // Exposure notification
+    { 0xFE2C, BLE_CLASS_PHONE    },     // Google Fast Pair
+    { 0x180D, BLE_CLASS_WEARABLE },     // Heart rate
+    { 0x1814, BLE_CLASS_WEARABLE },     // Running speed and cadence
+    { 0x1816, BLE_CLASS_WEARABLE },     // Cycling speed and cadence
+};
+
+// Manufacturer company identifiers
+static constexpr DRAM_ATTR class_entry_t company_classes[] = {
+    { 0x004C, BLE_CLASS_PHONE    },     // Apple
+    { 0x0006, BLE_CLASS_PHONE    },     // Microsoft
+    { 0x0075, BLE_CLASS_PHONE    },     // Samsung
+    { 0x00E0, BLE_CLASS_PHONE    },     // Google
+    { 0x0087, BLE_CLASS_WEARABLE },     // Garmin
+    { 0x006B, BLE_CLASS_WEARABLE },     // Polar
+    { 0x0157, BLE_CLASS_WEARABLE },     // Huami
+    { 0x015D, BLE_CLASS_BEACON   },     // Estimote
+};
+
+// GAP appearance categories (appearance >> 6)
+static constexpr DRAM_ATTR class_entry_t appearance_classes[] = {
+    { 0x001, BLE_CLASS_PHONE    },      // Phone
+    { 0x003, BLE_CLASS_WEARABLE },      // Watch
+    { 0x008, BLE_CLASS_TRACKER  },      // Tag
+    { 0x00D, BLE_CLASS_WEARABLE },      // Heart rate sensor
+    { 0x011, BLE_CLASS_WEARABLE },      // Running walking sensor
+};
+
+static const char* const class_names[BLE_CLASS_COUNT] = {
+    "unknown", "phone", "tracker", "wearable", "beacon"
+};
+
+template <uint8_t N>
+static ble_device_class_t IRAM_ATTR lookup(const class_entry_t (&table)[N], uint16_t key) {
+    for (uint8_t i = 0; i < N; i++) {
+        if (table[i].key == key) {
+            return table[i].device_class;
+        }
+    }
+    return BLE_CLASS_UNKNOWN;
+}
+
+static inline uint16_t read_le16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void IRAM_ATTR add_uuid16(ble_adv_info_t* info, uint16_t uuid) {
+    if (info->uuid16_count < BLE_ADV_MAX_UUID16) {
+        info->uuid16[info->uuid16_count++] = uuid;
+    }
+}
+
+/**
+ * @brief Walk the AD structures of a raw advertisement payload in place
+ */
+void IRAM_ATTR ble_adv_parse(const uint8_t* data, uint8_t len, ble_adv_info_t* info) {
+    PROFILE_SCOPE(PROFILE_ADV_PARSE);
+    info->company_id = COMPANY_NONE;
+    info->mfg_type = 0;
+    info->mfg_subtype = 0;
+    info->appearance = 0;
+    info->tx_power = 0;
+    info->has_tx_power = false;
+    info->flags = 0;
+    info->uuid16_count = 0;
+    info->name_hash = 0;
+
+    uint8_t pos = 0;
+    while (pos + 1 < len) {
+        uint8_t field_len = data[pos];
+        if (field_len == 0 || pos + 1 + field_len > len) {
+            break;
+        }
+
+        uint8_t type = data[pos + 1];
+        const uint8_t* value = &data[pos + 2];
+        uint8_t value_len = field_len - 1;
+
+        switch (type) {
+            case AD_TYPE_FLAGS:
+                if (value_len >= 1) {
+                    info->flags = value[0];
+                }
+                break;
+
+            case AD_TYPE_UUID16_PARTIAL:
+            case AD_TYPE_UUID16_COMPLETE:
+                for (uint8_t i = 0; i + 1 < value_len; i += 2) {
+                    add_uuid16(info, read_le16(&value[i]));
+                }
+                break;
+
+            case AD_TYPE_SERVICE_DATA16:
+                if (value_len >= 2) {
+                    add_uuid16(info, read_le16(value));
+                }
+                break;
+
+            case AD_TYPE_SHORT_NAME:
+            case AD_TYPE_FULL_NAME:
+                if (value_len > 0) {
+                    // FNV-1a over the raw name bytes
+                    uint32_t hash = 2166136261UL;
+                    for (uint8_t i = 0; i < value_len; i++) {
+                        hash = (hash ^ value[i]) * 16777619UL;
+                    }
+                    info->name_hash = hash;
+                }
+                break;
+
+            case AD_TYPE_TX_POWER:
+                if (value_len >= 1) {
+                    info->tx_power = (int8_t)value[0];
+                    info->has_tx_power = true;
+                }
+                break;
+
+            case AD_TYPE_APPEARANCE:
+                if (value_len >= 2) {
+                    info->appearance = read_le16(value);
+                }
+                break;
+
+            case AD_TYPE_MANUFACTURER:
+                if (value_len >= 2) {
+                    info->company_id = read_le16(value);
+                    info->mfg_type = value_len >= 3 ? value[2] : 0;
+                    info->mfg_subtype = value_len >= 4 ? value[3] : 0;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        pos += field_len + 1;
+    }
+}
+
+/**
+ * @brief Map extracted fields to a device class
+ */
+ble_device_class_t IRAM_ATTR ble_adv_classify(const ble_adv_info_t* info) {
+    // Apple continuity types are more specific than the company itself
+    if (info->company_id == COMPANY_APPLE) {
+        switch (info->mfg_type) {
+            case APPLE_TYPE_IBEACON:    return BLE_CLASS_BEACON;
+            case APPLE_TYPE_FIND_MY:    return BLE_CLASS_TRACKER;
+            case APPLE_TYPE_PROXIMITY:  return BLE_CLASS_WEARABLE;
+            case APPLE_TYPE_NEARBY:     return BLE_CLASS_PHONE;
+            default:                    break;
+        }
+    }
+
+    // Services identify beacons and trackers regardless of vendor
+    ble_device_class_t by_service = BLE_CLASS_UNKNOWN;
+    for (uint8_t i = 0; i < info->uuid16_count; i++) {
+        ble_device_class_t match = lookup(service_classes, info->uuid16[i]);
+        if (match == BLE_CLASS_BEACON || match == BLE_CLASS_TRACKER) {
+            return match;
+        }
+        if (by_service == BLE_CLASS_UNKNOWN) {
+            by_service = match;
+        }
+    }
+
+    if (info->appearance != 0) {
+        ble_device_class_t match = lookup(appearance_classes, info->appearance >> 6);
+        if (match != BLE_CLASS_UNKNOWN) {
+            return match;
+        }
+    }
+
+    if (by_service != BLE_CLASS_UNKNOWN) {
+        return by_service;
+    }
+
+    return info->company_id != COMPANY_NONE ? lookup(company_classes, info->company_id)
+                                            : BLE_CLASS_UNKNOWN;
+}
+
+/**
+ * @brief Short name of a device class
+ */
+const char* ble_class_to_string(ble_device_class_t device_class) {
+    return device_class < BLE_CLASS_COUNT ? class_names[device_class] : class_names[0];
+}
@@ -0,0 +1,124 @@
+/**
+ * @file ble_backend_bluedroid.cpp
+ * @brief The observer scan on Bluedroid's legacy GAP scan
+ *
+ * Setting the parameters starts the scan once the stack acknowledges them.
+ * Only legacy advertising on the 1M PHY is reported.
+ */
+
+#include "config.h"
+
+#if BLE_SCAN_BACKEND == BLE_BACKEND_BLUEDROID
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <esp_gap_ble_api.h>
+#include <esp_bt.h>
+#include <esp_attr.h>
+#include "ble_backend.h"
+
+static volatile bool running = false;
+
+static esp_ble_scan_params_t scan_params = {
+    .scan_type          = BLE_SCAN_TYPE_ACTIVE,
+    .own_addr_type      = BLE_ADDR_TYPE_PUBLIC,
+    .scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL,
+    .scan_interval      = BLE_MS_TO_UNITS(BLE_SCAN_INTERVAL),
+    .scan_window        = BLE_MS_TO_UNITS(BLE_SCAN_WINDOW),
+    .scan_duplicate     = BLE_SCAN_DUPLICATE_DISABLE
+};
+
+// Forward declarations
+static void IRAM_ATTR gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+
+/**
+ * @brief Drop classic BT's memory and start the controller in BLE mode
+ */
+bool ble_backend_prepare(void) {
+    esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT);
+    return btStartMode(BT_MODE_BLE);
+}
+
+/**
+ * @brief Bring up Bluedroid and take its GAP events
+ */
+bool ble_backend_init(void) {
+    BLEDevice::init("HydraESP-Scanner");
+    BLEDevice::setCustomGapHandler(gap_event_handler);
+    return true;
+}
+
+/**
+ * @brief Set the parameters, which starts the scan once acknowledged
+ */
+bool ble_backend_start(const ble_backend_params_t* params) {
+    if (running) {
+        esp_ble_gap_stop_scanning();
+    }
+    scan_params.scan_type = params->passive ? BLE_SCAN_TYPE_PASSIVE : BLE_SCAN_TYPE_ACTIVE;
+    scan_params.scan_interval = params->interval_units;
+    scan_params.scan_window = params->window_units;
+    scan_params.scan_filter_policy = params->whitelist_only ? BLE_SCAN_FILTER_ALLOW_ONLY_WLST
+                                                            : BLE_SCAN_FILTER_ALLOW_ALL;
+    running = true;
+    return esp_ble_gap_set_scan_params(&scan_params) == ESP_OK;
+}
+
+/**
+ * @brief Stop the observer scan until the next start
+ */
+bool ble_backend_stop(void) {
+    running = false;
+    return esp_ble_gap_stop_scanning() == ESP_OK;
+}
+
+/**
+ * @brief Empty the whitelist and add each address; only public and random types exist there
+ */
+bool ble_backend_set_whitelist(const uint8_t (*addrs)[6], const uint8_t* addr_types, uint8_t count) {
+    bool ok = esp_ble_gap_clear_whitelist() == ESP_OK;
+    for (uint8_t i = 0; i < count; i++) {
+        esp_bd_addr_t addr;
+        memcpy(addr, addrs[i], sizeof(addr));
+        esp_ble_wl_addr_type_t type = (addr_types[i] & 0x01) ? BLE_WL_ADDR_TYPE_RANDOM : BLE_WL_ADDR_TYPE_PUBLIC;
+        ok = esp_ble_gap_update_whitelist(true, addr, type) == ESP_OK && ok;
+    }
+    return ok;
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* ble_backend_name(void) {
+    return "bluedroid";
+}
+
+/**
+ * @brief GAP callback - runs in the Bluetooth host task
+ */
+static void IRAM_ATTR gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+    switch (event) {
+        case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT:
+            // Duration 0 keeps the scan running until explicitly stopped
+            if (running) {
+                esp_ble_gap_start_scanning(0);
+            }
+            break;
+
+        case ESP_GAP_BLE_SCAN_RESULT_EVT:
+            if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT) {
+                ble_scan_fold(param->scan_rst.bda, (uint8_t)param->scan_rst.ble_addr_type,
+                              (int8_t)param->scan_rst.rssi, param->scan_rst.ble_adv,
+                              param->scan_rst.adv_data_len + param->scan_rst.scan_rsp_len,
+                              BLE_ADV_KIND_LEGACY);
+            } else if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_CMPL_EVT && running) {
+                esp_ble_gap_start_scanning(0);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+#endif // BLE_SCAN_BACKEND == BLE_BACKEND_BLUEDROID
@@ -0,0 +1,210 @@
+/**
+ * @file ble_backend_nimble.cpp
+ * @brief The observer scan on NimBLE, the default host stack
+ *
+ * The scan only observes, and NimBLE's host needs far less internal RAM
+ * than Bluedroid's; with classic BT's controller memory given back as
+ * well, the difference goes to the display's DMA buffers, the inference
+ * arena and the web server.
+ *
+ * Built with CONFIG_BT_NIMBLE_EXT_ADV, as the S3 is, it runs extended
+ * discovery: legacy advertising as before and also the BLE 5 extended
+ * advertising PDUs, on the 1M PHY and, with BLE_SCAN_CODED_PHY, the coded
+ * PHY that long-range devices use; the controller shares the scan between
+ * the two. A BLE 4.2 controller, as on the classic ESP32, gets the legacy
+ * discovery.
+ *
+ * An extended advertisement longer than one report arrives in fragments;
+ * the first, which holds the leading AD structures, is folded and the
+ * rest of the chain is skipped. Addresses come least significant byte
+ * first and are turned around to match Bluedroid's.
+ */
+
+#include "config.h"
+
+#if BLE_SCAN_BACKEND == BLE_BACKEND_NIMBLE
+
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <esp_bt.h>
+#include <esp_attr.h>
+#include "ble_backend.h"
+
+#if defined(CONFIG_BT_NIMBLE_EXT_ADV) && CONFIG_BT_NIMBLE_EXT_ADV
+#define EXTENDED_DISCOVERY 1
+#else
+#define EXTENDED_DISCOVERY 0
+#endif
+
+static volatile bool running = false;
+static uint8_t filter_policy = BLE_HCI_SCAN_FILT_NO_WL;
+#if EXTENDED_DISCOVERY
+static ble_gap_ext_disc_params uncoded_params;
+static ble_gap_ext_disc_params coded_params;
+
+// Host task: the advertiser whose fragment chain is being skipped
+static bool in_chain = false;
+static uint8_t chain_addr[6];
+#else
+static ble_gap_disc_params disc_params;
+#endif
+
+// Forward declarations
+static int start_discovery(void);
+static int IRAM_ATTR gap_event(struct ble_gap_event* event, void* arg);
+
+/**
+ * @brief Drop classic BT's memory; NimBLE's init brings the controller up
+ */
+bool ble_backend_prepare(void) {
+    esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT);
+    return true;
+}
+
+/**
+ * @brief Bring up NimBLE; init returns once the host and controller are in sync
+ */
+bool ble_backend_init(void) {
+    NimBLEDevice::init("HydraESP-Scanner");
+    return true;
+}
+
+/**
+ * @brief Start discovery, or restart it with new parameters
+ */
+bool ble_backend_start(const ble_backend_params_t* params) {
+    if (running) {
+        ble_gap_disc_cancel();
+    }
+    filter_policy = params->whitelist_only ? BLE_HCI_SCAN_FILT_USE_WL : BLE_HCI_SCAN_FILT_NO_WL;
+#if EXTENDED_DISCOVERY
+    uncoded_params.itvl = params->interval_units;
+    uncoded_params.window = params->window_units;
+    uncoded_params.passive = params->passive ? 1 : 0;
+    coded_params = uncoded_params;
+#else
+    disc_params.itvl = params->interval_units;
+    disc_params.window = params->window_units;
+    disc_params.filter_policy = filter_policy;
+    disc_params.limited = 0;
+    disc_params.passive = params->passive ? 1 : 0;
+    disc_params.filter_duplicates = 0;
+#endif
+    running = true;
+    return start_discovery() == 0;
+}
+
+/**
+ * @brief Stop the observer scan until the next start
+ */
+bool ble_backend_stop(void) {
+    running = false;
+    int rc = ble_gap_disc_cancel();
+    return rc == 0 || rc == BLE_HS_EALREADY;
+}
+
+/**
+ * @brief Set the controller's whitelist in one go; NimBLE wants it least significant byte first
+ */
+bool ble_backend_set_whitelist(const uint8_t (*addrs)[6], const uint8_t* addr_types, uint8_t count) {
+    if (count == 0) {
+        return true;                // NimBLE rejects an empty list; the filter policy leaves it unused
+    }
+    ble_addr_t list[SCAN_TARGET_MAX];
+    count = min(count, (uint8_t)SCAN_TARGET_MAX);
+    for (uint8_t i = 0; i < count; i++) {
+        list[i].type = (addr_types[i] & 0x01) ? BLE_ADDR_RANDOM : BLE_ADDR_PUBLIC;
+        for (uint8_t b = 0; b < 6; b++) {
+            list[i].val[b] = addrs[i][5 - b];
+        }
+    }
+    return ble_gap_wl_set(list, count) == 0;
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* ble_backend_name(void) {
+    return "nimble";
+}
+
+/**
+ * @brief Discover until cancelled, no duplicate filtering
+ */
+static int start_discovery(void) {
+#if EXTENDED_DISCOVERY
+    return ble_gap_ext_disc(BLE_OWN_ADDR_PUBLIC, 0, 0, 0, filter_policy, 0,
+                            &uncoded_params, BLE_SCAN_CODED_PHY ? &coded_params : NULL,
+                            gap_event, NULL);
+#else
+    return ble_gap_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER, &disc_params, gap_event, NULL);
+#endif
+}
+
+/**
+ * @brief Addresses arrive least significant byte first
+ */
+static inline void IRAM_ATTR copy_addr(uint8_t* out, const ble_addr_t* addr) {
+    for (uint8_t i = 0; i < 6; i++) {
+        out[i] = addr->val[5 - i];
+    }
+}
+
+/**
+ * @brief GAP callback - runs in the NimBLE host task
+ */
+static int IRAM_ATTR gap_event(struct ble_gap_event* event, void* arg) {
+    switch (event->type) {
+#if EXTENDED_DISCOVERY
+        case BLE_GAP_EVENT_EXT_DISC: {
+            const struct ble_gap_ext_disc_desc* desc = &event->ext_disc;
+            uint8_t addr[6];
+            copy_addr(addr, &desc->addr);
+
+            // Fold the head of a fragmented advertisement only
+            bool chained = in_chain && memcmp(addr, chain_addr, sizeof(addr)) == 0;
+            if (desc->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+                if (chained) {
+                    return 0;
+                }
+                in_chain = true;
+                memcpy(chain_addr, addr, sizeof(addr));
+            } else if (chained) {
+                in_chain = false;
+                return 0;
+            }
+
+            uint8_t kind = BLE_ADV_KIND_LEGACY;
+            if ((desc->props & BLE_HCI_ADV_LEGACY_MASK) == 0) {
+                kind |= BLE_ADV_KIND_EXTENDED;
+            }
+            if (desc->prim_phy == BLE_HCI_LE_PHY_CODED) {
+                kind |= BLE_ADV_KIND_CODED;
+            }
+            ble_scan_fold(addr, desc->addr.type, desc->rssi, desc->data, desc->length_data, kind);
+            return 0;
+        }
+#else
+        case BLE_GAP_EVENT_DISC: {
+            const struct ble_gap_disc_desc* desc = &event->disc;
+            uint8_t addr[6];
+            copy_addr(addr, &desc->addr);
+            ble_scan_fold(addr, desc->addr.type, desc->rssi, desc->data, desc->length_data,
+                          BLE_ADV_KIND_LEGACY);
+            return 0;
+        }
+#endif
+
+        case BLE_GAP_EVENT_DISC_COMPLETE:
+            // Only a controller-side stop ends a discovery without a duration
+            if (running) {
+                start_discovery();
+            }
+            return 0;
+
+        default:
+            return 0;
+    }
+}
+
+#endif // BLE_SCAN_BACKEND == BLE_BACKEND_NIMBLE
@@ -0,0 +1,242 @@
+/**
+ * @file ble_duty.cpp
+ * @brief BLE scan duty cycle chosen by how many devices it still hears
+ *
+ * The observer scan listens for BLE_SCAN_WINDOW of every BLE_SCAN_INTERVAL
+ * and sends scan requests, which is the most it can hear and the most it
+ * can draw. Every BLE_DUTY_REEVAL_MS a reference trial listens that way
+ * for BLE_DUTY_TRIAL_MS and counts the devices heard. Cheaper candidates,
+ * shorter windows and passive listening, are then tried in order of cost
+ * for as long, and the first to hear BLE_DUTY_COVERAGE_PCT of the
+ * reference's devices is kept until the next evaluation. With too few
+ * devices around to tell, the settings in force are kept.
+ *
+ * The trials follow one another, so devices that come and go between them
+ * count against the candidate; a trial the scan is paused during, for a
+ * capture burst, is started over.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "ble_duty.h"
+#include "ble_scan.h"
+#include "logger.h"
+
+#define REFERENCE_PCT   ((uint8_t)(BLE_SCAN_WINDOW * 100 / BLE_SCAN_INTERVAL))
+
+/**
+ * @brief One setting to try
+ */
+typedef struct {
+    uint8_t window_pct;
+    bool    passive;
+} candidate_t;
+
+static const uint8_t candidate_pcts[] = { 10, 25, 50, 75, 99 };
+#define CANDIDATE_COUNT (sizeof(candidate_pcts) / sizeof(candidate_pcts[0]) * 2)
+
+// System task
+static candidate_t candidates[CANDIDATE_COUNT];     // Cheapest first
+static uint8_t next_candidate = 0;
+static candidate_t applied;                         // Kept outside trials
+static candidate_t trying;
+static uint32_t trial_start_ms = 0;
+static uint32_t trial_adverts = 0;
+static uint32_t trial_pauses = 0;
+static uint32_t evaluated_ms = 0;
+static bool evaluated = false;
+
+// Shared
+static ble_duty_stats_t stats;
+static portMUX_TYPE duty_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const phase_names[BLE_DUTY_PHASE_COUNT] = {
+    "settled", "reference", "trial"
+};
+
+// Forward declarations
+static uint32_t cost_of(const candidate_t* candidate);
+static void start_trial(ble_duty_phase_t phase, const candidate_t* candidate, uint32_t now_ms);
+static bool start_next_candidate(uint32_t now_ms);
+static void settle(const candidate_t* candidate, uint8_t coverage_pct, uint32_t now_ms);
+
+/**
+ * @brief Start from the configured window, active unless passive only
+ */
+void ble_duty_init(void) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < sizeof(candidate_pcts); i++) {
+        candidates[count++] = { candidate_pcts[i], true };
+        candidates[count++] = { candidate_pcts[i], false };
+    }
+    // Insertion sort by cost; ten entries
+    for (uint8_t i = 1; i < CANDIDATE_COUNT; i++) {
+        candidate_t key = candidates[i];
+        int8_t j = i - 1;
+        while (j >= 0 && cost_of(&candidates[j]) > cost_of(&key)) {
+            candidates[j + 1] = candidates[j];
+            j--;
+        }
+        candidates[j + 1] = key;
+    }
+
+    applied = { REFERENCE_PCT, ble_scan_passive_only() };
+    evaluated = false;
+    portENTER_CRITICAL(&duty_mux);
+    memset(&stats, 0, sizeof(stats));
+    stats.phase = BLE_DUTY_SETTLED;
+    stats.window_pct = applied.window_pct;
+    stats.passive = applied.passive;
+    portEXIT_CRITICAL(&duty_mux);
+}
+
+/**
+ * @brief Finish a trial once BLE_DUTY_TRIAL_MS has passed and start the next
+ */
+void ble_duty_tick(uint32_t now_ms) {
+    portENTER_CRITICAL(&duty_mux);
+    ble_duty_phase_t phase = (ble_duty_phase_t)stats.phase;
+    portEXIT_CRITICAL(&duty_mux);
+
+    if (phase == BLE_DUTY_SETTLED) {
+        if (!evaluated || now_ms - evaluated_ms >= BLE_DUTY_REEVAL_MS) {
+            candidate_t reference = { REFERENCE_PCT, ble_scan_passive_only() };
+            start_trial(BLE_DUTY_REFERENCE, &reference, now_ms);
+        }
+        return;
+    }
+
+    // A pause leaves the trial short of listening time
+    if (ble_scan_pauses() != trial_pauses) {
+        portENTER_CRITICAL(&duty_mux);
+        stats.restarts++;
+        portEXIT_CRITICAL(&duty_mux);
+        start_trial(phase, &trying, now_ms);
+        return;
+    }
+    if (now_ms - trial_start_ms < BLE_DUTY_TRIAL_MS) {
+        return;
+    }
+
+    uint32_t adverts = 0;
+    uint16_t devices = ble_scan_heard_since(trial_start_ms, &adverts);
+    uint16_t adv_per_s = (uint16_t)min((adverts - trial_adverts) * 1000 / (now_ms - trial_start_ms),
+                                       (uint32_t)UINT16_MAX);
+
+    portENTER_CRITICAL(&duty_mux);
+    stats.trials++;
+    stats.devices = devices;
+    stats.adv_per_s = adv_per_s;
+    if (phase == BLE_DUTY_REFERENCE) {
+        stats.reference_devices = devices;
+        stats.reference_adv_per_s = adv_per_s;
+    }
+    uint16_t reference_devices = stats.reference_devices;
+    portEXIT_CRITICAL(&duty_mux);
+
+    if (phase == BLE_DUTY_REFERENCE) {
+        if (devices < BLE_DUTY_MIN_DEVICES) {
+            LOGD(SCAN, "BLE duty: %u devices at full duty, keeping %u%% %s",
+                 devices, applied.window_pct, applied.passive ? "passive" : "active");
+            settle(&applied, 100, now_ms);
+            return;
+        }
+        next_candidate = 0;
+        if (!start_next_candidate(now_ms)) {
+            settle(&trying, 100, now_ms);
+        }
+        return;
+    }
+
+    uint8_t coverage = (uint8_t)min((uint32_t)devices * 100 / reference_devices, (uint32_t)100);
+    if (coverage >= BLE_DUTY_COVERAGE_PCT) {
+        settle(&trying, coverage, now_ms);
+    } else if (!start_next_candidate(now_ms)) {
+        candidate_t reference = { REFERENCE_PCT, ble_scan_passive_only() };
+        settle(&reference, 100, now_ms);
+    }
+}
+
+/**
+ * @brief Copy the settings in force and the last evaluation's figures
+ */
+void ble_duty_get_stats(ble_duty_stats_t* out) {
+    portENTER_CRITICAL(&duty_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&duty_mux);
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* ble_duty_phase_name(ble_duty_phase_t phase) {
+    return phase < BLE_DUTY_PHASE_COUNT ? phase_names[phase] : "?";
+}
+
+/**
+ * @brief Relative draw: window share, with scan requests and responses on top
+ */
+static uint32_t cost_of(const candidate_t* candidate) {
+    return (uint32_t)candidate->window_pct * (candidate->passive ? 100 : BLE_DUTY_ACTIVE_COST_PCT);
+}
+
+/**
+ * @brief Apply a setting and count from now
+ */
+static void start_trial(ble_duty_phase_t phase, const candidate_t* candidate, uint32_t now_ms) {
+    trying = *candidate;
+    ble_scan_set_duty(trying.window_pct, trying.passive);
+    trial_start_ms = now_ms;
+    ble_scan_heard_since(now_ms, &trial_adverts);
+    trial_pauses = ble_scan_pauses();
+    portENTER_CRITICAL(&duty_mux);
+    stats.phase = (uint8_t)phase;
+    stats.window_pct = trying.window_pct;
+    stats.passive = trying.passive;
+    portEXIT_CRITICAL(&duty_mux);
+}
+
+/**
+ * @brief Try the next candidate cheaper than the reference
+ * @return false once none is left
+ */
+static bool start_next_candidate(uint32_t now_ms) {
+    candidate_t reference = { REFERENCE_PCT, ble_scan_passive_only() };
+    while (next_candidate < CANDIDATE_COUNT) {
+        const candidate_t* candidate = &candidates[next_candidate++];
+        if (cost_of(candidate) >= cost_of(&reference)) {
+            return false;
+        }
+        if (!candidate->passive && reference.passive) {
+            continue;               // Scan requests are ruled out
+        }
+        start_trial(BLE_DUTY_TRIAL, candidate, now_ms);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Keep a setting until the next evaluation
+ */
+static void settle(const candidate_t* candidate, uint8_t coverage_pct, uint32_t now_ms) {
+    bool changed = candidate->window_pct != applied.window_pct || candidate->passive != applied.passive;
+    applied = *candidate;
+    ble_scan_set_duty(applied.window_pct, applied.passive);
+    evaluated = true;
+    evaluated_ms = now_ms;
+    portENTER_CRITICAL(&duty_mux);
+    stats.phase = BLE_DUTY_SETTLED;
+    stats.window_pct = applied.window_pct;
+    stats.passive = applied.passive;
+    stats.coverage_pct = coverage_pct;
+    stats.evaluations++;
+    uint16_t reference_devices = stats.reference_devices;
+    portEXIT_CRITICAL(&duty_mux);
+
+    if (changed) {
+        LOGI(SCAN, "📶 BLE duty %u%% %s, %u%% of %u devices",
+             applied.window_pct, applied.passive ? "passive" : "active", coverage_pct, reference_devices);
+    }
+}
@@ -0,0 +1,381 @@
+/**
+ * @file ble_scan.cpp
+ * @brief Continuous BLE observer scan with callback-side aggregation
+ *
+ * Advertisements are taken straight from the GAP callback parameters and
+ * folded into a fixed table of compact records. The Arduino BLEScan object
+ * is never created, so no BLEAdvertisedDevice copies or result lists exist.
+ * The callback and the fold run from IRAM over records in DRAM, so their
+ * latency does not depend on what the flash cache holds.
+ *
+ * The host stack is behind ble_backend.h: Bluedroid's legacy observer, or
+ * NimBLE's extended scan, which also hears BLE 5 extended advertising and
+ * the coded PHY. Either feeds ble_scan_fold().
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
+#include "config.h"
+#include "ble_scan.h"
+#include "ble_backend.h"
+#include "ble_adv_parser.h"
+#include "alloc_trace.h"
+#include "energy.h"
+#include "logger.h"
+
+// Record table, written by the GAP callback
+static ble_record_t ble_records[BLE_RECORD_CAPACITY];
+static bool record_used[BLE_RECORD_CAPACITY];
+static portMUX_TYPE records_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t adv_total = 0;
+static uint32_t adv_extended = 0;
+static uint32_t adv_coded = 0;
+static uint32_t dropped_total = 0;
+static bool scan_started = false;
+static volatile bool scan_paused = false;
+static bool passive_only = false;
+static uint32_t pause_count = 0;
+
+static ble_backend_params_t scan_params = {
+    BLE_MS_TO_UNITS(BLE_SCAN_INTERVAL),
+    BLE_MS_TO_UNITS(BLE_SCAN_WINDOW),
+    false,
+    false
+};
+
+// Forward declarations
+static void IRAM_ATTR fold_advertisement(const uint8_t addr[6], uint8_t addr_type, int8_t rssi,
+                                         const uint8_t* data, uint8_t len, uint8_t kind);
+
+/**
+ * @brief Release classic BT's memory and ready the controller for BLE only
+ */
+bool ble_scan_prepare(void) {
+    return ble_backend_prepare();
+}
+
+/**
+ * @brief Bring up the BLE stack and start a continuous observer scan
+ */
+bool ble_scan_init(void) {
+    memset(record_used, 0, sizeof(record_used));
+
+    if (!ble_backend_init()) {
+        LOGE(SCAN, "❌ BLE host (%s) failed to start", ble_backend_name());
+        return false;
+    }
+    if (!ble_backend_start(&scan_params)) {
+        LOGE(SCAN, "❌ BLE scan parameter setup failed");
+        return false;
+    }
+
+    energy_set_active(ENERGY_LOAD_BLE_SCAN, true);
+    scan_started = true;
+    LOGI(SCAN, "✅ BLE continuous scan initialized (%s)", ble_backend_name());
+    return true;
+}
+
+/**
+ * @brief Listen only from the next parameter setup on
+ */
+void ble_scan_set_passive(void) {
+    scan_params.passive = true;
+    passive_only = true;
+}
+
+/**
+ * @brief Whether scan requests were ruled out by ble_scan_set_passive()
+ */
+bool ble_scan_passive_only(void) {
+    return passive_only;
+}
+
+/**
+ * @brief Listen for a share of each interval, actively or not, from now on
+ */
+bool ble_scan_set_duty(uint8_t window_pct, bool passive) {
+    window_pct = constrain(window_pct, 1, 100);
+    uint16_t interval = BLE_MS_TO_UNITS(BLE_SCAN_INTERVAL);
+    // The controller takes a window of at least 4 units and no longer than the interval
+    uint16_t window = max((uint16_t)((uint32_t)interval * window_pct / 100), (uint16_t)4);
+    passive = passive || passive_only;
+    if (window == scan_params.window_units && passive == scan_params.passive) {
+        return true;
+    }
+    scan_params.window_units = window;
+    scan_params.passive = passive;
+    energy_set_duty(ENERGY_LOAD_BLE_SCAN, (uint8_t)((uint32_t)window * 100 / interval));
+    if (!scan_started || scan_paused) {
+        return true;                // Taken up when the scan starts or resumes
+    }
+    return ble_backend_start(&scan_params);
+}
+
+/**
+ * @brief Devices and advertisements heard since a point in time
+ */
+uint16_t ble_scan_heard_since(uint32_t since_ms, uint32_t* adverts_total) {
+    uint16_t count = 0;
+    portENTER_CRITICAL(&records_lock);
+    for (uint16_t i = 0; i < BLE_RECORD_CAPACITY; i++) {
+        if (record_used[i] && (int32_t)(ble_records[i].last_seen_ms - since_ms) >= 0) {
+            count++;
+        }
+    }
+    if (adverts_total != NULL) {
+        *adverts_total = adv_total;
+    }
+    portEXIT_CRITICAL(&records_lock);
+    return count;
+}
+
+/**
+ * @brief Times the scan has been paused since boot
+ */
+uint32_t ble_scan_pauses(void) {
+    return pause_count;
+}
+
+/**
+ * @brief Stop the observer scan and set the parameters again, which restarts it
+ */
+bool ble_scan_restart(void) {
+    if (scan_paused) {
+        return true;                // Resumed with the parameters set again
+    }
+    ble_backend_stop();
+    return ble_backend_start(&scan_params);
+}
+
+/**
+ * @brief Hear only the given addresses, or everyone again with count 0
+ */
+bool ble_scan_set_whitelist(const uint8_t (*addrs)[6], const uint8_t* addr_types, uint8_t count) {
+    if (!scan_started) {
+        return false;
+    }
+    // The controller's list cannot change under a running scan
+    if (!scan_paused) {
+        ble_backend_stop();
+    }
+    bool ok = ble_backend_set_whitelist(addrs, addr_types, count);
+    scan_params.whitelist_only = ok && count > 0;
+    pause_count++;                  // Counts heard from here on are not the open scan's
+    if (scan_paused) {
+        return ok;
+    }
+    return ble_backend_start(&scan_params) && ok;
+}
+
+/**
+ * @brief Latest of one device's record
+ */
+bool ble_scan_lookup(const uint8_t addr[6], ble_sighting_t* out, uint8_t* addr_type) {
+    bool found = false;
+    portENTER_CRITICAL(&records_lock);
+    for (uint16_t i = 0; i < BLE_RECORD_CAPACITY; i++) {
+        const ble_record_t* record = &ble_records[i];
+        if (record_used[i] && memcmp(record->addr, addr, sizeof(record->addr)) == 0) {
+            memcpy(out->addr, record->addr, sizeof(out->addr));
+            out->rssi = record->rssi_last;
+            out->fresh = 0;
+            out->last_seen_ms = record->last_seen_ms;
+            out->last_seen_us = record->last_seen_us;
+            if (addr_type != NULL) {
+                *addr_type = record->addr_type;
+            }
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&records_lock);
+    return found;
+}
+
+/**
+ * @brief Stop the observer scan, or resume it by setting the parameters again
+ */
+bool ble_scan_pause(bool paused) {
+    if (!scan_started || paused == scan_paused) {
+        return true;
+    }
+    scan_paused = paused;
+    energy_set_active(ENERGY_LOAD_BLE_SCAN, !paused);
+    if (paused) {
+        pause_count++;
+        return ble_backend_stop();
+    }
+    return ble_backend_start(&scan_params);
+}
+
+/**
+ * @brief Summarize devices heard within BLE_RECORD_TTL_MS
+ */
+void ble_scan_get_summary(ble_scan_summary_t* summary) {
+    if (summary == NULL) {
+        return;
+    }
+
+    uint32_t now = millis();
+    uint16_t count = 0;
+    int32_t rssi_sum_x16 = 0;
+    memset(summary->class_counts, 0, sizeof(summary->class_counts));
+
+    portENTER_CRITICAL(&records_lock);
+    for (uint16_t i = 0; i < BLE_RECORD_CAPACITY; i++) {
+        if (record_used[i] && now - ble_records[i].last_seen_ms <= BLE_RECORD_TTL_MS) {
+            rssi_sum_x16 += ble_records[i].rssi_ewma_x16;
+            summary->class_counts[ble_records[i].device_class]++;
+            count++;
+        }
+    }
+    summary->adv_total = adv_total;
+    summary->adv_extended = adv_extended;
+    summary->adv_coded = adv_coded;
+    summary->dropped_total = dropped_total;
+    portEXIT_CRITICAL(&records_lock);
+
+    summary->device_count = count;
+    summary->avg_rssi = count > 0 ? (int16_t)((rssi_sum_x16 / count) >> 4) : -100;
+}
+
+/**
+ * @brief Write recently heard devices into the caller's slots
+ */
+uint16_t ble_scan_take_sightings(ble_sighting_t* out, uint16_t capacity, uint32_t since_ms) {
+    if (out == NULL) {
+        return 0;
+    }
+
+    uint32_t now = millis();
+    uint16_t written = 0;
+    portENTER_CRITICAL(&records_lock);
+    for (uint16_t i = 0; i < BLE_RECORD_CAPACITY && written < capacity; i++) {
+        const ble_record_t* record = &ble_records[i];
+        bool fresh = (int32_t)(record->last_seen_ms - since_ms) >= 0;
+        if (!record_used[i] || (!fresh && now - record->last_seen_ms > BLE_RECORD_TTL_MS)) {
+            continue;
+        }
+        ble_sighting_t* sighting = &out[written++];
+        memcpy(sighting->addr, record->addr, sizeof(sighting->addr));
+        sighting->rssi = (int8_t)(record->rssi_ewma_x16 >> 4);
+        sighting->fresh = fresh;
+        sighting->last_seen_ms = record->last_seen_ms;
+        sighting->last_seen_us = record->last_seen_us;
+    }
+    portEXIT_CRITICAL(&records_lock);
+    return written;
+}
+
+/**
+ * @brief Release records not heard within BLE_RECORD_TTL_MS
+ */
+uint16_t ble_scan_expire(void) {
+    uint32_t now = millis();
+    uint16_t released = 0;
+
+    portENTER_CRITICAL(&records_lock);
+    for (uint16_t i = 0; i < BLE_RECORD_CAPACITY; i++) {
+        if (record_used[i] && now - ble_records[i].last_seen_ms > BLE_RECORD_TTL_MS) {
+            record_used[i] = false;
+            released++;
+        }
+    }
+    portEXIT_CRITICAL(&records_lock);
+    return released;
+}
+
+/**
+ * @brief Fold one advertising report into its device record; backends call this
+ */
+void IRAM_ATTR ble_scan_fold(const uint8_t addr[6], uint8_t addr_type, int8_t rssi,
+                             const uint8_t* data, uint8_t len, uint8_t kind) {
+    ALLOC_TRACE_BEGIN(ALLOC_CYCLE_BLE_ADVERT);
+    fold_advertisement(addr, addr_type, rssi, data, len, kind);
+    ALLOC_TRACE_END(ALLOC_CYCLE_BLE_ADVERT);
+}
+
+/**
+ * @brief Fold one advertisement into its device record
+ */
+static void IRAM_ATTR fold_advertisement(const uint8_t addr[6], uint8_t addr_type, int8_t rssi,
+                                         const uint8_t* data, uint8_t len, uint8_t kind) {
+    ble_adv_info_t info;
+    ble_adv_parse(data, len, &info);
+    uint8_t device_class = (uint8_t)ble_adv_classify(&info);
+
+    uint32_t now = millis();
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+    int16_t free_slot = -1;
+    int16_t oldest_slot = -1;
+
+    portENTER_CRITICAL(&records_lock);
+    adv_total++;
+    if (kind & BLE_ADV_KIND_EXTENDED) {
+        adv_extended++;
+    }
+    if (kind & BLE_ADV_KIND_CODED) {
+        adv_coded++;
+    }
+
+    for (uint16_t i = 0; i < BLE_RECORD_CAPACITY; i++) {
+        if (!record_used[i]) {
+            if (free_slot < 0) {
+                free_slot = i;
+            }
+            continue;
+        }
+
+        ble_record_t* record = &ble_records[i];
+        if (memcmp(record->addr, addr, sizeof(record->addr)) == 0) {
+            record->rssi_ewma_x16 += ((int16_t)(rssi * 16) - record->rssi_ewma_x16) >> BLE_RSSI_EWMA_SHIFT;
+            record->rssi_last = rssi;
+            record->last_seen_ms = now;
+            record->last_seen_us = now_us;
+            record->adv_count++;
+            record->adv_flags |= info.flags;
+            if (info.name_hash != 0) {
+                record->name_hash = info.name_hash;
+            }
+            // Scan responses may reveal a class the advert alone did not
+            if (device_class != BLE_CLASS_UNKNOWN) {
+                record->device_class = device_class;
+            }
+            portEXIT_CRITICAL(&records_lock);
+            return;
+        }
+
+        if (oldest_slot < 0 || record->last_seen_ms < ble_records[oldest_slot].last_seen_ms) {
+            oldest_slot = i;
+        }
+    }
+
+    // New device: take a free slot, or recycle one that has gone stale
+    int16_t slot = free_slot;
+    if (slot < 0 && oldest_slot >= 0 &&
+        now - ble_records[oldest_slot].last_seen_ms > BLE_RECORD_TTL_MS) {
+        slot = oldest_slot;
+    }
+
+    if (slot < 0) {
+        dropped_total++;
+        portEXIT_CRITICAL(&records_lock);
+        return;
+    }
+
+    ble_record_t* record = &ble_records[slot];
+    memcpy(record->addr, addr, sizeof(record->addr));
+    record->addr_type = addr_type;
+    record->adv_flags = info.flags;
+    record->rssi_ewma_x16 = (int16_t)(rssi * 16);
+    record->rssi_last = rssi;
+    record->device_class = device_class;
+    record->name_hash = info.name_hash;
+    record->first_seen_ms = now;
+    record->last_seen_ms = now;
+    record->last_seen_us = now_us;
+    record->adv_count = 1;
+    record_used[slot] = true;
+    portEXIT_CRITICAL(&records_lock);
+}
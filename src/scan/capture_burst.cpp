@@ -0,0 +1,136 @@
+/**
+ * @file capture_burst.cpp
+ * @brief Short bursts of capture on one channel after a detection
+ *
+ * A rogue access point pattern or a commit to EXCITED is most worth
+ * recording in the seconds that follow it, and the normal schedule spends
+ * those seconds hopping away and sweeping BLE. A burst holds the radio on
+ * the channel of interest for CAPTURE_BURST_MS instead: the hopper parks
+ * there, the capture task drains its ring every CAPTURE_BURST_DRAIN_MS,
+ * card writes start sooner and keep the bus, the BLE observer is stopped
+ * and the scan task holds its WiFi sweeps. Everyone reads the burst by
+ * its end time, so it ends on its own.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "capture_burst.h"
+#include "channel_hopper.h"
+#include "logger.h"
+
+static capture_burst_stats_t stats;
+static uint32_t started_ms = 0;
+static uint32_t until_ms = 0;       // End of the burst in force or the last, 0 before the first
+static portMUX_TYPE burst_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const reason_names[CAPTURE_BURST_REASON_COUNT] = {
+    "anomaly", "excited"
+};
+
+// Forward declarations
+static bool in_force(uint32_t now_ms);
+
+/**
+ * @brief Hold the capture on one channel for CAPTURE_BURST_MS
+ */
+bool capture_burst_trigger(capture_burst_reason_t reason, uint8_t channel, uint32_t now_ms) {
+    if (reason >= CAPTURE_BURST_REASON_COUNT) {
+        return false;
+    }
+#if CHANNEL_HOPPING_ENABLED
+    if (channel == 0 || channel > WIFI_CHANNEL_COUNT) {
+        hopper_stats_t hops;
+        hopper_get_stats(&hops);
+        channel = hops.busiest_channel;
+    }
+#else
+    // Nothing parks the radio without the hopper
+    return false;
+#endif
+
+    bool started = false;
+    bool extended = false;
+    portENTER_CRITICAL(&burst_mux);
+    if (in_force(now_ms)) {
+        uint32_t limit = started_ms + CAPTURE_BURST_MAX_MS;
+        uint32_t until = now_ms + CAPTURE_BURST_MS;
+        if (channel == stats.channel && (int32_t)(limit - until) < 0) {
+            until = limit;
+        }
+        if (channel == stats.channel && (int32_t)(until - until_ms) > 0) {
+            stats.burst_ms += until - until_ms;
+            until_ms = until;
+            stats.extended++;
+            extended = true;
+        } else {
+            stats.suppressed++;
+        }
+    } else if (until_ms != 0 && now_ms - until_ms < CAPTURE_BURST_COOLDOWN_MS) {
+        stats.suppressed++;
+    } else {
+        started_ms = now_ms;
+        until_ms = now_ms + CAPTURE_BURST_MS;
+        if (until_ms == 0) {
+            until_ms = 1;
+        }
+        stats.channel = channel;
+        stats.reason = (uint8_t)reason;
+        stats.bursts[reason]++;
+        stats.burst_ms += CAPTURE_BURST_MS;
+        started = true;
+    }
+    portEXIT_CRITICAL(&burst_mux);
+
+    if (started) {
+        LOGI(CAPTURE, "🎯 Capture burst on channel %u (%s) for %lums",
+             channel, reason_names[reason], (unsigned long)CAPTURE_BURST_MS);
+    }
+    return started || extended;
+}
+
+/**
+ * @brief Channel of the burst in force, 0 with none
+ */
+uint8_t capture_burst_channel(uint32_t now_ms) {
+    portENTER_CRITICAL(&burst_mux);
+    uint8_t channel = in_force(now_ms) ? stats.channel : 0;
+    portEXIT_CRITICAL(&burst_mux);
+    return channel;
+}
+
+/**
+ * @brief Whether a burst is in force
+ */
+bool capture_burst_active(uint32_t now_ms) {
+    return capture_burst_channel(now_ms) != 0;
+}
+
+/**
+ * @brief Copy the burst figures
+ */
+void capture_burst_get_stats(capture_burst_stats_t* out) {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&burst_mux);
+    *out = stats;
+    out->active = in_force(now);
+    out->remaining_ms = out->active ? until_ms - now : 0;
+    portEXIT_CRITICAL(&burst_mux);
+    if (!out->active) {
+        out->channel = 0;
+    }
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* capture_burst_reason_name(capture_burst_reason_t reason) {
+    return reason < CAPTURE_BURST_REASON_COUNT ? reason_names[reason] : "?";
+}
+
+/**
+ * @brief Whether the last burst has yet to end; call with burst_mux held
+ */
+static bool in_force(uint32_t now_ms) {
+    return until_ms != 0 && (int32_t)(until_ms - now_ms) > 0;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file channel_hopper.cpp
+ * @brief Adaptive-dwell channel hopping for the promiscuous capture mode
+ *
+ * Each channel keeps an EWMA of the frame rate measured while the radio was
+ * parked on it. Dwell time scales with that score between HOP_MIN_DWELL_MS
+ * and HOP_MAX_DWELL_MS, so empty channels are only sampled briefly while
+ * busy channels get most of the airtime.
+ *
+ * A capture burst parks the radio on its channel, ahead of the dwell,
+ * until it ends; the time parked is not scored.
+ */
+
+#include <Arduino.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "channel_hopper.h"
+#include "packet_capture.h"
+#include "wifi_scan.h"
+#include "wifi_link.h"
+#include "capture_burst.h"
+#include "airtime.h"
+
+// Per-channel state, index = channel number
+static uint16_t score_fps[WIFI_CHANNEL_COUNT + 1];
+static uint16_t dwell_ms[WIFI_CHANNEL_COUNT + 1];
+
+static uint8_t current_channel = 1;
+static uint32_t dwell_started_ms = 0;
+static uint32_t frames_at_dwell_start = 0;
+static uint32_t hops_total = 0;
+static uint32_t hops_deferred = 0;
+static portMUX_TYPE hopper_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void update_dwell_times(void);
+#if CAPTURE_BURST_ENABLED
+static bool park_on_burst(uint8_t channel, uint32_t now_ms);
+#endif
+
+/**
+ * @brief Reset channel scores and tune to channel 1
+ */
+void hopper_init(void) {
+    memset(score_fps, 0, sizeof(score_fps));
+    for (uint8_t ch = 0; ch <= WIFI_CHANNEL_COUNT; ch++) {
+        dwell_ms[ch] = HOP_MIN_DWELL_MS;
+    }
+
+    current_channel = 1;
+    esp_wifi_set_channel(current_channel, WIFI_SECOND_CHAN_NONE);
+    dwell_started_ms = millis();
+    airtime_note_channel(current_channel, dwell_started_ms);
+    frames_at_dwell_start = capture_channel_frames(current_channel);
+    hops_total = hops_deferred = 0;
+}
+
+/**
+ * @brief Hop once the dwell on the current channel has elapsed
+ */
+bool hopper_tick(uint32_t now_ms) {
+#if CAPTURE_BURST_ENABLED
+    uint8_t burst = capture_burst_channel(now_ms);
+    if (burst != 0 && !wifi_scan_in_progress()) {
+        return park_on_burst(burst, now_ms);
+    }
+#endif
+
+    uint32_t elapsed = now_ms - dwell_started_ms;
+    if (elapsed < dwell_ms[current_channel]) {
+        return false;
+    }
+
+    // The scan engine owns the radio while an active scan is in flight
+    if (wifi_scan_in_progress()) {
+        hops_deferred++;
+        return false;
+    }
+
+#if WIFI_LINK_ENABLED
+    // An association holds the radio on the access point's channel
+    uint8_t home = wifi_link_home_channel();
+    if (home != 0) {
+        if (home != current_channel) {
+            current_channel = home;
+            frames_at_dwell_start = capture_channel_frames(current_channel);
+            airtime_note_channel(current_channel, now_ms);
+        }
+        dwell_started_ms = now_ms;
+        hops_deferred++;
+        return false;
+    }
+#endif
+
+    // Score the channel we are leaving
+    uint32_t frames = capture_channel_frames(current_channel) - frames_at_dwell_start;
+    int32_t fps = (int32_t)(frames * 1000 / (elapsed > 0 ? elapsed : 1));
+    int32_t delta = fps - score_fps[current_channel];
+
+    portENTER_CRITICAL(&hopper_lock);
+    score_fps[current_channel] = (uint16_t)(score_fps[current_channel] + (delta >> HOP_SCORE_EWMA_SHIFT));
+    if (delta > 0 && score_fps[current_channel] == 0) {
+        score_fps[current_channel] = 1;
+    }
+    update_dwell_times();
+    portEXIT_CRITICAL(&hopper_lock);
+
+    uint8_t next = current_channel >= WIFI_CHANNEL_COUNT ? 1 : current_channel + 1;
+    if (esp_wifi_set_channel(next, WIFI_SECOND_CHAN_NONE) != ESP_OK) {
+        hops_deferred++;
+        dwell_started_ms = now_ms;
+        frames_at_dwell_start = capture_channel_frames(current_channel);
+        return false;
+    }
+
+    current_channel = next;
+    airtime_note_channel(current_channel, now_ms);
+    dwell_started_ms = now_ms;
+    frames_at_dwell_start = capture_channel_frames(current_channel);
+    hops_total++;
+    return true;
+}
+
+/**
+ * @brief Copy the current hopper statistics
+ */
+void hopper_get_stats(hopper_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&hopper_lock);
+    stats->current_channel = current_channel;
+    stats->hops_total = hops_total;
+    stats->hops_deferred = hops_deferred;
+    memcpy(stats->dwell_ms, dwell_ms, sizeof(stats->dwell_ms));
+    memcpy(stats->score_fps, score_fps, sizeof(stats->score_fps));
+    portEXIT_CRITICAL(&hopper_lock);
+
+    stats->busiest_channel = 1;
+    stats->busiest_channel_fps = 0;
+    for (uint8_t ch = 1; ch <= WIFI_CHANNEL_COUNT; ch++) {
+        if (stats->score_fps[ch] > stats->busiest_channel_fps) {
+            stats->busiest_channel = ch;
+            stats->busiest_channel_fps = stats->score_fps[ch];
+        }
+    }
+}
+
+#if CAPTURE_BURST_ENABLED
+/**
+ * @brief Hold the radio on a burst's channel, restarting the dwell each tick
+ *
+ * An association keeps the radio on its home channel; the burst listens there.
+ */
+static bool park_on_burst(uint8_t channel, uint32_t now_ms) {
+#if WIFI_LINK_ENABLED
+    uint8_t home = wifi_link_home_channel();
+    if (home != 0) {
+        current_channel = home;
+        channel = home;
+        airtime_note_channel(current_channel, now_ms);
+    }
+#endif
+    bool retuned = false;
+    if (channel != current_channel) {
+        if (esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE) != ESP_OK) {
+            hops_deferred++;
+            return false;
+        }
+        current_channel = channel;
+        airtime_note_channel(current_channel, now_ms);
+        hops_total++;
+        retuned = true;
+    }
+    dwell_started_ms = now_ms;
+    frames_at_dwell_start = capture_channel_frames(current_channel);
+    return retuned;
+}
+#endif
+
+/**
+ * @brief Scale every channel's dwell by its share of the top score
+ */
+static void update_dwell_times(void) {
+    uint16_t top = 0;
+    for (uint8_t ch = 1; ch <= WIFI_CHANNEL_COUNT; ch++) {
+        if (score_fps[ch] > top) {
+            top = score_fps[ch];
+        }
+    }
+
+    for (uint8_t ch = 1; ch <= WIFI_CHANNEL_COUNT; ch++) {
+        uint32_t span = HOP_MAX_DWELL_MS - HOP_MIN_DWELL_MS;
+        dwell_ms[ch] = HOP_MIN_DWELL_MS + (top > 0 ? span * score_fps[ch] / top : 0);
+    }
+}
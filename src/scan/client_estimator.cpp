@@ -0,0 +1,208 @@
+/**
+ * @file client_estimator.cpp
+ * @brief Bounded client table with randomized-MAC bucketing
+ *
+ * Stations with a globally administered MAC are counted by address. Phones
+ * probing with randomized MACs rotate addresses, so a new randomized MAC is
+ * folded into an existing device when its probe fingerprint matches and its
+ * sequence number continues where that device left off shortly before.
+ */
+
+#include <string.h>
+#include "config.h"
+#include "client_estimator.h"
+
+// Information element IDs
+#define IE_SSID         0
+#define IE_RATES        1
+#define IE_DS_PARAMS    3
+#define IE_HT_CAPS      45
+#define IE_EXT_RATES    50
+#define IE_EXT_CAPS     127
+#define IE_VHT_CAPS     191
+
+#define SEQ_MODULO      4096
+
+/**
+ * @brief One estimated client device
+ */
+typedef struct {
+    uint8_t  mac[6];                // Most recent address of the device
+    bool     used;
+    bool     randomized;            // Locally administered address
+    uint32_t ie_hash;               // Probe fingerprint (0 until a probe is seen)
+    uint16_t last_seq;
+    uint16_t reserved;
+    uint32_t last_seen_ms;
+} client_entry_t;
+
+static client_entry_t clients[CAPTURE_CLIENT_SLOTS];
+static uint16_t window_merges = 0;
+
+// Forward declarations
+static int16_t find_by_mac(const uint8_t* mac);
+static int16_t find_rotation(uint32_t ie_hash, uint16_t seq, uint32_t now_ms);
+static int16_t claim_entry(void);
+
+/**
+ * @brief Clear the client table
+ */
+void client_estimator_reset(void) {
+    memset(clients, 0, sizeof(clients));
+    window_merges = 0;
+}
+
+/**
+ * @brief Fingerprint the information elements of a probe request body
+ */
+uint32_t client_estimator_ie_hash(const uint8_t* ies, uint8_t len) {
+    uint32_t hash = 2166136261UL;
+    size_t pos = 0;
+
+    while (pos + 2 <= len) {
+        uint8_t id = ies[pos];
+        uint8_t ie_len = ies[pos + 1];
+        if (pos + 2 + ie_len > len) {
+            break;                  // Truncated or forged length: the rest is not elements
+        }
+
+        if (id != IE_SSID && id != IE_DS_PARAMS) {
+            hash = (hash ^ id) * 16777619UL;
+            hash = (hash ^ ie_len) * 16777619UL;
+
+            bool capability = id == IE_RATES || id == IE_EXT_RATES || id == IE_HT_CAPS ||
+                              id == IE_EXT_CAPS || id == IE_VHT_CAPS;
+            if (capability) {
+                for (size_t i = pos + 2; i < pos + 2 + ie_len; i++) {
+                    hash = (hash ^ ies[i]) * 16777619UL;
+                }
+            }
+        }
+
+        pos += 2 + ie_len;
+    }
+
+    return hash != 0 ? hash : 1;
+}
+
+/**
+ * @brief Record a frame transmitted by a station
+ */
+void client_estimator_observe(const uint8_t* mac, uint16_t seq, uint32_t ie_hash, uint32_t now_ms) {
+    // Group addresses never identify a station
+    if (mac[0] & 0x01) {
+        return;
+    }
+
+    int16_t slot = find_by_mac(mac);
+    bool randomized = (mac[0] & 0x02) != 0;
+
+    if (slot < 0 && randomized && ie_hash != 0 && seq != CLIENT_SEQ_UNKNOWN) {
+        slot = find_rotation(ie_hash, seq, now_ms);
+        if (slot >= 0) {
+            memcpy(clients[slot].mac, mac, sizeof(clients[slot].mac));
+            window_merges++;
+        }
+    }
+
+    if (slot < 0) {
+        slot = claim_entry();
+        client_entry_t* entry = &clients[slot];
+        memcpy(entry->mac, mac, sizeof(entry->mac));
+        entry->used = true;
+        entry->randomized = randomized;
+        entry->ie_hash = 0;
+    }
+
+    client_entry_t* entry = &clients[slot];
+    if (ie_hash != 0) {
+        entry->ie_hash = ie_hash;
+    }
+    if (seq != CLIENT_SEQ_UNKNOWN) {
+        entry->last_seq = seq;
+    }
+    entry->last_seen_ms = now_ms;
+}
+
+/**
+ * @brief Count devices heard within CLIENT_WINDOW_MS and expire old entries
+ */
+void client_estimator_estimate(uint32_t now_ms, client_estimate_t* estimate) {
+    memset(estimate, 0, sizeof(*estimate));
+
+    for (uint16_t i = 0; i < CAPTURE_CLIENT_SLOTS; i++) {
+        client_entry_t* entry = &clients[i];
+        if (!entry->used) {
+            continue;
+        }
+
+        uint32_t age = now_ms - entry->last_seen_ms;
+        if (age > CLIENT_ENTRY_TTL_MS) {
+            entry->used = false;
+            continue;
+        }
+
+        estimate->table_used++;
+        if (age <= CLIENT_WINDOW_MS) {
+            estimate->clients++;
+            if (entry->randomized) {
+                estimate->randomized++;
+            }
+        }
+    }
+
+    estimate->macs_merged = window_merges;
+    window_merges = 0;
+}
+
+/**
+ * @brief Entry currently using a MAC
+ */
+static int16_t find_by_mac(const uint8_t* mac) {
+    for (uint16_t i = 0; i < CAPTURE_CLIENT_SLOTS; i++) {
+        if (clients[i].used && memcmp(clients[i].mac, mac, sizeof(clients[i].mac)) == 0) {
+            return (int16_t)i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Randomized device whose fingerprint and sequence match a new MAC
+ */
+static int16_t find_rotation(uint32_t ie_hash, uint16_t seq, uint32_t now_ms) {
+    int16_t best = -1;
+    uint16_t best_gap = CLIENT_SEQ_MAX_GAP + 1;
+
+    for (uint16_t i = 0; i < CAPTURE_CLIENT_SLOTS; i++) {
+        const client_entry_t* entry = &clients[i];
+        if (!entry->used || !entry->randomized || entry->ie_hash != ie_hash ||
+            now_ms - entry->last_seen_ms > CLIENT_MERGE_MAX_AGE_MS) {
+            continue;
+        }
+
+        // Sequence numbers keep counting across a MAC rotation on most stacks
+        uint16_t gap = (uint16_t)((seq - entry->last_seq) & (SEQ_MODULO - 1));
+        if (gap > 0 && gap < best_gap) {
+            best = (int16_t)i;
+            best_gap = gap;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Free entry, or the stalest one if the table is full
+ */
+static int16_t claim_entry(void) {
+    int16_t oldest = 0;
+    for (uint16_t i = 0; i < CAPTURE_CLIENT_SLOTS; i++) {
+        if (!clients[i].used) {
+            return (int16_t)i;
+        }
+        if (clients[i].last_seen_ms < clients[oldest].last_seen_ms) {
+            oldest = (int16_t)i;
+        }
+    }
+    return oldest;
+}
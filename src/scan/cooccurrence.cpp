@@ -0,0 +1,487 @@
+/**
+ * @file cooccurrence.cpp
+ * @brief Sparse co-occurrence graph of devices, grouped by label propagation
+ *
+ * Devices heard in the same scan cycle are linked by edges whose weight
+ * grows with each cycle they share, by COOC_ARRIVAL_BONUS times more for
+ * devices that arrived together, halves every COOC_HALF_LIFE_CYCLES
+ * without one, and halves again each cycle one is heard without the
+ * other. Co-presence alone would merge a passer-by into the room; arriving
+ * together and being heard apart are what set a person's devices off from
+ * the place they are in. Each node keeps at most COOC_EDGES_PER_NODE edges, the
+ * weakest giving way to a new one, so the graph stays bounded however
+ * crowded the air gets. Nodes are set-associative in pairs: a new device
+ * takes a free way or evicts the one heard least recently, and edges
+ * carry the neighbour's key tag so an edge to an evicted node is known
+ * stale without anyone having to unlink it.
+ *
+ * Label propagation runs on a job worker, COOC_LP_BUDGET nodes per scan
+ * cycle: each node takes the label with the most edge weight among its
+ * neighbours. After each full sweep the active communities are tallied;
+ * one holding an access point, or more devices than a person carries, is
+ * a place, and a small BLE-only one is a person (phone, watch, earbuds).
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "cooccurrence.h"
+#include "job_pool.h"
+#include "logger.h"
+
+#ifdef ESP_PLATFORM
+#include "mem_policy.h"
+#endif
+
+static_assert((COOC_NODES & (COOC_NODES - 1)) == 0, "COOC_NODES must be a power of two");
+static_assert(COOC_NODES <= 65536, "node indices are 16-bit");
+
+/**
+ * @brief One directed edge; its twin lives on the neighbour
+ */
+typedef struct {
+    uint16_t node;                  // Neighbour index
+    uint16_t tag;                   // Low half of the neighbour's key when linked
+    uint16_t weight;                // COOC_EDGE_STEP per shared cycle, 0 for a free edge
+    uint16_t cycle;                 // Cycle the weight was last decayed to
+} cooc_edge_t;
+
+/**
+ * @brief One device and its strongest links
+ */
+typedef struct {
+    uint32_t    key;                // Hash of address and kind, 0 for a free node
+    uint32_t    last_seen_ms;
+    uint16_t    label;              // Community, named after one of its nodes
+    uint16_t    linked_cycle;       // Last cycle it was linked in
+    uint16_t    arrived_cycle;      // First cycle of its current presence
+    uint8_t     kind;               // device_kind_t
+    uint8_t     reserved;
+    cooc_edge_t edges[COOC_EDGES_PER_NODE];
+} cooc_node_t;
+
+/**
+ * @brief Per-label tally of a sweep
+ */
+typedef struct {
+    uint8_t members;
+    uint8_t access_points;
+} cooc_tally_t;
+
+static cooc_node_t* nodes = NULL;
+static cooc_tally_t* tallies = NULL;
+static SemaphoreHandle_t graph_lock = NULL;
+static StaticSemaphore_t graph_lock_state;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static cooccurrence_stats_t stats;
+
+// Cycle bookkeeping, owned by the scan task but read under the lock
+static uint16_t current_cycle = 1;
+static uint16_t cycle_nodes[COOC_CYCLE_NODES];
+static uint16_t cycle_count = 0;
+static uint32_t random_state = 0x9E3779B9UL;
+
+// Label propagation progress, owned by the worker
+static volatile bool pass_queued = false;
+static uint16_t sweep_cursor = 0;
+static uint16_t sweep_edges = 0;
+
+// Forward declarations
+static uint32_t hash_key(const uint8_t* mac, uint8_t kind);
+static int32_t find_or_insert(uint32_t key, uint8_t kind);
+static uint16_t draw_partner(uint16_t index);
+static bool arrived_together(uint16_t a, uint16_t b);
+static void link_nodes(uint16_t a, uint16_t b);
+static void add_edge(uint16_t from, uint16_t to, uint16_t step, uint16_t cap);
+static void weaken_absent(cooc_node_t* node);
+static uint16_t decayed_weight(cooc_edge_t* edge);
+static bool edge_valid(const cooc_edge_t* edge);
+static void propagate_job(void* payload);
+static void propagate_node(uint16_t index);
+static void tally_communities(uint32_t now_ms);
+static uint32_t next_random(void);
+
+/**
+ * @brief Allocate the graph (PSRAM preferred)
+ */
+bool cooccurrence_init(void) {
+    size_t node_bytes = COOC_NODES * sizeof(cooc_node_t);
+    size_t tally_bytes = COOC_NODES * sizeof(cooc_tally_t);
+#ifdef ESP_PLATFORM
+    nodes = (cooc_node_t*)mem_calloc(MEM_BULK, 1, node_bytes);
+    tallies = (cooc_tally_t*)mem_calloc(MEM_BULK, 1, tally_bytes);
+#else
+    nodes = (cooc_node_t*)calloc(1, node_bytes);
+    tallies = (cooc_tally_t*)calloc(1, tally_bytes);
+#endif
+    if (graph_lock == NULL) {
+        graph_lock = xSemaphoreCreateMutexStatic(&graph_lock_state);
+    }
+    if (nodes == NULL || tallies == NULL) {
+        LOGE(SCAN, "❌ Co-occurrence graph allocation failed");
+        return false;
+    }
+    memset(&stats, 0, sizeof(stats));
+    LOGI(SCAN, "✅ Co-occurrence graph: %d nodes, %d KB",
+         COOC_NODES, (int)((node_bytes + tally_bytes) / 1024));
+    return true;
+}
+
+/**
+ * @brief Add a sighting of the open cycle, linking it to devices already seen in it
+ */
+void cooccurrence_observe(const uint8_t* mac, device_kind_t kind, uint32_t now_ms) {
+    if (nodes == NULL || mac == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(graph_lock, portMAX_DELAY);
+    int32_t found = find_or_insert(hash_key(mac, (uint8_t)kind), (uint8_t)kind);
+    if (found >= 0) {
+        uint16_t index = (uint16_t)found;
+        cooc_node_t* node = &nodes[index];
+        node->last_seen_ms = now_ms;
+
+        // Once per cycle: back from an absence it arrives anew; links to
+        // devices absent meanwhile weaken, links to those
+        // already heard in this one grow, and a few new partners are drawn
+        // from them, which it then joins
+        if (node->linked_cycle != current_cycle) {
+            if ((uint16_t)(current_cycle - node->linked_cycle) > COOC_ABSENT_CYCLES) {
+                node->arrived_cycle = current_cycle;
+            }
+            node->linked_cycle = current_cycle;
+            weaken_absent(node);
+            for (uint8_t i = 0; i < COOC_EDGES_PER_NODE; i++) {
+                const cooc_edge_t* edge = &node->edges[i];
+                if (edge_valid(edge) && nodes[edge->node].linked_cycle == current_cycle) {
+                    link_nodes(index, edge->node);
+                }
+            }
+            for (uint8_t i = 0; i < COOC_LINKS_PER_SIGHTING && cycle_count > 0; i++) {
+                uint16_t other = draw_partner(index);
+                if (other != index) {
+                    link_nodes(index, other);
+                }
+            }
+            if (cycle_count < COOC_CYCLE_NODES) {
+                cycle_nodes[cycle_count++] = index;
+            }
+        }
+    }
+    xSemaphoreGive(graph_lock);
+}
+
+/**
+ * @brief Close the cycle and queue a label propagation pass on a job worker
+ */
+void cooccurrence_close_cycle(uint32_t now_ms) {
+    if (nodes == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(graph_lock, portMAX_DELAY);
+    cycle_count = 0;
+    current_cycle++;
+    if (current_cycle == 0) {
+        current_cycle = 1;          // 0 is "never linked"
+    }
+    xSemaphoreGive(graph_lock);
+
+    // One pass in flight at a time; a cycle that finds one queued skips its own
+    if (pass_queued) {
+        portENTER_CRITICAL(&stats_mux);
+        stats.skipped++;
+        portEXIT_CRITICAL(&stats_mux);
+        return;
+    }
+    pass_queued = true;
+    if (!job_pool_submit(JOB_LANE_LOW, propagate_job, &now_ms, sizeof(now_ms))) {
+        pass_queued = false;
+        portENTER_CRITICAL(&stats_mux);
+        stats.skipped++;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+}
+
+/**
+ * @brief Copy the graph size and the community counts
+ */
+void cooccurrence_get_stats(cooccurrence_stats_t* out) {
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Mix the 48-bit address and kind into a non-zero 32-bit key
+ */
+static uint32_t hash_key(const uint8_t* mac, uint8_t kind) {
+    uint32_t low = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 |
+                   (uint32_t)mac[4] << 8 | mac[5];
+    uint32_t high = (uint32_t)mac[0] << 8 | mac[1];
+    uint32_t h = low * 0x9E3779B1UL ^ (high + kind) * 0x85EBCA77UL;
+    h ^= h >> 16;
+    return h != 0 ? h : 1;
+}
+
+/**
+ * @brief The node of a key, taking a free way or the stalest one of its pair
+ */
+static int32_t find_or_insert(uint32_t key, uint8_t kind) {
+    uint16_t first = (uint16_t)(key & (COOC_NODES - 1) & ~1u);
+    for (uint16_t way = first; way <= first + 1; way++) {
+        if (nodes[way].key == key) {
+            return way;
+        }
+    }
+
+    uint16_t victim = first;
+    if (nodes[first].key != 0 &&
+        (nodes[first + 1].key == 0 ||
+         (int32_t)(nodes[first + 1].last_seen_ms - nodes[first].last_seen_ms) < 0)) {
+        victim = first + 1;
+    }
+    if (nodes[victim].key != 0) {
+        portENTER_CRITICAL(&stats_mux);
+        stats.evictions++;
+        stats.nodes--;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+
+    // Edges elsewhere that pointed at the old device now fail their tag check
+    cooc_node_t* node = &nodes[victim];
+    memset(node, 0, sizeof(*node));
+    node->key = key;
+    node->kind = kind;
+    node->label = victim;
+    node->arrived_cycle = current_cycle;
+    portENTER_CRITICAL(&stats_mux);
+    stats.nodes++;
+    portEXIT_CRITICAL(&stats_mux);
+    return victim;
+}
+
+/**
+ * @brief A device heard earlier in the cycle, one that arrived together if a few draws find one
+ */
+static uint16_t draw_partner(uint16_t index) {
+    uint16_t other = index;
+    for (uint8_t i = 0; i < COOC_DRAW_TRIES; i++) {
+        other = cycle_nodes[next_random() % cycle_count];
+        if (other != index && arrived_together(index, other)) {
+            break;
+        }
+    }
+    return other;
+}
+
+/**
+ * @brief Whether two presences began within COOC_ARRIVAL_CYCLES of each other
+ */
+static bool arrived_together(uint16_t a, uint16_t b) {
+    uint16_t apart = (uint16_t)(nodes[a].arrived_cycle - nodes[b].arrived_cycle);
+    return apart <= COOC_ARRIVAL_CYCLES || (uint16_t)-apart <= COOC_ARRIVAL_CYCLES;
+}
+
+/**
+ * @brief Strengthen the pair both ways; more, and without a cap, if they arrived together
+ */
+static void link_nodes(uint16_t a, uint16_t b) {
+    bool together = arrived_together(a, b);
+    uint16_t step = together ? COOC_EDGE_STEP * COOC_ARRIVAL_BONUS : COOC_EDGE_STEP;
+    uint16_t cap = together ? UINT16_MAX : COOC_PRESENCE_CAP;
+    add_edge(a, b, step, cap);
+    add_edge(b, a, step, cap);
+}
+
+/**
+ * @brief Halve the edges to neighbours unheard for more than COOC_ABSENT_CYCLES
+ */
+static void weaken_absent(cooc_node_t* node) {
+    for (uint8_t i = 0; i < COOC_EDGES_PER_NODE; i++) {
+        cooc_edge_t* edge = &node->edges[i];
+        if (!edge_valid(edge)) {
+            continue;
+        }
+        if ((uint16_t)(current_cycle - nodes[edge->node].linked_cycle) > COOC_ABSENT_CYCLES) {
+            edge->weight = decayed_weight(edge) >> 1;
+        }
+    }
+}
+
+/**
+ * @brief Add a shared cycle to an edge, or replace the weakest one with it
+ */
+static void add_edge(uint16_t from, uint16_t to, uint16_t step, uint16_t cap) {
+    cooc_edge_t* edges = nodes[from].edges;
+    uint16_t tag = (uint16_t)nodes[to].key;
+    cooc_edge_t* weakest = &edges[0];
+    uint16_t weakest_weight = UINT16_MAX;
+
+    for (uint8_t i = 0; i < COOC_EDGES_PER_NODE; i++) {
+        cooc_edge_t* edge = &edges[i];
+        uint16_t weight = edge_valid(edge) ? decayed_weight(edge) : 0;
+        if (weight > 0 && edge->node == to && edge->tag == tag) {
+            edge->weight = weight >= cap - step ? max(weight, cap) : weight + step;
+            return;
+        }
+        if (weight < weakest_weight) {
+            weakest = edge;
+            weakest_weight = weight;
+        }
+    }
+
+    weakest->node = to;
+    weakest->tag = tag;
+    weakest->weight = step;
+    weakest->cycle = current_cycle;
+}
+
+/**
+ * @brief Halve the weight once per half-life since it was last touched
+ */
+static uint16_t decayed_weight(cooc_edge_t* edge) {
+    uint16_t halvings = (uint16_t)(current_cycle - edge->cycle) / COOC_HALF_LIFE_CYCLES;
+    if (halvings > 0) {
+        edge->weight = halvings >= 16 ? 0 : edge->weight >> halvings;
+        edge->cycle += halvings * COOC_HALF_LIFE_CYCLES;
+    }
+    return edge->weight;
+}
+
+/**
+ * @brief Whether an edge is in use and its neighbour is still the same device
+ */
+static bool edge_valid(const cooc_edge_t* edge) {
+    return edge->weight > 0 && nodes[edge->node].key != 0 &&
+           (uint16_t)nodes[edge->node].key == edge->tag;
+}
+
+/**
+ * @brief One slice of label propagation, and the tally when a sweep completes
+ */
+static void propagate_job(void* payload) {
+    uint32_t now_ms;
+    memcpy(&now_ms, payload, sizeof(now_ms));
+
+    xSemaphoreTake(graph_lock, portMAX_DELAY);
+    for (uint16_t i = 0; i < COOC_LP_BUDGET; i++) {
+        if (nodes[sweep_cursor].key != 0) {
+            propagate_node(sweep_cursor);
+        }
+        sweep_cursor = (sweep_cursor + 1) & (COOC_NODES - 1);
+        if (sweep_cursor == 0) {
+            tally_communities(now_ms);
+        }
+    }
+    xSemaphoreGive(graph_lock);
+    pass_queued = false;
+}
+
+/**
+ * @brief Give a node the label carrying the most edge weight among its neighbours
+ *
+ * Ties keep the current label, so communities settle instead of flapping.
+ */
+static void propagate_node(uint16_t index) {
+    cooc_node_t* node = &nodes[index];
+    uint16_t labels[COOC_EDGES_PER_NODE];
+    uint32_t weights[COOC_EDGES_PER_NODE];
+    uint8_t distinct = 0;
+
+    for (uint8_t i = 0; i < COOC_EDGES_PER_NODE; i++) {
+        cooc_edge_t* edge = &node->edges[i];
+        if (!edge_valid(edge)) {
+            edge->weight = 0;
+            continue;
+        }
+        uint16_t weight = decayed_weight(edge);
+        if (weight < COOC_MIN_WEIGHT) {
+            continue;
+        }
+        sweep_edges++;
+        uint16_t label = nodes[edge->node].label;
+        uint8_t slot = 0;
+        while (slot < distinct && labels[slot] != label) {
+            slot++;
+        }
+        if (slot == distinct) {
+            labels[distinct] = label;
+            weights[distinct++] = 0;
+        }
+        weights[slot] += weight;
+    }
+
+    // Cut off from everyone, a node is a community of its own
+    if (distinct == 0) {
+        node->label = index;
+        return;
+    }
+    uint8_t best = 0;
+    for (uint8_t slot = 1; slot < distinct; slot++) {
+        if (weights[slot] > weights[best] ||
+            (weights[slot] == weights[best] && labels[slot] == node->label)) {
+            best = slot;
+        }
+    }
+    node->label = labels[best];
+}
+
+/**
+ * @brief Count the communities with members heard within COOC_ACTIVE_MS
+ */
+static void tally_communities(uint32_t now_ms) {
+    memset(tallies, 0, COOC_NODES * sizeof(cooc_tally_t));
+    for (uint16_t i = 0; i < COOC_NODES; i++) {
+        const cooc_node_t* node = &nodes[i];
+        if (node->key == 0 || now_ms - node->last_seen_ms > COOC_ACTIVE_MS) {
+            continue;
+        }
+        cooc_tally_t* tally = &tallies[node->label & (COOC_NODES - 1)];
+        if (tally->members < UINT8_MAX) {
+            tally->members++;
+        }
+        if (node->kind == DEVICE_KIND_WIFI_AP && tally->access_points < UINT8_MAX) {
+            tally->access_points++;
+        }
+    }
+
+    uint16_t people = 0;
+    uint16_t places = 0;
+    uint16_t largest = 0;
+    for (uint16_t i = 0; i < COOC_NODES; i++) {
+        const cooc_tally_t* tally = &tallies[i];
+        if (tally->members < 2) {
+            continue;
+        }
+        if (tally->access_points > 0 || tally->members > COOC_PERSON_MAX_DEVICES) {
+            places++;
+        } else {
+            people++;
+        }
+        if (tally->members > largest) {
+            largest = tally->members;
+        }
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.edges = sweep_edges;
+    stats.people = people;
+    stats.places = places;
+    stats.largest = largest;
+    stats.sweeps++;
+    portEXIT_CRITICAL(&stats_mux);
+    sweep_edges = 0;
+}
+
+/**
+ * @brief xorshift32: which earlier sightings a new one is linked to
+ */
+static uint32_t next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
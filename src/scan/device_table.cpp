@@ -0,0 +1,624 @@
+/**
+ * @file device_table.cpp
+ * @brief Open-addressing device table keyed by MAC address
+ *
+ * Linear probing with backward-shift deletion keeps the table free of
+ * tombstones, so lookups stay short even after heavy churn. Expiry is done
+ * by an incremental sweep so no single call walks the whole table.
+ *
+ * Each sighting also folds into the device's track in constant time: the
+ * weighted RSSI fit, its stay, and a tally per arrival window of devices
+ * whose stays began together. A BLE device is following when it has stayed
+ * for DEVICE_FOLLOW_STAY_MS while DEVICE_FOLLOW_ARRIVALS access points
+ * came into range, and its signal is not falling away. Access points do
+ * not move, so new ones mean the unit did; a fixed unit sees none and
+ * counts nothing as following.
+ *
+ * Other tasks read the table while the scan task writes it, without a
+ * lock and without copying it. Slots hold pointers into a pool of entry
+ * records: a sighting of a known device copies its record, updates the
+ * copy and publishes it in the slot, and the old record is retired with
+ * the current epoch. A reader pins the epoch for the length of a walk;
+ * every record it can reach stays as it was until it unpins, as a retired
+ * record only returns to the pool once every pinned reader has started
+ * after it was retired. The epoch advances once per cycle, at
+ * device_table_take_delta(), and only records retired in an earlier epoch
+ * are reclaimed, so the scan task's own pointers also hold for the cycle.
+ * Spare records are set aside for this; while they are all waiting in
+ * limbo an update is written in place. Bookkeeping fields (log state,
+ * visits, the mesh sync time) are always written in place, a word at a
+ * time.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "device_table.h"
+#include "profile.h"
+
+#ifdef ESP_PLATFORM
+#include "mem_policy.h"
+#endif
+
+// Table storage: slots point into the record pool
+static device_entry_t** slots = NULL;
+static uint32_t table_mask = 0;
+static uint32_t live_count = 0;
+static uint32_t max_live = 0;
+static uint16_t live_by_kind[2] = {0, 0};
+
+// Incremental sweep and delta accounting
+static uint32_t sweep_cursor = 0;
+static uint16_t current_cycle = 1;
+static device_delta_t pending_delta = {};
+static device_event_handler_t event_handler = NULL;
+
+// Trajectory accounting across entries
+typedef struct {
+    uint16_t window;            // Arrival window counted here
+    uint16_t count;             // Live devices whose stay began in it
+} arrival_window_t;
+static arrival_window_t arrival_windows[DEVICE_CLUSTER_SLOTS];
+static uint32_t ap_arrivals = 0;
+static uint16_t following_count = 0;
+
+// Record pool, retired records and the readers that may still hold them
+static device_entry_t* records = NULL;
+static uint32_t record_count = 0;
+static uint16_t* free_stack = NULL;         // Indices of free records
+static uint32_t free_top = 0;
+static uint16_t* limbo = NULL;              // Retired records, oldest first
+static uint32_t* retired_epoch = NULL;      // Per record, while in limbo
+static uint32_t limbo_head = 0;
+static uint32_t limbo_count = 0;
+static uint32_t epoch = 1;
+static uint32_t reader_epochs[DEVICE_TABLE_READERS];   // 0 = slot free
+static device_versions_t versions = {};
+
+// Forward declarations
+static uint32_t hash_key(const uint8_t* mac, uint8_t kind);
+static int32_t find_slot(const uint8_t* mac, uint8_t kind);
+static void remove_slot(uint32_t index);
+static void start_stay(device_entry_t* entry, uint32_t now_ms);
+static void end_stay(device_entry_t* entry);
+static void fit_sighting(device_entry_t* entry, int8_t rssi, uint32_t now_ms);
+static void update_following(device_entry_t* entry, uint32_t now_ms);
+static device_entry_t* take_record(void);
+static void retire_record(device_entry_t* entry);
+static void reclaim_records(bool advance);
+static void publish(uint32_t index, device_entry_t* entry);
+
+/**
+ * @brief Allocate the table (PSRAM preferred)
+ */
+bool device_table_init(uint32_t capacity) {
+    uint32_t slot_count = 16;
+    while (slot_count < capacity) {
+        slot_count <<= 1;
+    }
+    uint32_t live = slot_count * DEVICE_TABLE_MAX_LOAD_PCT / 100;
+    uint32_t pool = live + live * DEVICE_TABLE_SPARE_PCT / 100;
+    if (pool > UINT16_MAX) {
+        return false;
+    }
+
+    size_t slot_bytes = slot_count * sizeof(device_entry_t*);
+    size_t record_bytes = pool * sizeof(device_entry_t);
+    size_t index_bytes = pool * (2 * sizeof(uint16_t) + sizeof(uint32_t));
+#ifdef ESP_PLATFORM
+    slots = (device_entry_t**)mem_calloc(MEM_BULK, 1, slot_bytes);
+    records = (device_entry_t*)mem_calloc(MEM_BULK, 1, record_bytes);
+    free_stack = (uint16_t*)mem_calloc(MEM_BULK, 1, index_bytes);
+#else
+    slots = (device_entry_t**)calloc(1, slot_bytes);
+    records = (device_entry_t*)calloc(1, record_bytes);
+    free_stack = (uint16_t*)calloc(1, index_bytes);
+#endif
+    if (slots == NULL || records == NULL || free_stack == NULL) {
+        slots = NULL;
+        return false;
+    }
+    limbo = free_stack + pool;
+    retired_epoch = (uint32_t*)(limbo + pool);
+
+    record_count = pool;
+    for (uint32_t i = 0; i < pool; i++) {
+        free_stack[i] = (uint16_t)(pool - 1 - i);
+    }
+    free_top = pool;
+    limbo_head = 0;
+    limbo_count = 0;
+    memset(&versions, 0, sizeof(versions));
+
+    table_mask = slot_count - 1;
+    max_live = live;
+    live_count = 0;
+    live_by_kind[0] = live_by_kind[1] = 0;
+    sweep_cursor = 0;
+    memset(&pending_delta, 0, sizeof(pending_delta));
+    memset(arrival_windows, 0, sizeof(arrival_windows));
+    ap_arrivals = 0;
+    following_count = 0;
+    return true;
+}
+
+/**
+ * @brief Install a handler for per-device events (NULL to remove)
+ */
+void device_table_set_event_handler(device_event_handler_t handler) {
+    event_handler = handler;
+}
+
+/**
+ * @brief Record one sighting, inserting the device if it is new
+ */
+device_entry_t* device_table_observe(const uint8_t* mac, device_kind_t kind,
+                                     int8_t rssi, uint8_t channel, uint32_t now_ms,
+                                     uint32_t rx_us) {
+    PROFILE_SCOPE(PROFILE_DEVICE_OBSERVE);
+    if (slots == NULL || mac == NULL) {
+        return NULL;
+    }
+
+    int32_t slot = find_slot(mac, (uint8_t)kind);
+    if (slot >= 0) {
+        // A new version for the readers, unless the spares are all in limbo;
+        // free records enough for the devices still to come are kept back
+        device_entry_t* current = slots[slot];
+        device_entry_t* entry = current;
+        if (free_top <= max_live - live_count) {
+            reclaim_records(false);         // Readers may have unpinned since the cycle began
+        }
+        if (free_top > max_live - live_count) {
+            entry = take_record();
+            *entry = *current;
+        } else {
+            versions.in_place++;
+        }
+        int16_t delta_x16 = (int16_t)(rssi * 16) - entry->rssi_ewma_x16;
+        int16_t jump = delta_x16 < 0 ? -delta_x16 : delta_x16;
+        if (jump >= DEVICE_MOVED_RSSI_DB * 16 && entry->moved_cycle != current_cycle) {
+            entry->moved_cycle = current_cycle;
+            entry->synced_ms = 0;
+            pending_delta.moved++;
+            if (event_handler != NULL) {
+                event_handler(DEVICE_EVENT_MOVED, entry);
+            }
+        }
+
+        // A device unheard long enough has left and come back
+        if (now_ms - entry->last_seen_ms > DEVICE_STAY_GAP_MS) {
+            end_stay(entry);
+            start_stay(entry, now_ms);
+        }
+        fit_sighting(entry, rssi, now_ms);
+        update_following(entry, now_ms);
+
+        entry->rssi_ewma_x16 += delta_x16 >> DEVICE_RSSI_EWMA_SHIFT;
+        if (rssi < entry->rssi_min) entry->rssi_min = rssi;
+        if (rssi > entry->rssi_max) entry->rssi_max = rssi;
+        entry->rssi_last = rssi;
+        if (channel != 0) {
+            entry->channel = channel;
+        }
+        entry->last_seen_ms = now_ms;
+        entry->last_seen_us = rx_us;
+        entry->last_cycle = current_cycle;
+        entry->sightings++;
+        if (entry != current) {
+            publish(slot, entry);
+            retire_record(current);
+            versions.published++;
+        }
+        return entry;
+    }
+
+    // A removal since the last reclaim can leave the pool a record short
+    if (live_count >= max_live || free_top == 0) {
+        pending_delta.dropped++;
+        return NULL;
+    }
+
+    // Insert at the first empty slot along the probe sequence
+    uint32_t index = hash_key(mac, (uint8_t)kind) & table_mask;
+    while (slots[index] != NULL) {
+        index = (index + 1) & table_mask;
+    }
+
+    device_entry_t* entry = take_record();
+    memcpy(entry->mac, mac, sizeof(entry->mac));
+    entry->kind = (uint8_t)kind;
+    entry->used = 1;
+    entry->rssi_min = rssi;
+    entry->rssi_max = rssi;
+    entry->rssi_last = rssi;
+    entry->channel = channel;
+    entry->rssi_ewma_x16 = (int16_t)(rssi * 16);
+    entry->moved_cycle = 0;
+    entry->first_seen_ms = now_ms;
+    entry->last_seen_ms = now_ms;
+    entry->sightings = 1;
+    entry->synced_ms = 0;
+    entry->last_seen_us = rx_us;
+    entry->last_cycle = current_cycle;
+    memset(&entry->log, 0, sizeof(entry->log));
+    memset(&entry->track, 0, sizeof(entry->track));
+    entry->track.rssi_mean = rssi;
+    if (kind == DEVICE_KIND_WIFI_AP) {
+        ap_arrivals++;
+    }
+    start_stay(entry, now_ms);
+    publish(index, entry);
+
+    live_count++;
+    live_by_kind[kind == DEVICE_KIND_BLE ? 1 : 0]++;
+    pending_delta.appeared++;
+    if (event_handler != NULL) {
+        event_handler(DEVICE_EVENT_APPEARED, entry);
+    }
+    return entry;
+}
+
+/**
+ * @brief Look up a device without modifying it
+ */
+const device_entry_t* device_table_find(const uint8_t* mac, device_kind_t kind) {
+    if (slots == NULL || mac == NULL) {
+        return NULL;
+    }
+    int32_t slot = find_slot(mac, (uint8_t)kind);
+    if (slot < 0) {
+        return NULL;
+    }
+    // From another task the slot may have been shifted since it matched
+    const device_entry_t* entry = __atomic_load_n(&slots[slot], __ATOMIC_ACQUIRE);
+    return entry != NULL && entry->kind == kind && memcmp(entry->mac, mac, 6) == 0 ? entry : NULL;
+}
+
+/**
+ * @brief Incrementally sweep for expired entries
+ */
+uint16_t device_table_age_step(uint32_t now_ms, uint32_t budget) {
+    if (slots == NULL) {
+        return 0;
+    }
+
+    uint16_t removed = 0;
+    for (uint32_t examined = 0; examined < budget && examined <= table_mask; examined++) {
+        device_entry_t* entry = slots[sweep_cursor];
+        if (entry != NULL && now_ms - entry->last_seen_ms > DEVICE_TTL_MS) {
+            if (event_handler != NULL) {
+                event_handler(DEVICE_EVENT_LOST, entry);
+            }
+
+            // Backward shift may pull a later entry into this slot,
+            // so the cursor stays put and re-examines it next
+            remove_slot(sweep_cursor);
+            removed++;
+            continue;
+        }
+        sweep_cursor = (sweep_cursor + 1) & table_mask;
+    }
+
+    pending_delta.lost += removed;
+    return removed;
+}
+
+/**
+ * @brief Return the delta since the previous call and start a new cycle
+ */
+void device_table_take_delta(device_delta_t* delta) {
+    if (delta != NULL) {
+        *delta = pending_delta;
+        delta->live_wifi = live_by_kind[0];
+        delta->live_ble = live_by_kind[1];
+        delta->following = following_count;
+    }
+    memset(&pending_delta, 0, sizeof(pending_delta));
+    reclaim_records(true);
+
+    // Cycle 0 is reserved for "never moved"
+    current_cycle++;
+    if (current_cycle == 0) {
+        current_cycle = 1;
+    }
+}
+
+/**
+ * @brief Record that a slot's entry was shared with mesh peers
+ */
+void device_table_mark_synced(uint32_t index, uint32_t now_ms) {
+    if (slots != NULL && index <= table_mask && slots[index] != NULL) {
+        // Keep 0 free as the "never synced" marker
+        slots[index]->synced_ms = now_ms != 0 ? now_ms : 1;
+    }
+}
+
+/**
+ * @brief RSSI trend of a device, dB per minute
+ */
+float device_table_trend(const device_entry_t* entry) {
+    // Under a few seconds of spread the slope is mostly noise
+    if (entry == NULL || entry->track.t_var < DEVICE_TREND_MIN_VAR_S2) {
+        return 0.0f;
+    }
+    return entry->track.t_rssi_cov / entry->track.t_var * 60.0f;
+}
+
+/**
+ * @brief Length of a device's current stay
+ */
+uint32_t device_table_stay_ms(const device_entry_t* entry) {
+    return entry != NULL ? entry->last_seen_ms - entry->track.stay_start_ms : 0;
+}
+
+/**
+ * @brief Other live devices whose stay started in the same cycle window
+ */
+uint16_t device_table_companions(const device_entry_t* entry) {
+    if (entry == NULL) {
+        return 0;
+    }
+    const arrival_window_t* slot = &arrival_windows[entry->track.arrival_window & (DEVICE_CLUSTER_SLOTS - 1)];
+    return slot->window == entry->track.arrival_window && slot->count > 0 ? slot->count - 1 : 0;
+}
+
+/**
+ * @brief Sequence number of the open scan cycle
+ */
+uint16_t device_table_cycle(void) {
+    return current_cycle;
+}
+
+/**
+ * @brief Number of live entries
+ */
+uint32_t device_table_count(void) {
+    return live_count;
+}
+
+/**
+ * @brief Slot count, for iteration with device_table_entry_at()
+ */
+uint32_t device_table_capacity(void) {
+    return slots != NULL ? table_mask + 1 : 0;
+}
+
+/**
+ * @brief Entry stored at a slot index
+ */
+const device_entry_t* device_table_entry_at(uint32_t index) {
+    if (slots == NULL || index > table_mask) {
+        return NULL;
+    }
+    return __atomic_load_n(&slots[index], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Writable entry at a slot index
+ */
+device_entry_t* device_table_entry_mut(uint32_t index) {
+    if (slots == NULL || index > table_mask) {
+        return NULL;
+    }
+    return slots[index];
+}
+
+/**
+ * @brief Pin the current epoch for a read from another task
+ */
+uint8_t device_table_pin(void) {
+    uint32_t current = __atomic_load_n(&epoch, __ATOMIC_SEQ_CST);
+    for (uint8_t i = 0; i < DEVICE_TABLE_READERS; i++) {
+        uint32_t idle = 0;
+        if (__atomic_compare_exchange_n(&reader_epochs[i], &idle, current, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            // The pin is visible before any slot is read
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            __atomic_fetch_add(&versions.pins, 1, __ATOMIC_RELAXED);
+            return i + 1;
+        }
+    }
+    __atomic_fetch_add(&versions.unpinned, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * @brief Let the records read since device_table_pin() go back to the pool
+ */
+void device_table_unpin(uint8_t pin) {
+    if (pin != 0 && pin <= DEVICE_TABLE_READERS) {
+        __atomic_store_n(&reader_epochs[pin - 1], 0, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Copy the version pool figures
+ */
+void device_table_get_versions(device_versions_t* out) {
+    *out = versions;
+    out->epoch = epoch;
+    out->records = record_count;
+    out->free = free_top;
+    out->limbo = limbo_count;
+    out->readers = 0;
+    for (uint8_t i = 0; i < DEVICE_TABLE_READERS; i++) {
+        out->readers += __atomic_load_n(&reader_epochs[i], __ATOMIC_RELAXED) != 0 ? 1 : 0;
+    }
+}
+
+/**
+ * @brief Mix the 48-bit address and kind into a 32-bit hash
+ */
+static uint32_t hash_key(const uint8_t* mac, uint8_t kind) {
+    // Locally administered BLE addresses vary most in the low bytes
+    uint32_t low = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 |
+                   (uint32_t)mac[4] << 8 | mac[5];
+    uint32_t high = (uint32_t)mac[0] << 8 | mac[1];
+    uint32_t h = low * 0x9E3779B1UL ^ (high + kind) * 0x85EBCA77UL;
+    return h ^ (h >> 16);
+}
+
+/**
+ * @brief Probe for a key, stopping at the first empty slot
+ */
+static int32_t find_slot(const uint8_t* mac, uint8_t kind) {
+    uint32_t index = hash_key(mac, kind) & table_mask;
+
+    const device_entry_t* entry;
+    while ((entry = __atomic_load_n(&slots[index], __ATOMIC_ACQUIRE)) != NULL) {
+        if (entry->kind == kind && memcmp(entry->mac, mac, 6) == 0) {
+            return (int32_t)index;
+        }
+        index = (index + 1) & table_mask;
+    }
+    return -1;
+}
+
+/**
+ * @brief Delete a slot and backward-shift its probe chain
+ *
+ * Only pointers move, so a reader holding the entry, or one that was
+ * shifted, still has it whole; a walk racing the shift may see a moved
+ * entry twice or not at all.
+ */
+static void remove_slot(uint32_t index) {
+    device_entry_t* removed = slots[index];
+    end_stay(removed);
+    live_count--;
+    live_by_kind[removed->kind == DEVICE_KIND_BLE ? 1 : 0]--;
+
+    uint32_t hole = index;
+    uint32_t next = (hole + 1) & table_mask;
+
+    while (slots[next] != NULL) {
+        uint32_t home = hash_key(slots[next]->mac, slots[next]->kind) & table_mask;
+
+        // Move the entry back if the hole lies between its home and itself
+        if (((next - home) & table_mask) >= ((next - hole) & table_mask)) {
+            publish(hole, slots[next]);
+            hole = next;
+        }
+        next = (next + 1) & table_mask;
+    }
+
+    publish(hole, NULL);
+    retire_record(removed);
+}
+
+/**
+ * @brief Open a stay: its arrival window, and the access point count it is judged against
+ */
+static void start_stay(device_entry_t* entry, uint32_t now_ms) {
+    device_track_t* track = &entry->track;
+    track->stay_start_ms = now_ms;
+    track->arrivals_mark = ap_arrivals;
+    track->arrival_window = current_cycle >> DEVICE_CLUSTER_WINDOW_SHIFT;
+
+    // A slot still holding an older window is taken over; its devices
+    // simply stop counting each other
+    arrival_window_t* slot = &arrival_windows[track->arrival_window & (DEVICE_CLUSTER_SLOTS - 1)];
+    if (slot->window != track->arrival_window) {
+        slot->window = track->arrival_window;
+        slot->count = 0;
+    }
+    slot->count++;
+}
+
+/**
+ * @brief Close a stay: leave its window's tally and the following count
+ */
+static void end_stay(device_entry_t* entry) {
+    device_track_t* track = &entry->track;
+    arrival_window_t* slot = &arrival_windows[track->arrival_window & (DEVICE_CLUSTER_SLOTS - 1)];
+    if (slot->window == track->arrival_window && slot->count > 0) {
+        slot->count--;
+    }
+    if (track->following) {
+        track->following = 0;
+        following_count--;
+    }
+}
+
+/**
+ * @brief Fold a sighting into the weighted least-squares fit of RSSI over time
+ *
+ * West's incremental form: the means move by alpha of the residual and the
+ * second moments decay by 1 - alpha, which stays stable in single
+ * precision however long the device lives.
+ */
+static void fit_sighting(device_entry_t* entry, int8_t rssi, uint32_t now_ms) {
+    device_track_t* track = &entry->track;
+    float t = (now_ms - entry->first_seen_ms) / 1000.0f;
+    float dt = t - track->t_mean_s;
+    float dy = rssi - track->rssi_mean;
+    track->t_mean_s += DEVICE_TREND_ALPHA * dt;
+    track->rssi_mean += DEVICE_TREND_ALPHA * dy;
+    track->t_rssi_cov = (1.0f - DEVICE_TREND_ALPHA) * (track->t_rssi_cov + DEVICE_TREND_ALPHA * dt * dy);
+    track->t_var = (1.0f - DEVICE_TREND_ALPHA) * (track->t_var + DEVICE_TREND_ALPHA * dt * dt);
+}
+
+/**
+ * @brief A BLE device that stayed long enough, while enough access points came, and is not receding
+ */
+static void update_following(device_entry_t* entry, uint32_t now_ms) {
+    device_track_t* track = &entry->track;
+    bool following = entry->kind == DEVICE_KIND_BLE &&
+                     now_ms - track->stay_start_ms >= DEVICE_FOLLOW_STAY_MS &&
+                     ap_arrivals - track->arrivals_mark >= DEVICE_FOLLOW_ARRIVALS &&
+                     device_table_trend(entry) > -DEVICE_TREND_DB_PER_MIN;
+    if (following != (track->following != 0)) {
+        track->following = following;
+        following_count += following ? 1 : -1;
+    }
+}
+
+/**
+ * @brief A free record from the pool; callers check free_top first
+ */
+static device_entry_t* take_record(void) {
+    return &records[free_stack[--free_top]];
+}
+
+/**
+ * @brief Hold a record unpublished by the scan task until no reader can have it
+ */
+static void retire_record(device_entry_t* entry) {
+    uint32_t index = (uint32_t)(entry - records);
+    retired_epoch[index] = epoch;
+    limbo[(limbo_head + limbo_count) % record_count] = (uint16_t)index;
+    limbo_count++;
+}
+
+/**
+ * @brief Return to the pool what no pinned reader can still hold
+ *
+ * A reader pinned at epoch e may hold anything retired up to e; the oldest
+ * pin bounds what goes back. Records retired in the current epoch only go
+ * back once it has been advanced, at the end of the cycle, as the scan
+ * task may still be holding them.
+ * @param advance Start a new epoch first
+ */
+static void reclaim_records(bool advance) {
+    uint32_t oldest = advance ? __atomic_add_fetch(&epoch, 1, __ATOMIC_SEQ_CST)
+                              : __atomic_load_n(&epoch, __ATOMIC_SEQ_CST);
+    for (uint8_t i = 0; i < DEVICE_TABLE_READERS; i++) {
+        uint32_t pinned = __atomic_load_n(&reader_epochs[i], __ATOMIC_SEQ_CST);
+        if (pinned != 0 && (int32_t)(pinned - oldest) < 0) {
+            oldest = pinned;
+        }
+    }
+    while (limbo_count > 0 && (int32_t)(retired_epoch[limbo[limbo_head]] - oldest) < 0) {
+        free_stack[free_top++] = limbo[limbo_head];
+        limbo_head = (limbo_head + 1) % record_count;
+        limbo_count--;
+        versions.reclaimed++;
+    }
+}
+
+/**
+ * @brief Store a slot so a reader that loads it also sees the record's contents
+ */
+static void publish(uint32_t index, device_entry_t* entry) {
+    __atomic_store_n(&slots[index], entry, __ATOMIC_RELEASE);
+}
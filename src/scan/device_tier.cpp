@@ -0,0 +1,1146 @@
+/**
+ * @file device_tier.cpp
+ * @brief Warm records in PSRAM and cold sorted runs on the card, merged LSM-style
+ *
+ * The warm tier is an open-addressed array of records, owned by the scan
+ * task: a device entering the table gets its record there, flagged hot
+ * until it leaves, when its stay is folded in. Only records that are not
+ * hot are flushed, the oldest first by a histogram of their ages in
+ * octaves of seconds, so one pass counts and one pass picks.
+ *
+ * A flush is sorted and written on a worker as TIER_DIR/run_NNNNN.htr:
+ * the records, the run's Bloom filter, then a footer. The filters of all
+ * runs stay in PSRAM; a device none of them admits has never been on the
+ * card, and is known to be new without a read. After each flush, while a
+ * level holds TIER_MERGE_FANIN runs they are merged into one of the next
+ * level, reading them side by side; a key held by several is folded into
+ * one record, the newest first. The footer names the runs a merged run
+ * replaces, so a merge cut short between writing its output and removing
+ * its inputs is finished at the next load. Card work, the writes, merges,
+ * loads and lookups, is done one at a time under work_lock; the run index
+ * is only ever held for as long as it takes to read or swap entries.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "sd_bench.h"
+#include "job_pool.h"
+#include "time_sync.h"
+#include "device_tier.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+#define KIND_MASK      0x0F
+#define FLAG_USED      0x20         // Warm only: the slot holds a record
+#define FLAG_HOT       0x40         // Warm only: its device is in the table
+#define CARD_FLAGS     (KIND_MASK | DEVICE_TIER_WHOLE)
+#define WARM_MASK      (TIER_WARM_SLOTS - 1)
+#define WARM_BYTES     (TIER_WARM_SLOTS * sizeof(device_tier_record_t))
+#define FLUSH_BYTES    (TIER_FLUSH_RECORDS * sizeof(device_tier_record_t))
+#define READ_BYTES     (TIER_READ_RECORDS * sizeof(device_tier_record_t))
+#define MERGE_BYTES    ((TIER_MERGE_FANIN + 1) * READ_BYTES)
+#define AGE_OCTAVES    32
+
+static_assert((TIER_WARM_SLOTS & (TIER_WARM_SLOTS - 1)) == 0, "TIER_WARM_SLOTS must be a power of two");
+static_assert(TIER_WARM_FLUSH_PCT < TIER_WARM_MAX_PCT && TIER_WARM_MAX_PCT < 100, "flush before the warm tier is full");
+static_assert(TIER_FLUSH_RECORDS < TIER_WARM_SLOTS * TIER_WARM_FLUSH_PCT / 100, "a flush must fit the warm tier");
+static_assert(TIER_MERGE_FANIN >= 2, "a merge needs two runs");
+
+/**
+ * @brief One run on the card, oldest first in the index
+ */
+typedef struct {
+    uint32_t number;
+    uint32_t records;
+    uint32_t bloom_bits;            // 0 without a filter: every lookup reads the run
+    uint8_t* bloom;
+    uint8_t  hashes;
+    uint8_t  level;
+} tier_run_t;
+
+/**
+ * @brief A run being written
+ */
+typedef struct {
+    File     file;
+    char     path[40];
+    uint32_t number;
+    uint32_t records;
+    uint32_t bloom_bits;
+    uint8_t* bloom;
+    uint32_t newest_s;
+    bool     ok;
+} run_writer_t;
+
+/**
+ * @brief A finished card lookup, for the scan task
+ */
+typedef struct {
+    uint8_t  mac[6];
+    uint8_t  kind;
+    bool     found;
+    device_tier_record_t record;
+} recall_t;
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t kind;
+} recall_job_t;
+
+// Warm tier and clock (scan task only)
+static device_tier_record_t* warm = NULL;
+static uint32_t warm_used = 0;
+static uint32_t warm_hot = 0;
+static uint32_t clock_s = 0;
+static uint32_t clock_ms = 0;
+static uint8_t recalls_in_flight = 0;
+
+// Flush buffer: filled by the scan task, then the worker's until writing clears
+static device_tier_record_t* flushing = NULL;
+static uint32_t flush_count = 0;
+static volatile bool writing = false;
+static bool flush_pending = false;          // Taken from the warm tier, not yet handed over
+static volatile bool loading = false;
+static volatile bool loaded = false;
+static volatile uint32_t clock_floor_s = 0;    // Newest record on the card, for a clock that is unset
+
+// The run index, under runs_lock
+static tier_run_t runs[TIER_RUNS_MAX];
+static uint16_t run_count = 0;
+static SemaphoreHandle_t runs_lock = NULL;
+static StaticSemaphore_t runs_lock_state;
+
+// Card work, one flush, merge, load or lookup at a time under work_lock
+static device_tier_record_t* merge_buffers = NULL;     // One read buffer per input, then the output's
+static uint32_t next_number = 1;
+static device_tier_footer_t footers[TIER_RUNS_MAX];
+static uint32_t footer_numbers[TIER_RUNS_MAX];
+static SemaphoreHandle_t work_lock = NULL;
+static StaticSemaphore_t work_lock_state;
+
+static recall_t recalls[TIER_RECALLS_MAX];
+static uint8_t recall_count = 0;
+static device_tier_stats_t stats = {0};
+static portMUX_TYPE tier_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static uint32_t tier_clock(uint32_t now_ms);
+static void flush_oldest(uint32_t now_s);
+static void flush_job(void* payload);
+static void load_job(void* payload);
+static void recall_job(void* payload);
+static void compact(void);
+static bool merge_runs(const tier_run_t* inputs);
+static bool open_run(run_writer_t* writer, uint32_t expected);
+static void put_records(run_writer_t* writer, const device_tier_record_t* records, uint32_t count);
+static bool close_run(run_writer_t* writer, uint8_t level, const uint32_t* replaces);
+static void add_run(const tier_run_t* run, const uint32_t* replaced);
+static bool search_run(uint32_t number, uint32_t records, uint64_t key, device_tier_record_t* out);
+static uint16_t read_footers(void);
+static void fold_older(device_tier_record_t* newer, const device_tier_record_t* older);
+static void fold_stay(device_tier_record_t* record, const device_entry_t* entry, uint32_t now_ms);
+static int32_t warm_find(const uint8_t* mac, uint8_t kind);
+static device_tier_record_t* warm_insert(const uint8_t* mac, uint8_t kind);
+static void warm_remove(uint32_t index);
+static uint32_t warm_hash(const uint8_t* mac, uint8_t kind);
+static uint64_t record_key(const uint8_t* mac, uint8_t kind);
+static void bloom_hashes(uint64_t key, uint32_t* h1, uint32_t* h2);
+static bool bloom_admits(const tier_run_t* run, uint64_t key);
+static int compare_records(const void* a, const void* b);
+static void run_path(uint32_t number, char* path, size_t size);
+static void publish_index(void);
+
+/**
+ * @brief Allocate the warm tier and the card buffers in PSRAM
+ */
+bool device_tier_init(void) {
+    if (warm != NULL) {
+        return true;
+    }
+    warm = (device_tier_record_t*)mem_calloc(MEM_BULK, 1, WARM_BYTES);
+    flushing = (device_tier_record_t*)mem_alloc(MEM_BULK, FLUSH_BYTES);
+    merge_buffers = (device_tier_record_t*)mem_alloc(MEM_BULK, MERGE_BYTES);
+    if (warm == NULL || flushing == NULL || merge_buffers == NULL) {
+        mem_free(MEM_BULK, warm, WARM_BYTES);
+        mem_free(MEM_BULK, flushing, FLUSH_BYTES);
+        mem_free(MEM_BULK, merge_buffers, MERGE_BYTES);
+        warm = NULL;
+        flushing = NULL;
+        merge_buffers = NULL;
+        LOGE(SCAN, "❌ Device tier buffers allocation failed");
+        return false;
+    }
+    runs_lock = xSemaphoreCreateMutexStatic(&runs_lock_state);
+    work_lock = xSemaphoreCreateMutexStatic(&work_lock_state);
+    clock_ms = millis();
+    LOGI(SCAN, "✅ Device tier: %d warm records, runs of %d merged %d at a time",
+         TIER_WARM_SLOTS, TIER_FLUSH_RECORDS, TIER_MERGE_FANIN);
+    return true;
+}
+
+/**
+ * @brief A device entered the table: find what is known of it
+ */
+void device_tier_appeared(const device_entry_t* entry, uint32_t now_ms) {
+    if (warm == NULL) {
+        return;
+    }
+    int32_t slot = warm_find(entry->mac, entry->kind);
+    if (slot >= 0) {
+        if ((warm[slot].kind & FLAG_HOT) == 0) {
+            warm[slot].kind |= FLAG_HOT;
+            warm_hot++;
+        }
+        portENTER_CRITICAL(&tier_mux);
+        stats.returned_warm++;
+        portEXIT_CRITICAL(&tier_mux);
+        return;
+    }
+    if (warm_used >= TIER_WARM_SLOTS * TIER_WARM_MAX_PCT / 100) {
+        portENTER_CRITICAL(&tier_mux);
+        stats.dropped++;
+        portEXIT_CRITICAL(&tier_mux);
+        return;
+    }
+
+    // A record with no sightings yet: the stay is folded in when it leaves
+    device_tier_record_t* record = warm_insert(entry->mac, entry->kind);
+    record->kind |= FLAG_HOT;
+    record->channel = entry->channel;
+    record->last_s = tier_clock(now_ms);
+    record->rssi_min = entry->rssi_last;
+    record->rssi_max = entry->rssi_last;
+    record->rssi_mean = entry->rssi_last;
+    warm_hot++;
+    if (!loaded) {
+        return;
+    }
+
+    // Not warm: the runs' filters say whether it was ever on the card
+    uint64_t key = record_key(entry->mac, entry->kind);
+    uint16_t admitted = 0;
+    uint16_t skipped = 0;
+    xSemaphoreTake(runs_lock, portMAX_DELAY);
+    for (uint16_t i = 0; i < run_count; i++) {
+        if (bloom_admits(&runs[i], key)) {
+            admitted++;
+        } else {
+            skipped++;
+        }
+    }
+    xSemaphoreGive(runs_lock);
+
+    bool is_new = false;
+    bool submitted = false;
+    if (admitted == 0) {
+        // A flush in flight may hold it, in no run yet
+        is_new = !writing;
+        if (is_new) {
+            record->kind |= DEVICE_TIER_WHOLE;
+        }
+    } else if (recalls_in_flight < TIER_RECALLS_MAX) {
+        recall_job_t job;
+        memcpy(job.mac, entry->mac, sizeof(job.mac));
+        job.kind = entry->kind;
+        submitted = job_pool_submit(JOB_LANE_LOW, recall_job, &job, sizeof(job));
+        recalls_in_flight += submitted ? 1 : 0;
+    }
+    portENTER_CRITICAL(&tier_mux);
+    stats.filter_skips += skipped;
+    stats.new_devices += is_new ? 1 : 0;
+    stats.lookups_skipped += admitted > 0 && !submitted ? 1 : 0;
+    portEXIT_CRITICAL(&tier_mux);
+}
+
+/**
+ * @brief A device is leaving the table: fold its stay into its warm record
+ */
+void device_tier_lost(const device_entry_t* entry, uint32_t now_ms) {
+    if (warm == NULL) {
+        return;
+    }
+    int32_t slot = warm_find(entry->mac, entry->kind);
+    device_tier_record_t* record;
+    if (slot >= 0) {
+        record = &warm[slot];
+    } else if (warm_used < TIER_WARM_SLOTS * TIER_WARM_MAX_PCT / 100) {
+        // Its record was dropped when it came, or flushed while it stayed
+        record = warm_insert(entry->mac, entry->kind);
+    } else {
+        portENTER_CRITICAL(&tier_mux);
+        stats.dropped++;
+        portEXIT_CRITICAL(&tier_mux);
+        return;
+    }
+    if (record->kind & FLAG_HOT) {
+        record->kind &= ~FLAG_HOT;
+        warm_hot--;
+    }
+    fold_stay(record, entry, now_ms);
+    portENTER_CRITICAL(&tier_mux);
+    stats.demoted++;
+    portEXIT_CRITICAL(&tier_mux);
+}
+
+/**
+ * @brief Take in finished lookups and flush the oldest warm records; once per cycle
+ */
+void device_tier_step(uint32_t now_ms) {
+    if (warm == NULL) {
+        return;
+    }
+    uint32_t now_s = tier_clock(now_ms);
+    if (!loaded && !loading && sd_monitor_mounted()) {
+        loading = true;
+        if (!job_pool_submit(JOB_LANE_LOW, load_job, NULL, 0)) {
+            loading = false;        // Retried next cycle
+        }
+    }
+
+    recall_t done[TIER_RECALLS_MAX];
+    portENTER_CRITICAL(&tier_mux);
+    uint8_t count = recall_count;
+    memcpy(done, recalls, count * sizeof(recall_t));
+    recall_count = 0;
+    portEXIT_CRITICAL(&tier_mux);
+    uint8_t returned = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        recalls_in_flight--;
+        // Gone from the warm tier meanwhile: its merge with the card's copy comes later
+        int32_t slot = warm_find(done[i].mac, done[i].kind);
+        if (slot >= 0 && done[i].found) {
+            fold_older(&warm[slot], &done[i].record);
+            returned++;
+        }
+    }
+
+    if (flush_pending) {
+        flush_pending = !job_pool_submit(JOB_LANE_LOW, flush_job, NULL, 0);
+    } else if (warm_used >= TIER_WARM_SLOTS * TIER_WARM_FLUSH_PCT / 100 && !writing) {
+        flush_oldest(now_s);
+    }
+
+    portENTER_CRITICAL(&tier_mux);
+    stats.returned_cold += returned;
+    stats.warm = warm_used;
+    stats.warm_hot = warm_hot;
+    portEXIT_CRITICAL(&tier_mux);
+}
+
+/**
+ * @brief Copy the tier figures
+ */
+void device_tier_get_stats(device_tier_stats_t* out) {
+    portENTER_CRITICAL(&tier_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&tier_mux);
+}
+
+/**
+ * @brief Seconds for records: UTC when the clock is set, else on from the card's newest record
+ */
+static uint32_t tier_clock(uint32_t now_ms) {
+    // Counted in whole seconds so millis() wrapping does not matter
+    uint32_t elapsed_s = (now_ms - clock_ms) / 1000;
+    clock_s += elapsed_s;
+    clock_ms += elapsed_s * 1000;
+
+    uint64_t wall_ms = time_sync_wall_ms_at(now_ms);
+    if (wall_ms != 0) {
+        return (uint32_t)(wall_ms / 1000);
+    }
+    return clock_floor_s + clock_s;
+}
+
+/**
+ * @brief Hand the oldest TIER_FLUSH_RECORDS records that are not hot to a worker
+ *
+ * Without a card to write them to they are let go, so the devices still
+ * coming keep their records.
+ */
+static void flush_oldest(uint32_t now_s) {
+    bool card = sd_monitor_mounted();
+    if (card && (!loaded || run_count >= TIER_RUNS_MAX)) {
+        return;                     // Indexing or merging first; dropping only at TIER_WARM_MAX_PCT
+    }
+
+    // Records per octave of age, then the octave the oldest flush's worth reaches into
+    uint32_t octaves[AGE_OCTAVES] = {0};
+    for (uint32_t i = 0; i < TIER_WARM_SLOTS; i++) {
+        const device_tier_record_t* record = &warm[i];
+        if ((record->kind & (FLAG_USED | FLAG_HOT)) == FLAG_USED) {
+            uint32_t age = now_s - record->last_s;
+            octaves[age == 0 ? 0 : min(32 - __builtin_clz(age), AGE_OCTAVES - 1)]++;
+        }
+    }
+    uint32_t taken = 0;
+    int8_t cutoff = AGE_OCTAVES - 1;
+    while (cutoff > 0 && taken + octaves[cutoff] < TIER_FLUSH_RECORDS) {
+        taken += octaves[cutoff];
+        cutoff--;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < TIER_WARM_SLOTS && count < TIER_FLUSH_RECORDS; i++) {
+        const device_tier_record_t* record = &warm[i];
+        if ((record->kind & (FLAG_USED | FLAG_HOT)) != FLAG_USED) {
+            continue;
+        }
+        uint32_t age = now_s - record->last_s;
+        if ((age == 0 ? 0 : min(32 - __builtin_clz(age), AGE_OCTAVES - 1)) >= cutoff) {
+            flushing[count] = *record;
+            flushing[count].kind &= CARD_FLAGS;
+            count++;
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+
+    // Keys are looked up again as each removal shifts the slots after it
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t slot = warm_find(flushing[i].mac, flushing[i].kind & KIND_MASK);
+        if (slot >= 0) {
+            warm_remove((uint32_t)slot);
+        }
+    }
+    if (card) {
+        flush_count = count;
+        writing = true;
+        flush_pending = !job_pool_submit(JOB_LANE_LOW, flush_job, NULL, 0);
+        return;
+    }
+    portENTER_CRITICAL(&tier_mux);
+    stats.discarded += count;
+    portEXIT_CRITICAL(&tier_mux);
+    LOGW(SCAN, "⚠️  No card: %lu oldest device records let go", count);
+}
+
+/**
+ * @brief Sort a flush, write it as the next run and merge what that fills, on a worker
+ */
+static void flush_job(void* payload) {
+    xSemaphoreTake(work_lock, portMAX_DELAY);
+    uint32_t count = flush_count;
+    qsort(flushing, count, sizeof(device_tier_record_t), compare_records);
+
+    run_writer_t writer;
+    bool ok = open_run(&writer, count);
+    if (ok) {
+        put_records(&writer, flushing, count);
+        ok = close_run(&writer, 0, NULL);
+    }
+    if (ok) {
+        tier_run_t run = { writer.number, count, writer.bloom_bits, writer.bloom, TIER_BLOOM_HASHES, 0 };
+        add_run(&run, NULL);
+        LOGI(SCAN, "🧊 %lu device records to %s", count, writer.path);
+    } else {
+        LOGW(SCAN, "⚠️  Device tier run write failed - %lu records lost", count);
+    }
+    portENTER_CRITICAL(&tier_mux);
+    stats.flushes += ok ? 1 : 0;
+    stats.write_failures += ok ? 0 : 1;
+    portEXIT_CRITICAL(&tier_mux);
+
+    // Indexed before the flag clears, so a device the filters miss is new
+    writing = false;
+    if (ok) {
+        compact();
+    }
+    xSemaphoreGive(work_lock);
+}
+
+/**
+ * @brief Index the card's runs and load their filters, on a worker
+ */
+static void load_job(void* payload) {
+    xSemaphoreTake(work_lock, portMAX_DELAY);
+    uint16_t count = read_footers();
+
+    // A merged run that was complete replaces its inputs, whether or not they were removed
+    for (uint16_t i = 0; i < count; i++) {
+        for (uint16_t j = 0; j < count; j++) {
+            bool replaced = false;
+            for (uint8_t r = 0; r < DEVICE_TIER_REPLACES; r++) {
+                replaced |= i != j && footers[j].replaces[r] == footer_numbers[i];
+            }
+            if (replaced) {
+                footers[i].records = 0;
+                break;
+            }
+        }
+    }
+
+    uint32_t newest_s = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        char path[40];
+        run_path(footer_numbers[i], path, sizeof(path));
+        next_number = max(next_number, footer_numbers[i] + 1);
+        if (footers[i].records == 0) {
+            spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+            SD.remove(path);
+            spi_bus_release(SPI_DEVICE_SD);
+            continue;
+        }
+        newest_s = max(newest_s, footers[i].newest_s);
+
+        // A filter that cannot be held or read back only costs reads
+        tier_run_t run = { footer_numbers[i], footers[i].records, footers[i].bloom_bits, NULL,
+                           footers[i].bloom_hashes, footers[i].level };
+        uint32_t bloom_bytes = (run.bloom_bits + 7) / 8;
+        run.bloom = bloom_bytes > 0 ? (uint8_t*)mem_alloc(MEM_BULK, bloom_bytes) : NULL;
+        if (run.bloom != NULL) {
+            spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+            File file = SD.open(path, "r");
+            bool read = file && file.seek(run.records * sizeof(device_tier_record_t)) &&
+                        file.read(run.bloom, bloom_bytes) == bloom_bytes;
+            if (file) {
+                file.close();
+            }
+            spi_bus_release(SPI_DEVICE_SD);
+            if (!read || esp_rom_crc32_le(0, run.bloom, bloom_bytes) != footers[i].crc32) {
+                mem_free(MEM_BULK, run.bloom, bloom_bytes);
+                run.bloom = NULL;
+            }
+        }
+        if (run.bloom == NULL) {
+            run.bloom_bits = 0;
+        }
+        add_run(&run, NULL);
+    }
+
+    clock_floor_s = newest_s;
+    loaded = true;
+    loading = false;
+    publish_index();
+    device_tier_stats_t figures;
+    device_tier_get_stats(&figures);
+    LOGI(SCAN, "🧊 Device tier: %u runs, %lu records on the card", figures.runs, figures.cold_records);
+    compact();
+    xSemaphoreGive(work_lock);
+}
+
+/**
+ * @brief Look for a returning device in the runs that may hold it, on a worker
+ */
+static void recall_job(void* payload) {
+    const recall_job_t* job = (const recall_job_t*)payload;
+    uint64_t key = record_key(job->mac, job->kind);
+    recall_t result;
+    memcpy(result.mac, job->mac, sizeof(result.mac));
+    result.kind = job->kind;
+    result.found = false;
+
+    xSemaphoreTake(work_lock, portMAX_DELAY);
+    // The runs may have been merged since it was submitted; newest first
+    tier_run_t candidates[TIER_RUNS_MAX];
+    uint16_t count = 0;
+    xSemaphoreTake(runs_lock, portMAX_DELAY);
+    for (int16_t i = (int16_t)run_count - 1; i >= 0; i--) {
+        if (bloom_admits(&runs[i], key)) {
+            candidates[count++] = runs[i];
+        }
+    }
+    xSemaphoreGive(runs_lock);
+
+    uint16_t misses = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        device_tier_record_t record;
+        if (!search_run(candidates[i].number, candidates[i].records, key, &record)) {
+            misses++;
+            continue;
+        }
+        if (!result.found) {
+            result.record = record;
+            result.found = true;
+        } else {
+            fold_older(&result.record, &record);
+        }
+        if (result.record.kind & DEVICE_TIER_WHOLE) {
+            break;
+        }
+    }
+    xSemaphoreGive(work_lock);
+
+    portENTER_CRITICAL(&tier_mux);
+    recalls[recall_count++] = result;   // Never more in flight than it holds
+    stats.lookups++;
+    stats.filter_false += misses;
+    portEXIT_CRITICAL(&tier_mux);
+}
+
+/**
+ * @brief Merge the oldest runs of the lowest level holding TIER_MERGE_FANIN, until none does
+ */
+static void compact(void) {
+    for (;;) {
+        tier_run_t inputs[TIER_MERGE_FANIN];
+        uint8_t count = 0;
+        xSemaphoreTake(runs_lock, portMAX_DELAY);
+        uint8_t deepest = 0;
+        for (uint16_t i = 0; i < run_count; i++) {
+            deepest = max(deepest, runs[i].level);
+        }
+        for (uint16_t level = 0; level <= deepest && count < TIER_MERGE_FANIN; level++) {
+            count = 0;
+            for (uint16_t i = 0; i < run_count && count < TIER_MERGE_FANIN; i++) {
+                if (runs[i].level == level) {
+                    inputs[count++] = runs[i];
+                }
+            }
+        }
+        xSemaphoreGive(runs_lock);
+        if (count < TIER_MERGE_FANIN || !merge_runs(inputs)) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Merge runs of one level, oldest first, into one of the next
+ *
+ * Keys are taken in order from the heads of the inputs; of a key held by
+ * several, the newest input's record comes first and the older ones are
+ * folded into it.
+ */
+static bool merge_runs(const tier_run_t* inputs) {
+    File files[TIER_MERGE_FANIN];
+    uint32_t left[TIER_MERGE_FANIN];        // Records not yet read
+    uint16_t head[TIER_MERGE_FANIN];        // Into the input's buffer
+    uint16_t held[TIER_MERGE_FANIN];        // Records in it
+    device_tier_record_t* output = merge_buffers + TIER_MERGE_FANIN * TIER_READ_RECORDS;
+    uint32_t expected = 0;
+    uint32_t replaces[DEVICE_TIER_REPLACES] = {0};
+    bool ok = true;
+
+    for (uint8_t i = 0; i < TIER_MERGE_FANIN; i++) {
+        char path[40];
+        run_path(inputs[i].number, path, sizeof(path));
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        files[i] = SD.open(path, "r");
+        spi_bus_release(SPI_DEVICE_SD);
+        ok &= (bool)files[i];
+        left[i] = inputs[i].records;
+        head[i] = 0;
+        held[i] = 0;
+        expected += inputs[i].records;
+        replaces[i] = inputs[i].number;
+    }
+
+    run_writer_t writer;
+    ok = ok && open_run(&writer, expected);
+    uint16_t out = 0;
+    uint32_t written = 0;
+    uint32_t folded = 0;
+    while (ok) {
+        // Refill the empty buffers, then find the smallest key at the heads
+        int8_t pick = -1;
+        uint64_t pick_key = 0;
+        for (uint8_t i = 0; i < TIER_MERGE_FANIN && ok; i++) {
+            device_tier_record_t* buffer = merge_buffers + i * TIER_READ_RECORDS;
+            if (head[i] == held[i] && left[i] > 0) {
+                uint16_t want = (uint16_t)min(left[i], (uint32_t)TIER_READ_RECORDS);
+                spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+                ok = files[i].read((uint8_t*)buffer, want * sizeof(device_tier_record_t)) ==
+                     want * sizeof(device_tier_record_t);
+                spi_bus_release(SPI_DEVICE_SD);
+                left[i] -= want;
+                head[i] = 0;
+                held[i] = want;
+            }
+            if (head[i] < held[i]) {
+                uint64_t key = record_key(buffer[head[i]].mac, buffer[head[i]].kind);
+                // Ties go to the later input, the newer run
+                if (pick < 0 || key <= pick_key) {
+                    pick = (int8_t)i;
+                    pick_key = key;
+                }
+            }
+        }
+        if (!ok || pick < 0) {
+            break;
+        }
+
+        device_tier_record_t* merged = &output[out];
+        *merged = merge_buffers[pick * TIER_READ_RECORDS + head[pick]++];
+        for (int8_t i = pick - 1; i >= 0; i--) {
+            device_tier_record_t* buffer = merge_buffers + i * TIER_READ_RECORDS;
+            if (head[i] < held[i] && record_key(buffer[head[i]].mac, buffer[head[i]].kind) == pick_key) {
+                fold_older(merged, &buffer[head[i]++]);
+                folded++;
+            }
+        }
+        if (++out == TIER_READ_RECORDS) {
+            put_records(&writer, output, out);
+            written += out;
+            out = 0;
+        }
+    }
+
+    for (uint8_t i = 0; i < TIER_MERGE_FANIN; i++) {
+        if (files[i]) {
+            spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+            files[i].close();
+            spi_bus_release(SPI_DEVICE_SD);
+        }
+    }
+    if (writer.file && out > 0) {
+        put_records(&writer, output, out);
+        written += out;
+    }
+    if (writer.file) {
+        writer.ok &= ok;
+        ok = close_run(&writer, inputs[0].level + 1, replaces);
+    }
+    if (!ok) {
+        // close_run() has removed a failed output; the inputs stay for the next flush
+        LOGW(SCAN, "⚠️  Device tier merge of level %u failed", inputs[0].level);
+        portENTER_CRITICAL(&tier_mux);
+        stats.write_failures++;
+        portEXIT_CRITICAL(&tier_mux);
+        return false;
+    }
+
+    tier_run_t run = { writer.number, written, writer.bloom_bits, writer.bloom, TIER_BLOOM_HASHES,
+                       (uint8_t)(inputs[0].level + 1) };
+    add_run(&run, replaces);
+    for (uint8_t i = 0; i < TIER_MERGE_FANIN; i++) {
+        char path[40];
+        run_path(inputs[i].number, path, sizeof(path));
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        SD.remove(path);
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+    LOGI(SCAN, "🧊 %u device runs merged into %s: %lu records, %lu folded",
+         TIER_MERGE_FANIN, writer.path, written, folded);
+    portENTER_CRITICAL(&tier_mux);
+    stats.merges++;
+    stats.merged_records += written;
+    stats.folded += folded;
+    portEXIT_CRITICAL(&tier_mux);
+    return true;
+}
+
+/**
+ * @brief Open the next run file, with a filter sized for the records to come
+ */
+static bool open_run(run_writer_t* writer, uint32_t expected) {
+    writer->number = next_number++;
+    writer->records = 0;
+    writer->newest_s = 0;
+    writer->ok = true;
+    run_path(writer->number, writer->path, sizeof(writer->path));
+
+    // Without room for a filter the run is still written; lookups read it
+    writer->bloom_bits = max(expected * TIER_BLOOM_BITS_PER_KEY, (uint32_t)64);
+    writer->bloom = (uint8_t*)mem_calloc(MEM_BULK, 1, (writer->bloom_bits + 7) / 8);
+    if (writer->bloom == NULL) {
+        writer->bloom_bits = 0;
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (SD.exists(TIER_DIR) || SD.mkdir(TIER_DIR)) {
+        writer->file = SD.open(writer->path, "w");
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!writer->file) {
+        mem_free(MEM_BULK, writer->bloom, (writer->bloom_bits + 7) / 8);
+        writer->bloom = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Append sorted records and add them to the filter
+ */
+static void put_records(run_writer_t* writer, const device_tier_record_t* records, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (writer->bloom != NULL) {
+            uint32_t h1, h2;
+            bloom_hashes(record_key(records[i].mac, records[i].kind), &h1, &h2);
+            for (uint8_t k = 0; k < TIER_BLOOM_HASHES; k++) {
+                uint32_t bit = (h1 + k * h2) % writer->bloom_bits;
+                writer->bloom[bit >> 3] |= 1 << (bit & 7);
+            }
+        }
+        writer->newest_s = max(writer->newest_s, records[i].last_s);
+    }
+
+    uint32_t length = count * sizeof(device_tier_record_t);
+    uint32_t max_chunk = sd_bench_block_bytes(TIER_WRITE_CHUNK);
+    const uint8_t* bytes = (const uint8_t*)records;
+    for (uint32_t done = 0; done < length && writer->ok; done += max_chunk) {
+        size_t chunk = min(length - done, max_chunk);
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        writer->ok = writer->file.write(bytes + done, chunk) == chunk;
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+    writer->records += count;
+}
+
+/**
+ * @brief Write the filter and footer and close; a run that failed is removed with its filter
+ */
+static bool close_run(run_writer_t* writer, uint8_t level, const uint32_t* replaces) {
+    uint32_t bloom_bytes = (writer->bloom_bits + 7) / 8;
+    device_tier_footer_t footer;
+    memset(&footer, 0, sizeof(footer));
+    footer.records = writer->records;
+    footer.bloom_bits = writer->bloom_bits;
+    footer.format = DEVICE_TIER_FORMAT;
+    footer.bloom_hashes = TIER_BLOOM_HASHES;
+    footer.level = level;
+    footer.newest_s = writer->newest_s;
+    if (replaces != NULL) {
+        memcpy(footer.replaces, replaces, sizeof(footer.replaces));
+    }
+    footer.crc32 = bloom_bytes > 0 ? esp_rom_crc32_le(0, writer->bloom, bloom_bytes) : 0;
+    footer.magic = DEVICE_TIER_MAGIC;
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    bool ok = writer->ok &&
+              (bloom_bytes == 0 || writer->file.write(writer->bloom, bloom_bytes) == bloom_bytes) &&
+              writer->file.write((const uint8_t*)&footer, sizeof(footer)) == sizeof(footer);
+    writer->file.close();
+    if (!ok) {
+        SD.remove(writer->path);    // A run without its footer is removed at load anyway
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!ok) {
+        mem_free(MEM_BULK, writer->bloom, bloom_bytes);
+        writer->bloom = NULL;
+    }
+    return ok;
+}
+
+/**
+ * @brief Add a run to the index, dropping the runs it replaces and their filters
+ */
+static void add_run(const tier_run_t* run, const uint32_t* replaced) {
+    xSemaphoreTake(runs_lock, portMAX_DELAY);
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < run_count; i++) {
+        bool drop = false;
+        for (uint8_t r = 0; replaced != NULL && r < DEVICE_TIER_REPLACES; r++) {
+            drop |= replaced[r] == runs[i].number;
+        }
+        if (drop) {
+            mem_free(MEM_BULK, runs[i].bloom, (runs[i].bloom_bits + 7) / 8);
+        } else {
+            runs[kept++] = runs[i];
+        }
+    }
+    run_count = kept;
+    if (run_count < TIER_RUNS_MAX) {
+        runs[run_count++] = *run;   // Numbers only grow, so the index stays oldest first
+    } else {
+        mem_free(MEM_BULK, run->bloom, (run->bloom_bits + 7) / 8);
+    }
+    xSemaphoreGive(runs_lock);
+    publish_index();
+}
+
+/**
+ * @brief Binary search of one run on the card
+ */
+static bool search_run(uint32_t number, uint32_t records, uint64_t key, device_tier_record_t* out) {
+    char path[40];
+    run_path(number, path, sizeof(path));
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(path, "r");
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!file) {
+        return false;
+    }
+
+    bool found = false;
+    uint32_t low = 0;
+    uint32_t high = records;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        bool read = file.seek(middle * sizeof(device_tier_record_t)) &&
+                    file.read((uint8_t*)out, sizeof(*out)) == sizeof(*out);
+        spi_bus_release(SPI_DEVICE_SD);
+        if (!read) {
+            break;
+        }
+        uint64_t probe = record_key(out->mac, out->kind);
+        if (probe == key) {
+            found = true;
+            break;
+        }
+        if (probe < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    file.close();
+    spi_bus_release(SPI_DEVICE_SD);
+    return found;
+}
+
+/**
+ * @brief Footers of the run files in TIER_DIR, into footers[]; a file without one is removed
+ * @return Runs found, at most TIER_RUNS_MAX
+ */
+static uint16_t read_footers(void) {
+    uint16_t count = 0;
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File dir = SD.open(TIER_DIR);
+    if (dir && dir.isDirectory()) {
+        for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+            // Named by run_path(): run_NNNNN.htr, with more digits past 99999
+            const char* slash = strrchr(file.name(), '/');
+            const char* base = slash != NULL ? slash + 1 : file.name();
+            unsigned long number;
+            char suffix[8];
+            if (sscanf(base, "run_%lu%7s", &number, suffix) != 2 || strcmp(suffix, ".htr") != 0) {
+                file.close();
+                continue;
+            }
+            device_tier_footer_t footer;
+            size_t size = file.size();
+            bool valid = size >= sizeof(footer) && file.seek(size - sizeof(footer)) &&
+                         file.read((uint8_t*)&footer, sizeof(footer)) == sizeof(footer) &&
+                         footer.magic == DEVICE_TIER_MAGIC && footer.format == DEVICE_TIER_FORMAT &&
+                         size == footer.records * sizeof(device_tier_record_t) +
+                                 (footer.bloom_bits + 7) / 8 + sizeof(footer);
+            file.close();
+            if (!valid) {
+                char path[40];
+                run_path(number, path, sizeof(path));
+                SD.remove(path);
+            } else if (count < TIER_RUNS_MAX) {
+                footers[count] = footer;
+                footer_numbers[count++] = number;
+            }
+        }
+    }
+    if (dir) {
+        dir.close();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+
+    // Oldest first, as the index keeps them
+    for (uint16_t i = 1; i < count; i++) {
+        device_tier_footer_t footer = footers[i];
+        uint32_t number = footer_numbers[i];
+        uint16_t j = i;
+        for (; j > 0 && footer_numbers[j - 1] > number; j--) {
+            footers[j] = footers[j - 1];
+            footer_numbers[j] = footer_numbers[j - 1];
+        }
+        footers[j] = footer;
+        footer_numbers[j] = number;
+    }
+    return count;
+}
+
+/**
+ * @brief Fold an older record of the same device into a newer one
+ *
+ * A whole record already holds every older one. One with no sightings of
+ * its own, a device back in range whose stay is not over, takes the older
+ * record's history as it is.
+ */
+static void fold_older(device_tier_record_t* newer, const device_tier_record_t* older) {
+    if (newer->kind & DEVICE_TIER_WHOLE) {
+        return;
+    }
+    if (newer->sightings == 0) {
+        uint8_t flags = newer->kind & (FLAG_USED | FLAG_HOT);
+        *newer = *older;
+        newer->kind = (older->kind & CARD_FLAGS) | flags;
+        return;
+    }
+    uint32_t first_s = min(newer->last_s - newer->span_s, older->last_s - older->span_s);
+    newer->last_s = max(newer->last_s, older->last_s);
+    newer->span_s = newer->last_s - first_s;
+    newer->sightings += older->sightings;
+    newer->stays = (uint8_t)min(newer->stays + older->stays, UINT8_MAX);
+    newer->rssi_min = min(newer->rssi_min, older->rssi_min);
+    newer->rssi_max = max(newer->rssi_max, older->rssi_max);
+    newer->kind |= older->kind & DEVICE_TIER_WHOLE;
+}
+
+/**
+ * @brief Fold a device's stay in the table into its record
+ */
+static void fold_stay(device_tier_record_t* record, const device_entry_t* entry, uint32_t now_ms) {
+    uint32_t now_s = tier_clock(now_ms);
+    uint32_t last_s = now_s - (now_ms - entry->last_seen_ms) / 1000;
+    uint32_t first_s = now_s - (now_ms - entry->first_seen_ms) / 1000;
+    if (record->sightings > 0) {
+        first_s = min(first_s, record->last_s - record->span_s);
+        record->rssi_min = min(record->rssi_min, entry->rssi_min);
+        record->rssi_max = max(record->rssi_max, entry->rssi_max);
+    } else {
+        record->rssi_min = entry->rssi_min;
+        record->rssi_max = entry->rssi_max;
+    }
+    record->last_s = max(record->last_s, last_s);
+    record->span_s = record->last_s - first_s;
+    record->sightings += entry->sightings;
+    record->stays = (uint8_t)min(record->stays + 1, UINT8_MAX);
+    record->rssi_mean = (int8_t)(entry->rssi_ewma_x16 / 16);
+    if (entry->channel != 0) {
+        record->channel = entry->channel;
+    }
+}
+
+/**
+ * @brief Probe the warm tier for a device, stopping at the first empty slot
+ */
+static int32_t warm_find(const uint8_t* mac, uint8_t kind) {
+    uint32_t index = warm_hash(mac, kind) & WARM_MASK;
+    while (warm[index].kind & FLAG_USED) {
+        if ((warm[index].kind & KIND_MASK) == kind && memcmp(warm[index].mac, mac, 6) == 0) {
+            return (int32_t)index;
+        }
+        index = (index + 1) & WARM_MASK;
+    }
+    return -1;
+}
+
+/**
+ * @brief A cleared record for a device at the first empty slot along its probe sequence
+ */
+static device_tier_record_t* warm_insert(const uint8_t* mac, uint8_t kind) {
+    uint32_t index = warm_hash(mac, kind) & WARM_MASK;
+    while (warm[index].kind & FLAG_USED) {
+        index = (index + 1) & WARM_MASK;
+    }
+    device_tier_record_t* record = &warm[index];
+    memset(record, 0, sizeof(*record));
+    memcpy(record->mac, mac, sizeof(record->mac));
+    record->kind = kind | FLAG_USED;
+    warm_used++;
+    return record;
+}
+
+/**
+ * @brief Delete a warm record and backward-shift its probe chain, as the device table does
+ */
+static void warm_remove(uint32_t index) {
+    uint32_t hole = index;
+    uint32_t next = (hole + 1) & WARM_MASK;
+    while (warm[next].kind & FLAG_USED) {
+        uint32_t home = warm_hash(warm[next].mac, warm[next].kind & KIND_MASK) & WARM_MASK;
+        if (((next - home) & WARM_MASK) >= ((next - hole) & WARM_MASK)) {
+            warm[hole] = warm[next];
+            hole = next;
+        }
+        next = (next + 1) & WARM_MASK;
+    }
+    warm[hole].kind = 0;
+    warm_used--;
+}
+
+/**
+ * @brief Mix the 48-bit address and kind into a 32-bit hash
+ */
+static uint32_t warm_hash(const uint8_t* mac, uint8_t kind) {
+    uint32_t low = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 |
+                   (uint32_t)mac[4] << 8 | mac[5];
+    uint32_t high = (uint32_t)mac[0] << 8 | mac[1];
+    uint32_t h = low * 0x9E3779B1UL ^ (high + kind) * 0x85EBCA77UL;
+    return h ^ (h >> 16);
+}
+
+/**
+ * @brief Sort key of a record: kind, then the address as a big-endian number
+ */
+static uint64_t record_key(const uint8_t* mac, uint8_t kind) {
+    uint64_t key = kind & KIND_MASK;
+    for (uint8_t i = 0; i < 6; i++) {
+        key = key << 8 | mac[i];
+    }
+    return key;
+}
+
+/**
+ * @brief Two 32-bit hashes of a key for double hashing
+ */
+static void bloom_hashes(uint64_t key, uint32_t* h1, uint32_t* h2) {
+    // The 64-bit murmur finalizer
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    *h1 = (uint32_t)key;
+    *h2 = (uint32_t)(key >> 32) | 1;
+}
+
+/**
+ * @brief Whether a run may hold a key; always, for a run without a filter
+ */
+static bool bloom_admits(const tier_run_t* run, uint64_t key) {
+    if (run->bloom_bits == 0) {
+        return true;
+    }
+    uint32_t h1, h2;
+    bloom_hashes(key, &h1, &h2);
+    for (uint8_t k = 0; k < run->hashes; k++) {
+        uint32_t bit = (h1 + k * h2) % run->bloom_bits;
+        if ((run->bloom[bit >> 3] & (1 << (bit & 7))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief qsort() order of records by key
+ */
+static int compare_records(const void* a, const void* b) {
+    const device_tier_record_t* left = (const device_tier_record_t*)a;
+    const device_tier_record_t* right = (const device_tier_record_t*)b;
+    uint64_t left_key = record_key(left->mac, left->kind);
+    uint64_t right_key = record_key(right->mac, right->kind);
+    return left_key < right_key ? -1 : left_key > right_key ? 1 : 0;
+}
+
+/**
+ * @brief Card path of a run; the zero padding is a minimum width, not a cap
+ */
+static void run_path(uint32_t number, char* path, size_t size) {
+    snprintf(path, size, TIER_DIR "/run_%05lu.htr", (unsigned long)number);
+}
+
+/**
+ * @brief Copy the index's totals into the figures
+ */
+static void publish_index(void) {
+    uint32_t records = 0;
+    uint32_t bloom_bytes = 0;
+    uint8_t levels = 0;
+    xSemaphoreTake(runs_lock, portMAX_DELAY);
+    uint16_t count = run_count;
+    for (uint16_t i = 0; i < count; i++) {
+        records += runs[i].records;
+        bloom_bytes += (runs[i].bloom_bits + 7) / 8;
+        levels = max(levels, (uint8_t)(runs[i].level + 1));
+    }
+    xSemaphoreGive(runs_lock);
+
+    portENTER_CRITICAL(&tier_mux);
+    stats.loaded = loaded;
+    stats.runs = count;
+    stats.levels = levels;
+    stats.cold_records = records;
+    stats.cold_bytes = records * sizeof(device_tier_record_t) + bloom_bytes +
+                       count * sizeof(device_tier_footer_t);
+    stats.bloom_bytes = bloom_bytes;
+    portEXIT_CRITICAL(&tier_mux);
+}
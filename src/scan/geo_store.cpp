@@ -0,0 +1,967 @@
+/**
+ * @file geo_store.cpp
+ * @brief Survey sightings in one card file per geohash cell, found through a directory in PSRAM
+ *
+ * A geohash interleaves longitude and latitude bits, so a prefix is a
+ * rectangle and the next character picks one of its 32 children. Rows are
+ * bucketed by a GEO_CELL_PRECISION-character prefix, kept as 30 bits, and
+ * each cell's file only ever grows: a batch is appended run by run, one
+ * run per stretch of cycles spent in the same cell, then the directory is
+ * rewritten beside the files through a temporary copy. A query looks up
+ * which cells' row bounds come within its radius and reads only those
+ * files; the bounds are of the positions actually recorded, so a query
+ * near the edge of a cell opens its neighbour only if something was heard
+ * near that edge. Without a directory on the card, e.g. after a crash
+ * between the two writes, it is rebuilt once from the files themselves.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <math.h>
+#include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "sd_bench.h"
+#include "job_pool.h"
+#include "device_table.h"
+#include "gps.h"
+#include "wardrive.h"
+#include "geo_store.h"
+#include "mem_policy.h"
+#include "text_writer.h"
+#include "logger.h"
+
+#define CHILD_BITS     5
+#define CELL_BITS      (GEO_CELL_PRECISION * CHILD_BITS)
+#define NAME_BYTES     (GEO_CELL_PRECISION + 2)
+#define BATCH_BYTES    (GEO_STAGE_ROWS * sizeof(geo_row_t))
+#define RUNS_BYTES     (GEO_STAGE_RUNS * sizeof(geo_run_t))
+#define DIRECTORY_BYTES (GEO_CELLS_MAX * sizeof(geo_cell_t))
+#define READ_BYTES     (GEO_READ_ROWS * sizeof(geo_row_t))
+#define METRES_PER_DEGREE 111320
+
+static_assert(GEO_CELL_PRECISION >= 1 && GEO_CELL_PRECISION <= 6, "a cell must fit 32 bits");
+static_assert(DEVICE_TABLE_CAPACITY <= GEO_STAGE_ROWS, "one cycle must fit a batch");
+static_assert(GEO_STAGE_ROWS <= UINT16_MAX, "run offsets are 16 bits");
+
+static const char base32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+/**
+ * @brief Consecutive staged rows of one cell
+ */
+typedef struct {
+    uint32_t cell;
+    uint16_t start;
+    uint16_t count;
+} geo_run_t;
+
+/**
+ * @brief Nearby devices found by the last POST
+ */
+typedef struct {
+    uint8_t  mac[6];
+    uint8_t  kind;
+    int8_t   rssi;                  // Strongest within the radius
+    uint32_t distance_m;            // Nearest recording
+} geo_result_device_t;
+
+typedef enum {
+    RESULT_IDLE = 0,
+    RESULT_RUNNING,
+    RESULT_DONE,
+    RESULT_FAILED
+} result_state_t;
+
+typedef struct {
+    uint8_t  state;                 // result_state_t
+    int32_t  lat_e7;
+    int32_t  lon_e7;
+    uint32_t radius_m;
+    uint32_t took_ms;
+    uint8_t  devices;
+    geo_query_stats_t query;
+    geo_result_device_t device[GEO_RESULT_MAX];
+} geo_result_t;
+
+typedef struct {
+    int32_t  lat_e7;
+    int32_t  lon_e7;
+    uint32_t radius_m;
+} query_job_t;
+
+// Two batches: the scan task fills one while a job worker writes the other
+static geo_row_t* batches[2] = { NULL, NULL };
+static geo_run_t* runs[2] = { NULL, NULL };
+static uint16_t batch_rows[2] = { 0, 0 };
+static uint16_t batch_runs[2] = { 0, 0 };
+static uint32_t batch_opened_ms[2] = { 0, 0 };
+static uint8_t filling = 0;
+static volatile bool writing = false;
+static volatile bool loading = false;
+static volatile bool loaded = false;
+
+// Last recorded cycle, for thinning while parked (scan task only)
+static bool have_last = false;
+static uint32_t last_recorded_ms = 0;
+static int32_t last_lat_e7 = 0;
+static int32_t last_lon_e7 = 0;
+
+// The directory, sorted by cell, under directory_lock
+static geo_cell_t* directory = NULL;
+static uint16_t cell_count = 0;
+static SemaphoreHandle_t directory_lock = NULL;
+static StaticSemaphore_t directory_lock_state;
+
+// Card work, one writer, loader or query at a time under work_lock
+static geo_cell_t* snapshot = NULL;             // The directory as written or read
+static geo_row_t* read_rows = NULL;
+static uint32_t query_cells[GEO_QUERY_MAX_CELLS];
+static SemaphoreHandle_t work_lock = NULL;
+static StaticSemaphore_t work_lock_state;
+
+static geo_store_stats_t stats = {0};
+static geo_result_t result = {0};
+static portMUX_TYPE geo_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void release_buffers(void);
+static bool close_batch(void);
+static void write_job(void* payload);
+static void load_job(void* payload);
+static void query_job(void* payload);
+static bool append_run(const geo_run_t* run, const geo_row_t* rows);
+static bool write_index(void);
+static void ensure_loaded(void);
+static bool read_index(uint16_t* count);
+static uint16_t rebuild_from_files(void);
+static void merge_cell(const geo_cell_t* cell);
+static int32_t find_cell(uint32_t cell, bool* found);
+static geo_cell_t* take_cell(uint32_t cell);
+static void add_position(geo_cell_t* entry, int32_t lat_e7, int32_t lon_e7, uint32_t utc_s, uint8_t child, uint32_t rows);
+static uint64_t geohash(int32_t lat_e7, int32_t lon_e7, uint8_t bits);
+static void cell_path(uint32_t cell, char* path, size_t size);
+static bool parse_cell_name(const char* name, uint32_t* cell);
+static bool collect_nearest(const geo_row_t* row, uint32_t distance_m, void* context);
+static void on_get(AsyncWebServerRequest* request);
+static void on_post(AsyncWebServerRequest* request);
+
+/**
+ * @brief Allocate the staging, directory and read buffers in PSRAM
+ */
+bool geo_store_init(void) {
+    if (batches[0] != NULL) {
+        return true;
+    }
+    batches[0] = (geo_row_t*)mem_alloc(MEM_BULK, BATCH_BYTES);
+    batches[1] = (geo_row_t*)mem_alloc(MEM_BULK, BATCH_BYTES);
+    runs[0] = (geo_run_t*)mem_alloc(MEM_BULK, RUNS_BYTES);
+    runs[1] = (geo_run_t*)mem_alloc(MEM_BULK, RUNS_BYTES);
+    directory = (geo_cell_t*)mem_alloc(MEM_BULK, DIRECTORY_BYTES);
+    snapshot = (geo_cell_t*)mem_alloc(MEM_BULK, DIRECTORY_BYTES);
+    read_rows = (geo_row_t*)mem_alloc(MEM_BULK, READ_BYTES);
+    if (batches[0] == NULL || batches[1] == NULL || runs[0] == NULL || runs[1] == NULL ||
+        directory == NULL || snapshot == NULL || read_rows == NULL) {
+        release_buffers();
+        LOGE(SCAN, "❌ Geo store buffers allocation failed");
+        return false;
+    }
+    directory_lock = xSemaphoreCreateMutexStatic(&directory_lock_state);
+    work_lock = xSemaphoreCreateMutexStatic(&work_lock_state);
+    LOGI(SCAN, "✅ Geo store: %d-character cells, %d at most", GEO_CELL_PRECISION, GEO_CELLS_MAX);
+    return true;
+}
+
+/**
+ * @brief Stage a row for every device seen in the closing scan cycle, at the current fix
+ */
+void geo_store_record_cycle(uint16_t cycle, uint32_t now_ms) {
+    if (batches[0] == NULL) {
+        return;
+    }
+    // The card's directory first, so cells surveyed on earlier drives count
+    if (!loaded && !loading && sd_monitor_mounted()) {
+        loading = true;
+        if (!job_pool_submit(JOB_LANE_LOW, load_job, NULL, 0)) {
+            loading = false;        // Retried next cycle
+        }
+    }
+
+    gps_fix_t fix;
+    if (!gps_get_fix(&fix)) {
+        return;
+    }
+
+    // Parked close to the last recorded cycle: only the devices new since then
+    bool thin = have_last && now_ms - last_recorded_ms < GEO_REFRESH_MS &&
+                wardrive_distance_m(last_lat_e7, last_lon_e7, fix.lat_e7, fix.lon_e7) < GEO_RECORD_MIN_M;
+    uint32_t capacity = device_table_capacity();
+    uint16_t seen = 0;
+    for (uint32_t i = 0; i < capacity; i++) {
+        const device_entry_t* entry = device_table_entry_at(i);
+        if (entry != NULL && entry->last_cycle == cycle &&
+            (!thin || (int32_t)(entry->first_seen_ms - last_recorded_ms) > 0)) {
+            seen++;
+        }
+    }
+    if (!thin) {
+        have_last = true;
+        last_recorded_ms = now_ms;
+        last_lat_e7 = fix.lat_e7;
+        last_lon_e7 = fix.lon_e7;
+    }
+
+    uint64_t hash = geohash(fix.lat_e7, fix.lon_e7, CELL_BITS + CHILD_BITS);
+    uint32_t cell = (uint32_t)(hash >> CHILD_BITS);
+    uint8_t child = (uint8_t)(hash & ((1 << CHILD_BITS) - 1));
+
+    // Room in the cell, then in the batch
+    xSemaphoreTake(directory_lock, portMAX_DELAY);
+    bool found;
+    int32_t at = find_cell(cell, &found);
+    bool capped = found ? directory[at].rows + seen > GEO_CELL_MAX_ROWS : cell_count >= GEO_CELLS_MAX;
+    xSemaphoreGive(directory_lock);
+
+    uint16_t fill_runs = batch_runs[filling];
+    bool new_run = fill_runs == 0 || runs[filling][fill_runs - 1].cell != cell;
+    if (seen > 0 && !capped && (batch_rows[filling] + seen > GEO_STAGE_ROWS ||
+                                (new_run && fill_runs >= GEO_STAGE_RUNS))) {
+        close_batch();
+        new_run = true;
+    }
+    bool room = batch_rows[filling] + seen <= GEO_STAGE_ROWS &&
+                (!new_run || batch_runs[filling] < GEO_STAGE_RUNS);
+
+    portENTER_CRITICAL(&geo_mux);
+    stats.cycles_recorded += thin ? 0 : 1;
+    stats.cycles_thinned += thin ? 1 : 0;
+    if (seen > 0 && capped) {
+        stats.rows_capped += seen;
+    } else if (seen > 0 && !room) {
+        stats.rows_dropped += seen;
+    }
+    portEXIT_CRITICAL(&geo_mux);
+    if (seen == 0 || capped || !room) {
+        return;
+    }
+
+    uint16_t start = batch_rows[filling];
+    if (start == 0) {
+        batch_opened_ms[filling] = now_ms;
+    }
+    geo_row_t* rows = batches[filling];
+    uint16_t row = start;
+    for (uint32_t i = 0; i < capacity && row < start + seen; i++) {
+        const device_entry_t* entry = device_table_entry_at(i);
+        if (entry == NULL || entry->last_cycle != cycle ||
+            (thin && (int32_t)(entry->first_seen_ms - last_recorded_ms) <= 0)) {
+            continue;
+        }
+        geo_row_t* out = &rows[row++];
+        out->lat_e7 = fix.lat_e7;
+        out->lon_e7 = fix.lon_e7;
+        out->utc_s = fix.utc_s;
+        memcpy(out->mac, entry->mac, sizeof(out->mac));
+        out->kind = entry->kind;
+        out->rssi = entry->rssi_last;
+    }
+    batch_rows[filling] = row;
+    if (new_run) {
+        geo_run_t* run = &runs[filling][batch_runs[filling]++];
+        run->cell = cell;
+        run->start = start;
+        run->count = 0;
+    }
+    runs[filling][batch_runs[filling] - 1].count += seen;
+
+    // The directory counts staged rows, so "surveyed" holds from this cycle on
+    xSemaphoreTake(directory_lock, portMAX_DELAY);
+    geo_cell_t* entry = take_cell(cell);
+    if (entry != NULL) {
+        add_position(entry, fix.lat_e7, fix.lon_e7, fix.utc_s, child, seen);
+    }
+    xSemaphoreGive(directory_lock);
+    portENTER_CRITICAL(&geo_mux);
+    stats.rows_staged += seen;
+    portEXIT_CRITICAL(&geo_mux);
+
+    // Write the batch once the next cycle might not fit, or once it is old
+    uint16_t staged = batch_rows[filling];
+    if (staged + device_table_count() > GEO_STAGE_ROWS || batch_runs[filling] >= GEO_STAGE_RUNS ||
+        now_ms - batch_opened_ms[filling] >= GEO_FLUSH_MS) {
+        close_batch();
+    }
+}
+
+/**
+ * @brief Whether rows were recorded in the child cell of a position
+ */
+bool geo_store_surveyed(int32_t lat_e7, int32_t lon_e7) {
+    if (directory == NULL) {
+        return false;
+    }
+    uint64_t hash = geohash(lat_e7, lon_e7, CELL_BITS + CHILD_BITS);
+    xSemaphoreTake(directory_lock, portMAX_DELAY);
+    bool found;
+    int32_t at = find_cell((uint32_t)(hash >> CHILD_BITS), &found);
+    bool surveyed = found && (directory[at].surveyed & (1UL << (hash & ((1 << CHILD_BITS) - 1)))) != 0;
+    xSemaphoreGive(directory_lock);
+    return surveyed;
+}
+
+/**
+ * @brief Hand every stored row within a radius of a position to a callback
+ */
+bool geo_store_query(int32_t lat_e7, int32_t lon_e7, uint32_t radius_m, geo_row_fn fn, void* context,
+                     geo_query_stats_t* out) {
+    memset(out, 0, sizeof(*out));
+    if (read_rows == NULL || !sd_monitor_mounted()) {
+        return false;
+    }
+
+    // A box around the circle; longitude degrees shrink towards the poles
+    int64_t dlat = (int64_t)radius_m * 10000000LL / METRES_PER_DEGREE;
+    float cos_lat = max(cosf((float)lat_e7 * (float)M_PI / 180.0f / 1e7f), 0.01f);
+    int64_t dlon = (int64_t)((float)dlat / cos_lat);
+    int64_t min_lat = (int64_t)lat_e7 - dlat;
+    int64_t max_lat = (int64_t)lat_e7 + dlat;
+    int64_t min_lon = (int64_t)lon_e7 - dlon;
+    int64_t max_lon = (int64_t)lon_e7 + dlon;
+
+    xSemaphoreTake(work_lock, portMAX_DELAY);
+    uint16_t wanted = 0;
+    xSemaphoreTake(directory_lock, portMAX_DELAY);
+    for (uint16_t i = 0; i < cell_count; i++) {
+        const geo_cell_t* entry = &directory[i];
+        if (entry->rows == 0 || entry->max_lat_e7 < min_lat || entry->min_lat_e7 > max_lat ||
+            entry->max_lon_e7 < min_lon || entry->min_lon_e7 > max_lon) {
+            continue;
+        }
+        out->cells++;
+        if (wanted < GEO_QUERY_MAX_CELLS) {
+            query_cells[wanted++] = entry->cell;
+        } else {
+            out->truncated = true;
+        }
+    }
+    xSemaphoreGive(directory_lock);
+
+    bool more = true;
+    for (uint16_t c = 0; c < wanted && more; c++) {
+        char path[40];
+        cell_path(query_cells[c], path, sizeof(path));
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        File file = SD.open(path, "r");
+        spi_bus_release(SPI_DEVICE_SD);
+        if (!file) {
+            continue;
+        }
+        out->cells_read++;
+        while (more) {
+            spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+            size_t bytes = file.read((uint8_t*)read_rows, READ_BYTES);
+            spi_bus_release(SPI_DEVICE_SD);
+            size_t count = bytes / sizeof(geo_row_t);
+            if (count == 0) {
+                break;
+            }
+            out->bytes_read += bytes;
+            for (size_t r = 0; r < count && more; r++) {
+                const geo_row_t* row = &read_rows[r];
+                if (row->lat_e7 < min_lat || row->lat_e7 > max_lat ||
+                    row->lon_e7 < min_lon || row->lon_e7 > max_lon) {
+                    continue;
+                }
+                uint32_t distance = wardrive_distance_m(lat_e7, lon_e7, row->lat_e7, row->lon_e7);
+                if (distance <= radius_m) {
+                    out->rows++;
+                    more = fn(row, distance, context);
+                }
+            }
+        }
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        file.close();
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+    xSemaphoreGive(work_lock);
+
+    portENTER_CRITICAL(&geo_mux);
+    stats.queries++;
+    stats.query_bytes_read += out->bytes_read;
+    portEXIT_CRITICAL(&geo_mux);
+    return true;
+}
+
+/**
+ * @brief Geohash of a position, precision characters and a terminator
+ */
+void geo_store_cell_name(int32_t lat_e7, int32_t lon_e7, uint8_t precision, char* out) {
+    precision = min(precision, (uint8_t)12);
+    uint64_t hash = geohash(lat_e7, lon_e7, precision * CHILD_BITS);
+    for (uint8_t i = 0; i < precision; i++) {
+        out[i] = base32[(hash >> ((precision - 1 - i) * CHILD_BITS)) & 31];
+    }
+    out[precision] = '\0';
+}
+
+/**
+ * @brief Add GEO_PATH to the web server
+ */
+void geo_store_register(AsyncWebServer* server) {
+    server->on(GEO_PATH, HTTP_GET, on_get);
+    server->on(GEO_PATH, HTTP_POST, on_post);
+}
+
+/**
+ * @brief Copy the store figures
+ */
+void geo_store_get_stats(geo_store_stats_t* out) {
+    portENTER_CRITICAL(&geo_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&geo_mux);
+    out->loaded = loaded;
+    if (directory_lock != NULL) {
+        xSemaphoreTake(directory_lock, portMAX_DELAY);
+        out->cells = cell_count;
+        out->rows = 0;
+        for (uint16_t i = 0; i < cell_count; i++) {
+            out->rows += directory[i].rows;
+        }
+        xSemaphoreGive(directory_lock);
+    }
+}
+
+/**
+ * @brief Free whatever init managed to allocate
+ */
+static void release_buffers(void) {
+    mem_free(MEM_BULK, batches[0], BATCH_BYTES);
+    mem_free(MEM_BULK, batches[1], BATCH_BYTES);
+    mem_free(MEM_BULK, runs[0], RUNS_BYTES);
+    mem_free(MEM_BULK, runs[1], RUNS_BYTES);
+    mem_free(MEM_BULK, directory, DIRECTORY_BYTES);
+    mem_free(MEM_BULK, snapshot, DIRECTORY_BYTES);
+    mem_free(MEM_BULK, read_rows, READ_BYTES);
+    batches[0] = batches[1] = NULL;
+    runs[0] = runs[1] = NULL;
+    directory = NULL;
+    snapshot = NULL;
+    read_rows = NULL;
+}
+
+/**
+ * @brief Hand the filling batch to a job worker and start on the other one
+ * @return false if the other one is still being written, or there is no card
+ */
+static bool close_batch(void) {
+    if (writing || !sd_monitor_mounted()) {
+        return false;
+    }
+    uint8_t full = filling;
+    writing = true;
+    if (!job_pool_submit(JOB_LANE_LOW, write_job, &full, sizeof(full))) {
+        writing = false;            // Retried after the next cycle
+        return false;
+    }
+    filling ^= 1;
+    batch_rows[filling] = 0;
+    batch_runs[filling] = 0;
+    return true;
+}
+
+/**
+ * @brief Append a batch to its cells' files and rewrite the directory, on a job worker
+ */
+static void write_job(void* payload) {
+    uint8_t which = *(const uint8_t*)payload;
+    uint16_t count = batch_rows[which];
+    if (count == 0) {
+        writing = false;
+        return;
+    }
+
+    xSemaphoreTake(work_lock, portMAX_DELAY);
+    ensure_loaded();
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    bool ok = (SD.exists(TRACE_LOG_DIR) || SD.mkdir(TRACE_LOG_DIR)) &&
+              (SD.exists(GEO_STORE_DIR) || SD.mkdir(GEO_STORE_DIR));
+    spi_bus_release(SPI_DEVICE_SD);
+    uint16_t written = 0;
+    for (uint16_t r = 0; ok && r < batch_runs[which]; r++) {
+        ok = append_run(&runs[which][r], batches[which]);
+        written += ok ? runs[which][r].count : 0;
+    }
+    ok = ok && write_index();
+    xSemaphoreGive(work_lock);
+
+    if (ok) {
+        LOGI(SCAN, "🗺️  %u sightings in %u cell runs added to the geo store", count, batch_runs[which]);
+    } else {
+        LOGW(SCAN, "⚠️  Geo store write failed - %u of %u rows written", written, count);
+    }
+    portENTER_CRITICAL(&geo_mux);
+    if (ok) {
+        stats.batches_written++;
+    } else {
+        stats.write_failures++;
+    }
+    portEXIT_CRITICAL(&geo_mux);
+    writing = false;
+}
+
+/**
+ * @brief Read the card's directory, on a job worker
+ */
+static void load_job(void* payload) {
+    xSemaphoreTake(work_lock, portMAX_DELAY);
+    ensure_loaded();
+    xSemaphoreGive(work_lock);
+    loading = false;
+}
+
+/**
+ * @brief Run a POST's query on a job worker and keep its nearest devices
+ */
+static void query_job(void* payload) {
+    const query_job_t* job = (const query_job_t*)payload;
+    static geo_result_t working;
+    memset(&working, 0, sizeof(working));
+    working.lat_e7 = job->lat_e7;
+    working.lon_e7 = job->lon_e7;
+    working.radius_m = job->radius_m;
+
+    uint32_t started_ms = millis();
+    bool ok = geo_store_query(job->lat_e7, job->lon_e7, job->radius_m, collect_nearest, &working,
+                              &working.query);
+    working.took_ms = millis() - started_ms;
+    working.state = ok ? RESULT_DONE : RESULT_FAILED;
+    portENTER_CRITICAL(&geo_mux);
+    result = working;
+    portEXIT_CRITICAL(&geo_mux);
+    LOGI(SCAN, "🗺️  Geo query: %u devices within %lu m, %u cell files, %lu bytes read in %lu ms",
+         working.devices, working.radius_m, working.query.cells_read, working.query.bytes_read,
+         working.took_ms);
+}
+
+/**
+ * @brief Append one run of a batch to its cell's file
+ */
+static bool append_run(const geo_run_t* run, const geo_row_t* rows) {
+    char path[40];
+    cell_path(run->cell, path, sizeof(path));
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(path, "a");
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!file) {
+        return false;
+    }
+
+    const uint8_t* data = (const uint8_t*)&rows[run->start];
+    uint32_t length = run->count * sizeof(geo_row_t);
+    uint32_t max_chunk = sd_bench_block_bytes(GEO_WRITE_CHUNK);
+    bool ok = true;
+    for (uint32_t done = 0; done < length && ok; done += max_chunk) {
+        size_t chunk = min(length - done, max_chunk);
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        ok = file.write(data + done, chunk) == chunk;
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    file.close();
+    spi_bus_release(SPI_DEVICE_SD);
+    return ok;
+}
+
+/**
+ * @brief Write the directory to a temporary file and put it in place of the old one
+ */
+static bool write_index(void) {
+    xSemaphoreTake(directory_lock, portMAX_DELAY);
+    uint16_t count = cell_count;
+    memcpy(snapshot, directory, count * sizeof(geo_cell_t));
+    xSemaphoreGive(directory_lock);
+
+    geo_index_header_t header;
+    header.magic = GEO_INDEX_MAGIC;
+    header.format = GEO_INDEX_FORMAT;
+    header.cells = count;
+    header.crc32 = esp_rom_crc32_le(0, (const uint8_t*)snapshot, count * sizeof(geo_cell_t));
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(GEO_INDEX_TEMP_FILE, "w");
+    bool ok = file && file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              file.write((const uint8_t*)snapshot, count * sizeof(geo_cell_t)) == count * sizeof(geo_cell_t);
+    if (file) {
+        file.close();
+    }
+    if (ok) {
+        SD.remove(GEO_INDEX_FILE);
+        ok = SD.rename(GEO_INDEX_TEMP_FILE, GEO_INDEX_FILE);
+    } else {
+        SD.remove(GEO_INDEX_TEMP_FILE);
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    return ok;
+}
+
+/**
+ * @brief Fold the card's directory into the one kept since boot, once
+ *
+ * The caller holds work_lock.
+ */
+static void ensure_loaded(void) {
+    if (loaded || !sd_monitor_mounted()) {
+        return;
+    }
+    uint16_t count = 0;
+    bool indexed = read_index(&count);
+    if (indexed) {
+        for (uint16_t i = 0; i < count; i++) {
+            merge_cell(&snapshot[i]);
+        }
+        LOGI(SCAN, "🗺️  Geo store directory: %u cells", count);
+    } else {
+        uint16_t rebuilt = rebuild_from_files();
+        if (rebuilt > 0) {
+            LOGW(SCAN, "⚠️  Geo store directory missing or corrupt - rebuilt %u cells from their files", rebuilt);
+        }
+    }
+    loaded = true;
+}
+
+/**
+ * @brief Read GEO_INDEX_FILE into the snapshot
+ * @return false if it is missing or does not check out
+ */
+static bool read_index(uint16_t* count) {
+    geo_index_header_t header;
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(GEO_INDEX_FILE, "r");
+    bool ok = file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == GEO_INDEX_MAGIC && header.format == GEO_INDEX_FORMAT &&
+              header.cells <= GEO_CELLS_MAX &&
+              file.read((uint8_t*)snapshot, header.cells * sizeof(geo_cell_t)) == header.cells * sizeof(geo_cell_t);
+    if (file) {
+        file.close();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!ok || esp_rom_crc32_le(0, (const uint8_t*)snapshot, header.cells * sizeof(geo_cell_t)) != header.crc32) {
+        return false;
+    }
+    *count = header.cells;
+    return true;
+}
+
+/**
+ * @brief Rebuild the directory from the cell files, reading every row once
+ * @return Cells found
+ */
+static uint16_t rebuild_from_files(void) {
+    uint16_t cells = 0;
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File dir = SD.open(GEO_STORE_DIR);
+    bool listing = dir && dir.isDirectory();
+    spi_bus_release(SPI_DEVICE_SD);
+    while (listing) {
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        File file = dir.openNextFile();
+        spi_bus_release(SPI_DEVICE_SD);
+        if (!file) {
+            break;
+        }
+        geo_cell_t entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.min_lat_e7 = entry.min_lon_e7 = INT32_MAX;
+        entry.max_lat_e7 = entry.max_lon_e7 = INT32_MIN;
+        bool wanted = parse_cell_name(file.name(), &entry.cell);
+        while (wanted) {
+            spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+            size_t count = file.read((uint8_t*)read_rows, READ_BYTES) / sizeof(geo_row_t);
+            spi_bus_release(SPI_DEVICE_SD);
+            if (count == 0) {
+                break;
+            }
+            for (size_t r = 0; r < count; r++) {
+                uint64_t hash = geohash(read_rows[r].lat_e7, read_rows[r].lon_e7, CELL_BITS + CHILD_BITS);
+                add_position(&entry, read_rows[r].lat_e7, read_rows[r].lon_e7, read_rows[r].utc_s,
+                             (uint8_t)(hash & ((1 << CHILD_BITS) - 1)), 1);
+            }
+        }
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        file.close();
+        spi_bus_release(SPI_DEVICE_SD);
+        if (wanted && entry.rows > 0) {
+            merge_cell(&entry);
+            cells++;
+        }
+    }
+    if (dir) {
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        dir.close();
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+    return cells;
+}
+
+/**
+ * @brief Add a cell read from the card to the directory
+ */
+static void merge_cell(const geo_cell_t* cell) {
+    xSemaphoreTake(directory_lock, portMAX_DELAY);
+    geo_cell_t* entry = take_cell(cell->cell);
+    if (entry != NULL) {
+        entry->surveyed |= cell->surveyed;
+        entry->rows += cell->rows;
+        entry->min_lat_e7 = min(entry->min_lat_e7, cell->min_lat_e7);
+        entry->max_lat_e7 = max(entry->max_lat_e7, cell->max_lat_e7);
+        entry->min_lon_e7 = min(entry->min_lon_e7, cell->min_lon_e7);
+        entry->max_lon_e7 = max(entry->max_lon_e7, cell->max_lon_e7);
+        entry->last_utc_s = max(entry->last_utc_s, cell->last_utc_s);
+    }
+    xSemaphoreGive(directory_lock);
+}
+
+/**
+ * @brief Binary search of the directory; the caller holds directory_lock
+ * @return The cell's index, or where it would go
+ */
+static int32_t find_cell(uint32_t cell, bool* found) {
+    int32_t low = 0;
+    int32_t high = (int32_t)cell_count - 1;
+    while (low <= high) {
+        int32_t middle = (low + high) / 2;
+        if (directory[middle].cell == cell) {
+            *found = true;
+            return middle;
+        }
+        if (directory[middle].cell < cell) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    *found = false;
+    return low;
+}
+
+/**
+ * @brief A cell's entry, inserted empty if new; the caller holds directory_lock
+ * @return NULL with the directory full
+ */
+static geo_cell_t* take_cell(uint32_t cell) {
+    bool found;
+    int32_t at = find_cell(cell, &found);
+    if (found) {
+        return &directory[at];
+    }
+    if (cell_count >= GEO_CELLS_MAX) {
+        return NULL;
+    }
+    memmove(&directory[at + 1], &directory[at], (cell_count - at) * sizeof(geo_cell_t));
+    cell_count++;
+    geo_cell_t* entry = &directory[at];
+    memset(entry, 0, sizeof(*entry));
+    entry->cell = cell;
+    entry->min_lat_e7 = entry->min_lon_e7 = INT32_MAX;
+    entry->max_lat_e7 = entry->max_lon_e7 = INT32_MIN;
+    return entry;
+}
+
+/**
+ * @brief Count rows recorded at a position into a cell's entry
+ */
+static void add_position(geo_cell_t* entry, int32_t lat_e7, int32_t lon_e7, uint32_t utc_s, uint8_t child, uint32_t rows) {
+    entry->surveyed |= 1UL << child;
+    entry->rows += rows;
+    entry->min_lat_e7 = min(entry->min_lat_e7, lat_e7);
+    entry->max_lat_e7 = max(entry->max_lat_e7, lat_e7);
+    entry->min_lon_e7 = min(entry->min_lon_e7, lon_e7);
+    entry->max_lon_e7 = max(entry->max_lon_e7, lon_e7);
+    entry->last_utc_s = max(entry->last_utc_s, utc_s);
+}
+
+/**
+ * @brief Geohash bits of a position, longitude first, in the low bits of the result
+ */
+static uint64_t geohash(int32_t lat_e7, int32_t lon_e7, uint8_t bits) {
+    uint8_t lon_bits = (bits + 1) / 2;
+    uint8_t lat_bits = bits / 2;
+    int64_t lat = constrain((int64_t)lat_e7, -900000000LL, 900000000LL) + 900000000LL;
+    int64_t lon = constrain((int64_t)lon_e7, -1800000000LL, 1800000000LL) + 1800000000LL;
+    // The north pole and the antimeridian's east side fall in the last index, not past it
+    uint64_t lat_index = min(((uint64_t)lat << lat_bits) / 1800000000ULL, (1ULL << lat_bits) - 1);
+    uint64_t lon_index = min(((uint64_t)lon << lon_bits) / 3600000000ULL, (1ULL << lon_bits) - 1);
+    uint64_t hash = 0;
+    for (uint8_t i = 0; i < bits; i++) {
+        uint64_t bit = (i % 2 == 0) ? lon_index >> (lon_bits - 1 - i / 2) : lat_index >> (lat_bits - 1 - i / 2);
+        hash = (hash << 1) | (bit & 1);
+    }
+    return hash;
+}
+
+/**
+ * @brief GEO_STORE_DIR/<cell>.hgc
+ */
+static void cell_path(uint32_t cell, char* path, size_t size) {
+    char name[NAME_BYTES];
+    for (uint8_t i = 0; i < GEO_CELL_PRECISION; i++) {
+        name[i] = base32[(cell >> ((GEO_CELL_PRECISION - 1 - i) * CHILD_BITS)) & 31];
+    }
+    name[GEO_CELL_PRECISION] = '\0';
+    snprintf(path, size, "%s/%s.hgc", GEO_STORE_DIR, name);
+}
+
+/**
+ * @brief Cell of a file name, with or without its directory
+ */
+static bool parse_cell_name(const char* name, uint32_t* cell) {
+    const char* slash = strrchr(name, '/');
+    const char* base = slash != NULL ? slash + 1 : name;
+    if (strlen(base) != GEO_CELL_PRECISION + 4 || strcmp(base + GEO_CELL_PRECISION, ".hgc") != 0) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < GEO_CELL_PRECISION; i++) {
+        const char* digit = strchr(base32, base[i]);
+        if (digit == NULL || base[i] == '\0') {
+            return false;
+        }
+        value = (value << CHILD_BITS) | (uint32_t)(digit - base32);
+    }
+    *cell = value;
+    return true;
+}
+
+/**
+ * @brief Query callback of a POST: one entry per device, nearest recordings kept
+ */
+static bool collect_nearest(const geo_row_t* row, uint32_t distance_m, void* context) {
+    geo_result_t* out = (geo_result_t*)context;
+    geo_result_device_t* slot = NULL;
+    uint8_t farthest = 0;
+    for (uint8_t i = 0; i < out->devices; i++) {
+        if (memcmp(out->device[i].mac, row->mac, sizeof(row->mac)) == 0 && out->device[i].kind == row->kind) {
+            slot = &out->device[i];
+            break;
+        }
+        if (out->device[i].distance_m > out->device[farthest].distance_m) {
+            farthest = i;
+        }
+    }
+    if (slot != NULL) {
+        slot->distance_m = min(slot->distance_m, distance_m);
+        slot->rssi = max(slot->rssi, row->rssi);
+        return true;
+    }
+    if (out->devices < GEO_RESULT_MAX) {
+        slot = &out->device[out->devices++];
+    } else if (distance_m < out->device[farthest].distance_m) {
+        slot = &out->device[farthest];
+    } else {
+        return true;
+    }
+    memcpy(slot->mac, row->mac, sizeof(slot->mac));
+    slot->kind = row->kind;
+    slot->rssi = row->rssi;
+    slot->distance_m = distance_m;
+    return true;
+}
+
+/**
+ * @brief Directory figures, "surveyed" at lat=&lon= or the fix, and the last query
+ */
+static void on_get(AsyncWebServerRequest* request) {
+    static char body[4096];
+    text_writer_t w;
+    text_writer_init(&w, body, sizeof(body));
+    geo_store_stats_t s;
+    geo_store_get_stats(&s);
+    text_printf(&w,
+        "{\"loaded\":%s,\"cells\":%u,\"rows\":%lu,\"rows_staged\":%lu,\"rows_dropped\":%lu,"
+        "\"rows_capped\":%lu,\"cycles_recorded\":%lu,\"cycles_thinned\":%lu,\"batches_written\":%lu,"
+        "\"write_failures\":%lu,\"queries\":%lu,",
+        s.loaded ? "true" : "false", s.cells, s.rows, s.rows_staged, s.rows_dropped, s.rows_capped,
+        s.cycles_recorded, s.cycles_thinned, s.batches_written, s.write_failures, s.queries);
+
+    gps_fix_t fix;
+    bool here = gps_get_fix(&fix);
+    if (request->hasParam("lat") && request->hasParam("lon")) {
+        fix.lat_e7 = (int32_t)lround(request->getParam("lat")->value().toDouble() * 1e7);
+        fix.lon_e7 = (int32_t)lround(request->getParam("lon")->value().toDouble() * 1e7);
+        here = true;
+    }
+    if (here) {
+        char name[GEO_CELL_PRECISION + 2];
+        geo_store_cell_name(fix.lat_e7, fix.lon_e7, GEO_CELL_PRECISION + 1, name);
+        text_printf(&w, "\"here\":{\"lat\":%.7f,\"lon\":%.7f,\"cell\":\"%s\",\"surveyed\":%s},",
+                    fix.lat_e7 / 1e7, fix.lon_e7 / 1e7, name,
+                    geo_store_surveyed(fix.lat_e7, fix.lon_e7) ? "true" : "false");
+    } else {
+        text_printf(&w, "\"here\":null,");
+    }
+
+    static geo_result_t last;
+    portENTER_CRITICAL(&geo_mux);
+    last = result;
+    portEXIT_CRITICAL(&geo_mux);
+    static const char* const state_names[] = { "idle", "running", "done", "failed" };
+    text_printf(&w,
+        "\"query\":{\"state\":\"%s\",\"lat\":%.7f,\"lon\":%.7f,\"radius_m\":%lu,\"rows\":%lu,"
+        "\"cells\":%u,\"cells_read\":%u,\"bytes_read\":%lu,\"truncated\":%s,\"took_ms\":%lu,\"devices\":[",
+        state_names[last.state], last.lat_e7 / 1e7, last.lon_e7 / 1e7, last.radius_m, last.query.rows,
+        last.query.cells, last.query.cells_read, last.query.bytes_read,
+        last.query.truncated ? "true" : "false", last.took_ms);
+    for (uint8_t i = 0; i < last.devices && w.length + 96 < sizeof(body); i++) {   // Room for "]}}"
+        const geo_result_device_t* d = &last.device[i];
+        text_printf(&w, "%s{\"mac\":\"%02x:%02x:%02x:%02x:%02x:%02x\",\"kind\":\"%s\","
+                    "\"rssi\":%d,\"distance_m\":%lu}",
+                    i > 0 ? "," : "", d->mac[0], d->mac[1], d->mac[2], d->mac[3], d->mac[4], d->mac[5],
+                    d->kind == DEVICE_KIND_BLE ? "ble" : "wifi", d->rssi, d->distance_m);
+    }
+    text_printf(&w, "]}}");
+    if (w.truncated) {
+        request->send(500, "text/plain", "geo document too large\n");
+        return;
+    }
+    request->send(200, "application/json", body);
+}
+
+/**
+ * @brief Query around lat=&lon= within radius= metres (GEO_QUERY_RADIUS_M by default)
+ */
+static void on_post(AsyncWebServerRequest* request) {
+    if (!request->hasParam("lat", true) || !request->hasParam("lon", true)) {
+        request->send(400, "text/plain", "lat= and lon= in degrees\n");
+        return;
+    }
+    query_job_t job;
+    job.lat_e7 = (int32_t)lround(request->getParam("lat", true)->value().toDouble() * 1e7);
+    job.lon_e7 = (int32_t)lround(request->getParam("lon", true)->value().toDouble() * 1e7);
+    job.radius_m = request->hasParam("radius", true) ?
+        (uint32_t)constrain(request->getParam("radius", true)->value().toInt(), 1L, 5000L) : GEO_QUERY_RADIUS_M;
+    if (read_rows == NULL || !sd_monitor_mounted()) {
+        request->send(503, "text/plain", "no SD card or no geo store\n");
+        return;
+    }
+
+    portENTER_CRITICAL(&geo_mux);
+    bool busy = result.state == RESULT_RUNNING;
+    if (!busy) {
+        result.state = RESULT_RUNNING;
+    }
+    portEXIT_CRITICAL(&geo_mux);
+    if (busy) {
+        request->send(409, "text/plain", "a query is running\n");
+        return;
+    }
+    if (!job_pool_submit(JOB_LANE_LOW, query_job, &job, sizeof(job))) {
+        portENTER_CRITICAL(&geo_mux);
+        result.state = RESULT_IDLE;
+        portEXIT_CRITICAL(&geo_mux);
+        request->send(503, "text/plain", "job queue full\n");
+        return;
+    }
+    request->send(202, "text/plain", "started\n");
+}
@@ -0,0 +1,287 @@
+/**
+ * @file handshake_watch.cpp
+ * @brief Association and EAPOL handshake counts per BSSID
+ *
+ * BSSIDs are direct-indexed by a hash of their last three bytes into a
+ * fixed table, as the beacon checks do; one that lands on a slot another
+ * still has counts in takes it over, and that is counted. Each slot keeps
+ * saturating 8-bit counts per window step and the one 4-way handshake it
+ * is following: the station, when it began and which messages were seen.
+ * The totals are kept apart from the slots, so an eviction loses only the
+ * per-BSSID detail. Each frame is a lookup and a few increments.
+ *
+ * EAPOL-Key messages are told apart by the Ack and MIC bits; the
+ * second and fourth, both with MIC and without Ack, by whether they carry
+ * key data, which the EAPOL length gives without reading that far.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "handshake_watch.h"
+
+static_assert((HANDSHAKE_BSSID_SLOTS & (HANDSHAKE_BSSID_SLOTS - 1)) == 0,
+              "HANDSHAKE_BSSID_SLOTS must be a power of two");
+
+// 802.11 management subtypes and EAPOL fields
+#define MGMT_ASSOC_REQUEST    0
+#define MGMT_REASSOC_REQUEST  2
+#define MGMT_AUTH             11
+#define EAPOL_TYPE_EAP        0
+#define EAPOL_TYPE_START      1
+#define EAPOL_TYPE_KEY        3
+#define EAPOL_HEADER_LEN      4         // Version, type, body length
+#define EAPOL_KEY_INFO        5         // After the descriptor type, big-endian
+#define EAPOL_KEY_MIN_LEN     7
+#define EAPOL_KEY_BODY_LEN    95        // Key descriptor without key data
+#define KEY_INFO_PAIRWISE     0x0008
+#define KEY_INFO_ACK          0x0080
+#define KEY_INFO_MIC          0x0100
+
+/**
+ * @brief One BSSID's counts and the handshake it is following
+ */
+typedef struct {
+    uint8_t  bssid[6];
+    uint8_t  station[6];            // Of the handshake in progress
+    uint32_t last_ms;               // 0 for a free slot
+    uint32_t exchange_ms;           // First message of the handshake in progress
+    uint8_t  messages;              // Bit per message 1-4 seen, 0 with none in progress
+    uint8_t  counts[HANDSHAKE_BUCKETS][HANDSHAKE_COUNTER_COUNT];
+} bssid_slot_t;
+
+// Capture task
+static bssid_slot_t slots[HANDSHAKE_BSSID_SLOTS];
+static uint16_t window_counts[HANDSHAKE_BUCKETS][HANDSHAKE_COUNTER_COUNT];
+static uint32_t totals[HANDSHAKE_COUNTER_COUNT];
+static uint32_t evicted = 0;
+static uint32_t bucket_epoch = 0;       // now_ms / HANDSHAKE_BUCKET_MS of the current step
+
+// Published
+static handshake_stats_t published;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const counter_names[HANDSHAKE_COUNTER_COUNT] = {
+    "assoc", "reassoc", "auth", "eapol", "complete", "partial", "pmkid", "eap"
+};
+
+// Forward declarations
+static bssid_slot_t* slot_for(const uint8_t* bssid, uint32_t now_ms);
+static void count(bssid_slot_t* slot, handshake_counter_t counter);
+static void follow_handshake(bssid_slot_t* slot, const uint8_t* station, uint8_t message, uint32_t now_ms);
+static uint16_t window_sum(const bssid_slot_t* slot, handshake_counter_t counter);
+
+/**
+ * @brief Clear every BSSID and count (capture task)
+ */
+void handshake_watch_init(void) {
+    memset(slots, 0, sizeof(slots));
+    memset(window_counts, 0, sizeof(window_counts));
+    memset(totals, 0, sizeof(totals));
+    evicted = 0;
+    bucket_epoch = millis() / HANDSHAKE_BUCKET_MS;
+    portENTER_CRITICAL(&stats_mux);
+    memset(&published, 0, sizeof(published));
+    published.window_ms = HANDSHAKE_BUCKETS * HANDSHAKE_BUCKET_MS;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Count an association, reassociation or authentication frame (capture task)
+ */
+void handshake_watch_observe_mgmt(uint8_t subtype, const uint8_t* station, const uint8_t* bssid,
+                                  uint32_t now_ms) {
+    handshake_counter_t counter;
+    if (subtype == MGMT_ASSOC_REQUEST) {
+        counter = HANDSHAKE_ASSOC;
+    } else if (subtype == MGMT_REASSOC_REQUEST) {
+        counter = HANDSHAKE_REASSOC;
+    } else if (subtype == MGMT_AUTH && memcmp(station, bssid, 6) != 0) {
+        counter = HANDSHAKE_AUTH;       // The access point's reply is not counted
+    } else {
+        return;
+    }
+    count(slot_for(bssid, now_ms), counter);
+}
+
+/**
+ * @brief Count an EAPOL frame and follow its 4-way handshake (capture task)
+ */
+void handshake_watch_observe_eapol(const uint8_t* eapol, uint8_t len, const uint8_t* station,
+                                   const uint8_t* bssid, bool from_ap, uint32_t now_ms) {
+    if (len < EAPOL_HEADER_LEN) {
+        return;
+    }
+    bssid_slot_t* slot = slot_for(bssid, now_ms);
+    if (eapol[1] == EAPOL_TYPE_EAP || eapol[1] == EAPOL_TYPE_START) {
+        count(slot, HANDSHAKE_EAP);
+        return;
+    }
+    if (eapol[1] != EAPOL_TYPE_KEY || len < EAPOL_KEY_MIN_LEN) {
+        return;
+    }
+    count(slot, HANDSHAKE_EAPOL);
+
+    uint16_t body_len = (uint16_t)(eapol[2] << 8 | eapol[3]);
+    uint16_t info = (uint16_t)(eapol[EAPOL_KEY_INFO] << 8 | eapol[EAPOL_KEY_INFO + 1]);
+    if ((info & KEY_INFO_PAIRWISE) == 0) {
+        return;                         // Group key update, not a station joining
+    }
+    bool ack = (info & KEY_INFO_ACK) != 0;
+    bool mic = (info & KEY_INFO_MIC) != 0;
+    bool key_data = body_len > EAPOL_KEY_BODY_LEN;
+    uint8_t message;
+    if (ack) {
+        message = mic ? 3 : 1;
+    } else if (mic) {
+        message = key_data ? 2 : 4;
+    } else {
+        return;
+    }
+    // Ack comes from the authenticator; anything else is malformed or misread
+    if (ack != from_ap) {
+        return;
+    }
+    if (message == 1 && key_data) {
+        count(slot, HANDSHAKE_PMKID);
+    }
+    follow_handshake(slot, station, message, now_ms);
+}
+
+/**
+ * @brief Step the rolling window and close stale handshakes; with each capture window
+ */
+void handshake_watch_roll(uint32_t now_ms) {
+    uint32_t epoch = now_ms / HANDSHAKE_BUCKET_MS;
+    // Clear the steps entered since the last roll, at most the whole window
+    for (uint32_t step = 0; step < HANDSHAKE_BUCKETS && bucket_epoch != epoch; step++) {
+        bucket_epoch++;
+        uint8_t bucket = bucket_epoch % HANDSHAKE_BUCKETS;
+        memset(window_counts[bucket], 0, sizeof(window_counts[bucket]));
+        for (uint16_t i = 0; i < HANDSHAKE_BSSID_SLOTS; i++) {
+            memset(slots[i].counts[bucket], 0, sizeof(slots[i].counts[bucket]));
+        }
+    }
+    bucket_epoch = epoch;
+
+    handshake_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    for (uint16_t i = 0; i < HANDSHAKE_BSSID_SLOTS; i++) {
+        bssid_slot_t* slot = &slots[i];
+        if (slot->last_ms == 0) {
+            continue;
+        }
+        if (slot->messages != 0 && now_ms - slot->exchange_ms > HANDSHAKE_EXCHANGE_MS) {
+            slot->messages = 0;
+            count(slot, HANDSHAKE_PARTIAL);
+        }
+        uint16_t activity = window_sum(slot, HANDSHAKE_ASSOC) + window_sum(slot, HANDSHAKE_REASSOC) +
+                            window_sum(slot, HANDSHAKE_EAPOL);
+        if (activity == 0 && window_sum(slot, HANDSHAKE_AUTH) == 0 && window_sum(slot, HANDSHAKE_EAP) == 0) {
+            continue;
+        }
+        stats.bssids++;
+        if (activity > stats.busiest_count) {
+            stats.busiest_count = activity;
+            memcpy(stats.busiest_bssid, slot->bssid, sizeof(stats.busiest_bssid));
+        }
+    }
+    for (uint8_t counter = 0; counter < HANDSHAKE_COUNTER_COUNT; counter++) {
+        uint32_t sum = 0;
+        for (uint8_t bucket = 0; bucket < HANDSHAKE_BUCKETS; bucket++) {
+            sum += window_counts[bucket][counter];
+        }
+        stats.window[counter] = (uint16_t)min(sum, (uint32_t)UINT16_MAX);
+        stats.total[counter] = totals[counter];
+    }
+    stats.evicted = evicted;
+    stats.window_ms = HANDSHAKE_BUCKETS * HANDSHAKE_BUCKET_MS;
+
+    portENTER_CRITICAL(&stats_mux);
+    published = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Copy the figures of the last roll
+ */
+void handshake_watch_get_stats(handshake_stats_t* out) {
+    portENTER_CRITICAL(&stats_mux);
+    *out = published;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* handshake_counter_name(handshake_counter_t counter) {
+    return counter < HANDSHAKE_COUNTER_COUNT ? counter_names[counter] : "?";
+}
+
+/**
+ * @brief The slot a BSSID hashes to, taken over if another BSSID held it
+ */
+static bssid_slot_t* slot_for(const uint8_t* bssid, uint32_t now_ms) {
+    uint32_t index = ((uint32_t)bssid[3] << 16 | (uint32_t)bssid[4] << 8 | bssid[5]) * 2654435761u;
+    bssid_slot_t* slot = &slots[index >> 16 & (HANDSHAKE_BSSID_SLOTS - 1)];
+    if (slot->last_ms == 0 || memcmp(slot->bssid, bssid, sizeof(slot->bssid)) != 0) {
+        if (slot->last_ms != 0 && now_ms - slot->last_ms < HANDSHAKE_BUCKETS * HANDSHAKE_BUCKET_MS) {
+            evicted++;
+        }
+        memset(slot, 0, sizeof(*slot));
+        memcpy(slot->bssid, bssid, sizeof(slot->bssid));
+    }
+    slot->last_ms = now_ms != 0 ? now_ms : 1;
+    return slot;
+}
+
+/**
+ * @brief Add one to a counter in the current step, for the slot and overall
+ */
+static void count(bssid_slot_t* slot, handshake_counter_t counter) {
+    uint8_t bucket = bucket_epoch % HANDSHAKE_BUCKETS;
+    if (slot->counts[bucket][counter] < UINT8_MAX) {
+        slot->counts[bucket][counter]++;
+    }
+    if (window_counts[bucket][counter] < UINT16_MAX) {
+        window_counts[bucket][counter]++;
+    }
+    totals[counter]++;
+}
+
+/**
+ * @brief Fold one 4-way handshake message into the exchange the slot follows
+ *
+ * A message for another station, a first message, or one past
+ * HANDSHAKE_EXCHANGE_MS starts a new exchange, and an unfinished one it
+ * replaces counts as partial. Message 4 after message 3 completes it.
+ */
+static void follow_handshake(bssid_slot_t* slot, const uint8_t* station, uint8_t message, uint32_t now_ms) {
+    bool same = slot->messages != 0 && now_ms - slot->exchange_ms <= HANDSHAKE_EXCHANGE_MS &&
+                memcmp(slot->station, station, sizeof(slot->station)) == 0;
+    // A repeated message 1 is a retransmission of the same exchange
+    bool restart = !same || (message == 1 && (slot->messages & ~(1 << 1)) != 0);
+    if (restart) {
+        if (slot->messages != 0) {
+            count(slot, HANDSHAKE_PARTIAL);
+        }
+        memcpy(slot->station, station, sizeof(slot->station));
+        slot->exchange_ms = now_ms;
+        slot->messages = 0;
+    }
+    slot->messages |= 1 << message;
+    if (message == 4 && (slot->messages & (1 << 3)) != 0) {
+        count(slot, HANDSHAKE_COMPLETE);
+        slot->messages = 0;
+    }
+}
+
+/**
+ * @brief A slot's count over the window
+ */
+static uint16_t window_sum(const bssid_slot_t* slot, handshake_counter_t counter) {
+    uint16_t sum = 0;
+    for (uint8_t bucket = 0; bucket < HANDSHAKE_BUCKETS; bucket++) {
+        sum += slot->counts[bucket][counter];
+    }
+    return sum;
+}
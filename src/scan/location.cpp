@@ -0,0 +1,518 @@
+/**
+ * @file location.cpp
+ * @brief Coarse indoor location from access point RSSI fingerprints
+ *
+ * A fingerprint is the RSSI of up to LOCATION_ANCHORS anchor access
+ * points, the strongest ones heard when places were learned, quantized to
+ * dB above LOCATION_FLOOR_DBM so an anchor that is not heard reads 0. With
+ * 16 anchors a fingerprint is one 128-bit PIE register, and the distance
+ * from a cycle to every stored fingerprint is a subtract and a
+ * multiply-accumulate each (rssi_sqdist_s8x16). The LOCATION_K nearest
+ * within LOCATION_MAX_RMS_DB vote on the label, weighted by closeness;
+ * with none that near the cycle is somewhere not learned.
+ *
+ * Learning takes the next few cycles as fingerprints of a label, so a
+ * place is covered by several scans rather than one. A full store gives
+ * up its fingerprints in the order they were taken. The store is written
+ * to flash after each learned label and each deletion.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "location.h"
+#include "rssi_kernels.h"
+#include "storage.h"
+#include "job_pool.h"
+#include "logger.h"
+
+#ifdef ESP_PLATFORM
+#include "mem_policy.h"
+#endif
+
+static_assert(LOCATION_ANCHORS == 16, "a fingerprint is one 16-lane vector");
+static_assert(LOCATION_LABELS < LOCATION_UNKNOWN, "label indices are 8-bit");
+static_assert(-LOCATION_FLOOR_DBM < 128, "quantized RSSI must fit an int8 lane difference");
+
+#define LOCATION_MAGIC          0x4C4F434E  // "LOCN"
+#define LOCATION_VERSION        1
+#define MAX_DISTANCE            ((uint32_t)LOCATION_MAX_RMS_DB * LOCATION_MAX_RMS_DB * LOCATION_ANCHORS)
+
+/**
+ * @brief On-flash header, followed by the anchors, the labels, the
+ *        fingerprints' labels and their vectors
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t  anchors;
+    uint8_t  labels;
+    uint16_t label_length;
+    uint16_t fingerprints;
+} location_file_header_t;
+
+static int8_t* vectors = NULL;                          // LOCATION_ANCHORS lanes each, 16-byte aligned
+static uint8_t print_labels[LOCATION_FINGERPRINTS];
+static uint32_t distances[LOCATION_FINGERPRINTS];
+static uint16_t print_count = 0;
+static uint16_t replace_cursor = 0;
+static uint8_t anchors[LOCATION_ANCHORS][6];
+static location_label_t labels[LOCATION_LABELS];
+static location_estimate_t estimate;
+static location_stats_t stats;
+static SemaphoreHandle_t store_lock = NULL;
+static StaticSemaphore_t store_lock_state;
+
+// Forward declarations
+static void add_anchors(const wifi_record_t* records, uint16_t count);
+static int8_t find_anchor(const uint8_t* bssid);
+static uint8_t build_query(const wifi_record_t* records, uint16_t count, int8_t* query);
+static void store_print(const int8_t* query, uint8_t label);
+static void place(const int8_t* query, uint8_t heard, uint32_t now_ms);
+static int16_t find_label(const char* name);
+static bool valid_name(const char* name);
+static bool load(void);
+static void save_job(void* payload);
+
+/**
+ * @brief Allocate the fingerprint store (PSRAM preferred) and restore it from flash
+ */
+bool location_init(void) {
+    size_t bytes = (size_t)LOCATION_FINGERPRINTS * LOCATION_ANCHORS;
+    if (vectors == NULL) {
+#ifdef ESP_PLATFORM
+        vectors = (int8_t*)mem_aligned_alloc(MEM_BULK, 16, bytes);
+#else
+        vectors = (int8_t*)aligned_alloc(16, bytes);
+#endif
+    }
+    if (store_lock == NULL) {
+        store_lock = xSemaphoreCreateMutexStatic(&store_lock_state);
+    }
+    if (vectors == NULL) {
+        LOGE(SCAN, "❌ Location store allocation failed");
+        return false;
+    }
+
+    memset(vectors, 0, bytes);
+    memset(labels, 0, sizeof(labels));
+    memset(&stats, 0, sizeof(stats));
+    memset(&estimate, 0, sizeof(estimate));
+    print_count = replace_cursor = 0;
+    stats.learning = LOCATION_UNKNOWN;
+    estimate.label = LOCATION_UNKNOWN;
+
+    if (!load()) {
+        memset(labels, 0, sizeof(labels));
+        print_count = 0;
+        stats.anchors = 0;
+    }
+    stats.fingerprints = print_count;
+    LOGI(SCAN, "✅ Location store: %u fingerprints over %u anchors restored",
+         print_count, stats.anchors);
+    return true;
+}
+
+/**
+ * @brief Place one WiFi cycle, or take it as a fingerprint while learning
+ */
+void location_observe(const wifi_record_t* records, uint16_t count, uint32_t now_ms) {
+    static int8_t query[LOCATION_ANCHORS] __attribute__((aligned(16)));
+    if (vectors == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    bool learning = stats.learning != LOCATION_UNKNOWN;
+    if (learning && stats.anchors < LOCATION_ANCHORS) {
+        add_anchors(records, count);
+    }
+    uint8_t heard = build_query(records, count, query);
+
+    // Too few anchors in range says nothing about where this is
+    bool saving = false;
+    if (heard >= LOCATION_MIN_ANCHORS && learning) {
+        store_print(query, stats.learning);
+        if (--stats.learn_cycles == 0) {
+            stats.learning = LOCATION_UNKNOWN;
+            saving = true;
+        }
+    }
+    place(query, heard, now_ms);
+    xSemaphoreGive(store_lock);
+
+    if (saving && !job_pool_submit(JOB_LANE_LOW, save_job, NULL, 0)) {
+        location_save();
+    }
+}
+
+/**
+ * @brief Take the next cycles as fingerprints of a label, adding the label if new
+ */
+bool location_learn(const char* name, uint8_t cycles) {
+    if (vectors == NULL || !valid_name(name)) {
+        return false;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    int16_t label = find_label(name);
+    for (uint8_t i = 0; label < 0 && i < LOCATION_LABELS; i++) {
+        if (labels[i].name[0] == '\0') {
+            label = i;
+            strncpy(labels[i].name, name, sizeof(labels[i].name) - 1);
+            labels[i].fingerprints = 0;
+        }
+    }
+    if (label >= 0) {
+        stats.learning = (uint8_t)label;
+        stats.learn_cycles = cycles > 0 ? cycles : LOCATION_LEARN_CYCLES;
+    }
+    xSemaphoreGive(store_lock);
+    return label >= 0;
+}
+
+/**
+ * @brief Delete a label and its fingerprints
+ */
+int32_t location_forget(const char* name) {
+    if (vectors == NULL || name == NULL) {
+        return -1;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    int16_t label = find_label(name);
+    if (label < 0) {
+        xSemaphoreGive(store_lock);
+        return -1;
+    }
+
+    // Close the gaps so the kernel keeps running over one block
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < print_count; i++) {
+        if (print_labels[i] == label) {
+            continue;
+        }
+        if (kept != i) {
+            memcpy(vectors + kept * LOCATION_ANCHORS, vectors + i * LOCATION_ANCHORS, LOCATION_ANCHORS);
+            print_labels[kept] = print_labels[i];
+        }
+        kept++;
+    }
+    int32_t deleted = print_count - kept;
+    print_count = kept;
+    replace_cursor = 0;
+    memset(&labels[label], 0, sizeof(labels[label]));
+    if (stats.learning == label) {
+        stats.learning = LOCATION_UNKNOWN;
+    }
+    if (estimate.label == label) {
+        estimate.label = LOCATION_UNKNOWN;
+        estimate.match = 0;
+    }
+
+    // An empty store may be learned again around different access points
+    if (print_count == 0) {
+        stats.anchors = 0;
+    }
+    stats.fingerprints = print_count;
+    xSemaphoreGive(store_lock);
+
+    if (!job_pool_submit(JOB_LANE_LOW, save_job, NULL, 0)) {
+        location_save();
+    }
+    return deleted;
+}
+
+/**
+ * @brief Write the store to flash
+ *
+ * Holds the store for the write, which delays at most one cycle's placing.
+ */
+bool location_save(void) {
+    if (vectors == NULL) {
+        return false;
+    }
+
+    storage_medium_t medium;
+    fs::FS* fs = storage_acquire(STORAGE_CLASS_CONFIG, &medium);
+    File file;
+    if (fs != NULL) {
+        file = fs->open(LOCATION_FILE, "w");
+    }
+    if (!file) {
+        storage_unlock(medium);
+        LOGE(SCAN, "❌ Location store save failed");
+        return false;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    location_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LOCATION_MAGIC;
+    header.version = LOCATION_VERSION;
+    header.anchors = stats.anchors;
+    header.labels = LOCATION_LABELS;
+    header.label_length = LOCATION_LABEL_LENGTH;
+    header.fingerprints = print_count;
+
+    size_t vector_bytes = (size_t)print_count * LOCATION_ANCHORS;
+    bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              file.write((const uint8_t*)anchors, sizeof(anchors)) == sizeof(anchors) &&
+              file.write((const uint8_t*)labels, sizeof(labels)) == sizeof(labels) &&
+              file.write(print_labels, print_count) == print_count &&
+              file.write((const uint8_t*)vectors, vector_bytes) == vector_bytes;
+    if (ok) {
+        stats.saves++;
+    }
+    xSemaphoreGive(store_lock);
+    file.close();
+    storage_unlock(medium);
+    return ok;
+}
+
+/**
+ * @brief Copy the latest estimate
+ */
+void location_get_estimate(location_estimate_t* out) {
+    if (store_lock == NULL) {
+        memset(out, 0, sizeof(*out));
+        out->label = LOCATION_UNKNOWN;
+        return;
+    }
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    *out = estimate;
+    xSemaphoreGive(store_lock);
+}
+
+/**
+ * @brief Copy every label slot, LOCATION_LABELS of them
+ */
+void location_get_labels(location_label_t* out) {
+    if (store_lock == NULL) {
+        memset(out, 0, sizeof(labels));
+        return;
+    }
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    memcpy(out, labels, sizeof(labels));
+    xSemaphoreGive(store_lock);
+}
+
+/**
+ * @brief Copy the store figures
+ */
+void location_get_stats(location_stats_t* out) {
+    if (store_lock == NULL) {
+        memset(out, 0, sizeof(*out));
+        out->learning = LOCATION_UNKNOWN;
+        return;
+    }
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(store_lock);
+}
+
+/**
+ * @brief Fill free anchor lanes with the strongest access points not yet anchors
+ */
+static void add_anchors(const wifi_record_t* records, uint16_t count) {
+    while (stats.anchors < LOCATION_ANCHORS) {
+        const wifi_record_t* strongest = NULL;
+        for (uint16_t i = 0; i < count; i++) {
+            if (records[i].rssi > LOCATION_FLOOR_DBM &&
+                (strongest == NULL || records[i].rssi > strongest->rssi) &&
+                find_anchor(records[i].bssid) < 0) {
+                strongest = &records[i];
+            }
+        }
+        if (strongest == NULL) {
+            return;
+        }
+        memcpy(anchors[stats.anchors++], strongest->bssid, sizeof(anchors[0]));
+    }
+}
+
+/**
+ * @brief Lane of an anchor, -1 if the BSSID is not one
+ */
+static int8_t find_anchor(const uint8_t* bssid) {
+    for (uint8_t lane = 0; lane < stats.anchors; lane++) {
+        if (memcmp(anchors[lane], bssid, sizeof(anchors[lane])) == 0) {
+            return (int8_t)lane;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Quantize the cycle's anchor RSSIs, returning how many anchors were heard
+ */
+static uint8_t build_query(const wifi_record_t* records, uint16_t count, int8_t* query) {
+    memset(query, 0, LOCATION_ANCHORS);
+    uint8_t heard = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        int8_t lane = find_anchor(records[i].bssid);
+        if (lane < 0 || records[i].rssi <= LOCATION_FLOOR_DBM) {
+            continue;
+        }
+        int8_t level = (int8_t)(records[i].rssi - LOCATION_FLOOR_DBM);
+        if (query[lane] == 0) {
+            heard++;
+        }
+        // A sweep may hear one access point twice; the stronger reading stands
+        if (level > query[lane]) {
+            query[lane] = level;
+        }
+    }
+    return heard;
+}
+
+/**
+ * @brief Add a fingerprint, giving up the oldest when the store is full
+ */
+static void store_print(const int8_t* query, uint8_t label) {
+    uint16_t slot;
+    if (print_count < LOCATION_FINGERPRINTS) {
+        slot = print_count++;
+    } else {
+        slot = replace_cursor;
+        replace_cursor = (replace_cursor + 1) % LOCATION_FINGERPRINTS;
+        labels[print_labels[slot]].fingerprints--;
+    }
+    memcpy(vectors + slot * LOCATION_ANCHORS, query, LOCATION_ANCHORS);
+    print_labels[slot] = label;
+    labels[label].fingerprints++;
+    stats.fingerprints = print_count;
+    stats.learned++;
+}
+
+/**
+ * @brief Let the nearest fingerprints vote on where the cycle was heard
+ */
+static void place(const int8_t* query, uint8_t heard, uint32_t now_ms) {
+    estimate.label = LOCATION_UNKNOWN;
+    estimate.match = 0;
+    estimate.anchors_heard = heard;
+    estimate.nearest_db = 0.0f;
+    estimate.updated_ms = now_ms;
+    if (heard < LOCATION_MIN_ANCHORS || print_count == 0) {
+        return;
+    }
+    stats.queries++;
+    rssi_sqdist_s8x16(query, vectors, print_count, distances);
+
+    // k is small: insertion into a sorted list of the nearest so far
+    uint16_t nearest[LOCATION_K];
+    uint8_t found = 0;
+    for (uint16_t i = 0; i < print_count; i++) {
+        if (found == LOCATION_K && distances[i] >= distances[nearest[found - 1]]) {
+            continue;
+        }
+        uint8_t at = found < LOCATION_K ? found++ : found - 1;
+        while (at > 0 && distances[nearest[at - 1]] > distances[i]) {
+            nearest[at] = nearest[at - 1];
+            at--;
+        }
+        nearest[at] = i;
+    }
+    estimate.nearest_db = sqrtf((float)distances[nearest[0]] / LOCATION_ANCHORS);
+
+    float votes[LOCATION_LABELS] = { 0 };
+    float total = 0.0f;
+    for (uint8_t n = 0; n < found && distances[nearest[n]] <= MAX_DISTANCE; n++) {
+        float weight = 1.0f / (1.0f + (float)distances[nearest[n]]);
+        votes[print_labels[nearest[n]]] += weight;
+        total += weight;
+    }
+    if (total <= 0.0f) {
+        return;
+    }
+    uint8_t best = 0;
+    for (uint8_t label = 1; label < LOCATION_LABELS; label++) {
+        if (votes[label] > votes[best]) {
+            best = label;
+        }
+    }
+    estimate.label = best;
+    estimate.match = (uint8_t)(votes[best] / total * 255.0f + 0.5f);
+}
+
+/**
+ * @brief Index of a named label, -1 if there is none
+ */
+static int16_t find_label(const char* name) {
+    for (uint8_t i = 0; i < LOCATION_LABELS; i++) {
+        if (labels[i].name[0] != '\0' && strcmp(labels[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Names go into JSON unescaped, so only plain characters are taken
+ */
+static bool valid_name(const char* name) {
+    size_t length = name != NULL ? strlen(name) : 0;
+    if (length == 0 || length >= LOCATION_LABEL_LENGTH) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        char c = name[i];
+        if (!isalnum((unsigned char)c) && c != ' ' && c != '-' && c != '_' && c != '.') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Restore the store if the file matches this build's layout
+ */
+static bool load(void) {
+    storage_medium_t medium;
+    fs::FS* fs = storage_acquire(STORAGE_CLASS_CONFIG, &medium);
+    File file;
+    if (fs != NULL && fs->exists(LOCATION_FILE)) {
+        file = fs->open(LOCATION_FILE, "r");
+    }
+    bool valid = false;
+    if (file) {
+        location_file_header_t header;
+        valid = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                header.magic == LOCATION_MAGIC && header.version == LOCATION_VERSION &&
+                header.anchors <= LOCATION_ANCHORS && header.labels == LOCATION_LABELS &&
+                header.label_length == LOCATION_LABEL_LENGTH &&
+                header.fingerprints <= LOCATION_FINGERPRINTS &&
+                file.read((uint8_t*)anchors, sizeof(anchors)) == sizeof(anchors) &&
+                file.read((uint8_t*)labels, sizeof(labels)) == sizeof(labels) &&
+                file.read(print_labels, header.fingerprints) == header.fingerprints &&
+                file.read((uint8_t*)vectors, (size_t)header.fingerprints * LOCATION_ANCHORS) ==
+                    (size_t)header.fingerprints * LOCATION_ANCHORS;
+        file.close();
+        if (valid) {
+            stats.anchors = header.anchors;
+            print_count = header.fingerprints;
+            for (uint16_t i = 0; i < print_count; i++) {
+                valid = valid && print_labels[i] < LOCATION_LABELS;
+            }
+            for (uint8_t i = 0; i < LOCATION_LABELS; i++) {
+                labels[i].name[LOCATION_LABEL_LENGTH - 1] = '\0';
+            }
+        }
+        if (!valid) {
+            LOGW(SCAN, "⚠️  Location store unreadable - starting empty");
+        }
+    }
+    storage_unlock(medium);
+    return valid;
+}
+
+/**
+ * @brief Flash writes stay off the scan and server tasks
+ */
+static void save_job(void* payload) {
+    (void)payload;
+    location_save();
+}
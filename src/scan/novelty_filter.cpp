@@ -0,0 +1,301 @@
+/**
+ * @file novelty_filter.cpp
+ * @brief Generational Bloom filter of addresses seen in the last N days
+ *
+ * The retention window is split into NOVELTY_GENERATIONS plain Bloom
+ * filters. Inserts go to the newest generation, membership is the OR of
+ * all of them, and expiry clears the oldest generation as a whole. This
+ * ages entries out without the per-bit counters a counting filter would
+ * need, and without having to remember which addresses to delete.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "storage.h"
+#include "novelty_filter.h"
+#include "profile.h"
+#include "logger.h"
+
+#ifdef ESP_PLATFORM
+#include "mem_policy.h"
+#endif
+
+#define NOVELTY_MAGIC           0x4E564C54  // "NVLT"
+#define NOVELTY_VERSION         1
+#define GENERATION_BYTES        (NOVELTY_FILTER_BITS / 8)
+#define GENERATION_SPAN_S       ((uint32_t)NOVELTY_RETENTION_DAYS * 86400UL / NOVELTY_GENERATIONS)
+
+/**
+ * @brief On-flash header, followed by the generation bitsets
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t  generations;
+    uint8_t  hashes;
+    uint32_t bits;
+    uint8_t  current_generation;
+    uint8_t  reserved[3];
+    uint32_t generation_age_s;
+    uint32_t history_s;
+} novelty_file_header_t;
+
+static uint8_t* bitsets = NULL;
+static SemaphoreHandle_t filter_lock = NULL;
+static StaticSemaphore_t filter_lock_state;
+static novelty_stats_t stats;
+static uint32_t bits_set = 0;
+static uint32_t last_tick_ms = 0;
+static uint32_t tick_remainder_ms = 0;
+
+// Forward declarations
+static void hash_address(const uint8_t* mac, uint8_t kind, uint32_t* h1, uint32_t* h2);
+static uint32_t count_bits(const uint8_t* bitset);
+
+/**
+ * @brief Allocate the filter (PSRAM preferred) and restore it from flash
+ */
+bool novelty_filter_init(void) {
+    size_t bytes = (size_t)GENERATION_BYTES * NOVELTY_GENERATIONS;
+#ifdef ESP_PLATFORM
+    bitsets = (uint8_t*)mem_calloc(MEM_BULK, 1, bytes);
+#else
+    bitsets = (uint8_t*)calloc(1, bytes);
+#endif
+    if (filter_lock == NULL) {
+        filter_lock = xSemaphoreCreateMutexStatic(&filter_lock_state);
+    }
+    if (bitsets == NULL) {
+        LOGE(SCAN, "❌ Novelty filter allocation failed");
+        return false;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    last_tick_ms = millis();
+
+    // Restore the history if the stored layout matches this build
+    storage_medium_t medium;
+    fs::FS* fs = storage_acquire(STORAGE_CLASS_CONFIG, &medium);
+    File file;
+    if (fs != NULL) {
+        file = fs->open(NOVELTY_FILE, "r");
+    }
+    if (file) {
+        novelty_file_header_t header;
+        bool valid = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                     header.magic == NOVELTY_MAGIC && header.version == NOVELTY_VERSION &&
+                     header.generations == NOVELTY_GENERATIONS &&
+                     header.hashes == NOVELTY_FILTER_HASHES &&
+                     header.bits == NOVELTY_FILTER_BITS &&
+                     header.current_generation < NOVELTY_GENERATIONS &&
+                     file.read(bitsets, bytes) == bytes;
+        file.close();
+
+        if (valid) {
+            stats.current_generation = header.current_generation;
+            stats.generation_age_s = header.generation_age_s;
+            stats.history_s = header.history_s;
+            bits_set = count_bits(bitsets + stats.current_generation * GENERATION_BYTES);
+        } else {
+            memset(bitsets, 0, bytes);
+            LOGW(SCAN, "⚠️  Novelty history unreadable - starting fresh");
+        }
+    }
+    storage_unlock(medium);
+
+    stats.warm = stats.history_s >= NOVELTY_WARMUP_S;
+    LOGI(SCAN, "✅ Novelty filter: %d KB, %lu s of history restored",
+         (int)(bytes / 1024), stats.history_s);
+    return true;
+}
+
+/**
+ * @brief Check an address against the history and add it
+ */
+bool novelty_filter_check_and_add(const uint8_t* mac, device_kind_t kind, uint8_t* generations) {
+    PROFILE_SCOPE(PROFILE_NOVELTY);
+    if (generations != NULL) {
+        *generations = 0;
+    }
+    if (bitsets == NULL || mac == NULL) {
+        return false;
+    }
+
+    uint32_t h1, h2;
+    hash_address(mac, (uint8_t)kind, &h1, &h2);
+
+    xSemaphoreTake(filter_lock, portMAX_DELAY);
+    uint8_t* current = bitsets + stats.current_generation * GENERATION_BYTES;
+    uint8_t held = 0;
+    bool seen_in_current = true;
+
+    // A generation holds the address only if all of its probe bits are set;
+    // every one is probed, as the count is how many spans it was seen in
+    for (uint8_t g = 0; g < NOVELTY_GENERATIONS; g++) {
+        const uint8_t* bitset = bitsets + g * GENERATION_BYTES;
+        bool all_set = true;
+        for (uint8_t k = 0; k < NOVELTY_FILTER_HASHES && all_set; k++) {
+            uint32_t bit = (h1 + k * h2) & (NOVELTY_FILTER_BITS - 1);
+            all_set = (bitset[bit >> 3] & (1 << (bit & 7))) != 0;
+        }
+        held += all_set;
+    }
+    bool seen_in_any = held > 0;
+
+    // Refresh the address in the newest generation so it survives rotation
+    for (uint8_t k = 0; k < NOVELTY_FILTER_HASHES; k++) {
+        uint32_t bit = (h1 + k * h2) & (NOVELTY_FILTER_BITS - 1);
+        uint8_t mask = 1 << (bit & 7);
+        if (!(current[bit >> 3] & mask)) {
+            current[bit >> 3] |= mask;
+            bits_set++;
+            seen_in_current = false;
+        }
+    }
+
+    bool novel = !seen_in_any && stats.warm;
+    if (!seen_in_current) {
+        stats.inserted++;
+    }
+    if (novel) {
+        stats.novel++;
+    }
+    xSemaphoreGive(filter_lock);
+    if (generations != NULL) {
+        *generations = held;
+    }
+    return novel;
+}
+
+/**
+ * @brief Advance generation ages and retire the oldest when due
+ */
+void novelty_filter_tick(uint32_t now_ms) {
+    if (bitsets == NULL) {
+        return;
+    }
+
+    tick_remainder_ms += now_ms - last_tick_ms;
+    last_tick_ms = now_ms;
+    uint32_t elapsed_s = tick_remainder_ms / 1000;
+    tick_remainder_ms %= 1000;
+    if (elapsed_s == 0) {
+        return;
+    }
+
+    xSemaphoreTake(filter_lock, portMAX_DELAY);
+    stats.generation_age_s += elapsed_s;
+    stats.history_s += elapsed_s;
+
+    if (stats.generation_age_s >= GENERATION_SPAN_S) {
+        // The oldest generation becomes the new, empty current one
+        stats.current_generation = (stats.current_generation + 1) % NOVELTY_GENERATIONS;
+        memset(bitsets + stats.current_generation * GENERATION_BYTES, 0, GENERATION_BYTES);
+        stats.generation_age_s = 0;
+        bits_set = 0;
+
+        uint32_t retained_s = GENERATION_SPAN_S * (NOVELTY_GENERATIONS - 1);
+        if (stats.history_s > retained_s) {
+            stats.history_s = retained_s;
+        }
+        LOGI(SCAN, "🔄 Novelty filter rotated to generation %d", stats.current_generation);
+    }
+
+    stats.warm = stats.history_s >= NOVELTY_WARMUP_S;
+    xSemaphoreGive(filter_lock);
+}
+
+/**
+ * @brief Write the filter to flash
+ */
+bool novelty_filter_save(void) {
+    if (bitsets == NULL) {
+        return false;
+    }
+
+    storage_medium_t medium;
+    fs::FS* fs = storage_acquire(STORAGE_CLASS_CONFIG, &medium);
+    File file;
+    if (fs != NULL) {
+        file = fs->open(NOVELTY_FILE, "w");
+    }
+    if (!file) {
+        storage_unlock(medium);
+        LOGE(SCAN, "❌ Novelty filter save failed");
+        return false;
+    }
+
+    novelty_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = NOVELTY_MAGIC;
+    header.version = NOVELTY_VERSION;
+    header.generations = NOVELTY_GENERATIONS;
+    header.hashes = NOVELTY_FILTER_HASHES;
+    header.bits = NOVELTY_FILTER_BITS;
+
+    // Bits are only ever set between rotations, so the bitsets can be
+    // written without holding the lock; a concurrent insert is at worst
+    // missing from the saved copy
+    xSemaphoreTake(filter_lock, portMAX_DELAY);
+    header.current_generation = stats.current_generation;
+    header.generation_age_s = stats.generation_age_s;
+    header.history_s = stats.history_s;
+    xSemaphoreGive(filter_lock);
+
+    size_t bytes = (size_t)GENERATION_BYTES * NOVELTY_GENERATIONS;
+    bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              file.write(bitsets, bytes) == bytes;
+    file.close();
+    storage_unlock(medium);
+
+    if (ok) {
+        stats.saves++;
+    }
+    return ok;
+}
+
+/**
+ * @brief Copy the filter statistics
+ */
+void novelty_filter_get_stats(novelty_stats_t* out) {
+    if (out == NULL) {
+        return;
+    }
+    *out = stats;
+    out->fill_permille = (uint16_t)((uint64_t)bits_set * 1000 / NOVELTY_FILTER_BITS);
+}
+
+/**
+ * @brief Two independent 32-bit hashes for double hashing
+ */
+static void hash_address(const uint8_t* mac, uint8_t kind, uint32_t* h1, uint32_t* h2) {
+    // FNV-1a over kind and address, then a murmur-style finalizer
+    uint32_t h = 2166136261UL ^ kind;
+    h *= 16777619UL;
+    for (uint8_t i = 0; i < 6; i++) {
+        h ^= mac[i];
+        h *= 16777619UL;
+    }
+
+    uint32_t g = h ^ (h >> 16);
+    g *= 0x85EBCA6BUL;
+    g ^= g >> 13;
+    g *= 0xC2B2AE35UL;
+    g ^= g >> 16;
+
+    *h1 = h;
+    *h2 = g | 1;    // Odd step visits distinct bits
+}
+
+/**
+ * @brief Population count of one generation
+ */
+static uint32_t count_bits(const uint8_t* bitset) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < GENERATION_BYTES; i++) {
+        count += __builtin_popcount(bitset[i]);
+    }
+    return count;
+}
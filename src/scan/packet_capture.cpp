@@ -0,0 +1,474 @@
+/**
+ * @file packet_capture.cpp
+ * @brief Promiscuous frame capture through a lock-free SPSC ring
+ *
+ * The WiFi driver callback is the single producer: it copies the leading
+ * header bytes of each frame into a preallocated PSRAM ring and never
+ * blocks or allocates. The capture task is the single consumer and turns
+ * queued headers into per-BSSID, per-client and per-channel statistics,
+ * and into each channel's airtime, handing each slot to the PCAP export
+ * on the way.
+ *
+ * The producer runs from IRAM; the ring's indices are a plain static and
+ * so in DRAM already. Its slots are too large for internal RAM and stay in
+ * PSRAM. Each frame's wait in the ring, from its radio timestamp, goes to
+ * the ring's latency figures.
+ */
+
+#include <Arduino.h>
+#include <esp_wifi.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "packet_capture.h"
+#include "mem_policy.h"
+#include "spsc_ring.h"
+#include "client_estimator.h"
+#include "ap_anomaly.h"
+#include "handshake_watch.h"
+#include "airtime.h"
+#include "energy.h"
+#include "pcap_export.h"
+#include "profile.h"
+#include "logger.h"
+
+// 802.11 frame control fields
+#define FC_TYPE(fc0)        (((fc0) >> 2) & 0x03)
+#define FC_SUBTYPE(fc0)     (((fc0) >> 4) & 0x0F)
+#define FC_TO_DS            0x01
+#define FC_FROM_DS          0x02
+#define FC_PROTECTED        0x40
+#define FC_ORDER            0x80
+#define FC_QOS              0x80        // Subtype bit of QoS data frames, in the first byte
+#define FRAME_TYPE_MGMT     0
+#define FRAME_TYPE_DATA     2
+#define MGMT_PROBE_REQUEST  4
+#define MGMT_BEACON         8
+#define MGMT_DISASSOC       10
+#define MGMT_DEAUTH         12
+#define HDR_ADDR1           4
+#define HDR_ADDR2           10
+#define HDR_ADDR3           16
+#define HDR_SEQ_CTRL        22
+#define HDR_MIN_LEN         24
+#define BEACON_TSF          24          // Fixed fields after the header
+#define BEACON_INTERVAL     32
+#define BEACON_MIN_LEN      34
+#define HDR_SEQ(hdr)        ((uint16_t)(((hdr)[HDR_SEQ_CTRL] | ((hdr)[HDR_SEQ_CTRL + 1] << 8)) >> 4))
+#define LLC_SNAP_LEN        8           // AA AA 03 00 00 00 and the EtherType
+#define ETHERTYPE_EAPOL_HI  0x88
+#define ETHERTYPE_EAPOL_LO  0x8E
+
+static_assert(CAPTURE_EAPOL_HEADER_BYTES <= CAPTURE_HEADER_BYTES, "EAPOL frames are kept in the header slot");
+
+/**
+ * @brief Frame counters for one transmitter address
+ */
+typedef struct {
+    uint8_t  mac[6];
+    bool     used;
+    uint16_t window_frames;        // Frames in the current window
+    uint32_t last_seen_ms;
+} mac_counter_t;
+
+// Callback to capture task
+static spsc_ring<capture_frame_t, CAPTURE_RING_SLOTS> ring;
+static bool running = false;
+
+// Consumer-side state
+static mac_counter_t bssids[CAPTURE_BSSID_SLOTS];
+static uint16_t window_channel_frames[WIFI_CHANNEL_COUNT + 1];
+static uint32_t channel_frames[WIFI_CHANNEL_COUNT + 1];
+static uint16_t window_frames = 0;
+static uint16_t window_probes = 0;
+static uint32_t window_started_ms = 0;
+static uint32_t frames_total = 0;
+
+// Published statistics
+static capture_stats_t published;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void IRAM_ATTR promiscuous_rx(void* buf, wifi_promiscuous_pkt_type_t type);
+static void parse_frame(const capture_frame_t* frame, uint32_t now_ms);
+static void count_mac(mac_counter_t* table, uint16_t capacity, const uint8_t* mac, uint32_t now_ms);
+static void check_management(const capture_frame_t* frame, uint32_t now_ms);
+static inline uint8_t data_header_len(const uint8_t* hdr);
+static bool is_eapol(const uint8_t* hdr, uint16_t len);
+
+/**
+ * @brief Allocate the frame ring (PSRAM preferred) and clear statistics
+ */
+bool capture_init(void) {
+    static capture_frame_t* slots = NULL;
+    if (slots == NULL) {
+        size_t bytes = CAPTURE_RING_SLOTS * sizeof(capture_frame_t);
+        slots = (capture_frame_t*)mem_alloc(MEM_BULK, bytes);
+        if (slots == NULL) {
+            LOGE(CAPTURE, "❌ Capture ring allocation failed");
+            return false;
+        }
+    }
+
+    ring.attach(slots);
+    memset(bssids, 0, sizeof(bssids));
+    client_estimator_reset();
+    memset(window_channel_frames, 0, sizeof(window_channel_frames));
+    memset(channel_frames, 0, sizeof(channel_frames));
+    memset(&published, 0, sizeof(published));
+    window_frames = window_probes = 0;
+    window_started_ms = millis();
+    frames_total = 0;
+    airtime_init(0, window_started_ms);
+#if HANDSHAKE_WATCH_ENABLED
+    handshake_watch_init();
+#endif
+
+    LOGI(CAPTURE, "✅ Capture ring ready: %d slots (%d KB)",
+         CAPTURE_RING_SLOTS, (int)(CAPTURE_RING_SLOTS * sizeof(capture_frame_t) / 1024));
+    return true;
+}
+
+/**
+ * @brief Enable promiscuous reception into the ring
+ */
+bool capture_start(void) {
+    if (!ring.attached()) {
+        return false;
+    }
+    if (running) {
+        return true;
+    }
+
+    wifi_promiscuous_filter_t filter = {
+        .filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_DATA
+    };
+    esp_wifi_set_promiscuous_filter(&filter);
+    esp_wifi_set_promiscuous_rx_cb(promiscuous_rx);
+
+    if (esp_wifi_set_promiscuous(true) != ESP_OK) {
+        LOGE(CAPTURE, "❌ Failed to enable promiscuous mode");
+        return false;
+    }
+
+    // Listening time counts from the channel the radio is on; the hopper reports retunes
+    uint8_t primary = 0;
+    wifi_second_chan_t secondary;
+    if (esp_wifi_get_channel(&primary, &secondary) == ESP_OK) {
+        airtime_note_channel(primary, millis());
+    }
+
+    running = true;
+    energy_set_active(ENERGY_LOAD_WIFI_RX, true);
+    LOGI(CAPTURE, "✅ Promiscuous capture started");
+    return true;
+}
+
+/**
+ * @brief Disable promiscuous reception
+ */
+void capture_stop(void) {
+    if (!running) {
+        return;
+    }
+    esp_wifi_set_promiscuous(false);
+    running = false;
+    energy_set_active(ENERGY_LOAD_WIFI_RX, false);
+    LOGI(CAPTURE, "⏹️  Promiscuous capture stopped");
+}
+
+/**
+ * @brief Whether promiscuous reception is active
+ */
+bool capture_is_running(void) {
+    return running;
+}
+
+/**
+ * @brief Drain and parse queued frames (consumer side)
+ */
+uint16_t capture_process(uint16_t max_frames) {
+    if (!ring.attached()) {
+        return 0;
+    }
+
+    uint32_t now = millis();
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+    uint16_t parsed = (uint16_t)ring.drain([now, now_us](capture_frame_t& frame) {
+        if ((int32_t)(now_us - frame.timestamp_us) >= 0) {
+            ring.note_latency(now_us - frame.timestamp_us);
+        }
+#if PCAP_EXPORT_ENABLED
+        pcap_export_frame(&frame);
+#endif
+        parse_frame(&frame, now);
+    }, max_frames);
+    frames_total += parsed;
+    return parsed;
+}
+
+/**
+ * @brief Close the current statistics window if it has elapsed
+ */
+bool capture_roll_window(uint32_t now_ms) {
+    uint32_t elapsed = now_ms - window_started_ms;
+    if (elapsed < CAPTURE_WINDOW_MS) {
+        return false;
+    }
+
+    capture_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.frames_total = frames_total;
+    spsc_stats_t stream;
+    ring.get_stats(&stream);
+    stats.frames_dropped = stream.dropped;
+    stats.frames_per_second = (uint16_t)((uint32_t)window_frames * 1000 / elapsed);
+    stats.probe_requests = window_probes;
+
+    for (uint8_t ch = 0; ch <= WIFI_CHANNEL_COUNT; ch++) {
+        stats.channel_fps[ch] = (uint16_t)((uint32_t)window_channel_frames[ch] * 1000 / elapsed);
+    }
+
+    for (uint16_t i = 0; i < CAPTURE_BSSID_SLOTS; i++) {
+        mac_counter_t* entry = &bssids[i];
+        if (!entry->used) {
+            continue;
+        }
+        if (now_ms - entry->last_seen_ms > CAPTURE_ENTRY_TTL_MS) {
+            entry->used = false;
+            continue;
+        }
+
+        uint16_t fps = (uint16_t)((uint32_t)entry->window_frames * 1000 / elapsed);
+        if (fps > stats.busiest_bssid_fps) {
+            stats.busiest_bssid_fps = fps;
+            memcpy(stats.busiest_bssid, entry->mac, sizeof(stats.busiest_bssid));
+        }
+        entry->window_frames = 0;
+        stats.bssid_count++;
+    }
+
+    client_estimate_t estimate;
+    client_estimator_estimate(now_ms, &estimate);
+#if AIRTIME_ENABLED
+    airtime_roll(now_ms);
+#endif
+#if HANDSHAKE_WATCH_ENABLED
+    handshake_watch_roll(now_ms);
+#endif
+    stats.client_count = estimate.clients;
+    stats.randomized_clients = estimate.randomized;
+    stats.macs_merged = estimate.macs_merged;
+
+    portENTER_CRITICAL(&stats_lock);
+    published = stats;
+    portEXIT_CRITICAL(&stats_lock);
+
+    memset(window_channel_frames, 0, sizeof(window_channel_frames));
+    window_frames = window_probes = 0;
+    window_started_ms = now_ms;
+    return true;
+}
+
+/**
+ * @brief Frames parsed on a channel since capture_init() (consumer side)
+ */
+uint32_t capture_channel_frames(uint8_t channel) {
+    return channel <= WIFI_CHANNEL_COUNT ? channel_frames[channel] : 0;
+}
+
+/**
+ * @brief Copy the most recently published statistics
+ */
+void capture_get_stats(capture_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    *stats = published;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief Copy the callback-to-task ring's figures
+ */
+void capture_get_stream_stats(spsc_stats_t* stats) {
+    ring.get_stats(stats);
+}
+
+/**
+ * @brief Promiscuous RX callback - runs in the WiFi driver task
+ *
+ * Must not block or allocate: a full ring just counts the frame as dropped.
+ */
+static void IRAM_ATTR promiscuous_rx(void* buf, wifi_promiscuous_pkt_type_t type) {
+    const wifi_promiscuous_pkt_t* pkt = (const wifi_promiscuous_pkt_t*)buf;
+    capture_frame_t* frame = ring.claim();
+    if (frame == NULL) {
+        return;                     // Counted as dropped by the ring
+    }
+
+    uint16_t length = pkt->rx_ctrl.sig_len;
+
+    // Probe requests keep their leading IEs for fingerprinting, EAPOL frames their key information
+    uint8_t keep = CAPTURE_SHORT_HEADER_BYTES;
+    if (type == WIFI_PKT_MGMT && FC_SUBTYPE(pkt->payload[0]) == MGMT_PROBE_REQUEST) {
+        keep = CAPTURE_HEADER_BYTES;
+    } else if (type == WIFI_PKT_DATA && is_eapol(pkt->payload, length)) {
+        keep = CAPTURE_EAPOL_HEADER_BYTES;
+    }
+    uint8_t header_len = length < keep ? (uint8_t)length : keep;
+
+    frame->timestamp_us = pkt->rx_ctrl.timestamp;
+    frame->length = length;
+    frame->rssi = (int8_t)pkt->rx_ctrl.rssi;
+    frame->channel = (uint8_t)pkt->rx_ctrl.channel;
+    frame->pkt_type = (uint8_t)type;
+    frame->header_len = header_len;
+    frame->rate = (uint8_t)(pkt->rx_ctrl.sig_mode != 0 ? pkt->rx_ctrl.mcs : pkt->rx_ctrl.rate);
+    frame->phy = (uint8_t)(pkt->rx_ctrl.sig_mode | pkt->rx_ctrl.cwb << 2 | pkt->rx_ctrl.sgi << 3);
+    memcpy(frame->header, pkt->payload, header_len);
+
+    ring.publish();
+}
+
+/**
+ * @brief Attribute one frame to its BSSID, client and channel
+ */
+static void parse_frame(const capture_frame_t* frame, uint32_t now_ms) {
+    PROFILE_SCOPE(PROFILE_FRAME_PARSE);
+    window_frames++;
+    if (frame->channel <= WIFI_CHANNEL_COUNT) {
+        window_channel_frames[frame->channel]++;
+        channel_frames[frame->channel]++;
+    }
+#if AIRTIME_ENABLED
+    airtime_observe(frame->channel, airtime_frame_us(frame->rate, frame->phy, frame->length));
+#endif
+
+    if (frame->header_len < HDR_MIN_LEN) {
+        return;
+    }
+
+    const uint8_t* hdr = frame->header;
+    uint8_t type = FC_TYPE(hdr[0]);
+    uint8_t ds = hdr[1] & (FC_TO_DS | FC_FROM_DS);
+
+    if (type == FRAME_TYPE_MGMT) {
+        if (FC_SUBTYPE(hdr[0]) == MGMT_PROBE_REQUEST) {
+            // Probe requests come from stations looking for networks
+            window_probes++;
+            uint32_t ie_hash = client_estimator_ie_hash(&hdr[HDR_MIN_LEN], frame->header_len - HDR_MIN_LEN);
+            client_estimator_observe(&hdr[HDR_ADDR2], HDR_SEQ(hdr), ie_hash, now_ms);
+        } else {
+            count_mac(bssids, CAPTURE_BSSID_SLOTS, &hdr[HDR_ADDR3], now_ms);
+#if AP_ANOMALY_ENABLED
+            check_management(frame, now_ms);
+#endif
+#if HANDSHAKE_WATCH_ENABLED
+            handshake_watch_observe_mgmt(FC_SUBTYPE(hdr[0]), &hdr[HDR_ADDR2], &hdr[HDR_ADDR3], now_ms);
+#endif
+        }
+    } else if (type == FRAME_TYPE_DATA) {
+        const uint8_t* station = NULL;
+        const uint8_t* bssid = NULL;
+        if (ds == FC_TO_DS) {
+            station = &hdr[HDR_ADDR2];
+            bssid = &hdr[HDR_ADDR1];
+            count_mac(bssids, CAPTURE_BSSID_SLOTS, bssid, now_ms);
+            client_estimator_observe(station, HDR_SEQ(hdr), 0, now_ms);
+        } else if (ds == FC_FROM_DS) {
+            // The sequence number belongs to the AP, not the receiving client
+            station = &hdr[HDR_ADDR1];
+            bssid = &hdr[HDR_ADDR2];
+            count_mac(bssids, CAPTURE_BSSID_SLOTS, bssid, now_ms);
+            client_estimator_observe(station, CLIENT_SEQ_UNKNOWN, 0, now_ms);
+        }
+#if HANDSHAKE_WATCH_ENABLED
+        if (station != NULL && is_eapol(hdr, frame->header_len)) {
+            uint8_t offset = data_header_len(hdr) + LLC_SNAP_LEN;
+            handshake_watch_observe_eapol(&hdr[offset], frame->header_len - offset, station, bssid,
+                                          ds == FC_FROM_DS, now_ms);
+        }
+#endif
+    }
+}
+
+/**
+ * @brief Count a frame against a MAC, recycling the stalest entry if full
+ */
+static void count_mac(mac_counter_t* table, uint16_t capacity, const uint8_t* mac, uint32_t now_ms) {
+    int16_t free_slot = -1;
+    int16_t oldest_slot = -1;
+
+    for (uint16_t i = 0; i < capacity; i++) {
+        mac_counter_t* entry = &table[i];
+        if (!entry->used) {
+            if (free_slot < 0) {
+                free_slot = i;
+            }
+            continue;
+        }
+        if (memcmp(entry->mac, mac, sizeof(entry->mac)) == 0) {
+            entry->window_frames++;
+            entry->last_seen_ms = now_ms;
+            return;
+        }
+        if (oldest_slot < 0 || entry->last_seen_ms < table[oldest_slot].last_seen_ms) {
+            oldest_slot = i;
+        }
+    }
+
+    int16_t slot = free_slot >= 0 ? free_slot : oldest_slot;
+    if (slot < 0) {
+        return;
+    }
+
+    mac_counter_t* entry = &table[slot];
+    memcpy(entry->mac, mac, sizeof(entry->mac));
+    entry->used = true;
+    entry->window_frames = 1;
+    entry->last_seen_ms = now_ms;
+}
+
+/**
+ * @brief Hand beacons and deauthentications to the rogue AP checks
+ */
+static void check_management(const capture_frame_t* frame, uint32_t now_ms) {
+    const uint8_t* hdr = frame->header;
+    uint8_t subtype = FC_SUBTYPE(hdr[0]);
+    if (subtype == MGMT_BEACON && frame->header_len >= BEACON_MIN_LEN) {
+        uint64_t tsf = 0;
+        for (int8_t i = 7; i >= 0; i--) {
+            tsf = tsf << 8 | hdr[BEACON_TSF + i];
+        }
+        uint16_t interval = hdr[BEACON_INTERVAL] | hdr[BEACON_INTERVAL + 1] << 8;
+        ap_anomaly_observe_beacon(&hdr[HDR_ADDR3], interval, tsf, frame->channel, frame->rssi, now_ms);
+    } else if (subtype == MGMT_DEAUTH || subtype == MGMT_DISASSOC) {
+        ap_anomaly_observe_deauth(&hdr[HDR_ADDR3], frame->channel, frame->rssi, now_ms);
+    }
+}
+
+/**
+ * @brief Length of a data frame's MAC header: QoS control and HT control included
+ */
+static inline uint8_t IRAM_ATTR data_header_len(const uint8_t* hdr) {
+    if ((hdr[0] & FC_QOS) == 0) {
+        return HDR_MIN_LEN;
+    }
+    return HDR_MIN_LEN + 2 + ((hdr[1] & FC_ORDER) != 0 ? 4 : 0);
+}
+
+/**
+ * @brief Whether an unprotected data frame carries EAPOL; runs in the RX callback too
+ */
+static bool IRAM_ATTR is_eapol(const uint8_t* hdr, uint16_t len) {
+    if (len < HDR_MIN_LEN || FC_TYPE(hdr[0]) != FRAME_TYPE_DATA || (hdr[1] & FC_PROTECTED) != 0) {
+        return false;
+    }
+    uint8_t offset = data_header_len(hdr);
+    return len >= offset + LLC_SNAP_LEN &&
+           hdr[offset + LLC_SNAP_LEN - 2] == ETHERTYPE_EAPOL_HI &&
+           hdr[offset + LLC_SNAP_LEN - 1] == ETHERTYPE_EAPOL_LO;
+}
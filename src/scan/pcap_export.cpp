@@ -0,0 +1,497 @@
+/**
+ * @file pcap_export.cpp
+ * @brief Captured frames as pcap with radiotap headers, to the card and to a live HTTP stream
+ *
+ * The capture task formats each ring slot it drains directly into one
+ * PSRAM byte ring as a pcap record: record header, radiotap header with
+ * channel and signal, then the kept frame bytes. Two readers consume that
+ * ring through their own cursors: a job worker appending whole chunks to
+ * TRACE_LOG_DIR/capture_NNNN.pcap, and the HTTP stream copying straight
+ * into the connection's send buffer. Neither copies a record again. The
+ * writer only ever publishes whole records and drops a frame rather than
+ * overwrite bytes a reader has not taken, so both readers always see a
+ * well-formed file. While no reader is open the export costs one branch
+ * per frame.
+ *
+ * Frames are truncated by the capture callback, so records carry the
+ * kept bytes with the full length in orig_len, and the file's snaplen
+ * says so; Wireshark marks them as cut short and still dissects the
+ * headers. Timestamps are the radio clock since boot, widened past its
+ * 32-bit wrap.
+ *
+ * During a capture burst the card is written to even if nobody asked,
+ * partial chunks go out after PCAP_BURST_FLUSH_MS on the normal job lane
+ * rather than the low one, and each write keeps the bus from opening the
+ * file to closing it, so touch and display traffic cannot split a burst's
+ * records across many short holds.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "sd_bench.h"
+#include "job_pool.h"
+#include "log_manager.h"
+#include "pcap_export.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+#define RING_MASK      (PCAP_RING_BYTES - 1)
+#define RECORD_MAX     (sizeof(pcap_record_header_t) + sizeof(pcap_radiotap_t) + CAPTURE_HEADER_BYTES)
+#define NO_SEGMENT     -1
+
+#define RADIOTAP_FLAGS         (1UL << 1)
+#define RADIOTAP_CHANNEL       (1UL << 3)
+#define RADIOTAP_DBM_SIGNAL    (1UL << 5)
+#define RADIOTAP_FLAG_FCS      0x10
+#define RADIOTAP_CHANNEL_2GHZ  0x0080
+#define FCS_BYTES              4         // Counted in the driver's frame length
+
+static_assert((PCAP_RING_BYTES & (PCAP_RING_BYTES - 1)) == 0, "PCAP_RING_BYTES must be a power of two");
+static_assert(PCAP_SD_CHUNK <= PCAP_RING_BYTES / 2, "a chunk must leave room for the writer");
+
+typedef enum {
+    READER_SD = 0,
+    READER_STREAM,
+    READER_COUNT
+} reader_id_t;
+
+/**
+ * @brief One consumer of the export ring
+ */
+typedef struct {
+    volatile bool     open;
+    volatile uint32_t cursor;       // Bytes of the ring taken, on the writer's count
+} reader_t;
+
+// Byte ring: head written only by the capture task, each cursor only by its reader
+static uint8_t* ring = NULL;
+static volatile uint32_t ring_head = 0;
+static reader_t readers[READER_COUNT];
+
+// Writer state, capture task only
+static uint32_t last_timestamp_us = 0;
+static uint32_t timestamp_wraps = 0;
+static uint32_t staged_since_ms = 0;
+
+// Card state, job worker only once open
+static volatile bool flushing = false;
+static volatile bool sd_stop_requested = false;
+static volatile bool burst = false;
+static bool burst_opened_sd = false;    // The SD file was opened for the burst and closes with it
+static int32_t sd_segment = NO_SEGMENT;
+static uint32_t sd_segment_bytes = 0;
+static uint32_t sd_noted_ms = 0;
+
+// Stream state, async TCP task only
+static uint8_t stream_header_sent = 0;
+
+static pcap_export_stats_t stats = {0};
+static portMUX_TYPE pcap_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void open_reader(reader_id_t id);
+static uint32_t ring_free(uint32_t head);
+static void put(uint32_t at, const void* data, size_t length);
+static void flush_job(void* payload);
+static bool open_segment(void);
+static bool append(uint32_t cursor, uint32_t length);
+static void fill_file_header(pcap_file_header_t* header);
+
+/**
+ * @brief Allocate the export ring in PSRAM; start the SD file if PCAP_SD_AUTOSTART
+ */
+bool pcap_export_init(void) {
+    if (ring != NULL) {
+        return true;
+    }
+    ring = (uint8_t*)mem_alloc(MEM_BULK, PCAP_RING_BYTES);
+    if (ring == NULL) {
+        LOGE(CAPTURE, "❌ PCAP export ring allocation failed");
+        return false;
+    }
+    memset(readers, 0, sizeof(readers));
+    LOGI(CAPTURE, "✅ PCAP export ready: %d KB ring, stream on %s", PCAP_RING_BYTES / 1024, PCAP_PATH);
+#if PCAP_SD_AUTOSTART
+    pcap_export_sd_start();
+#endif
+    return true;
+}
+
+/**
+ * @brief Append one frame as a pcap record, straight from its capture ring slot
+ */
+void pcap_export_frame(const capture_frame_t* frame) {
+    if (!readers[READER_SD].open && !readers[READER_STREAM].open) {
+        return;
+    }
+
+    uint32_t head = ring_head;
+    uint32_t length = sizeof(pcap_record_header_t) + sizeof(pcap_radiotap_t) + frame->header_len;
+    if (ring_free(head) < length) {
+        portENTER_CRITICAL(&pcap_mux);
+        stats.frames_dropped++;
+        portEXIT_CRITICAL(&pcap_mux);
+        return;
+    }
+
+    if (frame->timestamp_us < last_timestamp_us) {
+        timestamp_wraps++;
+    }
+    last_timestamp_us = frame->timestamp_us;
+    uint64_t timestamp_us = ((uint64_t)timestamp_wraps << 32) | frame->timestamp_us;
+
+    pcap_record_header_t record;
+    record.ts_sec = (uint32_t)(timestamp_us / 1000000);
+    record.ts_usec = (uint32_t)(timestamp_us % 1000000);
+    record.incl_len = sizeof(pcap_radiotap_t) + frame->header_len;
+    record.orig_len = sizeof(pcap_radiotap_t) + frame->length;
+
+    pcap_radiotap_t radiotap = {0};
+    radiotap.length = sizeof(pcap_radiotap_t);
+    radiotap.present = RADIOTAP_FLAGS | RADIOTAP_CHANNEL | RADIOTAP_DBM_SIGNAL;
+    radiotap.flags = frame->header_len == frame->length && frame->length >= FCS_BYTES ? RADIOTAP_FLAG_FCS : 0;
+    radiotap.channel_mhz = frame->channel == 14 ? 2484 : 2407 + 5 * frame->channel;
+    radiotap.channel_flags = RADIOTAP_CHANNEL_2GHZ;
+    radiotap.antenna_signal = frame->rssi;
+
+    put(head, &record, sizeof(record));
+    put(head + sizeof(record), &radiotap, sizeof(radiotap));
+    put(head + sizeof(record) + sizeof(radiotap), frame->header, frame->header_len);
+
+    // Publish the whole record to the readers
+    __atomic_store_n(&ring_head, head + length, __ATOMIC_RELEASE);
+    portENTER_CRITICAL(&pcap_mux);
+    stats.frames_exported++;
+    portEXIT_CRITICAL(&pcap_mux);
+}
+
+/**
+ * @brief Start a card write on a job worker once a chunk is staged or has aged
+ */
+void pcap_export_tick(uint32_t now_ms) {
+    if (!readers[READER_SD].open || flushing) {
+        return;
+    }
+    if (!sd_monitor_mounted()) {
+        readers[READER_SD].open = false;
+        sd_stop_requested = false;
+        sd_segment = NO_SEGMENT;
+        LOGW(CAPTURE, "⚠️  SD card gone - PCAP file closed");
+        return;
+    }
+
+    uint32_t staged = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) - readers[READER_SD].cursor;
+    if (staged == 0 && !sd_stop_requested) {
+        staged_since_ms = now_ms;
+        return;
+    }
+    uint32_t max_age_ms = burst ? PCAP_BURST_FLUSH_MS : PCAP_SD_FLUSH_MS;
+    if (staged < sd_bench_block_bytes(PCAP_SD_CHUNK) && now_ms - staged_since_ms < max_age_ms && !sd_stop_requested) {
+        return;
+    }
+
+    flushing = true;
+    if (!job_pool_submit(burst ? JOB_LANE_NORMAL : JOB_LANE_LOW, flush_job, NULL, 0)) {
+        flushing = false;           // Retried on the next drain
+        return;
+    }
+    staged_since_ms = now_ms;
+}
+
+/**
+ * @brief Start writing frames to a new capture_NNNN.pcap in TRACE_LOG_DIR
+ */
+bool pcap_export_sd_start(void) {
+    if (ring == NULL || !sd_monitor_mounted()) {
+        return false;
+    }
+    burst_opened_sd = false;        // Asked for, so it outlives a burst
+    if (readers[READER_SD].open) {
+        sd_stop_requested = false;
+        return true;
+    }
+    sd_segment = NO_SEGMENT;
+    sd_stop_requested = false;
+    staged_since_ms = millis();
+    open_reader(READER_SD);
+    LOGI(CAPTURE, "📼 PCAP capture to SD started");
+    return true;
+}
+
+/**
+ * @brief Write what is staged, then stop writing to the card
+ */
+void pcap_export_sd_stop(void) {
+    if (readers[READER_SD].open) {
+        sd_stop_requested = true;   // The next flush closes the file
+    }
+}
+
+/**
+ * @brief Enter or leave burst mode (capture task)
+ */
+void pcap_export_set_burst(bool on) {
+    if (on == burst) {
+        return;
+    }
+    if (on) {
+#if CAPTURE_BURST_SD
+        if (!readers[READER_SD].open && pcap_export_sd_start()) {
+            burst_opened_sd = true;
+        }
+#endif
+        burst = true;
+        return;
+    }
+    burst = false;
+    if (burst_opened_sd) {
+        burst_opened_sd = false;
+        pcap_export_sd_stop();
+    }
+}
+
+/**
+ * @brief Open the live stream; frames from now on are kept for it
+ */
+bool pcap_export_stream_open(void) {
+    if (ring == NULL || readers[READER_STREAM].open) {
+        return false;
+    }
+    stream_header_sent = 0;
+    open_reader(READER_STREAM);
+    portENTER_CRITICAL(&pcap_mux);
+    stats.stream_sessions++;
+    portEXIT_CRITICAL(&pcap_mux);
+    return true;
+}
+
+/**
+ * @brief Copy the next stream bytes, starting with the file header
+ */
+size_t pcap_export_stream_read(uint8_t* out, size_t max_len) {
+    if (!readers[READER_STREAM].open) {
+        return 0;
+    }
+
+    size_t copied = 0;
+    if (stream_header_sent < sizeof(pcap_file_header_t)) {
+        pcap_file_header_t header;
+        fill_file_header(&header);
+        copied = min(max_len, sizeof(header) - stream_header_sent);
+        memcpy(out, (const uint8_t*)&header + stream_header_sent, copied);
+        stream_header_sent += copied;
+    }
+
+    uint32_t cursor = readers[READER_STREAM].cursor;
+    uint32_t available = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) - cursor;
+    uint32_t length = min((uint32_t)(max_len - copied), available);
+    uint32_t offset = cursor & RING_MASK;
+    uint32_t first = min(length, (uint32_t)PCAP_RING_BYTES - offset);
+    memcpy(out + copied, ring + offset, first);
+    memcpy(out + copied + first, ring, length - first);
+
+    // Hand the bytes back to the writer
+    __atomic_store_n(&readers[READER_STREAM].cursor, cursor + length, __ATOMIC_RELEASE);
+    portENTER_CRITICAL(&pcap_mux);
+    stats.stream_bytes += length;
+    portEXIT_CRITICAL(&pcap_mux);
+    return copied + length;
+}
+
+/**
+ * @brief Close the live stream; its staged bytes are released
+ */
+void pcap_export_stream_close(void) {
+    readers[READER_STREAM].open = false;
+}
+
+/**
+ * @brief Copy the export figures
+ */
+void pcap_export_get_stats(pcap_export_stats_t* out) {
+    portENTER_CRITICAL(&pcap_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&pcap_mux);
+    out->sd_active = readers[READER_SD].open;
+    out->stream_active = readers[READER_STREAM].open;
+    out->sd_segment = sd_segment == NO_SEGMENT ? 0 : (uint16_t)sd_segment;
+}
+
+/**
+ * @brief Start a reader at the writer's head, which is always a record boundary
+ *
+ * The cursor is set before the reader counts, so the writer never sees
+ * an open reader behind the head it is about to move.
+ */
+static void open_reader(reader_id_t id) {
+    __atomic_store_n(&readers[id].cursor, __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    __atomic_store_n(&readers[id].open, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Bytes the writer may add before catching up with the slowest open reader
+ */
+static uint32_t ring_free(uint32_t head) {
+    uint32_t used = 0;
+    for (uint8_t id = 0; id < READER_COUNT; id++) {
+        if (__atomic_load_n(&readers[id].open, __ATOMIC_ACQUIRE)) {
+            used = max(used, head - __atomic_load_n(&readers[id].cursor, __ATOMIC_ACQUIRE));
+        }
+    }
+    return PCAP_RING_BYTES - used;
+}
+
+/**
+ * @brief Copy bytes into the ring at a writer position, wrapping at its end
+ */
+static void put(uint32_t at, const void* data, size_t length) {
+    uint32_t offset = at & RING_MASK;
+    size_t first = min(length, (size_t)(PCAP_RING_BYTES - offset));
+    memcpy(ring + offset, data, first);
+    memcpy(ring, (const uint8_t*)data + first, length - first);
+}
+
+/**
+ * @brief Append the staged bytes to the capture file, on a job worker
+ *
+ * Opens a new segment first when there is none or the current one is
+ * past PCAP_SD_SEGMENT_BYTES. On a failed write the bytes are let go,
+ * so the ring never stalls the capture behind a bad card.
+ */
+static void flush_job(void* payload) {
+    uint32_t cursor = readers[READER_SD].cursor;
+    uint32_t length = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) - cursor;
+    bool ok = true;
+
+    if (length > 0 && (sd_segment == NO_SEGMENT || sd_segment_bytes >= PCAP_SD_SEGMENT_BYTES)) {
+        ok = open_segment();
+    }
+    if (length > 0 && ok) {
+        ok = append(cursor, length);
+    }
+
+    // Hand the bytes back to the writer either way
+    __atomic_store_n(&readers[READER_SD].cursor, cursor + length, __ATOMIC_RELEASE);
+    uint32_t now = millis();
+    if (ok && length > 0) {
+        log_manager_note(LOG_SEGMENT_PCAP, (uint16_t)sd_segment, sd_segment_bytes - length, sd_noted_ms, now);
+    }
+    sd_noted_ms = now;
+
+    portENTER_CRITICAL(&pcap_mux);
+    if (ok) {
+        stats.sd_bytes += length;
+    } else {
+        stats.sd_failures++;
+    }
+    portEXIT_CRITICAL(&pcap_mux);
+    if (!ok) {
+        LOGW(CAPTURE, "⚠️  PCAP write failed - %lu bytes lost", length);
+        sd_segment = NO_SEGMENT;    // Start over in a fresh file
+    }
+
+    if (sd_stop_requested) {
+        readers[READER_SD].open = false;
+        sd_stop_requested = false;
+        LOGI(CAPTURE, "⏹️  PCAP capture to SD stopped");
+        sd_segment = NO_SEGMENT;
+    }
+    flushing = false;
+}
+
+/**
+ * @brief Create the next capture file and write its header
+ */
+static bool open_segment(void) {
+    if (!sd_monitor_mounted()) {
+        return false;
+    }
+    pcap_file_header_t header;
+    fill_file_header(&header);
+    char path[40];
+    uint16_t segment = 0;
+    bool ok = false;
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (SD.exists(TRACE_LOG_DIR) || SD.mkdir(TRACE_LOG_DIR)) {
+        segment = log_manager_next_segment(LOG_SEGMENT_PCAP);
+        log_manager_segment_path(LOG_SEGMENT_PCAP, segment, path, sizeof(path));
+        File file = SD.open(path, "w");
+        if (file) {
+            ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+            file.close();
+        }
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!ok) {
+        return false;
+    }
+
+    log_manager_opened(LOG_SEGMENT_PCAP, segment);
+    sd_segment = segment;
+    sd_segment_bytes = sizeof(header);
+    sd_noted_ms = millis();
+    LOGI(CAPTURE, "📼 PCAP capture to %s", path);
+    return true;
+}
+
+/**
+ * @brief Write ring bytes to the open capture file, straight from the ring
+ *
+ * At most the card's measured write size, capped at PCAP_SD_CHUNK, per
+ * bus hold, so touch reads never wait long behind the card. In a burst
+ * the bus is held for the whole append instead.
+ */
+static bool append(uint32_t cursor, uint32_t length) {
+    char path[40];
+    log_manager_segment_path(LOG_SEGMENT_PCAP, (uint16_t)sd_segment, path, sizeof(path));
+    bool hold = burst;
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(path, "a");
+    if (!file || !hold) {
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+    if (!file) {
+        return false;
+    }
+
+    bool ok = true;
+    uint32_t max_chunk = sd_bench_block_bytes(PCAP_SD_CHUNK);
+    for (uint32_t done = 0; done < length && ok; ) {
+        uint32_t offset = (cursor + done) & RING_MASK;
+        size_t chunk = min(min(length - done, max_chunk), (uint32_t)PCAP_RING_BYTES - offset);
+        if (!hold) {
+            spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        }
+        ok = file.write(ring + offset, chunk) == chunk;
+        if (!hold) {
+            spi_bus_release(SPI_DEVICE_SD);
+        }
+        done += chunk;
+    }
+
+    if (!hold) {
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    }
+    file.close();
+    spi_bus_release(SPI_DEVICE_SD);
+    if (ok) {
+        sd_segment_bytes += length;
+    }
+    return ok;
+}
+
+static void fill_file_header(pcap_file_header_t* header) {
+    header->magic = PCAP_MAGIC;
+    header->version_major = 2;
+    header->version_minor = 4;
+    header->thiszone = 0;
+    header->sigfigs = 0;
+    header->snaplen = sizeof(pcap_radiotap_t) + CAPTURE_HEADER_BYTES;
+    header->linktype = PCAP_LINKTYPE_RADIOTAP;
+}
@@ -0,0 +1,421 @@
+/**
+ * @file radio_link.cpp
+ * @brief Observations from extra radio modules over a UART, and their channel shares
+ *
+ * Frames are found in the byte stream by their two sync bytes and checked
+ * by their CRC; after a bad one the parser drops its first byte and
+ * searches what it had buffered for the next sync pair, so a false pair
+ * costs no good frame behind it and a module plugged in mid-frame costs
+ * one frame. The UART driver's ring
+ * holds a cycle's bytes while the scan task sweeps; the task drains it
+ * once per cycle, so a sighting is timed by the drain less its age in the
+ * frame, late by at most the frame's wait in the ring.
+ */
+
+#include <Arduino.h>
+#include <driver/uart.h>
+#include <esp_timer.h>
+#include <esp_rom_crc.h>
+#include "config.h"
+#include "board.h"
+#include "device_table.h"
+#include "cooccurrence.h"
+#include "radio_link.h"
+#include "logger.h"
+
+#define FRAME_MAX (sizeof(radio_frame_header_t) + RADIO_LINK_PAYLOAD_MAX + sizeof(uint32_t))
+
+static_assert(RADIO_LINK_PAYLOAD_MAX <= UINT8_MAX, "payload length is one byte");
+
+static radio_module_t modules[RADIO_LINK_MAX_RADIOS];
+static uint16_t accept_mask[RADIO_LINK_MAX_RADIOS];    // Last two assignments: frames in flight straddle a change
+static uint8_t last_seq[RADIO_LINK_MAX_RADIOS];
+static uint16_t sent_mask[RADIO_LINK_MAX_RADIOS];
+static uint32_t sent_ms[RADIO_LINK_MAX_RADIOS];
+static uint8_t tx_seq = 0;
+static uint16_t plan_dwell_ms = 0;
+static bool plan_passive = false;
+
+static uint8_t frame[FRAME_MAX];
+static uint16_t frame_length = 0;
+
+static radio_link_stats_t stats;
+static portMUX_TYPE link_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static uint32_t parse_frames(uint32_t now_ms);
+static bool take_frame(uint32_t now_ms);
+static void take_hello(uint8_t radio, const uint8_t* payload, uint8_t length, uint32_t now_ms);
+static void take_observations(uint8_t radio, const uint8_t* payload, uint8_t length, uint32_t now_ms);
+static void send_assign(uint8_t radio, uint32_t now_ms);
+
+/**
+ * @brief Install the UART driver on BOARD.radio_link
+ */
+bool radio_link_init(void) {
+    if (BOARD.radio_link.rx < 0) {
+        LOGW(SCAN, "⚠️  No radio link pins on this board");
+        return false;
+    }
+
+    uart_config_t config = {};
+    config.baud_rate = RADIO_LINK_BAUD;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    config.source_clk = UART_SCLK_APB;
+    if (uart_driver_install((uart_port_t)RADIO_LINK_UART_NUM, RADIO_LINK_RX_BUFFER_BYTES, 0, 0, NULL, 0) != ESP_OK ||
+        uart_param_config((uart_port_t)RADIO_LINK_UART_NUM, &config) != ESP_OK ||
+        uart_set_pin((uart_port_t)RADIO_LINK_UART_NUM, BOARD.radio_link.tx, BOARD.radio_link.rx,
+                     UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+        LOGE(SCAN, "❌ Radio link UART%d setup failed", RADIO_LINK_UART_NUM);
+        return false;
+    }
+
+    portENTER_CRITICAL(&link_mux);
+    stats.running = true;
+    portEXIT_CRITICAL(&link_mux);
+    LOGI(SCAN, "✅ Radio link on UART%d, RX %d TX %d, %d baud", RADIO_LINK_UART_NUM,
+         BOARD.radio_link.rx, BOARD.radio_link.tx, RADIO_LINK_BAUD);
+    return true;
+}
+
+/**
+ * @brief Take the link's frames into the device table and send changed assignments
+ */
+void radio_link_collect(uint32_t now_ms) {
+    if (!stats.running) {
+        return;
+    }
+    static uint8_t chunk[RADIO_LINK_READ_CHUNK];
+    int read;
+    while ((read = uart_read_bytes((uart_port_t)RADIO_LINK_UART_NUM, chunk, sizeof(chunk), 0)) > 0) {
+        radio_link_feed(chunk, read, now_ms);
+    }
+
+    // Quiet modules lose their share at the next plan; live ones get theirs
+    uint8_t live = 0;
+    for (uint8_t radio = 0; radio < RADIO_LINK_MAX_RADIOS; radio++) {
+        radio_module_t* module = &modules[radio];
+        bool alive = module->frames > 0 && now_ms - module->last_seen_ms <= RADIO_LINK_TTL_MS;
+        if (module->live && !alive) {
+            LOGW(SCAN, "📴 Radio module %u silent - its channels return to this node", radio);
+        }
+        portENTER_CRITICAL(&link_mux);
+        module->live = alive;
+        portEXIT_CRITICAL(&link_mux);
+        if (!alive) {
+            continue;
+        }
+        live++;
+        if (module->assigned_mask != sent_mask[radio] || now_ms - sent_ms[radio] >= RADIO_LINK_ASSIGN_REFRESH_MS) {
+            send_assign(radio, now_ms);
+        }
+    }
+    portENTER_CRITICAL(&link_mux);
+    stats.live = live;
+    portEXIT_CRITICAL(&link_mux);
+}
+
+/**
+ * @brief Parse link bytes, one at a time
+ */
+void radio_link_feed(const uint8_t* data, size_t length, uint32_t now_ms) {
+    uint32_t skipped = 0;
+    for (size_t i = 0; i < length; i++) {
+        frame[frame_length++] = data[i];
+        skipped += parse_frames(now_ms);
+    }
+
+    portENTER_CRITICAL(&link_mux);
+    stats.bytes += length;
+    stats.resyncs += skipped;
+    portEXIT_CRITICAL(&link_mux);
+}
+
+/**
+ * @brief Take what the buffered bytes hold: skip to a sync pair, then a frame once whole
+ *
+ * A bad frame (a length over RADIO_LINK_PAYLOAD_MAX or a failed CRC) may
+ * be a false sync pair inside good frames, so only its first byte is
+ * dropped and the rest is searched again for the next pair.
+ * @return Bytes skipped
+ */
+static uint32_t parse_frames(uint32_t now_ms) {
+    uint32_t skipped = 0;
+    for (;;) {
+        uint16_t start = 0;
+        while (start < frame_length && !(frame[start] == RADIO_LINK_SYNC0 &&
+                                          (start + 1 == frame_length || frame[start + 1] == RADIO_LINK_SYNC1))) {
+            start++;
+        }
+        if (start > 0) {
+            memmove(frame, frame + start, frame_length - start);
+            frame_length -= start;
+            skipped += start;
+        }
+        if (frame_length < sizeof(radio_frame_header_t)) {
+            return skipped;
+        }
+
+        const radio_frame_header_t* header = (const radio_frame_header_t*)frame;
+        uint16_t total = sizeof(radio_frame_header_t) + header->length + sizeof(uint32_t);
+        if (header->length <= RADIO_LINK_PAYLOAD_MAX && frame_length < total) {
+            return skipped;
+        }
+        if (header->length <= RADIO_LINK_PAYLOAD_MAX && take_frame(now_ms)) {
+            memmove(frame, frame + total, frame_length - total);
+            frame_length -= total;
+            continue;
+        }
+        memmove(frame, frame + 1, frame_length - 1);
+        frame_length--;
+        skipped++;
+    }
+}
+
+/**
+ * @brief Deal a plan's channels between this node and the live modules
+ */
+uint16_t radio_link_filter_mask(uint16_t mask, const scan_profile_t* profile) {
+    plan_dwell_ms = profile->dwell_ms;
+    plan_passive = profile->passive;
+
+    // Modules that sweep WiFi, in link order; every plan deals the same way
+    uint8_t dealt[RADIO_LINK_MAX_RADIOS];
+    uint8_t count = 0;
+    for (uint8_t radio = 0; radio < RADIO_LINK_MAX_RADIOS; radio++) {
+        if (modules[radio].live && (modules[radio].bands & RADIO_BAND_WIFI)) {
+            dealt[count++] = radio;
+        }
+    }
+
+    uint16_t local = mask;
+    uint16_t shares[RADIO_LINK_MAX_RADIOS] = {0};
+    if (count > 0 && __builtin_popcount(mask) > 1) {
+        local = 0;
+        uint8_t index = 0;
+        for (uint8_t channel = 1; channel <= WIFI_CHANNEL_COUNT; channel++) {
+            if (!(mask & (1 << channel))) {
+                continue;
+            }
+            uint8_t turn = index++ % (count + 1);
+            if (turn > 0 && (modules[dealt[turn - 1]].supported_mask & (1 << channel))) {
+                shares[dealt[turn - 1]] |= 1 << channel;
+            } else {
+                local |= 1 << channel;      // Our turn, or a channel the module cannot tune
+            }
+        }
+    }
+
+    portENTER_CRITICAL(&link_mux);
+    for (uint8_t radio = 0; radio < RADIO_LINK_MAX_RADIOS; radio++) {
+        if (modules[radio].assigned_mask != shares[radio]) {
+            accept_mask[radio] = modules[radio].assigned_mask | shares[radio];
+            modules[radio].assigned_mask = shares[radio];
+        }
+    }
+    stats.local_mask = local;
+    portEXIT_CRITICAL(&link_mux);
+    return local;
+}
+
+/**
+ * @brief WiFi access points the modules reported on channels they were given
+ */
+uint16_t radio_link_remote_networks(uint32_t now_ms) {
+    uint16_t remote_mask = 0;
+    for (uint8_t radio = 0; radio < RADIO_LINK_MAX_RADIOS; radio++) {
+        if (modules[radio].live) {
+            remote_mask |= modules[radio].assigned_mask;
+        }
+    }
+    if (remote_mask == 0) {
+        return 0;
+    }
+
+    uint16_t count = 0;
+    uint32_t capacity = device_table_capacity();
+    for (uint32_t i = 0; i < capacity; i++) {
+        const device_entry_t* entry = device_table_entry_at(i);
+        if (entry != NULL && entry->kind == DEVICE_KIND_WIFI_AP && entry->channel != 0 &&
+            (remote_mask & (1 << entry->channel)) &&
+            now_ms - entry->last_seen_ms <= RADIO_LINK_REMOTE_TTL_MS) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Copy the link figures
+ */
+void radio_link_get_stats(radio_link_stats_t* out) {
+    portENTER_CRITICAL(&link_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&link_mux);
+}
+
+/**
+ * @brief Copy one module's figures
+ */
+bool radio_link_get_module(uint8_t radio, radio_module_t* out) {
+    if (radio >= RADIO_LINK_MAX_RADIOS) {
+        return false;
+    }
+    portENTER_CRITICAL(&link_mux);
+    *out = modules[radio];
+    portEXIT_CRITICAL(&link_mux);
+    return true;
+}
+
+/**
+ * @brief Check a complete frame and hand its payload on
+ * @return false if its CRC fails
+ */
+static bool take_frame(uint32_t now_ms) {
+    radio_frame_header_t header;
+    memcpy(&header, frame, sizeof(header));
+    const uint8_t* payload = frame + sizeof(header);
+    uint32_t crc;
+    memcpy(&crc, payload + header.length, sizeof(crc));
+    if (esp_rom_crc32_le(0, frame + 2, sizeof(header) - 2 + header.length) != crc) {
+        portENTER_CRITICAL(&link_mux);
+        stats.crc_errors++;
+        portEXIT_CRITICAL(&link_mux);
+        return false;
+    }
+    bool known = header.radio < RADIO_LINK_MAX_RADIOS &&
+                 (header.type == RADIO_MSG_HELLO || header.type == RADIO_MSG_OBSERVATIONS);
+    portENTER_CRITICAL(&link_mux);
+    stats.frames++;
+    stats.rejected += known ? 0 : 1;
+    portEXIT_CRITICAL(&link_mux);
+    if (!known) {
+        return true;
+    }
+
+    radio_module_t* module = &modules[header.radio];
+    uint8_t gap = header.seq - last_seq[header.radio];
+    last_seq[header.radio] = header.seq;
+    portENTER_CRITICAL(&link_mux);
+    if (module->frames > 0 && gap > 1 && gap < 0x80) {
+        module->frames_lost += gap - 1;
+    }
+    module->frames++;
+    module->last_seen_ms = now_ms;
+    portEXIT_CRITICAL(&link_mux);
+
+    if (header.type == RADIO_MSG_HELLO) {
+        take_hello(header.radio, payload, header.length, now_ms);
+    } else {
+        take_observations(header.radio, payload, header.length, now_ms);
+    }
+    return true;
+}
+
+/**
+ * @brief A module's bands and channels
+ */
+static void take_hello(uint8_t radio, const uint8_t* payload, uint8_t length, uint32_t now_ms) {
+    radio_hello_t hello;
+    if (length < sizeof(hello)) {
+        portENTER_CRITICAL(&link_mux);
+        stats.rejected++;
+        portEXIT_CRITICAL(&link_mux);
+        return;
+    }
+    memcpy(&hello, payload, sizeof(hello));
+    if (hello.version != RADIO_LINK_VERSION) {
+        LOGW(SCAN, "⚠️  Radio module %u speaks link version %u, not %u - ignored",
+             radio, hello.version, RADIO_LINK_VERSION);
+        portENTER_CRITICAL(&link_mux);
+        modules[radio].frames = 0;              // Not live, so never dealt channels
+        portEXIT_CRITICAL(&link_mux);
+        return;
+    }
+
+    radio_module_t* module = &modules[radio];
+    bool first = module->bands == 0;
+    portENTER_CRITICAL(&link_mux);
+    module->bands = hello.bands;
+    module->supported_mask = hello.channel_mask;
+    module->module_dropped = hello.dropped;
+    portEXIT_CRITICAL(&link_mux);
+    if (first) {
+        LOGI(SCAN, "📻 Radio module %u:%s%s, channels 0x%04x", radio,
+             (hello.bands & RADIO_BAND_WIFI) ? " WiFi" : "", (hello.bands & RADIO_BAND_BLE) ? " BLE" : "",
+             hello.channel_mask);
+    }
+}
+
+/**
+ * @brief Fold a module's sightings into the device table
+ */
+static void take_observations(uint8_t radio, const uint8_t* payload, uint8_t length, uint32_t now_ms) {
+    if (length % sizeof(radio_observation_t) != 0) {
+        portENTER_CRITICAL(&link_mux);
+        stats.rejected++;
+        portEXIT_CRITICAL(&link_mux);
+        return;
+    }
+    uint16_t accepted = accept_mask[radio] | modules[radio].assigned_mask;
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+    uint8_t count = length / sizeof(radio_observation_t);
+    uint32_t merged = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        radio_observation_t seen;
+        memcpy(&seen, payload + i * sizeof(seen), sizeof(seen));
+        device_kind_t kind;
+        uint8_t channel;
+        if (seen.kind == DEVICE_KIND_BLE) {
+            kind = DEVICE_KIND_BLE;
+            channel = 0;
+        } else if (seen.kind == DEVICE_KIND_WIFI_AP && seen.channel >= 1 &&
+                   seen.channel <= WIFI_CHANNEL_COUNT && (accepted & (1 << seen.channel))) {
+            // Only channels it was dealt; ours are swept by our own radio
+            kind = DEVICE_KIND_WIFI_AP;
+            channel = seen.channel;
+        } else {
+            continue;
+        }
+        device_table_observe(seen.mac, kind, seen.rssi, channel, now_ms - seen.age_ms,
+                             now_us - seen.age_ms * 1000UL);
+#if COOCCURRENCE_ENABLED
+        cooccurrence_observe(seen.mac, kind, now_ms - seen.age_ms);
+#endif
+        merged++;
+    }
+
+    portENTER_CRITICAL(&link_mux);
+    modules[radio].observations += count;
+    modules[radio].merged += merged;
+    modules[radio].rejected += count - merged;
+    portEXIT_CRITICAL(&link_mux);
+}
+
+/**
+ * @brief Tell a module its share of the plan
+ */
+static void send_assign(uint8_t radio, uint32_t now_ms) {
+    if (BOARD.radio_link.tx < 0) {
+        return;                     // Receive only: the modules keep their own channels
+    }
+    uint8_t out[sizeof(radio_frame_header_t) + sizeof(radio_assign_t) + sizeof(uint32_t)];
+    radio_frame_header_t header = { RADIO_LINK_SYNC0, RADIO_LINK_SYNC1, RADIO_MSG_ASSIGN, radio,
+                                    tx_seq++, sizeof(radio_assign_t) };
+    radio_assign_t assign = { modules[radio].assigned_mask, plan_dwell_ms, plan_passive ? (uint8_t)1 : (uint8_t)0, 0 };
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), &assign, sizeof(assign));
+    uint32_t crc = esp_rom_crc32_le(0, out + 2, sizeof(header) - 2 + sizeof(assign));
+    memcpy(out + sizeof(header) + sizeof(assign), &crc, sizeof(crc));
+    if (uart_write_bytes((uart_port_t)RADIO_LINK_UART_NUM, (const char*)out, sizeof(out)) != (int)sizeof(out)) {
+        return;
+    }
+    sent_mask[radio] = assign.channel_mask;
+    sent_ms[radio] = now_ms;
+    portENTER_CRITICAL(&link_mux);
+    stats.assigns_sent++;
+    portEXIT_CRITICAL(&link_mux);
+}
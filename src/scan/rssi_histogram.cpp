@@ -0,0 +1,64 @@
+/**
+ * @file rssi_histogram.cpp
+ * @brief Fixed-bin RSSI histograms with bounded-time quantile queries
+ */
+
+#include <string.h>
+#include "config.h"
+#include "rssi_histogram.h"
+
+/**
+ * @brief Clear all bins
+ */
+void rssi_hist_reset(rssi_hist_t* hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+/**
+ * @brief Add one observation (values outside the range land in the end bins)
+ */
+void rssi_hist_add(rssi_hist_t* hist, int8_t rssi) {
+    int16_t bin = (rssi - RSSI_HIST_MIN_DBM) / RSSI_HIST_BIN_DB;
+    if (bin < 0) {
+        bin = 0;
+    } else if (bin >= RSSI_HIST_BINS) {
+        bin = RSSI_HIST_BINS - 1;
+    }
+
+    hist->bins[bin]++;
+    hist->count++;
+}
+
+/**
+ * @brief Estimate a quantile in O(RSSI_HIST_BINS) by interpolating within a bin
+ */
+int8_t rssi_hist_quantile(const rssi_hist_t* hist, uint8_t percent) {
+    if (hist->count == 0) {
+        return -100;
+    }
+    if (percent > 100) {
+        percent = 100;
+    }
+
+    // Rank of the requested quantile, scaled by 100 to keep integer math
+    uint32_t target = (uint32_t)hist->count * percent;
+    uint32_t below = 0;
+
+    for (uint8_t bin = 0; bin < RSSI_HIST_BINS; bin++) {
+        uint32_t in_bin = (uint32_t)hist->bins[bin] * 100;
+        if (in_bin > 0 && below + in_bin >= target) {
+            int16_t low = RSSI_HIST_MIN_DBM + bin * RSSI_HIST_BIN_DB;
+            return (int8_t)(low + (int32_t)(target - below) * RSSI_HIST_BIN_DB / in_bin);
+        }
+        below += in_bin;
+    }
+
+    return (int8_t)(RSSI_HIST_MIN_DBM + RSSI_HIST_BINS * RSSI_HIST_BIN_DB);
+}
+
+/**
+ * @brief Clear every histogram in a scan_histograms_t
+ */
+void scan_histograms_reset(scan_histograms_t* hists) {
+    memset(hists, 0, sizeof(*hists));
+}
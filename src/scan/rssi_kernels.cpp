@@ -0,0 +1,285 @@
+/**
+ * @file rssi_kernels.cpp
+ * @brief RSSI aggregation kernels with an ESP32-S3 PIE vector path
+ *
+ * The PIE path handles the 16-byte aligned body of an array with 128-bit
+ * loads; unaligned heads and short tails go through the scalar code, which
+ * is also the whole implementation on other targets. Histogram binning and
+ * the EWMA update stay scalar: PIE has no scatter for the former, and the
+ * latter touches at most a few hundred elements per cycle. Distances
+ * between 16-lane vectors take one register each, so those go through
+ * PIE whole.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "rssi_kernels.h"
+#include "profile.h"
+#include "logger.h"
+
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && RSSI_KERNELS_USE_PIE
+#define RSSI_KERNELS_PIE 1
+#else
+#define RSSI_KERNELS_PIE 0
+#endif
+
+// Forward declarations
+static int32_t sum_scalar(const int8_t* values, uint32_t count);
+static void minmax_scalar(const int8_t* values, uint32_t count, int8_t* min, int8_t* max);
+static void sqdist_scalar(const int8_t* query, const int8_t* vectors, uint32_t count, uint32_t* distances);
+
+#if RSSI_KERNELS_PIE
+/**
+ * @brief Sum 16-byte blocks with a multiply-accumulate against all ones
+ */
+static int32_t sum_pie(const int8_t* blocks, uint32_t block_count) {
+    static const int8_t one = 1;
+    int32_t acc_low;
+
+    asm volatile (
+        "ee.zero.accx\n"
+        "ee.vldbc.8         q1, %[one]\n"
+        "loopnez            %[n], 1f\n"
+        "ee.vld.128.ip      q0, %[ptr], 16\n"
+        "ee.vmulas.s8.accx  q0, q1\n"
+        "1:\n"
+        "rur.accx_0         %[acc]\n"
+        : [ptr] "+r" (blocks), [acc] "=r" (acc_low)
+        : [n] "r" (block_count), [one] "r" (&one)
+        : "memory"
+    );
+
+    // 40-bit accumulator, but 2^31 / 128 samples never fit in a cycle
+    return acc_low;
+}
+
+/**
+ * @brief Lane-wise min/max over 16-byte blocks, reduced in scalar code
+ */
+static void minmax_pie(const int8_t* blocks, uint32_t block_count, int8_t* min, int8_t* max) {
+    int8_t lanes[32] __attribute__((aligned(16)));
+    int8_t* out = lanes;
+
+    asm volatile (
+        "ee.vld.128.ip      q0, %[ptr], 16\n"
+        "ee.orq             q1, q0, q0\n"
+        "loopnez            %[n], 1f\n"
+        "ee.vld.128.ip      q2, %[ptr], 16\n"
+        "ee.vmin.s8         q0, q0, q2\n"
+        "ee.vmax.s8         q1, q1, q2\n"
+        "1:\n"
+        "ee.vst.128.ip      q0, %[out], 16\n"
+        "ee.vst.128.ip      q1, %[out], 16\n"
+        : [ptr] "+r" (blocks), [out] "+r" (out)
+        : [n] "r" (block_count - 1)
+        : "memory"
+    );
+
+    int8_t lane_min, lane_max, unused;
+    minmax_scalar(lanes, 16, &lane_min, &unused);
+    minmax_scalar(lanes + 16, 16, &unused, &lane_max);
+    *min = lane_min;
+    *max = lane_max;
+}
+
+/**
+ * @brief Per vector: subtract the query lane-wise, then multiply-accumulate the difference by itself
+ */
+static void sqdist_pie(const int8_t* query, const int8_t* vectors, uint32_t count, uint32_t* distances) {
+    uint32_t acc;
+
+    asm volatile (
+        "ee.vld.128.ip      q1, %[query], 0\n"
+        "loopnez            %[n], 1f\n"
+        "ee.zero.accx\n"
+        "ee.vld.128.ip      q0, %[ptr], 16\n"
+        "ee.vsubs.s8        q0, q0, q1\n"
+        "ee.vmulas.s8.accx  q0, q0\n"
+        "rur.accx_0         %[acc]\n"
+        "s32i               %[acc], %[out], 0\n"
+        "addi               %[out], %[out], 4\n"
+        "1:\n"
+        : [query] "+r" (query), [ptr] "+r" (vectors), [out] "+r" (distances), [acc] "=&r" (acc)
+        : [n] "r" (count)
+        : "memory"
+    );
+}
+
+/**
+ * @brief Bytes before the first 16-byte boundary, capped at count
+ */
+static uint32_t head_length(const int8_t* values, uint32_t count) {
+    uint32_t head = (16 - ((uintptr_t)values & 15)) & 15;
+    return head < count ? head : count;
+}
+#endif
+
+/**
+ * @brief Sum of an int8 RSSI array
+ */
+int32_t rssi_sum_s8(const int8_t* values, uint32_t count) {
+    PROFILE_SCOPE(PROFILE_RSSI_SUM);
+#if RSSI_KERNELS_PIE
+    uint32_t head = head_length(values, count);
+    uint32_t blocks = (count - head) / 16;
+    if (blocks > 0) {
+        uint32_t body = blocks * 16;
+        return sum_scalar(values, head) +
+               sum_pie(values + head, blocks) +
+               sum_scalar(values + head + body, count - head - body);
+    }
+#endif
+    return sum_scalar(values, count);
+}
+
+/**
+ * @brief Minimum and maximum of an int8 RSSI array
+ */
+void rssi_minmax_s8(const int8_t* values, uint32_t count, int8_t* min, int8_t* max) {
+    PROFILE_SCOPE(PROFILE_RSSI_MINMAX);
+    if (count == 0) {
+        return;
+    }
+
+#if RSSI_KERNELS_PIE
+    uint32_t head = head_length(values, count);
+    uint32_t blocks = (count - head) / 16;
+    if (blocks > 0) {
+        uint32_t body = blocks * 16;
+        int8_t lo, hi;
+        minmax_pie(values + head, blocks, &lo, &hi);
+
+        int8_t part_lo, part_hi;
+        if (head > 0) {
+            minmax_scalar(values, head, &part_lo, &part_hi);
+            lo = part_lo < lo ? part_lo : lo;
+            hi = part_hi > hi ? part_hi : hi;
+        }
+        if (count - head - body > 0) {
+            minmax_scalar(values + head + body, count - head - body, &part_lo, &part_hi);
+            lo = part_lo < lo ? part_lo : lo;
+            hi = part_hi > hi ? part_hi : hi;
+        }
+        *min = lo;
+        *max = hi;
+        return;
+    }
+#endif
+    minmax_scalar(values, count, min, max);
+}
+
+/**
+ * @brief Bin an int8 RSSI array into a histogram
+ */
+void rssi_hist_add_s8(rssi_hist_t* hist, const int8_t* values, uint32_t count) {
+    PROFILE_SCOPE(PROFILE_HIST_ADD);
+    for (uint32_t i = 0; i < count; i++) {
+        rssi_hist_add(hist, values[i]);
+    }
+}
+
+/**
+ * @brief Fold one sample per element into an array of 1/16 dBm EWMAs
+ */
+void rssi_ewma_update_s16(int16_t* ewma_x16, const int8_t* samples, uint32_t count, uint8_t shift) {
+    for (uint32_t i = 0; i < count; i++) {
+        ewma_x16[i] += ((int16_t)(samples[i] * 16) - ewma_x16[i]) >> shift;
+    }
+}
+
+/**
+ * @brief Squared Euclidean distance from one 16-lane int8 vector to each of many
+ */
+void rssi_sqdist_s8x16(const int8_t* query, const int8_t* vectors, uint32_t count, uint32_t* distances) {
+    PROFILE_SCOPE(PROFILE_RSSI_DISTANCE);
+#if RSSI_KERNELS_PIE
+    if (count > 0) {
+        sqdist_pie(query, vectors, count, distances);
+        return;
+    }
+#endif
+    sqdist_scalar(query, vectors, count, distances);
+}
+
+/**
+ * @brief Time the vector and scalar paths against each other and log the results
+ */
+void rssi_kernels_benchmark(void) {
+    const uint32_t samples = 512;
+    const uint32_t rounds = 1000;
+    static int8_t values[512] __attribute__((aligned(16)));
+
+    // Deterministic spread over the usual RSSI range
+    uint32_t seed = 0x12345678;
+    for (uint32_t i = 0; i < samples; i++) {
+        seed = seed * 1664525UL + 1013904223UL;
+        values[i] = (int8_t)(-95 + (int32_t)((seed >> 16) % 70));
+    }
+
+    volatile int32_t sink = 0;
+    int8_t min_a = 0, max_a = 0, min_b = 0, max_b = 0;
+    static uint32_t distances_a[512 / 16], distances_b[512 / 16];
+
+    uint32_t start = micros();
+    for (uint32_t r = 0; r < rounds; r++) {
+        sink += sum_scalar(values, samples);
+        minmax_scalar(values, samples, &min_a, &max_a);
+        sqdist_scalar(values, values, samples / 16, distances_a);
+    }
+    uint32_t scalar_us = micros() - start;
+    int32_t scalar_sum = sum_scalar(values, samples);
+
+    start = micros();
+    for (uint32_t r = 0; r < rounds; r++) {
+        sink += rssi_sum_s8(values, samples);
+        rssi_minmax_s8(values, samples, &min_b, &max_b);
+        rssi_sqdist_s8x16(values, values, samples / 16, distances_b);
+    }
+    uint32_t kernel_us = micros() - start;
+    int32_t kernel_sum = rssi_sum_s8(values, samples);
+
+    bool match = scalar_sum == kernel_sum && min_a == min_b && max_a == max_b &&
+                 memcmp(distances_a, distances_b, sizeof(distances_a)) == 0;
+    LOGI(SCAN, "⏱️  RSSI kernels (%s): scalar %luus, kernel %luus for %lu x %lu samples%s",
+         RSSI_KERNELS_PIE ? "PIE" : "scalar only", scalar_us, kernel_us,
+         rounds, samples, match ? "" : " - RESULT MISMATCH");
+}
+
+/**
+ * @brief Portable sum
+ */
+static int32_t sum_scalar(const int8_t* values, uint32_t count) {
+    int32_t sum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += values[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief Portable min/max (count must be non-zero)
+ */
+static void minmax_scalar(const int8_t* values, uint32_t count, int8_t* min, int8_t* max) {
+    int8_t lo = values[0];
+    int8_t hi = values[0];
+    for (uint32_t i = 1; i < count; i++) {
+        if (values[i] < lo) lo = values[i];
+        if (values[i] > hi) hi = values[i];
+    }
+    *min = lo;
+    *max = hi;
+}
+
+/**
+ * @brief Portable squared distances
+ */
+static void sqdist_scalar(const int8_t* query, const int8_t* vectors, uint32_t count, uint32_t* distances) {
+    for (uint32_t v = 0; v < count; v++) {
+        uint32_t sum = 0;
+        for (uint8_t lane = 0; lane < 16; lane++) {
+            int32_t diff = vectors[v * 16 + lane] - query[lane];
+            sum += (uint32_t)(diff * diff);
+        }
+        distances[v] = sum;
+    }
+}
@@ -0,0 +1,68 @@
+/**
+ * @file scan_interval.cpp
+ * @brief Churn-driven scan interval controller
+ *
+ * Churn is (appeared + lost) / live devices per cycle. A static environment
+ * is rescanned less often so the radio stays off longer; a burst of change
+ * snaps the interval down to the floor. The gap between the high and low
+ * thresholds plus the calm-cycle count provide the hysteresis.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "scan_interval.h"
+
+static scan_interval_stats_t controller;
+
+/**
+ * @brief Start at the profile's nominal interval
+ */
+void scan_interval_init(void) {
+    memset(&controller, 0, sizeof(controller));
+    controller.scale_pct = 100;
+    controller.interval_ms = SCAN_INTERVAL;
+}
+
+/**
+ * @brief Feed one cycle's delta and pick the next interval
+ */
+uint32_t scan_interval_update(const device_delta_t* delta, uint32_t base_ms, bool thermal_hold) {
+    uint32_t changed = delta->appeared + delta->lost;
+    uint32_t total = delta->live_wifi + delta->live_ble + delta->lost;
+    uint32_t churn = total > 0 ? changed * 1000 / total : 0;
+    controller.churn_permille = churn > 1000 ? 1000 : (uint16_t)churn;
+
+    controller.thermal_hold = thermal_hold;
+    if (controller.thermal_hold) {
+        controller.scale_pct = SCAN_ADAPT_CEILING_PCT;
+        controller.calm_cycles = 0;
+    } else if (controller.churn_permille >= SCAN_ADAPT_CHURN_HIGH) {
+        controller.scale_pct = SCAN_ADAPT_FLOOR_PCT;
+        controller.calm_cycles = 0;
+    } else if (controller.churn_permille < SCAN_ADAPT_CHURN_LOW) {
+        if (controller.calm_cycles < SCAN_ADAPT_CALM_CYCLES) {
+            controller.calm_cycles++;
+        }
+        if (controller.calm_cycles >= SCAN_ADAPT_CALM_CYCLES) {
+            controller.scale_pct += SCAN_ADAPT_STEP_PCT;
+            if (controller.scale_pct > SCAN_ADAPT_CEILING_PCT) {
+                controller.scale_pct = SCAN_ADAPT_CEILING_PCT;
+            }
+        }
+    } else {
+        // Between the thresholds: hold the current interval
+        controller.calm_cycles = 0;
+    }
+
+    controller.interval_ms = base_ms * controller.scale_pct / 100;
+    return controller.interval_ms;
+}
+
+/**
+ * @brief Copy the controller state
+ */
+void scan_interval_get_stats(scan_interval_stats_t* stats) {
+    if (stats != NULL) {
+        *stats = controller;
+    }
+}
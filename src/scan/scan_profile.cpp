@@ -0,0 +1,126 @@
+/**
+ * @file scan_profile.cpp
+ * @brief Named WiFi scan profiles, selected per AI state by the resource governor
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "scan_profile.h"
+#include "logger.h"
+
+static const scan_profile_t profiles[SCAN_PROFILE_COUNT] = {
+    // name             channel mask               dwell                    passive target interval
+    { "fast-passive",   SCAN_CHANNEL_MASK_SOCIAL,  PASSIVE_DWELL_MS,        true,   false, SLEEP_SCAN_INTERVAL_MS },
+    { "full-active",    SCAN_CHANNEL_MASK_ALL,     0,                       false,  false, SCAN_INTERVAL },
+    { "targeted-bssid", 0,                         TARGETED_DWELL_MS,       false,  true,  SCAN_INTERVAL },
+    { "single-channel", 0,                         SINGLE_CHANNEL_DWELL_MS, false,  false, SCAN_INTERVAL }
+};
+
+static volatile scan_profile_id_t active_profile = SCAN_PROFILE_FULL_ACTIVE;
+static volatile scan_profile_id_t pinned_profile = SCAN_PROFILE_COUNT;
+
+// Target for the targeted and single-channel profiles
+static uint8_t target_bssid[6];
+static uint8_t target_channel = 0;
+static bool target_valid = false;
+static portMUX_TYPE target_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Profile parameters by id
+ */
+const scan_profile_t* scan_profile_get(scan_profile_id_t id) {
+    if (id >= SCAN_PROFILE_COUNT) {
+        id = SCAN_PROFILE_FULL_ACTIVE;
+    }
+    return &profiles[id];
+}
+
+/**
+ * @brief Request a profile for the next scan cycle (safe from any task)
+ */
+void scan_profile_select(scan_profile_id_t id) {
+    if (id < SCAN_PROFILE_COUNT && id != active_profile) {
+        active_profile = id;
+        LOGI(SCAN, "📡 Scan profile: %s", profiles[id].name);
+    }
+}
+
+/**
+ * @brief Profile for the next scan cycle: the pinned one, else the one requested
+ */
+scan_profile_id_t scan_profile_active(void) {
+    scan_profile_id_t pinned = pinned_profile;
+    return pinned < SCAN_PROFILE_COUNT ? pinned : active_profile;
+}
+
+/**
+ * @brief Hold a profile over the governor's choices
+ */
+void scan_profile_pin(scan_profile_id_t id) {
+    id = id < SCAN_PROFILE_COUNT ? id : SCAN_PROFILE_COUNT;
+    if (id == pinned_profile) {
+        return;
+    }
+    pinned_profile = id;
+    if (id < SCAN_PROFILE_COUNT) {
+        LOGI(SCAN, "📌 Scan profile pinned: %s", profiles[id].name);
+    } else {
+        LOGI(SCAN, "📌 Scan profile unpinned: %s", profiles[active_profile].name);
+    }
+}
+
+/**
+ * @brief Pinned profile, SCAN_PROFILE_COUNT for none
+ */
+scan_profile_id_t scan_profile_pinned(void) {
+    return pinned_profile;
+}
+
+/**
+ * @brief Profile by name
+ */
+scan_profile_id_t scan_profile_find(const char* name) {
+    for (uint8_t id = 0; id < SCAN_PROFILE_COUNT; id++) {
+        if (strcmp(name, profiles[id].name) == 0) {
+            return (scan_profile_id_t)id;
+        }
+    }
+    return SCAN_PROFILE_COUNT;
+}
+
+/**
+ * @brief Set the BSSID and channel used by the targeted and single-channel profiles
+ */
+void scan_profile_set_target(const uint8_t* bssid, uint8_t channel) {
+    if (channel == 0 || channel > WIFI_CHANNEL_COUNT) {
+        return;
+    }
+
+    portENTER_CRITICAL(&target_lock);
+    if (bssid != NULL) {
+        memcpy(target_bssid, bssid, sizeof(target_bssid));
+        target_valid = true;
+    }
+    target_channel = channel;
+    portEXIT_CRITICAL(&target_lock);
+}
+
+/**
+ * @brief Effective channel mask of a profile, resolving the target channel
+ */
+uint16_t scan_profile_channel_mask(const scan_profile_t* profile) {
+    if (profile->channel_mask != 0) {
+        return profile->channel_mask;
+    }
+
+    // Without a target yet, fall back to a full sweep to find one
+    return target_channel != 0 ? (uint16_t)(1 << target_channel) : SCAN_CHANNEL_MASK_ALL;
+}
+
+/**
+ * @brief Target BSSID for profiles that filter on it
+ */
+const uint8_t* scan_profile_target_bssid(const scan_profile_t* profile) {
+    return profile->use_target_bssid && target_valid ? target_bssid : NULL;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file scan_scheduler.cpp
+ * @brief Interleaved WiFi/BLE slot planner with coexistence policy
+ */
+
+#include <Arduino.h>
+#include <esp_coexist.h>
+#include "config.h"
+#include "scan_scheduler.h"
+#include "mesh_sync.h"
+#include "radio_link.h"
+#include "logger.h"
+
+// Maximum slots per cycle: every WiFi run is followed by a BLE window
+#define WIFI_SLOT_COUNT ((WIFI_CHANNEL_COUNT + WIFI_CHANNELS_PER_SLOT - 1) / WIFI_CHANNELS_PER_SLOT)
+#define MAX_SCAN_SLOTS  (WIFI_SLOT_COUNT * 2)
+
+// Per-channel dwell table from config.h
+static const uint16_t channel_dwell_ms[WIFI_CHANNEL_COUNT] = WIFI_CHANNEL_DWELL_MS;
+
+// Slot plan, rebuilt whenever the profile changes
+static const scan_profile_t* plan_profile = NULL;
+static uint16_t plan_channel_mask = 0;
+static scan_slot_t slot_plan[MAX_SCAN_SLOTS];
+static uint8_t slot_count = 0;
+static uint8_t next_slot = 0;
+static uint32_t plan_duration_ms = 0;
+static uint32_t wifi_refresh_ms = 0;
+static uint32_t ble_refresh_ms = 0;
+
+// Forward declarations
+static void build_slot_plan(const scan_profile_t* profile);
+static void compute_refresh_latency(void);
+static uint16_t plan_mask_for(const scan_profile_t* profile);
+
+/**
+ * @brief Build the interleaved slot plan and apply the coexistence policy
+ */
+bool scan_scheduler_init(void) {
+    // Let the coexistence arbiter split airtime evenly between the radios
+    esp_coex_preference_set(ESP_COEX_PREFER_BALANCE);
+
+    build_slot_plan(scan_profile_get(scan_profile_active()));
+    compute_refresh_latency();
+
+    LOGI(SCAN, "✅ Scan scheduler: %d slots, %lums plan, refresh WiFi %lums / BLE %lums",
+         slot_count, plan_duration_ms, wifi_refresh_ms, ble_refresh_ms);
+
+    if (plan_duration_ms > plan_profile->interval_ms) {
+        LOGW(SCAN, "⚠️  Scan plan (%lums) exceeds the profile interval (%lums)",
+             plan_duration_ms, plan_profile->interval_ms);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Rewind to the first slot of a new scan cycle
+ */
+const scan_profile_t* scan_scheduler_begin_cycle(void) {
+    const scan_profile_t* profile = scan_profile_get(scan_profile_active());
+    if (profile != plan_profile || plan_mask_for(profile) != plan_channel_mask) {
+        build_slot_plan(profile);
+        compute_refresh_latency();
+    }
+
+    next_slot = 0;
+    return plan_profile;
+}
+
+/**
+ * @brief Fetch the next slot of the current cycle
+ */
+bool scan_scheduler_next_slot(scan_slot_t* slot) {
+    if (slot == NULL || next_slot >= slot_count) {
+        return false;
+    }
+    *slot = slot_plan[next_slot++];
+    return true;
+}
+
+/**
+ * @brief Dwell time configured for a WiFi channel
+ */
+uint16_t scan_scheduler_channel_dwell(uint8_t channel) {
+    if (channel == 0 || channel > WIFI_CHANNEL_COUNT) {
+        return WIFI_SCAN_TIMEOUT_MS;
+    }
+    if (plan_profile != NULL && plan_profile->dwell_ms != 0) {
+        return plan_profile->dwell_ms;
+    }
+    return channel_dwell_ms[channel - 1];
+}
+
+/**
+ * @brief Worst-case time between two refreshes of the same WiFi channel
+ */
+uint32_t scan_scheduler_wifi_refresh_ms(void) {
+    return wifi_refresh_ms;
+}
+
+/**
+ * @brief Worst-case gap between two BLE scan windows
+ */
+uint32_t scan_scheduler_ble_refresh_ms(void) {
+    return ble_refresh_ms;
+}
+
+/**
+ * @brief Split the profile's channels into runs and interleave BLE windows
+ */
+static void build_slot_plan(const scan_profile_t* profile) {
+    plan_profile = profile;
+    plan_channel_mask = plan_mask_for(profile);
+    slot_count = 0;
+    plan_duration_ms = 0;
+
+    uint8_t channel = 1;
+    while (channel <= WIFI_CHANNEL_COUNT) {
+        scan_slot_t wifi_slot = { SCAN_SLOT_WIFI, 0, 0 };
+        uint8_t in_run = 0;
+
+        // Collect up to WIFI_CHANNELS_PER_SLOT masked channels into one run
+        for (; channel <= WIFI_CHANNEL_COUNT && in_run < WIFI_CHANNELS_PER_SLOT; channel++) {
+            if (plan_channel_mask & (1 << channel)) {
+                wifi_slot.channel_mask |= 1 << channel;
+                wifi_slot.duration_ms += scan_scheduler_channel_dwell(channel) + SCAN_SLOT_OVERHEAD_MS;
+                in_run++;
+            }
+        }
+        if (in_run == 0) {
+            break;
+        }
+
+        slot_plan[slot_count++] = wifi_slot;
+
+        scan_slot_t* ble_slot = &slot_plan[slot_count++];
+        ble_slot->type = SCAN_SLOT_BLE;
+        ble_slot->channel_mask = 0;
+        ble_slot->duration_ms = BLE_SLOT_MS;
+
+        plan_duration_ms += wifi_slot.duration_ms + ble_slot->duration_ms;
+    }
+}
+
+/**
+ * @brief Derive worst-case refresh latency for both radios from the plan
+ */
+static void compute_refresh_latency(void) {
+    // Cycles start every profile interval unless the plan overruns it
+    uint32_t cycle_ms = max(plan_profile->interval_ms, plan_duration_ms);
+    wifi_refresh_ms = cycle_ms;
+
+    // Longest stretch without a BLE window, including the idle tail
+    uint32_t gap = cycle_ms - plan_duration_ms;
+    uint32_t longest_gap = 0;
+    uint32_t leading_gap = 0;
+    bool seen_ble = false;
+
+    for (uint8_t i = 0; i < slot_count; i++) {
+        if (slot_plan[i].type == SCAN_SLOT_BLE) {
+            if (!seen_ble) {
+                leading_gap = gap;
+                seen_ble = true;
+            }
+            longest_gap = max(longest_gap, gap);
+            gap = 0;
+        } else {
+            gap += slot_plan[i].duration_ms;
+        }
+    }
+
+    // Wrap-around: tail of this cycle plus head of the next one
+    longest_gap = max(longest_gap, gap + leading_gap);
+    ble_refresh_ms = longest_gap;
+}
+
+/**
+ * @brief Channels this node sweeps for a profile, after the mesh and radio module splits
+ */
+static uint16_t plan_mask_for(const scan_profile_t* profile) {
+    uint16_t mask = scan_profile_channel_mask(profile);
+#if MESH_SYNC_ENABLED
+    mask = mesh_sync_filter_mask(mask);
+#endif
+#if RADIO_LINK_ENABLED
+    mask = radio_link_filter_mask(mask, profile);
+#endif
+    return mask;
+}
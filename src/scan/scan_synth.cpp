@@ -0,0 +1,334 @@
+/**
+ * @file scan_synth.cpp
+ * @brief Synthetic scan source for load and capacity testing
+ *
+ * Stands in for the radios so the scan, AI and UI pipeline can be driven
+ * with a stadium's worth of devices on a desk. Each emulated device is a
+ * slot holding a generation, bumped when churn replaces it with a new
+ * address, a signal offset random-walking around its population's centre,
+ * and a channel or BLE class. Addresses are locally administered and
+ * carry slot and generation, so they never collide with real devices.
+ *
+ * The generator runs on the scan task inside the cycle it feeds; its own
+ * cost is reported apart (last_sweep_us) so it can be taken off the
+ * LOOP_SCAN figures when capacity is measured.
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "ssid_arena.h"
+#include "scan_synth.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+#define SYNTH_OFFSET_MAX_DB 20      // Furthest a device drifts from its population's centre
+#define SYNTH_HIDDEN_EVERY  32      // One access point in this many hides its SSID
+#define SYNTH_MIN_INTERVAL_MS 100   // Shortest cycle period at any speedup
+#define SYNTH_SEED          0x5EED5CA7
+
+/**
+ * @brief One emulated device
+ */
+typedef struct {
+    uint16_t generation;            // Bumped when churned: a new address in the same slot
+    int8_t   offset_db;             // Signal level around the population's centre
+    uint8_t  attribute;             // Channel of an access point, class of an advertiser
+} synth_device_t;
+
+static synth_device_t* aps = NULL;
+static synth_device_t* advertisers = NULL;
+static wifi_record_t wifi_records[MAX_WIFI_NETWORKS];
+static uint16_t wifi_count = 0;
+static ble_sighting_t ble_sightings[BLE_RECORD_CAPACITY];
+static uint16_t ble_count = 0;
+static ble_scan_summary_t summary = {0};
+
+// Windows and churn cursors, scan task only
+static uint32_t rng = SYNTH_SEED;
+static uint16_t wifi_cursor = 0;
+static uint16_t ble_cursor = 0;
+static uint16_t ap_churn_cursor = 0;
+static uint16_t ble_churn_cursor = 0;
+static uint32_t last_interval_ms = 0;
+
+static scan_synth_load_t load = {
+    SCAN_SYNTH_APS, SCAN_SYNTH_BLE, SCAN_SYNTH_CHURN_PERMILLE, SCAN_SYNTH_RSSI_STEP_DB,
+    SCAN_SYNTH_ADV_PER_S, -70, -75, SCAN_SYNTH_SPEEDUP
+};
+static scan_synth_stats_t stats = {0};
+static portMUX_TYPE synth_mux = portMUX_INITIALIZER_UNLOCKED;
+
+const scan_source_t scan_synth_source = {
+    "synthetic",
+    scan_synth_init,
+    scan_synth_sweep,
+    scan_synth_wifi_results,
+    scan_synth_wifi_release,
+    scan_synth_ble_sightings,
+    scan_synth_ble_expire,
+    scan_synth_ble_summary,
+    scan_synth_interval_ms
+};
+
+// Forward declarations
+static uint32_t next_random(void);
+static void churn(synth_device_t* devices, uint16_t count, uint16_t replace, uint16_t* cursor);
+static void walk(synth_device_t* devices, uint16_t count, uint8_t step_db);
+static void make_mac(uint16_t slot, const synth_device_t* device, uint8_t kind, uint8_t* mac);
+static void fill_wifi(const scan_synth_load_t* now_load, uint32_t rx_us);
+static void fill_ble(const scan_synth_load_t* now_load, uint32_t now_ms, uint32_t rx_us);
+
+/**
+ * @brief Allocate both populations (PSRAM preferred); the radios stay off
+ */
+bool scan_synth_init(void) {
+    size_t bytes = SCAN_SYNTH_MAX_DEVICES * sizeof(synth_device_t);
+    aps = (synth_device_t*)mem_calloc(MEM_BULK, 1, bytes);
+    advertisers = (synth_device_t*)mem_calloc(MEM_BULK, 1, bytes);
+    if (aps == NULL || advertisers == NULL) {
+        LOGE(SCAN, "❌ No room for %u synthetic devices", SCAN_SYNTH_MAX_DEVICES * 2);
+        return false;
+    }
+
+    // Most access points crowd the three non-overlapping channels
+    static const uint8_t busy_channels[] = { 1, 6, 11 };
+    for (uint16_t i = 0; i < SCAN_SYNTH_MAX_DEVICES; i++) {
+        uint32_t r = next_random();
+        aps[i].offset_db = (int8_t)(r % (2 * SYNTH_OFFSET_MAX_DB + 1)) - SYNTH_OFFSET_MAX_DB;
+        aps[i].attribute = r & 0x300 ? busy_channels[(r >> 4) % 3] : 1 + (r >> 12) % WIFI_CHANNEL_COUNT;
+        r = next_random();
+        advertisers[i].offset_db = (int8_t)(r % (2 * SYNTH_OFFSET_MAX_DB + 1)) - SYNTH_OFFSET_MAX_DB;
+        advertisers[i].attribute = (uint8_t)((r >> 8) % BLE_CLASS_COUNT);
+    }
+    ssid_arena_init();
+
+    LOGI(SCAN, "✅ Synthetic scan source: %u APs, %u BLE devices, %u%% churn, %ux speed",
+         load.aps, load.ble_devices, load.churn_permille / 10, load.speedup);
+    return true;
+}
+
+/**
+ * @brief Churn, move and sample the populations for one cycle
+ */
+void scan_synth_sweep(const scan_profile_t* profile) {
+    uint32_t start_us = (uint32_t)esp_timer_get_time();
+    scan_synth_load_t now_load;
+    scan_synth_get_load(&now_load);
+    if (aps == NULL || advertisers == NULL) {
+        wifi_count = 0;
+        ble_count = 0;
+        return;
+    }
+
+    uint16_t ap_churn = (uint16_t)((uint32_t)now_load.aps * now_load.churn_permille / 1000);
+    uint16_t ble_churn = (uint16_t)((uint32_t)now_load.ble_devices * now_load.churn_permille / 1000);
+    churn(aps, now_load.aps, ap_churn, &ap_churn_cursor);
+    churn(advertisers, now_load.ble_devices, ble_churn, &ble_churn_cursor);
+    walk(aps, now_load.aps, now_load.rssi_step_db);
+    walk(advertisers, now_load.ble_devices, now_load.rssi_step_db);
+
+    uint32_t rx_us = (uint32_t)esp_timer_get_time();
+    fill_wifi(&now_load, rx_us);
+    fill_ble(&now_load, millis(), rx_us);
+
+    uint32_t sweep_us = (uint32_t)esp_timer_get_time() - start_us;
+    portENTER_CRITICAL(&synth_mux);
+    stats.cycles++;
+    stats.wifi_records += wifi_count;
+    stats.ble_records += ble_count;
+    stats.replaced += ap_churn + ble_churn;
+    stats.last_sweep_us = sweep_us;
+    portEXIT_CRITICAL(&synth_mux);
+}
+
+/**
+ * @brief This cycle's access point window
+ */
+bool scan_synth_wifi_results(const wifi_record_t** records, uint16_t* count) {
+    *records = wifi_records;
+    *count = wifi_count;
+    return true;
+}
+
+void scan_synth_wifi_release(void) {
+    wifi_count = 0;
+}
+
+/**
+ * @brief This cycle's advertiser window, every one of them just heard
+ */
+uint16_t scan_synth_ble_sightings(ble_sighting_t* out, uint16_t capacity, uint32_t since_ms) {
+    uint16_t n = min(ble_count, capacity);
+    memcpy(out, ble_sightings, n * sizeof(ble_sighting_t));
+    return n;
+}
+
+/**
+ * @brief Nothing to age: every window is fresh
+ */
+uint16_t scan_synth_ble_expire(void) {
+    return 0;
+}
+
+void scan_synth_ble_summary(ble_scan_summary_t* out) {
+    *out = summary;
+}
+
+/**
+ * @brief The plan's period divided by the speedup
+ */
+uint32_t scan_synth_interval_ms(uint32_t planned_ms) {
+    scan_synth_load_t now_load;
+    scan_synth_get_load(&now_load);
+    last_interval_ms = max(planned_ms / max((uint8_t)1, now_load.speedup), (uint32_t)SYNTH_MIN_INTERVAL_MS);
+    return last_interval_ms;
+}
+
+/**
+ * @brief Change the emulated load; safe from any task, applied at the next cycle
+ */
+void scan_synth_set_load(const scan_synth_load_t* new_load) {
+    portENTER_CRITICAL(&synth_mux);
+    load = *new_load;
+    load.aps = min(load.aps, (uint16_t)SCAN_SYNTH_MAX_DEVICES);
+    load.ble_devices = min(load.ble_devices, (uint16_t)SCAN_SYNTH_MAX_DEVICES);
+    load.churn_permille = min(load.churn_permille, (uint16_t)1000);
+    load.speedup = max(load.speedup, (uint8_t)1);
+    portEXIT_CRITICAL(&synth_mux);
+}
+
+/**
+ * @brief Copy the load in force
+ */
+void scan_synth_get_load(scan_synth_load_t* out) {
+    portENTER_CRITICAL(&synth_mux);
+    *out = load;
+    portEXIT_CRITICAL(&synth_mux);
+}
+
+/**
+ * @brief Copy the generator figures
+ */
+void scan_synth_get_stats(scan_synth_stats_t* out) {
+    portENTER_CRITICAL(&synth_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&synth_mux);
+}
+
+/**
+ * @brief xorshift32: the same sequence for the same load on every run
+ */
+static uint32_t next_random(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+/**
+ * @brief Give the next replace slots new addresses, round the population
+ */
+static void churn(synth_device_t* devices, uint16_t count, uint16_t replace, uint16_t* cursor) {
+    if (count == 0) {
+        return;
+    }
+    for (uint16_t i = 0; i < replace; i++) {
+        *cursor = (*cursor + 1) % count;
+        devices[*cursor].generation++;
+    }
+}
+
+/**
+ * @brief Move every device's signal by up to step_db, staying near the centre
+ */
+static void walk(synth_device_t* devices, uint16_t count, uint8_t step_db) {
+    if (step_db == 0) {
+        return;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        int8_t step = (int8_t)(next_random() % (2 * step_db + 1)) - step_db;
+        devices[i].offset_db = constrain(devices[i].offset_db + step,
+                                         -SYNTH_OFFSET_MAX_DB, SYNTH_OFFSET_MAX_DB);
+    }
+}
+
+/**
+ * @brief Locally administered address from generation, kind and slot
+ */
+static void make_mac(uint16_t slot, const synth_device_t* device, uint8_t kind, uint8_t* mac) {
+    mac[0] = 0x02;
+    mac[1] = (uint8_t)(device->generation >> 8);
+    mac[2] = (uint8_t)device->generation;
+    mac[3] = (uint8_t)(kind << 7 | ((slot >> 8) & 0x7F));
+    mac[4] = (uint8_t)slot;
+    mac[5] = 0x5E;
+}
+
+/**
+ * @brief The next MAX_WIFI_NETWORKS access points, as one sweep's records
+ */
+static void fill_wifi(const scan_synth_load_t* now_load, uint32_t rx_us) {
+    ssid_arena_begin_cycle();
+    wifi_count = min(now_load->aps, (uint16_t)MAX_WIFI_NETWORKS);
+    for (uint16_t k = 0; k < wifi_count; k++) {
+        uint16_t slot = (wifi_cursor + k) % now_load->aps;
+        const synth_device_t* device = &aps[slot];
+        wifi_record_t* record = &wifi_records[k];
+        make_mac(slot, device, 0, record->bssid);
+        record->rssi = (int8_t)constrain(now_load->wifi_rssi_dbm + device->offset_db, -100, -20);
+        record->channel = device->attribute;
+        record->auth_mode = slot % 5 == 0 ? 0 : 3;     // Some open, the rest WPA2
+        record->rx_time_us = rx_us;
+        if (slot % SYNTH_HIDDEN_EVERY == 0) {
+            record->ssid_id = SSID_ARENA_NONE;
+        } else {
+            char ssid[16];
+            uint8_t len = (uint8_t)snprintf(ssid, sizeof(ssid), "synth-%04x%02x",
+                                            slot, device->generation & 0xFF);
+            record->ssid_id = ssid_arena_intern((const uint8_t*)ssid, len);
+        }
+    }
+    if (now_load->aps > 0) {
+        wifi_cursor = (wifi_cursor + wifi_count) % now_load->aps;
+    }
+}
+
+/**
+ * @brief The next BLE_RECORD_CAPACITY advertisers, with the adverts of the interval
+ */
+static void fill_ble(const scan_synth_load_t* now_load, uint32_t now_ms, uint32_t rx_us) {
+    uint32_t per_device = max((uint32_t)1, now_load->adv_per_s * last_interval_ms / 1000);
+    int32_t rssi_sum = 0;
+
+    memset(summary.class_counts, 0, sizeof(summary.class_counts));
+    ble_count = min(now_load->ble_devices, (uint16_t)BLE_RECORD_CAPACITY);
+    for (uint16_t k = 0; k < ble_count; k++) {
+        uint16_t slot = (ble_cursor + k) % now_load->ble_devices;
+        const synth_device_t* device = &advertisers[slot];
+        ble_sighting_t* sighting = &ble_sightings[k];
+        int8_t rssi = (int8_t)constrain(now_load->ble_rssi_dbm + device->offset_db, -100, -20);
+        make_mac(slot, device, 1, sighting->addr);
+        sighting->rssi = rssi;
+        sighting->fresh = 1;
+        sighting->last_seen_ms = now_ms;
+        sighting->last_seen_us = rx_us;
+        rssi_sum += rssi;
+        summary.class_counts[device->attribute]++;
+    }
+    if (now_load->ble_devices > 0) {
+        ble_cursor = (ble_cursor + ble_count) % now_load->ble_devices;
+    }
+
+    uint32_t adverts = per_device * now_load->ble_devices;
+    uint32_t dropped = per_device * (now_load->ble_devices - ble_count);
+    summary.device_count = ble_count;
+    summary.avg_rssi = ble_count > 0 ? (int16_t)(rssi_sum / ble_count) : -100;
+    summary.adv_total += adverts;
+    summary.dropped_total += dropped;
+
+    portENTER_CRITICAL(&synth_mux);
+    stats.adverts += adverts;
+    stats.adverts_dropped += dropped;
+    portEXIT_CRITICAL(&synth_mux);
+}
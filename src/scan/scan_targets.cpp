@@ -0,0 +1,431 @@
+/**
+ * @file scan_targets.cpp
+ * @brief Pinned devices scanned on their own between full sweeps
+ *
+ * The registry is a handful of slots under one lock, written by the HTTP
+ * handlers and the scan task; everything that touches the device table,
+ * the BLE records or the controller runs on the scan task, on a copy taken
+ * under the lock, and writes back by address. The controller's whitelist
+ * is only rewritten when the BLE targets changed since it was set, so a
+ * steady registry costs one scan restart per full sweep and one after it.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "scan_targets.h"
+#include "device_table.h"
+#include "ble_scan.h"
+#include "governor.h"
+#include "logger.h"
+
+static scan_target_t targets[SCAN_TARGET_MAX];
+static bool target_used[SCAN_TARGET_MAX];
+static uint32_t ble_generation = 0;         // Bumped when the BLE targets change
+static scan_targets_stats_t stats;
+static portMUX_TYPE targets_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Scan task
+static bool narrowed = false;               // Whitelist in force
+static uint32_t narrowed_generation = 0;    // BLE targets it was set from
+
+// Forward declarations
+static int8_t find_slot(const uint8_t* mac, device_kind_t kind);
+static void note_update(scan_target_t* target, int8_t rssi, uint32_t seen_ms);
+static bool set_whitelist(const uint8_t (*addrs)[6], const uint8_t* addr_types, uint8_t count);
+static void on_get(AsyncWebServerRequest* request);
+static void on_post(AsyncWebServerRequest* request);
+
+/**
+ * @brief Pin a device; any task
+ */
+bool scan_targets_pin(const uint8_t* mac, device_kind_t kind, scan_target_source_t source) {
+    uint32_t now = millis();
+    bool pinned = true;
+    portENTER_CRITICAL(&targets_mux);
+    int8_t slot = find_slot(mac, kind);
+    if (slot >= 0) {
+        if (source == SCAN_TARGET_USER) {
+            targets[slot].source = SCAN_TARGET_USER;    // The user's hold outlasts the AI's
+        }
+    } else {
+        for (uint8_t i = 0; i < SCAN_TARGET_MAX && slot < 0; i++) {
+            slot = target_used[i] ? -1 : i;
+        }
+        if (slot < 0) {
+            stats.rejected++;
+            pinned = false;
+        } else {
+            scan_target_t* target = &targets[slot];
+            memset(target, 0, sizeof(*target));
+            memcpy(target->mac, mac, sizeof(target->mac));
+            target->kind = kind;
+            target->source = source;
+            target->pinned_ms = now;
+            target_used[slot] = true;
+            ble_generation += kind == DEVICE_KIND_BLE ? 1 : 0;
+        }
+    }
+    portEXIT_CRITICAL(&targets_mux);
+    return pinned;
+}
+
+/**
+ * @brief Unpin a device; any task
+ */
+bool scan_targets_unpin(const uint8_t* mac, device_kind_t kind) {
+    portENTER_CRITICAL(&targets_mux);
+    int8_t slot = find_slot(mac, kind);
+    if (slot >= 0) {
+        target_used[slot] = false;
+        ble_generation += kind == DEVICE_KIND_BLE ? 1 : 0;
+    }
+    portEXIT_CRITICAL(&targets_mux);
+    return slot >= 0;
+}
+
+/**
+ * @brief Unpin every target of one source; any task
+ */
+uint8_t scan_targets_unpin_all(scan_target_source_t source) {
+    uint8_t unpinned = 0;
+    portENTER_CRITICAL(&targets_mux);
+    for (uint8_t i = 0; i < SCAN_TARGET_MAX; i++) {
+        if (target_used[i] && targets[i].source == source) {
+            target_used[i] = false;
+            ble_generation += targets[i].kind == DEVICE_KIND_BLE ? 1 : 0;
+            unpinned++;
+        }
+    }
+    portEXIT_CRITICAL(&targets_mux);
+    return unpinned;
+}
+
+/**
+ * @brief Pick or release the AI's targets after a folded cycle (scan task)
+ */
+void scan_targets_cycle(uint32_t now_ms) {
+    governor_status_t governor;
+    governor_get_status(&governor);
+    bool tracking = governor.state == AI_STATE_TRACKING;
+
+    // Let go of picks once the state ends or the device has gone quiet
+    scan_target_t current[SCAN_TARGET_MAX];
+    uint8_t count = scan_targets_list(current);
+    uint8_t released = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (current[i].source != SCAN_TARGET_AI) {
+            continue;
+        }
+        const device_entry_t* entry = device_table_find(current[i].mac, (device_kind_t)current[i].kind);
+        if (!tracking || entry == NULL || now_ms - entry->last_seen_ms > SCAN_TARGET_AI_TTL_MS) {
+            released += scan_targets_unpin(current[i].mac, (device_kind_t)current[i].kind) ? 1 : 0;
+        }
+    }
+    count -= released;
+
+    portENTER_CRITICAL(&targets_mux);
+    stats.sweeps++;
+    stats.ai_released += released;
+    portEXIT_CRITICAL(&targets_mux);
+    if (!tracking || count >= SCAN_TARGET_MAX) {
+        return;
+    }
+
+    // The strongest followers not pinned yet, into the free slots
+    uint8_t wanted = SCAN_TARGET_MAX - count;
+    const device_entry_t* picks[SCAN_TARGET_MAX];
+    uint8_t picked = 0;
+    uint32_t capacity = device_table_capacity();
+    for (uint32_t i = 0; i < capacity; i++) {
+        const device_entry_t* entry = device_table_entry_at(i);
+        if (entry == NULL || entry->kind != DEVICE_KIND_BLE || !entry->track.following) {
+            continue;
+        }
+        portENTER_CRITICAL(&targets_mux);
+        bool pinned = find_slot(entry->mac, DEVICE_KIND_BLE) >= 0;
+        portEXIT_CRITICAL(&targets_mux);
+        if (pinned) {
+            continue;
+        }
+        // Insertion into a short list, strongest first
+        uint8_t at = picked < wanted ? picked++ : wanted;
+        while (at > 0 && picks[at - 1]->rssi_ewma_x16 < entry->rssi_ewma_x16) {
+            if (at < wanted) {
+                picks[at] = picks[at - 1];
+            }
+            at--;
+        }
+        if (at < wanted) {
+            picks[at] = entry;
+        }
+    }
+
+    for (uint8_t i = 0; i < picked; i++) {
+        if (!scan_targets_pin(picks[i]->mac, DEVICE_KIND_BLE, SCAN_TARGET_AI)) {
+            break;
+        }
+        portENTER_CRITICAL(&targets_mux);
+        stats.ai_picks++;
+        portEXIT_CRITICAL(&targets_mux);
+        LOGI(SCAN, "🎯 Tracking %02x:%02x:%02x:%02x:%02x:%02x (%d dBm)", picks[i]->mac[0], picks[i]->mac[1],
+             picks[i]->mac[2], picks[i]->mac[3], picks[i]->mac[4], picks[i]->mac[5], picks[i]->rssi_last);
+    }
+}
+
+/**
+ * @brief Ready a targeted pass: look channels up, narrow the BLE scan (scan task)
+ */
+uint8_t scan_targets_begin_pass(scan_target_t* out) {
+    uint8_t count = scan_targets_list(out);
+
+    uint8_t addrs[SCAN_TARGET_MAX][6];
+    uint8_t addr_types[SCAN_TARGET_MAX];
+    uint8_t ble_count = 0;
+    bool ble_known = true;
+    for (uint8_t i = 0; i < count; i++) {
+        scan_target_t* target = &out[i];
+        if (target->kind == DEVICE_KIND_WIFI_AP) {
+            // An access point may have moved channel; the last sweep knows
+            if (target->channel != 0 && target->misses < SCAN_TARGET_MISSES) {
+                continue;
+            }
+            const device_entry_t* entry = device_table_find(target->mac, DEVICE_KIND_WIFI_AP);
+            target->channel = entry != NULL ? entry->channel : 0;
+            target->misses = 0;
+            portENTER_CRITICAL(&targets_mux);
+            int8_t slot = find_slot(target->mac, DEVICE_KIND_WIFI_AP);
+            if (slot >= 0) {
+                targets[slot].channel = target->channel;
+                targets[slot].misses = 0;
+            }
+            portEXIT_CRITICAL(&targets_mux);
+            continue;
+        }
+        // The whitelist needs the address type, which only the device's record holds
+        ble_sighting_t sighting;
+        if (ble_scan_lookup(target->mac, &sighting, &target->addr_type)) {
+            memcpy(addrs[ble_count], target->mac, sizeof(addrs[ble_count]));
+            addr_types[ble_count++] = target->addr_type;
+        } else {
+            ble_known = false;
+        }
+    }
+
+    // Narrow the BLE scan to the targets once each of them has been heard
+    portENTER_CRITICAL(&targets_mux);
+    uint32_t generation = ble_generation;
+    stats.passes += count > 0 ? 1 : 0;
+    portEXIT_CRITICAL(&targets_mux);
+    bool narrow = ble_count > 0 && ble_known;
+    if (narrow && (!narrowed || narrowed_generation != generation)) {
+        narrowed = set_whitelist(addrs, addr_types, ble_count);
+        narrowed_generation = generation;
+    } else if (!narrow && narrowed) {
+        scan_targets_end_phase();
+    }
+    return count;
+}
+
+/**
+ * @brief Record what a WiFi target's scan heard (scan task)
+ */
+void scan_targets_note_wifi(const uint8_t* bssid, bool heard, int8_t rssi, uint8_t channel, uint32_t now_ms) {
+    portENTER_CRITICAL(&targets_mux);
+    stats.wifi_scans++;
+    int8_t slot = find_slot(bssid, DEVICE_KIND_WIFI_AP);
+    if (slot >= 0) {
+        scan_target_t* target = &targets[slot];
+        if (heard) {
+            note_update(target, rssi, now_ms);
+            target->channel = channel;
+            target->misses = 0;
+            stats.wifi_hits++;
+        } else if (target->misses < UINT8_MAX) {
+            target->misses++;
+        }
+    }
+    portEXIT_CRITICAL(&targets_mux);
+}
+
+/**
+ * @brief Take the BLE targets' latest advertisements from their records (scan task)
+ */
+void scan_targets_note_ble(void) {
+    scan_target_t current[SCAN_TARGET_MAX];
+    uint8_t count = scan_targets_list(current);
+    for (uint8_t i = 0; i < count; i++) {
+        ble_sighting_t sighting;
+        if (current[i].kind != DEVICE_KIND_BLE || !ble_scan_lookup(current[i].mac, &sighting, NULL) ||
+            (int32_t)(sighting.last_seen_ms - current[i].last_seen_ms) <= 0) {
+            continue;
+        }
+        portENTER_CRITICAL(&targets_mux);
+        int8_t slot = find_slot(current[i].mac, DEVICE_KIND_BLE);
+        if (slot >= 0) {
+            note_update(&targets[slot], sighting.rssi, sighting.last_seen_ms);
+            stats.ble_updates++;
+        }
+        portEXIT_CRITICAL(&targets_mux);
+    }
+}
+
+/**
+ * @brief Hear everyone again before a full sweep (scan task)
+ */
+void scan_targets_end_phase(void) {
+    if (narrowed) {
+        set_whitelist(NULL, NULL, 0);
+        narrowed = false;
+    }
+}
+
+/**
+ * @brief Copy the pinned targets; any task
+ */
+uint8_t scan_targets_list(scan_target_t* out) {
+    uint8_t count = 0;
+    portENTER_CRITICAL(&targets_mux);
+    for (uint8_t i = 0; i < SCAN_TARGET_MAX; i++) {
+        if (target_used[i]) {
+            out[count++] = targets[i];
+        }
+    }
+    portEXIT_CRITICAL(&targets_mux);
+    return count;
+}
+
+/**
+ * @brief Copy the registry figures
+ */
+void scan_targets_get_stats(scan_targets_stats_t* out) {
+    portENTER_CRITICAL(&targets_mux);
+    *out = stats;
+    out->count = 0;
+    out->ai = 0;
+    for (uint8_t i = 0; i < SCAN_TARGET_MAX; i++) {
+        if (target_used[i]) {
+            out->count++;
+            out->ai += targets[i].source == SCAN_TARGET_AI ? 1 : 0;
+        }
+    }
+    portEXIT_CRITICAL(&targets_mux);
+    out->whitelist = narrowed;
+}
+
+/**
+ * @brief Add SCAN_TARGETS_PATH to the web server
+ */
+void scan_targets_register(AsyncWebServer* server) {
+    server->on(SCAN_TARGETS_PATH, HTTP_GET, on_get);
+    server->on(SCAN_TARGETS_PATH, HTTP_POST, on_post);
+}
+
+/**
+ * @brief Slot pinning a device, -1 for none; under targets_mux
+ */
+static int8_t find_slot(const uint8_t* mac, device_kind_t kind) {
+    for (uint8_t i = 0; i < SCAN_TARGET_MAX; i++) {
+        if (target_used[i] && targets[i].kind == kind && memcmp(targets[i].mac, mac, sizeof(targets[i].mac)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Take one targeted sighting; under targets_mux
+ */
+static void note_update(scan_target_t* target, int8_t rssi, uint32_t seen_ms) {
+    if (target->last_seen_ms != 0) {
+        uint32_t gap = seen_ms - target->last_seen_ms;
+        target->interval_ms = target->interval_ms == 0 ? gap :
+            target->interval_ms + (((int32_t)(gap - target->interval_ms)) >> 2);
+    }
+    target->rssi = rssi;
+    target->last_seen_ms = seen_ms;
+    target->updates++;
+}
+
+/**
+ * @brief Hand the controller a new whitelist, counted
+ */
+static bool set_whitelist(const uint8_t (*addrs)[6], const uint8_t* addr_types, uint8_t count) {
+    bool ok = ble_scan_set_whitelist(addrs, addr_types, count);
+    portENTER_CRITICAL(&targets_mux);
+    stats.whitelist_sets++;
+    portEXIT_CRITICAL(&targets_mux);
+    if (!ok) {
+        LOGW(SCAN, "⚠️  BLE whitelist of %d addresses not taken", count);
+    }
+    return ok && count > 0;
+}
+
+/**
+ * @brief List the targets
+ */
+static void on_get(AsyncWebServerRequest* request) {
+    static char body[1024];
+    scan_targets_stats_t s;
+    scan_targets_get_stats(&s);
+    scan_target_t current[SCAN_TARGET_MAX];
+    uint8_t count = scan_targets_list(current);
+    uint32_t now = millis();
+
+    int len = snprintf(body, sizeof(body), "{\"count\":%u,\"ai\":%u,\"whitelist\":%s,\"targets\":[",
+                       s.count, s.ai, s.whitelist ? "true" : "false");
+    for (uint8_t i = 0; i < count; i++) {
+        const scan_target_t* target = &current[i];
+        len += snprintf(body + len, sizeof(body) - len,
+                        "%s{\"mac\":\"%02x:%02x:%02x:%02x:%02x:%02x\",\"kind\":\"%s\",\"source\":\"%s\","
+                        "\"channel\":%u,\"rssi\":%d,\"updates\":%lu,\"interval_ms\":%lu,\"age_ms\":%ld}",
+                        i > 0 ? "," : "", target->mac[0], target->mac[1], target->mac[2], target->mac[3],
+                        target->mac[4], target->mac[5], target->kind == DEVICE_KIND_BLE ? "ble" : "wifi",
+                        target->source == SCAN_TARGET_AI ? "ai" : "user", target->channel, target->rssi,
+                        target->updates, target->interval_ms,
+                        target->last_seen_ms != 0 ? (long)(now - target->last_seen_ms) : -1L);
+    }
+    snprintf(body + len, sizeof(body) - len, "]}");
+    request->send(200, "application/json", body);
+}
+
+/**
+ * @brief Pin or unpin for the user, or clear a source's targets
+ */
+static void on_post(AsyncWebServerRequest* request) {
+    if (request->hasParam("clear", true)) {
+        String which = request->getParam("clear", true)->value();
+        uint8_t unpinned = 0;
+        if (which == "user" || which == "all") {
+            unpinned += scan_targets_unpin_all(SCAN_TARGET_USER);
+        }
+        if (which == "ai" || which == "all") {
+            unpinned += scan_targets_unpin_all(SCAN_TARGET_AI);
+        }
+        char reply[24];
+        snprintf(reply, sizeof(reply), "unpinned %u\n", unpinned);
+        request->send(200, "text/plain", reply);
+        return;
+    }
+
+    uint8_t mac[6];
+    unsigned int bytes[6];
+    String kind = request->hasParam("kind", true) ? request->getParam("kind", true)->value() : String("");
+    if (!request->hasParam("mac", true) || (kind != "wifi" && kind != "ble") ||
+        sscanf(request->getParam("mac", true)->value().c_str(), "%x:%x:%x:%x:%x:%x",
+               &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]) != 6) {
+        request->send(400, "text/plain", "mac=aa:bb:cc:dd:ee:ff and kind=wifi|ble, or clear=user|ai|all\n");
+        return;
+    }
+    for (uint8_t i = 0; i < 6; i++) {
+        mac[i] = (uint8_t)bytes[i];
+    }
+    device_kind_t device_kind = kind == "ble" ? DEVICE_KIND_BLE : DEVICE_KIND_WIFI_AP;
+
+    if (request->hasParam("remove", true)) {
+        bool unpinned = scan_targets_unpin(mac, device_kind);
+        request->send(unpinned ? 200 : 404, "text/plain", unpinned ? "unpinned\n" : "not pinned\n");
+        return;
+    }
+    bool pinned = scan_targets_pin(mac, device_kind, SCAN_TARGET_USER);
+    request->send(pinned ? 200 : 409, "text/plain", pinned ? "pinned\n" : "registry full\n");
+}
@@ -0,0 +1,186 @@
+/**
+ * @file sighting_log.cpp
+ * @brief Per-device sightings in the scan log, deduplicated into runs
+ *
+ * Most devices at a site are access points seen in every cycle at nearly
+ * the same RSSI, so a record per sighting would be almost all repetition.
+ * A device instead gets one raw record when it appears, then only
+ * presence records counting the cycles it was seen in and the RSSI range
+ * over them: one per SIGHTING_LOG_HEARTBEAT_CYCLES while its RSSI stays
+ * within SIGHTING_LOG_RSSI_BAND of the raw record, a raw record again
+ * when it leaves the band, and a last presence record when it ages out.
+ * The counters live in the device's table entry, so nothing is kept per
+ * device beyond what the table already holds.
+ *
+ * Records go through scan_log_append() like every other scan log record,
+ * so they reach the card in whole sectors with the rest.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "device_table.h"
+#include "scan_log.h"
+#include "sighting_log.h"
+
+static uint32_t cursor = 0;         // Slot the next walk starts at, so deferred devices go first
+static sighting_log_stats_t stats = {0};
+static portMUX_TYPE sighting_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static bool stage_sighting(scan_log_type_t type, const device_entry_t* entry);
+static bool stage_presence(scan_log_type_t type, const device_entry_t* entry);
+static void start_run(device_log_state_t* log, int8_t rssi_ref);
+static void fold(device_log_state_t* log, int8_t rssi);
+
+/**
+ * @brief Fold the closing cycle's sightings into the scan log
+ */
+void sighting_log_record_cycle(uint16_t cycle) {
+    uint32_t capacity = device_table_capacity();
+    if (capacity == 0) {
+        return;
+    }
+
+    uint16_t budget = SIGHTING_LOG_CYCLE_RECORDS;
+    uint32_t seen = 0, appeared = 0, changed = 0, present = 0, deferred = 0;
+    int32_t first_deferred = -1;
+    for (uint32_t n = 0; n < capacity; n++) {
+        uint32_t index = (cursor + n) & (capacity - 1);
+        device_entry_t* entry = device_table_entry_mut(index);
+        if (entry == NULL) {
+            continue;
+        }
+        device_log_state_t* log = &entry->log;
+        int8_t rssi = entry->rssi_last;
+
+        if (!log->logged) {
+            if (budget == 0 || !stage_sighting(SCAN_LOG_DEVICE_APPEARED, entry)) {
+                deferred++;
+                first_deferred = first_deferred < 0 ? (int32_t)index : first_deferred;
+                continue;
+            }
+            budget--;
+            appeared++;
+            log->logged = 1;
+            start_run(log, rssi);
+            continue;
+        }
+        if (entry->last_cycle != cycle) {
+            continue;
+        }
+        seen++;
+
+        if (abs(rssi - log->rssi_ref) > SIGHTING_LOG_RSSI_BAND) {
+            // Close the run at the old level, then a raw record sets the new one
+            uint16_t needed = log->cycles > 0 ? 2 : 1;
+            if (budget >= needed &&
+                (log->cycles == 0 || stage_presence(SCAN_LOG_DEVICE_PRESENT, entry))) {
+                present += log->cycles > 0 ? 1 : 0;
+                start_run(log, log->rssi_ref);
+                if (stage_sighting(SCAN_LOG_DEVICE_CHANGED, entry)) {
+                    changed++;
+                    start_run(log, rssi);
+                    budget -= needed;
+                    continue;
+                }
+            }
+            // Counted in the run; the next cycle tries again if it is still out
+            fold(log, rssi);
+            deferred++;
+            first_deferred = first_deferred < 0 ? (int32_t)index : first_deferred;
+            continue;
+        }
+
+        fold(log, rssi);
+        if (log->cycles >= SIGHTING_LOG_HEARTBEAT_CYCLES) {
+            if (budget > 0 && stage_presence(SCAN_LOG_DEVICE_PRESENT, entry)) {
+                budget--;
+                present++;
+                start_run(log, log->rssi_ref);
+            } else {
+                deferred++;
+                first_deferred = first_deferred < 0 ? (int32_t)index : first_deferred;
+            }
+        }
+    }
+    if (first_deferred >= 0) {
+        cursor = (uint32_t)first_deferred;
+    }
+
+    portENTER_CRITICAL(&sighting_mux);
+    stats.cycles_seen += seen;
+    stats.appeared += appeared;
+    stats.changed += changed;
+    stats.present += present;
+    stats.deferred += deferred;
+    portEXIT_CRITICAL(&sighting_mux);
+}
+
+/**
+ * @brief Stage a device's last run as it ages out
+ */
+void sighting_log_device_lost(const device_entry_t* entry) {
+    if (!entry->log.logged) {
+        return;                     // Aged out before its appearance got a slot
+    }
+    bool staged = stage_presence(SCAN_LOG_DEVICE_GONE, entry);
+    portENTER_CRITICAL(&sighting_mux);
+    if (staged) {
+        stats.gone++;
+    } else {
+        stats.deferred++;
+    }
+    portEXIT_CRITICAL(&sighting_mux);
+}
+
+/**
+ * @brief Copy the sighting log figures
+ */
+void sighting_log_get_stats(sighting_log_stats_t* out) {
+    portENTER_CRITICAL(&sighting_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&sighting_mux);
+}
+
+static bool stage_sighting(scan_log_type_t type, const device_entry_t* entry) {
+    scan_log_sighting_t record;
+    memcpy(record.mac, entry->mac, sizeof(record.mac));
+    record.kind = entry->kind;
+    record.channel = entry->channel;
+    record.rssi = entry->rssi_last;
+    return scan_log_append(type, &record, sizeof(record), false);
+}
+
+static bool stage_presence(scan_log_type_t type, const device_entry_t* entry) {
+    scan_log_presence_t record;
+    memcpy(record.mac, entry->mac, sizeof(record.mac));
+    record.kind = entry->kind;
+    record.rssi_min = entry->log.cycles > 0 ? entry->log.rssi_min : entry->log.rssi_ref;
+    record.rssi_max = entry->log.cycles > 0 ? entry->log.rssi_max : entry->log.rssi_ref;
+    record.rssi_last = entry->rssi_last;
+    record.cycles = entry->log.cycles;
+    return scan_log_append(type, &record, sizeof(record), false);
+}
+
+/**
+ * @brief Start counting a new run against a reference RSSI
+ */
+static void start_run(device_log_state_t* log, int8_t rssi_ref) {
+    log->rssi_ref = rssi_ref;
+    log->cycles = 0;
+}
+
+/**
+ * @brief Count one cycle's sighting in the current run
+ */
+static void fold(device_log_state_t* log, int8_t rssi) {
+    if (log->cycles == 0) {
+        log->rssi_min = log->rssi_max = rssi;
+    } else {
+        log->rssi_min = min(log->rssi_min, rssi);
+        log->rssi_max = max(log->rssi_max, rssi);
+    }
+    if (log->cycles < UINT16_MAX) {
+        log->cycles++;
+    }
+}
@@ -0,0 +1,183 @@
+/**
+ * @file ssid_arena.cpp
+ * @brief Fixed-slot SSID storage with an interning hash index
+ *
+ * Every SSID lives in one 32-byte slot of a static arena, so scanning never
+ * touches the heap. An open-addressed index maps SSID bytes to slots, letting
+ * networks that reappear every cycle keep the slot they already own.
+ */
+
+#include <string.h>
+#include "config.h"
+#include "ssid_arena.h"
+
+#define INDEX_EMPTY 0xFFFF
+#define INDEX_MASK  (SSID_ARENA_INDEX_SIZE - 1)
+
+// Slot storage
+static uint8_t  slot_bytes[SSID_ARENA_SLOTS][MAX_SSID_LENGTH];
+static uint8_t  slot_len[SSID_ARENA_SLOTS];      // 0 = free
+static uint32_t slot_hash[SSID_ARENA_SLOTS];
+static uint16_t slot_cycle[SSID_ARENA_SLOTS];    // Cycle of the last intern
+
+// Interning index: slot handles, or INDEX_EMPTY
+static uint16_t hash_index[SSID_ARENA_INDEX_SIZE];
+
+static uint16_t current_cycle = 0;
+static uint16_t used_slots = 0;
+static uint16_t evict_cursor = 0;
+
+// Forward declarations
+static uint32_t hash_bytes(const uint8_t* bytes, uint8_t len);
+static int16_t  claim_slot(void);
+static void     index_remove(uint16_t id);
+
+/**
+ * @brief Reset the arena and its interning index
+ */
+void ssid_arena_init(void) {
+    memset(slot_len, 0, sizeof(slot_len));
+    memset(hash_index, 0xFF, sizeof(hash_index));
+    current_cycle = 0;
+    used_slots = 0;
+    evict_cursor = 0;
+}
+
+/**
+ * @brief Start a new scan cycle
+ */
+void ssid_arena_begin_cycle(void) {
+    current_cycle++;
+}
+
+/**
+ * @brief Intern raw SSID bytes, reusing the slot of an identical SSID
+ */
+uint16_t ssid_arena_intern(const uint8_t* bytes, uint8_t len) {
+    if (bytes == NULL || len == 0) {
+        return SSID_ARENA_NONE;
+    }
+    if (len > MAX_SSID_LENGTH) {
+        len = MAX_SSID_LENGTH;
+    }
+
+    uint32_t hash = hash_bytes(bytes, len);
+    uint32_t pos = hash & INDEX_MASK;
+
+    while (hash_index[pos] != INDEX_EMPTY) {
+        uint16_t id = hash_index[pos];
+        if (slot_hash[id] == hash && slot_len[id] == len &&
+            memcmp(slot_bytes[id], bytes, len) == 0) {
+            slot_cycle[id] = current_cycle;
+            return id;
+        }
+        pos = (pos + 1) & INDEX_MASK;
+    }
+
+    int16_t slot = claim_slot();
+    if (slot < 0) {
+        return SSID_ARENA_NONE;
+    }
+
+    // Eviction may have reshuffled the probe chain, so probe again
+    pos = hash & INDEX_MASK;
+    while (hash_index[pos] != INDEX_EMPTY) {
+        pos = (pos + 1) & INDEX_MASK;
+    }
+
+    memcpy(slot_bytes[slot], bytes, len);
+    slot_len[slot] = len;
+    slot_hash[slot] = hash;
+    slot_cycle[slot] = current_cycle;
+    hash_index[pos] = (uint16_t)slot;
+    used_slots++;
+    return (uint16_t)slot;
+}
+
+/**
+ * @brief Raw bytes of an interned SSID
+ */
+const uint8_t* ssid_arena_bytes(uint16_t id, uint8_t* len) {
+    if (id >= SSID_ARENA_SLOTS || slot_len[id] == 0) {
+        if (len != NULL) {
+            *len = 0;
+        }
+        return NULL;
+    }
+    if (len != NULL) {
+        *len = slot_len[id];
+    }
+    return slot_bytes[id];
+}
+
+/**
+ * @brief Check whether an interned SSID contains a byte pattern
+ */
+bool ssid_arena_contains(uint16_t id, const char* needle) {
+    uint8_t len = 0;
+    const uint8_t* bytes = ssid_arena_bytes(id, &len);
+    if (bytes == NULL || needle == NULL) {
+        return false;
+    }
+    return memmem(bytes, len, needle, strlen(needle)) != NULL;
+}
+
+/**
+ * @brief Number of occupied slots
+ */
+uint16_t ssid_arena_count(void) {
+    return used_slots;
+}
+
+/**
+ * @brief FNV-1a over the SSID bytes
+ */
+static uint32_t hash_bytes(const uint8_t* bytes, uint8_t len) {
+    uint32_t hash = 2166136261UL;
+    for (uint8_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Find a free slot, evicting one unused this cycle if necessary
+ */
+static int16_t claim_slot(void) {
+    for (uint16_t n = 0; n < SSID_ARENA_SLOTS; n++) {
+        uint16_t id = evict_cursor;
+        evict_cursor = (evict_cursor + 1) % SSID_ARENA_SLOTS;
+
+        if (slot_len[id] == 0) {
+            return (int16_t)id;
+        }
+        if (slot_cycle[id] != current_cycle) {
+            index_remove(id);
+            slot_len[id] = 0;
+            used_slots--;
+            return (int16_t)id;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Drop a slot from the index using backward-shift deletion
+ */
+static void index_remove(uint16_t id) {
+    uint32_t hole = slot_hash[id] & INDEX_MASK;
+    while (hash_index[hole] != id) {
+        hole = (hole + 1) & INDEX_MASK;
+    }
+
+    uint32_t next = (hole + 1) & INDEX_MASK;
+    while (hash_index[next] != INDEX_EMPTY) {
+        uint32_t home = slot_hash[hash_index[next]] & INDEX_MASK;
+        if (((next - home) & INDEX_MASK) >= ((next - hole) & INDEX_MASK)) {
+            hash_index[hole] = hash_index[next];
+            hole = next;
+        }
+        next = (next + 1) & INDEX_MASK;
+    }
+    hash_index[hole] = INDEX_EMPTY;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file wardrive.cpp
+ * @brief Position records for the scan log and speed-paced scan intervals
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include "config.h"
+#include "gps.h"
+#include "scan_log.h"
+#include "wardrive.h"
+#include "logger.h"
+
+static const char* const motion_names[WARDRIVE_MOTIONS] = {
+    "no_fix", "parked", "slow", "moving", "fast"
+};
+
+static wardrive_stats_t stats = { WARDRIVE_NO_FIX, 100, 0, 0, 0, 0 };
+static portMUX_TYPE wardrive_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t slow_since_ms = 0;          // 0 while not slow
+static bool have_last = false;
+static int32_t last_lat_e7 = 0;
+static int32_t last_lon_e7 = 0;
+
+/**
+ * @brief Stage the cycle's position ahead of its sightings
+ */
+void wardrive_tag_cycle(uint32_t now_ms) {
+    gps_fix_t fix;
+    if (!gps_get_fix(&fix)) {
+        portENTER_CRITICAL(&wardrive_mux);
+        stats.untagged_cycles++;
+        portEXIT_CRITICAL(&wardrive_mux);
+        return;
+    }
+
+    scan_log_position_t record;
+    record.lat_e7 = fix.lat_e7;
+    record.lon_e7 = fix.lon_e7;
+    record.utc_s = fix.utc_s;
+    record.alt_m = fix.alt_m;
+    record.speed_kmh = (uint8_t)min(fix.speed_kmh_x10 / 10, 255);
+    record.hdop_x10 = fix.hdop_x10;
+    bool staged = scan_log_append(SCAN_LOG_POSITION, &record, sizeof(record), false);
+
+    uint32_t moved = have_last ? wardrive_distance_m(last_lat_e7, last_lon_e7, fix.lat_e7, fix.lon_e7) : 0;
+    have_last = true;
+    last_lat_e7 = fix.lat_e7;
+    last_lon_e7 = fix.lon_e7;
+
+    portENTER_CRITICAL(&wardrive_mux);
+    stats.tagged_cycles++;
+    stats.distance_m += moved;
+    if (!staged) {
+        stats.dropped++;
+    }
+    portEXIT_CRITICAL(&wardrive_mux);
+}
+
+/**
+ * @brief Scale the next scan interval by the motion
+ */
+uint32_t wardrive_interval_ms(uint32_t planned_ms, uint32_t now_ms) {
+    gps_fix_t fix;
+    wardrive_motion_t motion = WARDRIVE_NO_FIX;
+    if (gps_get_fix(&fix)) {
+        if (fix.speed_kmh_x10 >= WARDRIVE_FAST_KMH_X10) {
+            motion = WARDRIVE_FAST;
+        } else if (fix.speed_kmh_x10 >= WARDRIVE_MOVING_KMH_X10) {
+            motion = WARDRIVE_MOVING;
+        } else {
+            motion = WARDRIVE_SLOW;
+        }
+    }
+
+    // Parked only after a while slow, so a red light does not stretch the sweeps
+    if (motion == WARDRIVE_SLOW && fix.speed_kmh_x10 < WARDRIVE_STILL_KMH_X10) {
+        slow_since_ms = slow_since_ms != 0 ? slow_since_ms : max(now_ms, (uint32_t)1);
+        if (now_ms - slow_since_ms >= WARDRIVE_STILL_MS) {
+            motion = WARDRIVE_PARKED;
+        }
+    } else {
+        slow_since_ms = 0;
+    }
+
+    uint16_t scale_pct = motion == WARDRIVE_FAST ? WARDRIVE_FAST_PCT :
+                         motion == WARDRIVE_MOVING ? WARDRIVE_MOVING_PCT :
+                         motion == WARDRIVE_PARKED ? WARDRIVE_STILL_PCT : 100;
+    uint32_t interval_ms = planned_ms * scale_pct / 100;
+    if (scale_pct < 100) {
+        interval_ms = max(interval_ms, min(planned_ms, (uint32_t)WARDRIVE_MIN_INTERVAL_MS));
+    }
+
+    if (stats.motion != motion) {
+        LOGI(SCAN, "🚗 Motion: %s, scan interval x%u%%", motion_names[motion], scale_pct);
+    }
+    portENTER_CRITICAL(&wardrive_mux);
+    stats.motion = motion;
+    stats.scale_pct = scale_pct;
+    portEXIT_CRITICAL(&wardrive_mux);
+    return interval_ms;
+}
+
+/**
+ * @brief Copy the figures
+ */
+void wardrive_get_stats(wardrive_stats_t* out) {
+    portENTER_CRITICAL(&wardrive_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&wardrive_mux);
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* wardrive_motion_name(wardrive_motion_t motion) {
+    return motion < WARDRIVE_MOTIONS ? motion_names[motion] : "?";
+}
+
+/**
+ * @brief Equirectangular distance; plenty for the metres between two cycles
+ */
+uint32_t wardrive_distance_m(int32_t lat1_e7, int32_t lon1_e7, int32_t lat2_e7, int32_t lon2_e7) {
+    const float e7_to_rad = (float)M_PI / 180.0f / 1e7f;
+    float mean_lat = ((float)lat1_e7 + (float)lat2_e7) * 0.5f * e7_to_rad;
+    float dx = (float)((int64_t)lon2_e7 - lon1_e7) * e7_to_rad * cosf(mean_lat);
+    float dy = (float)((int64_t)lat2_e7 - lat1_e7) * e7_to_rad;
+    return (uint32_t)lroundf(sqrtf(dx * dx + dy * dy) * 6371000.0f);
+}
@@ -0,0 +1,208 @@
+/**
+ * @file wifi_scan.cpp
+ * @brief Event-driven, non-blocking WiFi scan engine
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "wifi_scan.h"
+#include "energy.h"
+#include "logger.h"
+
+// Fixed-capacity record table, filled once per completed scan
+static wifi_record_t wifi_records[MAX_WIFI_NETWORKS];
+static uint16_t wifi_record_count = 0;
+
+// Scan state
+static volatile bool scan_done_event = false;
+static volatile uint32_t scan_done_us = 0;
+static volatile wifi_scan_status_t scan_status = WIFI_SCAN_STATE_IDLE;
+static uint32_t scan_started_at = 0;
+static uint32_t scan_budget_ms = 0;
+static TaskHandle_t scan_notify_task = NULL;
+
+// Forward declarations
+static void on_scan_done(arduino_event_id_t event, arduino_event_info_t info);
+static void copy_scan_results(int16_t network_count);
+static bool start_scan(uint8_t channel, uint16_t dwell_ms, bool passive, const uint8_t* bssid);
+
+/**
+ * @brief Register the scan-done event handler
+ */
+bool wifi_scan_init(TaskHandle_t notify_task) {
+    scan_notify_task = notify_task != NULL ? notify_task : xTaskGetCurrentTaskHandle();
+
+    if (WiFi.onEvent(on_scan_done, ARDUINO_EVENT_WIFI_SCAN_DONE) == 0) {
+        LOGE(SCAN, "❌ Failed to register WiFi scan-done handler");
+        return false;
+    }
+
+    ssid_arena_init();
+    scan_status = WIFI_SCAN_STATE_IDLE;
+    LOGI(SCAN, "✅ Async WiFi scan engine initialized");
+    return true;
+}
+
+/**
+ * @brief Start a non-blocking scan of all channels
+ */
+bool wifi_scan_start(void) {
+    wifi_scan_begin_sweep();
+    return start_scan(0, WIFI_SCAN_TIMEOUT_MS, false, NULL);
+}
+
+/**
+ * @brief Clear the record table before a multi-slot channel sweep
+ */
+void wifi_scan_begin_sweep(void) {
+    if (scan_status != WIFI_SCAN_STATE_RUNNING) {
+        wifi_record_count = 0;
+        ssid_arena_begin_cycle();
+    }
+}
+
+/**
+ * @brief Clear the record table, keeping the SSID arena's cycle
+ */
+void wifi_scan_clear_records(void) {
+    if (scan_status != WIFI_SCAN_STATE_RUNNING) {
+        wifi_record_count = 0;
+    }
+}
+
+/**
+ * @brief Start a non-blocking scan of a single channel
+ */
+bool wifi_scan_start_channel(uint8_t channel, uint16_t dwell_ms, bool passive, const uint8_t* bssid) {
+    if (channel == 0 || channel > WIFI_CHANNEL_COUNT) {
+        return false;
+    }
+    return start_scan(channel, dwell_ms, passive, bssid);
+}
+
+/**
+ * @brief Advance the scan state machine without blocking
+ */
+wifi_scan_status_t wifi_scan_poll(void) {
+    if (scan_status != WIFI_SCAN_STATE_RUNNING) {
+        return scan_status;
+    }
+
+    if (scan_done_event) {
+        int16_t network_count = WiFi.scanComplete();
+        if (network_count >= 0) {
+            copy_scan_results(network_count);
+            scan_status = WIFI_SCAN_STATE_DONE;
+        } else {
+            scan_status = WIFI_SCAN_STATE_FAILED;
+        }
+        WiFi.scanDelete();
+        energy_set_active(ENERGY_LOAD_WIFI_RX, false);
+        return scan_status;
+    }
+
+    // Guard against a lost completion event
+    if (millis() - scan_started_at > scan_budget_ms) {
+        LOGW(SCAN, "⚠️  WiFi scan timed out");
+        WiFi.scanDelete();
+        scan_status = WIFI_SCAN_STATE_FAILED;
+        energy_set_active(ENERGY_LOAD_WIFI_RX, false);
+    }
+
+    return scan_status;
+}
+
+/**
+ * @brief Whether a scan currently owns the radio (safe from any task)
+ */
+bool wifi_scan_in_progress(void) {
+    return scan_status == WIFI_SCAN_STATE_RUNNING;
+}
+
+/**
+ * @brief Access the record table filled by the last completed scan
+ */
+uint16_t wifi_scan_get_results(const wifi_record_t** records) {
+    if (records != NULL) {
+        *records = wifi_records;
+    }
+    return scan_status == WIFI_SCAN_STATE_RUNNING ? 0 : wifi_record_count;
+}
+
+/**
+ * @brief Acknowledge the current results and return to idle
+ */
+void wifi_scan_release(void) {
+    if (scan_status != WIFI_SCAN_STATE_RUNNING) {
+        scan_status = WIFI_SCAN_STATE_IDLE;
+    }
+}
+
+/**
+ * @brief Issue an async scan request for one channel (0 = all channels)
+ */
+static bool start_scan(uint8_t channel, uint16_t dwell_ms, bool passive, const uint8_t* bssid) {
+    if (scan_status == WIFI_SCAN_STATE_RUNNING) {
+        return true;
+    }
+
+    scan_done_event = false;
+    int16_t result = WiFi.scanNetworks(true, true, passive, dwell_ms, channel, NULL, bssid);
+    if (result == WIFI_SCAN_FAILED) {
+        LOGE(SCAN, "❌ WiFi scan failed to start");
+        scan_status = WIFI_SCAN_STATE_FAILED;
+        return false;
+    }
+
+    uint8_t channels = channel == 0 ? WIFI_CHANNEL_COUNT : 1;
+    scan_budget_ms = channels * dwell_ms + WIFI_SCAN_DONE_MARGIN_MS;
+    scan_started_at = millis();
+    scan_done_us = 0;
+    scan_status = WIFI_SCAN_STATE_RUNNING;
+    energy_set_active(ENERGY_LOAD_WIFI_RX, true);
+    return true;
+}
+
+/**
+ * @brief Scan-done event handler, runs in the WiFi event task
+ */
+static void on_scan_done(arduino_event_id_t event, arduino_event_info_t info) {
+    scan_done_us = (uint32_t)esp_timer_get_time();
+    scan_done_event = true;
+    if (scan_notify_task != NULL) {
+        xTaskNotify(scan_notify_task, WIFI_SCAN_NOTIFY_BIT, eSetBits);
+    }
+}
+
+/**
+ * @brief Append driver records to the fixed table in a single pass
+ */
+static void copy_scan_results(int16_t network_count) {
+    uint16_t stored = wifi_record_count;
+
+    // The driver reports no per-AP receive time; the end of the dwell
+    // bounds it (timed-out scans fall back to the copy time)
+    uint32_t rx_time_us = scan_done_us != 0 ? scan_done_us : (uint32_t)esp_timer_get_time();
+
+    for (int16_t i = 0; i < network_count && stored < MAX_WIFI_NETWORKS; i++) {
+        const wifi_ap_record_t* ap = (const wifi_ap_record_t*)WiFi.getScanInfoByIndex(i);
+        if (ap == NULL) {
+            continue;
+        }
+
+        wifi_record_t* record = &wifi_records[stored++];
+        memcpy(record->bssid, ap->bssid, sizeof(record->bssid));
+        record->ssid_id = ssid_arena_intern(ap->ssid, strnlen((const char*)ap->ssid, MAX_SSID_LENGTH));
+        record->rssi = ap->rssi;
+        record->channel = ap->primary;
+        record->auth_mode = (uint8_t)ap->authmode;
+        record->rx_time_us = rx_time_us;
+    }
+
+    wifi_record_count = stored;
+}
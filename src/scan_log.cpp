@@ -0,0 +1,264 @@
+/**
+ * @file scan_log.cpp
+ * @brief Append-only binary log of state changes and summaries on the SD card
+ *
+ * Records are framed and staged in a PSRAM ring by whichever task makes
+ * them, under a spinlock held only for the copy. A job worker writes the
+ * staged data in whole 512-byte sectors, so every card write starts and
+ * ends on a sector boundary of the file: FAT writes the sectors in place
+ * instead of reading them back first, the card sees a few kilobytes at a
+ * time instead of a line per event, and the bus is held one chunk at a
+ * time. A partial sector waits for the next flush unless a forced record
+ * pads it out with 0xFF. While no card is mounted the same file is kept
+ * on flash instead, rotated at STORAGE_FLASH_LOG_MAX_BYTES.
+ */
+
+#include <Arduino.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include "config.h"
+#include "storage.h"
+#include "sd_bench.h"
+#include "job_pool.h"
+#include "scan_log.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+#define RECORD_CRC_BYTES (sizeof(scan_log_record_t) - sizeof(uint32_t))
+#define PAD_BYTE         0xFF
+
+static uint8_t* staging = NULL;             // SCAN_LOG_STAGING_BYTES, PSRAM
+static uint32_t head = 0;                   // Bytes staged since boot
+static uint32_t tail = 0;                   // Bytes written since boot, always whole sectors
+static uint32_t sequence = 0;
+static bool force_pending = false;
+static volatile bool flush_queued = false;
+static uint32_t last_flush_ms = 0;
+static scan_log_stats_t stats = {0};
+static portMUX_TYPE log_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void request_flush(void);
+static void flush_job(void* payload);
+static bool write_sectors(uint32_t end);
+static bool pad_file(File& file);
+
+/**
+ * @brief Allocate the PSRAM staging ring and stage the boot record
+ */
+bool scan_log_init(void) {
+    if (staging != NULL) {
+        return true;
+    }
+    staging = (uint8_t*)mem_alloc(MEM_BULK, SCAN_LOG_STAGING_BYTES);
+    if (staging == NULL) {
+        LOGW(SYSTEM, "⚠️  No PSRAM for the scan log - scan log disabled");
+        return false;
+    }
+
+    scan_log_boot_t boot;
+    memset(&boot, 0, sizeof(boot));
+    boot.format = SCAN_LOG_FORMAT;
+    boot.record_bytes = sizeof(scan_log_record_t);
+    boot.reset_reason = (uint8_t)esp_reset_reason();
+    boot.heap_size = ESP.getHeapSize();
+    scan_log_append(SCAN_LOG_BOOT, &boot, sizeof(boot), false);
+    LOGI(SYSTEM, "✅ Scan log: %u KB staging in PSRAM, to %s", SCAN_LOG_STAGING_BYTES / 1024, SCAN_LOG_FILE);
+    return true;
+}
+
+/**
+ * @brief Frame and stage one record without blocking; safe from any task
+ */
+bool scan_log_append(scan_log_type_t type, const void* payload, size_t length, bool force) {
+    if (staging == NULL || length > SCAN_LOG_PAYLOAD_BYTES) {
+        return false;
+    }
+
+    scan_log_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.sync = SCAN_LOG_SYNC;
+    record.type = type;
+    record.length = length;
+    record.timestamp_ms = millis();
+    memcpy(record.payload, payload, length);
+
+    portENTER_CRITICAL(&log_mux);
+    bool staged = head - tail + sizeof(record) <= SCAN_LOG_STAGING_BYTES;
+    if (staged) {
+        record.sequence = sequence;
+        record.crc32 = esp_rom_crc32_le(0, (const uint8_t*)&record, RECORD_CRC_BYTES);
+        memcpy(staging + head % SCAN_LOG_STAGING_BYTES, &record, sizeof(record));
+        head += sizeof(record);
+        stats.records++;
+        force_pending = force_pending || force;
+    } else {
+        stats.dropped++;
+    }
+    sequence++;                     // Dropped records leave a gap
+    portEXIT_CRITICAL(&log_mux);
+
+    if (staged && force) {
+        request_flush();
+    }
+    return staged;
+}
+
+/**
+ * @brief Start a flush on a job worker when one is due
+ */
+void scan_log_tick(uint32_t now_ms) {
+    if (staging == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&log_mux);
+    uint32_t staged = head - tail;
+    bool forced = force_pending;
+    portEXIT_CRITICAL(&log_mux);
+
+    // A half-full ring is written early rather than left to drop records
+    bool sectors = staged >= SCAN_LOG_SECTOR_BYTES && now_ms - last_flush_ms >= SCAN_LOG_FLUSH_MS;
+    if (forced || sectors || staged >= SCAN_LOG_STAGING_BYTES / 2) {
+        request_flush();
+    }
+}
+
+/**
+ * @brief Copy the log's figures
+ */
+void scan_log_get_stats(scan_log_stats_t* out) {
+    portENTER_CRITICAL(&log_mux);
+    *out = stats;
+    out->staged_bytes = head - tail;
+    portEXIT_CRITICAL(&log_mux);
+}
+
+/**
+ * @brief Queue one flush job unless one is already queued or running
+ *
+ * Without a free descriptor the request is simply retried by the next
+ * tick; card writes never run on the caller's task.
+ */
+static void request_flush(void) {
+    portENTER_CRITICAL(&log_mux);
+    bool queued = flush_queued;
+    flush_queued = true;
+    portEXIT_CRITICAL(&log_mux);
+    if (!queued && !job_pool_submit(JOB_LANE_LOW, flush_job, NULL, 0)) {
+        flush_queued = false;
+    }
+}
+
+/**
+ * @brief Write every whole staged sector, padding the last one if forced
+ */
+static void flush_job(void* payload) {
+    portENTER_CRITICAL(&log_mux);
+    bool forced = force_pending;
+    uint32_t partial = head % SCAN_LOG_SECTOR_BYTES;
+    if (forced && partial != 0 && head - tail + SCAN_LOG_SECTOR_BYTES - partial <= SCAN_LOG_STAGING_BYTES) {
+        uint32_t pad = SCAN_LOG_SECTOR_BYTES - partial;
+        memset(staging + head % SCAN_LOG_STAGING_BYTES, PAD_BYTE, pad);
+        head += pad;
+        stats.padding_bytes += pad;
+    }
+    force_pending = false;
+    uint32_t end = head - head % SCAN_LOG_SECTOR_BYTES;
+    portEXIT_CRITICAL(&log_mux);
+
+    last_flush_ms = millis();
+    if (end != tail && !write_sectors(end)) {
+        // Staged data stays for the next card or the next attempt
+        portENTER_CRITICAL(&log_mux);
+        force_pending = force_pending || forced;
+        portEXIT_CRITICAL(&log_mux);
+    }
+    flush_queued = false;
+}
+
+/**
+ * @brief Append staged bytes from tail up to end to SCAN_LOG_FILE
+ *
+ * tail and end are sector multiples, and so is the ring, so each chunk is
+ * contiguous in the ring and whole sectors on the card.
+ * @return false if no medium is mounted or a write fell short
+ */
+static bool write_sectors(uint32_t end) {
+    storage_medium_t medium;
+    fs::FS* fs = storage_acquire(STORAGE_CLASS_LOG, &medium);
+    if (fs == NULL) {
+        return false;
+    }
+    uint32_t max_bytes = medium == STORAGE_MEDIUM_SD ? SCAN_LOG_MAX_BYTES : STORAGE_FLASH_LOG_MAX_BYTES;
+    File file;
+    if (storage_mkdir(medium, TRACE_LOG_DIR)) {
+        file = fs->open(SCAN_LOG_FILE, "a");
+        if (file && file.size() + (end - tail) > max_bytes) {
+            file.close();
+            fs->remove(SCAN_LOG_OLD_FILE);
+            fs->rename(SCAN_LOG_FILE, SCAN_LOG_OLD_FILE);
+            file = fs->open(SCAN_LOG_FILE, "a");
+        }
+    }
+    if (!file || !pad_file(file)) {
+        if (file) {
+            file.close();
+        }
+        storage_unlock(medium);
+        return false;
+    }
+    storage_unlock(medium);
+
+    // Sector multiples either way, at the card's measured write size
+    size_t max_chunk = medium == STORAGE_MEDIUM_SD ? sd_bench_block_bytes(SPI_BUS_SD_CHUNK_BYTES)
+                                                   : SPI_BUS_SD_CHUNK_BYTES;
+    bool ok = true;
+    while (tail != end) {
+        uint32_t offset = tail % SCAN_LOG_STAGING_BYTES;
+        size_t chunk = min((size_t)(end - tail), max_chunk);
+        chunk = min(chunk, (size_t)(SCAN_LOG_STAGING_BYTES - offset));
+        size_t written = 0;
+        if (storage_lock(medium)) {
+            written = file.write(staging + offset, chunk);
+            storage_unlock(medium);
+        }
+        if (written != chunk) {
+            // A short write leaves a torn sector; the next flush pads past it
+            LOGW(SYSTEM, "⚠️  Scan log write failed - %lu B kept staged", end - tail);
+            ok = false;
+            break;
+        }
+        portENTER_CRITICAL(&log_mux);
+        tail += chunk;
+        stats.bytes_written += chunk;
+        portEXIT_CRITICAL(&log_mux);
+    }
+
+    bool locked = storage_lock(medium);     // A card pulled meanwhile is closed without its bus
+    file.close();
+    if (locked) {
+        storage_unlock(medium);
+    }
+    if (ok) {
+        portENTER_CRITICAL(&log_mux);
+        stats.flushes++;
+        portEXIT_CRITICAL(&log_mux);
+    }
+    return ok;
+}
+
+/**
+ * @brief Bring a file torn by a power loss back to a sector boundary
+ *
+ * The caller holds the file's medium.
+ */
+static bool pad_file(File& file) {
+    uint32_t partial = file.size() % SCAN_LOG_SECTOR_BYTES;
+    if (partial == 0) {
+        return true;
+    }
+    uint8_t pad[SCAN_LOG_SECTOR_BYTES];
+    size_t length = SCAN_LOG_SECTOR_BYTES - partial;
+    memset(pad, PAD_BYTE, length);
+    return file.write(pad, length) == length;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file sensor_data_codec.cpp
+ * @brief Packed, CBOR and JSON encodings of sensor_data_t
+ *
+ * The packed form is the struct itself: its layout is fixed by
+ * SENSOR_DATA_VERSION and the size checks in ai_states.h, and every
+ * consumer so far (ESP32-S3 and x86 hosts) is little-endian. A record is
+ * rejected on decode unless it carries the current version.
+ *
+ * The CBOR and JSON forms are expanded from SENSOR_DATA_FIELDS, so a field
+ * added there reaches both, and the size check below fails until it is.
+ * CBOR keys are the field ids: a typical cycle encodes in 60 to 80 bytes
+ * against some 650 for JSON, and stays readable across versions.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ai_states.h"
+#include "cbor.h"
+#include "sensor_data_codec.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "sensor_data_t wire format assumes a little-endian target"
+#endif
+
+// Capacity for every field of sensor_data_t as a JSON member
+#define SENSOR_DATA_JSON_CAPACITY JSON_OBJECT_SIZE(SENSOR_DATA_FIELD_COUNT)
+
+// Bytes outside the field list
+#define SENSOR_DATA_RESERVED_BYTES sizeof(sensor_data_t::reserved)
+
+#define FIELD_BYTES(id, name) + sizeof(sensor_data_t::name)
+static_assert(0 SENSOR_DATA_FIELDS(FIELD_BYTES) == sizeof(sensor_data_t) - SENSOR_DATA_RESERVED_BYTES,
+              "a sensor_data_t field is missing from SENSOR_DATA_FIELDS");
+#undef FIELD_BYTES
+
+/**
+ * @brief Binary encoding for logs, the web API and peers
+ */
+size_t sensor_data_serialize(const sensor_data_t* data, uint8_t* out, size_t capacity) {
+    if (data == NULL || out == NULL || capacity < SENSOR_DATA_WIRE_BYTES) {
+        return 0;
+    }
+    memcpy(out, data, SENSOR_DATA_WIRE_BYTES);
+    out[offsetof(sensor_data_t, version)] = SENSOR_DATA_VERSION;
+    return SENSOR_DATA_WIRE_BYTES;
+}
+
+/**
+ * @brief Decode a record written by sensor_data_serialize()
+ */
+bool sensor_data_deserialize(const uint8_t* in, size_t length, sensor_data_t* data) {
+    if (in == NULL || data == NULL || length != SENSOR_DATA_WIRE_BYTES ||
+        in[offsetof(sensor_data_t, version)] != SENSOR_DATA_VERSION) {
+        return false;
+    }
+    memcpy(data, in, SENSOR_DATA_WIRE_BYTES);
+    return true;
+}
+
+/**
+ * @brief CBOR encoding: a map from field id to value
+ */
+size_t sensor_data_to_cbor(const sensor_data_t* data, uint8_t* out, size_t capacity) {
+    if (data == NULL || out == NULL) {
+        return 0;
+    }
+
+    cbor_writer_t writer;
+    cbor_writer_init(&writer, out, capacity);
+    cbor_put_map(&writer, SENSOR_DATA_FIELD_COUNT);
+    // Field 0 is the version, stamped as sensor_data_serialize() does
+#define PUT_FIELD(id, name)                                                          \
+    cbor_put_int(&writer, id);                                                       \
+    cbor_put_int(&writer, (id) == 0 ? SENSOR_DATA_VERSION : (int64_t)data->name);
+    SENSOR_DATA_FIELDS(PUT_FIELD)
+#undef PUT_FIELD
+    return writer.overflowed ? 0 : writer.length;
+}
+
+/**
+ * @brief Decode a record written by sensor_data_to_cbor() of any version
+ */
+bool sensor_data_from_cbor(const uint8_t* in, size_t length, sensor_data_t* data) {
+    if (in == NULL || data == NULL) {
+        return false;
+    }
+
+    cbor_reader_t reader;
+    cbor_reader_init(&reader, in, length);
+    uint32_t pairs;
+    if (!cbor_get_map(&reader, &pairs)) {
+        return false;
+    }
+    memset(data, 0, sizeof(*data));
+    for (uint32_t i = 0; i < pairs; i++) {
+        int64_t id;
+        int64_t value;
+        if (!cbor_get_int(&reader, &id)) {
+            return false;
+        }
+        // A duplicate id in SENSOR_DATA_FIELDS fails to compile here
+        switch (id) {
+#define GET_FIELD(field_id, name)                                           \
+            case field_id:                                                  \
+                if (!cbor_get_int(&reader, &value)) {                       \
+                    return false;                                           \
+                }                                                           \
+                data->name = (decltype(data->name))value;                   \
+                break;
+            SENSOR_DATA_FIELDS(GET_FIELD)
+#undef GET_FIELD
+            default:
+                if (!cbor_skip(&reader)) {
+                    return false;
+                }
+                break;
+        }
+    }
+    data->version = SENSOR_DATA_VERSION;
+    return true;
+}
+
+/**
+ * @brief JSON encoding with one key per field
+ */
+size_t sensor_data_to_json(const sensor_data_t* data, char* out, size_t capacity) {
+    if (data == NULL || out == NULL || capacity == 0) {
+        return 0;
+    }
+
+    StaticJsonDocument<SENSOR_DATA_JSON_CAPACITY> doc;
+#define JSON_FIELD(id, name) doc[#name] = data->name;
+    SENSOR_DATA_FIELDS(JSON_FIELD)
+#undef JSON_FIELD
+
+    if (doc.overflowed() || measureJson(doc) >= capacity) {
+        return 0;
+    }
+    return serializeJson(doc, out, capacity);
+}
@@ -0,0 +1,84 @@
+/**
+ * @file sensor_snapshot.cpp
+ * @brief Sensor data view over the scan, system, capture and I2C bus topics
+ *
+ * Readers see one sensor_data_t as before, but each producer task
+ * publishes its own fields on its own topic, so no writer ever waits for
+ * another and every read is lock-free.
+ */
+
+#include <Arduino.h>
+#include <stddef.h>
+#include "data_bus.h"
+#include "sensor_snapshot.h"
+
+/**
+ * @brief Copy the latest sensor data without blocking
+ */
+uint32_t sensor_snapshot_read(sensor_data_t* data) {
+    uint32_t version = data_bus_read(BUS_TOPIC_SCAN, data, offsetof(sensor_snapshot_t, data),
+                                     sizeof(sensor_data_t));
+    sensor_snapshot_overlay(data);
+    data->version = SENSOR_DATA_VERSION;
+    return version;
+}
+
+/**
+ * @brief Replace the system, capture and I2C fields with their latest publications
+ */
+void sensor_snapshot_overlay(sensor_data_t* data) {
+    system_publication_t system;
+    data_bus_read(BUS_TOPIC_SYSTEM, &system, 0, sizeof(system));
+    data->free_memory = system.free_memory;
+    data->uptime_seconds = system.uptime_seconds;
+    data->sd_card_present = system.sd_card_present;
+    data->ambient_level = system.ambient_level;
+
+    capture_publication_t capture;
+    data_bus_read(BUS_TOPIC_CAPTURE, &capture, 0, sizeof(capture));
+    data->capture_frames_per_second = capture.capture_frames_per_second;
+    data->probe_requests = capture.probe_requests;
+    data->wifi_clients_count = capture.wifi_clients_count;
+    data->randomized_clients = capture.randomized_clients;
+    data->busiest_bssid_fps = capture.busiest_bssid_fps;
+    data->busiest_channel_fps = capture.busiest_channel_fps;
+    data->hop_channel = capture.hop_channel;
+    data->busiest_channel = capture.busiest_channel;
+    data->airtime_permille = capture.airtime_permille;
+    data->busiest_airtime_permille = capture.busiest_airtime_permille;
+    data->busiest_airtime_channel = capture.busiest_airtime_channel;
+    data->associations_per_min = capture.associations_per_min;
+    data->handshakes_per_min = capture.handshakes_per_min;
+
+    i2c_publication_t i2c;
+    data_bus_read(BUS_TOPIC_I2C, &i2c, 0, sizeof(i2c));
+    data->battery_pct = i2c.battery_pct;
+    data->temperature_c10 = i2c.temperature_c10;
+    data->humidity_permille = i2c.humidity_permille;
+    data->light_lux = i2c.light_lux;
+    data->motion_mg = i2c.motion_mg;
+    data->i2c_fresh = i2c.fresh;
+}
+
+/**
+ * @brief Copy the latest RSSI histograms without blocking
+ */
+uint32_t sensor_snapshot_read_histograms(scan_histograms_t* histograms) {
+    return data_bus_read(BUS_TOPIC_SCAN, histograms, offsetof(sensor_snapshot_t, histograms),
+                         sizeof(scan_histograms_t));
+}
+
+/**
+ * @brief Copy the latest feature vector without blocking
+ */
+uint32_t sensor_snapshot_read_features(ai_feature_vector_t* features) {
+    return data_bus_read(BUS_TOPIC_SCAN, features, offsetof(sensor_snapshot_t, features),
+                         sizeof(ai_feature_vector_t));
+}
+
+/**
+ * @brief Scan cycle publication version (increments once per cycle)
+ */
+uint32_t sensor_snapshot_sequence(void) {
+    return data_bus_version(BUS_TOPIC_SCAN);
+}
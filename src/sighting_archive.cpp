@@ -0,0 +1,740 @@
+/**
+ * @file sighting_archive.cpp
+ * @brief Per-device sightings kept long term as columnar segments on the card
+ *
+ * The scan task stages one row per device seen in a cycle: time, device,
+ * RSSI and channel. A full batch, or one ARCHIVE_SEGMENT_MAX_MS old, is
+ * encoded on a job worker into TRACE_LOG_DIR/archive_NNNN.hca, one column
+ * block after another, while the scan task fills the other batch.
+ *
+ * Every row of a cycle carries the cycle's time, so the time column is
+ * mostly one-byte zero delta-of-deltas. A device that stays put repeats
+ * its RSSI, which the per-device deltas fold into runs of zeros. Rows are
+ * ordered by channel within a cycle, so the channel column is a few runs
+ * per cycle. Devices are numbered per segment through a dictionary: the
+ * device table reuses a slot once its device ages out, so slot numbers
+ * are not stable enough to store. A footer with the segment's bounds lets
+ * a query rule a segment out from its last 88 bytes and read only the
+ * columns it needs from the rest. The log manager numbers, indexes and
+ * expires the segments along with the other files in TRACE_LOG_DIR.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "sd_bench.h"
+#include "job_pool.h"
+#include "device_table.h"
+#include "log_manager.h"
+#include "sighting_archive.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+#define CHANNEL_SLOTS  16           // Channel 0 (BLE) and the 2.4 GHz channels
+#define DICT_SLOTS     (ARCHIVE_SEGMENT_ROWS * 2)
+#define ROW_BYTES_MAX  18           // Time 5, device 2, RSSI 2, channel 2, dictionary 7
+#define ENCODED_MAX    (sizeof(archive_header_t) + ARCHIVE_SEGMENT_ROWS * ROW_BYTES_MAX + sizeof(archive_footer_t))
+#define BATCH_BYTES    (ARCHIVE_SEGMENT_ROWS * sizeof(archive_row_t))
+#define RSSI_RUN       0x80         // RSSI byte with this bit: (low bits + 1) zero deltas
+#define RSSI_ESCAPE    0x00         // RSSI byte followed by the absolute value
+#define RSSI_RUN_MAX   128
+
+static_assert((ARCHIVE_SEGMENT_ROWS & (ARCHIVE_SEGMENT_ROWS - 1)) == 0, "ARCHIVE_SEGMENT_ROWS must be a power of two");
+static_assert(ARCHIVE_SEGMENT_ROWS < 16384, "device indices must fit a two-byte varint");
+static_assert(DEVICE_TABLE_CAPACITY <= ARCHIVE_SEGMENT_ROWS, "one cycle must fit a batch");
+
+// Two batches: the scan task fills one while a job worker writes the other
+static archive_row_t* batches[2] = { NULL, NULL };
+static uint16_t batch_rows[2] = { 0, 0 };
+static uint32_t batch_opened_ms[2] = { 0, 0 };
+static uint8_t filling = 0;
+static volatile bool writing = false;
+
+// Working storage of the writer and of queries, one at a time under work_lock
+static uint8_t* encoded = NULL;                 // A whole segment, or one column block read back
+static uint16_t* dict_slots = NULL;             // Dictionary index + 1 by hash, 0 if empty
+static archive_device_t* dict = NULL;
+static int8_t* last_rssi = NULL;                // Per dictionary entry
+static uint16_t* row_device = NULL;
+static uint32_t* row_time = NULL;
+static uint8_t* row_channel = NULL;
+static int8_t* row_rssi = NULL;
+static SemaphoreHandle_t work_lock = NULL;
+static StaticSemaphore_t work_lock_state;
+static uint16_t segment_list[ARCHIVE_QUERY_MAX_SEGMENTS];
+
+static archive_stats_t stats = {0};
+static portMUX_TYPE archive_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void release_buffers(void);
+static bool close_batch(void);
+static void write_job(void* payload);
+static uint32_t encode(const archive_row_t* rows, uint16_t count, archive_footer_t* footer);
+static uint16_t dictionary_index(const archive_row_t* row, uint16_t* devices);
+static void close_column(archive_footer_t* footer, archive_column_t column, const uint8_t* start, const uint8_t* end);
+static bool write_segment(uint32_t length, uint16_t* segment, char* path, size_t size);
+static uint16_t list_segments(void);
+static bool query_segment(uint16_t segment, uint32_t boot, uint32_t from_ms, uint32_t to_ms,
+                          const archive_query_t* query, archive_row_fn fn, void* context,
+                          archive_query_stats_t* out);
+static const uint8_t* read_column(File& file, const archive_footer_t* footer, archive_column_t column,
+                                  archive_query_stats_t* out);
+static bool decode_time(const uint8_t* in, uint32_t length, uint32_t rows);
+static bool decode_channel(const uint8_t* in, uint32_t length, uint32_t rows);
+static bool decode_device(const uint8_t* in, uint32_t length, uint32_t rows, uint16_t devices);
+static bool decode_rssi(const uint8_t* in, uint32_t length, uint32_t rows, uint16_t devices);
+static uint8_t* put_varint(uint8_t* out, uint32_t value);
+static const uint8_t* get_varint(const uint8_t* in, const uint8_t* end, uint32_t* value);
+
+static inline uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * @brief Allocate the staging and encoding buffers in PSRAM
+ */
+bool sighting_archive_init(void) {
+    if (batches[0] != NULL) {
+        return true;
+    }
+    batches[0] = (archive_row_t*)mem_alloc(MEM_BULK, BATCH_BYTES);
+    batches[1] = (archive_row_t*)mem_alloc(MEM_BULK, BATCH_BYTES);
+    encoded = (uint8_t*)mem_alloc(MEM_BULK, ENCODED_MAX);
+    dict_slots = (uint16_t*)mem_alloc(MEM_BULK, DICT_SLOTS * sizeof(uint16_t));
+    dict = (archive_device_t*)mem_alloc(MEM_BULK, ARCHIVE_SEGMENT_ROWS * sizeof(archive_device_t));
+    last_rssi = (int8_t*)mem_alloc(MEM_BULK, ARCHIVE_SEGMENT_ROWS);
+    row_device = (uint16_t*)mem_alloc(MEM_BULK, ARCHIVE_SEGMENT_ROWS * sizeof(uint16_t));
+    row_time = (uint32_t*)mem_alloc(MEM_BULK, ARCHIVE_SEGMENT_ROWS * sizeof(uint32_t));
+    row_channel = (uint8_t*)mem_alloc(MEM_BULK, ARCHIVE_SEGMENT_ROWS);
+    row_rssi = (int8_t*)mem_alloc(MEM_BULK, ARCHIVE_SEGMENT_ROWS);
+    if (batches[0] == NULL || batches[1] == NULL || encoded == NULL || dict_slots == NULL ||
+        dict == NULL || last_rssi == NULL || row_device == NULL || row_time == NULL ||
+        row_channel == NULL || row_rssi == NULL) {
+        release_buffers();
+        LOGE(SCAN, "❌ Sighting archive buffers allocation failed");
+        return false;
+    }
+    work_lock = xSemaphoreCreateMutexStatic(&work_lock_state);
+    LOGI(SCAN, "✅ Sighting archive: %d rows per segment", ARCHIVE_SEGMENT_ROWS);
+    return true;
+}
+
+/**
+ * @brief Stage a row for every device seen in the closing scan cycle
+ */
+void sighting_archive_record_cycle(uint16_t cycle, uint32_t now_ms) {
+    if (batches[0] == NULL) {
+        return;
+    }
+
+    // Count the cycle's rows per channel, then place them in channel order
+    uint16_t starts[CHANNEL_SLOTS] = {0};
+    uint32_t capacity = device_table_capacity();
+    uint16_t seen = 0;
+    for (uint32_t i = 0; i < capacity; i++) {
+        const device_entry_t* entry = device_table_entry_at(i);
+        if (entry != NULL && entry->last_cycle == cycle) {
+            starts[entry->channel % CHANNEL_SLOTS]++;
+            seen++;
+        }
+    }
+
+    if (seen > 0 && batch_rows[filling] + seen > ARCHIVE_SEGMENT_ROWS) {
+        close_batch();
+    }
+    if (batch_rows[filling] + seen > ARCHIVE_SEGMENT_ROWS) {
+        portENTER_CRITICAL(&archive_mux);
+        stats.rows_dropped += seen;
+        portEXIT_CRITICAL(&archive_mux);
+        return;
+    }
+
+    if (seen > 0) {
+        if (batch_rows[filling] == 0) {
+            batch_opened_ms[filling] = now_ms;
+        }
+        uint16_t position = batch_rows[filling];
+        for (uint8_t c = 0; c < CHANNEL_SLOTS; c++) {
+            uint16_t count = starts[c];
+            starts[c] = position;
+            position += count;
+        }
+        archive_row_t* rows = batches[filling];
+        for (uint32_t i = 0; i < capacity; i++) {
+            const device_entry_t* entry = device_table_entry_at(i);
+            if (entry == NULL || entry->last_cycle != cycle) {
+                continue;
+            }
+            archive_row_t* row = &rows[starts[entry->channel % CHANNEL_SLOTS]++];
+            row->time_ms = now_ms;
+            memcpy(row->mac, entry->mac, sizeof(row->mac));
+            row->kind = entry->kind;
+            row->channel = entry->channel;
+            row->rssi = entry->rssi_last;
+        }
+        batch_rows[filling] += seen;
+        portENTER_CRITICAL(&archive_mux);
+        stats.rows_staged += seen;
+        portEXIT_CRITICAL(&archive_mux);
+    }
+
+    // Write the batch once the next cycle might not fit, or once it is old
+    uint16_t rows = batch_rows[filling];
+    if (rows > 0 && (rows + device_table_count() > ARCHIVE_SEGMENT_ROWS ||
+                     now_ms - batch_opened_ms[filling] >= ARCHIVE_SEGMENT_MAX_MS)) {
+        close_batch();
+    }
+}
+
+/**
+ * @brief Hand every archived sighting matching a query to a callback, oldest segment first
+ */
+bool sighting_archive_query(const archive_query_t* query, archive_row_fn fn, void* context,
+                            archive_query_stats_t* out) {
+    memset(out, 0, sizeof(*out));
+    if (encoded == NULL || !sd_monitor_mounted()) {
+        return false;
+    }
+    uint32_t boot = query->boot != 0 ? query->boot : log_manager_boot();
+    uint32_t to_ms = query->to_ms != 0 ? query->to_ms : UINT32_MAX;
+
+    xSemaphoreTake(work_lock, portMAX_DELAY);
+    uint16_t count = list_segments();
+    for (uint16_t i = 0; i < count; i++) {
+        if (!query_segment(segment_list[i], boot, query->from_ms, to_ms, query, fn, context, out)) {
+            break;
+        }
+    }
+    xSemaphoreGive(work_lock);
+    return true;
+}
+
+/**
+ * @brief Copy the archive figures
+ */
+void sighting_archive_get_stats(archive_stats_t* out) {
+    portENTER_CRITICAL(&archive_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&archive_mux);
+}
+
+/**
+ * @brief Free whatever init managed to allocate
+ */
+static void release_buffers(void) {
+    mem_free(MEM_BULK, batches[0], BATCH_BYTES);
+    mem_free(MEM_BULK, batches[1], BATCH_BYTES);
+    mem_free(MEM_BULK, encoded, ENCODED_MAX);
+    mem_free(MEM_BULK, dict_slots, DICT_SLOTS * sizeof(uint16_t));
+    mem_free(MEM_BULK, dict, ARCHIVE_SEGMENT_ROWS * sizeof(archive_device_t));
+    mem_free(MEM_BULK, last_rssi, ARCHIVE_SEGMENT_ROWS);
+    mem_free(MEM_BULK, row_device, ARCHIVE_SEGMENT_ROWS * sizeof(uint16_t));
+    mem_free(MEM_BULK, row_time, ARCHIVE_SEGMENT_ROWS * sizeof(uint32_t));
+    mem_free(MEM_BULK, row_channel, ARCHIVE_SEGMENT_ROWS);
+    mem_free(MEM_BULK, row_rssi, ARCHIVE_SEGMENT_ROWS);
+    batches[0] = batches[1] = NULL;
+    encoded = NULL;
+    dict_slots = NULL;
+    dict = NULL;
+    last_rssi = NULL;
+    row_device = NULL;
+    row_time = NULL;
+    row_channel = NULL;
+    row_rssi = NULL;
+}
+
+/**
+ * @brief Hand the filling batch to a job worker and start on the other one
+ * @return false if the other one is still being written, or there is no card
+ */
+static bool close_batch(void) {
+    if (writing || !sd_monitor_mounted()) {
+        return false;
+    }
+    uint8_t full = filling;
+    writing = true;
+    if (!job_pool_submit(JOB_LANE_LOW, write_job, &full, sizeof(full))) {
+        writing = false;            // Retried after the next cycle
+        return false;
+    }
+    filling ^= 1;
+    batch_rows[filling] = 0;
+    return true;
+}
+
+/**
+ * @brief Encode a batch and write it as the next segment, on a job worker
+ */
+static void write_job(void* payload) {
+    uint8_t which = *(const uint8_t*)payload;
+    uint16_t count = batch_rows[which];
+    if (count == 0) {
+        writing = false;
+        return;
+    }
+
+    xSemaphoreTake(work_lock, portMAX_DELAY);
+    archive_footer_t footer;
+    uint32_t length = encode(batches[which], count, &footer);
+    uint16_t segment = 0;
+    char path[40];
+    bool ok = write_segment(length, &segment, path, sizeof(path));
+    xSemaphoreGive(work_lock);
+
+    if (ok) {
+        log_manager_note(LOG_SEGMENT_ARCHIVE, segment, 0, footer.first_ms, footer.last_ms);
+        LOGI(SCAN, "🗄️  %u sightings of %u devices archived to %s, %lu bytes (%lu%% of raw)",
+             count, footer.devices, path, length, length * 100 / (count * sizeof(archive_row_t)));
+    } else {
+        LOGW(SCAN, "⚠️  Sighting archive write failed - %u rows lost", count);
+    }
+    portENTER_CRITICAL(&archive_mux);
+    if (ok) {
+        stats.segments_written++;
+        stats.raw_bytes += count * sizeof(archive_row_t);
+        stats.encoded_bytes += length;
+    } else {
+        stats.write_failures++;
+    }
+    portEXIT_CRITICAL(&archive_mux);
+    writing = false;
+}
+
+/**
+ * @brief Lay out a whole segment file in the encoding buffer
+ * @return Its length
+ */
+static uint32_t encode(const archive_row_t* rows, uint16_t count, archive_footer_t* footer) {
+    memset(footer, 0, sizeof(*footer));
+    footer->boot = log_manager_boot();
+    footer->first_ms = rows[0].time_ms;
+    footer->last_ms = rows[count - 1].time_ms;
+    footer->rows = count;
+    footer->rssi_min = INT8_MAX;
+    footer->rssi_max = INT8_MIN;
+    footer->magic = ARCHIVE_FOOTER_MAGIC;
+
+    archive_header_t* header = (archive_header_t*)encoded;
+    memset(header, 0, sizeof(*header));
+    header->magic = ARCHIVE_MAGIC;
+    header->format = ARCHIVE_FORMAT;
+    header->column_count = ARCHIVE_COLUMN_COUNT;
+    header->boot = footer->boot;
+    uint8_t* out = encoded + sizeof(*header);
+
+    // Time, as delta-of-delta in wrapping arithmetic, so millis() rollover costs nothing
+    uint8_t* start = out;
+    uint32_t previous = 0;
+    uint32_t previous_delta = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        uint32_t delta = rows[i].time_ms - previous;
+        out = put_varint(out, zigzag((int32_t)(delta - previous_delta)));
+        previous = rows[i].time_ms;
+        previous_delta = delta;
+    }
+    close_column(footer, ARCHIVE_COLUMN_TIME, start, out);
+
+    // Device, numbering each one at its first row
+    memset(dict_slots, 0, DICT_SLOTS * sizeof(uint16_t));
+    uint16_t devices = 0;
+    start = out;
+    for (uint16_t i = 0; i < count; i++) {
+        const archive_row_t* row = &rows[i];
+        row_device[i] = dictionary_index(row, &devices);
+        out = put_varint(out, row_device[i]);
+        footer->channel_mask |= 1 << (row->channel % CHANNEL_SLOTS);
+        footer->kind_mask |= 1 << (row->kind & 7);
+        footer->rssi_min = min(footer->rssi_min, row->rssi);
+        footer->rssi_max = max(footer->rssi_max, row->rssi);
+    }
+    footer->devices = devices;
+    close_column(footer, ARCHIVE_COLUMN_DEVICE, start, out);
+
+    // RSSI, as the change since the same device's previous row
+    start = out;
+    uint8_t run = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        int8_t rssi = rows[i].rssi;
+        int32_t delta = rssi - last_rssi[row_device[i]];
+        last_rssi[row_device[i]] = rssi;
+        if (delta == 0) {
+            if (++run == RSSI_RUN_MAX) {
+                *out++ = RSSI_RUN | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            *out++ = RSSI_RUN | (run - 1);
+            run = 0;
+        }
+        uint32_t value = zigzag(delta);
+        if (value < RSSI_RUN) {
+            *out++ = (uint8_t)value;
+        } else {
+            *out++ = RSSI_ESCAPE;
+            *out++ = (uint8_t)rssi;
+        }
+    }
+    if (run > 0) {
+        *out++ = RSSI_RUN | (run - 1);
+    }
+    close_column(footer, ARCHIVE_COLUMN_RSSI, start, out);
+
+    // Channel, as (channel, run) pairs
+    start = out;
+    for (uint16_t i = 0; i < count;) {
+        uint8_t channel = rows[i].channel;
+        uint16_t length = 1;
+        while (i + length < count && rows[i + length].channel == channel && length < UINT8_MAX) {
+            length++;
+        }
+        *out++ = channel;
+        *out++ = (uint8_t)length;
+        i += length;
+    }
+    close_column(footer, ARCHIVE_COLUMN_CHANNEL, start, out);
+
+    start = out;
+    memcpy(out, dict, devices * sizeof(archive_device_t));
+    out += devices * sizeof(archive_device_t);
+    close_column(footer, ARCHIVE_COLUMN_DICTIONARY, start, out);
+
+    memcpy(out, footer, sizeof(*footer));
+    out += sizeof(*footer);
+    return out - encoded;
+}
+
+/**
+ * @brief A row's device's dictionary index, adding the device on its first row
+ */
+static uint16_t dictionary_index(const archive_row_t* row, uint16_t* devices) {
+    // FNV-1a over the MAC and kind; the table is never more than half full
+    uint32_t hash = 2166136261UL;
+    for (uint8_t i = 0; i < sizeof(row->mac); i++) {
+        hash = (hash ^ row->mac[i]) * 16777619UL;
+    }
+    hash = (hash ^ row->kind) * 16777619UL;
+
+    for (uint32_t slot = hash & (DICT_SLOTS - 1);; slot = (slot + 1) & (DICT_SLOTS - 1)) {
+        uint16_t stored = dict_slots[slot];
+        if (stored == 0) {
+            uint16_t index = (*devices)++;
+            memcpy(dict[index].mac, row->mac, sizeof(row->mac));
+            dict[index].kind = row->kind;
+            last_rssi[index] = 0;
+            dict_slots[slot] = index + 1;
+            return index;
+        }
+        const archive_device_t* device = &dict[stored - 1];
+        if (device->kind == row->kind && memcmp(device->mac, row->mac, sizeof(row->mac)) == 0) {
+            return stored - 1;
+        }
+    }
+}
+
+/**
+ * @brief Record where a column block ended up in the footer's directory
+ */
+static void close_column(archive_footer_t* footer, archive_column_t column, const uint8_t* start, const uint8_t* end) {
+    archive_column_ref_t* ref = &footer->columns[column];
+    ref->offset = start - encoded;
+    ref->length = end - start;
+    ref->crc32 = esp_rom_crc32_le(0, start, ref->length);
+}
+
+/**
+ * @brief Write the encoded segment to the next archive file
+ */
+static bool write_segment(uint32_t length, uint16_t* segment, char* path, size_t size) {
+    if (!sd_monitor_mounted()) {
+        return false;
+    }
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file;
+    if (SD.exists(TRACE_LOG_DIR) || SD.mkdir(TRACE_LOG_DIR)) {
+        *segment = log_manager_next_segment(LOG_SEGMENT_ARCHIVE);
+        log_manager_segment_path(LOG_SEGMENT_ARCHIVE, *segment, path, size);
+        file = SD.open(path, "w");
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!file) {
+        return false;
+    }
+    log_manager_opened(LOG_SEGMENT_ARCHIVE, *segment);
+
+    bool ok = true;
+    uint32_t max_chunk = sd_bench_block_bytes(ARCHIVE_WRITE_CHUNK);
+    for (uint32_t done = 0; done < length && ok; done += max_chunk) {
+        size_t chunk = min(length - done, max_chunk);
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        ok = file.write(encoded + done, chunk) == chunk;
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    file.close();
+    if (!ok) {
+        SD.remove(path);            // A segment without its footer is unreadable anyway
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    return ok;
+}
+
+/**
+ * @brief Numbers of the archive segments on the card, oldest first
+ */
+static uint16_t list_segments(void) {
+    uint16_t count = 0;
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File dir = SD.open(TRACE_LOG_DIR);
+    if (dir && dir.isDirectory()) {
+        for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+            // Named by log_manager_segment_path(): archive_NNNN.hca
+            const char* slash = strrchr(file.name(), '/');
+            const char* base = slash != NULL ? slash + 1 : file.name();
+            unsigned number;
+            char suffix[8];
+            if (count < ARCHIVE_QUERY_MAX_SEGMENTS &&
+                sscanf(base, "archive_%4u%7s", &number, suffix) == 2 && strcmp(suffix, ".hca") == 0) {
+                segment_list[count++] = (uint16_t)number;
+            }
+            file.close();
+        }
+    }
+    if (dir) {
+        dir.close();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+
+    for (uint16_t i = 1; i < count; i++) {
+        uint16_t number = segment_list[i];
+        uint16_t j = i;
+        for (; j > 0 && segment_list[j - 1] > number; j--) {
+            segment_list[j] = segment_list[j - 1];
+        }
+        segment_list[j] = number;
+    }
+    return count;
+}
+
+/**
+ * @brief Run a query over one segment
+ * @return false if the callback asked to stop
+ */
+static bool query_segment(uint16_t segment, uint32_t boot, uint32_t from_ms, uint32_t to_ms,
+                          const archive_query_t* query, archive_row_fn fn, void* context,
+                          archive_query_stats_t* out) {
+    char path[40];
+    log_manager_segment_path(LOG_SEGMENT_ARCHIVE, segment, path, sizeof(path));
+    archive_footer_t footer;
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    File file = SD.open(path, "r");
+    bool ok = file && file.size() >= sizeof(archive_header_t) + sizeof(footer) &&
+              file.seek(file.size() - sizeof(footer)) &&
+              file.read((uint8_t*)&footer, sizeof(footer)) == sizeof(footer);
+    spi_bus_release(SPI_DEVICE_SD);
+    if (ok) {
+        out->segments++;
+        out->bytes_read += sizeof(footer);
+    }
+
+    // Predicate pushdown: the footer alone rules most segments out
+    ok = ok && footer.magic == ARCHIVE_FOOTER_MAGIC && footer.rows > 0 &&
+         footer.rows <= ARCHIVE_SEGMENT_ROWS && footer.devices <= footer.rows &&
+         footer.boot == boot && footer.last_ms >= from_ms && footer.first_ms <= to_ms &&
+         (query->channel_mask == 0 || (footer.channel_mask & query->channel_mask) != 0) &&
+         (query->kind_mask == 0 || (footer.kind_mask & query->kind_mask) != 0);
+
+    // Time and channel decide which rows match; the other columns only if any do
+    bool intact = true;
+    uint32_t matches = 0;
+    if (ok) {
+        const uint8_t* block = read_column(file, &footer, ARCHIVE_COLUMN_TIME, out);
+        intact = block != NULL && decode_time(block, footer.columns[ARCHIVE_COLUMN_TIME].length, footer.rows);
+    }
+    if (ok && intact) {
+        const uint8_t* block = read_column(file, &footer, ARCHIVE_COLUMN_CHANNEL, out);
+        intact = block != NULL && decode_channel(block, footer.columns[ARCHIVE_COLUMN_CHANNEL].length, footer.rows);
+    }
+    for (uint32_t r = 0; ok && intact && r < footer.rows; r++) {
+        if (row_time[r] >= from_ms && row_time[r] <= to_ms &&
+            (query->channel_mask == 0 || (query->channel_mask & (1 << (row_channel[r] % CHANNEL_SLOTS))) != 0)) {
+            matches++;
+        }
+    }
+    ok = ok && intact && matches > 0;
+    if (ok) {
+        const uint8_t* block = read_column(file, &footer, ARCHIVE_COLUMN_DICTIONARY, out);
+        intact = block != NULL &&
+                 footer.columns[ARCHIVE_COLUMN_DICTIONARY].length == footer.devices * sizeof(archive_device_t);
+        if (intact) {
+            memcpy(dict, block, footer.devices * sizeof(archive_device_t));
+        }
+    }
+    if (ok && intact) {
+        const uint8_t* block = read_column(file, &footer, ARCHIVE_COLUMN_DEVICE, out);
+        intact = block != NULL &&
+                 decode_device(block, footer.columns[ARCHIVE_COLUMN_DEVICE].length, footer.rows, footer.devices);
+    }
+    if (ok && intact) {
+        const uint8_t* block = read_column(file, &footer, ARCHIVE_COLUMN_RSSI, out);
+        intact = block != NULL &&
+                 decode_rssi(block, footer.columns[ARCHIVE_COLUMN_RSSI].length, footer.rows, footer.devices);
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (file) {
+        file.close();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!intact) {
+        LOGW(SCAN, "⚠️  %s is corrupt - skipped", path);
+    }
+    if (!ok || !intact) {
+        return true;
+    }
+
+    out->segments_read++;
+    for (uint32_t r = 0; r < footer.rows; r++) {
+        const archive_device_t* device = &dict[row_device[r]];
+        if (row_time[r] < from_ms || row_time[r] > to_ms ||
+            (query->channel_mask != 0 && (query->channel_mask & (1 << (row_channel[r] % CHANNEL_SLOTS))) == 0) ||
+            (query->kind_mask != 0 && (query->kind_mask & (1 << (device->kind & 7))) == 0)) {
+            continue;
+        }
+        archive_row_t row;
+        row.time_ms = row_time[r];
+        memcpy(row.mac, device->mac, sizeof(row.mac));
+        row.kind = device->kind;
+        row.channel = row_channel[r];
+        row.rssi = row_rssi[r];
+        out->rows++;
+        if (!fn(&row, context)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Read one column block into the working buffer and check its CRC
+ * @return The block, or NULL
+ */
+static const uint8_t* read_column(File& file, const archive_footer_t* footer, archive_column_t column,
+                                  archive_query_stats_t* out) {
+    const archive_column_ref_t* ref = &footer->columns[column];
+    if (ref->length > ENCODED_MAX) {
+        return NULL;
+    }
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    bool ok = file.seek(ref->offset) && file.read(encoded, ref->length) == ref->length;
+    spi_bus_release(SPI_DEVICE_SD);
+    if (!ok || esp_rom_crc32_le(0, encoded, ref->length) != ref->crc32) {
+        return NULL;
+    }
+    out->bytes_read += ref->length;
+    return encoded;
+}
+
+static bool decode_time(const uint8_t* in, uint32_t length, uint32_t rows) {
+    const uint8_t* end = in + length;
+    uint32_t previous = 0;
+    uint32_t previous_delta = 0;
+    for (uint32_t r = 0; r < rows; r++) {
+        uint32_t value;
+        in = get_varint(in, end, &value);
+        if (in == NULL) {
+            return false;
+        }
+        previous_delta += (uint32_t)unzigzag(value);
+        previous += previous_delta;
+        row_time[r] = previous;
+    }
+    return in == end;
+}
+
+static bool decode_channel(const uint8_t* in, uint32_t length, uint32_t rows) {
+    uint32_t r = 0;
+    for (uint32_t i = 0; i + 1 < length; i += 2) {
+        uint8_t run = in[i + 1];
+        if (run == 0 || r + run > rows) {
+            return false;
+        }
+        memset(row_channel + r, in[i], run);
+        r += run;
+    }
+    return r == rows && length % 2 == 0;
+}
+
+static bool decode_device(const uint8_t* in, uint32_t length, uint32_t rows, uint16_t devices) {
+    const uint8_t* end = in + length;
+    for (uint32_t r = 0; r < rows; r++) {
+        uint32_t value;
+        in = get_varint(in, end, &value);
+        if (in == NULL || value >= devices) {
+            return false;
+        }
+        row_device[r] = (uint16_t)value;
+    }
+    return in == end;
+}
+
+static bool decode_rssi(const uint8_t* in, uint32_t length, uint32_t rows, uint16_t devices) {
+    memset(last_rssi, 0, devices);
+    const uint8_t* end = in + length;
+    uint32_t r = 0;
+    while (in < end && r < rows) {
+        uint8_t byte = *in++;
+        if (byte & RSSI_RUN) {
+            for (uint8_t zero = 0; zero <= (byte & ~RSSI_RUN) && r < rows; zero++, r++) {
+                row_rssi[r] = last_rssi[row_device[r]];
+            }
+            continue;
+        }
+        int8_t rssi;
+        if (byte == RSSI_ESCAPE) {
+            if (in == end) {
+                return false;
+            }
+            rssi = (int8_t)*in++;
+        } else {
+            rssi = (int8_t)(last_rssi[row_device[r]] + unzigzag(byte));
+        }
+        last_rssi[row_device[r]] = rssi;
+        row_rssi[r++] = rssi;
+    }
+    return r == rows && in == end;
+}
+
+static uint8_t* put_varint(uint8_t* out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static const uint8_t* get_varint(const uint8_t* in, const uint8_t* end, uint32_t* value) {
+    uint32_t result = 0;
+    for (uint8_t shift = 0; in < end && shift < 35; shift += 7) {
+        uint8_t byte = *in++;
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return in;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,254 @@
+/**
+ * @file site_thresholds.cpp
+ * @brief Per-site activity thresholds from streaming quantiles
+ *
+ * "High WiFi activity" and "strong BLE signal" mean different things in an
+ * office tower and on a farm. Each is tracked as a running quantile of what
+ * this unit actually sees, with the P² algorithm (Jain & Chlamtac): five
+ * markers per quantile, constant memory and O(1) per observation. Until
+ * enough cycles are seen, and whenever the result would leave the sane
+ * range, the compile-time thresholds apply. The estimators are saved to
+ * the journal, or to NVS on a unit without a journal partition.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "config.h"
+#include "journal.h"
+#include "site_thresholds.h"
+#include "logger.h"
+
+#define SITE_STATE_MAGIC    0x53495445  // "SITE"
+#define SITE_STATE_VERSION  1
+#define SITE_JOURNAL_KEY    "site"
+
+/**
+ * @brief Persisted estimator state
+ */
+typedef struct {
+    uint32_t      magic;
+    uint16_t      version;
+    uint16_t      reserved;
+    p2_quantile_t wifi_count;
+    p2_quantile_t ble_rssi;
+} site_state_t;
+
+static site_state_t state;
+static uint32_t last_save_ms = 0;
+static bool dirty = false;
+
+// Forward declarations
+static void p2_init(p2_quantile_t* est, float quantile);
+static void p2_add(p2_quantile_t* est, float x);
+static float p2_value(const p2_quantile_t* est);
+static void reset_state(void);
+static bool load_state(site_state_t* stored);
+
+/**
+ * @brief Restore the learned estimators from the journal, else NVS
+ */
+void site_thresholds_init(void) {
+    reset_state();
+
+    site_state_t stored;
+    if (load_state(&stored) && stored.magic == SITE_STATE_MAGIC && stored.version == SITE_STATE_VERSION &&
+        stored.wifi_count.quantile == SITE_WIFI_HIGH_QUANTILE &&
+        stored.ble_rssi.quantile == SITE_BLE_STRONG_QUANTILE) {
+        state = stored;
+        LOGI(AI, "✅ Site thresholds restored from %lu cycles", state.wifi_count.count);
+    }
+}
+
+/**
+ * @brief Learn from one published scan cycle
+ */
+void site_thresholds_observe(const sensor_data_t* data) {
+    p2_add(&state.wifi_count, data->wifi_networks_count);
+
+    // The average signal means nothing with no devices in view
+    if (data->ble_devices_count > 0) {
+        p2_add(&state.ble_rssi, data->ble_signal_strength);
+    }
+    dirty = true;
+}
+
+/**
+ * @brief Thresholds to use now (config.h defaults until SITE_LEARN_CYCLES are seen)
+ */
+void site_thresholds_get(site_thresholds_t* out) {
+    uint32_t samples = state.wifi_count.count;
+    out->samples = samples;
+    out->progress_pct = (uint8_t)min(samples * 100UL / SITE_LEARN_CYCLES, 100UL);
+    out->learned = samples >= SITE_LEARN_CYCLES;
+    out->wifi_high = HIGH_WIFI_ACTIVITY_THRESHOLD;
+    out->ble_strong = STRONG_BLE_SIGNAL_THRESHOLD;
+
+    if (out->learned) {
+        out->wifi_high = constrain(p2_value(&state.wifi_count),
+                                   (float)SITE_WIFI_HIGH_MIN, (float)SITE_WIFI_HIGH_MAX);
+        if (state.ble_rssi.count >= SITE_LEARN_CYCLES / 4) {
+            out->ble_strong = constrain(p2_value(&state.ble_rssi),
+                                        (float)SITE_BLE_STRONG_MIN, (float)SITE_BLE_STRONG_MAX);
+        }
+    }
+}
+
+/**
+ * @brief Persist the estimators every SITE_SAVE_INTERVAL_MS
+ */
+void site_thresholds_tick(uint32_t now_ms) {
+    if (!dirty || now_ms - last_save_ms < SITE_SAVE_INTERVAL_MS) {
+        return;
+    }
+
+    if (journal_put(SITE_JOURNAL_KEY, &state, sizeof(state))) {
+        dirty = false;
+    } else {
+        Preferences prefs;
+        if (prefs.begin(SITE_NVS_NAMESPACE, false)) {
+            prefs.putBytes("state", &state, sizeof(state));
+            prefs.end();
+            dirty = false;
+        }
+    }
+    last_save_ms = now_ms;
+}
+
+/**
+ * @brief Forget this site, e.g. after the unit has been moved
+ */
+void site_thresholds_reset(void) {
+    reset_state();
+
+    journal_erase(SITE_JOURNAL_KEY);
+    Preferences prefs;
+    if (prefs.begin(SITE_NVS_NAMESPACE, false)) {
+        prefs.clear();
+        prefs.end();
+    }
+    LOGI(AI, "🔄 Site thresholds reset");
+}
+
+/**
+ * @brief Read the saved estimators: the journal's, else those an older firmware left in NVS
+ */
+static bool load_state(site_state_t* stored) {
+    if (journal_get(SITE_JOURNAL_KEY, stored, sizeof(*stored)) == sizeof(*stored)) {
+        return true;
+    }
+    Preferences prefs;
+    if (!prefs.begin(SITE_NVS_NAMESPACE, true)) {
+        return false;
+    }
+    bool ok = prefs.getBytes("state", stored, sizeof(*stored)) == sizeof(*stored);
+    prefs.end();
+    return ok;
+}
+
+/**
+ * @brief Start both estimators from scratch
+ */
+static void reset_state(void) {
+    memset(&state, 0, sizeof(state));
+    state.magic = SITE_STATE_MAGIC;
+    state.version = SITE_STATE_VERSION;
+    p2_init(&state.wifi_count, SITE_WIFI_HIGH_QUANTILE);
+    p2_init(&state.ble_rssi, SITE_BLE_STRONG_QUANTILE);
+    dirty = false;
+}
+
+/**
+ * @brief Empty P² estimator for one quantile
+ */
+static void p2_init(p2_quantile_t* est, float quantile) {
+    memset(est, 0, sizeof(*est));
+    est->quantile = quantile;
+}
+
+/**
+ * @brief Fold one observation into a P² estimator
+ */
+static void p2_add(p2_quantile_t* est, float x) {
+    float* q = est->height;
+    int32_t* n = est->position;
+    float p = est->quantile;
+
+    // The first five observations become the markers, kept sorted
+    if (est->count < 5) {
+        uint32_t i = est->count;
+        while (i > 0 && q[i - 1] > x) {
+            q[i] = q[i - 1];
+            i--;
+        }
+        q[i] = x;
+        est->count++;
+        if (est->count == 5) {
+            for (uint8_t k = 0; k < 5; k++) {
+                n[k] = k;
+            }
+            est->desired[0] = 0.0f;
+            est->desired[1] = 2.0f * p;
+            est->desired[2] = 4.0f * p;
+            est->desired[3] = 2.0f + 2.0f * p;
+            est->desired[4] = 4.0f;
+        }
+        return;
+    }
+
+    // Cell the observation falls into, stretching the extremes if needed
+    uint8_t k;
+    if (x < q[0]) {
+        q[0] = x;
+        k = 0;
+    } else if (x >= q[4]) {
+        q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= q[k + 1]) {
+            k++;
+        }
+    }
+
+    for (uint8_t i = k + 1; i < 5; i++) {
+        n[i]++;
+    }
+    const float increment[5] = { 0.0f, p / 2.0f, p, (1.0f + p) / 2.0f, 1.0f };
+    for (uint8_t i = 0; i < 5; i++) {
+        est->desired[i] += increment[i];
+    }
+
+    // Move the middle markers towards their desired positions
+    for (uint8_t i = 1; i < 4; i++) {
+        float d = est->desired[i] - n[i];
+        if ((d >= 1.0f && n[i + 1] - n[i] > 1) || (d <= -1.0f && n[i - 1] - n[i] < -1)) {
+            int32_t s = d >= 0.0f ? 1 : -1;
+
+            // Piecewise-parabolic prediction, linear if it would break ordering
+            float parabolic = q[i] + (float)s / (n[i + 1] - n[i - 1]) *
+                ((n[i] - n[i - 1] + s) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                 (n[i + 1] - n[i] - s) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+            if (q[i - 1] < parabolic && parabolic < q[i + 1]) {
+                q[i] = parabolic;
+            } else {
+                q[i] += s * (q[i + s] - q[i]) / (n[i + s] - n[i]);
+            }
+            n[i] += s;
+        }
+    }
+    est->count++;
+}
+
+/**
+ * @brief Current quantile estimate (nearest rank while fewer than five observations)
+ */
+static float p2_value(const p2_quantile_t* est) {
+    if (est->count == 0) {
+        return 0.0f;
+    }
+    if (est->count < 5) {
+        uint32_t rank = (uint32_t)(est->quantile * (est->count - 1) + 0.5f);
+        return est->height[rank];
+    }
+    return est->height[2];
+}
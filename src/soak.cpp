@@ -0,0 +1,391 @@
+/**
+ * @file soak.cpp
+ * @brief Synthetic workload and regression gates of the env:soak firmware
+ *
+ * Slow leaks and fragmentation only show after days of the real mix of
+ * work, so a soak run keeps every task busy as in the field without the
+ * field: scan cycles are replayed from a recorded trace (or generated)
+ * and their counts set the load of the synthetic scan source, which
+ * feeds the scan task in place of the radios, so the device table,
+ * novelty filter, archive, logs and rule engine see churn; the UI walks
+ * the scene ring on a script; tools/soak/soak_run.py adds API load from
+ * a host. The gates are judged on the unit from its own metrics history.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include "config.h"
+#include "metrics_history.h"
+#include "loop_timing.h"
+#include "renderer.h"
+#include "ui_screens.h"
+#include "ui_events.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "scan_synth.h"
+#include "trace_log.h"
+#include "soak.h"
+#include "logger.h"
+
+#if SOAK_ENABLED
+
+#define SOAK_READ_RECORDS  16       // Trace records read per bus hold
+#define SOAK_PAGE_POINTS   64       // History points read per page for a fit
+#define MS_PER_HOUR        3600000.0
+
+/**
+ * @brief Running sums of a least-squares line through (hours, value) points
+ */
+typedef struct {
+    double n;
+    double x;
+    double y;
+    double xy;
+    double xx;
+} fit_t;
+
+// Trace replay, scan task only
+static File trace_file;
+static bool trace_opened = false;           // Tried on this card, whatever came of it
+static trace_record_t records[SOAK_READ_RECORDS];
+static uint8_t record_count = 0;
+static uint8_t record_next = 0;
+static uint32_t synthetic_cycle = 0;
+
+// Gate baseline, system task only
+static uint32_t warm_ms = 0;                // End of warm-up, 0 before
+static uint32_t warm_misses = 0;
+static uint32_t warm_exec_us[LOOP_COUNT];
+static uint32_t last_check_ms = 0;
+static uint32_t last_step_ms = 0;
+
+static soak_status_t status = {0};
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+
+const scan_source_t soak_scan_source = {
+    "soak",
+    scan_synth_init,
+    soak_sweep,
+    scan_synth_wifi_results,
+    scan_synth_wifi_release,
+    scan_synth_ble_sightings,
+    scan_synth_ble_expire,
+    scan_synth_ble_summary,
+    soak_interval_ms
+};
+
+// Forward declarations
+static void soak_sweep(const scan_profile_t* profile);
+static uint32_t soak_interval_ms(uint32_t planned_ms);
+static bool read_trace(trace_record_t* record);
+static bool refill(void);
+static void generate(trace_record_t* record);
+static void check_gates(uint32_t now_ms);
+static double fit_slope(metric_id_t metric, bool floor);
+static uint32_t total_misses(void);
+
+/**
+ * @brief Set the generator's load from the next recorded cycle, then run it
+ */
+static void soak_sweep(const scan_profile_t* profile) {
+    trace_record_t record;
+    bool from_trace = read_trace(&record);
+    if (!from_trace) {
+        generate(&record);
+    }
+
+    // The recorded arrivals are the churn, as a share of everything heard
+    const sensor_data_t* data = &record.data;
+    uint32_t heard = data->wifi_networks_count + data->ble_devices_count;
+    scan_synth_load_t load;
+    scan_synth_get_load(&load);
+    load.aps = data->wifi_networks_count;
+    load.ble_devices = data->ble_devices_count;
+    load.churn_permille = heard > 0 ? (uint16_t)min(data->devices_appeared * 1000UL / heard, 1000UL) : 0;
+    load.wifi_rssi_dbm = (int8_t)constrain(data->wifi_signal_strength, -100, -20);
+    load.ble_rssi_dbm = (int8_t)constrain(data->ble_signal_strength, -100, -20);
+    load.speedup = 1;
+    scan_synth_set_load(&load);
+    scan_synth_sweep(profile);
+
+    portENTER_CRITICAL(&status_mux);
+    status.cycles++;
+    status.from_trace = from_trace;
+    portEXIT_CRITICAL(&status_mux);
+}
+
+/**
+ * @brief SOAK_CYCLE_MS, whatever the plan
+ */
+static uint32_t soak_interval_ms(uint32_t planned_ms) {
+    return scan_synth_interval_ms(SOAK_CYCLE_MS);
+}
+
+/**
+ * @brief Show the next scene in the ring; UI task only, on UI_EVENT_SOAK
+ */
+void soak_ui_step(void) {
+    const renderer_scene_t* current = renderer_current_scene();
+    uint8_t count = ui_screens_count();
+    uint8_t index = 0;
+    while (index < count && ui_screens_scene(index) != current) {
+        index++;
+    }
+    const renderer_scene_t* next = ui_screens_scene((index + 1) % count);
+    if (next != NULL) {
+        renderer_show(next);
+    }
+
+    portENTER_CRITICAL(&status_mux);
+    status.ui_steps++;
+    portEXIT_CRITICAL(&status_mux);
+}
+
+/**
+ * @brief Script the UI and judge the gates; call from the system task
+ */
+void soak_tick(uint32_t now_ms) {
+    if (now_ms - last_step_ms >= SOAK_UI_STEP_MS) {
+        ui_notify(UI_EVENT_SOAK | UI_EVENT_WAKE);
+        last_step_ms = now_ms;
+    }
+
+    if (warm_ms == 0) {
+        if (now_ms < SOAK_WARMUP_MS) {
+            return;
+        }
+        // Pools, caches and the device table have filled: this is the baseline
+        warm_ms = now_ms;
+        warm_misses = total_misses();
+        for (uint8_t loop = 0; loop < LOOP_COUNT; loop++) {
+            loop_timing_stats_t stats;
+            loop_timing_get((loop_id_t)loop, &stats);
+            warm_exec_us[loop] = stats.avg_exec_us;
+        }
+        last_check_ms = now_ms;
+        LOGI(SYSTEM, "🧪 Soak warm-up over, gates judged from now");
+        return;
+    }
+
+    if (now_ms - last_check_ms >= SOAK_CHECK_INTERVAL_MS) {
+        check_gates(now_ms);
+        last_check_ms = now_ms;
+    }
+}
+
+/**
+ * @brief Copy the progress and the latest verdict
+ */
+void soak_get_status(soak_status_t* out) {
+    portENTER_CRITICAL(&status_mux);
+    *out = status;
+    portEXIT_CRITICAL(&status_mux);
+    out->elapsed_ms = millis();
+}
+
+/**
+ * @brief Short name of a gate for logs and the report
+ */
+const char* soak_gate_name(soak_gate_t gate) {
+    switch (gate) {
+        case SOAK_GATE_HEAP_DRIFT:  return "heap_drift";
+        case SOAK_GATE_FRAG_GROWTH: return "frag_growth";
+        case SOAK_GATE_DEADLINES:   return "deadlines";
+        case SOAK_GATE_LOOP_CREEP:  return "loop_creep";
+        default:                    return "unknown";
+    }
+}
+
+/**
+ * @brief Next record of SOAK_TRACE_FILE, wrapping at its end
+ * @return false without a card or a readable trace
+ */
+static bool read_trace(trace_record_t* record) {
+    if (record_next >= record_count && !refill()) {
+        return false;
+    }
+    *record = records[record_next++];
+    return true;
+}
+
+/**
+ * @brief Read the next SOAK_READ_RECORDS records of the current sensor_data_t version
+ */
+static bool refill(void) {
+    record_count = 0;
+    record_next = 0;
+    if (!sd_monitor_mounted()) {
+        if (trace_file) {
+            trace_file.close();
+        }
+        trace_opened = false;               // A new card gets a new look
+        return false;
+    }
+    if (!trace_file && trace_opened) {
+        return false;
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (!trace_opened) {
+        trace_opened = true;
+        trace_file = SD.open(SOAK_TRACE_FILE, "r");
+        trace_file_header_t header;
+        if (trace_file && (trace_file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+                           header.magic != TRACE_FILE_MAGIC ||
+                           header.record_bytes != sizeof(trace_record_t))) {
+            LOGW(SYSTEM, "⚠️  %s is not a format %d trace, generating cycles",
+                 SOAK_TRACE_FILE, TRACE_FILE_FORMAT);
+            trace_file.close();
+        }
+    }
+
+    // Two passes at most: the rest of the file, then from its start
+    for (uint8_t pass = 0; trace_file && pass < 2 && record_count == 0; pass++) {
+        while (record_count < SOAK_READ_RECORDS &&
+               trace_file.read((uint8_t*)&records[record_count], sizeof(trace_record_t)) ==
+                   sizeof(trace_record_t)) {
+            if (records[record_count].data.version == SENSOR_DATA_VERSION) {
+                record_count++;
+            }
+        }
+        if (record_count == 0) {
+            trace_file.seek(sizeof(trace_file_header_t));
+            portENTER_CRITICAL(&status_mux);
+            status.trace_loops++;
+            portEXIT_CRITICAL(&status_mux);
+        }
+    }
+    if (trace_file && record_count == 0) {
+        LOGW(SYSTEM, "⚠️  %s holds no version %d records, generating cycles",
+             SOAK_TRACE_FILE, SENSOR_DATA_VERSION);
+        trace_file.close();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    return record_count > 0;
+}
+
+/**
+ * @brief A fixed cycle pattern: a room filling and emptying over ~17 minutes at SOAK_CYCLE_MS
+ */
+static void generate(trace_record_t* record) {
+    uint32_t i = synthetic_cycle++;
+    uint32_t phase = i % 512;
+    uint16_t crowd = (uint16_t)(phase < 256 ? phase : 511 - phase);     // 0..255..0
+
+    memset(record, 0, sizeof(*record));
+    sensor_data_t* data = &record->data;
+    data->version = SENSOR_DATA_VERSION;
+    data->wifi_networks_count = 4 + crowd / 8;
+    data->wifi_signal_strength = -55 - (int16_t)(i % 30);
+    data->ble_devices_count = 2 + crowd / 3;
+    data->ble_signal_strength = -65 - (int16_t)(i % 25);
+    data->devices_appeared = (uint16_t)(1 + i % 7);
+}
+
+/**
+ * @brief Judge every gate over the history since warm-up and log the verdict
+ */
+static void check_gates(uint32_t now_ms) {
+    uint32_t window_ms = now_ms - warm_ms;
+    double hours = window_ms / MS_PER_HOUR;
+    int32_t heap_drift = (int32_t)fit_slope(METRIC_FREE_HEAP, true);
+    int32_t frag_growth = (int32_t)(fit_slope(METRIC_HEAP_FRAG_PCT, false) * 1000.0);
+    uint32_t misses = hours > 0.0 ? (uint32_t)((total_misses() - warm_misses) / hours) : 0;
+
+    // Worst loop against its own warm-up figure; loops that barely run are left out
+    int32_t creep = 0;
+    for (uint8_t loop = 0; loop < LOOP_COUNT; loop++) {
+        loop_timing_stats_t stats;
+        loop_timing_get((loop_id_t)loop, &stats);
+        if (warm_exec_us[loop] >= SOAK_CREEP_MIN_US) {
+            creep = max(creep, (int32_t)(((int64_t)stats.avg_exec_us - warm_exec_us[loop]) * 100 /
+                                         warm_exec_us[loop]));
+        }
+    }
+
+    uint8_t failing = 0;
+    if (window_ms >= SOAK_MIN_WINDOW_MS) {
+        if (heap_drift < -SOAK_HEAP_DRIFT_LIMIT) {
+            failing |= 1 << SOAK_GATE_HEAP_DRIFT;
+        }
+        if (frag_growth > SOAK_FRAG_GROWTH_LIMIT * 1000) {
+            failing |= 1 << SOAK_GATE_FRAG_GROWTH;
+        }
+        if (misses > SOAK_MISS_LIMIT) {
+            failing |= 1 << SOAK_GATE_DEADLINES;
+        }
+        if (creep > SOAK_CREEP_LIMIT_PCT) {
+            failing |= 1 << SOAK_GATE_LOOP_CREEP;
+        }
+    }
+
+    portENTER_CRITICAL(&status_mux);
+    status.window_ms = window_ms;
+    status.checks++;
+    status.heap_drift_bph = heap_drift;
+    status.frag_growth_milli_pph = frag_growth;
+    status.misses_per_hour = misses;
+    status.loop_creep_pct = creep;
+    status.failing = failing;
+    status.failed |= failing;
+    portEXIT_CRITICAL(&status_mux);
+
+    LOGI(SYSTEM, "🧪 Soak %lum judged: heap %ld B/h, frag %+.2f pts/h, %lu misses/h, loops %+ld%%%s",
+         window_ms / 60000, heap_drift, frag_growth / 1000.0f, misses, creep,
+         window_ms < SOAK_MIN_WINDOW_MS ? " (too early to fail)" : "");
+    for (uint8_t gate = 0; gate < SOAK_GATE_COUNT; gate++) {
+        if (failing & (1 << gate)) {
+            LOGW(SYSTEM, "⚠️  Soak gate %s failing", soak_gate_name((soak_gate_t)gate));
+        }
+    }
+}
+
+/**
+ * @brief Least-squares slope per hour of a metric's minute points since warm-up
+ * @param floor Fit each minute's least value rather than its mean
+ */
+static double fit_slope(metric_id_t metric, bool floor) {
+    static metric_rollup_t values[SOAK_PAGE_POINTS];
+    static uint32_t ends[SOAK_PAGE_POINTS];
+    fit_t fit = {0};
+    uint32_t after_ms = warm_ms;
+    uint16_t count;
+
+    do {
+        count = metrics_history_read_after(HISTORY_TIER_MINUTES, metric, after_ms,
+                                           values, ends, SOAK_PAGE_POINTS);
+        for (uint16_t i = 0; i < count; i++) {
+            double x = (ends[i] - warm_ms) / MS_PER_HOUR;
+            double y = floor ? values[i].min : values[i].avg;
+            fit.n += 1.0;
+            fit.x += x;
+            fit.y += y;
+            fit.xy += x * y;
+            fit.xx += x * x;
+        }
+        if (count > 0) {
+            after_ms = ends[count - 1];
+        }
+    } while (count == SOAK_PAGE_POINTS);
+
+    double denominator = fit.n * fit.xx - fit.x * fit.x;
+    if (fit.n < 2.0 || denominator <= 0.0) {
+        return 0.0;
+    }
+    return (fit.n * fit.xy - fit.x * fit.y) / denominator;
+}
+
+/**
+ * @brief Deadline misses of every loop since boot
+ */
+static uint32_t total_misses(void) {
+    uint32_t misses = 0;
+    for (uint8_t loop = 0; loop < LOOP_COUNT; loop++) {
+        loop_timing_stats_t stats;
+        loop_timing_get((loop_id_t)loop, &stats);
+        misses += stats.misses;
+    }
+    return misses;
+}
+
+#endif // SOAK_ENABLED
@@ -0,0 +1,254 @@
+/**
+ * @file storage.cpp
+ * @brief LittleFS on the data partition, the SD card, and which files go where
+ *
+ * The data partition used to be SPIFFS, which slows down as it fills and
+ * has no directories. It is now mounted as LittleFS; a unit whose
+ * partition still holds SPIFFS has its files carried over on the first
+ * boot that finds it, after which LittleFS mounts and the step is skipped.
+ *
+ * Callers name a class of file rather than a medium. Config files stay on
+ * flash, where they are before the card is mounted and LittleFS levels
+ * the wear of whole-file rewrites; models prefer flash and fall back to
+ * the card; logs prefer the card and fall back to flash while there is
+ * none. The card needs its SPI bus held for every operation, so access
+ * is bracketed by storage_lock() and storage_unlock().
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <SPIFFS.h>
+#include <SD.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "sd_monitor.h"
+#include "storage.h"
+#include "mem_policy.h"
+#include "logger.h"
+
+typedef struct {
+    char     path[48];
+    uint8_t* data;                  // PSRAM, freed once written back
+    uint32_t size;
+} stashed_file_t;
+
+static bool flash_mounted = false;
+static storage_status_t status = {0};
+
+// Forward declarations
+static bool migrate_spiffs(void);
+static uint16_t stash_spiffs(stashed_file_t* files);
+static bool make_parents(fs::FS& fs, const char* path);
+
+/**
+ * @brief Mount LittleFS, moving a SPIFFS partition's files over once
+ */
+bool storage_init(void) {
+    flash_mounted = LittleFS.begin(false, "/littlefs", STORAGE_MAX_OPEN_FILES, STORAGE_PARTITION_LABEL);
+    if (!flash_mounted) {
+        // Not LittleFS: SPIFFS from an older firmware, or blank
+        flash_mounted = migrate_spiffs();
+    }
+    if (!flash_mounted) {
+        LOGE(SYSTEM, "❌ LittleFS mount failed");
+        return false;
+    }
+
+    status.flash_mounted = true;
+    status.flash_total_bytes = LittleFS.totalBytes();
+    status.flash_used_bytes = LittleFS.usedBytes();
+    LOGI(SYSTEM, "✅ LittleFS mounted: %lu KB total, %lu KB used",
+         status.flash_total_bytes / 1024, status.flash_used_bytes / 1024);
+    return true;
+}
+
+/**
+ * @brief The medium a class of file goes to right now; no bus traffic
+ */
+storage_medium_t storage_select(storage_class_t cls) {
+    bool card = sd_monitor_mounted();
+    switch (cls) {
+        case STORAGE_CLASS_CONFIG:
+            return flash_mounted ? STORAGE_MEDIUM_FLASH : STORAGE_MEDIUM_NONE;
+        case STORAGE_CLASS_MODEL:
+            return flash_mounted ? STORAGE_MEDIUM_FLASH : card ? STORAGE_MEDIUM_SD : STORAGE_MEDIUM_NONE;
+        case STORAGE_CLASS_LOG:
+            return card ? STORAGE_MEDIUM_SD : flash_mounted ? STORAGE_MEDIUM_FLASH : STORAGE_MEDIUM_NONE;
+        default:
+            return STORAGE_MEDIUM_NONE;
+    }
+}
+
+/**
+ * @brief Take a medium for file operations: the SD card's bus, nothing for flash
+ */
+bool storage_lock(storage_medium_t medium) {
+    switch (medium) {
+        case STORAGE_MEDIUM_FLASH:
+            return flash_mounted;
+        case STORAGE_MEDIUM_SD:
+            return sd_monitor_mounted() && spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Give back what storage_lock() took
+ */
+void storage_unlock(storage_medium_t medium) {
+    if (medium == STORAGE_MEDIUM_SD) {
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+}
+
+/**
+ * @brief File system of a medium, NULL for STORAGE_MEDIUM_NONE
+ */
+fs::FS* storage_fs(storage_medium_t medium) {
+    switch (medium) {
+        case STORAGE_MEDIUM_FLASH: return &LittleFS;
+        case STORAGE_MEDIUM_SD:    return &SD;
+        default:                   return NULL;
+    }
+}
+
+/**
+ * @brief Select and lock the medium of a class in one step
+ */
+fs::FS* storage_acquire(storage_class_t cls, storage_medium_t* medium) {
+    *medium = storage_select(cls);
+    if (!storage_lock(*medium)) {
+        *medium = STORAGE_MEDIUM_NONE;
+        return NULL;
+    }
+    return storage_fs(*medium);
+}
+
+/**
+ * @brief Create a directory on a locked medium unless it exists
+ */
+bool storage_mkdir(storage_medium_t medium, const char* path) {
+    fs::FS* fs = storage_fs(medium);
+    return fs != NULL && (fs->exists(path) || fs->mkdir(path));
+}
+
+/**
+ * @brief Name of a medium for logs
+ */
+const char* storage_medium_name(storage_medium_t medium) {
+    switch (medium) {
+        case STORAGE_MEDIUM_FLASH: return "flash";
+        case STORAGE_MEDIUM_SD:    return "SD";
+        default:                   return "none";
+    }
+}
+
+/**
+ * @brief Copy the flash file system's state
+ */
+void storage_get_status(storage_status_t* out) {
+    *out = status;
+    if (flash_mounted) {
+        out->flash_total_bytes = LittleFS.totalBytes();
+        out->flash_used_bytes = LittleFS.usedBytes();
+    }
+}
+
+/**
+ * @brief Carry a SPIFFS partition's files over to LittleFS, or format a blank one
+ *
+ * Files beyond STORAGE_MIGRATE_MAX_FILES or STORAGE_MIGRATE_MAX_BYTES, or
+ * with no PSRAM to hold them, are lost; everything on it can be rebuilt
+ * or uploaded again, and the partition is unusable until reformatted.
+ * @return true if LittleFS is mounted afterwards
+ */
+static bool migrate_spiffs(void) {
+    static stashed_file_t files[STORAGE_MIGRATE_MAX_FILES];
+    uint16_t count = 0;
+    if (SPIFFS.begin(false, "/spiffs", STORAGE_MAX_OPEN_FILES, STORAGE_PARTITION_LABEL)) {
+        LOGW(SYSTEM, "⚠️  SPIFFS partition found - migrating to LittleFS");
+        count = stash_spiffs(files);
+        SPIFFS.end();
+        status.migrated = true;
+    }
+
+    if (!LittleFS.begin(true, "/littlefs", STORAGE_MAX_OPEN_FILES, STORAGE_PARTITION_LABEL)) {
+        for (uint16_t i = 0; i < count; i++) {
+            mem_free(MEM_BULK, files[i].data, max(files[i].size, (uint32_t)1));
+        }
+        return false;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        stashed_file_t* stashed = &files[i];
+        File file;
+        if (make_parents(LittleFS, stashed->path)) {
+            file = LittleFS.open(stashed->path, "w");
+        }
+        bool ok = file && file.write(stashed->data, stashed->size) == stashed->size;
+        if (file) {
+            file.close();
+        }
+        mem_free(MEM_BULK, stashed->data, max(stashed->size, (uint32_t)1));
+        if (ok) {
+            status.migrated_files++;
+        } else {
+            status.migration_lost++;
+            LOGW(SYSTEM, "⚠️  %s not migrated", stashed->path);
+        }
+    }
+    if (status.migrated) {
+        LOGI(SYSTEM, "✅ %u files migrated to LittleFS, %u lost", status.migrated_files, status.migration_lost);
+    }
+    return true;
+}
+
+/**
+ * @brief Read every SPIFFS file that fits the budget into PSRAM
+ * @return Files stashed
+ */
+static uint16_t stash_spiffs(stashed_file_t* files) {
+    uint16_t count = 0;
+    uint32_t total = 0;
+    File root = SPIFFS.open("/");
+    if (!root) {
+        return 0;
+    }
+    for (File file = root.openNextFile(); file; file = root.openNextFile()) {
+        stashed_file_t* stashed = &files[count];
+        uint32_t size = file.size();
+        bool fits = count < STORAGE_MIGRATE_MAX_FILES && total + size <= STORAGE_MIGRATE_MAX_BYTES &&
+                    strlen(file.path()) < sizeof(stashed->path);
+        stashed->data = fits ? (uint8_t*)mem_alloc(MEM_BULK, max(size, (uint32_t)1)) : NULL;
+        if (stashed->data != NULL && file.read(stashed->data, size) == size) {
+            strlcpy(stashed->path, file.path(), sizeof(stashed->path));
+            stashed->size = size;
+            total += size;
+            count++;
+        } else {
+            mem_free(MEM_BULK, stashed->data, max(size, (uint32_t)1));
+            status.migration_lost++;
+            LOGW(SYSTEM, "⚠️  %s (%lu B) left behind by the migration", file.path(), size);
+        }
+        file.close();
+    }
+    root.close();
+    return count;
+}
+
+/**
+ * @brief Create the directories above a file; SPIFFS names carry them as plain slashes
+ */
+static bool make_parents(fs::FS& fs, const char* path) {
+    char dir[48];
+    for (const char* slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        size_t length = min((size_t)(slash - path), sizeof(dir) - 1);
+        memcpy(dir, path, length);
+        dir[length] = '\0';
+        if (!fs.exists(dir) && !fs.mkdir(dir)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,285 @@
+/**
+ * @file supervisor.cpp
+ * @brief Per-task liveness heartbeats and escalation of stalls
+ *
+ * Each task checks in before it blocks and says how long it may wait;
+ * with its own work budget on top that gives a deadline for the next
+ * check-in. A task that misses it is escalated in steps, each logged to
+ * the crash log on flash: the return addresses found on its stack, then
+ * its subsystem's recovery hook and a forced wakeup if it is blocked,
+ * then a reboot if it still does not come back. A task that checks in
+ * again clears its escalation.
+ */
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <esp_system.h>
+#include <soc/soc.h>
+#include "config.h"
+#include "storage.h"
+#include "crash_dump.h"
+#include "supervisor.h"
+
+typedef struct {
+    supervisor_task_stats_t stats;
+    TaskHandle_t            task;
+    uint32_t                stack_bytes;
+    uint32_t                budget_ms;
+    supervisor_recover_t    recover;
+    uint32_t                checkin_ms;     // Last check-in
+    uint32_t                wait_ms;        // ...and the wait it announced
+    uint8_t                 escalation;     // Steps taken for the stall under way, supervisor_check() only
+    uint32_t                stalled_checkins;   // stats.checkins when that stall was found
+} supervised_t;
+
+static const char* const default_names[SUPERVISED_COUNT] = {
+    "UI_Task", "AI_Task", "Scan_Task", "System_Task", "Capture_Task", "GPS_Task"
+};
+
+static supervised_t tasks[SUPERVISED_COUNT];
+static portMUX_TYPE tasks_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool log_ready = false;
+
+// Forward declarations
+static void escalate(supervised_t* entry, uint32_t overdue_ms, uint32_t now_ms);
+static void log_backtrace(const supervised_t* entry, uint32_t overdue_ms, uint32_t now_ms);
+static void reboot(const supervised_t* entry, uint32_t overdue_ms, uint32_t now_ms);
+static void crash_log(const char* format, ...);
+static const char* state_name(eTaskState state);
+
+/**
+ * @brief Open the crash log and note a reset caused by a panic or watchdog
+ */
+void supervisor_init(void) {
+    log_ready = true;
+    const char* cause = NULL;
+    switch (esp_reset_reason()) {
+        case ESP_RST_PANIC:    cause = "panic"; break;
+        case ESP_RST_INT_WDT:  cause = "interrupt watchdog"; break;
+        case ESP_RST_TASK_WDT: cause = "task watchdog"; break;
+        case ESP_RST_WDT:      cause = "watchdog"; break;
+        case ESP_RST_BROWNOUT: cause = "brownout"; break;
+        default:               break;
+    }
+    if (cause != NULL) {
+        crash_log("[%lu ms] Boot after %s reset", millis(), cause);
+    }
+}
+
+/**
+ * @brief Start watching a task
+ */
+void supervisor_register(supervised_task_t id, TaskHandle_t task, uint32_t stack_bytes,
+                         uint32_t budget_ms, supervisor_recover_t recover) {
+    if (id >= SUPERVISED_COUNT || task == NULL) {
+        return;
+    }
+    supervised_t* entry = &tasks[id];
+    portENTER_CRITICAL(&tasks_mux);
+    entry->task = task;
+    entry->stack_bytes = stack_bytes;
+    entry->budget_ms = budget_ms;
+    entry->recover = recover;
+    entry->stats.name = default_names[id];
+    if (entry->stats.checkins == 0) {
+        entry->checkin_ms = millis();   // First deadline counts from here
+    }
+    entry->stats.registered = true;
+    portEXIT_CRITICAL(&tasks_mux);
+}
+
+/**
+ * @brief Heartbeat, from the task itself before it waits
+ */
+void supervisor_checkin(supervised_task_t id, uint32_t wait_ms) {
+    supervised_t* entry = &tasks[id];
+    uint32_t now = millis();
+    portENTER_CRITICAL(&tasks_mux);
+    if (entry->stats.checkins > 0) {
+        uint32_t gap = now - entry->checkin_ms;
+        entry->stats.max_gap_ms = max(entry->stats.max_gap_ms, gap);
+        if (entry->wait_ms != SUPERVISOR_PARKED && gap > entry->wait_ms) {
+            entry->stats.max_late_ms = max(entry->stats.max_late_ms, gap - entry->wait_ms);
+        }
+    }
+    entry->checkin_ms = now;
+    entry->wait_ms = wait_ms;
+    entry->stats.checkins++;
+    portEXIT_CRITICAL(&tasks_mux);
+}
+
+/**
+ * @brief The task is ending on purpose
+ */
+void supervisor_retire(supervised_task_t id) {
+    portENTER_CRITICAL(&tasks_mux);
+    tasks[id].stats.retired = true;
+    portEXIT_CRITICAL(&tasks_mux);
+}
+
+/**
+ * @brief Find overdue tasks and escalate
+ */
+void supervisor_check(uint32_t now_ms) {
+    for (uint8_t id = 0; id < SUPERVISED_COUNT; id++) {
+        supervised_t* entry = &tasks[id];
+        portENTER_CRITICAL(&tasks_mux);
+        bool watched = entry->stats.registered && !entry->stats.retired &&
+                       entry->wait_ms != SUPERVISOR_PARKED;
+        uint32_t since = now_ms - entry->checkin_ms;
+        uint32_t allowed = entry->wait_ms + entry->budget_ms;
+        uint32_t checkins = entry->stats.checkins;
+        portEXIT_CRITICAL(&tasks_mux);
+
+        if (entry->escalation > 0 && checkins != entry->stalled_checkins) {
+            crash_log("[%lu ms] %s checked in again", now_ms, entry->stats.name);
+            entry->escalation = 0;
+        }
+        if (watched && since > allowed) {
+            escalate(entry, since - allowed, now_ms);
+        }
+    }
+}
+
+/**
+ * @brief Copy one task's figures
+ */
+void supervisor_get(supervised_task_t id, supervisor_task_stats_t* out) {
+    portENTER_CRITICAL(&tasks_mux);
+    *out = tasks[id].stats;
+    portEXIT_CRITICAL(&tasks_mux);
+    if (out->name == NULL) {
+        out->name = default_names[id];
+    }
+}
+
+/**
+ * @brief Take the next step for a task this far past its deadline
+ */
+static void escalate(supervised_t* entry, uint32_t overdue_ms, uint32_t now_ms) {
+    if (overdue_ms >= SUPERVISOR_REBOOT_MS) {
+        reboot(entry, overdue_ms, now_ms);
+    }
+
+    if (overdue_ms >= SUPERVISOR_STALL_MS && entry->escalation == 0) {
+        entry->escalation = 1;
+        entry->stalled_checkins = entry->stats.checkins;
+        portENTER_CRITICAL(&tasks_mux);
+        entry->stats.stalls++;
+        portEXIT_CRITICAL(&tasks_mux);
+        log_backtrace(entry, overdue_ms, now_ms);
+    }
+
+    if (overdue_ms >= SUPERVISOR_RECOVER_MS && entry->escalation == 1) {
+        if (entry->stats.recoveries >= SUPERVISOR_MAX_RECOVERIES) {
+            reboot(entry, overdue_ms, now_ms);
+        }
+        entry->escalation = 2;
+        portENTER_CRITICAL(&tasks_mux);
+        entry->stats.recoveries++;
+        portEXIT_CRITICAL(&tasks_mux);
+
+        bool restarted = entry->recover != NULL && entry->recover();
+        // A task blocked on a queue, notification or delay returns as if timed out
+        bool woken = eTaskGetState(entry->task) == eBlocked && xTaskAbortDelay(entry->task) == pdPASS;
+        crash_log("[%lu ms] %s recovery %lu: subsystem %s, wait %s", now_ms, entry->stats.name,
+                  entry->stats.recoveries, restarted ? "restarted" : "not restarted",
+                  woken ? "aborted" : "not aborted");
+    }
+}
+
+/**
+ * @brief Log a stalled task with the code addresses found on its stack
+ *
+ * The saved stack pointer is the first member of every FreeRTOS TCB. From
+ * there to the stack's end, words that point into IRAM or flash code are
+ * listed innermost first, as pc:sp pairs the exception decoder reads; a
+ * running task's saved pointer is stale, so its list is only a hint.
+ */
+static void log_backtrace(const supervised_t* entry, uint32_t overdue_ms, uint32_t now_ms) {
+    eTaskState state = eTaskGetState(entry->task);
+    char trace[SUPERVISOR_BACKTRACE_DEPTH * 22 + 1];
+    size_t len = 0;
+    trace[0] = '\0';
+
+    const uint32_t* sp = *(const uint32_t* const*)entry->task;
+    const uint32_t* end = (const uint32_t*)(pxTaskGetStackStart(entry->task) + entry->stack_bytes);
+    uint8_t found = 0;
+    for (const uint32_t* word = sp; word < end && found < SUPERVISOR_BACKTRACE_DEPTH; word++) {
+        // Windowed calls keep the window increment in the top two bits
+        uint32_t pc = (*word & 0x3FFFFFFF) | 0x40000000;
+        bool code = (pc >= SOC_IROM_LOW && pc < SOC_IROM_HIGH) ||
+                    (pc >= SOC_IRAM_LOW && pc < SOC_IRAM_HIGH);
+        if (code) {
+            len += snprintf(trace + len, sizeof(trace) - len, " 0x%08lx:0x%08lx",
+                            (unsigned long)pc, (unsigned long)(uintptr_t)word);
+            found++;
+        }
+    }
+
+    crash_log("[%lu ms] %s stalled %lu ms past its check-in (%s, %u bytes of stack free)",
+              now_ms, entry->stats.name, overdue_ms, state_name(state),
+              (unsigned)uxTaskGetStackHighWaterMark(entry->task));
+    crash_log("Backtrace:%s", found > 0 ? trace : " none found");
+}
+
+/**
+ * @brief Record why and restart the chip
+ */
+static void reboot(const supervised_t* entry, uint32_t overdue_ms, uint32_t now_ms) {
+    crash_log("[%lu ms] %s still stalled after %lu ms and %lu recoveries - rebooting",
+              now_ms, entry->stats.name, overdue_ms, entry->stats.recoveries);
+#if CRASH_DUMP_ENABLED
+    char note[CRASH_NOTE_BYTES];
+    snprintf(note, sizeof(note), "%s stalled %lu ms", entry->stats.name, overdue_ms);
+    crash_dump_note(note);
+#endif
+    Serial.flush();
+    ESP.restart();
+}
+
+/**
+ * @brief One line to the serial console and the crash log
+ */
+static void crash_log(const char* format, ...) {
+    char line[SUPERVISOR_BACKTRACE_DEPTH * 22 + 64];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    Serial.printf("🐕 %s\n", line);
+    if (!log_ready) {
+        return;
+    }
+
+    storage_medium_t medium;
+    fs::FS* fs = storage_acquire(STORAGE_CLASS_CONFIG, &medium);
+    if (fs == NULL) {
+        return;
+    }
+    File file = fs->open(SUPERVISOR_CRASH_LOG, "a");
+    if (file && file.size() >= SUPERVISOR_CRASH_LOG_BYTES) {
+        file.close();
+        fs->remove("/crash.old");
+        fs->rename(SUPERVISOR_CRASH_LOG, "/crash.old");
+        file = fs->open(SUPERVISOR_CRASH_LOG, "w");
+    }
+    if (file) {
+        file.println(line);
+        file.close();
+    }
+    storage_unlock(medium);
+}
+
+/**
+ * @brief FreeRTOS task state for logs
+ */
+static const char* state_name(eTaskState state) {
+    switch (state) {
+        case eRunning:   return "running";
+        case eReady:     return "ready";
+        case eBlocked:   return "blocked";
+        case eSuspended: return "suspended";
+        default:         return "deleted";
+    }
+}
@@ -0,0 +1,332 @@
+/**
+ * @file survey.cpp
+ * @brief Duty-cycled survey: deep sleep, one sweep per wake, flushes now and then
+ *
+ * A wake brings up only the radios. BLE listens passively while the WiFi
+ * sweep listens on each channel in turn, so the BLE time mostly overlaps
+ * it; each sweep becomes one 16-byte record in a ring in RTC memory, which
+ * keeps its contents through deep sleep and through a crash restart too
+ * (RTC_NOINIT_ATTR), and is only taken as valid with its magic.
+ *
+ * Every SURVEY_FLUSH_WAKES wakes, or once the ring is full, the ring is
+ * appended to SURVEY_LOG_PATH on the card and, with an uplink configured,
+ * published in one QoS 1 message; either one taking it empties the ring.
+ * With neither the oldest records are counted and overwritten.
+ *
+ * The display is never initialized, so its backlight pin is driven low
+ * and held through the sleep, where it would otherwise float.
+ */
+
+#include "config.h"
+#include "survey.h"
+
+#if SURVEY_MODE_ENABLED
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <SD.h>
+#include <esp_sleep.h>
+#include <esp_attr.h>
+#include <esp_wifi.h>
+#include <driver/gpio.h>
+#include <time.h>
+#if MQTT_ENABLED && WIFI_LINK_ENABLED
+#include <mqtt_client.h>
+#endif
+#include <Wire.h>
+#include "ble_scan.h"
+#include "wake_sources.h"
+#include "sd_monitor.h"
+#include "spi_bus.h"
+#include "logger.h"
+
+#define SURVEY_MAGIC        0x53525654u     // "SRVT"
+#define SURVEY_NO_RSSI      -128
+
+/**
+ * @brief Everything kept between wakes
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t wakes;
+    uint32_t dropped;
+    uint32_t flushes;
+    uint16_t head;                  // Oldest record
+    uint16_t count;
+    survey_record_t records[SURVEY_RING_RECORDS];
+} survey_state_t;
+
+RTC_NOINIT_ATTR static survey_state_t state;
+
+// Forward declarations
+static void sweep(survey_record_t* record);
+static bool flush_to_card(void);
+static bool flush_to_broker(void);
+static uint16_t copy_ring(survey_record_t* out);
+static void sleep_until_next(uint32_t awake_ms, bool stretch, bool motion) __attribute__((noreturn));
+
+/**
+ * @brief A survey wake, unless the exit pin is held or a touch did the waking
+ */
+bool survey_should_run(void) {
+    pinMode(SURVEY_EXIT_PIN, INPUT_PULLUP);
+    bool run = digitalRead(SURVEY_EXIT_PIN) == HIGH && wake_sources_boot_cause() != WAKE_CAUSE_TOUCH;
+    if (!run && BOARD.display.bl >= 0) {
+        gpio_hold_dis((gpio_num_t)BOARD.display.bl);    // The backlight driver takes it over
+    }
+    return run;
+}
+
+/**
+ * @brief Sweep, store, flush if due, sleep
+ */
+void survey_run(void) {
+    uint32_t start_ms = millis();
+    if (state.magic != SURVEY_MAGIC || state.head >= SURVEY_RING_RECORDS || state.count > SURVEY_RING_RECORDS) {
+        memset(&state, 0, sizeof(state));
+        state.magic = SURVEY_MAGIC;
+    }
+    state.wakes++;
+    if (BOARD.i2c.sda >= 0) {
+        Wire.begin(BOARD.i2c.sda, BOARD.i2c.scl);
+    }
+    wake_sources_init();
+
+    survey_record_t record;
+    sweep(&record);
+    record.wake_ms_x16 = (uint8_t)min((millis() - start_ms) / 16, (uint32_t)UINT8_MAX);
+
+    bool overwrote = state.count == SURVEY_RING_RECORDS;
+    if (overwrote) {
+        state.head = (state.head + 1) % SURVEY_RING_RECORDS;
+        state.count--;
+        state.dropped++;
+    }
+    state.records[(state.head + state.count) % SURVEY_RING_RECORDS] = record;
+    state.count++;
+    LOGI(SYSTEM, "🛰️  Survey wake %lu: %u APs, %u BLE, %u in the ring",
+         (unsigned long)state.wakes, record.wifi_count, record.ble_count, state.count);
+
+    // Once full, only the regular flushes are tried: with no card and no
+    // broker in reach, every wake would otherwise spend the uplink timeouts
+    if (state.wakes % SURVEY_FLUSH_WAKES == 0 || (state.count == SURVEY_RING_RECORDS && !overwrote)) {
+        bool card = flush_to_card();
+        bool broker = flush_to_broker();
+        if (card || broker) {
+            state.count = 0;
+            state.head = 0;
+            state.flushes++;
+        } else {
+            LOGW(SYSTEM, "⚠️  Survey flush found no card and no broker; ring kept");
+        }
+    }
+
+    // A motion wake arms only the timer and touch for the next sleep, so a
+    // device being carried sweeps at most once more per interval
+    wake_status_t wake;
+    wake_sources_get_status(&wake);
+    bool low_battery = wake.battery && wake.battery_mv < WAKE_BATTERY_LOW_MV;
+    sleep_until_next(millis() - start_ms, low_battery, wake.boot_cause != WAKE_CAUSE_MOTION);
+}
+
+/**
+ * @brief One passive WiFi sweep with BLE listening alongside
+ */
+static void sweep(survey_record_t* record) {
+    memset(record, 0, sizeof(*record));
+    record->time_s = (uint32_t)time(NULL);
+    record->wifi_best_rssi = SURVEY_NO_RSSI;
+    record->ble_avg_rssi = SURVEY_NO_RSSI;
+
+    uint32_t ble_start_ms = millis();
+    ble_scan_set_passive();
+    bool ble = ble_scan_init();
+
+    WiFi.mode(WIFI_STA);
+    int16_t found = WiFi.scanNetworks(false, true, true, SURVEY_WIFI_DWELL_MS);
+    for (int16_t i = 0; i < found; i++) {
+        int32_t rssi = WiFi.RSSI(i);
+        if (rssi > record->wifi_best_rssi) {
+            const uint8_t* bssid = WiFi.BSSID(i);
+            record->wifi_best_rssi = (int8_t)rssi;
+            record->best_bssid = (uint32_t)bssid[2] << 24 | (uint32_t)bssid[3] << 16 |
+                                 (uint32_t)bssid[4] << 8 | bssid[5];
+        }
+        int32_t channel = WiFi.channel(i);
+        if (channel >= 1 && channel <= 13) {
+            record->channel_mask |= 1 << channel;
+        }
+        if (WiFi.encryptionType(i) == WIFI_AUTH_OPEN) {
+            record->open_count++;
+        }
+    }
+    record->wifi_count = (uint8_t)min(max(found, (int16_t)0), (int16_t)UINT8_MAX);
+    WiFi.scanDelete();
+
+    if (ble) {
+        uint32_t listened_ms = millis() - ble_start_ms;
+        if (listened_ms < SURVEY_BLE_MS) {
+            delay(SURVEY_BLE_MS - listened_ms);
+        }
+        ble_scan_summary_t summary;
+        ble_scan_get_summary(&summary);
+        record->ble_count = (uint8_t)min(summary.device_count, (uint16_t)UINT8_MAX);
+        if (summary.device_count > 0) {
+            record->ble_avg_rssi = (int8_t)summary.avg_rssi;
+        }
+    }
+}
+
+/**
+ * @brief Append the ring to the survey file, creating it with its header
+ */
+static bool flush_to_card(void) {
+    if (!spi_bus_init() || !sd_monitor_init()) {
+        return false;
+    }
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    bool fresh = !SD.exists(SURVEY_LOG_PATH);
+    File file = SD.open(SURVEY_LOG_PATH, FILE_APPEND);
+    bool ok = false;
+    if (file) {
+        ok = true;
+        if (fresh) {
+            survey_header_t header = { SURVEY_FILE_MAGIC, SURVEY_FORMAT, sizeof(survey_record_t), 0,
+                                       state.wakes, state.dropped };
+            ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+        }
+        for (uint16_t i = 0; i < state.count && ok; i++) {
+            const survey_record_t* record = &state.records[(state.head + i) % SURVEY_RING_RECORDS];
+            ok = file.write((const uint8_t*)record, sizeof(*record)) == sizeof(*record);
+        }
+        file.close();
+    }
+    SD.end();
+    spi_bus_release(SPI_DEVICE_SD);
+    if (ok) {
+        LOGI(SYSTEM, "✅ %u survey records appended to %s", state.count, SURVEY_LOG_PATH);
+    }
+    return ok;
+}
+
+#if MQTT_ENABLED && WIFI_LINK_ENABLED
+static volatile bool broker_up = false;
+static volatile int acked_id = -1;
+
+/**
+ * @brief Connection and acknowledgement, from the MQTT task
+ */
+static void on_mqtt_event(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data) {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+    if (event_id == MQTT_EVENT_CONNECTED) {
+        broker_up = true;
+    } else if (event_id == MQTT_EVENT_PUBLISHED) {
+        acked_id = event->msg_id;
+    }
+}
+
+/**
+ * @brief Wait for a condition, up to SURVEY_UPLINK_TIMEOUT_MS
+ */
+static bool wait_for(volatile bool* flag) {
+    uint32_t start_ms = millis();
+    while (!*flag && millis() - start_ms < SURVEY_UPLINK_TIMEOUT_MS) {
+        delay(50);
+    }
+    return *flag;
+}
+#endif
+
+/**
+ * @brief Join, publish the ring in one message and wait for the broker to take it
+ *
+ * Published on MQTT_TOPIC_PREFIX/<station MAC>/survey: a survey_header_t,
+ * then the records oldest first.
+ */
+static bool flush_to_broker(void) {
+#if MQTT_ENABLED && WIFI_LINK_ENABLED
+    WiFi.begin(WIFI_LINK_SSID, WIFI_LINK_PASSWORD);
+    uint32_t start_ms = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - start_ms < SURVEY_UPLINK_TIMEOUT_MS) {
+        delay(50);
+    }
+    if (WiFi.status() != WL_CONNECTED) {
+        return false;
+    }
+
+    static uint8_t payload[sizeof(survey_header_t) + SURVEY_RING_RECORDS * sizeof(survey_record_t)];
+    survey_header_t* header = (survey_header_t*)payload;
+    *header = { SURVEY_FILE_MAGIC, SURVEY_FORMAT, sizeof(survey_record_t), state.count,
+                state.wakes, state.dropped };
+    uint16_t records = copy_ring((survey_record_t*)(payload + sizeof(*header)));
+
+    uint8_t mac[6];
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+    char topic[64];
+    snprintf(topic, sizeof(topic), "%s/%02x%02x%02x%02x%02x%02x/survey", MQTT_TOPIC_PREFIX,
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    esp_mqtt_client_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.uri = MQTT_BROKER_URI;
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&config);
+    if (client == NULL) {
+        return false;
+    }
+    esp_mqtt_client_register_event(client, MQTT_EVENT_ANY, on_mqtt_event, NULL);
+    esp_mqtt_client_start(client);
+
+    bool ok = false;
+    if (wait_for(&broker_up)) {
+        int id = esp_mqtt_client_publish(client, topic, (const char*)payload,
+                                         sizeof(*header) + records * sizeof(survey_record_t), 1, 0);
+        start_ms = millis();
+        while (id >= 0 && acked_id != id && millis() - start_ms < SURVEY_UPLINK_TIMEOUT_MS) {
+            delay(50);
+        }
+        ok = id >= 0 && acked_id == id;
+    }
+    esp_mqtt_client_stop(client);
+    esp_mqtt_client_destroy(client);
+    if (ok) {
+        LOGI(SYSTEM, "✅ %u survey records published on %s", records, topic);
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief The ring, oldest first
+ */
+static uint16_t copy_ring(survey_record_t* out) {
+    for (uint16_t i = 0; i < state.count; i++) {
+        out[i] = state.records[(state.head + i) % SURVEY_RING_RECORDS];
+    }
+    return state.count;
+}
+
+/**
+ * @brief Radios off, backlight held dark, deep sleep for the rest of the interval
+ *
+ * With stretch (a low battery) the interval is SURVEY_LOW_BATTERY_STRETCH times longer.
+ */
+static void sleep_until_next(uint32_t awake_ms, bool stretch, bool motion) {
+    WiFi.mode(WIFI_OFF);
+    if (BOARD.display.bl >= 0) {
+        pinMode(BOARD.display.bl, OUTPUT);
+        digitalWrite(BOARD.display.bl, LOW);
+        gpio_hold_en((gpio_num_t)BOARD.display.bl);
+        gpio_deep_sleep_hold_en();
+    }
+    wake_sources_arm_deep_sleep(motion);
+    uint64_t interval_ms = (uint64_t)SURVEY_INTERVAL_S * 1000 * (stretch ? SURVEY_LOW_BATTERY_STRETCH : 1);
+    uint64_t sleep_ms = awake_ms < interval_ms ? interval_ms - awake_ms : 1000;
+    LOGI(SYSTEM, "💤 Awake %lums, sleeping %llus", (unsigned long)awake_ms, sleep_ms / 1000);
+    Serial.flush();
+    esp_sleep_enable_timer_wakeup(sleep_ms * 1000);
+    esp_deep_sleep_start();
+}
+
+#endif // SURVEY_MODE_ENABLED
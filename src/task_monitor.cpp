@@ -0,0 +1,144 @@
+/**
+ * @file task_monitor.cpp
+ * @brief Stack high-water marks and per-task heap use of the firmware's tasks
+ *
+ * FreeRTOS already keeps each stack's least headroom; this only reads it
+ * for a fixed list of tasks and keeps the lowest figure, so a stack that
+ * came close to overflowing is on record long after it recovered. With
+ * ESP-IDF heap task tracking, the heap blocks each task owns are totalled
+ * in the same pass.
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "task_monitor.h"
+#include "logger.h"
+
+#if CONFIG_HEAP_TASK_TRACKING
+#include <esp_heap_task_info.h>
+#define HEAP_TRACKING true
+#else
+#define HEAP_TRACKING false
+#endif
+
+static TaskHandle_t watched[TASK_MONITOR_MAX_TASKS];
+static task_stats_t stats[TASK_MONITOR_MAX_TASKS];
+static uint8_t watched_count = 0;
+static bool sampled = false;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+#if HEAP_TRACKING
+static heap_task_totals_t totals[TASK_MONITOR_MAX_TASKS];
+
+// Forward declarations
+static void sample_heap(void);
+#endif
+
+/**
+ * @brief Add a task to the stack and heap report
+ */
+bool task_monitor_watch(TaskHandle_t task, uint32_t stack_bytes) {
+    if (task == NULL || watched_count == TASK_MONITOR_MAX_TASKS) {
+        return false;
+    }
+    task_stats_t* entry = &stats[watched_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->name = pcTaskGetName(task);
+    entry->stack_bytes = stack_bytes;
+    entry->stack_min_free = stack_bytes;
+    entry->heap_tracked = HEAP_TRACKING;
+
+    portENTER_CRITICAL(&stats_mux);
+    watched[watched_count++] = task;
+    portEXIT_CRITICAL(&stats_mux);
+    return true;
+}
+
+/**
+ * @brief Read every watched task's stack high-water mark and heap totals
+ */
+void task_monitor_sample(void) {
+    for (uint8_t i = 0; i < watched_count; i++) {
+        uint32_t free_bytes = uxTaskGetStackHighWaterMark(watched[i]);
+        if (free_bytes >= stats[i].stack_min_free) {
+            continue;
+        }
+        portENTER_CRITICAL(&stats_mux);
+        stats[i].stack_min_free = free_bytes;
+        portEXIT_CRITICAL(&stats_mux);
+        if (free_bytes < TASK_STACK_WARN_BYTES) {
+            LOGW(SYSTEM, "⚠️ Warning: %s stack down to %lu of %lu bytes free",
+                 stats[i].name, free_bytes, stats[i].stack_bytes);
+        }
+    }
+#if HEAP_TRACKING
+    sample_heap();
+#endif
+    sampled = true;
+}
+
+/**
+ * @brief Copy out the figures of the last sample
+ */
+uint8_t task_monitor_get(task_stats_t* out, uint8_t max) {
+    portENTER_CRITICAL(&stats_mux);
+    uint8_t count = min(watched_count, max);
+    memcpy(out, stats, count * sizeof(task_stats_t));
+    portEXIT_CRITICAL(&stats_mux);
+    return count;
+}
+
+/**
+ * @brief Least stack headroom of any watched task
+ */
+uint32_t task_monitor_min_stack_free(void) {
+    if (!sampled) {
+        return UINT32_MAX;
+    }
+    uint32_t least = UINT32_MAX;
+    portENTER_CRITICAL(&stats_mux);
+    for (uint8_t i = 0; i < watched_count; i++) {
+        least = min(least, stats[i].stack_min_free);
+    }
+    portEXIT_CRITICAL(&stats_mux);
+    return least;
+}
+
+#if HEAP_TRACKING
+
+/**
+ * @brief Total the live heap blocks of the watched tasks across every heap
+ *
+ * A task that holds nothing gets no totals entry and reads as 0.
+ */
+static void sample_heap(void) {
+    heap_task_info_params_t params;
+    memset(&params, 0, sizeof(params));
+    params.caps[0] = 0;             // (heap caps & 0) == 0: every heap in one bucket
+    params.mask[0] = 0;
+    params.tasks = watched;
+    params.num_tasks = watched_count;
+    size_t found = 0;
+    params.totals = totals;
+    params.num_totals = &found;
+    params.max_totals = TASK_MONITOR_MAX_TASKS;
+    heap_caps_get_per_task_info(&params);
+
+    portENTER_CRITICAL(&stats_mux);
+    for (uint8_t i = 0; i < watched_count; i++) {
+        stats[i].heap_bytes = 0;
+        stats[i].heap_blocks = 0;
+        for (size_t t = 0; t < found; t++) {
+            if (totals[t].task == watched[i]) {
+                stats[i].heap_bytes = totals[t].size[0];
+                stats[i].heap_blocks = totals[t].count[0];
+            }
+        }
+        stats[i].heap_peak_bytes = max(stats[i].heap_peak_bytes, stats[i].heap_bytes);
+    }
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+#endif // HEAP_TRACKING
@@ -7,221 +7,397 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
+#include <esp_timer.h>
 #include "config.h"
 #include "ai_states.h"
+#include "sensor_snapshot.h"
+#include "data_bus.h"
+#include "governor.h"
+#include "scan_events.h"
+#include "ai_inference.h"
+#include "ai_sequence.h"
+#include "ai_transition.h"
+#include "ai_rules.h"
+#include "site_thresholds.h"
+#include "ai_state_stats.h"
+#include "baseline.h"
+#include "ai_telemetry.h"
+#include "trace_log.h"
+#include "scan_log.h"
+#include "power_manager.h"
+#include "supervisor.h"
+#include "loop_timing.h"
+#include "warm_start.h"
+#include "event_trace.h"
+#include "firmware_update.h"
+#include "ap_anomaly.h"
+#include "capture_burst.h"
+#include "live_feed.h"
+#include "device_table.h"
+#include "ui_events.h"
+#include "tunables.h"
+#include "timer_wheel.h"
+#include "latency_trace.h"
+#include "mem_policy.h"
+#include "logger.h"
 
 // External variables
 extern ai_state_t current_ai_state;
-extern sensor_data_t global_sensor_data;
-extern SemaphoreHandle_t sensor_data_mutex;
-extern QueueHandle_t ai_state_queue;
+extern QueueHandle_t scan_event_queue;
+extern TaskHandle_t system_task_handle;
+
+// One decision's copies that outlive no cycle, 16-byte aligned
+#define AI_SCRATCH_BYTES (sizeof(scan_histograms_t) + 16)
 
 // Internal state tracking
+static mem_arena_t scratch;                 // Emptied at the top of every decision
 static ai_state_t previous_state = AI_STATE_IDLE;
 static uint32_t state_duration = 0;
+static uint32_t state_entered_ms = 0;
+static uint32_t events_dropped = 0;
 static uint32_t excitement_level = 0;
 static uint32_t learning_progress = 0;
+static uint32_t anomaly_ms = 0;             // Last rogue AP event, 0 for none
+static timer_id_t metrics_timer = TIMER_WHEEL_NONE;
 
 // Forward declarations
-ai_state_t analyze_behavior(const sensor_data_t* data);
-void update_learning_metrics(ai_state_t new_state);
-void log_state_change(ai_state_t old_state, ai_state_t new_state);
+ai_state_t analyze_behavior(const sensor_data_t* data, const ai_sequence_state_t* seq);
+void log_state_change(ai_state_t old_state, ai_state_t new_state, float confidence);
+static void restore_warm_start(void);
+static void snapshot_warm_start(void);
+static void ai_metrics_timer(void* arg);
 
 /**
  * @brief AI Task - performs behavioral inference and state management
  */
 void ai_task(void* parameter) {
-    Serial.println("🧠 AI Task started");
+    LOGI(AI, "🧠 AI Task started");
     
-    TickType_t last_wake_time = xTaskGetTickCount();
     sensor_data_t local_sensor_data;
+    ai_feature_vector_t local_features;
+    scan_event_t event;
+    state_entered_ms = millis();
+    ai_sequence_init();
+#if WARM_START_ENABLED
+    restore_warm_start();
+#endif
+    ai_transition_init(current_ai_state, state_entered_ms);
+    ai_state_stats_init(current_ai_state, state_entered_ms);
+    site_thresholds_init();
+    ai_telemetry_reset();
+    uint32_t log_interval_ms = (uint32_t)tunable_get(TUNABLE_LOG_INTERVAL_MS);
+    metrics_timer = timer_wheel_start("ai metrics", log_interval_ms, log_interval_ms, ai_metrics_timer, NULL);
+    if (!mem_arena_init(&scratch, "ai", MEM_HOT_CPU, AI_SCRATCH_BYTES)) {
+        LOGE(AI, "❌ AI scratch allocation failed - cycles will not be traced");
+    }
+    
+    // Model backend if one is configured and loads, rule engine otherwise;
+    // this task starts before the file systems are mounted
+    ai_inference_init();
+    bool model_retried = false;
+    LOGI(AI, "🧠 Inference backend: %s", ai_inference_backend_name());
+#if AI_INFERENCE_BENCHMARK
+    ai_inference_benchmark();
+#endif
     
     while (true) {
-        // Get current sensor data safely
-        if (xSemaphoreTake(sensor_data_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-            memcpy(&local_sensor_data, &global_sensor_data, sizeof(sensor_data_t));
-            xSemaphoreGive(sensor_data_mutex);
-        } else {
-            Serial.println("⚠️  AI Task: Failed to get sensor data");
-            vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(AI_UPDATE_INTERVAL));
-            continue;
+        // Sleep until the scan task reports a change; the timeout keeps
+        // time-based transitions running when the environment is quiet
+        supervisor_checkin(SUPERVISED_AI, AI_EVENT_TIMEOUT_MS);
+        uint16_t trace = 0;
+        if (xQueueReceive(scan_event_queue, &event, pdMS_TO_TICKS(AI_EVENT_TIMEOUT_MS)) == pdTRUE) {
+            // Coalesce a burst of events into a single inference
+            uint32_t feed_sequence = live_feed_sequence();
+            do {
+                if (event.type == SCAN_EVENT_CYCLE_COMPLETE) {
+                    events_dropped += event.dropped;
+                    if (event.trace != 0) {
+                        // Coalesced cycles: the newest trace is the one this decision answers
+                        latency_trace_end(trace, LATENCY_END_COALESCED);
+                        trace = event.trace;
+                    }
+                } else if (event.type == SCAN_EVENT_AP_ANOMALY) {
+                    anomaly_ms = event.timestamp_ms != 0 ? event.timestamp_ms : 1;
+                    LOGW(AI, "🧠 Rogue AP (%s) at %02X:%02X:%02X:%02X:%02X:%02X",
+                         ap_anomaly_name((ap_anomaly_t)event.detail), event.mac[0], event.mac[1],
+                         event.mac[2], event.mac[3], event.mac[4], event.mac[5]);
+#if LIVE_FEED_ENABLED
+                    live_feed_post(LIVE_FEED_ROGUE_AP, event.timestamp_ms, "Rogue AP %s %02X:%02X:%02X:%02X:%02X:%02X",
+                                   ap_anomaly_name((ap_anomaly_t)event.detail), event.mac[0], event.mac[1],
+                                   event.mac[2], event.mac[3], event.mac[4], event.mac[5]);
+#endif
+                } else if (event.type == SCAN_EVENT_DEVICE_APPEARED) {
+#if LIVE_FEED_ENABLED
+                    live_feed_post(LIVE_FEED_DEVICE, event.timestamp_ms, "New %s %02X:%02X:%02X:%02X:%02X:%02X %d dBm",
+                                   event.kind == DEVICE_KIND_WIFI_AP ? "AP" : "BLE", event.mac[0], event.mac[1],
+                                   event.mac[2], event.mac[3], event.mac[4], event.mac[5], event.rssi);
+#endif
+                }
+            } while (xQueueReceive(scan_event_queue, &event, 0) == pdTRUE);
+            
+            // One wake for the whole burst, in case the ticker is on screen
+            if (live_feed_sequence() != feed_sequence) {
+                ui_notify(UI_EVENT_FEED);
+            }
+        }
+        loop_timing_start(LOOP_AI);
+        mem_arena_reset(&scratch);
+        
+        // Full clock for the decision, then back to idle speed
+        power_manager_acquire(POWER_CLIENT_AI);
+        
+        // Cycle boundary: a freshly uploaded model takes over from here,
+        // with latency and margin figures of its own
+        if (ai_inference_poll_update()) {
+            ai_telemetry_reset();
+        }
+        
+        // A model kept only as a file comes within reach once boot has
+        // mounted LittleFS and the card, the system task being created last
+        if (!model_retried && system_task_handle != NULL) {
+            model_retried = true;
+            ai_inference_stats_t loaded;
+            ai_inference_get_stats(&loaded);
+            if (!loaded.model_loaded && ai_inference_init()) {
+                LOGI(AI, "🧠 Inference backend: %s", ai_inference_backend_name());
+                ai_telemetry_reset();
+            }
+        }
+        
+        // Get a consistent copy of the latest sensor data and features (never blocks)
+        sensor_snapshot_read(&local_sensor_data);
+        sensor_snapshot_read_features(&local_features);
+        bool fresh = ai_sequence_push(&local_features);
+        if (fresh) {
+            // Each new cycle also teaches this site's thresholds
+            site_thresholds_observe(&local_sensor_data);
+#if TRACE_LOG_ENABLED
+            // ...and is recorded for replay on a host
+            scan_histograms_t* histograms =
+                (scan_histograms_t*)mem_arena_alloc(&scratch, sizeof(scan_histograms_t), 16);
+            if (histograms != NULL) {
+                sensor_snapshot_read_histograms(histograms);
+                trace_log_append(&local_sensor_data, histograms, local_features.timestamp_ms);
+            }
+#endif
         }
+        site_thresholds_tick(millis());
         
-        // Perform AI inference
-        ai_state_t new_state = analyze_behavior(&local_sensor_data);
+#if BASELINE_ENABLED
+        // Learning progress is how much of the week has a baseline
+        learning_progress = baseline_coverage_pct();
+#else
+        site_thresholds_t site;
+        site_thresholds_get(&site);
+        learning_progress = site.progress_pct;
+#endif
+        
+        // Perform AI inference; the rules decide whenever the model cannot
+        TRACE_EVENT(TRACE_INFER_BEGIN, 0, 0);
+        int64_t decide_start_us = esp_timer_get_time();
+        ai_state_t proposed;
+        float confidence = 1.0f;
+        bool model_decided = ai_inference_run(&local_features, &proposed);
+        if (!model_decided) {
+            proposed = analyze_behavior(&local_sensor_data, ai_sequence_state());
+        }
+        uint32_t decide_us = (uint32_t)(esp_timer_get_time() - decide_start_us);
+        TRACE_EVENT(TRACE_INFER_END, proposed, model_decided);
+        latency_trace_mark(trace, LATENCY_STAGE_INFERENCE);
+        
+        // Time one decision per scan cycle; re-evaluations reuse the result
+        ai_inference_stats_t inference;
+        ai_inference_get_stats(&inference);
+        if (model_decided) {
+            confidence = inference.last_confidence;
+        }
+        if (fresh) {
+            ai_telemetry_record(decide_us, model_decided,
+                                inference.model_loaded ? inference.last_margin : -1.0f);
+        }
+#if AP_ANOMALY_ENABLED
+        // A rogue access point nearby holds the unit on alert for a while
+        if (anomaly_ms != 0 && millis() - anomaly_ms < AP_ANOMALY_HOLD_MS) {
+            proposed = AI_STATE_EXCITED;
+            confidence = 1.0f;
+        }
+#endif
+#if FIRMWARE_UPDATE_ENABLED
+        // A firmware image being written overrides the scene until the restart
+        if (firmware_update_in_progress()) {
+            proposed = AI_STATE_UPDATING;
+            confidence = 1.0f;
+        }
+#endif
         
-        // Check if state changed
-        if (new_state != current_ai_state) {
-            log_state_change(current_ai_state, new_state);
+        // Only committed transitions reach the UI, the resource governor and the log
+        ai_state_t new_state;
+        if (ai_transition_update(proposed, confidence, millis(), &new_state)) {
+            log_state_change(current_ai_state, new_state, confidence);
+#if LIVE_FEED_ENABLED
+            live_feed_post(LIVE_FEED_STATE, millis(), "%s -> %s (%.0f%%)", ai_state_to_string(current_ai_state),
+                           ai_state_to_string(new_state), confidence * 100.0f);
+#endif
             
-            // Send state change to UI task
-            if (xQueueSend(ai_state_queue, &new_state, pdMS_TO_TICKS(10)) != pdTRUE) {
-                Serial.println("⚠️  Failed to send AI state to UI");
+            // Publish the state; the UI task is woken as a subscriber
+            ai_state_publication_t* published =
+                (ai_state_publication_t*)data_bus_begin_publish(BUS_TOPIC_AI_STATE);
+            if (published != NULL) {
+                published->previous = current_ai_state;
+                published->state = new_state;
+                published->confidence = confidence;
+                published->entered_ms = millis();
+                published->transitions++;
+                published->trace = trace;
+                latency_trace_mark(trace, LATENCY_STAGE_COMMIT);
+                data_bus_publish(BUS_TOPIC_AI_STATE);
             }
             
-            // Update learning metrics
-            update_learning_metrics(new_state);
+            // Scan profile, clock floor and log levels follow the new state
+            governor_apply(new_state, millis());
+#if CAPTURE_BURST_ENABLED && PACKET_CAPTURE_ENABLED
+            if (new_state == AI_STATE_EXCITED) {
+                capture_burst_trigger(CAPTURE_BURST_EXCITED, 0, millis());
+            }
+#endif
             
             previous_state = current_ai_state;
             current_ai_state = new_state;
+            state_entered_ms = millis();
             state_duration = 0;
         } else {
-            state_duration += AI_UPDATE_INTERVAL;
-        }
-        
-        // Log AI metrics periodically
-        static uint32_t last_log_time = 0;
-        if (millis() - last_log_time > 30000) { // Every 30 seconds
-            Serial.printf("🧠 AI Metrics: State=%s, Duration=%lums, Excitement=%lu, Learning=%lu\n",
-                         ai_state_to_string(current_ai_state), state_duration, 
-                         excitement_level, learning_progress);
-            last_log_time = millis();
+            state_duration = millis() - state_entered_ms;
+            latency_trace_end(trace, LATENCY_END_HELD);
         }
-        
-        // Sleep until next inference cycle
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(AI_UPDATE_INTERVAL));
+        // Per-state time and the transition matrix, kept across restarts
+        ai_state_stats_tick(current_ai_state, millis());
+#if WARM_START_ENABLED
+        snapshot_warm_start();
+#endif
+        power_manager_release(POWER_CLIENT_AI);
+        loop_timing_finish(LOOP_AI, AI_UPDATE_INTERVAL);
     }
 }
 
 /**
- * @brief Analyze sensor data and determine AI behavior state
+ * @brief Log the AI metrics (system task timer)
+ *
+ * Reads this task's word-sized figures as they stand; a line a decision
+ * late is no matter for a log.
  */
-ai_state_t analyze_behavior(const sensor_data_t* data) {
-    // Check for error conditions first
-    if (data->free_memory < LOW_MEMORY_THRESHOLD) {
-        return AI_STATE_ERROR;
-    }
-    
-    // Check for high activity states
-    if (data->wifi_networks_count >= HIGH_WIFI_ACTIVITY_THRESHOLD) {
-        excitement_level = min(excitement_level + 5, (uint32_t)100);
-        
-        if (excitement_level > 80) {
-            return AI_STATE_EXCITED;
-        } else {
-            return AI_STATE_SNIFFING;
-        }
-    }
-    
-    // Check for BLE tracking mode
-    if (data->ble_devices_count > 5 && data->ble_signal_strength > STRONG_BLE_SIGNAL_THRESHOLD) {
-        return AI_STATE_TRACKING;
-    }
-    
-    // Learning state when processing data
-    if (current_ai_state == AI_STATE_SNIFFING && state_duration > 5000) {
-        learning_progress = min(learning_progress + 10, (uint32_t)100);
-        return AI_STATE_LEARNING;
-    }
-    
-    // Sleep state during low activity
-    if (data->wifi_networks_count == 0 && data->ble_devices_count == 0 && 
-        !data->user_interaction && state_duration > 60000) {
-        excitement_level = max((int32_t)excitement_level - 2, 0);
-        return AI_STATE_SLEEPING;
-    }
-    
-    // Gradually reduce excitement over time
-    if (millis() % 10000 == 0) { // Every 10 seconds
-        excitement_level = max((int32_t)excitement_level - 1, 0);
-    }
-    
-    // Default to idle state
-    return AI_STATE_IDLE;
+static void ai_metrics_timer(void* arg) {
+    ai_transition_stats_t transitions;
+    ai_telemetry_t telemetry;
+    ai_transition_get_stats(&transitions);
+    ai_telemetry_get(&telemetry);
+    LOGI(AI, "🧠 AI Metrics: State=%s (%.2f), Duration=%lums, Excitement=%lu, Learning=%lu, Dropped events=%lu, Transitions=%lu/%lu suppressed",
+        ai_state_to_string(current_ai_state), transitions.confidence, state_duration, 
+        excitement_level, learning_progress, events_dropped,
+        transitions.transitions, transitions.suppressed);
+    LOGI(AI, "🧠 Inference: %lu decisions, %lu/%lu/%lu/%luus min/avg/p99/max, margin %.2f avg %.2f min",
+        telemetry.decisions, telemetry.min_us, telemetry.avg_us,
+        telemetry.p99_us, telemetry.max_us,
+        telemetry.mean_margin, telemetry.min_margin);
+    timer_wheel_set_period(metrics_timer, (uint32_t)tunable_get(TUNABLE_LOG_INTERVAL_MS));
 }
 
 /**
- * @brief Update learning metrics based on state transitions
+ * @brief Analyze sensor data and determine AI behavior state
+ *
+ * Activity levels come from the recurrent state of the feature history,
+ * so a single cycle on either side of a threshold does not flip the state.
+ * Until the first feature vector arrives the raw readings are used. The
+ * thresholds are the ones learned at this site once there are enough
+ * cycles, and the decision itself is the compiled rule set selected by
+ * AI_RULE_PROFILE.
  */
-void update_learning_metrics(ai_state_t new_state) {
-    switch (new_state) {
-        case AI_STATE_LEARNING:
-            learning_progress += 5;
-            break;
-            
-        case AI_STATE_EXCITED:
-            excitement_level = min(excitement_level + 10, (uint32_t)100);
-            break;
-            
-        case AI_STATE_SLEEPING:
-            // Reset some metrics during sleep
-            if (learning_progress > 20) {
-                learning_progress -= 2;
-            }
-            break;
-            
-        default:
-            break;
-    }
+ai_state_t analyze_behavior(const sensor_data_t* data, const ai_sequence_state_t* seq) {
+    bool history = seq->length > 0;
+    ai_rule_input_t in;
+    in.data = data;
+    in.wifi_networks = history ? seq->hidden[AI_FEATURE_WIFI_COUNT] * MAX_WIFI_NETWORKS
+                               : data->wifi_networks_count;
+    in.ble_devices = history ? seq->hidden[AI_FEATURE_BLE_COUNT] * BLE_RECORD_CAPACITY
+                             : data->ble_devices_count;
+    in.current = current_ai_state;
+    in.state_duration_ms = state_duration;
+    
+    site_thresholds_t site;
+    site_thresholds_get(&site);
+    in.wifi_high = site.wifi_high;
+    
+    // Excitement is sustained activity: 50 at the threshold over the whole
+    // window, 100 at twice the threshold
+    float window_wifi = history ? seq->mean[AI_FEATURE_WIFI_COUNT] * MAX_WIFI_NETWORKS : 0.0f;
+    float excitement = 50.0f * window_wifi * seq->length /
+                       (site.wifi_high * AI_SEQUENCE_WINDOW);
+    excitement_level = (uint32_t)min(excitement, 100.0f);
+    in.excitement = excitement_level;
     
-    // Cap metrics at reasonable values
-    learning_progress = min(learning_progress, (uint32_t)100);
-    excitement_level = min(excitement_level, (uint32_t)100);
+    return ai_rules_t::evaluate(in);
 }
 
 /**
  * @brief Log state changes for debugging and analysis
  */
-void log_state_change(ai_state_t old_state, ai_state_t new_state) {
-    Serial.printf("🧠 AI State Change: %s -> %s (Duration: %lums)\n",
-                  ai_state_to_string(old_state),
-                  ai_state_to_string(new_state),
-                  state_duration);
+void log_state_change(ai_state_t old_state, ai_state_t new_state, float confidence) {
+    LOGI(AI, "🧠 AI State Change: %s -> %s (Duration: %lums)",
+         ai_state_to_string(old_state),
+         ai_state_to_string(new_state),
+         state_duration);
     
-    // TODO: Log to SD card if available for long-term analysis
+#if SCAN_LOG_ENABLED
+    // A forcing point: the transition reaches the card on the next worker pass
+    scan_log_state_t record;
+    memset(&record, 0, sizeof(record));
+    record.from = old_state;
+    record.to = new_state;
+    record.confidence = confidence;
+    record.duration_ms = state_duration;
+    scan_log_append(SCAN_LOG_STATE_CHANGE, &record, sizeof(record), true);
+#endif
 }
+
 /**
- * @file ai_task.cpp
- * @brief AI inference and decision making task
+ * @brief Pick up where the last boot left off, from the snapshot read in setup()
+ *
+ * current_ai_state was set from it before the tasks started; the UI and
+ * the scan profile are told here, as after a transition.
  */
+static void restore_warm_start(void) {
+    warm_start_snapshot_t snapshot;
+    if (!warm_start_restored(&snapshot)) {
+        return;
+    }
+    previous_state = (ai_state_t)snapshot.previous_state;
+    excitement_level = snapshot.excitement;
+    learning_progress = snapshot.learning_progress;
+    ai_sequence_seed(snapshot.hidden);
 
-#include <Arduino.h>
-#include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
-#include <freertos/queue.h>
-#include "config.h"
-#include "ai_states.h"
-
-// External variables
-extern sensor_data_t global_sensor_data;
-extern SemaphoreHandle_t sensor_data_mutex;
-extern QueueHandle_t ai_state_queue;
-extern ai_state_t current_ai_state;
+    ai_state_publication_t* published =
+        (ai_state_publication_t*)data_bus_begin_publish(BUS_TOPIC_AI_STATE);
+    if (published != NULL) {
+        published->previous = previous_state;
+        published->state = current_ai_state;
+        published->confidence = 1.0f;
+        published->entered_ms = millis();
+        published->trace = 0;
+        data_bus_publish(BUS_TOPIC_AI_STATE);
+    }
+    governor_apply(current_ai_state, millis());
+}
 
 /**
- * @brief AI Task - performs state inference and decision making
+ * @brief Hand the state after this decision to the warm start snapshot
  */
-void ai_task(void* parameter) {
-    Serial.println("🧠 AI Task started");
-    
-    TickType_t last_wake_time = xTaskGetTickCount();
-    sensor_data_t local_sensor_data;
-    
-    while (true) {
-        // Copy sensor data safely
-        if (xSemaphoreTake(sensor_data_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-            memcpy(&local_sensor_data, &global_sensor_data, sizeof(sensor_data_t));
-            xSemaphoreGive(sensor_data_mutex);
-        }
-        
-        // Perform AI inference
-        ai_state_t new_state = infer_ai_state(&local_sensor_data);
-        
-        // Update state if changed
-        if (new_state != current_ai_state) {
-            current_ai_state = new_state;
-            
-            // Send state change to UI task
-            if (ai_state_queue != NULL) {
-                xQueueSend(ai_state_queue, &new_state, 0);
-            }
-            
-            Serial.printf("🧠 AI State changed to: %s %s\n", 
-                         ai_state_to_string(new_state),
-                         ai_state_to_emoji(new_state));
-        }
-        
-        // Sleep until next inference cycle
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(AI_UPDATE_INTERVAL));
-    }
+static void snapshot_warm_start(void) {
+    warm_start_snapshot_t snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.state = current_ai_state;
+    snapshot.previous_state = previous_state;
+    snapshot.excitement = (uint8_t)excitement_level;
+    snapshot.learning_progress = (uint8_t)learning_progress;
+    snapshot.state_age_ms = state_duration;
+    memcpy(snapshot.hidden, ai_sequence_state()->hidden, sizeof(snapshot.hidden));
+    warm_start_update(&snapshot);
 }
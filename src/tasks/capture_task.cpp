@@ -0,0 +1,136 @@
+/**
+ * @file capture_task.cpp
+ * @brief Consumer stage for the promiscuous capture pipeline
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "ai_states.h"
+#include "packet_capture.h"
+#include "channel_hopper.h"
+#include "pcap_export.h"
+#include "capture_burst.h"
+#include "ble_scan.h"
+#include "airtime.h"
+#include "handshake_watch.h"
+#include "data_bus.h"
+#include "supervisor.h"
+#include "loop_timing.h"
+#include "logger.h"
+
+// Forward declarations
+void publish_capture_stats(void);
+
+/**
+ * @brief Capture Task - drains the frame ring and publishes traffic stats
+ */
+void capture_task(void* parameter) {
+    LOGI(CAPTURE, "🛰️ Capture Task started");
+
+    if (!capture_init() || !capture_start()) {
+        LOGE(CAPTURE, "❌ Packet capture unavailable - stopping Capture Task");
+        supervisor_retire(SUPERVISED_CAPTURE);
+        vTaskDelete(NULL);
+        return;
+    }
+
+#if CHANNEL_HOPPING_ENABLED
+    hopper_init();
+#endif
+#if PCAP_EXPORT_ENABLED
+    pcap_export_init();
+#endif
+
+    while (true) {
+        loop_timing_start(LOOP_CAPTURE);
+        uint32_t drain_ms = CAPTURE_DRAIN_INTERVAL_MS;
+#if CAPTURE_BURST_ENABLED && CHANNEL_HOPPING_ENABLED
+        // A burst drains at a higher rate, hurries the card writes and has
+        // the radio to itself; the scan task holds its WiFi sweeps meanwhile
+        static bool was_in_burst = false;
+        bool in_burst = capture_burst_active(millis());
+        if (in_burst) {
+            drain_ms = CAPTURE_BURST_DRAIN_MS;
+        }
+        if (in_burst != was_in_burst) {
+            was_in_burst = in_burst;
+            ble_scan_pause(in_burst);
+#if PCAP_EXPORT_ENABLED
+            pcap_export_set_burst(in_burst);
+#endif
+        }
+#endif
+        capture_process(CAPTURE_RING_SLOTS);
+#if PCAP_EXPORT_ENABLED
+        pcap_export_tick(millis());
+#endif
+
+#if CHANNEL_HOPPING_ENABLED
+        // Scores use the frames just drained, so hop after processing
+        hopper_tick(millis());
+#endif
+
+        if (capture_roll_window(millis())) {
+            publish_capture_stats();
+        }
+
+        uint32_t period_ms = loop_timing_finish(LOOP_CAPTURE, drain_ms);
+        supervisor_checkin(SUPERVISED_CAPTURE, period_ms);
+        vTaskDelay(pdMS_TO_TICKS(period_ms));
+    }
+}
+
+/**
+ * @brief Copy the latest capture window into global sensor data
+ */
+void publish_capture_stats(void) {
+    capture_stats_t stats;
+    capture_get_stats(&stats);
+
+    hopper_stats_t hops;
+    memset(&hops, 0, sizeof(hops));
+#if CHANNEL_HOPPING_ENABLED
+    hopper_get_stats(&hops);
+#endif
+    airtime_stats_t air;
+    memset(&air, 0, sizeof(air));
+#if AIRTIME_ENABLED
+    airtime_get_stats(&air);
+#endif
+    handshake_stats_t handshakes;
+    memset(&handshakes, 0, sizeof(handshakes));
+#if HANDSHAKE_WATCH_ENABLED
+    handshake_watch_get_stats(&handshakes);
+#endif
+    uint32_t window_ms = max(handshakes.window_ms, (uint32_t)1);
+    uint32_t associations = handshakes.window[HANDSHAKE_ASSOC] + handshakes.window[HANDSHAKE_REASSOC];
+
+    // Publish on the capture topic; readers see it in the sensor data
+    capture_publication_t* capture = (capture_publication_t*)data_bus_begin_publish(BUS_TOPIC_CAPTURE);
+    if (capture != NULL) {
+        capture->capture_frames_per_second = stats.frames_per_second;
+        capture->probe_requests = stats.probe_requests;
+        capture->wifi_clients_count = stats.client_count;
+        capture->randomized_clients = stats.randomized_clients;
+        capture->busiest_bssid_fps = stats.busiest_bssid_fps;
+        capture->hop_channel = hops.current_channel;
+        capture->busiest_channel = hops.busiest_channel;
+        capture->busiest_channel_fps = hops.busiest_channel_fps;
+        capture->airtime_permille = air.permille;
+        capture->busiest_airtime_permille = air.busiest_permille;
+        capture->busiest_airtime_channel = air.busiest_channel;
+        capture->associations_per_min = (uint8_t)min(associations * 60000 / window_ms, (uint32_t)UINT8_MAX);
+        capture->handshakes_per_min =
+            (uint8_t)min((uint32_t)handshakes.window[HANDSHAKE_COMPLETE] * 60000 / window_ms, (uint32_t)UINT8_MAX);
+        data_bus_publish(BUS_TOPIC_CAPTURE);
+    }
+
+    static uint32_t last_dropped = 0;
+    if (stats.frames_dropped != last_dropped) {
+        LOGW(CAPTURE, "⚠️  Capture ring overflow: %lu frames dropped",
+             stats.frames_dropped - last_dropped);
+        last_dropped = stats.frames_dropped;
+    }
+}
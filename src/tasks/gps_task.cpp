@@ -0,0 +1,35 @@
+/**
+ * @file gps_task.cpp
+ * @brief Reader of the NMEA receiver for wardriving
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "gps.h"
+#include "supervisor.h"
+#include "logger.h"
+
+/**
+ * @brief GPS Task - parses the receiver's sentences as they arrive
+ *
+ * Low priority and blocked on the UART nearly all the time; a read
+ * returns after GPS_READ_TIMEOUT_MS at most, so the task checks in even
+ * with the receiver unplugged.
+ */
+void gps_task(void* parameter) {
+    LOGI(SCAN, "🛰️ GPS Task started");
+
+    if (!gps_init()) {
+        LOGE(SCAN, "❌ GPS unavailable - stopping GPS Task");
+        supervisor_retire(SUPERVISED_GPS);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (true) {
+        gps_poll();
+        supervisor_checkin(SUPERVISED_GPS, GPS_READ_TIMEOUT_MS);
+    }
+}
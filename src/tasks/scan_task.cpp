@@ -1,221 +1,904 @@
 /**
  * @file scan_task.cpp
  * @brief Network scanning task for WiFi and BLE detection
+ *
+ * The task runs protothreads (protothread.h) rather than one blocking
+ * loop: the cycle thread sweeps, folds and publishes, then sleeps to the
+ * next cycle, and the targets thread uses that sleep for passes over the
+ * pinned devices. Each waits on the radio with co-operative waits, so
+ * the flow reads in order while the task itself only ever blocks on its
+ * notification value. Every wait stores what must outlive it in
+ * cycle_ctx or targets_ctx.
  */
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <BLEDevice.h>
-#include <BLEScan.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/queue.h>
+#include <esp_timer.h>
 #include "config.h"
 #include "ai_states.h"
+#include "wifi_scan.h"
+#include "scan_scheduler.h"
+#include "ble_scan.h"
+#include "device_table.h"
+#include "device_tier.h"
+#include "telemetry_summary.h"
+#include "rssi_histogram.h"
+#include "sensor_snapshot.h"
+#include "data_bus.h"
+#include "job_pool.h"
+#include "scan_events.h"
+#include "scan_interval.h"
+#include "mesh_sync.h"
+#include "radio_link.h"
+#include "wifi_link.h"
+#include "novelty_filter.h"
+#include "baseline.h"
+#include "cooccurrence.h"
+#include "ap_anomaly.h"
+#include "location.h"
+#include "capture_burst.h"
+#include "rssi_kernels.h"
+#include "thermal.h"
+#include "governor.h"
+#include "power_manager.h"
+#include "supervisor.h"
+#include "loop_timing.h"
+#include "event_trace.h"
+#include "scan_log.h"
+#include "sighting_archive.h"
+#include "sighting_log.h"
+#include "scan_source.h"
+#include "scan_synth.h"
+#include "soak.h"
+#include "wake_sources.h"
+#include "fleet_commands.h"
+#include "mem_policy.h"
+#include "wardrive.h"
+#include "geo_store.h"
+#include "scan_targets.h"
+#include "protothread.h"
+#include "timer_wheel.h"
+#include "latency_trace.h"
+#include "logger.h"
 
 // External variables
-extern sensor_data_t global_sensor_data;
-extern SemaphoreHandle_t sensor_data_mutex;
+extern QueueHandle_t scan_event_queue;
 
-// BLE scanning variables
-BLEScan* ble_scanner = nullptr;
-static std::vector<BLEAdvertisedDevice> ble_devices;
+/**
+ * @brief Results of one scan cycle, staged until they are published together
+ */
+typedef struct {
+    bool     wifi_valid;             // False if the sweep produced no results
+    uint16_t wifi_networks_count;
+    int16_t  wifi_signal_strength;
+    uint16_t ble_devices_count;
+    int16_t  ble_signal_strength;
+    uint16_t ble_class_counts[BLE_CLASS_COUNT];
+    uint16_t novel_devices;          // Appeared devices absent from the long-term history
+    device_delta_t delta;
+    scan_histograms_t histograms;
+} scan_cycle_t;
+
+// One cycle's RSSI columns and BLE sightings, each 16-byte aligned
+#define SCAN_SCRATCH_BYTES (MAX_WIFI_NETWORKS + BLE_RECORD_CAPACITY * (sizeof(ble_sighting_t) + 1) + 3 * 16)
+
+// Bits the threads post each other; WIFI_SCAN_NOTIFY_BIT comes from the scan engine
+#define SCAN_PT_CYCLE_DONE (1UL << 8)       // A cycle is published; passes may run until the next
+#define SCAN_PT_RADIO_FREE (1UL << 9)       // The target passes are over for this interval
 
-// WiFi scanning results
-static int32_t wifi_networks[MAX_WIFI_NETWORKS];
-static String wifi_ssids[MAX_WIFI_NETWORKS];
+/**
+ * @brief One channel's scan, run as a child thread
+ */
+typedef struct {
+    pt_t           pt;
+    uint8_t        channel;
+    uint16_t       dwell_ms;
+    bool           passive;
+    const uint8_t* bssid;           // Only report this BSSID (NULL = all)
+    bool           scanned;         // The scan ran to its end; false if skipped or refused
+} dwell_ctx_t;
 
-// Forward declarations
-void scan_wifi_networks(void);
-void scan_ble_devices(void);
-void process_scan_results(void);
-void log_interesting_networks(void);
+/**
+ * @brief What the cycle thread keeps across its waits
+ */
+typedef struct {
+    const scan_profile_t* profile;
+    scan_slot_t slot;
+    uint8_t     channel;            // Within a WiFi slot
+    uint32_t    interval_ms;
+    uint32_t    wake_ms;            // When the next cycle starts
+    pt_t        sweep;
+    dwell_ctx_t dwell;
+} cycle_ctx_t;
 
 /**
- * @brief BLE scan callback class
+ * @brief What the targets thread keeps across its waits
  */
-class MyAdvertisedDeviceCallbacks: public BLEAdvertisedDeviceCallbacks {
-    void onResult(BLEAdvertisedDevice advertisedDevice) {
-        if (ble_devices.size() < MAX_BLE_DEVICES) {
-            ble_devices.push_back(advertisedDevice);
-        }
-    }
+typedef struct {
+    scan_target_t targets[SCAN_TARGET_MAX];
+    uint8_t     count;
+    uint8_t     index;
+    bool        radio_free;         // No capture burst holding the radio
+    bool        running;            // Between the first pass and the last
+    uint32_t    pass_ms;            // Start of the current pass
+    dwell_ctx_t dwell;
+} targets_ctx_t;
+
+static scan_cycle_t cycle;
+static mem_arena_t scratch;                 // Emptied at the top of every cycle
+static uint16_t events_dropped = 0;
+static uint16_t cycle_trace = 0;            // Latency trace opened by the cycle's first new device
+static uint32_t last_gestures = 0;          // Gestures published by the last cycle
+static pt_sched_t threads;
+static pt_thread_t cycle_thread_state;
+static cycle_ctx_t cycle_ctx;
+#if SCAN_TARGETS_ENABLED
+static pt_thread_t targets_thread_state;
+static targets_ctx_t targets_ctx;
+#endif
+
+// The radios, unless a soak run or a stress build feeds the cycles instead
+static const scan_source_t radio_source = {
+    "radio",
+    radio_init,
+    NULL,                           // Swept by sweep_thread(), without blocking the task
+    radio_wifi_results,
+    wifi_scan_release,
+    ble_scan_take_sightings,
+    ble_scan_expire,
+    ble_scan_get_summary,
+    radio_interval_ms
 };
+#if SOAK_ENABLED
+static const scan_source_t* const source = &soak_scan_source;
+#elif SCAN_SYNTH_ENABLED
+static const scan_source_t* const source = &scan_synth_source;
+#else
+static const scan_source_t* const source = &radio_source;
+#endif
+
+// Forward declarations
+static bool radio_init(void);
+static bool radio_wifi_results(const wifi_record_t** records, uint16_t* count);
+static uint32_t radio_interval_ms(uint32_t planned_ms);
+static pt_status_t cycle_thread(pt_t* pt);
+static pt_status_t sweep_thread(pt_t* pt);
+static pt_status_t dwell_thread(dwell_ctx_t* dwell);
+static void dwell_setup(dwell_ctx_t* dwell, uint8_t channel, uint16_t dwell_ms, bool passive,
+                        const uint8_t* bssid);
+static uint32_t finish_cycle(const scan_profile_t* profile);
+#if SCAN_TARGETS_ENABLED
+static pt_status_t targets_thread(pt_t* pt);
+static bool target_dwell_setup(const scan_target_t* target);
+static void target_note_wifi(const scan_target_t* target);
+#endif
+void collect_wifi_results(void);
+void scan_ble_devices(void);
+void process_scan_results(void);
+static void network_summary_timer(void* arg);
+static void print_network_summary(void* payload);
+void handle_device_event(device_event_t event, device_entry_t* entry);
+void post_cycle_event(void);
 
 /**
  * @brief Scan Task - performs WiFi and BLE network scanning
  */
 void scan_task(void* parameter) {
-    Serial.println("📡 Scan Task started");
+    LOGI(SCAN, "📡 Scan Task started");
 
-    // Initialize BLE scanner
-    BLEDevice::init("HydraESP-Scanner");
-    ble_scanner = BLEDevice::getScan();
-    ble_scanner->setAdvertisedDeviceCallbacks(new MyAdvertisedDeviceCallbacks());
-    ble_scanner->setActiveScan(true);
-    ble_scanner->setInterval(100);
-    ble_scanner->setWindow(99);
+    // Persistent device table for cross-cycle deltas
+    if (!device_table_init(DEVICE_TABLE_CAPACITY)) {
+        LOGE(SCAN, "❌ Device table allocation failed");
+    }
+    device_table_set_event_handler(handle_device_event);
+#if TIER_ENABLED
+    device_tier_init();
+#endif
+#if SUMMARY_ENABLED
+    telemetry_summary_init();
+#endif
+#if NOVELTY_FILTER_ENABLED
+    novelty_filter_init();
+#endif
+#if BASELINE_ENABLED
+    baseline_init();
+#endif
+#if COOCCURRENCE_ENABLED
+    cooccurrence_init();
+#endif
+#if AP_ANOMALY_ENABLED
+    ap_anomaly_init();
+#endif
+#if LOCATION_ENABLED
+    location_init();
+#endif
+#if ARCHIVE_ENABLED
+    sighting_archive_init();
+#endif
+#if WARDRIVE_ENABLED && GEO_STORE_ENABLED
+    geo_store_init();
+#endif
+
+    // Start the continuous BLE observer and the async WiFi scan engine,
+    // or whatever stands in for them
+    if (!source->init()) {
+        LOGE(SCAN, "❌ Scan source '%s' failed to start", source->name);
+    }
 
-    Serial.println("✅ BLE scanner initialized");
+#if MESH_SYNC_ENABLED
+    mesh_sync_init();
+#endif
+#if RADIO_LINK_ENABLED
+    radio_link_init();
+#endif
+    scan_scheduler_init();
+    scan_interval_init();
+    // The activity summary comes off the published snapshot, on the system task's timer
+    timer_wheel_start("network summary", NETWORK_SUMMARY_INTERVAL_MS, NETWORK_SUMMARY_INTERVAL_MS,
+                      network_summary_timer, NULL);
+    if (!mem_arena_init(&scratch, "scan", MEM_HOT_CPU, SCAN_SCRATCH_BYTES)) {
+        LOGE(SCAN, "❌ Scan scratch allocation failed - results will not be folded");
+    }
 
-    TickType_t last_wake_time = xTaskGetTickCount();
+    // Target passes only run while the cycle thread sleeps; neither blocks the other
+    pt_sched_init(&threads);
+    pt_sched_add(&threads, &cycle_thread_state, "cycle", cycle_thread);
+#if SCAN_TARGETS_ENABLED
+    // Stand-in sources have no radio to point at a target
+    if (source == &radio_source) {
+        pt_sched_add(&threads, &targets_thread_state, "targets", targets_thread);
+    }
+#endif
+    pt_sched_run(&threads);
 
-    while (true) {
-        Serial.println("📡 Starting network scan cycle...");
+    LOGE(SCAN, "❌ Scan threads exited");
+    vTaskDelete(NULL);
+}
 
-        // Scan WiFi networks
-        scan_wifi_networks();
+/**
+ * @brief Sweep, fold and publish a cycle, then sleep until the next is due
+ */
+static pt_status_t cycle_thread(pt_t* pt) {
+    PT_BEGIN(pt);
+    cycle_ctx.wake_ms = millis();
 
-        // Scan BLE devices  
-        scan_ble_devices();
+    while (true) {
+#if CAPTURE_BURST_ENABLED && PACKET_CAPTURE_ENABLED && CHANNEL_HOPPING_ENABLED
+        // Hold the sweep while a capture burst has the radio
+        while (capture_burst_active(millis())) {
+            supervisor_checkin(SUPERVISED_SCAN, CAPTURE_BURST_WAIT_MS);
+            PT_SLEEP_MS(pt, CAPTURE_BURST_WAIT_MS);
+        }
+#endif
+        loop_timing_start(LOOP_SCAN);
+        TRACE_EVENT(TRACE_SCAN_BEGIN, 0, 0);
+        LOGI(SCAN, "📡 Starting network scan cycle...");
+
+        // Run the interleaved WiFi channel / BLE window plan, or the stand-in's cycle
+        power_manager_acquire(POWER_CLIENT_SCAN);
+        cycle_ctx.profile = scan_scheduler_begin_cycle();
+#if SCAN_TARGETS_ENABLED
+        // The full sweep hears everyone, not only the targets
+        scan_targets_end_phase();
+#endif
+        if (source->sweep == NULL) {
+            PT_SPAWN(pt, &cycle_ctx.sweep, sweep_thread(&cycle_ctx.sweep));
+        } else {
+            source->sweep(cycle_ctx.profile);
+        }
+        cycle_ctx.interval_ms = finish_cycle(cycle_ctx.profile);
 
-        // Process and update global sensor data
-        process_scan_results();
+        // Sleep until the next cycle; one that overran starts at once, without catching up
+        supervisor_checkin(SUPERVISED_SCAN, cycle_ctx.interval_ms);
+        cycle_ctx.wake_ms += cycle_ctx.interval_ms;
+        if ((int32_t)(cycle_ctx.wake_ms - millis()) < 0) {
+            cycle_ctx.wake_ms = millis();
+        }
+        pt_sched_post(&threads, SCAN_PT_CYCLE_DONE);
+        PT_SLEEP_UNTIL(pt, cycle_ctx.wake_ms);
+#if SCAN_TARGETS_ENABLED
+        // A target pass still on the radio finishes first
+        PT_WAIT_UNTIL(pt, !targets_ctx.running);
+#endif
+    }
+    PT_END(pt);
+}
 
-        // Log interesting findings
-        log_interesting_networks();
+/**
+ * @brief Fold the swept cycle into sensor data, publish it and plan the next
+ * @return Interval to the next cycle
+ */
+static uint32_t finish_cycle(const scan_profile_t* profile) {
+#if RADIO_LINK_ENABLED
+    radio_link_collect(millis());
+#endif
+
+    // Fold the accumulated results of the cycle into sensor data
+    memset(&cycle, 0, sizeof(cycle));
+    mem_arena_reset(&scratch);
+    collect_wifi_results();
+    scan_ble_devices();
+
+    // Publish WiFi and BLE results of this cycle as one snapshot
+    process_scan_results();
+    TRACE_EVENT(TRACE_SCAN_END, cycle.wifi_networks_count, cycle.ble_devices_count);
+#if SCAN_TARGETS_ENABLED
+    // The AI's targets follow the committed state and the followers just folded
+    scan_targets_cycle(millis());
+#endif
+
+#if MESH_SYNC_ENABLED
+    // Share this cycle's changes with nearby nodes
+    mesh_sync_tick(millis());
+#endif
+
+    power_manager_release(POWER_CLIENT_SCAN);
+
+#if FLEET_ENABLED
+    // Remote commands land here, with the cycle published and the next unplanned
+    fleet_commands_apply();
+#endif
+
+    // Stretch the interval in a static environment, shrink it on churn;
+    // a hot die holds it at the ceiling. The AI state scales the base
+    uint32_t interval_ms = governor_scan_interval_ms(profile->interval_ms);
+    bool thermal_hold = thermal_level() >= THERMAL_SCAN_THROTTLED;
+#if SCAN_ADAPT_ENABLED
+    interval_ms = scan_interval_update(&cycle.delta, interval_ms, thermal_hold);
+#else
+    if (thermal_hold) {
+        interval_ms = interval_ms * SCAN_ADAPT_CEILING_PCT / 100;
+    }
+#endif
+#if WARDRIVE_ENABLED
+    // Closer sweeps on the move, sparser parked; the heat hold still wins
+    if (!thermal_hold) {
+        interval_ms = wardrive_interval_ms(interval_ms, millis());
+    }
+#endif
+    interval_ms = source->interval_ms(interval_ms);
+    // A sweep longer than its interval would start the next one at once
+    interval_ms = loop_timing_finish(LOOP_SCAN, interval_ms);
+
+    LOGI(SCAN, "📊 Scan complete (%s): %d WiFi, %d BLE devices, next in %lums",
+        profile->name,
+        cycle.wifi_networks_count,
+        cycle.ble_devices_count,
+        interval_ms);
+    return interval_ms;
+}
 
-        Serial.printf("📊 Scan complete: %d WiFi, %d BLE devices\n",
-                     global_sensor_data.wifi_networks_count,
-                     global_sensor_data.ble_devices_count);
+/**
+ * @brief Start the continuous BLE observer and the async WiFi scan engine
+ */
+static bool radio_init(void) {
+    bool ble = ble_scan_init();
+    return wifi_scan_init(NULL) && ble;
+}
 
-        // Sleep until next scan cycle
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(SCAN_INTERVAL));
+/**
+ * @brief Run the profile's slots: WiFi channel dwells and BLE windows
+ */
+static pt_status_t sweep_thread(pt_t* pt) {
+    PT_BEGIN(pt);
+    wifi_scan_begin_sweep();
+    while (scan_scheduler_next_slot(&cycle_ctx.slot)) {
+#if CAPTURE_BURST_ENABLED && PACKET_CAPTURE_ENABLED && CHANNEL_HOPPING_ENABLED
+        // A burst takes the radio; the channels left are swept next cycle
+        if (capture_burst_active(millis())) {
+            break;
+        }
+#endif
+        if (cycle_ctx.slot.type != SCAN_SLOT_WIFI) {
+            // Keep WiFi quiet so the continuous BLE scan gets full airtime
+            PT_SLEEP_MS(pt, cycle_ctx.slot.duration_ms);
+            continue;
+        }
+        // Dwell on the slot's run of channels, one async scan per channel
+        for (cycle_ctx.channel = 1; cycle_ctx.channel <= WIFI_CHANNEL_COUNT; cycle_ctx.channel++) {
+            if ((cycle_ctx.slot.channel_mask & (1 << cycle_ctx.channel)) == 0) {
+                continue;
+            }
+            dwell_setup(&cycle_ctx.dwell, cycle_ctx.channel, scan_scheduler_channel_dwell(cycle_ctx.channel),
+                        cycle_ctx.profile->passive, scan_profile_target_bssid(cycle_ctx.profile));
+            PT_SPAWN(pt, &cycle_ctx.dwell.pt, dwell_thread(&cycle_ctx.dwell));
+        }
     }
+    PT_END(pt);
 }
 
 /**
- * @brief Scan for WiFi networks
+ * @brief Records of the sweep, unless the last channel never finished
  */
-void scan_wifi_networks(void) {
-    Serial.println("📶 Scanning WiFi networks...");
+static bool radio_wifi_results(const wifi_record_t** records, uint16_t* count) {
+    if (wifi_scan_poll() == WIFI_SCAN_STATE_RUNNING) {
+        LOGE(SCAN, "❌ WiFi sweep still running");
+        return false;
+    }
+    *count = wifi_scan_get_results(records);
+    return true;
+}
 
-    // Start WiFi scan
-    int network_count = WiFi.scanNetworks(false, true, false, 300);
+/**
+ * @brief The plan's period, as adapted
+ */
+static uint32_t radio_interval_ms(uint32_t planned_ms) {
+    return planned_ms;
+}
 
-    if (network_count == WIFI_SCAN_FAILED) {
-        Serial.println("❌ WiFi scan failed");
-        return;
-    }
+/**
+ * @brief Describe the channel scan the next dwell_thread() spawn runs
+ */
+static void dwell_setup(dwell_ctx_t* dwell, uint8_t channel, uint16_t dwell_ms, bool passive,
+                        const uint8_t* bssid) {
+    dwell->channel = channel;
+    dwell->dwell_ms = dwell_ms;
+    dwell->passive = passive;
+    dwell->bssid = bssid;
+    dwell->scanned = false;
+}
 
-    // Store results
-    int stored_count = 0;
-    int32_t total_rssi = 0;
+/**
+ * @brief Run one channel's async scan to its end; its records join the table
+ *
+ * Leaves scanned false if the channel was skipped or the scan would not start.
+ */
+static pt_status_t dwell_thread(dwell_ctx_t* dwell) {
+    pt_t* pt = &dwell->pt;
+    PT_BEGIN(pt);
+#if WIFI_LINK_ENABLED
+    // Away from an associated access point only in short, spaced turns
+    if (!wifi_link_claim_radio(dwell->channel, &dwell->dwell_ms)) {
+        PT_EXIT(pt);
+    }
+#endif
+    if (!wifi_scan_start_channel(dwell->channel, dwell->dwell_ms, dwell->passive, dwell->bssid)) {
+#if WIFI_LINK_ENABLED
+        wifi_link_release_radio();
+#endif
+        PT_EXIT(pt);
+    }
 
-    for (int i = 0; i < network_count && stored_count < MAX_WIFI_NETWORKS; i++) {
-        wifi_networks[stored_count] = WiFi.RSSI(i);
-        wifi_ssids[stored_count] = WiFi.SSID(i);
-        total_rssi += WiFi.RSSI(i);
-        stored_count++;
+    while (wifi_scan_poll() == WIFI_SCAN_STATE_RUNNING) {
+        PT_AWAIT_BITS(pt, WIFI_SCAN_NOTIFY_BIT, WIFI_SCAN_TIMEOUT_MS);
+    }
+    wifi_scan_release();
+#if WIFI_LINK_ENABLED
+    wifi_link_release_radio();
+#endif
+    dwell->scanned = true;
+    PT_END(pt);
+}
 
-        // Log interesting networks (hidden, unusual names, etc.)
-        String ssid = WiFi.SSID(i);
-        if (ssid.length() == 0 || ssid.indexOf("Hidden") >= 0 || 
-            ssid.indexOf("_nomap") >= 0 || WiFi.RSSI(i) > -30) {
-            Serial.printf("🎯 Interesting WiFi: '%s' (RSSI: %d dBm)\n", 
-                         ssid.c_str(), WiFi.RSSI(i));
+#if SCAN_TARGETS_ENABLED
+/**
+ * @brief Scan the pinned devices every SCAN_TARGET_PERIOD_MS while the cycle thread sleeps
+ *
+ * Each WiFi target gets a short active scan of its channel filtered on its
+ * BSSID; the BLE targets' records are read, the scan having been narrowed
+ * to them. Stops for the interval at once when nothing is pinned, and a
+ * pass is only started with a whole period left before the next cycle.
+ */
+static pt_status_t targets_thread(pt_t* pt) {
+    PT_BEGIN(pt);
+    while (true) {
+        PT_WAIT_BITS(pt, SCAN_PT_CYCLE_DONE);
+
+        targets_ctx.running = true;
+        while ((int32_t)(cycle_ctx.wake_ms - millis()) > (int32_t)SCAN_TARGET_PERIOD_MS) {
+            targets_ctx.pass_ms = millis();
+            targets_ctx.count = scan_targets_begin_pass(targets_ctx.targets);
+            if (targets_ctx.count == 0) {
+                break;
+            }
+
+            targets_ctx.radio_free = true;
+#if CAPTURE_BURST_ENABLED && PACKET_CAPTURE_ENABLED && CHANNEL_HOPPING_ENABLED
+            targets_ctx.radio_free = !capture_burst_active(millis());
+#endif
+            power_manager_acquire(POWER_CLIENT_SCAN);
+            for (targets_ctx.index = 0; targets_ctx.index < targets_ctx.count && targets_ctx.radio_free;
+                 targets_ctx.index++) {
+                if (!target_dwell_setup(&targets_ctx.targets[targets_ctx.index])) {
+                    continue;
+                }
+                PT_SPAWN(pt, &targets_ctx.dwell.pt, dwell_thread(&targets_ctx.dwell));
+                if (targets_ctx.dwell.scanned) {
+                    target_note_wifi(&targets_ctx.targets[targets_ctx.index]);
+                }
+            }
+            power_manager_release(POWER_CLIENT_SCAN);
+            scan_targets_note_ble();
+
+            supervisor_checkin(SUPERVISED_SCAN, SCAN_TARGET_PERIOD_MS);
+            PT_SLEEP_UNTIL(pt, targets_ctx.pass_ms + SCAN_TARGET_PERIOD_MS);
         }
+        targets_ctx.running = false;
+        pt_sched_post(&threads, SCAN_PT_RADIO_FREE);
     }
+    PT_END(pt);
+}
 
-    // Update global sensor data (thread-safe)
-    if (xSemaphoreTake(sensor_data_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        global_sensor_data.wifi_networks_count = stored_count;
-        global_sensor_data.wifi_signal_strength = stored_count > 0 ? total_rssi / stored_count : -100;
-        xSemaphoreGive(sensor_data_mutex);
+/**
+ * @brief Ready a WiFi target's filtered scan of its channel
+ * @return false for a BLE target or an access point whose channel is not known
+ */
+static bool target_dwell_setup(const scan_target_t* target) {
+    if (target->kind != DEVICE_KIND_WIFI_AP || target->channel == 0) {
+        return false;
     }
+    wifi_scan_clear_records();
+    dwell_setup(&targets_ctx.dwell, target->channel, SCAN_TARGET_DWELL_MS, false, target->mac);
+    return true;
+}
 
-    // Clean up
-    WiFi.scanDelete();
-
-    Serial.printf("✅ WiFi scan complete: %d networks found\n", stored_count);
+/**
+ * @brief Record whether a WiFi target's scan heard it
+ */
+static void target_note_wifi(const scan_target_t* target) {
+    const wifi_record_t* records = NULL;
+    uint16_t stored = wifi_scan_get_results(&records);
+    const wifi_record_t* heard = NULL;
+    for (uint16_t r = 0; r < stored && heard == NULL; r++) {
+        heard = memcmp(records[r].bssid, target->mac, sizeof(target->mac)) == 0 ? &records[r] : NULL;
+    }
+    uint32_t now = millis();
+    if (heard != NULL) {
+        device_table_observe(heard->bssid, DEVICE_KIND_WIFI_AP, heard->rssi, heard->channel,
+                             now, heard->rx_time_us);
+        scan_targets_note_wifi(heard->bssid, true, heard->rssi, heard->channel, now);
+    } else {
+        scan_targets_note_wifi(target->mac, false, 0, 0, now);
+    }
 }
+#endif
 
 /**
- * @brief Scan for BLE devices
+ * @brief Fold the records accumulated during the sweep into sensor data
  */
-void scan_ble_devices(void) {
-    Serial.println("📱 Scanning BLE devices...");
+void collect_wifi_results(void) {
+    const wifi_record_t* records = NULL;
+    uint16_t stored_count = 0;
+    if (!source->wifi_results(&records, &stored_count)) {
+        return;
+    }
+    int8_t* rssi_values = (int8_t*)mem_arena_alloc(&scratch, MAX_WIFI_NETWORKS, 16);
+    if (rssi_values == NULL) {
+        source->wifi_release();
+        return;
+    }
+    uint32_t now = millis();
+    const wifi_record_t* strongest = NULL;
+
+    for (uint16_t i = 0; i < stored_count; i++) {
+        const wifi_record_t* record = &records[i];
+        rssi_values[i] = record->rssi;
+        if (strongest == NULL || record->rssi > strongest->rssi) {
+            strongest = record;
+        }
+        if (record->channel <= WIFI_CHANNEL_COUNT) {
+            rssi_hist_add(&cycle.histograms.wifi_channel[record->channel], record->rssi);
+        }
+#if AP_ANOMALY_ENABLED
+        // Against the table as it was before this sighting
+        ap_anomaly_check_record(record, now);
+#endif
+        device_table_observe(record->bssid, DEVICE_KIND_WIFI_AP, record->rssi, record->channel,
+                             now, record->rx_time_us);
+#if COOCCURRENCE_ENABLED
+        cooccurrence_observe(record->bssid, DEVICE_KIND_WIFI_AP, now);
+#endif
 
-    // Clear previous results
-    ble_devices.clear();
+        // Log interesting networks (hidden, unusual names, etc.)
+        if (record->ssid_id == SSID_ARENA_NONE || ssid_arena_contains(record->ssid_id, "Hidden") ||
+            ssid_arena_contains(record->ssid_id, "_nomap") || record->rssi > -30) {
+            uint8_t ssid_len = 0;
+            const uint8_t* ssid = ssid_arena_bytes(record->ssid_id, &ssid_len);
+            LOGI(SCAN, "🎯 Interesting WiFi: '%.*s' (RSSI: %d dBm)",
+                ssid_len, ssid != NULL ? (const char*)ssid : "", record->rssi);
+        }
+    }
 
-    // Perform BLE scan
-    BLEScanResults foundDevices = ble_scanner->start(SCAN_TIME_SECONDS, false);
+#if LOCATION_ENABLED
+    // Where the sweep was heard, or a fingerprint of it while learning
+    location_observe(records, stored_count, now);
+#endif
 
-    int device_count = foundDevices.getCount();
-    int32_t total_rssi = 0;
+    // Focused profiles follow the strongest access point
+    if (strongest != NULL) {
+        scan_profile_set_target(strongest->bssid, strongest->channel);
+    }
 
-    // Process discovered devices
-    for (int i = 0; i < device_count; i++) {
-        BLEAdvertisedDevice device = foundDevices.getDevice(i);
-        total_rssi += device.getRSSI();
+    // Whole-cycle aggregates run over the packed RSSI column
+    int32_t total_rssi = rssi_sum_s8(rssi_values, stored_count);
+    rssi_hist_add_s8(&cycle.histograms.wifi_all, rssi_values, stored_count);
+
+    cycle.wifi_valid = true;
+    cycle.wifi_networks_count = stored_count;
+#if MESH_SYNC_ENABLED
+    // Channels handed to peers are covered by their digests
+    cycle.wifi_networks_count += mesh_sync_remote_networks(now);
+#endif
+#if RADIO_LINK_ENABLED
+    // And the channels handed to radio modules by their frames
+    cycle.wifi_networks_count += radio_link_remote_networks(now);
+#endif
+    cycle.wifi_signal_strength = stored_count > 0 ? total_rssi / stored_count : -100;
+
+    source->wifi_release();
+
+    LOGI(SCAN, "✅ WiFi scan complete: %d networks found", stored_count);
+}
 
-        // Log interesting devices
-        String device_name = device.getName().c_str();
-        if (device_name.length() > 0) {
-            Serial.printf("🔵 BLE Device: '%s' (RSSI: %d dBm, Address: %s)\n",
-                         device_name.c_str(), device.getRSSI(), 
-                         device.getAddress().toString().c_str());
-        }
+/**
+ * @brief Publish the aggregate of recently heard BLE devices
+ */
+void scan_ble_devices(void) {
+    static uint32_t last_fold_ms = 0;
+    ble_sighting_t* sightings =
+        (ble_sighting_t*)mem_arena_alloc(&scratch, BLE_RECORD_CAPACITY * sizeof(ble_sighting_t), 16);
+    int8_t* rssi_values = (int8_t*)mem_arena_alloc(&scratch, BLE_RECORD_CAPACITY, 16);
+    if (sightings == NULL || rssi_values == NULL) {
+        return;
+    }
 
-        // Check for specific device types
-        if (device.haveServiceUUID()) {
-            Serial.printf("🎯 BLE Service: %s\n", device.getServiceUUID().toString().c_str());
+    // Bin recently heard advertisers and feed those heard since the
+    // previous cycle into the device table
+    uint32_t now = millis();
+    uint16_t recent = source->ble_sightings(sightings, BLE_RECORD_CAPACITY, last_fold_ms);
+    for (uint16_t i = 0; i < recent; i++) {
+        const ble_sighting_t* sighting = &sightings[i];
+        rssi_values[i] = sighting->rssi;
+        if (sighting->fresh) {
+            device_table_observe(sighting->addr, DEVICE_KIND_BLE, sighting->rssi, 0,
+                                 sighting->last_seen_ms, sighting->last_seen_us);
+#if COOCCURRENCE_ENABLED
+            cooccurrence_observe(sighting->addr, DEVICE_KIND_BLE, sighting->last_seen_ms);
+#endif
         }
     }
+    last_fold_ms = now;
+    rssi_hist_add_s8(&cycle.histograms.ble, rssi_values, recent);
 
-    // Update global sensor data (thread-safe)
-    if (xSemaphoreTake(sensor_data_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        global_sensor_data.ble_devices_count = device_count;
-        global_sensor_data.ble_signal_strength = device_count > 0 ? total_rssi / device_count : -100;
-        xSemaphoreGive(sensor_data_mutex);
-    }
+    // Drop devices that went quiet so their slots can be reused
+    source->ble_expire();
 
-    // Clear scan results to free memory
-    ble_scanner->clearResults();
+    ble_scan_summary_t summary;
+    source->ble_summary(&summary);
 
-    Serial.printf("✅ BLE scan complete: %d devices found\n", device_count);
+    cycle.ble_devices_count = summary.device_count;
+    cycle.ble_signal_strength = summary.avg_rssi;
+    memcpy(cycle.ble_class_counts, summary.class_counts, sizeof(cycle.ble_class_counts));
+
+    LOGI(SCAN, "✅ BLE: %d active devices (%lu adverts, %lu extended, %lu coded, %lu dropped)",
+         summary.device_count, summary.adv_total, summary.adv_extended, summary.adv_coded,
+         summary.dropped_total);
 }
 
 /**
  * @brief Process scan results and update sensor data
  */
 void process_scan_results(void) {
-    // Update timestamp for sensor data
-    if (xSemaphoreTake(sensor_data_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        global_sensor_data.uptime_seconds = millis() / 1000;
-
-        // Trigger user interaction flag if high activity detected
-        if (global_sensor_data.wifi_networks_count > HIGH_WIFI_ACTIVITY_THRESHOLD ||
-            global_sensor_data.ble_devices_count > 10) {
-            global_sensor_data.user_interaction = true;
-        } else {
-            global_sensor_data.user_interaction = false;
+    // Age out a bounded slice of the table, then close the cycle
+    device_delta_t* delta = &cycle.delta;
+    uint16_t cycle_seq = device_table_cycle();
+    uint32_t cycle_time_us = (uint32_t)esp_timer_get_time();
+#if ARCHIVE_ENABLED
+    sighting_archive_record_cycle(cycle_seq, millis());
+#endif
+#if WARDRIVE_ENABLED && SCAN_LOG_ENABLED
+    // Where this cycle was heard, ahead of its sightings
+    wardrive_tag_cycle(millis());
+#endif
+#if WARDRIVE_ENABLED && GEO_STORE_ENABLED
+    geo_store_record_cycle(cycle_seq, millis());
+#endif
+#if SCAN_LOG_ENABLED && SIGHTING_LOG_ENABLED
+    sighting_log_record_cycle(cycle_seq);
+#endif
+    device_table_age_step(millis(), DEVICE_AGE_SWEEP_BUDGET);
+#if TIER_ENABLED
+    device_tier_step(millis());
+#endif
+    device_table_take_delta(delta);
+#if COOCCURRENCE_ENABLED
+    // Communities come from the worker's last completed sweep
+    cooccurrence_close_cycle(millis());
+    cooccurrence_stats_t communities;
+    cooccurrence_get_stats(&communities);
+#endif
+
+    // Publish the whole cycle at once so readers never mix two cycles
+    sensor_snapshot_t* snapshot = (sensor_snapshot_t*)data_bus_begin_publish(BUS_TOPIC_SCAN);
+    if (snapshot != NULL) {
+        sensor_data_t* data = &snapshot->data;
+        if (cycle.wifi_valid) {
+            data->wifi_networks_count = cycle.wifi_networks_count;
+            data->wifi_signal_strength = cycle.wifi_signal_strength;
+            memcpy(snapshot->histograms.wifi_channel, cycle.histograms.wifi_channel,
+                   sizeof(snapshot->histograms.wifi_channel));
+            snapshot->histograms.wifi_all = cycle.histograms.wifi_all;
         }
+        data->ble_devices_count = cycle.ble_devices_count;
+        data->ble_signal_strength = cycle.ble_signal_strength;
+        data->ble_phones = cycle.ble_class_counts[BLE_CLASS_PHONE];
+        data->ble_trackers = cycle.ble_class_counts[BLE_CLASS_TRACKER];
+        data->ble_wearables = cycle.ble_class_counts[BLE_CLASS_WEARABLE];
+        data->ble_beacons = cycle.ble_class_counts[BLE_CLASS_BEACON];
+        snapshot->histograms.ble = cycle.histograms.ble;
+        data->devices_appeared = delta->appeared;
+        data->devices_lost = delta->lost;
+        data->devices_moved = delta->moved;
+        data->ble_followers = delta->following;
+#if COOCCURRENCE_ENABLED
+        data->people_clusters = (uint8_t)min(communities.people, (uint16_t)UINT8_MAX);
+        data->place_clusters = (uint8_t)min(communities.places, (uint16_t)UINT8_MAX);
+#endif
+#if LOCATION_ENABLED
+        location_estimate_t place;
+        location_get_estimate(&place);
+        data->location = place.label != LOCATION_UNKNOWN ? place.label + 1 : 0;
+        data->location_match = place.match;
+#endif
+        data->novel_devices = cycle.novel_devices;
+        data->novelty_permille = delta->appeared > 0 ?
+            (uint16_t)(cycle.novel_devices * 1000UL / delta->appeared) : 0;
+        data->scan_cycle = cycle_seq;
+        data->cycle_time_us = cycle_time_us;
+
+        // User interaction: a gesture since the last cycle (a stray pen-down
+        // is none), or a touch ended the deep sleep this boot came from
+        uint32_t gestures = 0;
+        data_bus_read(BUS_TOPIC_INPUT, &gestures, offsetof(input_publication_t, gestures), sizeof(gestures));
+        data->wake_flags = wake_sources_flags(millis());
+        data->user_interaction = gestures != last_gestures || (data->wake_flags & SENSOR_WAKE_TOUCH);
+        last_gestures = gestures;
+
+#if BASELINE_ENABLED
+        // How far this cycle is from the same hour in earlier weeks
+        data->unusual_z10 = baseline_observe(data, time(NULL));
+#endif
+
+        // Features are derived once per cycle from the data just staged,
+        // with the system and capture figures of the moment
+        sensor_snapshot_overlay(data);
+        ai_features_extract(data, &snapshot->histograms, &snapshot->features);
+        latency_trace_mark(cycle_trace, LATENCY_STAGE_FEATURES);
+#if SUMMARY_ENABLED
+        telemetry_summary_cycle(data, &snapshot->histograms, cycle_seq, millis());
+#endif
+        data_bus_publish(BUS_TOPIC_SCAN);
+    }
+    post_cycle_event();
 
-        xSemaphoreGive(sensor_data_mutex);
+    if (delta->appeared > 0 || delta->lost > 0 || delta->moved > 0) {
+        LOGI(SCAN, "🔄 Devices: +%d new, -%d lost, %d moved, %d following (%lu tracked)",
+             delta->appeared, delta->lost, delta->moved, delta->following, device_table_count());
     }
 }
 
 /**
- * @brief Log interesting network findings
+ * @brief Track novelty and queue a device delta for the AI task without blocking
  */
-void log_interesting_networks(void) {
-    static uint32_t last_log_time = 0;
-    uint32_t current_time = millis();
+void handle_device_event(device_event_t event, device_entry_t* entry) {
+#if NOVELTY_FILTER_ENABLED
+    if (event == DEVICE_EVENT_APPEARED) {
+        // The generations holding it are the spans of days it was seen in
+        if (novelty_filter_check_and_add(entry->mac, (device_kind_t)entry->kind, &entry->track.visits)) {
+            cycle.novel_devices++;
+        }
+    } else if (event == DEVICE_EVENT_LOST) {
+        // Long-lived devices only appear once; refresh them on the way out
+        novelty_filter_check_and_add(entry->mac, (device_kind_t)entry->kind, NULL);
+    }
+#endif
+#if SCAN_LOG_ENABLED && SIGHTING_LOG_ENABLED
+    if (event == DEVICE_EVENT_LOST) {
+        sighting_log_device_lost(entry);
+    }
+#endif
+#if TIER_ENABLED
+    if (event == DEVICE_EVENT_APPEARED) {
+        device_tier_appeared(entry, millis());
+    } else if (event == DEVICE_EVENT_LOST) {
+        device_tier_lost(entry, millis());
+    }
+#endif
+    if (event == DEVICE_EVENT_APPEARED && cycle_trace == 0) {
+        // One trace per cycle: its first new device, from when it was heard
+        cycle_trace = latency_trace_begin(entry->first_seen_ms);
+    }
 
-    // Log summary every 60 seconds
-    if (current_time - last_log_time > 60000) {
-        Serial.println("\n📊 === Network Activity Summary ===");
-        Serial.printf("WiFi Networks: %d (Avg RSSI: %d dBm)\n",
-                     global_sensor_data.wifi_networks_count,
-                     global_sensor_data.wifi_signal_strength);
-        Serial.printf("BLE Devices: %d (Avg RSSI: %d dBm)\n",
-                     global_sensor_data.ble_devices_count,
-                     global_sensor_data.ble_signal_strength);
-        Serial.println("=====================================\n");
+    // Keep the last slot free so the cycle-complete event always fits
+    if (scan_event_queue == NULL || uxQueueSpacesAvailable(scan_event_queue) <= 1) {
+        events_dropped++;
+        return;
+    }
 
-        last_log_time = current_time;
+    scan_event_t scan_event;
+    scan_event.type = event == DEVICE_EVENT_APPEARED ? SCAN_EVENT_DEVICE_APPEARED :
+                      event == DEVICE_EVENT_LOST ? SCAN_EVENT_DEVICE_LOST : SCAN_EVENT_DEVICE_MOVED;
+    scan_event.kind = entry->kind;
+    scan_event.rssi = entry->rssi_last;
+    scan_event.detail = 0;
+    memcpy(scan_event.mac, entry->mac, sizeof(scan_event.mac));
+    scan_event.dropped = 0;
+    scan_event.trace = cycle_trace;
+    scan_event.timestamp_ms = millis();
+    bool sent = xQueueSend(scan_event_queue, &scan_event, 0) == pdTRUE;
+    TRACE_EVENT(TRACE_QUEUE_SEND, TRACE_QUEUE_SCAN_EVENTS,
+                sent ? uxQueueMessagesWaiting(scan_event_queue) : UINT32_MAX);
+}
 
-        // TODO: Log to SD card for historical analysis
+/**
+ * @brief Tell the AI task that a new snapshot is ready
+ */
+void post_cycle_event(void) {
+    if (scan_event_queue == NULL) {
+        return;
+    }
+
+    scan_event_t scan_event;
+    memset(&scan_event, 0, sizeof(scan_event));
+    scan_event.type = SCAN_EVENT_CYCLE_COMPLETE;
+    scan_event.dropped = events_dropped;
+    scan_event.trace = cycle_trace;
+    scan_event.timestamp_ms = millis();
+    cycle_trace = 0;
+
+    bool sent = xQueueSend(scan_event_queue, &scan_event, 0) == pdTRUE;
+    TRACE_EVENT(TRACE_QUEUE_SEND, TRACE_QUEUE_SCAN_EVENTS,
+                sent ? uxQueueMessagesWaiting(scan_event_queue) : UINT32_MAX);
+    if (sent) {
+        events_dropped = 0;
+    }
+}
+
+/**
+ * @brief Log the network activity summary and record it in the scan log (system task timer)
+ */
+static void network_summary_timer(void* arg) {
+    // Printing takes longer than a timer should; a worker does it
+    sensor_data_t data;
+    sensor_snapshot_read(&data);
+    if (!job_pool_submit(JOB_LANE_LOW, print_network_summary, &data, sizeof(data))) {
+        print_network_summary(&data);
     }
-}
\ No newline at end of file
+
+#if SCAN_LOG_ENABLED
+    // And into the binary log for historical analysis
+    scan_log_networks_t record;
+    memset(&record, 0, sizeof(record));
+    record.wifi_networks = data.wifi_networks_count;
+    record.ble_devices = data.ble_devices_count;
+    record.wifi_rssi = (int8_t)constrain(data.wifi_signal_strength, INT8_MIN, 0);
+    record.ble_rssi = (int8_t)constrain(data.ble_signal_strength, INT8_MIN, 0);
+    record.ble_phones = data.ble_phones;
+    record.ble_trackers = data.ble_trackers;
+    record.wifi_clients = data.wifi_clients_count;
+    record.probe_requests = data.probe_requests;
+    record.capture_fps = data.capture_frames_per_second;
+    scan_log_append(SCAN_LOG_NETWORKS, &record, sizeof(record), false);
+#endif
+}
+
+/**
+ * @brief Print the network activity summary, normally on a job worker
+ */
+static void print_network_summary(void* payload) {
+    const sensor_data_t* data = (const sensor_data_t*)payload;
+    LOGI(SCAN, "📊 === Network Activity Summary ===");
+    LOGI(SCAN, "WiFi Networks: %d (Avg RSSI: %d dBm)",
+        data->wifi_networks_count,
+        data->wifi_signal_strength);
+    LOGI(SCAN, "BLE Devices: %d (Avg RSSI: %d dBm)",
+        data->ble_devices_count,
+        data->ble_signal_strength);
+    LOGI(SCAN, "BLE Classes: %d phones, %d trackers, %d wearables, %d beacons",
+        data->ble_phones, data->ble_trackers,
+        data->ble_wearables, data->ble_beacons);
+    LOGI(SCAN, "=====================================");
+}
@@ -6,19 +6,71 @@
 #include <WiFi.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-#include <SPIFFS.h>
-#include <SD.h>
 #include "config.h"
 #include "ai_states.h"
 #include "system_monitor.h"
-
-// External variables
-extern sensor_data_t global_sensor_data;
-extern SemaphoreHandle_t sensor_data_mutex;
+#include "sensor_snapshot.h"
+#include "data_bus.h"
+#include "job_pool.h"
+#include "novelty_filter.h"
+#include "baseline.h"
+#include "spi_bus.h"
+#include "renderer.h"
+#include "lvgl_pool.h"
+#include "cpu_load.h"
+#include "task_monitor.h"
+#include "heap_monitor.h"
+#include "alloc_trace.h"
+#include "memory_pressure.h"
+#include "metrics_history.h"
+#include "thermal.h"
+#include "power_manager.h"
+#include "energy.h"
+#include "wake_sources.h"
+#include "i2c_sensors.h"
+#include "ambient.h"
+#include "supervisor.h"
+#include "loop_timing.h"
+#include "priority_tuner.h"
+#include "boot_profile.h"
+#include "tunables.h"
+#include "logger.h"
+#include "sd_monitor.h"
+#include "sd_bench.h"
+#include "http_api.h"
+#include "live_stream.h"
+#include "mqtt_uplink.h"
+#include "wifi_link.h"
+#include "time_sync.h"
+#include "provisioning.h"
+#include "fleet_commands.h"
+#include "crash_dump.h"
+#include "firmware_update.h"
+#include "web_assets.h"
+#include "status_led.h"
+#include "wifi_scan.h"
+#include "ble_duty.h"
+#include "model_update.h"
+#include "scan_log.h"
+#include "storage.h"
+#include "asset_store.h"
+#include "journal.h"
+#include "warm_start.h"
+#include "log_manager.h"
+#include "sighting_archive.h"
+#include "device_tier.h"
+#include "telemetry_summary.h"
+#include "sighting_log.h"
+#include "pcap_export.h"
+#include "soak.h"
+#include "scan_synth.h"
+#include "timer_wheel.h"
+#include "latency_trace.h"
 
 // System metrics
 static system_metrics_t current_metrics = {0};
 static bool system_critical = false;
+static timer_id_t status_timer = TIMER_WHEEL_NONE;
 
 // Forward declarations
 void collect_system_metrics(void);
@@ -26,40 +78,121 @@ void update_global_sensor_data(void);
 void check_critical_conditions(void);
 void manage_memory(void);
 void log_system_status(void);
+static void start_housekeeping_timers(void);
+static void memory_log_timer(void* arg);
+static void status_report_timer(void* arg);
+#if NOVELTY_FILTER_ENABLED
+static void novelty_save_timer(void* arg);
+#endif
+#if BASELINE_ENABLED
+static void baseline_save_timer(void* arg);
+#endif
+#if PRIORITY_TUNER_ENABLED
+static void priority_tuner_timer(void* arg);
+#endif
 
 /**
  * @brief System Task - monitors system health and manages resources
  */
 void system_task(void* parameter) {
-    Serial.println("⚙️ System Task started");
+    LOGI(SYSTEM, "⚙️ System Task started");
+
+#if BLE_DUTY_ENABLED && !SOAK_ENABLED && !SCAN_SYNTH_ENABLED
+    ble_duty_init();
+#endif
+
+    start_housekeeping_timers();
 
     TickType_t last_wake_time = xTaskGetTickCount();
 
     while (true) {
+        loop_timing_start(LOOP_SYSTEM);
+
         // Collect system metrics
         collect_system_metrics();
 
         // Update global sensor data with system info
         update_global_sensor_data();
 
+        // How long boot took, once, with the first published metrics
+        boot_profile_report();
+
         // Check for critical conditions
         check_critical_conditions();
 
+#if HISTORY_ENABLED
+        // One seconds-tier point per cycle, with the latest scan counts
+        sensor_data_t scan;
+        sensor_snapshot_read(&scan);
+        metrics_history_record(millis(), &current_metrics, &scan);
+#endif
+
         // Perform memory management
         manage_memory();
 
+#if SCAN_LOG_ENABLED
+        // Staged scan log sectors go to the card on a worker
+        scan_log_tick(millis());
+#endif
+
+#if LOG_MANAGER_ENABLED
+        // Index, compaction and retention of the card's logs on a worker
+        log_manager_tick(millis());
+#endif
+
         // Update status LED
         system_monitor_update_status_led();
 
-        // Log system status periodically
-        static uint32_t last_log = 0;
-        if (millis() - last_log > 30000) {  // Every 30 seconds
-            log_system_status();
-            last_log = millis();
-        }
-
-        // Sleep until next monitoring cycle
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(SYSTEM_MONITOR_INTERVAL));
+#if NOVELTY_FILTER_ENABLED
+        // Age the long-term device history; its saves are on a timer
+        novelty_filter_tick(millis());
+#endif
+
+#if WARM_START_ENABLED
+        // The AI task's behavioural state to NVS on a worker
+        warm_start_tick(millis());
+#endif
+
+#if WIFI_LINK_ENABLED
+        // Rejoin after a loss, power save to match the AI state
+        wifi_link_tick(millis());
+#endif
+
+        // SNTP once the link is up; log anchors for every clock step
+        time_sync_tick(millis());
+
+#if PROVISION_ENABLED
+        // The setup portal: SoftAP, DNS, and credentials to the journal
+        provisioning_tick(millis());
+#endif
+
+#if FLEET_ENABLED
+        // Applied command ids to the journal, and a commanded restart
+        fleet_commands_tick(millis());
+#endif
+
+#if CRASH_DUMP_ENABLED
+        // The core dump read and logged, the kept trace's tasks named
+        crash_dump_tick(millis());
+#endif
+
+#if BLE_DUTY_ENABLED && !SOAK_ENABLED && !SCAN_SYNTH_ENABLED
+        // Trials of cheaper BLE scan settings against full duty
+        ble_duty_tick(millis());
+#endif
+
+#if SOAK_ENABLED
+        // Scripted UI steps, and the gates over the history just recorded
+        soak_tick(millis());
+#endif
+
+        // Saves, status reports and the other periodic housekeeping that came due
+        timer_wheel_advance(millis());
+
+        // Sleep until next monitoring cycle, later if the cycles keep overrunning
+        uint32_t period_ms = loop_timing_finish(LOOP_SYSTEM, SYSTEM_MONITOR_INTERVAL);
+        supervisor_checkin(SUPERVISED_SYSTEM, period_ms);
+        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(period_ms));
     }
 }
 
@@ -71,34 +204,64 @@ void collect_system_metrics(void) {
     current_metrics.free_heap_size = ESP.getFreeHeap();
     current_metrics.free_psram_size = ESP.getFreePsram();
     current_metrics.min_free_heap = ESP.getMinFreeHeap();
+    heap_monitor_sample(millis());
+    heap_region_stats_t internal;
+    heap_monitor_get(HEAP_REGION_INTERNAL, &internal);
+    current_metrics.heap_largest_free = internal.largest_free;
+    current_metrics.heap_frag_pct = internal.frag_pct;
 
     // System uptime
     current_metrics.uptime_ms = millis();
 
-    // Task count (FreeRTOS)
+    // Task count (FreeRTOS) and the watched tasks' stack and heap
     current_metrics.task_count = uxTaskGetNumberOfTasks();
-
-    // Temperature (if available - approximation)
-    current_metrics.temperature_celsius = temperatureRead();
-
-    // CPU usage estimation (rough approximation)
-    current_metrics.cpu_usage_percent = 50; // Placeholder - would need proper implementation
+    task_monitor_sample();
+
+    // Die temperature, filtered; throttling steps up and down from here
+    thermal_sample(millis());
+    current_metrics.temperature_celsius = thermal_celsius();
+    current_metrics.thermal_level = thermal_level();
+
+    // CPU utilization over the interval since the previous cycle
+    cpu_load_sample(millis());
+    cpu_load_t load;
+    cpu_load_get(&load);
+    current_metrics.cpu_core_percent[0] = (uint8_t)(load.core_pct[0] + 0.5f);
+    current_metrics.cpu_core_percent[1] = (uint8_t)(load.core_pct[1] + 0.5f);
+    current_metrics.cpu_usage_percent = (uint8_t)((load.core_pct[0] + load.core_pct[1]) / 2 + 0.5f);
+
+    // Charge per subsystem, from the loads' states over the same interval
+    energy_sample(millis());
+    wake_sources_sample(millis());  // Releases a latched motion interrupt
+    i2c_sensors_tick(millis());     // Publishes the last batch, starts the next
+    ambient_sample(millis());       // Backlight scale and night profile from the light
 
     // Connectivity status
     current_metrics.wifi_connected = WiFi.status() == WL_CONNECTED;
-    current_metrics.sd_card_mounted = SD.begin();
+    sd_monitor_poll(millis());      // One status command every SD_PROBE_INTERVAL_MS at most
+    current_metrics.sd_card_mounted = sd_monitor_mounted();
+
+    // LVGL pool, sampled by the UI task (only it may walk the pool)
+    lvgl_pool_stats_t pool;
+    lvgl_pool_get_stats(&pool);
+    current_metrics.lvgl_used_pct = pool.used_pct;
+    current_metrics.lvgl_frag_pct = pool.frag_pct;
+    current_metrics.lvgl_used_bytes = pool.used;
+    current_metrics.lvgl_peak_bytes = pool.peak;
+    current_metrics.lvgl_largest_free = pool.largest_free;
 }
 
 /**
  * @brief Update global sensor data with system information
  */
 void update_global_sensor_data(void) {
-    if (xSemaphoreTake(sensor_data_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        global_sensor_data.free_memory = current_metrics.free_heap_size;
-        global_sensor_data.uptime_seconds = current_metrics.uptime_ms / 1000;
-        global_sensor_data.sd_card_present = current_metrics.sd_card_mounted;
-
-        xSemaphoreGive(sensor_data_mutex);
+    system_publication_t* system = (system_publication_t*)data_bus_begin_publish(BUS_TOPIC_SYSTEM);
+    if (system != NULL) {
+        system->free_memory = current_metrics.free_heap_size;
+        system->uptime_seconds = current_metrics.uptime_ms / 1000;
+        system->sd_card_present = current_metrics.sd_card_mounted;
+        system->ambient_level = ambient_level();
+        data_bus_publish(BUS_TOPIC_SYSTEM);
     }
 }
 
@@ -110,21 +273,51 @@ void check_critical_conditions(void) {
 
     // Low memory condition
     if (current_metrics.free_heap_size < LOW_MEMORY_THRESHOLD) {
-        Serial.printf("⚠️ Critical: Low heap memory (%lu bytes)\n", 
-                     current_metrics.free_heap_size);
+        LOGW(SYSTEM, "⚠️ Critical: Low heap memory (%lu bytes)", 
+            current_metrics.free_heap_size);
+        new_critical = true;
+    }
+
+    // Fragmented: an allocation of this size would fail whatever is free
+    if (current_metrics.heap_largest_free > 0 &&
+        current_metrics.heap_largest_free < HEAP_LARGEST_CRITICAL) {
+        LOGW(SYSTEM, "⚠️ Critical: Largest internal heap block %lu bytes (%u%% fragmented)",
+            current_metrics.heap_largest_free, current_metrics.heap_frag_pct);
         new_critical = true;
+    } else if (current_metrics.heap_frag_pct > HEAP_FRAG_WARN_PCT) {
+        LOGW(SYSTEM, "⚠️ Warning: Internal heap %u%% fragmented", current_metrics.heap_frag_pct);
     }
 
     // High temperature condition
-    if (current_metrics.temperature_celsius > 80.0) {
-        Serial.printf("⚠️ Critical: High temperature (%.1f°C)\n", 
-                     current_metrics.temperature_celsius);
+    if (current_metrics.temperature_celsius > tunable_get(TUNABLE_THERMAL_CPU_C)) {
+        LOGW(SYSTEM, "⚠️ Critical: High temperature (%.1f°C, throttling %s)",
+            current_metrics.temperature_celsius,
+            thermal_level_name((thermal_level_t)current_metrics.thermal_level));
         new_critical = true;
     }
 
-    // Task stack overflow detection
+    // A stack this close to overflowing takes the system down next
+    uint32_t stack_free = task_monitor_min_stack_free();
+    if (stack_free < TASK_STACK_CRITICAL_BYTES) {
+        LOGW(SYSTEM, "⚠️ Critical: A task stack has %lu bytes left", stack_free);
+        new_critical = true;
+    }
+
+    // The next screen build would start short of its reserve
+    if (current_metrics.lvgl_peak_bytes > 0 &&
+        current_metrics.lvgl_largest_free < RENDERER_SCENE_RESERVE) {
+        LOGW(SYSTEM, "⚠️ Warning: LVGL pool fragmented (%lu bytes largest free, %u%% frag)",
+            current_metrics.lvgl_largest_free, current_metrics.lvgl_frag_pct);
+    }
+
+    for (uint8_t core = 0; core < 2; core++) {
+        if (current_metrics.cpu_core_percent[core] >= CPU_LOAD_WARN_PCT) {
+            LOGW(SYSTEM, "⚠️ Warning: Core %d at %u%% CPU", core, current_metrics.cpu_core_percent[core]);
+        }
+    }
+
     if (current_metrics.task_count > 20) {
-        Serial.printf("⚠️ Warning: High task count (%d)\n", current_metrics.task_count);
+        LOGW(SYSTEM, "⚠️ Warning: High task count (%d)", current_metrics.task_count);
     }
 
     system_critical = new_critical;
@@ -134,23 +327,77 @@ void check_critical_conditions(void) {
  * @brief Perform memory management and cleanup
  */
 void manage_memory(void) {
-    // Force garbage collection if memory is low
-    if (current_metrics.free_heap_size < (LOW_MEMORY_THRESHOLD * 2)) {
-        Serial.println("🧹 Performing memory cleanup...");
-        Serial.printf("🧹 Memory after cleanup: %lu bytes free\n", ESP.getFreeHeap());
-    }
-
-    // Log memory usage statistics
-    static uint32_t last_memory_log = 0;
-    if (millis() - last_memory_log > 60000) { // Every minute
-        Serial.printf("💾 Memory Stats - Heap: %lu/%lu KB, PSRAM: %lu/%lu KB\n",
-                     current_metrics.free_heap_size / 1024,
-                     ESP.getHeapSize() / 1024,
-                     current_metrics.free_psram_size / 1024,
-                     ESP.getPsramSize() / 1024);
-        last_memory_log = millis();
-    }
+    // Ask the registered subsystems for memory once the heap crosses a threshold
+    memory_pressure_respond(millis());
+}
+
+/**
+ * @brief Start the system task's own periodic jobs on the timer wheel
+ */
+static void start_housekeeping_timers(void) {
+    timer_wheel_start("memory log", MEMORY_LOG_INTERVAL_MS, MEMORY_LOG_INTERVAL_MS, memory_log_timer, NULL);
+    uint32_t report_ms = (uint32_t)tunable_get(TUNABLE_STATUS_REPORT_MS);
+    status_timer = timer_wheel_start("status report", report_ms, report_ms, status_report_timer, NULL);
+#if NOVELTY_FILTER_ENABLED
+    timer_wheel_start("novelty save", NOVELTY_SAVE_INTERVAL_MS, NOVELTY_SAVE_INTERVAL_MS,
+                      novelty_save_timer, NULL);
+#endif
+#if BASELINE_ENABLED
+    // Hour-of-week baselines, including the hour in progress
+    timer_wheel_start("baseline save", BASELINE_SAVE_INTERVAL_MS, BASELINE_SAVE_INTERVAL_MS,
+                      baseline_save_timer, NULL);
+#endif
+#if PRIORITY_TUNER_ENABLED
+    timer_wheel_start("priority tuner", PRIORITY_TUNE_INTERVAL_MS, PRIORITY_TUNE_INTERVAL_MS,
+                      priority_tuner_timer, NULL);
+#endif
+}
+
+/**
+ * @brief Log memory usage statistics (timer)
+ */
+static void memory_log_timer(void* arg) {
+    LOGI(SYSTEM, "💾 Memory Stats - Heap: %lu/%lu KB, PSRAM: %lu/%lu KB",
+        current_metrics.free_heap_size / 1024,
+        ESP.getHeapSize() / 1024,
+        current_metrics.free_psram_size / 1024,
+        ESP.getPsramSize() / 1024);
+}
+
+/**
+ * @brief Full status report, then pick up a changed report interval (timer)
+ */
+static void status_report_timer(void* arg) {
+    log_system_status();
+    timer_wheel_set_period(status_timer, (uint32_t)tunable_get(TUNABLE_STATUS_REPORT_MS));
+}
+
+#if NOVELTY_FILTER_ENABLED
+/**
+ * @brief Persist the long-term device history (timer)
+ */
+static void novelty_save_timer(void* arg) {
+    novelty_filter_save();
+}
+#endif
+
+#if BASELINE_ENABLED
+/**
+ * @brief Persist the hour-of-week baselines (timer)
+ */
+static void baseline_save_timer(void* arg) {
+    baseline_save();
+}
+#endif
+
+#if PRIORITY_TUNER_ENABLED
+/**
+ * @brief Move task priorities after the loops' last interval (timer)
+ */
+static void priority_tuner_timer(void* arg) {
+    priority_tuner_adjust();
 }
+#endif
 
 /**
  * @brief Log system status to serial and storage
@@ -159,30 +406,370 @@ void log_system_status(void) {
     static uint32_t last_status_log = 0;
     uint32_t current_time = millis();
 
-    // Log detailed status every 5 minutes
-    if (current_time - last_status_log > 300000) {
-        Serial.println("\n⚙️ === System Status Report ===");
-        Serial.printf("Uptime: %lu seconds (%.1f hours)\n", 
-                     current_metrics.uptime_ms / 1000,
-                     current_metrics.uptime_ms / 3600000.0);
-        Serial.printf("Memory: %lu KB free heap, %lu KB free PSRAM\n",
-                     current_metrics.free_heap_size / 1024,
-                     current_metrics.free_psram_size / 1024);
-        Serial.printf("Temperature: %.1f°C\n", current_metrics.temperature_celsius);
-        Serial.printf("Tasks: %d active\n", current_metrics.task_count);
-        Serial.printf("WiFi: %s, SD Card: %s\n",
-                     current_metrics.wifi_connected ? "Connected" : "Disconnected",
-                     current_metrics.sd_card_mounted ? "Mounted" : "Not found");
-        Serial.printf("System Status: %s\n", system_critical ? "CRITICAL" : "OK");
-        Serial.println("================================\n");
-
-        last_status_log = current_time;
-
-        // TODO: Write to log file on SD card
-        if (current_metrics.sd_card_mounted) {
-            // Implement SD card logging
+    LOGI(SYSTEM, "⚙️ === System Status Report ===");
+    LOGI(SYSTEM, "Uptime: %lu seconds (%.1f hours)", 
+        current_metrics.uptime_ms / 1000,
+        current_metrics.uptime_ms / 3600000.0);
+    LOGI(SYSTEM, "Memory: %lu KB free heap, %lu KB free PSRAM",
+        current_metrics.free_heap_size / 1024,
+        current_metrics.free_psram_size / 1024);
+    for (uint8_t region = 0; region < HEAP_REGION_COUNT; region++) {
+        heap_region_stats_t heap;
+        heap_monitor_get((heap_region_t)region, &heap);
+        if (heap.total_free == 0) {
+            continue;           // No PSRAM fitted
+        }
+        LOGI(SYSTEM, "Heap %-8s: %lu KB free, largest %lu KB (min %lu), %lu free blocks, "
+            "%u%% frag (max %u%%), trend %+ld/%+ld B/h",
+            heap_monitor_region_name((heap_region_t)region),
+            heap.total_free / 1024, heap.largest_free / 1024, heap.min_largest_free / 1024,
+            heap.free_blocks, heap.frag_pct, heap.max_frag_pct,
+            heap.free_trend_per_hour, heap.largest_trend_per_hour);
+    }
+    static uint32_t reported_failures = 0;
+    alloc_failure_stats_t failed;
+    alloc_trace_get_failures(&failed);
+    if (failed.failures != reported_failures) {
+        reported_failures = failed.failures;
+        LOGW(SYSTEM, "⚠️  %lu failed allocations, largest %lu bytes; last %lu bytes (caps 0x%lx) in %s",
+            failed.failures, failed.largest_failed, failed.last_size, failed.last_caps,
+            failed.last_function != NULL ? failed.last_function : "?");
+    }
+#if ALLOC_TRACE_ENABLED
+    for (uint8_t cycle = 0; cycle < ALLOC_CYCLE_COUNT; cycle++) {
+        alloc_cycle_stats_t allocs;
+        alloc_trace_get_cycle((alloc_cycle_t)cycle, &allocs);
+        LOGI(SYSTEM, "Allocs %-10s: %lu of %lu bodies clean, %lu allocs (%llu B), last %lu, max %lu, %lu regressions",
+            allocs.name, allocs.clean_cycles, allocs.cycles, allocs.allocs, allocs.bytes,
+            allocs.last_allocs, allocs.max_allocs, allocs.regressions);
+    }
+#endif
+    memory_shrinker_stats_t shrinkers[MEMORY_SHRINKERS_MAX];
+    uint8_t shrinker_count = memory_pressure_get(shrinkers, MEMORY_SHRINKERS_MAX);
+    for (uint8_t i = 0; i < shrinker_count; i++) {
+        LOGI(SYSTEM, "Shrinker %-10s: %lu calls, %lu KB reclaimed",
+            shrinkers[i].name, shrinkers[i].calls, shrinkers[i].reclaimed_bytes / 1024);
+    }
+    thermal_status_t thermal;
+    thermal_get_status(&thermal);
+    LOGI(SYSTEM, "Temperature: %.1f°C (last reading %.1f°C), throttling %s: CPU %u MHz, "
+        "frames every %u ms, %lu s throttled, %lu changes",
+        thermal.celsius, thermal.raw_celsius, thermal_level_name(thermal.level),
+        thermal.cpu_mhz, thermal.frame_interval_ms, thermal.throttled_ms / 1000,
+        thermal.level_changes);
+    power_status_t power;
+    power_manager_get_status(&power);
+    LOGI(SYSTEM, "Clock: %u-%u MHz%s%s, full clock held render %lus, scan %lus, ai %lus",
+        power.min_mhz, power.max_mhz, power.dfs ? " DFS" : " fixed",
+        power.light_sleep ? ", light sleep" : "",
+        power.held_ms[POWER_CLIENT_RENDER] / 1000, power.held_ms[POWER_CLIENT_SCAN] / 1000,
+        power.held_ms[POWER_CLIENT_AI] / 1000);
+    LOGI(SYSTEM, "Tasks: %d active", current_metrics.task_count);
+    cpu_load_t load;
+    cpu_load_get(&load);
+    LOGI(SYSTEM, "CPU (%s): core 0 %.1f%%, core 1 %.1f%%",
+        load.method != NULL ? load.method : "not sampled", load.core_pct[0], load.core_pct[1]);
+    for (uint8_t i = 0; i < load.task_count; i++) {
+        LOGI(SYSTEM, "  %-13s core %2d %5.1f%% (%u%% on core 0, %u%% on core 1)",
+            load.tasks[i].name, load.tasks[i].core, load.tasks[i].busy_pct,
+            load.tasks[i].core_share_pct[0], load.tasks[i].core_share_pct[1]);
+    }
+    // Scan throughput, to compare task placements against each other
+    static uint32_t last_scan_cycles = 0;
+    uint32_t scan_cycles = data_bus_version(BUS_TOPIC_SCAN);
+    LOGI(SYSTEM, "Scan: %.1f cycles/min since the last report",
+        (scan_cycles - last_scan_cycles) * 60000.0f / (current_time - last_status_log));
+    last_scan_cycles = scan_cycles;
+    task_stats_t tasks[TASK_MONITOR_MAX_TASKS];
+    uint8_t watched = task_monitor_get(tasks, TASK_MONITOR_MAX_TASKS);
+    for (uint8_t i = 0; i < watched; i++) {
+        if (tasks[i].heap_tracked) {
+            LOGI(SYSTEM, "  %-13s stack %lu/%lu B used (min free %lu), heap %lu B in %lu blocks, peak %lu B",
+                tasks[i].name, tasks[i].stack_bytes - tasks[i].stack_min_free,
+                tasks[i].stack_bytes, tasks[i].stack_min_free,
+                tasks[i].heap_bytes, tasks[i].heap_blocks, tasks[i].heap_peak_bytes);
+        } else {
+            LOGI(SYSTEM, "  %-13s stack %lu/%lu B used (min free %lu)",
+                tasks[i].name, tasks[i].stack_bytes - tasks[i].stack_min_free,
+                tasks[i].stack_bytes, tasks[i].stack_min_free);
         }
     }
+    for (uint8_t lane = 0; lane < JOB_LANE_COUNT; lane++) {
+        job_lane_stats_t jobs;
+        job_pool_get_stats((job_lane_t)lane, &jobs);
+        LOGI(SYSTEM, "Jobs %-6s: %lu done of %lu, %lu rejected, max wait %lu us, max run %lu us",
+            job_pool_lane_name((job_lane_t)lane), jobs.completed, jobs.submitted,
+            jobs.rejected, jobs.max_wait_us, jobs.max_run_us);
+    }
+    timer_wheel_stats_t timers;
+    timer_wheel_get_stats(&timers);
+    LOGI(SYSTEM, "Timers: %u active (peak %u), %lu fired, %lu cascaded, %lu rejected, late max %lu ms, run max %lu us",
+        timers.active, timers.peak, timers.fired, timers.cascaded, timers.rejected,
+        timers.late_max_ms, timers.run_max_us);
+    latency_trace_stats_t latency;
+    latency_trace_get(&latency);
+    if (latency.started > 0) {
+        const latency_stage_stats_t* total = &latency.stages[LATENCY_STAGE_TOTAL];
+        LOGI(SYSTEM, "Scan to display: %lu traces, %lu shown (%lu held, %lu coalesced, %lu lost), p50 %lu ms, p99 %lu ms, max %lu ms",
+            latency.started, latency.completed, latency.held, latency.coalesced, latency.lost,
+            total->p50_ms, total->p99_ms, total->max_us / 1000);
+    }
+    for (uint8_t topic = 0; topic < BUS_TOPIC_COUNT; topic++) {
+        bus_topic_stats_t bus;
+        data_bus_get_stats((bus_topic_t)topic, &bus);
+        LOGI(SYSTEM, "Bus %-8s: %lu publications, %lu read retries, %u subscribers%s",
+            bus.name, bus.version, bus.read_retries, bus.subscribers,
+            bus.rejected_writes > 0 ? ", foreign writes rejected" : "");
+    }
+    logger_stats_t logs;
+    logger_get_stats(&logs);
+    LOGI(SYSTEM, "Log: %lu lines, %lu dropped, %lu truncated, writer lag max %lu ms, %lu B to SD",
+        logs.drained, logs.dropped, logs.truncated, logs.max_latency_ms, logs.sd_bytes);
+#if SCAN_LOG_ENABLED
+    scan_log_stats_t scan_log;
+    scan_log_get_stats(&scan_log);
+    LOGI(SYSTEM, "Scan log: %lu records, %lu dropped, %lu KB in %lu flushes (%lu B padding), %lu B staged",
+        scan_log.records, scan_log.dropped, scan_log.bytes_written / 1024, scan_log.flushes,
+        scan_log.padding_bytes, scan_log.staged_bytes);
+#if SIGHTING_LOG_ENABLED
+    sighting_log_stats_t sightings;
+    sighting_log_get_stats(&sightings);
+    LOGI(SYSTEM, "Sightings: %lu folded into %lu appeared, %lu changed, %lu present, %lu gone (%lu deferred)",
+        sightings.cycles_seen, sightings.appeared, sightings.changed, sightings.present,
+        sightings.gone, sightings.deferred);
+#endif
+#endif
+#if LOG_MANAGER_ENABLED
+    log_manager_stats_t manager;
+    log_manager_get_stats(&manager);
+    LOGI(SYSTEM, "Log files: boot %lu, %lu passes, %lu compacted, %lu expired, %lu indexed (%lu lost), %u%% free",
+        manager.boot, manager.passes, manager.compacted, manager.deleted,
+        manager.index_entries, manager.index_dropped, manager.free_pct);
+#endif
+#if ARCHIVE_ENABLED
+    archive_stats_t archive;
+    sighting_archive_get_stats(&archive);
+    LOGI(SYSTEM, "Archive: %lu rows staged, %lu dropped, %lu segments (%lu failed), %lu KB for %lu KB raw",
+        archive.rows_staged, archive.rows_dropped, archive.segments_written, archive.write_failures,
+        archive.encoded_bytes / 1024, archive.raw_bytes / 1024);
+#endif
+#if TIER_ENABLED
+    device_tier_stats_t tier;
+    device_tier_get_stats(&tier);
+    LOGI(SYSTEM, "Device tier: %lu warm (%lu hot), %u runs in %u levels, %lu cold, %lu back warm, %lu back cold, %lu new, %lu reads for nothing",
+        tier.warm, tier.warm_hot, tier.runs, tier.levels, tier.cold_records, tier.returned_warm,
+        tier.returned_cold, tier.new_devices, tier.filter_false);
+#endif
+#if SUMMARY_ENABLED
+    static telemetry_summary_stats_t summary;   // Only the status report reads it
+    telemetry_summary_get_stats(&summary);
+    LOGI(SYSTEM, "Summary: %lu minutes, %lu hours, %lu uplinked, %lu dropped; last minute %u cycles, %lu novel, %u unusual, %u top of %u displaced",
+        summary.closed[SUMMARY_PERIOD_MINUTE], summary.closed[SUMMARY_PERIOD_HOUR], summary.taken,
+        summary.dropped, summary.last_minute.cycles, summary.last_minute.novel_devices,
+        summary.last_minute.unusual_cycles, summary.last_minute.top_count, summary.sketch_replaced);
+#endif
+#if PACKET_CAPTURE_ENABLED && PCAP_EXPORT_ENABLED
+    pcap_export_stats_t pcap;
+    pcap_export_get_stats(&pcap);
+    LOGI(SYSTEM, "PCAP: SD %s (capture_%04u, %lu KB, %lu failed), stream %s (%lu KB, %lu sessions), %lu frames, %lu dropped",
+        pcap.sd_active ? "on" : "off", pcap.sd_segment, pcap.sd_bytes / 1024, pcap.sd_failures,
+        pcap.stream_active ? "on" : "off", pcap.stream_bytes / 1024, pcap.stream_sessions,
+        pcap.frames_exported, pcap.frames_dropped);
+#endif
+    for (uint8_t id = 0; id < LOOP_COUNT; id++) {
+        loop_timing_stats_t timing;
+        loop_timing_get((loop_id_t)id, &timing);
+        LOGI(SYSTEM, "Loop %-7s: %lu runs, exec %lu/%lu us avg/max, jitter max %lu us, %lu/%lu ms period, %lu missed, stretched %lu times",
+            timing.name, timing.loops, timing.avg_exec_us, timing.max_exec_us,
+            timing.max_jitter_us, max(timing.period_ms, timing.stretched_ms),
+            timing.period_ms, timing.misses, timing.stretches);
+    }
+    priority_tuner_stats_t priorities;
+    priority_tuner_get(&priorities);
+    for (uint8_t i = 0; i < priorities.count; i++) {
+        const priority_task_stats_t* task = &priorities.tasks[i];
+        LOGI(SYSTEM, "Priority %-7s: %u (own %u, running %u), raised %lu, lowered %lu, inherited at %lu looks",
+            task->name, task->priority, task->base, task->running, task->boosts, task->relaxes,
+            task->inherited);
+    }
+    if (priorities.ui_guards > 0) {
+        LOGI(SYSTEM, "Priority: other boosts lowered for the UI at %lu of %lu looks",
+            priorities.ui_guards, priorities.looks);
+    }
+    for (uint8_t id = 0; id < SUPERVISED_COUNT; id++) {
+        supervisor_task_stats_t live;
+        supervisor_get((supervised_task_t)id, &live);
+        if (!live.registered) {
+            continue;
+        }
+        LOGI(SYSTEM, "  %-13s %s%lu check-ins, max gap %lu ms (late %lu), %lu stalls, %lu recoveries",
+            live.name, live.retired ? "retired, " : "", live.checkins, live.max_gap_ms,
+            live.max_late_ms, live.stalls, live.recoveries);
+    }
+    LOGI(SYSTEM, "LVGL pool: %lu KB used (%u%%), peak %lu KB, largest free %lu KB, %u%% frag",
+        current_metrics.lvgl_used_bytes / 1024, current_metrics.lvgl_used_pct,
+        current_metrics.lvgl_peak_bytes / 1024, current_metrics.lvgl_largest_free / 1024,
+        current_metrics.lvgl_frag_pct);
+    sd_monitor_status_t sd;
+    sd_monitor_get_status(&sd);
+    LOGI(SYSTEM, "WiFi: %s, SD Card: %s (%lu probes, %lu in, %lu out, %lu mount failures)",
+        current_metrics.wifi_connected ? "Connected" : "Disconnected",
+        current_metrics.sd_card_mounted ? "Mounted" : "Not found",
+        sd.probes, sd.insertions, sd.removals, sd.mount_failures);
+#if SD_BENCH_ENABLED
+    sd_bench_stats_t bench;
+    sd_bench_get_stats(&bench);
+    if (bench.valid) {
+        LOGI(SYSTEM, "SD bench: %lu MHz, %u B writes, %lu kB/s, %lu us worst block (%u sweeps, %u re-runs)",
+            bench.result.spi_hz / 1000000, bench.result.block_bytes, bench.result.write_kbps,
+            bench.result.max_block_us, bench.sweeps, bench.block_runs);
+    }
+#endif
+#if MODEL_UPDATE_ENABLED && HTTP_API_ENABLED
+    http_api_stats_t api;
+    http_api_get_stats(&api);
+    if (api.served > 0 || api.busy > 0 || api.limited > 0) {
+        LOGI(SYSTEM, "API: %lu served (state %lu, sensor %lu, metrics %lu, devices %lu, history %lu, location %lu, states %lu, scrapes %lu), %lu busy, %lu rate limited, %lu too large",
+            api.served, api.state, api.sensor, api.metrics, api.devices, api.history, api.location, api.states, api.openmetrics,
+            api.busy, api.limited, api.overflowed);
+        LOGI(SYSTEM, "API streams: %u open, %lu chunks deferred, %lu filled inline, %lu waits",
+            api.heavy_streams, api.deferred, api.inline_fills, api.waits);
+    }
+    for (uint8_t i = 0; i < http_api_key_count(); i++) {
+        http_api_key_stats_t key;
+        http_api_get_key_stats(i, &key);
+        LOGI(SYSTEM, "API key %s: %lu requests, %lu kB, %u/%u streams, %lu over quota, %lu streams refused",
+            key.name, key.requests, key.bytes / 1024, key.streams, key.stream_max, key.limited,
+            key.stream_refusals);
+    }
+    if (api.unauthorized > 0) {
+        LOGI(SYSTEM, "API: %lu without a key, %lu over a key's quota", api.unauthorized, api.key_limited);
+    }
+#endif
+#if MODEL_UPDATE_ENABLED && LIVE_STREAM_ENABLED
+    live_stream_stats_t live;
+    live_stream_get_stats(&live);
+    if (live.connects > 0) {
+        LOGI(SYSTEM, "Live: %u clients, %lu frames, %lu coalesced, %lu deferred, %lu refused",
+            live.clients, live.frames_sent, live.coalesced, live.deferred, live.refused);
+    }
+#endif
+#if FIRMWARE_UPDATE_ENABLED
+    firmware_update_status_t firmware;
+    firmware_update_get_status(&firmware);
+    if (firmware.phase != FIRMWARE_UPDATE_IDLE) {
+        LOGI(SYSTEM, "Firmware: %s, %lu of %lu patch bytes, %lu of %lu image bytes, %u resumes%s%s",
+            firmware_update_phase_name(firmware.phase), firmware.received, firmware.patch_bytes,
+            firmware.written, firmware.target_size, firmware.resumes,
+            firmware.error[0] != '\0' ? " - " : "", firmware.error);
+    }
+#endif
+#if WIFI_LINK_ENABLED
+    wifi_link_stats_t link;
+    wifi_link_get_stats(&link);
+    LOGI(SYSTEM, "Link: %s on channel %u (%d dBm, PS %u), %lu joins, %lu lost, %lu off-channel scans (%lums), %lu delayed, %lu skipped",
+        link.associated ? "up" : "down", link.home_channel, link.rssi, link.power_save,
+        link.associations, link.disconnects, link.off_channel_scans, link.off_channel_ms,
+        link.scans_delayed, link.scans_skipped);
+#endif
+#if MQTT_ENABLED && WIFI_LINK_ENABLED
+    mqtt_uplink_stats_t mqtt;
+    mqtt_uplink_get_stats(&mqtt);
+    LOGI(SYSTEM, "MQTT: WiFi %s, broker %s, %lu published, %lu summaries, %lu raw (%lus asked left), %u queued, %lu spooled, %lu retries, %lu spilled, %lu dropped",
+        mqtt.wifi_connected ? "up" : "down", mqtt.broker_connected ? "up" : "down",
+        mqtt.published, mqtt.summaries, mqtt.raw, mqtt.raw_left_s, mqtt.queued, mqtt.spooled,
+        mqtt.retries, mqtt.spilled, mqtt.dropped);
+#endif
+    storage_status_t flash;
+    storage_get_status(&flash);
+    LOGI(SYSTEM, "LittleFS: %s, %lu of %lu KB used%s",
+        flash.flash_mounted ? "mounted" : "not mounted",
+        flash.flash_used_bytes / 1024, flash.flash_total_bytes / 1024,
+        flash.migrated ? " (migrated from SPIFFS this boot)" : "");
+#if ASSET_STORE_ENABLED
+    asset_store_stats_t assets;
+    asset_store_get_stats(&assets);
+    LOGI(SYSTEM, "Assets: %u mapped, %lu KB, %lu lookups, %lu CRC failures",
+        assets.count, assets.mapped_bytes / 1024, assets.lookups, assets.crc_failures);
+#if WEB_ASSETS_ENABLED && MODEL_UPDATE_ENABLED
+    web_assets_stats_t web;
+    web_assets_get_stats(&web);
+    LOGI(SYSTEM, "Dashboard: %lu served, %lu not modified, %lu missing, %lu without gzip offered",
+        web.served, web.not_modified, web.missing, web.unasked);
+#endif
+#endif
+#if SOAK_ENABLED
+    soak_status_t soak;
+    soak_get_status(&soak);
+    LOGI(SYSTEM, "Soak: %lu cycles %s (%lu loops), %lu UI steps, %lu checks, failing 0x%02x, ever 0x%02x",
+        soak.cycles, soak.from_trace ? "replayed" : "generated", soak.trace_loops,
+        soak.ui_steps, soak.checks, soak.failing, soak.failed);
+#endif
+#if SCAN_SYNTH_ENABLED || SOAK_ENABLED
+    scan_synth_stats_t synth;
+    scan_synth_get_stats(&synth);
+    LOGI(SYSTEM, "Synth: %lu cycles, %lu Wi-Fi and %lu BLE records, %lu adverts (%lu dropped), %lu replaced, sweep %lu us",
+        synth.cycles, synth.wifi_records, synth.ble_records, synth.adverts,
+        synth.adverts_dropped, synth.replaced, synth.last_sweep_us);
+#endif
+#if JOURNAL_ENABLED
+    journal_stats_t journal;
+    journal_get_stats(&journal);
+    LOGI(SYSTEM, "Journal: %s, %u keys, %lu commits (%lu failed), last %lu us, max %lu us, %u/%u sectors free, %lu reclaimed",
+        journal.mounted ? "mounted" : "not mounted", journal.keys, journal.commits, journal.failures,
+        journal.last_commit_us, journal.max_commit_us, journal.sectors_free, journal.sectors,
+        journal.reclaimed);
+#endif
+    for (uint8_t device = 0; device < SPI_DEVICE_COUNT; device++) {
+        spi_bus_stats_t bus;
+        spi_bus_get_stats((spi_device_t)device, &bus);
+        LOGI(SYSTEM, "SPI %s: %.1f%% busy, %lu holds, max wait %lu us, %lu timeouts",
+            spi_bus_device_name((spi_device_t)device),
+            bus.busy_us / (current_metrics.uptime_ms * 10.0),
+            bus.transactions, bus.max_wait_us, bus.timeouts);
+    }
+    renderer_profile_t display;
+    renderer_get_profile(&display);
+    if (display.refreshes > 0) {
+        LOGI(SYSTEM, "Display: %lu refreshes, render avg/max %llu/%lu us, flush avg/max %llu/%lu us, "
+            "%llu KB flushed, %llu KB unchanged, %lu dropped",
+            display.refreshes,
+            display.render_total_us / display.refreshes, display.render_max_us,
+            display.flush_total_us / display.refreshes, display.flush_max_us,
+            display.bytes_flushed / 1024, display.bytes_unchanged / 1024, display.frames_dropped);
+    }
+    energy_status_t energy;
+    energy_get_status(&energy);
+    LOGI(SYSTEM, "Energy: %.0f mA avg (%.0f modelled x%.2f), %.1f mAh used, %.1f h on %u mAh",
+        energy.avg_ma, energy.model_ma, energy.scale, energy.mah, energy.runtime_h, energy.battery_mah);
+    for (uint8_t load = 0; load < ENERGY_LOAD_COUNT; load++) {
+        LOGI(SYSTEM, "  %-9s %5.1f mA now, %6.2f mAh, %3u%%, on %lus",
+            energy_load_name((energy_load_t)load), energy.loads[load].ma, energy.loads[load].mah,
+            energy.loads[load].share_pct, energy.loads[load].active_ms / 1000);
+    }
+    wake_status_t wake;
+    wake_sources_get_status(&wake);
+    LOGI(SYSTEM, "Wake: booted by %s, %lu motion events, battery %u mV",
+        wake_cause_name(wake.boot_cause), wake.motion_events, wake.battery_mv);
+    LOGI(SYSTEM, "System Status: %s", system_critical ? "CRITICAL" : "OK");
+    LOGI(SYSTEM, "================================");
+
+    last_status_log = current_time;
+
+#if SCAN_LOG_ENABLED
+    // The same figures in the binary log, staged whether or not a card is in
+    scan_log_system_t record;
+    memset(&record, 0, sizeof(record));
+    record.free_heap = current_metrics.free_heap_size;
+    record.min_free_heap = current_metrics.min_free_heap;
+    record.free_psram_kb = (uint16_t)min(current_metrics.free_psram_size / 1024, (uint32_t)UINT16_MAX);
+    record.temperature_dc = (int16_t)(current_metrics.temperature_celsius * 10.0f);
+    record.cpu_pct = current_metrics.cpu_usage_percent;
+    record.thermal_level = current_metrics.thermal_level;
+    record.task_count = (uint8_t)min(current_metrics.task_count, (uint16_t)UINT8_MAX);
+    record.critical = system_critical;
+    scan_log_append(SCAN_LOG_SYSTEM, &record, sizeof(record), false);
+#endif
 }
 
 // Implementation of system_monitor.h functions
@@ -191,18 +778,14 @@ void log_system_status(void) {
  * @brief Initialize system monitoring
  */
 bool system_monitor_init(void) {
-    Serial.println("⚙️ Initializing system monitor...");
-
-    // Initialize status LED
-    pinMode(STATUS_LED_PIN, OUTPUT);
-    digitalWrite(STATUS_LED_PIN, LOW);
+    LOGI(SYSTEM, "⚙️ Initializing system monitor...");
 
     // Set initial metrics
     current_metrics.free_heap_size = ESP.getFreeHeap();
     current_metrics.free_psram_size = ESP.getFreePsram();
     current_metrics.min_free_heap = ESP.getMinFreeHeap();
 
-    Serial.println("✅ System monitor initialized");
+    LOGI(SYSTEM, "✅ System monitor initialized");
     return true;
 }
 
@@ -231,26 +814,23 @@ bool system_monitor_is_critical(void) {
 
 /**
  * @brief Update status LED based on system health
+ *
+ * Only picks the pattern; status_led plays it off its own timer.
  */
 void system_monitor_update_status_led(void) {
-    static uint32_t last_blink = 0;
-    static bool led_state = false;
-    uint32_t current_time = millis();
-
+    status_led_pattern_t pattern = STATUS_LED_HEARTBEAT;
     if (system_critical) {
-        // Fast blink for critical state
-        if (current_time - last_blink > 250) {
-            led_state = !led_state;
-            digitalWrite(STATUS_LED_PIN, led_state ? HIGH : LOW);
-            last_blink = current_time;
-        }
-    } else {
-        // Slow heartbeat for normal operation
-        if (current_time - last_blink > 2000) {
-            digitalWrite(STATUS_LED_PIN, HIGH);
-            delay(50);
-            digitalWrite(STATUS_LED_PIN, LOW);
-            last_blink = current_time;
-        }
+        pattern = STATUS_LED_CRITICAL;
+#if MODEL_UPDATE_ENABLED
+    } else if (model_update_in_progress()) {
+        pattern = STATUS_LED_OTA;
+#endif
+#if FIRMWARE_UPDATE_ENABLED
+    } else if (firmware_update_in_progress()) {
+        pattern = STATUS_LED_OTA;
+#endif
+    } else if (wifi_scan_in_progress()) {
+        pattern = STATUS_LED_SCANNING;
     }
+    status_led_set(pattern);
 }
\ No newline at end of file
@@ -6,423 +6,453 @@
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-#include <freertos/queue.h>
+#include <esp_heap_caps.h>
 #include <lvgl.h>
 #include "config.h"
 #include "ai_states.h"
+#include "renderer.h"
+#include "image_cache.h"
+#include "face_anim.h"
+#include "ui_events.h"
+#include "backlight.h"
+#include "sensor_snapshot.h"
+#include "data_bus.h"
+#include "ai_telemetry.h"
+#include "ui_screens.h"
+#include "face_atlas.h"
+#include "ui_layout.h"
+#include "ui_theme.h"
+#include "gestures.h"
+#include "provisioning.h"
+#include "memory_pressure.h"
+#include "thermal.h"
+#include "ambient.h"
+#include "governor.h"
+#include "supervisor.h"
+#include "loop_timing.h"
+#include "latency_trace.h"
+#include "boot_profile.h"
+#include "logger.h"
+#include "bench.h"
+#include "soak.h"
 
-// External variables
-extern ai_state_t current_ai_state;
-extern QueueHandle_t ai_state_queue;
-extern sensor_data_t global_sensor_data;
-extern SemaphoreHandle_t sensor_data_mutex;
+// AI state as last read from the bus; the AI task owns the real one
+static ai_state_t shown_state = AI_STATE_IDLE;
+static uint32_t shown_version = 0;
+static uint32_t shown_transitions = 0;
 
 // Forward declarations
-bool display_driver_init(void);
-void display_driver_update(void);
-void create_ponagotchi_ui(void);
+void create_ponagotchi_ui(lv_obj_t* screen);
+void update_face_scene(uint32_t now_ms);
 void update_face_expression(ai_state_t state);
-void update_status_bar(void);
-void create_main_screen(void);
+void update_status_bar(uint32_t now_ms);
+uint32_t status_bar_wait_ms(uint32_t now_ms);
+uint32_t face_scene_wait_ms(uint32_t now_ms);
+static void fit_face_cb(lv_event_t* event);
+static size_t ui_shrink(memory_pressure_t level);
+static void release_memory(void);
+
+// The face and status screen, home of the screen ring and never torn down
+static const renderer_scene_t face_scene = {
+    "face", create_ponagotchi_ui, update_face_scene, face_scene_wait_ms, NULL
+};
 
 // LVGL objects
 static lv_obj_t* main_screen = NULL;
-static lv_obj_t* face_container = NULL;
-static lv_obj_t* left_eye = NULL;
-static lv_obj_t* right_eye = NULL;
-static lv_obj_t* mouth = NULL;
-static lv_obj_t* status_label = NULL;
-static lv_obj_t* stats_label = NULL;
-static lv_obj_t* network_label = NULL;
+static lv_obj_t* face_img = NULL;           // Shows one prerendered atlas frame
+static lv_obj_t* status_icon = NULL;        // State icon left of the status text
+static lv_obj_t* status_text = NULL;        // Coloured by state (see ui_theme.h)
+static ai_state_t styled_state = (ai_state_t)AI_STATE_COUNT;
+
+// Status text, one cached label per field so a change redraws only its line
+static renderer_label_t status_label;
+static renderer_label_t memory_label;
+static renderer_label_t uptime_label;
+static renderer_label_t inference_label;
+static renderer_label_t margin_label;
+static renderer_label_t wifi_label;
+static renderer_label_t ble_label;
 
 // Animation variables
-static lv_anim_t blink_anim;
-static uint32_t last_blink_time = 0;
 static uint32_t last_expression_change = 0;
 
+// Set once the UI task runs; ui_notify() is a no-op before that
+static TaskHandle_t volatile ui_task_self = NULL;
+
+// Memory pressure the system task last asked the UI to answer
+static int8_t ui_shrinker = -1;
+static volatile memory_pressure_t ui_pressure = MEMORY_PRESSURE_NONE;
+
 /**
  * @brief UI Task - handles LVGL updates and face animations
  */
 void ui_task(void* parameter) {
-    Serial.println("🎨 UI Task started");
+    LOGI(UI, "🎨 UI Task started");
     
-    // Initialize display driver and LVGL
-    if (!display_driver_init()) {
-        Serial.println("❌ Display driver initialization failed");
+    // Panel, LVGL and buffers, while setup() carries on with storage
+    boot_profile_begin(BOOT_STAGE_DISPLAY);
+    if (!renderer_init()) {
+        LOGE(UI, "❌ Renderer initialization failed");
+        supervisor_retire(SUPERVISED_UI);
         vTaskDelete(NULL);
         return;
     }
     
-    // Create Ponagotchi UI
-    create_ponagotchi_ui();
+    boot_profile_end(BOOT_STAGE_DISPLAY);
     
-    ai_state_t new_state;
-    TickType_t last_wake_time = xTaskGetTickCount();
+    // Create Ponagotchi UI; detail screens are built when first swiped to
+    boot_profile_begin(BOOT_STAGE_FIRST_FRAME);
+    ui_screens_init(&face_scene);
+    renderer_show(&face_scene);
+    ui_task_self = xTaskGetCurrentTaskHandle();
+    ui_shrinker = memory_pressure_register("ui_scenes", 10, MEMORY_PRESSURE_LOW, ui_shrink);
+    
+    data_bus_subscribe(BUS_TOPIC_AI_STATE, ui_task_self, UI_EVENT_STATE);
+    data_bus_subscribe(BUS_TOPIC_SCAN, ui_task_self, UI_EVENT_SENSORS);
+    
+    uint32_t events = 0;
     
     while (true) {
-        // Check for AI state updates
-        if (xQueueReceive(ai_state_queue, &new_state, 0) == pdTRUE) {
-            current_ai_state = new_state;
-            update_face_expression(new_state);
+        loop_timing_start(LOOP_UI);
+        
+        // Check for AI state updates; only the latest state is shown
+        if (data_bus_version(BUS_TOPIC_AI_STATE) != shown_version) {
+            ai_state_publication_t published;
+            shown_version = data_bus_read(BUS_TOPIC_AI_STATE, &published, 0, sizeof(published));
+            shown_state = published.state;
+            update_face_expression(published.state);
             last_expression_change = millis();
+            if (published.trace != 0) {
+                // The face is set; its trace ends when the frame below goes out
+                latency_trace_mark(published.trace, LATENCY_STAGE_UI);
+                renderer_trace_flush(published.trace);
+            }
             
-            Serial.printf("🎭 Face expression changed to: %s\n", 
-                         ai_state_to_string(new_state));
+            uint32_t latency_ms = millis() - published.entered_ms;
+            if (published.transitions - shown_transitions > 1) {
+                LOGI(UI, "🎭 Face expression changed to: %s (%.0f%% confidence, %lu ms after the decision, %lu earlier states skipped)",
+                     ai_state_to_string(published.state), published.confidence * 100.0f,
+                     latency_ms, published.transitions - shown_transitions - 1);
+            } else {
+                LOGI(UI, "🎭 Face expression changed to: %s (%.0f%% confidence, %lu ms after the decision)",
+                     ai_state_to_string(published.state), published.confidence * 100.0f, latency_ms);
+            }
+            shown_transitions = published.transitions;
         }
         
-        // Update status information
-        update_status_bar();
+        // The RSSI sparkline follows every cycle, even while off screen
+        if (events & UI_EVENT_SENSORS) {
+            ui_screens_sample();
+        }
         
-        // Handle automatic blinking animation
-        uint32_t current_time = millis();
-        if (current_time - last_blink_time > random(2000, 5000)) {
-            // Trigger blink animation
-            last_blink_time = current_time;
-            // TODO: Implement blink animation
+        if (events & UI_EVENT_MEMORY) {
+            release_memory();
         }
         
-        // Update LVGL
-        display_driver_update();
+#if BENCH_ENABLED
+        if (events & UI_EVENT_BENCH) {
+            bench_ui_scenes();      // Returns with the face back on screen
+        }
+#endif
+#if SOAK_ENABLED
+        if (events & UI_EVENT_SOAK) {
+            soak_ui_step();
+        }
+#endif
         
-        // Sleep until next update cycle
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(UI_UPDATE_INTERVAL));
+        // Standby: LVGL stays suspended until the AI leaves SLEEPING or the
+        // user wakes the unit; scan cycles alone do not wake the panel
+        bool wake = (events & UI_EVENT_WAKE) != 0;
+        if (wake) {
+            backlight_interaction(millis());
+        }
+        if (renderer_in_standby()) {
+            if (shown_state == AI_STATE_SLEEPING && !wake) {
+                events = 0;
+                supervisor_checkin(SUPERVISED_UI, SUPERVISOR_PARKED);
+                xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+                continue;
+            }
+            renderer_standby(false);
+        }
+        if (events & UI_EVENT_TOUCH) {
+            renderer_touch_active();
+        }
+        
+#if UI_THEME_NIGHT_IN_DARK
+        // A dark room gets the night colours; a no-op while the level holds
+        ui_theme_set(ambient_level() == AMBIENT_DARK ? UI_THEME_NIGHT : (ui_theme_t)UI_THEME_DEFAULT);
+#endif
+        
+        // Images loaded from the card since the last frame, then refresh
+        // the scene, render and flush
+        image_cache_poll(millis());
+        uint32_t wait_ms = renderer_frame();
+        
+        // A swipe read during that frame moves along the screen ring, and
+        // the new screen is drawn straight away; a long press opens the
+        // setup portal, whose key appears on the ticker
+        gesture_t gesture = gestures_take();
+        if (gesture == GESTURE_SWIPE_LEFT || gesture == GESTURE_SWIPE_RIGHT) {
+            ui_screens_step(gesture == GESTURE_SWIPE_LEFT ? 1 : -1);
+            wait_ms = 0;
+        }
+#if PROVISION_ENABLED
+        if (gesture == GESTURE_LONG_PRESS) {
+            provisioning_request_open();
+        }
+#endif
+        
+        // Sleep until LVGL, the scene on screen or the backlight is next
+        // due, or until the AI or scan task notifies; a still face leaves
+        // core 1 idle. A calm state, a hot die or a dark room gets a lower
+        // frame rate cap, and a screen without motion the renderer's 2 Hz
+        uint32_t now = millis();
+        wait_ms = min(wait_ms, backlight_update(now));
+        wait_ms = min(wait_ms, renderer_scene_wait_ms(now));
+        // Frames that keep overrunning the cap get a longer one
+        uint32_t cap_ms = max(governor_frame_interval_ms(), thermal_frame_interval_ms());
+        cap_ms = max(cap_ms, max(ambient_frame_interval_ms(), renderer_frame_interval_ms()));
+        uint32_t frame_ms = loop_timing_finish(LOOP_UI, cap_ms);
+        wait_ms = constrain(wait_ms, frame_ms, max(frame_ms, (uint32_t)UI_IDLE_INTERVAL_MS));
+        
+        // Asleep long enough: park the panel once the face has settled
+        if (shown_state == AI_STATE_SLEEPING &&
+            now - last_expression_change >= DISPLAY_STANDBY_DELAY_MS &&
+            renderer_standby(true)) {
+            events = 0;
+            continue;
+        }
+        
+        events = 0;
+        supervisor_checkin(SUPERVISED_UI, wait_ms);
+        xTaskNotifyWait(0, UINT32_MAX, &events, pdMS_TO_TICKS(wait_ms));
     }
 }
 
 /**
- * @brief Create the main Ponagotchi UI layout
+ * @brief Wake the UI task to redraw for an external change
  */
-void create_ponagotchi_ui(void) {
-    Serial.println("🎨 Creating Ponagotchi UI...");
-    
-    // Create main screen
-    main_screen = lv_obj_create(NULL);
-    lv_obj_set_style_bg_color(main_screen, lv_color_black(), 0);
-    lv_scr_load(main_screen);
-    
-    // Create face container (center of screen)
-    face_container = lv_obj_create(main_screen);
-    lv_obj_set_size(face_container, 200, 150);
-    lv_obj_center(face_container);
-    lv_obj_set_style_bg_color(face_container, lv_color_black(), 0);
-    lv_obj_set_style_border_width(face_container, 0, 0);
-    
-    // Create eyes
-    left_eye = lv_obj_create(face_container);
-    lv_obj_set_size(left_eye, 30, 30);
-    lv_obj_set_pos(left_eye, 50, 40);
-    lv_obj_set_style_bg_color(left_eye, lv_color_white(), 0);
-    lv_obj_set_style_radius(left_eye, 15, 0);
-    
-    right_eye = lv_obj_create(face_container);
-    lv_obj_set_size(right_eye, 30, 30);
-    lv_obj_set_pos(right_eye, 120, 40);
-    lv_obj_set_style_bg_color(right_eye, lv_color_white(), 0);
-    lv_obj_set_style_radius(right_eye, 15, 0);
-    
-    // Create mouth
-    mouth = lv_obj_create(face_container);
-    lv_obj_set_size(mouth, 60, 20);
-    lv_obj_set_pos(mouth, 70, 90);
-    lv_obj_set_style_bg_color(mouth, lv_color_white(), 0);
-    lv_obj_set_style_radius(mouth, 10, 0);
-    
-    // Create status label (top of screen)
-    status_label = lv_label_create(main_screen);
-    lv_label_set_text(status_label, "🧠 HydraESP AI - Idle");
-    lv_obj_set_style_text_color(status_label, lv_color_white(), 0);
-    lv_obj_set_pos(status_label, 10, 10);
-    
-    // Create stats label (bottom left)
-    stats_label = lv_label_create(main_screen);
-    lv_label_set_text(stats_label, "Memory: OK\nUptime: 0s");
-    lv_obj_set_style_text_color(stats_label, lv_color_hex(0x00FF00), 0);
-    lv_obj_set_style_text_font(stats_label, &lv_font_montserrat_14, 0);
-    lv_obj_set_pos(stats_label, 10, 180);
-    
-    // Create network stats label (bottom right)
-    network_label = lv_label_create(main_screen);
-    lv_label_set_text(network_label, "WiFi: 0\nBLE: 0");
-    lv_obj_set_style_text_color(network_label, lv_color_hex(0x00FFFF), 0);
-    lv_obj_set_style_text_font(network_label, &lv_font_montserrat_12, 0);
-    lv_obj_set_pos(network_label, 250, 180);
-    
-    Serial.println("✅ Ponagotchi UI created successfully");
+void ui_notify(uint32_t events) {
+    TaskHandle_t task = ui_task_self;
+    if (task != NULL) {
+        xTaskNotify(task, events, eSetBits);
+    }
 }
 
 /**
- * @brief Update face expression based on AI state
+ * @brief ui_notify() for interrupt handlers
  */
-void update_face_expression(ai_state_t state) {
-    if (face_container == NULL) return;
-    
-    switch (state) {
-        case AI_STATE_IDLE:
-            // Normal round eyes, small smile
-            lv_obj_set_size(left_eye, 30, 30);
-            lv_obj_set_size(right_eye, 30, 30);
-            lv_obj_set_style_bg_color(mouth, lv_color_white(), 0);
-            lv_obj_set_size(mouth, 40, 15);
-            break;
-            
-        case AI_STATE_SNIFFING:
-            // Wide eyes, focused expression
-            lv_obj_set_size(left_eye, 35, 35);
-            lv_obj_set_size(right_eye, 35, 35);
-            lv_obj_set_style_bg_color(mouth, lv_color_hex(0xFFFF00), 0);
-            lv_obj_set_size(mouth, 30, 10);
-            break;
-            
-        case AI_STATE_EXCITED:
-            // Big round eyes, big smile
-            lv_obj_set_size(left_eye, 40, 40);
-            lv_obj_set_size(right_eye, 40, 40);
-            lv_obj_set_style_bg_color(mouth, lv_color_hex(0x00FF00), 0);
-            lv_obj_set_size(mouth, 70, 25);
-            break;
-            
-        case AI_STATE_LEARNING:
-            // Squinted eyes, thinking
-            lv_obj_set_size(left_eye, 25, 15);
-            lv_obj_set_size(right_eye, 25, 15);
-            lv_obj_set_style_bg_color(mouth, lv_color_hex(0xFF8800), 0);
-            lv_obj_set_size(mouth, 35, 12);
-            break;
-            
-        case AI_STATE_SLEEPING:
-            // Closed eyes, peaceful
-            lv_obj_set_size(left_eye, 30, 5);
-            lv_obj_set_size(right_eye, 30, 5);
-            lv_obj_set_style_bg_color(mouth, lv_color_hex(0x8888FF), 0);
-            lv_obj_set_size(mouth, 25, 8);
-            break;
-            
-        case AI_STATE_ERROR:
-            // X eyes, frown
-            lv_obj_set_size(left_eye, 20, 20);
-            lv_obj_set_size(right_eye, 20, 20);
-            lv_obj_set_style_bg_color(mouth, lv_color_hex(0xFF0000), 0);
-            lv_obj_set_size(mouth, 50, 8);
-            break;
-            
-        default:
-            break;
+void IRAM_ATTR ui_notify_from_isr(uint32_t events) {
+    TaskHandle_t task = ui_task_self;
+    if (task != NULL) {
+        BaseType_t woken = pdFALSE;
+        xTaskNotifyFromISR(task, events, eSetBits, &woken);
+        portYIELD_FROM_ISR(woken);
     }
 }
 
 /**
- * @brief Update status bar with current information
+ * @brief Memory pressure shrinker: hand the work to the UI task, which owns LVGL
+ * @return 0; the UI task credits what it frees
  */
-void update_status_bar(void) {
-    if (status_label == NULL || stats_label == NULL || network_label == NULL) return;
-    
-    // Update main status
-    static char status_text[64];
-    snprintf(status_text, sizeof(status_text), "%s %s", 
-             ai_state_to_emoji(current_ai_state),
-             ai_state_to_string(current_ai_state));
-    lv_label_set_text(status_label, status_text);
-    
-    // Update system stats (thread-safe)
-    if (xSemaphoreTake(sensor_data_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-        static char stats_text[64];
-        snprintf(stats_text, sizeof(stats_text), 
-                "Mem: %luKB\nUp: %lus", 
-                global_sensor_data.free_memory / 1024,
-                global_sensor_data.uptime_seconds);
-        lv_label_set_text(stats_label, stats_text);
-        
-        // Update network stats
-        static char network_text[64];
-        snprintf(network_text, sizeof(network_text),
-                "WiFi: %d\nBLE: %d",
-                global_sensor_data.wifi_networks_count,
-                global_sensor_data.ble_devices_count);
-        lv_label_set_text(network_label, network_text);
-        
-        xSemaphoreGive(sensor_data_mutex);
-    }
+static size_t ui_shrink(memory_pressure_t level) {
+    ui_pressure = level;
+    ui_notify(UI_EVENT_MEMORY);
+    return 0;
 }
+
 /**
- * @file ui_task.cpp
- * @brief UI task with LVGL integration
+ * @brief Drop idle screens, and under high pressure the full-frame buffers
  */
-
-#include <Arduino.h>
-#include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
-#include <freertos/queue.h>
-#include <SPI.h>
-#include <TFT_eSPI.h>
-#include <lvgl.h>
-#include "config.h"
-#include "ai_states.h"
-
-// External variables
-extern ai_state_t current_ai_state;
-extern QueueHandle_t ai_state_queue;
-
-// LVGL objects
-static lv_obj_t* main_screen = NULL;
-static lv_obj_t* face_label = NULL;
-static lv_obj_t* stats_label = NULL;
-
-// TFT instance
-TFT_eSPI tft = TFT_eSPI();
-
-// LVGL display buffer
-static lv_disp_draw_buf_t draw_buf;
-static lv_color_t buf[TFT_WIDTH * 10];
-
-// Forward declarations
-void display_flush(lv_disp_drv_t* disp, const lv_area_t* area, lv_color_t* color_p);
-void create_ponagotchi_ui(void);
-void update_face_expression(ai_state_t state);
-void update_stats_display(void);
+static void release_memory(void) {
+    memory_pressure_t level = ui_pressure;
+    size_t before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    uint8_t evicted = renderer_release_memory(level >= MEMORY_PRESSURE_HIGH);
+    size_t after = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t freed = after > before ? after - before : 0;
+    memory_pressure_credit(ui_shrinker, freed);
+    LOGI(UI, "🧹 UI released %u screens, %u bytes (%s pressure)",
+         evicted, (unsigned)freed, memory_pressure_name(level));
+}
 
 /**
- * @brief UI Task - handles display and animations
+ * @brief Create the main Ponagotchi UI layout on the scene's screen
+ *
+ * A flex column (see ui_layout.h): status row, the face centred in the
+ * space left over, and the stats and network columns along the bottom.
+ * It fits any panel the face atlas fits, in either orientation.
  */
-void ui_task(void* parameter) {
-    Serial.println("🎨 UI Task started");
-    
-    // Initialize TFT display
-    tft.init();
-    tft.setRotation(1);
-    tft.fillScreen(TFT_BLACK);
+void create_ponagotchi_ui(lv_obj_t* screen) {
+    LOGI(UI, "🎨 Creating Ponagotchi UI...");
     
-    // Initialize LVGL
-    lv_init();
+    main_screen = screen;
+    ui_layout_screen(main_screen);
     
-    // Initialize display buffer
-    lv_disp_draw_buf_init(&draw_buf, buf, NULL, TFT_WIDTH * 10);
+    // Status icon and label (top); the icon replaces the state emoji,
+    // which the subset fonts do not carry
+    lv_obj_t* status_row = ui_layout_box(main_screen, LV_FLEX_FLOW_ROW);
+    ui_layout_fill(status_row, 0);
+    lv_obj_set_flex_align(status_row, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+    ui_theme_apply(status_row, UI_STYLE_STATUS_ROW);
+    status_icon = lv_img_create(status_row);
+    lv_img_set_src(status_icon, face_icons[shown_state]);
+    lv_obj_t* label = renderer_label_create(&status_label, status_row, UI_REFRESH_STATUS_MS);
+    ui_theme_apply(label, UI_STYLE_TEXT);
+    status_text = label;
+    ui_theme_set_state(status_text, styled_state, shown_state);
+    styled_state = shown_state;
+    ui_layout_line(label);
+    lv_obj_set_width(label, 0);
+    lv_obj_set_flex_grow(label, 1);
     
-    // Initialize display driver
-    static lv_disp_drv_t disp_drv;
-    lv_disp_drv_init(&disp_drv);
-    disp_drv.hor_res = TFT_WIDTH;
-    disp_drv.ver_res = TFT_HEIGHT;
-    disp_drv.flush_cb = display_flush;
-    disp_drv.draw_buf = &draw_buf;
-    lv_disp_drv_register(&disp_drv);
+    // Face, drawn from the prerendered atlas and cropped to the space left
+    lv_obj_t* face_area = lv_obj_create(main_screen);
+    lv_obj_remove_style_all(face_area);
+    ui_layout_fill(face_area, 1);
+    lv_obj_clear_flag(face_area, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_clear_flag(face_area, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(face_area, fit_face_cb, LV_EVENT_SIZE_CHANGED, NULL);
+    face_img = lv_img_create(face_area);
+    lv_obj_center(face_img);
+    face_anim_init(face_img, shown_state);
     
-    // Create UI
-    create_ponagotchi_ui();
+    // Stats (bottom left) and network counters (bottom right)
+    lv_obj_t* footer = ui_layout_box(main_screen, LV_FLEX_FLOW_ROW);
+    ui_layout_fill(footer, 0);
+    lv_obj_set_flex_align(footer, LV_FLEX_ALIGN_SPACE_BETWEEN, LV_FLEX_ALIGN_END, LV_FLEX_ALIGN_END);
+    lv_obj_t* stats_column = ui_layout_box(footer, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_width(stats_column, lv_pct(60));
+    lv_obj_t* network_column = ui_layout_box(footer, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_width(network_column, lv_pct(40));
     
-    TickType_t last_wake_time = xTaskGetTickCount();
-    ai_state_t new_state;
+    renderer_label_t* stats[] = { &memory_label, &uptime_label, &inference_label, &margin_label };
+    const uint32_t stats_period[] = {
+        UI_REFRESH_MEMORY_MS, UI_REFRESH_UPTIME_MS, UI_REFRESH_AI_MS, UI_REFRESH_AI_MS
+    };
+    for (uint8_t i = 0; i < 4; i++) {
+        label = renderer_label_create(stats[i], stats_column, stats_period[i]);
+        ui_theme_apply(label, UI_STYLE_STATS);
+        ui_layout_line(label);
+    }
     
-    while (true) {
-        // Check for AI state updates
-        if (xQueueReceive(ai_state_queue, &new_state, 0) == pdTRUE) {
-            update_face_expression(new_state);
-        }
-        
-        // Update statistics display
-        update_stats_display();
-        
-        // Handle LVGL tasks
-        lv_timer_handler();
-        
-        // Sleep until next update
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(UI_UPDATE_INTERVAL));
+    renderer_label_t* network[] = { &wifi_label, &ble_label };
+    for (uint8_t i = 0; i < 2; i++) {
+        label = renderer_label_create(network[i], network_column, UI_REFRESH_NETWORK_MS);
+        ui_theme_apply(label, UI_STYLE_NETWORK);
+        ui_layout_line(label);
     }
+    
+    LOGI(UI, "✅ Ponagotchi UI created successfully");
 }
 
 /**
- * @brief LVGL display flush callback
+ * @brief Face area laid out: show as much of the atlas frame as fits, centred
+ *
+ * Frames carry a wide black margin around the features, so a short panel
+ * loses only margin. Runs on build and rotation, never per frame.
  */
-void display_flush(lv_disp_drv_t* disp, const lv_area_t* area, lv_color_t* color_p) {
-    uint32_t w = (area->x2 - area->x1 + 1);
-    uint32_t h = (area->y2 - area->y1 + 1);
-    
-    tft.startWrite();
-    tft.setAddrWindow(area->x1, area->y1, w, h);
-    tft.pushColors((uint16_t*)&color_p->full, w * h, true);
-    tft.endWrite();
-    
-    lv_disp_flush_ready(disp);
+static void fit_face_cb(lv_event_t* event) {
+    lv_obj_t* area = lv_event_get_target(event);
+    lv_coord_t w = min(lv_obj_get_content_width(area), (lv_coord_t)FACE_ATLAS_WIDTH);
+    lv_coord_t h = min(lv_obj_get_content_height(area), (lv_coord_t)FACE_ATLAS_HEIGHT);
+    lv_obj_set_size(face_img, w, h);
+    lv_img_set_offset_x(face_img, -(FACE_ATLAS_WIDTH - w) / 2);
+    lv_img_set_offset_y(face_img, -(FACE_ATLAS_HEIGHT - h) / 2);
 }
 
 /**
- * @brief Create Ponagotchi-style UI
+ * @brief Per-frame refresh of the face scene
  */
-void create_ponagotchi_ui(void) {
-    // Create main screen
-    main_screen = lv_scr_act();
-    lv_obj_set_style_bg_color(main_screen, lv_color_black(), 0);
-    
-    // Create face label (centered)
-    face_label = lv_label_create(main_screen);
-    lv_obj_set_style_text_font(face_label, &lv_font_montserrat_48, 0);
-    lv_obj_set_style_text_color(face_label, lv_color_white(), 0);
-    lv_obj_align(face_label, LV_ALIGN_CENTER, 0, -20);
-    lv_label_set_text(face_label, "😊");
+void update_face_scene(uint32_t now_ms) {
+    // Update status information
+    update_status_bar(now_ms);
     
-    // Create stats label (bottom)
-    stats_label = lv_label_create(main_screen);
-    lv_obj_set_style_text_font(stats_label, &lv_font_montserrat_14, 0);
-    lv_obj_set_style_text_color(stats_label, lv_color_white(), 0);
-    lv_obj_align(stats_label, LV_ALIGN_BOTTOM_MID, 0, -10);
-    lv_label_set_text(stats_label, "Initializing...");
+    // Automatic blinking and breathing
+    face_anim_update(now_ms);
+}
+
+/**
+ * @brief Time until the face scene has a blink, breath or label due
+ */
+uint32_t face_scene_wait_ms(uint32_t now_ms) {
+    return min(face_anim_quiet_ms(now_ms), status_bar_wait_ms(now_ms));
 }
 
 /**
  * @brief Update face expression based on AI state
+ *
+ * Each expression is a prerendered frame (see tools/face_atlas); the change
+ * is eased in as a blink that swaps the face while the eyes are shut. The
+ * status text changes colour by swapping one shared style for another.
  */
 void update_face_expression(ai_state_t state) {
-    const char* face = "😊";  // Default idle face
-    
-    switch (state) {
-        case AI_STATE_IDLE:
-            face = "😊";
-            break;
-        case AI_STATE_SNIFFING:
-            face = "👃";
-            break;
-        case AI_STATE_TRACKING:
-            face = "👁️";
-            break;
-        case AI_STATE_LEARNING:
-            face = "🧠";
-            break;
-        case AI_STATE_EXCITED:
-            face = "🤩";
-            break;
-        case AI_STATE_SLEEPING:
-            face = "😴";
-            break;
-        case AI_STATE_ERROR:
-            face = "💀";
-            break;
-        case AI_STATE_UPDATING:
-            face = "🔄";
-            break;
-    }
+    backlight_set_state(state);
+    if (face_img == NULL) return;
     
-    if (face_label) {
-        lv_label_set_text(face_label, face);
-    }
+    lv_img_set_src(status_icon, face_icons[state]);
+    ui_theme_set_state(status_text, styled_state, state);
+    styled_state = state;
+    face_anim_set_state(state);
 }
 
 /**
- * @brief Update statistics display
+ * @brief Update status bar with current information
+ *
+ * Each field is re-formatted at its own UI_REFRESH_*_MS rate and only
+ * redrawn when the text differs, so an idle screen sends almost nothing
+ * over SPI.
  */
-void update_stats_display(void) {
-    static uint32_t last_update = 0;
+void update_status_bar(uint32_t now_ms) {
+    // Update main status
+    if (renderer_label_due(&status_label, now_ms)) {
+        renderer_label_printf(&status_label, now_ms, "%s", ai_state_to_string(shown_state));
+    }
     
-    if (millis() - last_update > 1000) {  // Update every second
-        char stats_text[100];
-        snprintf(stats_text, sizeof(stats_text), 
-                "State: %s | Memory: %d KB | Uptime: %d s",
-                ai_state_to_string(current_ai_state),
-                ESP.getFreeHeap() / 1024,
-                millis() / 1000);
+    // Update system and network stats from a consistent snapshot (never blocks)
+    bool data_due = renderer_label_due(&memory_label, now_ms) ||
+                    renderer_label_due(&uptime_label, now_ms) ||
+                    renderer_label_due(&wifi_label, now_ms);
+    if (data_due) {
+        sensor_data_t data;
+        sensor_snapshot_read(&data);
         
-        if (stats_label) {
-            lv_label_set_text(stats_label, stats_text);
+        if (renderer_label_due(&memory_label, now_ms)) {
+            renderer_label_printf(&memory_label, now_ms, "Mem: %luKB", data.free_memory / 1024);
         }
-        
-        last_update = millis();
+        if (renderer_label_due(&uptime_label, now_ms)) {
+            renderer_label_printf(&uptime_label, now_ms, "Up: %lus", data.uptime_seconds);
+        }
+        if (renderer_label_due(&wifi_label, now_ms)) {
+            renderer_label_printf(&wifi_label, now_ms, "WiFi: %d", data.wifi_networks_count);
+            renderer_label_printf(&ble_label, now_ms, "BLE: %d", data.ble_devices_count);
+        }
+    }
+    
+    // Inference latency and how decisive the model is
+    if (renderer_label_due(&inference_label, now_ms)) {
+        ai_telemetry_t telemetry;
+        ai_telemetry_get(&telemetry);
+        renderer_label_printf(&inference_label, now_ms, "AI: %luus p99 %luus",
+                              telemetry.avg_us, telemetry.p99_us);
+        if (telemetry.margins > 0) {
+            renderer_label_printf(&margin_label, now_ms, "Margin: %.2f", telemetry.mean_margin);
+        } else {
+            renderer_label_printf(&margin_label, now_ms, "Margin: --");
+        }
+    }
+}
+
+/**
+ * @brief Time until the next periodic status label is due
+ */
+uint32_t status_bar_wait_ms(uint32_t now_ms) {
+    const renderer_label_t* periodic[] = {
+        &status_label, &memory_label, &uptime_label, &inference_label, &wifi_label
+    };
+    uint32_t wait_ms = UINT32_MAX;
+    for (uint8_t i = 0; i < sizeof(periodic) / sizeof(periodic[0]); i++) {
+        wait_ms = min(wait_ms, renderer_label_wait_ms(periodic[i], now_ms));
     }
+    return wait_ms;
 }
@@ -0,0 +1,415 @@
+/**
+ * @file telemetry_summary.cpp
+ * @brief Minute and hour summaries of the scan cycles, in fixed memory
+ *
+ * A window opens with the first cycle after the last one closed and
+ * closes with the first cycle at least its period after it opened, so a
+ * window never holds half a cycle and a node that stops scanning sends
+ * nothing rather than empty windows. The hour takes each minute whole
+ * when the minute closes, except for its sketch: a space-saving sketch
+ * cannot be merged from another of the same size without losing its
+ * bound, so every cycle's devices are counted into both.
+ *
+ * Everything here runs on the scan task but the pending queue and the
+ * figures, which the uplink and the status report read under summary_mux.
+ */
+
+#include <Arduino.h>
+#include "config.h"
+#include "device_table.h"
+#include "time_sync.h"
+#include "ap_anomaly.h"
+#include "telemetry_summary.h"
+
+#define COUNT_BINS      64          // 0-15 exact, then four an octave up to 65535
+#define MINUTE_MS       60000UL
+#define HOUR_MS         3600000UL
+
+/**
+ * @brief Log-spaced histogram of one per-cycle figure
+ */
+typedef struct {
+    uint16_t bins[COUNT_BINS];
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+} count_hist_t;
+
+/**
+ * @brief One open window
+ */
+typedef struct {
+    bool          open;
+    uint32_t      start_ms;
+    uint32_t      utc_s;
+    uint32_t      last_ms;          // Of the latest cycle in it
+    uint16_t      cycles;
+    uint16_t      novelty_peak;
+    uint16_t      unusual_cycles;
+    uint8_t       unusual_peak;
+    uint32_t      novel;
+    uint32_t      appeared;
+    uint32_t      lost;
+    uint32_t      moved;
+    uint32_t      ap_anomalies;
+    count_hist_t  metrics[SUMMARY_METRIC_COUNT];
+    rssi_hist_t   wifi_rssi;
+    rssi_hist_t   ble_rssi;
+    uint8_t       sketch_used;
+    uint16_t      replaced;         // Devices displaced from the full sketch
+    summary_top_t sketch[SUMMARY_SKETCH_SLOTS];
+} window_t;
+
+static_assert(SUMMARY_TOP_K <= SUMMARY_SKETCH_SLOTS, "the top devices come from the sketch");
+
+static window_t windows[SUMMARY_PERIOD_COUNT];
+static uint32_t ap_seen = 0;        // Anomalies detected when the last cycle was folded
+
+static portMUX_TYPE summary_mux = portMUX_INITIALIZER_UNLOCKED;
+static telemetry_summary_t pending[SUMMARY_PENDING];
+static uint8_t pending_head = 0;
+static uint8_t pending_count = 0;
+static telemetry_summary_stats_t stats;
+
+// Forward declarations
+static void open_window(window_t* window, uint32_t now_ms);
+static void add_cycle(window_t* window, const sensor_data_t* data,
+                      const scan_histograms_t* histograms, uint32_t ap_anomalies, uint32_t now_ms);
+static void fold_window(window_t* into, const window_t* from);
+static void sketch_add(window_t* window, const device_entry_t* entry, uint32_t weight);
+static void close_window(window_t* window, summary_period_t period);
+static void count_add(count_hist_t* hist, uint16_t value, bool first);
+static uint16_t count_quantile(const count_hist_t* hist, uint16_t total, uint8_t percent);
+static void rssi_fold(rssi_hist_t* into, const rssi_hist_t* from);
+static uint32_t ap_anomaly_total(void);
+
+/**
+ * @brief Open the first windows
+ */
+void telemetry_summary_init(void) {
+    memset(windows, 0, sizeof(windows));
+    ap_seen = ap_anomaly_total();
+    portENTER_CRITICAL(&summary_mux);
+    memset(&stats, 0, sizeof(stats));
+    pending_head = pending_count = 0;
+    portEXIT_CRITICAL(&summary_mux);
+}
+
+/**
+ * @brief Fold one published cycle into the minute, closing windows it ends (scan task)
+ */
+void telemetry_summary_cycle(const sensor_data_t* data, const scan_histograms_t* histograms,
+                             uint16_t cycle, uint32_t now_ms) {
+    window_t* minute = &windows[SUMMARY_PERIOD_MINUTE];
+    window_t* hour = &windows[SUMMARY_PERIOD_HOUR];
+
+    // Close what this cycle falls past, the minute first so the hour has it
+    if (minute->open && now_ms - minute->start_ms >= MINUTE_MS) {
+        fold_window(hour, minute);
+        close_window(minute, SUMMARY_PERIOD_MINUTE);
+        if (now_ms - hour->start_ms >= HOUR_MS) {
+            close_window(hour, SUMMARY_PERIOD_HOUR);
+        }
+    }
+    if (!minute->open) {
+        open_window(minute, now_ms);
+    }
+    if (!hour->open) {
+        open_window(hour, now_ms);
+    }
+
+    uint32_t ap_total = ap_anomaly_total();
+    add_cycle(minute, data, histograms, ap_total - ap_seen, now_ms);
+    ap_seen = ap_total;
+
+    // Devices heard this cycle, each weighing the square of its signal
+    // above the floor, so the few near ones outweigh the crowd at the edge
+    uint32_t capacity = device_table_capacity();
+    for (uint32_t i = 0; i < capacity; i++) {
+        const device_entry_t* entry = device_table_entry_at(i);
+        if (entry == NULL || entry->last_cycle != cycle) {
+            continue;
+        }
+        uint32_t margin = (uint32_t)constrain(entry->rssi_last + 100, 1, 100);
+        uint32_t weight = margin * margin;
+        sketch_add(minute, entry, weight);
+        sketch_add(hour, entry, weight);
+    }
+}
+
+/**
+ * @brief Take the oldest closed summary the uplink has not had (any task)
+ */
+bool telemetry_summary_take(telemetry_summary_t* summary) {
+    portENTER_CRITICAL(&summary_mux);
+    bool any = pending_count > 0;
+    if (any) {
+        *summary = pending[pending_head];
+        pending_head = (pending_head + 1) % SUMMARY_PENDING;
+        pending_count--;
+        stats.taken++;
+    }
+    portEXIT_CRITICAL(&summary_mux);
+    return any;
+}
+
+/**
+ * @brief Copy the figures and the last closed minute
+ */
+void telemetry_summary_get_stats(telemetry_summary_stats_t* out) {
+    portENTER_CRITICAL(&summary_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&summary_mux);
+}
+
+/**
+ * @brief Start a window at this cycle
+ */
+static void open_window(window_t* window, uint32_t now_ms) {
+    memset(window, 0, sizeof(*window));
+    window->open = true;
+    window->start_ms = now_ms;
+    int64_t wall_us;
+    window->utc_s = time_sync_wall_us(&wall_us) ? (uint32_t)(wall_us / 1000000) : 0;
+    rssi_hist_reset(&window->wifi_rssi);
+    rssi_hist_reset(&window->ble_rssi);
+}
+
+/**
+ * @brief Fold one cycle's figures into a window
+ */
+static void add_cycle(window_t* window, const sensor_data_t* data,
+                      const scan_histograms_t* histograms, uint32_t ap_anomalies, uint32_t now_ms) {
+    const uint16_t values[SUMMARY_METRIC_COUNT] = {
+        data->wifi_networks_count, data->ble_devices_count, data->wifi_clients_count,
+        data->capture_frames_per_second, data->airtime_permille
+    };
+    for (uint8_t m = 0; m < SUMMARY_METRIC_COUNT; m++) {
+        count_add(&window->metrics[m], values[m], window->cycles == 0);
+    }
+    rssi_fold(&window->wifi_rssi, &histograms->wifi_all);
+    rssi_fold(&window->ble_rssi, &histograms->ble);
+
+    window->novel += data->novel_devices;
+    window->appeared += data->devices_appeared;
+    window->lost += data->devices_lost;
+    window->moved += data->devices_moved;
+    window->novelty_peak = max(window->novelty_peak, (uint16_t)data->novelty_permille);
+    window->unusual_peak = max(window->unusual_peak, (uint8_t)data->unusual_z10);
+    window->unusual_cycles += data->unusual_z10 >= SUMMARY_ANOMALY_Z10 ? 1 : 0;
+    window->ap_anomalies += ap_anomalies;
+    window->last_ms = now_ms;
+    window->cycles++;
+}
+
+/**
+ * @brief Add a closed minute to the hour; the sketch was fed directly
+ */
+static void fold_window(window_t* into, const window_t* from) {
+    if (from->cycles == 0) {
+        return;
+    }
+    for (uint8_t m = 0; m < SUMMARY_METRIC_COUNT; m++) {
+        count_hist_t* hist = &into->metrics[m];
+        const count_hist_t* add = &from->metrics[m];
+        hist->min = into->cycles == 0 ? add->min : min(hist->min, add->min);
+        hist->max = into->cycles == 0 ? add->max : max(hist->max, add->max);
+        hist->sum += add->sum;
+        for (uint8_t b = 0; b < COUNT_BINS; b++) {
+            hist->bins[b] += add->bins[b];
+        }
+    }
+    rssi_fold(&into->wifi_rssi, &from->wifi_rssi);
+    rssi_fold(&into->ble_rssi, &from->ble_rssi);
+
+    into->novel += from->novel;
+    into->appeared += from->appeared;
+    into->lost += from->lost;
+    into->moved += from->moved;
+    into->novelty_peak = max(into->novelty_peak, from->novelty_peak);
+    into->unusual_peak = max(into->unusual_peak, from->unusual_peak);
+    into->unusual_cycles += from->unusual_cycles;
+    into->ap_anomalies += from->ap_anomalies;
+    into->last_ms = from->last_ms;
+    into->cycles += from->cycles;
+}
+
+/**
+ * @brief Count a sighting in the sketch, displacing its lightest device if it is full
+ *
+ * The newcomer takes over the lightest counter's weight as its error, so
+ * no device that really outweighs the K-th heaviest can be missing.
+ */
+static void sketch_add(window_t* window, const device_entry_t* entry, uint32_t weight) {
+    summary_top_t* lightest = NULL;
+    for (uint8_t i = 0; i < window->sketch_used; i++) {
+        summary_top_t* slot = &window->sketch[i];
+        if (slot->kind == entry->kind && memcmp(slot->mac, entry->mac, sizeof(slot->mac)) == 0) {
+            slot->weight += weight;
+            slot->rssi_max = max(slot->rssi_max, entry->rssi_last);
+            return;
+        }
+        if (lightest == NULL || slot->weight < lightest->weight) {
+            lightest = slot;
+        }
+    }
+
+    summary_top_t* slot;
+    if (window->sketch_used < SUMMARY_SKETCH_SLOTS) {
+        slot = &window->sketch[window->sketch_used++];
+        slot->error = 0;
+        slot->weight = weight;
+    } else {
+        slot = lightest;
+        slot->error = lightest->weight;
+        slot->weight = lightest->weight + weight;
+        window->replaced++;
+    }
+    memcpy(slot->mac, entry->mac, sizeof(slot->mac));
+    slot->kind = entry->kind;
+    slot->rssi_max = entry->rssi_last;
+}
+
+/**
+ * @brief Write a window's summary out for the uplink and the figures, and close it
+ */
+static void close_window(window_t* window, summary_period_t period) {
+    if (!window->open || window->cycles == 0) {
+        window->open = false;
+        return;
+    }
+
+    telemetry_summary_t summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.version = TELEMETRY_SUMMARY_VERSION;
+    summary.period = period;
+    summary.cycles = window->cycles;
+    summary.start_s = window->start_ms / 1000;
+    summary.utc_s = window->utc_s;
+    summary.span_s = (uint16_t)min((window->last_ms - window->start_ms) / 1000, (uint32_t)UINT16_MAX);
+    summary.unusual_peak_z10 = window->unusual_peak;
+    summary.novel_devices = window->novel;
+    summary.appeared = window->appeared;
+    summary.lost = window->lost;
+    summary.moved = window->moved;
+    for (uint8_t m = 0; m < SUMMARY_METRIC_COUNT; m++) {
+        const count_hist_t* hist = &window->metrics[m];
+        summary_quantiles_t* out = &summary.metrics[m];
+        out->min = hist->min;
+        out->p50 = count_quantile(hist, window->cycles, 50);
+        out->p90 = count_quantile(hist, window->cycles, 90);
+        out->max = hist->max;
+        out->mean = (uint16_t)(hist->sum / window->cycles);
+    }
+    summary.novelty_peak_permille = window->novelty_peak;
+    summary.unusual_cycles = window->unusual_cycles;
+    summary.ap_anomalies = (uint16_t)min(window->ap_anomalies, (uint32_t)UINT16_MAX);
+    const uint8_t percents[3] = { 10, 50, 90 };
+    for (uint8_t q = 0; q < 3; q++) {
+        summary.wifi_rssi[q] = rssi_hist_quantile(&window->wifi_rssi, percents[q]);
+        summary.ble_rssi[q] = rssi_hist_quantile(&window->ble_rssi, percents[q]);
+    }
+
+    // Heaviest first; the window is done with, so its sketch is sorted in place
+    for (uint8_t i = 1; i < window->sketch_used; i++) {
+        summary_top_t slot = window->sketch[i];
+        uint8_t j = i;
+        for (; j > 0 && window->sketch[j - 1].weight < slot.weight; j--) {
+            window->sketch[j] = window->sketch[j - 1];
+        }
+        window->sketch[j] = slot;
+    }
+    summary.top_count = min(window->sketch_used, (uint8_t)SUMMARY_TOP_K);
+    memcpy(summary.top, window->sketch, summary.top_count * sizeof(summary_top_t));
+
+    bool uplinked = MQTT_ENABLED && (period == SUMMARY_PERIOD_HOUR || SUMMARY_UPLINK_MINUTES);
+    portENTER_CRITICAL(&summary_mux);
+    stats.closed[period]++;
+    if (period == SUMMARY_PERIOD_MINUTE) {
+        stats.last_minute = summary;
+        stats.sketch_replaced = window->replaced;
+    }
+    if (uplinked) {
+        if (pending_count == SUMMARY_PENDING) {
+            pending_head = (pending_head + 1) % SUMMARY_PENDING;
+            pending_count--;
+            stats.dropped++;
+        }
+        pending[(pending_head + pending_count) % SUMMARY_PENDING] = summary;
+        pending_count++;
+    }
+    portEXIT_CRITICAL(&summary_mux);
+
+    window->open = false;
+}
+
+/**
+ * @brief Count one value, four buckets an octave past 15
+ */
+static void count_add(count_hist_t* hist, uint16_t value, bool first) {
+    uint8_t bin = (uint8_t)value;
+    if (value >= 16) {
+        uint8_t octave = 31 - __builtin_clz(value);
+        bin = 16 + (octave - 4) * 4 + ((value >> (octave - 2)) & 3);
+    }
+    hist->bins[bin]++;
+    hist->min = first ? value : min(hist->min, value);
+    hist->max = first ? value : max(hist->max, value);
+    hist->sum += value;
+}
+
+/**
+ * @brief Middle of the bucket holding a quantile, kept within the range seen
+ */
+static uint16_t count_quantile(const count_hist_t* hist, uint16_t total, uint8_t percent) {
+    uint32_t rank = (uint32_t)total * percent / 100;
+    uint32_t seen = 0;
+    uint8_t bin = 0;
+    for (; bin < COUNT_BINS - 1; bin++) {
+        seen += hist->bins[bin];
+        if (seen > rank) {
+            break;
+        }
+    }
+    uint32_t value = bin;
+    if (bin >= 16) {
+        uint8_t octave = 4 + (bin - 16) / 4;
+        uint32_t width = 1UL << (octave - 2);
+        value = (4 + (bin - 16) % 4) * width + width / 2;
+    }
+    return (uint16_t)constrain(value, (uint32_t)hist->min, (uint32_t)hist->max);
+}
+
+/**
+ * @brief Add one RSSI histogram to another, halving the total first if it would overflow
+ */
+static void rssi_fold(rssi_hist_t* into, const rssi_hist_t* from) {
+    while ((uint32_t)into->count + from->count > UINT16_MAX && into->count > 0) {
+        into->count = 0;
+        for (uint8_t b = 0; b < RSSI_HIST_BINS; b++) {
+            into->bins[b] /= 2;
+            into->count += into->bins[b];
+        }
+    }
+    for (uint8_t b = 0; b < RSSI_HIST_BINS; b++) {
+        into->bins[b] += from->bins[b];
+    }
+    into->count += from->count;
+}
+
+/**
+ * @brief Rogue access point detections since boot, every pattern together
+ */
+static uint32_t ap_anomaly_total(void) {
+#if AP_ANOMALY_ENABLED
+    ap_anomaly_stats_t anomalies;
+    ap_anomaly_get_stats(&anomalies);
+    uint32_t total = 0;
+    for (uint8_t a = 0; a < AP_ANOMALY_COUNT; a++) {
+        total += anomalies.detected[a];
+    }
+    return total;
+#else
+    return 0;
+#endif
+}
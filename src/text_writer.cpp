@@ -0,0 +1,47 @@
+/**
+ * @file text_writer.cpp
+ * @brief Bounded printf appends for the HTTP handlers' response buffers
+ *
+ * vsnprintf returns the length it would have written, so the usual
+ * len += snprintf(buf + len, sizeof(buf) - len, ...) chain walks past the
+ * buffer after one truncated append and wraps the remaining size. Here a
+ * short write stops the chain instead.
+ */
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include "text_writer.h"
+
+/**
+ * @brief Start an empty text in out
+ */
+void text_writer_init(text_writer_t* writer, char* out, size_t capacity) {
+    writer->out = out;
+    writer->capacity = capacity;
+    writer->length = 0;
+    writer->truncated = capacity == 0;
+    if (capacity > 0) {
+        out[0] = '\0';
+    }
+}
+
+/**
+ * @brief Append printf-style text, or nothing once the buffer is full
+ */
+void text_printf(text_writer_t* writer, const char* format, ...) {
+    if (writer->truncated) {
+        return;
+    }
+    size_t room = writer->capacity - writer->length;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(writer->out + writer->length, room, format, args);
+    va_end(args);
+    if (n >= 0 && (size_t)n < room) {
+        writer->length += n;
+    } else {
+        writer->truncated = true;
+        writer->out[writer->length] = '\0';   // Ends at the last append that fitted
+    }
+}
@@ -0,0 +1,187 @@
+/**
+ * @file thermal.cpp
+ * @brief Filtered die temperature and graded thermal throttling
+ *
+ * Single readings of the S3 sensor jitter by a degree or two, so the
+ * throttling follows an EWMA of them. Each threshold adds one measure,
+ * cheapest first: the scan interval goes to its ceiling, which keeps the
+ * radios off longest; then the UI frame rate is capped; then the CPU is
+ * clocked down. A step is only released THERMAL_HYSTERESIS_C below its
+ * threshold, so a unit at the edge does not flap between them.
+ */
+
+#include <Arduino.h>
+#include <esp_idf_version.h>
+#include "config.h"
+#include "power_manager.h"
+#include "thermal.h"
+#include "tunables.h"
+#include "logger.h"
+
+// The classic ESP32 (BOARD_PROFILE_CYD) has no sensor driver, only temperatureRead()
+#if CONFIG_IDF_TARGET_ESP32
+#elif ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <driver/temperature_sensor.h>
+static temperature_sensor_handle_t sensor = NULL;
+#else
+#include <driver/temp_sensor.h>
+#endif
+
+static const char* const level_names[THERMAL_LEVELS] = { "normal", "scan", "ui", "cpu" };
+
+static thermal_status_t status;
+static volatile thermal_level_t level = THERMAL_NORMAL;
+static volatile float filtered = 0;
+static uint16_t nominal_mhz = 0;
+static uint32_t last_sample_ms = 0;
+static bool sampled = false;
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static bool read_sensor(float* celsius);
+static void set_cpu_mhz(uint16_t mhz);
+
+/**
+ * @brief Start the die temperature sensor in its 20-100 °C range
+ */
+bool thermal_init(void) {
+    power_status_t power;
+    power_manager_get_status(&power);
+    nominal_mhz = power.max_mhz;
+    status.cpu_mhz = nominal_mhz;
+    status.frame_interval_ms = UI_UPDATE_INTERVAL;
+#if CONFIG_IDF_TARGET_ESP32
+    status.sensor_driver = false;
+#elif ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    temperature_sensor_config_t config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(20, 100);
+    status.sensor_driver = temperature_sensor_install(&config, &sensor) == ESP_OK &&
+                           temperature_sensor_enable(sensor) == ESP_OK;
+#else
+    temp_sensor_config_t config = TSENS_CONFIG_DEFAULT();
+    config.dac_offset = TSENS_DAC_L1;    // 20-100 °C, error under 2 °C
+    status.sensor_driver = temp_sensor_set_config(config) == ESP_OK && temp_sensor_start() == ESP_OK;
+#endif
+    if (!status.sensor_driver) {
+        LOGW(SYSTEM, "⚠️  Temperature sensor driver unavailable - using temperatureRead()");
+    }
+    return status.sensor_driver;
+}
+
+/**
+ * @brief Read the sensor, filter it and step the throttling up or down
+ */
+void thermal_sample(uint32_t now_ms) {
+    float raw;
+    if (!read_sensor(&raw)) {
+        return;
+    }
+    float celsius = sampled ? filtered + THERMAL_EWMA_ALPHA * (raw - filtered) : raw;
+
+    // Tunable at run time, so taken afresh each sample
+    const float thresholds[THERMAL_LEVELS] = {
+        -273.0,
+        (float)tunable_get(TUNABLE_THERMAL_SCAN_C),
+        (float)tunable_get(TUNABLE_THERMAL_UI_C),
+        (float)tunable_get(TUNABLE_THERMAL_CPU_C)
+    };
+
+    // Up to the highest threshold reached; down while under the release point
+    thermal_level_t next = level;
+    while (next + 1 < THERMAL_LEVELS && celsius >= thresholds[next + 1]) {
+        next = (thermal_level_t)(next + 1);
+    }
+    while (next > THERMAL_NORMAL && celsius < thresholds[next] - THERMAL_HYSTERESIS_C) {
+        next = (thermal_level_t)(next - 1);
+    }
+
+    if (next != level) {
+        uint16_t mhz = next >= THERMAL_CPU_THROTTLED ? THERMAL_CPU_MHZ : nominal_mhz;
+        if (mhz != status.cpu_mhz) {
+            set_cpu_mhz(mhz);
+        }
+        LOGI(SYSTEM, "🌡️ Thermal %s -> %s at %.1f°C (CPU %u MHz, frames every %u ms)",
+             level_names[level], level_names[next], celsius, mhz,
+             next >= THERMAL_UI_THROTTLED ? THERMAL_UI_INTERVAL_MS : UI_UPDATE_INTERVAL);
+    }
+
+    portENTER_CRITICAL(&status_mux);
+    if (sampled && level > THERMAL_NORMAL) {
+        status.throttled_ms += now_ms - last_sample_ms;
+    }
+    if (next != level) {
+        status.level_changes++;
+        status.cpu_mhz = next >= THERMAL_CPU_THROTTLED ? THERMAL_CPU_MHZ : nominal_mhz;
+        status.frame_interval_ms = next >= THERMAL_UI_THROTTLED ? THERMAL_UI_INTERVAL_MS : UI_UPDATE_INTERVAL;
+    }
+    status.raw_celsius = raw;
+    status.celsius = celsius;
+    status.level = next;
+    filtered = celsius;
+    level = next;
+    portEXIT_CRITICAL(&status_mux);
+    last_sample_ms = now_ms;
+    sampled = true;
+}
+
+/**
+ * @brief Filtered die temperature
+ */
+float thermal_celsius(void) {
+    return filtered;
+}
+
+/**
+ * @brief Throttling step in force
+ */
+thermal_level_t thermal_level(void) {
+    return level;
+}
+
+/**
+ * @brief Shortest gap between UI frames at the current step
+ */
+uint32_t thermal_frame_interval_ms(void) {
+    return level >= THERMAL_UI_THROTTLED ? THERMAL_UI_INTERVAL_MS : UI_UPDATE_INTERVAL;
+}
+
+/**
+ * @brief Copy the filtered temperature and throttling state
+ */
+void thermal_get_status(thermal_status_t* out) {
+    portENTER_CRITICAL(&status_mux);
+    *out = status;
+    portEXIT_CRITICAL(&status_mux);
+}
+
+/**
+ * @brief Short name for logs
+ */
+const char* thermal_level_name(thermal_level_t value) {
+    return value < THERMAL_LEVELS ? level_names[value] : "?";
+}
+
+/**
+ * @brief One reading in degrees Celsius
+ */
+static bool read_sensor(float* celsius) {
+    if (!status.sensor_driver) {
+        *celsius = temperatureRead();
+        return !isnan(*celsius);
+    }
+#if CONFIG_IDF_TARGET_ESP32
+    return false;
+#elif ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    return temperature_sensor_get_celsius(sensor, celsius) == ESP_OK;
+#else
+    return temp_sensor_read_celsius(celsius) == ESP_OK;
+#endif
+}
+
+/**
+ * @brief Change the CPU clock: the top of the DFS range, or the fixed clock
+ */
+static void set_cpu_mhz(uint16_t mhz) {
+    if (!power_manager_set_max_mhz(mhz)) {
+        setCpuFrequencyMhz(mhz);
+    }
+}
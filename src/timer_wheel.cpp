@@ -0,0 +1,294 @@
+/**
+ * @file timer_wheel.cpp
+ * @brief Hierarchical timing wheel for the housekeeping timers
+ *
+ * Timer records come from a fixed array through a free list and are
+ * linked into their slot in both directions, so a cancel unlinks in O(1)
+ * wherever the timer is filed. A timer goes into the lowest level whose
+ * span covers its delay, in the slot its expiry tick selects at that
+ * level. When the bottom level wraps, the next slot of level 1 is emptied
+ * into level 0, and level 2 into level 1 when that wraps in turn; every
+ * timer so reaches the bottom slot of its own tick. Delays beyond the top
+ * level wait in its furthest slot and are refiled until they fit.
+ *
+ * Callbacks run after the lock is released, from a list of the timers
+ * that came due, so they may start, re-period or cancel timers
+ * themselves. A periodic timer is refiled from its deadline rather than
+ * from when it ran, unless the system task fell more than a period
+ * behind; then it runs once and starts over from now instead of catching
+ * up in a burst.
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "timer_wheel.h"
+#include "logger.h"
+
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1u << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 3
+#define WHEEL_SPAN(level) (1ul << (WHEEL_BITS * ((level) + 1)))
+
+static_assert(TIMER_WHEEL_MAX_TIMERS < TIMER_WHEEL_NONE, "timer ids must fit below TIMER_WHEEL_NONE");
+
+typedef struct timer_rec {
+    const char*       name;
+    timer_fn_t        fn;
+    void*             arg;
+    uint32_t          expires;      // Tick it is due at
+    uint32_t          period;       // Ticks, 0 for one-shot
+    struct timer_rec* prev;
+    struct timer_rec* next;         // In its slot, or in the free list
+    struct timer_rec* due_next;     // In the list of a tick's expiries
+    uint16_t          generation;   // Bumped on free, so a stale due entry is skipped
+    uint8_t           level;        // Where it is filed
+    uint8_t           slot;
+    bool              filed;
+} timer_rec_t;
+
+static timer_rec_t records[TIMER_WHEEL_MAX_TIMERS];
+static timer_rec_t* free_list = NULL;
+static timer_rec_t* slots[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint32_t base_ms = 0;            // millis() at tick 0
+static uint32_t current_tick = 0;       // Last tick processed
+static timer_wheel_stats_t stats;
+static portMUX_TYPE wheel_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void file_timer(timer_rec_t* timer);
+static void unlink_timer(timer_rec_t* timer);
+static void cascade(uint8_t level, uint32_t index);
+static void free_timer(timer_rec_t* timer);
+
+/**
+ * @brief Start with an empty wheel at the current time; before the tasks start
+ */
+void timer_wheel_init(void) {
+    memset(records, 0, sizeof(records));
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+    for (uint8_t i = 0; i < TIMER_WHEEL_MAX_TIMERS; i++) {
+        records[i].next = i + 1 < TIMER_WHEEL_MAX_TIMERS ? &records[i + 1] : NULL;
+    }
+    free_list = &records[0];
+    base_ms = millis();
+    current_tick = 0;
+    LOGI(SYSTEM, "✅ Timer wheel: %d timers, %d ms ticks", TIMER_WHEEL_MAX_TIMERS, TIMER_WHEEL_TICK_MS);
+}
+
+/**
+ * @brief File a timer; any task
+ */
+timer_id_t timer_wheel_start(const char* name, uint32_t delay_ms, uint32_t period_ms,
+                             timer_fn_t fn, void* arg) {
+    if (fn == NULL) {
+        return TIMER_WHEEL_NONE;
+    }
+    portENTER_CRITICAL(&wheel_mux);
+    timer_rec_t* timer = free_list;
+    if (timer == NULL) {
+        stats.rejected++;
+        portEXIT_CRITICAL(&wheel_mux);
+        LOGW(SYSTEM, "⚠️ Timer '%s' not started: all %d in use", name, TIMER_WHEEL_MAX_TIMERS);
+        return TIMER_WHEEL_NONE;
+    }
+    free_list = timer->next;
+    timer->name = name;
+    timer->fn = fn;
+    timer->arg = arg;
+    timer->period = period_ms == 0 ? 0 : max(1ul, (unsigned long)(period_ms / TIMER_WHEEL_TICK_MS));
+    // Rounded up, so a timer never runs early
+    timer->expires = current_tick + max(1ul, (unsigned long)((delay_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS));
+    file_timer(timer);
+    stats.started++;
+    stats.active++;
+    stats.peak = max(stats.peak, stats.active);
+    portEXIT_CRITICAL(&wheel_mux);
+    return (timer_id_t)(timer - records);
+}
+
+/**
+ * @brief Change a periodic timer's period from its next run on; any task, callbacks included
+ */
+void timer_wheel_set_period(timer_id_t id, uint32_t period_ms) {
+    if (id >= TIMER_WHEEL_MAX_TIMERS || period_ms == 0) {
+        return;
+    }
+    portENTER_CRITICAL(&wheel_mux);
+    timer_rec_t* timer = &records[id];
+    if (timer->fn != NULL && timer->period != 0) {
+        timer->period = max(1ul, (unsigned long)(period_ms / TIMER_WHEEL_TICK_MS));
+    }
+    portEXIT_CRITICAL(&wheel_mux);
+}
+
+/**
+ * @brief Stop a timer and free its record; any task. A run in progress finishes.
+ */
+void timer_wheel_cancel(timer_id_t id) {
+    if (id >= TIMER_WHEEL_MAX_TIMERS) {
+        return;
+    }
+    portENTER_CRITICAL(&wheel_mux);
+    timer_rec_t* timer = &records[id];
+    if (timer->fn != NULL) {
+        if (timer->filed) {
+            unlink_timer(timer);
+        }
+        free_timer(timer);
+    }
+    portEXIT_CRITICAL(&wheel_mux);
+}
+
+/**
+ * @brief Process every tick up to now_ms and run the callbacks that came due (system task)
+ */
+void timer_wheel_advance(uint32_t now_ms) {
+    uint32_t target = (now_ms - base_ms) / TIMER_WHEEL_TICK_MS;
+
+    while ((int32_t)(target - current_tick) > 0) {
+        timer_rec_t* due = NULL;
+        uint16_t due_generation[TIMER_WHEEL_MAX_TIMERS];
+
+        portENTER_CRITICAL(&wheel_mux);
+        current_tick++;
+        stats.ticks++;
+        uint32_t index = current_tick & WHEEL_MASK;
+        if (index == 0) {
+            // Higher level first, so its timers can land in the slot level 1 empties next
+            uint32_t index1 = (current_tick >> WHEEL_BITS) & WHEEL_MASK;
+            if (index1 == 0) {
+                cascade(2, (current_tick >> (2 * WHEEL_BITS)) & WHEEL_MASK);
+            }
+            cascade(1, index1);
+        }
+        timer_rec_t* timer = slots[0][index];
+        slots[0][index] = NULL;
+        while (timer != NULL) {
+            timer_rec_t* next = timer->next;
+            timer->filed = false;
+            timer->prev = timer->next = NULL;
+            if (timer->expires != current_tick) {
+                file_timer(timer);          // Beyond the top level's span; not due yet
+            } else {
+                timer->due_next = due;
+                due = timer;
+                due_generation[timer - records] = timer->generation;
+                if (timer->period != 0) {
+                    uint32_t next_tick = timer->expires + timer->period;
+                    // Behind by more than a period: run once, then keep time from now
+                    timer->expires = (int32_t)(next_tick - target) > 0 ? next_tick : target + timer->period;
+                    file_timer(timer);
+                }
+            }
+            timer = next;
+        }
+        portEXIT_CRITICAL(&wheel_mux);
+
+        while (due != NULL) {
+            timer_rec_t* next = due->due_next;
+            portENTER_CRITICAL(&wheel_mux);
+            // Cancelled by an earlier callback of this tick, perhaps reused since
+            bool live = due->fn != NULL && due->generation == due_generation[due - records];
+            timer_fn_t fn = due->fn;
+            void* arg = due->arg;
+            if (live && due->period == 0) {
+                free_timer(due);
+            }
+            portEXIT_CRITICAL(&wheel_mux);
+
+            if (live) {
+                uint32_t late_ms = millis() - (base_ms + current_tick * TIMER_WHEEL_TICK_MS);
+                int64_t start_us = esp_timer_get_time();
+                fn(arg);
+                uint32_t run_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+                portENTER_CRITICAL(&wheel_mux);
+                stats.fired++;
+                stats.late_max_ms = max(stats.late_max_ms, late_ms);
+                stats.run_max_us = max(stats.run_max_us, run_us);
+                portEXIT_CRITICAL(&wheel_mux);
+            }
+            due = next;
+        }
+    }
+}
+
+/**
+ * @brief Copy the figures
+ */
+void timer_wheel_get_stats(timer_wheel_stats_t* out) {
+    portENTER_CRITICAL(&wheel_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&wheel_mux);
+}
+
+/**
+ * @brief Link a timer into the slot its expiry selects; caller holds wheel_mux
+ */
+static void file_timer(timer_rec_t* timer) {
+    uint32_t delta = timer->expires - current_tick;
+    uint8_t level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= WHEEL_SPAN(level)) {
+        level++;
+    }
+    uint32_t tick = timer->expires;
+    if (delta >= WHEEL_SPAN(WHEEL_LEVELS - 1)) {
+        tick = current_tick + WHEEL_SPAN(WHEEL_LEVELS - 1) - 1;   // Refiled from the furthest slot
+    }
+    timer->level = level;
+    timer->slot = (uint8_t)((tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    timer_rec_t** slot = &slots[level][timer->slot];
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot != NULL) {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+    timer->filed = true;
+}
+
+/**
+ * @brief Take a timer out of whichever slot holds it; caller holds wheel_mux
+ */
+static void unlink_timer(timer_rec_t* timer) {
+    if (timer->prev != NULL) {
+        timer->prev->next = timer->next;
+    } else {
+        slots[timer->level][timer->slot] = timer->next;
+    }
+    if (timer->next != NULL) {
+        timer->next->prev = timer->prev;
+    }
+    timer->prev = timer->next = NULL;
+    timer->filed = false;
+}
+
+/**
+ * @brief Refile one slot of a higher level into the levels below; caller holds wheel_mux
+ */
+static void cascade(uint8_t level, uint32_t index) {
+    timer_rec_t* timer = slots[level][index];
+    slots[level][index] = NULL;
+    while (timer != NULL) {
+        timer_rec_t* next = timer->next;
+        timer->filed = false;
+        file_timer(timer);
+        stats.cascaded++;
+        timer = next;
+    }
+}
+
+/**
+ * @brief Return a record to the free list; caller holds wheel_mux
+ */
+static void free_timer(timer_rec_t* timer) {
+    timer->fn = NULL;
+    timer->arg = NULL;
+    timer->generation++;
+    timer->next = free_list;
+    free_list = timer;
+    stats.active--;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file trace_log.cpp
+ * @brief Per-cycle sensor traces on the SD card for host-side replay
+ *
+ * Records are batched in RAM and written TRACE_FLUSH_RECORDS at a time,
+ * so the card sees one write of a few kilobytes instead of one per cycle.
+ * A new file is started at every boot and whenever TRACE_MAX_FILE_BYTES
+ * or LOG_SEGMENT_MAX_MS is reached; each flush is noted with the log
+ * manager, which indexes it. tools/replay reads them back.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include "config.h"
+#include "spi_bus.h"
+#include "trace_log.h"
+#include "log_manager.h"
+#include "logger.h"
+
+static File trace_file;
+static bool active = false;
+static uint32_t file_bytes = 0;
+static uint16_t segment = 0;
+static uint32_t opened_ms = 0;
+static trace_record_t pending[TRACE_FLUSH_RECORDS];
+static uint8_t pending_count = 0;
+
+// Forward declarations
+static bool open_next_file(void);
+
+/**
+ * @brief Open a new trace file in TRACE_LOG_DIR on the SD card
+ */
+bool trace_log_init(void) {
+    if (!spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER)) {
+        return false;
+    }
+    if (SD.exists(TRACE_LOG_DIR) || SD.mkdir(TRACE_LOG_DIR)) {
+        active = open_next_file();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+    return active;
+}
+
+/**
+ * @brief Queue one scan cycle; records reach the card TRACE_FLUSH_RECORDS at a time
+ */
+void trace_log_append(const sensor_data_t* data, const scan_histograms_t* histograms,
+                      uint32_t timestamp_ms) {
+    if (!active) {
+        return;
+    }
+
+    trace_record_t* record = &pending[pending_count++];
+    record->data = *data;
+    record->wifi_all = histograms->wifi_all;
+    record->ble = histograms->ble;
+    record->timestamp_ms = timestamp_ms;
+
+    if (pending_count == TRACE_FLUSH_RECORDS) {
+        trace_log_flush();
+    }
+}
+
+/**
+ * @brief Write out queued records
+ */
+void trace_log_flush(void) {
+    if (!active || pending_count == 0) {
+        return;
+    }
+
+    size_t bytes = pending_count * sizeof(trace_record_t);
+    uint32_t first_ms = pending[0].timestamp_ms;
+    uint32_t last_ms = pending[pending_count - 1].timestamp_ms;
+    uint32_t start = file_bytes;
+    pending_count = 0;
+    const uint8_t* data = (const uint8_t*)pending;
+    for (size_t offset = 0; offset < bytes; offset += SPI_BUS_SD_CHUNK_BYTES) {
+        size_t chunk = min(bytes - offset, (size_t)SPI_BUS_SD_CHUNK_BYTES);
+        spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+        size_t written = trace_file.write(data + offset, chunk);
+        if (written != chunk) {
+            // Card removed or full; stop rather than retry on every cycle
+            LOGW(SYSTEM, "⚠️  Trace write failed - trace logging stopped");
+            trace_file.close();
+            spi_bus_release(SPI_DEVICE_SD);
+            active = false;
+            return;
+        }
+        spi_bus_release(SPI_DEVICE_SD);
+    }
+
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    trace_file.flush();
+    file_bytes += bytes;
+    log_manager_note(LOG_SEGMENT_TRACE, segment, start, first_ms, last_ms);
+    if (file_bytes >= TRACE_MAX_FILE_BYTES || millis() - opened_ms >= LOG_SEGMENT_MAX_MS) {
+        trace_file.close();
+        active = open_next_file();
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+}
+
+/**
+ * @brief SD hot-plug listener
+ */
+void trace_log_card_changed(bool mounted) {
+    if (mounted) {
+        if (!active) {
+            trace_log_init();
+        }
+        return;
+    }
+    spi_bus_acquire(SPI_DEVICE_SD, SPI_BUS_WAIT_FOREVER);
+    if (active) {
+        active = false;
+        trace_file.close();
+        LOGI(SYSTEM, "📝 Trace file closed - card removed");
+    }
+    spi_bus_release(SPI_DEVICE_SD);
+}
+
+/**
+ * @brief Create the next TRACE_LOG_DIR/trace_NNNN.htr and write its header
+ *
+ * The caller holds the SD card's bus.
+ */
+static bool open_next_file(void) {
+    char path[48];
+    segment = log_manager_next_segment(LOG_SEGMENT_TRACE);
+    log_manager_segment_path(LOG_SEGMENT_TRACE, segment, path, sizeof(path));
+    trace_file = SD.open(path, "w");
+    if (!trace_file) {
+        return false;
+    }
+
+    trace_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TRACE_FILE_MAGIC;
+    header.format = TRACE_FILE_FORMAT;
+    header.record_bytes = sizeof(trace_record_t);
+    header.heap_size = ESP.getHeapSize();
+    header.boot = log_manager_boot();
+    trace_file.write((const uint8_t*)&header, sizeof(header));
+    file_bytes = sizeof(header);
+    opened_ms = millis();
+    log_manager_opened(LOG_SEGMENT_TRACE, segment);
+
+    LOGI(SYSTEM, "📝 Tracing scan cycles to %s", path);
+    return true;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file tunables.cpp
+ * @brief Bounded run-time values over the config.h defaults, kept in NVS
+ *
+ * Each value lives in a word of its own, so readers take it with one load
+ * and no lock; only a set writes NVS. A stored value that no longer fits
+ * its bounds (the bounds changed in a later build) is ignored at boot.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "tunables.h"
+#include "logger.h"
+
+typedef struct {
+    const char* name;
+    int32_t     default_value;
+    int32_t     min;
+    int32_t     max;
+} tunable_def_t;
+
+// In tunable_id_t order; names are NVS keys, 15 characters at most
+static const tunable_def_t defs[TUNABLE_COUNT] = {
+    { "log_ms",          LOG_INTERVAL_MS,                 1000,  3600000 },
+    { "status_ms",       STATUS_REPORT_INTERVAL_MS,       10000, 86400000 },
+    { "thermal_scan_c",  (int32_t)THERMAL_SCAN_CELSIUS,   40,    100 },
+    { "thermal_ui_c",    (int32_t)THERMAL_UI_CELSIUS,     40,    100 },
+    { "thermal_cpu_c",   (int32_t)CRITICAL_TEMPERATURE_C, 40,    100 },
+    { "backlight_ms",    BACKLIGHT_INTERACTION_MS,        1000,  600000 },
+    { "battery_mah",     ENERGY_BATTERY_MAH,              100,   50000 },
+};
+
+static volatile int32_t values[TUNABLE_COUNT];
+static SemaphoreHandle_t store_lock = NULL;
+static StaticSemaphore_t store_lock_state;
+
+// Forward declarations
+static bool in_bounds(tunable_id_t id, int32_t value);
+static bool thermal_in_order(tunable_id_t id, int32_t value);
+
+/**
+ * @brief Load stored values over the config.h defaults
+ */
+void tunables_init(void) {
+    if (store_lock == NULL) {
+        store_lock = xSemaphoreCreateMutexStatic(&store_lock_state);
+    }
+    for (uint8_t id = 0; id < TUNABLE_COUNT; id++) {
+        values[id] = defs[id].default_value;
+    }
+
+    Preferences prefs;
+    if (!prefs.begin(TUNABLES_NVS_NAMESPACE, true)) {
+        return;                     // Nothing stored yet
+    }
+    uint8_t loaded = 0;
+    for (uint8_t id = 0; id < TUNABLE_COUNT; id++) {
+        if (!prefs.isKey(defs[id].name)) {
+            continue;
+        }
+        int32_t value = prefs.getInt(defs[id].name, defs[id].default_value);
+        if (in_bounds((tunable_id_t)id, value)) {
+            values[id] = value;
+            loaded++;
+        } else {
+            LOGW(SYSTEM, "⚠️  Stored %s=%ld out of bounds - default %ld kept",
+                 defs[id].name, value, defs[id].default_value);
+        }
+    }
+    prefs.end();
+    if (!thermal_in_order(TUNABLE_COUNT, 0)) {
+        LOGW(SYSTEM, "⚠️  Stored thermal steps out of order - defaults kept");
+        for (uint8_t id = TUNABLE_THERMAL_SCAN_C; id <= TUNABLE_THERMAL_CPU_C; id++) {
+            values[id] = defs[id].default_value;
+        }
+    }
+    if (loaded > 0) {
+        LOGI(SYSTEM, "✅ %u tunable value(s) restored from NVS", loaded);
+    }
+}
+
+/**
+ * @brief Current value
+ */
+int32_t tunable_get(tunable_id_t id) {
+    return values[id];
+}
+
+/**
+ * @brief Take a new value and store it
+ */
+bool tunable_set(tunable_id_t id, int32_t value) {
+    if (id >= TUNABLE_COUNT || store_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    bool ok = in_bounds(id, value) && thermal_in_order(id, value);
+    if (ok) {
+        Preferences prefs;
+        ok = prefs.begin(TUNABLES_NVS_NAMESPACE, false) &&
+             prefs.putInt(defs[id].name, value) == sizeof(int32_t);
+        prefs.end();
+    }
+    if (ok) {
+        values[id] = value;
+        LOGI(SYSTEM, "🔧 %s set to %ld", defs[id].name, value);
+    }
+    xSemaphoreGive(store_lock);
+    return ok;
+}
+
+/**
+ * @brief Look a value up by name
+ */
+tunable_id_t tunable_find(const char* name) {
+    for (uint8_t id = 0; id < TUNABLE_COUNT; id++) {
+        if (strcmp(name, defs[id].name) == 0) {
+            return (tunable_id_t)id;
+        }
+    }
+    return TUNABLE_COUNT;
+}
+
+/**
+ * @brief Copy one value with its bounds
+ */
+void tunable_get_info(tunable_id_t id, tunable_info_t* info) {
+    info->name = defs[id].name;
+    info->value = values[id];
+    info->default_value = defs[id].default_value;
+    info->min = defs[id].min;
+    info->max = defs[id].max;
+}
+
+/**
+ * @brief Back to the config.h defaults, stored values erased
+ */
+void tunables_reset(void) {
+    if (store_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+    Preferences prefs;
+    if (prefs.begin(TUNABLES_NVS_NAMESPACE, false)) {
+        prefs.clear();
+        prefs.end();
+    }
+    for (uint8_t id = 0; id < TUNABLE_COUNT; id++) {
+        values[id] = defs[id].default_value;
+    }
+    xSemaphoreGive(store_lock);
+    LOGI(SYSTEM, "🔧 Tunable values reset to their defaults");
+}
+
+/**
+ * @brief Within the value's bounds
+ */
+static bool in_bounds(tunable_id_t id, int32_t value) {
+    return value >= defs[id].min && value <= defs[id].max;
+}
+
+/**
+ * @brief Each thermal step above the one before, with id taking value
+ */
+static bool thermal_in_order(tunable_id_t id, int32_t value) {
+    int32_t steps[TUNABLE_THERMAL_CPU_C - TUNABLE_THERMAL_SCAN_C + 1];
+    for (uint8_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        uint8_t step = TUNABLE_THERMAL_SCAN_C + i;
+        steps[i] = step == id ? value : values[step];
+        if (i > 0 && steps[i] <= steps[i - 1]) {
+            return false;
+        }
+    }
+    return true;
+}
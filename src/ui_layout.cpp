@@ -0,0 +1,77 @@
+/**
+ * @file ui_layout.cpp
+ * @brief Flex building blocks shared by every scene
+ *
+ * Screens are columns of boxes with fixed-height rows and one or more
+ * blocks taking the leftover space, so the same scene code lays itself
+ * out on a 240x240, 320x240 or 480x320 panel, upright or turned. LVGL
+ * computes a flex layout when a container or one of its children changes
+ * size; the rows built here never do, so that happens when a screen is
+ * built and after a rotation, and not when a label or the face changes.
+ */
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+#include "ui_layout.h"
+#include "ui_theme.h"
+
+static ui_layout_stats_t stats;
+
+// Forward declarations
+static void layout_changed_cb(lv_event_t* event);
+
+/**
+ * @brief Make a scene's screen a padded, non-scrolling flex column
+ */
+void ui_layout_screen(lv_obj_t* screen) {
+    lv_obj_set_flex_flow(screen, LV_FLEX_FLOW_COLUMN);
+    ui_theme_apply(screen, UI_STYLE_LAYOUT);
+    lv_obj_clear_flag(screen, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(screen, layout_changed_cb, LV_EVENT_LAYOUT_CHANGED, NULL);
+}
+
+/**
+ * @brief Transparent flex container, sized to its content
+ */
+lv_obj_t* ui_layout_box(lv_obj_t* parent, lv_flex_flow_t flow) {
+    lv_obj_t* box = lv_obj_create(parent);
+    lv_obj_remove_style_all(box);
+    lv_obj_set_size(box, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+    lv_obj_set_flex_flow(box, flow);
+    lv_obj_clear_flag(box, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_clear_flag(box, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(box, layout_changed_cb, LV_EVENT_LAYOUT_CHANGED, NULL);
+    return box;
+}
+
+/**
+ * @brief Stretch an object across its flex column and give it grow shares
+ */
+void ui_layout_fill(lv_obj_t* obj, uint8_t grow) {
+    lv_obj_set_width(obj, lv_pct(100));
+    lv_obj_set_flex_grow(obj, grow);
+}
+
+/**
+ * @brief Pin a one-line label to its column's width and its font's height
+ */
+void ui_layout_line(lv_obj_t* label) {
+    const lv_font_t* font = lv_obj_get_style_text_font(label, LV_PART_MAIN);
+    lv_label_set_long_mode(label, LV_LABEL_LONG_CLIP);
+    lv_obj_set_size(label, lv_pct(100), lv_font_get_line_height(font));
+}
+
+/**
+ * @brief Copy the layout counters
+ */
+void ui_layout_get_stats(ui_layout_stats_t* out) {
+    *out = stats;
+}
+
+/**
+ * @brief A container's children were repositioned by its flex layout
+ */
+static void layout_changed_cb(lv_event_t* event) {
+    stats.passes++;
+}
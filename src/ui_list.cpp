@@ -0,0 +1,132 @@
+/**
+ * @file ui_list.cpp
+ * @brief Virtual list: long device tables scrolled through a pool of labels
+ *
+ * A label per row would cost LVGL memory in proportion to the table, a
+ * few hundred bytes each. The viewport instead holds a transparent spacer
+ * at the bottom of the content, which gives LVGL the full scroll range,
+ * and the pool labels are moved to whichever rows are in view.
+ */
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+#include "ui_list.h"
+#include "ui_theme.h"
+#include "logger.h"
+
+#define NO_ROW UINT32_MAX
+
+// Forward declarations
+static void scroll_cb(lv_event_t* event);
+static void resize_cb(lv_event_t* event);
+static void layout(ui_list_t* list, bool refill);
+
+/**
+ * @brief Build the viewport and its label pool
+ */
+lv_obj_t* ui_list_create(ui_list_t* list, lv_obj_t* parent, lv_coord_t width, lv_coord_t height,
+                         ui_list_fill_t fill, void* user_data) {
+    memset(list, 0, sizeof(*list));
+    list->row_height = UI_LIST_ROW_HEIGHT;
+    list->fill = fill;
+    list->user_data = user_data;
+
+    list->container = lv_obj_create(parent);
+    lv_obj_remove_style_all(list->container);
+    lv_obj_set_size(list->container, width, height);
+    lv_obj_set_scroll_dir(list->container, LV_DIR_VER);
+    lv_obj_add_event_cb(list->container, scroll_cb, LV_EVENT_SCROLL, list);
+    lv_obj_add_event_cb(list->container, resize_cb, LV_EVENT_SIZE_CHANGED, list);
+
+    list->spacer = lv_obj_create(list->container);
+    lv_obj_remove_style_all(list->spacer);
+    lv_obj_set_size(list->spacer, 1, 1);
+    lv_obj_clear_flag(list->spacer, LV_OBJ_FLAG_CLICKABLE);
+
+    for (uint8_t i = 0; i < UI_LIST_POOL_ROWS; i++) {
+        lv_obj_t* label = lv_label_create(list->container);
+        lv_label_set_long_mode(label, LV_LABEL_LONG_CLIP);
+        lv_label_set_text_static(label, "");
+        lv_obj_set_size(label, lv_pct(100), list->row_height);
+        ui_theme_apply(label, UI_STYLE_TEXT);
+        lv_obj_add_flag(label, LV_OBJ_FLAG_HIDDEN);
+        list->rows[i] = label;
+        list->row_of[i] = NO_ROW;
+    }
+
+    return list->container;
+}
+
+/**
+ * @brief Change the number of rows and redraw the visible ones
+ */
+void ui_list_set_count(ui_list_t* list, uint32_t count) {
+    if (count != list->count) {
+        list->count = count;
+        lv_coord_t bottom = (lv_coord_t)(count * list->row_height);
+        lv_obj_set_y(list->spacer, bottom > 0 ? bottom - 1 : 0);
+        lv_obj_update_layout(list->container);
+        lv_obj_readjust_scroll(list->container, LV_ANIM_OFF);
+    }
+    layout(list, true);
+}
+
+/**
+ * @brief Scrolled: hand labels that left the view to the rows entering it
+ */
+static void scroll_cb(lv_event_t* event) {
+    layout((ui_list_t*)lv_event_get_user_data(event), false);
+}
+
+/**
+ * @brief Laid out anew (built, or the screen turned): cover the new viewport
+ */
+static void resize_cb(lv_event_t* event) {
+    ui_list_t* list = (ui_list_t*)lv_event_get_user_data(event);
+    lv_coord_t height = lv_obj_get_height(list->container);
+    if (height / list->row_height + 1 > UI_LIST_POOL_ROWS) {
+        LOGW(UI, "⚠️  List of %d px needs more than %d pooled rows", height, UI_LIST_POOL_ROWS);
+    }
+    layout(list, false);
+}
+
+/**
+ * @brief Give each pooled label the row it should show at this scroll position
+ * @param refill Rewrite the text of labels that keep their row as well
+ */
+static void layout(ui_list_t* list, bool refill) {
+    lv_coord_t scroll_y = max(lv_obj_get_scroll_y(list->container), (lv_coord_t)0);
+    uint32_t first = scroll_y / list->row_height;
+
+    for (uint32_t row = first; row < first + UI_LIST_POOL_ROWS; row++) {
+        uint8_t slot = row % UI_LIST_POOL_ROWS;
+        lv_obj_t* label = list->rows[slot];
+
+        if (row >= list->count) {
+            if (list->row_of[slot] != NO_ROW) {
+                lv_obj_add_flag(label, LV_OBJ_FLAG_HIDDEN);
+                list->row_of[slot] = NO_ROW;
+            }
+            continue;
+        }
+
+        bool moved = list->row_of[slot] != row;
+        if (!moved && !refill) {
+            continue;
+        }
+        if (moved) {
+            lv_obj_set_y(label, (lv_coord_t)(row * list->row_height));
+            lv_obj_clear_flag(label, LV_OBJ_FLAG_HIDDEN);
+            list->row_of[slot] = row;
+        }
+
+        // Unchanged text is not handed to LVGL, so it is not redrawn
+        char text[UI_LIST_ROW_CHARS];
+        list->fill(list->user_data, row, text, sizeof(text));
+        if (moved || strcmp(text, lv_label_get_text(label)) != 0) {
+            lv_label_set_text(label, text);
+            list->refills++;
+        }
+    }
+}
@@ -0,0 +1,738 @@
+/**
+ * @file ui_screens.cpp
+ * @brief Detail screens behind the face: device lists, system health, AI states, RSSI charts
+ *
+ * Every screen is a renderer scene, so it only exists once it has been
+ * entered and is deleted again when LVGL memory runs short while it is out
+ * of view. Nothing here is kept across a teardown apart from the scroll
+ * ring itself; the next entry rebuilds from the current data.
+ *
+ * The device lists never copy device table entries. Once per scan cycle
+ * they collect the slot indices of their kind and sort those, by RSSI or
+ * by last sighting, and each visible row reads its entry straight from the
+ * table when it is drawn, under an epoch pin (device_table_pin()) so the
+ * version it reads stays whole. The sort keys are sampled into the index array
+ * first, so the scan task updating entries in place cannot make the
+ * comparator inconsistent; rows show the live values.
+ *
+ * The live feed is a ticker over live_feed.h's ring. Its rows are a fixed
+ * pool of labels, each pointing at its own text buffer: a new line goes
+ * into the oldest label, which moves to the top while the others each
+ * move down a row, so nothing is created or freed and only the feed area
+ * is redrawn.
+ */
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+#include "ui_screens.h"
+#include "ui_list.h"
+#include "ui_layout.h"
+#include "ui_theme.h"
+#include "renderer.h"
+#include "device_table.h"
+#include "sensor_snapshot.h"
+#include "rssi_histogram.h"
+#include "ai_features.h"
+#include "backlight.h"
+#include "spi_bus.h"
+#include "lvgl_pool.h"
+#include "thermal.h"
+#include "energy.h"
+#include "live_feed.h"
+#include "mem_policy.h"
+#include "ai_state_stats.h"
+
+#if LIVE_FEED_ENABLED
+#define RING_SCREENS 7
+#else
+#define RING_SCREENS 6
+#endif
+
+/**
+ * @brief Order of a device list; tapping the header switches it
+ */
+typedef enum {
+    DEVICE_SORT_RSSI = 0,           // Strongest first
+    DEVICE_SORT_LAST_SEEN           // Most recently heard first
+} device_sort_t;
+
+/**
+ * @brief A device table slot and the key it was sorted by
+ */
+typedef struct {
+    uint32_t key;
+    uint16_t slot;
+} device_index_t;
+
+/**
+ * @brief A device list screen and the index it shows
+ */
+typedef struct {
+    device_kind_t    kind;
+    const char*      title;
+    device_sort_t    sort;
+    renderer_label_t header;
+    ui_list_t        list;
+    device_index_t*  index;             // Sorted slots, NULL while torn down
+    uint32_t         capacity;
+    uint32_t         count;
+    uint32_t         sequence;          // Snapshot the index follows
+} device_screen_t;
+
+static_assert(DEVICE_TABLE_CAPACITY <= 65536, "device_index_t holds 16-bit slots");
+
+// Forward declarations
+static void networks_create(lv_obj_t* screen);
+static void networks_update(uint32_t now_ms);
+static void networks_destroy(void);
+static void ble_create(lv_obj_t* screen);
+static void ble_update(uint32_t now_ms);
+static void ble_destroy(void);
+static void health_create(lv_obj_t* screen);
+static void health_update(uint32_t now_ms);
+static uint32_t health_wait_ms(uint32_t now_ms);
+static void health_destroy(void);
+static void states_create(lv_obj_t* screen);
+static void states_update(uint32_t now_ms);
+static uint32_t states_wait_ms(uint32_t now_ms);
+static void states_destroy(void);
+static void frame_mode_cb(lv_event_t* event);
+static void feed_create(lv_obj_t* screen);
+static void feed_update(uint32_t now_ms);
+static void feed_destroy(void);
+static void histogram_create(lv_obj_t* screen);
+static void histogram_update(uint32_t now_ms);
+static void histogram_destroy(void);
+static void device_screen_create(device_screen_t* screen, lv_obj_t* parent);
+static void device_screen_update(device_screen_t* screen, uint32_t now_ms);
+static void device_screen_destroy(device_screen_t* screen);
+static void device_row_fill(void* user_data, uint32_t row, char* text, size_t size);
+static void device_sort_cb(lv_event_t* event);
+static int compare_index(const void* a, const void* b);
+static lv_obj_t* create_chart(lv_obj_t* parent, uint8_t grow, lv_chart_type_t type, uint16_t points);
+static void update_series(lv_obj_t* obj, lv_chart_series_t* series, const uint16_t* values,
+                          uint16_t count);
+static void set_chart_peak(lv_obj_t* obj, uint16_t* shown, uint16_t peak);
+static lv_coord_t spark_point(int8_t dbm);
+static lv_obj_t* create_title_row(lv_obj_t* parent);
+static lv_obj_t* create_title(lv_obj_t* parent, const char* text);
+
+static const renderer_scene_t networks_scene = {
+    "networks", networks_create, networks_update, NULL, networks_destroy
+};
+static const renderer_scene_t ble_scene = {
+    "ble", ble_create, ble_update, NULL, ble_destroy
+};
+static const renderer_scene_t health_scene = {
+    "health", health_create, health_update, health_wait_ms, health_destroy
+};
+static const renderer_scene_t states_scene = {
+    "states", states_create, states_update, states_wait_ms, states_destroy
+};
+static const renderer_scene_t histogram_scene = {
+    "rssi", histogram_create, histogram_update, NULL, histogram_destroy
+};
+static const renderer_scene_t feed_scene = {
+    "feed", feed_create, feed_update, NULL, feed_destroy
+};
+
+// Swipe order; the home scene is filled in by ui_screens_init()
+static const renderer_scene_t* ring[RING_SCREENS] = {
+#if LIVE_FEED_ENABLED
+    NULL, &feed_scene, &networks_scene, &ble_scene, &health_scene, &states_scene, &histogram_scene
+#else
+    NULL, &networks_scene, &ble_scene, &health_scene, &states_scene, &histogram_scene
+#endif
+};
+
+static device_screen_t networks = { DEVICE_KIND_WIFI_AP, "WiFi", DEVICE_SORT_RSSI };
+static device_screen_t ble_devices = { DEVICE_KIND_BLE, "BLE", DEVICE_SORT_RSSI };
+
+// System health
+#define HEALTH_LINES 9
+static renderer_label_t health_labels[HEALTH_LINES];
+
+// AI states: one line per state, then the busiest transition
+#define STATES_LINES (AI_STATE_COUNT + 1)
+static renderer_label_t states_labels[STATES_LINES];
+
+// Live feed: row labels, their text and colour, newest at feed_top
+static lv_obj_t* feed_rows[LIVE_FEED_ENTRIES];
+static char feed_text[LIVE_FEED_ENTRIES][LIVE_FEED_TEXT_BYTES];
+static uint8_t feed_kind[LIVE_FEED_ENTRIES];
+static uint8_t feed_top = 0;
+static uint32_t feed_shown = 0;             // Sequence of the newest line on screen
+static const ui_style_role_t feed_roles[LIVE_FEED_KINDS] = {
+    UI_STYLE_TEXT, UI_STYLE_ALERT, UI_STYLE_TITLE, UI_STYLE_HEALTH
+};
+
+// RSSI screen
+#define SPARK_NONE INT8_MIN                 // No devices of the kind that cycle
+static lv_obj_t* spark_chart = NULL;
+static lv_obj_t* hist_chart = NULL;
+static lv_obj_t* channel_chart = NULL;
+static lv_chart_series_t* spark_wifi = NULL;
+static lv_chart_series_t* spark_ble = NULL;
+static lv_chart_series_t* hist_wifi = NULL;
+static lv_chart_series_t* hist_ble = NULL;
+static lv_chart_series_t* channel_series = NULL;
+static uint16_t hist_peak = 0;
+static uint16_t channel_peak = 0;
+static uint32_t chart_sequence = 0;
+
+// Sparkline history, kept outside LVGL so a rebuilt screen starts full
+static int8_t spark_history[2][UI_SPARK_POINTS];    // WiFi, BLE medians in dBm
+static uint16_t spark_head = 0;
+static uint16_t spark_len = 0;
+static uint32_t sampled_sequence = 0;
+
+/**
+ * @brief Register the detail screens behind the home scene
+ */
+void ui_screens_init(const renderer_scene_t* home) {
+    ring[0] = home;
+}
+
+/**
+ * @brief Number of scenes in the ring, home included
+ */
+uint8_t ui_screens_count(void) {
+    return RING_SCREENS;
+}
+
+/**
+ * @brief Scene at a place in the ring, 0 being home
+ */
+const renderer_scene_t* ui_screens_scene(uint8_t index) {
+    return index < RING_SCREENS ? ring[index] : NULL;
+}
+
+/**
+ * @brief Move along the ring, wrapping at either end
+ */
+void ui_screens_step(int8_t step) {
+    const renderer_scene_t* current = renderer_current_scene();
+    uint8_t index = 0;
+    while (index < RING_SCREENS && ring[index] != current) {
+        index++;
+    }
+    if (index == RING_SCREENS) {
+        index = 0;
+    }
+    const renderer_scene_t* next = ring[(index + RING_SCREENS + step % RING_SCREENS) % RING_SCREENS];
+    if (next != NULL) {
+        renderer_show(next);
+    }
+}
+
+// WiFi networks and BLE devices
+
+static void networks_create(lv_obj_t* screen) { device_screen_create(&networks, screen); }
+static void networks_update(uint32_t now_ms) { device_screen_update(&networks, now_ms); }
+static void networks_destroy(void) { device_screen_destroy(&networks); }
+static void ble_create(lv_obj_t* screen) { device_screen_create(&ble_devices, screen); }
+static void ble_update(uint32_t now_ms) { device_screen_update(&ble_devices, now_ms); }
+static void ble_destroy(void) { device_screen_destroy(&ble_devices); }
+
+/**
+ * @brief Title, count and a pooled list below them
+ */
+static void device_screen_create(device_screen_t* screen, lv_obj_t* parent) {
+    ui_layout_screen(parent);
+
+    lv_obj_t* row = create_title_row(parent);
+    lv_obj_t* label = renderer_label_create(&screen->header, row, 0);
+    ui_theme_apply(label, UI_STYLE_TITLE);
+    ui_layout_line(label);
+    lv_obj_add_flag(label, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(label, device_sort_cb, LV_EVENT_CLICKED, screen);
+
+    // Takes the rest of the screen, whatever its size
+    lv_obj_t* list = ui_list_create(&screen->list, parent, lv_pct(100), lv_pct(100),
+                                    device_row_fill, screen);
+    ui_layout_fill(list, 1);
+
+    // One index per table slot at most, eight bytes each
+    screen->capacity = device_table_capacity();
+    size_t bytes = screen->capacity * sizeof(device_index_t);
+    screen->index = (device_index_t*)mem_alloc(MEM_BULK, bytes);
+    if (screen->index == NULL) {
+        screen->capacity = 0;
+    }
+    screen->count = 0;
+    screen->sequence = sensor_snapshot_sequence() - 1;      // Index on the first frame
+}
+
+/**
+ * @brief Rebuild and re-sort the index once per published scan cycle
+ */
+static void device_screen_update(device_screen_t* screen, uint32_t now_ms) {
+    uint32_t sequence = sensor_snapshot_sequence();
+    if (sequence == screen->sequence) {
+        return;
+    }
+    screen->sequence = sequence;
+
+    // Keys sort ascending: negate RSSI, age measured back from now
+    uint32_t count = 0;
+    uint32_t slots = min(device_table_capacity(), screen->capacity);
+    uint8_t pin = device_table_pin();
+    for (uint32_t slot = 0; slot < slots; slot++) {
+        const device_entry_t* entry = device_table_entry_at(slot);
+        if (entry == NULL || entry->kind != screen->kind) {
+            continue;
+        }
+        device_index_t* index = &screen->index[count++];
+        index->slot = (uint16_t)slot;
+        index->key = screen->sort == DEVICE_SORT_RSSI ? (uint32_t)(128 - entry->rssi_last)
+                                                      : now_ms - entry->last_seen_ms;
+    }
+    device_table_unpin(pin);
+    qsort(screen->index, count, sizeof(device_index_t), compare_index);
+    screen->count = count;
+
+    renderer_label_printf(&screen->header, now_ms, "%s: %lu  by %s", screen->title, count,
+                          screen->sort == DEVICE_SORT_RSSI ? "RSSI" : "last seen");
+    ui_list_set_count(&screen->list, count);
+}
+
+/**
+ * @brief Free the index; the list's labels go with the screen
+ */
+static void device_screen_destroy(device_screen_t* screen) {
+    mem_free(MEM_BULK, screen->index, screen->capacity * sizeof(device_index_t));
+    screen->index = NULL;
+    screen->capacity = 0;
+    screen->count = 0;
+}
+
+/**
+ * @brief Header tapped: switch the order and re-sort on the next frame
+ */
+static void device_sort_cb(lv_event_t* event) {
+    device_screen_t* screen = (device_screen_t*)lv_event_get_user_data(event);
+    screen->sort = screen->sort == DEVICE_SORT_RSSI ? DEVICE_SORT_LAST_SEEN : DEVICE_SORT_RSSI;
+    screen->sequence = sensor_snapshot_sequence() - 1;
+}
+
+/**
+ * @brief Text of one listed device, read from its table slot as it is drawn
+ */
+static void device_row_fill(void* user_data, uint32_t row, char* text, size_t size) {
+    const device_screen_t* screen = (const device_screen_t*)user_data;
+    const device_entry_t* entry = NULL;
+    uint8_t pin = device_table_pin();
+    if (row < screen->count) {
+        entry = device_table_entry_at(screen->index[row].slot);
+    }
+    if (entry == NULL || entry->kind != screen->kind) {
+        // Aged out since the index was built; gone at the next cycle
+        device_table_unpin(pin);
+        snprintf(text, size, "--");
+        return;
+    }
+
+    const uint8_t* mac = entry->mac;
+    uint32_t age_s = (millis() - entry->last_seen_ms) / 1000;
+    if (screen->kind == DEVICE_KIND_WIFI_AP) {
+        snprintf(text, size, "%02X:%02X:%02X:%02X:%02X:%02X  ch%-2u %4d dBm %3lus",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], entry->channel,
+                 entry->rssi_last, age_s);
+    } else {
+        snprintf(text, size, "%02X:%02X:%02X:%02X:%02X:%02X  %4d dBm %3lus",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], entry->rssi_last, age_s);
+    }
+    device_table_unpin(pin);
+}
+
+/**
+ * @brief Ascending key, then slot so equal rows keep their order
+ */
+static int compare_index(const void* a, const void* b) {
+    const device_index_t* left = (const device_index_t*)a;
+    const device_index_t* right = (const device_index_t*)b;
+    if (left->key != right->key) {
+        return left->key < right->key ? -1 : 1;
+    }
+    return (int)left->slot - (int)right->slot;
+}
+
+// System health
+
+static void health_create(lv_obj_t* screen) {
+    ui_layout_screen(screen);
+    create_title(screen, "System health");
+
+    // Lines spread over whatever height the panel has
+    lv_obj_t* lines = ui_layout_box(screen, LV_FLEX_FLOW_COLUMN);
+    ui_layout_fill(lines, 1);
+    lv_obj_set_flex_align(lines, LV_FLEX_ALIGN_SPACE_EVENLY, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
+    for (uint8_t i = 0; i < HEALTH_LINES; i++) {
+        lv_obj_t* label = renderer_label_create(&health_labels[i], lines, UI_REFRESH_HEALTH_MS);
+        ui_theme_apply(label, UI_STYLE_HEALTH);
+        ui_layout_line(label);
+    }
+
+    // Tapping the frame line switches between band and full-frame flushing
+    lv_obj_t* frame = health_labels[3].obj;
+    lv_obj_add_flag(frame, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(frame, frame_mode_cb, LV_EVENT_CLICKED, NULL);
+}
+
+/**
+ * @brief Heap, LVGL, frame, bus, backlight and power figures, all on one period
+ */
+static void health_update(uint32_t now_ms) {
+    if (!renderer_label_due(&health_labels[0], now_ms)) {
+        return;
+    }
+
+    lvgl_pool_stats_t pool;
+    lvgl_pool_get_stats(&pool);
+    renderer_info_t render;
+    renderer_get_info(&render);
+    backlight_status_t light;
+    backlight_get_status(&light);
+    spi_bus_stats_t sd;
+    spi_bus_get_stats(SPI_DEVICE_SD, &sd);
+    ui_layout_stats_t layout;
+    ui_layout_get_stats(&layout);
+    energy_status_t energy;
+    energy_get_status(&energy);
+
+    renderer_label_printf(&health_labels[0], now_ms, "Heap: %luKB free, min %luKB",
+                          ESP.getFreeHeap() / 1024, ESP.getMinFreeHeap() / 1024);
+    renderer_label_printf(&health_labels[1], now_ms, "PSRAM: %luKB free", ESP.getFreePsram() / 1024);
+    renderer_label_printf(&health_labels[2], now_ms, "LVGL: %u%% pk %lu%% frag %u%%",
+                          pool.used_pct, pool.peak * 100 / max(pool.size, (uint32_t)1), pool.frag_pct);
+    renderer_label_printf(&health_labels[3], now_ms, "Frame: %luus, %lu over, %s",
+                          render.frame_us, render.frames_over_budget,
+                          render.mode == RENDERER_MODE_FULL_FRAME ? "full" : "bands");
+    renderer_label_printf(&health_labels[4], now_ms, "Screens: %lu built, %lu evicted",
+                          render.scene_builds, render.scene_evictions);
+    renderer_label_printf(&health_labels[5], now_ms, "SD bus: %.1f%% busy",
+                          sd.busy_us / (millis() * 10.0));
+    renderer_label_printf(&health_labels[6], now_ms, "Up: %lus  %.1fC  BL %u%%",
+                          now_ms / 1000, thermal_celsius(), light.level_pct);
+    renderer_label_printf(&health_labels[7], now_ms, "Layout: %dx%d r%u, %lu passes",
+                          render.width, render.height, render.rotation, layout.passes);
+    renderer_label_printf(&health_labels[8], now_ms, "Power: %.0fmA, %.1fh on %umAh",
+                          energy.avg_ma, energy.runtime_h, energy.battery_mah);
+}
+
+static uint32_t health_wait_ms(uint32_t now_ms) {
+    return renderer_label_wait_ms(&health_labels[0], now_ms);
+}
+
+static void health_destroy(void) {
+    memset(health_labels, 0, sizeof(health_labels));
+}
+
+static void frame_mode_cb(lv_event_t* event) {
+    renderer_info_t render;
+    renderer_get_info(&render);
+    renderer_set_mode(render.mode == RENDERER_MODE_BANDS ? RENDERER_MODE_FULL_FRAME : RENDERER_MODE_BANDS);
+}
+
+// AI states
+
+static void states_create(lv_obj_t* screen) {
+    ui_layout_screen(screen);
+    create_title(screen, "AI states");
+
+    lv_obj_t* lines = ui_layout_box(screen, LV_FLEX_FLOW_COLUMN);
+    ui_layout_fill(lines, 1);
+    lv_obj_set_flex_align(lines, LV_FLEX_ALIGN_SPACE_EVENLY, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
+    for (uint8_t i = 0; i < STATES_LINES; i++) {
+        lv_obj_t* label = renderer_label_create(&states_labels[i], lines, UI_REFRESH_STATES_MS);
+        ui_theme_apply(label, UI_STYLE_HEALTH);
+        ui_layout_line(label);
+    }
+}
+
+/**
+ * @brief Share of the time, hours and entries per state, and the transition that churns most
+ */
+static void states_update(uint32_t now_ms) {
+    if (!renderer_label_due(&states_labels[0], now_ms)) {
+        return;
+    }
+
+    static ai_state_stats_t figures;    // Only the UI task draws
+    ai_state_stats_get(&figures);
+
+    for (uint8_t i = 0; i < AI_STATE_COUNT; i++) {
+        renderer_label_printf(&states_labels[i], now_ms, "%c%-9s %3lu%% %6.1fh %5lu in",
+                              i == figures.current ? '>' : ' ', ai_state_to_string((ai_state_t)i),
+                              (uint32_t)(figures.total_s > 0 ? figures.seconds[i] * 100ULL / figures.total_s : 0),
+                              figures.seconds[i] / 3600.0f, figures.entries[i]);
+    }
+
+    uint8_t from_max = 0;
+    uint8_t to_max = 0;
+    for (uint8_t from = 0; from < AI_STATE_COUNT; from++) {
+        for (uint8_t to = 0; to < AI_STATE_COUNT; to++) {
+            if (figures.transitions[from][to] > figures.transitions[from_max][to_max]) {
+                from_max = from;
+                to_max = to;
+            }
+        }
+    }
+    if (figures.transitions[from_max][to_max] == 0) {
+        renderer_label_printf(&states_labels[AI_STATE_COUNT], now_ms, "Churn: no transitions yet");
+    } else {
+        renderer_label_printf(&states_labels[AI_STATE_COUNT], now_ms, "Churn: %s>%s x%u",
+                              ai_state_to_string((ai_state_t)from_max), ai_state_to_string((ai_state_t)to_max),
+                              figures.transitions[from_max][to_max]);
+    }
+}
+
+static uint32_t states_wait_ms(uint32_t now_ms) {
+    return renderer_label_wait_ms(&states_labels[0], now_ms);
+}
+
+static void states_destroy(void) {
+    memset(states_labels, 0, sizeof(states_labels));
+}
+
+// Live feed
+
+static void feed_create(lv_obj_t* screen) {
+    ui_layout_screen(screen);
+    create_title(screen, "Live feed");
+
+    // Rows are placed by hand below the title and clipped to the screen
+    lv_obj_t* area = lv_obj_create(screen);
+    lv_obj_remove_style_all(area);
+    ui_layout_fill(area, 1);
+    lv_obj_clear_flag(area, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_clear_flag(area, LV_OBJ_FLAG_CLICKABLE);
+    for (uint8_t i = 0; i < LIVE_FEED_ENTRIES; i++) {
+        lv_obj_t* label = lv_label_create(area);
+        lv_label_set_long_mode(label, LV_LABEL_LONG_CLIP);
+        feed_text[i][0] = '\0';
+        lv_label_set_text_static(label, feed_text[i]);
+        lv_obj_set_size(label, lv_pct(100), UI_LIST_ROW_HEIGHT);
+        lv_obj_set_y(label, i * UI_LIST_ROW_HEIGHT);
+        ui_theme_apply(label, feed_roles[LIVE_FEED_DEVICE]);
+        feed_kind[i] = LIVE_FEED_DEVICE;
+        feed_rows[i] = label;
+    }
+    feed_top = 0;
+    feed_shown = 0;                         // Fill from the ring on the first frame
+}
+
+/**
+ * @brief Rotate the lines posted since the last frame in at the top
+ */
+static void feed_update(uint32_t now_ms) {
+    uint32_t newest = live_feed_sequence();
+    if (newest == feed_shown) {
+        return;
+    }
+
+    uint32_t oldest = newest >= LIVE_FEED_ENTRIES ? newest - LIVE_FEED_ENTRIES + 1 : 1;
+    live_feed_entry_t entry;
+    for (uint32_t sequence = max(feed_shown + 1, oldest); sequence <= newest; sequence++) {
+        if (!live_feed_read(sequence, &entry)) {
+            continue;                       // Overwritten while this loop ran
+        }
+        feed_top = (feed_top + LIVE_FEED_ENTRIES - 1) % LIVE_FEED_ENTRIES;
+        lv_obj_t* label = feed_rows[feed_top];
+        memcpy(feed_text[feed_top], entry.text, sizeof(entry.text));
+        if (entry.kind != feed_kind[feed_top] && entry.kind < LIVE_FEED_KINDS) {
+            ui_theme_swap(label, feed_roles[feed_kind[feed_top]], feed_roles[entry.kind]);
+            feed_kind[feed_top] = entry.kind;
+        }
+        lv_label_set_text_static(label, feed_text[feed_top]);
+    }
+    feed_shown = newest;
+
+    // Every row moves down past the new ones; only positions change
+    for (uint8_t i = 0; i < LIVE_FEED_ENTRIES; i++) {
+        lv_obj_set_y(feed_rows[(feed_top + i) % LIVE_FEED_ENTRIES], i * UI_LIST_ROW_HEIGHT);
+    }
+}
+
+static void feed_destroy(void) {
+    memset(feed_rows, 0, sizeof(feed_rows));
+    feed_shown = 0;
+}
+
+// RSSI: median sparkline, distributions and channel occupancy
+
+static void histogram_create(lv_obj_t* screen) {
+    ui_layout_screen(screen);
+    lv_obj_t* title = create_title(screen, "RSSI");
+
+    lv_obj_t* legend = lv_label_create(title);
+    lv_label_set_recolor(legend, true);
+    lv_label_set_text_static(legend, "#00FFFF WiFi#  #FF00FF BLE#  #FFFF00 ch 1-13#");
+    ui_theme_apply(legend, UI_STYLE_TEXT);
+
+    // Median RSSI per scan cycle, oldest on the left
+    spark_chart = create_chart(screen, 3, LV_CHART_TYPE_LINE, UI_SPARK_POINTS);
+    ui_theme_apply(spark_chart, UI_STYLE_CHART_POINTS);
+    lv_chart_set_range(spark_chart, LV_CHART_AXIS_PRIMARY_Y, UI_SPARK_MIN_DBM, UI_SPARK_MAX_DBM);
+    spark_wifi = lv_chart_add_series(spark_chart, lv_color_hex(0x00FFFF), LV_CHART_AXIS_PRIMARY_Y);
+    spark_ble = lv_chart_add_series(spark_chart, lv_color_hex(0xFF00FF), LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_all_value(spark_chart, spark_wifi, LV_CHART_POINT_NONE);
+    lv_chart_set_all_value(spark_chart, spark_ble, LV_CHART_POINT_NONE);
+    uint16_t oldest = (spark_head + UI_SPARK_POINTS - spark_len) % UI_SPARK_POINTS;
+    for (uint16_t i = 0; i < spark_len; i++) {
+        uint16_t at = (oldest + i) % UI_SPARK_POINTS;
+        lv_chart_set_next_value(spark_chart, spark_wifi, spark_point(spark_history[0][at]));
+        lv_chart_set_next_value(spark_chart, spark_ble, spark_point(spark_history[1][at]));
+    }
+
+    // Last cycle's RSSI_HIST_BIN_DB bins from RSSI_HIST_MIN_DBM up
+    hist_chart = create_chart(screen, 4, LV_CHART_TYPE_BAR, RSSI_HIST_BINS);
+    hist_wifi = lv_chart_add_series(hist_chart, lv_color_hex(0x00FFFF), LV_CHART_AXIS_PRIMARY_Y);
+    hist_ble = lv_chart_add_series(hist_chart, lv_color_hex(0xFF00FF), LV_CHART_AXIS_PRIMARY_Y);
+
+    // Networks per WiFi channel
+    channel_chart = create_chart(screen, 4, LV_CHART_TYPE_BAR, WIFI_CHANNEL_COUNT);
+    channel_series = lv_chart_add_series(channel_chart, lv_color_hex(0xFFFF00), LV_CHART_AXIS_PRIMARY_Y);
+
+    hist_peak = 0;
+    channel_peak = 0;
+    chart_sequence = sensor_snapshot_sequence() - 1;
+}
+
+/**
+ * @brief Load the last cycle's bins, touching only values that changed
+ *
+ * A changed bar invalidates its own column; an unchanged series is not
+ * touched at all, so a quiet cycle redraws nothing.
+ */
+static void histogram_update(uint32_t now_ms) {
+    uint32_t sequence = sensor_snapshot_sequence();
+    if (hist_chart == NULL || sequence == chart_sequence) {
+        return;
+    }
+    chart_sequence = sequence;
+
+    static scan_histograms_t histograms;
+    sensor_snapshot_read_histograms(&histograms);
+
+    uint16_t peak = 0;
+    for (uint8_t bin = 0; bin < RSSI_HIST_BINS; bin++) {
+        peak = max(peak, max(histograms.wifi_all.bins[bin], histograms.ble.bins[bin]));
+    }
+    set_chart_peak(hist_chart, &hist_peak, peak);
+    update_series(hist_chart, hist_wifi, histograms.wifi_all.bins, RSSI_HIST_BINS);
+    update_series(hist_chart, hist_ble, histograms.ble.bins, RSSI_HIST_BINS);
+
+    uint16_t networks[WIFI_CHANNEL_COUNT];
+    peak = 0;
+    for (uint8_t channel = 1; channel <= WIFI_CHANNEL_COUNT; channel++) {
+        networks[channel - 1] = histograms.wifi_channel[channel].count;
+        peak = max(peak, networks[channel - 1]);
+    }
+    set_chart_peak(channel_chart, &channel_peak, peak);
+    update_series(channel_chart, channel_series, networks, WIFI_CHANNEL_COUNT);
+}
+
+static void histogram_destroy(void) {
+    spark_chart = NULL;
+    hist_chart = NULL;
+    channel_chart = NULL;
+}
+
+/**
+ * @brief Record the medians of a newly published scan cycle
+ */
+void ui_screens_sample(void) {
+    ai_feature_vector_t features;
+    uint32_t sequence = sensor_snapshot_read_features(&features);
+    if (sequence == sampled_sequence) {
+        return;
+    }
+    sampled_sequence = sequence;
+
+    // The aggregator's quantiles, mapped back from [0, 1] to dBm
+    const int16_t* v = features.values;
+    int8_t wifi = v[AI_FEATURE_WIFI_COUNT] > 0
+        ? (int8_t)((v[AI_FEATURE_WIFI_RSSI_P50] * 100 + AI_FEATURE_ONE / 2) / AI_FEATURE_ONE - 100) : SPARK_NONE;
+    int8_t ble = v[AI_FEATURE_BLE_COUNT] > 0
+        ? (int8_t)((v[AI_FEATURE_BLE_RSSI_P50] * 100 + AI_FEATURE_ONE / 2) / AI_FEATURE_ONE - 100) : SPARK_NONE;
+    spark_history[0][spark_head] = wifi;
+    spark_history[1][spark_head] = ble;
+    spark_head = (spark_head + 1) % UI_SPARK_POINTS;
+    spark_len = min((uint16_t)(spark_len + 1), (uint16_t)UI_SPARK_POINTS);
+
+    // Circular update mode: only the new point and the gap after it redraw
+    if (spark_chart != NULL) {
+        lv_chart_set_next_value(spark_chart, spark_wifi, spark_point(wifi));
+        lv_chart_set_next_value(spark_chart, spark_ble, spark_point(ble));
+    }
+}
+
+/**
+ * @brief Borderless chart strip across the screen
+ * @param grow Share of the height left below the title
+ */
+static lv_obj_t* create_chart(lv_obj_t* parent, uint8_t grow, lv_chart_type_t type, uint16_t points) {
+    lv_obj_t* obj = lv_chart_create(parent);
+    ui_layout_fill(obj, grow);
+    ui_theme_apply(obj, UI_STYLE_CHART);
+    lv_chart_set_type(obj, type);
+    lv_chart_set_point_count(obj, points);
+    lv_chart_set_update_mode(obj, LV_CHART_UPDATE_MODE_CIRCULAR);
+    lv_chart_set_div_line_count(obj, 0, 0);
+    return obj;
+}
+
+/**
+ * @brief Hand LVGL only the points whose value differs from what is drawn
+ */
+static void update_series(lv_obj_t* obj, lv_chart_series_t* series, const uint16_t* values,
+                          uint16_t count) {
+    lv_coord_t* drawn = lv_chart_get_y_array(obj, series);
+    for (uint16_t i = 0; i < count; i++) {
+        if (drawn[i] != (lv_coord_t)values[i]) {
+            lv_chart_set_value_by_id(obj, series, i, values[i]);
+        }
+    }
+}
+
+/**
+ * @brief Scale the y axis in steps of UI_CHART_PEAK_STEP, which redraws the whole chart
+ */
+static void set_chart_peak(lv_obj_t* obj, uint16_t* shown, uint16_t peak) {
+    uint16_t top = (peak / UI_CHART_PEAK_STEP + 1) * UI_CHART_PEAK_STEP;
+    if (top != *shown) {
+        lv_chart_set_range(obj, LV_CHART_AXIS_PRIMARY_Y, 0, top);
+        *shown = top;
+    }
+}
+
+/**
+ * @brief Stored sparkline sample to a chart value
+ */
+static lv_coord_t spark_point(int8_t dbm) {
+    return dbm == SPARK_NONE ? LV_CHART_POINT_NONE : dbm;
+}
+
+/**
+ * @brief Row across the top of a detail screen, items pushed to either end
+ */
+static lv_obj_t* create_title_row(lv_obj_t* parent) {
+    lv_obj_t* row = ui_layout_box(parent, LV_FLEX_FLOW_ROW);
+    ui_layout_fill(row, 0);
+    lv_obj_set_flex_align(row, LV_FLEX_ALIGN_SPACE_BETWEEN, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+    return row;
+}
+
+/**
+ * @brief Static heading at the top left of a detail screen
+ * @return Its row, for anything to show at the right end
+ */
+static lv_obj_t* create_title(lv_obj_t* parent, const char* text) {
+    lv_obj_t* row = create_title_row(parent);
+    lv_obj_t* label = lv_label_create(row);
+    lv_label_set_text(label, text);
+    ui_theme_apply(label, UI_STYLE_TITLE);
+    return row;
+}
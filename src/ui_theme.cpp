@@ -0,0 +1,180 @@
+/**
+ * @file ui_theme.cpp
+ * @brief Shared, prebuilt LVGL styles for every scene, in two colour sets
+ *
+ * A local style (lv_obj_set_style_*) gives the object its own style on
+ * the LVGL heap, grown by one property at a time, and each one is another
+ * entry LVGL walks whenever it resolves a property of that object. The
+ * face screen alone had a dozen, every device list row another, and each
+ * screen rebuild after an eviction made them again. Here each role and AI
+ * state has one lv_style_t, filled in once at boot, and objects only
+ * reference it.
+ *
+ * Themes are palettes, not style sets: switching rewrites the colour
+ * properties in place, which LVGL does without allocating since the
+ * properties already exist, and then restyles the screens once.
+ */
+
+#include <Arduino.h>
+#include <lvgl.h>
+#include "config.h"
+#include "ui_theme.h"
+#include "ui_fonts.h"
+#include "logger.h"
+
+/**
+ * @brief A theme's colours
+ */
+typedef struct {
+    const char* name;
+    uint32_t screen;
+    uint32_t text;
+    uint32_t title;
+    uint32_t alert;
+    uint32_t stats;
+    uint32_t network;
+    uint32_t health;
+    uint32_t overlay;
+    uint32_t overlay_bg;
+    uint32_t state[AI_STATE_COUNT];     // Status line, by ai_state_t
+} palette_t;
+
+static const palette_t palettes[UI_THEMES] = {
+    {
+        "classic", 0x000000, 0xFFFFFF, 0x00FFFF, 0xFF4040, 0x00FF00, 0x00FFFF, 0x00FF00, 0xFFFF00, 0x000000,
+        //  IDLE     SNIFFING  TRACKING  LEARNING  EXCITED   SLEEPING  ERROR     UPDATING
+        { 0xFFFFFF, 0x00FFFF, 0xFF8000, 0x8080FF, 0xFFFF00, 0x808080, 0xFF0000, 0xFF00FF }
+    },
+    {
+        "night", 0x000000, 0xA00000, 0xC00000, 0xFF0000, 0xB00000, 0x900000, 0xB00000, 0xC04000, 0x000000,
+        { 0xA00000, 0xC00000, 0xD02000, 0xA00020, 0xD03000, 0x600000, 0xFF0000, 0xC00040 }
+    },
+};
+
+static lv_style_t styles[UI_STYLE_ROLES];
+static lv_style_t state_styles[AI_STATE_COUNT];
+static ui_theme_t current = (ui_theme_t)UI_THEME_DEFAULT;
+static bool built = false;
+
+// Part each role's style is added to
+static const lv_style_selector_t selectors[UI_STYLE_ROLES] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, LV_PART_INDICATOR, 0
+};
+
+// Forward declarations
+static void paint(const palette_t* palette);
+
+/**
+ * @brief Build the shared styles in UI_THEME_DEFAULT
+ */
+void ui_theme_init(void) {
+    if (built) {
+        return;
+    }
+    for (uint8_t i = 0; i < UI_STYLE_ROLES; i++) {
+        lv_style_init(&styles[i]);
+    }
+    for (uint8_t i = 0; i < AI_STATE_COUNT; i++) {
+        lv_style_init(&state_styles[i]);
+    }
+
+    // Everything but the colours, which paint() sets
+    lv_style_set_bg_opa(&styles[UI_STYLE_SCREEN], LV_OPA_COVER);
+    lv_style_set_pad_all(&styles[UI_STYLE_LAYOUT], UI_LAYOUT_PAD);
+    lv_style_set_pad_row(&styles[UI_STYLE_LAYOUT], UI_LAYOUT_GAP);
+    lv_style_set_pad_column(&styles[UI_STYLE_STATUS_ROW], 6);
+    lv_style_set_text_font(&styles[UI_STYLE_STATS], &ui_font_14);
+    lv_style_set_text_font(&styles[UI_STYLE_NETWORK], &ui_font_12);
+    lv_style_set_pad_all(&styles[UI_STYLE_CHART], 2);
+    lv_style_set_size(&styles[UI_STYLE_CHART_POINTS], 0);
+    lv_style_set_text_font(&styles[UI_STYLE_OVERLAY], &ui_font_12);
+    lv_style_set_bg_opa(&styles[UI_STYLE_OVERLAY], LV_OPA_70);
+
+    paint(&palettes[current]);
+    built = true;
+    LOGI(UI, "🎨 UI styles built: %u roles, %u states, %s theme",
+         UI_STYLE_ROLES, AI_STATE_COUNT, palettes[current].name);
+}
+
+/**
+ * @brief Give an object a role's shared style
+ */
+void ui_theme_apply(lv_obj_t* obj, ui_style_role_t role) {
+    lv_obj_add_style(obj, &styles[role], selectors[role]);
+}
+
+/**
+ * @brief Replace one role's shared style on an object with another's
+ */
+void ui_theme_swap(lv_obj_t* obj, ui_style_role_t from, ui_style_role_t to) {
+    if (from == to) {
+        return;
+    }
+    lv_obj_remove_style(obj, &styles[from], selectors[from]);
+    lv_obj_add_style(obj, &styles[to], selectors[to]);
+}
+
+/**
+ * @brief Colour an object's text by AI state, swapping out the previous state's style
+ */
+void ui_theme_set_state(lv_obj_t* obj, ai_state_t previous, ai_state_t state) {
+    if (previous == state) {
+        return;
+    }
+    if (previous < AI_STATE_COUNT) {
+        lv_obj_remove_style(obj, &state_styles[previous], 0);
+    }
+    lv_obj_add_style(obj, &state_styles[state], 0);
+}
+
+/**
+ * @brief Switch every shared style to another colour set
+ */
+void ui_theme_set(ui_theme_t theme) {
+    if (theme == current || theme >= UI_THEMES) {
+        return;
+    }
+    LOGI(UI, "🎨 UI theme %s -> %s", palettes[current].name, palettes[theme].name);
+    current = theme;
+    if (!built) {
+        return;
+    }
+    paint(&palettes[theme]);
+
+    // Screens, built or not yet shown, then the top layer, which LVGL
+    // keeps apart from them
+    lv_obj_report_style_change(NULL);
+    lv_obj_refresh_style(lv_layer_top(), LV_PART_ANY, LV_STYLE_PROP_ANY);
+}
+
+/**
+ * @brief Theme in force
+ */
+ui_theme_t ui_theme_current(void) {
+    return current;
+}
+
+/**
+ * @brief Short name for logs
+ */
+const char* ui_theme_name(ui_theme_t theme) {
+    return theme < UI_THEMES ? palettes[theme].name : "?";
+}
+
+/**
+ * @brief Set every colour property from a palette
+ */
+static void paint(const palette_t* palette) {
+    lv_style_set_bg_color(&styles[UI_STYLE_SCREEN], lv_color_hex(palette->screen));
+    lv_style_set_text_color(&styles[UI_STYLE_TEXT], lv_color_hex(palette->text));
+    lv_style_set_text_color(&styles[UI_STYLE_TITLE], lv_color_hex(palette->title));
+    lv_style_set_text_color(&styles[UI_STYLE_ALERT], lv_color_hex(palette->alert));
+    lv_style_set_text_color(&styles[UI_STYLE_STATS], lv_color_hex(palette->stats));
+    lv_style_set_text_color(&styles[UI_STYLE_NETWORK], lv_color_hex(palette->network));
+    lv_style_set_text_color(&styles[UI_STYLE_HEALTH], lv_color_hex(palette->health));
+    lv_style_set_text_color(&styles[UI_STYLE_OVERLAY], lv_color_hex(palette->overlay));
+    lv_style_set_bg_color(&styles[UI_STYLE_OVERLAY], lv_color_hex(palette->overlay_bg));
+    for (uint8_t i = 0; i < AI_STATE_COUNT; i++) {
+        lv_style_set_text_color(&state_styles[i], lv_color_hex(palette->state[i]));
+    }
+}
@@ -0,0 +1,225 @@
+/**
+ * @file wake_sources.cpp
+ * @brief Touch, motion and battery as reasons to wake, and as features
+ *
+ * The S3's ULP-RISC-V would need its program built and embedded by the
+ * IDF's own build, which the Arduino framework does not run. The RTC
+ * wake logic does the same job for events that raise a pin: the touch
+ * IRQ is EXT0 and the accelerometer's INT1 is EXT1, each active low, so
+ * the main cores stay off until one of them fires. The battery has no
+ * such pin, so it is read by the main CPU on each wake instead of watched
+ * from the coprocessor.
+ *
+ * The accelerometer (a LIS3DH) runs its own 10 Hz low-power loop and
+ * latches INT1 on a high-passed change above WAKE_MOTION_THRESHOLD_MG,
+ * so a device at rest never raises it and a move raises it until read.
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <driver/rtc_io.h>
+#include "config.h"
+#include "wake_sources.h"
+#include "power_manager.h"
+#include "logger.h"
+
+#define LIS3DH_WHO_AM_I     0x0F
+#define LIS3DH_ID           0x33
+#define LIS3DH_CTRL_REG1    0x20
+#define LIS3DH_REFERENCE    0x26
+#define LIS3DH_INT1_CFG     0x30
+#define LIS3DH_INT1_SRC     0x31
+#define LIS3DH_INT1_THS     0x32
+#define LIS3DH_MG_PER_LSB   16          // INT1_THS at +-2 g
+
+static wake_status_t status;
+static portMUX_TYPE wake_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const cause_names[WAKE_CAUSE_COUNT] = { "reset", "timer", "touch", "motion" };
+
+// Forward declarations
+static bool accel_write(uint8_t reg, uint8_t value);
+static bool accel_read(uint8_t reg, uint8_t* value);
+static bool accel_configure(void);
+static uint16_t read_battery_mv(void);
+
+/**
+ * @brief What ended the last sleep
+ */
+wake_cause_t wake_sources_boot_cause(void) {
+    switch (esp_sleep_get_wakeup_cause()) {
+        case ESP_SLEEP_WAKEUP_TIMER:
+            return WAKE_CAUSE_TIMER;
+        case ESP_SLEEP_WAKEUP_EXT0:
+            return WAKE_CAUSE_TOUCH;
+        case ESP_SLEEP_WAKEUP_EXT1:
+            return WAKE_CAUSE_MOTION;
+        default:
+            return WAKE_CAUSE_RESET;
+    }
+}
+
+/**
+ * @brief Boot cause, accelerometer, battery pin
+ */
+void wake_sources_init(void) {
+    status.boot_cause = wake_sources_boot_cause();
+    status.battery = BOARD.battery_adc >= 0;
+    if (status.boot_cause == WAKE_CAUSE_MOTION) {
+        status.motion_ms = millis();
+    }
+#if WAKE_MOTION_ENABLED
+    if (BOARD.i2c.sda >= 0 && BOARD.i2c.motion_irq >= 0) {
+        status.accelerometer = accel_configure();
+    }
+    if (status.accelerometer) {
+        // A level wakeup: the chip stays awake until the system task clears the latch
+        pinMode(BOARD.i2c.motion_irq, INPUT_PULLUP);
+        power_status_t power;
+        power_manager_get_status(&power);
+        if (power.light_sleep) {
+            gpio_wakeup_enable((gpio_num_t)BOARD.i2c.motion_irq, GPIO_INTR_LOW_LEVEL);
+            esp_sleep_enable_gpio_wakeup();
+        }
+    }
+#endif
+    status.battery_mv = read_battery_mv();
+    LOGI(SYSTEM, "✅ Woken by %s; accelerometer %s, battery %s",
+         cause_names[status.boot_cause], status.accelerometer ? "found" : "absent",
+         status.battery ? "read" : "not wired");
+}
+
+/**
+ * @brief Clear a latched motion interrupt and read the battery
+ */
+void wake_sources_sample(uint32_t now_ms) {
+    bool moved = false;
+    if (status.accelerometer && digitalRead(BOARD.i2c.motion_irq) == LOW) {
+        uint8_t source;
+        moved = accel_read(LIS3DH_INT1_SRC, &source);     // Reading it releases INT1
+    }
+    uint16_t battery_mv = read_battery_mv();
+    portENTER_CRITICAL(&wake_mux);
+    if (moved) {
+        status.motion_events++;
+        status.motion_ms = now_ms;
+    }
+    status.battery_mv = battery_mv;
+    portEXIT_CRITICAL(&wake_mux);
+}
+
+/**
+ * @brief SENSOR_WAKE_* bits for the cycle's sensor data
+ */
+uint8_t wake_sources_flags(uint32_t now_ms) {
+    portENTER_CRITICAL(&wake_mux);
+    wake_status_t now = status;
+    portEXIT_CRITICAL(&wake_mux);
+
+    uint8_t flags = 0;
+    bool recent = now.motion_ms != 0 && now_ms - now.motion_ms < WAKE_EVENT_HOLD_MS;
+    if (recent && (now.motion_events > 0 || now.boot_cause == WAKE_CAUSE_MOTION)) {
+        flags |= SENSOR_WAKE_MOTION;
+    }
+    if (now.boot_cause == WAKE_CAUSE_TOUCH && now_ms < WAKE_EVENT_HOLD_MS) {
+        flags |= SENSOR_WAKE_TOUCH;
+    }
+    if (now.battery && now.battery_mv > 0 && now.battery_mv < WAKE_BATTERY_LOW_MV) {
+        flags |= SENSOR_WAKE_BATTERY_LOW;
+    }
+    return flags;
+}
+
+/**
+ * @brief Arm the touch IRQ (EXT0) and the accelerometer (EXT1) for deep sleep
+ */
+void wake_sources_arm_deep_sleep(bool motion) {
+    if (BOARD.touch.irq >= 0 && esp_sleep_is_valid_wakeup_gpio((gpio_num_t)BOARD.touch.irq)) {
+        // The controller's pen-down output is open drain; the RTC pad keeps its pull-up
+        rtc_gpio_pullup_en((gpio_num_t)BOARD.touch.irq);
+        rtc_gpio_pulldown_dis((gpio_num_t)BOARD.touch.irq);
+        esp_sleep_enable_ext0_wakeup((gpio_num_t)BOARD.touch.irq, 0);
+    }
+    if (motion && status.accelerometer && esp_sleep_is_valid_wakeup_gpio((gpio_num_t)BOARD.i2c.motion_irq)) {
+        uint8_t source;
+        accel_read(LIS3DH_INT1_SRC, &source);       // Start the sleep with INT1 released
+        esp_sleep_enable_ext1_wakeup(1ULL << BOARD.i2c.motion_irq, ESP_EXT1_WAKEUP_ALL_LOW);
+    }
+}
+
+/**
+ * @brief Copy the sources and their figures
+ */
+void wake_sources_get_status(wake_status_t* out) {
+    portENTER_CRITICAL(&wake_mux);
+    *out = status;
+    portEXIT_CRITICAL(&wake_mux);
+}
+
+/**
+ * @brief Short name for logs and metrics
+ */
+const char* wake_cause_name(wake_cause_t cause) {
+    return cause < WAKE_CAUSE_COUNT ? cause_names[cause] : "?";
+}
+
+/**
+ * @brief One register of the accelerometer
+ */
+static bool accel_write(uint8_t reg, uint8_t value) {
+    Wire.beginTransmission(WAKE_ACCEL_ADDR);
+    Wire.write(reg);
+    Wire.write(value);
+    return Wire.endTransmission() == 0;
+}
+
+static bool accel_read(uint8_t reg, uint8_t* value) {
+    Wire.beginTransmission(WAKE_ACCEL_ADDR);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0 || Wire.requestFrom(WAKE_ACCEL_ADDR, 1) != 1) {
+        return false;
+    }
+    *value = Wire.read();
+    return true;
+}
+
+/**
+ * @brief 10 Hz low-power, high-passed motion on INT1, latched, active low
+ */
+static bool accel_configure(void) {
+    uint8_t id;
+    if (!accel_read(LIS3DH_WHO_AM_I, &id) || id != LIS3DH_ID) {
+        return false;
+    }
+    static const uint8_t setup[][2] = {
+        { LIS3DH_CTRL_REG1,     0x2F },     // 10 Hz, low-power mode, X, Y and Z
+        { LIS3DH_CTRL_REG1 + 1, 0x01 },     // CTRL_REG2: high-pass filter on the INT1 path
+        { LIS3DH_CTRL_REG1 + 2, 0x40 },     // CTRL_REG3: IA1 on INT1
+        { LIS3DH_CTRL_REG1 + 3, 0x00 },     // CTRL_REG4: +-2 g
+        { LIS3DH_CTRL_REG1 + 4, 0x08 },     // CTRL_REG5: latch INT1 until INT1_SRC is read
+        { LIS3DH_CTRL_REG1 + 5, 0x02 },     // CTRL_REG6: INT1 active low
+        { LIS3DH_INT1_THS,      WAKE_MOTION_THRESHOLD_MG / LIS3DH_MG_PER_LSB },
+        { LIS3DH_INT1_THS + 1,  0x00 },     // INT1_DURATION: one sample is enough
+        { LIS3DH_INT1_CFG,      0x2A },     // Any of X, Y, Z high
+    };
+    for (size_t i = 0; i < sizeof(setup) / sizeof(setup[0]); i++) {
+        if (!accel_write(setup[i][0], setup[i][1])) {
+            return false;
+        }
+    }
+    uint8_t unused;
+    accel_read(LIS3DH_REFERENCE, &unused);          // Sets the high-pass filter to the present reading
+    return accel_read(LIS3DH_INT1_SRC, &unused);
+}
+
+/**
+ * @brief Cell voltage, 0 without a battery pin
+ */
+static uint16_t read_battery_mv(void) {
+    if (BOARD.battery_adc < 0) {
+        return 0;
+    }
+    return (uint16_t)(analogReadMilliVolts(BOARD.battery_adc) * WAKE_BATTERY_DIVIDER);
+}
@@ -0,0 +1,200 @@
+/**
+ * @file warm_start.cpp
+ * @brief Snapshot of the AI task's behavioural state in the journal
+ *
+ * The AI task hands over its state after every decision, which is only a
+ * copy under a spinlock. A low-lane job commits it to the journal every
+ * WARM_START_SAVE_INTERVAL_MS when it differs from the last one written,
+ * and a shutdown handler commits it once more on esp_restart(). A commit
+ * appends about 160 bytes and takes well under a millisecond, and one cut
+ * off by a power loss leaves the previous snapshot in force. Without a
+ * journal partition the snapshot goes to NVS as before. A foreign
+ * snapshot fails its version or CRC check and the unit starts cold.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_system.h>
+#include <esp_rom_crc.h>
+#include "config.h"
+#include "job_pool.h"
+#include "journal.h"
+#include "warm_start.h"
+#include "logger.h"
+
+#define SNAPSHOT_CRC_BYTES (sizeof(warm_start_snapshot_t) - sizeof(uint32_t))
+#define WARM_JOURNAL_KEY   "warm"
+
+static warm_start_snapshot_t restored;
+static bool restored_valid = false;
+static warm_start_snapshot_t latest;            // From the AI task
+static bool latest_valid = false;
+static warm_start_snapshot_t written;           // Last one in NVS
+static volatile bool save_queued = false;
+static uint32_t last_save_ms = 0;
+static warm_start_stats_t stats = {0};
+static portMUX_TYPE warm_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void save_job(void* payload);
+static void save_on_shutdown(void);
+static bool save(void);
+static bool same_state(const warm_start_snapshot_t* a, const warm_start_snapshot_t* b);
+static bool load(warm_start_snapshot_t* stored);
+
+/**
+ * @brief Read the snapshot from the journal, else NVS, and register the shutdown save
+ */
+bool warm_start_init(void) {
+    esp_register_shutdown_handler(save_on_shutdown);
+
+    warm_start_snapshot_t stored;
+    if (!load(&stored)) {
+        return false;               // Nothing saved yet: first boot
+    }
+    bool ok = stored.magic == WARM_START_MAGIC && stored.version == WARM_START_VERSION &&
+         stored.feature_count == AI_FEATURE_COUNT && stored.state < AI_STATE_COUNT &&
+         stored.previous_state < AI_STATE_COUNT &&
+         esp_rom_crc32_le(0, (const uint8_t*)&stored, SNAPSHOT_CRC_BYTES) == stored.crc32;
+    if (!ok) {
+        LOGW(AI, "⚠️  No usable warm start snapshot - starting cold");
+        return false;
+    }
+
+    if (stored.state == AI_STATE_ERROR || stored.state == AI_STATE_UPDATING) {
+        stored.state = AI_STATE_IDLE;
+    }
+    restored = stored;
+    written = stored;
+    restored_valid = true;
+    stats.restored = true;
+    LOGI(AI, "✅ Warm start: %s, excitement %u, learning %u%%, saved after %lu s up",
+         ai_state_to_string((ai_state_t)stored.state), stored.excitement,
+         stored.learning_progress, stored.uptime_s);
+    return true;
+}
+
+/**
+ * @brief The snapshot read at boot
+ */
+bool warm_start_restored(warm_start_snapshot_t* snapshot) {
+    if (restored_valid) {
+        *snapshot = restored;
+    }
+    return restored_valid;
+}
+
+/**
+ * @brief Hand over the latest state; cheap, from the AI task after each decision
+ */
+void warm_start_update(const warm_start_snapshot_t* snapshot) {
+    portENTER_CRITICAL(&warm_mux);
+    latest = *snapshot;
+    latest_valid = true;
+    portEXIT_CRITICAL(&warm_mux);
+}
+
+/**
+ * @brief Save on a job worker every WARM_START_SAVE_INTERVAL_MS if the state changed
+ */
+void warm_start_tick(uint32_t now_ms) {
+    if (save_queued || now_ms - last_save_ms < WARM_START_SAVE_INTERVAL_MS) {
+        return;
+    }
+    last_save_ms = now_ms;
+    save_queued = true;
+    if (!job_pool_submit(JOB_LANE_LOW, save_job, NULL, 0)) {
+        save_queued = false;        // Retried on the next interval
+    }
+}
+
+/**
+ * @brief Copy the counts
+ */
+void warm_start_get_stats(warm_start_stats_t* out) {
+    portENTER_CRITICAL(&warm_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&warm_mux);
+}
+
+/**
+ * @brief The periodic save, on a job worker
+ */
+static void save_job(void* payload) {
+    save();
+    save_queued = false;
+}
+
+/**
+ * @brief Last save before a restart; runs on whichever task called esp_restart()
+ */
+static void save_on_shutdown(void) {
+    save();
+}
+
+/**
+ * @brief Write the latest snapshot unless NVS already has the same state
+ */
+static bool save(void) {
+    portENTER_CRITICAL(&warm_mux);
+    bool valid = latest_valid;
+    warm_start_snapshot_t snapshot = latest;
+    portEXIT_CRITICAL(&warm_mux);
+    if (!valid) {
+        return false;
+    }
+    if (same_state(&snapshot, &written)) {
+        portENTER_CRITICAL(&warm_mux);
+        stats.skipped++;
+        portEXIT_CRITICAL(&warm_mux);
+        return true;
+    }
+
+    snapshot.magic = WARM_START_MAGIC;
+    snapshot.version = WARM_START_VERSION;
+    snapshot.feature_count = AI_FEATURE_COUNT;
+    snapshot.uptime_s = millis() / 1000;
+    snapshot.crc32 = esp_rom_crc32_le(0, (const uint8_t*)&snapshot, SNAPSHOT_CRC_BYTES);
+
+    bool ok = journal_put(WARM_JOURNAL_KEY, &snapshot, sizeof(snapshot));
+    if (!ok) {
+        Preferences prefs;
+        ok = prefs.begin(WARM_START_NVS_NAMESPACE, false) &&
+             prefs.putBytes("state", &snapshot, sizeof(snapshot)) == sizeof(snapshot);
+        prefs.end();
+    }
+    portENTER_CRITICAL(&warm_mux);
+    if (ok) {
+        written = snapshot;
+        stats.saves++;
+    } else {
+        stats.failures++;
+    }
+    portEXIT_CRITICAL(&warm_mux);
+    return ok;
+}
+
+/**
+ * @brief Whether two snapshots hold the same behaviour, ignoring the clocks
+ */
+static bool same_state(const warm_start_snapshot_t* a, const warm_start_snapshot_t* b) {
+    return a->state == b->state && a->previous_state == b->previous_state &&
+           a->excitement == b->excitement && a->learning_progress == b->learning_progress &&
+           memcmp(a->hidden, b->hidden, sizeof(a->hidden)) == 0;
+}
+
+/**
+ * @brief Read the saved snapshot: the journal's, else one an older firmware left in NVS
+ */
+static bool load(warm_start_snapshot_t* stored) {
+    if (journal_get(WARM_JOURNAL_KEY, stored, sizeof(*stored)) == sizeof(*stored)) {
+        return true;
+    }
+    Preferences prefs;
+    if (!prefs.begin(WARM_START_NVS_NAMESPACE, true)) {
+        return false;
+    }
+    bool ok = prefs.getBytes("state", stored, sizeof(*stored)) == sizeof(*stored);
+    prefs.end();
+    return ok;
+}
@@ -0,0 +1,210 @@
+"""
+Query HydraESP sighting archive segments, reading only the columns needed.
+
+The segments are /logs/archive_NNNN.hca on the SD card, one per batch of
+up to 4096 per-device sightings:
+
+    python3 tools/archive/query_archive.py archive_*.hca
+    python3 tools/archive/query_archive.py --channel 6 --from 14:00 --to 15:00 archive_*.hca
+    python3 tools/archive/query_archive.py --boot 12 --kind ble --csv archive_*.hca > ble.csv
+    python3 tools/archive/query_archive.py --stats archive_*.hca
+
+Times are milliseconds since the boot that wrote the segment, or
+[H]H:MM[:SS] of uptime. A segment's footer is read first and the segment
+skipped if its bounds rule the query out; of the rest, the time and
+channel columns are read, and the device, RSSI and dictionary columns
+only of segments with a matching row. --stats prints each footer and the
+bytes the query read.
+"""
+
+import struct
+import sys
+import zlib
+
+MAGIC = 0x41484848              # ARCHIVE_MAGIC
+FOOTER_MAGIC = 0x46414848       # ARCHIVE_FOOTER_MAGIC
+HEADER = struct.Struct("<IHHII")                # archive_header_t
+FOOTER = struct.Struct("<IIIIHHbbBB" + "III" * 5 + "I")  # archive_footer_t
+DEVICE = struct.Struct("<6sB")                  # archive_device_t
+TIME, DEVICE_COLUMN, RSSI, CHANNEL, DICTIONARY = range(5)   # archive_column_t
+KINDS = ["wifi", "ble"]         # device_kind_t
+RSSI_RUN = 0x80
+RSSI_ESCAPE = 0x00
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def varints(data):
+    value = shift = 0
+    for byte in data:
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            yield value
+            value = shift = 0
+    if shift:
+        raise ValueError("truncated varint")
+
+
+def parse_time(text):
+    if ":" not in text:
+        return int(text)
+    parts = [int(part) for part in text.split(":")]
+    while len(parts) < 3:
+        parts.append(0)
+    return ((parts[0] * 60 + parts[1]) * 60 + parts[2]) * 1000
+
+
+class Segment:
+    """An archive file; columns are read on demand and counted in bytes_read."""
+
+    def __init__(self, path):
+        self.path = path
+        self.file = open(path, "rb")
+        self.file.seek(0, 2)
+        size = self.file.tell()
+        if size < HEADER.size + FOOTER.size:
+            raise ValueError("too short")
+        self.file.seek(size - FOOTER.size)
+        fields = FOOTER.unpack(self.file.read(FOOTER.size))
+        (self.boot, self.first_ms, self.last_ms, self.rows, self.devices, self.channel_mask,
+         self.rssi_min, self.rssi_max, self.kind_mask, _) = fields[:10]
+        self.columns = [fields[10 + 3 * i:13 + 3 * i] for i in range(5)]
+        if fields[-1] != FOOTER_MAGIC:
+            raise ValueError("no footer")
+        self.bytes_read = FOOTER.size
+
+    def column(self, index):
+        offset, length, crc = self.columns[index]
+        self.file.seek(offset)
+        data = self.file.read(length)
+        if len(data) != length or zlib.crc32(data) != crc:
+            raise ValueError("column %d fails its CRC" % index)
+        self.bytes_read += length
+        return data
+
+    def times(self):
+        times, previous, delta = [], 0, 0
+        for value in varints(self.column(TIME)):
+            delta = (delta + unzigzag(value)) & 0xFFFFFFFF
+            previous = (previous + delta) & 0xFFFFFFFF
+            times.append(previous)
+        return times
+
+    def channels(self):
+        data = self.column(CHANNEL)
+        channels = []
+        for i in range(0, len(data) - 1, 2):
+            channels.extend([data[i]] * data[i + 1])
+        return channels
+
+    def device_indices(self):
+        return list(varints(self.column(DEVICE_COLUMN)))
+
+    def dictionary(self):
+        data = self.column(DICTIONARY)
+        return [DEVICE.unpack_from(data, i * DEVICE.size) for i in range(self.devices)]
+
+    def rssi(self, devices):
+        data = self.column(RSSI)
+        last = {}
+        values, i = [], 0
+        while i < len(data):
+            byte = data[i]
+            i += 1
+            if byte & RSSI_RUN:
+                for _ in range((byte & 0x7F) + 1):
+                    values.append(last.get(devices[len(values)], 0))
+                continue
+            device = devices[len(values)]
+            if byte == RSSI_ESCAPE:
+                value = struct.unpack("<b", data[i:i + 1])[0]
+                i += 1
+            else:
+                value = last.get(device, 0) + unzigzag(byte)
+            last[device] = value
+            values.append(value)
+        return values
+
+
+def query(segment, boot, start, end, channels, kinds):
+    """Yield (time_ms, mac, kind, channel, rssi) rows of a segment that match."""
+    if boot is not None and segment.boot != boot:
+        return
+    if segment.last_ms < start or segment.first_ms > end:
+        return
+    if channels and not segment.channel_mask & sum(1 << (c % 16) for c in channels):
+        return
+    if kinds and not segment.kind_mask & sum(1 << k for k in kinds):
+        return
+    times = segment.times()
+    row_channels = segment.channels()
+    selected = [r for r in range(segment.rows)
+                if start <= times[r] <= end and (not channels or row_channels[r] in channels)]
+    if not selected:
+        return
+    dictionary = segment.dictionary()
+    devices = segment.device_indices()
+    rssi = segment.rssi(devices)
+    for r in selected:
+        mac, kind = dictionary[devices[r]]
+        if kinds and kind not in kinds:
+            continue
+        yield times[r], mac, kind, row_channels[r], rssi[r]
+
+
+def main(argv):
+    options = {"--boot": None, "--from": None, "--to": None, "--channel": [], "--kind": []}
+    flags = set()
+    paths = []
+    args = iter(argv)
+    for arg in args:
+        if arg in ("--csv", "--stats"):
+            flags.add(arg)
+        elif arg in ("--channel", "--kind"):
+            options[arg].append(next(args))
+        elif arg in options:
+            options[arg] = next(args)
+        else:
+            paths.append(arg)
+    if not paths:
+        sys.exit(__doc__)
+    boot = int(options["--boot"]) if options["--boot"] else None
+    start = parse_time(options["--from"]) if options["--from"] else 0
+    end = parse_time(options["--to"]) if options["--to"] else 0xFFFFFFFF
+    channels = {int(c) for c in options["--channel"]}
+    kinds = {KINDS.index(k) for k in options["--kind"]}
+
+    if "--csv" in flags:
+        print("boot,time_ms,mac,kind,channel,rssi")
+    rows = read = files = 0
+    for path in paths:
+        try:
+            segment = Segment(path)
+            for time_ms, mac, kind, channel, rssi in query(segment, boot, start, end, channels, kinds):
+                rows += 1
+                mac_text = ":".join("%02x" % b for b in mac)
+                kind_text = KINDS[kind] if kind < len(KINDS) else kind
+                if "--csv" in flags:
+                    print("%d,%d,%s,%s,%d,%d" % (segment.boot, time_ms, mac_text, kind_text, channel, rssi))
+                elif "--stats" not in flags:
+                    print("boot %d %10d ms  %s  %-4s ch %2d  %4d dBm" %
+                          (segment.boot, time_ms, mac_text, kind_text, channel, rssi))
+        except (OSError, ValueError, IndexError) as error:
+            print("%s: %s - skipped" % (path, error), file=sys.stderr)
+            continue
+        files += 1
+        read += segment.bytes_read
+        if "--stats" in flags:
+            print("%s: boot %d, %d-%d ms, %d rows of %d devices, RSSI %d..%d, channels %s, %d B read" %
+                  (path, segment.boot, segment.first_ms, segment.last_ms, segment.rows, segment.devices,
+                   segment.rssi_min, segment.rssi_max,
+                   ",".join(str(c) for c in range(16) if segment.channel_mask & (1 << c)),
+                   segment.bytes_read))
+    print("%d rows from %d segments, %d bytes read" % (rows, files, read), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
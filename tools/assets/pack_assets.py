@@ -0,0 +1,118 @@
+"""
+Pack read-only assets into an image of the HydraESP asset partition.
+
+The unit maps the partition into its address space (src/asset_store.cpp)
+and uses each asset where it lies: a model through tflite::GetModel(),
+an image as an lv_img_dsc_t, neither copied to the heap.
+
+    python3 tools/assets/pack_assets.py -o assets.bin models/ai_model.tflite face.bin
+    python3 tools/assets/pack_assets.py -o assets.bin --web web models/ai_model.tflite
+    make assets-upload ASSETS="models/ai_model.tflite" WEB=web
+
+An asset is named after its file. The type comes from the extension:
+.tflite is a model, .bin an image in LVGL's binary format (the
+lv_img_header_t word, then the pixels, as LVGL's image converter writes
+it), anything else a blob. NAME=PATH names an asset explicitly.
+
+Every file under --web DIR becomes a dashboard asset named by its path
+below DIR, gzip-compressed here so the unit serves the bytes as they are
+with Content-Encoding: gzip; the stored CRC-32 doubles as the ETag.
+"""
+
+import argparse
+import gzip
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = 0x54534148              # ASSET_MAGIC
+FORMAT = 1                      # ASSET_FORMAT
+NAME_BYTES = 24                 # ASSET_NAME_BYTES
+ALIGN = 16                      # ASSET_ALIGN
+MAX_ENTRIES = 32                # ASSET_MAX_ENTRIES
+PARTITION_BYTES = 0xF0000       # assets in partitions.csv
+HEADER = struct.Struct("<IHHII")            # asset_header_t
+ENTRY = struct.Struct("<%dsIIIHH" % NAME_BYTES)  # asset_entry_t
+
+TYPES = {".tflite": 1, ".bin": 2}           # asset_type_t, blob (0) otherwise
+WEB = 3                                     # ASSET_TYPE_WEB
+MIMES = {".html": 1, ".htm": 1, ".css": 2, ".js": 3, ".json": 4,
+         ".svg": 5, ".png": 6, ".ico": 7}   # asset_mime_t, other (0) otherwise
+
+
+def parse(spec):
+    """Name and path of one NAME=PATH or PATH argument."""
+    name, sep, path = spec.partition("=")
+    if not sep:
+        path, name = spec, os.path.basename(spec)
+    if len(name.encode()) >= NAME_BYTES:
+        sys.exit("asset name too long (%d bytes at most): %s" % (NAME_BYTES - 1, name))
+    return name, path
+
+
+def web_specs(root):
+    """Name and path of every file below a dashboard directory."""
+    specs = []
+    for directory, _, files in sorted(os.walk(root)):
+        for file in sorted(files):
+            path = os.path.join(directory, file)
+            name = os.path.relpath(path, root).replace(os.sep, "/")
+            if len(name.encode()) >= NAME_BYTES:
+                sys.exit("asset name too long (%d bytes at most): %s" % (NAME_BYTES - 1, name))
+            specs.append((name, path))
+    return specs
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("-o", "--output", default="assets.bin")
+    parser.add_argument("--web", metavar="DIR", help="dashboard files, served gzip-compressed")
+    parser.add_argument("assets", nargs="*", metavar="[NAME=]PATH")
+    args = parser.parse_args()
+
+    specs = [parse(spec) for spec in args.assets]
+    web = web_specs(args.web) if args.web else []
+    specs += web
+    if not specs:
+        sys.exit("nothing to pack")
+    if len(specs) > MAX_ENTRIES:
+        sys.exit("%d assets, the table holds %d" % (len(specs), MAX_ENTRIES))
+    if len({name for name, _ in specs}) != len(specs):
+        sys.exit("asset names must be unique")
+
+    offset = HEADER.size + ENTRY.size * len(specs)
+    entries = []
+    blobs = []
+    for name, path in specs:
+        with open(path, "rb") as f:
+            data = f.read()
+        offset = (offset + ALIGN - 1) // ALIGN * ALIGN
+        extension = os.path.splitext(path)[1].lower()
+        kind, mime = TYPES.get(extension, 0), 0
+        if (name, path) in web:
+            # mtime=0: the same file always packs to the same bytes, and ETag
+            kind, mime = WEB, MIMES.get(extension, 0)
+            data = gzip.compress(data, 9, mtime=0)
+        entries.append(ENTRY.pack(name.encode(), offset, len(data), zlib.crc32(data), kind, mime))
+        blobs.append((offset, data))
+        offset += len(data)
+    if offset > PARTITION_BYTES:
+        sys.exit("%d bytes of assets, the partition holds %d" % (offset, PARTITION_BYTES))
+
+    toc = b"".join(entries)
+    image = bytearray(b"\xff" * offset)     # Erased flash between assets
+    image[:HEADER.size] = HEADER.pack(MAGIC, FORMAT, len(entries), zlib.crc32(toc), 0)
+    image[HEADER.size:HEADER.size + len(toc)] = toc
+    for start, data in blobs:
+        image[start:start + len(data)] = data
+    with open(args.output, "wb") as f:
+        f.write(image)
+
+    for (name, path), (start, data) in zip(specs, blobs):
+        print("%-24s %7d B at 0x%06x" % (name, len(data), start))
+    print("%s: %d assets, %d of %d KB" % (args.output, len(specs), offset // 1024, PARTITION_BYTES // 1024))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,222 @@
+"""
+Record a HydraESP benchmark report and compare it with an earlier one.
+
+The env:bench firmware prints its report on the console at boot, one
+"BENCH {...}" line per case between BENCH_BEGIN and BENCH_END:
+
+    make bench                                  # flash, record bench/<commit>.json, compare
+    make bench-baseline                         # ...and record it as bench/baseline.json
+    make bench-compare REPORT=bench/1a2b3c4.json    # a recorded report, no unit needed
+    make bench-host                             # the host bench (env:native), no unit needed
+    python3 tools/bench/bench_report.py --log console.txt --baseline bench/1a2b3c4.json
+
+Reading the unit's port needs pyserial (pip install pyserial); --log
+reads a saved console capture instead. The report is named after the
+checked-out commit, with "-dirty" for uncommitted changes, and holds the
+header the firmware printed and every case keyed by suite and name.
+`program --bench --report` prints the same report for the host build,
+with "target": "host" in its header; its file name ends in "-host".
+A host entry only says something on the machine that recorded it: re-record
+it with make bench-host-baseline before comparing on another.
+
+Reports are written with sorted keys and a "format" number, so the
+checked-in bench/baseline.json diffs line by line in review. It holds
+one report per target, "unit" for the firmware and "host", and a report
+is only compared with the baseline of its own target. It is the baseline
+unless --baseline names another, and --update-baseline replaces the
+entry of this report's target with this report.
+
+Compared with a baseline, each case's median is printed with its change;
+a change beyond the case's noise threshold is flagged, and for
+throughput the sign is reversed, since more is better there. Thresholds
+come from tools/bench/noise.json, first matching pattern wins: the
+display and card cases share the bus and the panel and move more from
+run to run than the CPU-bound ones, and a host shares its cores with
+everything else it runs. A change smaller than the pattern's
+"min" in the case's own unit is never flagged, so a 40 ns case does not
+fail on one cache miss. Reports of a different BENCH_REPORT_VERSION do
+not measure the same things and are refused.
+"""
+
+import argparse
+import fnmatch
+import json
+import os
+import subprocess
+import sys
+import time
+
+PREFIX = "BENCH "
+BEGIN = "BENCH_BEGIN "
+END = "BENCH_END "
+HIGHER_IS_BETTER = {"kbps"}
+FORMAT = 1                              # Of the saved file; bump when its layout changes
+
+
+def console_lines(args):
+    """Lines of the saved log, or of the port until the report ends."""
+    if args.log == "-":
+        yield from sys.stdin
+        return
+    if args.log:
+        with open(args.log, errors="replace") as f:
+            yield from f
+        return
+    try:
+        import serial
+    except ImportError:
+        sys.exit("reading the port needs pyserial: pip install pyserial")
+    deadline = time.time() + args.timeout
+    with serial.Serial(args.port, args.baud, timeout=1) as port:
+        while time.time() < deadline:
+            line = port.readline().decode(errors="replace")
+            if line:
+                yield line
+
+
+def read_report(lines):
+    """Header, cases and footer of the first complete report."""
+    header = footer = None
+    cases = {}
+    for line in lines:
+        line = line.strip()
+        if line.startswith(BEGIN):
+            header, cases = json.loads(line[len(BEGIN):]), {}
+        elif line.startswith(PREFIX) and header is not None:
+            case = json.loads(line[len(PREFIX):])
+            cases["%s/%s" % (case.pop("suite"), case.pop("case"))] = case
+        elif line.startswith(END) and header is not None:
+            footer = json.loads(line[len(END):])
+            break
+    if footer is None:
+        sys.exit("no complete BENCH_BEGIN .. BENCH_END report found")
+    return {"header": header, "footer": footer, "cases": cases}
+
+
+def commit():
+    try:
+        rev = subprocess.check_output(["git", "rev-parse", "--short", "HEAD"], text=True,
+                                      stderr=subprocess.DEVNULL).strip()
+        dirty = subprocess.call(["git", "diff", "--quiet", "HEAD"], stderr=subprocess.DEVNULL) != 0
+        return rev + ("-dirty" if dirty else "")
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def target(report):
+    """What ran the report; firmware headers do not name one."""
+    return report["header"].get("target", "unit")
+
+
+def load_baseline(path):
+    """Baseline reports by target."""
+    baseline = load_report(path)
+    if "targets" in baseline:
+        return baseline["targets"]
+    return {target(baseline): baseline}      # A single report given with --baseline
+
+
+def load_report(path):
+    with open(path) as f:
+        report = json.load(f)
+    if report.get("format", FORMAT) != FORMAT:
+        sys.exit("%s is file format %s, this tool reads %d" % (path, report.get("format"), FORMAT))
+    return report
+
+
+def save_report(report, path):
+    with open(path, "w") as f:
+        json.dump(report, f, indent=1, sort_keys=True)
+        f.write("\n")
+
+
+def noise_for(key, rules, threshold):
+    """Percent and absolute change a case must exceed to be flagged."""
+    for pattern, rule in rules.items():
+        if fnmatch.fnmatch(key, pattern):
+            return rule.get("percent", threshold), rule.get("min", 0)
+    return threshold, 0
+
+
+def compare(report, baseline, noise, threshold):
+    if baseline["header"].get("report") != report["header"].get("report"):
+        sys.exit("baseline is report version %s, this is %s: not comparable" %
+                 (baseline["header"].get("report"), report["header"].get("report")))
+    regressions = 0
+    print("baseline %s, now %s" % (baseline.get("commit", "?"), report.get("commit", "?")))
+    print("%-32s %12s %12s %8s %7s" % ("case", "baseline", "now", "change", "noise"))
+    for key, case in sorted(report["cases"].items()):
+        old = baseline["cases"].get(key)
+        if "skipped" in case or old is None or "skipped" in old:
+            reason = case.get("skipped") or ("new" if old is None else old.get("skipped"))
+            print("%-32s %12s %12s %8s %7s  %s" % (key, "-", "-", "-", "-", reason))
+            continue
+        rules = noise.get("cases" if target(report) == "unit" else target(report), {})
+        percent, least = noise_for(key, rules, threshold)
+        delta = case["p50"] - old["p50"]
+        change = 100.0 * delta / old["p50"] if old["p50"] else 0.0
+        worse = -change if case["unit"] in HIGHER_IS_BETTER else change
+        flag = ""
+        if abs(delta) >= least and worse > percent:
+            flag = "  slower"
+            regressions += 1
+        elif abs(delta) >= least and worse < -percent:
+            flag = "  faster"
+        print("%-32s %10d%-2s %10d%-2s %+7.1f%% %6.0f%%%s" %
+              (key, old["p50"], case["unit"][:2], case["p50"], case["unit"][:2], change, percent, flag))
+    for key in sorted(set(baseline["cases"]) - set(report["cases"])):
+        print("%-32s %12s %12s %8s %7s  gone" % (key, "-", "-", "-", "-"))
+    if regressions:
+        print("%d case(s) slower than the baseline beyond their noise" % regressions)
+    return regressions
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(sys.argv[0]))
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("--port", default="/dev/ttyUSB0")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=int, default=180, help="seconds to wait for the report")
+    parser.add_argument("--log", help="saved console output instead of the port")
+    parser.add_argument("--report", help="recorded report to compare, instead of reading one")
+    parser.add_argument("--out", default="bench", help="directory for the report")
+    parser.add_argument("--baseline", help="report to compare with (default <out>/baseline.json)")
+    parser.add_argument("--update-baseline", action="store_true", help="record this report as the baseline")
+    parser.add_argument("--noise", default=os.path.join(here, "noise.json"))
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percent change flagged for cases noise.json does not match")
+    args = parser.parse_args()
+
+    if args.report:
+        report = load_report(args.report)
+    else:
+        report = read_report(console_lines(args))
+        report["commit"] = commit()
+        report["format"] = FORMAT
+        os.makedirs(args.out, exist_ok=True)
+        suffix = "" if target(report) == "unit" else "-" + target(report)
+        path = os.path.join(args.out, report["commit"] + suffix + ".json")
+        save_report(report, path)
+        print("%s: %d cases in %.1f s" % (path, len(report["cases"]), report["footer"]["ms"] / 1000.0))
+
+    baseline_path = args.baseline or os.path.join(args.out, "baseline.json")
+    baselines = load_baseline(baseline_path) if os.path.exists(baseline_path) else {}
+    regressions = 0
+    if target(report) in baselines:
+        noise = {}
+        if os.path.exists(args.noise):
+            with open(args.noise) as f:
+                noise = json.load(f)
+        regressions = compare(report, baselines[target(report)], noise, args.threshold)
+    elif not args.update_baseline:
+        print("no %s baseline: record one with make %s" %
+              (target(report), "bench-baseline" if target(report) == "unit" else "bench-host-baseline"))
+    if args.update_baseline:
+        baselines[target(report)] = report
+        save_report({"format": FORMAT, "targets": baselines}, baseline_path)
+        print("wrote the %s baseline to %s" % (target(report), baseline_path))
+    sys.exit(1 if regressions > 0 and not args.update_baseline else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,102 @@
+"""
+Rebuild a HydraESP crash's core dump and event trace.
+
+From a unit still up after the crash, over HTTP:
+
+    python3 tools/crash/crash_fetch.py --http <device-ip>
+
+or from the MQTT chunks, captured raw with the payloads run together:
+
+    mosquitto_sub -h <broker> -t 'hydraesp/<mac>/crash' -N > crash.bin
+    python3 tools/crash/crash_fetch.py crash.bin
+
+Writes core.bin and crash.hev into the current directory (with the crash
+id in the name, for a capture holding several crashes). Decode the first
+with ESP-IDF's espcoredump.py against the firmware's ELF, the second with
+tools/trace/trace_to_perfetto.py.
+"""
+
+import struct
+import sys
+import urllib.error
+import urllib.request
+
+MAGIC = 0x53524348      # CRASH_CHUNK_MAGIC
+FORMAT = 1              # CRASH_CHUNK_FORMAT
+HEADER = struct.Struct("<IBBHIII")      # crash_chunk_header_t
+PARTS = ["trace", "core"]               # crash_part_t
+NAMES = {"trace": "crash.hev", "core": "core.bin"}
+
+
+def fetch_http(host):
+    """Both parts as the unit serves them; a missing part is skipped."""
+    parts = {}
+    for part in PARTS:
+        try:
+            with urllib.request.urlopen("http://%s/crash?part=%s" % (host, part), timeout=30) as r:
+                parts[part] = r.read()
+        except urllib.error.HTTPError as e:
+            if e.code != 404:
+                raise
+    return {None: parts}
+
+
+def split_capture(data):
+    """Reassemble every crash in a capture of run-together chunk messages."""
+    crashes = {}
+    offset = 0
+    while offset + HEADER.size <= len(data):
+        magic, part, fmt, length, crash_id, at, total = HEADER.unpack_from(data, offset)
+        if magic != MAGIC:
+            offset += 1         # Resynchronise past anything that is not a chunk
+            continue
+        if fmt != FORMAT or part >= len(PARTS):
+            sys.exit("chunk format %d at byte %d, %d expected" % (fmt, offset, FORMAT))
+        body = data[offset + HEADER.size:offset + HEADER.size + length]
+        offset += HEADER.size + length
+
+        # A redelivered chunk lands on the same bytes again
+        buf = crashes.setdefault(crash_id, {}).setdefault(PARTS[part], [bytearray(total), set()])
+        buf[0][at:at + len(body)] = body
+        buf[1].update(range(at, at + len(body)))
+
+    parts = {}
+    for crash_id, found in crashes.items():
+        parts[crash_id] = {}
+        for part, (data, have) in found.items():
+            if len(have) < len(data):
+                sys.stderr.write("crash %08x: %s incomplete, %d of %d bytes\n"
+                                 % (crash_id, part, len(have), len(data)))
+                continue
+            parts[crash_id][part] = bytes(data)
+    return parts
+
+
+def main():
+    args = sys.argv[1:]
+    if len(args) == 2 and args[0] == "--http":
+        crashes = fetch_http(args[1])
+    elif len(args) == 1:
+        with open(args[0], "rb") as f:
+            crashes = split_capture(f.read())
+    else:
+        sys.exit("usage: crash_fetch.py --http <device-ip> | <capture.bin>")
+
+    written = 0
+    for crash_id, parts in crashes.items():
+        for part, data in parts.items():
+            name = NAMES[part]
+            if crash_id is not None and len(crashes) > 1:
+                name = "%08x-%s" % (crash_id, name)
+            with open(name, "wb") as f:
+                f.write(data)
+            sys.stderr.write("%s: %d bytes\n" % (name, len(data)))
+            written += 1
+    if written == 0:
+        sys.exit("no complete crash part found")
+    sys.stderr.write("decode the core with: espcoredump.py info_corefile -t raw -c core.bin "
+                     ".pio/build/<env>/firmware.elf\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,208 @@
+"""
+Prerender the Ponagotchi face for every AI state into LVGL images.
+
+Each state gets a row of eyelid frames, from open to shut, rasterized once and
+stored in flash as 2-bit indexed LV_IMG_CF_INDEXED_2BIT images (palette:
+background, eyes, mouth). The UI then swaps whole frames with
+lv_img_set_src() instead of resizing and restyling rounded objects.
+
+Each state also gets a small open-eyed icon of the same face for the status
+bar, in place of the emoji the fonts do not carry.
+
+Runs as a PlatformIO pre-build script and on its own:
+
+    python3 tools/face_atlas/gen_face_atlas.py
+
+The output is src/generated/face_atlas.c, rewritten only when this script
+is newer.
+"""
+
+import os
+import sys
+
+WIDTH = 200         # FACE_ATLAS_WIDTH
+HEIGHT = 150        # FACE_ATLAS_HEIGHT
+
+# Centres in the 200x150 face, matching the old lv_obj layout
+LEFT_EYE = (65, 55)
+RIGHT_EYE = (135, 55)
+MOUTH = (100, 100)
+EYE_RADIUS = 15
+MOUTH_RADIUS = 10
+BLINK_EYE_HEIGHT = 4
+
+ICON_WIDTH = 24     # FACE_ICON_WIDTH
+ICON_HEIGHT = 18    # FACE_ICON_HEIGHT
+ICON_SAMPLES = 4    # Per icon pixel and axis
+ICON_CROP = (28, 22, 144, 108)  # Part of the face shrunk into it: x, y, w, h
+
+# In ai_state_t order: (name, eye w, eye h, mouth w, mouth h, mouth colour)
+FACES = [
+    ("idle",     30, 30, 40, 15, 0xFFFFFF),
+    ("sniffing", 35, 35, 30, 10, 0xFFFF00),
+    ("tracking", 35, 25, 40, 10, 0x00FFFF),
+    ("learning", 25, 15, 35, 12, 0xFF8800),
+    ("excited",  40, 40, 70, 25, 0x00FF00),
+    ("sleeping", 30,  5, 25,  8, 0x8888FF),
+    ("error",    20, 20, 50,  8, 0xFF0000),
+    ("updating", 30, 30, 20, 20, 0x0088FF),
+]
+
+BACKGROUND = 0x000000
+EYE_COLOUR = 0xFFFFFF
+# Eyelid closure steps, FACE_ATLAS_FRAMES of them; the last one is shut
+FRAMES = ("open", "lid1", "lid2", "shut")
+
+
+def inside_rounded_rect(px, py, cx, cy, w, h, radius):
+    """Point (px, py) lies in the rounded rectangle centred on (cx, cy)."""
+    r = min(radius, w / 2.0, h / 2.0)
+    left, right = cx - w / 2.0, cx + w / 2.0
+    top, bottom = cy - h / 2.0, cy + h / 2.0
+    if px < left or px >= right or py < top or py >= bottom:
+        return False
+    # Distance into the corner region, if any
+    dx = max(left + r - px, px - (right - r), 0.0)
+    dy = max(top + r - py, py - (bottom - r), 0.0)
+    return dx * dx + dy * dy <= r * r
+
+
+def classify(face, eye_h, px, py):
+    """Palette index at a point of the 200x150 face: 0 background, 1 eyes, 2 mouth."""
+    _, eye_w, _, mouth_w, mouth_h, _ = face
+    if (inside_rounded_rect(px, py, LEFT_EYE[0], LEFT_EYE[1], eye_w, eye_h, EYE_RADIUS) or
+            inside_rounded_rect(px, py, RIGHT_EYE[0], RIGHT_EYE[1], eye_w, eye_h, EYE_RADIUS)):
+        return 1
+    if inside_rounded_rect(px, py, MOUTH[0], MOUTH[1], mouth_w, mouth_h, MOUTH_RADIUS):
+        return 2
+    return 0
+
+
+def render(face, step):
+    """Palette indices, row-major, sampled at pixel centres."""
+    eye_h = face[2]
+    if eye_h > BLINK_EYE_HEIGHT:
+        eye_h -= (eye_h - BLINK_EYE_HEIGHT) * step / (len(FRAMES) - 1.0)
+    return [[classify(face, eye_h, x + 0.5, y + 0.5) for x in range(WIDTH)] for y in range(HEIGHT)]
+
+
+def render_icon(face):
+    """The open face, cropped to ICON_CROP, shrunk to ICON_WIDTH x ICON_HEIGHT.
+
+    Features are a few icon pixels across, so each pixel takes the
+    foreground index covering at least a quarter of its samples rather than
+    the majority, which would erase the thinner mouths and sleeping eyes.
+    """
+    left, top, w, h = ICON_CROP
+    sx, sy = w / float(ICON_WIDTH), h / float(ICON_HEIGHT)
+    threshold = ICON_SAMPLES * ICON_SAMPLES // 4
+    pixels = []
+    for y in range(ICON_HEIGHT):
+        row = []
+        for x in range(ICON_WIDTH):
+            counts = [0, 0, 0]
+            for j in range(ICON_SAMPLES):
+                for i in range(ICON_SAMPLES):
+                    px = left + (x + (i + 0.5) / ICON_SAMPLES) * sx
+                    py = top + (y + (j + 0.5) / ICON_SAMPLES) * sy
+                    counts[classify(face, face[2], px, py)] += 1
+            best = 1 if counts[1] >= counts[2] else 2
+            row.append(best if counts[best] >= threshold else 0)
+        pixels.append(row)
+    return pixels
+
+
+def palette_bytes(colours):
+    """lv_color32_t entries: blue, green, red, alpha."""
+    out = []
+    for rgb in colours:
+        out += [rgb & 0xFF, (rgb >> 8) & 0xFF, (rgb >> 16) & 0xFF, 0xFF]
+    return out
+
+
+def pack_2bit(pixels):
+    """Four pixels per byte, leftmost in the top bits, rows byte-aligned."""
+    out = []
+    for row in pixels:
+        for i in range(0, len(row), 4):
+            chunk = row[i:i + 4] + [0] * (4 - len(row[i:i + 4]))
+            out.append(chunk[0] << 6 | chunk[1] << 4 | chunk[2] << 2 | chunk[3])
+    return out
+
+
+def image_lines(name, data, width, height):
+    """A static lv_img_dsc_t over a 2-bit indexed map."""
+    lines = ["static const uint8_t %s_map[] = {" % name]
+    for i in range(0, len(data), 20):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 20]) + ",")
+    lines += [
+        "};",
+        "",
+        "static const lv_img_dsc_t %s = {" % name,
+        "    .header.cf = LV_IMG_CF_INDEXED_2BIT,",
+        "    .header.always_zero = 0,",
+        "    .header.reserved = 0,",
+        "    .header.w = %d," % width,
+        "    .header.h = %d," % height,
+        "    .data_size = sizeof(%s_map)," % name,
+        "    .data = %s_map," % name,
+        "};",
+        "",
+    ]
+    return lines
+
+
+def emit(path):
+    lines = [
+        "/**",
+        " * @file face_atlas.c",
+        " * @brief Generated by tools/face_atlas/gen_face_atlas.py - do not edit",
+        " */",
+        "",
+        "#include <lvgl.h>",
+        "#include \"face_atlas.h\"",
+        "",
+    ]
+    names = []
+    for face in FACES:
+        colours = [BACKGROUND, EYE_COLOUR, face[5], BACKGROUND]
+        for step, frame in enumerate(FRAMES):
+            name = "face_%s_%s" % (face[0], frame)
+            data = palette_bytes(colours) + pack_2bit(render(face, step))
+            lines += image_lines(name, data, WIDTH, HEIGHT)
+            names.append(name)
+        data = palette_bytes(colours) + pack_2bit(render_icon(face))
+        lines += image_lines("face_%s_icon" % face[0], data, ICON_WIDTH, ICON_HEIGHT)
+
+    lines.append("const lv_img_dsc_t* const face_atlas[FACE_ATLAS_STATES][FACE_ATLAS_FRAMES] = {")
+    for i in range(0, len(names), len(FRAMES)):
+        lines.append("    { " + ", ".join("&" + n for n in names[i:i + len(FRAMES)]) + " },")
+    lines += [
+        "};",
+        "",
+        "const lv_img_dsc_t* const face_icons[FACE_ATLAS_STATES] = {",
+    ]
+    lines += ["    &face_%s_icon," % face[0] for face in FACES]
+    lines += ["};", ""]
+
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "w") as out:
+        out.write("\n".join(lines))
+
+
+def generate(project_dir, script_path):
+    output = os.path.join(project_dir, "src", "generated", "face_atlas.c")
+    if os.path.exists(output) and os.path.getmtime(output) >= os.path.getmtime(script_path):
+        return
+    emit(output)
+    print("Generated %s (%d faces x %d frames, plus icons)" % (output, len(FACES), len(FRAMES)))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO's SCons
+    project = env.subst("$PROJECT_DIR")  # noqa: F821
+    generate(project, os.path.join(project, "tools", "face_atlas", "gen_face_atlas.py"))
+except NameError:
+    if __name__ == "__main__":
+        here = os.path.abspath(sys.argv[0])
+        generate(os.path.dirname(os.path.dirname(os.path.dirname(here))), here)
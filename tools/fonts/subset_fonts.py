@@ -0,0 +1,262 @@
+"""
+Subset LVGL's built-in Montserrat fonts to the glyphs the UI draws.
+
+LVGL's lv_font_montserrat_*.c carry printable ASCII plus the degree sign,
+the bullet and about sixty FontAwesome symbols, more than half the bitmap
+bytes. The firmware only prints ASCII (state names, counters, MACs), and
+the state emoji are images from the face atlas, so the rest is dead flash.
+This script keeps the codepoints in CHARSET, renumbers the glyphs, trims
+the kerning class maps to match and, since what remains is one contiguous
+range, leaves a single FORMAT0 cmap: a codepoint's glyph id is one
+subtraction, with no sparse-list search.
+
+Runs as a PlatformIO pre-build script and on its own:
+
+    python3 tools/fonts/subset_fonts.py [path/to/lvgl/src/font]
+
+The output is src/generated/ui_fonts.c (fonts ui_font_12 and ui_font_14,
+see include/ui_fonts.h), rewritten only when this script is newer. The
+LVGL copies are switched off in platformio.ini so they are not linked.
+"""
+
+import os
+import re
+import sys
+
+# Point sizes to emit, as ui_font_<size>
+SIZES = (12, 14)
+
+# Printable ASCII; extend here if a label ever needs more
+CHARSET = list(range(0x20, 0x7F))
+
+
+def c_array(source, name):
+    """Body of `<type> name[] = { ... };` with comments stripped."""
+    match = re.search(r"\b%s\[\]\s*=\s*\{(.*?)\};" % re.escape(name), source, re.S)
+    if match is None:
+        raise ValueError("array %s not found" % name)
+    return re.sub(r"/\*.*?\*/", "", match.group(1), flags=re.S)
+
+
+def c_numbers(body):
+    return [int(tok, 0) for tok in re.findall(r"-?(?:0x[0-9a-fA-F]+|\d+)", body)]
+
+
+def c_field(source, name):
+    match = re.search(r"\.%s\s*=\s*(-?\d+)" % re.escape(name), source)
+    if match is None:
+        raise ValueError("field .%s not found" % name)
+    return int(match.group(1))
+
+
+def parse(path):
+    with open(path) as f:
+        source = f.read()
+
+    if c_field(source, "bitmap_format") != 0:
+        raise ValueError("%s: compressed fonts are not supported" % path)
+
+    bitmap = c_numbers(c_array(source, "glyph_bitmap"))
+    glyphs = [tuple(int(v) for v in m) for m in re.findall(
+        r"\{\.bitmap_index = (\d+), \.adv_w = (\d+), \.box_w = (\d+), \.box_h = (\d+), "
+        r"\.ofs_x = (-?\d+), \.ofs_y = (-?\d+)\}", source)]
+
+    # Codepoint -> glyph id over every cmap
+    glyph_of = {}
+    for m in re.finditer(
+            r"\.range_start = (\d+), \.range_length = (\d+), \.glyph_id_start = (\d+),\s*"
+            r"\.unicode_list = (\w+), \.glyph_id_ofs_list = (\w+), \.list_length = (\d+), "
+            r"\.type = (\w+)", source):
+        start, length, first_id = int(m.group(1)), int(m.group(2)), int(m.group(3))
+        kind = m.group(7)
+        if kind == "LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY":
+            for i in range(length):
+                glyph_of[start + i] = first_id + i
+        elif kind == "LV_FONT_FMT_TXT_CMAP_SPARSE_TINY":
+            for i, ofs in enumerate(c_numbers(c_array(source, m.group(4)))):
+                glyph_of[start + ofs] = first_id + i
+        else:
+            raise ValueError("%s: cmap type %s is not supported" % (path, kind))
+
+    font = {
+        "bitmap": bitmap,
+        "glyphs": glyphs,
+        "glyph_of": glyph_of,
+        "bpp": c_field(source, "bpp"),
+        "line_height": c_field(source, "line_height"),
+        "base_line": c_field(source, "base_line"),
+        "underline_position": c_field(source, "underline_position"),
+        "underline_thickness": c_field(source, "underline_thickness"),
+        "kern": None,
+    }
+    if c_field(source, "kern_classes") == 1:
+        font["kern"] = {
+            "left": c_numbers(c_array(source, "kern_left_class_mapping")),
+            "right": c_numbers(c_array(source, "kern_right_class_mapping")),
+            "values": c_numbers(c_array(source, "kern_class_values")),
+            "left_cnt": c_field(source, "left_class_cnt"),
+            "right_cnt": c_field(source, "right_class_cnt"),
+            "scale": c_field(source, "kern_scale"),
+        }
+    return font
+
+
+def subset(font, charset):
+    """Keep the glyphs of charset, renumbered from 1 in codepoint order."""
+    bitmap, glyphs = font["bitmap"], font["glyphs"]
+    kept = [cp for cp in sorted(set(charset)) if cp in font["glyph_of"]]
+    missing = sorted(set(charset) - set(kept))
+    if missing:
+        raise ValueError("codepoints not in the font: %s" % ", ".join("U+%04X" % cp for cp in missing))
+
+    old_ids = [0] + [font["glyph_of"][cp] for cp in kept]
+    new_bitmap, new_glyphs = [], [(0, 0, 0, 0, 0, 0)]
+    for old in old_ids[1:]:
+        start = glyphs[old][0]
+        end = glyphs[old + 1][0] if old + 1 < len(glyphs) else len(bitmap)
+        new_glyphs.append((len(new_bitmap),) + glyphs[old][1:])
+        new_bitmap += bitmap[start:end]
+
+    # Contiguous runs of codepoints become FORMAT0 cmaps
+    cmaps = []
+    for i, cp in enumerate(kept):
+        if cmaps and cmaps[-1][0] + cmaps[-1][1] == cp:
+            cmaps[-1][1] += 1
+        else:
+            cmaps.append([cp, 1, i + 1])
+
+    kern = font["kern"]
+    if kern is not None:
+        kern = dict(kern)
+        kern["left"] = [kern["left"][old] for old in old_ids]
+        kern["right"] = [kern["right"][old] for old in old_ids]
+
+    out = dict(font)
+    out.update(bitmap=new_bitmap, glyphs=new_glyphs, cmaps=cmaps, kern=kern, codepoints=kept)
+    return out
+
+
+def array_lines(values, per_line, fmt):
+    return ["    " + ", ".join(fmt % v for v in values[i:i + per_line]) + ","
+            for i in range(0, len(values), per_line)]
+
+
+def emit_font(name, font):
+    p = name + "_"
+    lines = [
+        "/* %s: %d glyphs, %d bitmap bytes */" % (name, len(font["codepoints"]), len(font["bitmap"])),
+        "static LV_ATTRIBUTE_LARGE_CONST const uint8_t %sbitmap[] = {" % p,
+    ]
+    lines += array_lines(font["bitmap"], 16, "0x%02x")
+    lines += ["};", "", "static const lv_font_fmt_txt_glyph_dsc_t %sglyph_dsc[] = {" % p]
+    for g in font["glyphs"]:
+        lines.append("    {.bitmap_index = %d, .adv_w = %d, .box_w = %d, .box_h = %d, "
+                     ".ofs_x = %d, .ofs_y = %d}," % g)
+    lines += ["};", "", "static const lv_font_fmt_txt_cmap_t %scmaps[] = {" % p]
+    for start, length, first_id in font["cmaps"]:
+        lines.append("    {.range_start = %d, .range_length = %d, .glyph_id_start = %d, "
+                     ".unicode_list = NULL, .glyph_id_ofs_list = NULL, .list_length = 0, "
+                     ".type = LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY}," % (start, length, first_id))
+    lines += ["};", ""]
+
+    kern = font["kern"]
+    if kern is not None:
+        for side in ("left", "right"):
+            lines.append("static const uint8_t %skern_%s[] = {" % (p, side))
+            lines += array_lines(kern[side], 16, "%d")
+            lines += ["};", ""]
+        lines.append("static const int8_t %skern_values[] = {" % p)
+        lines += array_lines(kern["values"], 16, "%d")
+        lines += [
+            "};",
+            "",
+            "static const lv_font_fmt_txt_kern_classes_t %skern_classes = {" % p,
+            "    .class_pair_values = %skern_values," % p,
+            "    .left_class_mapping = %skern_left," % p,
+            "    .right_class_mapping = %skern_right," % p,
+            "    .left_class_cnt = %d," % kern["left_cnt"],
+            "    .right_class_cnt = %d," % kern["right_cnt"],
+            "};",
+            "",
+        ]
+
+    lines += [
+        "static lv_font_fmt_txt_glyph_cache_t %scache;" % p,
+        "",
+        "static const lv_font_fmt_txt_dsc_t %sdsc = {" % p,
+        "    .glyph_bitmap = %sbitmap," % p,
+        "    .glyph_dsc = %sglyph_dsc," % p,
+        "    .cmaps = %scmaps," % p,
+        "    .kern_dsc = %s," % ("&%skern_classes" % p if kern is not None else "NULL"),
+        "    .kern_scale = %d," % (kern["scale"] if kern is not None else 0),
+        "    .cmap_num = %d," % len(font["cmaps"]),
+        "    .bpp = %d," % font["bpp"],
+        "    .kern_classes = %d," % (1 if kern is not None else 0),
+        "    .bitmap_format = 0,",
+        "    .cache = &%scache," % p,
+        "};",
+        "",
+        "const lv_font_t %s = {" % name,
+        "    .get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt,",
+        "    .get_glyph_bitmap = lv_font_get_bitmap_fmt_txt,",
+        "    .line_height = %d," % font["line_height"],
+        "    .base_line = %d," % font["base_line"],
+        "    .subpx = LV_FONT_SUBPX_NONE,",
+        "    .underline_position = %d," % font["underline_position"],
+        "    .underline_thickness = %d," % font["underline_thickness"],
+        "    .dsc = &%sdsc," % p,
+        "};",
+        "",
+    ]
+    return lines
+
+
+def emit(path, fonts):
+    lines = [
+        "/**",
+        " * @file ui_fonts.c",
+        " * @brief Generated by tools/fonts/subset_fonts.py - do not edit",
+        " *",
+        " * Subsets of LVGL's Montserrat Medium, 4 bpp, printable ASCII only.",
+        " */",
+        "",
+        "#include <lvgl.h>",
+        "#include \"ui_fonts.h\"",
+        "",
+    ]
+    for name, font in fonts:
+        lines += emit_font(name, font)
+
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "w") as out:
+        out.write("\n".join(lines))
+
+
+def generate(project_dir, script_path, font_dir):
+    output = os.path.join(project_dir, "src", "generated", "ui_fonts.c")
+    if os.path.exists(output) and os.path.getmtime(output) >= os.path.getmtime(script_path):
+        return
+    fonts = []
+    for size in SIZES:
+        source = os.path.join(font_dir, "lv_font_montserrat_%d.c" % size)
+        if not os.path.exists(source):
+            sys.exit("subset_fonts: %s not found, install the LVGL library first" % source)
+        full = parse(source)
+        fonts.append(("ui_font_%d" % size, subset(full, CHARSET)))
+        print("ui_font_%d: %d -> %d bitmap bytes" % (size, len(full["bitmap"]), len(fonts[-1][1]["bitmap"])))
+    emit(output, fonts)
+    print("Generated %s" % output)
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO's SCons
+    project = env.subst("$PROJECT_DIR")  # noqa: F821
+    lvgl_fonts = os.path.join(env.subst("$PROJECT_LIBDEPS_DIR"), env.subst("$PIOENV"),  # noqa: F821
+                              "lvgl", "src", "font")
+    generate(project, os.path.join(project, "tools", "fonts", "subset_fonts.py"), lvgl_fonts)
+except NameError:
+    if __name__ == "__main__":
+        here = os.path.abspath(sys.argv[0])
+        root = os.path.dirname(os.path.dirname(os.path.dirname(here)))
+        default_fonts = os.path.join(root, ".pio", "libdeps", "esp32-s3-devkitc-1", "lvgl", "src", "font")
+        generate(root, here, sys.argv[1] if len(sys.argv) > 1 else default_fonts)
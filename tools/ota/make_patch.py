@@ -0,0 +1,67 @@
+"""
+Build a HydraESP firmware patch from the image a unit runs to a new one.
+
+    python3 tools/ota/make_patch.py old/firmware.bin .pio/build/esp32-s3-devkitc-1/firmware.bin fw.hdp
+    python3 -m http.server --directory . 8000
+    curl -X POST -d "url=http://<host>:8000/fw.hdp" -d "sha256=<printed>" http://<device-ip>/firmware
+
+The base must be the exact image the unit runs: the unit compares its
+running partition's SHA-256 with the one in the patch before writing
+anything. The differences are computed with bsdiff (pip install bsdiff4)
+and written as one record per bsdiff control triple, each followed by its
+add and copy bytes, so the unit can apply them in a single pass; the
+record stream is deflated with zlib. The server should honour Range
+requests, so a dropped download resumes where it stopped.
+"""
+
+import hashlib
+import struct
+import sys
+import zlib
+
+import bsdiff4.core
+
+MAGIC = 0x31504448              # FIRMWARE_PATCH_MAGIC
+VERSION = 1                     # FIRMWARE_PATCH_VERSION
+HEADER = struct.Struct("<IHHII32s32s")          # firmware_patch_header_t
+CONTROL = struct.Struct("<IIi")
+
+
+def records(base, target):
+    control, diff, extra = bsdiff4.core.diff(base, target)
+    diff_at = extra_at = 0
+    for add, copy, seek in control:
+        yield CONTROL.pack(add, copy, seek)
+        yield diff[diff_at:diff_at + add]
+        yield extra[extra_at:extra_at + copy]
+        diff_at += add
+        extra_at += copy
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit("usage: make_patch.py BASE.bin TARGET.bin OUT.hdp")
+    with open(sys.argv[1], "rb") as f:
+        base = f.read()
+    with open(sys.argv[2], "rb") as f:
+        target = f.read()
+
+    compressor = zlib.compressobj(9)
+    body = b"".join(compressor.compress(part) for part in records(base, target))
+    body += compressor.flush()
+
+    target_sha = hashlib.sha256(target).digest()
+    header = HEADER.pack(MAGIC, VERSION, 0, len(base), len(target),
+                         hashlib.sha256(base).digest(), target_sha)
+    with open(sys.argv[3], "wb") as f:
+        f.write(header)
+        f.write(body)
+
+    size = len(header) + len(body)
+    print("%s: %d bytes, %.1f%% of the %d byte image" %
+          (sys.argv[3], size, 100.0 * size / len(target), len(target)))
+    print("sha256=%s" % target_sha.hex())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,499 @@
+/**
+ * @file host_bench.cpp
+ * @brief Throughput and round-trip checks of the pure-logic paths on a host
+ *
+ *     pio run -e native && .pio/build/native/program --bench [--repeat N] [--report]
+ *
+ * The same sources as the firmware, built for the host: the rule engine,
+ * feature extraction, RSSI histograms, the device table (calloc instead
+ * of PSRAM off ESP_PLATFORM) and the sensor_data_t codecs. Inputs are a
+ * fixed ring of synthetic cycles, so two builds on one machine compare
+ * case by case; an algorithmic regression shows up here before anything
+ * is flashed. Figures are host figures; env:bench gives the unit's.
+ * Each case is timed as BENCH_SAMPLES batches; --report prints the run as
+ * a BENCH report of target "host" instead of the table, in picoseconds
+ * per call, for tools/bench/bench_report.py.
+ *
+ * After the timings, checks with known answers: the rule set on crafted
+ * cycles, the transition filter's dwell and hysteresis, histogram
+ * quantiles, codec round trips and device-table deletion.
+ */
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include "config.h"
+#include "bench.h"
+#include "ai_states.h"
+#include "ai_rules.h"
+#include "ai_transition.h"
+#include "ai_features.h"
+#include "rssi_histogram.h"
+#include "device_table.h"
+#include "sensor_data_codec.h"
+#include "host_bench.h"
+
+#define HOST_BENCH_INPUTS   64          // Ring of synthetic cycles, a power of two
+#define HOST_BENCH_DEVICES  (DEVICE_TABLE_CAPACITY / 2)
+#define HOST_BENCH_CALLS    1000000     // Per case and repeat; the encoders take a tenth
+
+// Case inputs
+static sensor_data_t inputs[HOST_BENCH_INPUTS];
+static scan_histograms_t histograms;
+static ai_feature_vector_t features;
+static uint8_t wire[SENSOR_DATA_CBOR_MAX_BYTES];
+static size_t wire_length = 0;
+static char json[1024];
+static volatile uint32_t sink = 0;          // Keeps results alive past the optimizer
+static uint32_t failures = 0;
+
+// Report
+static bool reporting = false;
+static uint32_t cases = 0;
+static uint32_t samples[BENCH_SAMPLES];
+
+// Forward declarations
+static void fill_inputs(void);
+static bool check_rules(void);
+static bool check_transitions(void);
+static bool check_quantiles(void);
+static bool check_round_trips(void);
+static bool check_device_table(void);
+static bool check_device_delete(void);
+template <typename Fn>
+static void run_case(const char* suite, const char* name, uint64_t calls, Fn fn);
+
+static void make_mac(uint32_t i, uint8_t* mac) {
+    mac[0] = 0x02;                          // Same addresses as the firmware's bench.cpp
+    mac[1] = 0xBE;
+    mac[2] = 0x4C;
+    mac[3] = (uint8_t)(i >> 16);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+/**
+ * @brief Time the pure-logic paths on the host and check their round trips
+ */
+int host_bench_run(uint32_t repeat, bool report) {
+    uint64_t calls = (uint64_t)HOST_BENCH_CALLS * repeat;
+    auto started = std::chrono::steady_clock::now();
+    reporting = report;
+    fill_inputs();
+
+    if (reporting) {
+        printf("BENCH_BEGIN {\"report\":%d,\"target\":\"host\",\"compiler\":\"%s\","
+               "\"repeat\":%u,\"samples\":%d}\n",
+               BENCH_REPORT_VERSION, __VERSION__, repeat, BENCH_SAMPLES);
+    } else {
+        printf("%-20s %12s %10s %14s\n", "case", "calls", "ns/call", "calls/s");
+    }
+    run_case("ai", "rules", calls, [](uint64_t i) {
+        sink += infer_ai_state(&inputs[i % HOST_BENCH_INPUTS]);
+    });
+    run_case("ai", "features", calls, [](uint64_t i) {
+        ai_features_extract(&inputs[i % HOST_BENCH_INPUTS], &histograms, &features);
+        sink += features.scan_cycle;
+    });
+    run_case("hist", "add", calls, [](uint64_t i) {
+        rssi_hist_add(&histograms.ble, (int8_t)(-30 - (i * 37) % 70));
+    });
+    run_case("hist", "quantile", calls, [](uint64_t i) {
+        sink += rssi_hist_quantile(&histograms.wifi_all, (uint8_t)(i % 100));
+    });
+
+    if (!device_table_init(DEVICE_TABLE_CAPACITY)) {
+        printf("devices: table allocation failed\n");
+        return 1;
+    }
+    run_case("devices", "insert", calls, [](uint64_t i) {
+        uint8_t mac[6];
+        make_mac((uint32_t)(i % HOST_BENCH_DEVICES), mac);      // New, then updates
+        sink += device_table_observe(mac, DEVICE_KIND_BLE, -60, 0, 1000, 0) != NULL;
+    });
+    run_case("devices", "lookup", calls, [](uint64_t i) {
+        uint8_t mac[6];
+        make_mac((uint32_t)(i % HOST_BENCH_DEVICES), mac);
+        sink += device_table_find(mac, DEVICE_KIND_BLE) != NULL;
+    });
+    run_case("devices", "miss", calls, [](uint64_t i) {
+        uint8_t mac[6];
+        make_mac(0x800000 | (uint32_t)(i & 0xFFFFF), mac);
+        sink += device_table_find(mac, DEVICE_KIND_BLE) != NULL;
+    });
+
+    run_case("codec", "json", calls / 10, [](uint64_t i) {
+        sink += sensor_data_to_json(&inputs[i % HOST_BENCH_INPUTS], json, sizeof(json));
+    });
+    run_case("codec", "cbor_encode", calls / 10, [](uint64_t i) {
+        sink += sensor_data_to_cbor(&inputs[i % HOST_BENCH_INPUTS], wire, sizeof(wire));
+    });
+    wire_length = sensor_data_to_cbor(&inputs[0], wire, sizeof(wire));
+    run_case("codec", "cbor_decode", calls / 10, [](uint64_t) {
+        sensor_data_t decoded;
+        sink += sensor_data_from_cbor(wire, wire_length, &decoded);
+    });
+    run_case("codec", "packed", calls / 10, [](uint64_t i) {
+        sink += sensor_data_serialize(&inputs[i % HOST_BENCH_INPUTS], wire, sizeof(wire));
+    });
+
+    check_rules();
+    check_transitions();
+    check_quantiles();
+    check_round_trips();
+    check_device_table();
+    check_device_delete();
+    if (reporting) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        printf("BENCH_END {\"cases\":%u,\"ms\":%u}\n", cases, (uint32_t)(elapsed.count() * 1000));
+    }
+    if (failures > 0) {
+        printf("\n%u check(s) failed\n", failures);
+        return 1;
+    }
+    printf("\nAll checks passed\n");
+    return 0;
+}
+
+/**
+ * @brief A spread of cycles, from an empty room to a crowded one
+ */
+static void fill_inputs(void) {
+    for (uint32_t i = 0; i < HOST_BENCH_INPUTS; i++) {
+        sensor_data_t* data = &inputs[i];
+        memset(data, 0, sizeof(*data));
+        data->version = SENSOR_DATA_VERSION;
+        data->scan_cycle = 1000 + i;
+        data->free_memory = 6 * 1024 * 1024 - i * 4096;
+        data->uptime_seconds = 86400 + i * 5;
+        data->wifi_networks_count = (uint8_t)((i * 7) % 60);
+        data->wifi_signal_strength = (int8_t)(-40 - (i * 13) % 55);
+        data->ble_devices_count = (uint8_t)((i * 11) % 90);
+        data->ble_signal_strength = (int8_t)(-50 - (i * 17) % 45);
+        data->novel_devices = (uint8_t)(i % 9);
+        data->novelty_permille = (uint16_t)((i * 97) % 1000);
+        data->sd_card_present = (i & 1) != 0;
+        data->hop_channel = (uint8_t)(1 + i % WIFI_CHANNEL_COUNT);
+        data->busiest_channel = (uint8_t)(1 + (i * 5) % WIFI_CHANNEL_COUNT);
+        data->devices_appeared = (uint8_t)(i % 12);
+        data->devices_lost = (uint8_t)(i % 5);
+        data->devices_moved = (uint8_t)(i % 7);
+        data->capture_frames_per_second = (uint16_t)((i * 61) % 900);
+        data->probe_requests = (uint16_t)((i * 23) % 200);
+        data->wifi_clients_count = (uint8_t)((i * 3) % 80);
+        data->randomized_clients = (uint8_t)(data->wifi_clients_count / 2);
+        data->busiest_bssid_fps = (uint16_t)((i * 19) % 300);
+        data->busiest_channel_fps = (uint16_t)((i * 29) % 600);
+        data->ble_phones = (uint8_t)(i % 20);
+        data->ble_trackers = (uint8_t)(i % 4);
+        data->ble_wearables = (uint8_t)(i % 6);
+        data->ble_beacons = (uint8_t)(i % 10);
+        data->cycle_time_us = 123456789 + i * 1000;
+    }
+
+    scan_histograms_reset(&histograms);
+    for (uint8_t i = 0; i < 64; i++) {
+        int8_t rssi = (int8_t)(-40 - (i * 37) % 55);
+        rssi_hist_add(&histograms.wifi_channel[1 + i % WIFI_CHANNEL_COUNT], rssi);
+        rssi_hist_add(&histograms.wifi_all, rssi);
+        rssi_hist_add(&histograms.ble, rssi - 10);
+    }
+}
+
+/**
+ * @brief Each rule of the default set fires on a cycle crafted for it, in priority order
+ */
+static bool check_rules(void) {
+    uint32_t before = failures;
+    struct {
+        const char* name;
+        uint32_t    free_memory;
+        uint8_t     novel;
+        uint8_t     followers;
+        float       wifi;
+        uint32_t    excitement;
+        ai_state_t  current;
+        uint32_t    duration_ms;
+        ai_state_t  expected;
+    } cases[] = {
+        { "low memory",  LOW_MEMORY_THRESHOLD - 1, NOVELTY_EXCITED_THRESHOLD, 0, 50, 0,
+          AI_STATE_IDLE, 0, AI_STATE_ERROR },
+        { "novel",       1 << 20, NOVELTY_EXCITED_THRESHOLD, AI_RULE_FOLLOWERS, 50, 0,
+          AI_STATE_IDLE, 0, AI_STATE_EXCITED },
+        { "sustained",   1 << 20, 0, 0, HIGH_WIFI_ACTIVITY_THRESHOLD, AI_RULE_EXCITED_LEVEL + 1,
+          AI_STATE_IDLE, 0, AI_STATE_EXCITED },
+        { "wifi busy",   1 << 20, 0, AI_RULE_FOLLOWERS, HIGH_WIFI_ACTIVITY_THRESHOLD,
+          AI_RULE_EXCITED_LEVEL, AI_STATE_IDLE, 0, AI_STATE_SNIFFING },
+        { "followed",    1 << 20, 0, AI_RULE_FOLLOWERS, 1, 0,
+          AI_STATE_SNIFFING, AI_RULE_LEARNING_AFTER_MS + 1, AI_STATE_TRACKING },
+        { "digesting",   1 << 20, 0, 0, 1, 0,
+          AI_STATE_SNIFFING, AI_RULE_LEARNING_AFTER_MS + 1, AI_STATE_LEARNING },
+        { "not yet",     1 << 20, 0, 0, 1, 0,
+          AI_STATE_SNIFFING, AI_RULE_LEARNING_AFTER_MS, AI_STATE_IDLE },
+        { "quiet",       1 << 20, 0, 0, 0, 0,
+          AI_STATE_IDLE, AI_RULE_SLEEP_AFTER_MS + 1, AI_STATE_SLEEPING },
+        { "fallback",    1 << 20, 0, 0, 1, 0,
+          AI_STATE_IDLE, AI_RULE_SLEEP_AFTER_MS + 1, AI_STATE_IDLE },
+    };
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        sensor_data_t data;
+        memset(&data, 0, sizeof(data));
+        data.free_memory = cases[i].free_memory;
+        data.novel_devices = cases[i].novel;
+        data.ble_followers = cases[i].followers;
+        data.wifi_networks_count = (uint8_t)cases[i].wifi;
+
+        ai_rule_input_t in;
+        in.data = &data;
+        in.wifi_networks = cases[i].wifi;
+        in.ble_devices = 0;
+        in.wifi_high = HIGH_WIFI_ACTIVITY_THRESHOLD;
+        in.excitement = cases[i].excitement;
+        in.current = cases[i].current;
+        in.state_duration_ms = cases[i].duration_ms;
+
+        ai_state_t state = ai_rules_default_t::evaluate(in);
+        if (state != cases[i].expected) {
+            printf("ai.rules: %s gave %s, expected %s\n", cases[i].name,
+                   ai_state_to_string(state), ai_state_to_string(cases[i].expected));
+            failures++;
+        }
+    }
+
+    if (infer_ai_state(NULL) != AI_STATE_ERROR) {
+        printf("ai.rules: no cycle did not give Error\n");
+        failures++;
+    }
+    return failures == before;
+}
+
+/**
+ * @brief Dwell time and hysteresis hold a proposal back; faults go through at once
+ */
+static bool check_transitions(void) {
+    uint32_t before = failures;
+    ai_state_t committed = AI_STATE_IDLE;
+
+    // Evidence alone is not enough before IDLE's dwell time has passed
+    ai_transition_init(AI_STATE_IDLE, 0);
+    for (uint8_t i = 0; i < 5; i++) {
+        if (ai_transition_update(AI_STATE_SNIFFING, 1.0f, AI_DWELL_IDLE_MS - 1, &committed)) {
+            printf("ai.transition: left Idle before its dwell time\n");
+            failures++;
+            break;
+        }
+    }
+    if (!ai_transition_update(AI_STATE_SNIFFING, 1.0f, AI_DWELL_IDLE_MS, &committed) ||
+        committed != AI_STATE_SNIFFING) {
+        printf("ai.transition: Sniffing not committed after the dwell time\n");
+        failures++;
+    }
+
+    // Past the dwell time, one proposal does not reach AI_TRANSITION_ENTER, two do
+    ai_transition_init(AI_STATE_IDLE, 0);
+    bool first = ai_transition_update(AI_STATE_SNIFFING, 1.0f, AI_DWELL_IDLE_MS, &committed);
+    bool second = ai_transition_update(AI_STATE_SNIFFING, 1.0f, AI_DWELL_IDLE_MS, &committed);
+    if (first || !second || committed != AI_STATE_SNIFFING) {
+        printf("ai.transition: Sniffing committed after %s proposal(s), expected 2\n",
+               first ? "1" : second ? "2" : "more than 2");
+        failures++;
+    }
+
+    // ERROR is committed on the first proposal, however weak, and left once IDLE has evidence
+    ai_transition_init(AI_STATE_SNIFFING, 0);
+    if (!ai_transition_update(AI_STATE_ERROR, 0.1f, 0, &committed) ||
+        committed != AI_STATE_ERROR) {
+        printf("ai.transition: Error was held back\n");
+        failures++;
+    }
+    first = ai_transition_update(AI_STATE_IDLE, 1.0f, 0, &committed);
+    second = ai_transition_update(AI_STATE_IDLE, 1.0f, 0, &committed);
+    if (first || !second || committed != AI_STATE_IDLE) {
+        printf("ai.transition: Error not left on the second Idle proposal\n");
+        failures++;
+    }
+
+    ai_transition_stats_t stats;
+    ai_transition_get_stats(&stats);
+    if (stats.proposals != 3 || stats.transitions != 2 || stats.suppressed != 1) {
+        printf("ai.transition: %u proposals, %u transitions, %u suppressed, expected 3, 2, 1\n",
+               stats.proposals, stats.transitions, stats.suppressed);
+        failures++;
+    }
+    return failures == before;
+}
+
+/**
+ * @brief Quantiles of a two-cluster histogram interpolate within their bins
+ */
+static bool check_quantiles(void) {
+    uint32_t before = failures;
+    rssi_hist_t hist;
+    rssi_hist_reset(&hist);
+    if (rssi_hist_quantile(&hist, 50) != -100) {
+        printf("hist.quantile: empty histogram gave %d, expected -100\n",
+               rssi_hist_quantile(&hist, 50));
+        failures++;
+    }
+
+    // Ten samples in the -95 dBm bin and ten in the -55 dBm bin
+    for (uint8_t i = 0; i < 10; i++) {
+        rssi_hist_add(&hist, -92);
+        rssi_hist_add(&hist, -52);
+    }
+    static const struct {
+        uint8_t percent;
+        int8_t  expected;
+    } cases[] = {
+        { 0, -95 }, { 25, -93 }, { 50, -90 }, { 75, -53 }, { 100, -50 }, { 200, -50 },
+    };
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int8_t value = rssi_hist_quantile(&hist, cases[i].percent);
+        if (value != cases[i].expected) {
+            printf("hist.quantile: p%u gave %d, expected %d\n",
+                   cases[i].percent, value, cases[i].expected);
+            failures++;
+        }
+    }
+
+    // Out-of-range readings are clamped into the end bins
+    rssi_hist_reset(&hist);
+    rssi_hist_add(&hist, -128);
+    rssi_hist_add(&hist, 20);
+    if (hist.bins[0] != 1 || hist.bins[RSSI_HIST_BINS - 1] != 1 || hist.count != 2) {
+        printf("hist.add: out-of-range readings not clamped into the end bins\n");
+        failures++;
+    }
+    return failures == before;
+}
+
+/**
+ * @brief Every input must come back unchanged through the packed and CBOR forms
+ */
+static bool check_round_trips(void) {
+    uint32_t before = failures;
+    for (uint32_t i = 0; i < HOST_BENCH_INPUTS; i++) {
+        sensor_data_t decoded;
+        size_t length = sensor_data_serialize(&inputs[i], wire, sizeof(wire));
+        if (length == 0 || !sensor_data_deserialize(wire, length, &decoded) ||
+            memcmp(&decoded, &inputs[i], sizeof(decoded)) != 0) {
+            printf("codec.packed: input %u does not round-trip\n", i);
+            failures++;
+        }
+
+        length = sensor_data_to_cbor(&inputs[i], wire, sizeof(wire));
+        if (length == 0 || !sensor_data_from_cbor(wire, length, &decoded) ||
+            memcmp(&decoded, &inputs[i], sizeof(decoded)) != 0) {
+            printf("codec.cbor: input %u does not round-trip\n", i);
+            failures++;
+        }
+
+        if (sensor_data_to_json(&inputs[i], json, sizeof(json)) == 0) {
+            printf("codec.json: input %u does not fit %u bytes\n", i, (unsigned)sizeof(json));
+            failures++;
+        }
+    }
+    return failures == before;
+}
+
+/**
+ * @brief Every device inserted by the cases is still there, and only those
+ */
+static bool check_device_table(void) {
+    uint32_t before = failures;
+    if (device_table_count() != HOST_BENCH_DEVICES) {
+        printf("devices: %u live entries, expected %u\n",
+               device_table_count(), (unsigned)HOST_BENCH_DEVICES);
+        failures++;
+    }
+    for (uint32_t i = 0; i < HOST_BENCH_DEVICES; i++) {
+        uint8_t mac[6];
+        make_mac(i, mac);
+        if (device_table_find(mac, DEVICE_KIND_BLE) == NULL) {
+            printf("devices: entry %u lost\n", i);
+            failures++;
+            break;
+        }
+    }
+    return failures == before;
+}
+
+/**
+ * @brief Ageing out every other device leaves the rest reachable through shifted chains
+ */
+static bool check_device_delete(void) {
+    uint32_t before = failures;
+    uint32_t later = 1000 + DEVICE_TTL_MS + 1;
+    for (uint32_t i = 0; i < HOST_BENCH_DEVICES; i += 2) {
+        uint8_t mac[6];
+        make_mac(i, mac);
+        device_table_observe(mac, DEVICE_KIND_BLE, -60, 0, later, 0);
+    }
+
+    // A removal re-examines its slot, so one budget of a table may not finish the sweep
+    uint32_t removed = 0;
+    for (uint8_t pass = 0; pass < 4; pass++) {
+        removed += device_table_age_step(later, device_table_capacity());
+    }
+    if (removed != HOST_BENCH_DEVICES / 2 || device_table_count() != HOST_BENCH_DEVICES / 2) {
+        printf("devices: aged out %u, %u left, expected %u of each\n",
+               removed, device_table_count(), (unsigned)(HOST_BENCH_DEVICES / 2));
+        failures++;
+    }
+
+    for (uint32_t i = 0; i < HOST_BENCH_DEVICES; i++) {
+        uint8_t mac[6];
+        make_mac(i, mac);
+        bool found = device_table_find(mac, DEVICE_KIND_BLE) != NULL;
+        if (found != ((i & 1) == 0)) {
+            printf("devices: entry %u %s after the sweep\n", i, found ? "still there" : "lost");
+            failures++;
+            break;
+        }
+    }
+    return failures == before;
+}
+
+/**
+ * @brief Time calls of one case as BENCH_SAMPLES batches, after a warm-up of a hundredth of them
+ */
+template <typename Fn>
+static void run_case(const char* suite, const char* name, uint64_t calls, Fn fn) {
+    uint64_t batch = std::max<uint64_t>(1, calls / BENCH_SAMPLES);
+    uint64_t call = 0;
+    for (uint64_t i = 0; i < calls / 100; i++) {
+        fn(call++);
+    }
+    double seconds = 0.0;
+    for (uint32_t s = 0; s < BENCH_SAMPLES; s++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < batch; i++) {
+            fn(call++);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        seconds += elapsed.count();
+        samples[s] = (uint32_t)std::min(elapsed.count() * 1e12 / batch, 4e9);   // ps per call
+    }
+    std::sort(samples, samples + BENCH_SAMPLES);
+
+    cases++;
+    if (reporting) {
+        uint64_t total = 0;
+        for (uint32_t s = 0; s < BENCH_SAMPLES; s++) {
+            total += samples[s];
+        }
+        printf("BENCH {\"suite\":\"%s\",\"case\":\"%s\",\"unit\":\"ps\",\"samples\":%d,"
+               "\"batch\":%llu,\"min\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u,\"mean\":%u}\n",
+               suite, name, BENCH_SAMPLES, (unsigned long long)batch, samples[0],
+               samples[BENCH_SAMPLES / 2], samples[BENCH_SAMPLES * 99 / 100],
+               samples[BENCH_SAMPLES - 1], (uint32_t)(total / BENCH_SAMPLES));
+        return;
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "%s/%s", suite, name);
+    uint64_t timed = batch * BENCH_SAMPLES;
+    printf("%-20s %12llu %10.1f %14.0f\n", label, (unsigned long long)timed,
+           samples[BENCH_SAMPLES / 2] / 1000.0, seconds > 0.0 ? timed / seconds : 0.0);
+}
@@ -0,0 +1,20 @@
+#ifndef HOST_BENCH_H
+#define HOST_BENCH_H
+
+#include <stdint.h>
+
+/**
+ * @brief Time the pure-logic paths on the host and check their round trips
+ *
+ * Runs the rule engine, feature extraction, histogram quantiles, device
+ * table inserts and lookups and the three sensor_data_t encodings on
+ * fixed inputs, printing calls per second for each. A codec that does not
+ * decode what it encoded, or a device table that loses an entry, fails
+ * the run.
+ * @param repeat Multiplier on every case's call count
+ * @param report Also print the run as a BENCH report (see tools/bench)
+ * @return 0 when every check passed, 1 otherwise
+ */
+int host_bench_run(uint32_t repeat, bool report);
+
+#endif // HOST_BENCH_H
@@ -0,0 +1,306 @@
+/**
+ * @file replay.cpp
+ * @brief Replay SD-card sensor traces through the decision path on a host
+ *
+ * Build and run with PlatformIO's native environment:
+ *
+ *     pio run -e native
+ *     .pio/build/native/program [--timeline] [--repeat N] trace_0000.htr ...
+ *     .pio/build/native/program --bench [--repeat N] [--report]
+ *
+ * Every record goes through ai_features_extract(), infer_ai_state() and the
+ * transition filter at its recorded time, exactly as the rule engine sees
+ * it on a unit. The report gives the committed state timeline, transition
+ * counts, time in each state and the decision-path throughput. Time-of-day
+ * features use the host clock; no rule reads them. --bench runs the
+ * host throughput and round-trip checks of host_bench.cpp instead.
+ */
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "config.h"
+#include "ai_states.h"
+#include "ai_features.h"
+#include "ai_transition.h"
+#include "trace_log.h"
+#include "host_bench.h"
+
+/**
+ * @brief One trace file loaded into memory
+ */
+typedef struct {
+    const char*                 path;
+    trace_file_header_t         header;
+    std::vector<trace_record_t> records;
+    uint32_t                    skipped;        // Records with another sensor_data_t version
+} trace_t;
+
+/**
+ * @brief Outcome of replaying one or more traces
+ */
+typedef struct {
+    uint32_t cycles;
+    uint32_t proposal_flips;                    // Raw rule output changes
+    uint32_t transitions;                       // Committed changes
+    uint32_t matrix[AI_STATE_COUNT][AI_STATE_COUNT];
+    uint64_t time_in_state_ms[AI_STATE_COUNT];
+    uint32_t proposals[AI_STATE_COUNT];
+} replay_report_t;
+
+// Replay clock and heap, read back through the Arduino shim
+static uint32_t replay_now_ms = 0;
+static uint32_t replay_heap_size = 0;
+EspClass ESP;
+
+uint32_t millis(void) {
+    return replay_now_ms;
+}
+
+uint32_t EspClass::getHeapSize(void) {
+    return replay_heap_size;
+}
+
+// Forward declarations
+static bool load_trace(const char* path, trace_t* trace);
+static void replay_trace(const trace_t* trace, bool timeline, replay_report_t* report);
+static double measure_throughput(const std::vector<trace_t>& traces, uint32_t repeat,
+                                 uint64_t* decisions);
+static void print_report(const char* title, const replay_report_t* report);
+static void print_time(uint32_t ms);
+
+int main(int argc, char** argv) {
+    bool timeline = false;
+    bool bench = false;
+    bool report = false;
+    uint32_t repeat = 1;
+    std::vector<trace_t> traces;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--timeline") == 0) {
+            timeline = true;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--report") == 0) {
+            report = true;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = max(1, atoi(argv[++i]));
+        } else {
+            trace_t trace;
+            if (!load_trace(argv[i], &trace)) {
+                return 1;
+            }
+            traces.push_back(trace);
+        }
+    }
+    if (bench) {
+        return host_bench_run(repeat, report);
+    }
+    if (traces.empty()) {
+        fprintf(stderr, "usage: %s [--timeline] [--repeat N] trace.htr...\n"
+                        "       %s --bench [--repeat N] [--report]\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    replay_report_t total;
+    memset(&total, 0, sizeof(total));
+    for (const trace_t& trace : traces) {
+        replay_report_t report;
+        replay_trace(&trace, timeline, &report);
+        print_report(trace.path, &report);
+
+        total.cycles += report.cycles;
+        total.proposal_flips += report.proposal_flips;
+        total.transitions += report.transitions;
+        for (uint8_t from = 0; from < AI_STATE_COUNT; from++) {
+            total.time_in_state_ms[from] += report.time_in_state_ms[from];
+            total.proposals[from] += report.proposals[from];
+            for (uint8_t to = 0; to < AI_STATE_COUNT; to++) {
+                total.matrix[from][to] += report.matrix[from][to];
+            }
+        }
+    }
+    if (traces.size() > 1) {
+        print_report("all traces", &total);
+    }
+
+    uint64_t decisions = 0;
+    double seconds = measure_throughput(traces, repeat, &decisions);
+    printf("\nThroughput: %llu decisions in %.3f s = %.0f inferences/s (%.0f ns each)\n",
+           (unsigned long long)decisions, seconds,
+           seconds > 0.0 ? decisions / seconds : 0.0,
+           decisions > 0 ? seconds * 1e9 / decisions : 0.0);
+    return 0;
+}
+
+/**
+ * @brief Read a trace file written by trace_log.cpp
+ */
+static bool load_trace(const char* path, trace_t* trace) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+
+    trace->path = path;
+    trace->skipped = 0;
+    trace->records.clear();
+    if (fread(&trace->header, sizeof(trace->header), 1, file) != 1 ||
+        trace->header.magic != TRACE_FILE_MAGIC || trace->header.format != TRACE_FILE_FORMAT ||
+        trace->header.record_bytes != sizeof(trace_record_t)) {
+        fprintf(stderr, "%s: not a format %d trace\n", path, TRACE_FILE_FORMAT);
+        fclose(file);
+        return false;
+    }
+
+    // A trailing partial record is what a power cut mid-write leaves behind
+    trace_record_t record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.data.version != SENSOR_DATA_VERSION) {
+            trace->skipped++;
+            continue;
+        }
+        trace->records.push_back(record);
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * @brief Run one trace through extraction, rules and the transition filter
+ */
+static void replay_trace(const trace_t* trace, bool timeline, replay_report_t* report) {
+    memset(report, 0, sizeof(*report));
+    if (trace->records.empty()) {
+        return;
+    }
+
+    static scan_histograms_t histograms;
+    ai_feature_vector_t features;
+    uint32_t start_ms = trace->records.front().timestamp_ms;
+    uint32_t entered_ms = start_ms;
+    ai_state_t current = AI_STATE_IDLE;
+    ai_state_t last_proposed = AI_STATE_IDLE;
+
+    replay_heap_size = trace->header.heap_size;
+    ai_transition_init(current, start_ms);
+    if (timeline) {
+        printf("\n%s timeline:\n", trace->path);
+    }
+
+    for (const trace_record_t& record : trace->records) {
+        replay_now_ms = record.timestamp_ms;
+        scan_histograms_reset(&histograms);
+        histograms.wifi_all = record.wifi_all;
+        histograms.ble = record.ble;
+        ai_features_extract(&record.data, &histograms, &features);
+
+        ai_state_t proposed = infer_ai_state(&record.data);
+        report->proposals[proposed]++;
+        if (report->cycles > 0 && proposed != last_proposed) {
+            report->proposal_flips++;
+        }
+        last_proposed = proposed;
+        report->cycles++;
+
+        ai_state_t committed;
+        if (ai_transition_update(proposed, 1.0f, record.timestamp_ms, &committed)) {
+            if (timeline) {
+                printf("  ");
+                print_time(entered_ms - start_ms);
+                printf("  %-9s for ", ai_state_to_string(current));
+                print_time(record.timestamp_ms - entered_ms);
+                printf("\n");
+            }
+            report->time_in_state_ms[current] += record.timestamp_ms - entered_ms;
+            report->matrix[current][committed]++;
+            report->transitions++;
+            current = committed;
+            entered_ms = record.timestamp_ms;
+        }
+    }
+
+    uint32_t end_ms = trace->records.back().timestamp_ms;
+    report->time_in_state_ms[current] += end_ms - entered_ms;
+    if (timeline) {
+        printf("  ");
+        print_time(entered_ms - start_ms);
+        printf("  %-9s until the end of the trace\n", ai_state_to_string(current));
+    }
+    if (trace->skipped > 0) {
+        printf("%s: skipped %u records of another sensor_data_t version\n",
+               trace->path, trace->skipped);
+    }
+}
+
+/**
+ * @brief Time extraction plus inference over every record, repeat times
+ */
+static double measure_throughput(const std::vector<trace_t>& traces, uint32_t repeat,
+                                 uint64_t* decisions) {
+    static scan_histograms_t histograms;
+    ai_feature_vector_t features;
+    volatile uint32_t sink = 0;         // Keeps the work from being optimized away
+    *decisions = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t pass = 0; pass < repeat; pass++) {
+        for (const trace_t& trace : traces) {
+            replay_heap_size = trace.header.heap_size;
+            for (const trace_record_t& record : trace.records) {
+                replay_now_ms = record.timestamp_ms;
+                histograms.wifi_all = record.wifi_all;
+                histograms.ble = record.ble;
+                ai_features_extract(&record.data, &histograms, &features);
+                sink = sink + infer_ai_state(&record.data);
+                (*decisions)++;
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    (void)sink;
+    return elapsed.count();
+}
+
+/**
+ * @brief Transition counts, state shares and proposal stability
+ */
+static void print_report(const char* title, const replay_report_t* report) {
+    uint64_t total_ms = 0;
+    for (uint8_t s = 0; s < AI_STATE_COUNT; s++) {
+        total_ms += report->time_in_state_ms[s];
+    }
+
+    printf("\n%s: %u cycles over ", title, report->cycles);
+    print_time((uint32_t)min(total_ms, (uint64_t)UINT32_MAX));
+    printf(", %u committed transitions, %u raw proposal flips\n",
+           report->transitions, report->proposal_flips);
+
+    printf("  %-9s %8s %7s %9s\n", "state", "proposed", "time", "share");
+    for (uint8_t s = 0; s < AI_STATE_COUNT; s++) {
+        if (report->proposals[s] == 0 && report->time_in_state_ms[s] == 0) {
+            continue;
+        }
+        printf("  %-9s %8u %6.0fs %8.1f%%\n", ai_state_to_string((ai_state_t)s),
+               report->proposals[s], report->time_in_state_ms[s] / 1000.0,
+               total_ms > 0 ? 100.0 * report->time_in_state_ms[s] / total_ms : 0.0);
+    }
+
+    for (uint8_t from = 0; from < AI_STATE_COUNT; from++) {
+        for (uint8_t to = 0; to < AI_STATE_COUNT; to++) {
+            if (report->matrix[from][to] > 0) {
+                printf("  %-9s -> %-9s %u\n", ai_state_to_string((ai_state_t)from),
+                       ai_state_to_string((ai_state_t)to), report->matrix[from][to]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Print a duration as h:mm:ss.mmm
+ */
+static void print_time(uint32_t ms) {
+    printf("%u:%02u:%02u.%03u", ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file Arduino.h
+ * @brief The few Arduino-core symbols the pure logic uses, for the native build
+ *
+ * Only covers what the env:native sources need: the decision path,
+ * rssi_histogram.cpp, device_table.cpp and the sensor_data_t codecs. The replay tool drives the clock and the heap
+ * size from the trace being replayed.
+ */
+
+#ifndef REPLAY_ARDUINO_SHIM_H
+#define REPLAY_ARDUINO_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+/**
+ * @brief Time of the record being replayed
+ */
+uint32_t millis(void);
+
+/**
+ * @brief Heap size of the unit that recorded the trace
+ */
+class EspClass {
+public:
+    uint32_t getHeapSize(void);
+};
+
+extern EspClass ESP;
+
+#endif // REPLAY_ARDUINO_SHIM_H
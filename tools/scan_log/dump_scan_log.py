@@ -0,0 +1,187 @@
+"""
+Print a HydraESP binary scan log as one line per record.
+
+The log is /logs/scan.hsl on the SD card (/logs/scan_old.hsl before the
+last rotation), appended to across boots:
+
+    python3 tools/scan_log/dump_scan_log.py scan.hsl
+    python3 tools/scan_log/dump_scan_log.py --csv scan_old.hsl scan.hsl > scan.csv
+    python3 tools/scan_log/dump_scan_log.py --device aa:bb:cc:dd:ee:ff scan.hsl
+    python3 tools/scan_log/dump_scan_log.py --wigle scan.hsl > wigle.csv
+
+Devices are logged as runs: "appeared" with the RSSI later records are
+measured against, "present" with the cycles seen and RSSI range since the
+device's previous record, "changed" when its RSSI left the band and a new
+reference is set, and "gone" when it aged out. --devices prints only
+those, --device <mac> only one device's.
+
+Every 32-byte slot is either a record, padding (no sync word) or a
+record torn by a power loss (CRC mismatch); the last two are skipped and
+counted. A gap in the sequence numbers is records dropped on the unit
+while its staging ring was full.
+
+A "clock" record pairs the uptime with the wall clock whenever the unit's
+clock is set or stepped (SNTP, a mesh peer, or the RTC across a sleep);
+from it to the end of the boot, each line also gets its UTC time.
+
+A wardriving build (env:wardrive) stages a "position" record ahead of
+each cycle's device records while the GPS has a fix. --wigle joins the
+two into a WiGLE 1.4 CSV: every appeared, changed and present record
+with a position from the last 30 s, timed by that position's GPS clock.
+SSIDs and security modes are not in the log; those columns are left
+blank and "[ESS]".
+"""
+
+import datetime
+import struct
+import sys
+import zlib
+
+SYNC = 0x4C53           # SCAN_LOG_SYNC
+RECORD = struct.Struct("<HBBII16sI")    # scan_log_record_t
+CRC_BYTES = RECORD.size - 4
+
+STATES = ["idle", "sniffing", "tracking", "learning", "excited", "sleeping", "error", "updating"]  # ai_state_t
+
+# scan_log_type_t, from 1: name, payload layout, field names
+TYPES = {
+    1: ("boot", struct.Struct("<HBBI"), ("format", "record_bytes", "reset_reason", "heap_size")),
+    2: ("state", struct.Struct("<BBHfI"), ("from", "to", "reserved", "confidence", "duration_ms")),
+    3: ("networks", struct.Struct("<HHbbHHHHH"),
+        ("wifi_networks", "ble_devices", "wifi_rssi", "ble_rssi", "ble_phones",
+         "ble_trackers", "wifi_clients", "probe_requests", "capture_fps")),
+    4: ("system", struct.Struct("<IIHhBBBB"),
+        ("free_heap", "min_free_heap", "free_psram_kb", "temperature_dc", "cpu_pct",
+         "thermal_level", "task_count", "critical")),
+    5: ("appeared", struct.Struct("<6sBBb"), ("mac", "kind", "channel", "rssi")),
+    6: ("changed", struct.Struct("<6sBBb"), ("mac", "kind", "channel", "rssi")),
+    7: ("present", struct.Struct("<6sBbbbH"), ("mac", "kind", "rssi_min", "rssi_max", "rssi_last", "cycles")),
+    8: ("gone", struct.Struct("<6sBbbbH"), ("mac", "kind", "rssi_min", "rssi_max", "rssi_last", "cycles")),
+    9: ("clock", struct.Struct("<IHBBi"), ("epoch_s", "epoch_ms", "source", "stratum", "step_ms")),
+    10: ("position", struct.Struct("<iiIhBB"), ("lat_e7", "lon_e7", "utc_s", "alt_m", "speed_kmh", "hdop_x10")),
+}
+KINDS = ["wifi", "ble"]         # device_kind_t
+SOURCES = ["none", "rtc", "peer", "sntp"]  # time_source_t
+
+
+def records(paths, skipped):
+    """Yield (type, sequence, timestamp_ms, fields) for every valid record."""
+    for path in paths:
+        with open(path, "rb") as log:
+            data = log.read()
+        for offset in range(0, len(data) - RECORD.size + 1, RECORD.size):
+            slot = data[offset:offset + RECORD.size]
+            sync, kind, length, sequence, timestamp, payload, crc = RECORD.unpack(slot)
+            if sync != SYNC:
+                skipped["padding"] += 1
+                continue
+            if zlib.crc32(slot[:CRC_BYTES]) != crc or kind not in TYPES:
+                skipped["torn"] += 1
+                continue
+            name, layout, fields = TYPES[kind]
+            values = dict(zip(fields, layout.unpack(payload[:layout.size])))
+            values.pop("reserved", None)
+            if name == "state":
+                values["from"] = STATES[values["from"]] if values["from"] < len(STATES) else values["from"]
+                values["to"] = STATES[values["to"]] if values["to"] < len(STATES) else values["to"]
+                values["confidence"] = round(values["confidence"], 3)
+            elif name == "clock":
+                values["source"] = SOURCES[values["source"]] if values["source"] < len(SOURCES) else values["source"]
+            elif name == "position":
+                values["lat"] = values.pop("lat_e7") / 1e7
+                values["lon"] = values.pop("lon_e7") / 1e7
+                values["hdop"] = values.pop("hdop_x10") / 10.0
+            elif name == "system":
+                values["temperature_c"] = values.pop("temperature_dc") / 10.0
+            if "mac" in values:
+                values["mac"] = ":".join("%02x" % b for b in values["mac"])
+                values["kind"] = KINDS[values["kind"]] if values["kind"] < len(KINDS) else values["kind"]
+            yield name, sequence, timestamp, values
+
+
+DEVICE_RECORDS = ("appeared", "changed", "present", "gone")
+WIGLE_RECORDS = ("appeared", "changed", "present")
+POSITION_MAX_AGE_MS = 30000
+UERE_M = 5.0            # Metres of error per unit of HDOP, a typical receiver's
+
+
+def wigle(paths, skipped):
+    """Print a WiGLE 1.4 CSV of the device records that have a recent position."""
+    print("WigleWifi-1.4,appRelease=1,model=HydraESP,release=1,device=hydraesp,"
+          "display=,board=esp32,brand=HydraESP")
+    print("MAC,SSID,AuthMode,FirstSeen,Channel,RSSI,CurrentLatitude,CurrentLongitude,"
+          "AltitudeMeters,AccuracyMeters,Type")
+    position = None             # (timestamp_ms, fields) of the boot's latest fix
+    channels = {}               # Last channel an access point was logged on
+    rows = 0
+    for name, sequence, timestamp, values in records(paths, skipped):
+        if name == "boot":
+            position = None
+        elif name == "position":
+            position = (timestamp, values)
+        if name not in WIGLE_RECORDS or position is None:
+            continue
+        at, fix = position
+        if timestamp - at > POSITION_MAX_AGE_MS or fix["utc_s"] == 0:
+            continue
+        if "channel" in values:
+            channels[values["mac"]] = values["channel"]
+        wifi = values["kind"] == "wifi"
+        seen = datetime.datetime.utcfromtimestamp(fix["utc_s"] + (timestamp - at) / 1000.0)
+        print("%s,,%s,%s,%d,%d,%.7f,%.7f,%d,%.1f,%s" % (
+            values["mac"], "[ESS]" if wifi else "Misc [LE]", seen.strftime("%Y-%m-%d %H:%M:%S"),
+            channels.get(values["mac"], 0) if wifi else 0, values.get("rssi", values.get("rssi_last")),
+            fix["lat"], fix["lon"], fix["alt_m"], fix["hdop"] * UERE_M, "WIFI" if wifi else "BLE"))
+        rows += 1
+    print("%u rows, %u padding slots, %u torn records" % (rows, skipped["padding"], skipped["torn"]),
+          file=sys.stderr)
+
+
+def main(argv):
+    csv = "--csv" in argv
+    devices = "--devices" in argv
+    device = None
+    paths = []
+    args = iter(argv)
+    for arg in args:
+        if arg == "--device":
+            device = next(args).lower()
+        elif arg not in ("--csv", "--devices", "--wigle"):
+            paths.append(arg)
+    if not paths:
+        sys.exit(__doc__)
+    skipped = {"padding": 0, "torn": 0}
+    if "--wigle" in argv:
+        wigle(paths, skipped)
+        return
+    expected = None
+    dropped = 0
+    epoch_offset_ms = None      # Wall clock minus uptime, from the boot's last clock record
+    for name, sequence, timestamp, values in records(paths, skipped):
+        if name == "boot":
+            expected = None
+            epoch_offset_ms = None
+        elif name == "clock":
+            epoch_offset_ms = values["epoch_s"] * 1000 + values["epoch_ms"] - timestamp
+        if expected is not None and sequence > expected:
+            dropped += sequence - expected
+        expected = sequence + 1
+        if (devices or device) and name not in DEVICE_RECORDS:
+            continue
+        if device and values.get("mac") != device:
+            continue
+        fields = " ".join("%s=%s" % item for item in values.items())
+        if csv:
+            print("%s,%u,%u,%s" % (name, sequence, timestamp, ",".join(str(v) for v in values.values())))
+        else:
+            wall = ""
+            if epoch_offset_ms is not None:
+                moment = datetime.datetime.utcfromtimestamp((epoch_offset_ms + timestamp) / 1000.0)
+                wall = moment.strftime("%Y-%m-%d %H:%M:%S.%f")[:-3] + "  "
+            print("%s%10.3f s  #%-6u %-8s %s" % (wall, timestamp / 1000.0, sequence, name, fields))
+    print("%u padding slots, %u torn records, %u dropped on the unit" %
+          (skipped["padding"], skipped["torn"], dropped), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
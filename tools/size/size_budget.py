@@ -0,0 +1,310 @@
+"""
+Break the firmware image down by subsystem from the linker map and hold it to a budget.
+
+    make size                                       # build, totals, then this report
+    make size-baseline                              # record tools/size/baseline.json
+    python3 tools/size/size_budget.py .pio/build/esp32-s3-devkitc-1/firmware.map --check
+
+Every input section placed in the image is attributed to the first
+subsystem in SUBSYSTEMS whose pattern matches its object file: our
+sources by directory and name, libraries and ESP-IDF archives by path.
+Bytes are split by where they end up: code and read-only data in flash,
+code in IRAM, initialised data in DRAM (all four in the image and the
+OTA download) and zeroed BSS (RAM only).
+
+Each subsystem's image bytes are held against tools/size/budget.json and
+compared with the checked-in baseline; growth beyond --threshold percent
+and --min-bytes is flagged. The whole image is held against the app slot
+in partitions.csv. As a PlatformIO post script it asks the linker for
+the map and prints the report after every link, without failing the
+build; --check (exit 1 on anything flagged) is for CI and make.
+
+Below the table, the internal RAM segments from the map's memory
+configuration are filled from the output sections placed in them. IRAM
+holds the ISR and callback paths tagged IRAM_ATTR; its free bytes are
+held against iram_headroom_kb, so moving one more path in shows what it
+costs. On the S3 both segments alias one SRAM, and the DRAM figure
+already counts the IRAM in use.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+# First match wins; paths are normalised to forward slashes
+SUBSYSTEMS = [
+    ("fonts",       r"/src/generated/ui_fonts\.|lv_font_"),
+    ("scan",        r"/src/scan/|/src/tasks/(scan|capture)_task\.|/src/(scan_log|sighting_archive|sensor_snapshot)\."),
+    ("ai",          r"/src/ai_|/src/tasks/ai_task\.|/src/model_store\."),
+    ("ui",          r"/src/(ui_|face_anim)|/src/generated/face_atlas\.|/src/tasks/ui_task\.|"
+                    r"/src/drivers/(renderer|backlight|touch|lvgl_pool|status_led)\."),
+    ("web",         r"/src/net/"),
+    ("storage",     r"/src/(storage|journal|trace_log|log_manager|warm_start|asset_store)\.|"
+                    r"/src/drivers/(sd_monitor|sd_bench|spi_bus)\.|/libSD|/SD/|/libFS|LittleFS|"
+                    r"lib(fatfs|spiffs|wear_levelling|sdmmc|littlefs)\.a"),
+    ("system",      r"/src/"),
+    ("lvgl",        r"lvgl"),
+    ("tflite",      r"TensorFlowLite|tflite|esp-nn|esp_nn"),
+    ("web-libs",    r"AsyncTCP|AsyncWebServer|ArduinoJson"),
+    ("display-lib", r"TFT_eSPI"),
+    ("bluetooth",   r"lib(bt|btdm_app|btbb|BLE|NimBLE-Arduino)\.a|/BLE/|/NimBLE-Arduino/"),
+    ("wifi",        r"lib(net80211|pp|wpa_supplicant|phy|coexist|mesh|espnow|smartconfig|lwip|"
+                    r"esp_wifi|esp_netif|WiFi|WiFiClientSecure|mbedtls|mbedcrypto|mbedx509)\.a"),
+    ("framework",   r"framework-arduinoespressif32|FrameworkArduino|/tools/sdk/"),
+    ("toolchain",   r"toolchain-|lib(c|m|g|gcc|stdc\+\+|nosys)\.a"),
+]
+
+# Output sections by region; anything else (debug, comments) is not in the image
+REGIONS = [
+    ("flash_text",   r"^\.flash\.text$|^\.text$"),
+    ("flash_rodata", r"^\.flash\.(rodata|appdesc)|^\.rodata"),
+    ("iram",         r"^\.iram0\.|^\.rtc\.text"),
+    ("data",         r"^\.dram0\.data$|^\.rtc\.data|^\.data"),
+    ("bss",          r"^\.dram0\.bss$|^\.ext_ram\.bss|^\.rtc\.bss|^\.bss|^\.noinit|^\.dram0\.noinit"),
+]
+IMAGE_REGIONS = ("flash_text", "flash_rodata", "iram", "data")
+
+# Internal RAM segments reported with their headroom
+SEGMENTS = ("iram0_0_seg", "dram0_0_seg")
+
+INPUT_LINE = re.compile(r"^ (\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+INPUT_NAME = re.compile(r"^ (\S+)$")
+INPUT_REST = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+OUTPUT_LINE = re.compile(r"^(\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+).*)?$")
+OUTPUT_REST = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)(\s+load address.*)?$")
+SEGMENT_LINE = re.compile(r"^(\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+
+
+def classify(patterns, text, default):
+    for name, pattern in patterns:
+        if pattern.search(text):
+            return name
+    return default
+
+
+def parse_map(path):
+    """Bytes per subsystem and region from the placed input sections of a GNU ld map,
+    and the origin, length and used bytes of each memory segment."""
+    subsystems = [(name, re.compile(pattern)) for name, pattern in SUBSYSTEMS]
+    regions = [(name, re.compile(pattern)) for name, pattern in REGIONS]
+    sizes = {}
+    segments = {}
+    region = None
+    pending = None
+    output = None
+    in_memory_map = False
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if not in_memory_map:
+                in_memory_map = line.startswith("Linker script and memory map")
+                match = SEGMENT_LINE.match(line)
+                if match and match.group(1) != "*default*":
+                    segments[match.group(1)] = [int(match.group(2), 16), int(match.group(3), 16), 0]
+                continue
+            if line and not line[0].isspace():
+                match = OUTPUT_LINE.match(line)
+                region = classify(regions, match.group(1), None) if match else None
+                output = None
+                if match and match.group(2):
+                    place(segments, int(match.group(2), 16), int(match.group(3), 16))
+                elif match:
+                    output = match.group(1)
+                pending = None
+                continue
+            if output is not None:
+                match = OUTPUT_REST.match(line)
+                if match:
+                    place(segments, int(match.group(1), 16), int(match.group(2), 16))
+                output = None
+                if match:
+                    continue
+            if region is None:
+                continue
+
+            match = INPUT_LINE.match(line)
+            if match:
+                section, address, size, obj = match.groups()
+            elif pending is not None and INPUT_REST.match(line):
+                section = pending
+                address, size, obj = INPUT_REST.match(line).groups()
+            else:
+                name = INPUT_NAME.match(line)
+                pending = name.group(1) if name and not name.group(1).startswith("*") else None
+                continue
+            pending = None
+            if section.startswith("*") or int(address, 16) == 0 or int(size, 16) == 0:
+                continue        # Fill, patterns and discarded sections
+            obj = obj.strip().replace("\\", "/")
+            subsystem = classify(subsystems, obj, "other")
+            by_region = sizes.setdefault(subsystem, {})
+            by_region[region] = by_region.get(region, 0) + int(size, 16)
+    if not in_memory_map:
+        sys.exit("%s: no memory map found, is it a GNU ld map file?" % path)
+    return sizes, segments
+
+
+def place(segments, address, size):
+    """Charge an output section to the memory segment its address falls in."""
+    if address == 0 or size == 0:
+        return
+    for segment in segments.values():
+        if segment[0] <= address < segment[0] + segment[1]:
+            segment[2] += size
+            return
+
+
+def image_bytes(by_region):
+    return sum(by_region.get(region, 0) for region in IMAGE_REGIONS)
+
+
+def app_slot_bytes(partitions):
+    """Size of the first app partition; every OTA slot has the same."""
+    try:
+        with open(partitions) as f:
+            for line in f:
+                fields = [field.strip() for field in line.split("#")[0].split(",")]
+                if len(fields) >= 5 and fields[1] == "app":
+                    return int(fields[4], 0)
+    except OSError:
+        pass
+    return None
+
+
+def report(sizes, segments, budget, baseline, threshold, min_bytes, slot):
+    """Print the table; return the number of flagged lines."""
+    flagged = 0
+    names = [name for name, _ in SUBSYSTEMS] + ["other"]
+    budgets = budget.get("subsystems", {})
+    old = baseline.get("subsystems", {}) if baseline else {}
+    print("%-12s %9s %9s %8s %8s %8s %10s %10s %9s" %
+          ("subsystem", "text", "rodata", "iram", "data", "bss", "image", "budget", "change"))
+    total = {}
+    for name in names:
+        by_region = sizes.get(name, {})
+        for region, size in by_region.items():
+            total[region] = total.get(region, 0) + size
+        image = image_bytes(by_region)
+        if image == 0 and name not in old:
+            continue
+        limit = budgets.get(name)
+        notes = []
+        if limit is not None and image > limit * 1024:
+            notes.append("over budget by %d B" % (image - limit * 1024))
+        change = ""
+        if name in old:
+            delta = image - old[name]
+            change = "%+d" % delta
+            if delta > min_bytes and delta > old[name] * threshold / 100.0:
+                notes.append("grew %.1f%%" % (100.0 * delta / old[name] if old[name] else 100.0))
+        flagged += 1 if notes else 0
+        print("%-12s %9d %9d %8d %8d %8d %10d %10s %9s%s" %
+              (name, by_region.get("flash_text", 0), by_region.get("flash_rodata", 0),
+               by_region.get("iram", 0), by_region.get("data", 0), by_region.get("bss", 0),
+               image, "%d K" % limit if limit is not None else "-", change,
+               "  <- " + ", ".join(notes) if notes else ""))
+
+    image = image_bytes(total)
+    print("%-12s %9d %9d %8d %8d %8d %10d" %
+          ("total", total.get("flash_text", 0), total.get("flash_rodata", 0), total.get("iram", 0),
+           total.get("data", 0), total.get("bss", 0), image))
+    if slot:
+        headroom = budget.get("slot_headroom_percent", 10)
+        used = 100.0 * image / slot
+        line = "app slot: %d of %d bytes (%.1f%%), %d free" % (image, slot, used, slot - image)
+        if used > 100 - headroom:
+            line += "  <- less than %d%% headroom" % headroom
+            flagged += 1
+        print(line)
+    for name in SEGMENTS:
+        if name not in segments:
+            continue
+        _, length, used = segments[name]
+        line = "%s: %d of %d bytes (%.1f%%), %d free" % (name, used, length,
+                                                         100.0 * used / length, length - used)
+        headroom = budget.get("iram_headroom_kb")
+        if name == "iram0_0_seg" and headroom is not None and length - used < headroom * 1024:
+            line += "  <- less than %d KB headroom" % headroom
+            flagged += 1
+        print(line)
+    if baseline:
+        print("baseline: %s, image %+d bytes" % (baseline.get("commit", "?"),
+                                                image - baseline.get("image", image)))
+    else:
+        print("no baseline: record one with make size-baseline")
+    return flagged
+
+
+def commit():
+    try:
+        return subprocess.check_output(["git", "rev-parse", "--short", "HEAD"], text=True,
+                                       stderr=subprocess.DEVNULL).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def load_json(path):
+    if not path or not os.path.exists(path):
+        return None
+    with open(path) as f:
+        return json.load(f)
+
+
+def run(map_path, budget_path, baseline_path, threshold, min_bytes, partitions, update, check):
+    sizes, segments = parse_map(map_path)
+    budget = load_json(budget_path) or {}
+    baseline = load_json(baseline_path)
+    flagged = report(sizes, segments, budget, baseline, threshold, min_bytes, app_slot_bytes(partitions))
+    if update:
+        recorded = {
+            "commit": commit(),
+            "image": sum(image_bytes(by_region) for by_region in sizes.values()),
+            "subsystems": {name: image_bytes(by_region) for name, by_region in sizes.items()},
+        }
+        with open(baseline_path, "w") as f:
+            json.dump(recorded, f, indent=1, sort_keys=True)
+            f.write("\n")
+        print("wrote %s" % baseline_path)
+    if flagged:
+        print("%d line(s) flagged" % flagged)
+    return 1 if check and flagged else 0
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(sys.argv[0]))
+    root = os.path.dirname(os.path.dirname(here))
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("map", help="linker map, e.g. .pio/build/<env>/firmware.map")
+    parser.add_argument("--budget", default=os.path.join(here, "budget.json"))
+    parser.add_argument("--baseline", default=os.path.join(here, "baseline.json"))
+    parser.add_argument("--partitions", default=os.path.join(root, "partitions.csv"))
+    parser.add_argument("--threshold", type=float, default=2.0, help="percent growth flagged")
+    parser.add_argument("--min-bytes", type=int, default=1024, help="growth below this is never flagged")
+    parser.add_argument("--update-baseline", action="store_true", help="record this map as the baseline")
+    parser.add_argument("--check", action="store_true", help="exit 1 if anything is flagged")
+    args = parser.parse_args()
+    sys.exit(run(args.map, args.budget, args.baseline, args.threshold, args.min_bytes,
+                 args.partitions, args.update_baseline, args.check))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO's SCons
+
+    def after_link(target, source, env):
+        project = env.subst("$PROJECT_DIR")
+        here = os.path.join(project, "tools", "size")
+        map_path = os.path.join(env.subst("$BUILD_DIR"), "firmware.map")
+        if os.path.exists(map_path):
+            run(map_path, os.path.join(here, "budget.json"), os.path.join(here, "baseline.json"),
+                2.0, 1024, os.path.join(project, env.GetProjectOption("board_build.partitions",
+                                                                        "partitions.csv")),
+                False, False)
+
+    env.Append(LINKFLAGS=["-Wl,-Map," + env.subst("$BUILD_DIR/firmware.map")])  # noqa: F821
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", after_link)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        main()
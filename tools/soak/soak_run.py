@@ -0,0 +1,212 @@
+"""
+Drive API load against an env:soak unit for hours and gate the outcome.
+
+The env:soak firmware replays scan cycles and walks the UI on its own;
+this adds the web clients. Each route is polled at a steady rate below
+its HTTP_API_RATE_* limit, every response is timed, and the unit's own
+verdict on /soak is read once a minute:
+
+    make soak DEVICE=192.168.1.42 HOURS=12
+    python3 tools/soak/soak_run.py --device 192.168.1.42 --hours 12 --out soak
+
+The run fails when the unit reports a gate that failed at any check
+(heap drift, fragmentation growth, deadline misses, loop creep), when
+the 95th percentile API latency of the last window exceeds the first
+window's by more than --creep-pct percent plus --creep-ms, or when more
+than --max-error-pct of the requests fail. The report, named after the
+checked-out commit like tools/bench's, holds every window's latency
+percentiles per route and the last /soak figures. Standard library only.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+
+# Route, requests per second (below the unit's HTTP_API_RATE_* limits)
+ROUTES = [
+    ("/api/state", 4.0),
+    ("/api/metrics", 2.0),
+    ("/api/devices", 0.5),
+    ("/api/history?metric=free_heap&tier=1m", 1.0),
+    ("/ui/", 0.2),
+]
+TIMEOUT_S = 10
+
+
+class Window:
+    """Latencies and failures of every route over one window."""
+
+    def __init__(self, start):
+        self.start = start
+        self.latency_ms = {route: [] for route, _ in ROUTES}
+        self.errors = {route: 0 for route, _ in ROUTES}
+
+    def summary(self):
+        routes = {}
+        for route, values in self.latency_ms.items():
+            values = sorted(values)
+            routes[route] = {
+                "requests": len(values) + self.errors[route],
+                "errors": self.errors[route],
+                "p50_ms": percentile(values, 50),
+                "p95_ms": percentile(values, 95),
+                "max_ms": values[-1] if values else None,
+            }
+        return {"start_s": round(self.start, 1), "routes": routes}
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    return round(values[min(len(values) - 1, len(values) * p // 100)], 1)
+
+
+def fetch(base, path):
+    with urllib.request.urlopen(base + path, timeout=TIMEOUT_S) as response:
+        return response.status, response.read()
+
+
+def poll_route(base, route, rate, windows, lock, stop):
+    """Request one route at a steady rate until stopped."""
+    period = 1.0 / rate
+    next_at = time.monotonic()
+    while not stop.is_set():
+        begin = time.monotonic()
+        try:
+            status, _ = fetch(base, route)
+            ok = status == 200
+        except (urllib.error.URLError, OSError):
+            ok = False
+        elapsed_ms = (time.monotonic() - begin) * 1000.0
+        with lock:
+            window = windows[-1]
+            if ok:
+                window.latency_ms[route].append(elapsed_ms)
+            else:
+                window.errors[route] += 1
+        next_at += period
+        stop.wait(max(0.0, next_at - time.monotonic()))
+
+
+def commit_name():
+    try:
+        commit = subprocess.check_output(["git", "rev-parse", "--short", "HEAD"],
+                                         stderr=subprocess.DEVNULL, text=True).strip()
+        dirty = subprocess.call(["git", "diff", "--quiet"], stderr=subprocess.DEVNULL) != 0
+        return commit + ("-dirty" if dirty else "")
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def overall_p95(windows, route):
+    """95th percentile of one route over the given windows."""
+    values = sorted(v for w in windows for v in w.latency_ms[route])
+    return percentile(values, 95)
+
+
+def judge(args, windows, soak):
+    """Reasons the run failed, empty when it passed."""
+    failures = []
+    if soak is None:
+        failures.append("the unit never answered on /soak (not an env:soak build?)")
+    else:
+        for gate in soak.get("failed", []):
+            failures.append(f"unit gate {gate} failed")
+
+    total = sum(len(w.latency_ms[r]) + w.errors[r] for w in windows for r, _ in ROUTES)
+    errors = sum(w.errors[r] for w in windows for r, _ in ROUTES)
+    if total > 0 and errors * 100.0 / total > args.max_error_pct:
+        failures.append(f"{errors} of {total} requests failed")
+
+    # Latency creep: the first full window against the last
+    if len(windows) >= 3:
+        first, last = windows[1], windows[-2]
+        for route, _ in ROUTES:
+            before = overall_p95([first], route)
+            after = overall_p95([last], route)
+            if before is None or after is None:
+                continue
+            limit = before * (1 + args.creep_pct / 100.0) + args.creep_ms
+            if after > limit:
+                failures.append(f"{route} p95 crept from {before} ms to {after} ms")
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--device", required=True, help="unit address, e.g. 192.168.1.42")
+    parser.add_argument("--hours", type=float, default=8.0, help="run length")
+    parser.add_argument("--window-min", type=float, default=15.0, help="latency window length")
+    parser.add_argument("--creep-pct", type=float, default=50.0, help="p95 growth allowed, percent")
+    parser.add_argument("--creep-ms", type=float, default=20.0, help="p95 growth allowed on top, ms")
+    parser.add_argument("--max-error-pct", type=float, default=1.0, help="failed requests allowed")
+    parser.add_argument("--out", default="soak", help="directory for the report")
+    args = parser.parse_args()
+
+    base = "http://" + args.device
+    started = time.monotonic()
+    windows = [Window(0.0)]
+    lock = threading.Lock()
+    stop = threading.Event()
+    threads = [threading.Thread(target=poll_route, daemon=True,
+                                args=(base, route, rate, windows, lock, stop))
+               for route, rate in ROUTES]
+    for thread in threads:
+        thread.start()
+
+    soak = None
+    end = started + args.hours * 3600.0
+    next_window = started + args.window_min * 60.0
+    try:
+        while time.monotonic() < end:
+            time.sleep(min(60.0, max(0.0, end - time.monotonic())))
+            try:
+                soak = json.loads(fetch(base, "/soak")[1])
+            except (urllib.error.URLError, OSError, ValueError):
+                pass
+            now = time.monotonic()
+            if now >= next_window:
+                with lock:
+                    windows.append(Window(now - started))
+                next_window += args.window_min * 60.0
+            if soak is not None:
+                print(f"{(now - started) / 3600.0:5.2f} h: {soak.get('cycles')} cycles, "
+                      f"heap {soak.get('heap_drift_bph')} B/h, "
+                      f"frag {soak.get('frag_growth_pph')} pts/h, "
+                      f"{soak.get('misses_per_hour')} misses/h, "
+                      f"failing {soak.get('failing')}", flush=True)
+    except KeyboardInterrupt:
+        print("interrupted, judging what ran")
+    stop.set()
+    for thread in threads:
+        thread.join(TIMEOUT_S + 1)
+
+    failures = judge(args, windows, soak)
+    report = {
+        "commit": commit_name(),
+        "hours": round((time.monotonic() - started) / 3600.0, 2),
+        "unit": soak,
+        "windows": [w.summary() for w in windows],
+        "failures": failures,
+    }
+    os.makedirs(args.out, exist_ok=True)
+    path = os.path.join(args.out, f"soak-{report['commit']}.json")
+    with open(path, "w") as f:
+        json.dump(report, f, indent=1)
+    print(f"report: {path}")
+
+    for failure in failures:
+        print("FAIL " + failure)
+    if failures:
+        sys.exit(1)
+    print("PASS")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,149 @@
+"""
+Convert a HydraESP event trace export into a Chrome/Perfetto trace.
+
+The export comes from GET /trace, from /logs/events.hev on the SD card, or
+from a serial log captured while the console key was pressed ("@@EVT"
+hex lines):
+
+    curl -o events.hev http://<device-ip>/trace
+    python3 tools/trace/trace_to_perfetto.py events.hev > events.json
+    python3 tools/trace/trace_to_perfetto.py --serial monitor.log > events.json
+
+Open the JSON in https://ui.perfetto.dev or chrome://tracing. Each FreeRTOS
+task is a thread, each event tagged with the core it ran on; scan cycles,
+inferences and flushes are slices, mutex waits are slices ending where
+the lock was taken, queue sends are instant events.
+"""
+
+import json
+import struct
+import sys
+
+MAGIC = 0x56454848      # EVENT_TRACE_MAGIC
+FORMAT = 1              # EVENT_TRACE_FORMAT
+HEADER = struct.Struct("<IHHIIHH")      # trace_export_header_t
+TASK = struct.Struct("<I16s")           # trace_task_entry_t
+RECORD = struct.Struct("<IBBHII")       # trace_event_record_t
+
+# In trace_event_t order, from 1
+EVENTS = ["scan_begin", "scan_end", "infer_begin", "infer_end",
+          "flush_begin", "flush_end", "mutex_wait", "queue_send"]
+LOCKS = ["spi_display", "spi_touch", "spi_sd"]                      # trace_lock_t
+QUEUES = ["scan_events", "jobs_high", "jobs_normal", "jobs_low"]    # trace_queue_t
+STATES = ["idle", "sniffing", "tracking", "learning", "excited", "sleeping", "error", "updating"]  # ai_state_t
+UINT32_MAX = 0xFFFFFFFF
+
+
+def read_serial(path):
+    """Concatenate the "@@EVT" hex lines of the last dump in a log."""
+    data = None
+    with open(path, "r", errors="replace") as log:
+        for line in log:
+            at = line.find("@@EVT ")
+            if at < 0:
+                continue
+            payload = line[at + 6:].strip()
+            if payload.startswith("begin"):
+                data = bytearray()
+            elif payload == "end":
+                pass
+            elif data is not None:
+                data += bytes.fromhex(payload)
+    if data is None:
+        sys.exit("no @@EVT dump in " + path)
+    return bytes(data)
+
+
+def parse(data):
+    magic, fmt, record_bytes, record_count, overwritten, task_count, task_bytes = \
+        HEADER.unpack_from(data, 0)
+    if magic != MAGIC or fmt != FORMAT:
+        sys.exit("not an event trace export (format %d expected)" % FORMAT)
+    if record_bytes != RECORD.size or task_bytes != TASK.size:
+        sys.exit("record layout differs from this script")
+
+    offset = HEADER.size
+    tasks = {}
+    for _ in range(task_count):
+        number, name = TASK.unpack_from(data, offset)
+        tasks[number] = name.split(b"\0", 1)[0].decode(errors="replace")
+        offset += TASK.size
+
+    records = []
+    for _ in range(record_count):
+        if offset + RECORD.size > len(data):
+            break
+        records.append(RECORD.unpack_from(data, offset))
+        offset += RECORD.size
+    return tasks, records, overwritten
+
+
+def convert(tasks, records):
+    events = []
+    seen = set()
+    base = 0
+    previous = None
+    for timestamp, event, core, task, arg0, arg1 in records:
+        # Undo the 32-bit microsecond wrap; records are oldest first
+        if previous is not None and timestamp < previous:
+            base += 1 << 32
+        previous = timestamp
+        ts = base + timestamp
+
+        if task not in seen:
+            seen.add(task)
+            events.append({"ph": "M", "name": "thread_name", "pid": 0, "tid": task,
+                           "args": {"name": tasks.get(task, "task %d" % task)}})
+        # Unpinned tasks move between cores, so a slice may end on the other one
+        common = {"pid": 0, "tid": task, "cat": "core%d" % core}
+        name = EVENTS[event - 1] if 1 <= event <= len(EVENTS) else "event_%d" % event
+
+        if name.endswith("_begin"):
+            events.append(dict(common, ph="B", ts=ts, name=name[:-6]))
+        elif name.endswith("_end"):
+            args = {}
+            if name == "scan_end":
+                args = {"wifi": arg0, "ble": arg1}
+            elif name == "infer_end":
+                args = {"state": STATES[arg0] if arg0 < len(STATES) else arg0,
+                        "model": bool(arg1)}
+            events.append(dict(common, ph="E", ts=ts, name=name[:-4], args=args))
+        elif name == "mutex_wait":
+            lock = LOCKS[arg0] if arg0 < len(LOCKS) else "lock_%d" % arg0
+            if arg1 == UINT32_MAX:
+                events.append(dict(common, ph="i", s="t", ts=ts, name="timeout " + lock))
+            else:
+                events.append(dict(common, ph="X", ts=ts - arg1, dur=arg1, name="wait " + lock))
+        elif name == "queue_send":
+            queue = QUEUES[arg0] if arg0 < len(QUEUES) else "queue_%d" % arg0
+            full = arg1 == UINT32_MAX
+            events.append(dict(common, ph="i", s="t", ts=ts,
+                               name=("full " if full else "send ") + queue,
+                               args={} if full else {"waiting": arg1}))
+        else:
+            events.append(dict(common, ph="i", s="t", ts=ts, name=name,
+                               args={"arg0": arg0, "arg1": arg1}))
+    events.append({"ph": "M", "name": "process_name", "pid": 0, "args": {"name": "HydraESP"}})
+    return events
+
+
+def main():
+    args = sys.argv[1:]
+    serial = "--serial" in args
+    paths = [a for a in args if a != "--serial"]
+    if len(paths) != 1:
+        sys.exit("usage: trace_to_perfetto.py [--serial] <events.hev | monitor.log>")
+
+    if serial:
+        data = read_serial(paths[0])
+    else:
+        with open(paths[0], "rb") as f:
+            data = f.read()
+    tasks, records, overwritten = parse(data)
+    json.dump({"traceEvents": convert(tasks, records), "displayTimeUnit": "ms"}, sys.stdout)
+    sys.stderr.write("%d events, %d tasks, %d overwritten before the export\n"
+                     % (len(records), len(tasks), overwritten))
+
+
+if __name__ == "__main__":
+    main()
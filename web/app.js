@@ -0,0 +1,21 @@
+// Polls the JSON API on the same server as this page
+function show(id, text) {
+  document.getElementById(id).textContent = text;
+}
+
+async function poll() {
+  try {
+    const state = await (await fetch("/api/state")).json();
+    if (state.ai) {
+      show("state", state.ai.state);
+      show("confidence", Math.round(state.ai.confidence * 100) + "%");
+      show("age", Math.round(state.ai.age_ms / 1000) + " s");
+      show("transitions", state.ai.transitions);
+    }
+  } catch (e) {
+    show("state", "unreachable");
+  }
+}
+
+poll();
+setInterval(poll, 2000);